@@ -26,11 +26,13 @@ extern struct cputopo_arm cpu_topology[NR_CPUS];
 void init_cpu_topology(void);
 void store_cpu_topology(unsigned int cpuid);
 const struct cpumask *cpu_coregroup_mask(int cpu);
+void set_power_scale(unsigned int cpu, unsigned long power);
 
 #else
 
 static inline void init_cpu_topology(void) { }
 static inline void store_cpu_topology(unsigned int cpuid) { }
+static inline void set_power_scale(unsigned int cpu, unsigned long power) { }
 
 #endif
 
@@ -245,6 +245,7 @@ void cpu_idle(void)
 	/* endless idle loop with no priority at all */
 	while (1) {
 		idle_notifier_call_chain(IDLE_START);
+		quiet_vmstat();
 		tick_nohz_idle_enter();
 		rcu_idle_enter();
 		while (!need_resched()) {
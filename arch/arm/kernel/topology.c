@@ -43,6 +43,25 @@
 
 struct cputopo_arm cpu_topology[NR_CPUS];
 
+/*
+ * cpu power scale management
+ *
+ * cpu_power of each cpu as seen by the scheduler through
+ * arch_scale_freq_power(), SCHED_POWER_SCALE unless the platform knows
+ * better, e.g. because its cores differ in speed.
+ */
+static DEFINE_PER_CPU(unsigned long, cpu_scale);
+
+unsigned long arch_scale_freq_power(struct sched_domain *sd, int cpu)
+{
+	return per_cpu(cpu_scale, cpu);
+}
+
+void set_power_scale(unsigned int cpu, unsigned long power)
+{
+	per_cpu(cpu_scale, cpu) = power;
+}
+
 const struct cpumask *cpu_coregroup_mask(int cpu)
 {
 	return &cpu_topology[cpu].core_sibling;
@@ -143,6 +162,8 @@ void init_cpu_topology(void)
 		cpu_topo->socket_id = -1;
 		cpumask_clear(&cpu_topo->core_sibling);
 		cpumask_clear(&cpu_topo->thread_sibling);
+
+		set_power_scale(cpu, SCHED_POWER_SCALE);
 	}
 	smp_wmb();
 }
@@ -31,6 +31,7 @@
 #include <mach/irqs.h>
 #include <mach/iomap.h>
 #include <mach/dc.h>
+#include <mach/edp_budget.h>
 #include <asm/mach-types.h>
 
 #include "board.h"
@@ -67,6 +68,10 @@ struct platform_device * __init roth_host1x_init(void)
 
 #define DC_CTRL_MODE	TEGRA_DC_OUT_CONTINUOUS_MODE
 
+/* backlight draw at full brightness and the floor of its power budget */
+#define ROTH_BL_MAX_MW		800
+#define ROTH_BL_MIN_MW		80
+
 static atomic_t sd_brightness = ATOMIC_INIT(255);
 
 static bool reg_requested;
@@ -873,6 +878,7 @@ static struct platform_device roth_nvmap_device __initdata = {
 static int roth_disp1_bl_notify(struct device *unused, int brightness)
 {
 	int cur_sd_brightness = atomic_read(&sd_brightness);
+	unsigned int cap_mw;
 
 	/* SD brightness is a percentage */
 	brightness = (brightness * cur_sd_brightness) / 255;
@@ -881,6 +887,14 @@ static int roth_disp1_bl_notify(struct device *unused, int brightness)
 	if (brightness > 255)
 		pr_info("Error: Brightness > 255!\n");
 
+	/* ask the system power budget for this level, dim to what is left */
+	tegra_edp_budget_request(EDP_BUDGET_BACKLIGHT,
+				 brightness * ROTH_BL_MAX_MW / 255);
+	cap_mw = tegra_edp_budget_get(EDP_BUDGET_BACKLIGHT);
+	if (cap_mw)
+		brightness = min(brightness,
+				 (int)(cap_mw * 255 / ROTH_BL_MAX_MW));
+
 	return brightness;
 }
 
@@ -972,6 +986,8 @@ int __init roth_panel_init(int board_id)
 	struct board_info board_info;
 
 	sd_settings = roth_sd_settings;
+	tegra_edp_budget_set_limits(EDP_BUDGET_BACKLIGHT, ROTH_BL_MIN_MW,
+				    ROTH_BL_MAX_MW);
 #ifdef CONFIG_TEGRA_NVMAP
 	roth_carveouts[1].base = tegra_carveout_start;
 	roth_carveouts[1].size = tegra_carveout_size;
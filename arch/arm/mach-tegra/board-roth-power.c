@@ -46,6 +46,7 @@
 #include "tegra-board-id.h"
 #include "board-pmu-defines.h"
 #include "board.h"
+#include "board-common.h"
 #include "gpio-names.h"
 #include "board-roth.h"
 #include "tegra_cl_dvfs.h"
@@ -890,5 +891,12 @@ static struct soctherm_platform_data roth_soctherm_data = {
 
 int __init roth_soctherm_init(void)
 {
+	/*
+	 * Cold dvfs floors sit on the PLL zone: soctherm interrupts on the
+	 * trip crossings, so the floors come and go without polling.
+	 */
+	tegra_add_cdev_trips(roth_soctherm_data.therm[THERM_PLL].trips,
+			     &roth_soctherm_data.therm[THERM_PLL].num_trips);
+
 	return tegra11_soctherm_init(&roth_soctherm_data);
 }
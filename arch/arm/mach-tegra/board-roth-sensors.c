@@ -34,7 +34,10 @@
 #include <linux/gpio.h>
 #include <linux/therm_est.h>
 #include <linux/nct1008.h>
+#include <linux/clk.h>
+#include <linux/cpu.h>
 #include <mach/edp.h>
+#include <mach/clk.h>
 #include <mach/gpio-tegra.h>
 #include <mach/pinmux-t11.h>
 #include <mach/pinmux.h>
@@ -48,6 +51,8 @@
 #include "devices.h"
 #include "tegra-board-id.h"
 #include "dvfs.h"
+#include "clock.h"
+#include "pm.h"
 
 static struct board_info board_info;
 
@@ -221,8 +226,6 @@ static int roth_nct1008_init(void)
 	tegra_platform_edp_init(roth_nct1008_pdata.trips,
 				&roth_nct1008_pdata.num_trips,
 				0); /* edp temperature margin */
-	tegra_add_cdev_trips(roth_nct1008_pdata.trips,
-				&roth_nct1008_pdata.num_trips);
 	tegra_add_tj_trips(roth_nct1008_pdata.trips,
 				&roth_nct1008_pdata.num_trips);
 
@@ -272,6 +275,7 @@ static struct therm_est_data skin_data = {
 	.ndevs = 2,
 	.tc1 = 10,
 	.tc2 = 1,
+	.forecast_ms = 10000,
 	.devs = {
 			{
 				.dev_data = "nct_ext",
@@ -418,6 +422,40 @@ static int roth_fan_est_get_temp(void *data, long *temp)
 	return 0;
 }
 
+/* gr3d dynamic power in mW per V^2 * GHz */
+#define ROTH_GPU_DYN_CONST	2600
+
+/*
+ * Feed-forward power for the fan estimator: G cluster power from the EDP
+ * power table at the current rate and core count, plus a dynamic model of
+ * gr3d on the core rail.
+ */
+static int roth_fan_est_get_power(void *data, long *mw)
+{
+	static struct clk *cpu_g, *gr3d;
+	u64 gpu_mw;
+	int mv;
+
+	if (!cpu_g)
+		cpu_g = tegra_get_clock_by_name("cpu_g");
+	if (!gr3d)
+		gr3d = tegra_get_clock_by_name("3d");
+
+	*mw = 0;
+	if (cpu_g && !is_lp_cluster())
+		*mw += tegra_edp_get_cpu_power(clk_get_rate(cpu_g) / 1000,
+					       num_online_cpus());
+
+	if (gr3d && tegra_core_rail && tegra_is_clk_enabled(gr3d)) {
+		mv = tegra_core_rail->millivolts;
+		gpu_mw = (u64)mv * mv * (clk_get_rate(gr3d) / 1000);
+		gpu_mw = div_u64(gpu_mw * ROTH_GPU_DYN_CONST, 1000000);
+		*mw += (long)div_u64(gpu_mw, 1000000);
+	}
+
+	return 0;
+}
+
 /*Fan thermal estimator init data for P2454*/
 static struct therm_fan_est_data fan_est_data_p2454 = {
 	.toffset = 0,
@@ -451,6 +489,10 @@ static struct therm_fan_est_data fan_est_data_p2454 = {
 	.active_trip_temps = {0, 70000, 82000, 120000, 130000,
 				140000, 150000, 160000, 170000, 180000},
 	.active_hysteresis = {0, 10000, 7000, 0, 0, 0, 0, 0, 0, 0},
+	.get_power = roth_fan_est_get_power,
+	.power_coeff = 1500,
+	.power_max_lead = 8000,
+	.power_decay = 90,
 };
 
 static struct platform_device roth_fan_therm_est_device_p2454 = {
@@ -495,6 +537,10 @@ static struct therm_fan_est_data fan_est_data_p2560 = {
 	.active_trip_temps = {0, 47000, 55000, 67000, 103000,
 				140000, 150000, 160000, 170000, 180000},
 	.active_hysteresis = {0, 12000, 7000, 10000, 0, 0, 0, 0, 0, 0},
+	.get_power = roth_fan_est_get_power,
+	.power_coeff = 1500,
+	.power_max_lead = 8000,
+	.power_decay = 90,
 };
 
 static struct platform_device roth_fan_therm_est_device_p2560 = {
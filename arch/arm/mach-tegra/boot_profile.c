@@ -0,0 +1,111 @@
+/*
+ * arch/arm/mach-tegra/boot_profile.c
+ *
+ * Boot milestones of the Tegra platform code, from init_early to the first
+ * display frame, time stamped with the microsecond timer. Together with
+ * initcall_debug, which times each initcall but nothing before them, this
+ * shows where the time between bootloader handoff and first frame goes.
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include <mach/boot_profile.h>
+
+#define BOOT_PROFILE_MARKS	32
+
+extern u32 notrace tegra_read_usec_raw(void);
+
+static struct {
+	const char	*name;
+	u32		us;		/* since reset */
+} marks[BOOT_PROFILE_MARKS];
+static int num_marks;
+static unsigned int dropped_marks;
+static DEFINE_SPINLOCK(boot_profile_lock);
+
+void tegra_boot_profile_mark(const char *name)
+{
+	unsigned long flags;
+	u32 us = tegra_read_usec_raw();
+	int i;
+
+	spin_lock_irqsave(&boot_profile_lock, flags);
+	for (i = 0; i < num_marks; i++)
+		if (marks[i].name == name)
+			goto out;
+
+	if (num_marks < BOOT_PROFILE_MARKS) {
+		marks[num_marks].name = name;
+		marks[num_marks].us = us;
+		num_marks++;
+	} else {
+		dropped_marks++;
+	}
+out:
+	spin_unlock_irqrestore(&boot_profile_lock, flags);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int boot_profile_show(struct seq_file *s, void *data)
+{
+	unsigned long flags;
+	u32 prev;
+	int i;
+
+	seq_printf(s, "%-24s %12s %12s %12s\n",
+		   "mark", "reset_us", "kernel_us", "delta_us");
+
+	spin_lock_irqsave(&boot_profile_lock, flags);
+	prev = num_marks ? marks[0].us : 0;
+	for (i = 0; i < num_marks; i++) {
+		seq_printf(s, "%-24s %12u %12u %12u\n", marks[i].name,
+			   marks[i].us, marks[i].us - marks[0].us,
+			   marks[i].us - prev);
+		prev = marks[i].us;
+	}
+	if (dropped_marks)
+		seq_printf(s, "(%u marks dropped)\n", dropped_marks);
+	spin_unlock_irqrestore(&boot_profile_lock, flags);
+	return 0;
+}
+
+static int boot_profile_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, boot_profile_show, inode->i_private);
+}
+
+static const struct file_operations boot_profile_fops = {
+	.open		= boot_profile_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init boot_profile_debug_init(void)
+{
+	if (!debugfs_create_file("tegra_boot_profile", S_IRUGO, NULL, NULL,
+				 &boot_profile_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(boot_profile_debug_init);
+#endif
@@ -32,6 +32,8 @@
 #include <linux/bitops.h>
 #include <linux/io.h>
 #include <linux/bug.h>
+#include <linux/pm_qos.h>
+#include <linux/async.h>
 #include <trace/events/power.h>
 
 #include <mach/clk.h>
@@ -39,6 +41,7 @@
 #include <mach/io.h>
 #include <mach/hardware.h>
 #include <mach/edp.h>
+#include <mach/boot_profile.h>
 
 #include "board.h"
 #include "clock.h"
@@ -913,13 +916,80 @@ static int __init tegra_dfll_cpu_start(void)
 	return 0;
 }
 
+/*
+ * PM QoS EMC and GPU minimum frequency requests (kHz) are applied through
+ * the floor users of the respective shared buses.
+ */
+struct tegra_clk_qos_floor {
+	int pm_qos_class;
+	const char *names[2];
+	struct clk *clk;
+	bool enabled;
+	struct mutex lock;
+	struct notifier_block nb;
+};
+
+static int tegra_clk_qos_floor_notify(struct notifier_block *nb,
+				      unsigned long khz, void *data)
+{
+	struct tegra_clk_qos_floor *floor =
+		container_of(nb, struct tegra_clk_qos_floor, nb);
+
+	mutex_lock(&floor->lock);
+	if (khz) {
+		clk_set_rate(floor->clk, khz * 1000);
+		if (!floor->enabled && !clk_enable(floor->clk))
+			floor->enabled = true;
+	} else if (floor->enabled) {
+		clk_disable(floor->clk);
+		floor->enabled = false;
+	}
+	mutex_unlock(&floor->lock);
+
+	return NOTIFY_OK;
+}
+
+static struct tegra_clk_qos_floor tegra_clk_qos_floors[] = {
+	{ .pm_qos_class = PM_QOS_EMC_FREQ_MIN,
+	  .names = { "floor.emc" }, },
+	{ .pm_qos_class = PM_QOS_GPU_FREQ_MIN,
+	  .names = { "floor.c2bus", "floor.cbus" }, },
+};
+
+static void __init tegra_clk_qos_floor_init(void)
+{
+	struct tegra_clk_qos_floor *floor;
+	const char *name;
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(tegra_clk_qos_floors); i++) {
+		floor = &tegra_clk_qos_floors[i];
+
+		for (j = 0; j < ARRAY_SIZE(floor->names) && !floor->clk; j++) {
+			name = floor->names[j];
+			if (name)
+				floor->clk = tegra_get_clock_by_name(name);
+		}
+		if (!floor->clk)
+			continue;
+
+		mutex_init(&floor->lock);
+		floor->nb.notifier_call = tegra_clk_qos_floor_notify;
+		pm_qos_add_notifier(floor->pm_qos_class, &floor->nb);
+	}
+}
+
 static int __init tegra_clk_late_init(void)
 {
+	tegra_boot_profile_mark("clk late init");
 	tegra_init_disable_boot_clocks(); /* must before dvfs late init */
 	if (!tegra_dvfs_late_init())
 		tegra_dfll_cpu_start();	/* after successful dvfs init only */
+	tegra_boot_profile_mark("dvfs late init");
 	tegra_sync_cpu_clock();		/* after attempt to get dfll ready */
 	tegra_recalculate_cpu_edp_limits();
+	tegra_clk_qos_floor_init();
+	tegra_boot_profile_mark("clk late init done");
 	return 0;
 }
 late_initcall(tegra_clk_late_init);
@@ -1547,7 +1617,12 @@ static int clk_debugfs_register(struct clk *c)
 	return 0;
 }
 
-static int __init clk_debugfs_init(void)
+/*
+ * A few hundred clocks make this one of the slower initcalls, and nothing
+ * else waits for it, so it runs asynchronously; init memory is only freed
+ * after all async work is done.
+ */
+static void __init clk_debugfs_populate(void *data, async_cookie_t cookie)
 {
 	struct clk *c;
 	struct dentry *d;
@@ -1555,7 +1630,7 @@ static int __init clk_debugfs_init(void)
 
 	d = debugfs_create_dir("clock", NULL);
 	if (!d)
-		return -ENOMEM;
+		goto out;
 	clk_debugfs_root = d;
 
 	d = debugfs_create_file("clock_tree", S_IRUGO, clk_debugfs_root, NULL,
@@ -1569,15 +1644,27 @@ static int __init clk_debugfs_init(void)
 	if (!d || dvfs_debugfs_init(clk_debugfs_root))
 		goto err_out;
 
+	err = 0;
+	mutex_lock(&clock_list_lock);
 	list_for_each_entry(c, &clocks, node) {
 		err = clk_debugfs_register(c);
 		if (err)
-			goto err_out;
+			break;
 	}
-	return 0;
+	mutex_unlock(&clock_list_lock);
+	if (!err)
+		goto out;
 err_out:
 	debugfs_remove_recursive(clk_debugfs_root);
-	return err;
+	pr_err("%s: failed to create clock debugfs (%d)\n", __func__, err);
+out:
+	tegra_boot_profile_mark("clock debugfs");
+}
+
+static int __init clk_debugfs_init(void)
+{
+	async_schedule(clk_debugfs_populate, NULL);
+	return 0;
 }
 
 late_initcall(clk_debugfs_init);
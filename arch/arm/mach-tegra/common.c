@@ -33,6 +33,7 @@
 #include <linux/of.h>
 #include <linux/persistent_ram.h>
 #include <linux/dma-mapping.h>
+#include <linux/dma-contiguous.h>
 #include <linux/sys_soc.h>
 
 #include <trace/events/nvsecurity.h>
@@ -48,6 +49,7 @@
 #include <mach/powergate.h>
 #include <mach/tegra_smmu.h>
 #include <mach/gpio-tegra.h>
+#include <mach/boot_profile.h>
 
 #include "apbio.h"
 #include "board.h"
@@ -116,6 +118,10 @@ unsigned long tegra_carveout_start;
 unsigned long tegra_carveout_size;
 unsigned long tegra_vpr_start;
 unsigned long tegra_vpr_size;
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+/* owner of the CMA region backing the generic carveout */
+static struct device tegra_carveout_cma_dev;
+#endif
 unsigned long tegra_tsec_start;
 unsigned long tegra_tsec_size;
 unsigned long tegra_lp0_vec_start;
@@ -747,14 +753,18 @@ void __init tegra11x_init_early(void)
 	   handler initializer is not called, so do it here for non-SMP. */
 	tegra_cpu_reset_handler_init();
 #endif
+	tegra_boot_profile_mark("init_early");
 	tegra_perf_init();
 	tegra_init_fuse();
 	tegra_ramrepair_init();
 	tegra11x_init_clocks();
+	tegra_boot_profile_mark("clocks registered");
 	tegra11x_init_dvfs();
+	tegra_boot_profile_mark("dvfs rails");
 	tegra_common_init_clock();
 	tegra_clk_init_from_table(tegra11x_clk_init_table);
 	tegra11x_clk_init_la();
+	tegra_boot_profile_mark("clock init table");
 	tegra_pmc_init();
 	tegra_powergate_init();
 	tegra_init_power();
@@ -763,6 +773,7 @@ void __init tegra11x_init_early(void)
 	tegra_gpio_resume_init();
 
 	init_dma_coherent_pool_size(SZ_1M);
+	tegra_boot_profile_mark("init_early done");
 }
 #endif
 static int __init tegra_lp0_vec_arg(char *options)
@@ -1422,7 +1433,7 @@ void __init tegra_reserve(unsigned long carveout_size, unsigned long fb_size,
 	}
 #endif
 
-	if (carveout_size) {
+	if (carveout_size && !IS_ENABLED(CONFIG_NVMAP_CARVEOUT_CMA)) {
 		tegra_carveout_start = memblock_end_of_DRAM() - carveout_size;
 		if (memblock_remove(tegra_carveout_start, carveout_size)) {
 			pr_err("Failed to remove carveout %08lx@%08lx "
@@ -1458,6 +1469,33 @@ void __init tegra_reserve(unsigned long carveout_size, unsigned long fb_size,
 			tegra_fb_size = fb_size;
 	}
 
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	/*
+	 * The carveout stays in the memory map as a CMA region so that
+	 * movable pages can use it while nvmap does not. It goes below the
+	 * framebuffers, which are still removed, and is aligned the way
+	 * dma_declare_contiguous() wants it.
+	 */
+	if (carveout_size) {
+		unsigned long align = PAGE_SIZE <<
+			max(MAX_ORDER - 1, pageblock_order);
+
+		carveout_size = ALIGN(carveout_size, align);
+		tegra_carveout_start = round_down(memblock_end_of_DRAM() -
+						  carveout_size, align);
+		if (dma_declare_contiguous(&tegra_carveout_cma_dev,
+					   carveout_size,
+					   tegra_carveout_start, 0)) {
+			pr_err("Failed to declare carveout %08lx@%08lx "
+				"as CMA region\n",
+				carveout_size, tegra_carveout_start);
+			tegra_carveout_start = 0;
+			tegra_carveout_size = 0;
+		} else
+			tegra_carveout_size = carveout_size;
+	}
+#endif
+
 	if (tegra_fb_size)
 		tegra_grhost_aperture = tegra_fb_start;
 
@@ -32,15 +32,23 @@
 #include <linux/io.h>
 #include <linux/suspend.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
 #include <linux/cpu.h>
 
 
 #include <mach/clk.h>
 #include <mach/edp.h>
+#include <mach/edp_budget.h>
+#include <mach/thermal.h>
+
+#include <trace/events/nvpower.h>
 
 #include "clock.h"
 #include "cpu-tegra.h"
 #include "dvfs.h"
+#include "pm.h"
 
 /* tegra throttling and edp governors require frequencies in the table
    to be in ascending order */
@@ -192,35 +200,42 @@ static int edp_thermal_index;
 static cpumask_t edp_cpumask;
 static unsigned int edp_limit;
 
+/*
+ * The limits for every thermal zone, system EDP alarm state and number of
+ * cpus, flattened when the EDP tables change. Hotplug, thermal and alarm
+ * updates then only index it. "limit" is rounded down to the cpufreq
+ * table; "predict" is the raw table value used to weigh core count.
+ */
+#define EDP_MAX_CPUS	ARRAY_SIZE(((struct tegra_edp_limits *)0)->freq_limits)
+
+static struct {
+	unsigned int predict;
+	unsigned int limit;
+} edp_flat[MAX_THROT_TABLE_SIZE][2][EDP_MAX_CPUS];
+
 unsigned int tegra_get_edp_limit(int *get_edp_thermal_index)
 {
 	if (get_edp_thermal_index)
-		*get_edp_thermal_index = edp_thermal_index;
-	return edp_limit;
+		*get_edp_thermal_index = ACCESS_ONCE(edp_thermal_index);
+	return ACCESS_ONCE(edp_limit);
 }
 
-static unsigned int edp_predict_limit(unsigned int cpus)
+static unsigned int edp_calc_limit(int index, bool alarm, unsigned int cpus)
 {
 	unsigned int limit = 0;
 
-	BUG_ON(cpus == 0);
-	if (cpu_edp_limits) {
-		BUG_ON(edp_thermal_index >= cpu_edp_limits_size);
-		limit = cpu_edp_limits[edp_thermal_index].freq_limits[cpus - 1];
-	}
-	if (system_edp_limits && system_edp_alarm)
+	if (cpu_edp_limits)
+		limit = cpu_edp_limits[index].freq_limits[cpus - 1];
+	if (system_edp_limits && alarm)
 		limit = min(limit, system_edp_limits[cpus - 1]);
 
 	return limit;
 }
 
-/* Must be called while holding cpu_tegra_lock */
-static void edp_update_limit(void)
+static unsigned int edp_round_limit(unsigned int limit)
 {
-	unsigned int limit = edp_predict_limit(cpumask_weight(&edp_cpumask));
-	BUG_ON(!mutex_is_locked(&tegra_cpu_lock));
 #ifdef CONFIG_TEGRA_EDP_EXACT_FREQ
-	edp_limit = limit;
+	return limit;
 #else
 	unsigned int i;
 	for (i = 0; freq_table[i].frequency != CPUFREQ_TABLE_END; i++) {
@@ -229,8 +244,95 @@ static void edp_update_limit(void)
 		}
 	}
 	BUG_ON(i == 0);	/* min freq above the limit or table empty */
-	edp_limit = freq_table[i-1].frequency;
+	return freq_table[i-1].frequency;
+#endif
+}
+
+#ifdef CONFIG_TEGRA_EDP_BUDGET
+/*
+ * The cpu share of the system power budget, as the power EDP limits of the
+ * richest level that fits in it; 0 when the share is not capped. Unlike
+ * the thermal and alarm limits it moves at run time, so it is applied on
+ * top of the flattened table.
+ */
+static unsigned int budget_edp_limits[EDP_MAX_CPUS];
+
+static unsigned int edp_budget_cap(unsigned int cpus, unsigned int limit)
+{
+	unsigned int cap = budget_edp_limits[cpus - 1];
+
+	if (cap && (!limit || cap < limit))
+		return cap;
+	return limit;
+}
+
+/* Must be called while holding cpu_tegra_lock */
+static void edp_budget_set_limits(unsigned int mw)
+{
+	struct tegra_system_edp_entry *e;
+	unsigned int cpus, limit;
+	int i, size = 0;
+
+	memset(budget_edp_limits, 0, sizeof(budget_edp_limits));
+
+	e = tegra_get_system_edp_entries(&size);
+	if (!mw || !e || !size || !freq_table)
+		return;
+
+	/* entries go up in power; the lowest one is the floor */
+	for (i = size - 1; i > 0; i--)
+		if (e[i].power_limit_100mW * 100 <= mw)
+			break;
+
+	for (cpus = 1; cpus <= EDP_MAX_CPUS; cpus++) {
+		limit = max(e[i].freq_limits[cpus - 1],
+			    freq_table[0].frequency);
+		budget_edp_limits[cpus - 1] = edp_round_limit(limit);
+	}
+}
+#else
+#define edp_budget_cap(cpus, limit) (limit)
 #endif
+
+/* Must be called while holding cpu_tegra_lock */
+static void edp_flatten_limits(void)
+{
+	int index, size = cpu_edp_limits ? cpu_edp_limits_size : 1;
+	unsigned int alarm, cpus, limit;
+
+	BUG_ON(size > MAX_THROT_TABLE_SIZE);
+
+	for (index = 0; index < size; index++)
+		for (alarm = 0; alarm < 2; alarm++)
+			for (cpus = 1; cpus <= EDP_MAX_CPUS; cpus++) {
+				limit = edp_calc_limit(index, alarm, cpus);
+				edp_flat[index][alarm][cpus - 1].predict =
+					limit;
+				edp_flat[index][alarm][cpus - 1].limit =
+					edp_round_limit(limit);
+			}
+}
+
+static unsigned int edp_predict_limit(unsigned int cpus)
+{
+	BUG_ON(cpus == 0);
+	BUG_ON(cpu_edp_limits && edp_thermal_index >= cpu_edp_limits_size);
+
+	return edp_budget_cap(cpus, edp_flat[edp_thermal_index]
+			      [system_edp_alarm][cpus - 1].predict);
+}
+
+/* Must be called while holding cpu_tegra_lock */
+static void edp_update_limit(void)
+{
+	unsigned int cpus = cpumask_weight(&edp_cpumask);
+
+	BUG_ON(!mutex_is_locked(&tegra_cpu_lock));
+	BUG_ON(cpus == 0);
+	BUG_ON(cpu_edp_limits && edp_thermal_index >= cpu_edp_limits_size);
+
+	edp_limit = edp_budget_cap(cpus,
+		edp_flat[edp_thermal_index][system_edp_alarm][cpus - 1].limit);
 }
 
 static unsigned int edp_governor_speed(unsigned int requested_speed)
@@ -241,6 +343,45 @@ static unsigned int edp_governor_speed(unsigned int requested_speed)
 		return edp_limit;
 }
 
+#ifdef CONFIG_TEGRA_EDP_BUDGET
+static void edp_budget_apply(unsigned int mw)
+{
+	mutex_lock(&tegra_cpu_lock);
+	edp_budget_set_limits(mw);
+	if (target_cpu_speed[0] && !cpumask_empty(&edp_cpumask)) {
+		edp_update_limit();
+		tegra_cpu_set_speed_cap_locked(NULL);
+	}
+	mutex_unlock(&tegra_cpu_lock);
+}
+
+static int tegra_cpu_budget_notify(struct notifier_block *nb,
+				   unsigned long client, void *data)
+{
+	if (client != EDP_BUDGET_CPU)
+		return NOTIFY_DONE;
+
+	edp_budget_apply(*(unsigned int *)data);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block tegra_cpu_budget_notifier = {
+	.notifier_call = tegra_cpu_budget_notify,
+};
+
+/*
+ * The budget calls into us with its lock held, so it must not be called
+ * with tegra_cpu_lock held.
+ */
+static void tegra_cpu_edp_budget_init(void)
+{
+	if (!tegra_edp_budget_register_notifier(&tegra_cpu_budget_notifier))
+		edp_budget_apply(tegra_edp_budget_get(EDP_BUDGET_CPU));
+}
+#else
+#define tegra_cpu_edp_budget_init()
+#endif
+
 int tegra_edp_get_max_state(struct thermal_cooling_device *cdev,
 				unsigned long *max_state)
 {
@@ -408,6 +549,7 @@ static void tegra_cpu_edp_init(bool resume)
 	 * Boot frequency allowed SoC to get here, should work till sensor is
 	 * initialized.
 	 */
+	edp_flatten_limits();
 	edp_cpumask = *cpu_online_mask;
 	edp_update_limit();
 
@@ -417,6 +559,26 @@ static void tegra_cpu_edp_init(bool resume)
 	}
 }
 
+/* The cpu EDP table was recalculated, e.g. on a DFLL mode change */
+void tegra_cpu_edp_limits_changed(void)
+{
+	mutex_lock(&tegra_cpu_lock);
+
+	if (freq_table && cpu_edp_limits) {
+		tegra_get_cpu_edp_limits(&cpu_edp_limits,
+					 &cpu_edp_limits_size);
+		if (edp_thermal_index >= cpu_edp_limits_size)
+			edp_thermal_index = cpu_edp_limits_size - 1;
+		edp_flatten_limits();
+		if (target_cpu_speed[0]) {
+			edp_update_limit();
+			tegra_cpu_set_speed_cap_locked(NULL);
+		}
+	}
+
+	mutex_unlock(&tegra_cpu_lock);
+}
+
 static void tegra_cpu_edp_exit(void)
 {
 	if (!(cpu_edp_limits || system_edp_limits))
@@ -457,6 +619,7 @@ static int __init tegra_edp_debug_init(struct dentry *cpu_tegra_debugfs_root)
 #define edp_governor_speed(requested_speed) (requested_speed)
 #define tegra_cpu_edp_init(resume)
 #define tegra_cpu_edp_exit()
+#define tegra_cpu_edp_budget_init()
 #define tegra_edp_debug_init(cpu_tegra_debugfs_root) (0)
 #endif	/* CONFIG_TEGRA_EDP_LIMITS */
 
@@ -464,6 +627,76 @@ static int __init tegra_edp_debug_init(struct dentry *cpu_tegra_debugfs_root)
 
 static struct dentry *cpu_tegra_debugfs_root;
 
+static int trans_stats_show(struct seq_file *s, void *data)
+{
+	struct cpu_trans_stats *st;
+	int from, to, i;
+
+	seq_printf(s, "%9s %9s %7s %7s %7s", "from kHz", "to kHz", "count",
+		   "avg us", "max us");
+	for (i = 0; i < TRANS_HIST_BUCKETS - 1; i++)
+		seq_printf(s, " %6s%-4u", "<", 16 << i);
+	seq_printf(s, " %6s%-4u\n", ">=", 16 << (i - 1));
+
+	mutex_lock(&tegra_cpu_lock);
+	for (from = 0; trans_stats && from < trans_stats_size; from++) {
+		for (to = 0; to < trans_stats_size; to++) {
+			st = &trans_stats[from * trans_stats_size + to];
+			if (!st->count)
+				continue;
+			seq_printf(s, "%9u %9u %7u %7llu %7u",
+				   freq_table[from].frequency,
+				   freq_table[to].frequency, st->count,
+				   div_u64(st->total_us, st->count),
+				   st->max_us);
+			for (i = 0; i < TRANS_HIST_BUCKETS; i++)
+				seq_printf(s, " %10u", st->hist[i]);
+			seq_printf(s, "\n");
+		}
+	}
+	mutex_unlock(&tegra_cpu_lock);
+	return 0;
+}
+
+static int trans_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, trans_stats_show, inode->i_private);
+}
+
+static const struct file_operations trans_stats_fops = {
+	.open		= trans_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_cpu_trans_stats_init(void)
+{
+	int size = 0;
+
+	if (!freq_table)
+		return 0;
+
+	while (freq_table[size].frequency != CPUFREQ_TABLE_END)
+		size++;
+
+	mutex_lock(&tegra_cpu_lock);
+	trans_stats = kzalloc(size * size * sizeof(*trans_stats),
+			      GFP_KERNEL);
+	if (trans_stats)
+		trans_stats_size = size;
+	mutex_unlock(&tegra_cpu_lock);
+
+	if (!trans_stats)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("transition_stats", S_IRUGO,
+				 cpu_tegra_debugfs_root, NULL,
+				 &trans_stats_fops))
+		return -ENOMEM;
+	return 0;
+}
+
 static int __init tegra_cpu_debug_init(void)
 {
 	cpu_tegra_debugfs_root = debugfs_create_dir("cpu-tegra", 0);
@@ -474,6 +707,9 @@ static int __init tegra_cpu_debug_init(void)
 	if (tegra_edp_debug_init(cpu_tegra_debugfs_root))
 		goto err_out;
 
+	if (tegra_cpu_trans_stats_init())
+		goto err_out;
+
 	return 0;
 
 err_out:
@@ -506,10 +742,76 @@ unsigned int tegra_getspeed(unsigned int cpu)
 	return rate;
 }
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Time from request to completion of each transition, per source and target
+ * table entry, in log2 buckets starting at 16 us.
+ */
+#define TRANS_HIST_BUCKETS	10
+
+struct cpu_trans_stats {
+	unsigned int count;
+	unsigned int max_us;
+	u64 total_us;
+	unsigned int hist[TRANS_HIST_BUCKETS];
+};
+
+static struct cpu_trans_stats *trans_stats;	/* [from][to] */
+static int trans_stats_size;
+
+static int freq_table_index(unsigned int freq)
+{
+	int i;
+	int index = -1;
+
+	for (i = 0; i < trans_stats_size; i++) {
+		if (freq_table[i].frequency == CPUFREQ_ENTRY_INVALID)
+			continue;
+		if (freq_table[i].frequency > freq)
+			break;
+		index = i;
+	}
+	return index;
+}
+
+static void cpu_trans_stats_update(unsigned int old_freq,
+				   unsigned int new_freq, ktime_t start)
+{
+	struct cpu_trans_stats *st;
+	unsigned int us;
+	int from, to;
+
+	if (!trans_stats)
+		return;
+
+	from = freq_table_index(old_freq);
+	to = freq_table_index(new_freq);
+	if (from < 0 || to < 0)
+		return;
+
+	us = ktime_us_delta(ktime_get(), start);
+	st = &trans_stats[from * trans_stats_size + to];
+	st->count++;
+	st->total_us += us;
+	st->max_us = max(st->max_us, us);
+	st->hist[min_t(int, fls(us >> 4), TRANS_HIST_BUCKETS - 1)]++;
+}
+#else
+#define cpu_trans_stats_update(old_freq, new_freq, start)
+#endif
+
+static inline int tegra_cpu_freq_mode(void)
+{
+	if (!is_lp_cluster() && tegra_dvfs_rail_is_dfll_mode(tegra_cpu_rail))
+		return NVPOWER_CPU_FREQ_DFLL;
+	return NVPOWER_CPU_FREQ_PLL;
+}
+
 int tegra_update_cpu_speed(unsigned long rate)
 {
 	int ret = 0;
 	struct cpufreq_freqs freqs;
+	ktime_t start;
 
 	freqs.old = tegra_getspeed(0);
 	freqs.new = rate;
@@ -521,6 +823,10 @@ int tegra_update_cpu_speed(unsigned long rate)
 	if (freqs.old == freqs.new)
 		return ret;
 
+	start = ktime_get();
+	trace_nvcpu_freq(NVPOWER_CPU_FREQ_REQUEST, tegra_cpu_freq_mode(),
+			 freqs.old, freqs.new);
+
 	/*
 	 * Vote on memory bus frequency based on cpu frequency
 	 * This sets the minimum frequency, display or avp may request higher
@@ -563,6 +869,10 @@ int tegra_update_cpu_speed(unsigned long rate)
 		tegra_update_mselect_rate(freqs.new);
 	}
 
+	trace_nvcpu_freq(NVPOWER_CPU_FREQ_DONE, tegra_cpu_freq_mode(),
+			 freqs.old, freqs.new);
+	cpu_trans_stats_update(freqs.old, freqs.new, start);
+
 	return 0;
 }
 
@@ -829,10 +1139,77 @@ static struct freq_attr *tegra_cpufreq_attr[] = {
 	NULL,
 };
 
+/*
+ * Throughput of the LP core relative to a G core at the same frequency, in
+ * percent. Governors use it to compare load measured on either cluster.
+ */
+static unsigned int lp_ipc_factor = 90;
+module_param(lp_ipc_factor, uint, 0644);
+
+static unsigned int tegra_cpu_capacity(unsigned int cpu, unsigned int freq)
+{
+	struct clk *parent;
+
+	/* frequencies above the LP range are run on the G cluster */
+	if (cpu_clk && is_lp_cluster()) {
+		parent = clk_get_parent(cpu_clk);
+		if (parent && freq <= clk_get_max_rate(parent) / 1000)
+			return freq * lp_ipc_factor / 100;
+	}
+
+	return freq;
+}
+
+/*
+ * Tell the scheduler what a cpu is worth at the cluster and frequency we
+ * run at, relative to a G core at the top of the table. All online cpus
+ * share both, so this only moves cpu_power as a whole; it is kept at or
+ * above half scale so that every cpu still counts as capacity 1 and task
+ * spreading is unchanged.
+ */
+static int tegra_cpu_power_notify(struct notifier_block *nb,
+				  unsigned long event, void *data)
+{
+	struct cpufreq_freqs *freqs = data;
+	unsigned int max = 0;
+	unsigned long power;
+	int i;
+
+	if (event != CPUFREQ_POSTCHANGE || !freq_table)
+		return NOTIFY_OK;
+
+	for (i = 0; freq_table[i].frequency != CPUFREQ_TABLE_END; i++)
+		if (freq_table[i].frequency != CPUFREQ_ENTRY_INVALID)
+			max = max(max, freq_table[i].frequency);
+	if (!max)
+		return NOTIFY_OK;
+
+	power = SCHED_POWER_SCALE * tegra_cpu_capacity(freqs->cpu, freqs->new) /
+		tegra_cpu_capacity(freqs->cpu, max);
+	power = clamp_t(unsigned long, power, SCHED_POWER_SCALE / 2,
+			SCHED_POWER_SCALE);
+
+	for_each_possible_cpu(i)
+		set_power_scale(i, power);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block tegra_cpu_power_nb = {
+	.notifier_call = tegra_cpu_power_notify,
+};
+
+static unsigned int tegra_cpu_mem_load(unsigned int cpu)
+{
+	return tegra_actmon_cpu_emc_load();
+}
+
 static struct cpufreq_driver tegra_cpufreq_driver = {
 	.verify		= tegra_verify_speed,
 	.target		= tegra_target,
 	.get		= tegra_getspeed,
+	.capacity	= tegra_cpu_capacity,
+	.mem_load	= tegra_cpu_mem_load,
 	.init		= tegra_cpu_init,
 	.exit		= tegra_cpu_exit,
 	.name		= "tegra",
@@ -862,6 +1239,7 @@ static int __init tegra_cpufreq_init(void)
 	mutex_lock(&tegra_cpu_lock);
 	tegra_cpu_edp_init(false);
 	mutex_unlock(&tegra_cpu_lock);
+	tegra_cpu_edp_budget_init();
 
 	ret = register_pm_notifier(&tegra_cpu_pm_notifier);
 
@@ -874,6 +1252,12 @@ static int __init tegra_cpufreq_init(void)
 	if (ret)
 		return ret;
 
+	ret = cpufreq_register_notifier(
+		&tegra_cpu_power_nb, CPUFREQ_TRANSITION_NOTIFIER);
+
+	if (ret)
+		return ret;
+
 	return cpufreq_register_driver(&tegra_cpufreq_driver);
 }
 
@@ -65,4 +65,11 @@ static inline int tegra_suspended_target(unsigned int target_freq)
 { return -ENOSYS; }
 #endif
 
+#if defined(CONFIG_CPU_FREQ) && defined(CONFIG_TEGRA_EDP_LIMITS)
+void tegra_cpu_edp_limits_changed(void);
+#else
+static inline void tegra_cpu_edp_limits_changed(void)
+{ }
+#endif
+
 #endif /* __MACH_TEGRA_CPU_TEGRA_H */
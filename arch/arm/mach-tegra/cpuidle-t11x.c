@@ -90,6 +90,15 @@ static struct clk *cpu_clk_for_dvfs;
 
 static int pd_exit_latencies[5];
 
+static bool pd_learn_wake_sources __read_mostly = true;
+module_param(pd_learn_wake_sources, bool, 0644);
+
+static bool pd_adaptive_residency __read_mostly = true;
+module_param(pd_adaptive_residency, bool, 0644);
+
+static uint pd_break_even_ratio __read_mostly = 200;	/* % of cost */
+module_param(pd_break_even_ratio, uint, 0644);
+
 static struct {
 	unsigned int cpu_ready_count[5];
 	unsigned int tear_down_count[5];
@@ -113,13 +122,225 @@ static struct {
 	unsigned int pd_int_count[NR_IRQS];
 	unsigned int last_pd_int_count[NR_IRQS];
 	unsigned int clk_gating_vmin;
+	unsigned int mispredict_count[5];
+	unsigned int demoted_count[5];
 } idle_stats;
 
+/*
+ * Interrupts that keep cutting power-down states short (audio DMA, vsync
+ * and the like) are usually periodic.  Every early wake is attributed to
+ * the pending interrupt, and the interval between wakes from the same
+ * source is averaged.  A source with a steady period that has been seen
+ * recently caps the sleep length used to pick a state, so that we don't
+ * pay for a power-down the interrupt will abort anyway.
+ */
+#define PD_WAKE_SOURCES		8
+#define PD_WAKE_MIN_COUNT	4	/* wakes before a source is trusted */
+#define PD_WAKE_EXPIRE		8	/* periods without a wake */
+#define PD_WAKE_MAX_INTERVAL	1000000	/* us */
+
+static struct pd_wake_source {
+	int irq;
+	s64 last;		/* us */
+	int period;		/* us */
+	int deviation;		/* us */
+	unsigned int count;
+} pd_wake_sources[PD_WAKE_SOURCES] = {
+	[0 ... PD_WAKE_SOURCES - 1] = { .irq = -1 },
+};
+static DEFINE_SPINLOCK(pd_wake_lock);
+
 static inline unsigned int time_to_bin(unsigned int time)
 {
 	return fls(time);
 }
 
+static inline bool pd_wake_source_periodic(struct pd_wake_source *src,
+					   s64 now)
+{
+	return (src->irq >= 0) && (src->count >= PD_WAKE_MIN_COUNT) &&
+		(src->deviation * 4 < src->period) &&
+		(now - src->last < (s64)src->period * PD_WAKE_EXPIRE);
+}
+
+static void pd_wake_source_learn(int irq, ktime_t time)
+{
+	struct pd_wake_source *src = NULL;
+	s64 now = ktime_to_us(time);
+	int interval;
+	int n;
+	int i;
+
+	if (!pd_learn_wake_sources || (irq < INT_PRI_BASE) ||
+	    (irq >= NR_IRQS))
+		return;
+
+	spin_lock(&pd_wake_lock);
+	for (i = 0; i < PD_WAKE_SOURCES; i++) {
+		if (pd_wake_sources[i].irq == irq) {
+			src = &pd_wake_sources[i];
+			break;
+		}
+		if (!src || (pd_wake_sources[i].last < src->last))
+			src = &pd_wake_sources[i];
+	}
+
+	if (src->irq != irq) {
+		/* replace the least recently seen source */
+		src->irq = irq;
+		src->period = 0;
+		src->deviation = 0;
+		src->count = 0;
+	} else if (now - src->last < PD_WAKE_MAX_INTERVAL) {
+		interval = now - src->last;
+
+		/*
+		 * Wakes that hit the CPU while it was not power gated are
+		 * not seen here; fold multiples back onto the period.
+		 */
+		if (src->period) {
+			n = (interval + src->period / 2) / src->period;
+			if (n > 1)
+				interval /= n;
+			src->deviation += (abs(interval - src->period) -
+					   src->deviation) / 8;
+			src->period += (interval - src->period) / 8;
+		} else
+			src->period = interval;
+		src->count++;
+	} else
+		src->count = 0;
+	src->last = now;
+	spin_unlock(&pd_wake_lock);
+}
+
+/*
+ * Cap the time to the next timer event by the next expected wake from any
+ * periodic source.
+ */
+static s64 pd_wake_source_predict(s64 request)
+{
+	struct pd_wake_source *src;
+	s64 now;
+	int next;
+	int i;
+
+	if (!pd_learn_wake_sources)
+		return request;
+
+	now = ktime_to_us(ktime_get());
+	spin_lock(&pd_wake_lock);
+	for (i = 0; i < PD_WAKE_SOURCES; i++) {
+		src = &pd_wake_sources[i];
+		if (!pd_wake_source_periodic(src, now))
+			continue;
+		next = src->period - (int)(now - src->last) % src->period;
+		if (next < request)
+			request = next;
+	}
+	spin_unlock(&pd_wake_lock);
+
+	return request;
+}
+
+/*
+ * Cluster power-down thresholds measured on this unit instead of the
+ * board's fixed min_residency values.  Every completed power-down gives
+ * the entry plus exit cost of that kind: the time spent on top of the
+ * programmed sleep.  The energy break-even residency is that cost scaled
+ * by pd_break_even_ratio at the nominal cpu rail voltage; leakage, which
+ * is what gating saves, grows with voltage, so the break-even shrinks as
+ * the rail goes up.  A power-down that wakes before break-even is a miss
+ * and raises the margin over break-even, hits slowly lower it again, so
+ * the threshold follows how often wakes come early on this workload.
+ * Until enough samples exist the board values are used.
+ */
+#define PD_RESIDENCY_MIN_SAMPLES	8
+#define PD_RESIDENCY_MARGIN_MIN		100	/* % */
+#define PD_RESIDENCY_MARGIN_MAX		400	/* % */
+#define PD_RESIDENCY_MARGIN_MISS	25	/* % */
+
+enum {
+	PD_KIND_C0NC,
+	PD_KIND_C1NC,
+	PD_KIND_CRAIL,
+	PD_KINDS,
+};
+
+static struct pd_residency {
+	int cost;		/* us, entry + exit */
+	int margin;		/* % of break-even */
+	unsigned int samples;
+	unsigned int entries;
+	unsigned int misses;
+} pd_residency[PD_KINDS] = {
+	[0 ... PD_KINDS - 1] = { .margin = PD_RESIDENCY_MARGIN_MIN },
+};
+
+static int pd_kind(unsigned int flag)
+{
+	if (is_lp_cluster())
+		return PD_KIND_C1NC;
+	if (flag & TEGRA_POWER_CLUSTER_PART_CRAIL)
+		return PD_KIND_CRAIL;
+	return PD_KIND_C0NC;
+}
+
+static unsigned long pd_static_residency(int kind)
+{
+	if (kind == PD_KIND_CRAIL)
+		return tegra_min_residency_crail();
+	return tegra_min_residency_ncpu();
+}
+
+static unsigned long pd_break_even(int kind)
+{
+	unsigned long us = pd_residency[kind].cost * pd_break_even_ratio / 100;
+	int mv = tegra_cpu_rail ? tegra_cpu_rail->millivolts : 0;
+
+	if (mv > 0 && tegra_cpu_rail->nominal_millivolts > 0)
+		us = us * tegra_cpu_rail->nominal_millivolts / mv;
+	return us;
+}
+
+static unsigned long pd_min_residency(int kind)
+{
+	struct pd_residency *r = &pd_residency[kind];
+
+	if (!pd_adaptive_residency || r->samples < PD_RESIDENCY_MIN_SAMPLES)
+		return pd_static_residency(kind);
+	return pd_break_even(kind) * r->margin / 100;
+}
+
+/* Only the last cpu of the cluster gets here, so no locking. */
+static void pd_residency_learn(int kind, s64 elapsed, s64 sleep_time,
+			       bool completed)
+{
+	struct pd_residency *r = &pd_residency[kind];
+	int cost;
+
+	r->entries++;
+
+	if (completed && elapsed > sleep_time) {
+		cost = min_t(s64, elapsed - sleep_time, 10000);
+		if (r->samples++)
+			r->cost += (cost - r->cost) / 8;
+		else
+			r->cost = cost;
+	}
+
+	if (r->samples < PD_RESIDENCY_MIN_SAMPLES)
+		return;
+
+	if (elapsed < pd_break_even(kind)) {
+		r->misses++;
+		r->margin = min(r->margin + PD_RESIDENCY_MARGIN_MISS,
+				PD_RESIDENCY_MARGIN_MAX);
+	} else if (r->margin > PD_RESIDENCY_MARGIN_MIN) {
+		r->margin--;
+	}
+}
+
 static inline void tegra_irq_unmask(int irq)
 {
 	struct irq_data *data = irq_get_irq_data(irq);
@@ -179,9 +400,35 @@ bool tegra11x_pd_is_allowed(struct cpuidle_device *dev,
 		return false;
 	}
 
+	if (pd_wake_source_predict(request) < state->target_residency) {
+		/* A periodic interrupt is due before LP2 pays off */
+		idle_stats.demoted_count[cpu_number(dev->cpu)]++;
+		return false;
+	}
+
 	return true;
 }
 
+/*
+ * The cluster power-down cancelled the wake timers of the other CPUs, which
+ * are still power gated. Nothing hands their events to the broadcast timer,
+ * so their own timers are re-armed here.
+ */
+static void tegra_cpu_restart_wake_timers(ktime_t now)
+{
+#if defined(CONFIG_SMP) && !defined(CONFIG_TEGRA_LP2_CPU_TIMER)
+	unsigned int i;
+
+	smp_rmb();
+	for (i = 1; i < CONFIG_NR_CPUS; i++) {
+		if (tegra_cpu_wake_by_time[i] == LLONG_MAX)
+			continue;
+		tegra_pd_timer_restart_secondary(i, tegra_cpu_wake_by_time[i] -
+			ktime_to_us(now) - pd_exit_latencies[i]);
+	}
+#endif
+}
+
 static inline void tegra11_irq_restore_affinity(void)
 {
 #ifdef CONFIG_SMP
@@ -204,6 +451,7 @@ static bool tegra_cpu_cluster_power_down(struct cpuidle_device *dev,
 	bool sleep_completed = false;
 	bool multi_cpu_entry = false;
 	int bin;
+	int irq = -1;
 	unsigned int flag = 0;
 	s64 sleep_time;
 
@@ -276,7 +524,6 @@ static bool tegra_cpu_cluster_power_down(struct cpuidle_device *dev,
 	bin = time_to_bin((u32)request / 1000);
 	idle_stats.tear_down_count[cpu_number(dev->cpu)]++;
 
-	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_ENTER, &dev->cpu);
 	if (is_lp_cluster()) {
 		/* here we are not supporting emulation mode, for now */
 		flag = TEGRA_POWER_CLUSTER_PART_NONCPU;
@@ -288,7 +535,8 @@ static bool tegra_cpu_cluster_power_down(struct cpuidle_device *dev,
 			<< TEGRA_POWER_CLUSTER_PART_SHIFT)
 			& TEGRA_POWER_CLUSTER_PART_MASK;
 
-		if (((request < tegra_min_residency_crail()) &&
+		if (((pd_wake_source_predict(request) <
+				pd_min_residency(PD_KIND_CRAIL)) &&
 			(flag != TEGRA_POWER_CLUSTER_PART_MASK)) &&
 			((fast_cluster_power_down_mode &
 			TEGRA_POWER_CLUSTER_FORCE_MASK) == 0))
@@ -306,15 +554,27 @@ static bool tegra_cpu_cluster_power_down(struct cpuidle_device *dev,
 	if (tegra_idle_power_down_last(sleep_time, flag) == 0)
 		sleep_completed = true;
 	else {
-		int irq = tegra_gic_pending_interrupt();
+		irq = tegra_gic_pending_interrupt();
 		idle_stats.pd_int_count[irq]++;
 	}
 
-	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_EXIT, &dev->cpu);
+	tegra3_lp2_local_timer_restart();
 	exit_time = ktime_get();
+	if (multi_cpu_entry)
+		tegra_cpu_restart_wake_timers(exit_time);
+	if (!sleep_completed) {
+		pd_wake_source_learn(irq, exit_time);
+		if (ktime_to_us(ktime_sub(exit_time, entry_time)) <
+		    state->target_residency)
+			idle_stats.mispredict_count[cpu_number(dev->cpu)]++;
+	}
 	if (!is_lp_cluster())
 		tegra_dvfs_rail_on(tegra_cpu_rail, exit_time);
 
+	pd_residency_learn(pd_kind(flag),
+			   ktime_to_us(ktime_sub(exit_time, entry_time)),
+			   sleep_time, sleep_completed);
+
 	if (flag == TEGRA_POWER_CLUSTER_PART_CRAIL)
 		idle_stats.rail_pd_time +=
 			ktime_to_us(ktime_sub(exit_time, entry_time));
@@ -375,6 +635,7 @@ static bool tegra_cpu_core_power_down(struct cpuidle_device *dev,
 	u32 cntp_tval;
 	u32 cntfrq;
 	ktime_t entry_time;
+	ktime_t exit_time;
 	bool sleep_completed = false;
 	struct tick_sched *ts = tick_get_tick_sched(dev->cpu);
 	unsigned int cpu = cpu_number(dev->cpu);
@@ -399,7 +660,6 @@ static bool tegra_cpu_core_power_down(struct cpuidle_device *dev,
 
 #if !defined(CONFIG_TEGRA_LP2_CPU_TIMER)
 	sleep_time = request - state->exit_latency;
-	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_ENTER, &dev->cpu);
 	tegra_pd_set_trigger(sleep_time);
 #endif
 	idle_stats.tear_down_count[cpu]++;
@@ -428,10 +688,16 @@ static bool tegra_cpu_core_power_down(struct cpuidle_device *dev,
 #else
 	sleep_completed = !tegra_pd_timer_remain();
 	tegra_pd_set_trigger(0);
-	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_EXIT, &dev->cpu);
+	tegra3_lp2_local_timer_restart();
 #endif
-	sleep_time = ktime_to_us(ktime_sub(ktime_get(), entry_time));
+	exit_time = ktime_get();
+	sleep_time = ktime_to_us(ktime_sub(exit_time, entry_time));
 	idle_stats.cpu_pg_time[cpu] += sleep_time;
+	if (!sleep_completed) {
+		pd_wake_source_learn(tegra_gic_pending_interrupt(), exit_time);
+		if (sleep_time < state->target_residency)
+			idle_stats.mispredict_count[cpu]++;
+	}
 	if (sleep_completed) {
 		/*
 		 * Stayed in LP2 for the full time until timer expires,
@@ -461,11 +727,16 @@ bool tegra11x_idle_power_down(struct cpuidle_device *dev,
 	int status = -1;
 	unsigned long rate;
 	s64 request;
+	s64 expect;
+	unsigned long min_residency_ncpu;
 
 	if (tegra_cpu_timer_get_remain(&request)) {
 		cpu_do_idle();
 		return false;
 	}
+	expect = pd_wake_source_predict(request);
+	min_residency_ncpu = pd_min_residency(is_lp_cluster() ?
+					      PD_KIND_C1NC : PD_KIND_C0NC);
 
 	tegra_set_cpu_in_pd(dev->cpu);
 	cpu_gating_only = (((fast_cluster_power_down_mode
@@ -474,7 +745,7 @@ bool tegra11x_idle_power_down(struct cpuidle_device *dev,
 
 	if (is_lp_cluster()) {
 		if (slow_cluster_power_gating_noncpu &&
-			(request > tegra_min_residency_ncpu()))
+			(expect > min_residency_ncpu))
 				power_gating_cpu_only = false;
 		else
 			power_gating_cpu_only = true;
@@ -488,16 +759,15 @@ bool tegra11x_idle_power_down(struct cpuidle_device *dev,
 			else if (tegra_force_clkgt_at_vmin ==
 					TEGRA_CPUIDLE_FORCE_NO_CLKGT_VMIN)
 				clkgt_at_vmin = false;
-			else if ((request >= tegra_min_residency_vmin_fmin()) &&
-				 (request < tegra_min_residency_ncpu()))
+			else if ((expect >= tegra_min_residency_vmin_fmin()) &&
+				 (expect < min_residency_ncpu))
 				clkgt_at_vmin = true;
 
 			if (!cpu_gating_only && tegra_rail_off_is_allowed()) {
 				if (fast_cluster_power_down_mode &
 						TEGRA_POWER_CLUSTER_FORCE_MASK)
 					power_gating_cpu_only = false;
-				else if (request >
-						tegra_min_residency_ncpu())
+				else if (expect > min_residency_ncpu)
 					power_gating_cpu_only = false;
 				else
 					power_gating_cpu_only = true;
@@ -539,6 +809,8 @@ bool tegra11x_idle_power_down(struct cpuidle_device *dev,
 #ifdef CONFIG_DEBUG_FS
 int tegra11x_pd_debug_show(struct seq_file *s, void *data)
 {
+	unsigned long flags;
+	s64 now;
 	int bin;
 	int i;
 	seq_printf(s, "                                    cpu0     cpu1     cpu2     cpu3     cpulp\n");
@@ -555,6 +827,18 @@ int tegra11x_pd_debug_show(struct seq_file *s, void *data)
 		idle_stats.tear_down_count[2],
 		idle_stats.tear_down_count[3],
 		idle_stats.tear_down_count[4]);
+	seq_printf(s, "mispredicted:                   %8u %8u %8u %8u %8u\n",
+		idle_stats.mispredict_count[0],
+		idle_stats.mispredict_count[1],
+		idle_stats.mispredict_count[2],
+		idle_stats.mispredict_count[3],
+		idle_stats.mispredict_count[4]);
+	seq_printf(s, "demoted:                        %8u %8u %8u %8u %8u\n",
+		idle_stats.demoted_count[0],
+		idle_stats.demoted_count[1],
+		idle_stats.demoted_count[2],
+		idle_stats.demoted_count[3],
+		idle_stats.demoted_count[4]);
 	seq_printf(s, "clk gating @ Vmin count:      %8u\n",
 		idle_stats.clk_gating_vmin);
 	seq_printf(s, "rail gating count:      %8u\n",
@@ -673,6 +957,34 @@ int tegra11x_pd_debug_show(struct seq_file *s, void *data)
 				idle_stats.c1nc_gating_bin[bin]);
 	}
 
+	seq_printf(s, "\n");
+	seq_printf(s, "%19s %8s %8s %8s\n", "", "c0nc", "c1nc", "crail");
+	seq_printf(s, "-------------------------------------------------\n");
+	seq_printf(s, "%-19s %8d %8d %8d\n", "cost us:",
+		pd_residency[PD_KIND_C0NC].cost,
+		pd_residency[PD_KIND_C1NC].cost,
+		pd_residency[PD_KIND_CRAIL].cost);
+	seq_printf(s, "%-19s %8lu %8lu %8lu\n", "break-even us:",
+		pd_break_even(PD_KIND_C0NC),
+		pd_break_even(PD_KIND_C1NC),
+		pd_break_even(PD_KIND_CRAIL));
+	seq_printf(s, "%-19s %8lu %8lu %8lu\n", "min residency us:",
+		pd_min_residency(PD_KIND_C0NC),
+		pd_min_residency(PD_KIND_C1NC),
+		pd_min_residency(PD_KIND_CRAIL));
+	seq_printf(s, "%-19s %7d%% %7d%% %7d%%\n", "margin:",
+		pd_residency[PD_KIND_C0NC].margin,
+		pd_residency[PD_KIND_C1NC].margin,
+		pd_residency[PD_KIND_CRAIL].margin);
+	seq_printf(s, "%-19s %8u %8u %8u\n", "entries:",
+		pd_residency[PD_KIND_C0NC].entries,
+		pd_residency[PD_KIND_C1NC].entries,
+		pd_residency[PD_KIND_CRAIL].entries);
+	seq_printf(s, "%-19s %8u %8u %8u\n", "break-even misses:",
+		pd_residency[PD_KIND_C0NC].misses,
+		pd_residency[PD_KIND_C1NC].misses,
+		pd_residency[PD_KIND_CRAIL].misses);
+
 	seq_printf(s, "\n");
 	seq_printf(s, "%3s %20s %6s %10s\n",
 		"int", "name", "count", "last count");
@@ -688,6 +1000,26 @@ int tegra11x_pd_debug_show(struct seq_file *s, void *data)
 				idle_stats.last_pd_int_count[i]);
 		idle_stats.last_pd_int_count[i] = idle_stats.pd_int_count[i];
 	};
+
+	seq_printf(s, "\n");
+	seq_printf(s, "%3s %20s %10s %10s %6s %8s\n",
+		"int", "name", "period us", "dev us", "wakes", "periodic");
+	seq_printf(s, "-------------------------------------------------"
+			"------------\n");
+	spin_lock_irqsave(&pd_wake_lock, flags);
+	now = ktime_to_us(ktime_get());
+	for (i = 0; i < PD_WAKE_SOURCES; i++) {
+		struct pd_wake_source *src = &pd_wake_sources[i];
+		if (src->irq < 0)
+			continue;
+		seq_printf(s, "%3d %20s %10d %10d %6u %8s\n",
+			src->irq, irq_to_desc(src->irq)->action ?
+				irq_to_desc(src->irq)->action->name ?: "???" :
+				"???",
+			src->period, src->deviation, src->count,
+			pd_wake_source_periodic(src, now) ? "yes" : "no");
+	}
+	spin_unlock_irqrestore(&pd_wake_lock, flags);
 	return 0;
 }
 #endif
@@ -184,6 +184,26 @@ bool tegra3_lp2_is_allowed(struct cpuidle_device *dev,
 	return true;
 }
 
+/*
+ * The cluster power-down cancelled the wake timers of the other CPUs, which
+ * are still power gated. Nothing hands their events to the broadcast timer,
+ * so their own timers are re-armed here.
+ */
+static void tegra_cpu_restart_wake_timers(ktime_t now)
+{
+#if defined(CONFIG_SMP) && !defined(CONFIG_TEGRA_LP2_CPU_TIMER)
+	unsigned int i;
+
+	smp_rmb();
+	for (i = 1; i < CONFIG_NR_CPUS; i++) {
+		if (tegra_cpu_wake_by_time[i] == LLONG_MAX)
+			continue;
+		tegra_pd_timer_restart_secondary(i, tegra_cpu_wake_by_time[i] -
+			ktime_to_us(now) - lp2_exit_latencies[i]);
+	}
+#endif
+}
+
 static inline void tegra3_lp2_restore_affinity(void)
 {
 #ifdef CONFIG_SMP
@@ -279,7 +299,6 @@ static bool tegra_cpu_cluster_power_down(struct cpuidle_device *dev,
 	idle_stats.lp2_count++;
 	idle_stats.lp2_count_bin[bin]++;
 
-	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_ENTER, &dev->cpu);
 	if (!is_lp_cluster())
 		tegra_dvfs_rail_off(tegra_cpu_rail, entry_time);
 
@@ -290,8 +309,10 @@ static bool tegra_cpu_cluster_power_down(struct cpuidle_device *dev,
 		idle_stats.lp2_int_count[irq]++;
 	}
 
-	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_EXIT, &dev->cpu);
+	tegra3_lp2_local_timer_restart();
 	exit_time = ktime_get();
+	if (multi_cpu_entry)
+		tegra_cpu_restart_wake_timers(exit_time);
 	if (!is_lp_cluster())
 		tegra_dvfs_rail_on(tegra_cpu_rail, exit_time);
 
@@ -391,7 +412,6 @@ static bool tegra_cpu_core_power_down(struct cpuidle_device *dev,
 
 #if !defined(CONFIG_TEGRA_LP2_CPU_TIMER)
 	sleep_time = request - state->exit_latency;
-	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_ENTER, &dev->cpu);
 	tegra_twd_suspend(&twd_context);
 	tegra_pd_set_trigger(sleep_time);
 #endif
@@ -422,7 +442,7 @@ static bool tegra_cpu_core_power_down(struct cpuidle_device *dev,
 	sleep_completed = !tegra_pd_timer_remain();
 	tegra_pd_set_trigger(0);
 	tegra_twd_resume(&twd_context);
-	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_EXIT, &dev->cpu);
+	tegra3_lp2_local_timer_restart();
 #endif
 	sleep_time = ktime_to_us(ktime_sub(ktime_get(), entry_time));
 	idle_stats.in_lp2_time[cpu_number(dev->cpu)] += sleep_time;
@@ -28,21 +28,27 @@
 #include <linux/err.h>
 #include <linux/io.h>
 #include <linux/cpu.h>
+#include <linux/irq.h>
 #include <linux/clk.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/cpuquiet.h>
 #include <linux/pm_qos.h>
 #include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/thermal.h>
+#include <linux/platform_data/thermal_sensors.h>
 
 #include "pm.h"
 #include "cpu-tegra.h"
 #include "clock.h"
+#include "tegra11_soctherm.h"
 
 #define INITIAL_STATE		TEGRA_CPQ_DISABLED
 #define UP_DELAY_MS		70
 #define DOWN_DELAY_MS		2000
 #define HOTPLUG_DELAY_MS	100
+#define CLUSTER_HIST_BUCKETS	16
 
 static struct mutex *tegra_cpu_lock;
 static DEFINE_MUTEX(tegra_cpq_lock_stats);
@@ -70,6 +76,16 @@ static unsigned long up_delay;
 static unsigned long down_delay;
 static unsigned long hotplug_timeout;
 static int mp_overhead = 10;
+static bool soft_offline = true;
+
+/*
+ * Minimum time (ms) to stay on a cluster before switching away from it. A
+ * switch requested earlier is deferred until the residency is met, unless
+ * it is forced by no_lp, by suspend or by a core count request.
+ */
+static unsigned int lp_min_residency;
+static unsigned int g_min_residency;
+static bool cluster_switch_forced;
 static unsigned int idle_top_freq;
 static unsigned int idle_bottom_freq;
 
@@ -80,6 +96,24 @@ static struct clk *cpu_lp_clk;
 static struct cpumask cr_online_requests;
 static struct cpumask cr_offline_requests;
 
+/*
+ * With soft_offline set, cores quiesced on the G cluster are parked rather
+ * than unplugged: they stay online but leave the scheduler's active set and
+ * sit in the deepest cpuidle state, so waking one is a scheduler update and
+ * not a cold boot of the core. Parked cores still count against the EDP
+ * limit. They are unplugged for real before switching to the LP cluster.
+ */
+static struct cpumask cr_parked;
+
+/*
+ * Interrupts that could only be delivered to parked cores are sent to the
+ * housekeeping core (the first active one) instead, so that devices like
+ * wifi, sdhci or USB don't keep waking the parked cores out of power-down.
+ * The affinity set by the user is kept and takes effect again once the
+ * cores are unparked.
+ */
+static bool steer_irqs = true;
+
 enum {
 	TEGRA_CPQ_DISABLED = 0,
 	TEGRA_CPQ_ENABLED,
@@ -102,6 +136,19 @@ static struct {
 	unsigned int up_down_count;
 } hp_stats[CONFIG_NR_CPUS + 1];	/* Append LP CPU entry at the end */
 
+/* cluster switch cost and residency, indexed by the cluster left */
+static struct {
+	ktime_t entry;
+	unsigned int deferred;
+	struct {
+		unsigned int count;
+		u64 total_us;
+		u64 max_us;
+		unsigned int cost[CLUSTER_HIST_BUCKETS];	/* log2 us */
+		unsigned int residency[CLUSTER_HIST_BUCKETS];	/* log2 ms */
+	} from[2];
+} cluster_stats;
+
 static void hp_init_stats(void)
 {
 	int i;
@@ -122,10 +169,69 @@ static void hp_init_stats(void)
 				hp_stats[i].up_down_count = 1;
 		}
 	}
+	cluster_stats.entry = ktime_get();
 
 	mutex_unlock(&tegra_cpq_lock_stats);
 }
 
+static int cluster_hist_bucket(u64 val)
+{
+	int bucket = fls64(val) - 1;
+
+	return clamp(bucket, 0, CLUSTER_HIST_BUCKETS - 1);
+}
+
+/* must be called with tegra_cpu_lock held */
+static void cluster_stats_update(int from, ktime_t start)
+{
+	ktime_t now = ktime_get();
+	u64 cost_us = ktime_us_delta(now, start);
+	u64 residency_ms = ktime_to_ms(ktime_sub(start, cluster_stats.entry));
+
+	mutex_lock(&tegra_cpq_lock_stats);
+
+	cluster_stats.from[from].count++;
+	cluster_stats.from[from].total_us += cost_us;
+	cluster_stats.from[from].max_us =
+		max(cluster_stats.from[from].max_us, cost_us);
+	cluster_stats.from[from].cost[cluster_hist_bucket(cost_us)]++;
+	cluster_stats.from[from].residency[cluster_hist_bucket(residency_ms)]++;
+	cluster_stats.entry = now;
+
+	mutex_unlock(&tegra_cpq_lock_stats);
+}
+
+/*
+ * Returns true, and re-arms the switch timer, if the current cluster has
+ * not met its minimum residency yet.
+ */
+static bool cluster_switch_deferred(int state)
+{
+	unsigned int min_residency = state == TEGRA_CPQ_LP ?
+				     lp_min_residency : g_min_residency;
+	s64 residency;
+	bool deferred = false;
+
+	mutex_lock(tegra_cpu_lock);
+
+	if (cluster_switch_forced) {
+		cluster_switch_forced = false;
+		goto out;
+	}
+
+	residency = ktime_to_ms(ktime_sub(ktime_get(), cluster_stats.entry));
+	if (residency < min_residency) {
+		cluster_stats.deferred++;
+		mod_timer(&updown_timer, jiffies +
+			  msecs_to_jiffies(min_residency - residency));
+		deferred = true;
+	}
+out:
+	mutex_unlock(tegra_cpu_lock);
+
+	return deferred;
+}
+
 /* must be called with tegra_cpq_lock_stats held */
 static void __hp_stats_update(unsigned int cpu, bool up)
 {
@@ -179,7 +285,8 @@ static int update_core_config(unsigned int cpunumber, bool up)
 		cpumask_clear_cpu(cpunumber, &cr_offline_requests);
 		if (is_lp_cluster())
 			ret = -EBUSY;
-		else if (tegra_cpu_edp_favor_up(nr_cpus, mp_overhead))
+		else if (cpumask_test_cpu(cpunumber, &cr_parked) ||
+			 tegra_cpu_edp_favor_up(nr_cpus, mp_overhead))
 			queue_work(cpuquiet_wq, &cpuquiet_work);
 	} else {
 		if (is_lp_cluster()) {
@@ -205,7 +312,7 @@ static int tegra_quiesence_cpu(unsigned int cpunumber, bool sync)
 		return err;
 
 	err = wait_event_interruptible_timeout(wait_cpu,
-					       !cpu_online(cpunumber),
+					       !cpu_active(cpunumber),
 					       hotplug_timeout);
 
 	if (err < 0)
@@ -225,7 +332,7 @@ static int tegra_wake_cpu(unsigned int cpunumber, bool sync)
 	if (err || !sync)
 		return err;
 
-	err = wait_event_interruptible_timeout(wait_cpu, cpu_online(cpunumber),
+	err = wait_event_interruptible_timeout(wait_cpu, cpu_active(cpunumber),
 					       hotplug_timeout);
 
 	if (err < 0)
@@ -241,6 +348,7 @@ static struct cpuquiet_driver tegra_cpuquiet_driver = {
         .name                   = "tegra",
         .quiesence_cpu          = tegra_quiesence_cpu,
         .wake_cpu               = tegra_wake_cpu,
+        .get_cpu_temp           = tegra11_soctherm_cpu_temp,
 };
 
 static void updown_handler(unsigned long data)
@@ -248,11 +356,98 @@ static void updown_handler(unsigned long data)
 	queue_work(cpuquiet_wq, &cpuquiet_work);
 }
 
+/* the last active G core was quiesced */
+static void lp_switch_request(void)
+{
+	if (no_lp != 1 &&
+	    num_active_cpus() == 1 &&
+	    tegra_getspeed(0) <= idle_bottom_freq) {
+		mutex_lock(tegra_cpu_lock);
+
+		cpq_target_cluster_state = TEGRA_CPQ_LP;
+
+		/* Explicit LP cluster request: force switch now. */
+		if (no_lp == -1) {
+			cluster_switch_forced = true;
+			queue_work(cpuquiet_wq, &cpuquiet_work);
+		} else
+			mod_timer(&updown_timer, jiffies + down_delay);
+
+		mutex_unlock(tegra_cpu_lock);
+	}
+}
+
+/* a second G core became active */
+static void lp_switch_cancel(void)
+{
+	if (cpq_target_cluster_state == TEGRA_CPQ_LP) {
+		mutex_lock(tegra_cpu_lock);
+
+		if (cpq_target_cluster_state == TEGRA_CPQ_LP) {
+			cpq_target_cluster_state = TEGRA_CPQ_G;
+			del_timer(&updown_timer);
+		}
+
+		mutex_unlock(tegra_cpu_lock);
+	}
+}
+
+/* must be called from worker function */
+static void __steer_irqs(const struct cpumask *changed)
+{
+	struct cpumask mask;
+	struct irq_desc *desc;
+	struct irq_data *d;
+	struct irq_chip *c;
+	unsigned long flags;
+	unsigned int irq;
+
+	if (!steer_irqs || cpumask_empty(changed))
+		return;
+
+	for_each_irq_desc(irq, desc) {
+		raw_spin_lock_irqsave(&desc->lock, flags);
+		d = irq_desc_get_irq_data(desc);
+		c = irq_data_get_irq_chip(d);
+		if (!desc->action || irqd_is_per_cpu(d) || !c ||
+		    !c->irq_set_affinity ||
+		    !cpumask_intersects(d->affinity, changed))
+			goto next;
+
+		if (!cpumask_and(&mask, d->affinity, cpu_active_mask))
+			cpumask_copy(&mask,
+				cpumask_of(cpumask_first(cpu_active_mask)));
+		c->irq_set_affinity(d, &mask, false);
+next:
+		raw_spin_unlock_irqrestore(&desc->lock, flags);
+	}
+}
+
+/* must be called from worker function */
+static void __unpark_cpus(bool unplug)
+{
+	struct cpumask unparked;
+	unsigned int cpu;
+
+	cpumask_clear(&unparked);
+	for_each_cpu(cpu, &cr_parked) {
+		if (unplug ? cpu_down(cpu) : sched_set_cpu_parked(cpu, false))
+			continue;
+		cpumask_clear_cpu(cpu, &cr_parked);
+		if (!unplug) {
+			cpumask_set_cpu(cpu, &unparked);
+			hp_stats_update(cpu, true);
+		}
+	}
+	__steer_irqs(&unparked);
+}
+
 /* must be called from worker function */
 static int __apply_cluster_config(int state, int target_state)
 {
 	int new_state = state;
 	unsigned long speed;
+	ktime_t start;
 
 	mutex_lock(tegra_cpu_lock);
 
@@ -264,7 +459,9 @@ static int __apply_cluster_config(int state, int target_state)
 					clk_get_min_rate(cpu_g_clk) / 1000);
 			tegra_update_cpu_speed(speed);
 
+			start = ktime_get();
 			if (!tegra_cluster_switch(cpu_clk, cpu_g_clk)) {
+				cluster_stats_update(TEGRA_CPQ_LP, start);
 				hp_stats_update(CONFIG_NR_CPUS, false);
 				hp_stats_update(0, true);
 				new_state = TEGRA_CPQ_G;
@@ -281,7 +478,9 @@ static int __apply_cluster_config(int state, int target_state)
 			    clk_get_max_rate(cpu_lp_clk) / 1000 - 30000);
 		tegra_update_cpu_speed(speed);
 
+		start = ktime_get();
 		if (!tegra_cluster_switch(cpu_clk, cpu_lp_clk)) {
+			cluster_stats_update(TEGRA_CPQ_G, start);
 			hp_stats_update(CONFIG_NR_CPUS, true);
 			hp_stats_update(0, false);
 			new_state = TEGRA_CPQ_LP;
@@ -301,7 +500,7 @@ static void __cpuinit __apply_core_config(void)
 	int count = -1;
 	unsigned int cpu;
 	int nr_cpus;
-	struct cpumask online, offline, cpu_online;
+	struct cpumask online, offline, cpu_online, changed;
 	int max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? :
 				num_present_cpus();
 	int min_cpus = pm_qos_request(PM_QOS_MIN_ONLINE_CPUS);
@@ -315,7 +514,11 @@ static void __cpuinit __apply_core_config(void)
 
 	/* always keep CPU0 online */
 	cpumask_set_cpu(0, &online);
-	cpu_online = *cpu_online_mask;
+	/* parked cores are online but quiesced */
+	cpu_online = *cpu_active_mask;
+
+	if (!soft_offline)
+		__unpark_cpus(true);
 
 	if (no_lp == -1) {
 		max_cpus = 1;
@@ -343,17 +546,31 @@ static void __cpuinit __apply_core_config(void)
 		}
 	}
 
+	cpumask_clear(&changed);
 	cpumask_andnot(&online, &online, &cpu_online);
 	for_each_cpu(cpu, &online) {
-		cpu_up(cpu);
+		if (cpumask_test_cpu(cpu, &cr_parked)) {
+			if (sched_set_cpu_parked(cpu, false))
+				continue;
+			cpumask_clear_cpu(cpu, &cr_parked);
+			cpumask_set_cpu(cpu, &changed);
+			lp_switch_cancel();
+		} else
+			cpu_up(cpu);
 		hp_stats_update(cpu, true);
 	}
 
 	cpumask_and(&offline, &offline, &cpu_online);
 	for_each_cpu(cpu, &offline) {
-		cpu_down(cpu);
+		if (soft_offline && !sched_set_cpu_parked(cpu, true)) {
+			cpumask_set_cpu(cpu, &cr_parked);
+			cpumask_set_cpu(cpu, &changed);
+			lp_switch_request();
+		} else
+			cpu_down(cpu);
 		hp_stats_update(cpu, false);
 	}
+	__steer_irqs(&changed);
 	wake_up_interruptible(&wait_cpu);
 }
 
@@ -366,6 +583,8 @@ static void __cpuinit tegra_cpuquiet_work_func(struct work_struct *work)
 	current_cluster = is_lp_cluster();
 	action = cpq_target_state;
 	new_cluster = cpq_target_cluster_state;
+	if (current_cluster == new_cluster)
+		cluster_switch_forced = false;
 
 	if (action == TEGRA_CPQ_ENABLED) {
 		hp_init_stats();
@@ -385,6 +604,8 @@ static void __cpuinit tegra_cpuquiet_work_func(struct work_struct *work)
 	if (action == TEGRA_CPQ_DISABLED) {
 		cpq_state = TEGRA_CPQ_DISABLED;
 		mutex_unlock(tegra_cpu_lock);
+		/* parked cores can't be brought back from the cpu sysfs */
+		__unpark_cpus(false);
 		cpuquiet_device_busy();
 		pr_info("Tegra cpuquiet clusterswitch disabled\n");
 		wake_up_interruptible(&wait_enable);
@@ -395,7 +616,11 @@ static void __cpuinit tegra_cpuquiet_work_func(struct work_struct *work)
 	if (current_cluster == TEGRA_CPQ_G)
 		__apply_core_config();
 
-	if (current_cluster != new_cluster) {
+	if (current_cluster != new_cluster &&
+	    !cluster_switch_deferred(current_cluster)) {
+		if (current_cluster == TEGRA_CPQ_G)
+			__unpark_cpus(true);
+
 		current_cluster = __apply_cluster_config(current_cluster,
 					new_cluster);
 
@@ -419,8 +644,10 @@ static int min_cpus_notify(struct notifier_block *nb, unsigned long n, void *p)
 		return NOTIFY_OK;
 	}
 
-	if (n > 1)
+	if (n > 1) {
 		cpq_target_cluster_state = TEGRA_CPQ_G;
+		cluster_switch_forced = true;
+	}
 
 	queue_work(cpuquiet_wq, &cpuquiet_work);
 
@@ -445,35 +672,19 @@ static int __cpuinit cpu_online_notify(struct notifier_block *nfb,
 					unsigned long action, void *hcpu)
 {
 	switch (action) {
+	case CPU_DEAD:
+		cpumask_clear_cpu((unsigned long)hcpu, &cr_parked);
+		break;
 	case CPU_POST_DEAD:
-		if (no_lp != 1 &&
-		    num_online_cpus() == 1 &&
-		    tegra_getspeed(0) <= idle_bottom_freq) {
-			mutex_lock(tegra_cpu_lock);
-
-			cpq_target_cluster_state = TEGRA_CPQ_LP;
-
-			/* Explicit LP cluster request: force switch now. */
-			if (no_lp == -1)
-				queue_work(cpuquiet_wq, &cpuquiet_work);
-			else
-				mod_timer(&updown_timer, jiffies + down_delay);
-
-			mutex_unlock(tegra_cpu_lock);
-		}
+		lp_switch_request();
 		break;
-	case CPU_ONLINE:
 	case CPU_ONLINE_FROZEN:
-		if (cpq_target_cluster_state == TEGRA_CPQ_LP) {
-			mutex_lock(tegra_cpu_lock);
-
-			if (cpq_target_cluster_state == TEGRA_CPQ_LP) {
-				cpq_target_cluster_state = TEGRA_CPQ_G;
-				del_timer(&updown_timer);
-			}
-
-			mutex_unlock(tegra_cpu_lock);
-		}
+		/* parked cores come back active from suspend, park again */
+		if (cpumask_test_cpu((unsigned long)hcpu, &cr_parked))
+			queue_work(cpuquiet_wq, &cpuquiet_work);
+		/* fall through */
+	case CPU_ONLINE:
+		lp_switch_cancel();
 		break;
 	}
 
@@ -495,6 +706,7 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 
 			/* Force switch now */
 			cpq_target_cluster_state = TEGRA_CPQ_G;
+			cluster_switch_forced = true;
 			queue_work(cpuquiet_wq, &cpuquiet_work);
 		}
 		return;
@@ -504,7 +716,7 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 	 * If there is more then 1 CPU online, we must be on the fast cluster
 	 * and we can't switch.
 	 */
-	if (num_online_cpus() > 1)
+	if (num_active_cpus() > 1)
 		return;
 
 	if (is_lp_cluster()) {
@@ -598,10 +810,12 @@ ssize_t store_no_lp(struct cpuquiet_attribute *attr,
 	/* Force switch if necessary. */
 	if (no_lp == 1 && is_lp_cluster()) {
 		cpq_target_cluster_state = TEGRA_CPQ_G;
+		cluster_switch_forced = true;
 		queue_work(cpuquiet_wq, &cpuquiet_work);
 		lp_req = 0;
 	} else if (no_lp == -1 && !is_lp_cluster()) {
 		cpq_target_cluster_state = TEGRA_CPQ_LP;
+		cluster_switch_forced = true;
 		queue_work(cpuquiet_wq, &cpuquiet_work);
 		lp_req = 1;
 	} else {
@@ -626,6 +840,10 @@ ssize_t store_no_lp(struct cpuquiet_attribute *attr,
 CPQ_BASIC_ATTRIBUTE(idle_top_freq, 0644, uint);
 CPQ_BASIC_ATTRIBUTE(idle_bottom_freq, 0644, uint);
 CPQ_BASIC_ATTRIBUTE(mp_overhead, 0644, int);
+CPQ_BASIC_ATTRIBUTE(soft_offline, 0644, bool);
+CPQ_BASIC_ATTRIBUTE(steer_irqs, 0644, bool);
+CPQ_BASIC_ATTRIBUTE(lp_min_residency, 0644, uint);
+CPQ_BASIC_ATTRIBUTE(g_min_residency, 0644, uint);
 CPQ_ATTRIBUTE_CUSTOM(no_lp, 0644, show_int_attribute, store_no_lp);
 CPQ_ATTRIBUTE(up_delay, 0644, ulong, delay_callback);
 CPQ_ATTRIBUTE(down_delay, 0644, ulong, delay_callback);
@@ -639,6 +857,10 @@ static struct attribute *tegra_auto_attributes[] = {
 	&idle_top_freq_attr.attr,
 	&idle_bottom_freq_attr.attr,
 	&mp_overhead_attr.attr,
+	&soft_offline_attr.attr,
+	&steer_irqs_attr.attr,
+	&lp_min_residency_attr.attr,
+	&g_min_residency_attr.attr,
 	&enable_attr.attr,
 	&hotplug_timeout_attr.attr,
 	NULL,
@@ -733,6 +955,64 @@ static const struct file_operations hp_stats_fops = {
 	.release	= single_release,
 };
 
+static int cluster_stats_show(struct seq_file *s, void *data)
+{
+	int i, from;
+
+	mutex_lock(&tegra_cpq_lock_stats);
+
+	seq_printf(s, "%-15s %u\n", "deferred:", cluster_stats.deferred);
+	seq_printf(s, "%-15s %-10s %-10s\n", "", "G->LP", "LP->G");
+
+	seq_printf(s, "%-15s ", "switches:");
+	for (from = TEGRA_CPQ_G; from <= TEGRA_CPQ_LP; from++)
+		seq_printf(s, "%-10u ", cluster_stats.from[from].count);
+	seq_printf(s, "\n");
+
+	seq_printf(s, "%-15s ", "avg cost (us):");
+	for (from = TEGRA_CPQ_G; from <= TEGRA_CPQ_LP; from++) {
+		unsigned int count = cluster_stats.from[from].count;
+
+		seq_printf(s, "%-10llu ", count ?
+			   div_u64(cluster_stats.from[from].total_us, count) :
+			   0);
+	}
+	seq_printf(s, "\n");
+
+	seq_printf(s, "%-15s ", "max cost (us):");
+	for (from = TEGRA_CPQ_G; from <= TEGRA_CPQ_LP; from++)
+		seq_printf(s, "%-10llu ", cluster_stats.from[from].max_us);
+	seq_printf(s, "\n");
+
+	seq_printf(s, "\ncost (us)\n");
+	for (i = 0; i < CLUSTER_HIST_BUCKETS; i++)
+		seq_printf(s, ">=%-13u %-10u %-10u\n", i ? 1 << i : 0,
+			   cluster_stats.from[TEGRA_CPQ_G].cost[i],
+			   cluster_stats.from[TEGRA_CPQ_LP].cost[i]);
+
+	seq_printf(s, "\nresidency (ms)\n");
+	for (i = 0; i < CLUSTER_HIST_BUCKETS; i++)
+		seq_printf(s, ">=%-13u %-10u %-10u\n", i ? 1 << i : 0,
+			   cluster_stats.from[TEGRA_CPQ_G].residency[i],
+			   cluster_stats.from[TEGRA_CPQ_LP].residency[i]);
+
+	mutex_unlock(&tegra_cpq_lock_stats);
+
+	return 0;
+}
+
+static int cluster_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cluster_stats_show, inode->i_private);
+}
+
+static const struct file_operations cluster_stats_fops = {
+	.open		= cluster_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 
 static int __init tegra_cpuquiet_debug_init(void)
 {
@@ -745,6 +1025,10 @@ static int __init tegra_cpuquiet_debug_init(void)
 		"stats", S_IRUGO, hp_debugfs_root, NULL, &hp_stats_fops))
 		goto err_out;
 
+	if (!debugfs_create_file("cluster_switch", S_IRUGO, hp_debugfs_root,
+				 NULL, &cluster_stats_fops))
+		goto err_out;
+
 	return 0;
 
 err_out:
@@ -153,6 +153,16 @@ struct tegra_dma_channel {
 	struct tegra_dma_req	*cb_req;
 	dma_isr_handler		isr_handler;
 	bool	dma_is_paused;
+
+	/* chained mode */
+	struct list_head	done;		/* completed, callbacks due */
+	int			run_nr;		/* requests in running block */
+	int			next_nr;	/* requests prefetched */
+
+	/* enqueue to start latency */
+	unsigned int		starts;
+	u64			start_us_total;
+	u32			start_us_max;
 };
 
 #define  NV_DMA_MAX_CHANNELS  32
@@ -162,13 +172,20 @@ static DEFINE_MUTEX(tegra_dma_lock);
 static DEFINE_SPINLOCK(enable_lock);
 
 static DECLARE_BITMAP(channel_usage, NV_DMA_MAX_CHANNELS);
+
+/* Free channels only TEGRA_DMA_PRIO_HIGH allocations may take */
+static unsigned int reserved_channels = 2;
+module_param(reserved_channels, uint, 0444);
 static struct tegra_dma_channel dma_channels[NV_DMA_MAX_CHANNELS];
 
 static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 	struct tegra_dma_req *req);
 static bool tegra_dma_update_hw_partial(struct tegra_dma_channel *ch,
 	struct tegra_dma_req *req);
+static bool __tegra_dma_update_hw_partial(struct tegra_dma_channel *ch,
+	struct tegra_dma_req *req, unsigned int req_transfer_count);
 static void handle_oneshot_dma(struct tegra_dma_channel *ch);
+static void handle_chained_dma(struct tegra_dma_channel *ch);
 static void handle_continuous_dbl_dma(struct tegra_dma_channel *ch);
 static void handle_continuous_sngl_dma(struct tegra_dma_channel *ch);
 static void handle_dma_isr_locked(struct tegra_dma_channel *ch);
@@ -252,6 +269,173 @@ static inline unsigned int get_req_xfer_word_count(
 		return req->size >> 2;
 }
 
+/* The request is programmed into the channel; called with ch->lock held */
+static void tegra_dma_req_started(struct tegra_dma_channel *ch,
+	struct tegra_dma_req *req)
+{
+	s64 us;
+
+	if (req->status == TEGRA_DMA_REQ_INFLIGHT)
+		return;
+	req->status = TEGRA_DMA_REQ_INFLIGHT;
+
+	us = ktime_us_delta(ktime_get(), req->queued);
+	if (us < 0)
+		us = 0;
+	ch->starts++;
+	ch->start_us_total += us;
+	ch->start_us_max = max_t(u32, ch->start_us_max, us);
+}
+
+/*
+ * Chained mode: the channel runs as continuous single buffer, and the block
+ * after the running one is prefetched into the shadow registers so that
+ * the controller moves on to it without waiting for the interrupt. CSR_ONCE
+ * is kept set while nothing is prefetched, so the channel stops after the
+ * last queued block instead of running it again. With coalescing, requests
+ * that continue one another in memory are prefetched as one block and
+ * complete on one interrupt.
+ */
+static bool chain_mergeable(struct tegra_dma_req *a, struct tegra_dma_req *b)
+{
+	unsigned long a_ahb = a->to_memory ? a->dest_addr : a->source_addr;
+	unsigned long b_ahb = b->to_memory ? b->dest_addr : b->source_addr;
+	unsigned long ahb_wrap = a->to_memory ? a->dest_wrap : a->source_wrap;
+	unsigned long apb_wrap = a->to_memory ? a->source_wrap : a->dest_wrap;
+
+	if (a->to_memory != b->to_memory || a->req_sel != b->req_sel ||
+	    a->use_smmu != b->use_smmu ||
+	    a->source_wrap != b->source_wrap || a->dest_wrap != b->dest_wrap ||
+	    a->source_bus_width != b->source_bus_width ||
+	    a->dest_bus_width != b->dest_bus_width)
+		return false;
+
+	/* one FIFO on the APB side, one run of memory on the AHB side */
+	if (ahb_wrap || !apb_wrap)
+		return false;
+	if (a->to_memory ? a->source_addr != b->source_addr :
+			   a->dest_addr != b->dest_addr)
+		return false;
+	return a_ahb + a->size == b_ahb;
+}
+
+static void chain_set_once(struct tegra_dma_channel *ch, bool once)
+{
+	u32 csr = readl(ch->addr + APB_DMA_CHAN_CSR);
+
+	if (once)
+		csr |= CSR_ONCE;
+	else
+		csr &= ~CSR_ONCE;
+	writel(csr, ch->addr + APB_DMA_CHAN_CSR);
+}
+
+/* Prefetch the block after the running one; called with ch->lock held */
+static void chain_prefetch(struct tegra_dma_channel *ch)
+{
+	struct tegra_dma_req *req, *first = NULL, *last = NULL;
+	unsigned int words = 0;
+	int i = 0, nr = 0;
+
+	list_for_each_entry(req, &ch->list, node) {
+		if (i++ < ch->run_nr)
+			continue;
+		if (first && (!(ch->mode & TEGRA_DMA_MODE_COALESCE) ||
+			      !chain_mergeable(last, req) ||
+			      ((words + (req->size >> 2)) << 2) >
+			      TEGRA_DMA_MAX_TRANSFER_SIZE))
+			break;
+		if (!first)
+			first = req;
+		words += req->size >> 2;
+		last = req;
+		nr++;
+	}
+
+	if (!first) {
+		chain_set_once(ch, true);
+		return;
+	}
+
+	if (!__tegra_dma_update_hw_partial(ch, first, words))
+		return;
+
+	ch->next_nr = nr;
+	req = first;
+	list_for_each_entry_from(req, &ch->list, node) {
+		if (!nr--)
+			break;
+		tegra_dma_req_started(ch, req);
+	}
+}
+
+static void chain_start(struct tegra_dma_channel *ch)
+{
+	struct tegra_dma_req *req;
+
+	list_for_each_entry(req, &ch->list, node)
+		req->status = TEGRA_DMA_REQ_PENDING;
+
+	ch->run_nr = 0;
+	ch->next_nr = 0;
+	if (list_empty(&ch->list))
+		return;
+
+	req = list_entry(ch->list.next, typeof(*req), node);
+	tegra_dma_update_hw(ch, req);
+	ch->run_nr = 1;
+	chain_prefetch(ch);
+}
+
+/* Bytes done by the running block */
+static unsigned int chain_run_bytes(struct tegra_dma_channel *ch,
+	unsigned int status)
+{
+	struct tegra_dma_req *req;
+	unsigned int words = 0, left;
+	int i = 0;
+
+	list_for_each_entry(req, &ch->list, node) {
+		if (i++ == ch->run_nr)
+			break;
+		words += req->size >> 2;
+	}
+
+	if ((status & STA_BUSY) && !(status & STA_ISE_EOC)) {
+		left = ((status & STA_COUNT_MASK) >> STA_COUNT_SHIFT) + 1;
+		words -= min(words, left);
+	}
+	return words << 2;
+}
+
+/* Spread the progress of the running block over its requests */
+static void chain_account(struct tegra_dma_channel *ch, unsigned int status)
+{
+	struct tegra_dma_req *req;
+	unsigned int done = chain_run_bytes(ch, status);
+	int i = 0;
+
+	list_for_each_entry(req, &ch->list, node) {
+		if (i++ == ch->run_nr)
+			break;
+		req->bytes_transferred = min(done, req->size);
+		done -= req->bytes_transferred;
+	}
+}
+
+/* Call the callbacks of completed requests; without any lock held */
+static void tegra_dma_complete_done(struct list_head *done)
+{
+	struct tegra_dma_req *req;
+
+	while (!list_empty(done)) {
+		req = list_entry(done->next, typeof(*req), node);
+		list_del(&req->node);
+		if (req->complete)
+			req->complete(req);
+	}
+}
+
 static int get_current_xferred_count(struct tegra_dma_channel *ch,
 	struct tegra_dma_req *req, unsigned long status)
 {
@@ -378,6 +562,56 @@ static unsigned int dma_active_count(struct tegra_dma_channel *ch,
 	return bytes_transferred;
 }
 
+/*
+ * In chained mode a request may share its block with the ones before it:
+ * dequeuing one that is in flight stops the channel and aborts it along
+ * with the requests queued before it.
+ */
+static int tegra_dma_dequeue_chained(struct tegra_dma_channel *ch,
+	struct tegra_dma_req *_req)
+{
+	struct tegra_dma_req *req, *tmp;
+	unsigned long irq_flags;
+	unsigned int status;
+	LIST_HEAD(aborted);
+	int found = 0;
+
+	spin_lock_irqsave(&ch->lock, irq_flags);
+
+	list_for_each_entry(req, &ch->list, node) {
+		if (req == _req) {
+			found = 1;
+			break;
+		}
+	}
+	if (!found) {
+		spin_unlock_irqrestore(&ch->lock, irq_flags);
+		return -ENOENT;
+	}
+
+	if (_req->status != TEGRA_DMA_REQ_INFLIGHT) {
+		list_move_tail(&_req->node, &aborted);
+	} else {
+		status = get_channel_status(ch, _req, true);
+		chain_account(ch, status);
+		list_for_each_entry_safe(req, tmp, &ch->list, node) {
+			list_move_tail(&req->node, &aborted);
+			if (req == _req)
+				break;
+		}
+		chain_start(ch);
+	}
+
+	list_for_each_entry(req, &aborted, node)
+		req->status = -TEGRA_DMA_REQ_ERROR_ABORTED;
+
+	spin_unlock_irqrestore(&ch->lock, irq_flags);
+
+	/* Callback should be called without any lock */
+	tegra_dma_complete_done(&aborted);
+	return 0;
+}
+
 int tegra_dma_dequeue_req(struct tegra_dma_channel *ch,
 	struct tegra_dma_req *_req)
 {
@@ -387,6 +621,9 @@ int tegra_dma_dequeue_req(struct tegra_dma_channel *ch,
 	unsigned long irq_flags;
 	int stop = 0;
 
+	if (ch->mode & TEGRA_DMA_MODE_CHAINED)
+		return tegra_dma_dequeue_chained(ch, _req);
+
 	spin_lock_irqsave(&ch->lock, irq_flags);
 
 	if (list_entry(ch->list.next, struct tegra_dma_req, node) == _req)
@@ -438,6 +675,7 @@ int tegra_dma_cancel(struct tegra_dma_channel *ch)
 	struct tegra_dma_req *cb_req = NULL;
 	dma_callback callback = NULL;
 	struct list_head new_list;
+	LIST_HEAD(done);
 
 	INIT_LIST_HEAD(&new_list);
 
@@ -469,12 +707,19 @@ int tegra_dma_cancel(struct tegra_dma_channel *ch)
 		status = readl(ch->addr + APB_DMA_CHAN_STA);
 	}
 
+	list_splice_init(&ch->done, &done);
+
 	/* Abort head requests, stop dma and dequeue all requests */
 	if (!list_empty(&ch->list)) {
 		tegra_dma_stop(ch);
 		hreq = list_entry(ch->list.next, typeof(*hreq), node);
-		hreq->bytes_transferred +=
+		if (ch->mode & TEGRA_DMA_MODE_CHAINED)
+			chain_account(ch, status);
+		else
+			hreq->bytes_transferred +=
 				get_current_xferred_count(ch, hreq, status);
+		ch->run_nr = 0;
+		ch->next_nr = 0;
 
 		/* copy the list into new list. */
 		list_replace_init(&ch->list, &new_list);
@@ -488,6 +733,7 @@ int tegra_dma_cancel(struct tegra_dma_channel *ch)
 	/* Call callback if it is due from interrupts */
 	if (callback)
 		callback(cb_req);
+	tegra_dma_complete_done(&done);
 
 	/* Abort all requests on list. */
 	while (!list_empty(&new_list)) {
@@ -558,7 +804,10 @@ int tegra_dma_get_transfer_count(struct tegra_dma_channel *ch,
 	}
 
 	status = get_channel_status(ch, req, false);
-	bytes_transferred = dma_active_count(ch, req, status);
+	if (ch->mode & TEGRA_DMA_MODE_CHAINED)
+		bytes_transferred = min(chain_run_bytes(ch, status), req->size);
+	else
+		bytes_transferred = dma_active_count(ch, req, status);
 	spin_unlock_irqrestore(&ch->lock, irq_flags);
 	return bytes_transferred;
 }
@@ -597,6 +846,7 @@ int tegra_dma_enqueue_req(struct tegra_dma_channel *ch,
 
 	req->bytes_transferred = 0;
 	req->status = TEGRA_DMA_REQ_PENDING;
+	req->queued = ktime_get();
 	/* STATUS_EMPTY just means the DMA hasn't processed the buf yet. */
 	req->buffer_status = TEGRA_DMA_REQ_BUF_STATUS_EMPTY;
 	if (list_empty(&ch->list))
@@ -604,7 +854,12 @@ int tegra_dma_enqueue_req(struct tegra_dma_channel *ch,
 
 	list_add_tail(&req->node, &ch->list);
 
-	if (start_dma) {
+	if (ch->mode & TEGRA_DMA_MODE_CHAINED) {
+		if (start_dma)
+			chain_start(ch);
+		else if (!ch->next_nr)
+			chain_prefetch(ch);
+	} else if (start_dma) {
 		tegra_dma_update_hw(ch, req);
 	} else {
 		/*
@@ -639,11 +894,43 @@ static void tegra_dma_dump_channel_usage(void)
 	pr_info("DMA channel allocation dump:\n");
 	for (i = TEGRA_SYSTEM_DMA_CH_MIN; i <= TEGRA_SYSTEM_DMA_CH_MAX; i++) {
 		struct tegra_dma_channel *ch = &dma_channels[i];
-		pr_warn("dma %d used by %s\n", i, ch->client_name);
+		pr_warn("dma %d used by %s%s\n", i, ch->client_name,
+			(ch->mode & TEGRA_DMA_PRIO_HIGH) ? " (high)" : "");
 	}
+	pr_warn("%u channels reserved for high priority\n",
+		reserved_channels);
 	return;
 }
 
+/* Called with tegra_dma_lock held */
+static unsigned int tegra_dma_free_channels(void)
+{
+	return TEGRA_SYSTEM_DMA_CH_MAX + 1 - TEGRA_SYSTEM_DMA_CH_MIN -
+		bitmap_weight(channel_usage, TEGRA_SYSTEM_DMA_CH_MAX + 1);
+}
+
+int tegra_dma_reserve_channels(unsigned int nr)
+{
+	int ret = 0;
+
+	mutex_lock(&tegra_dma_lock);
+	if (tegra_dma_free_channels() < reserved_channels + nr)
+		ret = -EBUSY;
+	else
+		reserved_channels += nr;
+	mutex_unlock(&tegra_dma_lock);
+	return ret;
+}
+EXPORT_SYMBOL(tegra_dma_reserve_channels);
+
+void tegra_dma_unreserve_channels(unsigned int nr)
+{
+	mutex_lock(&tegra_dma_lock);
+	reserved_channels -= min(nr, reserved_channels);
+	mutex_unlock(&tegra_dma_lock);
+}
+EXPORT_SYMBOL(tegra_dma_unreserve_channels);
+
 struct tegra_dma_channel *tegra_dma_allocate_channel(int mode,
 		const char namefmt[], ...)
 {
@@ -661,6 +948,12 @@ struct tegra_dma_channel *tegra_dma_allocate_channel(int mode,
 	if (mode & TEGRA_DMA_SHARED) {
 		channel = TEGRA_SYSTEM_DMA_CH_MIN;
 	} else {
+		if (!(mode & TEGRA_DMA_PRIO_HIGH) &&
+		    tegra_dma_free_channels() <= reserved_channels) {
+			pr_warn("DMA channels left are reserved\n");
+			tegra_dma_dump_channel_usage();
+			goto out;
+		}
 		channel = find_first_zero_bit(channel_usage,
 			ARRAY_SIZE(dma_channels));
 		if (channel >= ARRAY_SIZE(dma_channels)) {
@@ -669,7 +962,9 @@ struct tegra_dma_channel *tegra_dma_allocate_channel(int mode,
 		}
 	}
 
-	if (mode & TEGRA_DMA_MODE_ONESHOT)
+	if (mode & TEGRA_DMA_MODE_CHAINED)
+		isr_handler = handle_chained_dma;
+	else if (mode & TEGRA_DMA_MODE_ONESHOT)
 		isr_handler = handle_oneshot_dma;
 	else if (mode & TEGRA_DMA_MODE_CONTINUOUS_DOUBLE)
 		isr_handler = handle_continuous_dbl_dma;
@@ -686,6 +981,11 @@ struct tegra_dma_channel *tegra_dma_allocate_channel(int mode,
 	ch->mode = mode;
 	ch->isr_handler = isr_handler;
 	ch->dma_is_paused = false;
+	ch->run_nr = 0;
+	ch->next_nr = 0;
+	ch->starts = 0;
+	ch->start_us_total = 0;
+	ch->start_us_max = 0;
 	va_start(args, namefmt);
 	vsnprintf(ch->client_name, sizeof(ch->client_name),
 		namefmt, args);
@@ -720,6 +1020,13 @@ EXPORT_SYMBOL(tegra_dma_get_channel_id);
 
 static bool tegra_dma_update_hw_partial(struct tegra_dma_channel *ch,
 	struct tegra_dma_req *req)
+{
+	return __tegra_dma_update_hw_partial(ch, req,
+					     get_req_xfer_word_count(ch, req));
+}
+
+static bool __tegra_dma_update_hw_partial(struct tegra_dma_channel *ch,
+	struct tegra_dma_req *req, unsigned int req_transfer_count)
 {
 	u32 apb_ptr;
 	u32 ahb_ptr;
@@ -728,7 +1035,6 @@ static bool tegra_dma_update_hw_partial(struct tegra_dma_channel *ch,
 	u32 swid;
 #endif
 	unsigned long status;
-	unsigned int req_transfer_count;
 	bool configure = false;
 
 	if (req->to_memory) {
@@ -778,12 +1084,13 @@ static bool tegra_dma_update_hw_partial(struct tegra_dma_channel *ch,
 	writel(apb_ptr, ch->addr + APB_DMA_CHAN_APB_PTR);
 	writel(ahb_ptr, ch->addr + APB_DMA_CHAN_AHB_PTR);
 
-	req_transfer_count = get_req_xfer_word_count(ch, req);
 	csr = readl(ch->addr + APB_DMA_CHAN_CSR);
 	csr &= ~CSR_WCOUNT_MASK;
 	csr |= (req_transfer_count - 1) << CSR_WCOUNT_SHIFT;
+	if (ch->mode & TEGRA_DMA_MODE_CHAINED)
+		csr &= ~CSR_ONCE;
 	writel(csr, ch->addr + APB_DMA_CHAN_CSR);
-	req->status = TEGRA_DMA_REQ_INFLIGHT;
+	tegra_dma_req_started(ch, req);
 	configure = true;
 
 exit_config:
@@ -812,7 +1119,8 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 #endif
 
 	csr = CSR_FLOW;
-	if (req->complete || req->threshold)
+	if (req->complete || req->threshold ||
+	    (ch->mode & TEGRA_DMA_MODE_CHAINED))
 		csr |= CSR_IE_EOC;
 
 	ahb_seq = AHB_SEQ_INTR_ENB;
@@ -880,9 +1188,10 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 	req_transfer_count = get_req_xfer_word_count(ch, req);
 
 	/* One shot mode is always single buffered.  Continuous mode could
-	 * support either.
+	 * support either. Chained mode runs once until a next block is
+	 * prefetched.
 	 */
-	if (ch->mode & TEGRA_DMA_MODE_ONESHOT)
+	if (ch->mode & (TEGRA_DMA_MODE_ONESHOT | TEGRA_DMA_MODE_CHAINED))
 		csr |= CSR_ONCE;
 
 	if (ch->mode & TEGRA_DMA_MODE_CONTINUOUS_DOUBLE)
@@ -968,7 +1277,7 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 	csr |= CSR_ENB;
 	writel(csr, ch->addr + APB_DMA_CHAN_CSR);
 
-	req->status = TEGRA_DMA_REQ_INFLIGHT;
+	tegra_dma_req_started(ch, req);
 }
 
 static void handle_oneshot_dma(struct tegra_dma_channel *ch)
@@ -987,6 +1296,44 @@ static void handle_oneshot_dma(struct tegra_dma_channel *ch)
 	return;
 }
 
+static void handle_chained_dma(struct tegra_dma_channel *ch)
+{
+	struct tegra_dma_req *req;
+	unsigned long status;
+
+	/* The running block is done */
+	while (ch->run_nr && !list_empty(&ch->list)) {
+		req = list_entry(ch->list.next, typeof(*req), node);
+		req->bytes_transferred += req->size;
+		req->buffer_status = TEGRA_DMA_REQ_BUF_STATUS_FULL;
+		req->status = TEGRA_DMA_REQ_SUCCESS;
+		list_move_tail(&req->node, &ch->done);
+		ch->run_nr--;
+	}
+	ch->run_nr = ch->next_nr;
+	ch->next_nr = 0;
+
+	if (list_empty(&ch->list)) {
+		tegra_dma_stop(ch);
+		return;
+	}
+
+	/* The prefetched block is running: line up the one after it */
+	status = readl(ch->addr + APB_DMA_CHAN_STA);
+	if (ch->run_nr && (status & STA_BUSY)) {
+		chain_prefetch(ch);
+		return;
+	}
+
+	/* It is done too; the next interrupt completes it */
+	if (ch->run_nr && (status & STA_ISE_EOC))
+		return;
+
+	/* Nothing was prefetched in time and the channel stopped */
+	tegra_dma_stop(ch);
+	chain_start(ch);
+}
+
 static void handle_continuous_dbl_dma(struct tegra_dma_channel *ch)
 {
 	struct tegra_dma_req *req;
@@ -1102,6 +1449,7 @@ static irqreturn_t dma_isr(int irq, void *data)
 	unsigned long status;
 	dma_callback callback = NULL;
 	struct tegra_dma_req *cb_req = NULL;
+	LIST_HEAD(done);
 
 	spin_lock_irqsave(&ch->lock, irq_flags);
 
@@ -1124,6 +1472,7 @@ static irqreturn_t dma_isr(int irq, void *data)
 		cb_req = ch->cb_req;
 		ch->callback = NULL;
 		ch->cb_req = NULL;
+		list_splice_init(&ch->done, &done);
 	} else {
 		pr_info("Interrupt is already handled %d\n", ch->id);
 	}
@@ -1132,6 +1481,7 @@ static irqreturn_t dma_isr(int irq, void *data)
 	/* Call callback function to notify client if it is there */
 	if (callback)
 		callback(cb_req);
+	tegra_dma_complete_done(&done);
 	return IRQ_HANDLED;
 }
 #endif
@@ -1187,6 +1537,7 @@ int __init tegra_dma_init(void)
 
 		spin_lock_init(&ch->lock);
 		INIT_LIST_HEAD(&ch->list);
+		INIT_LIST_HEAD(&ch->done);
 
 #ifndef CONFIG_ARCH_TEGRA_2x_SOC
 		if (i >= 16)
@@ -1322,12 +1673,24 @@ static int dbg_dma_show(struct seq_file *s, void *unused)
 					__raw_readl(addr + 0x18),
 					__raw_readl(addr + 0x1C));
 	}
-	seq_printf(s, "\nAPB DMA users\n");
+	seq_printf(s, "\nAPB DMA users (%u channels reserved)\n",
+		   reserved_channels);
 	seq_printf(s, "-------------\n");
+	seq_printf(s, "%-24s %4s %10s %8s %8s\n", "", "prio", "starts",
+		   "avg us", "max us");
 	for (i = TEGRA_SYSTEM_DMA_CH_MIN; i <= TEGRA_SYSTEM_DMA_CH_MAX; i++) {
 		struct tegra_dma_channel *ch = &dma_channels[i];
-		if (strlen(ch->client_name) > 0)
-			seq_printf(s, "dma %d -> %s\n", i, ch->client_name);
+		char name[24];
+
+		if (!strlen(ch->client_name))
+			continue;
+		snprintf(name, sizeof(name), "dma %d -> %s", i,
+			 ch->client_name);
+		seq_printf(s, "%-24s %4s %10u %8llu %8u\n", name,
+			   (ch->mode & TEGRA_DMA_PRIO_HIGH) ? "high" : "-",
+			   ch->starts, ch->starts ?
+			   div_u64(ch->start_us_total, ch->starts) : 0,
+			   ch->start_us_max);
 	}
 	return 0;
 }
@@ -32,9 +32,12 @@
 #include <linux/suspend.h>
 #include <linux/delay.h>
 #include <linux/reboot.h>
+#include <linux/workqueue.h>
 
 #include <mach/clk.h>
 
+#include <trace/events/nvpower.h>
+
 #include "board.h"
 #include "clock.h"
 #include "dvfs.h"
@@ -49,6 +52,23 @@ static LIST_HEAD(dvfs_rail_list);
 static DEFINE_MUTEX(dvfs_lock);
 static DEFINE_MUTEX(rail_disable_lock);
 
+/*
+ * Rate changes that lower rail voltage do not wait for the regulator: the
+ * lower target is left pending, and all pending rails are solved and
+ * programmed together dvfs_batch_ms after the first of them was deferred.
+ * A burst of rate changes thus costs one regulator transaction per rail
+ * rather than one per change, and the clock setters do not wait on the
+ * regulator to go down. Voltage increases are still applied synchronously,
+ * since the new rate must not run before its voltage is reached.
+ */
+#define DVFS_BATCH_DEFAULT_MS	10
+
+static u32 dvfs_batch_ms = DVFS_BATCH_DEFAULT_MS;
+static bool dvfs_batch_down;
+
+static void dvfs_rail_batch_work_func(struct work_struct *work);
+static DECLARE_DELAYED_WORK(dvfs_rail_batch_work, dvfs_rail_batch_work_func);
+
 static int dvfs_rail_update(struct dvfs_rail *rail);
 
 static inline int tegra_dvfs_rail_get_disable_level(struct dvfs_rail *rail)
@@ -121,6 +141,15 @@ static int dvfs_solve_relationship(struct dvfs_relationship *rel)
 	return rel->solve(rel->from, rel->to);
 }
 
+static inline int dvfs_rail_stats_1mv_slot(struct dvfs_rail *rail,
+					   int millivolts)
+{
+	if (millivolts <= 0)
+		return 0;
+	return clamp(1 + millivolts - rail->min_millivolts,
+		     1, rail->stats.num_1mv - 1);
+}
+
 /* rail statistic - called during rail init, or under dfs_lock, or with
    CPU0 only on-line, and interrupts disabled */
 static void dvfs_rail_stats_init(struct dvfs_rail *rail, int millivolts)
@@ -145,14 +174,32 @@ static void dvfs_rail_stats_init(struct dvfs_rail *rail, int millivolts)
 		pr_warn("tegra_dvfs: %s: stats above %d mV will be squashed\n",
 			rail->reg_id,
 			rail->min_millivolts + dvfs_rail_stats_range);
+
+	/* 1mV residency is allocated once, on the first connection */
+	if (!rail->stats.time_at_1mv &&
+	    (rail->max_millivolts >= rail->min_millivolts)) {
+		int n = rail->max_millivolts - rail->min_millivolts + 2;
+		rail->stats.time_at_1mv = kzalloc(n * sizeof(ktime_t),
+						  GFP_KERNEL);
+		if (rail->stats.time_at_1mv)
+			rail->stats.num_1mv = n;
+	}
+	if (rail->stats.num_1mv)
+		rail->stats.last_1mv =
+			dvfs_rail_stats_1mv_slot(rail, millivolts);
+	rail->stats.holder_since = rail->stats.last_update;
 }
 
 static void dvfs_rail_stats_update(
 	struct dvfs_rail *rail, int millivolts, ktime_t now)
 {
+	ktime_t delta = ktime_sub(now, rail->stats.last_update);
+
 	rail->stats.time_at_mv[rail->stats.last_index] = ktime_add(
-		rail->stats.time_at_mv[rail->stats.last_index], ktime_sub(
-			now, rail->stats.last_update));
+		rail->stats.time_at_mv[rail->stats.last_index], delta);
+	if (rail->stats.num_1mv)
+		rail->stats.time_at_1mv[rail->stats.last_1mv] = ktime_add(
+			rail->stats.time_at_1mv[rail->stats.last_1mv], delta);
 	rail->stats.last_update = now;
 
 	if (rail->stats.off)
@@ -162,8 +209,13 @@ static void dvfs_rail_stats_update(
 		int i = 1 + (2 * (millivolts - rail->min_millivolts) * 1000 +
 			     rail->stats.bin_uV) / (2 * rail->stats.bin_uV);
 		rail->stats.last_index = min(i, DVFS_RAIL_STATS_TOP_BIN);
-	} else if (millivolts == 0)
-			rail->stats.last_index = 0;
+		if (rail->stats.num_1mv)
+			rail->stats.last_1mv =
+				dvfs_rail_stats_1mv_slot(rail, millivolts);
+	} else if (millivolts == 0) {
+		rail->stats.last_index = 0;
+		rail->stats.last_1mv = 0;
+	}
 }
 
 static void dvfs_rail_stats_pause(struct dvfs_rail *rail,
@@ -171,6 +223,35 @@ static void dvfs_rail_stats_pause(struct dvfs_rail *rail,
 {
 	int i = on ? rail->stats.last_index : 0;
 	rail->stats.time_at_mv[i] = ktime_add(rail->stats.time_at_mv[i], delta);
+
+	if (rail->stats.num_1mv) {
+		i = on ? rail->stats.last_1mv : 0;
+		rail->stats.time_at_1mv[i] =
+			ktime_add(rail->stats.time_at_1mv[i], delta);
+	}
+}
+
+/*
+ * Charge the time since the last change to the clock that held the rail,
+ * and make the clock with the highest request (if any) the new holder.
+ * Called under dvfs_lock.
+ */
+static void dvfs_rail_stats_holder(struct dvfs_rail *rail, ktime_t now)
+{
+	struct dvfs *d, *holder = NULL;
+
+	list_for_each_entry(d, &rail->dvfs, reg_node) {
+		if (d->cur_millivolts &&
+		    (!holder || (d->cur_millivolts > holder->cur_millivolts)))
+			holder = d;
+	}
+
+	if (rail->stats.holder)
+		rail->stats.holder->hold_time = ktime_add(
+			rail->stats.holder->hold_time,
+			ktime_sub(now, rail->stats.holder_since));
+	rail->stats.holder = holder;
+	rail->stats.holder_since = now;
 }
 
 void tegra_dvfs_rail_off(struct dvfs_rail *rail, ktime_t now)
@@ -199,15 +280,26 @@ static int dvfs_rail_set_voltage_reg(struct dvfs_rail *rail, int millivolts)
 {
 	int ret;
 
+	ktime_t start, delta;
+
 	rail->updating = true;
 	rail->reg_max_millivolts = rail->reg_max_millivolts ==
 		rail->max_millivolts ?
 		rail->max_millivolts + 1 : rail->max_millivolts;
+	start = ktime_get();
 	ret = regulator_set_voltage(rail->reg,
 		millivolts * 1000,
 		rail->reg_max_millivolts * 1000);
+	delta = ktime_sub(ktime_get(), start);
 	rail->updating = false;
 
+	rail->stats.reg_writes++;
+	if (ret)
+		rail->stats.reg_errors++;
+	rail->stats.reg_time = ktime_add(rail->stats.reg_time, delta);
+	if (ktime_to_ns(delta) > ktime_to_ns(rail->stats.reg_time_max))
+		rail->stats.reg_time_max = delta;
+
 	return ret;
 }
 
@@ -273,6 +365,10 @@ static int dvfs_rail_set_voltage(struct dvfs_rail *rail, int millivolts)
 			goto out;
 		}
 
+		/* regulator_set_voltage() returns after the ramp delay */
+		if (rail == tegra_cpu_rail)
+			trace_nvcpu_voltage(rail->millivolts,
+					    rail->new_millivolts);
 		rail->millivolts = rail->new_millivolts;
 		dvfs_rail_stats_update(rail, rail->millivolts, ktime_get());
 
@@ -346,6 +442,7 @@ static int dvfs_rail_update(struct dvfs_rail *rail)
 	/* Find the maximum voltage requested by any clock */
 	list_for_each_entry(d, &rail->dvfs, reg_node)
 		millivolts = max(d->cur_millivolts, millivolts);
+	dvfs_rail_stats_holder(rail, ktime_get());
 
 	/* Apply offset and min/max limits if any clock is requesting voltage */
 	if (millivolts)
@@ -364,12 +461,56 @@ static int dvfs_rail_update(struct dvfs_rail *rail)
 		if (rail->new_millivolts == rail->millivolts)
 			break;
 
+		if (dvfs_batch_down && !rail->dfll_mode &&
+		    (rail->new_millivolts < rail->millivolts)) {
+			rail->down_pending = true;
+			rail->down_deferred++;
+			schedule_delayed_work(&dvfs_rail_batch_work,
+					      msecs_to_jiffies(dvfs_batch_ms));
+			break;
+		}
+
 		ret = dvfs_rail_set_voltage(rail, rail->new_millivolts);
 	}
 
 	return ret;
 }
 
+/* Rate change path: defer voltage decreases to the batch work (see above) */
+static int dvfs_rail_update_batched(struct dvfs_rail *rail)
+{
+	int ret;
+
+	if (!dvfs_batch_ms)
+		return dvfs_rail_update(rail);
+
+	dvfs_batch_down = true;
+	ret = dvfs_rail_update(rail);
+	dvfs_batch_down = false;
+
+	return ret;
+}
+
+static void dvfs_rail_batch_work_func(struct work_struct *work)
+{
+	struct dvfs_rail *rail;
+
+	mutex_lock(&dvfs_lock);
+
+	list_for_each_entry(rail, &dvfs_rail_list, node) {
+		if (!rail->down_pending)
+			continue;
+
+		rail->down_pending = false;
+		rail->down_batched++;
+		if (dvfs_rail_update(rail))
+			pr_err("tegra_dvfs: failed to lower %s\n",
+			       rail->reg_id);
+	}
+
+	mutex_unlock(&dvfs_lock);
+}
+
 static int dvfs_rail_connect_to_regulator(struct dvfs_rail *rail)
 {
 	struct regulator *reg;
@@ -484,8 +625,10 @@ __tegra_dvfs_set_rate(struct dvfs *d, unsigned long rate)
 	}
 
 	d->cur_rate = rate;
+	if (d->dvfs_rail->reg && (d->cur_millivolts > d->dvfs_rail->millivolts))
+		d->raise_count++;
 
-	ret = dvfs_rail_update(d->dvfs_rail);
+	ret = dvfs_rail_update_batched(d->dvfs_rail);
 	if (ret)
 		pr_err("Failed to set regulator %s for clock %s to %d mV\n",
 			d->dvfs_rail->reg_id, d->clk_name, d->cur_millivolts);
@@ -776,6 +919,7 @@ static int tegra_dvfs_suspend(void)
 {
 	int ret = 0;
 
+	flush_delayed_work_sync(&dvfs_rail_batch_work);
 	mutex_lock(&dvfs_lock);
 
 	while (!tegra_dvfs_all_rails_suspended()) {
@@ -1075,6 +1219,19 @@ static void tegra_dvfs_rail_register_pll_mode_cdev(struct dvfs_rail *rail)
 #define tegra_dvfs_rail_register_pll_mode_cdev(rail)
 #endif
 
+/* Cold temperature floor for the given rate */
+int tegra_dvfs_rail_get_cold_floor(struct dvfs_rail *rail, unsigned long rate)
+{
+	int i;
+
+	for (i = 0; i < rail->cold_floors_num; i++)
+		if (rate <= rail->cold_floors[i].rate)
+			return min(rail->cold_floors[i].millivolts,
+				   rail->min_millivolts_cold);
+
+	return rail->min_millivolts_cold;
+}
+
 /* Directly set cold temperature limit in dfll mode */
 int tegra_dvfs_rail_dfll_mode_set_cold(struct dvfs_rail *rail)
 {
@@ -1217,6 +1374,9 @@ static int dvfs_tree_show(struct seq_file *s, void *data)
 				dvfs_solve_relationship(rel));
 		}
 		seq_printf(s, "   offset     %-7d mV\n", rail->offs_millivolts);
+		seq_printf(s, "   batched    %-7u of   %u deferred%s\n",
+			   rail->down_batched, rail->down_deferred,
+			   rail->down_pending ? ", pending" : "");
 
 		if (rail == tegra_core_rail) {
 			seq_printf(s, "   override   %-7d mV [%-4d...%-4d]\n",
@@ -1276,6 +1436,64 @@ static const struct file_operations rail_stats_fops = {
 	.release	= single_release,
 };
 
+/*
+ * Machine readable rail residency, one record per line:
+ *   rail <name> <mV now>
+ *   resid <mV> <us>		(0 mV: rail off)
+ *   reg <writes> <errors> <total us> <max us>
+ *   holder <clock> <us holding the rail> <raises>
+ */
+static int rail_residency_show(struct seq_file *s, void *data)
+{
+	int i;
+	ktime_t now;
+	struct dvfs *d;
+	struct dvfs_rail *rail;
+	struct rail_stats *st;
+
+	mutex_lock(&dvfs_lock);
+
+	list_for_each_entry(rail, &dvfs_rail_list, node) {
+		st = &rail->stats;
+		now = ktime_get();
+		dvfs_rail_stats_update(rail, -1, now);
+		dvfs_rail_stats_holder(rail, now);
+
+		seq_printf(s, "rail %s %d\n", rail->reg_id, rail->millivolts);
+		for (i = 0; i < st->num_1mv; i++) {
+			if (!ktime_to_us(st->time_at_1mv[i]))
+				continue;
+			seq_printf(s, "resid %d %lld\n",
+				   i ? rail->min_millivolts + i - 1 : 0,
+				   ktime_to_us(st->time_at_1mv[i]));
+		}
+		seq_printf(s, "reg %u %u %lld %lld\n", st->reg_writes,
+			   st->reg_errors, ktime_to_us(st->reg_time),
+			   ktime_to_us(st->reg_time_max));
+		list_for_each_entry(d, &rail->dvfs, reg_node) {
+			if (!ktime_to_us(d->hold_time) && !d->raise_count)
+				continue;
+			seq_printf(s, "holder %s %lld %u\n", d->clk_name,
+				   ktime_to_us(d->hold_time), d->raise_count);
+		}
+	}
+
+	mutex_unlock(&dvfs_lock);
+	return 0;
+}
+
+static int rail_residency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rail_residency_show, inode->i_private);
+}
+
+static const struct file_operations rail_residency_fops = {
+	.open		= rail_residency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int cpu_offs_get(void *data, u64 *val)
 {
 	if (tegra_cpu_rail) {
@@ -1350,6 +1568,11 @@ int __init dvfs_debugfs_init(struct dentry *clk_debugfs_root)
 	if (!d)
 		return -ENOMEM;
 
+	d = debugfs_create_file("rail_residency", S_IRUGO, clk_debugfs_root,
+		NULL, &rail_residency_fops);
+	if (!d)
+		return -ENOMEM;
+
 	d = debugfs_create_file("vdd_cpu_offs", S_IRUGO | S_IWUSR,
 		clk_debugfs_root, NULL, &cpu_offs_fops);
 	if (!d)
@@ -1365,6 +1588,11 @@ int __init dvfs_debugfs_init(struct dentry *clk_debugfs_root)
 	if (!d)
 		return -ENOMEM;
 
+	d = debugfs_create_u32("dvfs_batch_ms", S_IRUGO | S_IWUSR,
+		clk_debugfs_root, &dvfs_batch_ms);
+	if (!d)
+		return -ENOMEM;
+
 	return 0;
 }
 
@@ -54,6 +54,31 @@ struct rail_stats {
 	int last_index;
 	bool off;
 	int bin_uV;
+
+	/* 1mV residency: [0] off, [1 + mv - min_millivolts] on */
+	ktime_t *time_at_1mv;
+	int num_1mv;
+	int last_1mv;
+
+	/* regulator transactions */
+	unsigned int reg_writes;
+	unsigned int reg_errors;
+	ktime_t reg_time;
+	ktime_t reg_time_max;
+
+	/* clock holding the rail at its current level */
+	struct dvfs *holder;
+	ktime_t holder_since;
+};
+
+/*
+ * Cold floor for rates up to .rate (Hz); a table in ascending rate order
+ * lets low rates that are robust at cold get away with less than the
+ * rail-wide min_millivolts_cold, which still covers any rate above it.
+ */
+struct dvfs_cold_floor {
+	unsigned long rate;
+	int millivolts;
 };
 
 struct dvfs_rail {
@@ -63,6 +88,8 @@ struct dvfs_rail {
 	int reg_max_millivolts;
 	int nominal_millivolts;
 	int min_millivolts_cold;
+	const struct dvfs_cold_floor *cold_floors;
+	int cold_floors_num;
 	int override_millivolts;
 	int min_override_millivolts;
 	int step;
@@ -70,6 +97,9 @@ struct dvfs_rail {
 	bool disabled;
 	bool updating;
 	bool resolving_to;
+	bool down_pending;
+	unsigned int down_deferred;
+	unsigned int down_batched;
 
 	struct list_head node;  /* node in dvfs_rail_list */
 	struct list_head dvfs;  /* list head of attached dvfs clocks */
@@ -133,6 +163,8 @@ struct dvfs {
 
 	int cur_millivolts;
 	unsigned long cur_rate;
+	ktime_t hold_time;		/* time spent holding the rail */
+	unsigned int raise_count;	/* rate changes that raised the rail */
 	struct list_head node;
 	struct list_head debug_node;
 	struct list_head reg_node;
@@ -209,6 +241,7 @@ struct tegra_cooling_device *tegra_dvfs_get_cpu_dfll_cdev(void);
 struct tegra_cooling_device *tegra_dvfs_get_cpu_pll_cdev(void);
 struct tegra_cooling_device *tegra_dvfs_get_core_cdev(void);
 int tegra_dvfs_rail_dfll_mode_set_cold(struct dvfs_rail *rail);
+int tegra_dvfs_rail_get_cold_floor(struct dvfs_rail *rail, unsigned long rate);
 
 #ifndef CONFIG_ARCH_TEGRA_2x_SOC
 int tegra_dvfs_rail_disable_prepare(struct dvfs_rail *rail);
@@ -784,8 +784,9 @@ static int __init init_cpu_edp_limits_lookup(void)
 
 void tegra_recalculate_cpu_edp_limits(void)
 {
-	if (tegra_chip_id == TEGRA11X)
-		init_cpu_edp_limits_calculated();
+	if (tegra_chip_id == TEGRA11X &&
+	    init_cpu_edp_limits_calculated() == 0)
+		tegra_cpu_edp_limits_changed();
 }
 
 /*
@@ -917,6 +918,30 @@ struct tegra_system_edp_entry *tegra_get_system_edp_entries(int *size)
 	return power_edp_limits;
 }
 
+/*
+ * Estimate of G cluster power in mW when running n_cores at cpu_khz: the
+ * lowest power EDP level whose (90C) frequency limit still covers the rate.
+ * Returns 0 when there is no calculated power table.
+ */
+unsigned int tegra_edp_get_cpu_power(unsigned int cpu_khz,
+				     unsigned int n_cores)
+{
+	int i;
+
+	if (!power_edp_limits || !power_edp_limits_size || !n_cores)
+		return 0;
+
+	n_cores = min(n_cores, 4U);
+	for (i = 0; i < power_edp_limits_size; i++) {
+		if (power_edp_limits[i].freq_limits[n_cores - 1] >= cpu_khz)
+			break;
+	}
+	if (i >= power_edp_limits_size)
+		i = power_edp_limits_size - 1;
+
+	return power_edp_limits[i].power_limit_100mW * 100;
+}
+
 #ifdef CONFIG_DEBUG_FS
 
 static int edp_limit_debugfs_show(struct seq_file *s, void *data)
@@ -0,0 +1,377 @@
+/*
+ * arch/arm/mach-tegra/edp_budget.c
+ *
+ * System EDP budget: the power the system may draw is split between the
+ * cpu, gpu, EMC and display backlight. Every client gets its minimum
+ * first; what is left goes to the clients' requests, either in the order
+ * of the selected policy or in proportion to what they ask for, and
+ * anything still left raises shares towards their maximum. Share changes
+ * are sent down a notifier chain so the client governors can cap
+ * themselves; the gpu and EMC are capped here through ceiling clocks.
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#define pr_fmt(fmt)	"%s(): " fmt, __func__
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/math64.h>
+#include <linux/notifier.h>
+#include <linux/clk.h>
+#include <linux/err.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+
+#include <mach/edp_budget.h>
+
+struct edp_budget_client {
+	const char		*name;
+	unsigned int		min_mw;
+	unsigned int		max_mw;
+	unsigned int		request_mw;
+	unsigned int		share_mw;	/* 0: not capped */
+};
+
+struct edp_budget_policy {
+	const char		*name;
+	bool			proportional;
+	u8			order[EDP_BUDGET_CLIENTS];
+};
+
+static const struct edp_budget_policy policies[] = {
+	{ "balanced", true,
+	  { EDP_BUDGET_CPU, EDP_BUDGET_GPU, EDP_BUDGET_EMC,
+	    EDP_BUDGET_BACKLIGHT } },
+	{ "favor_cpu", false,
+	  { EDP_BUDGET_CPU, EDP_BUDGET_EMC, EDP_BUDGET_GPU,
+	    EDP_BUDGET_BACKLIGHT } },
+	{ "favor_gpu", false,
+	  { EDP_BUDGET_GPU, EDP_BUDGET_EMC, EDP_BUDGET_CPU,
+	    EDP_BUDGET_BACKLIGHT } },
+	{ "favor_display", false,
+	  { EDP_BUDGET_BACKLIGHT, EDP_BUDGET_CPU, EDP_BUDGET_GPU,
+	    EDP_BUDGET_EMC } },
+};
+
+static DEFINE_MUTEX(edp_budget_lock);
+static BLOCKING_NOTIFIER_HEAD(edp_budget_notifier);
+
+static unsigned int edp_budget_total;		/* mW, 0: unlimited */
+static const struct edp_budget_policy *edp_budget_policy = &policies[0];
+
+/* Board files are expected to override these with their own figures */
+static struct edp_budget_client clients[EDP_BUDGET_CLIENTS] = {
+	[EDP_BUDGET_CPU]	= { "cpu",	 1000, 8000, 8000 },
+	[EDP_BUDGET_GPU]	= { "gpu",	  500, 4000, 4000 },
+	[EDP_BUDGET_EMC]	= { "emc",	  300, 1200, 1200 },
+	[EDP_BUDGET_BACKLIGHT]	= { "backlight",  100, 1000, 1000 },
+};
+
+static unsigned int client_demand(struct edp_budget_client *c)
+{
+	return clamp(c->request_mw, c->min_mw, c->max_mw);
+}
+
+/* Share out the budget; called with edp_budget_lock held */
+static void edp_budget_update(void)
+{
+	const u8 *order = edp_budget_policy->order;
+	unsigned int share[EDP_BUDGET_CLIENTS];
+	unsigned int avail, give, extra = 0, min_sum = 0;
+	struct edp_budget_client *c;
+	int i;
+
+	for (i = 0; i < EDP_BUDGET_CLIENTS; i++) {
+		c = &clients[i];
+		share[i] = c->min_mw;
+		min_sum += c->min_mw;
+		extra += client_demand(c) - c->min_mw;
+	}
+
+	/* minimums are granted even when they overrun the budget */
+	avail = edp_budget_total > min_sum ? edp_budget_total - min_sum : 0;
+
+	if (edp_budget_policy->proportional && extra > avail) {
+		for (i = 0; i < EDP_BUDGET_CLIENTS; i++) {
+			c = &clients[i];
+			give = div_u64((u64)(client_demand(c) - c->min_mw) *
+				       avail, extra);
+			share[i] += give;
+		}
+		avail = 0;
+	} else {
+		for (i = 0; i < EDP_BUDGET_CLIENTS; i++) {
+			c = &clients[order[i]];
+			give = min(avail, client_demand(c) - c->min_mw);
+			share[order[i]] += give;
+			avail -= give;
+		}
+	}
+
+	/* requests are met: leave the rest as headroom, in policy order */
+	for (i = 0; i < EDP_BUDGET_CLIENTS && avail; i++) {
+		c = &clients[order[i]];
+		give = min(avail, c->max_mw - share[order[i]]);
+		share[order[i]] += give;
+		avail -= give;
+	}
+
+	for (i = 0; i < EDP_BUDGET_CLIENTS; i++) {
+		c = &clients[i];
+		if (!edp_budget_total || share[i] >= c->max_mw)
+			share[i] = 0;
+		if (share[i] == c->share_mw)
+			continue;
+
+		c->share_mw = share[i];
+		blocking_notifier_call_chain(&edp_budget_notifier, i,
+					     &c->share_mw);
+	}
+}
+
+void tegra_edp_budget_set_total(unsigned int mw)
+{
+	mutex_lock(&edp_budget_lock);
+	edp_budget_total = mw;
+	edp_budget_update();
+	mutex_unlock(&edp_budget_lock);
+}
+EXPORT_SYMBOL(tegra_edp_budget_set_total);
+
+int tegra_edp_budget_set_limits(enum tegra_edp_budget_client client,
+				unsigned int min_mw, unsigned int max_mw)
+{
+	if (client >= EDP_BUDGET_CLIENTS || !max_mw || min_mw > max_mw)
+		return -EINVAL;
+
+	mutex_lock(&edp_budget_lock);
+	clients[client].min_mw = min_mw;
+	clients[client].max_mw = max_mw;
+	edp_budget_update();
+	mutex_unlock(&edp_budget_lock);
+	return 0;
+}
+EXPORT_SYMBOL(tegra_edp_budget_set_limits);
+
+int tegra_edp_budget_request(enum tegra_edp_budget_client client,
+			     unsigned int mw)
+{
+	if (client >= EDP_BUDGET_CLIENTS)
+		return -EINVAL;
+
+	mutex_lock(&edp_budget_lock);
+	if (clients[client].request_mw != mw) {
+		clients[client].request_mw = mw;
+		edp_budget_update();
+	}
+	mutex_unlock(&edp_budget_lock);
+	return 0;
+}
+EXPORT_SYMBOL(tegra_edp_budget_request);
+
+unsigned int tegra_edp_budget_get(enum tegra_edp_budget_client client)
+{
+	unsigned int mw;
+
+	if (client >= EDP_BUDGET_CLIENTS)
+		return 0;
+
+	mutex_lock(&edp_budget_lock);
+	mw = clients[client].share_mw;
+	mutex_unlock(&edp_budget_lock);
+	return mw;
+}
+EXPORT_SYMBOL(tegra_edp_budget_get);
+
+int tegra_edp_budget_register_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&edp_budget_notifier, nb);
+}
+EXPORT_SYMBOL(tegra_edp_budget_register_notifier);
+
+int tegra_edp_budget_unregister_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&edp_budget_notifier, nb);
+}
+EXPORT_SYMBOL(tegra_edp_budget_unregister_notifier);
+
+/*
+ * gpu and EMC caps. Dynamic power falls faster than the clock rate as the
+ * voltage comes down with it, so scaling the maximum rate linearly by the
+ * share errs on the safe side.
+ */
+static struct clk *budget_clks[EDP_BUDGET_CLIENTS];
+static unsigned long budget_max_rates[EDP_BUDGET_CLIENTS];
+
+static int edp_budget_clk_notify(struct notifier_block *nb,
+				 unsigned long client, void *data)
+{
+	unsigned int mw = *(unsigned int *)data;
+	unsigned long rate;
+
+	if (client >= EDP_BUDGET_CLIENTS || !budget_clks[client])
+		return NOTIFY_DONE;
+
+	rate = budget_max_rates[client];
+	if (mw)
+		rate = div_u64((u64)rate * mw, clients[client].max_mw);
+	clk_set_rate(budget_clks[client], rate);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block edp_budget_clk_notifier = {
+	.notifier_call = edp_budget_clk_notify,
+};
+
+static void __init edp_budget_clk_init(enum tegra_edp_budget_client client,
+				       const char *con_id)
+{
+	struct clk *c = clk_get_sys("tegra_edp_budget", con_id);
+
+	if (IS_ERR(c)) {
+		pr_err("no %s budget clock\n", con_id);
+		return;
+	}
+
+	budget_max_rates[client] = clk_round_rate(c, ULONG_MAX);
+	clk_set_rate(c, budget_max_rates[client]);
+	clk_enable(c);
+	budget_clks[client] = c;
+}
+
+static ssize_t policy_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	ssize_t n = 0;
+	int i;
+
+	mutex_lock(&edp_budget_lock);
+	for (i = 0; i < ARRAY_SIZE(policies); i++)
+		n += sprintf(buf + n, &policies[i] == edp_budget_policy ?
+			     "[%s] " : "%s ", policies[i].name);
+	mutex_unlock(&edp_budget_lock);
+
+	buf[n - 1] = '\n';
+	return n;
+}
+
+static ssize_t policy_store(struct kobject *kobj,
+			    struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(policies); i++)
+		if (sysfs_streq(buf, policies[i].name))
+			break;
+	if (i == ARRAY_SIZE(policies))
+		return -EINVAL;
+
+	mutex_lock(&edp_budget_lock);
+	edp_budget_policy = &policies[i];
+	edp_budget_update();
+	mutex_unlock(&edp_budget_lock);
+	return count;
+}
+
+static ssize_t total_show(struct kobject *kobj,
+			  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", edp_budget_total);
+}
+
+static ssize_t total_store(struct kobject *kobj,
+			   struct kobj_attribute *attr,
+			   const char *buf, size_t count)
+{
+	unsigned int mw;
+
+	if (kstrtouint(buf, 0, &mw))
+		return -EINVAL;
+
+	tegra_edp_budget_set_total(mw);
+	return count;
+}
+
+static ssize_t clients_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	struct edp_budget_client *c;
+	ssize_t n;
+	int i;
+
+	n = sprintf(buf, "%-10s %8s %8s %8s %8s\n",
+		    "client", "min", "max", "request", "share");
+
+	mutex_lock(&edp_budget_lock);
+	for (i = 0; i < EDP_BUDGET_CLIENTS; i++) {
+		c = &clients[i];
+		n += sprintf(buf + n, "%-10s %8u %8u %8u %8u\n", c->name,
+			     c->min_mw, c->max_mw, c->request_mw,
+			     c->share_mw);
+	}
+	mutex_unlock(&edp_budget_lock);
+	return n;
+}
+
+static struct kobj_attribute policy_attr =
+	__ATTR(policy, S_IRUGO | S_IWUSR, policy_show, policy_store);
+static struct kobj_attribute total_attr =
+	__ATTR(total, S_IRUGO | S_IWUSR, total_show, total_store);
+static struct kobj_attribute clients_attr =
+	__ATTR(clients, S_IRUGO, clients_show, NULL);
+
+static const struct attribute *edp_budget_attrs[] = {
+	&policy_attr.attr,
+	&total_attr.attr,
+	&clients_attr.attr,
+	NULL,
+};
+
+static int __init edp_budget_init(void)
+{
+	struct kobject *kobj;
+
+	edp_budget_clk_init(EDP_BUDGET_GPU, "gpu");
+	edp_budget_clk_init(EDP_BUDGET_EMC, "emc");
+	blocking_notifier_chain_register(&edp_budget_notifier,
+					 &edp_budget_clk_notifier);
+
+	/* catch up with shares set by the board before we got here */
+	mutex_lock(&edp_budget_lock);
+	edp_budget_clk_notify(NULL, EDP_BUDGET_GPU,
+			      &clients[EDP_BUDGET_GPU].share_mw);
+	edp_budget_clk_notify(NULL, EDP_BUDGET_EMC,
+			      &clients[EDP_BUDGET_EMC].share_mw);
+	mutex_unlock(&edp_budget_lock);
+
+	kobj = kobject_create_and_add("tegra_edp_budget", kernel_kobj);
+	if (!kobj) {
+		pr_err("failed to create sysfs node\n");
+		return -ENOMEM;
+	}
+
+	if (sysfs_create_files(kobj, edp_budget_attrs)) {
+		pr_err("failed to create sysfs attributes\n");
+		kobject_put(kobj);
+		return -ENOMEM;
+	}
+	return 0;
+}
+late_initcall(edp_budget_init);
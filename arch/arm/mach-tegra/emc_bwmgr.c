@@ -0,0 +1,311 @@
+/*
+ * arch/arm/mach-tegra/emc_bwmgr.c
+ *
+ * EMC bandwidth manager: clients state their ISO and non-ISO bandwidth
+ * needs in MB/s, and the manager turns the sum into a single EMC floor.
+ * ISO needs are always met with margin. The declared non-ISO need is only
+ * an upper bound: while the EMC activity monitor runs, it is trimmed to
+ * what the measured traffic needs at the target utilization, but never
+ * below the ISO floor.
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#define pr_fmt(fmt)	"%s(): " fmt, __func__
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/clk.h>
+#include <linux/err.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include <mach/clk.h>
+#include <mach/mc.h>
+#include <mach/emc_bwmgr.h>
+
+#include "clock.h"
+#include "tegra_emc.h"
+
+#define EMC_BWMGR_SAMPLE_MS		100
+
+struct emc_bw_client {
+	struct list_head	node;
+	const char		*name;
+	bool			iso;
+	u32			bw;		/* MB/sec */
+	u32			max_bw;
+	unsigned int		requests;
+};
+
+static struct {
+	struct mutex		lock;
+	struct list_head	clients;
+	struct clk		*emc_clk;	/* floor user */
+	struct clk		*emc;
+	struct delayed_work	work;
+
+	u32			iso_margin;	/* percent */
+	u32			target_util;	/* percent */
+
+	/* last decision */
+	u32			iso_bw;
+	u32			noniso_bw;
+	unsigned long		iso_khz;
+	unsigned long		noniso_khz;
+	unsigned long		measured_khz;
+	unsigned long		floor_khz;
+} bwmgr = {
+	.iso_margin	= 25,
+	.target_util	= 70,
+};
+
+/* MB/sec scaled by percent to EMC kHz */
+static unsigned long bw_to_khz(u32 bw, unsigned int pct)
+{
+	u64 kbps = (u64)bw * 1000 * pct;
+
+	kbps = div_u64(kbps, 100);
+	return tegra_emc_bw_to_freq_req(min_t(u64, kbps, UINT_MAX));
+}
+
+static unsigned long client_khz(struct emc_bw_client *c)
+{
+	unsigned int efficiency = tegra_emc_bw_efficiency ? : 1;
+
+	if (c->iso)
+		return bw_to_khz(c->bw, 100 + bwmgr.iso_margin);
+	return bw_to_khz(c->bw, 100 * 100 / efficiency);
+}
+
+/* Recompute the floor; called with bwmgr.lock held */
+static void emc_bwmgr_update(void)
+{
+	struct emc_bw_client *c;
+	unsigned long rate, need;
+	int load;
+
+	bwmgr.iso_bw = 0;
+	bwmgr.noniso_bw = 0;
+	bwmgr.iso_khz = 0;
+	bwmgr.noniso_khz = 0;
+	list_for_each_entry(c, &bwmgr.clients, node) {
+		if (c->iso) {
+			bwmgr.iso_bw += c->bw;
+			bwmgr.iso_khz += client_khz(c);
+		} else {
+			bwmgr.noniso_bw += c->bw;
+			bwmgr.noniso_khz += client_khz(c);
+		}
+	}
+
+	rate = bwmgr.iso_khz + bwmgr.noniso_khz;
+
+	load = tegra_actmon_emc_load();
+	bwmgr.measured_khz = 0;
+	if (load > 0 && bwmgr.noniso_khz) {
+		bwmgr.measured_khz = clk_get_rate(bwmgr.emc) / 1000 *
+			load / 1000;
+		need = bwmgr.measured_khz * 100 / bwmgr.target_util;
+		rate = max(bwmgr.iso_khz, min(rate, need));
+	}
+
+	if (rate != bwmgr.floor_khz) {
+		bwmgr.floor_khz = rate;
+		clk_set_rate(bwmgr.emc_clk, rate * 1000);
+	}
+
+	/* measured traffic moves on its own: keep sampling it */
+	if (bwmgr.noniso_khz)
+		schedule_delayed_work(&bwmgr.work,
+				      msecs_to_jiffies(EMC_BWMGR_SAMPLE_MS));
+}
+
+static void emc_bwmgr_work_func(struct work_struct *work)
+{
+	mutex_lock(&bwmgr.lock);
+	emc_bwmgr_update();
+	mutex_unlock(&bwmgr.lock);
+}
+
+tegra_emc_bw_handle tegra_emc_bw_register(const char *name, bool iso)
+{
+	struct emc_bw_client *c;
+
+	if (!bwmgr.emc_clk)
+		return ERR_PTR(-ENODEV);
+
+	c = kzalloc(sizeof(*c), GFP_KERNEL);
+	if (!c)
+		return ERR_PTR(-ENOMEM);
+
+	c->name = name;
+	c->iso = iso;
+
+	mutex_lock(&bwmgr.lock);
+	list_add_tail(&c->node, &bwmgr.clients);
+	mutex_unlock(&bwmgr.lock);
+	return c;
+}
+EXPORT_SYMBOL(tegra_emc_bw_register);
+
+void tegra_emc_bw_unregister(tegra_emc_bw_handle handle)
+{
+	struct emc_bw_client *c = handle;
+
+	if (IS_ERR_OR_NULL(c))
+		return;
+
+	mutex_lock(&bwmgr.lock);
+	list_del(&c->node);
+	emc_bwmgr_update();
+	mutex_unlock(&bwmgr.lock);
+	kfree(c);
+}
+EXPORT_SYMBOL(tegra_emc_bw_unregister);
+
+int tegra_emc_bw_request(tegra_emc_bw_handle handle, u32 bw)
+{
+	struct emc_bw_client *c = handle;
+
+	if (IS_ERR_OR_NULL(c))
+		return -EINVAL;
+
+	mutex_lock(&bwmgr.lock);
+	c->bw = bw;
+	c->max_bw = max(c->max_bw, bw);
+	c->requests++;
+	emc_bwmgr_update();
+	mutex_unlock(&bwmgr.lock);
+	return 0;
+}
+EXPORT_SYMBOL(tegra_emc_bw_request);
+
+#ifdef CONFIG_DEBUG_FS
+static int emc_bwmgr_show(struct seq_file *s, void *data)
+{
+	struct emc_bw_client *c;
+
+	mutex_lock(&bwmgr.lock);
+
+	seq_printf(s, "%-16s %-7s %8s %8s %8s %10s\n", "client", "type",
+		   "MB/s", "max MB/s", "requests", "kHz");
+	list_for_each_entry(c, &bwmgr.clients, node)
+		seq_printf(s, "%-16s %-7s %8u %8u %8u %10lu\n", c->name,
+			   c->iso ? "iso" : "non-iso", c->bw, c->max_bw,
+			   c->requests, client_khz(c));
+
+	seq_printf(s, "\n%-16s %8u MB/s %10lu kHz (margin %u%%)\n", "iso",
+		   bwmgr.iso_bw, bwmgr.iso_khz, bwmgr.iso_margin);
+	seq_printf(s, "%-16s %8u MB/s %10lu kHz (efficiency %u%%)\n",
+		   "non-iso", bwmgr.noniso_bw, bwmgr.noniso_khz,
+		   tegra_emc_bw_efficiency);
+	seq_printf(s, "%-16s %10lu kHz (target %u%%)\n", "measured",
+		   bwmgr.measured_khz, bwmgr.target_util);
+	seq_printf(s, "%-16s %10lu kHz\n", "floor", bwmgr.floor_khz);
+
+	mutex_unlock(&bwmgr.lock);
+	return 0;
+}
+
+static int emc_bwmgr_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, emc_bwmgr_show, inode->i_private);
+}
+
+static const struct file_operations emc_bwmgr_fops = {
+	.open		= emc_bwmgr_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int param_get(void *data, u64 *val)
+{
+	*val = *(u32 *)data;
+	return 0;
+}
+static int param_set(void *data, u64 val)
+{
+	if ((val > 100) || (!val && (data == &bwmgr.target_util)))
+		return -EINVAL;
+
+	mutex_lock(&bwmgr.lock);
+	*(u32 *)data = val;
+	emc_bwmgr_update();
+	mutex_unlock(&bwmgr.lock);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(param_fops, param_get, param_set, "%llu\n");
+
+static int __init emc_bwmgr_debug_init(void)
+{
+	struct dentry *dir;
+
+	if (!bwmgr.emc_clk)
+		return 0;
+
+	dir = debugfs_create_dir("tegra_emc_bwmgr", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("clients", S_IRUGO, dir, NULL,
+				 &emc_bwmgr_fops))
+		goto err_out;
+
+	if (!debugfs_create_file("iso_margin", S_IRUGO | S_IWUSR, dir,
+				 &bwmgr.iso_margin, &param_fops))
+		goto err_out;
+
+	if (!debugfs_create_file("target_util", S_IRUGO | S_IWUSR, dir,
+				 &bwmgr.target_util, &param_fops))
+		goto err_out;
+
+	return 0;
+
+err_out:
+	debugfs_remove_recursive(dir);
+	return -ENOMEM;
+}
+late_initcall(emc_bwmgr_debug_init);
+#endif
+
+static int __init emc_bwmgr_init(void)
+{
+	struct clk *c;
+
+	mutex_init(&bwmgr.lock);
+	INIT_LIST_HEAD(&bwmgr.clients);
+	INIT_DELAYED_WORK(&bwmgr.work, emc_bwmgr_work_func);
+
+	bwmgr.emc = tegra_get_clock_by_name("emc");
+	c = clk_get_sys("tegra_emc_bwmgr", "emc");
+	if (!bwmgr.emc || IS_ERR(c)) {
+		pr_err("no emc floor clock\n");
+		return -ENODEV;
+	}
+
+	clk_set_rate(c, 0);
+	clk_enable(c);
+	bwmgr.emc_clk = c;
+	return 0;
+}
+subsys_initcall(emc_bwmgr_init);
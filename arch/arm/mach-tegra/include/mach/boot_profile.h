@@ -0,0 +1,36 @@
+/*
+ * include/mach/boot_profile.h
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __MACH_TEGRA_BOOT_PROFILE_H
+#define __MACH_TEGRA_BOOT_PROFILE_H
+
+#ifdef CONFIG_TEGRA_BOOT_PROFILE
+/*
+ * Record a boot milestone against the microsecond timer, which runs from
+ * reset and so also counts the bootloader. Each name (compared by address,
+ * so pass a literal) is recorded the first time only; usable from
+ * init_early on.
+ */
+void tegra_boot_profile_mark(const char *name);
+#else
+static inline void tegra_boot_profile_mark(const char *name)
+{}
+#endif
+
+#endif /* __MACH_TEGRA_BOOT_PROFILE_H */
@@ -63,6 +63,26 @@ static inline int tegra_emc_disable_eack(void) {
 	return 0;
 }
 #endif
+
+#if defined(CONFIG_ARCH_TEGRA_3x_SOC) || defined(CONFIG_ARCH_TEGRA_11x_SOC)
+int tegra_actmon_emc_load(void);
+int tegra_actmon_cpu_emc_load(void);
+unsigned long tegra_actmon_emc_actv_freq(void);
+#else
+static inline int tegra_actmon_emc_load(void)
+{
+	return 0;
+}
+static inline int tegra_actmon_cpu_emc_load(void)
+{
+	return 0;
+}
+static inline unsigned long tegra_actmon_emc_actv_freq(void)
+{
+	return 0;
+}
+#endif
+
 int tegra_dvfs_rail_disable_by_name(const char *reg_id);
 int tegra_clk_cfg_ex(struct clk *c, enum tegra_clk_ex_param p, u32 setting);
 int tegra_register_clk_rate_notifier(struct clk *c, struct notifier_block *nb);
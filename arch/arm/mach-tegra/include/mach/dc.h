@@ -267,6 +267,9 @@ struct tegra_dsi_out {
 	bool		power_saving_suspend;
 	bool		dsi2lvds_bridge_enable;
 	bool		dsi2edp_bridge_enable;
+	bool		partial_update;	/* panel accepts page address
+					 * updates in command mode */
+	u16		partial_update_align;	/* rows */
 
 	u32		max_panel_freq_khz;
 	u32		lp_cmd_mode_freq_khz;
@@ -469,6 +472,9 @@ struct tegra_dc_out {
 	const char			*parent_clk_backup;
 
 	unsigned			max_pixclock;
+	/* lowest refresh rate in Hz the sink accepts by stretching the
+	 * vertical front porch, 0 if the rate must not change */
+	unsigned			min_refresh;
 	unsigned			order;
 	unsigned			align;
 	unsigned			depth;
@@ -593,6 +599,12 @@ struct tegra_dc_win {
 	unsigned		z;
 	u8			global_alpha;
 
+	/* region changed by the last update, damage_w == 0 for all */
+	unsigned		damage_x;
+	unsigned		damage_y;
+	unsigned		damage_w;
+	unsigned		damage_h;
+
 	struct tegra_dc_csc	csc;
 
 	int			dirty;
@@ -695,6 +707,8 @@ int tegra_dc_set_default_videomode(struct tegra_dc *dc);
 u32 tegra_dc_get_syncpt_id(const struct tegra_dc *dc, int i);
 u32 tegra_dc_incr_syncpt_max(struct tegra_dc *dc, int i);
 void tegra_dc_incr_syncpt_min(struct tegra_dc *dc, int i, u32 val);
+void tegra_dc_get_latch(struct tegra_dc *dc, u32 *frame, s64 *timestamp_ns);
+int tegra_dc_wait_for_frame(struct tegra_dc *dc, u32 frame);
 
 /* tegra_dc_update_windows and tegra_dc_sync_windows do not support windows
  * with differenct dcs in one call
@@ -706,6 +720,7 @@ bool tegra_dc_is_within_n_vsync(struct tegra_dc *dc, s64 ts);
 bool tegra_dc_does_vsync_separate(struct tegra_dc *dc, s64 new_ts, s64 old_ts);
 
 int tegra_dc_set_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode);
+int tegra_dc_set_content_rate(struct tegra_dc *dc, int content_rate);
 struct fb_videomode;
 int tegra_dc_to_fb_videomode(struct fb_videomode *fbmode,
 	const struct tegra_dc_mode *mode);
@@ -753,6 +768,7 @@ void tegra_dc_put_edid(struct tegra_dc_edid *edid);
 
 int tegra_dc_set_flip_callback(void (*callback)(void));
 int tegra_dc_unset_flip_callback(void);
+unsigned long tegra_dc_get_last_flip(void);
 int tegra_dc_get_panel_sync_rate(void);
 
 int tegra_dc_get_out(const struct tegra_dc *dc);
@@ -22,6 +22,7 @@
 #define __MACH_TEGRA_DMA_H
 
 #include <linux/list.h>
+#include <linux/ktime.h>
 
 #define TEGRA_DMA_REQ_SEL_CNTR			0
 #define TEGRA_DMA_REQ_SEL_I2S_2			1
@@ -79,6 +80,19 @@ enum tegra_dma_mode {
 	TEGRA_DMA_MODE_CONTINUOUS_DOUBLE = TEGRA_DMA_MODE_CONTINUOUS,
 	TEGRA_DMA_MODE_CONTINUOUS_SINGLE = 4,
 	TEGRA_DMA_MODE_ONESHOT = 8,
+	/*
+	 * Queued requests run back to back: the next one is prefetched
+	 * while the current one runs. With COALESCE, requests that follow
+	 * one another in memory, to or from the same FIFO, run as one
+	 * transfer and complete on one interrupt.
+	 */
+	TEGRA_DMA_MODE_CHAINED = 16,
+	TEGRA_DMA_MODE_COALESCE = 32,
+	/*
+	 * Latency sensitive client (audio, touch): may take the channels
+	 * held in reserve, which bulk clients can not.
+	 */
+	TEGRA_DMA_PRIO_HIGH = 64,
 };
 
 /*
@@ -182,6 +196,9 @@ struct tegra_dma_req {
 
 	/* Client specific data */
 	void *dev;
+
+	/* Time of enqueue, for the request to start latency statistics */
+	ktime_t queued;
 };
 
 int tegra_dma_enqueue_req(struct tegra_dma_channel *ch,
@@ -201,6 +218,14 @@ struct tegra_dma_channel *tegra_dma_allocate_channel(int mode,
 void tegra_dma_free_channel(struct tegra_dma_channel *ch);
 
 int tegra_dma_get_channel_id(struct tegra_dma_channel *ch);
+
+/*
+ * tegra_dma_reserve_channels: Hold nr more free channels back for
+ * TEGRA_DMA_PRIO_HIGH allocations; -EBUSY if there are not as many free.
+ * tegra_dma_unreserve_channels gives them back to everyone.
+ */
+int tegra_dma_reserve_channels(unsigned int nr);
+void tegra_dma_unreserve_channels(unsigned int nr);
 /*
  * tegra_dma_cancel: Stop the dma and remove all request from pending request
  * queue for transfer.
@@ -213,6 +238,20 @@ int tegra_dma_cancel(struct tegra_dma_channel *ch);
 
 int __init tegra_dma_init(void);
 
+#if defined(CONFIG_TEGRA_APB_DMA)
+struct dma_chan;
+
+/*
+ * dmaengine clients pass tegra_dma_filter to dma_request_channel() with a
+ * tegra_dma_slave naming the peripheral; it must outlive the channel.
+ */
+struct tegra_dma_slave {
+	unsigned long req_sel;
+};
+
+bool tegra_dma_filter(struct dma_chan *chan, void *param);
+#endif
+
 #else /* !defined(CONFIG_TEGRA_SYSTEM_DMA) */
 static inline int tegra_dma_init(void)
 {
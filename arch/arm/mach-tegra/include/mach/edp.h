@@ -95,6 +95,8 @@ unsigned int tegra_edp_find_maxf(int volt);
 void tegra_platform_edp_init(struct thermal_trip_info *trips,
 					int *num_trips, int margin);
 struct tegra_system_edp_entry *tegra_get_system_edp_entries(int *size);
+unsigned int tegra_edp_get_cpu_power(unsigned int cpu_khz,
+				     unsigned int n_cores);
 #else
 static inline struct thermal_cooling_device *edp_cooling_device_create(
 	int index)
@@ -121,6 +123,9 @@ static inline void tegra_platform_edp_init(struct thermal_trip_info *trips,
 {}
 static inline struct tegra_system_edp_entry
 		*tegra_get_system_edp_entries(int *size) { return NULL; }
+static inline unsigned int tegra_edp_get_cpu_power(unsigned int cpu_khz,
+						   unsigned int n_cores)
+{ return 0; }
 #endif
 
 #ifdef CONFIG_ARCH_TEGRA_2x_SOC
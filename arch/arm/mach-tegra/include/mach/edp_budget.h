@@ -0,0 +1,80 @@
+/*
+ * include/mach/edp_budget.h
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __MACH_TEGRA_EDP_BUDGET_H
+#define __MACH_TEGRA_EDP_BUDGET_H
+
+#include <linux/errno.h>
+#include <linux/notifier.h>
+
+enum tegra_edp_budget_client {
+	EDP_BUDGET_CPU = 0,
+	EDP_BUDGET_GPU,
+	EDP_BUDGET_EMC,
+	EDP_BUDGET_BACKLIGHT,
+
+	EDP_BUDGET_CLIENTS,
+};
+
+#ifdef CONFIG_TEGRA_EDP_BUDGET
+/*
+ * Set the power the system may draw, in mW; 0 lifts the budget and with
+ * it all client caps.
+ */
+void tegra_edp_budget_set_total(unsigned int mw);
+
+/* set the range of a client's share, in mW */
+int tegra_edp_budget_set_limits(enum tegra_edp_budget_client client,
+				unsigned int min_mw, unsigned int max_mw);
+
+/* set what a client would draw if unconstrained, in mW */
+int tegra_edp_budget_request(enum tegra_edp_budget_client client,
+			     unsigned int mw);
+
+/* current share of a client in mW, 0 when it is not capped */
+unsigned int tegra_edp_budget_get(enum tegra_edp_budget_client client);
+
+/*
+ * Share changes are reported with the client as the action and a pointer
+ * to its new share (unsigned int, mW, 0 for no cap) as the data. Callbacks
+ * must not call back into the budget.
+ */
+int tegra_edp_budget_register_notifier(struct notifier_block *nb);
+int tegra_edp_budget_unregister_notifier(struct notifier_block *nb);
+#else
+static inline void tegra_edp_budget_set_total(unsigned int mw)
+{}
+static inline int tegra_edp_budget_set_limits(
+	enum tegra_edp_budget_client client,
+	unsigned int min_mw, unsigned int max_mw)
+{ return -ENODEV; }
+static inline int tegra_edp_budget_request(
+	enum tegra_edp_budget_client client, unsigned int mw)
+{ return -ENODEV; }
+static inline unsigned int tegra_edp_budget_get(
+	enum tegra_edp_budget_client client)
+{ return 0; }
+static inline int tegra_edp_budget_register_notifier(struct notifier_block *nb)
+{ return -ENODEV; }
+static inline int tegra_edp_budget_unregister_notifier(
+	struct notifier_block *nb)
+{ return -ENODEV; }
+#endif
+
+#endif /* __MACH_TEGRA_EDP_BUDGET_H */
@@ -0,0 +1,56 @@
+/*
+ * include/mach/emc_bwmgr.h
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __MACH_TEGRA_EMC_BWMGR_H
+#define __MACH_TEGRA_EMC_BWMGR_H
+
+#include <linux/err.h>
+
+/* handle to identify registered client */
+#define tegra_emc_bw_handle void *
+
+#ifdef CONFIG_TEGRA_EMC_BWMGR
+/*
+ * Register an EMC bandwidth client. ISO clients are always granted their
+ * request (plus margin); non-ISO requests may be trimmed down to measured
+ * EMC utilization.
+ */
+tegra_emc_bw_handle tegra_emc_bw_register(const char *name, bool iso);
+
+/* unregister a client, dropping its request */
+void tegra_emc_bw_unregister(tegra_emc_bw_handle handle);
+
+/* set client bandwidth need, 0 to drop it */
+int tegra_emc_bw_request(tegra_emc_bw_handle handle,
+			 u32 bw);	/* MB/sec */
+#else
+static inline tegra_emc_bw_handle tegra_emc_bw_register(const char *name,
+							bool iso)
+{
+	return ERR_PTR(-ENODEV);
+}
+static inline void tegra_emc_bw_unregister(tegra_emc_bw_handle handle)
+{}
+static inline int tegra_emc_bw_request(tegra_emc_bw_handle handle, u32 bw)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif /* __MACH_TEGRA_EMC_BWMGR_H */
@@ -116,11 +116,18 @@ static inline void tegra_latency_allowance_update_tick_length(
 {
 	return;
 }
+
+static inline void tegra_latency_allowance_underflow(enum tegra_la_id id)
+{
+}
 #else
 int tegra_set_latency_allowance(enum tegra_la_id id,
 				unsigned int bandwidth_in_mbps);
 
 void tegra_latency_allowance_update_tick_length(unsigned int new_ns_per_tick);
+
+/* Report an underflow of an ISO client; callable from interrupt context */
+void tegra_latency_allowance_underflow(enum tegra_la_id id);
 #endif
 
 #if !defined(CONFIG_TEGRA_LATENCY_ALLOWANCE_SCALING)
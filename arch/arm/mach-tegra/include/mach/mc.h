@@ -20,6 +20,9 @@
 #ifndef __MACH_TEGRA_MC_H
 #define __MACH_TEGRA_MC_H
 
+#include <linux/types.h>
+#include <linux/errno.h>
+
 #if defined(CONFIG_ARCH_TEGRA_2x_SOC)
 #define TEGRA_MC_FPRI_CTRL_AVPC		0x17c
 #define TEGRA_MC_FPRI_CTRL_DC		0x180
@@ -122,6 +125,35 @@ unsigned int tegra_emc_bw_to_freq_req(unsigned int bw_kbps);
 
 unsigned int tegra_emc_freq_req_to_bw(unsigned int freq_kbps);
 
+/* client groups seen by the MC statistics counters */
+enum tegra_mc_stats_group {
+	TEGRA_MC_STATS_DISPLAY,
+	TEGRA_MC_STATS_GR3D,
+	TEGRA_MC_STATS_CPU,
+	TEGRA_MC_STATS_AVP,
+	TEGRA_MC_STATS_VI,
+	TEGRA_MC_STATS_USB,
+	TEGRA_MC_STATS_SDMMC,
+	TEGRA_MC_STATS_GROUPS,
+};
+
+/* last sample of a group; index 0 is reads, 1 is writes */
+struct tegra_mc_client_stats {
+	u32	bw_kbps[2];
+	u32	latency_ns[2];		/* average per request */
+};
+
+#ifdef CONFIG_TEGRA_MC_STATS
+int tegra_mc_stats_get(enum tegra_mc_stats_group group,
+		       struct tegra_mc_client_stats *stats);
+#else
+static inline int tegra_mc_stats_get(enum tegra_mc_stats_group group,
+				     struct tegra_mc_client_stats *stats)
+{
+	return -ENODEV;
+}
+#endif
+
 /* API to get freqency switch latency at given MC freq.
  * freq_khz: Frequncy in KHz.
  * retruns latency in microseconds.
@@ -125,4 +125,11 @@ void tegra_usb_phy_memory_prefetch_off(struct tegra_usb_phy *phy);
 
 void tegra_usb_enable_vbus(struct tegra_usb_phy *phy, bool enable);
 
+/**
+ * Keeps the phy powered across bus suspend while blocked, so that a latency
+ * sensitive device resumes without a phy power up.  System suspend still
+ * powers the phy off.
+ */
+void tegra_usb_phy_block_lp(struct tegra_usb_phy *phy, bool block);
+
 #endif /* __MACH_USB_PHY_H */
@@ -64,6 +64,9 @@ struct la_scaling_info {
 	int scaling_ref_count;
 	int actual_la_to_set;
 	int la_set;
+	int la_base;			/* before closed-loop scaling, or -1 */
+	unsigned int adapt_pct;		/* closed-loop scaling, display only */
+	unsigned int underflows;	/* periods with an underflow */
 };
 
 struct la_scaling_reg_info {
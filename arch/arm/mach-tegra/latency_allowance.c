@@ -24,6 +24,9 @@
 #include <linux/spinlock.h>
 #include <linux/stringify.h>
 #include <linux/clk.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/bitops.h>
 #include <asm/bug.h>
 #include <asm/io.h>
 #include <asm/string.h>
@@ -130,14 +133,63 @@ static int la_scaling_enable_count;
 			return -EINVAL; \
 	} while (0)
 
+/* Closed-loop mode: display underflows tighten the LA of the windows that
+ * underflowed and back the non-ISO clients off. Every quiet stretch without
+ * one gives a step back, display first; after that the non-ISO clients may
+ * go below their computed LA for more throughput. Scaling is in percent of
+ * the LA computed from the bandwidth request. */
+#define LA_ADAPT_PERIOD_MS	250
+#define LA_ADAPT_QUIET_PERIODS	20
+#define LA_ADAPT_STEP_PCT	25
+#define LA_ADAPT_DISP_MIN_PCT	25
+#define LA_ADAPT_NONISO_MIN_PCT	75
+#define LA_ADAPT_NONISO_MAX_PCT	200
+
+static struct {
+	struct mutex lock;
+	struct delayed_work work;
+	bool enabled;
+	unsigned int noniso_pct;
+	unsigned int quiet;
+	unsigned int adjustments;
+	DECLARE_BITMAP(pending, TEGRA_LA_MAX_ID);
+} la_adapt;
+
+static bool la_is_display(enum tegra_la_id id)
+{
+	return id >= ID(DISPLAY_0A) && id <= ID(DISPLAY_HCB);
+}
 
-static void set_la(struct la_client_info *ci, int la)
+/* isochronous clients, which closed-loop mode never loosens */
+static bool la_is_iso(enum tegra_la_id id)
+{
+	return la_is_display(id) ||
+		(id >= ID(VI_RUV) && id <= ID(VI_WY)) ||
+		id == ID(HDAR) || id == ID(HDAW) || id == ID(PTCR);
+}
+
+/* la as scaled by closed-loop mode; called with safety_lock held */
+static int la_adapted(int idx, int la)
+{
+	enum tegra_la_id id = la_info_array[idx].id;
+	unsigned int pct = 100;
+
+	if (!la_adapt.enabled)
+		return la;
+
+	if (la_is_display(id))
+		pct = scaling_info[idx].adapt_pct;
+	else if (!la_is_iso(id))
+		pct = la_adapt.noniso_pct;
+	return min_t(int, la * pct / 100, MC_LA_MAX_VALUE);
+}
+
+static void __set_la(struct la_client_info *ci, int la)
 {
 	unsigned long reg_read;
 	unsigned long reg_write;
 	int idx = id_to_index[ci->id];
 
-	spin_lock(&safety_lock);
 	reg_read = readl(ci->reg_addr);
 	reg_write = (reg_read & ~ci->mask) |
 			(la << ci->shift);
@@ -145,9 +197,117 @@ static void set_la(struct la_client_info *ci, int la)
 	scaling_info[idx].la_set = la;
 	la_debug("reg_addr=0x%x, read=0x%x, write=0x%x",
 		(u32)ci->reg_addr, (u32)reg_read, (u32)reg_write);
+}
+
+/* Programs la, scaled if closed-loop mode is on, and keeps it as the base
+ * closed-loop mode scales from */
+static void set_la(struct la_client_info *ci, int la)
+{
+	int idx = id_to_index[ci->id];
+
+	spin_lock(&safety_lock);
+	scaling_info[idx].la_base = la;
+	__set_la(ci, la_adapted(idx, la));
 	spin_unlock(&safety_lock);
 }
 
+/* Reprograms every client from its base; called with la_adapt.lock held */
+static void la_adapt_apply(void)
+{
+	int i;
+
+	spin_lock(&safety_lock);
+	for (i = 0; i < ARRAY_SIZE(la_info_array) - 1; i++)
+		if (scaling_info[i].la_base >= 0)
+			__set_la(&la_info_array[i],
+				 la_adapted(i, scaling_info[i].la_base));
+	spin_unlock(&safety_lock);
+}
+
+static void la_adapt_work_func(struct work_struct *work)
+{
+	bool underflow = false, disp_relaxed = false, changed = false;
+	unsigned int pct;
+	int i;
+
+	mutex_lock(&la_adapt.lock);
+	if (!la_adapt.enabled)
+		goto out;
+
+	for (i = 0; i < ARRAY_SIZE(la_info_array) - 1; i++) {
+		struct la_client_info *ci = &la_info_array[i];
+
+		if (!la_is_display(ci->id) ||
+		    !test_and_clear_bit(ci->id, la_adapt.pending))
+			continue;
+
+		underflow = true;
+		scaling_info[i].underflows++;
+		pct = max_t(int, scaling_info[i].adapt_pct - LA_ADAPT_STEP_PCT,
+			    LA_ADAPT_DISP_MIN_PCT);
+		if (pct != scaling_info[i].adapt_pct) {
+			pr_info("LA: %s underflow, la at %u%%\n",
+				ci->name, pct);
+			scaling_info[i].adapt_pct = pct;
+			changed = true;
+		}
+	}
+
+	if (underflow) {
+		la_adapt.quiet = 0;
+		pct = min_t(unsigned int,
+			    la_adapt.noniso_pct + LA_ADAPT_STEP_PCT,
+			    LA_ADAPT_NONISO_MAX_PCT);
+		if (pct != la_adapt.noniso_pct) {
+			pr_info("LA: non-ISO backed off, la at %u%%\n", pct);
+			la_adapt.noniso_pct = pct;
+			changed = true;
+		}
+	} else if (++la_adapt.quiet >= LA_ADAPT_QUIET_PERIODS) {
+		la_adapt.quiet = 0;
+		for (i = 0; i < ARRAY_SIZE(la_info_array) - 1; i++) {
+			struct la_client_info *ci = &la_info_array[i];
+
+			if (!la_is_display(ci->id) ||
+			    scaling_info[i].adapt_pct >= 100)
+				continue;
+
+			pct = min(scaling_info[i].adapt_pct +
+				  LA_ADAPT_STEP_PCT, 100U);
+			pr_info("LA: %s quiet, la at %u%%\n", ci->name, pct);
+			scaling_info[i].adapt_pct = pct;
+			disp_relaxed = changed = true;
+		}
+
+		if (!disp_relaxed || la_adapt.noniso_pct > 100) {
+			pct = max_t(int,
+				    la_adapt.noniso_pct - LA_ADAPT_STEP_PCT,
+				    LA_ADAPT_NONISO_MIN_PCT);
+			if (pct != la_adapt.noniso_pct) {
+				pr_info("LA: non-ISO headroom, la at %u%%\n",
+					pct);
+				la_adapt.noniso_pct = pct;
+				changed = true;
+			}
+		}
+	}
+
+	if (changed) {
+		la_adapt.adjustments++;
+		la_adapt_apply();
+	}
+	schedule_delayed_work(&la_adapt.work,
+			      msecs_to_jiffies(LA_ADAPT_PERIOD_MS));
+out:
+	mutex_unlock(&la_adapt.lock);
+}
+
+void tegra_latency_allowance_underflow(enum tegra_la_id id)
+{
+	if (la_adapt.enabled && id < TEGRA_LA_MAX_ID)
+		set_bit(id, la_adapt.pending);
+}
+
 /* Sets latency allowance based on clients memory bandwitdh requirement.
  * Bandwidth passed is in mega bytes per second.
  */
@@ -353,6 +513,8 @@ void tegra_latency_allowance_update_tick_length(unsigned int new_ns_per_tick)
 					(la << la_info_array[i].shift);
 			writel(reg_write, la_info_array[i].reg_addr);
 			scaling_info[i].la_set = la;
+			if (scaling_info[i].la_base > 0)
+				scaling_info[i].la_base /= scale_factor;
 		}
 		spin_unlock(&safety_lock);
 
@@ -393,6 +555,67 @@ static const struct file_operations regs_fops = {
 	.release        = single_release,
 };
 
+static int la_adapt_get(void *data, u64 *val)
+{
+	*val = la_adapt.enabled;
+	return 0;
+}
+
+static int la_adapt_set(void *data, u64 val)
+{
+	int i;
+
+	cancel_delayed_work_sync(&la_adapt.work);
+	mutex_lock(&la_adapt.lock);
+	la_adapt.enabled = !!val;
+	la_adapt.noniso_pct = 100;
+	la_adapt.quiet = 0;
+	bitmap_zero(la_adapt.pending, TEGRA_LA_MAX_ID);
+	for (i = 0; i < ARRAY_SIZE(la_info_array) - 1; i++)
+		scaling_info[i].adapt_pct = 100;
+	la_adapt_apply();
+	if (la_adapt.enabled)
+		schedule_delayed_work(&la_adapt.work,
+				      msecs_to_jiffies(LA_ADAPT_PERIOD_MS));
+	mutex_unlock(&la_adapt.lock);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(la_adapt_fops, la_adapt_get, la_adapt_set, "%llu\n");
+
+static int la_adapt_show(struct seq_file *s, void *unused)
+{
+	unsigned i;
+
+	mutex_lock(&la_adapt.lock);
+	seq_printf(s, "enabled: %d\nnon-ISO: %u%%\nadjustments: %u\n\n",
+		   la_adapt.enabled, la_adapt.noniso_pct,
+		   la_adapt.adjustments);
+	seq_printf(s, "%-16s %6s %6s %6s %10s\n", "client", "base", "la",
+		   "pct", "underflows");
+	for (i = 0; i < ARRAY_SIZE(la_info_array) - 1; i++) {
+		if (!la_is_display(la_info_array[i].id))
+			continue;
+		seq_printf(s, "%-16s %6d %6d %5u%% %10u\n",
+			   la_info_array[i].name, scaling_info[i].la_base,
+			   scaling_info[i].la_set, scaling_info[i].adapt_pct,
+			   scaling_info[i].underflows);
+	}
+	mutex_unlock(&la_adapt.lock);
+	return 0;
+}
+
+static int dbg_la_adapt_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, la_adapt_show, inode->i_private);
+}
+
+static const struct file_operations adapt_state_fops = {
+	.open           = dbg_la_adapt_open,
+	.read           = seq_read,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 static int __init tegra_latency_allowance_debugfs_init(void)
 {
 	if (latency_debug_dir)
@@ -402,6 +625,10 @@ static int __init tegra_latency_allowance_debugfs_init(void)
 
 	debugfs_create_file("la_info", S_IRUGO, latency_debug_dir, NULL,
 		&regs_fops);
+	debugfs_create_file("adaptive", S_IRUGO | S_IWUSR, latency_debug_dir,
+		NULL, &la_adapt_fops);
+	debugfs_create_file("adaptive_state", S_IRUGO, latency_debug_dir,
+		NULL, &adapt_state_fops);
 
 	return 0;
 }
@@ -419,9 +646,14 @@ static int __init tegra_latency_allowance_init(void)
 
 	la_scaling_enable_count = 0;
 	memset(&id_to_index[0], 0xFF, sizeof(id_to_index));
+	mutex_init(&la_adapt.lock);
+	INIT_DELAYED_WORK(&la_adapt.work, la_adapt_work_func);
 
-	for (i = 0; i < ARRAY_SIZE(la_info_array); i++)
+	for (i = 0; i < ARRAY_SIZE(la_info_array); i++) {
 		id_to_index[la_info_array[i].id] = i;
+		scaling_info[i].la_base = -1;
+		scaling_info[i].adapt_pct = 100;
+	}
 
 	for (i = 0; i < ARRAY_SIZE(la_info_array); i++) {
 		if (la_info_array[i].init_la)
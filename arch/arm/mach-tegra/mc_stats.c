@@ -0,0 +1,491 @@
+/*
+ * arch/arm/mach-tegra/mc_stats.c
+ *
+ * Per-client memory bandwidth and latency from the T11x MC statistics
+ * counters. The MC has a single pair of filtered counters, so the clients
+ * are grouped and the counters are handed round the groups, one short
+ * window each: first counting the atoms read and written, then the
+ * requests and their accumulated latency. One pass over all groups makes
+ * a sample; samples are taken at a low rate and kept in a ring.
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#define pr_fmt(fmt)	"%s(): " fmt, __func__
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/io.h>
+#include <linux/mutex.h>
+#include <linux/clk.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include <mach/iomap.h>
+#include <mach/clk.h>
+#include <mach/mc.h>
+
+#include "clock.h"
+
+#define MC_STAT_CONTROL				0x100
+#define MC_STAT_CONTROL_EMC_GATHER_SHIFT	8
+#define MC_STAT_CONTROL_EMC_GATHER_CLEAR	1
+#define MC_STAT_CONTROL_EMC_GATHER_DISABLE	2
+#define MC_STAT_CONTROL_EMC_GATHER_ENABLE	3
+#define MC_STAT_EMC_CLOCK_LIMIT			0x108
+#define MC_STAT_EMC_CLOCKS			0x110
+
+/* two filter sets, same layout */
+#define MC_STAT_EMC_SET(n)			(0x118 + (n) * 0x40)
+#define MC_STAT_SET_ADR_LIMIT_LO		0x00
+#define MC_STAT_SET_ADR_LIMIT_HI		0x04
+#define MC_STAT_SET_MISC			0x0c
+#define MC_STAT_SET_MISC_EVENT_ATOMS		(0 << 0)
+#define MC_STAT_SET_MISC_EVENT_REQUESTS		(1 << 0)
+#define MC_STAT_SET_MISC_FILTER_CLIENT		(1 << 4)
+#define MC_STAT_SET_CLIENT(w)			(0x10 + (w) * 4)
+#define MC_STAT_SET_COUNT			0x20
+#define MC_STAT_SET_LATENCY			0x28	/* EMC clocks */
+
+#define MC_STAT_CLIENT_WORDS			3
+#define MC_STAT_ATOM_BYTES			64
+
+#define MC_STATS_SAMPLES			64
+#define MC_STATS_WINDOW_MS			10
+#define MC_STATS_SAMPLE_MS			1000
+
+#define MC_STATS_PHASE_BYTES			0
+#define MC_STATS_PHASE_LATENCY			1
+#define MC_STATS_PHASES				2
+
+#define RD					0
+#define WR					1
+
+/*
+ * Client ids as in the mcerr client table: reads are 0-39, writes 40-73,
+ * and from 74 on each client has a read and a write id in turn. T11x
+ * sdmmc has no MC client of its own and is seen through the AHB clients,
+ * which it shares with the other AHB masters.
+ */
+static const u8 display_rd[] = { 1, 2, 3, 4, 5, 6, 16, 17 };
+static const u8 gr3d_rd[] = { 18, 19, 24, 32, 78, 80 };
+static const u8 gr3d_wr[] = { 51, 52, 79, 81 };
+static const u8 cpu_rd[] = { 38, 39 };
+static const u8 cpu_wr[] = { 56, 57 };
+static const u8 avp_rd[] = { 15 };
+static const u8 avp_wr[] = { 50 };
+static const u8 vi_wr[] = { 44, 45, 46, 47 };
+static const u8 usb_rd[] = { 74, 76 };
+static const u8 usb_wr[] = { 75, 77 };
+static const u8 sdmmc_rd[] = { 29, 30 };
+static const u8 sdmmc_wr[] = { 59, 60 };
+
+#define GROUP(_g, _name, _rd, _nr_rd, _wr, _nr_wr)			\
+	[TEGRA_MC_STATS_##_g] = {					\
+		.name	= _name,					\
+		.ids	= { _rd, _wr },					\
+		.nr	= { _nr_rd, _nr_wr },				\
+	}
+
+static const struct mc_stats_group {
+	const char	*name;
+	const u8	*ids[2];
+	int		nr[2];
+} mc_stats_groups[TEGRA_MC_STATS_GROUPS] = {
+	GROUP(DISPLAY, "display", display_rd, ARRAY_SIZE(display_rd),
+	      NULL, 0),
+	GROUP(GR3D, "gr3d", gr3d_rd, ARRAY_SIZE(gr3d_rd),
+	      gr3d_wr, ARRAY_SIZE(gr3d_wr)),
+	GROUP(CPU, "cpu", cpu_rd, ARRAY_SIZE(cpu_rd),
+	      cpu_wr, ARRAY_SIZE(cpu_wr)),
+	GROUP(AVP, "avp", avp_rd, ARRAY_SIZE(avp_rd),
+	      avp_wr, ARRAY_SIZE(avp_wr)),
+	GROUP(VI, "vi", NULL, 0, vi_wr, ARRAY_SIZE(vi_wr)),
+	GROUP(USB, "usb", usb_rd, ARRAY_SIZE(usb_rd),
+	      usb_wr, ARRAY_SIZE(usb_wr)),
+	GROUP(SDMMC, "sdmmc", sdmmc_rd, ARRAY_SIZE(sdmmc_rd),
+	      sdmmc_wr, ARRAY_SIZE(sdmmc_wr)),
+};
+
+/* what one pass over the groups counted */
+struct mc_stats_count {
+	u64	bytes[2];
+	u32	requests[2];
+	u64	latency_ns[2];
+	u32	bytes_us;		/* length of the byte window */
+};
+
+struct mc_stats_sample {
+	unsigned long			stamp;		/* jiffies */
+	struct tegra_mc_client_stats	client[TEGRA_MC_STATS_GROUPS];
+};
+
+static struct {
+	struct mutex		lock;
+	void __iomem		*base;
+	struct clk		*emc;
+	struct delayed_work	work;
+
+	unsigned int		sample_ms;	/* 0: not sampling */
+	unsigned int		window_ms;
+
+	/* pass in progress */
+	int			group;
+	int			phase;
+	ktime_t			start;
+	unsigned long		pass_start;
+	struct mc_stats_count	count[TEGRA_MC_STATS_GROUPS];
+
+	int			head;
+	int			nr_samples;
+	struct mc_stats_sample	sample[MC_STATS_SAMPLES];
+} mc_stats = {
+	.sample_ms	= MC_STATS_SAMPLE_MS,
+	.window_ms	= MC_STATS_WINDOW_MS,
+};
+
+static inline u32 mc_stats_readl(unsigned long offs)
+{
+	return readl(mc_stats.base + offs);
+}
+
+static inline void mc_stats_writel(u32 val, unsigned long offs)
+{
+	writel(val, mc_stats.base + offs);
+}
+
+static void mc_stats_gather(u32 op)
+{
+	mc_stats_writel(op << MC_STAT_CONTROL_EMC_GATHER_SHIFT,
+			MC_STAT_CONTROL);
+}
+
+/* Point both filter sets at the current group and start counting */
+static void mc_stats_start(void)
+{
+	const struct mc_stats_group *g = &mc_stats_groups[mc_stats.group];
+	u32 misc = MC_STAT_SET_MISC_FILTER_CLIENT;
+	int dir, i;
+
+	if (mc_stats.phase == MC_STATS_PHASE_LATENCY)
+		misc |= MC_STAT_SET_MISC_EVENT_REQUESTS;
+	else
+		misc |= MC_STAT_SET_MISC_EVENT_ATOMS;
+
+	mc_stats_gather(MC_STAT_CONTROL_EMC_GATHER_DISABLE);
+	mc_stats_gather(MC_STAT_CONTROL_EMC_GATHER_CLEAR);
+
+	for (dir = RD; dir <= WR; dir++) {
+		unsigned long set = MC_STAT_EMC_SET(dir);
+		u32 mask[MC_STAT_CLIENT_WORDS] = { 0 };
+
+		for (i = 0; i < g->nr[dir]; i++) {
+			u8 id = g->ids[dir][i];
+
+			mask[id / 32] |= 1U << (id % 32);
+		}
+
+		mc_stats_writel(0, set + MC_STAT_SET_ADR_LIMIT_LO);
+		mc_stats_writel(~0, set + MC_STAT_SET_ADR_LIMIT_HI);
+		mc_stats_writel(misc, set + MC_STAT_SET_MISC);
+		for (i = 0; i < MC_STAT_CLIENT_WORDS; i++)
+			mc_stats_writel(mask[i], set + MC_STAT_SET_CLIENT(i));
+	}
+	mc_stats_writel(~0, MC_STAT_EMC_CLOCK_LIMIT);
+
+	mc_stats.start = ktime_get();
+	mc_stats_gather(MC_STAT_CONTROL_EMC_GATHER_ENABLE);
+}
+
+/* Stop counting and add the window to the current group's count */
+static void mc_stats_stop(void)
+{
+	struct mc_stats_count *c = &mc_stats.count[mc_stats.group];
+	unsigned long emc_khz;
+	s64 us;
+	int dir;
+
+	mc_stats_gather(MC_STAT_CONTROL_EMC_GATHER_DISABLE);
+	us = ktime_us_delta(ktime_get(), mc_stats.start);
+	emc_khz = clk_get_rate(mc_stats.emc) / 1000 ? : 1;
+
+	for (dir = RD; dir <= WR; dir++) {
+		unsigned long set = MC_STAT_EMC_SET(dir);
+		u32 count = mc_stats_readl(set + MC_STAT_SET_COUNT);
+		u64 clocks;
+
+		if (mc_stats.phase == MC_STATS_PHASE_BYTES) {
+			c->bytes[dir] = (u64)count * MC_STAT_ATOM_BYTES;
+			continue;
+		}
+
+		clocks = mc_stats_readl(set + MC_STAT_SET_LATENCY);
+		c->requests[dir] = count;
+		c->latency_ns[dir] = div_u64(clocks * 1000000, emc_khz);
+	}
+
+	if (mc_stats.phase == MC_STATS_PHASE_BYTES)
+		c->bytes_us = max_t(s64, us, 1);
+}
+
+/* Turn the counts of a complete pass into a sample */
+static void mc_stats_commit(void)
+{
+	struct mc_stats_sample *smp = &mc_stats.sample[mc_stats.head];
+	int i, dir;
+
+	smp->stamp = mc_stats.pass_start;
+	for (i = 0; i < TEGRA_MC_STATS_GROUPS; i++) {
+		struct mc_stats_count *c = &mc_stats.count[i];
+		struct tegra_mc_client_stats *cs = &smp->client[i];
+
+		for (dir = RD; dir <= WR; dir++) {
+			u64 kbps = div_u64(c->bytes[dir] * 1000, c->bytes_us);
+			u32 ns = 0;
+
+			if (c->requests[dir])
+				ns = div_u64(c->latency_ns[dir],
+					     c->requests[dir]);
+			cs->bw_kbps[dir] = min_t(u64, kbps, UINT_MAX);
+			cs->latency_ns[dir] = ns;
+		}
+	}
+
+	mc_stats.head = (mc_stats.head + 1) % MC_STATS_SAMPLES;
+	if (mc_stats.nr_samples < MC_STATS_SAMPLES)
+		mc_stats.nr_samples++;
+}
+
+static void mc_stats_work_func(struct work_struct *work)
+{
+	unsigned long next;
+
+	mutex_lock(&mc_stats.lock);
+	if (!mc_stats.sample_ms)
+		goto out;
+
+	if (mc_stats.group >= 0) {
+		mc_stats_stop();
+		if (++mc_stats.phase == MC_STATS_PHASES) {
+			mc_stats.phase = 0;
+			mc_stats.group++;
+		}
+	}
+
+	if (mc_stats.group == TEGRA_MC_STATS_GROUPS) {
+		/* pass done: wait out the rest of the sample period */
+		mc_stats_commit();
+		mc_stats.group = -1;
+		next = mc_stats.pass_start +
+			msecs_to_jiffies(mc_stats.sample_ms);
+		next = time_after(next, jiffies) ? next - jiffies : 0;
+		queue_delayed_work(system_freezable_wq, &mc_stats.work, next);
+		goto out;
+	}
+
+	if (mc_stats.group < 0) {
+		mc_stats.group = 0;
+		mc_stats.phase = 0;
+		mc_stats.pass_start = jiffies;
+	}
+	mc_stats_start();
+	queue_delayed_work(system_freezable_wq, &mc_stats.work,
+			   msecs_to_jiffies(mc_stats.window_ms));
+out:
+	mutex_unlock(&mc_stats.lock);
+}
+
+int tegra_mc_stats_get(enum tegra_mc_stats_group group,
+		       struct tegra_mc_client_stats *stats)
+{
+	int last, ret = 0;
+
+	if (group < 0 || group >= TEGRA_MC_STATS_GROUPS)
+		return -EINVAL;
+	if (!mc_stats.base)
+		return -ENODEV;
+
+	mutex_lock(&mc_stats.lock);
+	if (!mc_stats.nr_samples) {
+		ret = -EAGAIN;
+	} else {
+		last = (mc_stats.head + MC_STATS_SAMPLES - 1) %
+			MC_STATS_SAMPLES;
+		*stats = mc_stats.sample[last].client[group];
+	}
+	mutex_unlock(&mc_stats.lock);
+	return ret;
+}
+EXPORT_SYMBOL(tegra_mc_stats_get);
+
+#ifdef CONFIG_DEBUG_FS
+static int mc_stats_clients_show(struct seq_file *s, void *data)
+{
+	struct tegra_mc_client_stats *cs;
+	int i, last;
+
+	seq_printf(s, "%-8s %10s %10s %10s %10s\n", "client",
+		   "rd KB/s", "wr KB/s", "rd ns", "wr ns");
+
+	mutex_lock(&mc_stats.lock);
+	if (mc_stats.nr_samples) {
+		last = (mc_stats.head + MC_STATS_SAMPLES - 1) %
+			MC_STATS_SAMPLES;
+		for (i = 0; i < TEGRA_MC_STATS_GROUPS; i++) {
+			cs = &mc_stats.sample[last].client[i];
+			seq_printf(s, "%-8s %10u %10u %10u %10u\n",
+				   mc_stats_groups[i].name,
+				   cs->bw_kbps[RD], cs->bw_kbps[WR],
+				   cs->latency_ns[RD], cs->latency_ns[WR]);
+		}
+	}
+	mutex_unlock(&mc_stats.lock);
+	return 0;
+}
+
+static int mc_stats_clients_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mc_stats_clients_show, inode->i_private);
+}
+
+static const struct file_operations mc_stats_clients_fops = {
+	.open		= mc_stats_clients_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* one line per sample: read and write KB/s of each group */
+static int mc_stats_samples_show(struct seq_file *s, void *data)
+{
+	struct mc_stats_sample *smp;
+	int i, n, left;
+
+	seq_printf(s, "%-10s", "ms");
+	for (i = 0; i < TEGRA_MC_STATS_GROUPS; i++)
+		seq_printf(s, " %8s-rd %8s-wr", mc_stats_groups[i].name,
+			   mc_stats_groups[i].name);
+	seq_printf(s, "\n");
+
+	mutex_lock(&mc_stats.lock);
+	n = (mc_stats.head + MC_STATS_SAMPLES - mc_stats.nr_samples) %
+		MC_STATS_SAMPLES;
+	for (left = mc_stats.nr_samples; left; left--) {
+		smp = &mc_stats.sample[n];
+		seq_printf(s, "%-10u", jiffies_to_msecs(smp->stamp));
+		for (i = 0; i < TEGRA_MC_STATS_GROUPS; i++)
+			seq_printf(s, " %11u %11u", smp->client[i].bw_kbps[RD],
+				   smp->client[i].bw_kbps[WR]);
+		seq_printf(s, "\n");
+		n = (n + 1) % MC_STATS_SAMPLES;
+	}
+	mutex_unlock(&mc_stats.lock);
+	return 0;
+}
+
+static int mc_stats_samples_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mc_stats_samples_show, inode->i_private);
+}
+
+static const struct file_operations mc_stats_samples_fops = {
+	.open		= mc_stats_samples_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int param_get(void *data, u64 *val)
+{
+	*val = *(unsigned int *)data;
+	return 0;
+}
+static int param_set(void *data, u64 val)
+{
+	if (val > 60000 || (!val && (data == &mc_stats.window_ms)))
+		return -EINVAL;
+
+	cancel_delayed_work_sync(&mc_stats.work);
+
+	mutex_lock(&mc_stats.lock);
+	*(unsigned int *)data = val;
+	if (mc_stats.group >= 0)
+		mc_stats_gather(MC_STAT_CONTROL_EMC_GATHER_DISABLE);
+	mc_stats.group = -1;
+	if (mc_stats.sample_ms)
+		queue_delayed_work(system_freezable_wq, &mc_stats.work, 0);
+	mutex_unlock(&mc_stats.lock);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(param_fops, param_get, param_set, "%llu\n");
+
+static int __init mc_stats_debug_init(void)
+{
+	struct dentry *dir;
+
+	if (!mc_stats.base)
+		return 0;
+
+	dir = debugfs_create_dir("tegra_mc_stats", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("clients", S_IRUGO, dir, NULL,
+				 &mc_stats_clients_fops))
+		goto err_out;
+
+	if (!debugfs_create_file("samples", S_IRUGO, dir, NULL,
+				 &mc_stats_samples_fops))
+		goto err_out;
+
+	if (!debugfs_create_file("sample_ms", S_IRUGO | S_IWUSR, dir,
+				 &mc_stats.sample_ms, &param_fops))
+		goto err_out;
+
+	if (!debugfs_create_file("window_ms", S_IRUGO | S_IWUSR, dir,
+				 &mc_stats.window_ms, &param_fops))
+		goto err_out;
+
+	return 0;
+
+err_out:
+	debugfs_remove_recursive(dir);
+	return -ENOMEM;
+}
+late_initcall(mc_stats_debug_init);
+#endif
+
+static int __init mc_stats_init(void)
+{
+	mutex_init(&mc_stats.lock);
+	INIT_DELAYED_WORK(&mc_stats.work, mc_stats_work_func);
+	mc_stats.group = -1;
+
+	mc_stats.emc = tegra_get_clock_by_name("emc");
+	if (!mc_stats.emc) {
+		pr_err("no emc clock\n");
+		return -ENODEV;
+	}
+
+	mc_stats.base = IO_ADDRESS(TEGRA_MC_BASE);
+	if (mc_stats.sample_ms)
+		queue_delayed_work(system_freezable_wq, &mc_stats.work, 0);
+	return 0;
+}
+subsys_initcall(mc_stats_init);
@@ -24,6 +24,7 @@
 #include <linux/io.h>
 #include <linux/moduleparam.h>
 #include <linux/seq_file.h>
+#include <linux/suspend.h>
 #include <linux/syscore_ops.h>
 
 #include <mach/iomap.h>
@@ -54,6 +55,37 @@ static int tegra_prevent_lp0;
 
 static unsigned int tegra_wake_irq_count[PMC_MAX_WAKE_COUNT];
 
+/*
+ * Wake attribution: each full resume is charged to the first wake that
+ * caused it, together with the time until the next suspend began and the
+ * wakeup source that was active the longest in that time.
+ */
+static struct {
+	u64 awake_ms;
+	unsigned int filtered;
+	unsigned int last_awake_ms;
+	unsigned int last_held_ms;
+	char last_holder[32];
+} tegra_wake_stats[PMC_MAX_WAKE_COUNT];
+
+static u64 tegra_wake_status_last;
+static int tegra_wake_current = -1;
+static ktime_t tegra_wake_resume_time;
+
+/*
+ * Wakes listed here are benign: when nothing else woke us and no wakeup
+ * event is in progress once their handlers have run, the system goes
+ * straight back to sleep without resuming the full device tree.
+ */
+#define TEGRA_WAKE_FILTER_MAX		8
+#define TEGRA_WAKE_FILTER_MAX_RETRIES	64
+
+static int wake_filter[TEGRA_WAKE_FILTER_MAX];
+static int wake_filter_count;
+module_param_array(wake_filter, int, &wake_filter_count, S_IRUGO | S_IWUSR);
+
+static unsigned int tegra_wake_filter_retries;
+
 static bool debug_lp0;
 module_param(debug_lp0, bool, S_IRUGO | S_IWUSR);
 
@@ -228,6 +260,8 @@ static void tegra_pm_irq_syscore_resume(void)
 {
 	unsigned long long wake_status = read_pmc_wake_status();
 
+	tegra_wake_status_last = wake_status;
+
 	pr_info(" legacy wake status=0x%x\n", (u32)wake_status);
 	tegra_pm_irq_syscore_resume_helper((unsigned long)wake_status, 0);
 #ifndef CONFIG_ARCH_TEGRA_2x_SOC
@@ -290,6 +324,80 @@ static int tegra_pm_irq_syscore_suspend(void)
 	return 0;
 }
 
+static u64 tegra_wake_filter_mask(void)
+{
+	u64 mask = 0;
+	int i;
+
+	for (i = 0; i < wake_filter_count; i++)
+		if (wake_filter[i] >= 0 && wake_filter[i] < PMC_MAX_WAKE_COUNT)
+			mask |= 1ull << wake_filter[i];
+	return mask;
+}
+
+/*
+ * Called from the platform suspend_again hook, after the wake handlers
+ * ran and before the devices are fully resumed.
+ */
+bool tegra_pm_irq_wake_filtered(void)
+{
+	u64 status = tegra_wake_status_last;
+	unsigned int count;
+	int wake;
+
+	if (!status || (status & ~tegra_wake_filter_mask()))
+		goto resume;
+
+	/* a level wake that stays asserted must not keep us looping */
+	if (tegra_wake_filter_retries >= TEGRA_WAKE_FILTER_MAX_RETRIES)
+		goto resume;
+
+	/* a handler that reported a wakeup event wants it processed */
+	if (!pm_get_wakeup_count(&count, false) || !pm_save_wakeup_count(count))
+		goto resume;
+
+	for (wake = 0; wake < PMC_MAX_WAKE_COUNT; wake++)
+		if (status & (1ull << wake))
+			tegra_wake_stats[wake].filtered++;
+	tegra_wake_filter_retries++;
+	return true;
+
+resume:
+	tegra_wake_filter_retries = 0;
+	return false;
+}
+
+/* The system has woken and is resuming; start charging the wake. */
+void tegra_pm_irq_wake_begin(void)
+{
+	u64 status = tegra_wake_status_last;
+
+	tegra_wake_current = status ? __ffs64(status) : -1;
+	tegra_wake_resume_time = ktime_get();
+	pm_wakeup_attribution_start();
+}
+
+/* The next suspend is starting; close the wake's accounting. */
+void tegra_pm_irq_wake_end(void)
+{
+	int wake = tegra_wake_current;
+	unsigned int awake_ms;
+	ktime_t held;
+
+	if (wake < 0)
+		return;
+
+	awake_ms = ktime_to_ms(ktime_sub(ktime_get(), tegra_wake_resume_time));
+	tegra_wake_stats[wake].awake_ms += awake_ms;
+	tegra_wake_stats[wake].last_awake_ms = awake_ms;
+
+	held = pm_wakeup_attribution_end(tegra_wake_stats[wake].last_holder,
+				sizeof(tegra_wake_stats[wake].last_holder));
+	tegra_wake_stats[wake].last_held_ms = ktime_to_ms(held);
+
+	tegra_wake_current = -1;
+}
+
 static struct syscore_ops tegra_pm_irq_syscore_ops = {
 	.suspend = tegra_pm_irq_syscore_suspend,
 	.resume = tegra_pm_irq_syscore_resume,
@@ -311,8 +419,10 @@ static int tegra_pm_irq_debug_show(struct seq_file *s, void *data)
 	struct irq_desc *desc;
 	const char *irq_name;
 
-	seq_printf(s, "wake  irq  count  name\n");
-	seq_printf(s, "----------------------\n");
+	seq_printf(s, "wake  irq  count  filtered  awake_ms  last_ms  "
+		      "held_ms  holder  name\n");
+	seq_printf(s, "-----------------------------------------------"
+		      "--------------------\n");
 	for (wake = 0; wake < PMC_MAX_WAKE_COUNT; wake++) {
 		irq = tegra_wake_to_irq(wake);
 		if (irq < 0)
@@ -325,8 +435,15 @@ static int tegra_pm_irq_debug_show(struct seq_file *s, void *data)
 		irq_name = (desc->action && desc->action->name) ?
 			desc->action->name : "???";
 
-		seq_printf(s, "%4d  %3d  %5d  %s\n",
-			wake, irq, tegra_wake_irq_count[wake], irq_name);
+		seq_printf(s, "%4d  %3d  %5d  %8u  %8llu  %7u  %7u  %s  %s\n",
+			wake, irq, tegra_wake_irq_count[wake],
+			tegra_wake_stats[wake].filtered,
+			tegra_wake_stats[wake].awake_ms,
+			tegra_wake_stats[wake].last_awake_ms,
+			tegra_wake_stats[wake].last_held_ms,
+			tegra_wake_stats[wake].last_holder[0] ?
+				tegra_wake_stats[wake].last_holder : "-",
+			irq_name);
 	}
 	return 0;
 }
@@ -29,6 +29,9 @@ int tegra_gpio_to_wake(int gpio);
 int tegra_irq_to_wake(int irq);
 int tegra_wake_to_irq(int wake);
 int tegra_disable_wake_source(int wake);
+bool tegra_pm_irq_wake_filtered(void);
+void tegra_pm_irq_wake_begin(void);
+void tegra_pm_irq_wake_end(void);
 #else
 static inline int tegra_set_wake_gpio(unsigned int wake, int gpio)
 {
@@ -54,6 +57,12 @@ static inline int tegra_disable_wake_source(int wake)
 {
 	return 0;
 }
+static inline bool tegra_pm_irq_wake_filtered(void)
+{
+	return false;
+}
+static inline void tegra_pm_irq_wake_begin(void) {}
+static inline void tegra_pm_irq_wake_end(void) {}
 #endif
 void tegra_set_usb_wake_source(void);
 #endif
@@ -45,6 +45,7 @@
 #include <linux/pm_qos.h>
 #include <linux/export.h>
 #include <linux/tegra_audio.h>
+#include <linux/alarmtimer.h>
 
 #include <trace/events/power.h>
 #include <trace/events/nvsecurity.h>
@@ -123,6 +124,16 @@ static u64 resume_time;
 static u64 resume_entry_time;
 static u64 suspend_time;
 static u64 suspend_entry_time;
+
+/*
+ * Quick-wake standby: when LP0 is selected but the system is expected to
+ * sleep for less than lp1_auto_ms, suspend to LP1 instead. DRAM still
+ * goes to self-refresh and the G cluster is power-gated, but the core
+ * rail stays up, so resume skips the boot ROM and warmboot code.
+ */
+static unsigned int lp1_auto_ms;
+static unsigned long tegra_last_sleep_ms;
+static enum tegra_suspend_mode tegra_lp1_auto_saved_mode = TEGRA_SUSPEND_NONE;
 #endif
 
 struct suspend_context tegra_sctx;
@@ -236,13 +247,57 @@ static const char *tegra_suspend_name[TEGRA_MAX_SUSPEND_MODE] = {
 	[TEGRA_SUSPEND_LP0]	= "lp0",
 };
 
+/*
+ * Platform side of the last resume, in usecs since resume_entry_time: on
+ * LP0 the us timer restarts at wake, so the first mark includes the boot
+ * ROM and warmboot code. Per-device numbers are in debugfs pm_resume_times.
+ */
+enum tegra_resume_mark {
+	TEGRA_RESUME_MARK_CPU,
+	TEGRA_RESUME_MARK_MC,
+	TEGRA_RESUME_MARK_CORE,
+	TEGRA_RESUME_MARK_FINISH,
+	TEGRA_RESUME_MARK_DISPLAY,
+	TEGRA_RESUME_MARKS,
+};
+
+static const char *tegra_resume_mark_name[TEGRA_RESUME_MARKS] = {
+	[TEGRA_RESUME_MARK_CPU]		= "cpu",
+	[TEGRA_RESUME_MARK_MC]		= "mc",
+	[TEGRA_RESUME_MARK_CORE]	= "core",
+	[TEGRA_RESUME_MARK_FINISH]	= "devices_early",
+	[TEGRA_RESUME_MARK_DISPLAY]	= "display",
+};
+
+static u32 tegra_resume_marks[TEGRA_RESUME_MARKS];
+static enum tegra_suspend_mode tegra_resume_marks_mode;
+static bool tegra_resume_profiling;	/* system suspend, not idle LP1 */
+static bool tegra_resume_display_pending;
+
+static u32 tegra_resume_elapsed(void)
+{
+	u64 now = readl(tmrus_reg_base + TIMERUS_CNTR_1US);
+
+	if (resume_entry_time > now)
+		now |= 1ull<<32;
+	return now - resume_entry_time;
+}
+
+static void tegra_resume_mark(enum tegra_resume_mark mark)
+{
+	if (tegra_resume_profiling)
+		tegra_resume_marks[mark] = tegra_resume_elapsed();
+}
+
 void tegra_log_resume_time(void)
 {
-	u64 resume_end_time = readl(tmrus_reg_base + TIMERUS_CNTR_1US);
+	resume_time = tegra_resume_elapsed();
 
-	if (resume_entry_time > resume_end_time)
-		resume_end_time |= 1ull<<32;
-	resume_time = resume_end_time - resume_entry_time;
+	/* the panel is also enabled on unblank, only take the first one */
+	if (tegra_resume_display_pending) {
+		tegra_resume_marks[TEGRA_RESUME_MARK_DISPLAY] = resume_time;
+		tegra_resume_display_pending = false;
+	}
 }
 
 void tegra_log_suspend_time(void)
@@ -895,6 +950,11 @@ static int tegra_suspend_enter(suspend_state_t state)
 
 	read_persistent_clock(&ts_entry);
 
+	memset(tegra_resume_marks, 0, sizeof(tegra_resume_marks));
+	tegra_resume_marks_mode = current_suspend_mode;
+	tegra_resume_display_pending = false;
+	tegra_resume_profiling = true;
+
 	ret = tegra_suspend_dram(current_suspend_mode, 0);
 	if (ret) {
 		pr_info("Aborting suspend, tegra_suspend_dram error=%d\n", ret);
@@ -903,8 +963,10 @@ static int tegra_suspend_enter(suspend_state_t state)
 
 	read_persistent_clock(&ts_exit);
 
+	tegra_last_sleep_ms = 0;
 	if (timespec_compare(&ts_exit, &ts_entry) > 0) {
 		delta = timespec_to_ktime(timespec_sub(ts_exit, ts_entry));
+		tegra_last_sleep_ms = ktime_to_ms(delta);
 
 		tegra_dvfs_rail_pause(tegra_cpu_rail, delta, false);
 		if (current_suspend_mode == TEGRA_SUSPEND_LP0)
@@ -1030,6 +1092,7 @@ int tegra_suspend_dram(enum tegra_suspend_mode mode, unsigned int flags)
 	resume_entry_time = 0;
 	if (mode != TEGRA_SUSPEND_LP0)
 		resume_entry_time = readl(tmrus_reg_base + TIMERUS_CNTR_1US);
+	tegra_resume_mark(TEGRA_RESUME_MARK_CPU);
 
 	tegra_init_cache(true);
 
@@ -1060,6 +1123,7 @@ int tegra_suspend_dram(enum tegra_suspend_mode mode, unsigned int flags)
 		tegra_cpu_reset_handler_restore();
 		tegra_lp0_resume_mc();
 		tegra_tsc_wait_for_resume();
+		tegra_resume_mark(TEGRA_RESUME_MARK_MC);
 	} else if (mode == TEGRA_SUSPEND_LP1)
 		*iram_cpu_lp1_mask = 0;
 
@@ -1089,6 +1153,7 @@ int tegra_suspend_dram(enum tegra_suspend_mode mode, unsigned int flags)
 	local_fiq_enable();
 
 	tegra_common_resume();
+	tegra_resume_mark(TEGRA_RESUME_MARK_CORE);
 
 fail:
 	return err;
@@ -1100,8 +1165,34 @@ fail:
 void (*tegra_deep_sleep)(int);
 EXPORT_SYMBOL(tegra_deep_sleep);
 
+/*
+ * The next alarm bounds the sleep, but user input (e.g. a gamepad) can
+ * wake us at any time: take the last sleep length as the other estimate.
+ */
+static bool tegra_expect_short_sleep(void)
+{
+	ktime_t alarm = alarmtimer_get_sleep_length();
+
+	if (alarm.tv64 && ktime_to_ms(alarm) < lp1_auto_ms)
+		return true;
+	return tegra_last_sleep_ms && tegra_last_sleep_ms < lp1_auto_ms;
+}
+
+static int tegra_suspend_begin(suspend_state_t state)
+{
+	tegra_pm_irq_wake_end();
+	return 0;
+}
+
 static int tegra_suspend_prepare(void)
 {
+	if (current_suspend_mode == TEGRA_SUSPEND_LP0 && lp1_auto_ms &&
+	    tegra_expect_short_sleep()) {
+		tegra_lp1_auto_saved_mode = current_suspend_mode;
+		current_suspend_mode = TEGRA_SUSPEND_LP1;
+		pr_info("Tegra: short sleep expected, using LP1\n");
+	}
+
 	if ((current_suspend_mode == TEGRA_SUSPEND_LP0) && tegra_deep_sleep)
 		tegra_deep_sleep(1);
 	return 0;
@@ -1109,6 +1200,12 @@ static int tegra_suspend_prepare(void)
 
 static void tegra_suspend_finish(void)
 {
+	if (tegra_resume_profiling) {
+		tegra_resume_mark(TEGRA_RESUME_MARK_FINISH);
+		tegra_resume_profiling = false;
+		tegra_resume_display_pending = true;
+	}
+
 	if (pdata && pdata->cpu_resume_boost) {
 		int ret = tegra_suspended_target(pdata->cpu_resume_boost);
 		pr_info("Tegra: resume CPU boost to %u KHz: %s (%d)\n",
@@ -1117,15 +1214,29 @@ static void tegra_suspend_finish(void)
 
 	if ((current_suspend_mode == TEGRA_SUSPEND_LP0) && tegra_deep_sleep)
 		tegra_deep_sleep(0);
+
+	if (tegra_lp1_auto_saved_mode != TEGRA_SUSPEND_NONE) {
+		current_suspend_mode = tegra_lp1_auto_saved_mode;
+		tegra_lp1_auto_saved_mode = TEGRA_SUSPEND_NONE;
+	}
+
+	tegra_pm_irq_wake_begin();
+}
+
+static bool tegra_suspend_again(void)
+{
+	return tegra_pm_irq_wake_filtered();
 }
 
 static const struct platform_suspend_ops tegra_suspend_ops = {
 	.valid		= suspend_valid_only_mem,
+	.begin		= tegra_suspend_begin,
 	.prepare	= tegra_suspend_prepare,
 	.finish		= tegra_suspend_finish,
 	.prepare_late	= tegra_suspend_prepare_late,
 	.wake		= tegra_suspend_wake,
 	.enter		= tegra_suspend_enter,
+	.suspend_again	= tegra_suspend_again,
 };
 
 static ssize_t suspend_mode_show(struct kobject *kobj,
@@ -1197,20 +1308,83 @@ static ssize_t suspend_time_show(struct kobject *kobj,
 static struct kobj_attribute suspend_time_attribute =
 	__ATTR(suspend_time, 0444, suspend_time_show, 0);
 
+static ssize_t lp1_auto_ms_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", lp1_auto_ms);
+}
+
+static ssize_t lp1_auto_ms_store(struct kobject *kobj,
+				 struct kobj_attribute *attr,
+				 const char *buf, size_t n)
+{
+	unsigned int val;
+
+	if (kstrtouint(buf, 0, &val))
+		return -EINVAL;
+
+	lp1_auto_ms = val;
+	return n;
+}
+
+static struct kobj_attribute lp1_auto_ms_attribute =
+	__ATTR(lp1_auto_ms, 0644, lp1_auto_ms_show, lp1_auto_ms_store);
+
+#ifdef CONFIG_DEBUG_FS
+static int tegra_resume_profile_show(struct seq_file *s, void *data)
+{
+	int i;
+
+	seq_printf(s, "mode: %s\n",
+		   tegra_suspend_name[tegra_resume_marks_mode]);
+	for (i = 0; i < TEGRA_RESUME_MARKS; i++)
+		seq_printf(s, "%-16s %10u\n", tegra_resume_mark_name[i],
+			   tegra_resume_marks[i]);
+	return 0;
+}
+
+static int tegra_resume_profile_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_resume_profile_show, inode->i_private);
+}
+
+static const struct file_operations tegra_resume_profile_fops = {
+	.open		= tegra_resume_profile_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_resume_profile_debugfs_init(void)
+{
+	if (!debugfs_create_file("tegra_resume_profile", S_IRUGO, NULL, NULL,
+				 &tegra_resume_profile_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(tegra_resume_profile_debugfs_init);
+#endif
+
 static struct kobject *suspend_kobj;
 
 static int tegra_pm_enter_suspend(void)
 {
 	pr_info("Entering suspend state %s\n", lp_state[current_suspend_mode]);
 	suspend_cpu_dfll_mode();
-	if (current_suspend_mode == TEGRA_SUSPEND_LP0)
+	/*
+	 * Both LP0 and LP1 sleep on the LP cluster, so the G cluster and
+	 * its DFLL are off and out of the resume path.
+	 */
+	if (current_suspend_mode == TEGRA_SUSPEND_LP0 ||
+	    current_suspend_mode == TEGRA_SUSPEND_LP1)
 		tegra_lp0_cpu_mode(true);
 	return 0;
 }
 
 static void tegra_pm_enter_resume(void)
 {
-	if (current_suspend_mode == TEGRA_SUSPEND_LP0)
+	if (current_suspend_mode == TEGRA_SUSPEND_LP0 ||
+	    current_suspend_mode == TEGRA_SUSPEND_LP1)
 		tegra_lp0_cpu_mode(false);
 	resume_cpu_dfll_mode();
 	pr_info("Exited suspend state %s\n", lp_state[current_suspend_mode]);
@@ -1401,6 +1575,10 @@ out:
 					&suspend_time_attribute.attr))
 			pr_err("%s: sysfs_create_file suspend_time failed!\n",
 								__func__);
+		if (sysfs_create_file(suspend_kobj, \
+					&lp1_auto_ms_attribute.attr))
+			pr_err("%s: sysfs_create_file lp1_auto_ms failed!\n",
+								__func__);
 	}
 
 	iram_cpu_lp2_mask = tegra_cpu_lp2_mask;
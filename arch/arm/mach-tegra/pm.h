@@ -198,6 +198,8 @@ unsigned long tegra2_lp2_timer_remain(void);
 void tegra3_lp2_set_trigger(unsigned long cycles);
 unsigned long tegra3_lp2_timer_remain(void);
 int tegra3_is_cpu_wake_timer_ready(unsigned int cpu);
+void tegra3_lp2_timer_restart_secondary(unsigned int cpu, s64 us);
+void tegra3_lp2_local_timer_restart(void);
 void tegra3_lp2_timer_cancel_secondary(void);
 #endif
 
@@ -242,6 +244,13 @@ static inline void tegra_pd_timer_cancel_secondary(void)
 #endif
 }
 
+static inline void tegra_pd_timer_restart_secondary(unsigned int cpu, s64 us)
+{
+#ifndef CONFIG_ARCH_TEGRA_2x_SOC
+	tegra3_lp2_timer_restart_secondary(cpu, us);
+#endif
+}
+
 #if DEBUG_CLUSTER_SWITCH && 0 /* !!!FIXME!!! THIS IS BROKEN */
 extern unsigned int tegra_cluster_debug;
 #define DEBUG_CLUSTER(x) do { if (tegra_cluster_debug) printk x; } while (0)
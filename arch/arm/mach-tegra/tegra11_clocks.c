@@ -37,6 +37,8 @@
 #include <mach/hardware.h>
 #include <mach/mc.h>
 
+#include <trace/events/nvpower.h>
+
 #include "clock.h"
 #include "fuse.h"
 #include "dvfs.h"
@@ -1225,6 +1227,7 @@ back_to_dfll:
 
 static int tegra11_cpu_clk_set_rate(struct clk *c, unsigned long rate)
 {
+	int ret;
 	unsigned long old_rate = clk_get_rate_locked(c);
 	bool has_dfll = c->u.cpu.dynamic &&
 		(c->u.cpu.dynamic->state != UNINITIALIZED);
@@ -1243,13 +1246,20 @@ static int tegra11_cpu_clk_set_rate(struct clk *c, unsigned long rate)
 		}
 	}
 #endif
-	if (has_dfll && c->dvfs && c->dvfs->dvfs_rail) {
-		if (tegra_dvfs_is_dfll_range(c->dvfs, rate))
-			return tegra11_cpu_clk_dfll_on(c, rate, old_rate);
-		else if (is_dfll)
-			return tegra11_cpu_clk_dfll_off(c, rate, old_rate);
-	}
-	return tegra11_cpu_clk_set_plls(c, rate, old_rate);
+	if (has_dfll && c->dvfs && c->dvfs->dvfs_rail &&
+	    tegra_dvfs_is_dfll_range(c->dvfs, rate))
+		ret = tegra11_cpu_clk_dfll_on(c, rate, old_rate);
+	else if (has_dfll && c->dvfs && c->dvfs->dvfs_rail && is_dfll)
+		ret = tegra11_cpu_clk_dfll_off(c, rate, old_rate);
+	else
+		ret = tegra11_cpu_clk_set_plls(c, rate, old_rate);
+
+	if (!ret)
+		trace_nvcpu_freq(NVPOWER_CPU_FREQ_SWITCH,
+			c->parent->parent == c->u.cpu.dynamic ?
+				NVPOWER_CPU_FREQ_DFLL : NVPOWER_CPU_FREQ_PLL,
+			old_rate / 1000, rate / 1000);
+	return ret;
 }
 
 static long tegra11_cpu_clk_round_rate(struct clk *c, unsigned long rate)
@@ -6785,10 +6795,12 @@ struct clk tegra_list_clks[] = {
 	SHARED_CLK("sdmmc4.emc", "sdhci-tegra.3",	"emc",	&tegra_clk_emc, NULL, 0, 0),
 	SHARED_CLK("camera.emc", "vi",			"emc",	&tegra_clk_emc, NULL, 0, SHARED_BW),
 	SHARED_CLK("iso.emc",	"iso",			"emc",	&tegra_clk_emc, NULL, 0, SHARED_BW),
+	SHARED_CLK("bwmgr.emc",	"tegra_emc_bwmgr",	"emc",	&tegra_clk_emc, NULL, 0, 0),
 	SHARED_CLK("floor.emc",	"floor.emc",		NULL,	&tegra_clk_emc, NULL, 0, 0),
 	SHARED_CLK("override.emc", "override.emc",	NULL,	&tegra_clk_emc, NULL, 0, SHARED_OVERRIDE),
 	SHARED_CLK("edp.emc",	"edp.emc",		NULL,	&tegra_clk_emc, NULL, 0, SHARED_CEILING),
 	SHARED_CLK("battery.emc", "battery_edp",	"emc",	&tegra_clk_emc, NULL, 0, SHARED_CEILING),
+	SHARED_CLK("budget.emc", "tegra_edp_budget",	"emc",	&tegra_clk_emc, NULL, 0, SHARED_CEILING),
 	SHARED_CLK("floor.profile.emc", "profile.emc", NULL, &tegra_clk_emc, NULL,  0, 0),
 
 #ifdef CONFIG_TEGRA_DUAL_CBUS
@@ -6802,6 +6814,7 @@ struct clk tegra_list_clks[] = {
 	SHARED_CLK("edp.c2bus",		"edp.c2bus",		NULL,	&tegra_clk_c2bus, NULL,  0, SHARED_CEILING),
 	SHARED_CLK("cap.profile.c2bus",	"profile.c2bus",	NULL,	&tegra_clk_c2bus, NULL,  0, SHARED_CEILING),
 	SHARED_CLK("battery.c2bus",	"battery_edp",		"gpu",	&tegra_clk_c2bus, NULL,  0, SHARED_CEILING),
+	SHARED_CLK("budget.c2bus",	"tegra_edp_budget",	"gpu",	&tegra_clk_c2bus, NULL,  0, SHARED_CEILING),
 
 	DUAL_CBUS_CLK("msenc.cbus",	"tegra_msenc",		"msenc",  &tegra_clk_c3bus, "msenc", 0, 0),
 	DUAL_CBUS_CLK("tsec.cbus",	"tegra_tsec",		"tsec",   &tegra_clk_c3bus, "tsec", 0, 0),
@@ -6826,6 +6839,7 @@ struct clk tegra_list_clks[] = {
 	SHARED_CLK("edp.cbus",	"edp.cbus",		NULL,	&tegra_clk_cbus, NULL,  0, SHARED_CEILING),
 	SHARED_CLK("cap.profile.cbus", "profile.cbus",	NULL,	&tegra_clk_cbus, NULL,  0, SHARED_CEILING),
 	SHARED_CLK("battery.cbus", "battery_edp",	"gpu",	&tegra_clk_cbus, NULL,  0, SHARED_CEILING),
+	SHARED_CLK("budget.cbus", "tegra_edp_budget",	"gpu",	&tegra_clk_cbus, NULL,  0, SHARED_CEILING),
 #endif
 	SHARED_CLK("nv.host1x",	"tegra_host1x",		"host1x", &tegra_clk_host1x, NULL,  0, 0),
 	SHARED_CLK("vi.host1x",	"tegra_vi",		"host1x", &tegra_clk_host1x, NULL,  0, 0),
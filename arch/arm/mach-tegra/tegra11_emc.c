@@ -29,10 +29,13 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/hrtimer.h>
+#include <linux/bitmap.h>
+#include <linux/timer.h>
 
 #include <asm/cputime.h>
 
 #include <mach/iomap.h>
+#include <mach/boot_profile.h>
 
 #include "clock.h"
 #include "dvfs.h"
@@ -257,6 +260,50 @@ static struct emc_sel tegra_emc_clk_sel[TEGRA_EMC_TABLE_MAX_SIZE];
 static struct tegra11_emc_table start_timing;
 static const struct tegra11_emc_table *emc_timing;
 
+/*
+ * Registers that differ between a valid table entry and the next valid entry
+ * below it, found once at table init. A switch between such neighbours only
+ * writes these; any other switch, or the first one after boot timing or
+ * invalidation, writes the complete set.
+ */
+struct emc_diff {
+	int		lower;		/* index of lower neighbour, or -1 */
+	DECLARE_BITMAP(burst, TEGRA11_EMC_MAX_NUM_REGS);
+	DECLARE_BITMAP(trimmers, TEGRA11_EMC_MAX_NUM_REGS);
+	DECLARE_BITMAP(up_down, TEGRA11_EMC_MAX_NUM_REGS);
+};
+static struct emc_diff tegra_emc_diff[TEGRA_EMC_TABLE_MAX_SIZE];
+static u32 emc_fast_switch = 1;
+
+/*
+ * DRAM over-temperature handling. MR4 is polled from a timer - rounded to
+ * whole seconds while the DRAM is cool, every 250 ms once it is hot - and
+ * the reaction is applied on top of the current timing by rewriting the few
+ * affected shadow registers and latching them with a timing update, so it
+ * needs neither a table switch nor a clock change stall. The first step is
+ * 4x refresh, the second step adds the LPDDR2 AC timing derate; steps are
+ * taken up at once and down one at a time after a few cool readings.
+ */
+#define DRAM_OVER_TEMP_STATES		(DRAM_OVER_TEMP_THROTTLE + 1)
+#define DRAM_TEMP_COOL_POLLS		3
+#define LPDDR2_DERATE_PS		1875
+
+static unsigned long dram_over_temp_state = DRAM_OVER_TEMP_NONE;
+static u32 dram_temp_poll_ms = 1000;
+static u32 dram_temp_hot_poll_ms = 250;
+static bool dram_temp_poll = true;
+static struct timer_list dram_temp_timer;
+
+static struct {
+	int mr4;
+	int cool_polls;
+	u64 polls;
+	u64 errors;
+	u64 transitions[DRAM_OVER_TEMP_STATES];
+	u64 time_at_state[DRAM_OVER_TEMP_STATES];
+	u64 last_update;
+} dram_temp_stats;
+
 static ktime_t clkchange_time;
 static int clkchange_delay = 100;
 
@@ -274,6 +321,7 @@ static struct {
 	int last_sel;
 	u64 last_update;
 	u64 clkchange_count;
+	u64 fast_change_count;
 	spinlock_t spinlock;
 } emc_stats;
 
@@ -382,6 +430,56 @@ static inline void auto_cal_disable(void)
 	}
 }
 
+static inline void set_over_temp_timing(
+	const struct tegra11_emc_table *next_timing, unsigned long state)
+{
+#define REFRESH_SPEEDUP(val)						      \
+	do {								      \
+		val = ((val) & 0xFFFF0000) | (((val) & 0xFFFF) >> 2);	      \
+	} while (0)
+
+#define DERATE_REG(reg)							      \
+	__raw_writel(next_timing->burst_regs[EMC_##reg##_INDEX] + derate,    \
+		     burst_reg_addr[EMC_##reg##_INDEX])
+
+	u32 ref = next_timing->burst_regs[EMC_REFRESH_INDEX];
+	u32 pre_ref = next_timing->burst_regs[EMC_PRE_REFRESH_REQ_CNT_INDEX];
+	u32 dsr_cntrl = next_timing->burst_regs[EMC_DYN_SELF_REF_CONTROL_INDEX];
+	u32 derate = 0;
+
+	switch (state) {
+	case DRAM_OVER_TEMP_NONE:
+		break;
+	case DRAM_OVER_TEMP_THROTTLE:
+		/* tRCD, tRC, tRAS, tRP and tRRD grow by 1.875 ns */
+		derate = DIV_ROUND_UP(LPDDR2_DERATE_PS * next_timing->rate,
+				      1000000000);
+		/* fall through */
+	case DRAM_OVER_TEMP_REFRESH:
+		REFRESH_SPEEDUP(ref);
+		REFRESH_SPEEDUP(pre_ref);
+		REFRESH_SPEEDUP(dsr_cntrl);
+		break;
+	default:
+		pr_err("%s: Failed to set dram over temp state %lu\n",
+		       __func__, state);
+		BUG();
+	}
+
+	__raw_writel(ref, burst_reg_addr[EMC_REFRESH_INDEX]);
+	__raw_writel(pre_ref, burst_reg_addr[EMC_PRE_REFRESH_REQ_CNT_INDEX]);
+	__raw_writel(dsr_cntrl, burst_reg_addr[EMC_DYN_SELF_REF_CONTROL_INDEX]);
+
+	/* zero derate restores the table values */
+	DERATE_REG(RC);
+	DERATE_REG(RAS);
+	DERATE_REG(RP);
+	DERATE_REG(TRPAB);
+	DERATE_REG(RD_RCD);
+	DERATE_REG(WR_RCD);
+	DERATE_REG(RRD);
+}
+
 static inline bool dqs_preset(const struct tegra11_emc_table *next_timing,
 			      const struct tegra11_emc_table *last_timing)
 {
@@ -510,7 +608,7 @@ static inline void do_clock_change(u32 clk_setting)
 
 static noinline void emc_set_clock(const struct tegra11_emc_table *next_timing,
 				   const struct tegra11_emc_table *last_timing,
-				   u32 clk_setting)
+				   const struct emc_diff *diff, u32 clk_setting)
 {
 #ifndef EMULATE_CLOCK_SWITCH
 	int i, dll_change, pre_wait;
@@ -550,18 +648,28 @@ static noinline void emc_set_clock(const struct tegra11_emc_table *next_timing,
 
 	/* 3. disable auto-cal if vref mode is switching - removed */
 
-	/* 4. program burst shadow registers */
+	/* 4. program burst shadow registers (only changed ones if diff is
+	   known) */
 	for (i = 0; i < next_timing->burst_regs_num; i++) {
 		if (!burst_reg_addr[i])
 			continue;
+		if (diff && !test_bit(i, diff->burst))
+			continue;
 		__raw_writel(next_timing->burst_regs[i], burst_reg_addr[i]);
 	}
 	for (i = 0; i < next_timing->emc_trimmers_num; i++) {
+		if (diff && !test_bit(i, diff->trimmers))
+			continue;
 		__raw_writel(next_timing->emc_trimmers_0[i],
 			(u32)emc0_base + emc_trimmer_offs[i]);
 		__raw_writel(next_timing->emc_trimmers_1[i],
 			(u32)emc1_base + emc_trimmer_offs[i]);
 	}
+	/* over temp registers are rewritten on every switch, including fast
+	   ones, so leaving the state restores them from the current entry */
+	if ((dram_type == DRAM_TYPE_LPDDR2) &&
+	    (dram_over_temp_state != DRAM_OVER_TEMP_NONE))
+		set_over_temp_timing(next_timing, dram_over_temp_state);
 	emc_cfg_reg &= ~EMC_CFG_UPDATE_MASK;
 	emc_cfg_reg |= next_timing->emc_cfg & EMC_CFG_UPDATE_MASK;
 	emc_writel(emc_cfg_reg, EMC_CFG);
@@ -606,9 +714,12 @@ static noinline void emc_set_clock(const struct tegra11_emc_table *next_timing,
 
 	/* 11.5 program burst_up_down registers if emc rate is going down */
 	if (next_timing->rate < last_timing->rate) {
-		for (i = 0; i < next_timing->burst_up_down_regs_num; i++)
+		for (i = 0; i < next_timing->burst_up_down_regs_num; i++) {
+			if (diff && !test_bit(i, diff->up_down))
+				continue;
 			__raw_writel(next_timing->burst_up_down_regs[i],
 				burst_up_down_reg_addr[i]);
+		}
 		wmb();
 	}
 
@@ -621,9 +732,12 @@ static noinline void emc_set_clock(const struct tegra11_emc_table *next_timing,
 
 	/* 14.2 program burst_up_down registers if emc rate is going up */
 	if (next_timing->rate > last_timing->rate) {
-		for (i = 0; i < next_timing->burst_up_down_regs_num; i++)
+		for (i = 0; i < next_timing->burst_up_down_regs_num; i++) {
+			if (diff && !test_bit(i, diff->up_down))
+				continue;
 			__raw_writel(next_timing->burst_up_down_regs[i],
 				burst_up_down_reg_addr[i]);
+		}
 		wmb();
 	}
 
@@ -684,11 +798,23 @@ static inline void emc_get_timing(struct tegra11_emc_table *timing)
  * and relies on the clock lock on the emc clock to avoid races between
  * multiple frequency changes. In addition access lock prevents concurrent
  * access to EMC registers from reading MRR registers */
+static const struct emc_diff *get_emc_diff(int next, int last)
+{
+	if (!emc_fast_switch)
+		return NULL;
+	if (tegra_emc_diff[next].lower == last)
+		return &tegra_emc_diff[next];
+	if (tegra_emc_diff[last].lower == next)
+		return &tegra_emc_diff[last];
+	return NULL;
+}
+
 int tegra_emc_set_rate(unsigned long rate)
 {
 	int i;
 	u32 clk_setting;
 	const struct tegra11_emc_table *last_timing;
+	const struct emc_diff *diff = NULL;
 	unsigned long flags;
 	s64 last_change_delay;
 
@@ -716,8 +842,10 @@ int tegra_emc_set_rate(unsigned long rate)
 		emc_get_timing(&start_timing);
 		last_timing = &start_timing;
 	}
-	else
+	else {
 		last_timing = emc_timing;
+		diff = get_emc_diff(i, emc_timing - tegra_emc_table);
+	}
 
 	clk_setting = tegra_emc_clk_sel[i].value;
 
@@ -726,12 +854,14 @@ int tegra_emc_set_rate(unsigned long rate)
 		udelay(clkchange_delay - (int)last_change_delay);
 
 	spin_lock_irqsave(&emc_access_lock, flags);
-	emc_set_clock(&tegra_emc_table[i], last_timing, clk_setting);
+	emc_set_clock(&tegra_emc_table[i], last_timing, diff, clk_setting);
 	clkchange_time = ktime_get();
 	emc_timing = &tegra_emc_table[i];
 	spin_unlock_irqrestore(&emc_access_lock, flags);
 
 	emc_last_stats_update(i);
+	if (diff)
+		emc_stats.fast_change_count++;
 
 	pr_debug("%s: rate %lu setting 0x%x\n", __func__, rate, clk_setting);
 
@@ -1031,6 +1161,52 @@ static int purge_emc_table(unsigned long max_rate)
 #define purge_emc_table(max_rate) (0)
 #endif
 
+static void init_emc_diffs(void)
+{
+	int i, j, k;
+	const struct tegra11_emc_table *t, *l;
+	struct emc_diff *diff;
+
+	for (i = 0, j = -1; i < tegra_emc_table_size; i++) {
+		diff = &tegra_emc_diff[i];
+		diff->lower = -1;
+		if (tegra_emc_clk_sel[i].input == NULL)
+			continue;	/* invalid entry */
+
+		if (j >= 0) {
+			t = &tegra_emc_table[i];
+			l = &tegra_emc_table[j];
+			diff->lower = j;
+			for (k = 0; k < t->burst_regs_num; k++)
+				if (t->burst_regs[k] != l->burst_regs[k])
+					set_bit(k, diff->burst);
+			for (k = 0; k < t->emc_trimmers_num; k++)
+				if ((t->emc_trimmers_0[k] !=
+				     l->emc_trimmers_0[k]) ||
+				    (t->emc_trimmers_1[k] !=
+				     l->emc_trimmers_1[k]))
+					set_bit(k, diff->trimmers);
+			for (k = 0; k < t->burst_up_down_regs_num; k++)
+				if (t->burst_up_down_regs[k] !=
+				    l->burst_up_down_regs[k])
+					set_bit(k, diff->up_down);
+
+			/* MRS wait count may be overwritten on DLL restart */
+			set_bit(EMC_MRS_WAIT_CNT_INDEX, diff->burst);
+
+			pr_debug("tegra: EMC %lu <-> %lu kHz: %d burst,"
+				 " %d trimmer, %d up/down writes\n",
+				 l->rate, t->rate,
+				 bitmap_weight(diff->burst, t->burst_regs_num),
+				 bitmap_weight(diff->trimmers,
+					       t->emc_trimmers_num),
+				 bitmap_weight(diff->up_down,
+					       t->burst_up_down_regs_num));
+		}
+		j = i;
+	}
+}
+
 static int init_emc_table(const struct tegra11_emc_table *table, int table_size)
 {
 	int i, mv;
@@ -1139,6 +1315,7 @@ static int init_emc_table(const struct tegra11_emc_table *table, int table_size)
 		}
 	}
 
+	init_emc_diffs();
 	pr_info("tegra: validated EMC DFS table\n");
 
 	/* Configure clock change mode according to dram type */
@@ -1153,6 +1330,7 @@ static int __devinit tegra11_emc_probe(struct platform_device *pdev)
 {
 	struct tegra11_emc_pdata *pdata;
 	struct resource *res;
+	int ret;
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	if (!res) {
@@ -1166,7 +1344,11 @@ static int __devinit tegra11_emc_probe(struct platform_device *pdev)
 		return -ENODATA;
 	}
 
-	return init_emc_table(pdata->tables, pdata->num_tables);
+	ret = init_emc_table(pdata->tables, pdata->num_tables);
+	if (!ret)
+		dram_temp_poll_init();
+	tegra_boot_profile_mark("emc table");
+	return ret;
 }
 
 static struct platform_driver tegra11_emc_driver = {
@@ -1277,6 +1459,114 @@ int tegra_emc_get_dram_temperature(void)
 	return mr4;
 }
 
+/* called with emc_access_lock held */
+static void dram_temp_stats_update(unsigned long new_state)
+{
+	u64 cur_jiffies = get_jiffies_64();
+
+	dram_temp_stats.time_at_state[dram_over_temp_state] +=
+		cur_jiffies - dram_temp_stats.last_update;
+	dram_temp_stats.last_update = cur_jiffies;
+	if (new_state != dram_over_temp_state)
+		dram_temp_stats.transitions[new_state]++;
+}
+
+int tegra_emc_set_over_temp_state(unsigned long state)
+{
+	unsigned long flags;
+
+	if (dram_type != DRAM_TYPE_LPDDR2)
+		return -ENODEV;
+
+	if (state >= DRAM_OVER_TEMP_STATES)
+		return -EINVAL;
+
+	spin_lock_irqsave(&emc_access_lock, flags);
+
+	/* Update refresh and derated timing if state changed; without the
+	   current timing it is applied on the next clock change */
+	if (dram_over_temp_state != state) {
+		if (emc_timing) {
+			set_over_temp_timing(emc_timing, state);
+			emc_timing_update();
+			if (state > dram_over_temp_state)
+				emc_writel(EMC_REF_FORCE_CMD, EMC_REF);
+		}
+		dram_temp_stats_update(state);
+		dram_over_temp_state = state;
+	}
+	spin_unlock_irqrestore(&emc_access_lock, flags);
+	return 0;
+}
+
+static unsigned long dram_temp_to_state(int mr4)
+{
+	/* MR4 3 is 1x refresh, 4 is 0.25x, 5 and up also require derate */
+	if (mr4 <= 3)
+		return DRAM_OVER_TEMP_NONE;
+	if (mr4 == 4)
+		return DRAM_OVER_TEMP_REFRESH;
+	return DRAM_OVER_TEMP_THROTTLE;
+}
+
+static void dram_temp_poll_restart(void)
+{
+	unsigned long delay;
+
+	if (!dram_temp_poll)
+		return;
+
+	if (dram_over_temp_state == DRAM_OVER_TEMP_NONE)
+		delay = round_jiffies_relative(
+			msecs_to_jiffies(dram_temp_poll_ms));
+	else
+		delay = msecs_to_jiffies(dram_temp_hot_poll_ms);
+	mod_timer(&dram_temp_timer, jiffies + max(delay, 1UL));
+}
+
+static void dram_temp_poll_func(unsigned long data)
+{
+	unsigned long state = dram_over_temp_state;
+	unsigned long target;
+	int mr4;
+
+	mr4 = tegra_emc_get_dram_temperature();
+	dram_temp_stats.polls++;
+	if (IS_ERR_VALUE(mr4)) {
+		dram_temp_stats.errors++;
+		goto out;
+	}
+
+	if ((mr4 == 7) && (dram_temp_stats.mr4 != 7))
+		pr_warn("tegra_emc: DRAM exceeds high temperature limit\n");
+	dram_temp_stats.mr4 = mr4;
+
+	target = dram_temp_to_state(mr4);
+	if (target > state) {
+		tegra_emc_set_over_temp_state(target);
+		dram_temp_stats.cool_polls = 0;
+	} else if (target < state) {
+		if (++dram_temp_stats.cool_polls >= DRAM_TEMP_COOL_POLLS) {
+			tegra_emc_set_over_temp_state(state - 1);
+			dram_temp_stats.cool_polls = 0;
+		}
+	} else {
+		dram_temp_stats.cool_polls = 0;
+	}
+out:
+	dram_temp_poll_restart();
+}
+
+static void dram_temp_poll_init(void)
+{
+	if (dram_type != DRAM_TYPE_LPDDR2)
+		return;
+
+	dram_temp_stats.last_update = get_jiffies_64();
+	setup_timer(&dram_temp_timer, dram_temp_poll_func, 0);
+	dram_temp_poll_restart();
+}
+
 #ifdef CONFIG_DEBUG_FS
 
 static struct dentry *emc_debugfs_root;
@@ -1297,6 +1587,8 @@ static int emc_stats_show(struct seq_file *s, void *data)
 	}
 	seq_printf(s, "%-15s %llu\n", "transitions:",
 		   emc_stats.clkchange_count);
+	seq_printf(s, "%-15s %llu\n", "fast:",
+		   emc_stats.fast_change_count);
 	seq_printf(s, "%-15s %llu\n", "time-stamp:",
 		   cputime64_to_clock_t(emc_stats.last_update));
 
@@ -1323,6 +1615,75 @@ static int dram_temperature_get(void *data, u64 *val)
 DEFINE_SIMPLE_ATTRIBUTE(dram_temperature_fops, dram_temperature_get,
 			NULL, "%lld\n");
 
+static int dram_over_temp_show(struct seq_file *s, void *data)
+{
+	static const char * const names[DRAM_OVER_TEMP_STATES] = {
+		"none", "refresh", "throttle" };
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&emc_access_lock, flags);
+	dram_temp_stats_update(dram_over_temp_state);
+	spin_unlock_irqrestore(&emc_access_lock, flags);
+
+	seq_printf(s, "%-10s %-12s %-10s\n", "state", "transitions", "time");
+	for (i = 0; i < DRAM_OVER_TEMP_STATES; i++) {
+		u64 t = cputime64_to_clock_t(dram_temp_stats.time_at_state[i]);
+
+		seq_printf(s, "%-10s %-12llu %-10llu%s\n", names[i],
+			   dram_temp_stats.transitions[i], t,
+			   i == dram_over_temp_state ? " *" : "");
+	}
+	seq_printf(s, "%-15s %d\n", "mr4:", dram_temp_stats.mr4);
+	seq_printf(s, "%-15s %llu\n", "polls:", dram_temp_stats.polls);
+	seq_printf(s, "%-15s %llu\n", "errors:", dram_temp_stats.errors);
+	return 0;
+}
+
+static int dram_over_temp_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dram_over_temp_show, inode->i_private);
+}
+
+static const struct file_operations dram_over_temp_fops = {
+	.open		= dram_over_temp_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int over_temp_state_get(void *data, u64 *val)
+{
+	*val = dram_over_temp_state;
+	return 0;
+}
+static int over_temp_state_set(void *data, u64 val)
+{
+	return tegra_emc_set_over_temp_state(val);
+}
+DEFINE_SIMPLE_ATTRIBUTE(over_temp_state_fops, over_temp_state_get,
+			over_temp_state_set, "%llu\n");
+
+static int dram_temp_poll_get(void *data, u64 *val)
+{
+	*val = dram_temp_poll;
+	return 0;
+}
+static int dram_temp_poll_set(void *data, u64 val)
+{
+	if (dram_type != DRAM_TYPE_LPDDR2)
+		return -ENODEV;
+
+	dram_temp_poll = !!val;
+	if (dram_temp_poll)
+		dram_temp_poll_restart();
+	else
+		del_timer_sync(&dram_temp_timer);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(dram_temp_poll_fops, dram_temp_poll_get,
+			dram_temp_poll_set, "%llu\n");
+
 static int efficiency_get(void *data, u64 *val)
 {
 	*val = tegra_emc_bw_efficiency;
@@ -1356,6 +1717,10 @@ static int __init tegra_emc_debug_init(void)
 		emc_debugfs_root, (u32 *)&clkchange_delay))
 		goto err_out;
 
+	if (!debugfs_create_bool("fast_switch", S_IRUGO | S_IWUSR,
+		emc_debugfs_root, &emc_fast_switch))
+		goto err_out;
+
 	if (!debugfs_create_file("dram_temperature", S_IRUGO, emc_debugfs_root,
 				 NULL, &dram_temperature_fops))
 		goto err_out;
@@ -1364,6 +1729,29 @@ static int __init tegra_emc_debug_init(void)
 				 emc_debugfs_root, NULL, &efficiency_fops))
 		goto err_out;
 
+	if (dram_type == DRAM_TYPE_LPDDR2) {
+		if (!debugfs_create_file("over_temp_state", S_IRUGO | S_IWUSR,
+				emc_debugfs_root, NULL, &over_temp_state_fops))
+			goto err_out;
+
+		if (!debugfs_create_file("dram_over_temp", S_IRUGO,
+				emc_debugfs_root, NULL, &dram_over_temp_fops))
+			goto err_out;
+
+		if (!debugfs_create_file("dram_temp_poll", S_IRUGO | S_IWUSR,
+				emc_debugfs_root, NULL, &dram_temp_poll_fops))
+			goto err_out;
+
+		if (!debugfs_create_u32("dram_temp_poll_ms", S_IRUGO | S_IWUSR,
+				emc_debugfs_root, &dram_temp_poll_ms))
+			goto err_out;
+
+		if (!debugfs_create_u32("dram_temp_hot_poll_ms",
+				S_IRUGO | S_IWUSR, emc_debugfs_root,
+				&dram_temp_hot_poll_ms))
+			goto err_out;
+	}
+
 	return 0;
 
 err_out:
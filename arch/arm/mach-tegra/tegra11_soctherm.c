@@ -36,6 +36,8 @@
 #include <linux/uaccess.h>
 #include <linux/thermal.h>
 #include <linux/platform_data/thermal_sensors.h>
+#include <linux/kobject.h>
+#include <linux/ktime.h>
 
 #include <mach/tegra_fuse.h>
 #include <mach/iomap.h>
@@ -379,6 +381,7 @@ static struct soctherm_platform_data plat_data;
  * tegra11_soctherm_init(). See nvbug 1206311.
  */
 static bool soctherm_init_platform_done;
+static bool soctherm_suspended;
 static bool read_hw_temp = true;
 
 static struct clk *soctherm_clk;
@@ -470,6 +473,36 @@ static int sensor2therm_b[TSENSE_SIZE];
 static u32 clock_enabled;
 struct mutex clock_lock;
 
+/*
+ * Throttle level telemetry. Every hardware level programmed with a throttle
+ * gets its up and down crossing interrupts enabled; on each crossing the
+ * level status is sampled to count engagements and accumulate the time the
+ * level was engaged (above the up threshold, until back below the down
+ * threshold).
+ */
+#define SOCTHERM_LEVELS		4
+
+static const int therm_intr_shift[] = {
+	[THERM_CPU] = INTR_POS_CU0_SHIFT,
+	[THERM_GPU] = INTR_POS_GU0_SHIFT,
+	[THERM_MEM] = INTR_POS_MU0_SHIFT,
+	[THERM_PLL] = INTR_POS_PU0_SHIFT,
+};
+#define THROT_INTR_BITS(therm, level)	\
+	(0x3 << (therm_intr_shift[therm] + 2 * (level)))
+
+struct soctherm_throt_stats {
+	int throttle;		/* THROTTLE_* this level engages */
+	bool engaged;
+	ktime_t since;
+	u64 count;
+	u64 time_us;
+};
+
+static struct soctherm_throt_stats throt_stats[THERM_SIZE][SOCTHERM_LEVELS];
+static u32 throt_intr_mask;
+static DEFINE_MUTEX(throt_stats_lock);
+
 static const struct soctherm_throttle_dev throttle_defaults[] = {
 	[THROTTLE_LIGHT] = {
 		.dividend = 229,	/* 20% throttling */
@@ -532,6 +565,31 @@ static inline long temp_translate(int readback)
 		lsb * LOWER_PRECISION_FOR_CONV(500)) * sign;
 }
 
+/* temperature of one G cluster core, in millicelsius */
+int tegra11_soctherm_cpu_temp(unsigned int cpu, long *temp)
+{
+	enum soctherm_sense i = TSENSE_CPU0 + cpu;
+	u32 r;
+
+	if (!soctherm_init_platform_done || soctherm_suspended ||
+	    i > TSENSE_CPU3)
+		return -ENODEV;
+
+	if (read_hw_temp) {
+		r = soctherm_readl(TS_TSENSE_REG_OFFSET(TS_CPU0_STATUS1, i));
+		if (!REG_GET(r, TS_CPU0_STATUS1_TEMP_VALID))
+			return -EAGAIN;
+		*temp = temp_translate(REG_GET(r, TS_CPU0_STATUS1_TEMP));
+	} else {
+		r = soctherm_readl(TS_TSENSE_REG_OFFSET(TS_CPU0_STATUS0, i));
+		if (!REG_GET(r, TS_CPU0_STATUS0_VALID))
+			return -EAGAIN;
+		*temp = temp_convert(REG_GET(r, TS_CPU0_STATUS0_CAPTURE),
+				     sensor2therm_a[i], sensor2therm_b[i]);
+	}
+	return 0;
+}
+
 #ifdef CONFIG_THERMAL
 static inline void prog_hw_shutdown(struct thermal_trip_info *trip_state,
 				    int therm)
@@ -586,6 +644,56 @@ static inline void prog_hw_threshold(struct thermal_trip_info *trip_state,
 		    CTL_LVL0_CPU0_CPU_THROT_LIGHT);
 
 	soctherm_writel(r, reg_off);
+
+	/* account engagements of this level */
+	throt_stats[therm][throt + 1].throttle = throt;
+	throt_intr_mask |= THROT_INTR_BITS(therm, throt + 1);
+	r = soctherm_readl(INTR_EN);
+	soctherm_writel(r | THROT_INTR_BITS(therm, throt + 1), INTR_EN);
+}
+
+static u8 throttle_dividend(enum soctherm_throttle_id throttle)
+{
+	return plat_data.throttle[throttle].devs[THROTTLE_DEV_CPU].dividend ?:
+		throttle_defaults[throttle].dividend;
+}
+
+static void soctherm_throt_stats_update(bool suspend)
+{
+	struct soctherm_throt_stats *st;
+	ktime_t now = ktime_get();
+	bool engaged;
+	u32 status;
+	int i, level;
+
+	mutex_lock(&throt_stats_lock);
+	for (i = 0; i < THERM_SIZE; i++) {
+		for (level = 1; level < SOCTHERM_LEVELS; level++) {
+			if (!(throt_intr_mask & THROT_INTR_BITS(i, level)))
+				continue;
+
+			st = &throt_stats[i][level];
+			engaged = false;
+			if (!suspend) {
+				status = REG_GET(soctherm_readl(
+					TS_THERM_REG_OFFSET(CTL_LVL0_CPU0,
+							    level, i)),
+					CTL_LVL0_CPU0_STATUS);
+				/* 3: above up threshold, 1: in hysteresis */
+				engaged = (status == 3) ||
+					(st->engaged && (status == 1));
+			}
+
+			if (engaged && !st->engaged) {
+				st->count++;
+				st->since = now;
+			} else if (!engaged && st->engaged) {
+				st->time_us += ktime_us_delta(now, st->since);
+			}
+			st->engaged = engaged;
+		}
+	}
+	mutex_unlock(&throt_stats_lock);
 }
 
 static int soctherm_set_limits(enum soctherm_therm_id therm,
@@ -697,11 +805,11 @@ static int soctherm_hw_action_get_cur_state(struct thermal_cooling_device *cdev,
 	pskip_m = REG_GET(soctherm_readl(CPU_PSKIP_STATUS), CPU_PSKIP_STATUS_M);
 
 	if (strnstr(trip_state->cdev_type, "heavy", THERMAL_NAME_LENGTH) &&
-	    pskip_m == throttle_defaults[THROTTLE_LIGHT].dividend)
+	    pskip_m == throttle_dividend(THROTTLE_LIGHT))
 		return 0;
 
 	if (strnstr(trip_state->cdev_type, "light", THERMAL_NAME_LENGTH) &&
-	    pskip_m == throttle_defaults[THROTTLE_HEAVY].dividend)
+	    pskip_m == throttle_dividend(THROTTLE_HEAVY))
 		return 0;
 
 	*cur_state =
@@ -1075,6 +1183,16 @@ static void soctherm_work_func(struct work_struct *work)
 		soctherm_update();
 	}
 
+	/* account throttle level crossings, then re-arm them */
+	ex = st & throt_intr_mask;
+	if (ex) {
+		soctherm_writel(ex, INTR_STATUS);
+		st &= ~ex;
+		soctherm_throt_stats_update(false);
+		soctherm_writel(soctherm_readl(INTR_EN) | ex, INTR_EN);
+	}
+	ex = 0;
+
 	/* deliberately ignore expected interrupts NOT handled in SW */
 	ex |= REG_GET_BIT(st, INTR_POS_CD1);
 	ex |= REG_GET_BIT(st, INTR_POS_CU1);
@@ -1490,6 +1608,8 @@ static int soctherm_init_platform_data(void)
 
 static int soctherm_suspend(void)
 {
+	soctherm_suspended = true;
+	soctherm_throt_stats_update(true);
 	soctherm_writel((u32)-1, INTR_DIS);
 	disable_irq(INT_THERMAL);
 	cancel_work_sync(&work);
@@ -1503,7 +1623,9 @@ static int soctherm_resume(void)
 	soctherm_clk_enable(true);
 	enable_irq(INT_THERMAL);
 	soctherm_init_platform_data();
+	soctherm_suspended = false;
 	soctherm_update();
+	soctherm_throt_stats_update(false);
 
 	return 0;
 }
@@ -1562,6 +1684,140 @@ int __init tegra11_soctherm_init(struct soctherm_platform_data *data)
 	return 0;
 }
 
+static const char *const throttle_names[] = {
+	[THROTTLE_LIGHT] = "light",
+	[THROTTLE_HEAVY] = "heavy",
+};
+
+static const char *const throttle_dev_names[] = {
+	[THROTTLE_DEV_CPU] = "cpu",
+	[THROTTLE_DEV_GPU] = "gpu",
+};
+
+static ssize_t throttle_stats_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	struct soctherm_throt_stats *st;
+	ktime_t now = ktime_get();
+	ssize_t n = 0;
+	u64 time_us;
+	int i, level;
+
+	n += scnprintf(buf + n, PAGE_SIZE - n, "%-5s %-5s %-6s %10s %12s\n",
+		       "therm", "level", "throt", "count", "time_ms");
+
+	mutex_lock(&throt_stats_lock);
+	for (i = 0; i < THERM_SIZE; i++) {
+		for (level = 1; level < SOCTHERM_LEVELS; level++) {
+			if (!(throt_intr_mask & THROT_INTR_BITS(i, level)))
+				continue;
+
+			st = &throt_stats[i][level];
+			time_us = st->time_us;
+			if (st->engaged)
+				time_us += ktime_us_delta(now, st->since);
+			n += scnprintf(buf + n, PAGE_SIZE - n,
+				       "%-5s %-5d %-6s %10llu %12llu%s\n",
+				       therm_names[i], level,
+				       throttle_names[st->throttle], st->count,
+				       div_u64(time_us, 1000),
+				       st->engaged ? " *" : "");
+		}
+	}
+	mutex_unlock(&throt_stats_lock);
+	return n;
+}
+
+static ssize_t throttle_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	struct soctherm_throttle_dev *dev;
+	ssize_t n = 0;
+	int i, j;
+
+	for (i = 0; i < THROTTLE_SIZE; i++) {
+		for (j = 0; j < THROTTLE_DEV_SIZE; j++) {
+			dev = &plat_data.throttle[i].devs[j];
+			n += scnprintf(buf + n, PAGE_SIZE - n,
+				"%s %s enable %d dividend %u divisor %u\n",
+				throttle_names[i], throttle_dev_names[j],
+				dev->enable,
+				dev->dividend ?: throttle_defaults[i].dividend,
+				dev->divisor ?: throttle_defaults[i].divisor);
+		}
+	}
+	return n;
+}
+
+/* "<light|heavy> <cpu|gpu> <dividend> <divisor>" */
+static ssize_t throttle_store(struct kobject *kobj,
+			      struct kobj_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct soctherm_throttle_dev *dev;
+	char throt_name[8], dev_name[8];
+	unsigned int dividend, divisor;
+	int i, j;
+
+	if (sscanf(buf, "%7s %7s %u %u", throt_name, dev_name, &dividend,
+		   &divisor) != 4)
+		return -EINVAL;
+
+	for (i = 0; i < THROTTLE_SIZE; i++)
+		if (!strcmp(throt_name, throttle_names[i]))
+			break;
+	for (j = 0; j < THROTTLE_DEV_SIZE; j++)
+		if (!strcmp(dev_name, throttle_dev_names[j]))
+			break;
+	if ((i >= THROTTLE_SIZE) || (j >= THROTTLE_DEV_SIZE))
+		return -EINVAL;
+
+	if (!dividend || (dividend > divisor) || (divisor > 0xff))
+		return -EINVAL;
+
+	dev = &plat_data.throttle[i].devs[j];
+	if (!dev->enable)
+		return -ENODEV;
+
+	dev->dividend = dividend;
+	dev->divisor = divisor;
+	if (!soctherm_suspended)
+		tegra11_soctherm_throttle_program(i, &plat_data.throttle[i]);
+	return count;
+}
+
+static struct kobj_attribute throttle_stats_attr =
+	__ATTR_RO(throttle_stats);
+static struct kobj_attribute throttle_attr =
+	__ATTR(throttle, 0644, throttle_show, throttle_store);
+
+static const struct attribute *soctherm_attributes[] = {
+	&throttle_stats_attr.attr,
+	&throttle_attr.attr,
+	NULL,
+};
+
+static int __init soctherm_sysfs_init(void)
+{
+	struct kobject *kobj;
+
+	if (!soctherm_init_platform_done)
+		return 0;
+
+	kobj = kobject_create_and_add("tegra_soctherm", kernel_kobj);
+	if (!kobj) {
+		pr_err("soctherm: failed to create sysfs object\n");
+		return 0;
+	}
+
+	if (sysfs_create_files(kobj, soctherm_attributes)) {
+		pr_err("soctherm: failed to create sysfs interface\n");
+		kobject_put(kobj);
+	}
+	return 0;
+}
+late_initcall(soctherm_sysfs_init);
+
 #ifdef CONFIG_DEBUG_FS
 static int regs_show(struct seq_file *s, void *data)
 {
@@ -110,11 +110,16 @@ struct soctherm_platform_data {
 
 #ifdef CONFIG_TEGRA_SOCTHERM
 int __init tegra11_soctherm_init(struct soctherm_platform_data *data);
+int tegra11_soctherm_cpu_temp(unsigned int cpu, long *temp);
 #else
 static inline int tegra11_soctherm_init(struct soctherm_platform_data *data)
 {
 	return 0;
 }
+static inline int tegra11_soctherm_cpu_temp(unsigned int cpu, long *temp)
+{
+	return -ENODEV;
+}
 #endif
 
 #endif /* __MACH_TEGRA_11x_SOCTHERM_H */
@@ -30,6 +30,8 @@
 #include <mach/iomap.h>
 #include <mach/irqs.h>
 #include <mach/clk.h>
+#include <mach/mc.h>
+#include <mach/emc_bwmgr.h>
 
 #include "clock.h"
 
@@ -133,6 +135,13 @@ struct actmon_dev {
 	spinlock_t	lock;
 
 	struct notifier_block	rate_change_nb;
+
+	/*
+	 * A monitor of traffic on a bus it does not own follows the rate of
+	 * the bus clock and turns its target into an EMC bandwidth request.
+	 */
+	struct actmon_dev	*rate_dev;
+	tegra_emc_bw_handle	bw;
 };
 
 static void __iomem *actmon_base = IO_ADDRESS(TEGRA_ACTMON_BASE);
@@ -288,7 +297,11 @@ irqreturn_t actmon_dev_fn(int irq, void *dev_id)
 	pr_debug("%s.%s(kHz): avg: %lu, target: %lu current: %lu\n",
 			dev->dev_id, dev->con_id, dev->avg_actv_freq,
 			dev->target_freq, dev->cur_freq);
-	clk_set_rate(dev->clk, freq * 1000);
+	if (dev->rate_dev)
+		tegra_emc_bw_request(dev->bw,
+				     tegra_emc_freq_req_to_bw(freq) / 1000);
+	else
+		clk_set_rate(dev->clk, freq * 1000);
 
 	return IRQ_HANDLED;
 }
@@ -413,13 +426,16 @@ static void actmon_dev_suspend(struct actmon_dev *dev)
 
 	if (dev->suspend_freq)
 		clk_set_rate(dev->clk, dev->suspend_freq * 1000);
+	else if (dev->rate_dev)
+		tegra_emc_bw_request(dev->bw, 0);
 }
 
 static void actmon_dev_resume(struct actmon_dev *dev)
 {
 	u32 val;
 	unsigned long flags;
-	unsigned long freq = clk_get_rate(dev->clk) / 1000;
+	unsigned long freq = dev->rate_dev ? dev->rate_dev->cur_freq :
+		clk_get_rate(dev->clk) / 1000;
 
 	spin_lock_irqsave(&dev->lock, flags);
 
@@ -436,6 +452,60 @@ static void actmon_dev_resume(struct actmon_dev *dev)
 	spin_unlock_irqrestore(&dev->lock, flags);
 }
 
+static int __init actmon_dev_irq_init(struct actmon_dev *dev)
+{
+	int ret;
+
+	ret = request_threaded_irq(INT_ACTMON, actmon_dev_isr, actmon_dev_fn,
+				   IRQF_SHARED, dev->dev_id, dev);
+	if (ret)
+		pr_err("Failed irq %d request for %s.%s\n",
+		       INT_ACTMON, dev->dev_id, dev->con_id);
+	return ret;
+}
+
+/* Monitor on the bus of an initialized device: no clock of its own */
+static int __init actmon_dev_follower_init(struct actmon_dev *dev)
+{
+	struct actmon_dev *rd = dev->rate_dev;
+	struct clk *p;
+	int ret;
+
+	if (rd->state == ACTMON_UNINITIALIZED)
+		return -ENODEV;
+
+	dev->clk = rd->clk;
+	dev->max_freq = rd->max_freq;
+	actmon_dev_configure(dev, rd->cur_freq);
+
+	dev->bw = tegra_emc_bw_register(dev->con_id, false);
+	if (IS_ERR(dev->bw))
+		pr_info("%s.%s: no EMC bandwidth manager, monitor only\n",
+			dev->dev_id, dev->con_id);
+
+	p = clk_get_parent(dev->clk);
+	ret = tegra_register_clk_rate_notifier(p, &dev->rate_change_nb);
+	if (ret) {
+		pr_err("Failed to register %s rate change notifier for %s\n",
+		       p->name, dev->con_id);
+		goto err_bw;
+	}
+
+	ret = actmon_dev_irq_init(dev);
+	if (ret) {
+		tegra_unregister_clk_rate_notifier(p, &dev->rate_change_nb);
+		goto err_bw;
+	}
+
+	dev->state = ACTMON_OFF;
+	actmon_dev_enable(dev);
+	return 0;
+
+err_bw:
+	tegra_emc_bw_unregister(dev->bw);
+	return ret;
+}
+
 static int __init actmon_dev_init(struct actmon_dev *dev)
 {
 	int ret;
@@ -444,6 +514,9 @@ static int __init actmon_dev_init(struct actmon_dev *dev)
 
 	spin_lock_init(&dev->lock);
 
+	if (dev->rate_dev)
+		return actmon_dev_follower_init(dev);
+
 	dev->clk = clk_get_sys(dev->dev_id, dev->con_id);
 	if (IS_ERR(dev->clk)) {
 		pr_err("Failed to find %s.%s clock\n",
@@ -470,11 +543,8 @@ static int __init actmon_dev_init(struct actmon_dev *dev)
 		}
 	}
 
-	ret = request_threaded_irq(INT_ACTMON, actmon_dev_isr, actmon_dev_fn,
-				   IRQF_SHARED, dev->dev_id, dev);
+	ret = actmon_dev_irq_init(dev);
 	if (ret) {
-		pr_err("Failed irq %d request for %s.%s\n",
-		       INT_ACTMON, dev->dev_id, dev->con_id);
 		tegra_unregister_clk_rate_notifier(p, &dev->rate_change_nb);
 		return ret;
 	}
@@ -554,11 +624,101 @@ static struct actmon_dev actmon_dev_avp = {
 	},
 };
 
+/* CPU to EMC traffic monitor: frequency sampling device, counting the
+ * same transactions as the EMC monitor but only those from the cpu. Its
+ * target is requested from the EMC bandwidth manager as the "cpu_emc"
+ * non-ISO client rather than set on a clock, and its load tells cpufreq
+ * and cpuquiet governors how memory bound the cpu is.
+ */
+static struct actmon_dev actmon_dev_cpu_emc = {
+	.reg	= 0x200,
+	.glb_status_irq_mask = (0x1 << 25),
+	.dev_id = "tegra_actmon",
+	.con_id = "cpu_emc",
+
+	.boost_freq_step	= 16000,
+	.boost_up_coef		= 200,
+	.boost_down_coef	= 50,
+	.boost_up_threshold	= 60,
+	.boost_down_threshold	= 40,
+
+	.up_wmark_window	= 1,
+	.down_wmark_window	= 3,
+	.avg_window_log2	= ACTMON_DEFAULT_AVG_WINDOW_LOG2,
+#if defined(CONFIG_ARCH_TEGRA_3x_SOC)
+	.count_weight		= 0x200,
+#else
+	.count_weight		= 0x100,
+#endif
+
+	.type			= ACTMON_FREQ_SAMPLER,
+	.state			= ACTMON_UNINITIALIZED,
+
+	.rate_change_nb = {
+		.notifier_call = actmon_rate_notify_cb,
+	},
+	.rate_dev		= &actmon_dev_emc,
+};
+
+/* followers after the devices they follow */
 static struct actmon_dev *actmon_devices[] = {
 	&actmon_dev_emc,
 	&actmon_dev_avp,
+	&actmon_dev_cpu_emc,
 };
 
+static int actmon_dev_load(struct actmon_dev *dev)
+{
+	unsigned long flags;
+	unsigned long load = 0;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->state == ACTMON_ON && dev->cur_freq)
+		load = min(dev->avg_actv_freq * 1000 / dev->cur_freq, 1000UL);
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	return load;
+}
+
+/*
+ * EMC activity averaged over the actmon window, in per mille of the current
+ * EMC rate. Returns 0 while the EMC monitor is not running.
+ */
+int tegra_actmon_emc_load(void)
+{
+	return actmon_dev_load(&actmon_dev_emc);
+}
+EXPORT_SYMBOL(tegra_actmon_emc_load);
+
+/*
+ * EMC activity of the cpu alone, in per mille of the current EMC rate.
+ * Returns 0 while the monitor is not running.
+ */
+int tegra_actmon_cpu_emc_load(void)
+{
+	return actmon_dev_load(&actmon_dev_cpu_emc);
+}
+EXPORT_SYMBOL(tegra_actmon_cpu_emc_load);
+
+/*
+ * Average EMC activity as the EMC rate in kHz it would fully occupy, ie. the
+ * rate the actmon governor itself works from. Returns 0 while not running.
+ */
+unsigned long tegra_actmon_emc_actv_freq(void)
+{
+	struct actmon_dev *dev = &actmon_dev_emc;
+	unsigned long flags;
+	unsigned long freq = 0;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->state == ACTMON_ON)
+		freq = dev->avg_actv_freq;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	return freq;
+}
+EXPORT_SYMBOL(tegra_actmon_emc_actv_freq);
+
 /* Activity monitor suspend/resume */
 static int actmon_pm_notify(struct notifier_block *nb,
 			    unsigned long event, void *data)
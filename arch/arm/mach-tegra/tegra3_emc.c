@@ -1438,6 +1438,9 @@ int tegra_emc_set_over_temp_state(unsigned long state)
 	if (dram_type != DRAM_TYPE_LPDDR2)
 		return -ENODEV;
 
+	if (state > DRAM_OVER_TEMP_REFRESH)
+		return -EINVAL;
+
 	spin_lock_irqsave(&emc_access_lock, flags);
 
 	/* Update refresh timing if state changed */
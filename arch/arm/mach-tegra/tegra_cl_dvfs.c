@@ -37,6 +37,7 @@
 #include "tegra_cl_dvfs.h"
 #include "clock.h"
 #include "dvfs.h"
+#include "fuse.h"
 
 #define OUT_MASK			0x3f
 
@@ -137,6 +138,10 @@
 
 #define CL_DVFS_TUNE_HIGH_MARGIN_STEPS	2
 
+#define CL_DVFS_LEARN_DELAY		100	/* ms */
+#define CL_DVFS_LEARN_SAMPLES		300
+#define CL_DVFS_LEARN_MARGIN_STEPS	2
+
 #define CL_DVFS_DYNAMIC_OUTPUT_CFG	0
 
 enum tegra_cl_dvfs_ctrl_mode {
@@ -157,6 +162,18 @@ struct dfll_rate_req {
 	u8	scale;
 	u8	output;
 	u8	cap;
+	u8	idx;	/* safe dvfs table entry */
+};
+
+/*
+ * Output learned for one safe dvfs table entry: the highest output the loop
+ * settled at, and the cap derived from it once enough samples were taken
+ * (0 while still learning, or when the table cap is kept).
+ */
+struct cl_dvfs_learn_entry {
+	u8	cap;
+	u8	out_seen;
+	u16	samples;
 };
 
 struct tegra_cl_dvfs {
@@ -185,6 +202,7 @@ struct tegra_cl_dvfs {
 	u8				tune_high_out_start;
 	u8				tune_high_out_min;
 	u8				cold_out_min;
+	u8				cold_out_floor[MAX_DVFS_FREQS];
 	u8				minimax_output;
 	unsigned long			dfll_rate_min;
 
@@ -197,6 +215,14 @@ struct tegra_cl_dvfs {
 
 	struct timer_list		tune_timer;
 	unsigned long			tune_delay;
+
+	bool				learn;
+	u8				learn_floor;
+	u8				learn_freq;
+	unsigned int			learn_faults;
+	struct timer_list		learn_timer;
+	unsigned long			learn_delay;
+	struct cl_dvfs_learn_entry	learned[MAX_DVFS_FREQS];
 };
 
 /* Conversion macros (different scales for frequency request, and monitored
@@ -347,13 +373,18 @@ static inline void set_mode(struct tegra_cl_dvfs *cld,
 	cl_dvfs_wmb(cld);
 }
 
-static inline u8 get_output_min(struct tegra_cl_dvfs *cld)
+/* Output floor for the request, or for any request if none is given */
+static inline u8 get_output_min(struct tegra_cl_dvfs *cld,
+				struct dfll_rate_req *req)
 {
 	u32 tune_min, thermal_min;
 
 	tune_min = cld->tune_state == TEGRA_CL_DVFS_TUNE_LOW ?
 		0 : cld->tune_high_out_min;
-	thermal_min = cld->thermal_idx ? 0 : cld->cold_out_min;
+	thermal_min = 0;
+	if (!cld->thermal_idx)
+		thermal_min = req ? cld->cold_out_floor[req->idx] :
+			cld->cold_out_min;
 
 	return max(tune_min, thermal_min);
 }
@@ -418,7 +449,7 @@ static void set_ol_config(struct tegra_cl_dvfs *cld)
 			       CL_DVFS_TUNE0);
 		cl_dvfs_wmb(cld);
 
-		out_min = get_output_min(cld);
+		out_min = get_output_min(cld, NULL);
 #if CL_DVFS_DYNAMIC_OUTPUT_CFG
 		val = cl_dvfs_readl(cld, CL_DVFS_OUTPUT_CFG);
 		val &= ~CL_DVFS_OUTPUT_CFG_MIN_MASK;
@@ -467,7 +498,7 @@ static void set_cl_config(struct tegra_cl_dvfs *cld, struct dfll_rate_req *req)
 		BUG();
 	}
 
-	out_min = get_output_min(cld);
+	out_min = get_output_min(cld, req);
 	if (req->cap > (out_min + 1))
 		req->output = req->cap - 1;
 	else
@@ -542,6 +573,107 @@ static void set_request(struct tegra_cl_dvfs *cld, struct dfll_rate_req *req)
 	cl_dvfs_wmb(cld);
 }
 
+/*
+ * Voltage margin learning. The safe dvfs table caps the loop output at each
+ * rate with a margin that covers the weakest part of the speedo bin. While
+ * learning, the output the loop actually settles at is sampled per table
+ * entry; after CL_DVFS_LEARN_SAMPLES samples the cap for that entry drops
+ * to the highest output seen plus CL_DVFS_LEARN_MARGIN_STEPS, but never
+ * below the rail minimum for this speedo. A lower cap keeps the loop out of
+ * high tuning range, and its output floor, at rates this chip does not need
+ * it for. The cap keeps following the output seen, and is dropped if the
+ * monitored rate ever falls short of the request with it applied.
+ */
+static u8 get_learned_cap(struct tegra_cl_dvfs *cld, u8 idx)
+{
+	u8 cap = cld->clk_dvfs_map[idx];
+
+	if (cld->learned[idx].cap && (cld->learned[idx].cap < cap))
+		cap = cld->learned[idx].cap;
+	return cap;
+}
+
+static void cl_dvfs_learn_apply(struct tegra_cl_dvfs *cld, u8 idx)
+{
+	struct dfll_rate_req *req = &cld->last_req;
+
+	if ((req->freq == 0) || (req->idx != idx))
+		return;
+
+	req->cap = get_learned_cap(cld, idx);
+	if (cld->mode == TEGRA_CL_DVFS_CLOSED_LOOP) {
+		set_cl_config(cld, req);
+		set_request(cld, req);
+	}
+}
+
+static void learn_timer_cb(unsigned long data)
+{
+	unsigned long flags;
+	unsigned long rate, monitored;
+	u32 val, out_last;
+	u8 cap, table_cap;
+	struct tegra_cl_dvfs *cld = (struct tegra_cl_dvfs *)data;
+	struct dfll_rate_req *req = &cld->last_req;
+	struct cl_dvfs_learn_entry *l;
+
+	clk_lock_save(cld->dfll_clk, &flags);
+
+	if (!cld->learn)
+		goto out;
+	mod_timer(&cld->learn_timer, jiffies + cld->learn_delay);
+
+	/* sample only full scale requests the loop had a period to settle */
+	if ((cld->mode != TEGRA_CL_DVFS_CLOSED_LOOP) ||
+	    ((req->scale + 1) < SCALE_MAX) || (req->freq != cld->learn_freq)) {
+		cld->learn_freq = req->freq;
+		goto out;
+	}
+
+	l = &cld->learned[req->idx];
+	table_cap = cld->clk_dvfs_map[req->idx];
+
+	val = cl_dvfs_readl(cld, CL_DVFS_I2C_STS);
+	out_last = (val >> CL_DVFS_I2C_STS_I2C_LAST_SHIFT) & OUT_MASK;
+	val = cl_dvfs_readl(cld, CL_DVFS_MONITOR_DATA) &
+		CL_DVFS_MONITOR_DATA_MASK;
+	monitored = GET_MONITORED_RATE(val, cld->ref_rate);
+	rate = GET_REQUEST_RATE(req->freq, cld->ref_rate);
+
+	if (monitored + cld->ref_rate / 2 < rate) {
+		/* Loop ran out of voltage under the learned cap: forget it */
+		if (l->cap) {
+			pr_warn("%s: %lu kHz short at %d mV, cap dropped\n",
+				__func__, rate / 1000,
+				cld->out_map[l->cap]->reg_uV / 1000);
+			cld->learn_faults++;
+			l->cap = 0;
+			l->samples = 0;
+			l->out_seen = table_cap;
+			cl_dvfs_learn_apply(cld, req->idx);
+		}
+		goto out;
+	}
+
+	if (out_last > l->out_seen)
+		l->out_seen = out_last;
+	if (l->samples < CL_DVFS_LEARN_SAMPLES) {
+		l->samples++;
+		goto out;
+	}
+
+	cap = min_t(u8, l->out_seen + CL_DVFS_LEARN_MARGIN_STEPS, table_cap);
+	cap = max(cap, cld->learn_floor);
+	if (cap >= table_cap)
+		cap = 0;
+	if (cap != l->cap) {
+		l->cap = cap;
+		cl_dvfs_learn_apply(cld, req->idx);
+	}
+out:
+	clk_unlock_restore(cld->dfll_clk, &flags);
+}
+
 static u8 find_mv_out_cap(struct tegra_cl_dvfs *cld, int mv)
 {
 	u8 cap;
@@ -555,8 +687,8 @@ static u8 find_mv_out_cap(struct tegra_cl_dvfs *cld, int mv)
 	return cap - 1;	/* maximum possible output */
 }
 
-static int find_safe_output(
-	struct tegra_cl_dvfs *cld, unsigned long rate, u8 *safe_output)
+static int find_safe_output(struct tegra_cl_dvfs *cld, unsigned long rate,
+			    struct dfll_rate_req *req)
 {
 	int i;
 	int n = cld->safe_dvfs->num_freqs;
@@ -564,7 +696,8 @@ static int find_safe_output(
 
 	for (i = 0; i < n; i++) {
 		if (freqs[i] >= rate) {
-			*safe_output = cld->clk_dvfs_map[i];
+			req->output = cld->clk_dvfs_map[i];
+			req->idx = i;
 			return 0;
 		}
 	}
@@ -673,16 +806,34 @@ static void cl_dvfs_init_cold_output_floor(struct tegra_cl_dvfs *cld)
 		cld->minimax_output = cld->cold_out_min + 1;
 }
 
+static void cl_dvfs_init_cold_freq_floors(struct tegra_cl_dvfs *cld)
+{
+	int i, mv;
+	struct dvfs *d = cld->safe_dvfs;
+
+	/* only the rates the rail table asks it for pay the full floor */
+	for (i = 0; i < d->num_freqs; i++) {
+		mv = tegra_dvfs_rail_get_cold_floor(d->dvfs_rail, d->freqs[i]);
+		cld->cold_out_floor[i] = mv ? min(find_mv_out_cap(cld, mv),
+						  cld->cold_out_min) : 0;
+	}
+}
+
 static void cl_dvfs_init_output_thresholds(struct tegra_cl_dvfs *cld)
 {
 	cld->minimax_output = 0;
 	cl_dvfs_init_tuning_thresholds(cld);
 	cl_dvfs_init_cold_output_floor(cld);
+	cl_dvfs_init_cold_freq_floors(cld);
 
 	/* make sure safe output is safe at any temperature */
 	cld->safe_output = cld->cold_out_min ? : 1;
 	if (cld->minimax_output <= cld->safe_output)
 		cld->minimax_output = cld->safe_output + 1;
+
+	/* learned caps stay above the rail minimum for this speedo */
+	cld->learn_floor = max_t(u8, cld->safe_output + 1, find_mv_out_cap(
+		cld, cld->safe_dvfs->dvfs_rail->min_millivolts));
 }
 
 static void cl_dvfs_init_pwm_if(struct tegra_cl_dvfs *cld)
@@ -736,7 +887,7 @@ static void cl_dvfs_init_out_if(struct tegra_cl_dvfs *cld)
 	cld->tune_state = TEGRA_CL_DVFS_TUNE_LOW;
 	cld->thermal_idx = 0;
 #if CL_DVFS_DYNAMIC_OUTPUT_CFG
-	val = get_output_min(cld);
+	val = get_output_min(cld, NULL);
 	cld->lut_min = 0;
 	cld->lut_max = cld->num_voltages - 1;
 #else
@@ -747,7 +898,7 @@ static void cl_dvfs_init_out_if(struct tegra_cl_dvfs *cld)
 	 * reload of LUT is fine).
 	 */
 	val = 0;
-	cld->lut_min = get_output_min(cld);
+	cld->lut_min = get_output_min(cld, NULL);
 	cld->lut_max = cld->num_voltages - 1;
 #endif
 
@@ -877,6 +1028,12 @@ static int cl_dvfs_init(struct tegra_cl_dvfs *cld)
 	cld->tune_timer.data = (unsigned long)cld;
 	cld->tune_delay = usecs_to_jiffies(CL_DVFS_TUNE_HIGH_DELAY);
 
+	/* init margin learning timer */
+	init_timer_deferrable(&cld->learn_timer);
+	cld->learn_timer.function = learn_timer_cb;
+	cld->learn_timer.data = (unsigned long)cld;
+	cld->learn_delay = msecs_to_jiffies(CL_DVFS_LEARN_DELAY);
+
 	/* Get ready ouput voltage mapping*/
 	cl_dvfs_init_maps(cld);
 
@@ -1260,13 +1417,13 @@ int tegra_cl_dvfs_request_rate(struct tegra_cl_dvfs *cld, unsigned long rate)
 	req.freq = val;
 	rate = GET_REQUEST_RATE(val, cld->ref_rate);
 
-	/* Find safe voltage for requested rate */
-	if (find_safe_output(cld, rate, &req.output)) {
+	/* Find safe voltage for requested rate, and the learned cap if any */
+	if (find_safe_output(cld, rate, &req)) {
 		pr_err("%s: Failed to find safe output for rate %lu\n",
 		       __func__, rate);
 		return -EINVAL;
 	}
-	req.cap = req.output;
+	req.cap = get_learned_cap(cld, req.idx);
 
 	/*
 	 * Save validated request, and in CLOSED_LOOP mode actually update
@@ -1380,6 +1537,168 @@ static int tune_high_mv_set(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(tune_high_mv_fops, tune_high_mv_get, tune_high_mv_set,
 			"%llu\n");
 
+static int learn_get(void *data, u64 *val)
+{
+	struct tegra_cl_dvfs *cld = ((struct clk *)data)->u.dfll.cl_dvfs;
+	*val = cld->learn;
+	return 0;
+}
+static int learn_set(void *data, u64 val)
+{
+	unsigned long flags;
+	struct clk *c = (struct clk *)data;
+	struct tegra_cl_dvfs *cld = c->u.dfll.cl_dvfs;
+
+	clk_lock_save(c, &flags);
+	cld->learn = !!val;
+	if (cld->learn)
+		mod_timer(&cld->learn_timer, jiffies + cld->learn_delay);
+	clk_unlock_restore(c, &flags);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(learn_fops, learn_get, learn_set, "%llu\n");
+
+static int learn_stats_show(struct seq_file *s, void *data)
+{
+	int i;
+	unsigned long flags;
+	struct clk *c = s->private;
+	struct tegra_cl_dvfs *cld = c->u.dfll.cl_dvfs;
+	struct cl_dvfs_learn_entry *l;
+
+	seq_printf(s, "learn %s, floor %d mV, faults %u\n",
+		   cld->learn ? "on" : "off",
+		   cld->out_map[cld->learn_floor]->reg_uV / 1000,
+		   cld->learn_faults);
+	seq_printf(s, "%10s %8s %8s %8s %8s\n",
+		   "rate_khz", "table_mv", "seen_mv", "cap_mv", "samples");
+
+	clk_lock_save(c, &flags);
+	for (i = 0; i < cld->safe_dvfs->num_freqs; i++) {
+		l = &cld->learned[i];
+		seq_printf(s, "%10lu %8d %8d %8d %8u\n",
+			   cld->safe_dvfs->freqs[i] / 1000,
+			   cld->out_map[cld->clk_dvfs_map[i]]->reg_uV / 1000,
+			   l->samples ? cld->out_map[l->out_seen]->reg_uV /
+				1000 : 0,
+			   l->cap ? cld->out_map[l->cap]->reg_uV / 1000 : 0,
+			   l->samples);
+	}
+	clk_unlock_restore(c, &flags);
+	return 0;
+}
+
+static int learn_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, learn_stats_show, inode->i_private);
+}
+
+static const struct file_operations learn_stats_fops = {
+	.open		= learn_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * Learned caps in a form user space can save and write back on next boot:
+ * "<cpu speedo value> <cpu process id> <cap mV for each table entry>", with
+ * 0 for entries that keep the table cap. A saved set is only accepted on the
+ * chip it was learned on, and each cap is clamped to the current floor and
+ * table voltage. Writing a set also turns learning on, so that a cap that
+ * no longer holds (e.g. after aging) is still dropped.
+ */
+static int learned_show(struct seq_file *s, void *data)
+{
+	int i;
+	unsigned long flags;
+	struct clk *c = s->private;
+	struct tegra_cl_dvfs *cld = c->u.dfll.cl_dvfs;
+	u8 cap;
+
+	seq_printf(s, "%d %d", tegra_cpu_speedo_value(),
+		   tegra_cpu_process_id());
+	clk_lock_save(c, &flags);
+	for (i = 0; i < cld->safe_dvfs->num_freqs; i++) {
+		cap = cld->learned[i].cap;
+		seq_printf(s, " %d",
+			   cap ? cld->out_map[cap]->reg_uV / 1000 : 0);
+	}
+	clk_unlock_restore(c, &flags);
+	seq_printf(s, "\n");
+	return 0;
+}
+
+static int learned_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, learned_show, inode->i_private);
+}
+
+static ssize_t learned_write(struct file *file,
+	const char __user *userbuf, size_t count, loff_t *ppos)
+{
+	char buf[8 * (MAX_DVFS_FREQS + 2)];
+	char *p = buf, *tok;
+	int i, n, mv[MAX_DVFS_FREQS + 2];
+	unsigned long flags;
+	struct clk *c = file->f_path.dentry->d_inode->i_private;
+	struct tegra_cl_dvfs *cld = c->u.dfll.cl_dvfs;
+	struct cl_dvfs_learn_entry *l;
+	u8 cap, table_cap;
+
+	if (sizeof(buf) <= count)
+		return -EINVAL;
+
+	if (copy_from_user(buf, userbuf, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+	strim(buf);
+
+	for (n = 0; (tok = strsep(&p, " ")) != NULL;) {
+		if (!*tok)
+			continue;
+		if ((n >= ARRAY_SIZE(mv)) || kstrtoint(tok, 10, &mv[n]))
+			return -EINVAL;
+		n++;
+	}
+
+	if ((n != cld->safe_dvfs->num_freqs + 2) ||
+	    (mv[0] != tegra_cpu_speedo_value()) ||
+	    (mv[1] != tegra_cpu_process_id()))
+		return -EINVAL;
+
+	clk_lock_save(c, &flags);
+	for (i = 0; i < cld->safe_dvfs->num_freqs; i++) {
+		l = &cld->learned[i];
+		table_cap = cld->clk_dvfs_map[i];
+		cap = 0;
+		if (mv[i + 2] > 0) {
+			cap = find_mv_out_cap(cld, mv[i + 2]);
+			cap = max(cap, cld->learn_floor);
+			if (cap >= table_cap)
+				cap = 0;
+		}
+		l->cap = cap;
+		l->samples = cap ? CL_DVFS_LEARN_SAMPLES : 0;
+		l->out_seen = cap ? max_t(int, cap -
+			CL_DVFS_LEARN_MARGIN_STEPS, 0) : 0;
+		cl_dvfs_learn_apply(cld, i);
+	}
+	cld->learn = true;
+	mod_timer(&cld->learn_timer, jiffies + cld->learn_delay);
+	clk_unlock_restore(c, &flags);
+	return count;
+}
+
+static const struct file_operations learned_fops = {
+	.open		= learned_open,
+	.read		= seq_read,
+	.write		= learned_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int cl_register_show(struct seq_file *s, void *data)
 {
 	u32 offs;
@@ -1486,6 +1805,18 @@ static int __init tegra_cl_dvfs_debug_init(void)
 		cpu_cl_dvfs_dentry, dfll_cpu, &tune_high_mv_fops))
 		goto err_out;
 
+	if (!debugfs_create_file("learn", S_IRUGO | S_IWUSR,
+		cpu_cl_dvfs_dentry, dfll_cpu, &learn_fops))
+		goto err_out;
+
+	if (!debugfs_create_file("learn_stats", S_IRUGO,
+		cpu_cl_dvfs_dentry, dfll_cpu, &learn_stats_fops))
+		goto err_out;
+
+	if (!debugfs_create_file("learned", S_IRUGO | S_IWUSR,
+		cpu_cl_dvfs_dentry, dfll_cpu, &learned_fops))
+		goto err_out;
+
 	if (!debugfs_create_file("registers", S_IRUGO | S_IWUSR,
 		cpu_cl_dvfs_dentry, dfll_cpu, &cl_register_fops))
 		goto err_out;
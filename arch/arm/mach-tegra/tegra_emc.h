@@ -26,6 +26,7 @@ extern u8 tegra_emc_bw_efficiency;
 enum {
 	DRAM_OVER_TEMP_NONE = 0,
 	DRAM_OVER_TEMP_REFRESH,
+	DRAM_OVER_TEMP_THROTTLE,	/* refresh and derated timings */
 };
 
 struct clk;
@@ -108,6 +108,8 @@ struct tegra_usb_phy {
 	bool linkphy_init;
 	bool hot_plug;
 	bool ctrlr_suspended;
+	bool lp_blocked;	/* keep powered across bus suspend */
+	bool lp_skipped;	/* bus suspend left the phy powered */
 };
 
 int usb_phy_reg_status_wait(void __iomem *reg, u32 mask,
@@ -32,6 +32,7 @@
 #include <linux/syscore_ops.h>
 #include <linux/cpu.h>
 #include <linux/export.h>
+#include <linux/tick.h>
 
 #include <asm/mach/time.h>
 #include <asm/localtimer.h>
@@ -251,6 +252,36 @@ void tegra3_lp2_timer_cancel_secondary(void)
 		timer_writel(1<<30, base + TIMER_PCR);
 	}
 }
+
+/*
+ * Re-arm the wake timer of a secondary CPU which is still power gated
+ * after tegra3_lp2_timer_cancel_secondary(), to fire in @us.
+ */
+void tegra3_lp2_timer_restart_secondary(unsigned int cpu, s64 us)
+{
+	if (cpu >= ARRAY_SIZE(lp2_wake_timers) ||
+	    !cpumask_test_and_clear_cpu(cpu, &wake_timer_canceled))
+		return;
+
+	us = clamp_t(s64, us, 1, 0x1fffffff);
+	timer_writel(0x80000000ul | (u32)us, lp2_wake_timers[cpu] + TIMER_PTV);
+}
+
+/*
+ * Power gating stops the local timer. The CPU's own wake timer was armed
+ * for its next event, so there is no need to hand that event over to the
+ * broadcast timer (and take the broadcast lock) on every entry and exit;
+ * only the local timer has to be re-armed on the way out.
+ */
+void tegra3_lp2_local_timer_restart(void)
+{
+	struct clock_event_device *evt =
+		tick_get_device(smp_processor_id())->evtdev;
+
+	if (evt && evt->mode == CLOCK_EVT_MODE_ONESHOT &&
+	    evt->next_event.tv64 != KTIME_MAX)
+		clockevents_program_event(evt, evt->next_event, 1);
+}
 #endif
 
 void __init tegra30_init_timer(void)
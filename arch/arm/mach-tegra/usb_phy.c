@@ -392,6 +392,7 @@ int tegra_usb_phy_power_off(struct tegra_usb_phy *phy)
 	}
 
 	phy->phy_power_on = false;
+	phy->lp_skipped = false;
 
 	return err;
 }
@@ -481,8 +482,12 @@ int tegra_usb_phy_suspend(struct tegra_usb_phy *phy)
 	if (phy->ops && phy->ops->suspend)
 		err = phy->ops->suspend(phy);
 
-	if (!err && phy->pdata->u_data.host.power_off_on_suspend)
-		tegra_usb_phy_power_off(phy);
+	if (!err && phy->pdata->u_data.host.power_off_on_suspend) {
+		if (phy->lp_blocked)
+			phy->lp_skipped = true;
+		else
+			tegra_usb_phy_power_off(phy);
+	}
 
 	return err;
 }
@@ -525,6 +530,12 @@ int tegra_usb_phy_resume(struct tegra_usb_phy *phy)
 
 	DBG("%s(%d) inst:[%d]\n", __func__, __LINE__, phy->inst);
 
+	/* still powered, nothing to restore */
+	if (phy->lp_skipped) {
+		phy->lp_skipped = false;
+		return 0;
+	}
+
 	if (phy->pdata->u_data.host.power_off_on_suspend) {
 		err = tegra_usb_phy_power_on(phy);
 	}
@@ -628,6 +639,14 @@ bool tegra_usb_phy_otg_supported(struct tegra_usb_phy *phy)
 }
 EXPORT_SYMBOL_GPL(tegra_usb_phy_otg_supported);
 
+void tegra_usb_phy_block_lp(struct tegra_usb_phy *phy, bool block)
+{
+	DBG("%s(%d) inst:[%d] block %d\n", __func__, __LINE__, phy->inst,
+		block);
+	phy->lp_blocked = block;
+}
+EXPORT_SYMBOL_GPL(tegra_usb_phy_block_lp);
+
 void tegra_usb_phy_memory_prefetch_on(struct tegra_usb_phy *phy)
 {
 	void __iomem *ahb_gizmo = IO_ADDRESS(TEGRA_AHB_GIZMO_BASE);
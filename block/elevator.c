@@ -719,6 +719,21 @@ int elv_may_queue(struct request_queue *q, int rw)
 	return ELV_MQUEUE_MAY;
 }
 
+/*
+ * Does the elevator hold a request that should not wait behind the ones
+ * the driver is about to batch up? Only called with the queue lock held.
+ */
+int elv_is_urgent(struct request_queue *q)
+{
+	struct elevator_queue *e = q->elevator;
+
+	if (e->type->ops.elevator_is_urgent_fn)
+		return e->type->ops.elevator_is_urgent_fn(q);
+
+	return 0;
+}
+EXPORT_SYMBOL(elv_is_urgent);
+
 void elv_abort_queue(struct request_queue *q)
 {
 	struct request *rq;
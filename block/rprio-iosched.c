@@ -0,0 +1,674 @@
+/*
+ *  Read-priority i/o scheduler.
+ *
+ *  Derived from the deadline i/o scheduler,
+ *  Copyright (C) 2002 Jens Axboe <axboe@kernel.dk>
+ *
+ *  Requests are split in three classes: reads (always synchronous),
+ *  synchronous writes and asynchronous writes. Reads are dispatched first.
+ *  Writes are bounded twice: by the number of read batches that may pass
+ *  them (writes_starved) and by their fifo expiry, after which they go
+ *  ahead of any queued read. Synchronous writes go before asynchronous
+ *  ones until the latter expire.
+ *
+ *  On rotational queues the scheduler may idle for read_idle after a read
+ *  completes instead of turning to writes, hoping for the next dependent
+ *  read. Solid-state queues never idle.
+ *
+ *  Queued reads are reported as urgent through elv_is_urgent(), so that
+ *  drivers which batch requests (eMMC packed commands) stop packing writes
+ *  in front of them.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+#include <linux/ktime.h>
+
+static const int read_expire = HZ / 4;	/* max time before a read is submitted. */
+static const int sync_write_expire = HZ;	/* ditto for sync writes */
+static const int async_write_expire = 5 * HZ;	/* ditto for async writes */
+static const int writes_starved = 4;	/* max read batches passing a write */
+static const int fifo_batch = 16;	/* # of sequential requests treated as one */
+static const int read_idle = 8;		/* msecs to idle after a read, rotational only */
+
+enum {
+	RPRIO_READ,
+	RPRIO_SYNC_WRITE,
+	RPRIO_ASYNC_WRITE,
+	RPRIO_NR_CLASSES,
+};
+
+/* time spent queued in the scheduler before dispatch */
+struct rprio_lat {
+	unsigned long count;
+	unsigned long max_us;
+	u64 total_us;
+};
+
+struct rprio_data {
+	struct request_queue *queue;
+
+	/*
+	 * requests are present on both sort_list (per direction) and
+	 * fifo_list (per class)
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[RPRIO_NR_CLASSES];
+
+	/*
+	 * next in sort order. read, write or both are NULL
+	 */
+	struct request *next_rq[2];
+	unsigned int batching;		/* number of sequential requests made */
+	unsigned int starved;		/* times reads have starved writes */
+
+	/* read idling */
+	unsigned long last_read;	/* jiffies of the last read completion */
+	bool read_wait;			/* may idle for a read to follow */
+	struct timer_list idle_timer;
+	struct work_struct unplug_work;
+
+	struct rprio_lat lat[RPRIO_NR_CLASSES];
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[RPRIO_NR_CLASSES];
+	int fifo_batch;
+	int writes_starved;
+	int front_merges;
+	int read_idle;
+};
+
+static inline int rprio_class(struct request *rq)
+{
+	if (rq_data_dir(rq) == READ)
+		return RPRIO_READ;
+	return rq_is_sync(rq) ? RPRIO_SYNC_WRITE : RPRIO_ASYNC_WRITE;
+}
+
+/*
+ * the time a request entered the scheduler, in usecs. Only differences
+ * are used, so the truncation to a long does not matter.
+ */
+static inline unsigned long rprio_now_us(void)
+{
+	return (unsigned long)ktime_to_us(ktime_get());
+}
+
+static inline unsigned long rprio_insert_us(struct request *rq)
+{
+	return (unsigned long)rq->elv.priv[0];
+}
+
+static inline void rprio_set_insert_us(struct request *rq, unsigned long us)
+{
+	rq->elv.priv[0] = (void *)us;
+}
+
+static inline struct rb_root *
+rprio_rb_root(struct rprio_data *rd, struct request *rq)
+{
+	return &rd->sort_list[rq_data_dir(rq)];
+}
+
+/*
+ * get the request after `rq' in sector-sorted order
+ */
+static inline struct request *
+rprio_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+static void
+rprio_add_rq_rb(struct rprio_data *rd, struct request *rq)
+{
+	elv_rb_add(rprio_rb_root(rd, rq), rq);
+}
+
+static inline void
+rprio_del_rq_rb(struct rprio_data *rd, struct request *rq)
+{
+	const int data_dir = rq_data_dir(rq);
+
+	if (rd->next_rq[data_dir] == rq)
+		rd->next_rq[data_dir] = rprio_latter_request(rq);
+
+	elv_rb_del(rprio_rb_root(rd, rq), rq);
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+rprio_add_request(struct request_queue *q, struct request *rq)
+{
+	struct rprio_data *rd = q->elevator->elevator_data;
+	const int class = rprio_class(rq);
+
+	rprio_add_rq_rb(rd, rq);
+
+	rprio_set_insert_us(rq, rprio_now_us());
+	rq_set_fifo_time(rq, jiffies + rd->fifo_expire[class]);
+	list_add_tail(&rq->queuelist, &rd->fifo_list[class]);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void rprio_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct rprio_data *rd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	rprio_del_rq_rb(rd, rq);
+}
+
+static int
+rprio_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct rprio_data *rd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * check for front merge
+	 */
+	if (rd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&rd->sort_list[bio_data_dir(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void rprio_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct rprio_data *rd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(rprio_rb_root(rd, req), req);
+		rprio_add_rq_rb(rd, req);
+	}
+}
+
+static void
+rprio_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq and move
+	 * into next position (next will be deleted) in fifo. Only within a
+	 * class: a sync and an async write may merge, but each stays on the
+	 * fifo of its own class.
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    rprio_class(req) == rprio_class(next)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/* the merged request has been waiting since the older one came in */
+	if ((long)(rprio_insert_us(next) - rprio_insert_us(req)) < 0)
+		rprio_set_insert_us(req, rprio_insert_us(next));
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	rprio_remove_request(q, next);
+}
+
+static void rprio_account(struct rprio_data *rd, struct request *rq)
+{
+	struct rprio_lat *lat = &rd->lat[rprio_class(rq)];
+	unsigned long us = rprio_now_us() - rprio_insert_us(rq);
+
+	lat->count++;
+	lat->total_us += us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+}
+
+/*
+ * move an entry to dispatch queue
+ */
+static void
+rprio_move_request(struct rprio_data *rd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	const int data_dir = rq_data_dir(rq);
+
+	rd->next_rq[READ] = NULL;
+	rd->next_rq[WRITE] = NULL;
+	rd->next_rq[data_dir] = rprio_latter_request(rq);
+
+	if (data_dir == WRITE)
+		rd->read_wait = false;
+
+	rprio_account(rd, rq);
+
+	/*
+	 * take it off the sort and fifo list, move
+	 * to dispatch queue
+	 */
+	rprio_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * rprio_check_fifo returns 0 if there are no expired requests on the fifo
+ * of class, 1 otherwise.
+ */
+static inline int rprio_check_fifo(struct rprio_data *rd, int class)
+{
+	struct request *rq;
+
+	if (list_empty(&rd->fifo_list[class]))
+		return 0;
+
+	rq = rq_entry_fifo(rd->fifo_list[class].next);
+
+	/*
+	 * rq is expired!
+	 */
+	if (time_after(jiffies, rq_fifo_time(rq)))
+		return 1;
+
+	return 0;
+}
+
+static inline int rprio_writes_expired(struct rprio_data *rd)
+{
+	return rprio_check_fifo(rd, RPRIO_SYNC_WRITE) ||
+		rprio_check_fifo(rd, RPRIO_ASYNC_WRITE);
+}
+
+/*
+ * With only writes left, a rotational queue waits a little after a read
+ * completes in case the reader comes straight back for more.
+ */
+static int rprio_should_idle(struct request_queue *q, struct rprio_data *rd)
+{
+	unsigned long until;
+
+	if (!rd->read_wait || !rd->read_idle || blk_queue_nonrot(q) ||
+	    rprio_writes_expired(rd))
+		return 0;
+
+	until = rd->last_read + rd->read_idle;
+	if (!time_before(jiffies, until)) {
+		rd->read_wait = false;
+		return 0;
+	}
+
+	mod_timer(&rd->idle_timer, until);
+	return 1;
+}
+
+/*
+ * rprio_dispatch_requests selects the best request according to
+ * class, expire times, writes_starved, fifo_batch etc
+ */
+static int rprio_dispatch_requests(struct request_queue *q, int force)
+{
+	struct rprio_data *rd = q->elevator->elevator_data;
+	const int reads = !list_empty(&rd->fifo_list[RPRIO_READ]);
+	const int writes = !list_empty(&rd->fifo_list[RPRIO_SYNC_WRITE]) ||
+		!list_empty(&rd->fifo_list[RPRIO_ASYNC_WRITE]);
+	struct request *rq;
+	int data_dir, class;
+
+	/*
+	 * batches are currently reads XOR writes. A write batch ends as
+	 * soon as a read shows up.
+	 */
+	if (rd->next_rq[WRITE] && !reads)
+		rq = rd->next_rq[WRITE];
+	else
+		rq = rd->next_rq[READ];
+
+	if (rq && rd->batching < rd->fifo_batch)
+		/* we have a next request are still entitled to batch */
+		goto dispatch_request;
+
+	/*
+	 * at this point we are not running a batch. select the appropriate
+	 * class
+	 */
+
+	if (reads) {
+		BUG_ON(RB_EMPTY_ROOT(&rd->sort_list[READ]));
+
+		if (writes && (rprio_writes_expired(rd) ||
+			       rd->starved++ >= rd->writes_starved))
+			goto dispatch_writes;
+
+		data_dir = READ;
+		class = RPRIO_READ;
+
+		goto dispatch_find_request;
+	}
+
+	/*
+	 * there are either no reads or writes have been starved
+	 */
+
+	if (writes) {
+		if (!force && rprio_should_idle(q, rd))
+			return 0;
+dispatch_writes:
+		BUG_ON(RB_EMPTY_ROOT(&rd->sort_list[WRITE]));
+
+		rd->starved = 0;
+
+		data_dir = WRITE;
+		if (list_empty(&rd->fifo_list[RPRIO_SYNC_WRITE]) ||
+		    rprio_check_fifo(rd, RPRIO_ASYNC_WRITE))
+			class = RPRIO_ASYNC_WRITE;
+		else
+			class = RPRIO_SYNC_WRITE;
+
+		goto dispatch_find_request;
+	}
+
+	return 0;
+
+dispatch_find_request:
+	/*
+	 * we are not running a batch, find best request for selected class
+	 */
+	if (rprio_check_fifo(rd, class) || !rd->next_rq[data_dir]) {
+		/*
+		 * A deadline has expired, the last request was in the other
+		 * direction, or we have run out of higher-sectored requests.
+		 * Start again from the request with the earliest expiry time.
+		 */
+		rq = rq_entry_fifo(rd->fifo_list[class].next);
+	} else {
+		/*
+		 * The last req was the same dir and we have a next request in
+		 * sort order. No expired requests so continue on from here.
+		 */
+		rq = rd->next_rq[data_dir];
+	}
+
+	rd->batching = 0;
+
+dispatch_request:
+	/*
+	 * rq is the selected appropriate request.
+	 */
+	rd->batching++;
+	rprio_move_request(rd, rq);
+
+	return 1;
+}
+
+static void rprio_completed_request(struct request_queue *q,
+				    struct request *rq)
+{
+	struct rprio_data *rd = q->elevator->elevator_data;
+
+	if (rq_data_dir(rq) == READ) {
+		rd->last_read = jiffies;
+		rd->read_wait = true;
+	}
+}
+
+static int rprio_is_urgent(struct request_queue *q)
+{
+	struct rprio_data *rd = q->elevator->elevator_data;
+
+	return !list_empty(&rd->fifo_list[RPRIO_READ]);
+}
+
+static void rprio_kick_queue(struct work_struct *work)
+{
+	struct rprio_data *rd =
+		container_of(work, struct rprio_data, unplug_work);
+	struct request_queue *q = rd->queue;
+
+	spin_lock_irq(q->queue_lock);
+	__blk_run_queue(q);
+	spin_unlock_irq(q->queue_lock);
+}
+
+/*
+ * Timer running while idling for a read, stops the wait for writes
+ */
+static void rprio_idle_timer(unsigned long data)
+{
+	struct rprio_data *rd = (struct rprio_data *)data;
+
+	kblockd_schedule_work(rd->queue, &rd->unplug_work);
+}
+
+static void rprio_exit_queue(struct elevator_queue *e)
+{
+	struct rprio_data *rd = e->elevator_data;
+	int class;
+
+	del_timer_sync(&rd->idle_timer);
+	cancel_work_sync(&rd->unplug_work);
+
+	for (class = 0; class < RPRIO_NR_CLASSES; class++)
+		BUG_ON(!list_empty(&rd->fifo_list[class]));
+
+	kfree(rd);
+}
+
+/*
+ * initialize elevator private data (rprio_data).
+ */
+static void *rprio_init_queue(struct request_queue *q)
+{
+	struct rprio_data *rd;
+	int class;
+
+	rd = kmalloc_node(sizeof(*rd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!rd)
+		return NULL;
+
+	rd->queue = q;
+	for (class = 0; class < RPRIO_NR_CLASSES; class++)
+		INIT_LIST_HEAD(&rd->fifo_list[class]);
+	rd->sort_list[READ] = RB_ROOT;
+	rd->sort_list[WRITE] = RB_ROOT;
+	setup_timer(&rd->idle_timer, rprio_idle_timer, (unsigned long)rd);
+	INIT_WORK(&rd->unplug_work, rprio_kick_queue);
+	rd->fifo_expire[RPRIO_READ] = read_expire;
+	rd->fifo_expire[RPRIO_SYNC_WRITE] = sync_write_expire;
+	rd->fifo_expire[RPRIO_ASYNC_WRITE] = async_write_expire;
+	rd->writes_starved = writes_starved;
+	rd->front_merges = 1;
+	rd->fifo_batch = fifo_batch;
+	rd->read_idle = msecs_to_jiffies(read_idle);
+	return rd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+rprio_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+rprio_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct rprio_data *rd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return rprio_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(rprio_read_expire_show, rd->fifo_expire[RPRIO_READ], 1);
+SHOW_FUNCTION(rprio_sync_write_expire_show, rd->fifo_expire[RPRIO_SYNC_WRITE], 1);
+SHOW_FUNCTION(rprio_async_write_expire_show, rd->fifo_expire[RPRIO_ASYNC_WRITE], 1);
+SHOW_FUNCTION(rprio_writes_starved_show, rd->writes_starved, 0);
+SHOW_FUNCTION(rprio_front_merges_show, rd->front_merges, 0);
+SHOW_FUNCTION(rprio_fifo_batch_show, rd->fifo_batch, 0);
+SHOW_FUNCTION(rprio_read_idle_show, rd->read_idle, 1);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct rprio_data *rd = e->elevator_data;			\
+	int __data;							\
+	int ret = rprio_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(rprio_read_expire_store, &rd->fifo_expire[RPRIO_READ], 0, INT_MAX, 1);
+STORE_FUNCTION(rprio_sync_write_expire_store, &rd->fifo_expire[RPRIO_SYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(rprio_async_write_expire_store, &rd->fifo_expire[RPRIO_ASYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(rprio_writes_starved_store, &rd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(rprio_front_merges_store, &rd->front_merges, 0, 1, 0);
+STORE_FUNCTION(rprio_fifo_batch_store, &rd->fifo_batch, 1, INT_MAX, 0);
+STORE_FUNCTION(rprio_read_idle_store, &rd->read_idle, 0, 1000, 1);
+#undef STORE_FUNCTION
+
+/*
+ * dispatch latency per class: "requests total_us max_us", any write resets
+ */
+static ssize_t
+rprio_lat_show(struct rprio_data *rd, int class, char *page)
+{
+	struct request_queue *q = rd->queue;
+	struct rprio_lat lat;
+
+	spin_lock_irq(q->queue_lock);
+	lat = rd->lat[class];
+	spin_unlock_irq(q->queue_lock);
+
+	return sprintf(page, "%lu %llu %lu\n", lat.count,
+		       (unsigned long long)lat.total_us, lat.max_us);
+}
+
+static ssize_t
+rprio_lat_store(struct rprio_data *rd, int class, size_t count)
+{
+	struct request_queue *q = rd->queue;
+
+	spin_lock_irq(q->queue_lock);
+	memset(&rd->lat[class], 0, sizeof(rd->lat[class]));
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
+
+#define LAT_FUNCTIONS(__NAME, __CLASS)					\
+static ssize_t rprio_##__NAME##_show(struct elevator_queue *e, char *page) \
+{									\
+	return rprio_lat_show(e->elevator_data, __CLASS, page);	\
+}									\
+static ssize_t rprio_##__NAME##_store(struct elevator_queue *e,	\
+				      const char *page, size_t count)	\
+{									\
+	return rprio_lat_store(e->elevator_data, __CLASS, count);	\
+}
+LAT_FUNCTIONS(read_lat, RPRIO_READ);
+LAT_FUNCTIONS(sync_write_lat, RPRIO_SYNC_WRITE);
+LAT_FUNCTIONS(async_write_lat, RPRIO_ASYNC_WRITE);
+#undef LAT_FUNCTIONS
+
+#define RD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, rprio_##name##_show, \
+				      rprio_##name##_store)
+
+static struct elv_fs_entry rprio_attrs[] = {
+	RD_ATTR(read_expire),
+	RD_ATTR(sync_write_expire),
+	RD_ATTR(async_write_expire),
+	RD_ATTR(writes_starved),
+	RD_ATTR(front_merges),
+	RD_ATTR(fifo_batch),
+	RD_ATTR(read_idle),
+	RD_ATTR(read_lat),
+	RD_ATTR(sync_write_lat),
+	RD_ATTR(async_write_lat),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_rprio = {
+	.ops = {
+		.elevator_merge_fn = 		rprio_merge,
+		.elevator_merged_fn =		rprio_merged_request,
+		.elevator_merge_req_fn =	rprio_merged_requests,
+		.elevator_dispatch_fn =		rprio_dispatch_requests,
+		.elevator_add_req_fn =		rprio_add_request,
+		.elevator_completed_req_fn =	rprio_completed_request,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_is_urgent_fn =	rprio_is_urgent,
+		.elevator_init_fn =		rprio_init_queue,
+		.elevator_exit_fn =		rprio_exit_queue,
+	},
+
+	.elevator_attrs = rprio_attrs,
+	.elevator_name = "rprio",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init rprio_init(void)
+{
+	return elv_register(&iosched_rprio);
+}
+
+static void __exit rprio_exit(void)
+{
+	elv_unregister(&iosched_rprio);
+}
+
+module_init(rprio_init);
+module_exit(rprio_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("read-priority IO scheduler");
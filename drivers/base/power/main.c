@@ -29,6 +29,8 @@
 #include <linux/async.h>
 #include <linux/suspend.h>
 #include <linux/timer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "../base.h"
 #include "power.h"
@@ -359,6 +361,150 @@ static void pm_dev_err(struct device *dev, pm_message_t state, char *info,
 		dev_name(dev), pm_verb(state.event), info, error);
 }
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Where the last system resume went: the length of each phase and the
+ * slowest device callbacks, kept sorted by time. With async resume the
+ * callbacks overlap, so they do not add up to the phase totals.
+ */
+#define DPM_RESUME_PROFILE_DEVICES	32
+
+enum {
+	DPM_PHASE_NOIRQ,
+	DPM_PHASE_EARLY,
+	DPM_PHASE_RESUME,
+	DPM_PHASE_MAX,
+};
+
+static const char * const dpm_phase_names[DPM_PHASE_MAX] = {
+	[DPM_PHASE_NOIRQ]	= "noirq",
+	[DPM_PHASE_EARLY]	= "early",
+	[DPM_PHASE_RESUME]	= "resume",
+};
+
+static struct {
+	u64 phase_us[DPM_PHASE_MAX];
+
+	struct {
+		char name[32];
+		int phase;
+		u64 us;
+	} dev[DPM_RESUME_PROFILE_DEVICES];
+	int nr_dev;
+} dpm_resume_profile;
+
+static DEFINE_SPINLOCK(dpm_resume_profile_lock);
+
+/* resume phase in progress, -1 outside of dpm_resume{_noirq,_early,} */
+static int dpm_resume_phase = -1;
+
+static void dpm_resume_profile_start(int phase)
+{
+	dpm_resume_phase = phase;
+}
+
+static void dpm_resume_profile_reset(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dpm_resume_profile_lock, flags);
+	memset(&dpm_resume_profile, 0, sizeof(dpm_resume_profile));
+	spin_unlock_irqrestore(&dpm_resume_profile_lock, flags);
+}
+
+static void dpm_resume_profile_end(ktime_t starttime)
+{
+	if (dpm_resume_phase < 0)
+		return;
+
+	dpm_resume_profile.phase_us[dpm_resume_phase] =
+		ktime_to_us(ktime_sub(ktime_get(), starttime));
+	dpm_resume_phase = -1;
+}
+
+static void dpm_resume_profile_device(struct device *dev, ktime_t calltime)
+{
+	int phase = dpm_resume_phase;
+	unsigned long flags;
+	u64 us;
+	int i;
+
+	if (phase < 0)
+		return;
+
+	us = ktime_to_us(ktime_sub(ktime_get(), calltime));
+
+	spin_lock_irqsave(&dpm_resume_profile_lock, flags);
+	i = dpm_resume_profile.nr_dev;
+	if (i == DPM_RESUME_PROFILE_DEVICES) {
+		if (us <= dpm_resume_profile.dev[i - 1].us)
+			goto out;
+		i--;
+	} else {
+		dpm_resume_profile.nr_dev++;
+	}
+
+	/* insertion sort, slowest first */
+	for (; i > 0 && dpm_resume_profile.dev[i - 1].us < us; i--)
+		dpm_resume_profile.dev[i] = dpm_resume_profile.dev[i - 1];
+
+	strlcpy(dpm_resume_profile.dev[i].name, dev_name(dev),
+		sizeof(dpm_resume_profile.dev[i].name));
+	dpm_resume_profile.dev[i].phase = phase;
+	dpm_resume_profile.dev[i].us = us;
+out:
+	spin_unlock_irqrestore(&dpm_resume_profile_lock, flags);
+}
+
+static int dpm_resume_profile_show(struct seq_file *s, void *data)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&dpm_resume_profile_lock, flags);
+	seq_printf(s, "%-32s %-8s %10s\n", "phase", "", "usecs");
+	for (i = 0; i < DPM_PHASE_MAX; i++)
+		seq_printf(s, "%-32s %-8s %10llu\n", dpm_phase_names[i], "",
+			   dpm_resume_profile.phase_us[i]);
+
+	seq_printf(s, "\n%-32s %-8s %10s\n", "device", "phase", "usecs");
+	for (i = 0; i < dpm_resume_profile.nr_dev; i++)
+		seq_printf(s, "%-32s %-8s %10llu\n",
+			   dpm_resume_profile.dev[i].name,
+			   dpm_phase_names[dpm_resume_profile.dev[i].phase],
+			   dpm_resume_profile.dev[i].us);
+	spin_unlock_irqrestore(&dpm_resume_profile_lock, flags);
+
+	return 0;
+}
+
+static int dpm_resume_profile_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dpm_resume_profile_show, inode->i_private);
+}
+
+static const struct file_operations dpm_resume_profile_fops = {
+	.open		= dpm_resume_profile_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init dpm_resume_profile_debugfs_init(void)
+{
+	debugfs_create_file("pm_resume_times", S_IRUGO, NULL, NULL,
+			    &dpm_resume_profile_fops);
+	return 0;
+}
+postcore_initcall(dpm_resume_profile_debugfs_init);
+#else
+static inline void dpm_resume_profile_reset(void) {}
+static inline void dpm_resume_profile_start(int phase) {}
+static inline void dpm_resume_profile_end(ktime_t starttime) {}
+static inline void dpm_resume_profile_device(struct device *dev,
+					     ktime_t calltime) {}
+#endif
+
 static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 {
 	ktime_t calltime;
@@ -379,19 +525,21 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 			    pm_message_t state, char *info)
 {
-	ktime_t calltime;
+	ktime_t calltime, start;
 	int error;
 
 	if (!cb)
 		return 0;
 
 	calltime = initcall_debug_start(dev);
+	start = ktime_get();
 
 	pm_dev_dbg(dev, state, info);
 	error = cb(dev);
 	suspend_report_result(cb, error);
 
 	initcall_debug_report(dev, calltime, error);
+	dpm_resume_profile_device(dev, start);
 
 	return error;
 }
@@ -501,6 +649,7 @@ static void dpm_resume_noirq(pm_message_t state)
 {
 	ktime_t starttime = ktime_get();
 
+	dpm_resume_profile_start(DPM_PHASE_NOIRQ);
 	mutex_lock(&dpm_list_mtx);
 	while (!list_empty(&dpm_noirq_list)) {
 		struct device *dev = to_device(dpm_noirq_list.next);
@@ -522,6 +671,7 @@ static void dpm_resume_noirq(pm_message_t state)
 		put_device(dev);
 	}
 	mutex_unlock(&dpm_list_mtx);
+	dpm_resume_profile_end(starttime);
 	dpm_show_time(starttime, state, "noirq");
 	resume_device_irqs();
 }
@@ -575,6 +725,7 @@ static void dpm_resume_early(pm_message_t state)
 {
 	ktime_t starttime = ktime_get();
 
+	dpm_resume_profile_start(DPM_PHASE_EARLY);
 	mutex_lock(&dpm_list_mtx);
 	while (!list_empty(&dpm_late_early_list)) {
 		struct device *dev = to_device(dpm_late_early_list.next);
@@ -596,6 +747,7 @@ static void dpm_resume_early(pm_message_t state)
 		put_device(dev);
 	}
 	mutex_unlock(&dpm_list_mtx);
+	dpm_resume_profile_end(starttime);
 	dpm_show_time(starttime, state, "early");
 }
 
@@ -732,6 +884,7 @@ void dpm_resume(pm_message_t state)
 
 	might_sleep();
 
+	dpm_resume_profile_start(DPM_PHASE_RESUME);
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 	async_error = 0;
@@ -768,6 +921,7 @@ void dpm_resume(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	dpm_resume_profile_end(starttime);
 	dpm_show_time(starttime, state, NULL);
 }
 
@@ -1359,6 +1513,8 @@ int dpm_suspend_start(pm_message_t state)
 {
 	int error;
 
+	dpm_resume_profile_reset();
+
 	error = dpm_prepare(state);
 	if (error) {
 		suspend_stats.failed_prepare++;
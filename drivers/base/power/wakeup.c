@@ -653,6 +653,73 @@ void pm_wakeup_event(struct device *dev, unsigned int msec)
 }
 EXPORT_SYMBOL_GPL(pm_wakeup_event);
 
+/* Total time @ws has been active, including the current activation. */
+static ktime_t wakeup_source_active_time(struct wakeup_source *ws, ktime_t now)
+{
+	if (ws->active)
+		return ktime_add(ws->total_time, ktime_sub(now, ws->last_time));
+	return ws->total_time;
+}
+
+/**
+ * pm_wakeup_attribution_start - Start charging wakeup sources for a wakeup.
+ *
+ * Remember how long every wakeup source has been active so far, so that
+ * pm_wakeup_attribution_end() can tell which of them kept the system awake
+ * in between, typically from a system wakeup to the next suspend.
+ */
+void pm_wakeup_attribution_start(void)
+{
+	struct wakeup_source *ws;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		spin_lock_irqsave(&ws->lock, flags);
+		ws->attr_time = wakeup_source_active_time(ws, now);
+		spin_unlock_irqrestore(&ws->lock, flags);
+	}
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL_GPL(pm_wakeup_attribution_start);
+
+/**
+ * pm_wakeup_attribution_end - Find the wakeup source that held the system.
+ * @name: Buffer for the name of the wakeup source, empty if there is none.
+ * @len: Size of @name.
+ *
+ * Return how long the wakeup source that has been active the longest since
+ * pm_wakeup_attribution_start() was active in that time.
+ */
+ktime_t pm_wakeup_attribution_end(char *name, size_t len)
+{
+	struct wakeup_source *ws;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	ktime_t max = ktime_set(0, 0);
+	ktime_t held;
+
+	if (len)
+		name[0] = '\0';
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		spin_lock_irqsave(&ws->lock, flags);
+		held = ktime_sub(wakeup_source_active_time(ws, now),
+				 ws->attr_time);
+		if (ktime_to_ns(held) > ktime_to_ns(max)) {
+			max = held;
+			strlcpy(name, ws->name, len);
+		}
+		spin_unlock_irqrestore(&ws->lock, flags);
+	}
+	rcu_read_unlock();
+
+	return max;
+}
+EXPORT_SYMBOL_GPL(pm_wakeup_attribution_end);
+
 static void print_active_wakeup_sources(void)
 {
 	struct wakeup_source *ws;
@@ -1236,6 +1236,42 @@ unsigned int cpufreq_quick_get_max(unsigned int cpu)
 }
 EXPORT_SYMBOL(cpufreq_quick_get_max);
 
+/**
+ * cpufreq_freq_capacity - compute capacity of a CPU at a given frequency
+ * @cpu: CPU number
+ * @freq: frequency in kHz
+ *
+ * Returns the capacity in kHz of the fastest core type, so that load
+ * measured at different frequencies and on different core types (e.g.
+ * a companion low power core) can be compared. Without a driver hook
+ * this is the frequency itself.
+ */
+unsigned int cpufreq_freq_capacity(unsigned int cpu, unsigned int freq)
+{
+	if (cpufreq_driver && cpufreq_driver->capacity)
+		return cpufreq_driver->capacity(cpu, freq);
+
+	return freq;
+}
+EXPORT_SYMBOL(cpufreq_freq_capacity);
+
+/**
+ * cpufreq_mem_load - how memory bound a CPU is
+ * @cpu: CPU number
+ *
+ * Returns the share of the memory bandwidth taken by CPU traffic, in per
+ * mille. A high value means a higher CPU frequency would mostly wait on
+ * memory. Without a driver hook this is 0.
+ */
+unsigned int cpufreq_mem_load(unsigned int cpu)
+{
+	if (cpufreq_driver && cpufreq_driver->mem_load)
+		return cpufreq_driver->mem_load(cpu);
+
+	return 0;
+}
+EXPORT_SYMBOL(cpufreq_mem_load);
+
 
 static unsigned int __cpufreq_get(unsigned int cpu)
 {
@@ -0,0 +1,386 @@
+/*
+ * drivers/cpufreq/cpufreq_framedeadline.c
+ *
+ * CPU frequency governor driven by frame completion deadlines
+ *
+ * Copyright (c) 2013, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+/*
+ * Utilization tells how busy the CPU was; for a game the question is
+ * whether the frame was ready in time.  Every completed frame is reported
+ * with its deadline, either by the tegra-throughput flip callback or by
+ * the application itself through the throughput ioctl.  The CPU time the
+ * frame took is scaled to the current capacity, and the lowest frequency
+ * that still completes it within 'margin' percent of the deadline is
+ * picked.  The frequency is raised as soon as a frame is projected to
+ * miss, and lowered only after 'down_frames' frames in a row had slack.
+ *
+ * Without frame reports the governor samples every 'sample_ms' and treats
+ * the sample period as the deadline.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/cpu.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/tick.h>
+#include <linux/workqueue.h>
+
+#define DEFAULT_MARGIN		90
+#define DEFAULT_DOWN_FRAMES	4
+#define DEFAULT_SAMPLE_MS	50
+/* frames reported by the application mask the flip callback this long */
+#define EXPLICIT_TIMEOUT	HZ
+
+struct cpufreq_fd_cpuinfo {
+	struct cpufreq_policy *policy;
+	struct cpufreq_frequency_table *freq_table;
+	u64 prev_idle;
+	u64 prev_wall;
+	/* policy->cpu only */
+	unsigned int down_count;
+	unsigned int down_target;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_fd_cpuinfo, fd_cpuinfo);
+
+/* protects the cpuinfo and serializes frequency changes */
+static DEFINE_MUTEX(fd_mutex);
+static unsigned int active_count;
+
+static DEFINE_SPINLOCK(fd_frame_lock);
+static unsigned int frame_busy_us;	/* 0: measure from idle time */
+static unsigned int frame_deadline_us;
+static bool explicit_frames;
+static unsigned long explicit_stamp;
+
+static struct work_struct fd_frame_work;
+static struct delayed_work fd_sample_work;
+
+static unsigned long margin = DEFAULT_MARGIN;
+static unsigned long down_frames = DEFAULT_DOWN_FRAMES;
+static unsigned long sample_ms = DEFAULT_SAMPLE_MS;
+
+static u64 cpufreq_fd_idle_time(unsigned int cpu, u64 *wall)
+{
+	u64 idle = get_cpu_idle_time_us(cpu, wall);
+
+	if (idle == -1ULL) {
+		/* no NOHZ idle accounting: count the CPU as busy */
+		*wall = ktime_to_us(ktime_get());
+		idle = 0;
+	}
+	return idle;
+}
+
+/* busiest CPU of the policy over the last window */
+static void cpufreq_fd_window(struct cpufreq_policy *policy,
+			      unsigned int *busy_us, unsigned int *wall_us)
+{
+	struct cpufreq_fd_cpuinfo *pcpu;
+	unsigned int j;
+	u64 idle, wall;
+	u64 d_idle, d_wall;
+
+	*busy_us = 0;
+	*wall_us = 0;
+
+	for_each_cpu(j, policy->cpus) {
+		pcpu = &per_cpu(fd_cpuinfo, j);
+		idle = cpufreq_fd_idle_time(j, &wall);
+
+		d_wall = wall - pcpu->prev_wall;
+		d_idle = idle - pcpu->prev_idle;
+		pcpu->prev_wall = wall;
+		pcpu->prev_idle = idle;
+
+		if (d_wall > UINT_MAX || d_idle > d_wall)
+			continue;
+
+		*wall_us = max_t(unsigned int, *wall_us, d_wall);
+		*busy_us = max_t(unsigned int, *busy_us, d_wall - d_idle);
+	}
+}
+
+static unsigned int cpufreq_fd_target(struct cpufreq_fd_cpuinfo *pcpu,
+				      unsigned int busy_us,
+				      unsigned int deadline_us)
+{
+	struct cpufreq_policy *policy = pcpu->policy;
+	struct cpufreq_frequency_table *table = pcpu->freq_table;
+	unsigned int target_freq = policy->max;
+	unsigned int budget_us;
+	unsigned int freq;
+	u64 required;
+	int i;
+
+	budget_us = deadline_us * margin / 100;
+	if (!budget_us || !table)
+		return policy->max;
+
+	/* capacity the frame needs to complete within the budget */
+	required = (u64)cpufreq_freq_capacity(policy->cpu, policy->cur) *
+		busy_us;
+	required = div_u64(required, budget_us);
+
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		freq = table[i].frequency;
+		if (freq == CPUFREQ_ENTRY_INVALID ||
+		    freq < policy->min || freq > policy->max)
+			continue;
+		if (freq < target_freq &&
+		    cpufreq_freq_capacity(policy->cpu, freq) >= required)
+			target_freq = freq;
+	}
+
+	return target_freq;
+}
+
+/* must be called with fd_mutex held */
+static void cpufreq_fd_update(struct cpufreq_policy *policy,
+			      unsigned int busy_us, unsigned int deadline_us)
+{
+	struct cpufreq_fd_cpuinfo *pcpu = &per_cpu(fd_cpuinfo, policy->cpu);
+	unsigned int measured_us;
+	unsigned int wall_us;
+	unsigned int freq;
+
+	cpufreq_fd_window(policy, &measured_us, &wall_us);
+	if (!busy_us)
+		busy_us = measured_us;
+	if (!deadline_us)
+		deadline_us = wall_us;
+
+	freq = cpufreq_fd_target(pcpu, busy_us, deadline_us);
+
+	if (freq > policy->cur) {
+		/* projected to miss the deadline */
+		pcpu->down_count = 0;
+		__cpufreq_driver_target(policy, freq, CPUFREQ_RELATION_L);
+		return;
+	}
+
+	if (!pcpu->down_count || freq > pcpu->down_target)
+		pcpu->down_target = freq;
+	if (++pcpu->down_count < down_frames)
+		return;
+
+	pcpu->down_count = 0;
+	if (pcpu->down_target < policy->cur)
+		__cpufreq_driver_target(policy, pcpu->down_target,
+					CPUFREQ_RELATION_L);
+}
+
+static void cpufreq_fd_update_all(unsigned int busy_us,
+				  unsigned int deadline_us)
+{
+	struct cpufreq_fd_cpuinfo *pcpu;
+	unsigned int cpu;
+
+	mutex_lock(&fd_mutex);
+	for_each_online_cpu(cpu) {
+		pcpu = &per_cpu(fd_cpuinfo, cpu);
+		if (pcpu->policy && pcpu->policy->cpu == cpu)
+			cpufreq_fd_update(pcpu->policy, busy_us, deadline_us);
+	}
+	if (active_count)
+		schedule_delayed_work(&fd_sample_work,
+				      msecs_to_jiffies(sample_ms));
+	mutex_unlock(&fd_mutex);
+}
+
+static void cpufreq_fd_frame_work(struct work_struct *work)
+{
+	unsigned long flags;
+	unsigned int busy_us;
+	unsigned int deadline_us;
+
+	spin_lock_irqsave(&fd_frame_lock, flags);
+	busy_us = frame_busy_us;
+	deadline_us = frame_deadline_us;
+	spin_unlock_irqrestore(&fd_frame_lock, flags);
+
+	cancel_delayed_work(&fd_sample_work);
+	cpufreq_fd_update_all(busy_us, deadline_us);
+}
+
+static void cpufreq_fd_sample_work(struct work_struct *work)
+{
+	cpufreq_fd_update_all(0, 0);
+}
+
+/**
+ * cpufreq_framedeadline_frame - report a completed frame
+ * @busy_us:	CPU time the frame took, 0 to measure it from idle time
+ * @deadline_us: time the frame had
+ *
+ * Can be called from atomic context.
+ */
+void cpufreq_framedeadline_frame(unsigned int busy_us,
+				 unsigned int deadline_us)
+{
+	unsigned long flags;
+
+	if (!active_count || !deadline_us)
+		return;
+
+	spin_lock_irqsave(&fd_frame_lock, flags);
+	if (busy_us) {
+		explicit_frames = true;
+		explicit_stamp = jiffies;
+	} else if (explicit_frames) {
+		if (time_before(jiffies, explicit_stamp + EXPLICIT_TIMEOUT)) {
+			spin_unlock_irqrestore(&fd_frame_lock, flags);
+			return;
+		}
+		explicit_frames = false;
+	}
+	frame_busy_us = busy_us;
+	frame_deadline_us = deadline_us;
+	spin_unlock_irqrestore(&fd_frame_lock, flags);
+
+	schedule_work(&fd_frame_work);
+}
+EXPORT_SYMBOL_GPL(cpufreq_framedeadline_frame);
+
+#define DECL_CPUFREQ_FD_ATTR(name) \
+static ssize_t show_##name(struct kobject *kobj, \
+	struct attribute *attr, char *buf) \
+{ \
+	return sprintf(buf, "%lu\n", name); \
+} \
+\
+static ssize_t store_##name(struct kobject *kobj,\
+		struct attribute *attr, const char *buf, size_t count) \
+{ \
+	int ret; \
+	unsigned long val; \
+\
+	ret = strict_strtoul(buf, 0, &val); \
+	if (ret < 0) \
+		return ret; \
+	if (!val) \
+		return -EINVAL; \
+	name = val; \
+	return count; \
+} \
+\
+static struct global_attr name##_attr = __ATTR(name, 0644, \
+		show_##name, store_##name);
+
+DECL_CPUFREQ_FD_ATTR(margin)
+DECL_CPUFREQ_FD_ATTR(down_frames)
+DECL_CPUFREQ_FD_ATTR(sample_ms)
+
+#undef DECL_CPUFREQ_FD_ATTR
+
+static struct attribute *fd_attributes[] = {
+	&margin_attr.attr,
+	&down_frames_attr.attr,
+	&sample_ms_attr.attr,
+	NULL,
+};
+
+static struct attribute_group fd_attr_group = {
+	.attrs = fd_attributes,
+	.name = "framedeadline",
+};
+
+static int cpufreq_governor_framedeadline(struct cpufreq_policy *policy,
+					  unsigned int event)
+{
+	struct cpufreq_fd_cpuinfo *pcpu;
+	unsigned int j;
+	int rc;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if (!cpu_online(policy->cpu))
+			return -EINVAL;
+
+		mutex_lock(&fd_mutex);
+		if (!active_count) {
+			rc = sysfs_create_group(cpufreq_global_kobject,
+						&fd_attr_group);
+			if (rc) {
+				mutex_unlock(&fd_mutex);
+				return rc;
+			}
+		}
+
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(fd_cpuinfo, j);
+			pcpu->policy = policy;
+			pcpu->freq_table = cpufreq_frequency_get_table(j);
+			pcpu->prev_idle = cpufreq_fd_idle_time(j,
+							&pcpu->prev_wall);
+			pcpu->down_count = 0;
+		}
+
+		if (!active_count++)
+			schedule_delayed_work(&fd_sample_work,
+					      msecs_to_jiffies(sample_ms));
+		mutex_unlock(&fd_mutex);
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		mutex_lock(&fd_mutex);
+		for_each_cpu(j, policy->cpus)
+			per_cpu(fd_cpuinfo, j).policy = NULL;
+
+		if (!--active_count)
+			sysfs_remove_group(cpufreq_global_kobject,
+					   &fd_attr_group);
+		mutex_unlock(&fd_mutex);
+
+		if (!active_count) {
+			cancel_work_sync(&fd_frame_work);
+			cancel_delayed_work_sync(&fd_sample_work);
+		}
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		mutex_lock(&fd_mutex);
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy,
+					policy->max, CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy,
+					policy->min, CPUFREQ_RELATION_L);
+		mutex_unlock(&fd_mutex);
+		break;
+	}
+	return 0;
+}
+
+static struct cpufreq_governor cpufreq_gov_framedeadline = {
+	.name			= "framedeadline",
+	.governor		= cpufreq_governor_framedeadline,
+	.owner			= THIS_MODULE,
+};
+
+static int __init cpufreq_framedeadline_init(void)
+{
+	INIT_WORK(&fd_frame_work, cpufreq_fd_frame_work);
+	INIT_DELAYED_WORK(&fd_sample_work, cpufreq_fd_sample_work);
+
+	return cpufreq_register_governor(&cpufreq_gov_framedeadline);
+}
+
+module_init(cpufreq_framedeadline_init);
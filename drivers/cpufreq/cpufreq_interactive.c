@@ -21,6 +21,7 @@
 #include <linux/cpumask.h>
 #include <linux/cpufreq.h>
 #include <linux/module.h>
+#include <linux/math64.h>
 #include <linux/mutex.h>
 #include <linux/sched.h>
 #include <linux/tick.h>
@@ -76,6 +77,25 @@ static unsigned long io_is_busy;
  */
 static unsigned long sustain_load;
 
+/*
+ * Target load relative to compute capacity. Load is normalized to the
+ * capacity it was measured at (frequency scaled for the core type, see
+ * cpufreq_freq_capacity()) and the new speed is the lowest one whose
+ * capacity runs the same work at this load.
+ * If 0, the go_maxspeed_load / sustain_load policy is used instead.
+ */
+#define DEFAULT_TARGET_LOAD 80
+static unsigned long target_load;
+
+/*
+ * Do not raise the speed while the share of memory bandwidth taken by CPU
+ * traffic (per mille, see cpufreq_mem_load()) is at or above this value:
+ * the extra cycles would be spent waiting on memory.
+ * If 0, memory boundness is not considered.
+ */
+#define DEFAULT_MEM_BOUND_LOAD 600
+static unsigned long mem_bound_load;
+
 /*
  * The minimum amount of time to spend at a frequency before we can ramp down.
  */
@@ -134,12 +154,49 @@ struct cpufreq_governor cpufreq_gov_interactive = {
 	.owner = THIS_MODULE,
 };
 
+static unsigned int cpufreq_interactive_capacity_target(
+	int cpu_load, unsigned int tload,
+	struct cpufreq_interactive_cpuinfo *pcpu)
+{
+	struct cpufreq_policy *policy = pcpu->policy;
+	struct cpufreq_frequency_table *table = pcpu->freq_table;
+	unsigned int target_freq = policy->max;
+	unsigned int freq;
+	u64 required;
+	int i;
+
+	/* capacity used over the sample, in percent of one capacity unit */
+	required = (u64)cpufreq_freq_capacity(policy->cpu, policy->cur) *
+		cpu_load;
+
+	/* a saturated cpu hides its real demand: ramp by boost_factor */
+	if (cpu_load >= go_maxspeed_load && boost_factor)
+		required *= boost_factor;
+
+	required = div_u64(required, tload);
+
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		freq = table[i].frequency;
+		if (freq == CPUFREQ_ENTRY_INVALID ||
+		    freq < policy->min || freq > policy->max)
+			continue;
+		if (freq < target_freq &&
+		    cpufreq_freq_capacity(policy->cpu, freq) >= required)
+			target_freq = freq;
+	}
+
+	return target_freq;
+}
+
 static unsigned int cpufreq_interactive_get_target(
-	int cpu_load, int load_since_change, struct cpufreq_policy *policy)
+	int cpu_load, int load_since_change,
+	struct cpufreq_interactive_cpuinfo *pcpu)
 {
+	struct cpufreq_policy *policy = pcpu->policy;
 	unsigned int target_freq;
 	unsigned int maxspeed_load = go_maxspeed_load;
 	unsigned int mboost = max_boost;
+	unsigned int tload = target_load;
 
 	/*
 	 * Choose greater of short-term load (since last idle timer
@@ -149,6 +206,10 @@ static unsigned int cpufreq_interactive_get_target(
 	if (load_since_change > cpu_load)
 		cpu_load = load_since_change;
 
+	if (tload)
+		return cpufreq_interactive_capacity_target(cpu_load, tload,
+							   pcpu);
+
 	if (midrange_freq && policy->cur > midrange_freq) {
 		maxspeed_load = midrange_go_maxspeed_load;
 		mboost = midrange_max_boost;
@@ -264,7 +325,10 @@ static void cpufreq_interactive_timer(unsigned long data)
 	 * change) to determine new target frequency
 	 */
 	new_freq = cpufreq_interactive_get_target(cpu_load, load_since_change,
-						  pcpu->policy);
+						  pcpu);
+	if (mem_bound_load && new_freq > pcpu->policy->cur &&
+	    cpufreq_mem_load(data) >= mem_bound_load)
+		new_freq = pcpu->policy->cur;
 
 	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
 					   new_freq, CPUFREQ_RELATION_H,
@@ -529,6 +593,8 @@ DECL_CPUFREQ_INTERACTIVE_ATTR(io_is_busy)
 DECL_CPUFREQ_INTERACTIVE_ATTR(max_boost)
 DECL_CPUFREQ_INTERACTIVE_ATTR(midrange_max_boost)
 DECL_CPUFREQ_INTERACTIVE_ATTR(sustain_load)
+DECL_CPUFREQ_INTERACTIVE_ATTR(target_load)
+DECL_CPUFREQ_INTERACTIVE_ATTR(mem_bound_load)
 DECL_CPUFREQ_INTERACTIVE_ATTR(min_sample_time)
 DECL_CPUFREQ_INTERACTIVE_ATTR(timer_rate)
 DECL_CPUFREQ_INTERACTIVE_ATTR(high_freq_min_delay)
@@ -545,6 +611,8 @@ static struct attribute *interactive_attributes[] = {
 	&midrange_max_boost_attr.attr,
 	&io_is_busy_attr.attr,
 	&sustain_load_attr.attr,
+	&target_load_attr.attr,
+	&mem_bound_load_attr.attr,
 	&min_sample_time_attr.attr,
 	&timer_rate_attr.attr,
 	&high_freq_min_delay_attr.attr,
@@ -698,6 +766,8 @@ static int __init cpufreq_interactive_init(void)
 	timer_rate = DEFAULT_TIMER_RATE;
 	high_freq_min_delay = DEFAULT_HIGH_FREQ_MIN_DELAY;
 	max_normal_freq = DEFAULT_MAX_NORMAL_FREQ;
+	target_load = DEFAULT_TARGET_LOAD;
+	mem_bound_load = DEFAULT_MEM_BOUND_LOAD;
 
 	/* Initalize per-cpu timers */
 	for_each_possible_cpu(i) {
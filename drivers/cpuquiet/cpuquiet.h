@@ -24,6 +24,8 @@
 extern struct mutex cpuquiet_lock;
 extern struct cpuquiet_governor *cpuquiet_curr_governor;
 extern struct list_head cpuquiet_governors;
+extern bool cpuquiet_thermal_select;
+extern unsigned int cpuquiet_thermal_margin;
 int cpuquiet_add_interface(struct device *dev);
 struct cpuquiet_governor *cpuquiet_find_governor(const char *str);
 int cpuquiet_switch_governor(struct cpuquiet_governor *gov);
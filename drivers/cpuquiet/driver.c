@@ -138,6 +138,64 @@ int cpuquiet_wake_cpu(unsigned int cpunumber, bool sync)
 }
 EXPORT_SYMBOL(cpuquiet_wake_cpu);
 
+/*
+ * With thermal_select set, and a driver that reports per core temperatures,
+ * the governors' load based choice of a core is corrected by its thermal
+ * headroom: the hottest candidate is quiesced, and the coolest woken, when
+ * it is at least thermal_margin millicelsius off the governor's pick.
+ */
+bool cpuquiet_thermal_select;
+unsigned int cpuquiet_thermal_margin = 3000;
+
+static bool cpuquiet_cpu_temp(unsigned int cpu, long *temp)
+{
+	return cpuquiet_thermal_select && cpuquiet_curr_driver &&
+		cpuquiet_curr_driver->get_cpu_temp &&
+		!cpuquiet_curr_driver->get_cpu_temp(cpu, temp);
+}
+
+static unsigned int cpuquiet_thermal_pick(unsigned int cpunumber,
+					  const struct cpumask *candidates,
+					  bool hottest)
+{
+	unsigned int cpu, best = cpunumber;
+	long temp, best_temp;
+	long margin = cpuquiet_thermal_margin;
+
+	if (cpunumber >= nr_cpu_ids || !cpuquiet_cpu_temp(cpunumber, &temp))
+		return cpunumber;
+
+	best_temp = hottest ? temp + margin : temp - margin;
+	for_each_cpu(cpu, candidates) {
+		/* CPU0 is never quiesced */
+		if (cpu == 0 || cpu == cpunumber)
+			continue;
+		if (!cpuquiet_cpu_temp(cpu, &temp))
+			continue;
+		if (hottest ? temp >= best_temp : temp <= best_temp) {
+			best = cpu;
+			best_temp = temp;
+		}
+	}
+
+	return best;
+}
+
+unsigned int cpuquiet_thermal_quiesence_cpu(unsigned int cpunumber)
+{
+	return cpuquiet_thermal_pick(cpunumber, cpu_active_mask, true);
+}
+EXPORT_SYMBOL(cpuquiet_thermal_quiesence_cpu);
+
+unsigned int cpuquiet_thermal_wake_cpu(unsigned int cpunumber)
+{
+	struct cpumask inactive;
+
+	cpumask_andnot(&inactive, cpu_present_mask, cpu_active_mask);
+	return cpuquiet_thermal_pick(cpunumber, &inactive, false);
+}
+EXPORT_SYMBOL(cpuquiet_thermal_wake_cpu);
+
 int cpuquiet_register_driver(struct cpuquiet_driver *drv)
 {
 	int err = -EBUSY;
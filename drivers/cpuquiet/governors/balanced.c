@@ -77,7 +77,7 @@ static void calculate_load_timer(unsigned long data)
 	if (!load_timer_active)
 		return;
 
-	for_each_online_cpu(i) {
+	for_each_cpu(i, cpu_active_mask) {
 		struct idle_info *iinfo = &per_cpu(idleinfo, i);
 		unsigned int *load = &per_cpu(cpu_load, i);
 
@@ -104,7 +104,7 @@ static void start_load_timer(void)
 
 	load_timer_active = true;
 
-	for_each_online_cpu(i) {
+	for_each_cpu(i, cpu_active_mask) {
 		struct idle_info *iinfo = &per_cpu(idleinfo, i);
 
 		iinfo->idle_current =
@@ -128,7 +128,7 @@ static unsigned int get_slowest_cpu_n(void)
 	unsigned long minload = ULONG_MAX;
 	int i;
 
-	for_each_online_cpu(i) {
+	for_each_cpu(i, cpu_active_mask) {
 		unsigned int *load = &per_cpu(cpu_load, i);
 
 		if ((i > 0) && (minload > *load)) {
@@ -145,7 +145,7 @@ static unsigned int cpu_highest_speed(void)
 	unsigned int maxload = 0;
 	int i;
 
-	for_each_online_cpu(i) {
+	for_each_cpu(i, cpu_active_mask) {
 		unsigned int *load = &per_cpu(cpu_load, i);
 
 		maxload = max(maxload, *load);
@@ -159,7 +159,7 @@ static unsigned int count_slow_cpus(unsigned int limit)
 	unsigned int cnt = 0;
 	int i;
 
-	for_each_online_cpu(i) {
+	for_each_cpu(i, cpu_active_mask) {
 		unsigned int *load = &per_cpu(cpu_load, i);
 
 		if (*load <= limit)
@@ -204,52 +204,46 @@ static unsigned int *rt_profiles[] = {
 static unsigned int nr_run_hysteresis = 2;	/* 0.5 thread */
 static unsigned int nr_run_last;
 
-struct runnables_avg_sample {
-	u64 previous_integral;
-	unsigned int avg;
-	bool integral_sampled;
-	u64 prev_timestamp;
-};
+/*
+ * Demand prediction from per-task utilization: the utilization of tasks
+ * above heavy_task_util (of SCHED_UTIL_SCALE) is summed and divided by
+ * what one core should carry, core_util_target percent. Unlike the average
+ * number of runnable threads this follows a bursty frame thread and its
+ * helpers within a few sample periods in both directions.
+ */
+static unsigned int task_util_enable = 1;
+static unsigned int heavy_task_util = 128;	/* 12.5% */
+static unsigned int core_util_target = 80;	/* % */
 
-static DEFINE_PER_CPU(struct runnables_avg_sample, avg_nr_sample);
+/*
+ * While cpu traffic takes mem_bound_load per mille or more of the memory
+ * bandwidth (see cpufreq_mem_load()), no core is added: it would only
+ * queue more requests behind the ones already waiting. 0 disables this.
+ */
+static unsigned int mem_bound_load = 600;
 
+static unsigned int get_task_util_demand(void)
+{
+	unsigned int sum, target;
+
+	sum = sched_heavy_task_util(heavy_task_util, NULL);
+	target = SCHED_UTIL_SCALE * clamp_val(core_util_target, 10, 100);
+
+	return max(DIV_ROUND_UP(sum * 100, target), 1U);
+}
+
+/* runnable threads over the active cpus, FSHIFT fixed point */
 static unsigned int get_avg_nr_runnables(void)
 {
+	struct sched_cpu_demand demand;
 	unsigned int i, sum = 0;
-	struct runnables_avg_sample *sample;
-	u64 integral, old_integral, delta_integral, delta_time, cur_time;
-
-	for_each_online_cpu(i) {
-		sample = &per_cpu(avg_nr_sample, i);
-		integral = nr_running_integral(i);
-		old_integral = sample->previous_integral;
-		sample->previous_integral = integral;
-		cur_time = ktime_to_ns(ktime_get());
-		delta_time = cur_time - sample->prev_timestamp;
-		sample->prev_timestamp = cur_time;
-
-		if (!sample->integral_sampled) {
-			sample->integral_sampled = true;
-			/* First sample to initialize prev_integral, skip
-			 * avg calculation
-			 */
-			continue;
-		}
-
-		if (integral < old_integral) {
-			/* Overflow */
-			delta_integral = (ULLONG_MAX - old_integral) + integral;
-		} else {
-			delta_integral = integral - old_integral;
-		}
 
-		/* Calculate average for the previous sample window */
-		do_div(delta_integral, delta_time);
-		sample->avg = delta_integral;
-		sum += sample->avg;
+	for_each_cpu(i, cpu_active_mask) {
+		sched_get_cpu_demand(i, &demand);
+		sum += demand.nr_running_avg;
 	}
 
-	return sum;
+	return sum * FIXED_1 / SCHED_UTIL_SCALE;
 }
 
 static CPU_SPEED_BALANCE balanced_speed_balance(void)
@@ -257,10 +251,10 @@ static CPU_SPEED_BALANCE balanced_speed_balance(void)
 	unsigned long highest_speed = cpu_highest_speed();
 	unsigned long balanced_speed = highest_speed * balance_level / 100;
 	unsigned long skewed_speed = balanced_speed / 2;
-	unsigned int nr_cpus = num_online_cpus();
+	unsigned int nr_cpus = num_active_cpus();
 	unsigned int max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? : 4;
 	unsigned int avg_nr_run = get_avg_nr_runnables();
-	unsigned int nr_run;
+	unsigned int nr_run, nr_packed;
 	unsigned int *current_profile = rt_profiles[rt_profile_sel];
 
 	/* balanced: freq targets for all CPUs are above 50% of highest speed
@@ -275,6 +269,15 @@ static CPU_SPEED_BALANCE balanced_speed_balance(void)
 	}
 	nr_run_last = nr_run;
 
+	if (task_util_enable)
+		nr_run = min_t(unsigned int, get_task_util_demand(),
+			       ARRAY_SIZE(rt_profile_default));
+
+	/* the scheduler is packing the fair load onto this many cpus */
+	nr_packed = sched_packing_cpus();
+	if (nr_packed)
+		nr_run = min(nr_run, nr_packed);
+
 	if (count_slow_cpus(skewed_speed) >= 2 || nr_cpus > max_cpus ||
 		nr_run < nr_cpus)
 		return CPU_SPEED_SKEWED;
@@ -283,6 +286,9 @@ static CPU_SPEED_BALANCE balanced_speed_balance(void)
 		nr_run <= nr_cpus)
 		return CPU_SPEED_BIASED;
 
+	if (mem_bound_load && cpufreq_mem_load(0) >= mem_bound_load)
+		return CPU_SPEED_BIASED;
+
 	return CPU_SPEED_BALANCED;
 }
 
@@ -298,7 +304,7 @@ static void balanced_work_func(struct work_struct *work)
 	case IDLE:
 		break;
 	case DOWN:
-		cpu = get_slowest_cpu_n();
+		cpu = cpuquiet_thermal_quiesence_cpu(get_slowest_cpu_n());
 		if (cpu < nr_cpu_ids) {
 			up = false;
 			queue_delayed_work(balanced_wq,
@@ -312,13 +318,15 @@ static void balanced_work_func(struct work_struct *work)
 
 		/* cpu speed is up and balanced - one more on-line */
 		case CPU_SPEED_BALANCED:
-			cpu = cpumask_next_zero(0, cpu_online_mask);
+			cpu = cpuquiet_thermal_wake_cpu(
+				cpumask_next_zero(0, cpu_active_mask));
 			if (cpu < nr_cpu_ids)
 				up = true;
 			break;
 		/* cpu speed is up, but skewed - remove one core */
 		case CPU_SPEED_SKEWED:
-			cpu = get_slowest_cpu_n();
+			cpu = cpuquiet_thermal_quiesence_cpu(
+				get_slowest_cpu_n());
 			if (cpu < nr_cpu_ids)
 				up = false;
 			break;
@@ -431,6 +439,10 @@ CPQ_BASIC_ATTRIBUTE(load_sample_rate, 0644, uint);
 CPQ_ATTRIBUTE(core_bias, 0644, uint, core_bias_callback);
 CPQ_ATTRIBUTE(up_delay, 0644, ulong, delay_callback);
 CPQ_ATTRIBUTE(down_delay, 0644, ulong, delay_callback);
+CPQ_BASIC_ATTRIBUTE(task_util_enable, 0644, uint);
+CPQ_BASIC_ATTRIBUTE(heavy_task_util, 0644, uint);
+CPQ_BASIC_ATTRIBUTE(core_util_target, 0644, uint);
+CPQ_BASIC_ATTRIBUTE(mem_bound_load, 0644, uint);
 
 static struct attribute *balanced_attributes[] = {
 	&balance_level_attr.attr,
@@ -440,6 +452,10 @@ static struct attribute *balanced_attributes[] = {
 	&down_delay_attr.attr,
 	&load_sample_rate_attr.attr,
 	&core_bias_attr.attr,
+	&task_util_enable_attr.attr,
+	&heavy_task_util_attr.attr,
+	&core_util_target_attr.attr,
+	&mem_bound_load_attr.attr,
 	NULL,
 };
 
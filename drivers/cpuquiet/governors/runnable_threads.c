@@ -54,71 +54,26 @@ static unsigned int nr_run_thresholds[NR_CPUS];
 
 DEFINE_MUTEX(runnables_lock);
 
-struct runnables_avg_sample {
-	u64 previous_integral;
-	unsigned int avg;
-	bool integral_sampled;
-	u64 prev_timestamp;
-};
-
-static DEFINE_PER_CPU(struct runnables_avg_sample, avg_nr_sample);
-
-/* EXP = alpha in the exponential moving average.
- * Alpha = e ^ (-sample_rate / window_size) * FIXED_1
- * Calculated for sample_rate of 20ms, window size of 100ms
+/*
+ * The scheduler keeps a decayed nr_running per cpu (half-life of about
+ * 32ms), updated every tick; sum it in FSHIFT fixed point.
  */
-#define EXP    1677
-
 static unsigned int get_avg_nr_runnables(void)
 {
+	struct sched_cpu_demand demand;
 	unsigned int i, sum = 0;
-	static unsigned int avg;
-	struct runnables_avg_sample *sample;
-	u64 integral, old_integral, delta_integral, delta_time, cur_time;
-
-	for_each_online_cpu(i) {
-		sample = &per_cpu(avg_nr_sample, i);
-		integral = nr_running_integral(i);
-		old_integral = sample->previous_integral;
-		sample->previous_integral = integral;
-		cur_time = ktime_to_ns(ktime_get());
-		delta_time = cur_time - sample->prev_timestamp;
-		sample->prev_timestamp = cur_time;
-
-		if (!sample->integral_sampled) {
-			sample->integral_sampled = true;
-			/* First sample to initialize prev_integral, skip
-			 * avg calculation
-			 */
-			continue;
-		}
-
-		if (integral < old_integral) {
-			/* Overflow */
-			delta_integral = (ULLONG_MAX - old_integral) + integral;
-		} else {
-			delta_integral = integral - old_integral;
-		}
 
-		/* Calculate average for the previous sample window */
-		do_div(delta_integral, delta_time);
-		sample->avg = delta_integral;
-		sum += sample->avg;
+	for_each_cpu(i, cpu_active_mask) {
+		sched_get_cpu_demand(i, &demand);
+		sum += demand.nr_running_avg;
 	}
 
-	/* Exponential moving average
-	 * Avgn = Avgn-1 * alpha + new_avg * (1 - alpha)
-	 */
-	avg *= EXP;
-	avg += sum * (FIXED_1 - EXP);
-	avg >>= FSHIFT;
-
-	return avg;
+	return sum * FIXED_1 / SCHED_UTIL_SCALE;
 }
 
 static int get_action(unsigned int nr_run)
 {
-	unsigned int nr_cpus = num_online_cpus();
+	unsigned int nr_cpus = num_active_cpus();
 	int max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? : 4;
 	int min_cpus = pm_qos_request(PM_QOS_MIN_ONLINE_CPUS);
 
@@ -166,9 +121,12 @@ static unsigned int get_lightest_loaded_cpu_n(void)
 	unsigned int cpu = nr_cpu_ids;
 	int i;
 
-	for_each_online_cpu(i) {
-		struct runnables_avg_sample *s = &per_cpu(avg_nr_sample, i);
-		unsigned int nr_runnables = s->avg;
+	for_each_cpu(i, cpu_active_mask) {
+		struct sched_cpu_demand demand;
+		unsigned int nr_runnables;
+
+		sched_get_cpu_demand(i, &demand);
+		nr_runnables = demand.nr_running_avg;
 		if (i > 0 && min_avg_runnables > nr_runnables) {
 			cpu = i;
 			min_avg_runnables = nr_runnables;
@@ -188,11 +146,13 @@ static void runnables_work_func(struct work_struct *work)
 
 	action = get_action(nr_run_last);
 	if (action > 0) {
-		cpu = cpumask_next_zero(0, cpu_online_mask);
+		cpu = cpuquiet_thermal_wake_cpu(
+			cpumask_next_zero(0, cpu_active_mask));
 		if (cpu < nr_cpu_ids)
 			cpuquiet_wake_cpu(cpu, false);
 	} else if (action < 0) {
-		cpu = get_lightest_loaded_cpu_n();
+		cpu = cpuquiet_thermal_quiesence_cpu(
+			get_lightest_loaded_cpu_n());
 		if (cpu < nr_cpu_ids)
 			cpuquiet_quiesence_cpu(cpu, false);
 	}
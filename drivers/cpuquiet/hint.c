@@ -0,0 +1,300 @@
+/*
+ * drivers/cpuquiet/hint.c
+ *
+ * Userspace cpu demand hints. A client declares "need N cores at F kHz or
+ * above for T ms" through /dev/cpu_hint; the hint is turned into
+ * PM_QOS_MIN_ONLINE_CPUS and PM_QOS_CPU_FREQ_MIN floors that expire on their
+ * own, so the running cpuquiet and cpufreq governors keep working above
+ * them. Each open file is a client with its own time budget per window, so
+ * an application that keeps hinting gets its hints shortened and then
+ * refused instead of pinning the cores up.
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/pm_qos.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/jiffies.h>
+#include <linux/uaccess.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/cpu_hint_ioctl.h>
+
+/* longest single hint */
+static unsigned int max_hint_ms = 2000;
+module_param(max_hint_ms, uint, 0644);
+/* hinted time a client may use per budget window */
+static unsigned int budget_ms = 5000;
+module_param(budget_ms, uint, 0644);
+static unsigned int budget_window_ms = 30000;
+module_param(budget_window_ms, uint, 0644);
+/* highest frequency floor a client may ask for, 0 for no cap */
+static unsigned int max_freq_khz;
+module_param(max_freq_khz, uint, 0644);
+
+struct cpu_hint_client {
+	struct list_head	node;
+	pid_t			pid;
+	char			comm[TASK_COMM_LEN];
+
+	struct pm_qos_request	cpus_req;
+	struct pm_qos_request	freq_req;
+	unsigned int		cpus;
+	unsigned int		freq_khz;
+	unsigned long		expires;
+
+	unsigned long		window_start;
+	unsigned int		window_used_ms;
+
+	unsigned int		hints;
+	unsigned int		capped;
+	unsigned int		rejected;
+	u64			total_ms;
+};
+
+static LIST_HEAD(cpu_hint_clients);
+static DEFINE_MUTEX(cpu_hint_lock);
+
+static bool cpu_hint_active(struct cpu_hint_client *client)
+{
+	return client->expires && time_before(jiffies, client->expires);
+}
+
+/* Give back the unused part of a hint that is being replaced or dropped */
+static void cpu_hint_refund(struct cpu_hint_client *client)
+{
+	unsigned int left;
+
+	if (!cpu_hint_active(client))
+		return;
+
+	left = jiffies_to_msecs(client->expires - jiffies);
+	left = min(left, client->window_used_ms);
+	client->window_used_ms -= left;
+	client->total_ms -= left;
+	client->expires = 0;
+}
+
+static void cpu_hint_drop(struct cpu_hint_client *client)
+{
+	cpu_hint_refund(client);
+	pm_qos_update_request(&client->cpus_req,
+			      PM_QOS_MIN_ONLINE_CPUS_DEFAULT_VALUE);
+	pm_qos_update_request(&client->freq_req,
+			      PM_QOS_CPU_FREQ_MIN_DEFAULT_VALUE);
+	client->cpus = 0;
+	client->freq_khz = 0;
+}
+
+static int cpu_hint_demand(struct cpu_hint_client *client,
+			   struct cpu_hint_args *args)
+{
+	unsigned int time_ms, left;
+	unsigned long now = jiffies;
+
+	cpu_hint_drop(client);
+
+	if (!args->time_ms || (!args->cpus && !args->freq_khz)) {
+		args->time_ms = 0;
+		return 0;
+	}
+
+	if (time_after_eq(now, client->window_start +
+			  msecs_to_jiffies(budget_window_ms))) {
+		client->window_start = now;
+		client->window_used_ms = 0;
+	}
+
+	left = budget_ms > client->window_used_ms ?
+		budget_ms - client->window_used_ms : 0;
+	time_ms = min3(args->time_ms, max_hint_ms, left);
+	if (!time_ms) {
+		client->rejected++;
+		args->time_ms = 0;
+		return -EBUSY;
+	}
+	if (time_ms < args->time_ms)
+		client->capped++;
+
+	client->cpus = min(args->cpus, num_possible_cpus());
+	client->freq_khz = args->freq_khz;
+	if (max_freq_khz && client->freq_khz > max_freq_khz)
+		client->freq_khz = max_freq_khz;
+
+	if (client->cpus)
+		pm_qos_update_request_timeout(&client->cpus_req,
+					      client->cpus, time_ms * 1000);
+	if (client->freq_khz)
+		pm_qos_update_request_timeout(&client->freq_req,
+					      client->freq_khz, time_ms * 1000);
+
+	client->expires = now + msecs_to_jiffies(time_ms);
+	client->window_used_ms += time_ms;
+	client->total_ms += time_ms;
+	client->hints++;
+
+	args->time_ms = time_ms;
+	return 0;
+}
+
+static int cpu_hint_open(struct inode *inode, struct file *file)
+{
+	struct cpu_hint_client *client;
+
+	client = kzalloc(sizeof(*client), GFP_KERNEL);
+	if (!client)
+		return -ENOMEM;
+
+	client->pid = task_tgid_vnr(current);
+	get_task_comm(client->comm, current->group_leader);
+	client->window_start = jiffies;
+	pm_qos_add_request(&client->cpus_req, PM_QOS_MIN_ONLINE_CPUS,
+			   PM_QOS_MIN_ONLINE_CPUS_DEFAULT_VALUE);
+	pm_qos_add_request(&client->freq_req, PM_QOS_CPU_FREQ_MIN,
+			   PM_QOS_CPU_FREQ_MIN_DEFAULT_VALUE);
+
+	mutex_lock(&cpu_hint_lock);
+	list_add_tail(&client->node, &cpu_hint_clients);
+	mutex_unlock(&cpu_hint_lock);
+
+	file->private_data = client;
+	return 0;
+}
+
+static int cpu_hint_release(struct inode *inode, struct file *file)
+{
+	struct cpu_hint_client *client = file->private_data;
+
+	mutex_lock(&cpu_hint_lock);
+	list_del(&client->node);
+	mutex_unlock(&cpu_hint_lock);
+
+	pm_qos_remove_request(&client->cpus_req);
+	pm_qos_remove_request(&client->freq_req);
+	kfree(client);
+	return 0;
+}
+
+static long cpu_hint_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	struct cpu_hint_client *client = file->private_data;
+	struct cpu_hint_args args;
+	int err;
+
+	if ((_IOC_TYPE(cmd) != CPU_HINT_MAGIC) ||
+	    (_IOC_NR(cmd) == 0) ||
+	    (_IOC_NR(cmd) > CPU_HINT_IOCTL_MAXNR))
+		return -EFAULT;
+
+	switch (cmd) {
+	case CPU_HINT_IOCTL_DEMAND:
+		if (copy_from_user(&args, (void __user *)arg, sizeof(args)))
+			return -EFAULT;
+
+		mutex_lock(&cpu_hint_lock);
+		err = cpu_hint_demand(client, &args);
+		mutex_unlock(&cpu_hint_lock);
+
+		if (copy_to_user((void __user *)arg, &args, sizeof(args)))
+			return -EFAULT;
+		return err;
+	default:
+		return -ENOTTY;
+	}
+}
+
+static const struct file_operations cpu_hint_fops = {
+	.owner			= THIS_MODULE,
+	.open			= cpu_hint_open,
+	.release		= cpu_hint_release,
+	.unlocked_ioctl		= cpu_hint_ioctl,
+};
+
+static struct miscdevice cpu_hint_miscdev = {
+	.minor	= MISC_DYNAMIC_MINOR,
+	.name	= "cpu_hint",
+	.fops	= &cpu_hint_fops,
+	.mode	= 0666,
+};
+
+#ifdef CONFIG_DEBUG_FS
+static int cpu_hint_clients_show(struct seq_file *s, void *data)
+{
+	struct cpu_hint_client *client;
+
+	seq_printf(s, "%-7s %-16s %4s %8s %8s %8s %8s %8s %10s\n",
+		   "pid", "comm", "cpus", "freq", "left_ms", "hints",
+		   "capped", "rejected", "total_ms");
+
+	mutex_lock(&cpu_hint_lock);
+	list_for_each_entry(client, &cpu_hint_clients, node) {
+		bool active = cpu_hint_active(client);
+
+		seq_printf(s, "%-7d %-16s %4u %8u %8u %8u %8u %8u %10llu\n",
+			   client->pid, client->comm,
+			   active ? client->cpus : 0,
+			   active ? client->freq_khz : 0,
+			   active ? jiffies_to_msecs(client->expires -
+						     jiffies) : 0,
+			   client->hints, client->capped, client->rejected,
+			   client->total_ms);
+	}
+	mutex_unlock(&cpu_hint_lock);
+	return 0;
+}
+
+static int cpu_hint_clients_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cpu_hint_clients_show, inode->i_private);
+}
+
+static const struct file_operations cpu_hint_clients_fops = {
+	.open		= cpu_hint_clients_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init cpu_hint_debug_init(void)
+{
+	debugfs_create_file("cpu_hint", S_IRUGO, NULL, NULL,
+			    &cpu_hint_clients_fops);
+}
+#else
+static inline void cpu_hint_debug_init(void) {}
+#endif
+
+static int __init cpu_hint_init(void)
+{
+	int ret;
+
+	ret = misc_register(&cpu_hint_miscdev);
+	if (ret) {
+		pr_err("%s: can't register cpu_hint miscdev (%d)\n",
+		       __func__, ret);
+		return ret;
+	}
+
+	cpu_hint_debug_init();
+	return 0;
+}
+late_initcall(cpu_hint_init);
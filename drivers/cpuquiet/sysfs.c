@@ -103,14 +103,52 @@ static ssize_t available_governors_show(char *buf)
 	return ret;
 }
 
+static ssize_t show_thermal_select(char *buf)
+{
+	return sprintf(buf, "%d\n", cpuquiet_thermal_select);
+}
+
+static ssize_t store_thermal_select(const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u", &val) != 1 || val > 1)
+		return -EINVAL;
+
+	cpuquiet_thermal_select = val;
+	return count;
+}
+
+static ssize_t show_thermal_margin(char *buf)
+{
+	return sprintf(buf, "%u\n", cpuquiet_thermal_margin);
+}
+
+static ssize_t store_thermal_margin(const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u", &val) != 1)
+		return -EINVAL;
+
+	cpuquiet_thermal_margin = val;
+	return count;
+}
+
 struct cpuquiet_sysfs_attr attr_current_governor = __ATTR(current_governor,
 			0644, show_current_governor, store_current_governor);
 struct cpuquiet_sysfs_attr attr_governors = __ATTR_RO(available_governors);
+struct cpuquiet_sysfs_attr attr_thermal_select = __ATTR(thermal_select,
+			0644, show_thermal_select, store_thermal_select);
+struct cpuquiet_sysfs_attr attr_thermal_margin = __ATTR(thermal_margin,
+			0644, show_thermal_margin, store_thermal_margin);
 
 
 static struct attribute *cpuquiet_default_attrs[] = {
 	&attr_current_governor.attr,
 	&attr_governors.attr,
+	&attr_thermal_select.attr,
+	&attr_thermal_margin.attr,
 	NULL
 };
 
@@ -232,7 +270,7 @@ static ssize_t cpuquiet_state_store(struct kobject *kobj,
 
 static ssize_t show_active(unsigned int cpu, char *buf)
 {
-	return sprintf(buf, "%u\n", cpu_online(cpu));
+	return sprintf(buf, "%u\n", cpu_active(cpu));
 }
 
 static ssize_t store_active(unsigned int cpu, const char *value, size_t count)
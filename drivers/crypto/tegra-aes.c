@@ -202,6 +202,7 @@ struct tegra_aes_ctx {
 	int keylen;
 	bool use_ssk;
 	u8 dt[DEFAULT_RNG_BLK_SZ];
+	struct crypto_blkcipher *fallback;
 };
 
 static struct tegra_aes_ctx rng_ctx;
@@ -763,6 +764,17 @@ static int tegra_aes_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
 		return -EBUSY;
 	}
 
+	if (key && ctx->fallback) {
+		crypto_blkcipher_clear_flags(ctx->fallback, CRYPTO_TFM_REQ_MASK);
+		crypto_blkcipher_set_flags(ctx->fallback,
+			crypto_ablkcipher_get_flags(tfm) & CRYPTO_TFM_REQ_MASK);
+		ret = crypto_blkcipher_setkey(ctx->fallback, key, keylen);
+		if (ret) {
+			dev_err(dd->dev, "fallback setkey failed\n");
+			return ret;
+		}
+	}
+
 	dev_dbg(dd->dev, "keylen: %d\n", keylen);
 	ctx->dd = dd;
 
@@ -868,9 +880,38 @@ static irqreturn_t aes_bsea_irq(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+/*
+ * Requests up to this many bytes are run on the CPU, where the cipher is
+ * cheaper than the arbitration semaphore, the bounce copy through IRAM and
+ * the interrupt. 0 sends everything to the engine.
+ */
+static unsigned int sw_fallback_bytes = 512;
+module_param(sw_fallback_bytes, uint, 0644);
+MODULE_PARM_DESC(sw_fallback_bytes,
+	"largest AES request handled on the CPU instead of the engine");
+
+static int tegra_aes_fallback(struct ablkcipher_request *req,
+			      struct tegra_aes_ctx *ctx, unsigned long mode)
+{
+	struct blkcipher_desc desc;
+
+	desc.tfm = ctx->fallback;
+	desc.info = req->info;
+	desc.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	if (mode & FLAGS_ENCRYPT)
+		return crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+						   req->nbytes);
+
+	return crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+					   req->nbytes);
+}
+
 static int tegra_aes_crypt(struct ablkcipher_request *req, unsigned long mode)
 {
 	struct tegra_aes_reqctx *rctx = ablkcipher_request_ctx(req);
+	struct tegra_aes_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
 	struct tegra_aes_dev *dd = aes_dev;
 	unsigned long flags;
 	int err = 0;
@@ -881,6 +922,11 @@ static int tegra_aes_crypt(struct ablkcipher_request *req, unsigned long mode)
 		req->nbytes, !!(mode & FLAGS_ENCRYPT), !!(mode & FLAGS_CBC),
 		!!(mode & FLAGS_OFB));
 
+	/* the SSK is only usable by the engine */
+	if (req->nbytes <= sw_fallback_bytes && ctx->fallback &&
+	    !ctx->use_ssk)
+		return tegra_aes_fallback(req, ctx, mode);
+
 	rctx->mode = mode;
 
 	spin_lock_irqsave(&dd->lock, flags);
@@ -1101,7 +1147,25 @@ fail:
 
 static int tegra_aes_cra_init(struct crypto_tfm *tfm)
 {
+	struct tegra_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(tfm);
+
 	tfm->crt_ablkcipher.reqsize = sizeof(struct tegra_aes_reqctx);
+
+	if ((tfm->__crt_alg->cra_flags & CRYPTO_ALG_TYPE_MASK) !=
+	    CRYPTO_ALG_TYPE_ABLKCIPHER)
+		return 0;
+
+	/* the algorithms are registered under "disabled_" names */
+	if (!strncmp(name, "disabled_", 9))
+		name += 9;
+
+	/* no software mode only disables the small-request path */
+	ctx->fallback = crypto_alloc_blkcipher(name, 0,
+				CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback))
+		ctx->fallback = NULL;
+
 	return 0;
 }
 
@@ -1112,13 +1176,19 @@ void tegra_aes_cra_exit(struct crypto_tfm *tfm)
 
 	if (ctx && ctx->slot)
 		aes_release_key_slot(ctx->slot);
+
+	if (ctx && ctx->fallback) {
+		crypto_free_blkcipher(ctx->fallback);
+		ctx->fallback = NULL;
+	}
 }
 
 static struct crypto_alg algs[] = {
 	{
 		.cra_name = "disabled_ecb(aes)",
 		.cra_driver_name = "ecb-aes-tegra",
-		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC |
+			     CRYPTO_ALG_NEED_FALLBACK,
 		.cra_blocksize = AES_BLOCK_SIZE,
 		.cra_alignmask = 3,
 		.cra_type = &crypto_ablkcipher_type,
@@ -1132,7 +1202,8 @@ static struct crypto_alg algs[] = {
 	}, {
 		.cra_name = "disabled_cbc(aes)",
 		.cra_driver_name = "cbc-aes-tegra",
-		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC |
+			     CRYPTO_ALG_NEED_FALLBACK,
 		.cra_blocksize = AES_BLOCK_SIZE,
 		.cra_alignmask = 3,
 		.cra_type = &crypto_ablkcipher_type,
@@ -1147,7 +1218,8 @@ static struct crypto_alg algs[] = {
 	}, {
 		.cra_name = "disabled_ofb(aes)",
 		.cra_driver_name = "ofb-aes-tegra",
-		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC |
+			     CRYPTO_ALG_NEED_FALLBACK,
 		.cra_blocksize = AES_BLOCK_SIZE,
 		.cra_alignmask = 3,
 		.cra_type = &crypto_ablkcipher_type,
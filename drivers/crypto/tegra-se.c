@@ -107,6 +107,10 @@ struct tegra_se_dev {
 	u32 *dst_ll_buf;	/* pointer to destination linked list buffer */
 	dma_addr_t dst_ll_buf_adr; /* Destination linked list dma address */
 	u32 dst_ll_size;	/* Size of destination linked list buffer */
+	u32 *next_src_ll_buf;	/* source linked list of the queued request */
+	dma_addr_t next_src_ll_buf_adr;	/* its dma address */
+	u32 *next_dst_ll_buf;	/* destination linked list of queued request */
+	dma_addr_t next_dst_ll_buf_adr;	/* its dma address */
 	u32 *ctx_save_buf;	/* LP context buffer pointer*/
 	dma_addr_t ctx_save_buf_adr;	/* LP context buffer dma address*/
 	struct completion complete;	/* Tells the task completion */
@@ -122,6 +126,7 @@ struct tegra_se_aes_context {
 	struct tegra_se_slot *slot;	/* Security Engine key slot */
 	u32 keylen;	/* key length in bits */
 	u32 op_mode;	/* AES operation mode */
+	struct crypto_blkcipher *fallback;	/* CPU cipher for small requests */
 };
 
 /* Security Engine random number generator context */
@@ -140,6 +145,17 @@ struct tegra_se_rng_context {
 struct tegra_se_sha_context {
 	struct tegra_se_dev	*se_dev;	/* Security Engine device */
 	u32 op_mode;	/* SHA operation mode */
+	struct crypto_shash *fallback;	/* CPU hash for oversized messages */
+};
+
+#define SE_SHA_BUF_SIZE		PAGE_SIZE
+
+/* Security Engine SHA request context */
+struct tegra_se_sha_req_context {
+	u8 buf[SE_SHA_BUF_SIZE];	/* message collected by update() */
+	u32 buflen;	/* bytes in buf */
+	bool sw;	/* message outgrew buf, continued on the CPU */
+	struct shash_desc desc;	/* fallback state, must be last */
 };
 
 /* Security Engine AES CMAC context */
@@ -159,8 +175,21 @@ struct tegra_se_slot {
 	struct list_head node;
 	u8 slot_num;	/* Key slot number */
 	bool available; /* Tells whether key slot is free to use */
+	u32 users;	/* Contexts sharing the cached key */
+	bool key_valid;	/* key[] is loaded in the key table */
+	u32 keylen;	/* Length of the cached key */
+	u8 key[TEGRA_SE_KEY_256_SIZE];	/* Cached copy of the loaded key */
+};
+
+/* Key slot cache statistics, protected by key_slot_lock */
+struct tegra_se_slot_stats {
+	u32 hits;	/* setkey found the key already loaded */
+	u32 misses;	/* setkey had to load the key table */
+	u32 evictions;	/* cached keys dropped to make room */
 };
 
+static struct tegra_se_slot_stats slot_stats;
+
 static struct tegra_se_slot ssk_slot = {
 	.slot_num = 15,
 	.available = false,
@@ -185,6 +214,7 @@ static DEFINE_SPINLOCK(rsa_key_slot_lock);
 #define RSA_MAX_SIZE	256
 #define RNG_RESEED_INTERVAL	100
 #define TEGRA_SE_RSA_CONTEXT_SAVE_KEYSLOT_COUNT	2
+#define SE_MAX_BACK_TO_BACK	16
 
 static DEFINE_SPINLOCK(key_slot_lock);
 static DEFINE_MUTEX(se_hw_lock);
@@ -233,28 +263,105 @@ static inline unsigned int se_readl(struct tegra_se_dev *se_dev,
 
 static void tegra_se_free_key_slot(struct tegra_se_slot *slot)
 {
-	if (slot) {
-		spin_lock(&key_slot_lock);
+	if (!slot || slot == &ssk_slot || slot == &srk_slot)
+		return;
+
+	spin_lock(&key_slot_lock);
+	if (slot->users && --slot->users == 0) {
 		slot->available = true;
-		spin_unlock(&key_slot_lock);
+		/* keep the most recently used keys at the tail */
+		list_move_tail(&slot->node, &key_slot);
 	}
+	spin_unlock(&key_slot_lock);
+}
+
+/*
+ * Pick a free slot, preferring one without a cached key and otherwise
+ * evicting the least recently used cached key. Called with key_slot_lock
+ * held; the slot is returned with one user and no valid key.
+ */
+static struct tegra_se_slot *__tegra_se_alloc_key_slot(void)
+{
+	struct tegra_se_slot *slot, *lru = NULL;
+
+	list_for_each_entry(slot, &key_slot, node) {
+		if (!slot->available)
+			continue;
+		if (!slot->key_valid) {
+			lru = slot;
+			break;
+		}
+		if (!lru)
+			lru = slot;
+	}
+
+	if (!lru)
+		return NULL;
+
+	if (lru->key_valid) {
+		slot_stats.evictions++;
+		memset(lru->key, 0, sizeof(lru->key));
+		lru->key_valid = false;
+	}
+	lru->available = false;
+	lru->users = 1;
+
+	return lru;
 }
 
 static struct tegra_se_slot *tegra_se_alloc_key_slot(void)
 {
-	struct tegra_se_slot *slot = NULL;
-	bool found = false;
+	struct tegra_se_slot *slot;
+
+	spin_lock(&key_slot_lock);
+	slot = __tegra_se_alloc_key_slot();
+	spin_unlock(&key_slot_lock);
+
+	return slot;
+}
+
+/*
+ * Look up a slot that already holds @key. On a hit the slot is shared and
+ * *loaded is set so the caller can skip the key table write; on a miss a
+ * slot is allocated and tegra_se_key_slot_loaded() must be called once the
+ * key has been written.
+ */
+static struct tegra_se_slot *tegra_se_get_key_slot(const u8 *key,
+	u32 keylen, bool *loaded)
+{
+	struct tegra_se_slot *slot;
 
 	spin_lock(&key_slot_lock);
 	list_for_each_entry(slot, &key_slot, node) {
-		if (slot->available) {
+		if (slot->key_valid && slot->keylen == keylen &&
+		    !memcmp(slot->key, key, keylen)) {
 			slot->available = false;
-			found = true;
-			break;
+			slot->users++;
+			list_move_tail(&slot->node, &key_slot);
+			slot_stats.hits++;
+			spin_unlock(&key_slot_lock);
+			*loaded = true;
+			return slot;
 		}
 	}
+
+	slot = __tegra_se_alloc_key_slot();
+	if (slot) {
+		slot_stats.misses++;
+		slot->keylen = keylen;
+		memcpy(slot->key, key, keylen);
+	}
+	spin_unlock(&key_slot_lock);
+
+	*loaded = false;
+	return slot;
+}
+
+static void tegra_se_key_slot_loaded(struct tegra_se_slot *slot)
+{
+	spin_lock(&key_slot_lock);
+	slot->key_valid = true;
 	spin_unlock(&key_slot_lock);
-	return found ? slot : NULL;
 }
 
 static int tegra_init_key_slot(struct tegra_se_dev *se_dev)
@@ -278,6 +385,8 @@ static int tegra_init_key_slot(struct tegra_se_dev *se_dev)
 		if ((i == srk_slot.slot_num) || (i == ssk_slot.slot_num))
 			continue;
 		se_dev->slot_list[i].available = true;
+		se_dev->slot_list[i].users = 0;
+		se_dev->slot_list[i].key_valid = false;
 		se_dev->slot_list[i].slot_num = i;
 		INIT_LIST_HEAD(&se_dev->slot_list[i].node);
 		list_add_tail(&se_dev->slot_list[i].node, &key_slot);
@@ -642,11 +751,10 @@ static void tegra_se_config_sha(struct tegra_se_dev *se_dev, u32 count,
 	se_writel(se_dev, SHA_ENABLE, SE_SHA_CONFIG_REG_OFFSET);
 }
 
-static int tegra_se_start_operation(struct tegra_se_dev *se_dev, u32 nbytes,
+static int tegra_se_kick_operation(struct tegra_se_dev *se_dev, u32 nbytes,
 	bool context_save)
 {
 	u32 nblocks = nbytes / TEGRA_SE_AES_BLOCK_SIZE;
-	int ret = 0;
 	u32 val = 0;
 
 	if ((tegra_get_chipid() == TEGRA_CHIPID_TEGRA11) &&
@@ -675,6 +783,13 @@ static int tegra_se_start_operation(struct tegra_se_dev *se_dev, u32 nbytes,
 		se_writel(se_dev, SE_OPERATION(OP_SRART),
 			SE_OPERATION_REG_OFFSET);
 
+	return 0;
+}
+
+static int tegra_se_wait_operation(struct tegra_se_dev *se_dev)
+{
+	int ret;
+
 	ret = wait_for_completion_timeout(&se_dev->complete,
 			msecs_to_jiffies(1000));
 	if (ret == 0) {
@@ -685,6 +800,18 @@ static int tegra_se_start_operation(struct tegra_se_dev *se_dev, u32 nbytes,
 	return 0;
 }
 
+static int tegra_se_start_operation(struct tegra_se_dev *se_dev, u32 nbytes,
+	bool context_save)
+{
+	int ret;
+
+	ret = tegra_se_kick_operation(se_dev, nbytes, context_save);
+	if (ret)
+		return ret;
+
+	return tegra_se_wait_operation(se_dev);
+}
+
 static void tegra_se_read_hash_result(struct tegra_se_dev *se_dev,
 	u8 *pdata, u32 nbytes, bool swap32)
 {
@@ -762,6 +889,14 @@ static int tegra_se_alloc_ll_buf(struct tegra_se_dev *se_dev,
 			dev_err(se_dev->dev, "can not allocate src lldma buffer\n");
 			return -ENOMEM;
 		}
+		se_dev->next_src_ll_buf = dma_alloc_coherent(se_dev->dev,
+					se_dev->src_ll_size,
+					&se_dev->next_src_ll_buf_adr,
+					GFP_KERNEL);
+		if (!se_dev->next_src_ll_buf) {
+			dev_err(se_dev->dev, "can not allocate src lldma buffer\n");
+			return -ENOMEM;
+		}
 	}
 	if (num_dst_sgs) {
 		se_dev->dst_ll_size =
@@ -774,6 +909,14 @@ static int tegra_se_alloc_ll_buf(struct tegra_se_dev *se_dev,
 			dev_err(se_dev->dev, "can not allocate dst ll dma buffer\n");
 			return -ENOMEM;
 		}
+		se_dev->next_dst_ll_buf = dma_alloc_coherent(se_dev->dev,
+					se_dev->dst_ll_size,
+					&se_dev->next_dst_ll_buf_adr,
+					GFP_KERNEL);
+		if (!se_dev->next_dst_ll_buf) {
+			dev_err(se_dev->dev, "can not allocate dst ll dma buffer\n");
+			return -ENOMEM;
+		}
 	}
 
 	return 0;
@@ -792,10 +935,35 @@ static void tegra_se_free_ll_buf(struct tegra_se_dev *se_dev)
 			se_dev->dst_ll_buf, se_dev->dst_ll_buf_adr);
 		se_dev->dst_ll_buf = NULL;
 	}
+
+	if (se_dev->next_src_ll_buf) {
+		dma_free_coherent(se_dev->dev, se_dev->src_ll_size,
+			se_dev->next_src_ll_buf, se_dev->next_src_ll_buf_adr);
+		se_dev->next_src_ll_buf = NULL;
+	}
+
+	if (se_dev->next_dst_ll_buf) {
+		dma_free_coherent(se_dev->dev, se_dev->dst_ll_size,
+			se_dev->next_dst_ll_buf, se_dev->next_dst_ll_buf_adr);
+		se_dev->next_dst_ll_buf = NULL;
+	}
+}
+
+/*
+ * The ablkcipher worker fills the spare linked list pair for the next
+ * request while the engine is still walking the current one; swap the
+ * pairs once the engine is idle so the prepared request can be started.
+ */
+static void tegra_se_swap_ll_buf(struct tegra_se_dev *se_dev)
+{
+	swap(se_dev->src_ll_buf, se_dev->next_src_ll_buf);
+	swap(se_dev->src_ll_buf_adr, se_dev->next_src_ll_buf_adr);
+	swap(se_dev->dst_ll_buf, se_dev->next_dst_ll_buf);
+	swap(se_dev->dst_ll_buf_adr, se_dev->next_dst_ll_buf_adr);
 }
 
 static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev,
-	struct ablkcipher_request *req)
+	struct ablkcipher_request *req, u32 *src_ll_buf, u32 *dst_ll_buf)
 {
 	struct scatterlist *src_sg, *dst_sg;
 	struct tegra_se_ll *src_ll, *dst_ll;
@@ -812,11 +980,11 @@ static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev,
 			return -EINVAL;
 	}
 
-	*se_dev->src_ll_buf = num_src_sgs-1;
-	*se_dev->dst_ll_buf = num_dst_sgs-1;
+	*src_ll_buf = num_src_sgs-1;
+	*dst_ll_buf = num_dst_sgs-1;
 
-	src_ll = (struct tegra_se_ll *)(se_dev->src_ll_buf + 1);
-	dst_ll = (struct tegra_se_ll *)(se_dev->dst_ll_buf + 1);
+	src_ll = (struct tegra_se_ll *)(src_ll_buf + 1);
+	dst_ll = (struct tegra_se_ll *)(dst_ll_buf + 1);
 
 	src_sg = req->src;
 	dst_sg = req->dst;
@@ -847,17 +1015,12 @@ static void tegra_se_dequeue_complete_req(struct tegra_se_dev *se_dev,
 	}
 }
 
-static void tegra_se_process_new_req(struct crypto_async_request *async_req)
+static int tegra_se_submit_req(struct tegra_se_dev *se_dev,
+	struct ablkcipher_request *req)
 {
-	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
-	struct ablkcipher_request *req = ablkcipher_request_cast(async_req);
 	struct tegra_se_req_context *req_ctx = ablkcipher_request_ctx(req);
 	struct tegra_se_aes_context *aes_ctx =
 			crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
-	int ret = 0;
-
-	/* take access to the hw */
-	mutex_lock(&se_hw_lock);
 
 	/* write IV */
 	if (req->info) {
@@ -870,16 +1033,12 @@ static void tegra_se_process_new_req(struct crypto_async_request *async_req)
 				SE_KEY_TABLE_TYPE_ORGIV);
 		}
 	}
-	tegra_se_setup_ablk_req(se_dev, req);
 	tegra_se_config_algo(se_dev, req_ctx->op_mode, req_ctx->encrypt,
 		aes_ctx->keylen);
 	tegra_se_config_crypto(se_dev, req_ctx->op_mode, req_ctx->encrypt,
 			aes_ctx->slot->slot_num, req->info ? true : false);
-	ret = tegra_se_start_operation(se_dev, req->nbytes, false);
-	tegra_se_dequeue_complete_req(se_dev, req);
 
-	mutex_unlock(&se_hw_lock);
-	req->base.complete(&req->base, ret);
+	return tegra_se_kick_operation(se_dev, req->nbytes, false);
 }
 
 static irqreturn_t tegra_se_irq(int irq, void *dev)
@@ -902,40 +1061,132 @@ static irqreturn_t tegra_se_irq(int irq, void *dev)
 	return IRQ_HANDLED;
 }
 
-static void tegra_se_work_handler(struct work_struct *work)
+static struct ablkcipher_request *tegra_se_dequeue_req(
+	struct tegra_se_dev *se_dev)
 {
-	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
 	struct crypto_async_request *async_req = NULL;
 	struct crypto_async_request *backlog = NULL;
 
+	spin_lock_irq(&se_dev->lock);
+	backlog = crypto_get_backlog(&se_dev->queue);
+	async_req = crypto_dequeue_request(&se_dev->queue);
+	if (!async_req)
+		se_dev->work_q_busy = false;
+
+	spin_unlock_irq(&se_dev->lock);
+
+	if (backlog)
+		backlog->complete(backlog, -EINPROGRESS);
+
+	return async_req ? ablkcipher_request_cast(async_req) : NULL;
+}
+
+/*
+ * Dequeue the next request and map it into the given linked list pair.
+ * Requests that can not be mapped are completed here with the error.
+ */
+static struct ablkcipher_request *tegra_se_prepare_req(
+	struct tegra_se_dev *se_dev, u32 *src_ll_buf, u32 *dst_ll_buf)
+{
+	struct ablkcipher_request *req;
+	int ret;
+
+	while ((req = tegra_se_dequeue_req(se_dev))) {
+		ret = tegra_se_setup_ablk_req(se_dev, req, src_ll_buf,
+					dst_ll_buf);
+		if (!ret)
+			break;
+		req->base.complete(&req->base, ret);
+	}
+
+	return req;
+}
+
+static void tegra_se_work_handler(struct work_struct *work)
+{
+	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
+	struct ablkcipher_request *req, *next;
+	int ret, next_ret, count;
+
 	pm_runtime_get_sync(se_dev->dev);
 
 	do {
-		spin_lock_irq(&se_dev->lock);
-		backlog = crypto_get_backlog(&se_dev->queue);
-		async_req = crypto_dequeue_request(&se_dev->queue);
-		if (!async_req)
-			se_dev->work_q_busy = false;
+		/* take access to the hw */
+		mutex_lock(&se_hw_lock);
 
-		spin_unlock_irq(&se_dev->lock);
+		req = tegra_se_prepare_req(se_dev, se_dev->src_ll_buf,
+					se_dev->dst_ll_buf);
+		ret = req ? tegra_se_submit_req(se_dev, req) : 0;
 
-		if (backlog) {
-			backlog->complete(backlog, -EINPROGRESS);
-			backlog = NULL;
-		}
+		/*
+		 * While the engine runs a request, dequeue and map the next
+		 * one into the spare linked list pair so it can be started as
+		 * soon as the engine signals done. Completion callbacks of the
+		 * finished request also run with the engine already busy.
+		 * The chain is bounded so other se_hw_lock users (hash, rng,
+		 * setkey) are not starved under sustained load.
+		 */
+		for (count = 1; req; count++) {
+			next = NULL;
+			next_ret = 0;
+			if (!ret && count < SE_MAX_BACK_TO_BACK)
+				next = tegra_se_prepare_req(se_dev,
+						se_dev->next_src_ll_buf,
+						se_dev->next_dst_ll_buf);
+
+			if (!ret)
+				ret = tegra_se_wait_operation(se_dev);
+			tegra_se_dequeue_complete_req(se_dev, req);
+
+			if (next) {
+				tegra_se_swap_ll_buf(se_dev);
+				next_ret = tegra_se_submit_req(se_dev, next);
+			}
 
-		if (async_req) {
-			tegra_se_process_new_req(async_req);
-			async_req = NULL;
+			req->base.complete(&req->base, ret);
+			req = next;
+			ret = next_ret;
 		}
+
+		mutex_unlock(&se_hw_lock);
 	} while (se_dev->work_q_busy);
 	pm_runtime_put(se_dev->dev);
 }
 
+/*
+ * Requests up to this many bytes are run on the CPU: below it, mapping the
+ * buffers, the worker round trip and the done interrupt cost more than the
+ * cipher itself. 0 sends everything to the engine.
+ */
+static unsigned int sw_fallback_bytes = 512;
+module_param(sw_fallback_bytes, uint, 0644);
+MODULE_PARM_DESC(sw_fallback_bytes,
+	"largest AES request handled on the CPU instead of the engine");
+
+static int tegra_se_aes_fallback(struct ablkcipher_request *req,
+	struct tegra_se_aes_context *aes_ctx, bool encrypt)
+{
+	struct blkcipher_desc desc;
+
+	desc.tfm = aes_ctx->fallback;
+	desc.info = req->info;
+	desc.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	if (encrypt)
+		return crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+						req->nbytes);
+
+	return crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+					req->nbytes);
+}
+
 static int tegra_se_aes_queue_req(struct ablkcipher_request *req)
 {
 
 	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
+	struct tegra_se_req_context *req_ctx = ablkcipher_request_ctx(req);
+	struct tegra_se_aes_context *aes_ctx =
+			crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
 	unsigned long flags;
 	bool idle = true;
 	int err = 0;
@@ -944,6 +1195,11 @@ static int tegra_se_aes_queue_req(struct ablkcipher_request *req)
 	if (!tegra_se_count_sgs(req->src, req->nbytes, &chained))
 		return -EINVAL;
 
+	/* the SSK never leaves the engine, so it has no CPU fallback */
+	if (req->nbytes <= sw_fallback_bytes && aes_ctx->fallback &&
+	    aes_ctx->slot != &ssk_slot)
+		return tegra_se_aes_fallback(req, aes_ctx, req_ctx->encrypt);
+
 	spin_lock_irqsave(&se_dev->lock, flags);
 	err = ablkcipher_enqueue_request(&se_dev->queue, req);
 	if (se_dev->work_q_busy)
@@ -1047,6 +1303,7 @@ static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
 	struct tegra_se_dev *se_dev = NULL;
 	struct tegra_se_slot *pslot;
 	u8 *pdata = (u8 *)key;
+	bool loaded = false;
 
 	if (!ctx || !ctx->se_dev) {
 		pr_err("invalid context or dev");
@@ -1062,16 +1319,31 @@ static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
 		return -EINVAL;
 	}
 
+	if (key && ctx->fallback) {
+		int ret;
+
+		crypto_blkcipher_clear_flags(ctx->fallback, CRYPTO_TFM_REQ_MASK);
+		crypto_blkcipher_set_flags(ctx->fallback,
+			crypto_ablkcipher_get_flags(tfm) & CRYPTO_TFM_REQ_MASK);
+		ret = crypto_blkcipher_setkey(ctx->fallback, key, keylen);
+		if (ret) {
+			dev_err(se_dev->dev, "fallback setkey failed\n");
+			return ret;
+		}
+	}
+
 	if (key) {
-		if (!ctx->slot || (ctx->slot &&
-		    ctx->slot->slot_num == ssk_slot.slot_num)) {
-			pslot = tegra_se_alloc_key_slot();
-			if (!pslot) {
-				dev_err(se_dev->dev, "no free key slot\n");
-				return -ENOMEM;
-			}
-			ctx->slot = pslot;
+		/*
+		 * Take the new slot before dropping the old one so that
+		 * re-setting the same key finds it still cached.
+		 */
+		pslot = tegra_se_get_key_slot(key, keylen, &loaded);
+		if (!pslot) {
+			dev_err(se_dev->dev, "no free key slot\n");
+			return -ENOMEM;
 		}
+		tegra_se_free_key_slot(ctx->slot);
+		ctx->slot = pslot;
 		ctx->keylen = keylen;
 	} else {
 		tegra_se_free_key_slot(ctx->slot);
@@ -1079,6 +1351,10 @@ static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
 		ctx->keylen = AES_KEYSIZE_128;
 	}
 
+	/* key already in the key table, nothing to program */
+	if (loaded)
+		return 0;
+
 	/* take access to the hw */
 	mutex_lock(&se_hw_lock);
 	pm_runtime_get_sync(se_dev->dev);
@@ -1090,6 +1366,9 @@ static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
 	pm_runtime_put(se_dev->dev);
 	mutex_unlock(&se_hw_lock);
 
+	if (key)
+		tegra_se_key_slot_loaded(ctx->slot);
+
 	return 0;
 }
 
@@ -1100,6 +1379,12 @@ static int tegra_se_aes_cra_init(struct crypto_tfm *tfm)
 	ctx->se_dev = sg_tegra_se_dev;
 	tfm->crt_ablkcipher.reqsize = sizeof(struct tegra_se_req_context);
 
+	/* a missing software mode only disables the small-request path */
+	ctx->fallback = crypto_alloc_blkcipher(crypto_tfm_alg_name(tfm), 0,
+				CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback))
+		ctx->fallback = NULL;
+
 	return 0;
 }
 
@@ -1109,6 +1394,11 @@ static void tegra_se_aes_cra_exit(struct crypto_tfm *tfm)
 
 	tegra_se_free_key_slot(ctx->slot);
 	ctx->slot = NULL;
+
+	if (ctx->fallback) {
+		crypto_free_blkcipher(ctx->fallback);
+		ctx->fallback = NULL;
+	}
 }
 
 static int tegra_se_rng_init(struct crypto_tfm *tfm)
@@ -1379,84 +1669,67 @@ static void tegra_se_rng_drbg_exit(struct crypto_tfm *tfm)
 	rng_ctx->se_dev = NULL;
 }
 
-int tegra_se_sha_init(struct ahash_request *req)
+static unsigned long tegra_se_sha_mode(struct crypto_ahash *tfm,
+	struct tegra_se_sha_context *sha_ctx)
 {
-	return 0;
-}
+	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
 
-int tegra_se_sha_update(struct ahash_request *req)
-{
-	return 0;
-}
+	switch (crypto_ahash_digestsize(tfm)) {
+	case SHA1_DIGEST_SIZE:
+		sha_ctx->op_mode = SE_AES_OP_MODE_SHA1;
+		return se_dev->chipdata->sha1_freq;
+	case SHA224_DIGEST_SIZE:
+		sha_ctx->op_mode = SE_AES_OP_MODE_SHA224;
+		return se_dev->chipdata->sha224_freq;
+	case SHA256_DIGEST_SIZE:
+		sha_ctx->op_mode = SE_AES_OP_MODE_SHA256;
+		return se_dev->chipdata->sha256_freq;
+	case SHA384_DIGEST_SIZE:
+		sha_ctx->op_mode = SE_AES_OP_MODE_SHA384;
+		return se_dev->chipdata->sha384_freq;
+	case SHA512_DIGEST_SIZE:
+		sha_ctx->op_mode = SE_AES_OP_MODE_SHA512;
+		return se_dev->chipdata->sha512_freq;
+	}
 
-int tegra_se_sha_finup(struct ahash_request *req)
-{
 	return 0;
 }
 
-int tegra_se_sha_final(struct ahash_request *req)
+/*
+ * Hash @nbytes of @src in a single engine operation. The engine has no
+ * way to resume from an intermediate digest, so the whole message has to
+ * be described by one source linked list.
+ */
+static int tegra_se_sha_hw(struct ahash_request *req, struct scatterlist *src,
+	u32 nbytes)
 {
 	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
 	struct tegra_se_sha_context *sha_ctx = crypto_ahash_ctx(tfm);
 	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
-	struct scatterlist *src_sg;
 	struct tegra_se_ll *src_ll;
-	u32 total, num_sgs;
+	u32 num_sgs;
 	unsigned long freq = 0;
 	int err = 0;
 	int chained;
 
-	if (!req->nbytes)
-		return -EINVAL;
-
-	if (crypto_ahash_digestsize(tfm) == SHA1_DIGEST_SIZE) {
-		sha_ctx->op_mode = SE_AES_OP_MODE_SHA1;
-		freq = se_dev->chipdata->sha1_freq;
-	}
-
-	if (crypto_ahash_digestsize(tfm) == SHA224_DIGEST_SIZE) {
-		sha_ctx->op_mode = SE_AES_OP_MODE_SHA224;
-		freq = se_dev->chipdata->sha224_freq;
-	}
+	freq = tegra_se_sha_mode(tfm, sha_ctx);
 
-	if (crypto_ahash_digestsize(tfm) == SHA256_DIGEST_SIZE) {
-		sha_ctx->op_mode = SE_AES_OP_MODE_SHA256;
-		freq = se_dev->chipdata->sha256_freq;
-	}
-
-	if (crypto_ahash_digestsize(tfm) == SHA384_DIGEST_SIZE) {
-		sha_ctx->op_mode = SE_AES_OP_MODE_SHA384;
-		freq = se_dev->chipdata->sha384_freq;
-	}
-
-	if (crypto_ahash_digestsize(tfm) == SHA512_DIGEST_SIZE) {
-		sha_ctx->op_mode = SE_AES_OP_MODE_SHA512;
-		freq = se_dev->chipdata->sha512_freq;
+	num_sgs = tegra_se_count_sgs(src, nbytes, &chained);
+	if ((num_sgs > SE_MAX_SRC_SG_COUNT)) {
+		dev_err(se_dev->dev, "num of SG buffers are more\n");
+		return -EINVAL;
 	}
 
 	/* take access to the hw */
 	mutex_lock(&se_hw_lock);
 	pm_runtime_get_sync(se_dev->dev);
 
-	num_sgs = tegra_se_count_sgs(req->src, req->nbytes, &chained);
-	if ((num_sgs > SE_MAX_SRC_SG_COUNT)) {
-		dev_err(se_dev->dev, "num of SG buffers are more\n");
-		pm_runtime_put(se_dev->dev);
-		mutex_unlock(&se_hw_lock);
-		return -EINVAL;
-	}
-
 	*se_dev->src_ll_buf = num_sgs - 1;
 	src_ll = (struct tegra_se_ll *)(se_dev->src_ll_buf + 1);
-	src_sg = req->src;
-	total = req->nbytes;
-
-	if (total)
-		tegra_map_sg(se_dev->dev, src_sg, 1, DMA_TO_DEVICE,
-							src_ll, total);
+	tegra_map_sg(se_dev->dev, src, 1, DMA_TO_DEVICE, src_ll, nbytes);
 
 	tegra_se_config_algo(se_dev, sha_ctx->op_mode, false, 0);
-	tegra_se_config_sha(se_dev, req->nbytes, freq);
+	tegra_se_config_sha(se_dev, nbytes, freq);
 	err = tegra_se_start_operation(se_dev, 0, false);
 	if (!err) {
 		tegra_se_read_hash_result(se_dev, req->result,
@@ -1475,10 +1748,7 @@ int tegra_se_sha_final(struct ahash_request *req)
 		}
 	}
 
-	src_sg = req->src;
-	total = req->nbytes;
-	if (total)
-		tegra_unmap_sg(se_dev->dev, src_sg, DMA_TO_DEVICE, total);
+	tegra_unmap_sg(se_dev->dev, src, DMA_TO_DEVICE, nbytes);
 
 	pm_runtime_put(se_dev->dev);
 	mutex_unlock(&se_hw_lock);
@@ -1486,21 +1756,149 @@ int tegra_se_sha_final(struct ahash_request *req)
 	return err;
 }
 
+static void tegra_se_sha_init_desc(struct ahash_request *req)
+{
+	struct tegra_se_sha_context *sha_ctx =
+			crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct tegra_se_sha_req_context *rctx = ahash_request_ctx(req);
+
+	rctx->desc.tfm = sha_ctx->fallback;
+	rctx->desc.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+}
+
+int tegra_se_sha_init(struct ahash_request *req)
+{
+	struct tegra_se_sha_req_context *rctx = ahash_request_ctx(req);
+
+	rctx->buflen = 0;
+	rctx->sw = false;
+
+	return 0;
+}
+
+/*
+ * Messages are collected in the request until final() so the engine can
+ * hash them in one pass. Once a message outgrows the buffer it is handed
+ * to the CPU fallback for the remaining updates.
+ */
+int tegra_se_sha_update(struct ahash_request *req)
+{
+	struct tegra_se_sha_context *sha_ctx =
+			crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct tegra_se_sha_req_context *rctx = ahash_request_ctx(req);
+	int err;
+
+	if (!req->nbytes)
+		return 0;
+
+	if (!rctx->sw && rctx->buflen + req->nbytes <= SE_SHA_BUF_SIZE) {
+		scatterwalk_map_and_copy(rctx->buf + rctx->buflen, req->src,
+					0, req->nbytes, 0);
+		rctx->buflen += req->nbytes;
+		return 0;
+	}
+
+	if (!sha_ctx->fallback)
+		return -EINVAL;
+
+	if (!rctx->sw) {
+		tegra_se_sha_init_desc(req);
+		err = crypto_shash_init(&rctx->desc);
+		if (!err)
+			err = crypto_shash_update(&rctx->desc, rctx->buf,
+						rctx->buflen);
+		if (err)
+			return err;
+		rctx->sw = true;
+	}
+
+	return shash_ahash_update(req, &rctx->desc);
+}
+
+int tegra_se_sha_final(struct ahash_request *req)
+{
+	struct tegra_se_sha_context *sha_ctx =
+			crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct tegra_se_sha_req_context *rctx = ahash_request_ctx(req);
+	struct scatterlist sg;
+
+	if (rctx->sw)
+		return crypto_shash_final(&rctx->desc, req->result);
+
+	/* the engine can not hash an empty message */
+	if (!rctx->buflen) {
+		if (!sha_ctx->fallback)
+			return -EINVAL;
+		tegra_se_sha_init_desc(req);
+		return crypto_shash_digest(&rctx->desc, rctx->buf, 0,
+					req->result);
+	}
+
+	sg_init_one(&sg, rctx->buf, rctx->buflen);
+
+	return tegra_se_sha_hw(req, &sg, rctx->buflen);
+}
+
+int tegra_se_sha_finup(struct ahash_request *req)
+{
+	int err;
+
+	err = tegra_se_sha_update(req);
+	if (err)
+		return err;
+
+	return tegra_se_sha_final(req);
+}
+
+/*
+ * One-shot hashes (dm-verity blocks, IMA) go straight from the caller's
+ * scatterlist to the engine without a copy.
+ */
 static int tegra_se_sha_digest(struct ahash_request *req)
 {
-	return tegra_se_sha_init(req) ?: tegra_se_sha_final(req);
+	struct tegra_se_sha_context *sha_ctx =
+			crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct tegra_se_sha_req_context *rctx = ahash_request_ctx(req);
+	int chained;
+
+	if (req->nbytes && tegra_se_count_sgs(req->src, req->nbytes,
+					&chained) <= SE_MAX_SRC_SG_COUNT)
+		return tegra_se_sha_hw(req, req->src, req->nbytes);
+
+	if (!sha_ctx->fallback)
+		return -EINVAL;
+
+	tegra_se_sha_init_desc(req);
+	rctx->sw = true;
+
+	return shash_ahash_digest(req, &rctx->desc);
 }
 
 int tegra_se_sha_cra_init(struct crypto_tfm *tfm)
 {
-	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
-				 sizeof(struct tegra_se_sha_context));
+	struct tegra_se_sha_context *sha_ctx = crypto_tfm_ctx(tfm);
+	unsigned int reqsize = sizeof(struct tegra_se_sha_req_context);
+
+	sha_ctx->se_dev = sg_tegra_se_dev;
+	sha_ctx->fallback = crypto_alloc_shash(crypto_tfm_alg_name(tfm), 0,
+					CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(sha_ctx->fallback))
+		sha_ctx->fallback = NULL;
+	else
+		reqsize += crypto_shash_descsize(sha_ctx->fallback);
+
+	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm), reqsize);
 	return 0;
 }
 
 void tegra_se_sha_cra_exit(struct crypto_tfm *tfm)
 {
-	/* do nothing */
+	struct tegra_se_sha_context *sha_ctx = crypto_tfm_ctx(tfm);
+
+	if (sha_ctx->fallback) {
+		crypto_free_shash(sha_ctx->fallback);
+		sha_ctx->fallback = NULL;
+	}
 }
 
 int tegra_se_aes_cmac_init(struct ahash_request *req)
@@ -2114,7 +2512,8 @@ static struct crypto_alg aes_algs[] = {
 		.cra_name = "cbc(aes)",
 		.cra_driver_name = "cbc-aes-tegra",
 		.cra_priority = 300,
-		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC |
+				CRYPTO_ALG_NEED_FALLBACK,
 		.cra_blocksize = TEGRA_SE_AES_BLOCK_SIZE,
 		.cra_ctxsize  = sizeof(struct tegra_se_aes_context),
 		.cra_alignmask = 0,
@@ -2134,7 +2533,8 @@ static struct crypto_alg aes_algs[] = {
 		.cra_name = "ecb(aes)",
 		.cra_driver_name = "ecb-aes-tegra",
 		.cra_priority = 300,
-		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC |
+				CRYPTO_ALG_NEED_FALLBACK,
 		.cra_blocksize = TEGRA_SE_AES_BLOCK_SIZE,
 		.cra_ctxsize  = sizeof(struct tegra_se_aes_context),
 		.cra_alignmask = 0,
@@ -2154,7 +2554,8 @@ static struct crypto_alg aes_algs[] = {
 		.cra_name = "ctr(aes)",
 		.cra_driver_name = "ctr-aes-tegra",
 		.cra_priority = 300,
-		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC |
+				CRYPTO_ALG_NEED_FALLBACK,
 		.cra_blocksize = TEGRA_SE_AES_BLOCK_SIZE,
 		.cra_ctxsize  = sizeof(struct tegra_se_aes_context),
 		.cra_alignmask = 0,
@@ -2175,7 +2576,8 @@ static struct crypto_alg aes_algs[] = {
 		.cra_name = "ofb(aes)",
 		.cra_driver_name = "ofb-aes-tegra",
 		.cra_priority = 300,
-		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC |
+				CRYPTO_ALG_NEED_FALLBACK,
 		.cra_blocksize = TEGRA_SE_AES_BLOCK_SIZE,
 		.cra_ctxsize  = sizeof(struct tegra_se_aes_context),
 		.cra_alignmask = 0,
@@ -2455,6 +2857,30 @@ bool isAlgoSupported(struct tegra_se_dev *se_dev, const char *algo)
 	return true;
 }
 
+static ssize_t tegra_se_key_slot_stats_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tegra_se_slot *slot;
+	struct tegra_se_slot_stats stats;
+	u32 in_use = 0, cached = 0;
+
+	spin_lock(&key_slot_lock);
+	stats = slot_stats;
+	list_for_each_entry(slot, &key_slot, node) {
+		if (!slot->available)
+			in_use++;
+		if (slot->key_valid)
+			cached++;
+	}
+	spin_unlock(&key_slot_lock);
+
+	return sprintf(buf, "hits %u\nmisses %u\nevictions %u\n"
+			"in_use %u\ncached %u\n", stats.hits, stats.misses,
+			stats.evictions, in_use, cached);
+}
+static DEVICE_ATTR(key_slot_stats, S_IRUGO, tegra_se_key_slot_stats_show,
+	NULL);
+
 static int tegra_se_probe(struct platform_device *pdev)
 {
 	struct tegra_se_dev *se_dev = NULL;
@@ -2563,6 +2989,9 @@ static int tegra_se_probe(struct platform_device *pdev)
 		goto clean;
 	}
 
+	if (device_create_file(se_dev->dev, &dev_attr_key_slot_stats))
+		dev_warn(se_dev->dev, "can not create key_slot_stats\n");
+
 	for (i = 0; i < ARRAY_SIZE(aes_algs); i++) {
 		if (isAlgoSupported(se_dev, aes_algs[i].cra_name)) {
 			INIT_LIST_HEAD(&aes_algs[i].cra_list);
@@ -2647,6 +3076,7 @@ static int __devexit tegra_se_remove(struct platform_device *pdev)
 
 	pm_runtime_disable(se_dev->dev);
 
+	device_remove_file(se_dev->dev, &dev_attr_key_slot_stats);
 	cancel_work_sync(&se_work);
 	if (se_work_q)
 		destroy_workqueue(se_work_q);
@@ -0,0 +1,487 @@
+/*
+ * drivers/dma/tegra-apb-dma.c
+ *
+ * dmaengine provider for the Tegra APB DMA controller, on top of the
+ * channel code in arch/arm/mach-tegra/dma.c. A dmaengine channel takes a
+ * hardware channel in chained mode when a client allocates it; slave
+ * scatterlists and cyclic buffers become queues of tegra_dma_req, one per
+ * segment or period.
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/interrupt.h>
+#include <linux/platform_device.h>
+#include <linux/dmaengine.h>
+#include <linux/scatterlist.h>
+
+#include <mach/dma.h>
+
+#include "dmaengine.h"
+
+#define TEGRA_DMAE_CHANNELS	8
+
+/* An APB FIFO is one 32-bit register */
+#define TEGRA_DMAE_FIFO_WRAP	4
+
+struct tegra_dmae_chan;
+
+struct tegra_dmae_desc {
+	struct dma_async_tx_descriptor	txd;
+	struct list_head		node;
+	struct tegra_dmae_chan		*tc;
+	bool				cyclic;
+	bool				active;		/* queued to hw */
+	unsigned int			cur;		/* first not done */
+	unsigned int			periods;	/* callbacks due */
+	size_t				len;
+	unsigned int			nr_reqs;
+	struct tegra_dma_req		reqs[0];
+};
+
+struct tegra_dmae_chan {
+	struct dma_chan			chan;
+	struct tegra_dma_channel	*ch;
+	spinlock_t			lock;
+	struct list_head		submitted;
+	struct list_head		issued;
+	struct list_head		completed;	/* callbacks due */
+	struct list_head		terminated;
+	struct dma_slave_config		cfg;
+	struct tasklet_struct		tasklet;
+};
+
+static struct {
+	struct dma_device		dma;
+	struct tegra_dmae_chan		chans[TEGRA_DMAE_CHANNELS];
+} tegra_dmae;
+
+static inline struct tegra_dmae_chan *to_tegra_dmae_chan(struct dma_chan *c)
+{
+	return container_of(c, struct tegra_dmae_chan, chan);
+}
+
+static void tegra_dmae_free_list(struct list_head *list)
+{
+	struct tegra_dmae_desc *desc, *tmp;
+
+	list_for_each_entry_safe(desc, tmp, list, node) {
+		list_del(&desc->node);
+		kfree(desc);
+	}
+}
+
+/* Called from the DMA ISR, without the hardware channel lock */
+static void tegra_dmae_req_complete(struct tegra_dma_req *req)
+{
+	struct tegra_dmae_desc *desc = req->dev;
+	struct tegra_dmae_chan *tc = desc->tc;
+	unsigned long flags;
+
+	if (req->status != TEGRA_DMA_REQ_SUCCESS)
+		return;
+
+	spin_lock_irqsave(&tc->lock, flags);
+	if (!desc->active)
+		goto out;
+
+	if (desc->cyclic) {
+		desc->cur = (desc->cur + 1) % desc->nr_reqs;
+		desc->periods++;
+		tegra_dma_enqueue_req(tc->ch, req);
+	} else if (++desc->cur == desc->nr_reqs) {
+		desc->active = false;
+		dma_cookie_complete(&desc->txd);
+		list_move_tail(&desc->node, &tc->completed);
+	} else {
+		goto out;
+	}
+	tasklet_schedule(&tc->tasklet);
+out:
+	spin_unlock_irqrestore(&tc->lock, flags);
+}
+
+static void tegra_dmae_tasklet(unsigned long data)
+{
+	struct tegra_dmae_chan *tc = (struct tegra_dmae_chan *)data;
+	struct tegra_dmae_desc *desc;
+	dma_async_tx_callback callback = NULL;
+	void *param = NULL;
+	unsigned int periods = 0;
+	unsigned long flags;
+	LIST_HEAD(completed);
+
+	spin_lock_irqsave(&tc->lock, flags);
+	list_splice_init(&tc->completed, &completed);
+	list_for_each_entry(desc, &tc->issued, node) {
+		if (desc->cyclic && desc->active) {
+			periods = desc->periods;
+			desc->periods = 0;
+			callback = desc->txd.callback;
+			param = desc->txd.callback_param;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&tc->lock, flags);
+
+	while (callback && periods--)
+		callback(param);
+
+	list_for_each_entry(desc, &completed, node)
+		if (desc->txd.callback)
+			desc->txd.callback(desc->txd.callback_param);
+	tegra_dmae_free_list(&completed);
+}
+
+static dma_cookie_t tegra_dmae_tx_submit(struct dma_async_tx_descriptor *txd)
+{
+	struct tegra_dmae_desc *desc =
+		container_of(txd, struct tegra_dmae_desc, txd);
+	struct tegra_dmae_chan *tc = desc->tc;
+	unsigned long flags;
+	dma_cookie_t cookie;
+
+	spin_lock_irqsave(&tc->lock, flags);
+	cookie = dma_cookie_assign(txd);
+	list_add_tail(&desc->node, &tc->submitted);
+	spin_unlock_irqrestore(&tc->lock, flags);
+	return cookie;
+}
+
+static void tegra_dmae_issue_pending(struct dma_chan *chan)
+{
+	struct tegra_dmae_chan *tc = to_tegra_dmae_chan(chan);
+	struct tegra_dmae_desc *desc, *tmp;
+	unsigned long flags;
+	unsigned int i;
+
+	spin_lock_irqsave(&tc->lock, flags);
+	list_for_each_entry_safe(desc, tmp, &tc->submitted, node) {
+		desc->active = true;
+		for (i = 0; i < desc->nr_reqs; i++)
+			tegra_dma_enqueue_req(tc->ch, &desc->reqs[i]);
+		list_move_tail(&desc->node, &tc->issued);
+	}
+	spin_unlock_irqrestore(&tc->lock, flags);
+}
+
+/* Bytes left in an issued descriptor; called with tc->lock held */
+static size_t tegra_dmae_residue(struct tegra_dmae_chan *tc,
+	struct tegra_dmae_desc *desc)
+{
+	size_t done = 0;
+	unsigned int i;
+
+	if (!desc->active)
+		return desc->len;
+
+	for (i = 0; i < desc->cur; i++)
+		done += desc->reqs[i].size;
+	if (desc->cur < desc->nr_reqs)
+		done += tegra_dma_get_transfer_count(tc->ch,
+						     &desc->reqs[desc->cur]);
+	return desc->len - min(done, desc->len);
+}
+
+static enum dma_status tegra_dmae_tx_status(struct dma_chan *chan,
+	dma_cookie_t cookie, struct dma_tx_state *txstate)
+{
+	struct tegra_dmae_chan *tc = to_tegra_dmae_chan(chan);
+	struct tegra_dmae_desc *desc;
+	enum dma_status ret;
+	unsigned long flags;
+	size_t residue = 0;
+
+	ret = dma_cookie_status(chan, cookie, txstate);
+	if (ret == DMA_SUCCESS || !txstate)
+		return ret;
+
+	spin_lock_irqsave(&tc->lock, flags);
+	list_for_each_entry(desc, &tc->issued, node) {
+		if (desc->txd.cookie == cookie) {
+			residue = tegra_dmae_residue(tc, desc);
+			goto found;
+		}
+	}
+	list_for_each_entry(desc, &tc->submitted, node) {
+		if (desc->txd.cookie == cookie) {
+			residue = desc->len;
+			goto found;
+		}
+	}
+found:
+	spin_unlock_irqrestore(&tc->lock, flags);
+
+	dma_set_residue(txstate, residue);
+	return ret;
+}
+
+static struct tegra_dmae_desc *tegra_dmae_desc_alloc(
+	struct tegra_dmae_chan *tc, unsigned int nr_reqs)
+{
+	struct tegra_dmae_desc *desc;
+	unsigned long flags;
+	LIST_HEAD(terminated);
+
+	/*
+	 * Descriptors of an earlier terminate_all are only freed now: the
+	 * ISR may still have been in one of their completion callbacks.
+	 */
+	spin_lock_irqsave(&tc->lock, flags);
+	list_splice_init(&tc->terminated, &terminated);
+	spin_unlock_irqrestore(&tc->lock, flags);
+	tegra_dmae_free_list(&terminated);
+
+	desc = kzalloc(sizeof(*desc) + nr_reqs * sizeof(desc->reqs[0]),
+		       GFP_ATOMIC);
+	if (!desc)
+		return NULL;
+
+	dma_async_tx_descriptor_init(&desc->txd, &tc->chan);
+	desc->txd.tx_submit = tegra_dmae_tx_submit;
+	desc->tc = tc;
+	desc->nr_reqs = nr_reqs;
+	INIT_LIST_HEAD(&desc->node);
+	return desc;
+}
+
+static int tegra_dmae_setup_req(struct tegra_dmae_desc *desc,
+	struct tegra_dma_req *req, enum dma_transfer_direction direction,
+	dma_addr_t mem, size_t len)
+{
+	struct tegra_dmae_chan *tc = desc->tc;
+	struct tegra_dma_slave *slave = tc->chan.private;
+	struct dma_slave_config *cfg = &tc->cfg;
+
+	if (!len || (len & 3) || (mem & 3))
+		return -EINVAL;
+
+	req->complete = tegra_dmae_req_complete;
+	req->dev = desc;
+	req->req_sel = slave ? slave->req_sel : TEGRA_DMA_REQ_SEL_CNTR;
+	req->size = len;
+
+	if (direction == DMA_DEV_TO_MEM) {
+		req->to_memory = 1;
+		req->source_addr = cfg->src_addr;
+		req->source_wrap = TEGRA_DMAE_FIFO_WRAP;
+		req->source_bus_width = cfg->src_addr_width * 8 ? : 32;
+		req->dest_addr = mem;
+		req->dest_wrap = 0;
+		req->dest_bus_width = 32;
+	} else if (direction == DMA_MEM_TO_DEV) {
+		req->to_memory = 0;
+		req->source_addr = mem;
+		req->source_wrap = 0;
+		req->source_bus_width = 32;
+		req->dest_addr = cfg->dst_addr;
+		req->dest_wrap = TEGRA_DMAE_FIFO_WRAP;
+		req->dest_bus_width = cfg->dst_addr_width * 8 ? : 32;
+	} else {
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static struct dma_async_tx_descriptor *tegra_dmae_prep_slave_sg(
+	struct dma_chan *chan, struct scatterlist *sgl, unsigned int sg_len,
+	enum dma_transfer_direction direction, unsigned long flags,
+	void *context)
+{
+	struct tegra_dmae_chan *tc = to_tegra_dmae_chan(chan);
+	struct tegra_dmae_desc *desc;
+	struct scatterlist *sg;
+	int i;
+
+	if (!sg_len)
+		return NULL;
+
+	desc = tegra_dmae_desc_alloc(tc, sg_len);
+	if (!desc)
+		return NULL;
+
+	for_each_sg(sgl, sg, sg_len, i) {
+		if (tegra_dmae_setup_req(desc, &desc->reqs[i], direction,
+					 sg_dma_address(sg), sg_dma_len(sg))) {
+			kfree(desc);
+			return NULL;
+		}
+		desc->len += sg_dma_len(sg);
+	}
+
+	desc->txd.flags = flags;
+	return &desc->txd;
+}
+
+static struct dma_async_tx_descriptor *tegra_dmae_prep_dma_cyclic(
+	struct dma_chan *chan, dma_addr_t buf_addr, size_t buf_len,
+	size_t period_len, enum dma_transfer_direction direction,
+	void *context)
+{
+	struct tegra_dmae_chan *tc = to_tegra_dmae_chan(chan);
+	struct tegra_dmae_desc *desc;
+	unsigned int i, nr;
+
+	if (!period_len || buf_len % period_len)
+		return NULL;
+
+	nr = buf_len / period_len;
+	desc = tegra_dmae_desc_alloc(tc, nr);
+	if (!desc)
+		return NULL;
+
+	for (i = 0; i < nr; i++) {
+		if (tegra_dmae_setup_req(desc, &desc->reqs[i], direction,
+					 buf_addr + i * period_len,
+					 period_len)) {
+			kfree(desc);
+			return NULL;
+		}
+	}
+
+	desc->cyclic = true;
+	desc->len = buf_len;
+	return &desc->txd;
+}
+
+static void tegra_dmae_terminate_all(struct tegra_dmae_chan *tc)
+{
+	struct tegra_dmae_desc *desc;
+	unsigned long flags;
+
+	/* inactive descriptors are neither requeued nor completed */
+	spin_lock_irqsave(&tc->lock, flags);
+	list_for_each_entry(desc, &tc->issued, node)
+		desc->active = false;
+	list_splice_tail_init(&tc->issued, &tc->terminated);
+	list_splice_tail_init(&tc->submitted, &tc->terminated);
+	spin_unlock_irqrestore(&tc->lock, flags);
+
+	tegra_dma_cancel(tc->ch);
+}
+
+static int tegra_dmae_control(struct dma_chan *chan, enum dma_ctrl_cmd cmd,
+	unsigned long arg)
+{
+	struct tegra_dmae_chan *tc = to_tegra_dmae_chan(chan);
+
+	switch (cmd) {
+	case DMA_SLAVE_CONFIG:
+		tc->cfg = *(struct dma_slave_config *)arg;
+		return 0;
+	case DMA_TERMINATE_ALL:
+		tegra_dmae_terminate_all(tc);
+		return 0;
+	default:
+		return -ENXIO;
+	}
+}
+
+static int tegra_dmae_alloc_chan_resources(struct dma_chan *chan)
+{
+	struct tegra_dmae_chan *tc = to_tegra_dmae_chan(chan);
+
+	tc->ch = tegra_dma_allocate_channel(TEGRA_DMA_MODE_CHAINED,
+					    "dmaengine.%d", chan->chan_id);
+	if (!tc->ch)
+		return -EBUSY;
+
+	dma_cookie_init(chan);
+	return 0;
+}
+
+static void tegra_dmae_free_chan_resources(struct dma_chan *chan)
+{
+	struct tegra_dmae_chan *tc = to_tegra_dmae_chan(chan);
+
+	tegra_dmae_terminate_all(tc);
+	tegra_dma_free_channel(tc->ch);
+	tc->ch = NULL;
+	tasklet_kill(&tc->tasklet);
+
+	tegra_dmae_free_list(&tc->completed);
+	tegra_dmae_free_list(&tc->terminated);
+	chan->private = NULL;
+}
+
+bool tegra_dma_filter(struct dma_chan *chan, void *param)
+{
+	if (chan->device != &tegra_dmae.dma)
+		return false;
+
+	chan->private = param;
+	return true;
+}
+EXPORT_SYMBOL(tegra_dma_filter);
+
+static int __devinit tegra_dmae_probe(struct platform_device *pdev)
+{
+	struct dma_device *dma = &tegra_dmae.dma;
+	struct tegra_dmae_chan *tc;
+	int i;
+
+	INIT_LIST_HEAD(&dma->channels);
+	dma_cap_set(DMA_SLAVE, dma->cap_mask);
+	dma_cap_set(DMA_CYCLIC, dma->cap_mask);
+	dma->dev = &pdev->dev;
+	dma->device_alloc_chan_resources = tegra_dmae_alloc_chan_resources;
+	dma->device_free_chan_resources = tegra_dmae_free_chan_resources;
+	dma->device_prep_slave_sg = tegra_dmae_prep_slave_sg;
+	dma->device_prep_dma_cyclic = tegra_dmae_prep_dma_cyclic;
+	dma->device_control = tegra_dmae_control;
+	dma->device_tx_status = tegra_dmae_tx_status;
+	dma->device_issue_pending = tegra_dmae_issue_pending;
+
+	for (i = 0; i < TEGRA_DMAE_CHANNELS; i++) {
+		tc = &tegra_dmae.chans[i];
+		tc->chan.device = dma;
+		spin_lock_init(&tc->lock);
+		INIT_LIST_HEAD(&tc->submitted);
+		INIT_LIST_HEAD(&tc->issued);
+		INIT_LIST_HEAD(&tc->completed);
+		INIT_LIST_HEAD(&tc->terminated);
+		tasklet_init(&tc->tasklet, tegra_dmae_tasklet,
+			     (unsigned long)tc);
+		list_add_tail(&tc->chan.device_node, &dma->channels);
+	}
+
+	return dma_async_device_register(dma);
+}
+
+static struct platform_driver tegra_dmae_driver = {
+	.driver = {
+		.name	= "tegra-apbdma",
+		.owner	= THIS_MODULE,
+	},
+};
+
+static int __init tegra_dmae_init(void)
+{
+	struct platform_device *pdev;
+
+	pdev = platform_device_register_simple("tegra-apbdma", -1, NULL, 0);
+	if (IS_ERR(pdev))
+		return PTR_ERR(pdev);
+
+	return platform_driver_probe(&tegra_dmae_driver, tegra_dmae_probe);
+}
+subsys_initcall(tegra_dmae_init);
@@ -34,6 +34,7 @@
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
 #include <linux/dma-buf.h>
+#include <linux/math64.h>
 
 #include "ion_priv.h"
 
@@ -206,23 +207,33 @@ err:
 	return ERR_PTR(ret);
 }
 
-static void ion_buffer_destroy(struct kref *kref)
+void ion_buffer_destroy(struct ion_buffer *buffer)
 {
-	struct ion_buffer *buffer = container_of(kref, struct ion_buffer, ref);
-	struct ion_device *dev = buffer->dev;
-
 	if (WARN_ON(buffer->kmap_cnt > 0))
 		buffer->heap->ops->unmap_kernel(buffer->heap, buffer);
 	buffer->heap->ops->unmap_dma(buffer->heap, buffer);
 	buffer->heap->ops->free(buffer);
-	mutex_lock(&dev->lock);
-	rb_erase(&buffer->node, &dev->buffers);
-	mutex_unlock(&dev->lock);
 	if (buffer->flags & ION_FLAG_CACHED)
 		kfree(buffer->dirty);
 	kfree(buffer);
 }
 
+static void _ion_buffer_destroy(struct kref *kref)
+{
+	struct ion_buffer *buffer = container_of(kref, struct ion_buffer, ref);
+	struct ion_heap *heap = buffer->heap;
+	struct ion_device *dev = buffer->dev;
+
+	mutex_lock(&dev->lock);
+	rb_erase(&buffer->node, &dev->buffers);
+	mutex_unlock(&dev->lock);
+
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE)
+		ion_heap_freelist_add(heap, buffer);
+	else
+		ion_buffer_destroy(buffer);
+}
+
 void ion_buffer_get(struct ion_buffer *buffer)
 {
 	kref_get(&buffer->ref);
@@ -230,7 +241,7 @@ void ion_buffer_get(struct ion_buffer *buffer)
 
 static int ion_buffer_put(struct ion_buffer *buffer)
 {
-	return kref_put(&buffer->ref, ion_buffer_destroy);
+	return kref_put(&buffer->ref, _ion_buffer_destroy);
 }
 
 static void ion_buffer_add_to_handle(struct ion_buffer *buffer)
@@ -406,6 +417,10 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 		if (!((1 << heap->id) & heap_mask))
 			continue;
 		buffer = ion_buffer_create(heap, dev, len, align, flags);
+		/* memory may still be sitting on the deferred free list */
+		if (IS_ERR_OR_NULL(buffer) && ion_heap_freelist_drain(heap))
+			buffer = ion_buffer_create(heap, dev, len, align,
+						   flags);
 		if (!IS_ERR_OR_NULL(buffer))
 			break;
 	}
@@ -1250,6 +1265,33 @@ static int ion_debug_heap_show(struct seq_file *s, void *unused)
 		   total_orphaned_size);
 	seq_printf(s, "%16.s %16u\n", "total ", total_size);
 
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE) {
+		unsigned long queued, done;
+		unsigned int len, max_len;
+		u64 latency_ns, max_latency_ns;
+		size_t free_size;
+
+		spin_lock(&heap->free_lock);
+		free_size = heap->free_list_size;
+		len = heap->free_list_len;
+		max_len = heap->free_max_len;
+		queued = heap->free_queued;
+		latency_ns = heap->free_latency_ns;
+		max_latency_ns = heap->free_max_latency_ns;
+		spin_unlock(&heap->free_lock);
+		done = queued - len;
+
+		seq_printf(s, "----------------------------------------------------\n");
+		seq_printf(s, "%16.s %16u\n", "deferred free", free_size);
+		seq_printf(s, "%16.s %16u\n", "queue length", len);
+		seq_printf(s, "%16.s %16u\n", "max length", max_len);
+		seq_printf(s, "%16.s %16lu\n", "queued", queued);
+		seq_printf(s, "%16.s %16llu\n", "avg latency us",
+			   done ? div_u64(latency_ns, done) / NSEC_PER_USEC : 0);
+		seq_printf(s, "%16.s %16llu\n", "max latency us",
+			   div_u64(max_latency_ns, NSEC_PER_USEC));
+	}
+
 	return 0;
 }
 
@@ -1293,6 +1335,10 @@ void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap)
 		}
 	}
 
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE &&
+	    ion_heap_init_deferred_free(heap))
+		heap->flags &= ~ION_HEAP_FLAG_DEFER_FREE;
+
 	rb_link_node(&heap->node, parent, p);
 	rb_insert_color(&heap->node, &dev->heaps);
 	debugfs_create_file(heap->name, 0664, dev->debug_root, heap,
@@ -15,9 +15,124 @@
  */
 
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/ion.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
 #include "ion_priv.h"
 
+void ion_heap_freelist_add(struct ion_heap *heap, struct ion_buffer *buffer)
+{
+	buffer->free_queued = ktime_get();
+	spin_lock(&heap->free_lock);
+	list_add_tail(&buffer->list, &heap->free_list);
+	heap->free_list_size += buffer->size;
+	heap->free_list_len++;
+	heap->free_queued++;
+	if (heap->free_list_len > heap->free_max_len)
+		heap->free_max_len = heap->free_list_len;
+	spin_unlock(&heap->free_lock);
+	wake_up(&heap->waitqueue);
+}
+
+size_t ion_heap_freelist_size(struct ion_heap *heap)
+{
+	size_t size;
+
+	spin_lock(&heap->free_lock);
+	size = heap->free_list_size;
+	spin_unlock(&heap->free_lock);
+
+	return size;
+}
+
+static struct ion_buffer *ion_heap_freelist_pop(struct ion_heap *heap)
+{
+	struct ion_buffer *buffer = NULL;
+
+	spin_lock(&heap->free_lock);
+	if (!list_empty(&heap->free_list)) {
+		buffer = list_first_entry(&heap->free_list, struct ion_buffer,
+					  list);
+		list_del(&buffer->list);
+		heap->free_list_size -= buffer->size;
+		heap->free_list_len--;
+	}
+	spin_unlock(&heap->free_lock);
+
+	return buffer;
+}
+
+static size_t ion_heap_freelist_free(struct ion_heap *heap,
+				     struct ion_buffer *buffer)
+{
+	size_t size = buffer->size;
+	u64 latency = ktime_to_ns(ktime_sub(ktime_get(), buffer->free_queued));
+
+	ion_buffer_destroy(buffer);
+
+	spin_lock(&heap->free_lock);
+	heap->free_latency_ns += latency;
+	if (latency > heap->free_max_latency_ns)
+		heap->free_max_latency_ns = latency;
+	spin_unlock(&heap->free_lock);
+
+	return size;
+}
+
+size_t ion_heap_freelist_drain(struct ion_heap *heap)
+{
+	struct ion_buffer *buffer;
+	size_t total = 0;
+
+	if (!(heap->flags & ION_HEAP_FLAG_DEFER_FREE))
+		return 0;
+
+	while ((buffer = ion_heap_freelist_pop(heap)))
+		total += ion_heap_freelist_free(heap, buffer);
+
+	return total;
+}
+
+static int ion_heap_deferred_free(void *data)
+{
+	struct ion_heap *heap = data;
+	struct ion_buffer *buffer;
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		wait_event_freezable(heap->waitqueue,
+				     ion_heap_freelist_size(heap) > 0 ||
+				     kthread_should_stop());
+
+		while ((buffer = ion_heap_freelist_pop(heap)))
+			ion_heap_freelist_free(heap, buffer);
+	}
+
+	return 0;
+}
+
+int ion_heap_init_deferred_free(struct ion_heap *heap)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	INIT_LIST_HEAD(&heap->free_list);
+	heap->free_list_size = 0;
+	heap->free_list_len = 0;
+	spin_lock_init(&heap->free_lock);
+	init_waitqueue_head(&heap->waitqueue);
+	heap->task = kthread_run(ion_heap_deferred_free, heap,
+				 "%s", heap->name);
+	if (IS_ERR(heap->task)) {
+		pr_err("%s: creating thread for deferred free failed\n",
+		       __func__);
+		return PTR_RET(heap->task);
+	}
+	/* frame threads drop buffers; never compete with them for the cpu */
+	sched_setscheduler(heap->task, SCHED_IDLE, &param);
+	return 0;
+}
+
 struct ion_heap *ion_heap_create(struct ion_platform_heap *heap_data)
 {
 	struct ion_heap *heap = NULL;
@@ -58,6 +173,12 @@ void ion_heap_destroy(struct ion_heap *heap)
 	if (!heap)
 		return;
 
+	if ((heap->flags & ION_HEAP_FLAG_DEFER_FREE) &&
+	    !IS_ERR_OR_NULL(heap->task)) {
+		kthread_stop(heap->task);
+		ion_heap_freelist_drain(heap);
+	}
+
 	switch (heap->type) {
 	case ION_HEAP_TYPE_SYSTEM_CONTIG:
 		ion_system_contig_heap_destroy(heap);
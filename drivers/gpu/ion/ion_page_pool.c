@@ -0,0 +1,228 @@
+/*
+ * drivers/gpu/ion/ion_page_pool.c
+ *
+ * Copyright (C) 2011 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/dma-mapping.h>
+#include <linux/highmem.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/scatterlist.h>
+#include <linux/shrinker.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include "ion_priv.h"
+
+/* all pools, so that one shrinker can drain them */
+static LIST_HEAD(pools);
+static DEFINE_MUTEX(pools_lock);
+
+/*
+ * Pages handed out by ion must be ready for dma: zeroed, and with no dirty
+ * lines left in the cpu caches.  See the comment in ion_buffer_create().
+ */
+static void ion_page_pool_clean(struct ion_page_pool *pool, struct page *page)
+{
+	struct scatterlist sg;
+
+	sg_init_table(&sg, 1);
+	sg_set_page(&sg, page, PAGE_SIZE << pool->order, 0);
+	sg_dma_address(&sg) = sg_phys(&sg);
+	dma_sync_sg_for_device(NULL, &sg, 1, DMA_BIDIRECTIONAL);
+}
+
+static void ion_page_pool_zero(struct ion_page_pool *pool, struct page *page)
+{
+	int i;
+
+	for (i = 0; i < (1 << pool->order); i++)
+		clear_highpage(page + i);
+	ion_page_pool_clean(pool, page);
+}
+
+static struct page *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
+{
+	struct page *page = alloc_pages(pool->gfp_mask | __GFP_ZERO,
+					pool->order);
+
+	if (!page)
+		return NULL;
+	/* every page is mapped and refcounted on its own by ion */
+	split_page(page, pool->order);
+	ion_page_pool_clean(pool, page);
+	return page;
+}
+
+static void ion_page_pool_free_pages(struct ion_page_pool *pool,
+				     struct page *page)
+{
+	int i;
+
+	for (i = 0; i < (1 << pool->order); i++)
+		__free_page(page + i);
+}
+
+static struct page *ion_page_pool_remove(struct list_head *list, int *count)
+{
+	struct page *page;
+
+	if (list_empty(list))
+		return NULL;
+	page = list_first_entry(list, struct page, lru);
+	list_del(&page->lru);
+	(*count)--;
+	return page;
+}
+
+/* zero the pages freed back to the pool before anyone asks for them */
+static void ion_page_pool_zero_work(struct work_struct *work)
+{
+	struct ion_page_pool *pool = container_of(work, struct ion_page_pool,
+						  work);
+	struct page *page;
+
+	for (;;) {
+		mutex_lock(&pool->mutex);
+		page = ion_page_pool_remove(&pool->dirty, &pool->dirty_count);
+		mutex_unlock(&pool->mutex);
+		if (!page)
+			break;
+
+		ion_page_pool_zero(pool, page);
+
+		mutex_lock(&pool->mutex);
+		list_add_tail(&page->lru, &pool->items);
+		pool->count++;
+		mutex_unlock(&pool->mutex);
+		cond_resched();
+	}
+}
+
+struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
+{
+	struct page *page;
+	bool zero = false;
+
+	mutex_lock(&pool->mutex);
+	page = ion_page_pool_remove(&pool->items, &pool->count);
+	if (!page) {
+		page = ion_page_pool_remove(&pool->dirty, &pool->dirty_count);
+		zero = page != NULL;
+	}
+	mutex_unlock(&pool->mutex);
+
+	if (!page)
+		return ion_page_pool_alloc_pages(pool);
+	if (zero)
+		ion_page_pool_zero(pool, page);
+	return page;
+}
+
+void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
+{
+	mutex_lock(&pool->mutex);
+	list_add_tail(&page->lru, &pool->dirty);
+	pool->dirty_count++;
+	mutex_unlock(&pool->mutex);
+	queue_work(system_unbound_wq, &pool->work);
+}
+
+int ion_page_pool_total(struct ion_page_pool *pool)
+{
+	return (pool->count + pool->dirty_count) << pool->order;
+}
+
+/*
+ * Give up to @nr_to_scan pages back to the system, dirty ones first since
+ * nobody has paid to zero them yet.  Returns the number of pages freed.
+ */
+static int ion_page_pool_drain(struct ion_page_pool *pool, int nr_to_scan)
+{
+	struct page *page;
+	int freed = 0;
+
+	while (freed < nr_to_scan) {
+		mutex_lock(&pool->mutex);
+		page = ion_page_pool_remove(&pool->dirty, &pool->dirty_count);
+		if (!page)
+			page = ion_page_pool_remove(&pool->items, &pool->count);
+		mutex_unlock(&pool->mutex);
+		if (!page)
+			break;
+		ion_page_pool_free_pages(pool, page);
+		freed += 1 << pool->order;
+	}
+	return freed;
+}
+
+static int ion_page_pool_shrink(struct shrinker *shrinker,
+				struct shrink_control *sc)
+{
+	struct ion_page_pool *pool;
+	int nr_to_scan = sc->nr_to_scan;
+	int total = 0;
+
+	if (!mutex_trylock(&pools_lock))
+		return nr_to_scan ? -1 : 0;
+
+	list_for_each_entry(pool, &pools, list) {
+		if (nr_to_scan > 0)
+			nr_to_scan -= ion_page_pool_drain(pool, nr_to_scan);
+		total += ion_page_pool_total(pool);
+	}
+	mutex_unlock(&pools_lock);
+	return total;
+}
+
+static struct shrinker ion_page_pool_shrinker = {
+	.shrink = ion_page_pool_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
+					   bool cached)
+{
+	struct ion_page_pool *pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+
+	if (!pool)
+		return NULL;
+	INIT_LIST_HEAD(&pool->items);
+	INIT_LIST_HEAD(&pool->dirty);
+	mutex_init(&pool->mutex);
+	INIT_WORK(&pool->work, ion_page_pool_zero_work);
+	pool->gfp_mask = gfp_mask;
+	pool->order = order;
+	pool->cached = cached;
+
+	mutex_lock(&pools_lock);
+	if (list_empty(&pools))
+		register_shrinker(&ion_page_pool_shrinker);
+	list_add_tail(&pool->list, &pools);
+	mutex_unlock(&pools_lock);
+	return pool;
+}
+
+void ion_page_pool_destroy(struct ion_page_pool *pool)
+{
+	mutex_lock(&pools_lock);
+	list_del(&pool->list);
+	if (list_empty(&pools))
+		unregister_shrinker(&ion_page_pool_shrinker);
+	mutex_unlock(&pools_lock);
+
+	cancel_work_sync(&pool->work);
+	ion_page_pool_drain(pool, INT_MAX);
+	kfree(pool);
+}
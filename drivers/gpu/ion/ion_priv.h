@@ -18,12 +18,16 @@
 #define _ION_PRIV_H
 
 #include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/mm_types.h>
 #include <linux/mutex.h>
 #include <linux/rbtree.h>
 #include <linux/sched.h>
 #include <linux/ion.h>
 #include <linux/miscdevice.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 
 struct ion_device;
 struct ion_client;
@@ -79,6 +83,8 @@ int ion_remap_dma(struct ion_client *client,
  *			handle, used for debugging
  * @pid:		pid of last client to reference this buffer in a
  *			handle, used for debugging
+ * @list:		node on the heap's free list when freeing is deferred
+ * @free_queued:	when the buffer was put on the heap's free list
 */
 struct ion_buffer {
 	struct kref ref;
@@ -103,8 +109,12 @@ struct ion_buffer {
 	int handle_count;
 	char task_comm[TASK_COMM_LEN];
 	pid_t pid;
+	struct list_head list;
+	ktime_t free_queued;
 };
 
+void ion_buffer_destroy(struct ion_buffer *buffer);
+
 /**
  * struct ion_heap_ops - ops to operate on a given heap
  * @allocate:		allocate memory
@@ -133,16 +143,33 @@ struct ion_heap_ops {
 			 struct vm_area_struct *vma);
 };
 
+/**
+ * heap flags - flags between the heaps and core ion code
+ */
+#define ION_HEAP_FLAG_DEFER_FREE (1 << 0)
+
 /**
  * struct ion_heap - represents a heap in the system
  * @node:		rb node to put the heap on the device's tree of heaps
  * @dev:		back pointer to the ion_device
  * @type:		type of heap
  * @ops:		ops struct as above
+ * @flags:		flags
  * @id:			id of heap, also indicates priority of this heap when
  *			allocating.  These are specified by platform data and
  *			MUST be unique
  * @name:		used for debugging
+ * @free_list:		free list head if deferred free is used
+ * @free_list_size:	size of the buffers on the free list in bytes
+ * @free_list_len:	number of buffers on the free list
+ * @free_lock:		protects the free list and the free statistics
+ * @waitqueue:		queue to wait on from the deferred free thread
+ * @task:		task struct of the deferred free thread
+ * @free_queued:	buffers ever put on the free list
+ * @free_max_len:	longest the free list has been
+ * @free_latency_ns:	total time buffers spent between being queued and
+ *			being freed
+ * @free_max_latency_ns: longest any buffer waited to be freed
  *
  * Represents a pool of memory from which buffers can be made.  In some
  * systems the only heap is regular system memory allocated via vmalloc.
@@ -154,8 +181,19 @@ struct ion_heap {
 	struct ion_device *dev;
 	enum ion_heap_type type;
 	struct ion_heap_ops *ops;
+	unsigned long flags;
 	int id;
 	const char *name;
+	struct list_head free_list;
+	size_t free_list_size;
+	unsigned int free_list_len;
+	spinlock_t free_lock;
+	wait_queue_head_t waitqueue;
+	struct task_struct *task;
+	unsigned long free_queued;
+	unsigned int free_max_len;
+	u64 free_latency_ns;
+	u64 free_max_latency_ns;
 };
 
 /**
@@ -191,6 +229,41 @@ void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap);
 struct ion_heap *ion_heap_create(struct ion_platform_heap *);
 void ion_heap_destroy(struct ion_heap *);
 
+/**
+ * ion_heap_init_deferred_free -- initialize deferred free functionality
+ * @heap:		the heap
+ *
+ * If a heap sets the ION_HEAP_FLAG_DEFER_FREE flag this function will
+ * be called to set up deferred frees. Calls to free the buffer will
+ * return immediately and the actual free will occur some time later
+ */
+int ion_heap_init_deferred_free(struct ion_heap *heap);
+
+/**
+ * ion_heap_freelist_add - add a buffer to the deferred free list
+ * @heap:		the heap
+ * @buffer:		the buffer
+ *
+ * Adds an item to the deferred freelist.
+ */
+void ion_heap_freelist_add(struct ion_heap *heap, struct ion_buffer *buffer);
+
+/**
+ * ion_heap_freelist_drain - free the buffers waiting on the free list
+ * @heap:		the heap
+ *
+ * Frees everything on the deferred free list in the caller, for example
+ * when an allocation failed and the memory is needed now.  Returns the
+ * number of bytes freed.
+ */
+size_t ion_heap_freelist_drain(struct ion_heap *heap);
+
+/**
+ * ion_heap_freelist_size - returns the size of the freelist in bytes
+ * @heap:		the heap
+ */
+size_t ion_heap_freelist_size(struct ion_heap *heap);
+
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *);
 void ion_system_heap_destroy(struct ion_heap *);
 
@@ -226,4 +299,43 @@ static inline void ion_iommu_heap_destroy(struct ion_heap *)
  */
 #define ION_CARVEOUT_ALLOCATE_FAIL -1
 
+/**
+ * struct ion_page_pool - pool of pages of one order for the system heap
+ * @count:		number of zeroed, cache-clean chunks on @items
+ * @dirty_count:	number of freed chunks on @dirty not yet zeroed
+ * @items:		chunks ready to be handed out
+ * @dirty:		chunks waiting for @work to zero them
+ * @mutex:		protects the lists and counts
+ * @work:		zeroes chunks on @dirty in the background
+ * @gfp_mask:		gfp_mask used when the pool has to go to the buddy
+ *			allocator
+ * @order:		order of the chunks in the pool
+ * @cached:		whether the pool backs ION_FLAG_CACHED buffers
+ * @list:		node on the list of pools drained by the shrinker
+ *
+ * Chunks are split into order-0 pages, linked through the lru of their
+ * first page.  Allocating from the pool returns zeroed pages that are
+ * ready for dma; freeing to the pool queues the chunk for zeroing.  The
+ * pools give their pages back to the system from a shrinker.
+ */
+struct ion_page_pool {
+	int count;
+	int dirty_count;
+	struct list_head items;
+	struct list_head dirty;
+	struct mutex mutex;
+	struct work_struct work;
+	gfp_t gfp_mask;
+	unsigned int order;
+	bool cached;
+	struct list_head list;
+};
+
+struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
+					   bool cached);
+void ion_page_pool_destroy(struct ion_page_pool *);
+struct page *ion_page_pool_alloc(struct ion_page_pool *);
+void ion_page_pool_free(struct ion_page_pool *, struct page *);
+int ion_page_pool_total(struct ion_page_pool *);
+
 #endif /* _ION_PRIV_H */
@@ -25,28 +25,73 @@
 #include <linux/vmalloc.h>
 #include "ion_priv.h"
 
+static unsigned int orders[] = {8, 4, 0};
+#define NUM_ORDERS ARRAY_SIZE(orders)
+
+static int order_to_index(unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++)
+		if (order == orders[i])
+			return i;
+	BUG();
+	return -1;
+}
+
+/**
+ * struct ion_system_heap - the system heap and its page pools
+ * @heap:		the ion heap
+ * @uncached_pools:	one pool per entry in orders[] for uncached buffers
+ * @cached_pools:	one pool per entry in orders[] for ION_FLAG_CACHED
+ *			buffers
+ */
+struct ion_system_heap {
+	struct ion_heap heap;
+	struct ion_page_pool *uncached_pools[NUM_ORDERS];
+	struct ion_page_pool *cached_pools[NUM_ORDERS];
+};
+
+static struct ion_page_pool *ion_system_heap_pool(
+	struct ion_system_heap *sys_heap, unsigned long flags,
+	unsigned int order)
+{
+	int i = order_to_index(order);
+
+	if (flags & ION_FLAG_CACHED)
+		return sys_heap->cached_pools[i];
+	return sys_heap->uncached_pools[i];
+}
+
 struct page_info {
 	struct page *page;
 	unsigned long order;
 	struct list_head list;
 };
 
-static struct page_info *alloc_largest_available(unsigned long size)
+static struct page_info *alloc_largest_available(
+	struct ion_system_heap *sys_heap, unsigned long size,
+	unsigned long flags)
 {
-	static unsigned int orders[] = {8, 4, 0};
 	struct page *page;
 	struct page_info *info;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(orders); i++) {
+	for (i = 0; i < NUM_ORDERS; i++) {
 		if (size < (1 << orders[i]) * PAGE_SIZE)
 			continue;
-		page = alloc_pages(GFP_HIGHUSER | __GFP_ZERO |
-				   __GFP_NOWARN | __GFP_NORETRY, orders[i]);
+		page = ion_page_pool_alloc(ion_system_heap_pool(sys_heap,
+								flags,
+								orders[i]));
 		if (!page)
 			continue;
-		split_page(page, orders[i]);
-		info = kmalloc(sizeof(struct page_info *), GFP_KERNEL);
+		info = kmalloc(sizeof(struct page_info), GFP_KERNEL);
+		if (!info) {
+			ion_page_pool_free(ion_system_heap_pool(sys_heap, flags,
+								orders[i]),
+					   page);
+			return NULL;
+		}
 		info->page = page;
 		info->order = orders[i];
 		return info;
@@ -59,6 +104,9 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 				     unsigned long size, unsigned long align,
 				     unsigned long flags)
 {
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
 	struct sg_table *table;
 	struct scatterlist *sg;
 	int ret;
@@ -69,7 +117,8 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 
 	INIT_LIST_HEAD(&pages);
 	while (size_remaining > 0) {
-		info = alloc_largest_available(size_remaining);
+		info = alloc_largest_available(sys_heap, size_remaining,
+					       flags);
 		if (!info)
 			goto err;
 		list_add_tail(&info->list, &pages);
@@ -84,6 +133,7 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 	if (ret)
 		goto err1;
 
+	/* the pool hands out zeroed pages with clean caches, no sync here */
 	sg = table->sgl;
 	list_for_each_entry_safe(info, tmp_info, &pages, list) {
 		struct page *page = info->page;
@@ -96,30 +146,71 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 		kfree(info);
 	}
 
-	dma_sync_sg_for_device(NULL, table->sgl, table->nents,
-			       DMA_BIDIRECTIONAL);
-
 	buffer->priv_virt = table;
 	return 0;
 err1:
 	kfree(table);
 err:
-	list_for_each_entry(info, &pages, list) {
-		for (i = 0; i < (1 << info->order); i++)
-			__free_page(info->page + i);
+	list_for_each_entry_safe(info, tmp_info, &pages, list) {
+		ion_page_pool_free(ion_system_heap_pool(sys_heap, flags,
+							info->order),
+				   info->page);
 		kfree(info);
 	}
 	return -ENOMEM;
 }
 
+/*
+ * Hand the run of @count physically contiguous pages at @page back to the
+ * pools, in the largest chunks that fit.  The pages are all order-0 pages
+ * at this point, so any contiguous run can be pooled as a chunk.
+ */
+static void ion_system_heap_free_run(struct ion_system_heap *sys_heap,
+				     unsigned long flags, struct page *page,
+				     unsigned long count)
+{
+	int i;
+
+	while (count) {
+		for (i = 0; i < NUM_ORDERS; i++)
+			if ((1UL << orders[i]) <= count)
+				break;
+		ion_page_pool_free(ion_system_heap_pool(sys_heap, flags,
+							orders[i]),
+				   page);
+		page += 1 << orders[i];
+		count -= 1 << orders[i];
+	}
+}
+
 void ion_system_heap_free(struct ion_buffer *buffer)
 {
+	struct ion_system_heap *sys_heap = container_of(buffer->heap,
+							struct ion_system_heap,
+							heap);
+	unsigned long max_run = 1UL << orders[0];
+	struct page *run = NULL;
+	unsigned long count = 0;
 	int i;
 	struct scatterlist *sg;
 	struct sg_table *table = buffer->priv_virt;
 
-	for_each_sg(table->sgl, sg, table->nents, i)
-		__free_pages(sg_page(sg), get_order(sg_dma_len(sg)));
+	for_each_sg(table->sgl, sg, table->nents, i) {
+		struct page *page = sg_page(sg);
+
+		if (run && count < max_run &&
+		    page_to_pfn(page) == page_to_pfn(run) + count) {
+			count++;
+			continue;
+		}
+		if (run)
+			ion_system_heap_free_run(sys_heap, buffer->flags, run,
+						 count);
+		run = page;
+		count = 1;
+	}
+	if (run)
+		ion_system_heap_free_run(sys_heap, buffer->flags, run, count);
 	if (buffer->sg_table)
 		sg_free_table(buffer->sg_table);
 	kfree(buffer->sg_table);
@@ -208,21 +299,54 @@ static struct ion_heap_ops vmalloc_ops = {
 	.map_user = ion_system_heap_map_user,
 };
 
+static void ion_system_heap_destroy_pools(struct ion_system_heap *sys_heap)
+{
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		if (sys_heap->uncached_pools[i])
+			ion_page_pool_destroy(sys_heap->uncached_pools[i]);
+		if (sys_heap->cached_pools[i])
+			ion_page_pool_destroy(sys_heap->cached_pools[i]);
+	}
+}
+
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 {
-	struct ion_heap *heap;
+	struct ion_system_heap *sys_heap;
+	gfp_t gfp_flags = GFP_HIGHUSER | __GFP_NOWARN | __GFP_NORETRY;
+	int i;
 
-	heap = kzalloc(sizeof(struct ion_heap), GFP_KERNEL);
-	if (!heap)
+	sys_heap = kzalloc(sizeof(struct ion_system_heap), GFP_KERNEL);
+	if (!sys_heap)
 		return ERR_PTR(-ENOMEM);
-	heap->ops = &vmalloc_ops;
-	heap->type = ION_HEAP_TYPE_SYSTEM;
-	return heap;
+	sys_heap->heap.ops = &vmalloc_ops;
+	sys_heap->heap.type = ION_HEAP_TYPE_SYSTEM;
+	sys_heap->heap.flags = ION_HEAP_FLAG_DEFER_FREE;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		sys_heap->uncached_pools[i] =
+			ion_page_pool_create(gfp_flags, orders[i], false);
+		sys_heap->cached_pools[i] =
+			ion_page_pool_create(gfp_flags, orders[i], true);
+		if (!sys_heap->uncached_pools[i] ||
+		    !sys_heap->cached_pools[i]) {
+			ion_system_heap_destroy_pools(sys_heap);
+			kfree(sys_heap);
+			return ERR_PTR(-ENOMEM);
+		}
+	}
+	return &sys_heap->heap;
 }
 
 void ion_system_heap_destroy(struct ion_heap *heap)
 {
-	kfree(heap);
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
+
+	ion_system_heap_destroy_pools(sys_heap);
+	kfree(sys_heap);
 }
 
 static int ion_system_contig_heap_allocate(struct ion_heap *heap,
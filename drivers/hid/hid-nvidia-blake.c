@@ -20,6 +20,7 @@
 #include <linux/hid.h>
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 
 #include "hid-ids.h"
 
@@ -58,6 +59,10 @@
 #define XSCALE 1
 #define YSCALE 0
 
+/* last gamepad report per id, to drop repeats before the HID layer */
+#define REPORT_CACHE_IDS 8
+#define REPORT_CACHE_LEN 64
+
 struct nvidia_tp_loc {
 	u8 x;
 	u8 y;
@@ -67,6 +72,9 @@ struct nvidia_tp_loc {
 	u8 release;
 	u8 tp_size;
 	struct hid_report *ff_report;
+	ktime_t epoch;		/* MSC_TIMESTAMP base */
+	u8 report_len[REPORT_CACHE_IDS];
+	u8 report_cache[REPORT_CACHE_IDS][REPORT_CACHE_LEN];
 };
 
 enum {
@@ -131,6 +139,43 @@ static __u8 *nv_report_fixup(struct hid_device *hdev, __u8 *rdesc,
 	return rdesc;
 }
 
+static bool nvidia_is_gamepad(unsigned application)
+{
+	return application == HID_GD_GAMEPAD ||
+		application == HID_GD_JOYSTICK;
+}
+
+/*
+ * Gamepad reports repeat at the polling rate even when nothing moved.
+ * Drop exact repeats here instead of parsing every field, and stamp the
+ * rest with the time the report reached us, before the HID and input
+ * layers add their own latency.
+ */
+static int nvidia_gamepad_event(struct nvidia_tp_loc *loc,
+		struct hid_report *report, u8 *data, int size, ktime_t stamp)
+{
+	struct hid_input *hidinput;
+	unsigned id = report->id;
+
+	if (report->maxfield < 1 ||
+			!nvidia_is_gamepad(report->field[0]->application))
+		return 0;
+
+	if (id < REPORT_CACHE_IDS && size <= REPORT_CACHE_LEN) {
+		if (loc->report_len[id] == size &&
+				!memcmp(loc->report_cache[id], data, size))
+			return 1;
+		memcpy(loc->report_cache[id], data, size);
+		loc->report_len[id] = size;
+	}
+
+	hidinput = report->field[0]->hidinput;
+	if (hidinput)
+		input_event(hidinput->input, EV_MSC, MSC_TIMESTAMP,
+			(u32)ktime_to_us(ktime_sub(stamp, loc->epoch)));
+	return 0;
+}
+
 static int nvidia_raw_event(struct hid_device *hdev,
 		struct hid_report *report, u8 *data, int size) {
 
@@ -143,6 +188,7 @@ static int nvidia_raw_event(struct hid_device *hdev,
 	int release = 0;
 	signed short relx, rely;
 	signed short relx_raw, rely_raw;
+	ktime_t stamp = ktime_get();
 
 	if (!report)
 		return 1;
@@ -153,7 +199,7 @@ static int nvidia_raw_event(struct hid_device *hdev,
 
 	/* If not valid touch events, let generic driver to handle this */
 	if (id != TOUCH_REPORT_ID)
-		return 0;
+		return nvidia_gamepad_event(loc, report, data, size, stamp);
 
 	/* If driver is in disabled mode,
 	 * don't report anything to generic
@@ -501,8 +547,7 @@ static int nvidia_probe(struct hid_device *hdev, const struct hid_device_id *id)
 	int ret;
 	struct nvidia_tp_loc *loc;
 
-	loc = (struct nvidia_tp_loc *)
-		kmalloc(sizeof(struct nvidia_tp_loc *), GFP_KERNEL);
+	loc = kzalloc(sizeof(*loc), GFP_KERNEL);
 
 	if (!loc) {
 		hid_err(hdev, "cannot alloc device touchpad state\n");
@@ -514,6 +559,7 @@ static int nvidia_probe(struct hid_device *hdev, const struct hid_device_id *id)
 	loc->action = 0;
 	loc->speed = DEFAULT_SPEED;
 	loc->mode = MOUSE_MODE;
+	loc->epoch = ktime_get();
 	hid_set_drvdata(hdev, loc);
 
 	/* Parse the HID report now */
@@ -555,6 +601,8 @@ static void nvidia_remove(struct hid_device *hdev)
 	device_remove_file(&hdev->dev, &dev_attr_mode);
 
 	hid_hw_stop(hdev);
+	hid_set_drvdata(hdev, NULL);
+	kfree(loc);
 }
 
 static int nvidia_input_mapped(struct hid_device *hdev, struct hid_input *hi,
@@ -566,6 +614,9 @@ static int nvidia_input_mapped(struct hid_device *hdev, struct hid_input *hi,
 	int fuzz;
 	int flat;
 
+	if (nvidia_is_gamepad(field->application))
+		input_set_capability(hi->input, EV_MSC, MSC_TIMESTAMP);
+
 	if ((usage->type == EV_ABS) && (field->application == HID_GD_GAMEPAD
 			|| field->application == HID_GD_JOYSTICK)) {
 		switch (usage->hid) {
@@ -25,6 +25,8 @@
 #include <linux/input.h>
 #include <linux/module.h>
 #include <linux/pm_qos.h>
+#include <linux/suspend.h>
+#include <linux/input/cfboost.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/input_cfboost.h>
@@ -51,36 +53,124 @@ MODULE_DESCRIPTION("Input event CPU frequency booster");
 MODULE_LICENSE("GPL v2");
 
 
-static struct pm_qos_request freq_req, core_req;
+static struct pm_qos_request freq_req, core_req, emc_req, gpu_req;
 static struct work_struct boost;
 static struct delayed_work unboost;
 static unsigned int boost_freq; /* kHz */
 module_param(boost_freq, uint, 0644);
+static unsigned int boost_cpus = 1;
+module_param(boost_cpus, uint, 0644);
+static unsigned int boost_emc_freq; /* kHz */
+module_param(boost_emc_freq, uint, 0644);
+static unsigned int boost_gpu_freq; /* kHz */
+module_param(boost_gpu_freq, uint, 0644);
 static unsigned long boost_time = 500; /* ms */
 module_param(boost_time, ulong, 0644);
+
+/* per source boost time in ms, 0 means boost_time */
+static unsigned long source_time[CFBOOST_NR_SOURCES];
+module_param_named(touch_boost_time, source_time[CFBOOST_TOUCH], ulong, 0644);
+module_param_named(gamepad_boost_time, source_time[CFBOOST_GAMEPAD],
+		   ulong, 0644);
+module_param_named(key_boost_time, source_time[CFBOOST_KEY], ulong, 0644);
+module_param_named(wake_boost_time, source_time[CFBOOST_WAKE], ulong, 0644);
+
+static const char * const source_names[CFBOOST_NR_SOURCES] = {
+	[CFBOOST_TOUCH]		= "touch",
+	[CFBOOST_GAMEPAD]	= "gamepad",
+	[CFBOOST_KEY]		= "key",
+	[CFBOOST_WAKE]		= "wake",
+};
+
+static DEFINE_SPINLOCK(cfb_lock);
+static bool boosted;		/* protected by cfb_lock */
+static unsigned long boost_end;	/* jiffies, protected by cfb_lock */
 static struct workqueue_struct *cfb_wq;
 
 static void cfb_boost(struct work_struct *w)
 {
-	trace_input_cfboost_params("boost_params", boost_freq, boost_time);
-	cancel_delayed_work_sync(&unboost);
-	pm_qos_update_request(&core_req, 1);
+	unsigned long flags;
+	long delay;
+
+	pm_qos_update_request(&core_req, boost_cpus);
 	pm_qos_update_request(&freq_req, boost_freq);
-	queue_delayed_work(cfb_wq, &unboost, msecs_to_jiffies(boost_time));
+	pm_qos_update_request(&emc_req, boost_emc_freq);
+	pm_qos_update_request(&gpu_req, boost_gpu_freq);
+
+	spin_lock_irqsave(&cfb_lock, flags);
+	delay = max_t(long, (long)(boost_end - jiffies), 0);
+	spin_unlock_irqrestore(&cfb_lock, flags);
+
+	queue_delayed_work(cfb_wq, &unboost, delay);
 }
 
 static void cfb_unboost(struct work_struct *w)
 {
+	unsigned long flags;
+
+	spin_lock_irqsave(&cfb_lock, flags);
+	/* extended by a later event */
+	if (time_after(boost_end, jiffies)) {
+		queue_delayed_work(cfb_wq, &unboost, boost_end - jiffies);
+		spin_unlock_irqrestore(&cfb_lock, flags);
+		return;
+	}
+	boosted = false;
+	spin_unlock_irqrestore(&cfb_lock, flags);
+
+	pm_qos_update_request(&gpu_req, PM_QOS_DEFAULT_VALUE);
+	pm_qos_update_request(&emc_req, PM_QOS_DEFAULT_VALUE);
 	pm_qos_update_request(&freq_req, PM_QOS_DEFAULT_VALUE);
 	pm_qos_update_request(&core_req, PM_QOS_DEFAULT_VALUE);
 }
 
+/*
+ * Raise the boost floors for the duration configured for @source, or
+ * extend a boost in progress. Drivers with events the input layer does
+ * not see call this directly.
+ */
+void cfboost_kick(enum cfboost_source source)
+{
+	unsigned long time = source_time[source] ? : boost_time;
+	unsigned long end = jiffies + msecs_to_jiffies(time);
+	unsigned long flags;
+
+	if (!cfb_wq)
+		return;
+
+	spin_lock_irqsave(&cfb_lock, flags);
+	if (!boosted || time_after(end, boost_end))
+		boost_end = end;
+	if (!boosted) {
+		boosted = true;
+		trace_input_cfboost_params(source_names[source], boost_freq,
+					   time);
+		queue_work(cfb_wq, &boost);
+	}
+	spin_unlock_irqrestore(&cfb_lock, flags);
+}
+EXPORT_SYMBOL_GPL(cfboost_kick);
+
 static void cfb_input_event(struct input_handle *handle, unsigned int type,
 			    unsigned int code, int value)
 {
 	trace_input_cfboost_event("event", type, code, value);
-	if (!work_pending(&boost))
-		queue_work(cfb_wq, &boost);
+	cfboost_kick((enum cfboost_source)(long)handle->private);
+}
+
+static enum cfboost_source cfb_input_source(struct input_dev *dev)
+{
+	if (test_bit(BTN_TOUCH, dev->keybit) ||
+	    test_bit(ABS_MT_POSITION_X, dev->absbit))
+		return CFBOOST_TOUCH;
+
+	if (test_bit(EV_ABS, dev->evbit) ||
+	    test_bit(BTN_GAMEPAD, dev->keybit) ||
+	    test_bit(BTN_JOYSTICK, dev->keybit))
+		return CFBOOST_GAMEPAD;
+
+	/* keys, buttons and mice */
+	return CFBOOST_KEY;
 }
 
 static int cfb_input_connect(struct input_handler *handler,
@@ -97,6 +187,7 @@ static int cfb_input_connect(struct input_handler *handler,
 	handle->dev = dev;
 	handle->handler = handler;
 	handle->name = "icfboost";
+	handle->private = (void *)(long)cfb_input_source(dev);
 
 	error = input_register_handle(handle);
 	if (error)
@@ -204,39 +295,48 @@ static struct input_handler cfb_input_handler = {
 	.id_table	= cfb_ids,
 };
 
+static int cfb_pm_notify(struct notifier_block *nb, unsigned long event,
+			 void *data)
+{
+	if (event == PM_POST_SUSPEND)
+		cfboost_kick(CFBOOST_WAKE);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cfb_pm_notifier = {
+	.notifier_call = cfb_pm_notify,
+};
+
 static int __init cfboost_init(void)
 {
 	int ret;
 
-	cfb_wq = create_workqueue("icfb-wq");
+	cfb_wq = create_singlethread_workqueue("icfb-wq");
 	if (!cfb_wq)
 		return -ENOMEM;
 	INIT_WORK(&boost, cfb_boost);
 	INIT_DELAYED_WORK(&unboost, cfb_unboost);
+	pm_qos_add_request(&core_req, PM_QOS_MIN_ONLINE_CPUS,
+			   PM_QOS_DEFAULT_VALUE);
+	pm_qos_add_request(&freq_req, PM_QOS_CPU_FREQ_MIN,
+			   PM_QOS_DEFAULT_VALUE);
+	pm_qos_add_request(&emc_req, PM_QOS_EMC_FREQ_MIN,
+			   PM_QOS_DEFAULT_VALUE);
+	pm_qos_add_request(&gpu_req, PM_QOS_GPU_FREQ_MIN,
+			   PM_QOS_DEFAULT_VALUE);
 	ret = input_register_handler(&cfb_input_handler);
 	if (ret) {
+		pm_qos_remove_request(&gpu_req);
+		pm_qos_remove_request(&emc_req);
+		pm_qos_remove_request(&freq_req);
+		pm_qos_remove_request(&core_req);
 		destroy_workqueue(cfb_wq);
+		cfb_wq = NULL;
 		return ret;
 	}
-	pm_qos_add_request(&core_req, PM_QOS_CPU_FREQ_MIN,
-			   PM_QOS_DEFAULT_VALUE);
-	pm_qos_add_request(&freq_req, PM_QOS_CPU_FREQ_MIN,
-			   PM_QOS_DEFAULT_VALUE);
+	register_pm_notifier(&cfb_pm_notifier);
 	return 0;
 }
 
-static void __exit cfboost_exit(void)
-{
-	/* stop input events */
-	input_unregister_handler(&cfb_input_handler);
-	/* cancel pending work requests */
-	cancel_work_sync(&boost);
-	cancel_delayed_work_sync(&unboost);
-	/* clean up */
-	destroy_workqueue(cfb_wq);
-	pm_qos_remove_request(&freq_req);
-	pm_qos_remove_request(&core_req);
-}
-
 module_init(cfboost_init);
-module_exit(cfboost_exit);
@@ -0,0 +1,201 @@
+/*
+ * drivers/input/input-frametrace.c
+ *
+ * Copyright (C) 2013 NVIDIA Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include <linux/slab.h>
+#include <linux/atomic.h>
+#include <linux/input.h>
+#include <linux/module.h>
+#include <linux/input/frame_trace.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/frame.h>
+
+/* This module listens to touch and gamepad devices and numbers their
+ * reports. The number is the frame id the graphics and display drivers
+ * stamp on their own frame_* events, so that one trace holds the whole
+ * input to scanout chain of each frame. See <linux/input/frame_trace.h>.
+ */
+
+MODULE_DESCRIPTION("Input to display frame tracing");
+MODULE_LICENSE("GPL v2");
+
+static atomic_t frame_id = ATOMIC_INIT(0);
+
+struct ift_handle {
+	struct input_handle handle;
+	const char *source;
+	bool pending;		/* events since the last SYN_REPORT */
+};
+
+u32 frame_trace_current(void)
+{
+	return atomic_read(&frame_id);
+}
+EXPORT_SYMBOL_GPL(frame_trace_current);
+
+void frame_trace_submit(const char *name, u32 frame, u32 syncpt_id,
+			u32 thresh)
+{
+	trace_frame_submit(frame, name, syncpt_id, thresh);
+}
+EXPORT_SYMBOL_GPL(frame_trace_submit);
+
+void frame_trace_complete(const char *name, u32 frame, u32 syncpt_id,
+			  u32 thresh)
+{
+	trace_frame_complete(frame, name, syncpt_id, thresh);
+}
+EXPORT_SYMBOL_GPL(frame_trace_complete);
+
+void frame_trace_flip(int head, u32 frame, int win, u32 pre_syncpt_id,
+		      u32 pre_syncpt_val, u32 post_syncpt_id,
+		      u32 post_syncpt_val)
+{
+	trace_frame_flip(head, frame, win, pre_syncpt_id, pre_syncpt_val,
+			 post_syncpt_id, post_syncpt_val);
+}
+EXPORT_SYMBOL_GPL(frame_trace_flip);
+
+void frame_trace_scanout(int head, u32 frame, u32 post_syncpt_id,
+			 u32 post_syncpt_val, u32 vblank, s64 timestamp_ns)
+{
+	trace_frame_scanout(head, frame, post_syncpt_id, post_syncpt_val,
+			    vblank, timestamp_ns);
+}
+EXPORT_SYMBOL_GPL(frame_trace_scanout);
+
+/* called with the device's event_lock held, so per handle state is safe */
+static void ift_input_event(struct input_handle *handle, unsigned int type,
+			    unsigned int code, int value)
+{
+	struct ift_handle *ih = container_of(handle, struct ift_handle, handle);
+
+	if (type != EV_SYN) {
+		ih->pending = true;
+		return;
+	}
+
+	if (code != SYN_REPORT || !ih->pending)
+		return;
+
+	ih->pending = false;
+	trace_frame_input(atomic_inc_return(&frame_id), handle->dev->name,
+			  ih->source);
+}
+
+static const char *ift_input_source(struct input_dev *dev)
+{
+	if (test_bit(BTN_TOUCH, dev->keybit) ||
+	    test_bit(ABS_MT_POSITION_X, dev->absbit))
+		return "touch";
+
+	return "gamepad";
+}
+
+static int ift_input_connect(struct input_handler *handler,
+			     struct input_dev *dev,
+			     const struct input_device_id *id)
+{
+	struct ift_handle *ih;
+	int error;
+
+	ih = kzalloc(sizeof(*ih), GFP_KERNEL);
+	if (!ih)
+		return -ENOMEM;
+
+	ih->handle.dev = dev;
+	ih->handle.handler = handler;
+	ih->handle.name = "iframetrace";
+	ih->source = ift_input_source(dev);
+
+	error = input_register_handle(&ih->handle);
+	if (error)
+		goto err2;
+
+	error = input_open_device(&ih->handle);
+	if (error)
+		goto err1;
+
+	return 0;
+err1:
+	input_unregister_handle(&ih->handle);
+err2:
+	kfree(ih);
+	return error;
+}
+
+static void ift_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(container_of(handle, struct ift_handle, handle));
+}
+
+static const struct input_device_id ift_ids[] = {
+	{ /* touch screen */
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+				INPUT_DEVICE_ID_MATCH_KEYBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.keybit = {[BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+	},
+	{ /* multi-touch screen */
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+				INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = {[BIT_WORD(ABS_MT_POSITION_X)] =
+			BIT_MASK(ABS_MT_POSITION_X) },
+	},
+	/* joystick */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { BIT_MASK(ABS_X) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			INPUT_DEVICE_ID_MATCH_KEYBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+		.keybit = {[BIT_WORD(BTN_JOYSTICK)] = BIT_MASK(BTN_JOYSTICK) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			INPUT_DEVICE_ID_MATCH_KEYBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+		.keybit = { [BIT_WORD(BTN_GAMEPAD)] = BIT_MASK(BTN_GAMEPAD) },
+	},
+	/* terminating entry */
+	{ },
+};
+
+static struct input_handler ift_input_handler = {
+	.event		= ift_input_event,
+	.connect	= ift_input_connect,
+	.disconnect	= ift_input_disconnect,
+	.name		= "iframetrace",
+	.id_table	= ift_ids,
+};
+
+static int __init frametrace_init(void)
+{
+	return input_register_handler(&ift_input_handler);
+}
+
+module_init(frametrace_init);
@@ -36,6 +36,8 @@
 #include <linux/random.h>	/* random32() */
 #include <linux/suspend.h>	/* pm_notifier */
 #include <linux/workqueue.h>
+#include <linux/vmalloc.h>	/* vmalloc_user() */
+#include <linux/poll.h>
 #ifdef CONFIG_HAS_WAKELOCK
 #include <linux/wakelock.h> /* wakelock */
 #endif
@@ -52,6 +54,9 @@
 #include <linux/spi/rm31080a_ctrl.h>
 
 #include <linux/pm_qos.h>	/* pm qos for CPU boosting */
+#ifdef CONFIG_TEGRA_DC
+#include <mach/dc.h>		/* tegra_dc_get_last_flip() */
+#endif
 #include <linux/sysfs.h>	/* sysfs for pm qos attributes */
 #define CREATE_TRACE_POINTS
 #include <trace/events/touchscreen_raydium.h>
@@ -75,6 +80,7 @@
 #define RM_SCAN_ACTIVE_MODE			0x00
 #define RM_SCAN_PRE_IDLE_MODE		0x01
 #define RM_SCAN_IDLE_MODE			0x02
+#define RM_SCAN_MODE_MAX			0x03
 
 #define RM_NEED_NONE					0x00
 #define RM_NEED_TO_SEND_SCAN			0x01
@@ -135,6 +141,9 @@ struct rm31080a_ts_para {
 	u32 u32WatchDogTime;
 
 	u8 u8ScanModeState;
+	unsigned long ulScanModeStamp;
+	u64 u64ScanModeTime[RM_SCAN_MODE_MAX];	/* jiffies */
+	u32 u32ScanModeEnter[RM_SCAN_MODE_MAX];
 
 #ifdef ENABLE_SLOW_SCAN
 	bool bEnableSlowScan;
@@ -156,9 +165,6 @@ struct rm31080a_ts_para {
 #endif
 	struct mutex mutex_scan_mode;
 
-	struct workqueue_struct *rm_workqueue;
-	struct work_struct rm_work;
-
 	struct workqueue_struct *rm_timer_workqueue;
 	struct work_struct rm_timer_work;
 
@@ -189,10 +195,15 @@ struct rm_tch_bus_ops {
 	int (*write) (struct device *dev, u8 reg, u16 val);
 };
 
+/*
+ * Single producer (IRQ thread), single consumer (HAL) ring. The header
+ * and the frames are mapped into the HAL by dev_mmap(), so the indices
+ * are only ever advanced with barriers and never under a lock.
+ */
 struct rm_tch_queue_info {
+	struct rm_tch_queue_hdr *pHdr;
 	u8(*pQueue)[RAW_DATA_LENGTH];
-	u16 u16Front;
-	u16 u16Rear;
+	wait_queue_head_t wq;
 };
 
 /*=============================================================================
@@ -218,6 +229,16 @@ unsigned char g_stRmSlowScanCmd[KRL_SIZE_RM_SLOWSCAN];
 
 static int g_service_busy_report_count;
 
+/*
+ * With no flip for static_screen_ms the screen is treated as static and
+ * the scan drops to idle after static_idle_frames untouched frames
+ * instead of the HAL's bTime2Idle. 0 disables the fast ramp-down.
+ */
+static unsigned int static_screen_ms = 100;
+module_param(static_screen_ms, uint, 0644);
+static unsigned int static_idle_frames = 10;
+module_param(static_idle_frames, uint, 0644);
+
 /*=============================================================================
 	FUNCTION DECLARATION
 =============================================================================*/
@@ -235,6 +256,8 @@ static void rm_ctrl_stop(struct rm_tch_ts *ts);
 static void rm_ctrl_start(struct rm_tch_ts *ts);
 
 static void rm_watchdog_enable(unsigned char u8Enable);
+static void rm_tch_flush_irq(void);
+static void rm_tch_set_scan_mode(u8 u8Mode);
 
 /*=============================================================================
 	 Description:
@@ -392,6 +415,33 @@ int rm_tch_spi_burst_write(unsigned char *pBuf, unsigned int u32Len)
 	return ret;
 }
 
+/*=============================================================================
+	Description:
+		Track scan mode residency for the scan_mode_stats attribute.
+=============================================================================*/
+static void rm_tch_set_scan_mode(u8 u8Mode)
+{
+	unsigned long ulNow = jiffies;
+	u8 u8Old = g_stTs.u8ScanModeState;
+
+	if (u8Old < RM_SCAN_MODE_MAX)
+		g_stTs.u64ScanModeTime[u8Old] += ulNow - g_stTs.ulScanModeStamp;
+	g_stTs.ulScanModeStamp = ulNow;
+	if (u8Mode != u8Old && u8Mode < RM_SCAN_MODE_MAX)
+		g_stTs.u32ScanModeEnter[u8Mode]++;
+	g_stTs.u8ScanModeState = u8Mode;
+}
+
+static bool rm_tch_screen_static(void)
+{
+#ifdef CONFIG_TEGRA_DC
+	if (static_screen_ms)
+		return time_after(jiffies, tegra_dc_get_last_flip() +
+				msecs_to_jiffies(static_screen_ms));
+#endif
+	return false;
+}
+
 /*=============================================================================*/
 void raydium_change_scan_mode(u8 u8TouchCount)
 {
@@ -399,6 +449,9 @@ void raydium_change_scan_mode(u8 u8TouchCount)
 	u16 u16NTCountThd;
 
 	u16NTCountThd = (u16)g_stCtrl.bTime2Idle * 100;
+	/* nothing on screen is moving: no need to keep full rate as long */
+	if (u16NTCountThd > static_idle_frames && rm_tch_screen_static())
+		u16NTCountThd = static_idle_frames;
 
 	if (u8TouchCount) {
 		u32NoTouchCount = 0;
@@ -408,7 +461,7 @@ void raydium_change_scan_mode(u8 u8TouchCount)
 		u32NoTouchCount++;
 	} else if (g_stTs.u8ScanModeState == RM_SCAN_ACTIVE_MODE) {
 		if (g_stTs.bEnableAutoScan)
-			g_stTs.u8ScanModeState = RM_SCAN_PRE_IDLE_MODE;
+			rm_tch_set_scan_mode(RM_SCAN_PRE_IDLE_MODE);
 		u32NoTouchCount = 0;
 	}
 }
@@ -566,14 +619,14 @@ static u32 rm_tch_ctrl_configure(void)
 
 		case RM_SCAN_PRE_IDLE_MODE:
 			rm_tch_ctrl_enter_auto_mode();
-			g_stTs.u8ScanModeState = RM_SCAN_IDLE_MODE;
+			rm_tch_set_scan_mode(RM_SCAN_IDLE_MODE);
 			u32Flag = RM_NEED_NONE;
 			break;
 
 		case RM_SCAN_IDLE_MODE:
 			rm_tch_ctrl_leave_auto_mode();
 			rm_tch_ctrl_scan_start();
-			g_stTs.u8ScanModeState = RM_SCAN_ACTIVE_MODE;
+			rm_tch_set_scan_mode(RM_SCAN_ACTIVE_MODE);
 			if (g_stCtrl.bICVersion >= 0xD0)
 				u32Flag = RM_NEED_TO_SEND_SCAN;
 			else
@@ -804,7 +857,7 @@ static int rm_tch_cmd_process(u8 selCase, u8 *pCmdTbl, struct rm_tch_ts *ts)
 				ret = OK;
 				if (pCmdTbl[_SUB_CMD] == KRL_SUB_CMD_SENSOR_QU) {
 					mutex_unlock(&lock);
-					flush_workqueue(g_stTs.rm_workqueue);
+					rm_tch_flush_irq();
 					mutex_lock(&lock);
 				} else if (pCmdTbl[_SUB_CMD] == KRL_SUB_CMD_TIMER_QU) {
 					mutex_unlock(&lock);
@@ -887,19 +940,19 @@ int rm_set_kernel_tbl(int iFuncIdx, u8 *u8pSrc)
 =============================================================================*/
 static void rm_tch_enter_manual_mode(void)
 {
-	flush_workqueue(g_stTs.rm_workqueue);
+	rm_tch_flush_irq();
 
 	if (g_stTs.u8ScanModeState == RM_SCAN_ACTIVE_MODE)
 		return;
 
 	if (g_stTs.u8ScanModeState == RM_SCAN_PRE_IDLE_MODE) {
-		g_stTs.u8ScanModeState = RM_SCAN_ACTIVE_MODE;
+		rm_tch_set_scan_mode(RM_SCAN_ACTIVE_MODE);
 		return;
 	}
 
 	if (g_stTs.u8ScanModeState == RM_SCAN_IDLE_MODE) {
 		rm_tch_ctrl_leave_auto_mode();
-		g_stTs.u8ScanModeState = RM_SCAN_ACTIVE_MODE;
+		rm_tch_set_scan_mode(RM_SCAN_ACTIVE_MODE);
 		usleep_range(10000, 10050);/*msleep(10);*/
 	}
 }
@@ -986,35 +1039,62 @@ static int rm_tch_ts_send_signal(int pid, int iInfo)
 =============================================================================*/
 static void rm_tch_queue_reset(void)
 {
-	g_stQ.u16Rear = 0;
-	g_stQ.u16Front = 0;
+	g_stQ.pHdr->u32Rear = 0;
+	g_stQ.pHdr->u32Front = 0;
 }
 
 static int rm_tch_queue_init(void)
 {
-	rm_tch_queue_reset();
-	g_stQ.pQueue = kmalloc(QUEUE_COUNT * RAW_DATA_LENGTH, GFP_KERNEL);
-	if (g_stQ.pQueue == NULL) {
+	void *pBuf;
+
+	pBuf = vmalloc_user(RM_QUEUE_DATA_OFFSET +
+				QUEUE_COUNT * RAW_DATA_LENGTH);
+	if (pBuf == NULL) {
 		return -ENOMEM;
 	}
+	g_stQ.pHdr = pBuf;
+	g_stQ.pHdr->u32Count = QUEUE_COUNT;
+	g_stQ.pHdr->u32Length = RAW_DATA_LENGTH;
+	rm_tch_queue_reset();
+	init_waitqueue_head(&g_stQ.wq);
+	smp_wmb();
+	g_stQ.pQueue = pBuf + RM_QUEUE_DATA_OFFSET;
 	return 0;
 }
 
 static void rm_tch_queue_free(void)
 {
-	if (!g_stQ.pQueue)
+	if (!g_stQ.pHdr)
 		return;
-	kfree(g_stQ.pQueue);
 	g_stQ.pQueue = NULL;
+	vfree(g_stQ.pHdr);
+	g_stQ.pHdr = NULL;
+}
+
+/*
+ * u32Front is written by the HAL through the mapping; never trust it
+ * as an index without clamping.
+ */
+static u32 rm_tch_queue_front(void)
+{
+	return ACCESS_ONCE(g_stQ.pHdr->u32Front) % QUEUE_COUNT;
+}
+
+static u32 rm_tch_queue_rear(void)
+{
+	return ACCESS_ONCE(g_stQ.pHdr->u32Rear) % QUEUE_COUNT;
 }
 
 #ifdef ENABLE_CALC_QUEUE_COUNT
 static int rm_tch_queue_get_current_count(void)
 {
-	if (g_stQ.u16Rear >= g_stQ.u16Front)
-		return g_stQ.u16Rear - g_stQ.u16Front;
+	u32 u32Front = rm_tch_queue_front();
+	u32 u32Rear = rm_tch_queue_rear();
+
+	if (u32Rear >= u32Front)
+		return u32Rear - u32Front;
 
-	return (QUEUE_COUNT - g_stQ.u16Front) + g_stQ.u16Rear;
+	return (QUEUE_COUNT - u32Front) + u32Rear;
 }
 #endif
 
@@ -1036,7 +1116,7 @@ static int rm_tch_queue_get_current_count(void)
 =============================================================================*/
 static int rm_tch_queue_is_empty(void)
 {
-	if (g_stQ.u16Rear == g_stQ.u16Front)
+	if (rm_tch_queue_rear() == rm_tch_queue_front())
 		return 1;
 	return 0;
 }
@@ -1052,11 +1132,7 @@ static int rm_tch_queue_is_empty(void)
 =============================================================================*/
 static int rm_tch_queue_is_full(void)
 {
-	u16 u16Front = g_stQ.u16Front;
-	if (g_stQ.u16Rear + 1 == u16Front)
-		return 1;
-
-	if ((g_stQ.u16Rear == (QUEUE_COUNT - 1)) && (u16Front == 0))
+	if ((rm_tch_queue_rear() + 1) % QUEUE_COUNT == rm_tch_queue_front())
 		return 1;
 
 	return 0;
@@ -1069,7 +1145,9 @@ static void *rm_tch_enqueue_start(void)
 
 	if (!rm_tch_queue_is_full()) {
 		g_service_busy_report_count = 100;
-		return &g_stQ.pQueue[g_stQ.u16Rear];
+		/* the consumer is done with the slot before we overwrite it */
+		smp_mb();
+		return &g_stQ.pQueue[rm_tch_queue_rear()];
 	}
 
 	if (g_service_busy_report_count < 0) {
@@ -1082,26 +1160,31 @@ static void *rm_tch_enqueue_start(void)
 
 static void rm_tch_enqueue_finish(void)
 {
-	if (g_stQ.u16Rear == (QUEUE_COUNT - 1))
-		g_stQ.u16Rear = 0;
-	else
-		g_stQ.u16Rear++;
+	/* publish the frame before the index */
+	smp_wmb();
+	g_stQ.pHdr->u32Rear = (rm_tch_queue_rear() + 1) % QUEUE_COUNT;
+	wake_up_interruptible(&g_stQ.wq);
 }
 
 static void *rm_tch_dequeue_start(void)
 {
-	if (!rm_tch_queue_is_empty())
-		return &g_stQ.pQueue[g_stQ.u16Front];
+	if (!g_stQ.pQueue)
+		return NULL;
+
+	if (!rm_tch_queue_is_empty()) {
+		/* read the index before the frame */
+		smp_rmb();
+		return &g_stQ.pQueue[rm_tch_queue_front()];
+	}
 
 	return NULL;
 }
 
 static void rm_tch_dequeue_finish(void)
 {
-	if (g_stQ.u16Front == (QUEUE_COUNT - 1))
-		g_stQ.u16Front = 0;
-	else
-		g_stQ.u16Front++;
+	/* finish reading the frame before handing the slot back */
+	smp_mb();
+	g_stQ.pHdr->u32Front = (rm_tch_queue_front() + 1) % QUEUE_COUNT;
 }
 
 static long rm_tch_queue_read_raw_data(u8 *p, u32 u32Len)
@@ -1112,15 +1195,19 @@ static long rm_tch_queue_read_raw_data(u8 *p, u32 u32Len)
 	if (!pQueue)
 		return 0;
 
-	u32Ret = copy_to_user(p, pQueue, u32Len);
+	u32Ret = copy_to_user(p, pQueue, min_t(u32, u32Len, RAW_DATA_LENGTH));
 	if (u32Ret != 0)
 		return 0;
 
 	rm_tch_dequeue_finish();
 	return 1;
 }
-/*=============================================================================*/
-static void rm_work_handler(struct work_struct *work)
+/*=============================================================================
+	Description:
+		Runs in the threaded IRQ handler: clear the interrupt, burst
+		read the frame straight into the ring and wake the HAL.
+=============================================================================*/
+static void rm_tch_irq_process(void)
 {
 	void *pKernelBuffer;
 	u32 u32Flag;
@@ -1158,6 +1245,13 @@ static void rm_work_handler(struct work_struct *work)
 	}
 }
 
+/* wait for a running IRQ thread, replaces flushing the old sensor queue */
+static void rm_tch_flush_irq(void)
+{
+	if (g_spi)
+		synchronize_irq(g_spi->irq);
+}
+
 static void rm_tch_init_ts_structure_part(void)
 {
 	g_stTs.bInitFinish = 0;
@@ -1168,7 +1262,7 @@ static void rm_tch_init_ts_structure_part(void)
 #ifdef ENABLE_SLOW_SCAN
 	g_stTs.bEnableSlowScan = false;
 #endif
-	g_stTs.u8ScanModeState = RM_SCAN_ACTIVE_MODE;
+	rm_tch_set_scan_mode(RM_SCAN_ACTIVE_MODE);
 
 	g_pu8BurstReadBuf = NULL;
 
@@ -1224,7 +1318,7 @@ static void rm_watchdog_work_function(unsigned char scan_mode)
 		del_timer(&ts_timer_triggle);
 		rm_tch_cmd_process(0, g_stRmWatchdogCmd, NULL);
 		g_stTs.bIsSuspended = false;
-		g_stTs.u8ScanModeState = RM_SCAN_ACTIVE_MODE;
+		rm_tch_set_scan_mode(RM_SCAN_ACTIVE_MODE);
 		add_timer(&ts_timer_triggle);
 		rm_tch_ctrl_scan_start();
 		return;
@@ -1531,6 +1625,44 @@ static ssize_t rm_tch_module_detect_store(struct device *dev,
 	return count;
 }
 
+static ssize_t rm_tch_scan_mode_stats_show(struct device *dev,
+		struct device_attribute *attr,
+		char *buf)
+{
+	static const char * const name[RM_SCAN_MODE_MAX] = {
+		"active", "pre_idle", "idle"
+	};
+	u64 u64Time[RM_SCAN_MODE_MAX];
+	u8 u8Mode;
+	int i, len = 0;
+
+	mutex_lock(&g_stTs.mutex_scan_mode);
+	/* fold the ongoing interval in */
+	rm_tch_set_scan_mode(g_stTs.u8ScanModeState);
+	u8Mode = g_stTs.u8ScanModeState;
+	memcpy(u64Time, g_stTs.u64ScanModeTime, sizeof(u64Time));
+	mutex_unlock(&g_stTs.mutex_scan_mode);
+
+	for (i = 0; i < RM_SCAN_MODE_MAX; i++)
+		len += sprintf(buf + len, "%s%-8s %10u ms %8u entries\n",
+			i == u8Mode ? "*" : " ", name[i],
+			jiffies_to_msecs((unsigned long)u64Time[i]),
+			g_stTs.u32ScanModeEnter[i]);
+	return len;
+}
+
+static ssize_t rm_tch_scan_mode_stats_store(struct device *dev,
+		struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	mutex_lock(&g_stTs.mutex_scan_mode);
+	memset(g_stTs.u64ScanModeTime, 0, sizeof(g_stTs.u64ScanModeTime));
+	memset(g_stTs.u32ScanModeEnter, 0, sizeof(g_stTs.u32ScanModeEnter));
+	g_stTs.ulScanModeStamp = jiffies;
+	mutex_unlock(&g_stTs.mutex_scan_mode);
+	return count;
+}
+
 static DEVICE_ATTR(slowscan_enable, 0640, rm_tch_slowscan_show,
 					rm_tch_slowscan_store);
 static DEVICE_ATTR(smooth_level, 0640, rm_tch_smooth_level_show,
@@ -1541,6 +1673,8 @@ static DEVICE_ATTR(version, 0640, rm_tch_version_show,
 					rm_tch_version_store);
 static DEVICE_ATTR(module_detect, 0640, rm_tch_module_detect_show,
 					rm_tch_module_detect_store);
+static DEVICE_ATTR(scan_mode_stats, 0640, rm_tch_scan_mode_stats_show,
+					rm_tch_scan_mode_stats_store);
 
 static struct attribute *rm_ts_attributes[] = {
 	&dev_attr_slowscan_enable.attr,
@@ -1548,6 +1682,7 @@ static struct attribute *rm_ts_attributes[] = {
 	&dev_attr_self_test.attr,
 	&dev_attr_version.attr,
 	&dev_attr_module_detect.attr,
+	&dev_attr_scan_mode_stats.attr,
 	NULL
 };
 
@@ -1588,7 +1723,7 @@ static irqreturn_t rm_tch_irq(int irq, void *handle)
 #endif
 
 	if (g_stTs.bInitFinish && g_stTs.bIsSuspended == false) {
-		queue_work(g_stTs.rm_workqueue, &g_stTs.rm_work);
+		rm_tch_irq_process();
 	} else {
 		rm_watchdog_enable(0);
 	}
@@ -1605,7 +1740,7 @@ static void rm_tch_enter_test_mode(u8 flag)
 	if (flag) { /*enter test mode*/
 		g_stTs.u8SelfTestStatus = RM_SELF_TEST_STATUS_TESTING;
 		g_stTs.bIsSuspended = true;
-		flush_workqueue(g_stTs.rm_workqueue);
+		rm_tch_flush_irq();
 		flush_workqueue(g_stTs.rm_timer_workqueue);
 	} else {/*leave test mode*/
 		g_stTs.bIsSuspended = false;
@@ -1676,14 +1811,12 @@ static void rm_tch_init_ts_structure(void)
 {
 	g_stTs.ulHalPID = 0;
 	memset(&g_stTs, 0, sizeof(struct rm31080a_ts_para));
+	g_stTs.ulScanModeStamp = jiffies;
 
 #ifdef ENABLE_SLOW_SCAN
 	g_stTs.u32SlowScanLevel = RM_SLOW_SCAN_LEVEL_MAX;
 #endif
 
-	g_stTs.rm_workqueue = create_singlethread_workqueue("rm_work");
-	INIT_WORK(&g_stTs.rm_work, rm_work_handler);
-
 	g_stTs.rm_timer_workqueue = create_singlethread_workqueue("rm_idle_work");
 	INIT_WORK(&g_stTs.rm_timer_work, rm_timer_work_handler);
 
@@ -2121,6 +2254,38 @@ static long dev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	return ret;
 }
 
+/*=============================================================================
+	Description:
+		Map the raw data ring into the HAL. The rm_tch_queue_hdr is at
+		offset 0 and the frames start at RM_QUEUE_DATA_OFFSET. The HAL
+		consumes frames in place and advances u32Front itself.
+=============================================================================*/
+static int dev_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	if (!g_stQ.pHdr)
+		return -ENOMEM;
+
+	if (vma->vm_pgoff ||
+		vma->vm_end - vma->vm_start >
+			RM_QUEUE_DATA_OFFSET + QUEUE_COUNT * RAW_DATA_LENGTH)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, g_stQ.pHdr, 0);
+}
+
+static unsigned int dev_poll(struct file *filp, poll_table *wait)
+{
+	if (!g_stQ.pHdr)
+		return POLLERR;
+
+	poll_wait(filp, &g_stQ.wq, wait);
+
+	if (!rm_tch_queue_is_empty())
+		return POLLIN | POLLRDNORM;
+
+	return 0;
+}
+
 static struct file_operations dev_fops = {
 	.owner = THIS_MODULE,
 	.open = dev_open,
@@ -2128,6 +2293,8 @@ static struct file_operations dev_fops = {
 	.read = dev_read,
 	.write = dev_write,
 	.unlocked_ioctl = dev_ioctl,
+	.mmap = dev_mmap,
+	.poll = dev_poll,
 };
 
 static struct miscdevice raydium_ts_miscdev = {
@@ -2181,9 +2348,6 @@ static int __devexit rm_tch_spi_remove(struct spi_device *spi)
 
 	rm_tch_queue_free();
 
-	if (g_stTs.rm_workqueue)
-		destroy_workqueue(g_stTs.rm_workqueue);
-
 #ifdef CONFIG_HAS_WAKELOCK
 	if (&g_stTs.Wakelock_Initialization)
 		wake_lock_destroy(&g_stTs.Wakelock_Initialization);
@@ -2363,8 +2527,6 @@ err_regulator_init:
 err_spi_speed:
 	if (g_stTs.rm_timer_workqueue)
 		destroy_workqueue(g_stTs.rm_timer_workqueue);
-	if (g_stTs.rm_workqueue)
-		destroy_workqueue(g_stTs.rm_workqueue);
 	mutex_destroy(&g_stTs.mutex_scan_mode);
 	return ret;
 }
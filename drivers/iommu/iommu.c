@@ -26,6 +26,7 @@
 #include <linux/slab.h>
 #include <linux/errno.h>
 #include <linux/iommu.h>
+#include <linux/scatterlist.h>
 
 static ssize_t show_iommu_group(struct device *dev,
 				struct device_attribute *attr, char *buf)
@@ -333,6 +334,47 @@ size_t iommu_unmap(struct iommu_domain *domain, unsigned long iova, size_t size)
 }
 EXPORT_SYMBOL_GPL(iommu_unmap);
 
+/**
+ * iommu_map_sg - map a scatterlist contiguously from iova
+ * @domain: iommu domain
+ * @iova: start of the io virtual range, which must be page aligned
+ * @sgl: scatterlist to map
+ * @nents: number of entries of @sgl to map
+ * @prot: IOMMU_READ/IOMMU_WRITE/IOMMU_CACHE
+ *
+ * Each entry is mapped from the start of its first page up to the end of
+ * its data, rounded up to a page, and the next entry follows straight on.
+ * Drivers that implement ->map_sg get the whole list in one call;
+ * otherwise it is mapped an entry at a time. On failure nothing is left
+ * mapped.
+ */
+int iommu_map_sg(struct iommu_domain *domain, unsigned long iova,
+		 struct scatterlist *sgl, int nents, int prot)
+{
+	unsigned long orig_iova = iova;
+	struct scatterlist *s;
+	int i, ret = 0;
+
+	if (domain->ops->map_sg)
+		return domain->ops->map_sg(domain, iova, sgl, nents, prot);
+
+	for_each_sg(sgl, s, nents, i) {
+		size_t len = PAGE_ALIGN(s->offset + s->length);
+
+		ret = iommu_map(domain, iova, page_to_phys(sg_page(s)), len,
+				prot);
+		if (ret)
+			break;
+		iova += len;
+	}
+
+	if (ret)
+		iommu_unmap(domain, orig_iova, iova - orig_iova);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(iommu_map_sg);
+
 int iommu_device_group(struct device *dev, unsigned int *groupid)
 {
 	if (iommu_present(dev->bus) && dev->bus->iommu_ops->device_group)
@@ -32,10 +32,16 @@
 #include <linux/io.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/scatterlist.h>
+#include <linux/workqueue.h>
+#include <linux/mutex.h>
 
 #include <asm/page.h>
 #include <asm/cacheflush.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/tegra_smmu.h>
+
 #include <mach/iomap.h>
 #include <mach/hardware.h>
 #include <mach/tegra_smmu.h>
@@ -72,8 +78,12 @@ enum smmu_hwgrp {
 };
 #define HWG_AVPC	(1 << HWGRP_AVPC)
 
-/* bitmap of the page sizes currently supported */
-#define SMMU_IOMMU_PGSIZES	(SZ_4K)
+/*
+ * bitmap of the page sizes currently supported: the hardware only has 4K
+ * pages, but taking any power of two lets the iommu core hand contiguous
+ * runs over in one call, which map in one pass
+ */
+#define SMMU_IOMMU_PGSIZES	(~(SZ_4K - 1))
 
 #define SMMU_CONFIG				0x10
 #define SMMU_CONFIG_DISABLE			0
@@ -192,6 +202,7 @@ enum {
 #define SMMU_PDIR_SIZE	(sizeof(unsigned long) * SMMU_PDIR_COUNT)
 #define SMMU_PTBL_COUNT	1024
 #define SMMU_PTBL_SIZE	(sizeof(unsigned long) * SMMU_PTBL_COUNT)
+#define SMMU_SECTION_SIZE	(SMMU_PAGE_SIZE * SMMU_PTBL_COUNT)
 #define SMMU_PDIR_SHIFT	12
 #define SMMU_PDE_SHIFT	12
 #define SMMU_PTE_SHIFT	12
@@ -230,6 +241,9 @@ enum {
 #define SMMU_EX_PTBL_PAGE(pde)		\
 		pfn_to_page((unsigned long)(pde) & SMMU_PFN_MASK)
 #define SMMU_PFN_TO_PTE(pfn, attr)	(unsigned long)((pfn) | (attr))
+/* a PDE without _PDE_NEXT maps a 4MB section, by its first pfn */
+#define SMMU_PFN_TO_SECTION_PDE(pfn, attr)	\
+		(unsigned long)((pfn) | (attr))
 
 #define SMMU_ASID_ENABLE(asid)	((asid) | (1 << 31))
 #define SMMU_ASID_DISABLE	0
@@ -287,6 +301,32 @@ static const u32 tegra11x_smmu_hwgrp_asid_reg[HWGRP_COUNT] = {
 
 #define HWGRP_ASID_REG(x) (smmu_hwgrp_asid_reg[x])
 
+#define HWGRP_NAME(client) [HWGRP_##client] = #client
+
+static const char * const smmu_hwgrp_name[HWGRP_COUNT] = {
+	HWGRP_NAME(AFI),
+	HWGRP_NAME(AVPC),
+	HWGRP_NAME(DC),
+	HWGRP_NAME(DCB),
+	HWGRP_NAME(EPP),
+	HWGRP_NAME(G2),
+	HWGRP_NAME(HC),
+	HWGRP_NAME(HDA),
+	HWGRP_NAME(ISP),
+	HWGRP_NAME(MPE),
+	HWGRP_NAME(NV),
+	HWGRP_NAME(NV2),
+	HWGRP_NAME(PPCS),
+	HWGRP_NAME(SATA),
+	HWGRP_NAME(VDE),
+	HWGRP_NAME(VI),
+	HWGRP_NAME(MSENC),
+	HWGRP_NAME(TSEC),
+	HWGRP_NAME(PPCS1),
+	HWGRP_NAME(XUSB_HOST),
+	HWGRP_NAME(XUSB_DEV),
+};
+
 /*
  * Per client for address space
  */
@@ -297,6 +337,17 @@ struct smmu_client {
 	u32			hwgrp;
 };
 
+/*
+ * Per address space activity, counted under the address space lock
+ */
+struct smmu_as_stats {
+	u64			map_pages;
+	u64			unmap_pages;
+	u32			sections;
+	u32			ptc_flushes;
+	u32			tlb_flushes;
+};
+
 /*
  * Per address space
  */
@@ -308,7 +359,8 @@ struct smmu_as {
 	unsigned long		pdir_attr;
 	unsigned long		pde_attr;
 	unsigned long		pte_attr;
-	unsigned int		*pte_count;
+	unsigned int		*pte_count;	/* ~0 for a section */
+	struct smmu_as_stats	stats;
 
 	struct list_head	client;
 	spinlock_t		client_lock; /* for client list */
@@ -320,6 +372,37 @@ struct smmu_debugfs_info {
 	int cache;
 };
 
+/*
+ * The hit/miss counters only exist per cache, not per ASID. Each sample
+ * keeps their deltas next to what every ASID did over the same period, so
+ * that a burst of misses can be put down to the clients behind it.
+ */
+#define SMMU_STATS_SAMPLES	64
+#define SMMU_STATS_CACHES	2	/* tlb, ptc */
+
+struct smmu_stats_sample {
+	u32	ms;
+	u32	hit[SMMU_STATS_CACHES];
+	u32	miss[SMMU_STATS_CACHES];
+	struct {
+		u32	map_pages;
+		u32	unmap_pages;
+		u32	tlb_flushes;
+	} as[SMMU_NUM_ASIDS];
+};
+
+struct smmu_stats_ring {
+	struct mutex		lock;
+	struct delayed_work	work;
+	unsigned int		sample_ms;	/* 0: not sampling */
+	unsigned int		head;
+	unsigned int		count;
+	u32			last_hit[SMMU_STATS_CACHES];
+	u32			last_miss[SMMU_STATS_CACHES];
+	struct smmu_as_stats	last_as[SMMU_NUM_ASIDS];
+	struct smmu_stats_sample sample[SMMU_STATS_SAMPLES];
+};
+
 /*
  * Per SMMU device - IOMMU device
  */
@@ -344,6 +427,7 @@ struct smmu_device {
 
 	struct dentry *debugfs_root;
 	struct smmu_debugfs_info *debugfs_info;
+	struct smmu_stats_ring stats;
 
 	struct device_node *ahb;
 };
@@ -523,23 +607,42 @@ static void flush_ptc_and_tlb(struct smmu_device *smmu,
 		(as->asid << SMMU_TLB_FLUSH_ASID_SHIFT);
 	smmu_write(smmu, val, SMMU_TLB_FLUSH);
 	FLUSH_SMMU_REGS(smmu);
+	as->stats.ptc_flushes++;
+	as->stats.tlb_flushes++;
+}
+
+/*
+ * Sections are told apart by their count rather than by the PDE, since
+ * with CONFIG_TEGRA_IOMMU_SMMU_LINEAR a vacant PDE is an identity section.
+ */
+#define SMMU_PTE_COUNT_SECTION	(~0U)
+
+static inline bool pde_is_section(struct smmu_as *as, unsigned long pdn)
+{
+	return as->pte_count[pdn] == SMMU_PTE_COUNT_SECTION;
 }
 
+/* Drop the page table or section at iova */
 static void free_ptbl(struct smmu_as *as, dma_addr_t iova)
 {
 	unsigned long pdn = SMMU_ADDR_TO_PDN(iova);
 	unsigned long *pdir = (unsigned long *)page_address(as->pdir_page);
 
-	if (pdir[pdn] != _PDE_VACANT(pdn)) {
+	if (pde_is_section(as, pdn)) {
+		dev_dbg(as->smmu->dev, "section pdn: %lx\n", pdn);
+
+		as->pte_count[pdn] = 0;
+	} else if (pdir[pdn] != _PDE_VACANT(pdn)) {
 		dev_dbg(as->smmu->dev, "pdn: %lx\n", pdn);
 
 		ClearPageReserved(SMMU_EX_PTBL_PAGE(pdir[pdn]));
 		__free_page(SMMU_EX_PTBL_PAGE(pdir[pdn]));
-		pdir[pdn] = _PDE_VACANT(pdn);
-		FLUSH_CPU_DCACHE(&pdir[pdn], as->pdir_page, sizeof pdir[pdn]);
-		flush_ptc_and_tlb(as->smmu, as, iova, &pdir[pdn],
-				  as->pdir_page, 1);
+	} else {
+		return;
 	}
+	pdir[pdn] = _PDE_VACANT(pdn);
+	FLUSH_CPU_DCACHE(&pdir[pdn], as->pdir_page, sizeof pdir[pdn]);
+	flush_ptc_and_tlb(as->smmu, as, iova, &pdir[pdn], as->pdir_page, 1);
 }
 
 static void free_pdir(struct smmu_as *as)
@@ -578,7 +681,10 @@ static unsigned long *locate_pte(struct smmu_as *as,
 	unsigned long *pdir = page_address(as->pdir_page);
 	unsigned long *ptbl;
 
-	if (pdir[pdn] != _PDE_VACANT(pdn)) {
+	if (pde_is_section(as, pdn)) {
+		/* no PTEs under a section */
+		return NULL;
+	} else if (pdir[pdn] != _PDE_VACANT(pdn)) {
 		/* Mapped entry table already exists */
 		*ptbl_page_p = SMMU_EX_PTBL_PAGE(pdir[pdn]);
 		ptbl = page_address(*ptbl_page_p);
@@ -703,26 +809,110 @@ err_out:
 	return err;
 }
 
-static int __smmu_iommu_unmap(struct smmu_as *as, dma_addr_t iova)
+/*
+ * Range maps and unmaps write every PTE in the range before flushing
+ * anything. Short ranges are then flushed page by page as before; longer
+ * ones flush the whole PTC once and the TLB by 4MB section, or by ASID when
+ * the range spans more sections than that is worth.
+ */
+#define SMMU_RANGE_PAGE_FLUSH_MAX	16
+#define SMMU_RANGE_SECTION_FLUSH_MAX	4
+
+static void flush_ptc_and_tlb_range(struct smmu_device *smmu,
+				    struct smmu_as *as,
+				    unsigned long pdn_first,
+				    unsigned long pdn_last)
 {
-	unsigned long *pte;
+	unsigned long pdn;
+	u32 val, asid = SMMU_TLB_FLUSH_ASID_MATCH__ENABLE |
+		(as->asid << SMMU_TLB_FLUSH_ASID_SHIFT);
+
+	smmu_write(smmu, SMMU_PTC_FLUSH_TYPE_ALL, SMMU_PTC_FLUSH);
+	FLUSH_SMMU_REGS(smmu);
+	as->stats.ptc_flushes++;
+
+	if (pdn_last - pdn_first >= SMMU_RANGE_SECTION_FLUSH_MAX) {
+		val = SMMU_TLB_FLUSH_VA_MATCH_ALL | asid;
+		smmu_write(smmu, val, SMMU_TLB_FLUSH);
+		FLUSH_SMMU_REGS(smmu);
+		as->stats.tlb_flushes++;
+		return;
+	}
+
+	for (pdn = pdn_first; pdn <= pdn_last; pdn++) {
+		val = SMMU_TLB_FLUSH_VA(SMMU_PDN_TO_ADDR(pdn), SECTION) | asid;
+		smmu_write(smmu, val, SMMU_TLB_FLUSH);
+		as->stats.tlb_flushes++;
+	}
+	FLUSH_SMMU_REGS(smmu);
+}
+
+/* Unmap up to bytes from iova, stopping at the first vacant page */
+static size_t __smmu_iommu_unmap_range(struct smmu_as *as, dma_addr_t iova,
+				       size_t bytes)
+{
+	struct smmu_device *smmu = as->smmu;
+	unsigned long left = bytes >> SMMU_PAGE_SHIFT;
+	unsigned long pdn, pdn_first = SMMU_ADDR_TO_PDN(iova), pdn_last;
+	bool per_page = left <= SMMU_RANGE_PAGE_FLUSH_MAX;
+	unsigned long *pte, *run;
+	unsigned int *count, n, ptes;
 	struct page *page;
-	unsigned int *count;
+	size_t unmapped = 0;
+
+	while (left) {
+		if (pde_is_section(as, SMMU_ADDR_TO_PDN(iova))) {
+			/* sections only go as a whole */
+			if (WARN_ON(iova & (SMMU_SECTION_SIZE - 1)))
+				break;
+			free_ptbl(as, iova);
+			left -= min_t(unsigned long, left, SMMU_PTBL_COUNT);
+			iova += SMMU_SECTION_SIZE;
+			unmapped += SMMU_SECTION_SIZE;
+			continue;
+		}
 
-	pte = locate_pte(as, iova, false, &page, &count);
-	if (WARN_ON(!pte))
-		return -EINVAL;
+		pte = locate_pte(as, iova, false, &page, &count);
+		if (WARN_ON(!pte))
+			break;
 
-	if (*pte == _PTE_VACANT(iova))
-		return -EINVAL;
+		/* clear the run of PTEs this page table holds */
+		ptes = SMMU_ADDR_TO_PFN(iova) % SMMU_PTBL_COUNT;
+		ptes = min_t(unsigned long, SMMU_PTBL_COUNT - ptes, left);
+		run = pte;
+		for (n = 0; n < ptes && *pte != _PTE_VACANT(iova); n++) {
+			*pte = _PTE_VACANT(iova);
+			if (per_page) {
+				FLUSH_CPU_DCACHE(pte, page, sizeof(*pte));
+				flush_ptc_and_tlb(smmu, as, iova, pte, page, 0);
+			}
+			pte++;
+			iova += SMMU_PAGE_SIZE;
+		}
+		if (n && !per_page)
+			FLUSH_CPU_DCACHE(run, page, n * sizeof(*pte));
 
-	*pte = _PTE_VACANT(iova);
-	FLUSH_CPU_DCACHE(pte, page, sizeof(*pte));
-	flush_ptc_and_tlb(as->smmu, as, iova, pte, page, 0);
-	if (!--(*count))
-		free_ptbl(as, iova);
+		*count -= n;
+		left -= n;
+		unmapped += n * SMMU_PAGE_SIZE;
+		if (n < ptes)
+			break;
+	}
 
-	return 0;
+	if (!unmapped)
+		return 0;
+	as->stats.unmap_pages += unmapped >> SMMU_PAGE_SHIFT;
+
+	pdn_last = SMMU_ADDR_TO_PDN(iova - 1);
+	if (!per_page)
+		flush_ptc_and_tlb_range(smmu, as, pdn_first, pdn_last);
+
+	/* only now drop the page tables the range emptied */
+	for (pdn = pdn_first; pdn <= pdn_last; pdn++)
+		if (!as->pte_count[pdn])
+			free_ptbl(as, SMMU_PDN_TO_ADDR(pdn));
+
+	return unmapped;
 }
 
 static void __smmu_iommu_map_pfn(struct smmu_as *as, dma_addr_t iova,
@@ -747,19 +937,166 @@ static void __smmu_iommu_map_pfn(struct smmu_as *as, dma_addr_t iova,
 	put_signature(as, iova, pfn);
 }
 
+/*
+ * Map a 4MB section at iova straight from its PDE, if nothing is mapped
+ * there yet. Only ranges too long to flush page by page get here, so the
+ * PTC and TLB are left to the caller.
+ */
+static bool __smmu_iommu_map_section(struct smmu_as *as, dma_addr_t iova,
+				     unsigned long pfn)
+{
+	unsigned long pdn = SMMU_ADDR_TO_PDN(iova);
+	unsigned long *pdir = page_address(as->pdir_page);
+
+	if (as->pte_count[pdn] || pdir[pdn] != _PDE_VACANT(pdn))
+		return false;
+
+	pdir[pdn] = SMMU_PFN_TO_SECTION_PDE(pfn, as->pde_attr);
+	as->pte_count[pdn] = SMMU_PTE_COUNT_SECTION;
+	FLUSH_CPU_DCACHE(&pdir[pdn], as->pdir_page, sizeof pdir[pdn]);
+	put_signature(as, iova, pfn);
+	as->stats.sections++;
+	return true;
+}
+
+/*
+ * Fill the PTEs of npages physically contiguous pages from iova, with one
+ * cache flush per page table, using sections wherever iova and pfn are both
+ * 4MB aligned over a whole section. Unless per_page, the PTC and TLB are
+ * left for the caller to flush over the whole range. Returns the number of
+ * pages mapped, which is short only when a page table can't be allocated.
+ */
+static unsigned long __smmu_iommu_fill_range(struct smmu_as *as,
+					     dma_addr_t iova, unsigned long pfn,
+					     unsigned long npages,
+					     bool per_page)
+{
+	struct smmu_device *smmu = as->smmu;
+	unsigned long *pte, *run;
+	unsigned int *count, n, ptes;
+	struct page *page;
+	unsigned long mapped = 0;
+
+	while (mapped < npages) {
+		if (!per_page && npages - mapped >= SMMU_PTBL_COUNT &&
+		    !((SMMU_ADDR_TO_PFN(iova) | pfn) % SMMU_PTBL_COUNT) &&
+		    __smmu_iommu_map_section(as, iova, pfn)) {
+			pfn += SMMU_PTBL_COUNT;
+			iova += SMMU_SECTION_SIZE;
+			mapped += SMMU_PTBL_COUNT;
+			continue;
+		}
+
+		pte = locate_pte(as, iova, true, &page, &count);
+		if (!pte)
+			break;
+
+		ptes = SMMU_ADDR_TO_PFN(iova) % SMMU_PTBL_COUNT;
+		ptes = min_t(unsigned long, SMMU_PTBL_COUNT - ptes,
+			     npages - mapped);
+		run = pte;
+		for (n = 0; n < ptes; n++) {
+			if (*pte == _PTE_VACANT(iova))
+				(*count)++;
+			*pte = SMMU_PFN_TO_PTE(pfn, as->pte_attr);
+			if (unlikely((*pte == _PTE_VACANT(iova))))
+				(*count)--;
+			if (per_page) {
+				FLUSH_CPU_DCACHE(pte, page, sizeof(*pte));
+				flush_ptc_and_tlb(smmu, as, iova, pte, page, 0);
+			}
+			put_signature(as, iova, pfn);
+			pte++;
+			pfn++;
+			iova += SMMU_PAGE_SIZE;
+		}
+		if (!per_page)
+			FLUSH_CPU_DCACHE(run, page, ptes * sizeof(*pte));
+		mapped += ptes;
+	}
+	as->stats.map_pages += mapped;
+	return mapped;
+}
+
+/*
+ * Flush what a range map filled in, and take it down again if the map
+ * could not complete, so that a failed map leaves nothing behind
+ */
+static int __smmu_iommu_map_done(struct smmu_as *as, dma_addr_t iova,
+				 unsigned long mapped, bool per_page,
+				 bool complete)
+{
+	size_t bytes = mapped << SMMU_PAGE_SHIFT;
+
+	if (mapped && !per_page)
+		flush_ptc_and_tlb_range(as->smmu, as, SMMU_ADDR_TO_PDN(iova),
+					SMMU_ADDR_TO_PDN(iova + bytes - 1));
+	if (complete)
+		return 0;
+
+	__smmu_iommu_unmap_range(as, iova, bytes);
+	return -ENOMEM;
+}
+
 static int smmu_iommu_map(struct iommu_domain *domain, unsigned long iova,
 			  phys_addr_t pa, size_t bytes, int prot)
 {
 	struct smmu_as *as = domain->priv;
 	unsigned long pfn = __phys_to_pfn(pa);
-	unsigned long flags;
+	unsigned long npages = bytes >> SMMU_PAGE_SHIFT;
+	bool per_page = npages <= SMMU_RANGE_PAGE_FLUSH_MAX;
+	unsigned long flags, mapped;
+	int err;
 
-	dev_dbg(as->smmu->dev, "[%d] %08lx:%08x\n", as->asid, iova, pa);
+	dev_dbg(as->smmu->dev, "[%d] %08lx:%08x:%08zx\n", as->asid, iova, pa,
+		bytes);
+	trace_smmu_map(as->asid, iova, pa, bytes);
 
 	spin_lock_irqsave(&as->lock, flags);
-	__smmu_iommu_map_pfn(as, iova, pfn);
+	mapped = __smmu_iommu_fill_range(as, iova, pfn, npages, per_page);
+	err = __smmu_iommu_map_done(as, iova, mapped, per_page,
+				    mapped == npages);
 	spin_unlock_irqrestore(&as->lock, flags);
-	return 0;
+	return err;
+}
+
+/*
+ * Map a whole scatterlist under one lock round trip. Each entry covers the
+ * pages from its first page up to the end of its data, as dma-mapping lays
+ * them out.
+ */
+static int smmu_iommu_map_sg(struct iommu_domain *domain, unsigned long iova,
+			     struct scatterlist *sgl, int nents, int prot)
+{
+	struct smmu_as *as = domain->priv;
+	unsigned long total = 0, mapped = 0, npages, n, flags;
+	struct scatterlist *s;
+	bool per_page;
+	int i, err;
+
+	for_each_sg(sgl, s, nents, i)
+		total += PAGE_ALIGN(s->offset + s->length) >> SMMU_PAGE_SHIFT;
+	per_page = total <= SMMU_RANGE_PAGE_FLUSH_MAX;
+
+	dev_dbg(as->smmu->dev, "[%d] %08lx:%d entries, %lu pages\n",
+		as->asid, iova, nents, total);
+	trace_smmu_map_sg(as->asid, iova, nents, total);
+
+	spin_lock_irqsave(&as->lock, flags);
+	for_each_sg(sgl, s, nents, i) {
+		npages = PAGE_ALIGN(s->offset + s->length) >> SMMU_PAGE_SHIFT;
+		n = __smmu_iommu_fill_range(as,
+					    iova + (mapped << SMMU_PAGE_SHIFT),
+					    page_to_pfn(sg_page(s)), npages,
+					    per_page);
+		mapped += n;
+		if (n < npages)
+			break;
+	}
+	err = __smmu_iommu_map_done(as, iova, mapped, per_page,
+				    mapped == total);
+	spin_unlock_irqrestore(&as->lock, flags);
+	return err;
 }
 
 static size_t smmu_iommu_unmap(struct iommu_domain *domain, unsigned long iova,
@@ -767,21 +1104,24 @@ static size_t smmu_iommu_unmap(struct iommu_domain *domain, unsigned long iova,
 {
 	struct smmu_as *as = domain->priv;
 	unsigned long flags;
-	int err;
+	size_t unmapped;
 
-	dev_dbg(as->smmu->dev, "[%d] %08lx\n", as->asid, iova);
+	dev_dbg(as->smmu->dev, "[%d] %08lx:%08zx\n", as->asid, iova, bytes);
 
+	/* the iommu core hands us the whole remaining range */
 	spin_lock_irqsave(&as->lock, flags);
-	err = __smmu_iommu_unmap(as, iova);
+	unmapped = __smmu_iommu_unmap_range(as, iova, bytes);
 	spin_unlock_irqrestore(&as->lock, flags);
-	return err ? 0 : SMMU_PAGE_SIZE;
+	trace_smmu_unmap(as->asid, iova, bytes, unmapped);
+	return unmapped;
 }
 
 static phys_addr_t smmu_iommu_iova_to_phys(struct iommu_domain *domain,
 					   unsigned long iova)
 {
 	struct smmu_as *as = domain->priv;
-	unsigned long *pte;
+	unsigned long pdn = SMMU_ADDR_TO_PDN(iova);
+	unsigned long *pdir, *pte;
 	unsigned int *count;
 	struct page *page;
 	unsigned long pfn = 0;
@@ -789,9 +1129,15 @@ static phys_addr_t smmu_iommu_iova_to_phys(struct iommu_domain *domain,
 
 	spin_lock_irqsave(&as->lock, flags);
 
-	pte = locate_pte(as, iova, false, &page, &count);
-	if (pte)
-		pfn = *pte & SMMU_PFN_MASK;
+	if (pde_is_section(as, pdn)) {
+		pdir = page_address(as->pdir_page);
+		pfn = (pdir[pdn] & SMMU_PFN_MASK) +
+			SMMU_ADDR_TO_PFN(iova) % SMMU_PTBL_COUNT;
+	} else {
+		pte = locate_pte(as, iova, false, &page, &count);
+		if (pte)
+			pfn = *pte & SMMU_PFN_MASK;
+	}
 	dev_dbg(as->smmu->dev,
 		"iova:%08lx pfn:%08lx asid:%d\n", iova, pfn, as->asid);
 
@@ -1010,6 +1356,7 @@ static struct iommu_ops smmu_iommu_ops = {
 	.attach_dev	= smmu_iommu_attach_dev,
 	.detach_dev	= smmu_iommu_detach_dev,
 	.map		= smmu_iommu_map,
+	.map_sg		= smmu_iommu_map_sg,
 	.unmap		= smmu_iommu_unmap,
 	.iova_to_phys	= smmu_iommu_iova_to_phys,
 	.domain_has_cap	= smmu_iommu_domain_has_cap,
@@ -1128,8 +1475,233 @@ static const struct file_operations smmu_debugfs_stats_fops = {
 	.write		= smmu_debugfs_stats_write,
 };
 
+static void smmu_stats_snapshot(struct smmu_device *smmu,
+				struct smmu_as_stats *as_stats)
+{
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < smmu->num_as; i++) {
+		struct smmu_as *as = &smmu->as[i];
+
+		spin_lock_irqsave(&as->lock, flags);
+		as_stats[i] = as->stats;
+		spin_unlock_irqrestore(&as->lock, flags);
+	}
+}
+
+/* Take a sample; called with stats.lock held */
+static void smmu_stats_sample(struct smmu_device *smmu)
+{
+	struct smmu_stats_ring *ring = &smmu->stats;
+	struct smmu_stats_sample *smp = &ring->sample[ring->head];
+	struct smmu_as_stats now[SMMU_NUM_ASIDS];
+	int i;
+
+	smp->ms = jiffies_to_msecs(jiffies);
+	for (i = 0; i < SMMU_STATS_CACHES; i++) {
+		u32 hit = smmu_read(smmu, SMMU_STATS_CACHE_COUNT(0, i, 0));
+		u32 miss = smmu_read(smmu, SMMU_STATS_CACHE_COUNT(0, i, 1));
+
+		smp->hit[i] = hit - ring->last_hit[i];
+		smp->miss[i] = miss - ring->last_miss[i];
+		ring->last_hit[i] = hit;
+		ring->last_miss[i] = miss;
+	}
+
+	smmu_stats_snapshot(smmu, now);
+	for (i = 0; i < smmu->num_as; i++) {
+		struct smmu_as_stats *last = &ring->last_as[i];
+
+		smp->as[i].map_pages = now[i].map_pages - last->map_pages;
+		smp->as[i].unmap_pages = now[i].unmap_pages -
+			last->unmap_pages;
+		smp->as[i].tlb_flushes = now[i].tlb_flushes -
+			last->tlb_flushes;
+		*last = now[i];
+	}
+
+	ring->head = (ring->head + 1) % SMMU_STATS_SAMPLES;
+	if (ring->count < SMMU_STATS_SAMPLES)
+		ring->count++;
+}
+
+static void smmu_stats_work_func(struct work_struct *work)
+{
+	struct smmu_device *smmu = container_of(to_delayed_work(work),
+						struct smmu_device, stats.work);
+	struct smmu_stats_ring *ring = &smmu->stats;
+
+	mutex_lock(&ring->lock);
+	if (ring->sample_ms) {
+		smmu_stats_sample(smmu);
+		queue_delayed_work(system_freezable_wq, &ring->work,
+				   msecs_to_jiffies(ring->sample_ms));
+	}
+	mutex_unlock(&ring->lock);
+}
+
+static void smmu_stats_start(struct smmu_device *smmu)
+{
+	struct smmu_stats_ring *ring = &smmu->stats;
+	int i;
+
+	/* counting has to be on for there to be anything to sample */
+	for (i = 0; i < SMMU_STATS_CACHES; i++) {
+		size_t offs = SMMU_CACHE_CONFIG(i);
+		u32 val = smmu_read(smmu, offs);
+
+		val |= SMMU_CACHE_CONFIG_STATS_ENABLE;
+		val &= ~SMMU_CACHE_CONFIG_STATS_TEST;
+		smmu_write(smmu, val, offs);
+
+		ring->last_hit[i] = smmu_read(smmu,
+					      SMMU_STATS_CACHE_COUNT(0, i, 0));
+		ring->last_miss[i] = smmu_read(smmu,
+					       SMMU_STATS_CACHE_COUNT(0, i, 1));
+	}
+	smmu_stats_snapshot(smmu, ring->last_as);
+	ring->head = 0;
+	ring->count = 0;
+	queue_delayed_work(system_freezable_wq, &ring->work,
+			   msecs_to_jiffies(ring->sample_ms));
+}
+
+static int smmu_debugfs_sample_ms_get(void *data, u64 *val)
+{
+	struct smmu_device *smmu = data;
+
+	*val = smmu->stats.sample_ms;
+	return 0;
+}
+
+static int smmu_debugfs_sample_ms_set(void *data, u64 val)
+{
+	struct smmu_device *smmu = data;
+	struct smmu_stats_ring *ring = &smmu->stats;
+
+	if (val > MSEC_PER_SEC * 60)
+		return -EINVAL;
+
+	cancel_delayed_work_sync(&ring->work);
+	mutex_lock(&ring->lock);
+	ring->sample_ms = val;
+	if (ring->sample_ms)
+		smmu_stats_start(smmu);
+	mutex_unlock(&ring->lock);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(smmu_debugfs_sample_ms_fops,
+			smmu_debugfs_sample_ms_get,
+			smmu_debugfs_sample_ms_set, "%llu\n");
+
+/* hits in percent of lookups, or 100 with no lookups */
+static unsigned int smmu_hit_pct(u32 hit, u32 miss)
+{
+	u64 total = (u64)hit + miss;
+
+	return total ? div_u64((u64)hit * 100, total) : 100;
+}
+
+static int smmu_debugfs_samples_show(struct seq_file *s, void *v)
+{
+	struct smmu_device *smmu = s->private;
+	struct smmu_stats_ring *ring = &smmu->stats;
+	unsigned int i, n;
+	int j;
+
+	seq_printf(s, "%10s %10s %10s %4s %10s %10s %4s", "ms",
+		   "tlb_hit", "tlb_miss", "tlb%", "ptc_hit", "ptc_miss",
+		   "ptc%");
+	for (j = 0; j < smmu->num_as; j++)
+		seq_printf(s, "  as%d:map/unmap/tlbfl", j);
+	seq_printf(s, "\n");
+
+	mutex_lock(&ring->lock);
+	n = (ring->head + SMMU_STATS_SAMPLES - ring->count) %
+		SMMU_STATS_SAMPLES;
+	for (i = 0; i < ring->count; i++) {
+		struct smmu_stats_sample *smp = &ring->sample[n];
+
+		seq_printf(s, "%10u %10u %10u %4u %10u %10u %4u", smp->ms,
+			   smp->hit[0], smp->miss[0],
+			   smmu_hit_pct(smp->hit[0], smp->miss[0]),
+			   smp->hit[1], smp->miss[1],
+			   smmu_hit_pct(smp->hit[1], smp->miss[1]));
+		for (j = 0; j < smmu->num_as; j++)
+			seq_printf(s, "  %6u/%6u/%6u", smp->as[j].map_pages,
+				   smp->as[j].unmap_pages,
+				   smp->as[j].tlb_flushes);
+		seq_printf(s, "\n");
+		n = (n + 1) % SMMU_STATS_SAMPLES;
+	}
+	mutex_unlock(&ring->lock);
+	return 0;
+}
+
+static int smmu_debugfs_samples_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, smmu_debugfs_samples_show, inode->i_private);
+}
+
+static const struct file_operations smmu_debugfs_samples_fops = {
+	.open		= smmu_debugfs_samples_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int smmu_debugfs_asids_show(struct seq_file *s, void *v)
+{
+	struct smmu_device *smmu = s->private;
+	struct smmu_as_stats stats[SMMU_NUM_ASIDS];
+	int i;
+
+	smmu_stats_snapshot(smmu, stats);
+
+	seq_printf(s, "%4s %12s %12s %8s %10s %10s  %s\n", "asid",
+		   "map_pages", "unmap_pages", "sections", "ptc_flush",
+		   "tlb_flush", "swgroups");
+	for (i = 0; i < smmu->num_as; i++) {
+		struct smmu_as *as = &smmu->as[i];
+		struct smmu_client *c;
+		unsigned long hwgrp;
+		int grp;
+
+		seq_printf(s, "%4d %12llu %12llu %8u %10u %10u ", as->asid,
+			   stats[i].map_pages, stats[i].unmap_pages,
+			   stats[i].sections, stats[i].ptc_flushes,
+			   stats[i].tlb_flushes);
+
+		spin_lock(&as->client_lock);
+		list_for_each_entry(c, &as->client, list) {
+			hwgrp = c->hwgrp;
+			for_each_set_bit(grp, &hwgrp, HWGRP_COUNT)
+				seq_printf(s, " %s", smmu_hwgrp_name[grp]);
+			seq_printf(s, "(%s)", dev_name(c->dev));
+		}
+		spin_unlock(&as->client_lock);
+		seq_printf(s, "\n");
+	}
+	return 0;
+}
+
+static int smmu_debugfs_asids_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, smmu_debugfs_asids_show, inode->i_private);
+}
+
+static const struct file_operations smmu_debugfs_asids_fops = {
+	.open		= smmu_debugfs_asids_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void smmu_debugfs_delete(struct smmu_device *smmu)
 {
+	smmu->stats.sample_ms = 0;
+	cancel_delayed_work_sync(&smmu->stats.work);
 	debugfs_remove_recursive(smmu->debugfs_root);
 	kfree(smmu->debugfs_info);
 }
@@ -1140,6 +1712,9 @@ static void smmu_debugfs_create(struct smmu_device *smmu)
 	size_t bytes;
 	struct dentry *root;
 
+	mutex_init(&smmu->stats.lock);
+	INIT_DELAYED_WORK(&smmu->stats.work, smmu_stats_work_func);
+
 	bytes = ARRAY_SIZE(smmu_debugfs_mc) * ARRAY_SIZE(smmu_debugfs_cache) *
 		sizeof(*smmu->debugfs_info);
 	smmu->debugfs_info = kmalloc(bytes, GFP_KERNEL);
@@ -1178,6 +1753,16 @@ static void smmu_debugfs_create(struct smmu_device *smmu)
 		}
 	}
 
+	if (!debugfs_create_file("asids", S_IRUSR, root, smmu,
+				 &smmu_debugfs_asids_fops))
+		goto err_out;
+	if (!debugfs_create_file("samples", S_IRUSR, root, smmu,
+				 &smmu_debugfs_samples_fops))
+		goto err_out;
+	if (!debugfs_create_file("sample_ms", S_IWUSR | S_IRUSR, root, smmu,
+				 &smmu_debugfs_sample_ms_fops))
+		goto err_out;
+
 	return;
 
 err_out:
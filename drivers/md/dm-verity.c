@@ -12,12 +12,17 @@
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
  * access behavior.
+ *
+ * Data blocks are hashed through the asynchronous hash interface when a
+ * distinct (usually hardware) implementation of the algorithm is available;
+ * each block, including the salt, is then passed as one scatterlist.
  */
 
 #include "dm-bufio.h"
 
 #include <linux/module.h>
 #include <linux/device-mapper.h>
+#include <linux/scatterlist.h>
 #include <crypto/hash.h>
 
 #define DM_MSG_PREFIX			"verity"
@@ -28,6 +33,9 @@
 
 #define DM_VERITY_MAX_LEVELS		63
 
+/* salt before and after the data plus one entry per sector of a page */
+#define DM_VERITY_AHASH_SG		((PAGE_SIZE >> SECTOR_SHIFT) + 2)
+
 static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, S_IRUGO | S_IWUSR);
@@ -39,6 +47,7 @@ struct dm_verity {
 	struct dm_bufio_client *bufio;
 	char *alg_name;
 	struct crypto_shash *tfm;
+	struct crypto_ahash *ahash;	/* offloaded data block hashing */
 	u8 *root_digest;	/* digest of the root block */
 	u8 *salt;		/* salt: its size is salt_size */
 	unsigned salt_size;
@@ -273,21 +282,183 @@ release_ret_r:
 	return r;
 }
 
+/*
+ * Hash one data block starting at io_vec[*vector] + *offset with the
+ * synchronous hash and advance *vector and *offset past it.
+ */
+static int verity_shash_block(struct dm_verity *v, struct dm_verity_io *io,
+			      unsigned *vector, unsigned *offset, u8 *result)
+{
+	struct shash_desc *desc;
+	int r;
+	unsigned todo;
+
+	desc = io_hash_desc(v, io);
+	desc->tfm = v->tfm;
+	desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+	r = crypto_shash_init(desc);
+	if (r < 0) {
+		DMERR("crypto_shash_init failed: %d", r);
+		return r;
+	}
+
+	if (likely(v->version >= 1)) {
+		r = crypto_shash_update(desc, v->salt, v->salt_size);
+		if (r < 0) {
+			DMERR("crypto_shash_update failed: %d", r);
+			return r;
+		}
+	}
+
+	todo = 1 << v->data_dev_block_bits;
+	do {
+		struct bio_vec *bv;
+		u8 *page;
+		unsigned len;
+
+		BUG_ON(*vector >= io->io_vec_size);
+		bv = &io->io_vec[*vector];
+		page = kmap_atomic(bv->bv_page);
+		len = bv->bv_len - *offset;
+		if (likely(len >= todo))
+			len = todo;
+		r = crypto_shash_update(desc,
+				page + bv->bv_offset + *offset, len);
+		kunmap_atomic(page);
+		if (r < 0) {
+			DMERR("crypto_shash_update failed: %d", r);
+			return r;
+		}
+		*offset += len;
+		if (likely(*offset == bv->bv_len)) {
+			*offset = 0;
+			(*vector)++;
+		}
+		todo -= len;
+	} while (todo);
+
+	if (!v->version) {
+		r = crypto_shash_update(desc, v->salt, v->salt_size);
+		if (r < 0) {
+			DMERR("crypto_shash_update failed: %d", r);
+			return r;
+		}
+	}
+
+	r = crypto_shash_final(desc, result);
+	if (r < 0)
+		DMERR("crypto_shash_final failed: %d", r);
+
+	return r;
+}
+
+struct verity_ahash_result {
+	struct completion completion;
+	int err;
+};
+
+static void verity_ahash_done(struct crypto_async_request *req, int err)
+{
+	struct verity_ahash_result *res = req->data;
+
+	if (err == -EINPROGRESS)
+		return;
+
+	res->err = err;
+	complete(&res->completion);
+}
+
+/*
+ * Same as verity_shash_block() but the salt and the block are described by
+ * a single scatterlist so that the whole block is one digest request.
+ * Returns -EAGAIN without consuming anything if the block is split into
+ * more pieces than the scatterlist can hold.
+ */
+static int verity_ahash_block(struct dm_verity *v, struct dm_verity_io *io,
+			      struct ahash_request *req, unsigned *vector,
+			      unsigned *offset, u8 *result)
+{
+	struct scatterlist sg[DM_VERITY_AHASH_SG];
+	struct verity_ahash_result res;
+	unsigned vec = *vector, off = *offset;
+	unsigned nents = 0;
+	unsigned todo;
+	int r;
+
+	sg_init_table(sg, DM_VERITY_AHASH_SG);
+
+	if (likely(v->version >= 1) && v->salt_size)
+		sg_set_buf(&sg[nents++], v->salt, v->salt_size);
+
+	todo = 1 << v->data_dev_block_bits;
+	do {
+		struct bio_vec *bv;
+		unsigned len;
+
+		if (unlikely(nents >= DM_VERITY_AHASH_SG - 1))
+			return -EAGAIN;
+
+		BUG_ON(vec >= io->io_vec_size);
+		bv = &io->io_vec[vec];
+		len = bv->bv_len - off;
+		if (likely(len >= todo))
+			len = todo;
+		sg_set_page(&sg[nents++], bv->bv_page, len,
+			    bv->bv_offset + off);
+		off += len;
+		if (likely(off == bv->bv_len)) {
+			off = 0;
+			vec++;
+		}
+		todo -= len;
+	} while (todo);
+
+	if (!v->version && v->salt_size)
+		sg_set_buf(&sg[nents++], v->salt, v->salt_size);
+
+	sg_mark_end(&sg[nents - 1]);
+
+	init_completion(&res.completion);
+	ahash_request_set_callback(req, CRYPTO_TFM_REQ_MAY_SLEEP |
+				   CRYPTO_TFM_REQ_MAY_BACKLOG,
+				   verity_ahash_done, &res);
+	ahash_request_set_crypt(req, sg, result,
+				(1 << v->data_dev_block_bits) + v->salt_size);
+
+	r = crypto_ahash_digest(req);
+	if (r == -EINPROGRESS || r == -EBUSY) {
+		wait_for_completion(&res.completion);
+		r = res.err;
+	}
+	if (r < 0) {
+		DMERR("crypto_ahash_digest failed: %d", r);
+		return r;
+	}
+
+	*vector = vec;
+	*offset = off;
+
+	return 0;
+}
+
 /*
  * Verify one "dm_verity_io" structure.
  */
 static int verity_verify_io(struct dm_verity_io *io)
 {
 	struct dm_verity *v = io->v;
+	struct ahash_request *req = NULL;
 	unsigned b;
 	int i;
 	unsigned vector = 0, offset = 0;
+	int r = 0;
+
+	/* without a request the shash path below still works */
+	if (v->ahash)
+		req = ahash_request_alloc(v->ahash, GFP_NOIO);
 
 	for (b = 0; b < io->n_blocks; b++) {
-		struct shash_desc *desc;
 		u8 *result;
-		int r;
-		unsigned todo;
 
 		if (likely(v->levels)) {
 			/*
@@ -297,91 +468,48 @@ static int verity_verify_io(struct dm_verity_io *io)
 			 * function returns 0 and we fall back to whole
 			 * chain verification.
 			 */
-			int r = verity_verify_level(io, io->block + b, 0, true);
+			r = verity_verify_level(io, io->block + b, 0, true);
 			if (likely(!r))
 				goto test_block_hash;
 			if (r < 0)
-				return r;
+				goto out;
 		}
 
 		memcpy(io_want_digest(v, io), v->root_digest, v->digest_size);
 
 		for (i = v->levels - 1; i >= 0; i--) {
-			int r = verity_verify_level(io, io->block + b, i, false);
+			r = verity_verify_level(io, io->block + b, i, false);
 			if (unlikely(r))
-				return r;
+				goto out;
 		}
 
 test_block_hash:
-		desc = io_hash_desc(v, io);
-		desc->tfm = v->tfm;
-		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
-		r = crypto_shash_init(desc);
-		if (r < 0) {
-			DMERR("crypto_shash_init failed: %d", r);
-			return r;
-		}
-
-		if (likely(v->version >= 1)) {
-			r = crypto_shash_update(desc, v->salt, v->salt_size);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				return r;
-			}
-		}
-
-		todo = 1 << v->data_dev_block_bits;
-		do {
-			struct bio_vec *bv;
-			u8 *page;
-			unsigned len;
-
-			BUG_ON(vector >= io->io_vec_size);
-			bv = &io->io_vec[vector];
-			page = kmap_atomic(bv->bv_page);
-			len = bv->bv_len - offset;
-			if (likely(len >= todo))
-				len = todo;
-			r = crypto_shash_update(desc,
-					page + bv->bv_offset + offset, len);
-			kunmap_atomic(page);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				return r;
-			}
-			offset += len;
-			if (likely(offset == bv->bv_len)) {
-				offset = 0;
-				vector++;
-			}
-			todo -= len;
-		} while (todo);
-
-		if (!v->version) {
-			r = crypto_shash_update(desc, v->salt, v->salt_size);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				return r;
-			}
-		}
-
 		result = io_real_digest(v, io);
-		r = crypto_shash_final(desc, result);
-		if (r < 0) {
-			DMERR("crypto_shash_final failed: %d", r);
-			return r;
-		}
+		r = -EAGAIN;
+		if (req)
+			r = verity_ahash_block(v, io, req, &vector, &offset,
+					       result);
+		if (r == -EAGAIN)
+			r = verity_shash_block(v, io, &vector, &offset, result);
+		if (r < 0)
+			goto out;
+
 		if (unlikely(memcmp(result, io_want_digest(v, io), v->digest_size))) {
 			DMERR_LIMIT("data block %llu is corrupted",
 				(unsigned long long)(io->block + b));
 			v->hash_failed = 1;
-			return -EIO;
+			r = -EIO;
+			goto out;
 		}
 	}
 	BUG_ON(vector != io->io_vec_size);
 	BUG_ON(offset);
 
-	return 0;
+out:
+	if (req)
+		ahash_request_free(req);
+
+	return r;
 }
 
 /*
@@ -619,6 +747,9 @@ static void verity_dtr(struct dm_target *ti)
 	kfree(v->salt);
 	kfree(v->root_digest);
 
+	if (v->ahash)
+		crypto_free_ahash(v->ahash);
+
 	if (v->tfm)
 		crypto_free_shash(v->tfm);
 
@@ -764,6 +895,20 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	v->shash_descsize =
 		sizeof(struct shash_desc) + crypto_shash_descsize(v->tfm);
 
+	/*
+	 * Only use the asynchronous interface if it resolves to a different
+	 * implementation; wrapping the same shash would just add overhead.
+	 */
+	v->ahash = crypto_alloc_ahash(v->alg_name, 0, 0);
+	if (IS_ERR(v->ahash) ||
+	    crypto_ahash_digestsize(v->ahash) != v->digest_size ||
+	    !strcmp(crypto_tfm_alg_driver_name(crypto_ahash_tfm(v->ahash)),
+		    crypto_tfm_alg_driver_name(crypto_shash_tfm(v->tfm)))) {
+		if (!IS_ERR(v->ahash))
+			crypto_free_ahash(v->ahash);
+		v->ahash = NULL;
+	}
+
 	v->root_digest = kmalloc(v->digest_size, GFP_KERNEL);
 	if (!v->root_digest) {
 		ti->error = "Cannot allocate root digest";
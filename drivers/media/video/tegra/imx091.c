@@ -23,6 +23,7 @@
 #include <linux/list.h>
 #include <linux/edp.h>
 #include <media/imx091.h>
+#include <video/tegra_camera.h>
 
 #define IMX091_ID			0x0091
 #define IMX091_ID_ADDRESS   0x0000
@@ -1630,6 +1631,7 @@ static int imx091_pm_wr(struct imx091_info *info, int pwr)
 		info->mode_valid = false;
 		info->bin_en = 0;
 		imx091_edp_lowest(info);
+		tegra_camera_set_sensor_mode(0, 0, 0);
 		break;
 
 	case NVC_PWR_STDBY:
@@ -1842,8 +1844,14 @@ static int imx091_mode_wr_full(struct imx091_info *info, u32 mode_index)
 	err = imx091_i2c_wr_table(info,
 				  imx091_mode_table[mode_index]->p_mode_i2c);
 	if (!err) {
+		struct nvc_imager_mode *sm =
+			&imx091_mode_table[mode_index]->sensor_mode;
+
 		info->mode_index = mode_index;
 		info->mode_valid = true;
+		/* scale the camera EMC floor to this mode */
+		tegra_camera_set_sensor_mode(sm->res_x, sm->res_y,
+					     sm->peak_frame_rate);
 	} else {
 		info->mode_valid = false;
 	}
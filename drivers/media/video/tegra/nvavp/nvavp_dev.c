@@ -12,6 +12,7 @@
 #include <linux/clk.h>
 #include <linux/completion.h>
 #include <linux/delay.h>
+#include <linux/devfreq.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/firmware.h>
@@ -21,12 +22,15 @@
 #include <linux/ioctl.h>
 #include <linux/irq.h>
 #include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/math64.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/nvhost.h>
 #include <linux/platform_device.h>
+#include <linux/poll.h>
 #include <linux/rbtree.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
@@ -90,6 +94,11 @@
 
 #define SCLK_BOOST_RATE		40000000
 
+/* VDE clock scaling on decode load */
+#define NVAVP_SCALE_POLL_MS		50
+#define NVAVP_SCALE_UPTHRESHOLD		90
+#define NVAVP_SCALE_DOWNDIFFERENTIAL	15
+
 static bool boost_sclk;
 
 struct nvavp_channel {
@@ -118,6 +127,27 @@ struct nvavp_info {
 	unsigned long			sclk_rate;
 	unsigned long			emc_clk_rate;
 
+	/*
+	 * Decode load: the VDE is busy from the first submit until the AVP
+	 * reports the video channel idle. devfreq polls the busy fraction
+	 * and scales vde (bsev runs off the same clock) and sclk with it.
+	 */
+	struct devfreq			*devfreq;
+	struct devfreq_dev_profile	devfreq_profile;
+#ifdef CONFIG_DEVFREQ_GOV_SIMPLE_ONDEMAND
+	struct devfreq_simple_ondemand_data ondemand_data;
+#endif
+	spinlock_t			load_lock;
+	bool				busy;
+	ktime_t				last_event;
+	u64				busy_us;
+	u64				total_us;
+	unsigned long			vde_min_rate;
+	unsigned long			vde_max_rate;
+	unsigned long			vde_rate;
+	unsigned long			sclk_max_rate;
+	unsigned long			sclk_scaled_rate;
+
 	int				mbox_from_avp_pend_irq;
 
 	struct mutex			open_lock;
@@ -126,6 +156,11 @@ struct nvavp_info {
 #if defined(CONFIG_TEGRA_NVAVP_AUDIO)
 	int				audio_initialized;
 	struct work_struct		app_notify_work;
+
+	/* audio events, for clients sleeping until the AVP needs them */
+	spinlock_t			audio_events_lock;
+	struct nvavp_audio_events	audio_events;
+	wait_queue_head_t		audio_events_wq;
 #endif
 	struct work_struct		clock_disable_work;
 
@@ -161,6 +196,9 @@ struct nvavp_clientctx {
 	struct nvavp_info *nvavp;
 	int channel_id;
 	u32 clk_reqs;
+#if defined(CONFIG_TEGRA_NVAVP_AUDIO)
+	struct nvavp_audio_events audio_events_seen;
+#endif
 };
 
 #if defined(CONFIG_TEGRA_NVAVP_AUDIO)
@@ -298,6 +336,12 @@ static int nvavp_unpowergate_vde(struct nvavp_info *nvavp)
 	return ret;
 }
 
+/* the rate user space asked for, capped by what the decode load needs */
+static unsigned long nvavp_sclk_rate(struct nvavp_info *nvavp)
+{
+	return min(nvavp->sclk_rate, nvavp->sclk_scaled_rate);
+}
+
 static void nvavp_clks_enable(struct nvavp_info *nvavp)
 {
 	if (nvavp->clk_enabled++ == 0) {
@@ -306,9 +350,9 @@ static void nvavp_clks_enable(struct nvavp_info *nvavp)
 		clk_prepare_enable(nvavp->vde_clk);
 		nvavp_unpowergate_vde(nvavp);
 		clk_set_rate(nvavp->emc_clk, nvavp->emc_clk_rate);
-		clk_set_rate(nvavp->sclk, nvavp->sclk_rate);
+		clk_set_rate(nvavp->sclk, nvavp_sclk_rate(nvavp));
 		dev_dbg(&nvavp->nvhost_dev->dev, "%s: setting sclk to %lu\n",
-				__func__, nvavp->sclk_rate);
+				__func__, nvavp_sclk_rate(nvavp));
 		dev_dbg(&nvavp->nvhost_dev->dev, "%s: setting emc_clk to %lu\n",
 				__func__, nvavp->emc_clk_rate);
 	}
@@ -331,6 +375,128 @@ static void nvavp_clks_disable(struct nvavp_info *nvavp)
 	}
 }
 
+/* fold the time since the last event into the busy/total counters */
+static void nvavp_scale_account_locked(struct nvavp_info *nvavp)
+{
+	ktime_t now = ktime_get();
+	s64 delta = ktime_us_delta(now, nvavp->last_event);
+
+	if (delta > 0) {
+		nvavp->total_us += delta;
+		if (nvavp->busy)
+			nvavp->busy_us += delta;
+	}
+	nvavp->last_event = now;
+}
+
+static void nvavp_scale_notify(struct nvavp_info *nvavp, bool busy)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&nvavp->load_lock, flags);
+	if (nvavp->busy != busy) {
+		nvavp_scale_account_locked(nvavp);
+		nvavp->busy = busy;
+	}
+	spin_unlock_irqrestore(&nvavp->load_lock, flags);
+}
+
+static int nvavp_scale_target(struct device *dev, unsigned long *freq,
+			      u32 flags)
+{
+	struct nvavp_info *nvavp = dev_get_drvdata(dev);
+	unsigned long rate;
+
+	rate = clamp(*freq, nvavp->vde_min_rate, nvavp->vde_max_rate);
+
+	mutex_lock(&nvavp->open_lock);
+	clk_set_rate(nvavp->vde_clk, rate);
+	nvavp->vde_rate = clk_get_rate(nvavp->vde_clk);
+	nvavp->sclk_scaled_rate = div64_u64((u64)nvavp->sclk_max_rate *
+				nvavp->vde_rate, nvavp->vde_max_rate);
+	if (nvavp->clk_enabled)
+		clk_set_rate(nvavp->sclk, nvavp_sclk_rate(nvavp));
+	mutex_unlock(&nvavp->open_lock);
+
+	*freq = nvavp->vde_rate;
+	return 0;
+}
+
+static int nvavp_scale_get_dev_status(struct device *dev,
+				      struct devfreq_dev_status *stat)
+{
+	struct nvavp_info *nvavp = dev_get_drvdata(dev);
+	unsigned long flags;
+
+	spin_lock_irqsave(&nvavp->load_lock, flags);
+	nvavp_scale_account_locked(nvavp);
+	stat->busy_time = min_t(u64, nvavp->busy_us, ULONG_MAX);
+	stat->total_time = min_t(u64, nvavp->total_us, ULONG_MAX);
+	nvavp->busy_us = 0;
+	nvavp->total_us = 0;
+	spin_unlock_irqrestore(&nvavp->load_lock, flags);
+
+	stat->current_frequency = nvavp->vde_rate;
+	stat->private_data = NULL;
+	return 0;
+}
+
+/*
+ * Scale the VDE so that decoding a frame takes about NVAVP_SCALE_UPTHRESHOLD
+ * percent of the frame interval: just in time for its deadline, without
+ * running a 480p stream at the clocks a 4K one needs.
+ */
+static void nvavp_scale_init(struct nvavp_info *nvavp)
+{
+	struct platform_device *ndev = nvavp->nvhost_dev;
+	struct devfreq *df;
+	void *gov_data = NULL;
+	long max_rate, min_rate;
+
+	max_rate = clk_round_rate(nvavp->vde_clk, ULONG_MAX);
+	min_rate = clk_round_rate(nvavp->vde_clk, 0);
+	if (max_rate <= 0 || min_rate <= 0 || max_rate <= min_rate) {
+		dev_info(&ndev->dev, "vde scaling disabled: no rate range\n");
+		return;
+	}
+	nvavp->vde_max_rate = max_rate;
+	nvavp->vde_min_rate = min_rate;
+	nvavp->vde_rate = max_rate;
+
+	max_rate = clk_round_rate(nvavp->sclk, ULONG_MAX);
+	nvavp->sclk_max_rate = max_rate > 0 ? max_rate : ULONG_MAX;
+
+	nvavp->last_event = ktime_get();
+
+	nvavp->devfreq_profile.initial_freq = nvavp->vde_max_rate;
+	nvavp->devfreq_profile.polling_ms = NVAVP_SCALE_POLL_MS;
+	nvavp->devfreq_profile.target = nvavp_scale_target;
+	nvavp->devfreq_profile.get_dev_status = nvavp_scale_get_dev_status;
+
+#ifdef CONFIG_DEVFREQ_GOV_SIMPLE_ONDEMAND
+	nvavp->ondemand_data.upthreshold = NVAVP_SCALE_UPTHRESHOLD;
+	nvavp->ondemand_data.downdifferential = NVAVP_SCALE_DOWNDIFFERENTIAL;
+	gov_data = &nvavp->ondemand_data;
+#endif
+
+	df = devfreq_add_device(&ndev->dev, &nvavp->devfreq_profile,
+				devfreq_simple_ondemand, gov_data);
+	if (IS_ERR_OR_NULL(df))
+		return;
+	nvavp->devfreq = df;
+}
+
+static void nvavp_scale_deinit(struct nvavp_info *nvavp)
+{
+	if (!nvavp->devfreq)
+		return;
+
+	devfreq_remove_device(nvavp->devfreq);
+	nvavp->devfreq = NULL;
+	nvavp->vde_rate = ULONG_MAX;
+	nvavp->sclk_scaled_rate = ULONG_MAX;
+}
+
 static u32 nvavp_check_idle(struct nvavp_info *nvavp, int channel_id)
 {
 	struct nvavp_channel *channel_info = nvavp_get_channel_info(nvavp, channel_id);
@@ -364,6 +530,7 @@ static void clock_disable_handler(struct work_struct *work)
 	mutex_lock(&nvavp->open_lock);
 	if (nvavp_check_idle(nvavp, NVAVP_VIDEO_CHANNEL) && nvavp->pending) {
 		nvavp->pending = false;
+		nvavp_scale_notify(nvavp, false);
 		nvavp_clks_disable(nvavp);
 	}
 	mutex_unlock(&nvavp->open_lock);
@@ -384,8 +551,13 @@ static int nvavp_service(struct nvavp_info *nvavp)
 		schedule_work(&nvavp->clock_disable_work);
 
 #if defined(CONFIG_TEGRA_NVAVP_AUDIO)
-	if (inbox & NVE276_OS_INTERRUPT_AUDIO_IDLE)
+	if (inbox & NVE276_OS_INTERRUPT_AUDIO_IDLE) {
 		pr_debug("nvavp_service NVE276_OS_INTERRUPT_AUDIO_IDLE\n");
+		spin_lock(&nvavp->audio_events_lock);
+		nvavp->audio_events.audio_idle++;
+		spin_unlock(&nvavp->audio_events_lock);
+		wake_up_interruptible(&nvavp->audio_events_wq);
+	}
 #endif
 	if (inbox & NVE276_OS_INTERRUPT_DEBUG_STRING) {
 		/* Should only occur with debug AVP OS builds */
@@ -411,6 +583,10 @@ static int nvavp_service(struct nvavp_info *nvavp)
 #if defined(CONFIG_TEGRA_NVAVP_AUDIO)
 	if (inbox & NVE276_OS_INTERRUPT_APP_NOTIFY) {
 		pr_debug("nvavp_service NVE276_OS_INTERRUPT_APP_NOTIFY\n");
+		spin_lock(&nvavp->audio_events_lock);
+		nvavp->audio_events.app_notify++;
+		spin_unlock(&nvavp->audio_events_lock);
+		wake_up_interruptible(&nvavp->audio_events_wq);
 		schedule_work(&nvavp->app_notify_work);
 	}
 #endif
@@ -487,6 +663,7 @@ static void nvavp_halt_vde(struct nvavp_info *nvavp)
 	if (nvavp->pending) {
 		nvavp_clks_disable(nvavp);
 		nvavp->pending = false;
+		nvavp_scale_notify(nvavp, false);
 	}
 
 	tegra_periph_reset_assert(nvavp->bsev_clk);
@@ -509,11 +686,11 @@ static int nvavp_reset_vde(struct nvavp_info *nvavp)
 	tegra_periph_reset_deassert(nvavp->vde_clk);
 
 	/*
-	 * VDE clock is set to max freq by default.
-	 * VDE clock can be set to different freq if needed
-	 * through ioctl.
+	 * VDE clock is set to max freq by default, or to the rate the
+	 * decode load scaling last picked. VDE clock can be set to
+	 * different freq if needed through ioctl.
 	 */
-	clk_set_rate(nvavp->vde_clk, ULONG_MAX);
+	clk_set_rate(nvavp->vde_clk, nvavp->vde_rate);
 
 	nvavp_clks_disable(nvavp);
 
@@ -580,21 +757,29 @@ static void nvavp_pushbuffer_free(struct nvavp_info *nvavp)
 				nvavp->channel_info[channel_id].pushbuf_data);
 			nvmap_free(nvavp->nvmap,
 				nvavp->channel_info[channel_id].pushbuf_handle);
+			nvavp->channel_info[channel_id].pushbuf_data = NULL;
 		}
 	}
 }
 
 
+/*
+ * The push buffers stay allocated and pinned from the first init until the
+ * driver is removed, so that restarting the AVP after suspend or after the
+ * last client closed only has to reset the channel control areas.
+ */
 static int nvavp_pushbuffer_init(struct nvavp_info *nvavp)
 {
 	int ret, channel_id;
 
 	for (channel_id = 0; channel_id < NVAVP_NUM_CHANNELS; channel_id++) {
-		ret = nvavp_pushbuffer_alloc(nvavp, channel_id);
-		if (ret) {
-			dev_err(&nvavp->nvhost_dev->dev,
-				"unable to alloc pushbuffer\n");
-			return ret;
+		if (!nvavp->channel_info[channel_id].pushbuf_data) {
+			ret = nvavp_pushbuffer_alloc(nvavp, channel_id);
+			if (ret) {
+				dev_err(&nvavp->nvhost_dev->dev,
+					"unable to alloc pushbuffer\n");
+				return ret;
+			}
 		}
 		nvavp_set_channel_control_area(nvavp, channel_id);
 		if (IS_VIDEO_CHANNEL_ID(channel_id)) {
@@ -612,29 +797,18 @@ static void nvavp_pushbuffer_deinit(struct nvavp_info *nvavp)
 	nvavp_pushbuffer_free(nvavp);
 }
 
-static int nvavp_pushbuffer_update(struct nvavp_info *nvavp, u32 phys_addr,
-			u32 gather_count, struct nvavp_syncpt *syncpt,
-			u32 ext_ucode_flag, int channel_id)
+/*
+ * Write one submit's commands at pushbuf_index + wordcount and return the
+ * new wordcount; the AVP does not see them until nvavp_pushbuffer_kick().
+ * Called with pushbuffer_lock held.
+ */
+static u32 nvavp_pushbuffer_write(struct nvavp_info *nvavp,
+			struct nvavp_channel *channel_info, u32 wordcount,
+			u32 phys_addr, u32 gather_count,
+			struct nvavp_syncpt *syncpt, u32 ext_ucode_flag)
 {
-	struct nvavp_channel  *channel_info;
-	struct nv_e276_control *control;
 	u32 gather_cmd, setucode_cmd, sync = 0;
-	u32 wordcount = 0;
 	u32 index, value = -1;
-	int ret = 0;
-
-	channel_info = nvavp_get_channel_info(nvavp, channel_id);
-
-	control = channel_info->os_control;
-	pr_debug("nvavp_pushbuffer_update for channel_id (%d):\
-		control->put (0x%x) control->get (0x%x)\n",
-		channel_id, (u32) &control->put, (u32) &control->get);
-
-	mutex_lock(&channel_info->pushbuffer_lock);
-
-	/* check for pushbuffer wrapping */
-	if (channel_info->pushbuf_index >= channel_info->pushbuf_fence)
-		channel_info->pushbuf_index = 0;
 
 	if (!ext_ucode_flag) {
 		setucode_cmd =
@@ -682,13 +856,32 @@ static int nvavp_pushbuffer_update(struct nvavp_info *nvavp, u32 phys_addr,
 		index = wordcount + channel_info->pushbuf_index;
 		writel(sync, (channel_info->pushbuf_data + index));
 		wordcount += sizeof(u32);
+
+		/* Fill out fence struct */
+		syncpt->id = nvavp->syncpt_id;
+		syncpt->value = value;
 	}
 
+	return wordcount;
+}
+
+/*
+ * Publish wordcount bytes written by nvavp_pushbuffer_write() and wake the
+ * AVP. Called with pushbuffer_lock held.
+ */
+static int nvavp_pushbuffer_kick(struct nvavp_info *nvavp,
+			struct nvavp_channel *channel_info, u32 wordcount,
+			int channel_id)
+{
+	struct nv_e276_control *control = channel_info->os_control;
+	int ret = 0;
+
 	/* enable clocks to VDE/BSEV */
 	mutex_lock(&nvavp->open_lock);
 	if (!nvavp->pending && IS_VIDEO_CHANNEL_ID(channel_id)) {
 		nvavp_clks_enable(nvavp);
 		nvavp->pending = true;
+		nvavp_scale_notify(nvavp, true);
 	}
 	mutex_unlock(&nvavp->open_lock);
 
@@ -704,29 +897,96 @@ static int nvavp_pushbuffer_update(struct nvavp_info *nvavp, u32 phys_addr,
 	if (IS_VIDEO_CHANNEL_ID(channel_id)) {
 		pr_debug("Wake up Video Channel\n");
 		ret = nvavp_outbox_write(0xA0000001);
-		if (ret < 0)
-			goto err_exit;
 	}
 	else {
 #if defined(CONFIG_TEGRA_NVAVP_AUDIO)
 		if (IS_AUDIO_CHANNEL_ID(channel_id)) {
 			pr_debug("Wake up Audio Channel\n");
 			ret = nvavp_outbox_write(0xA0000002);
-			if (ret < 0)
-				goto err_exit;
 		}
 #endif
 	}
-	/* Fill out fence struct */
-	if (syncpt) {
-		syncpt->id = nvavp->syncpt_id;
-		syncpt->value = value;
+
+	return ret < 0 ? ret : 0;
+}
+
+static int nvavp_pushbuffer_update(struct nvavp_info *nvavp, u32 phys_addr,
+			u32 gather_count, struct nvavp_syncpt *syncpt,
+			u32 ext_ucode_flag, int channel_id)
+{
+	struct nvavp_channel  *channel_info;
+	struct nv_e276_control *control;
+	u32 wordcount;
+
+	channel_info = nvavp_get_channel_info(nvavp, channel_id);
+
+	control = channel_info->os_control;
+	pr_debug("nvavp_pushbuffer_update for channel_id (%d):\
+		control->put (0x%x) control->get (0x%x)\n",
+		channel_id, (u32) &control->put, (u32) &control->get);
+
+	mutex_lock(&channel_info->pushbuffer_lock);
+
+	/* check for pushbuffer wrapping */
+	if (channel_info->pushbuf_index >= channel_info->pushbuf_fence)
+		channel_info->pushbuf_index = 0;
+
+	wordcount = nvavp_pushbuffer_write(nvavp, channel_info, 0, phys_addr,
+					   gather_count, syncpt,
+					   ext_ucode_flag);
+	nvavp_pushbuffer_kick(nvavp, channel_info, wordcount, channel_id);
+
+	mutex_unlock(&channel_info->pushbuffer_lock);
+
+	return 0;
+}
+
+/*
+ * Like nvavp_pushbuffer_update() for several submits, with a single wake
+ * of the AVP at the end. A batch that runs into the push buffer's wrap
+ * point is kicked up to there first, so put never has to jump backwards
+ * past commands the AVP has not been told about.
+ */
+static int nvavp_pushbuffer_update_multi(struct nvavp_info *nvavp,
+			u32 *phys_addr, struct nvavp_pushbuffer_submit_hdr *hdr,
+			struct nvavp_syncpt *syncpt, int count, int channel_id)
+{
+	struct nvavp_channel *channel_info;
+	u32 wordcount = 0;
+	int ret = 0, i;
+
+	channel_info = nvavp_get_channel_info(nvavp, channel_id);
+
+	mutex_lock(&channel_info->pushbuffer_lock);
+
+	for (i = 0; i < count; i++) {
+		/* check for pushbuffer wrapping */
+		if (channel_info->pushbuf_index + wordcount >=
+		    channel_info->pushbuf_fence) {
+			if (wordcount) {
+				ret = nvavp_pushbuffer_kick(nvavp,
+						channel_info, wordcount,
+						channel_id);
+				if (ret)
+					goto err_exit;
+				wordcount = 0;
+			}
+			channel_info->pushbuf_index = 0;
+		}
+
+		wordcount = nvavp_pushbuffer_write(nvavp, channel_info,
+				wordcount, phys_addr[i], hdr[i].cmdbuf.words,
+				hdr[i].syncpt ? &syncpt[i] : NULL,
+				hdr[i].flags & NVAVP_UCODE_EXT);
 	}
 
+	ret = nvavp_pushbuffer_kick(nvavp, channel_info, wordcount,
+				    channel_id);
+
 err_exit:
 	mutex_unlock(&channel_info->pushbuffer_lock);
 
-	return 0;
+	return ret;
 }
 
 static void nvavp_unload_ucode(struct nvavp_info *nvavp)
@@ -817,7 +1077,12 @@ static int nvavp_load_ucode(struct nvavp_info *nvavp)
 		release_firmware(nvavp_ucode_fw);
 	}
 
-	memcpy(ucode_info->data, ucode_info->ucode_bin, ucode_info->size);
+	/* the VDE only reads the ucode, so one copy lasts until remove */
+	if (!ucode_info->resident) {
+		memcpy(ucode_info->data, ucode_info->ucode_bin,
+		       ucode_info->size);
+		ucode_info->resident = true;
+	}
 	return 0;
 
 err_ucode_pin:
@@ -982,7 +1247,8 @@ static int nvavp_os_init(struct nvavp_info *nvavp)
 		nvavp->os_info.phys);
 	sprintf(fw_os_file, "nvavp_os_%08x.bin", nvavp->os_info.phys);
 	nvavp->os_info.reset_addr = nvavp->os_info.phys;
-	nvavp->os_info.data = ioremap(nvavp->os_info.phys, SZ_1M);
+	if (!nvavp->os_info.data)
+		nvavp->os_info.data = ioremap(nvavp->os_info.phys, SZ_1M);
 #endif
 	ret = nvavp_load_os(nvavp, fw_os_file);
 	if (ret) {
@@ -1088,7 +1354,6 @@ static void nvavp_uninit(struct nvavp_info *nvavp)
 		clk_disable_unprepare(nvavp->sclk);
 		clk_disable_unprepare(nvavp->emc_clk);
 		disable_irq(nvavp->mbox_from_avp_pend_irq);
-		nvavp_pushbuffer_deinit(nvavp);
 		nvavp_halt_avp(nvavp);
 	}
 
@@ -1202,50 +1467,42 @@ static int nvavp_set_nvmapfd_ioctl(struct file *filp, unsigned int cmd,
 	return 0;
 }
 
-static int nvavp_pushbuffer_submit_ioctl(struct file *filp, unsigned int cmd,
-							unsigned long arg)
+/*
+ * Pin the command buffer of a submit into the driver's nvmap context and
+ * patch its relocations; *dupe holds it until nvavp_cmdbuf_release().
+ */
+static int nvavp_cmdbuf_prepare(struct nvavp_clientctx *clientctx,
+				struct nvavp_pushbuffer_submit_hdr *hdr,
+				struct nvmap_handle_ref **dupe,
+				unsigned long *phys)
 {
-	struct nvavp_clientctx *clientctx = filp->private_data;
 	struct nvavp_info *nvavp = clientctx->nvavp;
-	struct nvavp_pushbuffer_submit_hdr hdr;
 	u32 *cmdbuf_data;
 	struct nvmap_handle *cmdbuf_handle = NULL;
 	struct nvmap_handle_ref *cmdbuf_dupe;
 	int ret = 0, i;
 	unsigned long phys_addr;
 	unsigned long virt_addr;
-	struct nvavp_pushbuffer_submit_hdr *user_hdr =
-			(struct nvavp_pushbuffer_submit_hdr *) arg;
-	struct nvavp_syncpt syncpt;
-
-	syncpt.id = NVSYNCPT_INVALID;
-	syncpt.value = 0;
-
-	if (_IOC_DIR(cmd) & _IOC_WRITE) {
-		if (copy_from_user(&hdr, (void __user *)arg,
-			sizeof(struct nvavp_pushbuffer_submit_hdr)))
-			return -EFAULT;
-	}
 
-	if (!hdr.cmdbuf.mem)
-		return 0;
+	if (hdr->num_relocs > NVAVP_MAX_RELOCATION_COUNT)
+		return -EINVAL;
 
-	if (copy_from_user(clientctx->relocs, (void __user *)hdr.relocs,
-			sizeof(struct nvavp_reloc) * hdr.num_relocs)) {
+	if (copy_from_user(clientctx->relocs, (void __user *)hdr->relocs,
+			sizeof(struct nvavp_reloc) * hdr->num_relocs)) {
 		return -EFAULT;
 	}
 
-	cmdbuf_handle = nvmap_get_handle_id(clientctx->nvmap, hdr.cmdbuf.mem);
+	cmdbuf_handle = nvmap_get_handle_id(clientctx->nvmap, hdr->cmdbuf.mem);
 	if (cmdbuf_handle == NULL) {
 		dev_err(&nvavp->nvhost_dev->dev,
-			"invalid cmd buffer handle %08x\n", hdr.cmdbuf.mem);
+			"invalid cmd buffer handle %08x\n", hdr->cmdbuf.mem);
 		return -EPERM;
 	}
 
 	/* duplicate the new pushbuffer's handle into the nvavp driver's
 	 * nvmap context, to ensure that the handle won't be freed as
 	 * long as it is in-use by the fb driver */
-	cmdbuf_dupe = nvmap_duplicate_handle_id(nvavp->nvmap, hdr.cmdbuf.mem);
+	cmdbuf_dupe = nvmap_duplicate_handle_id(nvavp->nvmap, hdr->cmdbuf.mem);
 	nvmap_handle_put(cmdbuf_handle);
 
 	if (IS_ERR(cmdbuf_dupe)) {
@@ -1268,12 +1525,12 @@ static int nvavp_pushbuffer_submit_ioctl(struct file *filp, unsigned int cmd,
 		goto err_cmdbuf_mmap;
 	}
 
-	cmdbuf_data = (u32 *)(virt_addr + hdr.cmdbuf.offset);
+	cmdbuf_data = (u32 *)(virt_addr + hdr->cmdbuf.offset);
 
-	for (i = 0; i < hdr.num_relocs; i++) {
+	for (i = 0; i < hdr->num_relocs; i++) {
 		u32 *reloc_addr, target_phys_addr;
 
-		if (clientctx->relocs[i].cmdbuf_mem != hdr.cmdbuf.mem) {
+		if (clientctx->relocs[i].cmdbuf_mem != hdr->cmdbuf.mem) {
 			dev_err(&nvavp->nvhost_dev->dev,
 				"reloc info does not match target bufferID\n");
 			ret = -EPERM;
@@ -1289,31 +1546,142 @@ static int nvavp_pushbuffer_submit_ioctl(struct file *filp, unsigned int cmd,
 		writel(target_phys_addr, reloc_addr);
 	}
 
+	nvmap_munmap(cmdbuf_dupe, (void *)virt_addr);
+	*dupe = cmdbuf_dupe;
+	*phys = phys_addr + hdr->cmdbuf.offset;
+	return 0;
+
+err_reloc_info:
+	nvmap_munmap(cmdbuf_dupe, (void *)virt_addr);
+err_cmdbuf_mmap:
+	nvmap_unpin(nvavp->nvmap, cmdbuf_dupe);
+	nvmap_free(nvavp->nvmap, cmdbuf_dupe);
+	return ret;
+}
+
+static void nvavp_cmdbuf_release(struct nvavp_info *nvavp,
+				 struct nvmap_handle_ref *cmdbuf_dupe)
+{
+	nvmap_unpin(nvavp->nvmap, cmdbuf_dupe);
+	nvmap_free(nvavp->nvmap, cmdbuf_dupe);
+}
+
+static int nvavp_pushbuffer_submit_ioctl(struct file *filp, unsigned int cmd,
+							unsigned long arg)
+{
+	struct nvavp_clientctx *clientctx = filp->private_data;
+	struct nvavp_info *nvavp = clientctx->nvavp;
+	struct nvavp_pushbuffer_submit_hdr hdr;
+	struct nvmap_handle_ref *cmdbuf_dupe;
+	int ret = 0;
+	unsigned long phys_addr;
+	struct nvavp_pushbuffer_submit_hdr *user_hdr =
+			(struct nvavp_pushbuffer_submit_hdr *) arg;
+	struct nvavp_syncpt syncpt;
+
+	syncpt.id = NVSYNCPT_INVALID;
+	syncpt.value = 0;
+
+	if (_IOC_DIR(cmd) & _IOC_WRITE) {
+		if (copy_from_user(&hdr, (void __user *)arg,
+			sizeof(struct nvavp_pushbuffer_submit_hdr)))
+			return -EFAULT;
+	}
+
+	if (!hdr.cmdbuf.mem)
+		return 0;
+
+	ret = nvavp_cmdbuf_prepare(clientctx, &hdr, &cmdbuf_dupe, &phys_addr);
+	if (ret)
+		return ret;
+
 	if (hdr.syncpt) {
-		ret = nvavp_pushbuffer_update(nvavp,
-					     (phys_addr + hdr.cmdbuf.offset),
+		ret = nvavp_pushbuffer_update(nvavp, phys_addr,
 					      hdr.cmdbuf.words, &syncpt,
 					      (hdr.flags & NVAVP_UCODE_EXT),
 						clientctx->channel_id);
 
 		if (copy_to_user((void __user *)user_hdr->syncpt, &syncpt,
-				sizeof(struct nvavp_syncpt))) {
+				sizeof(struct nvavp_syncpt)))
 			ret = -EFAULT;
-			goto err_reloc_info;
-		}
 	} else {
-		ret = nvavp_pushbuffer_update(nvavp,
-					     (phys_addr + hdr.cmdbuf.offset),
+		ret = nvavp_pushbuffer_update(nvavp, phys_addr,
 					      hdr.cmdbuf.words, NULL,
 					      (hdr.flags & NVAVP_UCODE_EXT),
 						clientctx->channel_id);
 	}
 
-err_reloc_info:
-	nvmap_munmap(cmdbuf_dupe, (void *)virt_addr);
-err_cmdbuf_mmap:
-	nvmap_unpin(nvavp->nvmap, cmdbuf_dupe);
-	nvmap_free(nvavp->nvmap, cmdbuf_dupe);
+	nvavp_cmdbuf_release(nvavp, cmdbuf_dupe);
+	return ret;
+}
+
+struct nvavp_submit_multi {
+	struct nvavp_pushbuffer_submit_hdr hdr[NVAVP_MAX_MULTI_SUBMITS];
+	struct nvavp_syncpt syncpt[NVAVP_MAX_MULTI_SUBMITS];
+	struct nvmap_handle_ref *dupe[NVAVP_MAX_MULTI_SUBMITS];
+	u32 phys[NVAVP_MAX_MULTI_SUBMITS];
+};
+
+static int nvavp_pushbuffer_submit_multi_ioctl(struct file *filp,
+				unsigned int cmd, unsigned long arg)
+{
+	struct nvavp_clientctx *clientctx = filp->private_data;
+	struct nvavp_info *nvavp = clientctx->nvavp;
+	struct nvavp_pushbuffer_submit_multi_hdr multi;
+	struct nvavp_submit_multi *m;
+	unsigned long phys_addr;
+	int ret = 0, i, n;
+
+	if (copy_from_user(&multi, (void __user *)arg, sizeof(multi)))
+		return -EFAULT;
+
+	if (!multi.num_submits)
+		return 0;
+	if (multi.num_submits > NVAVP_MAX_MULTI_SUBMITS)
+		return -EINVAL;
+
+	m = kzalloc(sizeof(*m), GFP_KERNEL);
+	if (!m)
+		return -ENOMEM;
+
+	if (copy_from_user(m->hdr, (void __user *)multi.submits,
+			sizeof(m->hdr[0]) * multi.num_submits)) {
+		ret = -EFAULT;
+		goto err_free;
+	}
+
+	for (n = 0; n < multi.num_submits; n++) {
+		if (!m->hdr[n].cmdbuf.mem) {
+			ret = -EINVAL;
+			goto err_release;
+		}
+		ret = nvavp_cmdbuf_prepare(clientctx, &m->hdr[n],
+					   &m->dupe[n], &phys_addr);
+		if (ret)
+			goto err_release;
+		m->phys[n] = phys_addr;
+		m->syncpt[n].id = NVSYNCPT_INVALID;
+	}
+
+	ret = nvavp_pushbuffer_update_multi(nvavp, m->phys, m->hdr,
+					    m->syncpt, n,
+					    clientctx->channel_id);
+	if (ret)
+		goto err_release;
+
+	for (i = 0; i < n; i++) {
+		if (!m->hdr[i].syncpt)
+			continue;
+		if (copy_to_user((void __user *)m->hdr[i].syncpt,
+				&m->syncpt[i], sizeof(struct nvavp_syncpt)))
+			ret = -EFAULT;
+	}
+
+err_release:
+	for (i = 0; i < n; i++)
+		nvavp_cmdbuf_release(nvavp, m->dupe[i]);
+err_free:
+	kfree(m);
 	return ret;
 }
 
@@ -1465,8 +1833,76 @@ static int tegra_nvavp_video_open(struct inode *inode, struct file *filp)
 #if defined(CONFIG_TEGRA_NVAVP_AUDIO)
 static int tegra_nvavp_audio_open(struct inode *inode, struct file *filp)
 {
+	struct miscdevice *miscdev = filp->private_data;
+	struct nvavp_info *nvavp = dev_get_drvdata(miscdev->parent);
+	struct nvavp_clientctx *clientctx;
+	unsigned long flags;
+	int ret;
+
 	pr_debug("tegra_nvavp_audio_open NVAVP_AUDIO_CHANNEL\n");
-	return tegra_nvavp_open(inode, filp, NVAVP_AUDIO_CHANNEL);
+	ret = tegra_nvavp_open(inode, filp, NVAVP_AUDIO_CHANNEL);
+	if (ret)
+		return ret;
+
+	/* only events from now on are news to this client */
+	clientctx = filp->private_data;
+	spin_lock_irqsave(&nvavp->audio_events_lock, flags);
+	clientctx->audio_events_seen = nvavp->audio_events;
+	spin_unlock_irqrestore(&nvavp->audio_events_lock, flags);
+	return 0;
+}
+
+static bool nvavp_audio_events_new(struct nvavp_clientctx *clientctx,
+				   struct nvavp_audio_events *events)
+{
+	struct nvavp_info *nvavp = clientctx->nvavp;
+	unsigned long flags;
+
+	spin_lock_irqsave(&nvavp->audio_events_lock, flags);
+	*events = nvavp->audio_events;
+	spin_unlock_irqrestore(&nvavp->audio_events_lock, flags);
+
+	return events->app_notify != clientctx->audio_events_seen.app_notify ||
+		events->audio_idle != clientctx->audio_events_seen.audio_idle;
+}
+
+static ssize_t tegra_nvavp_audio_read(struct file *filp, char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct nvavp_clientctx *clientctx = filp->private_data;
+	struct nvavp_info *nvavp = clientctx->nvavp;
+	struct nvavp_audio_events events;
+	int ret;
+
+	if (count < sizeof(events))
+		return -EINVAL;
+
+	if (!nvavp_audio_events_new(clientctx, &events)) {
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(nvavp->audio_events_wq,
+				nvavp_audio_events_new(clientctx, &events));
+		if (ret)
+			return ret;
+	}
+
+	if (copy_to_user(buf, &events, sizeof(events)))
+		return -EFAULT;
+
+	clientctx->audio_events_seen = events;
+	return sizeof(events);
+}
+
+static unsigned int tegra_nvavp_audio_poll(struct file *filp,
+					   poll_table *wait)
+{
+	struct nvavp_clientctx *clientctx = filp->private_data;
+	struct nvavp_audio_events events;
+
+	poll_wait(filp, &clientctx->nvavp->audio_events_wq, wait);
+	if (nvavp_audio_events_new(clientctx, &events))
+		return POLLIN | POLLRDNORM;
+	return 0;
 }
 #endif
 
@@ -1525,6 +1961,9 @@ static long tegra_nvavp_ioctl(struct file *filp, unsigned int cmd,
 	case NVAVP_IOCTL_PUSH_BUFFER_SUBMIT:
 		ret = nvavp_pushbuffer_submit_ioctl(filp, cmd, arg);
 		break;
+	case NVAVP_IOCTL_PUSH_BUFFER_SUBMIT_MULTI:
+		ret = nvavp_pushbuffer_submit_multi_ioctl(filp, cmd, arg);
+		break;
 	case NVAVP_IOCTL_SET_CLOCK:
 		ret = nvavp_set_clock_ioctl(filp, cmd, arg);
 		break;
@@ -1563,6 +2002,8 @@ static const struct file_operations tegra_audio_nvavp_fops = {
 	.open           = tegra_nvavp_audio_open,
 	.release        = tegra_nvavp_release,
 	.unlocked_ioctl = tegra_nvavp_ioctl,
+	.read           = tegra_nvavp_audio_read,
+	.poll           = tegra_nvavp_audio_poll,
 };
 #endif
 
@@ -1762,6 +2203,10 @@ static int tegra_nvavp_probe(struct platform_device *ndev)
 	nvavp->clk_enabled = 0;
 	nvavp_halt_avp(nvavp);
 
+	spin_lock_init(&nvavp->load_lock);
+	nvavp->vde_rate = ULONG_MAX;
+	nvavp->sclk_scaled_rate = ULONG_MAX;
+
 	INIT_WORK(&nvavp->clock_disable_work, clock_disable_handler);
 
 	nvavp->video_misc_dev.minor = MISC_DYNAMIC_MINOR;
@@ -1778,6 +2223,8 @@ static int tegra_nvavp_probe(struct platform_device *ndev)
 
 #if defined(CONFIG_TEGRA_NVAVP_AUDIO)
 	INIT_WORK(&nvavp->app_notify_work, app_notify_handler);
+	spin_lock_init(&nvavp->audio_events_lock);
+	init_waitqueue_head(&nvavp->audio_events_wq);
 	nvavp->audio_misc_dev.minor = MISC_DYNAMIC_MINOR;
 	nvavp->audio_misc_dev.name = "tegra_audio_avpchannel";
 	nvavp->audio_misc_dev.fops = &tegra_audio_nvavp_fops;
@@ -1809,6 +2256,8 @@ static int tegra_nvavp_probe(struct platform_device *ndev)
 		goto err_req_irq_pend;
 	}
 
+	nvavp_scale_init(nvavp);
+
 	return 0;
 
 err_req_irq_pend:
@@ -1865,9 +2314,11 @@ static int tegra_nvavp_remove(struct platform_device *ndev)
 	}
 	mutex_unlock(&nvavp->open_lock);
 
+	nvavp_pushbuffer_deinit(nvavp);
 	nvavp_unload_ucode(nvavp);
 	nvavp_unload_os(nvavp);
 
+	nvavp_scale_deinit(nvavp);
 	device_remove_file(&ndev->dev, &dev_attr_boost_sclk);
 
 	misc_deregister(&nvavp->video_misc_dev);
@@ -98,6 +98,7 @@ struct nvavp_ucode_info {
 	u32			size;
 	phys_addr_t		phys;
 	void			*ucode_bin;
+	bool			resident;	/* data holds ucode_bin */
 };
 
 #endif /* __MEDIA_VIDEO_TEGRA_NVAVP_OS_H */
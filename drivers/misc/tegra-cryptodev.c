@@ -30,6 +30,7 @@
 #include <linux/crypto.h>
 #include <linux/scatterlist.h>
 #include <linux/uaccess.h>
+#include <linux/mm.h>
 #include <crypto/rng.h>
 #include <crypto/hash.h>
 #include <mach/hardware.h>
@@ -41,6 +42,15 @@
 #define RNG_DRBG 1
 #define RNG 0
 
+/*
+ * Requests of at least a page whose buffers share their offset in the page
+ * are run on the pinned user pages instead of bounce buffers.
+ */
+#define ZC_MIN_SIZE	PAGE_SIZE
+#define ZC_MAX_PAGES	32	/* pinned per buffer at a time */
+
+#define CRYPT_REQ_BATCH_MAX	64
+
 struct tegra_crypto_ctx {
 	struct crypto_ablkcipher *ecb_tfm;
 	struct crypto_ablkcipher *cbc_tfm;
@@ -205,6 +215,154 @@ static void tegra_crypt_complete(struct crypto_async_request *req, int err)
 	}
 }
 
+/*
+ * Waits without interruption: the buffers must not be released while the
+ * engine may still be working on them.
+ */
+static int tegra_crypt_run(struct ablkcipher_request *req,
+	struct tegra_crypto_completion *done, bool encrypt)
+{
+	int ret;
+
+	INIT_COMPLETION(done->restart);
+	done->req_err = 0;
+	ret = encrypt ? crypto_ablkcipher_encrypt(req) :
+		crypto_ablkcipher_decrypt(req);
+
+	if ((ret == -EINPROGRESS) || (ret == -EBUSY)) {
+		/* crypto driver is asynchronous */
+		wait_for_completion(&done->restart);
+		ret = done->req_err < 0 ? done->req_err : 0;
+	} else if (ret < 0) {
+		pr_debug("%scrypt failed (%d)\n", encrypt ? "en" : "de", ret);
+	}
+
+	return ret;
+}
+
+struct tegra_crypt_zc {
+	struct page *in_pages[ZC_MAX_PAGES];
+	struct page *out_pages[ZC_MAX_PAGES];
+	struct scatterlist in_sg[ZC_MAX_PAGES];
+	struct scatterlist out_sg[ZC_MAX_PAGES];
+};
+
+static bool crypt_req_zero_copy(struct tegra_crypt_req *crypt_req)
+{
+	unsigned long in = (unsigned long)crypt_req->plaintext;
+	unsigned long out = (unsigned long)crypt_req->result;
+
+	/* the engine writes whole blocks, and wants equal in and out sgs */
+	return crypt_req->plaintext_sz >= ZC_MIN_SIZE &&
+		IS_ALIGNED(crypt_req->plaintext_sz, AES_BLOCK_SIZE) &&
+		IS_ALIGNED(in, AES_BLOCK_SIZE) &&
+		offset_in_page(in) == offset_in_page(out);
+}
+
+static int zc_pin_pages(unsigned long addr, int nr_pages, int write,
+	struct page **pages)
+{
+	int pinned;
+
+	pinned = get_user_pages_fast(addr & PAGE_MASK, nr_pages, write, pages);
+	if (pinned == nr_pages)
+		return 0;
+
+	while (pinned > 0)
+		put_page(pages[--pinned]);
+	return -EFAULT;
+}
+
+static void zc_unpin_pages(struct page **pages, int nr_pages, bool dirty)
+{
+	int i;
+
+	for (i = 0; i < nr_pages; i++) {
+		if (dirty)
+			set_page_dirty_lock(pages[i]);
+		put_page(pages[i]);
+	}
+}
+
+/* describe @len bytes from @offset into the pinned range */
+static void zc_fill_sg(struct scatterlist *sg, struct page **pages,
+	unsigned long offset, unsigned long len)
+{
+	int n = 0;
+
+	sg_init_table(sg, ZC_MAX_PAGES);
+	while (len) {
+		unsigned int poff = offset_in_page(offset);
+		unsigned int size = min(len, PAGE_SIZE - poff);
+
+		sg_set_page(&sg[n++], pages[offset >> PAGE_SHIFT], size, poff);
+		offset += size;
+		len -= size;
+	}
+	sg_mark_end(&sg[n - 1]);
+}
+
+static int process_crypt_req_zc(struct ablkcipher_request *req,
+	struct tegra_crypto_completion *done,
+	struct tegra_crypt_req *crypt_req)
+{
+	unsigned long in = (unsigned long)crypt_req->plaintext;
+	unsigned long out = (unsigned long)crypt_req->result;
+	unsigned long total = crypt_req->plaintext_sz;
+	unsigned int off = offset_in_page(in);
+	struct tegra_crypt_zc *zc;
+	int ret = 0;
+
+	zc = kmalloc(sizeof(*zc), GFP_KERNEL);
+	if (!zc)
+		return -ENOMEM;
+
+	while (total > 0) {
+		/* whole pages of the stream, so that each pass keeps the iv
+		 * restarting every PAGE_SIZE bytes as the bounce buffers do */
+		unsigned long len = min(total,
+			(unsigned long)(ZC_MAX_PAGES - 1) * PAGE_SIZE);
+		int nr_pages = DIV_ROUND_UP(off + len, PAGE_SIZE);
+		unsigned long pos, step;
+
+		ret = zc_pin_pages(in, nr_pages, 0, zc->in_pages);
+		if (ret < 0)
+			break;
+		ret = zc_pin_pages(out, nr_pages, 1, zc->out_pages);
+		if (ret < 0) {
+			zc_unpin_pages(zc->in_pages, nr_pages, false);
+			break;
+		}
+
+		/* without an iv the whole pass is one request */
+		step = (crypt_req->op & TEGRA_CRYPTO_ECB) ? len : PAGE_SIZE;
+		for (pos = 0; pos < len; pos += step) {
+			unsigned long size = min(step, len - pos);
+
+			zc_fill_sg(zc->in_sg, zc->in_pages, off + pos, size);
+			zc_fill_sg(zc->out_sg, zc->out_pages, off + pos, size);
+			ablkcipher_request_set_crypt(req, zc->in_sg,
+				zc->out_sg, size, crypt_req->iv);
+
+			ret = tegra_crypt_run(req, done, crypt_req->encrypt);
+			if (ret < 0)
+				break;
+		}
+
+		zc_unpin_pages(zc->in_pages, nr_pages, false);
+		zc_unpin_pages(zc->out_pages, nr_pages, true);
+		if (ret < 0)
+			break;
+
+		total -= len;
+		in += len;
+		out += len;
+	}
+
+	kfree(zc);
+	return ret;
+}
+
 static int process_crypt_req(struct tegra_crypto_ctx *ctx, struct tegra_crypt_req *crypt_req)
 {
 	struct crypto_ablkcipher *tfm;
@@ -257,17 +415,22 @@ static int process_crypt_req(struct tegra_crypto_ctx *ctx, struct tegra_crypt_re
 		goto process_req_out;
 	}
 
+	init_completion(&tcrypt_complete.restart);
+
+	ablkcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+		tegra_crypt_complete, &tcrypt_complete);
+
+	if (crypt_req_zero_copy(crypt_req)) {
+		ret = process_crypt_req_zc(req, &tcrypt_complete, crypt_req);
+		goto process_req_out;
+	}
+
 	ret = alloc_bufs(xbuf);
 	if (ret < 0) {
 		pr_err("alloc_bufs failed");
 		goto process_req_out;
 	}
 
-	init_completion(&tcrypt_complete.restart);
-
-	ablkcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
-		tegra_crypt_complete, &tcrypt_complete);
-
 	total = crypt_req->plaintext_sz;
 	while (total > 0) {
 		size = min(total, PAGE_SIZE);
@@ -284,28 +447,10 @@ static int process_crypt_req(struct tegra_crypto_ctx *ctx, struct tegra_crypt_re
 		ablkcipher_request_set_crypt(req, &in_sg,
 			&out_sg, size, crypt_req->iv);
 
-		INIT_COMPLETION(tcrypt_complete.restart);
-		tcrypt_complete.req_err = 0;
-		ret = crypt_req->encrypt ?
-			crypto_ablkcipher_encrypt(req) :
-			crypto_ablkcipher_decrypt(req);
-
-		if ((ret == -EINPROGRESS) || (ret == -EBUSY)) {
-			/* crypto driver is asynchronous */
-			ret = wait_for_completion_interruptible(&tcrypt_complete.restart);
-
-			if (ret < 0)
-				goto process_req_buf_out;
-
-			if (tcrypt_complete.req_err < 0) {
-				ret = tcrypt_complete.req_err;
-				goto process_req_buf_out;
-			}
-		} else if (ret < 0) {
-			pr_debug("%scrypt failed (%d)\n",
-				crypt_req->encrypt ? "en" : "de", ret);
+		ret = tegra_crypt_run(req, &tcrypt_complete,
+			crypt_req->encrypt);
+		if (ret < 0)
 			goto process_req_buf_out;
-		}
 
 		ret = copy_to_user((void __user *)crypt_req->result,
 			(const void *)xbuf[1], size);
@@ -329,6 +474,31 @@ process_req_out:
 	return ret;
 }
 
+static int process_crypt_req_batch(struct tegra_crypto_ctx *ctx,
+	struct tegra_crypt_req_batch *batch)
+{
+	struct tegra_crypt_req crypt_req;
+	int i, ret = 0;
+
+	if (batch->nreqs < 0 || batch->nreqs > CRYPT_REQ_BATCH_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < batch->nreqs; i++) {
+		if (copy_from_user(&crypt_req,
+			(void __user *)&batch->reqs[i], sizeof(crypt_req))) {
+			ret = -EFAULT;
+			break;
+		}
+
+		ret = process_crypt_req(ctx, &crypt_req);
+		if (ret < 0)
+			break;
+	}
+
+	batch->done = i;
+	return ret;
+}
+
 static int sha_async_hash_op(struct ahash_request *req,
 				struct tegra_crypto_completion *tr,
 				int ret)
@@ -536,6 +706,7 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 {
 	struct tegra_crypto_ctx *ctx = filp->private_data;
 	struct tegra_crypt_req crypt_req;
+	struct tegra_crypt_req_batch batch;
 	struct tegra_rng_req rng_req;
 	struct tegra_sha_req sha_req;
 	struct tegra_rsa_req rsa_req;
@@ -560,6 +731,19 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 		ret = process_crypt_req(ctx, &crypt_req);
 		break;
 
+	case TEGRA_CRYPTO_IOCTL_PROCESS_REQ_BATCH:
+		if (copy_from_user(&batch, (void __user *)arg,
+			sizeof(batch))) {
+			ret = -EFAULT;
+			pr_err("%s: copy_from_user fail(%d)\n", __func__, ret);
+			return ret;
+		}
+
+		ret = process_crypt_req_batch(ctx, &batch);
+		if (copy_to_user((void __user *)arg, &batch, sizeof(batch)))
+			ret = -EFAULT;
+		break;
+
 	case TEGRA_CRYPTO_IOCTL_SET_SEED:
 		if (copy_from_user(&rng_req, (void __user *)arg,
 			sizeof(rng_req))) {
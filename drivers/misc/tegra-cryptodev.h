@@ -30,6 +30,7 @@
 #define TEGRA_CRYPTO_IOCTL_GET_RANDOM	_IOWR(0x98, 103, int*)
 #define TEGRA_CRYPTO_IOCTL_GET_SHA	_IOWR(0x98, 104, int*)
 #define TEGRA_CRYPTO_IOCTL_RSA_REQ	_IOWR(0x98, 105, int*)
+#define TEGRA_CRYPTO_IOCTL_PROCESS_REQ_BATCH	_IOWR(0x98, 106, int*)
 
 #define TEGRA_CRYPTO_MAX_KEY_SIZE	AES_MAX_KEY_SIZE
 #define RSA_KEY_SIZE		512
@@ -63,6 +64,17 @@ struct tegra_crypt_req {
 	u8 *result;
 };
 
+/* a pointer to this struct needs to be passed to:
+ * TEGRA_CRYPTO_IOCTL_PROCESS_REQ_BATCH
+ * The requests are run in order until one fails; done is set to the
+ * number that completed. At most 64 requests per call.
+ */
+struct tegra_crypt_req_batch {
+	struct tegra_crypt_req *reqs;
+	int nreqs;
+	int done;
+};
+
 /* pointer to this struct should be passed to:
  * TEGRA_CRYPTO_IOCTL_SET_SEED
  * TEGRA_CRYPTO_IOCTL_GET_RANDOM
@@ -0,0 +1,427 @@
+/*
+ * drivers/misc/tegra-hotpath-bench.c
+ *
+ * Micro-benchmarks for kernel hot paths that have no user space entry
+ * point of their own: SMMU map/unmap, EMC and CPU DVFS transitions and
+ * the zram compressor. The user space side lives in
+ * tools/testing/selftests/tegra_bench.
+ *
+ * Copyright (c) 2015, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/gfp.h>
+#include <linux/clk.h>
+#include <linux/iommu.h>
+#include <linux/platform_device.h>
+#include <linux/pm_qos.h>
+#include <linux/cpufreq.h>
+#include <linux/lzo.h>
+#include <linux/err.h>
+
+/*
+ * Results are one line per benchmark, all times in nanoseconds:
+ *
+ *   # name iterations min_ns avg_ns max_ns
+ *   smmu_map_unmap 10000 812 901 15024
+ *
+ * A benchmark whose hardware or driver is missing reports "skipped".
+ */
+
+#define BENCH_SMMU_IOVA		0x80000000UL
+
+struct bench_stats {
+	u32 iters;
+	u64 min_ns;
+	u64 max_ns;
+	u64 total_ns;
+};
+
+struct bench {
+	const char *name;
+	u32 iters;
+	int (*run)(struct bench_stats *s, u32 iters);
+
+	int err;
+	struct bench_stats stats;
+};
+
+static DEFINE_MUTEX(bench_lock);
+static u32 bench_iterations;
+static struct dentry *bench_debugfs_root;
+
+static void bench_account(struct bench_stats *s, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (!s->iters || ns < s->min_ns)
+		s->min_ns = ns;
+	if (ns > s->max_ns)
+		s->max_ns = ns;
+	s->total_ns += ns;
+	s->iters++;
+}
+
+static int bench_smmu_map_unmap(struct bench_stats *s, u32 iters)
+{
+	struct iommu_domain *domain;
+	struct page *page;
+	ktime_t start;
+	int err = 0;
+	u32 i;
+
+	domain = iommu_domain_alloc(&platform_bus_type);
+	if (!domain)
+		return -ENODEV;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		iommu_domain_free(domain);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < iters; i++) {
+		start = ktime_get();
+		err = iommu_map(domain, BENCH_SMMU_IOVA, page_to_phys(page),
+				PAGE_SIZE, IOMMU_READ | IOMMU_WRITE);
+		if (err)
+			break;
+		iommu_unmap(domain, BENCH_SMMU_IOVA, PAGE_SIZE);
+		bench_account(s, start);
+	}
+
+	__free_page(page);
+	iommu_domain_free(domain);
+	return err;
+}
+
+/* raise the EMC floor to the top rate; the way down is left to scaling */
+static int bench_emc_dvfs(struct bench_stats *s, u32 iters)
+{
+	struct pm_qos_request req;
+	struct clk *emc;
+	long max_khz;
+	ktime_t start;
+	u32 i;
+
+	emc = clk_get_sys(NULL, "emc");
+	if (IS_ERR(emc))
+		return -ENODEV;
+
+	max_khz = clk_round_rate(emc, ULONG_MAX) / 1000;
+	clk_put(emc);
+	if (max_khz <= 0)
+		return -ENODEV;
+
+	pm_qos_add_request(&req, PM_QOS_EMC_FREQ_MIN,
+			   PM_QOS_EMC_FREQ_MIN_DEFAULT_VALUE);
+
+	for (i = 0; i < iters; i++) {
+		start = ktime_get();
+		pm_qos_update_request(&req, max_khz);
+		bench_account(s, start);
+
+		pm_qos_update_request(&req, PM_QOS_EMC_FREQ_MIN_DEFAULT_VALUE);
+		msleep(20);
+	}
+
+	pm_qos_remove_request(&req);
+	return 0;
+}
+
+/* pin the cpu to its lowest and highest rate in turn, timing both steps */
+static int bench_cpu_dvfs(struct bench_stats *s, u32 iters)
+{
+	struct pm_qos_request min_req, max_req;
+	struct cpufreq_policy *policy;
+	unsigned int min_khz, max_khz;
+	ktime_t start;
+	u32 i;
+
+	policy = cpufreq_cpu_get(0);
+	if (!policy)
+		return -ENODEV;
+
+	min_khz = policy->cpuinfo.min_freq;
+	max_khz = policy->cpuinfo.max_freq;
+	cpufreq_cpu_put(policy);
+
+	pm_qos_add_request(&min_req, PM_QOS_CPU_FREQ_MIN,
+			   PM_QOS_CPU_FREQ_MIN_DEFAULT_VALUE);
+	pm_qos_add_request(&max_req, PM_QOS_CPU_FREQ_MAX,
+			   PM_QOS_CPU_FREQ_MAX_DEFAULT_VALUE);
+
+	for (i = 0; i < iters; i++) {
+		start = ktime_get();
+		pm_qos_update_request(&max_req, min_khz);
+		bench_account(s, start);
+
+		start = ktime_get();
+		pm_qos_update_request(&max_req,
+				      PM_QOS_CPU_FREQ_MAX_DEFAULT_VALUE);
+		pm_qos_update_request(&min_req, max_khz);
+		bench_account(s, start);
+
+		pm_qos_update_request(&min_req,
+				      PM_QOS_CPU_FREQ_MIN_DEFAULT_VALUE);
+	}
+
+	pm_qos_remove_request(&max_req);
+	pm_qos_remove_request(&min_req);
+	return 0;
+}
+
+/* a page that compresses about as well as typical anonymous memory */
+static void bench_fill_page(u8 *buf)
+{
+	u32 seed = 0x12345678;
+	int i;
+
+	for (i = 0; i < PAGE_SIZE; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (i & 0x30) ? 0 : seed >> 24;
+	}
+}
+
+struct bench_lzo_bufs {
+	u8 *src;
+	u8 *dst;
+	u8 *out;
+	void *wrkmem;
+};
+
+static int bench_lzo_alloc(struct bench_lzo_bufs *b)
+{
+	b->src = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	b->dst = kmalloc(lzo1x_worst_compress(PAGE_SIZE), GFP_KERNEL);
+	b->out = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	b->wrkmem = vmalloc(LZO1X_MEM_COMPRESS);
+
+	if (!b->src || !b->dst || !b->out || !b->wrkmem)
+		return -ENOMEM;
+
+	bench_fill_page(b->src);
+	return 0;
+}
+
+static void bench_lzo_free(struct bench_lzo_bufs *b)
+{
+	vfree(b->wrkmem);
+	kfree(b->out);
+	kfree(b->dst);
+	kfree(b->src);
+}
+
+static int bench_zram_compress(struct bench_stats *s, u32 iters)
+{
+	struct bench_lzo_bufs b;
+	size_t dst_len;
+	ktime_t start;
+	int err;
+	u32 i;
+
+	err = bench_lzo_alloc(&b);
+	if (err)
+		goto out;
+
+	for (i = 0; i < iters; i++) {
+		start = ktime_get();
+		err = lzo1x_1_compress(b.src, PAGE_SIZE, b.dst, &dst_len,
+				       b.wrkmem);
+		if (err != LZO_E_OK) {
+			err = -EIO;
+			break;
+		}
+		bench_account(s, start);
+	}
+
+out:
+	bench_lzo_free(&b);
+	return err;
+}
+
+static int bench_zram_decompress(struct bench_stats *s, u32 iters)
+{
+	struct bench_lzo_bufs b;
+	size_t dst_len, out_len;
+	ktime_t start;
+	int err;
+	u32 i;
+
+	err = bench_lzo_alloc(&b);
+	if (err)
+		goto out;
+
+	err = lzo1x_1_compress(b.src, PAGE_SIZE, b.dst, &dst_len, b.wrkmem);
+	if (err != LZO_E_OK) {
+		err = -EIO;
+		goto out;
+	}
+
+	for (i = 0; i < iters; i++) {
+		out_len = PAGE_SIZE;
+
+		start = ktime_get();
+		err = lzo1x_decompress_safe(b.dst, dst_len, b.out, &out_len);
+		if (err != LZO_E_OK || out_len != PAGE_SIZE) {
+			err = -EIO;
+			break;
+		}
+		bench_account(s, start);
+	}
+
+out:
+	bench_lzo_free(&b);
+	return err;
+}
+
+static struct bench benches[] = {
+	{ .name = "smmu_map_unmap",	 .iters = 10000,
+	  .run = bench_smmu_map_unmap, },
+	{ .name = "emc_dvfs_up",	 .iters = 50,
+	  .run = bench_emc_dvfs, },
+	{ .name = "cpu_dvfs",		 .iters = 100,
+	  .run = bench_cpu_dvfs, },
+	{ .name = "zram_compress",	 .iters = 10000,
+	  .run = bench_zram_compress, },
+	{ .name = "zram_decompress",	 .iters = 10000,
+	  .run = bench_zram_decompress, },
+};
+
+static void bench_run_one(struct bench *b)
+{
+	u32 iters = bench_iterations ? bench_iterations : b->iters;
+
+	memset(&b->stats, 0, sizeof(b->stats));
+	b->err = b->run(&b->stats, iters);
+
+	pr_debug("%s: %s: %u iterations, err %d\n", __func__, b->name,
+		 b->stats.iters, b->err);
+}
+
+static ssize_t bench_run_write(struct file *file, const char __user *ubuf,
+			       size_t count, loff_t *ppos)
+{
+	char buf[32];
+	bool all, found = false;
+	int i;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	strim(buf);
+
+	all = !strcmp(buf, "all");
+
+	mutex_lock(&bench_lock);
+	for (i = 0; i < ARRAY_SIZE(benches); i++) {
+		if (!all && strcmp(buf, benches[i].name))
+			continue;
+		bench_run_one(&benches[i]);
+		found = true;
+	}
+	mutex_unlock(&bench_lock);
+
+	return found ? count : -EINVAL;
+}
+
+static const struct file_operations bench_run_fops = {
+	.open		= simple_open,
+	.write		= bench_run_write,
+	.llseek		= noop_llseek,
+};
+
+static int bench_results_show(struct seq_file *s, void *data)
+{
+	int i;
+
+	mutex_lock(&bench_lock);
+	seq_puts(s, "# name iterations min_ns avg_ns max_ns\n");
+	for (i = 0; i < ARRAY_SIZE(benches); i++) {
+		struct bench *b = &benches[i];
+		struct bench_stats *st = &b->stats;
+
+		if (b->err && !st->iters) {
+			seq_printf(s, "%s skipped %d\n", b->name, b->err);
+			continue;
+		}
+		if (!st->iters)
+			continue;
+
+		seq_printf(s, "%s %u %llu %llu %llu\n", b->name, st->iters,
+			   st->min_ns, div_u64(st->total_ns, st->iters),
+			   st->max_ns);
+	}
+	mutex_unlock(&bench_lock);
+
+	return 0;
+}
+
+static int bench_results_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_results_show, inode->i_private);
+}
+
+static const struct file_operations bench_results_fops = {
+	.open		= bench_results_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_hotpath_bench_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("tegra_hotpath_bench", NULL);
+	if (!root)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("run", S_IWUSR, root, NULL,
+				 &bench_run_fops))
+		goto err;
+	if (!debugfs_create_file("results", S_IRUGO, root, NULL,
+				 &bench_results_fops))
+		goto err;
+	if (!debugfs_create_u32("iterations", S_IRUGO | S_IWUSR, root,
+				&bench_iterations))
+		goto err;
+
+	bench_debugfs_root = root;
+	return 0;
+
+err:
+	debugfs_remove_recursive(root);
+	return -ENOMEM;
+}
+
+static void __exit tegra_hotpath_bench_exit(void)
+{
+	debugfs_remove_recursive(bench_debugfs_root);
+}
+
+module_init(tegra_hotpath_bench_init);
+module_exit(tegra_hotpath_bench_exit);
+
+MODULE_DESCRIPTION("Tegra kernel hot path micro-benchmarks");
+MODULE_LICENSE("GPL v2");
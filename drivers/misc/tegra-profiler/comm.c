@@ -25,6 +25,7 @@
 #include <linux/bitops.h>
 #include <linux/err.h>
 #include <linux/mm.h>
+#include <linux/module.h>
 
 #include <asm/uaccess.h>
 
@@ -33,6 +34,17 @@
 #include "comm.h"
 #include "version.h"
 
+/*
+ * Flight recorder mode: the daemon arms the session and leaves the rings
+ * alone, the oldest records are evicted to make room for new ones. When
+ * a frame drop is reported the rings are frozen and the reader is woken
+ * up to copy out the last records; STOP, SET_MMAP_RB and START re-arm it.
+ *
+ * Records do not carry their length, so the start offset of every record
+ * in the ring is kept on the side to know how far pos_read has to move.
+ */
+#define QUADD_FR_MAX_RECORDS	4096
+
 struct quadd_ring_buffer {
 	struct quadd_ring_buffer_hdr *rb_hdr;
 	char *buf;
@@ -40,6 +52,12 @@ struct quadd_ring_buffer {
 	size_t max_fill_count;
 	size_t nr_skipped_samples;
 
+	int flight;
+	u32 *rec_pos;
+	unsigned int rec_head;
+	unsigned int rec_count;
+	size_t nr_evicted;
+
 	struct quadd_mmap_area *mmap;
 
 	spinlock_t lock;
@@ -55,6 +73,9 @@ struct quadd_comm_ctx {
 
 	int params_ok;
 
+	int flight_recorder;
+	atomic_t frozen;
+
 	wait_queue_head_t read_wait;
 
 	struct miscdevice *misc_dev;
@@ -121,6 +142,33 @@ rb_write(struct quadd_ring_buffer_hdr *rb_hdr,
 	return length;
 }
 
+static void
+rb_evict(struct quadd_ring_buffer *rb,
+	 struct quadd_ring_buffer_hdr *rb_hdr, size_t length)
+{
+	while (rb->rec_count > 0 &&
+	       (length > rb_get_free_space(rb_hdr) ||
+		rb->rec_count == QUADD_FR_MAX_RECORDS)) {
+		rb->rec_head = (rb->rec_head + 1) % QUADD_FR_MAX_RECORDS;
+		rb->rec_count--;
+
+		rb_hdr->pos_read = rb->rec_count > 0 ?
+			rb->rec_pos[rb->rec_head] : rb_hdr->pos_write;
+
+		rb->nr_evicted++;
+	}
+}
+
+static void
+rb_push_record(struct quadd_ring_buffer *rb, u32 pos)
+{
+	unsigned int idx;
+
+	idx = (rb->rec_head + rb->rec_count) % QUADD_FR_MAX_RECORDS;
+	rb->rec_pos[idx] = pos;
+	rb->rec_count++;
+}
+
 static ssize_t
 write_sample(struct quadd_ring_buffer *rb,
 	     struct quadd_record_data *sample,
@@ -140,7 +188,14 @@ write_sample(struct quadd_ring_buffer *rb,
 
 	new_hdr.size = rb_hdr->size;
 	new_hdr.pos_write = rb_hdr->pos_write;
-	new_hdr.pos_read = rb_hdr->pos_read;
+	new_hdr.pos_read = ACCESS_ONCE(rb_hdr->pos_read);
+
+	/*
+	 * The reader advances pos_read from user space once it is done
+	 * with the data: do not let our stores into the buffer pass that
+	 * load.
+	 */
+	smp_mb();
 
 	pr_debug("[cpu: %d] type/len: %u/%#zx, read/write pos: %#x/%#x, free: %#zx\n",
 		smp_processor_id(),
@@ -149,12 +204,21 @@ write_sample(struct quadd_ring_buffer *rb,
 		new_hdr.pos_read, new_hdr.pos_write,
 		rb_get_free_space(&new_hdr));
 
+	/* the daemon does not consume an armed flight recorder */
+	if (rb->flight) {
+		rb_evict(rb, &new_hdr, length_sample);
+		rb_hdr->pos_read = new_hdr.pos_read;
+	}
+
 	if (length_sample > rb_get_free_space(&new_hdr)) {
 		pr_err_once("[cpu: %d] warning: buffer has been overflowed\n",
 			    smp_processor_id());
 		return -ENOSPC;
 	}
 
+	if (rb->flight)
+		rb_push_record(rb, new_hdr.pos_write);
+
 	err = rb_write(&new_hdr, rb->buf, sample, sizeof(*sample));
 	if (err < 0)
 		return err;
@@ -171,8 +235,9 @@ write_sample(struct quadd_ring_buffer *rb,
 		rb_hdr->max_fill_count = fill_count;
 	}
 
+	/* publish the record only after its contents */
+	smp_wmb();
 	rb_hdr->pos_write = new_hdr.pos_write;
-	wake_up_all(&comm_ctx.read_wait);
 
 	return length_sample;
 }
@@ -218,6 +283,11 @@ put_sample(struct quadd_record_data *data,
 
 	spin_lock_irqsave(&rb->lock, flags);
 
+	if (atomic_read(&comm_ctx.frozen)) {
+		spin_unlock_irqrestore(&rb->lock, flags);
+		return -EBUSY;
+	}
+
 	err = write_sample(rb, data, vec, vec_count);
 	if (err < 0) {
 		pr_err_once("%s: error: write sample\n", __func__);
@@ -230,6 +300,18 @@ put_sample(struct quadd_record_data *data,
 
 	spin_unlock_irqrestore(&rb->lock, flags);
 
+	/*
+	 * The reader is asleep in poll() only when it has drained every
+	 * ring, so skip the shared waitqueue lock in the common case. Pairs
+	 * with the barrier in device_poll(). A flight recorder has no reader
+	 * until it is frozen.
+	 */
+	if (err >= 0 && !comm_ctx.flight_recorder) {
+		smp_mb();
+		if (waitqueue_active(&comm_ctx.read_wait))
+			wake_up_all(&comm_ctx.read_wait);
+	}
+
 	return err;
 }
 
@@ -238,6 +320,44 @@ static void comm_reset(void)
 	pr_debug("Comm reset\n");
 }
 
+static void rb_freeze(void)
+{
+	int cpu_id;
+	unsigned long flags;
+	struct quadd_ring_buffer *rb;
+	struct comm_cpu_context *cc;
+
+	for_each_possible_cpu(cpu_id) {
+		cc = &per_cpu(cpu_ctx, cpu_id);
+		rb = &cc->rb;
+
+		/* wait for a writer in progress, see put_sample() */
+		spin_lock_irqsave(&rb->lock, flags);
+		if (rb->rb_hdr)
+			rb->rb_hdr->state = QUADD_RB_STATE_FROZEN;
+		spin_unlock_irqrestore(&rb->lock, flags);
+	}
+}
+
+/*
+ * Called by the display path on a dropped frame, possibly from interrupt
+ * context. Only the first drop after arming freezes the rings.
+ */
+void __quadd_flight_recorder_trigger(void)
+{
+	if (!comm_ctx.flight_recorder || !atomic_read(&comm_ctx.active))
+		return;
+
+	if (atomic_cmpxchg(&comm_ctx.frozen, 0, 1))
+		return;
+
+	rb_freeze();
+	wake_up_all(&comm_ctx.read_wait);
+
+	pr_info("flight recorder: frozen\n");
+}
+EXPORT_SYMBOL_GPL(__quadd_flight_recorder_trigger);
+
 static int is_active(void)
 {
 	return atomic_read(&comm_ctx.active) != 0;
@@ -294,8 +414,15 @@ device_poll(struct file *file, poll_table *wait)
 
 	poll_wait(file, &comm_ctx.read_wait, wait);
 
-	if (get_data_size() > 0)
+	/* queue ourselves before looking at pos_write, see put_sample() */
+	smp_mb();
+
+	if (comm_ctx.flight_recorder) {
+		if (atomic_read(&comm_ctx.frozen))
+			mask |= POLLIN | POLLRDNORM | POLLPRI;
+	} else if (get_data_size() > 0) {
 		mask |= POLLIN | POLLRDNORM;
+	}
 
 	if (!atomic_read(&comm_ctx.active))
 		mask |= POLLHUP;
@@ -324,6 +451,14 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 
 	rb = &cc->rb;
 
+	/* kept until the module goes away, see quadd_comm_events_exit() */
+	if (comm_ctx.flight_recorder && !rb->rec_pos) {
+		rb->rec_pos = vmalloc(QUADD_FR_MAX_RECORDS *
+				      sizeof(*rb->rec_pos));
+		if (!rb->rec_pos)
+			return -ENOMEM;
+	}
+
 	spin_lock_irqsave(&rb->lock, flags);
 
 	mmap->rb = rb;
@@ -333,6 +468,11 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 	rb->max_fill_count = 0;
 	rb->nr_skipped_samples = 0;
 
+	rb->flight = comm_ctx.flight_recorder;
+	rb->rec_head = 0;
+	rb->rec_count = 0;
+	rb->nr_evicted = 0;
+
 	vma = mmap->mmap_vma;
 
 	size = vma->vm_end - vma->vm_start;
@@ -388,7 +528,13 @@ static void rb_stop(void)
 		pr_info("[%d] skipped samples/max filling: %zu/%zu\n",
 			cpu_id, rb->nr_skipped_samples, rb->max_fill_count);
 
-		rb_hdr->state = QUADD_RB_STATE_STOPPED;
+		if (rb->flight)
+			pr_info("[%d] flight recorder: evicted records: %zu\n",
+				cpu_id, rb->nr_evicted);
+
+		/* the reader still has to drain a frozen ring */
+		if (rb_hdr->state != QUADD_RB_STATE_FROZEN)
+			rb_hdr->state = QUADD_RB_STATE_STOPPED;
 	}
 }
 
@@ -405,6 +551,9 @@ static void rb_reset(struct quadd_ring_buffer *rb)
 	rb->buf = NULL;
 	rb->rb_hdr = NULL;
 
+	rb->flight = 0;
+	rb->rec_count = 0;
+
 	spin_unlock_irqrestore(&rb->lock, flags);
 }
 
@@ -471,6 +620,10 @@ device_ioctl(struct file *file,
 			goto error_out;
 		}
 
+		comm_ctx.flight_recorder =
+			!!(user_params->reserved[QUADD_PARAM_IDX_EXTRA] &
+			   QUADD_PARAM_EXTRA_FLIGHT_RECORDER);
+
 		comm_ctx.params_ok = 1;
 
 		pr_info("setup success: freq/mafreq: %u/%u, backtrace: %d, pid: %d\n",
@@ -524,6 +677,8 @@ device_ioctl(struct file *file,
 
 	case IOCTL_START:
 		if (!atomic_cmpxchg(&comm_ctx.active, 0, 1)) {
+			atomic_set(&comm_ctx.frozen, 0);
+
 			err = comm_ctx.control->start();
 			if (err) {
 				pr_err("error: start failed\n");
@@ -789,8 +944,10 @@ static int comm_init(void)
 
 	mutex_init(&comm_ctx.io_mutex);
 	atomic_set(&comm_ctx.active, 0);
+	atomic_set(&comm_ctx.frozen, 0);
 
 	comm_ctx.params_ok = 0;
+	comm_ctx.flight_recorder = 0;
 	comm_ctx.nr_users = 0;
 
 	init_waitqueue_head(&comm_ctx.read_wait);
@@ -809,6 +966,10 @@ static int comm_init(void)
 		rb->max_fill_count = 0;
 		rb->nr_skipped_samples = 0;
 
+		rb->flight = 0;
+		rb->rec_pos = NULL;
+		rb->rec_count = 0;
+
 		spin_lock_init(&rb->lock);
 	}
 
@@ -830,7 +991,16 @@ quadd_comm_events_init(struct quadd_comm_control_interface *control)
 
 void quadd_comm_events_exit(void)
 {
+	int cpu_id;
+
 	mutex_lock(&comm_ctx.io_mutex);
 	unregister();
+
+	for_each_possible_cpu(cpu_id) {
+		struct quadd_ring_buffer *rb = &per_cpu(cpu_ctx, cpu_id).rb;
+
+		vfree(rb->rec_pos);
+		rb->rec_pos = NULL;
+	}
 	mutex_unlock(&comm_ctx.io_mutex);
 }
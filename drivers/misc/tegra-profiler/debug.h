@@ -80,8 +80,15 @@ quadd_get_event_str(int event)
 		[QUADD_EVENT_TYPE_L2_DCACHE_READ_MISSES]	= "l2_d_read",
 		[QUADD_EVENT_TYPE_L2_DCACHE_WRITE_MISSES]	= "l2_d_write",
 		[QUADD_EVENT_TYPE_L2_ICACHE_MISSES]		= "l2_i",
+
+		[QUADD_EVENT_TYPE_EMC_LOAD]		= "emc_load",
+		[QUADD_EVENT_TYPE_EMC_CPU_LOAD]		= "emc_cpu_load",
+		[QUADD_EVENT_TYPE_EMC_BANDWIDTH]	= "emc_bandwidth",
+		[QUADD_EVENT_TYPE_GR3D_BUSY]		= "gr3d_busy",
+		[QUADD_EVENT_TYPE_SYNCPT_INTRS]		= "syncpt_intrs",
 	};
-	return (event < QM_ARRAY_SIZE(str)) ? str[event] : "invalid event";
+	return (event >= 0 && event < QM_ARRAY_SIZE(str) && str[event]) ?
+		str[event] : "invalid event";
 }
 
 #endif	/* __QUADD_DEBUG_H */
@@ -21,6 +21,8 @@
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <linux/err.h>
+#include <linux/hash.h>
+#include <linux/vmalloc.h>
 
 #include <asm/unaligned.h>
 
@@ -110,16 +112,50 @@ struct regs_state {
 
 #define DW_MAX_RS_STACK_DEPTH	8
 
+/*
+ * Decoded unwind rows, cached per cpu so that lookups from the sampling
+ * timer need no locking. Direct-mapped on pc; each entry holds the whole
+ * pc range its row covers within one mmapped table.
+ */
+#define DW_CACHE_BITS		7
+#define DW_CACHE_SIZE		(1 << DW_CACHE_BITS)
+
+struct dw_cache_entry {
+	unsigned int gen;
+
+	struct quadd_mmap_area *mmap;
+	unsigned long vm_start;
+
+	unsigned long pc_start;
+	unsigned long pc_end;
+
+	int is_eh;
+	int mode;
+
+	struct regs_state rs;
+};
+
+struct dw_cache_stats {
+	u64 hits;
+	u64 misses;
+};
+
 struct dwarf_cpu_context {
 	struct regs_state rs_stack[DW_MAX_RS_STACK_DEPTH];
 	int depth;
 
 	int dw_ptr_size;
+
+	struct dw_cache_entry *cache;
+	unsigned int cache_gen;
 };
 
 struct quadd_dwarf_context {
 	struct dwarf_cpu_context __percpu *cpu_ctx;
 	atomic_t started;
+
+	/* bumped whenever the set of mapped unwind tables changes */
+	atomic_t cache_gen;
 };
 
 struct stackframe {
@@ -131,6 +167,9 @@ struct stackframe {
 
 	unsigned long cfa;
 
+	/* location of the row being built by dwarf_cfa_exec_insns() */
+	unsigned long row_start;
+
 	int mode;
 };
 
@@ -197,6 +236,7 @@ struct eh_sec_data {
 })
 
 static struct quadd_dwarf_context ctx;
+static DEFINE_PER_CPU(struct dw_cache_stats, dw_cache_stats);
 
 static inline int regnum_sp(int mode)
 {
@@ -784,6 +824,8 @@ dwarf_cfa_exec_insns(struct ex_region_info *ri,
 	c_insn = insn_start;
 
 	while (c_insn < insn_end && sf->pc <= pc) {
+		sf->row_start = sf->pc;
+
 		insn = read_mmap_data_u8(ri, c_insn++,
 					 secid, &err);
 		if (err)
@@ -1774,54 +1816,79 @@ static long def_cfa(struct stackframe *sf, struct regs_state *rs)
 	return 0;
 }
 
-static long
-unwind_frame(struct ex_region_info *ri,
-	     struct stackframe *sf,
-	     struct vm_area_struct *vma_sp,
-	     int is_eh)
+static struct dw_cache_entry *
+dw_cache_slot(unsigned long pc)
 {
-	int i, num_regs;
-	long err;
-	unsigned char *insn_end;
-	unsigned long addr, return_addr, val, user_reg_size;
-	struct dw_fde fde;
-	struct dw_cie cie;
+	struct dwarf_cpu_context *cpu_ctx = this_cpu_ptr(ctx.cpu_ctx);
+
+	return &cpu_ctx->cache[hash_long(pc, DW_CACHE_BITS)];
+}
+
+static int
+dw_cache_lookup(struct ex_region_info *ri, struct stackframe *sf, int *is_eh)
+{
+	struct dw_cache_entry *e;
 	unsigned long pc = sf->pc;
-	struct regs_state *rs, *rs_initial;
-	int mode = sf->mode;
+	struct dwarf_cpu_context *cpu_ctx = this_cpu_ptr(ctx.cpu_ctx);
+	struct dw_cache_stats *stats = &__get_cpu_var(dw_cache_stats);
 
-	err = dwarf_decode(ri, &cie, &fde, pc, is_eh);
-	if (err < 0)
-		return err;
+	e = dw_cache_slot(pc);
 
-	sf->pc = fde.initial_location;
+	if (e->gen != cpu_ctx->cache_gen ||
+	    e->mmap != ri->mmap || e->vm_start != ri->vm_start ||
+	    e->mode != sf->mode ||
+	    pc < e->pc_start || pc >= e->pc_end) {
+		stats->misses++;
+		return 0;
+	}
 
-	rs = &sf->rs;
-	rs_initial = &sf->rs_initial;
+	stats->hits++;
 
-	rs->cfa_register = -1;
-	rs_initial->cfa_register = -1;
+	*is_eh = e->is_eh;
+	memcpy(&sf->rs, &e->rs, sizeof(sf->rs));
 
-	rules_cleanup(rs, mode);
+	return 1;
+}
 
-	if (cie.initial_insn) {
-		insn_end = cie.initial_insn + cie.initial_insn_len;
-		err = dwarf_cfa_exec_insns(ri, cie.initial_insn,
-					   insn_end, &cie, sf, pc, is_eh);
-		if (err)
-			return err;
-	}
+static void
+dw_cache_insert(struct ex_region_info *ri, struct stackframe *sf,
+		unsigned long pc, struct dw_fde *fde, int is_eh)
+{
+	struct dw_cache_entry *e;
+	struct dwarf_cpu_context *cpu_ctx = this_cpu_ptr(ctx.cpu_ctx);
 
-	memcpy(rs_initial, rs, sizeof(*rs));
+	e = dw_cache_slot(pc);
 
-	if (fde.instructions) {
-		insn_end = fde.instructions + fde.insn_length;
-		err = dwarf_cfa_exec_insns(ri, fde.instructions,
-					   insn_end, fde.cie, sf, pc, is_eh);
-		if (err)
-			return err;
+	/* the row ends at the advance that took us past pc, or at the fde end */
+	if (sf->pc > pc) {
+		e->pc_start = sf->row_start;
+		e->pc_end = sf->pc;
+	} else {
+		e->pc_start = sf->pc;
+		e->pc_end = fde->initial_location + fde->address_range;
 	}
 
+	e->gen = cpu_ctx->cache_gen;
+	e->mmap = ri->mmap;
+	e->vm_start = ri->vm_start;
+	e->is_eh = is_eh;
+	e->mode = sf->mode;
+
+	memcpy(&e->rs, &sf->rs, sizeof(e->rs));
+}
+
+/* Compute the caller's registers from the row in sf->rs */
+static long
+apply_frame_rules(struct stackframe *sf,
+		  struct vm_area_struct *vma_sp,
+		  unsigned long pc)
+{
+	int i, num_regs;
+	long err;
+	unsigned long addr, return_addr, val, user_reg_size;
+	struct regs_state *rs = &sf->rs;
+	int mode = sf->mode;
+
 	pr_debug("mode: %s\n", (mode == DW_MODE_ARM32) ? "arm32" : "arm64");
 	pr_debug("initial cfa: %#lx\n", sf->cfa);
 
@@ -1911,6 +1978,56 @@ unwind_frame(struct ex_region_info *ri,
 	return 0;
 }
 
+static long
+unwind_frame(struct ex_region_info *ri,
+	     struct stackframe *sf,
+	     struct vm_area_struct *vma_sp,
+	     int is_eh)
+{
+	long err;
+	unsigned char *insn_end;
+	struct dw_fde fde;
+	struct dw_cie cie;
+	unsigned long pc = sf->pc;
+	struct regs_state *rs, *rs_initial;
+
+	err = dwarf_decode(ri, &cie, &fde, pc, is_eh);
+	if (err < 0)
+		return err;
+
+	sf->pc = fde.initial_location;
+
+	rs = &sf->rs;
+	rs_initial = &sf->rs_initial;
+
+	rs->cfa_register = -1;
+	rs_initial->cfa_register = -1;
+
+	rules_cleanup(rs, sf->mode);
+
+	if (cie.initial_insn) {
+		insn_end = cie.initial_insn + cie.initial_insn_len;
+		err = dwarf_cfa_exec_insns(ri, cie.initial_insn,
+					   insn_end, &cie, sf, pc, is_eh);
+		if (err)
+			return err;
+	}
+
+	memcpy(rs_initial, rs, sizeof(*rs));
+
+	if (fde.instructions) {
+		insn_end = fde.instructions + fde.insn_length;
+		err = dwarf_cfa_exec_insns(ri, fde.instructions,
+					   insn_end, fde.cie, sf, pc, is_eh);
+		if (err)
+			return err;
+	}
+
+	dw_cache_insert(ri, sf, pc, &fde, is_eh);
+
+	return apply_frame_rules(sf, vma_sp, pc);
+}
+
 static void
 unwind_backtrace(struct quadd_callchain *cc,
 		 struct ex_region_info *ri,
@@ -1963,6 +2080,15 @@ unwind_backtrace(struct quadd_callchain *cc,
 			ri = &ri_new;
 		}
 
+		if (dw_cache_lookup(ri, sf, &is_eh)) {
+			err = apply_frame_rules(sf, vma_sp, where);
+			if (err < 0) {
+				cc->urc_dwarf = -err;
+				break;
+			}
+			goto frame_done;
+		}
+
 		if (!is_fde_entry_exist(ri, sf->pc, &__is_eh, &__is_debug)) {
 			pr_debug("eh/debug fde entries are not existed\n");
 			cc->urc_dwarf = QUADD_URC_IDX_NOT_FOUND;
@@ -1994,6 +2120,7 @@ unwind_backtrace(struct quadd_callchain *cc,
 			}
 		}
 
+frame_done:
 		unw_type = is_eh ? QUADD_UNW_TYPE_DWARF_EH :
 				   QUADD_UNW_TYPE_DWARF_DF;
 
@@ -2110,6 +2237,9 @@ quadd_get_user_cc_dwarf(struct pt_regs *regs,
 	cpu_ctx->dw_ptr_size = (mode == DW_MODE_ARM32) ?
 				sizeof(u32) : sizeof(u64);
 
+	/* rows cached under an older set of tables are ignored */
+	cpu_ctx->cache_gen = atomic_read(&ctx.cache_gen);
+
 	sf.mode = mode;
 	sf.cfa = 0;
 
@@ -2136,27 +2266,95 @@ quadd_get_user_cc_dwarf(struct pt_regs *regs,
 	return cc->nr;
 }
 
+static void free_cpu_caches(void)
+{
+	int cpu_id;
+
+	for_each_possible_cpu(cpu_id) {
+		struct dwarf_cpu_context *cpu_ctx =
+			per_cpu_ptr(ctx.cpu_ctx, cpu_id);
+
+		vfree(cpu_ctx->cache);
+		cpu_ctx->cache = NULL;
+	}
+}
+
 int quadd_dwarf_unwind_start(void)
 {
+	int cpu_id;
+
 	if (!atomic_cmpxchg(&ctx.started, 0, 1)) {
 		ctx.cpu_ctx = alloc_percpu(struct dwarf_cpu_context);
 		if (!ctx.cpu_ctx) {
 			atomic_set(&ctx.started, 0);
 			return -ENOMEM;
 		}
+
+		for_each_possible_cpu(cpu_id) {
+			struct dwarf_cpu_context *cpu_ctx =
+				per_cpu_ptr(ctx.cpu_ctx, cpu_id);
+			struct dw_cache_stats *stats =
+				&per_cpu(dw_cache_stats, cpu_id);
+
+			cpu_ctx->cache = vzalloc(DW_CACHE_SIZE *
+						 sizeof(*cpu_ctx->cache));
+			if (!cpu_ctx->cache) {
+				free_cpu_caches();
+				free_percpu(ctx.cpu_ctx);
+				atomic_set(&ctx.started, 0);
+				return -ENOMEM;
+			}
+
+			stats->hits = 0;
+			stats->misses = 0;
+		}
 	}
 
+	quadd_dwarf_cache_invalidate();
+
 	return 0;
 }
 
 void quadd_dwarf_unwind_stop(void)
 {
-	if (atomic_cmpxchg(&ctx.started, 1, 0))
+	u64 hits, misses;
+
+	if (atomic_cmpxchg(&ctx.started, 1, 0)) {
+		free_cpu_caches();
 		free_percpu(ctx.cpu_ctx);
+
+		quadd_dwarf_cache_stats(&hits, &misses);
+		pr_info("dwarf unwind cache hits/misses: %llu/%llu\n",
+			hits, misses);
+	}
+}
+
+void quadd_dwarf_cache_invalidate(void)
+{
+	atomic_inc(&ctx.cache_gen);
+}
+
+void quadd_dwarf_cache_stats(u64 *hits, u64 *misses)
+{
+	int cpu_id;
+
+	*hits = 0;
+	*misses = 0;
+
+	for_each_possible_cpu(cpu_id) {
+		struct dw_cache_stats *stats = &per_cpu(dw_cache_stats, cpu_id);
+
+		*hits += stats->hits;
+		*misses += stats->misses;
+	}
 }
 
 int quadd_dwarf_unwind_init(void)
 {
 	atomic_set(&ctx.started, 0);
+
+	/* zeroed cache entries must never match */
+	atomic_set(&ctx.cache_gen, 1);
+
 	return 0;
 }
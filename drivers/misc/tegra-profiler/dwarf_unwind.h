@@ -17,6 +17,8 @@
 #ifndef __QUADD_DWARF_UNWIND_H
 #define __QUADD_DWARF_UNWIND_H
 
+#include <linux/types.h>
+
 struct pt_regs;
 struct quadd_callchain;
 struct task_struct;
@@ -35,4 +37,7 @@ int quadd_dwarf_unwind_start(void);
 void quadd_dwarf_unwind_stop(void);
 int quadd_dwarf_unwind_init(void);
 
+void quadd_dwarf_cache_invalidate(void);
+void quadd_dwarf_cache_stats(u64 *hits, u64 *misses);
+
 #endif  /* __QUADD_DWARF_UNWIND_H */
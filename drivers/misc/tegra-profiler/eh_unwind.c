@@ -642,6 +642,8 @@ void quadd_unwind_delete_mmap(struct quadd_mmap_area *mmap)
 	rcu_assign_pointer(ctx.rd, rd_new);
 	call_rcu(&rd->rcu, rd_free_rcu);
 
+	quadd_dwarf_cache_invalidate();
+
 error_out:
 	spin_unlock(&ctx.lock);
 }
@@ -37,6 +37,7 @@
 #include "power_clk.h"
 #include "tegra.h"
 #include "debug.h"
+#include "thread_counters.h"
 
 static struct quadd_hrt_ctx hrt;
 
@@ -129,9 +130,39 @@ __put_sample(struct quadd_record_data *data,
 
 	err = comm->put_sample(data, vec, vec_count, cpu_id);
 	if (err < 0)
-		atomic64_inc(&hrt.skipped_samples);
+		this_cpu_inc(hrt.cpu_ctx->nr_skipped_samples);
 
-	atomic64_inc(&hrt.counter_samples);
+	this_cpu_inc(hrt.cpu_ctx->nr_samples);
+}
+
+static void
+get_samples_counters(u64 *nr_samples, u64 *nr_skipped_samples)
+{
+	int cpu_id;
+	struct quadd_cpu_context *cpu_ctx;
+
+	*nr_samples = 0;
+	*nr_skipped_samples = 0;
+
+	for_each_possible_cpu(cpu_id) {
+		cpu_ctx = per_cpu_ptr(hrt.cpu_ctx, cpu_id);
+
+		*nr_samples += cpu_ctx->nr_samples;
+		*nr_skipped_samples += cpu_ctx->nr_skipped_samples;
+	}
+}
+
+static void reset_samples_counters(void)
+{
+	int cpu_id;
+	struct quadd_cpu_context *cpu_ctx;
+
+	for_each_possible_cpu(cpu_id) {
+		cpu_ctx = per_cpu_ptr(hrt.cpu_ctx, cpu_id);
+
+		cpu_ctx->nr_samples = 0;
+		cpu_ctx->nr_skipped_samples = 0;
+	}
 }
 
 void
@@ -161,6 +192,7 @@ static void put_header(void)
 	struct quadd_ctx *ctx = hrt.quadd_ctx;
 	struct quadd_event_source_interface *pmu = ctx->pmu;
 	struct quadd_event_source_interface *pl310 = ctx->pl310;
+	struct quadd_event_source_interface *uncore = ctx->uncore;
 
 	record.record_type = QUADD_RECORD_TYPE_HEADER;
 
@@ -200,6 +232,9 @@ static void put_header(void)
 	if (hrt.get_stack_offset)
 		hdr->reserved |= QUADD_HDR_STACK_OFFSET;
 
+	if (hrt.thread_counters)
+		hdr->reserved |= QUADD_HDR_THREAD_COUNTERS;
+
 	if (pmu)
 		nr_events += pmu->get_current_events(events, max_events);
 
@@ -207,6 +242,10 @@ static void put_header(void)
 		nr_events += pl310->get_current_events(events + nr_events,
 						       max_events - nr_events);
 
+	if (uncore)
+		nr_events += uncore->get_current_events(events + nr_events,
+							max_events - nr_events);
+
 	hdr->nr_events = nr_events;
 
 	vec.base = events;
@@ -220,8 +259,12 @@ static void
 put_sched_sample(struct task_struct *task, int is_sched_in)
 {
 	unsigned int cpu, flags;
+	int vec_count = 0;
+	u32 nr_tc_events;
+	struct quadd_iovec vec[2];
 	struct quadd_record_data record;
 	struct quadd_sched_data *s = &record.sched;
+	struct quadd_thread_counters *tc;
 
 	record.record_type = QUADD_RECORD_TYPE_SCHED;
 
@@ -238,7 +281,44 @@ put_sched_sample(struct task_struct *task, int is_sched_in)
 	s->data[QUADD_SCHED_IDX_TASK_STATE] = get_task_state(task);
 	s->data[QUADD_SCHED_IDX_RESERVED] = 0;
 
-	quadd_put_sample_this_cpu(&record, NULL, 0);
+	if (!is_sched_in && hrt.thread_counters) {
+		tc = quadd_thread_counters_get(task->pid);
+		if (tc) {
+			nr_tc_events = hrt.nr_tc_events;
+			s->reserved |= QUADD_SCHED_RES_THREAD_COUNTERS;
+
+			vec[vec_count].base = &nr_tc_events;
+			vec[vec_count].len = sizeof(nr_tc_events);
+			vec_count++;
+
+			vec[vec_count].base = tc->vals;
+			vec[vec_count].len = nr_tc_events * sizeof(tc->vals[0]);
+			vec_count++;
+		}
+	}
+
+	quadd_put_sample_this_cpu(&record, vec_count ? vec : NULL, vec_count);
+}
+
+/*
+ * Fold the pmu deltas of this read into the thread's virtual counters.
+ * Deltas are taken per cpu and the pmu is restarted at every sched in,
+ * so the totals stay exact across migrations and cluster switches.
+ */
+static void
+update_thread_counters(struct task_struct *task,
+		       struct hrt_event_value *events, int nr_events)
+{
+	int i;
+	struct quadd_thread_counters *tc;
+
+	tc = quadd_thread_counters_get(task->pid);
+	if (!tc)
+		return;
+
+	nr_events = min_t(int, nr_events, hrt.nr_tc_events);
+	for (i = 0; i < nr_events; i++)
+		tc->vals[i] += events[i].value;
 }
 
 static int get_sample_data(struct quadd_sample_data *sample,
@@ -355,15 +435,24 @@ read_all_sources(struct pt_regs *regs, struct task_struct *task)
 	if (task->flags & PF_EXITING)
 		return;
 
-	if (ctx->pmu && ctx->pmu_info.active)
+	if (ctx->pmu && ctx->pmu_info.active) {
 		nr_events += read_source(ctx->pmu, regs,
 					 events, QUADD_MAX_COUNTERS);
 
+		if (hrt.thread_counters)
+			update_thread_counters(task, events, nr_events);
+	}
+
 	if (ctx->pl310 && ctx->pl310_info.active)
 		nr_events += read_source(ctx->pl310, regs,
 					 events + nr_events,
 					 QUADD_MAX_COUNTERS - nr_events);
 
+	if (ctx->uncore && ctx->uncore_info.active)
+		nr_events += read_source(ctx->uncore, regs,
+					 events + nr_events,
+					 QUADD_MAX_COUNTERS - nr_events);
+
 	if (!nr_events)
 		return;
 
@@ -646,8 +735,11 @@ int quadd_hrt_start(void)
 	struct quadd_ctx *ctx = hrt.quadd_ctx;
 	struct quadd_parameters *param = &ctx->param;
 
+	extra = param->reserved[QUADD_PARAM_IDX_EXTRA];
+
 	freq = ctx->param.freq;
-	freq = max_t(long, QUADD_HRT_MIN_FREQ, freq);
+	freq = max_t(long, (extra & QUADD_PARAM_EXTRA_FLIGHT_RECORDER) ?
+		     QUADD_HRT_FLIGHT_MIN_FREQ : QUADD_HRT_MIN_FREQ, freq);
 	period = NSEC_PER_SEC / freq;
 	hrt.sample_period = period;
 
@@ -656,13 +748,10 @@ int quadd_hrt_start(void)
 	else
 		hrt.ma_period = 0;
 
-	atomic64_set(&hrt.counter_samples, 0);
-	atomic64_set(&hrt.skipped_samples, 0);
+	reset_samples_counters();
 
 	reset_cpu_ctx();
 
-	extra = param->reserved[QUADD_PARAM_IDX_EXTRA];
-
 	if (param->backtrace) {
 		struct quadd_unw_methods *um = &hrt.um;
 
@@ -680,6 +769,18 @@ int quadd_hrt_start(void)
 	hrt.get_stack_offset =
 		(extra & QUADD_PARAM_EXTRA_STACK_OFFSET) ? 1 : 0;
 
+	hrt.thread_counters = 0;
+	if ((extra & QUADD_PARAM_EXTRA_THREAD_COUNTERS) &&
+	    ctx->pmu && ctx->pmu_info.active) {
+		int events[QUADD_MAX_COUNTERS];
+
+		hrt.nr_tc_events =
+			ctx->pmu->get_current_events(events,
+						     QUADD_TC_MAX_EVENTS);
+		hrt.thread_counters = hrt.nr_tc_events > 0;
+		quadd_thread_counters_start();
+	}
+
 	put_header();
 
 	if (extra & QUADD_PARAM_EXTRA_GET_MMAP) {
@@ -693,6 +794,9 @@ int quadd_hrt_start(void)
 	if (ctx->pl310)
 		ctx->pl310->start();
 
+	if (ctx->uncore)
+		ctx->uncore->start();
+
 	quadd_ma_start(&hrt);
 
 	atomic_set(&hrt.active, 1);
@@ -703,21 +807,27 @@ int quadd_hrt_start(void)
 
 void quadd_hrt_stop(void)
 {
+	u64 nr_samples, nr_skipped_samples;
 	struct quadd_ctx *ctx = hrt.quadd_ctx;
 
+	get_samples_counters(&nr_samples, &nr_skipped_samples);
 	pr_info("Stop hrt, samples all/skipped: %llu/%llu\n",
-		atomic64_read(&hrt.counter_samples),
-		atomic64_read(&hrt.skipped_samples));
+		nr_samples, nr_skipped_samples);
 
 	if (ctx->pl310)
 		ctx->pl310->stop();
 
+	if (ctx->uncore)
+		ctx->uncore->stop();
+
+	if (hrt.thread_counters)
+		quadd_thread_counters_stop();
+
 	quadd_ma_stop(&hrt);
 
 	atomic_set(&hrt.active, 0);
 
-	atomic64_set(&hrt.counter_samples, 0);
-	atomic64_set(&hrt.skipped_samples, 0);
+	reset_samples_counters();
 
 	/* reset_cpu_ctx(); */
 }
@@ -728,12 +838,17 @@ void quadd_hrt_deinit(void)
 		quadd_hrt_stop();
 
 	free_percpu(hrt.cpu_ctx);
+	quadd_thread_counters_deinit();
 }
 
 void quadd_hrt_get_state(struct quadd_module_state *state)
 {
-	state->nr_all_samples = atomic64_read(&hrt.counter_samples);
-	state->nr_skipped_samples = atomic64_read(&hrt.skipped_samples);
+	u64 nr_samples, nr_skipped_samples;
+
+	get_samples_counters(&nr_samples, &nr_skipped_samples);
+
+	state->nr_all_samples = nr_samples;
+	state->nr_skipped_samples = nr_skipped_samples;
 }
 
 struct quadd_hrt_ctx *quadd_hrt_init(struct quadd_ctx *ctx)
@@ -756,12 +871,15 @@ struct quadd_hrt_ctx *quadd_hrt_init(struct quadd_ctx *ctx)
 	else
 		hrt.ma_period = 0;
 
-	atomic64_set(&hrt.counter_samples, 0);
-
 	hrt.cpu_ctx = alloc_percpu(struct quadd_cpu_context);
 	if (!hrt.cpu_ctx)
 		return ERR_PTR(-ENOMEM);
 
+	if (quadd_thread_counters_init()) {
+		free_percpu(hrt.cpu_ctx);
+		return ERR_PTR(-ENOMEM);
+	}
+
 	for_each_possible_cpu(cpu_id) {
 		cpu_ctx = per_cpu_ptr(hrt.cpu_ctx, cpu_id);
 
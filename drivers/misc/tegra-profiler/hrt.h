@@ -37,6 +37,10 @@ struct quadd_cpu_context {
 
 	struct quadd_thread_data active_thread;
 	atomic_t nr_active;
+
+	/* samples put/dropped by this cpu, summed on read */
+	u64 nr_samples;
+	u64 nr_skipped_samples;
 };
 
 struct timecounter;
@@ -52,9 +56,6 @@ struct quadd_hrt_ctx {
 	atomic_t active;
 	atomic_t nr_active_all_core;
 
-	atomic64_t counter_samples;
-	atomic64_t skipped_samples;
-
 	struct timer_list ma_timer;
 	unsigned int ma_period;
 
@@ -63,10 +64,17 @@ struct quadd_hrt_ctx {
 
 	struct quadd_unw_methods um;
 	int get_stack_offset;
+
+	/* per-thread pmu totals, see thread_counters.c */
+	int thread_counters;
+	int nr_tc_events;
 };
 
 #define QUADD_HRT_MIN_FREQ	100
 
+/* always-on flight recorder sessions trade resolution for overhead */
+#define QUADD_HRT_FLIGHT_MIN_FREQ	10
+
 #define QUADD_U32_MAX (~(__u32)0)
 
 struct quadd_hrt_ctx;
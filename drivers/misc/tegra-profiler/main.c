@@ -35,6 +35,7 @@
 #include "version.h"
 #include "quadd_proc.h"
 #include "eh_unwind.h"
+#include "uncore.h"
 
 #ifdef CONFIG_ARM64
 #include "armv8_pmu.h"
@@ -104,6 +105,14 @@ static int start(void)
 			}
 		}
 
+		if (ctx.uncore) {
+			err = ctx.uncore->enable();
+			if (err) {
+				pr_err("error: uncore enable\n");
+				goto errout_preempt;
+			}
+		}
+
 		ctx.comm->reset();
 
 		err = quadd_hrt_start();
@@ -150,6 +159,9 @@ static void stop(void)
 		if (ctx.pl310)
 			ctx.pl310->disable();
 
+		if (ctx.uncore)
+			ctx.uncore->disable();
+
 		tegra_profiler_unlock();
 
 		preempt_enable();
@@ -172,9 +184,12 @@ static inline int is_event_supported(struct source_info *si, int event)
 }
 
 static int
-validate_freq(unsigned int freq)
+validate_freq(unsigned int freq, unsigned int extra)
 {
-	return freq >= 100 && freq <= 100000;
+	unsigned int min_freq = (extra & QUADD_PARAM_EXTRA_FLIGHT_RECORDER) ?
+		QUADD_HRT_FLIGHT_MIN_FREQ : QUADD_HRT_MIN_FREQ;
+
+	return freq >= min_freq && freq <= 100000;
 }
 
 static int
@@ -184,11 +199,12 @@ set_parameters(struct quadd_parameters *p)
 	uid_t task_uid, current_uid;
 	int pmu_events_id[QUADD_MAX_COUNTERS];
 	int pl310_events_id;
-	int nr_pmu = 0, nr_pl310 = 0;
+	int uncore_events_id[QUADD_MAX_COUNTERS];
+	int nr_pmu = 0, nr_pl310 = 0, nr_uncore = 0;
 	struct task_struct *task;
 	u64 *low_addr_p;
 
-	if (!validate_freq(p->freq)) {
+	if (!validate_freq(p->freq, p->reserved[QUADD_PARAM_IDX_EXTRA])) {
 		pr_err("error: incorrect frequency: %u\n", p->freq);
 		return -EINVAL;
 	}
@@ -258,6 +274,12 @@ set_parameters(struct quadd_parameters *p)
 				pr_err("error: multiply pl310 events\n");
 				return -EINVAL;
 			}
+		} else if (ctx.uncore &&
+			   is_event_supported(&ctx.uncore_info, event)) {
+			uncore_events_id[nr_uncore++] = p->events[i];
+
+			pr_info("uncore active event: %s\n",
+				quadd_get_event_str(event));
 		} else {
 			pr_err("Bad event: %s\n",
 			       quadd_get_event_str(event));
@@ -289,10 +311,26 @@ set_parameters(struct quadd_parameters *p)
 			ctx.pl310_info.active = 1;
 		} else {
 			ctx.pl310_info.active = 0;
+	ctx.uncore_info.active = 0;
 			ctx.pl310->set_events(NULL, 0);
 		}
 	}
 
+	if (ctx.uncore) {
+		if (nr_uncore > 0) {
+			err = ctx.uncore->set_events(uncore_events_id,
+						     nr_uncore);
+			if (err) {
+				pr_err("uncore set_parameters: error\n");
+				return err;
+			}
+			ctx.uncore_info.active = 1;
+		} else {
+			ctx.uncore_info.active = 0;
+			ctx.uncore->set_events(NULL, 0);
+		}
+	}
+
 	low_addr_p = (u64 *)&p->reserved[QUADD_PARAM_IDX_BT_LOWER_BOUND];
 	ctx.hrt->low_addr = (unsigned long)*low_addr_p;
 	pr_info("bt lower bound: %#lx\n", ctx.hrt->low_addr);
@@ -346,6 +384,12 @@ static void get_capabilities(struct quadd_comm_cap *cap)
 	events_cap->l2_dcache_write_misses = 0;
 	events_cap->l2_icache_misses = 0;
 
+	events_cap->emc_load = 0;
+	events_cap->emc_cpu_load = 0;
+	events_cap->emc_bandwidth = 0;
+	events_cap->gr3d_busy = 0;
+	events_cap->syncpt_intrs = 0;
+
 	if (ctx.pl310) {
 		struct source_info *s = &ctx.pl310_info;
 		for (i = 0; i < s->nr_supported_events; i++) {
@@ -420,6 +464,36 @@ static void get_capabilities(struct quadd_comm_cap *cap)
 		}
 	}
 
+	if (ctx.uncore) {
+		struct source_info *s = &ctx.uncore_info;
+		for (i = 0; i < s->nr_supported_events; i++) {
+			int event = s->supported_events[i];
+
+			switch (event) {
+			case QUADD_EVENT_TYPE_EMC_LOAD:
+				events_cap->emc_load = 1;
+				break;
+			case QUADD_EVENT_TYPE_EMC_CPU_LOAD:
+				events_cap->emc_cpu_load = 1;
+				break;
+			case QUADD_EVENT_TYPE_EMC_BANDWIDTH:
+				events_cap->emc_bandwidth = 1;
+				break;
+			case QUADD_EVENT_TYPE_GR3D_BUSY:
+				events_cap->gr3d_busy = 1;
+				break;
+			case QUADD_EVENT_TYPE_SYNCPT_INTRS:
+				events_cap->syncpt_intrs = 1;
+				break;
+
+			default:
+				pr_err_once("%s: error: invalid event\n",
+					    __func__);
+				return;
+			}
+		}
+	}
+
 	cap->tegra_lp_cluster = quadd_is_cpu_with_lp_cluster();
 	cap->power_rate = 1;
 	cap->blocked_read = 1;
@@ -433,6 +507,8 @@ static void get_capabilities(struct quadd_comm_cap *cap)
 	extra |= QUADD_COMM_CAP_EXTRA_UNWIND_MIXED;
 	extra |= QUADD_COMM_CAP_EXTRA_UNW_ENTRY_TYPE;
 	extra |= QUADD_COMM_CAP_EXTRA_RB_MMAP_OP;
+	extra |= QUADD_COMM_CAP_EXTRA_THREAD_COUNTERS;
+	extra |= QUADD_COMM_CAP_EXTRA_FLIGHT_RECORDER;
 
 	cap->reserved[QUADD_COMM_CAP_IDX_EXTRA] = extra;
 }
@@ -539,6 +615,21 @@ static int __init quadd_module_init(void)
 		pr_debug("PL310 not found\n");
 	}
 
+	ctx.uncore = quadd_uncore_events_init();
+	if (ctx.uncore) {
+		events = ctx.uncore_info.supported_events;
+		nr_events = ctx.uncore->get_supported_events(events,
+							     QUADD_MAX_COUNTERS);
+		ctx.uncore_info.nr_supported_events = nr_events;
+
+		pr_info("uncore success, amount of events: %d\n",
+			nr_events);
+
+		for (i = 0; i < nr_events; i++)
+			pr_info("uncore event: %s\n",
+				quadd_get_event_str(events[i]));
+	}
+
 	ctx.hrt = quadd_hrt_init(&ctx);
 	if (IS_ERR(ctx.hrt)) {
 		pr_err("error: HRT init failed\n");
@@ -56,6 +56,9 @@ struct quadd_ctx {
 	struct quadd_event_source_interface *pl310;
 	struct source_info pl310_info;
 
+	struct quadd_event_source_interface *uncore;
+	struct source_info uncore_info;
+
 	struct quadd_comm_data_interface *comm;
 	struct quadd_hrt_ctx *hrt;
 
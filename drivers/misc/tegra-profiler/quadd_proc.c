@@ -25,6 +25,7 @@
 #include "version.h"
 #include "quadd_proc.h"
 #include "arm_pmu.h"
+#include "dwarf_unwind.h"
 
 #define YES_NO(x) ((x) ? "yes" : "no")
 
@@ -154,6 +155,7 @@ static int show_status(struct seq_file *f, void *offset)
 {
 	unsigned int status;
 	unsigned int is_auth_open, active;
+	u64 cache_hits, cache_misses;
 	struct quadd_module_state s;
 
 	quadd_get_state(&s);
@@ -167,6 +169,10 @@ static int show_status(struct seq_file *f, void *offset)
 	seq_printf(f, "all samples:     %llu\n", s.nr_all_samples);
 	seq_printf(f, "skipped samples: %llu\n", s.nr_skipped_samples);
 
+	quadd_dwarf_cache_stats(&cache_hits, &cache_misses);
+	seq_printf(f, "dwarf cache:     %llu hits, %llu misses\n",
+		   cache_hits, cache_misses);
+
 	return 0;
 }
 
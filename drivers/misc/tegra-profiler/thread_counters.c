@@ -0,0 +1,100 @@
+/*
+ * drivers/misc/tegra-profiler/thread_counters.c
+ *
+ * Copyright (c) 2015, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/vmalloc.h>
+#include <linux/hash.h>
+#include <linux/atomic.h>
+#include <linux/string.h>
+#include <linux/errno.h>
+
+#include "thread_counters.h"
+
+/*
+ * Open-addressed table of per-thread counters, looked up from the sched
+ * hooks and the sampling timer. A thread runs on one cpu at a time, so
+ * only claiming a slot needs to be atomic; its counters are updated by
+ * whichever cpu the thread is running on. Slots are never released
+ * during a session.
+ */
+
+#define QUADD_TC_HASH_BITS	9
+#define QUADD_TC_SIZE		(1 << QUADD_TC_HASH_BITS)
+#define QUADD_TC_MAX_PROBES	16
+
+static struct quadd_thread_counters *tc_table;
+static atomic_t tc_overflows = ATOMIC_INIT(0);
+
+struct quadd_thread_counters *quadd_thread_counters_get(pid_t pid)
+{
+	int i;
+	u32 idx = hash_32((u32)pid, QUADD_TC_HASH_BITS);
+	struct quadd_thread_counters *table = tc_table;
+
+	if (!table || pid <= 0)
+		return NULL;
+
+	for (i = 0; i < QUADD_TC_MAX_PROBES; i++) {
+		struct quadd_thread_counters *tc;
+		pid_t owner;
+
+		tc = &table[(idx + i) & (QUADD_TC_SIZE - 1)];
+
+		owner = ACCESS_ONCE(tc->pid);
+		if (owner == pid)
+			return tc;
+
+		if (owner == 0) {
+			owner = cmpxchg(&tc->pid, 0, pid);
+			if (owner == 0 || owner == pid)
+				return tc;
+		}
+	}
+
+	atomic_inc(&tc_overflows);
+	return NULL;
+}
+
+void quadd_thread_counters_start(void)
+{
+	if (tc_table)
+		memset(tc_table, 0, QUADD_TC_SIZE * sizeof(*tc_table));
+
+	atomic_set(&tc_overflows, 0);
+}
+
+void quadd_thread_counters_stop(void)
+{
+	int overflows = atomic_read(&tc_overflows);
+
+	if (overflows)
+		pr_info("thread counters: %d updates dropped, table full\n",
+			overflows);
+}
+
+/* allocated up front: the session is started with preemption disabled */
+int quadd_thread_counters_init(void)
+{
+	tc_table = vzalloc(QUADD_TC_SIZE * sizeof(*tc_table));
+	return tc_table ? 0 : -ENOMEM;
+}
+
+void quadd_thread_counters_deinit(void)
+{
+	vfree(tc_table);
+	tc_table = NULL;
+}
@@ -0,0 +1,42 @@
+/*
+ * drivers/misc/tegra-profiler/thread_counters.h
+ *
+ * Copyright (c) 2015, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ */
+
+#ifndef __QUADD_THREAD_COUNTERS_H
+#define __QUADD_THREAD_COUNTERS_H
+
+#include <linux/types.h>
+
+#define QUADD_TC_MAX_EVENTS	8
+
+/*
+ * Virtual pmu counters of one thread: the deltas read on every cpu the
+ * thread ran on, summed over the session.
+ */
+struct quadd_thread_counters {
+	pid_t pid;
+	u32 reserved;
+	u64 vals[QUADD_TC_MAX_EVENTS];
+};
+
+int quadd_thread_counters_init(void);
+void quadd_thread_counters_deinit(void);
+
+void quadd_thread_counters_start(void);
+void quadd_thread_counters_stop(void);
+
+struct quadd_thread_counters *quadd_thread_counters_get(pid_t pid);
+
+#endif	/* __QUADD_THREAD_COUNTERS_H */
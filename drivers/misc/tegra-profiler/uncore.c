@@ -0,0 +1,301 @@
+/*
+ * drivers/misc/tegra-profiler/uncore.c
+ *
+ * Copyright (c) 2015, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/init.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+#include <linux/math64.h>
+#include <linux/nvhost.h>
+
+#include <mach/clk.h>
+#include <mach/mc.h>
+
+#include <linux/tegra_profiler.h>
+
+#include "quadd.h"
+#include "hrt.h"
+#include "uncore.h"
+#include "debug.h"
+
+/*
+ * System-wide events sampled next to the cpu counters: EMC activity from
+ * the actmon, gr3d busy time and syncpoint interrupts from host1x.
+ *
+ * Load and bandwidth events are levels, not counters: they are reported
+ * with prev_val == 0, so read_source() passes the value through as is.
+ * gr3d busy is the busy share of the interval since this cpu's previous
+ * sample. Syncpoint interrupts are a real counter, shared by all cpus so
+ * that each interrupt is accounted to exactly one sample.
+ */
+
+#if defined(CONFIG_ARCH_TEGRA_3x_SOC) || defined(CONFIG_ARCH_TEGRA_11x_SOC)
+#define QUADD_UNCORE_ACTMON
+#endif
+
+/* host1x must be built in, the profiler cannot be a module */
+#ifdef CONFIG_TEGRA_GRHOST
+#define QUADD_UNCORE_HOST1X
+#endif
+
+#define QUADD_UNCORE_MAX_EVENTS \
+	(QUADD_EVENT_TYPE_UNCORE_MAX - QUADD_EVENT_TYPE_EMC_LOAD)
+
+struct uncore_cpu_state {
+	u64 gr3d_busy_us;
+	u64 time_us;
+};
+
+static DEFINE_PER_CPU(struct uncore_cpu_state, uncore_cpu_state);
+
+struct uncore_context {
+	int supported[QUADD_UNCORE_MAX_EVENTS];
+	int nr_supported;
+
+	int events[QUADD_UNCORE_MAX_EVENTS];
+	int nr_events;
+
+	u32 syncpt_prev;
+	spinlock_t lock;
+};
+
+static struct uncore_context uncore_ctx;
+
+static inline u64 uncore_time_us(void)
+{
+	return div_u64(quadd_get_time(), NSEC_PER_USEC);
+}
+
+static u32 read_gr3d_busy(void)
+{
+#ifdef QUADD_UNCORE_HOST1X
+	struct uncore_cpu_state *s = &__get_cpu_var(uncore_cpu_state);
+	u64 busy_us = nvhost_gr3d_busy_us();
+	u64 now = uncore_time_us();
+	u64 delta = now - s->time_us;
+	u32 val = 0;
+
+	if (s->time_us && delta > 0)
+		val = min_t(u64, div64_u64((busy_us - s->gr3d_busy_us) * 1000,
+					   delta), 1000);
+
+	s->gr3d_busy_us = busy_us;
+	s->time_us = now;
+
+	return val;
+#else
+	return 0;
+#endif
+}
+
+static void read_syncpt_intrs(struct event_data *event)
+{
+#ifdef QUADD_UNCORE_HOST1X
+	unsigned long flags;
+
+	spin_lock_irqsave(&uncore_ctx.lock, flags);
+	event->val = nvhost_syncpt_intr_count();
+	event->prev_val = uncore_ctx.syncpt_prev;
+	uncore_ctx.syncpt_prev = event->val;
+	spin_unlock_irqrestore(&uncore_ctx.lock, flags);
+#endif
+}
+
+static void read_event(struct event_data *event)
+{
+	event->val = 0;
+	event->prev_val = 0;
+
+	switch (event->event_id) {
+#ifdef QUADD_UNCORE_ACTMON
+	case QUADD_EVENT_TYPE_EMC_LOAD:
+		event->val = tegra_actmon_emc_load();
+		break;
+	case QUADD_EVENT_TYPE_EMC_CPU_LOAD:
+		event->val = tegra_actmon_cpu_emc_load();
+		break;
+	case QUADD_EVENT_TYPE_EMC_BANDWIDTH:
+		event->val =
+			tegra_emc_freq_req_to_bw(tegra_actmon_emc_actv_freq());
+		break;
+#endif
+	case QUADD_EVENT_TYPE_GR3D_BUSY:
+		event->val = read_gr3d_busy();
+		break;
+	case QUADD_EVENT_TYPE_SYNCPT_INTRS:
+		read_syncpt_intrs(event);
+		break;
+	}
+}
+
+static int uncore_events_enable(void)
+{
+	return 0;
+}
+
+static void uncore_events_disable(void)
+{
+}
+
+static void uncore_events_start(void)
+{
+	int cpu_id;
+	unsigned long flags;
+
+	if (uncore_ctx.nr_events == 0)
+		return;
+
+	for_each_possible_cpu(cpu_id) {
+		struct uncore_cpu_state *s = &per_cpu(uncore_cpu_state, cpu_id);
+
+		s->gr3d_busy_us = 0;
+		s->time_us = 0;
+	}
+
+	spin_lock_irqsave(&uncore_ctx.lock, flags);
+#ifdef QUADD_UNCORE_HOST1X
+	uncore_ctx.syncpt_prev = nvhost_syncpt_intr_count();
+#endif
+	spin_unlock_irqrestore(&uncore_ctx.lock, flags);
+
+	qm_debug_start_source(QUADD_EVENT_SOURCE_UNCORE);
+}
+
+static void uncore_events_stop(void)
+{
+	if (uncore_ctx.nr_events == 0)
+		return;
+
+	qm_debug_stop_source(QUADD_EVENT_SOURCE_UNCORE);
+}
+
+static int uncore_events_read(struct event_data *events, int max_events)
+{
+	int i, nr_events = min_t(int, uncore_ctx.nr_events, max_events);
+
+	for (i = 0; i < nr_events; i++) {
+		events[i].event_source = QUADD_EVENT_SOURCE_UNCORE;
+		events[i].event_id = uncore_ctx.events[i];
+
+		read_event(&events[i]);
+
+		qm_debug_read_counter(events[i].event_id, events[i].prev_val,
+				      events[i].val);
+	}
+
+	return nr_events;
+}
+
+static int is_supported(int event)
+{
+	int i;
+
+	for (i = 0; i < uncore_ctx.nr_supported; i++) {
+		if (uncore_ctx.supported[i] == event)
+			return 1;
+	}
+	return 0;
+}
+
+static int uncore_set_events(int *events, int size)
+{
+	int i;
+
+	uncore_ctx.nr_events = 0;
+
+	if (!events || size == 0)
+		return 0;
+
+	if (size > QUADD_UNCORE_MAX_EVENTS) {
+		pr_err("Error: too many uncore events: %d\n", size);
+		return -ENOSPC;
+	}
+
+	for (i = 0; i < size; i++) {
+		if (!is_supported(events[i])) {
+			pr_err("Error event: %s\n",
+			       quadd_get_event_str(events[i]));
+			return -EINVAL;
+		}
+		uncore_ctx.events[i] = events[i];
+
+		pr_info("Event has been added: id/uncore: %s\n",
+			quadd_get_event_str(events[i]));
+	}
+	uncore_ctx.nr_events = size;
+
+	return 0;
+}
+
+static int get_supported_events(int *events, int max_events)
+{
+	int i, nr = min_t(int, uncore_ctx.nr_supported, max_events);
+
+	for (i = 0; i < nr; i++)
+		events[i] = uncore_ctx.supported[i];
+
+	return nr;
+}
+
+static int get_current_events(int *events, int max_events)
+{
+	int i, nr = min_t(int, uncore_ctx.nr_events, max_events);
+
+	for (i = 0; i < nr; i++)
+		events[i] = uncore_ctx.events[i];
+
+	return nr;
+}
+
+static struct quadd_event_source_interface uncore_int = {
+	.enable			= uncore_events_enable,
+	.disable		= uncore_events_disable,
+
+	.start			= uncore_events_start,
+	.stop			= uncore_events_stop,
+
+	.read			= uncore_events_read,
+	.set_events		= uncore_set_events,
+	.get_supported_events	= get_supported_events,
+	.get_current_events	= get_current_events,
+};
+
+struct quadd_event_source_interface *quadd_uncore_events_init(void)
+{
+	int *supported = uncore_ctx.supported;
+	int nr = 0;
+
+#ifdef QUADD_UNCORE_ACTMON
+	supported[nr++] = QUADD_EVENT_TYPE_EMC_LOAD;
+	supported[nr++] = QUADD_EVENT_TYPE_EMC_CPU_LOAD;
+	supported[nr++] = QUADD_EVENT_TYPE_EMC_BANDWIDTH;
+#endif
+#ifdef QUADD_UNCORE_HOST1X
+	supported[nr++] = QUADD_EVENT_TYPE_GR3D_BUSY;
+	supported[nr++] = QUADD_EVENT_TYPE_SYNCPT_INTRS;
+#endif
+
+	if (nr == 0)
+		return NULL;
+
+	uncore_ctx.nr_supported = nr;
+	uncore_ctx.nr_events = 0;
+	spin_lock_init(&uncore_ctx.lock);
+
+	pr_debug("uncore init success, amount of events: %d\n", nr);
+	return &uncore_int;
+}
@@ -0,0 +1,24 @@
+/*
+ * drivers/misc/tegra-profiler/uncore.h
+ *
+ * Copyright (c) 2015, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ */
+
+#ifndef __QUADD_UNCORE_H
+#define __QUADD_UNCORE_H
+
+struct quadd_event_source_interface;
+
+struct quadd_event_source_interface *quadd_uncore_events_init(void);
+
+#endif	/* __QUADD_UNCORE_H */
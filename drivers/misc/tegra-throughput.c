@@ -18,24 +18,52 @@
  */
 
 #include <linux/kthread.h>
+#include <linux/cpufreq.h>
 #include <linux/ktime.h>
 #include <linux/miscdevice.h>
 #include <linux/fs.h>
 #include <linux/init.h>
+#include <linux/list.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
 #include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/throughput_ioctl.h>
 #include <linux/module.h>
 #include <linux/nvhost.h>
+#include <linux/tegra_profiler.h>
+#include <linux/uaccess.h>
 #include <mach/dc.h>
 
 #define DEFAULT_SYNC_RATE 60000 /* 60 Hz */
 
+/*
+ * Each open of the node is a client with its own target and frame
+ * statistics. Flips are accounted to the foreground client: the one
+ * which last declared itself foreground, or the only client. With
+ * several clients and none in the foreground, flips are ignored.
+ */
+struct throughput_client {
+	struct list_head list;
+	pid_t pid;
+	char comm[TASK_COMM_LEN];
+	unsigned short target_frame_time;	/* 0 for the panel's */
+	bool foreground;
+	u64 frames;
+	u64 janks;
+	u32 hist[TEGRA_THROUGHPUT_HIST_BUCKETS];
+};
+
 static unsigned short target_frame_time;
 static unsigned short last_frame_time;
 static ktime_t last_flip;
-static unsigned int multiple_app_disable;
 static spinlock_t lock;
 
+/* clients and their statistics; nests inside lock and the dc's flip lock */
+static DEFINE_SPINLOCK(frame_lock);
+static LIST_HEAD(clients);
+
 static struct work_struct work;
 static int throughput_hint;
 
@@ -45,14 +73,59 @@ static void set_throughput_hint(struct work_struct *work)
 	nvhost_scale3d_set_throughput_hint(throughput_hint);
 }
 
+/* called with frame_lock held */
+static struct throughput_client *foreground_client(void)
+{
+	struct throughput_client *c;
+
+	list_for_each_entry(c, &clients, list)
+		if (c->foreground)
+			return c;
+
+	if (list_is_singular(&clients))
+		return list_first_entry(&clients, struct throughput_client,
+					list);
+
+	return NULL;
+}
+
+static unsigned short client_frame_time(struct throughput_client *c)
+{
+	return c->target_frame_time ? c->target_frame_time : target_frame_time;
+}
+
+/* a frame shown for more vsyncs than its target asks for is a jank */
+static void client_account_frame(struct throughput_client *c)
+{
+	unsigned int vsync = max_t(unsigned int, target_frame_time, 1);
+	unsigned int vsyncs, expected;
+
+	vsyncs = max(DIV_ROUND_CLOSEST(last_frame_time, vsync), 1U);
+	expected = max(DIV_ROUND_CLOSEST(client_frame_time(c), vsync), 1U);
+
+	c->frames++;
+	c->hist[min(vsyncs, (unsigned int)TEGRA_THROUGHPUT_HIST_BUCKETS) - 1]++;
+	if (vsyncs > expected)
+		c->janks++;
+}
+
 static int throughput_flip_callback(void)
 {
+	struct throughput_client *c;
+	unsigned short frame_time;
 	long timediff;
 	ktime_t now;
+	int ret = NOTIFY_OK;
+
+	spin_lock(&frame_lock);
 
-	/* only register flips when a single app is active */
-	if (multiple_app_disable)
-		return NOTIFY_DONE;
+	/* only register flips when an app is in the foreground */
+	c = foreground_client();
+	if (!c) {
+		ret = NOTIFY_DONE;
+		goto out;
+	}
+	frame_time = client_frame_time(c);
 
 	now = ktime_get();
 	if (last_flip.tv64 != 0) {
@@ -65,18 +138,32 @@ static int throughput_flip_callback(void)
 		if (last_frame_time == 0) {
 			pr_warn("%s: flips %lld nsec apart\n",
 				__func__, now.tv64 - last_flip.tv64);
-			return NOTIFY_DONE;
+			ret = NOTIFY_DONE;
+			goto out;
 		}
 
+		/* a flip after an idle period says nothing about the app */
+		if (last_frame_time != USHRT_MAX)
+			client_account_frame(c);
+
 		throughput_hint =
-			((int) target_frame_time * 1000) / last_frame_time;
+			((int) frame_time * 1000) / last_frame_time;
+
+		cpufreq_framedeadline_frame(0, frame_time);
+
+		/* a missed vsync, not a flip after an idle period */
+		if (last_frame_time >= 2 * (int) frame_time &&
+		    last_frame_time != USHRT_MAX)
+			quadd_flight_recorder_trigger();
 
 		if (!work_pending(&work))
 			schedule_work(&work);
 	}
 	last_flip = now;
 
-	return NOTIFY_OK;
+out:
+	spin_unlock(&frame_lock);
+	return ret;
 }
 
 static int sync_rate;
@@ -101,16 +188,29 @@ static int callback_initialized;
 
 static int throughput_open(struct inode *inode, struct file *file)
 {
+	struct throughput_client *c;
+
+	c = kzalloc(sizeof(*c), GFP_KERNEL);
+	if (!c)
+		return -ENOMEM;
+
+	c->pid = current->tgid;
+	get_task_comm(c->comm, current->group_leader);
+	file->private_data = c;
+
 	spin_lock(&lock);
 
 	if (!callback_initialized) {
 		callback_initialized = 1;
+		reset_target_frame_time();
 		tegra_dc_set_flip_callback(throughput_flip_callback);
 	}
 
 	throughput_active_app_count++;
-	if (throughput_active_app_count > 1)
-		multiple_app_disable = 1;
+
+	spin_lock(&frame_lock);
+	list_add_tail(&c->list, &clients);
+	spin_unlock(&frame_lock);
 
 	spin_unlock(&lock);
 
@@ -122,47 +222,128 @@ static int throughput_open(struct inode *inode, struct file *file)
 
 static int throughput_release(struct inode *inode, struct file *file)
 {
+	struct throughput_client *c = file->private_data;
+
 	spin_lock(&lock);
 
+	spin_lock(&frame_lock);
+	list_del(&c->list);
+	spin_unlock(&frame_lock);
+
 	throughput_active_app_count--;
 	if (throughput_active_app_count == 0) {
 		reset_target_frame_time();
-		multiple_app_disable = 0;
 		callback_initialized = 0;
 		tegra_dc_unset_flip_callback();
 	}
 
 	spin_unlock(&lock);
 
+	kfree(c);
+
 	pr_debug("throughput_release node %p file %p\n", inode, file);
 
 	return 0;
 }
 
-static int throughput_set_target_fps(unsigned long arg)
+static int throughput_set_target_fps(struct throughput_client *c,
+				     unsigned long arg)
 {
-	int disable;
+	unsigned short frame_time = 0;
 
-	pr_debug("%s: target fps %lu requested\n", __func__, arg);
+	pr_debug("%s: target fps %lu requested by %d\n", __func__, arg, c->pid);
 
-	disable = multiple_app_disable;
+	if (arg) {
+		unsigned long t = (1000000 / arg);
 
-	if (disable) {
-		pr_debug("%s: %d active apps, disabling fps usage\n",
-			__func__, throughput_active_app_count);
-		return 0;
+		frame_time = (unsigned short) min_t(unsigned long, t,
+						    USHRT_MAX);
 	}
 
-	if (arg == 0)
-		reset_target_frame_time();
-	else {
-		unsigned long frame_time = (1000000 / arg);
+	spin_lock(&frame_lock);
+	c->target_frame_time = frame_time;
+	spin_unlock(&frame_lock);
+
+	return 0;
+}
 
-		if (frame_time > USHRT_MAX)
-			frame_time = USHRT_MAX;
+static int throughput_set_foreground(struct throughput_client *c,
+				     unsigned long arg)
+{
+	struct throughput_client *other;
 
-		target_frame_time = (unsigned short) frame_time;
-	}
+	pr_debug("%s: %d %s the foreground\n", __func__, c->pid,
+		 arg ? "takes" : "leaves");
+
+	spin_lock(&frame_lock);
+	if (arg)
+		list_for_each_entry(other, &clients, list)
+			other->foreground = false;
+	c->foreground = !!arg;
+	spin_unlock(&frame_lock);
+
+	return 0;
+}
+
+static int throughput_get_stats(struct throughput_client *c,
+				unsigned long arg)
+{
+	struct tegra_throughput_stats_args args;
+
+	memset(&args, 0, sizeof(args));
+
+	spin_lock(&frame_lock);
+	args.frames = c->frames;
+	args.janks = c->janks;
+	args.target_frame_time_us = client_frame_time(c);
+	args.vsync_time_us = target_frame_time;
+	args.foreground = foreground_client() == c;
+	memcpy(args.hist, c->hist, sizeof(args.hist));
+	spin_unlock(&frame_lock);
+
+	if (copy_to_user((void __user *)arg, &args, sizeof(args)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int throughput_set_scaling_profile(unsigned long arg)
+{
+	struct tegra_throughput_scaling_profile_args args;
+
+	if (copy_from_user(&args, (void __user *)arg, sizeof(args)))
+		return -EFAULT;
+	args.name[sizeof(args.name) - 1] = '\0';
+
+	pr_debug("%s: scaling profile %s requested\n", __func__, args.name);
+
+	return nvhost_scale3d_set_profile(args.name);
+}
+
+static int throughput_frame_deadline(struct throughput_client *c,
+				     unsigned long arg)
+{
+	struct tegra_throughput_frame_deadline_args args;
+	unsigned short frame_time;
+	bool foreground;
+
+	if (copy_from_user(&args, (void __user *)arg, sizeof(args)))
+		return -EFAULT;
+
+	spin_lock(&frame_lock);
+	foreground = foreground_client() == c;
+	frame_time = client_frame_time(c);
+	spin_unlock(&frame_lock);
+
+	/* only the foreground app drives the governor */
+	if (!foreground)
+		return 0;
+
+	if (args.busy_us == 0)
+		return -EINVAL;
+
+	cpufreq_framedeadline_frame(args.busy_us,
+		args.deadline_us ? args.deadline_us : frame_time);
 
 	return 0;
 }
@@ -172,6 +353,7 @@ throughput_ioctl(struct file *file,
 			  unsigned int cmd,
 			  unsigned long arg)
 {
+	struct throughput_client *c = file->private_data;
 	int err = 0;
 
 	if ((_IOC_TYPE(cmd) != TEGRA_THROUGHPUT_MAGIC) ||
@@ -183,7 +365,23 @@ throughput_ioctl(struct file *file,
 	case TEGRA_THROUGHPUT_IOCTL_TARGET_FPS:
 		pr_debug("%s: TEGRA_THROUGHPUT_IOCTL_TARGET_FPS %lu\n",
 			__func__, arg);
-		err = throughput_set_target_fps(arg);
+		err = throughput_set_target_fps(c, arg);
+		break;
+
+	case TEGRA_THROUGHPUT_IOCTL_SCALING_PROFILE:
+		err = throughput_set_scaling_profile(arg);
+		break;
+
+	case TEGRA_THROUGHPUT_IOCTL_FRAME_DEADLINE:
+		err = throughput_frame_deadline(c, arg);
+		break;
+
+	case TEGRA_THROUGHPUT_IOCTL_FOREGROUND:
+		err = throughput_set_foreground(c, arg);
+		break;
+
+	case TEGRA_THROUGHPUT_IOCTL_GET_STATS:
+		err = throughput_get_stats(c, arg);
 		break;
 
 	default:
@@ -193,6 +391,62 @@ throughput_ioctl(struct file *file,
 	return err;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int frame_stats_show(struct seq_file *s, void *unused)
+{
+	struct throughput_client *c, *fg;
+	int i;
+
+	seq_printf(s, "vsync %u us\n", target_frame_time);
+	seq_printf(s, "%-8s %-16s %-3s %8s %10s %8s  vsyncs 1..%d+\n",
+		   "pid", "comm", "fg", "target", "frames", "janks",
+		   TEGRA_THROUGHPUT_HIST_BUCKETS);
+
+	spin_lock(&frame_lock);
+	fg = foreground_client();
+	list_for_each_entry(c, &clients, list) {
+		seq_printf(s, "%-8d %-16s %-3s %8u %10llu %8llu ",
+			   c->pid, c->comm, c == fg ? "*" : "",
+			   client_frame_time(c), c->frames, c->janks);
+		for (i = 0; i < TEGRA_THROUGHPUT_HIST_BUCKETS; i++)
+			seq_printf(s, " %u", c->hist[i]);
+		seq_putc(s, '\n');
+	}
+	spin_unlock(&frame_lock);
+
+	return 0;
+}
+
+static int frame_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, frame_stats_show, inode->i_private);
+}
+
+static const struct file_operations frame_stats_fops = {
+	.open		= frame_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static struct dentry *frame_stats_dentry;
+
+static void throughput_debugfs_init(void)
+{
+	frame_stats_dentry = debugfs_create_file("tegra_throughput", S_IRUGO,
+						 NULL, NULL,
+						 &frame_stats_fops);
+}
+
+static void throughput_debugfs_exit(void)
+{
+	debugfs_remove(frame_stats_dentry);
+}
+#else
+static inline void throughput_debugfs_init(void) { }
+static inline void throughput_debugfs_exit(void) { }
+#endif
+
 static const struct file_operations throughput_user_fops = {
 	.owner			= THIS_MODULE,
 	.open			= throughput_open,
@@ -225,6 +479,8 @@ int __init throughput_init_miscdev(void)
 		return ret;
 	}
 
+	throughput_debugfs_init();
+
 	return 0;
 }
 
@@ -236,6 +492,7 @@ void __exit throughput_exit_miscdev(void)
 
 	cancel_work_sync(&work);
 
+	throughput_debugfs_exit();
 	misc_deregister(&throughput_miscdev);
 }
 
@@ -32,6 +32,7 @@
 #include <linux/module.h>
 #include <linux/hwmon-sysfs.h>
 #include <linux/suspend.h>
+#include <linux/math64.h>
 
 struct therm_estimator {
 	long cur_temp;
@@ -47,11 +48,65 @@ struct therm_estimator {
 	long trip_temp;
 	int tc1;
 	int tc2;
+
+	/*
+	 * Forecast mode: the estimate is extrapolated forecast_ms ahead
+	 * from the least squares slope of the last HIST_LEN estimates, and
+	 * the zone reports the forecast while it is higher. The passive trip
+	 * is then reached early and stepped into one state at a time while
+	 * the forecast keeps rising, instead of being crossed late and
+	 * clamped hard.
+	 */
+	long forecast_ms;
+	long forecast_max_lead;
+	long est_hist[HIST_LEN];
+	int nest;
+	long slope;		/* mC per polling period */
+	long forecast_temp;
+	long last_forecast_temp;
 #ifdef CONFIG_PM
 	struct notifier_block pm_nb;
 #endif
 };
 
+static void therm_est_forecast(struct therm_estimator *est)
+{
+	s64 num = 0, lead;
+	long den = 0;
+	int i, x, index;
+
+	est->est_hist[est->ntemp % HIST_LEN] = est->cur_temp;
+	if (est->nest < HIST_LEN)
+		est->nest++;
+
+	est->last_forecast_temp = est->forecast_temp;
+	est->forecast_temp = est->cur_temp;
+	if (!est->forecast_ms || (est->nest < HIST_LEN) ||
+	    (est->polling_period <= 0))
+		return;
+
+	/* x runs over odd values centered on zero, oldest sample first */
+	for (i = 0; i < HIST_LEN; i++) {
+		index = (est->ntemp - (HIST_LEN - 1) + i + HIST_LEN) % HIST_LEN;
+		x = 2 * i - (HIST_LEN - 1);
+		num += (s64)x * est->est_hist[index];
+		den += x * x;
+	}
+
+	est->slope = div64_s64(2 * num, den);
+	lead = div64_s64(2 * num * est->forecast_ms,
+			 (s64)den * est->polling_period);
+	lead = clamp_t(s64, lead, 0, est->forecast_max_lead);
+	est->forecast_temp = est->cur_temp + lead;
+}
+
+static long therm_est_zone_temp(struct therm_estimator *est)
+{
+	if (est->forecast_ms)
+		return max(est->cur_temp, est->forecast_temp);
+	return est->cur_temp;
+}
+
 static void therm_est_work_func(struct work_struct *work)
 {
 	int i, j, index, sum = 0;
@@ -79,9 +134,11 @@ static void therm_est_work_func(struct work_struct *work)
 
 	est->cur_temp = sum / 100 + est->toffset;
 
+	therm_est_forecast(est);
+
 	est->ntemp++;
 
-	if (est->cur_temp >= est->trip_temp)
+	if (therm_est_zone_temp(est) >= est->trip_temp)
 		if (est->thz && !est->thz->passive)
 			thermal_zone_device_update(est->thz);
 
@@ -146,7 +203,7 @@ static int therm_est_get_temp(struct thermal_zone_device *thz,
 				unsigned long *temp)
 {
 	struct therm_estimator *est = thz->devdata;
-	*temp = est->cur_temp;
+	*temp = therm_est_zone_temp(est);
 	return 0;
 }
 
@@ -158,6 +215,20 @@ static int therm_est_get_trend(struct thermal_zone_device *thz,
 	int new_trend;
 	int cur_temp;
 
+	/*
+	 * Only the forecast is above the trip: keep stepping up while it
+	 * rises and hold the mild cap otherwise, so the real temperature
+	 * levels off below the trip.
+	 */
+	if (est->forecast_ms && (est->cur_temp < est->trip_temp) &&
+	    (est->forecast_temp >= est->trip_temp)) {
+		if (est->forecast_temp > est->last_forecast_temp)
+			*trend = THERMAL_TREND_RAISING;
+		else
+			*trend = THERMAL_TREND_STABLE;
+		return 0;
+	}
+
 	cur_temp = thz->temperature;
 	new_trend = (est->tc1 * (cur_temp - thz->last_temperature)) +
 		    (est->tc2 * (cur_temp - est->trip_temp));
@@ -346,12 +417,75 @@ static ssize_t set_tc2(struct device *dev,
 	return count;
 }
 
+static ssize_t show_forecast_ms(struct device *dev,
+				struct device_attribute *da,
+				char *buf)
+{
+	struct therm_estimator *est = dev_get_drvdata(dev);
+	snprintf(buf, PAGE_SIZE, "%ld\n", est->forecast_ms);
+	return strlen(buf);
+}
+
+static ssize_t set_forecast_ms(struct device *dev,
+				struct device_attribute *da,
+				const char *buf, size_t count)
+{
+	struct therm_estimator *est = dev_get_drvdata(dev);
+	long forecast_ms;
+
+	if (kstrtol(buf, 0, &forecast_ms) || (forecast_ms < 0))
+		return -EINVAL;
+
+	est->forecast_ms = forecast_ms;
+
+	return count;
+}
+
+static ssize_t show_forecast_max_lead(struct device *dev,
+				struct device_attribute *da,
+				char *buf)
+{
+	struct therm_estimator *est = dev_get_drvdata(dev);
+	snprintf(buf, PAGE_SIZE, "%ld\n", est->forecast_max_lead);
+	return strlen(buf);
+}
+
+static ssize_t set_forecast_max_lead(struct device *dev,
+				struct device_attribute *da,
+				const char *buf, size_t count)
+{
+	struct therm_estimator *est = dev_get_drvdata(dev);
+	long lead;
+
+	if (kstrtol(buf, 0, &lead) || (lead < 0))
+		return -EINVAL;
+
+	est->forecast_max_lead = lead;
+
+	return count;
+}
+
+static ssize_t show_forecast(struct device *dev,
+				struct device_attribute *da,
+				char *buf)
+{
+	struct therm_estimator *est = dev_get_drvdata(dev);
+	snprintf(buf, PAGE_SIZE, "temp %ld slope %ld forecast %ld\n",
+		 est->cur_temp, est->slope, est->forecast_temp);
+	return strlen(buf);
+}
+
 static struct sensor_device_attribute therm_est_nodes[] = {
 	SENSOR_ATTR(coeff, S_IRUGO | S_IWUSR, show_coeff, set_coeff, 0),
 	SENSOR_ATTR(offset, S_IRUGO | S_IWUSR, show_offset, set_offset, 0),
 	SENSOR_ATTR(tc1, S_IRUGO | S_IWUSR, show_tc1, set_tc1, 0),
 	SENSOR_ATTR(tc2, S_IRUGO | S_IWUSR, show_tc2, set_tc2, 0),
 	SENSOR_ATTR(temps, S_IRUGO, show_temps, 0, 0),
+	SENSOR_ATTR(forecast_ms, S_IRUGO | S_IWUSR, show_forecast_ms,
+			set_forecast_ms, 0),
+	SENSOR_ATTR(forecast_max_lead, S_IRUGO | S_IWUSR,
+			show_forecast_max_lead, set_forecast_max_lead, 0),
+	SENSOR_ATTR(forecast, S_IRUGO, show_forecast, 0, 0),
 };
 
 static int therm_est_init_history(struct therm_estimator *est)
@@ -370,6 +504,10 @@ static int therm_est_init_history(struct therm_estimator *est)
 			dev->hist[j] = temp;
 	}
 
+	/* the forecast restarts once the estimate history refills */
+	est->nest = 0;
+	est->slope = 0;
+
 	return 0;
 }
 
@@ -418,6 +556,9 @@ static int __devinit therm_est_probe(struct platform_device *pdev)
 	est->polling_period = data->polling_period;
 	est->tc1 = data->tc1;
 	est->tc2 = data->tc2;
+	est->forecast_ms = data->forecast_ms;
+	est->forecast_max_lead = data->forecast_max_lead ? :
+		THERM_EST_FORECAST_MAX_LEAD;
 
 	/* initialize history */
 	therm_est_init_history(est);
@@ -49,6 +49,22 @@ struct therm_fan_estimator {
 	int active_trip_temps[MAX_ACTIVE_STATES];
 	int active_hysteresis[MAX_ACTIVE_STATES];
 	int active_trip_temps_hyst[(MAX_ACTIVE_STATES << 1) + 1];
+
+	/*
+	 * Power feed-forward: the platform power estimate is turned into a
+	 * temperature lead that is added to the estimate before the trips
+	 * are checked, so the fan spins up as a high power state starts
+	 * rather than once the heat reaches the sensors. The lead follows
+	 * power increases at once and decays slowly on drops.
+	 */
+	int (*get_power)(void *, long *);
+	void *power_data;
+	long power_coeff;
+	long power_max_lead;
+	long power_decay;
+	long power_mw;
+	long power_lead;
+	long sensed_temp;
 };
 
 
@@ -63,6 +79,20 @@ static void fan_set_trip_temp_hyst(struct therm_fan_estimator *est, int trip,
 						trip_temp - hyst_temp;
 }
 
+static void therm_fan_est_power_update(struct therm_fan_estimator *est)
+{
+	long mw, lead;
+
+	if (!est->get_power || est->get_power(est->power_data, &mw))
+		mw = 0;
+
+	est->power_mw = mw;
+	lead = clamp(mw * est->power_coeff / 1000, 0L, est->power_max_lead);
+	if (lead < est->power_lead)
+		lead = max(lead, est->power_lead * est->power_decay / 100);
+	est->power_lead = lead;
+}
+
 static void therm_fan_est_work_func(struct work_struct *work)
 {
 	int i, j, index, trip_index, sum = 0;
@@ -88,7 +118,9 @@ static void therm_fan_est_work_func(struct work_struct *work)
 		}
 	}
 
-	est->cur_temp = sum / 100 + est->toffset;
+	est->sensed_temp = sum / 100 + est->toffset;
+	therm_fan_est_power_update(est);
+	est->cur_temp = est->sensed_temp + est->power_lead;
 
 	for (trip_index = 0;
 		trip_index < ((MAX_ACTIVE_STATES << 1) + 1); trip_index++) {
@@ -313,10 +345,49 @@ static ssize_t show_temps(struct device *dev,
 	return strlen(buf);
 }
 
+static ssize_t show_power_coeff(struct device *dev,
+				struct device_attribute *da,
+				char *buf)
+{
+	struct therm_fan_estimator *est = dev_get_drvdata(dev);
+
+	snprintf(buf, PAGE_SIZE, "%ld\n", est->power_coeff);
+	return strlen(buf);
+}
+
+static ssize_t set_power_coeff(struct device *dev,
+				struct device_attribute *da,
+				const char *buf, size_t count)
+{
+	struct therm_fan_estimator *est = dev_get_drvdata(dev);
+	long coeff;
+
+	if (kstrtol(buf, 0, &coeff) || (coeff < 0))
+		return -EINVAL;
+
+	est->power_coeff = coeff;
+
+	return count;
+}
+
+static ssize_t show_power(struct device *dev,
+				struct device_attribute *da,
+				char *buf)
+{
+	struct therm_fan_estimator *est = dev_get_drvdata(dev);
+
+	snprintf(buf, PAGE_SIZE, "power %ld mW sensed %ld lead %ld\n",
+		 est->power_mw, est->sensed_temp, est->power_lead);
+	return strlen(buf);
+}
+
 static struct sensor_device_attribute therm_fan_est_nodes[] = {
 	SENSOR_ATTR(coeff, S_IRUGO | S_IWUSR, show_coeff, set_coeff, 0),
 	SENSOR_ATTR(offset, S_IRUGO | S_IWUSR, show_offset, set_offset, 0),
 	SENSOR_ATTR(temps, S_IRUGO, show_temps, 0, 0),
+	SENSOR_ATTR(power_coeff, S_IRUGO | S_IWUSR, show_power_coeff,
+			set_power_coeff, 0),
+	SENSOR_ATTR(power, S_IRUGO, show_power, 0, 0),
 };
 
 static int __devinit therm_fan_est_probe(struct platform_device *pdev)
@@ -340,6 +411,11 @@ static int __devinit therm_fan_est_probe(struct platform_device *pdev)
 	est->ndevs = data->ndevs;
 	est->toffset = data->toffset;
 	est->polling_period = data->polling_period;
+	est->get_power = data->get_power;
+	est->power_data = data->power_data;
+	est->power_coeff = data->power_coeff;
+	est->power_max_lead = data->power_max_lead;
+	est->power_decay = data->power_decay;
 
 	for (i = 0; i < MAX_ACTIVE_STATES; i++) {
 		est->active_trip_temps[i] = data->active_trip_temps[i];
@@ -413,6 +489,7 @@ static int therm_fan_est_suspend(struct platform_device *pdev,
 	pr_info("therm-fan-est: %s, cur_temp:%ld", __func__, est->cur_temp);
 	cancel_delayed_work(&est->therm_fan_est_work);
 	est->current_trip_index = 0;
+	est->power_lead = 0;
 
 	return 0;
 }
@@ -34,6 +34,9 @@
 #include <linux/delay.h>
 #include <linux/capability.h>
 #include <linux/compat.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 
 #include <linux/mmc/ioctl.h>
 #include <linux/mmc/card.h>
@@ -87,6 +90,34 @@ static DECLARE_BITMAP(name_use, 256);
 #define PACKED_CMD_RD		0x01
 #define PACKED_CMD_WR		0x02
 
+/*
+ * Packing thresholds. A packed read costs an extra header write, so it
+ * only pays off with more requests queued behind it than a packed write
+ * needs. A request that already carries a large share of the maximum
+ * transfer is bandwidth bound and gains nothing from being packed. After
+ * a packed command fails, packing backs off for a number of candidate
+ * requests that doubles with each consecutive failure.
+ */
+#define PACKED_WR_MIN_DEPTH	2
+#define PACKED_RD_MIN_DEPTH	3
+#define PACKED_LARGE_SHIFT	2	/* 1/4 of max_blk_count */
+#define PACKED_BACKOFF_MIN	16
+#define PACKED_BACKOFF_MAX	1024
+
+struct mmc_blk_packed_stats {
+	unsigned int	cmds[2];	/* packed commands, per direction */
+	unsigned int	reqs[2];	/* requests carried by them */
+	unsigned int	unpacked[2];	/* requests issued on their own */
+	unsigned int	skip_depth;	/* too few requests queued */
+	unsigned int	skip_large;	/* request too large to pack */
+	unsigned int	skip_backoff;	/* backing off after failures */
+	unsigned int	cut_urgent;	/* write packing cut short for a read */
+	unsigned int	failures;	/* packed commands that failed */
+	unsigned int	fail_idx;	/* failures pinned to one entry */
+	u64		bytes[2];	/* completed packed data */
+	u64		us[2];		/* time taken to complete it */
+};
+
 
 struct mmc_blk_data {
 	spinlock_t	lock;
@@ -117,6 +148,11 @@ struct mmc_blk_data {
 	struct device_attribute force_ro;
 	struct device_attribute power_ro_lock;
 	int	area_type;
+
+	struct mmc_blk_packed_stats packed_stats;
+	unsigned int	packed_backoff;		/* candidates left to skip */
+	unsigned int	packed_backoff_len;	/* next backoff length */
+	struct dentry	*packed_dentry;
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -1145,8 +1181,12 @@ static int mmc_blk_packed_err_check(struct mmc_card *card,
 				 EXT_CSD_PACKED_GENERIC_ERROR)) {
 			if (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
 					EXT_CSD_PACKED_INDEXED_ERROR) {
+				struct mmc_blk_data *md =
+					req->rq_disk->private_data;
+
 				mq_rq->packed_fail_idx =
 					ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] - 1;
+				md->packed_stats.fail_idx++;
 				return MMC_BLK_PARTIAL;
 			}
 		}
@@ -1345,6 +1385,8 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 	bool en_rel_wr = card->ext_csd.rel_param & EXT_CSD_WR_REL_PARAM_EN;
 	unsigned int req_sectors = 0, phys_segments = 0;
 	unsigned int max_blk_count, max_phys_segs;
+	unsigned int large_sectors, min_depth;
+	int dir = rq_data_dir(cur);
 	u8 put_back = 0;
 	u8 max_packed_rw = 0;
 	u8 reqs = 0;
@@ -1355,7 +1397,7 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 			!card->ext_csd.packed_event_en)
 		goto no_packed;
 
-	if (rq_data_dir(cur) == READ)
+	if (dir == READ)
 		max_packed_rw = card->ext_csd.max_packed_reads;
 	else
 		max_packed_rw = card->ext_csd.max_packed_writes;
@@ -1369,11 +1411,34 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 		goto no_packed;
 	}
 
+	if (md->packed_backoff) {
+		md->packed_backoff--;
+		md->packed_stats.skip_backoff++;
+		goto no_packed;
+	}
+
+	/*
+	 * Only look for partners when enough requests are queued in the
+	 * elevator. Pulling out a lone request early only takes it away
+	 * from the scheduler's merging.
+	 */
+	min_depth = dir == READ ? PACKED_RD_MIN_DEPTH : PACKED_WR_MIN_DEPTH;
+	if (q->nr_sorted + 1 < min_depth) {
+		md->packed_stats.skip_depth++;
+		goto no_packed;
+	}
+
 	max_blk_count = min(card->host->max_blk_count,
 			card->host->max_req_size >> 9);
 	if (unlikely(max_blk_count > 0xffff))
 		max_blk_count = 0xffff;
 
+	large_sectors = max_blk_count >> PACKED_LARGE_SHIFT;
+	if (blk_rq_sectors(cur) >= large_sectors) {
+		md->packed_stats.skip_large++;
+		goto no_packed;
+	}
+
 	max_phys_segs = queue_max_segments(q);
 	req_sectors += blk_rq_sectors(cur);
 	phys_segments += req->nr_phys_segments;
@@ -1385,6 +1450,16 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 
 	while (reqs < max_packed_rw - 1) {
 		spin_lock_irq(q->queue_lock);
+		/*
+		 * Do not pull more writes ahead of a read the elevator
+		 * wants out urgently; the read goes next instead of
+		 * waiting for the whole packed write.
+		 */
+		if (dir == WRITE && elv_is_urgent(q)) {
+			spin_unlock_irq(q->queue_lock);
+			md->packed_stats.cut_urgent++;
+			break;
+		}
 		next = blk_fetch_request(q);
 		spin_unlock_irq(q->queue_lock);
 		if (!next)
@@ -1396,7 +1471,8 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 			break;
 		}
 
-		if (rq_data_dir(cur) != rq_data_dir(next)) {
+		if (rq_data_dir(cur) != rq_data_dir(next) ||
+				blk_rq_sectors(next) >= large_sectors) {
 			put_back = 1;
 			break;
 		}
@@ -1434,15 +1510,47 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 	if (reqs > 0) {
 		list_add(&req->queuelist, &mq->mqrq_cur->packed_list);
 		mq->mqrq_cur->packed_num = ++reqs;
+		md->packed_stats.cmds[dir]++;
+		md->packed_stats.reqs[dir] += reqs;
 		return reqs;
 	}
 
 no_packed:
+	md->packed_stats.unpacked[rq_data_dir(req)]++;
 	mq->mqrq_cur->packed_cmd = MMC_PACKED_NONE;
 	mq->mqrq_cur->packed_num = 0;
 	return 0;
 }
 
+/*
+ * Account a packed command that completed, successfully or not, and
+ * adjust the failure backoff.
+ */
+static void mmc_blk_packed_account(struct mmc_blk_data *md,
+				   struct mmc_queue_req *mq_rq,
+				   enum mmc_blk_status status)
+{
+	struct mmc_blk_packed_stats *stats = &md->packed_stats;
+	int dir = rq_data_dir(mq_rq->req);
+	s64 us;
+
+	if (status != MMC_BLK_SUCCESS) {
+		stats->failures++;
+		md->packed_backoff = max(md->packed_backoff_len,
+					 (unsigned int)PACKED_BACKOFF_MIN);
+		md->packed_backoff_len = min(md->packed_backoff * 2,
+					     (unsigned int)PACKED_BACKOFF_MAX);
+		return;
+	}
+
+	md->packed_backoff_len = PACKED_BACKOFF_MIN;
+	us = ktime_us_delta(ktime_get(), mq_rq->packed_start);
+	if (us > 0) {
+		stats->bytes[dir] += (u64)mq_rq->packed_blocks << 9;
+		stats->us[dir] += us;
+	}
+}
+
 static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
 			       struct mmc_card *card,
 			       struct mmc_queue *mq,
@@ -1460,6 +1568,7 @@ static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
 		MMC_PACKED_WR_HDR : MMC_PACKED_WRITE;
 	mqrq->packed_blocks = 0;
 	mqrq->packed_fail_idx = -1;
+	mqrq->packed_start = ktime_get();
 
 	memset(packed_cmd_hdr, 0, sizeof(mqrq->packed_cmd_hdr));
 	packed_cmd_hdr[0] = (reqs << 16) |
@@ -1653,6 +1762,9 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		type = rq_data_dir(req) == READ ? MMC_BLK_READ : MMC_BLK_WRITE;
 		mmc_queue_bounce_post(mq_rq);
 
+		if (mq_rq->packed_cmd != MMC_PACKED_NONE)
+			mmc_blk_packed_account(md, mq_rq, status);
+
 		switch (status) {
 		case MMC_BLK_SUCCESS:
 		case MMC_BLK_PARTIAL:
@@ -1674,15 +1786,15 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 						break;
 					}
 					list_del_init(&prq->queuelist);
-					ret = blk_end_request(prq,
-						0, blk_rq_bytes(prq));
+					ret = mmc_queue_end_request(mq, prq,
+						blk_rq_bytes(prq));
 					i++;
 				}
 				if (idx == -1)
 					mq_rq->packed_num = 0;
 				break;
 			} else {
-				ret = blk_end_request(req, 0,
+				ret = mmc_queue_end_request(mq, req,
 						brq->data.bytes_xfered);
 			}
 			/*
@@ -1765,8 +1877,10 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		}
 	} while (ret);
 
-	if (brq->cmd.resp[0] & R1_URGENT_BKOPS)
+	if (brq->cmd.resp[0] & R1_URGENT_BKOPS) {
 		mmc_card_set_need_bkops(card);
+		card->bkops_stats.urgent++;
+	}
 
 snd_packed_rd:
         if (mq->mqrq_cur->packed_cmd == MMC_PACKED_WR_HDR) {
@@ -1830,6 +1944,17 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		/* claim host only for the first request */
 		mmc_claim_host(card->host);
 
+	if (req) {
+		card->host->queue_depth = mq->queue->nr_sorted;
+		mmc_bkops_idle_cancel(card);
+		/*
+		 * Abort any current bk ops of eMMC card by issuing HPI,
+		 * before the partition switch or any other command.
+		 */
+		if (mmc_card_mmc(card) && mmc_card_doing_bkops(card))
+			mmc_interrupt_hpi(card);
+	}
+
 	ret = mmc_blk_part_switch(card, md);
 	if (ret) {
 		if (req) {
@@ -1853,10 +1978,6 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			mmc_blk_issue_rw_rq(mq, NULL);
 		ret = mmc_blk_issue_flush(mq, req);
 	} else {
-		/* Abort any current bk ops of eMMC card by issuing HPI */
-		if (mmc_card_mmc(mq->card) && mmc_card_doing_bkops(mq->card))
-			mmc_interrupt_hpi(mq->card);
-
 		ret = mmc_blk_issue_rw_rq(mq, req);
 	}
 
@@ -1972,6 +2093,15 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 	     card->ext_csd.rel_sectors)) {
 		md->flags |= MMC_BLK_REL_WR;
 		blk_queue_flush(md->queue.queue, REQ_FLUSH | REQ_FUA);
+	} else if (mmc_card_mmc(card) &&
+		   (card->host->caps2 & MMC_CAP2_CACHE_CTRL) &&
+		   card->ext_csd.cache_size > 0 &&
+		   (card->ext_csd.cache_ctrl & 1)) {
+		/*
+		 * Without reliable write there is no FUA, but a volatile
+		 * cache still needs REQ_FLUSH so that barriers reach it.
+		 */
+		blk_queue_flush(md->queue.queue, REQ_FLUSH);
 	}
 
 	return md;
@@ -2069,6 +2199,7 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 
 	if (md) {
 		card = md->queue.card;
+		debugfs_remove(md->packed_dentry);
 		if (md->disk->flags & GENHD_FL_UP) {
 			device_remove_file(disk_to_dev(md->disk), &md->force_ro);
 			if ((md->area_type & MMC_BLK_DATA_AREA_BOOT) &&
@@ -2100,6 +2231,73 @@ static void mmc_blk_remove_parts(struct mmc_card *card,
 	}
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int mmc_blk_packed_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_blk_data *md = s->private;
+	struct mmc_blk_packed_stats *stats = &md->packed_stats;
+	static const char * const dir_name[] = { "read", "write" };
+	int dir;
+
+	for (dir = READ; dir <= WRITE; dir++) {
+		unsigned int ratio = 0;
+		u64 kbps = 0;
+
+		if (stats->cmds[dir])
+			ratio = stats->reqs[dir] * 100 / stats->cmds[dir];
+		if (stats->us[dir])
+			kbps = div64_u64(stats->bytes[dir] * 1000,
+					 stats->us[dir]);
+
+		seq_printf(s, "%s: packed %u cmds %u reqs, unpacked %u reqs\n",
+			   dir_name[dir], stats->cmds[dir], stats->reqs[dir],
+			   stats->unpacked[dir]);
+		seq_printf(s, "%s: %u.%02u reqs/cmd, %llu kB/s packed\n",
+			   dir_name[dir], ratio / 100, ratio % 100, kbps);
+	}
+	seq_printf(s, "skipped: depth %u large %u backoff %u\n",
+		   stats->skip_depth, stats->skip_large, stats->skip_backoff);
+	seq_printf(s, "cut for urgent reads: %u\n", stats->cut_urgent);
+	seq_printf(s, "failures: %u (indexed %u), backoff %u\n",
+		   stats->failures, stats->fail_idx, md->packed_backoff);
+	return 0;
+}
+
+static int mmc_blk_packed_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_blk_packed_stats_show, inode->i_private);
+}
+
+static const struct file_operations mmc_blk_packed_stats_fops = {
+	.open		= mmc_blk_packed_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void mmc_blk_packed_debugfs_init(struct mmc_blk_data *md)
+{
+	struct mmc_card *card = md->queue.card;
+	char name[DISK_NAME_LEN + 8];
+
+	/*
+	 * The host directory outlives the card one, which is gone by the
+	 * time mmc_blk_remove_req() removes this file.
+	 */
+	if (!card->host->debugfs_root || !card->ext_csd.packed_event_en)
+		return;
+
+	snprintf(name, sizeof(name), "%s_packed", md->disk->disk_name);
+	md->packed_dentry = debugfs_create_file(name, S_IRUSR,
+			card->host->debugfs_root, md,
+			&mmc_blk_packed_stats_fops);
+}
+#else
+static inline void mmc_blk_packed_debugfs_init(struct mmc_blk_data *md)
+{
+}
+#endif
+
 static int mmc_add_disk(struct mmc_blk_data *md)
 {
 	int ret;
@@ -2135,6 +2333,7 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 		if (ret)
 			goto power_ro_lock_fail;
 	}
+	mmc_blk_packed_debugfs_init(md);
 	return ret;
 
 power_ro_lock_fail:
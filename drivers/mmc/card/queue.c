@@ -44,9 +44,48 @@ static int mmc_prep_request(struct request_queue *q, struct request *req)
 
 	req->cmd_flags |= REQ_DONTPREP;
 
+	/*
+	 * Only synchronous requests have someone waiting on the submitting
+	 * cpu. Writeback completes wherever the card finished it rather
+	 * than waking the flusher's cpu.
+	 */
+	if (!rq_is_sync(req))
+		req->cpu = -1;
+
 	return BLKPREP_OK;
 }
 
+static void mmc_softirq_done(struct request *req)
+{
+	blk_end_request_all(req, 0);
+}
+
+/**
+ * mmc_queue_end_request - complete transferred bytes of a request
+ * @mq: mmc queue
+ * @req: request
+ * @bytes: bytes transferred
+ *
+ * A request that is done in full is handed to the block softirq, which
+ * runs the completion on the cpu that submitted it (see rq_affinity)
+ * rather than in the queue thread. The waiter is then woken locally, and
+ * completions for one cpu that arrive together, such as the members of a
+ * packed command, are run in one softirq pass.
+ *
+ * Returns non-zero while part of @req remains, like blk_end_request().
+ */
+int mmc_queue_end_request(struct mmc_queue *mq, struct request *req,
+			  unsigned int bytes)
+{
+	if (bytes == blk_rq_bytes(req) &&
+	    test_bit(QUEUE_FLAG_SAME_COMP, &mq->queue->queue_flags)) {
+		blk_complete_request(req);
+		return 0;
+	}
+
+	return blk_end_request(req, 0, bytes);
+}
+
 static int mmc_queue_thread(void *d)
 {
 	struct mmc_queue *mq = d;
@@ -70,11 +109,16 @@ static int mmc_queue_thread(void *d)
 			mq->issue_fn(mq, req);
 		} else {
 			/*
-			 * Since the queue is empty, start synchronous
-			 * background ops if there is a request for it.
+			 * Since the queue is empty, start background ops if
+			 * there is a request for it, otherwise check for
+			 * pending ones once the queue has stayed idle. They
+			 * run asynchronously when HPI can stop them.
 			 */
 			if (mmc_card_need_bkops(mq->card))
-				mmc_bkops_start(mq->card, true);
+				mmc_bkops_start(mq->card,
+						!mq->card->ext_csd.hpi_en);
+			else
+				mmc_bkops_idle_schedule(mq->card);
 			if (kthread_should_stop()) {
 				set_current_state(TASK_RUNNING);
 				break;
@@ -191,6 +235,12 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
+	/*
+	 * The cpus share their cache, so plain rq_affinity would complete
+	 * everything on the queue thread's cpu. Steer to the submitter.
+	 */
+	blk_queue_softirq_done(mq->queue, mmc_softirq_done);
+	queue_flag_set_unlocked(QUEUE_FLAG_SAME_FORCE, mq->queue);
 	if (mmc_can_erase(card))
 		mmc_queue_setup_discard(mq->queue, card);
 
@@ -34,6 +34,7 @@ struct mmc_queue_req {
 	enum mmc_packed_cmd	packed_cmd;
 	int			packed_fail_idx;
 	u8			packed_num;
+	ktime_t			packed_start;
 };
 
 struct mmc_queue {
@@ -54,6 +55,8 @@ extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *,
 extern void mmc_cleanup_queue(struct mmc_queue *);
 extern void mmc_queue_suspend(struct mmc_queue *);
 extern void mmc_queue_resume(struct mmc_queue *);
+extern int mmc_queue_end_request(struct mmc_queue *, struct request *,
+				 unsigned int);
 
 extern unsigned int mmc_queue_map_sg(struct mmc_queue *,
 				     struct mmc_queue_req *);
@@ -262,6 +262,8 @@ struct mmc_card *mmc_alloc_card(struct mmc_host *host, struct device_type *type)
 	card->dev.release = mmc_release_card;
 	card->dev.type = type;
 
+	INIT_DELAYED_WORK(&card->bkops_idle, mmc_bkops_idle_work);
+
 	return card;
 }
 
@@ -364,6 +366,8 @@ void mmc_remove_card(struct mmc_card *card)
 		device_del(&card->dev);
 	}
 
+	/* The block queue is gone, so nothing can requeue the work */
+	cancel_delayed_work_sync(&card->bkops_idle);
 	put_device(&card->dev);
 }
 
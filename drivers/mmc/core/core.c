@@ -260,6 +260,8 @@ static int __mmc_start_req(struct mmc_host *host, struct mmc_request *mrq)
 		complete(&mrq->completion);
 		return -ENOMEDIUM;
 	}
+	if (host->card && mrq->data && (mrq->data->flags & MMC_DATA_WRITE))
+		mmc_card_set_cache_dirty(host->card);
 	mmc_start_request(host, mrq);
 	return 0;
 }
@@ -455,6 +457,8 @@ int mmc_bkops_start(struct mmc_card *card, bool is_synchronous)
 	if (err)
 		pr_err("%s: abort bk ops (%d error)\n",
 			mmc_hostname(card->host), err);
+	else
+		card->bkops_stats.started++;
 	if (card->ext_csd.refresh) {
 		do_gettimeofday(&after_time);
 		switch (after_time.tv_sec - before_time.tv_sec) {
@@ -496,6 +500,65 @@ static void mmc_bkops_work(struct work_struct *work)
 	mmc_bkops_start(card, true);
 }
 
+/*
+ * Runs once the block queue has been idle for MMC_BKOPS_IDLE_DELAY. If
+ * the card reports pending background work, start it asynchronously so
+ * that the next foreground request can stop it with HPI.
+ */
+void mmc_bkops_idle_work(struct work_struct *work)
+{
+	struct mmc_card *card = container_of(work, struct mmc_card,
+					     bkops_idle.work);
+	u8 ext_csd[512];
+	int level, err;
+
+	mmc_claim_host(card->host);
+	if (mmc_card_doing_bkops(card) || mmc_card_removed(card) ||
+	    mmc_card_is_sleep(card)) {
+		mmc_release_host(card->host);
+		return;
+	}
+	err = mmc_send_ext_csd(card, ext_csd);
+	mmc_release_host(card->host);
+	if (err)
+		return;
+
+	level = ext_csd[EXT_CSD_BKOPS_STATUS] & 0x3;
+	card->bkops_stats.level[level]++;
+	if (level || mmc_card_need_bkops(card))
+		mmc_bkops_start(card, false);
+}
+
+/**
+ *	mmc_bkops_idle_schedule - start BKOPS if the card stays idle
+ *	@card: the MMC card whose queue has run empty
+ *
+ *	Only cards with HPI get idle BKOPS, as nothing else can stop
+ *	them when foreground I/O arrives.
+ */
+void mmc_bkops_idle_schedule(struct mmc_card *card)
+{
+	if (!mmc_card_mmc(card) || !card->ext_csd.bk_ops_en ||
+	    !card->ext_csd.hpi_en || mmc_card_doing_bkops(card))
+		return;
+
+	mmc_schedule_delayed_work(&card->bkops_idle,
+				  msecs_to_jiffies(MMC_BKOPS_IDLE_DELAY));
+}
+EXPORT_SYMBOL(mmc_bkops_idle_schedule);
+
+/**
+ *	mmc_bkops_idle_cancel - foreground I/O arrived, drop idle BKOPS
+ *	@card: the MMC card
+ *
+ *	Must not wait for the work, the caller may hold the host.
+ */
+void mmc_bkops_idle_cancel(struct mmc_card *card)
+{
+	cancel_delayed_work(&card->bkops_idle);
+}
+EXPORT_SYMBOL(mmc_bkops_idle_cancel);
+
 static void mmc_refresh_work(struct work_struct *work)
 {
 	struct mmc_card *card = container_of(work, struct mmc_card, refresh);
@@ -553,6 +616,7 @@ int mmc_interrupt_hpi(struct mmc_card *card)
 	int err;
 	u32 status;
 	unsigned long flags;
+	bool bkops;
 
 	BUG_ON(!card);
 
@@ -562,6 +626,7 @@ int mmc_interrupt_hpi(struct mmc_card *card)
 	}
 
 	mmc_claim_host(card->host);
+	bkops = mmc_card_doing_bkops(card);
 	err = mmc_send_status(card, &status);
 	if (err) {
 		pr_err("%s: Get card status fail\n", mmc_hostname(card->host));
@@ -572,6 +637,8 @@ int mmc_interrupt_hpi(struct mmc_card *card)
 	 * If the card status is in PRG-state, we can send the HPI command.
 	 */
 	if (R1_CURRENT_STATE(status) == R1_STATE_PRG) {
+		if (bkops)
+			card->bkops_stats.hpi++;
 		do {
 			/*
 			 * We don't know when the HPI command will finish
@@ -590,8 +657,11 @@ int mmc_interrupt_hpi(struct mmc_card *card)
 			if (err)
 				break;
 		} while (R1_CURRENT_STATE(status) == R1_STATE_PRG);
-	} else
+	} else {
 		pr_debug("%s: Left prg-state\n", mmc_hostname(card->host));
+		if (bkops)
+			card->bkops_stats.completed++;
+	}
 
 out:
 	spin_lock_irqsave(&card->host->lock, flags);
@@ -2435,11 +2505,24 @@ int mmc_flush_cache(struct mmc_card *card)
 	if (mmc_card_mmc(card) &&
 			(card->ext_csd.cache_size > 0) &&
 			(card->ext_csd.cache_ctrl & 1)) {
+		/*
+		 * Nothing has been written since the last flush, so the
+		 * cache holds no dirty data and the CMD6 can be skipped.
+		 * fsync heavy workloads issue many such back to back
+		 * flushes.
+		 */
+		if (!mmc_card_cache_dirty(card)) {
+			card->cache_flushes_skipped++;
+			return err;
+		}
 		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
 				EXT_CSD_FLUSH_CACHE, 1, 0);
 		if (err)
 			pr_err("%s: cache flush error %d\n",
 					mmc_hostname(card->host), err);
+		else
+			mmc_card_clr_cache_dirty(card);
+		card->cache_flushes++;
 	}
 
 	return err;
@@ -2498,6 +2581,8 @@ int mmc_suspend_host(struct mmc_host *host)
 	if (mmc_bus_needs_resume(host))
 		return 0;
 
+	if (host->card)
+		mmc_bkops_idle_cancel(host->card);
 	if (mmc_card_mmc(host->card) && mmc_card_doing_bkops(host->card))
 		mmc_interrupt_hpi(host->card);
 	mmc_card_clr_need_bkops(host->card);
@@ -28,6 +28,7 @@ struct mmc_bus_ops {
 };
 
 void mmc_attach_bus(struct mmc_host *host, const struct mmc_bus_ops *ops);
+void mmc_bkops_idle_work(struct work_struct *work);
 void mmc_detach_bus(struct mmc_host *host);
 
 void mmc_init_erase(struct mmc_card *card);
@@ -318,6 +318,33 @@ static const struct file_operations mmc_dbg_ext_csd_fops = {
 	.llseek		= default_llseek,
 };
 
+static int mmc_bkops_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_card *card = s->private;
+	struct mmc_bkops_stats *stats = &card->bkops_stats;
+
+	/* BKOPS_STATUS: 0 none, 1 non critical, 2 perf impacted, 3 critical */
+	seq_printf(s, "level: %u %u %u %u\n", stats->level[0],
+		   stats->level[1], stats->level[2], stats->level[3]);
+	seq_printf(s, "urgent: %u\n", stats->urgent);
+	seq_printf(s, "started: %u\n", stats->started);
+	seq_printf(s, "stopped_by_hpi: %u\n", stats->hpi);
+	seq_printf(s, "completed: %u\n", stats->completed);
+	return 0;
+}
+
+static int mmc_bkops_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_bkops_stats_show, inode->i_private);
+}
+
+static const struct file_operations mmc_dbg_bkops_stats_fops = {
+	.open		= mmc_bkops_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void mmc_add_card_debugfs(struct mmc_card *card)
 {
 	struct mmc_host	*host = card->host;
@@ -350,6 +377,20 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 					&mmc_dbg_ext_csd_fops))
 			goto err;
 
+	if (mmc_card_mmc(card) && card->ext_csd.bk_ops_en)
+		if (!debugfs_create_file("bkops_stats", S_IRUSR, root, card,
+					&mmc_dbg_bkops_stats_fops))
+			goto err;
+
+	if (mmc_card_mmc(card) && card->ext_csd.cache_size > 0) {
+		if (!debugfs_create_u32("cache_flushes", S_IRUSR, root,
+					&card->cache_flushes))
+			goto err;
+		if (!debugfs_create_u32("cache_flushes_skipped", S_IRUSR, root,
+					&card->cache_flushes_skipped))
+			goto err;
+	}
+
 	return;
 
 err:
@@ -610,14 +610,18 @@ int mmc_send_bk_ops_cmd(struct mmc_card *card, bool is_synchronous)
 	if (err)
 		return err;
 
-	/* Must check status to be sure of no errors */
+	/*
+	 * Must check status to be sure of no errors. Asynchronous BKOPS
+	 * leave the card in PRG state until they finish or are stopped
+	 * with HPI, so only wait for that in the synchronous case.
+	 */
 	do {
 		err = mmc_send_status(card, &status);
 		if (err)
 			return err;
 		if (card->host->caps & MMC_CAP_WAIT_WHILE_BUSY)
 			break;
-	} while (R1_CURRENT_STATE(status) == 7);
+	} while (is_synchronous && R1_CURRENT_STATE(status) == 7);
 
 	if (status & 0xFDFFA000)
 		printk(KERN_ERR "%s: unexpected status %#x after "
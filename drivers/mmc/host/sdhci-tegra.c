@@ -37,6 +37,9 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/reboot.h>
+#include <linux/devfreq.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #include <mach/gpio-tegra.h>
 #include <mach/sdhci.h>
@@ -46,6 +49,9 @@
 
 #include "sdhci-pltfm.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/sdhci_tegra.h>
+
 #define SDHCI_VNDR_CLK_CTRL	0x100
 #define SDHCI_VNDR_CLK_CTRL_SDMMC_CLK	0x1
 #define SDHCI_VNDR_CLK_CTRL_PADPIPE_CLKEN_OVERRIDE	0x8
@@ -98,6 +104,13 @@
 #define TUNING_FREQ_COUNT	3
 #define TUNING_VOLTAGES_COUNT	2
 #define TUNING_RETRIES	1
+#define TUNING_CACHE_SIZE	4
+
+/* SDMMC clock scaling on I/O load */
+#define SDHCI_SCALE_POLL_MS		100
+#define SDHCI_SCALE_UPTHRESHOLD		60
+#define SDHCI_SCALE_DOWNDIFFERENTIAL	20
+#define SDHCI_SCALE_MIN_DIV		4
 
 struct sdhci_host *sdhci_host_for_sdio;
 
@@ -229,6 +242,42 @@ struct tegra_tuning_data {
 	struct tap_window_data	*tap_data[TUNING_VOLTAGES_COUNT];
 };
 
+/*
+ * Tap value a full scan found for a controller clock rate. The scan already
+ * picks a tap that passes across the core voltage range, so the clock is
+ * the key.
+ */
+struct tegra_tuning_cache {
+	unsigned int	clock;
+	unsigned int	tap_value;
+	bool		valid;
+};
+
+/*
+ * Per slot request latency, from sdhci_request() to the completion
+ * tasklet, in log2 buckets starting below 64us. Queue depth is what the
+ * block driver had waiting behind each data request.
+ */
+enum {
+	SDHCI_LAT_READ,
+	SDHCI_LAT_WRITE,
+	SDHCI_LAT_FLUSH,
+	SDHCI_LAT_DISCARD,
+	SDHCI_LAT_OTHER,
+	SDHCI_LAT_TYPES,
+};
+
+#define SDHCI_LAT_BUCKETS	16	/* last one is 1s and above */
+#define SDHCI_LAT_MIN_SHIFT	6	/* first bucket is below 64us */
+#define SDHCI_DEPTH_BUCKETS	7	/* 0, 1, 2, 3-4, 5-8, 9-16, 17+ */
+
+struct sdhci_tegra_lat_stats {
+	u32	hist[SDHCI_LAT_TYPES][SDHCI_LAT_BUCKETS];
+	u64	total_us[SDHCI_LAT_TYPES];
+	u32	max_us[SDHCI_LAT_TYPES];
+	u32	depth[SDHCI_DEPTH_BUCKETS];
+};
+
 struct sdhci_tegra {
 	const struct tegra_sdhci_platform_data *plat;
 	const struct sdhci_tegra_soc_data *soc_data;
@@ -272,6 +321,33 @@ struct sdhci_tegra {
 #define TUNING_STATUS_RETUNE	2
 	/* Freq tuning information for each sampling clock freq */
 	struct tegra_tuning_data tuning_data;
+	/* Tuned tap values, verified before falling back to a full scan */
+	struct tegra_tuning_cache tuning_cache[TUNING_CACHE_SIZE];
+	unsigned int tuning_cache_next;
+	/*
+	 * I/O load clock scaling. A request is busy from sdhci_request()
+	 * until its tasklet completes it; devfreq polls the busy fraction
+	 * and picks a cap for the controller clock, which the next request
+	 * applies while the bus is idle.
+	 */
+	struct devfreq *devfreq;
+	struct devfreq_dev_profile devfreq_profile;
+#ifdef CONFIG_DEVFREQ_GOV_SIMPLE_ONDEMAND
+	struct devfreq_simple_ondemand_data ondemand_data;
+#endif
+	spinlock_t scale_lock;
+	bool scale_busy;
+	ktime_t scale_last_event;
+	u64 scale_busy_us;
+	u64 scale_total_us;
+	unsigned int scale_load;	/* percent, last polling window */
+	unsigned long full_rate;	/* controller rate without a cap */
+	unsigned long scale_rate;	/* cap in use, 0 for none */
+	unsigned long scale_target;	/* cap devfreq asked for */
+	unsigned int scale_transitions;
+	/* request latency histograms, see struct sdhci_tegra_lat_stats */
+	struct sdhci_tegra_lat_stats lat_stats;
+	ktime_t req_start;
 	bool set_tuning_override;
 	bool is_parent_pllc;
 	struct notifier_block reboot_notify;
@@ -608,6 +684,8 @@ static irqreturn_t carddetect_irq(int irq, void *data)
 		 * a card is inserted.
 		 */
 		tegra_host->tuning_status = TUNING_STATUS_RETUNE;
+		memset(tegra_host->tuning_cache, 0,
+		       sizeof(tegra_host->tuning_cache));
 	}
 
 	tasklet_schedule(&sdhost->card_tasklet);
@@ -755,6 +833,15 @@ static void tegra_sdhci_set_clk_rate(struct sdhci_host *sdhci,
 		(clk_rate > tegra_host->max_clk_limit))
 		clk_rate = tegra_host->max_clk_limit;
 
+	/*
+	 * The card clock divider stays as the full rate set it, so a lower
+	 * controller rate slows the card clock by the same factor.
+	 */
+	tegra_host->full_rate = clk_rate;
+	if (tegra_host->scale_rate && clk_rate > tegra_host->scale_rate)
+		clk_rate = max_t(unsigned int, tegra_host->scale_rate,
+				 tegra_sdhost_min_freq);
+
 	tegra_sdhci_clock_set_parent(sdhci, clk_rate);
 	clk_set_rate(pltfm_host->clk, clk_rate);
 	sdhci->max_clk = clk_get_rate(pltfm_host->clk);
@@ -1097,6 +1184,10 @@ static int sdhci_tegra_sd_error_stats(struct sdhci_host *host, u32 int_status)
 	struct sdhci_tegra *tegra_host = pltfm_host->priv;
 	struct sdhci_tegra_sd_stats *head;
 
+	if (int_status & SDHCI_INT_ERROR_MASK)
+		trace_sdhci_tegra_error(mmc_hostname(host->mmc),
+			host->mrq ? host->mrq->cmd->opcode : 0, int_status);
+
 	head = tegra_host->sd_stat_head;
 	if (int_status & SDHCI_INT_DATA_CRC)
 		head->data_crc_count++;
@@ -1551,6 +1642,66 @@ out:
 	return err;
 }
 
+static struct tegra_tuning_cache *sdhci_tegra_tuning_cache_find(
+	struct sdhci_tegra *tegra_host, unsigned int clock)
+{
+	int i;
+
+	for (i = 0; i < TUNING_CACHE_SIZE; i++)
+		if (tegra_host->tuning_cache[i].valid &&
+		    tegra_host->tuning_cache[i].clock == clock)
+			return &tegra_host->tuning_cache[i];
+	return NULL;
+}
+
+static void sdhci_tegra_tuning_cache_store(struct sdhci_tegra *tegra_host,
+	unsigned int clock, unsigned int tap_value)
+{
+	unsigned int *next = &tegra_host->tuning_cache_next;
+	struct tegra_tuning_cache *entry;
+
+	entry = sdhci_tegra_tuning_cache_find(tegra_host, clock);
+	if (!entry) {
+		entry = &tegra_host->tuning_cache[*next];
+		*next = (*next + 1) % TUNING_CACHE_SIZE;
+	}
+	entry->clock = clock;
+	entry->tap_value = tap_value;
+	entry->valid = true;
+}
+
+/*
+ * Retuning after resume or after the card clock moved back to a rate that
+ * was tuned before: one tuning command at the cached tap tells whether it
+ * still holds, instead of scanning all 256 taps again.
+ */
+static bool sdhci_tegra_verify_cached_tap(struct sdhci_host *sdhci)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
+	struct sdhci_tegra *tegra_host = pltfm_host->priv;
+	struct tegra_tuning_cache *entry;
+
+	if (tegra_host->set_tuning_override)
+		return false;
+
+	entry = sdhci_tegra_tuning_cache_find(tegra_host, sdhci->max_clk);
+	if (!entry)
+		return false;
+
+	sdhci_tegra_set_tap_delay(sdhci, entry->tap_value);
+	if (sdhci_tegra_run_frequency_tuning(sdhci)) {
+		dev_info(mmc_dev(sdhci->mmc),
+			"Cached tap value %d failed at %uHz, retuning\n",
+			entry->tap_value, entry->clock);
+		entry->valid = false;
+		return false;
+	}
+
+	tegra_host->tuning_data.best_tap_value = entry->tap_value;
+	tegra_host->tuning_status = TUNING_STATUS_DONE;
+	return true;
+}
+
 static int sdhci_tegra_execute_tuning(struct sdhci_host *sdhci, u32 opcode)
 {
 	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
@@ -1603,6 +1754,11 @@ static int sdhci_tegra_execute_tuning(struct sdhci_host *sdhci, u32 opcode)
 		freq_band = TUNING_LOW_FREQ;
 	tuning_data = &tegra_host->tuning_data;
 
+	if (sdhci_tegra_verify_cached_tap(sdhci)) {
+		err = 0;
+		goto out_restore;
+	}
+
 	/*
 	 * If tuning is already done and retune request is not set, then skip
 	 * best tap value calculation and use the old best tap value.
@@ -1784,10 +1940,14 @@ set_best_tap:
 		tegra_host->tuning_status = TUNING_STATUS_RETUNE;
 	} else {
 		if (tuning_data->nominal_vcore_tuning_done &&
-			tuning_data->overide_vcore_tuning_done)
+			tuning_data->overide_vcore_tuning_done) {
 			tegra_host->tuning_status = TUNING_STATUS_DONE;
-		else
+			sdhci_tegra_tuning_cache_store(tegra_host,
+				sdhci->max_clk,
+				tuning_data->best_tap_value);
+		} else {
 			tegra_host->tuning_status = TUNING_STATUS_RETUNE;
+		}
 	}
 
 out:
@@ -1816,6 +1976,7 @@ out:
 			10 * HZ);
 	}
 
+out_restore:
 	/* Enable interrupts. Enable full range for core voltage */
 	sdhci_writel(sdhci, ier, SDHCI_INT_ENABLE);
 	sdhci_writel(sdhci, ier, SDHCI_SIGNAL_ENABLE);
@@ -1908,6 +2069,79 @@ static void tegra_sdhci_post_resume(struct sdhci_host *sdhci)
 	}
 }
 
+static int show_latency_stats(struct seq_file *s, void *data)
+{
+	static const char * const type_name[SDHCI_LAT_TYPES] = {
+		"read", "write", "flush", "discard", "other",
+	};
+	static const char * const depth_name[SDHCI_DEPTH_BUCKETS] = {
+		"0", "1", "2", "3-4", "5-8", "9-16", "17+",
+	};
+	struct sdhci_host *host = s->private;
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_tegra *tegra_host = pltfm_host->priv;
+	struct sdhci_tegra_lat_stats *stats = &tegra_host->lat_stats;
+	int i, t;
+
+	seq_printf(s, "%10s", "<us");
+	for (t = 0; t < SDHCI_LAT_TYPES; t++)
+		seq_printf(s, " %10s", type_name[t]);
+	seq_printf(s, "\n");
+
+	for (i = 0; i < SDHCI_LAT_BUCKETS; i++) {
+		if (i < SDHCI_LAT_BUCKETS - 1)
+			seq_printf(s, "%10u", 1U << (SDHCI_LAT_MIN_SHIFT + i));
+		else
+			seq_printf(s, "%10s", "inf");
+		for (t = 0; t < SDHCI_LAT_TYPES; t++)
+			seq_printf(s, " %10u", stats->hist[t][i]);
+		seq_printf(s, "\n");
+	}
+
+	seq_printf(s, "%10s", "avg_us");
+	for (t = 0; t < SDHCI_LAT_TYPES; t++) {
+		u32 n = 0;
+
+		for (i = 0; i < SDHCI_LAT_BUCKETS; i++)
+			n += stats->hist[t][i];
+		seq_printf(s, " %10llu",
+			   n ? div_u64(stats->total_us[t], n) : 0);
+	}
+	seq_printf(s, "\n%10s", "max_us");
+	for (t = 0; t < SDHCI_LAT_TYPES; t++)
+		seq_printf(s, " %10u", stats->max_us[t]);
+	seq_printf(s, "\n\nQueueDepth:\n");
+	for (i = 0; i < SDHCI_DEPTH_BUCKETS; i++)
+		seq_printf(s, "%10s %10u\n", depth_name[i], stats->depth[i]);
+	return 0;
+}
+
+static int sdhci_latency_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_latency_stats, inode->i_private);
+}
+
+/* any write clears the histograms */
+static ssize_t sdhci_latency_stats_write(struct file *file,
+	const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct sdhci_host *host = s->private;
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_tegra *tegra_host = pltfm_host->priv;
+
+	memset(&tegra_host->lat_stats, 0, sizeof(tegra_host->lat_stats));
+	return count;
+}
+
+static const struct file_operations sdhci_latency_stats_fops = {
+	.open		= sdhci_latency_stats_open,
+	.read		= seq_read,
+	.write		= sdhci_latency_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void sdhci_tegra_error_stats_debugfs(struct sdhci_host *host)
 {
 	struct dentry *root;
@@ -1926,6 +2160,9 @@ static void sdhci_tegra_error_stats_debugfs(struct sdhci_host *host)
 	if (!debugfs_create_file("error_stats", S_IRUSR, root, host,
 				&sdhci_host_fops))
 		goto err_node;
+	if (!debugfs_create_file("latency_stats", S_IRUSR | S_IWUSR, root,
+				host, &sdhci_latency_stats_fops))
+		goto err_node;
 	return;
 
 err_node:
@@ -1936,6 +2173,252 @@ err_root:
 	return;
 }
 
+/* fold the time since the last event into the busy/total counters */
+static void tegra_sdhci_scale_account_locked(struct sdhci_tegra *tegra_host)
+{
+	ktime_t now = ktime_get();
+	s64 delta = ktime_us_delta(now, tegra_host->scale_last_event);
+
+	if (delta > 0) {
+		tegra_host->scale_total_us += delta;
+		if (tegra_host->scale_busy)
+			tegra_host->scale_busy_us += delta;
+	}
+	tegra_host->scale_last_event = now;
+}
+
+static void tegra_sdhci_scale_notify(struct sdhci_tegra *tegra_host,
+	bool busy)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tegra_host->scale_lock, flags);
+	if (tegra_host->scale_busy != busy) {
+		tegra_sdhci_scale_account_locked(tegra_host);
+		tegra_host->scale_busy = busy;
+	}
+	spin_unlock_irqrestore(&tegra_host->scale_lock, flags);
+}
+
+static int tegra_sdhci_lat_type(struct mmc_request *mrq)
+{
+	switch (mrq->cmd->opcode) {
+	case MMC_READ_SINGLE_BLOCK:
+	case MMC_READ_MULTIPLE_BLOCK:
+		return SDHCI_LAT_READ;
+	case MMC_WRITE_BLOCK:
+	case MMC_WRITE_MULTIPLE_BLOCK:
+		return SDHCI_LAT_WRITE;
+	case MMC_ERASE:
+		return SDHCI_LAT_DISCARD;
+	case MMC_SWITCH:
+		if (((mrq->cmd->arg >> 16) & 0xff) == EXT_CSD_FLUSH_CACHE)
+			return SDHCI_LAT_FLUSH;
+		break;
+	}
+	return SDHCI_LAT_OTHER;
+}
+
+static void tegra_sdhci_lat_account(struct sdhci_host *sdhci,
+				    struct mmc_request *mrq)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
+	struct sdhci_tegra *tegra_host = pltfm_host->priv;
+	struct sdhci_tegra_lat_stats *stats = &tegra_host->lat_stats;
+	unsigned int depth = sdhci->mmc->queue_depth;
+	int type = tegra_sdhci_lat_type(mrq);
+	s64 delta = ktime_us_delta(ktime_get(), tegra_host->req_start);
+	u32 us = clamp_t(s64, delta, 0, UINT_MAX);
+	int idx;
+
+	idx = min(fls(us >> SDHCI_LAT_MIN_SHIFT), SDHCI_LAT_BUCKETS - 1);
+	stats->hist[type][idx]++;
+	stats->total_us[type] += us;
+	stats->max_us[type] = max(stats->max_us[type], us);
+
+	if (type == SDHCI_LAT_READ || type == SDHCI_LAT_WRITE) {
+		idx = depth ? min(fls(depth - 1) + 1,
+				  SDHCI_DEPTH_BUCKETS - 1) : 0;
+		stats->depth[idx]++;
+	}
+
+	trace_sdhci_tegra_request(mmc_hostname(sdhci->mmc),
+		mrq->cmd->opcode, mrq->data ? mrq->data->blocks : 0,
+		depth, us);
+}
+
+static void tegra_sdhci_request_start(struct sdhci_host *sdhci,
+				      struct mmc_request *mrq)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
+	struct sdhci_tegra *tegra_host = pltfm_host->priv;
+	unsigned char timing = sdhci->mmc->ios.timing;
+
+	tegra_host->req_start = ktime_get();
+
+	if (!tegra_host->devfreq)
+		return;
+
+	tegra_sdhci_scale_notify(tegra_host, true);
+
+	if (tegra_host->scale_target == tegra_host->scale_rate ||
+	    !tegra_host->clk_enabled || !sdhci->clock)
+		return;
+
+	tegra_host->scale_rate = tegra_host->scale_target;
+	tegra_sdhci_set_clk_rate(sdhci, sdhci->clock);
+	tegra_host->scale_transitions++;
+
+	/* a tuned tap only holds for the clock it was tuned at */
+	if (timing == MMC_TIMING_UHS_SDR104 ||
+	    timing == MMC_TIMING_MMC_HS200 ||
+	    (timing == MMC_TIMING_UHS_SDR50 &&
+	     (sdhci->flags & SDHCI_SDR50_NEEDS_TUNING)))
+		sdhci->flags |= SDHCI_NEEDS_RETUNING;
+}
+
+static void tegra_sdhci_request_done(struct sdhci_host *sdhci,
+				     struct mmc_request *mrq)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
+	struct sdhci_tegra *tegra_host = pltfm_host->priv;
+
+	tegra_sdhci_lat_account(sdhci, mrq);
+
+	if (tegra_host->devfreq)
+		tegra_sdhci_scale_notify(tegra_host, false);
+}
+
+static int tegra_sdhci_scale_target(struct device *dev, unsigned long *freq,
+	u32 flags)
+{
+	struct sdhci_host *sdhci = dev_get_drvdata(dev);
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
+	struct sdhci_tegra *tegra_host = pltfm_host->priv;
+	unsigned long full = tegra_host->full_rate;
+	unsigned long min_rate, rate;
+
+	if (!full) {
+		*freq = 0;
+		return 0;
+	}
+
+	min_rate = max_t(unsigned long, full / SDHCI_SCALE_MIN_DIV,
+			 tegra_sdhost_min_freq);
+	rate = clamp(*freq, min(min_rate, full), full);
+	tegra_host->scale_target = rate < full ? rate : 0;
+
+	*freq = rate;
+	return 0;
+}
+
+static int tegra_sdhci_scale_get_dev_status(struct device *dev,
+	struct devfreq_dev_status *stat)
+{
+	struct sdhci_host *sdhci = dev_get_drvdata(dev);
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
+	struct sdhci_tegra *tegra_host = pltfm_host->priv;
+	unsigned long flags;
+
+	spin_lock_irqsave(&tegra_host->scale_lock, flags);
+	tegra_sdhci_scale_account_locked(tegra_host);
+	stat->busy_time = min_t(u64, tegra_host->scale_busy_us, ULONG_MAX);
+	stat->total_time = min_t(u64, tegra_host->scale_total_us, ULONG_MAX);
+	tegra_host->scale_busy_us = 0;
+	tegra_host->scale_total_us = 0;
+	spin_unlock_irqrestore(&tegra_host->scale_lock, flags);
+
+	tegra_host->scale_load = stat->total_time ? div64_u64(
+		(u64)stat->busy_time * 100, stat->total_time) : 0;
+
+	stat->current_frequency = tegra_host->scale_rate ?
+		tegra_host->scale_rate : tegra_host->full_rate;
+	stat->private_data = NULL;
+	return 0;
+}
+
+static int show_clk_scaling(struct seq_file *s, void *data)
+{
+	struct sdhci_host *host = s->private;
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_tegra *tegra_host = pltfm_host->priv;
+
+	seq_printf(s, "full_rate     %lu\n", tegra_host->full_rate);
+	seq_printf(s, "scaled_rate   %lu\n", tegra_host->scale_rate ?
+		   tegra_host->scale_rate : tegra_host->full_rate);
+	seq_printf(s, "load          %u%%\n", tegra_host->scale_load);
+	seq_printf(s, "transitions   %u\n", tegra_host->scale_transitions);
+	return 0;
+}
+
+static int sdhci_clk_scaling_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_clk_scaling, inode->i_private);
+}
+
+static const struct file_operations sdhci_clk_scaling_fops = {
+	.open		= sdhci_clk_scaling_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * Run the controller, and with it the card, slower during light I/O so
+ * that the core rail can drop, and at full rate once transfers keep the
+ * bus busy. The governor can be switched to performance in sysfs to keep
+ * the old always-full-speed behaviour.
+ */
+static void tegra_sdhci_scale_init(struct sdhci_host *host)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_tegra *tegra_host = pltfm_host->priv;
+	struct device *dev = mmc_dev(host->mmc);
+	struct devfreq *df;
+	void *gov_data = NULL;
+
+	spin_lock_init(&tegra_host->scale_lock);
+	tegra_host->scale_last_event = ktime_get();
+
+	tegra_host->devfreq_profile.initial_freq = ULONG_MAX;
+	tegra_host->devfreq_profile.polling_ms = SDHCI_SCALE_POLL_MS;
+	tegra_host->devfreq_profile.target = tegra_sdhci_scale_target;
+	tegra_host->devfreq_profile.get_dev_status =
+		tegra_sdhci_scale_get_dev_status;
+
+#ifdef CONFIG_DEVFREQ_GOV_SIMPLE_ONDEMAND
+	tegra_host->ondemand_data.upthreshold = SDHCI_SCALE_UPTHRESHOLD;
+	tegra_host->ondemand_data.downdifferential =
+		SDHCI_SCALE_DOWNDIFFERENTIAL;
+	gov_data = &tegra_host->ondemand_data;
+#endif
+
+	df = devfreq_add_device(dev, &tegra_host->devfreq_profile,
+				devfreq_simple_ondemand, gov_data);
+	if (IS_ERR_OR_NULL(df))
+		return;
+	tegra_host->devfreq = df;
+
+	if (host->debugfs_root)
+		debugfs_create_file("clk_scaling", S_IRUSR,
+				    host->debugfs_root, host,
+				    &sdhci_clk_scaling_fops);
+}
+
+static void tegra_sdhci_scale_deinit(struct sdhci_host *host)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_tegra *tegra_host = pltfm_host->priv;
+
+	if (!tegra_host->devfreq)
+		return;
+
+	devfreq_remove_device(tegra_host->devfreq);
+	tegra_host->devfreq = NULL;
+	tegra_host->scale_target = 0;
+	tegra_host->scale_rate = 0;
+}
+
 static struct sdhci_ops tegra_sdhci_ops = {
 #ifndef CONFIG_ARCH_TEGRA_11x_SOC
 	.get_ro     = tegra_sdhci_get_ro,
@@ -1946,6 +2429,8 @@ static struct sdhci_ops tegra_sdhci_ops = {
 	.write_l    = tegra_sdhci_writel,
 	.platform_8bit_width = tegra_sdhci_8bit,
 	.set_clock		= tegra_sdhci_set_clock,
+	.request_start		= tegra_sdhci_request_start,
+	.request_done		= tegra_sdhci_request_done,
 	.suspend		= tegra_sdhci_suspend,
 	.resume			= tegra_sdhci_resume,
 	.platform_resume	= tegra_sdhci_post_resume,
@@ -2379,6 +2864,8 @@ static int __devinit sdhci_tegra_probe(struct platform_device *pdev)
 	host->mmc->pm_caps |= MMC_PM_KEEP_POWER | MMC_PM_IGNORE_PM_NOTIFY;
 	if (plat->mmc_data.built_in) {
 		host->mmc->caps |= MMC_CAP_NONREMOVABLE;
+		/* block.c advertises REQ_FLUSH for a cached eMMC */
+		host->mmc->caps2 |= MMC_CAP2_CACHE_CTRL;
 	}
 	host->mmc->pm_flags |= MMC_PM_IGNORE_PM_NOTIFY;
 
@@ -2417,6 +2904,10 @@ static int __devinit sdhci_tegra_probe(struct platform_device *pdev)
 	if (rc)
 		goto err_add_host;
 
+	/* sdio latency matters more than its clock power */
+	if (tegra_host->instance != 0)
+		tegra_sdhci_scale_init(host);
+
 	/* Enable async suspend/resume to reduce LP0 latency */
 	device_enable_async_suspend(&pdev->dev);
 
@@ -2459,6 +2950,7 @@ static int __devexit sdhci_tegra_remove(struct platform_device *pdev)
 	const struct tegra_sdhci_platform_data *plat = tegra_host->plat;
 	int dead = (readl(host->ioaddr + SDHCI_INT_STATUS) == 0xffffffff);
 
+	tegra_sdhci_scale_deinit(host);
 	sdhci_remove_host(host, dead);
 
 	disable_irq_wake(gpio_to_irq(plat->cd_gpio));
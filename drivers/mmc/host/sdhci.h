@@ -289,6 +289,11 @@ struct sdhci_ops {
 		u32 opcode);
 	int	(*get_tuning_counter)(struct sdhci_host *sdhci);
 	int	(*sd_error_stats)(struct sdhci_host *host, u32 int_status);
+	/* request_start() may sleep; no transfer is active when it runs */
+	void	(*request_start)(struct sdhci_host *host,
+				 struct mmc_request *mrq);
+	void	(*request_done)(struct sdhci_host *host,
+				struct mmc_request *mrq);
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
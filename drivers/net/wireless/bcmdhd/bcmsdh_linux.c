@@ -44,6 +44,7 @@
 #if defined(OOB_INTR_ONLY)
 #include <linux/irq.h>
 extern void dhdsdio_isr(void * args);
+extern void dhd_os_wake_irq(void *dhdp);
 #include <bcmutils.h>
 #include <dngl_stats.h>
 #include <dhd.h>
@@ -631,6 +632,7 @@ static irqreturn_t wlan_oob_irq(int irq, void *dev_id)
 		return IRQ_HANDLED;
 	}
 
+	dhd_os_wake_irq(dhdp);
 	dhdsdio_isr((void *)dhdp->bus);
 
 	return IRQ_HANDLED;
@@ -1143,15 +1143,15 @@ sdioh_request_packet(sdioh_info_t *sd, uint fix_inc, uint write, uint func,
 				pkt = pnext;
 			}
 
-			sg_set_buf(&sd->sg_list[SGCount++],
-				(uint8*)PKTDATA(sd->osh, pnext),
-				pkt_len);
-
 			if (SGCount >= SDIOH_SDMMC_MAX_SG_ENTRIES) {
 				sd_err(("%s: sg list entries exceed limit\n",
 					__FUNCTION__));
 				return (SDIOH_API_RC_FAIL);
 			}
+
+			sg_set_buf(&sd->sg_list[SGCount++],
+				(uint8*)PKTDATA(sd->osh, pnext),
+				pkt_len);
 		}
 
 		mmc_dat.sg = sd->sg_list;
@@ -37,6 +37,7 @@
 #include <linux/mmc/host.h>
 #include <linux/mmc/sdio_func.h>
 #include <linux/mmc/sdio_ids.h>
+#include <linux/platform_device.h>
 
 #if !defined(SDIO_VENDOR_ID_BROADCOM)
 #define SDIO_VENDOR_ID_BROADCOM		0x02d0
@@ -82,6 +83,7 @@ extern void sdioh_sdmmc_devintr_off(sdioh_info_t *sd);
 extern void sdioh_sdmmc_devintr_on(sdioh_info_t *sd);
 extern int dhd_os_check_wakelock(void *dhdp);
 extern int dhd_os_check_if_up(void *dhdp);
+extern void dhd_os_wake_resume(void *dhdp);
 extern void *bcmsdh_get_drvdata(void);
 
 int sdio_function_init(void);
@@ -184,6 +186,38 @@ static void bcmsdh_sdmmc_remove(struct sdio_func *func)
 	}
 }
 
+/* IRQ of the SDIO host controller, for placing the DHD threads */
+int sdioh_sdmmc_host_irq(void)
+{
+	struct device *dev;
+
+	if (!gInstance || !gInstance->func[1])
+		return -ENODEV;
+
+	dev = mmc_dev(gInstance->func[1]->card->host);
+	if (!dev || dev->bus != &platform_bus_type)
+		return -ENODEV;
+
+	return platform_get_irq(to_platform_device(dev), 0);
+}
+
+/* Move the mmc core's SDIO IRQ thread along with the DHD threads */
+void sdioh_sdmmc_irq_thread_affinity(const struct cpumask *mask)
+{
+	struct sdio_func *func;
+	struct mmc_host *host;
+
+	if (!gInstance || !(func = gInstance->func[1]))
+		return;
+
+	host = func->card->host;
+	/* the thread comes and goes with sdio_claim_irq() under the host */
+	sdio_claim_host(func);
+	if (host->sdio_irq_thread)
+		set_cpus_allowed_ptr(host->sdio_irq_thread, mask);
+	sdio_release_host(func);
+}
+
 /* devices we support, null terminated */
 static const struct sdio_device_id bcmsdh_sdmmc_ids[] = {
 	{ SDIO_DEVICE(SDIO_VENDOR_ID_BROADCOM, SDIO_DEVICE_ID_BROADCOM_DEFAULT) },
@@ -244,8 +278,10 @@ static int bcmsdh_sdmmc_resume(struct device *pdev)
 	sd_trace(("%s Enter\n", __FUNCTION__));
 	dhd_mmc_suspend = FALSE;
 #if defined(OOB_INTR_ONLY)
-	if ((func->num == 2) && dhd_os_check_if_up(bcmsdh_get_drvdata()))
+	if ((func->num == 2) && dhd_os_check_if_up(bcmsdh_get_drvdata())) {
+		dhd_os_wake_resume(bcmsdh_get_drvdata());
 		bcmsdh_oob_intr_set(1);
+	}
 #endif 
 
 	smp_mb();
@@ -216,6 +216,8 @@ typedef struct tcp_ack_info {
 void dhd_onoff_tcpack_sup(void *pub, bool on);
 #endif /* DHDTCPACK_SUPPRESS */
 
+#define DHD_CUSTOM_FILTER_MAX	8	/* filters added by PKTFILTER-ADD */
+
 /* Common structure for module and instance linkage */
 typedef struct dhd_pub {
 	/* Linkage ponters */
@@ -284,6 +286,8 @@ typedef struct dhd_pub {
 	/* Pkt filter defination */
 	char * pktfilter[100];
 	int pktfilter_count;
+	/* User filters, kept across wifi off/on and appended to pktfilter[] */
+	char *pktfilter_custom[DHD_CUSTOM_FILTER_MAX];
 
 	wl_country_t dhd_cspec;		/* Current Locale info */
 	char eventmask[WL_EVENTING_MASK_LEN];
@@ -578,6 +582,8 @@ extern int dhd_keep_alive_onoff(dhd_pub_t *dhd);
 #define DHD_MULTICAST6_FILTER_NUM	3
 #define DHD_MDNS_FILTER_NUM		4
 #define DHD_ARP_FILTER_NUM		5
+#define DHD_CUSTOM_FILTER_NUM		6	/* first slot of the user filters */
+#define DHD_PKT_FILTER_ID_BASE		100	/* pktfilter[i] has id 100 + i */
 
 /* Port based packet filtering command actions */
 #define PKT_FILTER_PORTS_CLEAR		0
@@ -592,7 +598,13 @@ extern int net_os_enable_packet_filter(struct net_device *dev, int val);
 extern int net_os_rxfilter_add_remove(struct net_device *dev, int val, int num);
 extern void dhd_set_packet_filter_mode(struct net_device *dev, char *command);
 extern int dhd_set_packet_filter_ports(struct net_device *dev, char *command);
+extern int net_os_pktfilter_add(struct net_device *dev, char *spec);
+extern int net_os_pktfilter_del(struct net_device *dev, int id);
+extern int dhd_pktfilter_get_stats(dhd_pub_t *dhd, int id, wl_pkt_filter_stats_t *stats);
+extern void dhd_pktfilter_clear_stats(dhd_pub_t *dhd, int id);
 #endif /* PKT_FILTER_SUPPORT */
+extern int dhd_dev_get_offload_stats(struct net_device *dev, char *buf, int len,
+	bool clear);
 
 extern int dhd_get_suspend_bcn_li_dtim(dhd_pub_t *dhd);
 extern bool dhd_support_sta_mode(dhd_pub_t *dhd);
@@ -999,6 +1011,8 @@ void dhd_aoe_hostip_clr(dhd_pub_t *dhd, int idx);
 void dhd_aoe_arp_clr(dhd_pub_t *dhd, int idx);
 int dhd_arp_get_arp_hostip_table(dhd_pub_t *dhd, void *buf, int buflen, int idx);
 void dhd_arp_offload_add_ip(dhd_pub_t *dhd, uint32 ipaddr, int idx);
+int dhd_arp_get_stats(dhd_pub_t *dhd, struct arp_ol_stats_t *stats);
+void dhd_arp_clear_stats(dhd_pub_t *dhd);
 #endif /* ARP_OFFLOAD_SUPPORT */
 #ifdef WLTDLS
 int dhd_tdls_enable_disable(dhd_pub_t *dhd, bool flag);
@@ -1007,6 +1021,8 @@ int dhd_tdls_enable_disable(dhd_pub_t *dhd, bool flag);
 int dhd_ndo_enable(dhd_pub_t * dhd, int ndo_enable);
 int dhd_ndo_add_ip(dhd_pub_t *dhd, char* ipaddr, int idx);
 int dhd_ndo_remove_ip(dhd_pub_t *dhd, int idx);
+int dhd_ndo_get_stats(dhd_pub_t *dhd, struct nd_ol_stats_t *stats);
+void dhd_ndo_clear_stats(dhd_pub_t *dhd);
 /* ioctl processing for nl80211 */
 int dhd_ioctl_process(dhd_pub_t *pub, int ifidx, struct dhd_ioctl *ioc);
 
@@ -1601,6 +1601,40 @@ void dhd_pktfilter_offload_delete(dhd_pub_t *dhd, int id)
 			__FUNCTION__, id, ret));
 	}
 }
+
+/* Matches of filter "id", plus forwarded/discarded totals over all filters */
+int
+dhd_pktfilter_get_stats(dhd_pub_t *dhd, int id, wl_pkt_filter_stats_t *stats)
+{
+	char iovbuf[DHD_IOVAR_BUF_SIZE];
+	uint32 filter_id = htod32(id);
+	int ret;
+
+	bcm_mkiovar("pkt_filter_stats", (char *)&filter_id, sizeof(filter_id),
+		iovbuf, sizeof(iovbuf));
+	ret = dhd_wl_ioctl_cmd(dhd, WLC_GET_VAR, iovbuf, sizeof(iovbuf), FALSE, 0);
+	if (ret < 0) {
+		DHD_TRACE(("%s: filter %d, ret=%d\n", __FUNCTION__, id, ret));
+		return ret;
+	}
+
+	memcpy(stats, iovbuf, sizeof(*stats));
+	stats->num_pkts_matched = dtoh32(stats->num_pkts_matched);
+	stats->num_pkts_forwarded = dtoh32(stats->num_pkts_forwarded);
+	stats->num_pkts_discarded = dtoh32(stats->num_pkts_discarded);
+	return 0;
+}
+
+void
+dhd_pktfilter_clear_stats(dhd_pub_t *dhd, int id)
+{
+	char iovbuf[32];
+	uint32 filter_id = htod32(id);
+
+	bcm_mkiovar("pkt_filter_clear_stats", (char *)&filter_id,
+		sizeof(filter_id), iovbuf, sizeof(iovbuf));
+	dhd_wl_ioctl_cmd(dhd, WLC_SET_VAR, iovbuf, sizeof(iovbuf), TRUE, 0);
+}
 #endif /* PKT_FILTER_SUPPORT */
 
 /* ========================== */
@@ -1749,6 +1783,35 @@ dhd_arp_get_arp_hostip_table(dhd_pub_t *dhd, void *buf, int buflen, int idx)
 
 	return 0;
 }
+
+int
+dhd_arp_get_stats(dhd_pub_t *dhd, struct arp_ol_stats_t *stats)
+{
+	char iovbuf[DHD_IOVAR_BUF_SIZE];
+	uint32 *p = (uint32 *)stats;
+	int ret, i;
+
+	bcm_mkiovar("arp_stats", 0, 0, iovbuf, sizeof(iovbuf));
+	ret = dhd_wl_ioctl_cmd(dhd, WLC_GET_VAR, iovbuf, sizeof(iovbuf), FALSE, 0);
+	if (ret < 0) {
+		DHD_TRACE(("%s: ret=%d\n", __FUNCTION__, ret));
+		return ret;
+	}
+
+	memcpy(stats, iovbuf, sizeof(*stats));
+	for (i = 0; i < sizeof(*stats) / sizeof(uint32); i++)
+		p[i] = dtoh32(p[i]);
+	return 0;
+}
+
+void
+dhd_arp_clear_stats(dhd_pub_t *dhd)
+{
+	char iovbuf[32];
+
+	bcm_mkiovar("arp_stats_clear", 0, 0, iovbuf, sizeof(iovbuf));
+	dhd_wl_ioctl_cmd(dhd, WLC_SET_VAR, iovbuf, sizeof(iovbuf), TRUE, 0);
+}
 #endif /* ARP_OFFLOAD_SUPPORT  */
 /*
  * Neighbor Discovery Offload: enable NDO feature
@@ -1829,6 +1892,44 @@ dhd_ndo_remove_ip(dhd_pub_t *dhd, int idx)
 	return retcode;
 }
 
+/*
+ * Neighbor Discover Offload: NS requests answered and dropped by firmware
+ */
+int
+dhd_ndo_get_stats(dhd_pub_t *dhd, struct nd_ol_stats_t *stats)
+{
+	char iovbuf[DHD_IOVAR_BUF_SIZE];
+	uint32 *p = (uint32 *)stats;
+	int ret, i;
+
+	if (dhd == NULL)
+		return -1;
+
+	bcm_mkiovar("nd_status", 0, 0, iovbuf, sizeof(iovbuf));
+	ret = dhd_wl_ioctl_cmd(dhd, WLC_GET_VAR, iovbuf, sizeof(iovbuf), FALSE, 0);
+	if (ret < 0) {
+		DHD_TRACE(("%s: ret=%d\n", __FUNCTION__, ret));
+		return ret;
+	}
+
+	memcpy(stats, iovbuf, sizeof(*stats));
+	for (i = 0; i < sizeof(*stats) / sizeof(uint32); i++)
+		p[i] = dtoh32(p[i]);
+	return 0;
+}
+
+void
+dhd_ndo_clear_stats(dhd_pub_t *dhd)
+{
+	char iovbuf[32];
+
+	if (dhd == NULL)
+		return;
+
+	bcm_mkiovar("nd_status_clear", 0, 0, iovbuf, sizeof(iovbuf));
+	dhd_wl_ioctl_cmd(dhd, WLC_SET_VAR, iovbuf, sizeof(iovbuf), TRUE, 0);
+}
+
 /* send up locally generated event */
 void
 dhd_sendup_event_common(dhd_pub_t *dhdp, wl_event_msg_t *event, void *data)
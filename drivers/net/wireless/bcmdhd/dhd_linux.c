@@ -45,6 +45,9 @@
 #include <linux/fs.h>
 #include <linux/ip.h>
 #include <linux/device.h>
+#include <linux/cpu.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
 #include <net/addrconf.h>
 #ifdef ENABLE_ADAPTIVE_SCHED
 #include <linux/cpufreq.h>
@@ -60,6 +63,7 @@
 
 #include <proto/ethernet.h>
 #include <proto/bcmip.h>
+#include <proto/802.1d.h>
 #include <dngl_stats.h>
 #include <dhd.h>
 #include <dhd_bus.h>
@@ -245,6 +249,23 @@ typedef struct dhd_if {
 	bool			event2cfg80211;	/* To determine if pass event to cfg80211 */
 } dhd_if_t;
 
+/* Why the dongle woke the host, see dhd_os_wake_irq() */
+typedef struct dhd_wake_stats {
+	uint32	total;		/* resumes ended by the OOB interrupt */
+	uint32	unattributed;	/* no frame followed the wakeup */
+	uint32	ev_pfn;		/* PNO network found/lost */
+	uint32	ev_batch;	/* batch scan buffer full */
+	uint32	ev_link;	/* link, roam, deauth, disassoc */
+	uint32	ev_other;
+	uint32	rx_ucast;
+	uint32	rx_mcast;
+	uint32	rx_bcast;
+	uint32	rx_arp;
+} dhd_wake_stats_t;
+
+/* An OOB interrupt this soon after resume is taken to be the wake source */
+#define DHD_WAKE_WINDOW_MS	200
+
 #ifdef WLMEDIA_HTSF
 typedef struct {
 	uint32 low;
@@ -294,6 +315,20 @@ typedef struct dhd_info {
 	wait_queue_head_t ioctl_resp_wait;
 	uint32	default_wd_interval;
 
+	/* Low latency mode, see dhd_set_latency_mode() */
+	bool	latency_mode;
+	uint16	latency_port;		/* UDP port of the prioritized flow */
+	uint	latency_saved_wd;
+	uint	latency_saved_slpauto;
+	int	latency_saved_idletime;
+
+	/* Host wakeup attribution */
+	spinlock_t	wake_stats_lock;
+	unsigned long	wake_resume_time;
+	bool		wake_check;	/* resumed, no OOB interrupt seen yet */
+	bool		wake_pending;	/* wakeup not yet matched to a frame */
+	dhd_wake_stats_t wake_stats;
+
 	struct timer_list timer;
 	bool wd_timer_valid;
 	struct tasklet_struct tasklet;
@@ -310,7 +345,20 @@ typedef struct dhd_info {
 #ifdef RXFRAME_THREAD
 	tsk_ctl_t	thr_rxf_ctl;
 	spinlock_t	rxf_lock;
+	/* frames handed from the rxf thread to NET_RX softirq */
+	struct napi_struct	rx_napi;
+	struct sk_buff_head	rx_napi_queue;
+	bool		rx_napi_enabled;
 #endif /* RXFRAME_THREAD */
+	/* CPU placement of the DPC/RXF threads, see dhd_affinity_apply() */
+	int		affinity_policy;
+	int		affinity_cpu;
+	int		affinity_irq;
+	bool		affinity_inited;
+	struct mutex	affinity_lock;
+	struct work_struct	affinity_work;
+	struct notifier_block	affinity_cpu_nb;
+	struct irq_affinity_notify	affinity_irq_nb;
 #endif /* DHDTHREAD */
 	bool dhd_tasklet_create;
 	tsk_ctl_t	thr_sysioc_ctl;
@@ -438,6 +486,9 @@ module_param(dhd_console_ms, uint, 0644);
 uint dhd_slpauto = TRUE;
 module_param(dhd_slpauto, uint, 0);
 
+/* Watchdog period while in low latency mode */
+#define DHD_LATENCY_WD_MS	5
+
 #ifdef PKT_FILTER_SUPPORT
 /* Global Pkt filter enable control */
 uint dhd_pkt_filter_enable = TRUE;
@@ -464,6 +515,10 @@ module_param(dhd_dpc_prio, int, 0);
 /* RX frame thread priority */
 int dhd_rxf_prio = CUSTOM_RXF_PRIO_SETTING;
 module_param(dhd_rxf_prio, int, 0);
+
+/* RX frame NAPI budget per poll, 0 to deliver each frame by netif_rx_ni() */
+int dhd_napi_weight = 64;
+module_param(dhd_napi_weight, int, 0);
 #endif /* RXFRAME_THREAD */
 
 /* DPC thread priority, -1 to use tasklet */
@@ -547,6 +602,8 @@ static void dhd_net_if_lock_local(dhd_info_t *dhd);
 static void dhd_net_if_unlock_local(dhd_info_t *dhd);
 static void dhd_suspend_lock(dhd_pub_t *dhdp);
 static void dhd_suspend_unlock(dhd_pub_t *dhdp);
+static void dhd_wake_account(dhd_info_t *dhd, struct sk_buff *skb,
+	wl_event_msg_t *event);
 
 #ifdef WLMEDIA_HTSF
 void htsf_update(dhd_info_t *dhd, void *data);
@@ -686,6 +743,67 @@ static inline void* dhd_rxf_dequeue(dhd_pub_t *dhdp)
 
 	return skb;
 }
+
+/*
+ * The rxf thread moves whole frame chains onto rx_napi_queue and the
+ * NET_RX softirq drains it in dhd_napi_weight sized batches through GRO,
+ * instead of one netif_rx_ni() and softirq round trip per frame.
+ */
+static int
+dhd_napi_poll(struct napi_struct *napi, int budget)
+{
+	dhd_info_t *dhd = container_of(napi, dhd_info_t, rx_napi);
+	struct sk_buff_head rx_process_queue;
+	struct sk_buff *skb;
+	int processed = 0;
+
+	__skb_queue_head_init(&rx_process_queue);
+	spin_lock(&dhd->rx_napi_queue.lock);
+	skb_queue_splice_tail_init(&dhd->rx_napi_queue, &rx_process_queue);
+	spin_unlock(&dhd->rx_napi_queue.lock);
+
+	while (processed < budget &&
+		(skb = __skb_dequeue(&rx_process_queue)) != NULL) {
+		napi_gro_receive(napi, skb);
+		processed++;
+	}
+
+	if (!skb_queue_empty(&rx_process_queue)) {
+		/* Out of budget, put the rest back in front, in order */
+		spin_lock(&dhd->rx_napi_queue.lock);
+		skb_queue_splice(&rx_process_queue, &dhd->rx_napi_queue);
+		spin_unlock(&dhd->rx_napi_queue.lock);
+	}
+
+	if (processed < budget) {
+		napi_complete(napi);
+		/* Catch frames queued after the splice above */
+		if (!skb_queue_empty(&dhd->rx_napi_queue))
+			napi_schedule(napi);
+	}
+
+	return processed;
+}
+
+static void
+dhd_rxf_napi_deliver(dhd_info_t *dhd, void *skb)
+{
+	struct sk_buff_head rxq;
+
+	__skb_queue_head_init(&rxq);
+	while (skb) {
+		void *skbnext = PKTNEXT(dhd->pub.osh, skb);
+		PKTSETNEXT(dhd->pub.osh, skb, NULL);
+		__skb_queue_tail(&rxq, (struct sk_buff *)skb);
+		skb = skbnext;
+	}
+
+	/* poll runs as soon as bottom halves are enabled again */
+	spin_lock_bh(&dhd->rx_napi_queue.lock);
+	skb_queue_splice_tail_init(&rxq, &dhd->rx_napi_queue);
+	napi_schedule(&dhd->rx_napi);
+	spin_unlock_bh(&dhd->rx_napi_queue.lock);
+}
 #endif /* defined(DHDTHREAD) && defined(RXFRAME_THREAD) */
 
 static int dhd_process_cid_mac(dhd_pub_t *dhdp, bool prepost)
@@ -879,6 +997,28 @@ dhd_enable_packet_filter_ports(dhd_pub_t *dhd, bool enable)
 }
 #endif /* PKT_FILTER_SUPPORT */
 
+#ifdef PKT_FILTER_SUPPORT
+static int
+dhd_pktfilter_id(char *spec)
+{
+	return spec ? (int)bcm_strtoul(spec, NULL, 0) : -1;
+}
+
+/* Append the user filters to the built-in ones in dhd->pktfilter[] */
+static void
+dhd_pktfilter_custom_sync(dhd_pub_t *dhd)
+{
+	int i;
+
+	dhd->pktfilter_count = DHD_CUSTOM_FILTER_NUM;
+	for (i = 0; i < DHD_CUSTOM_FILTER_MAX; i++) {
+		if (dhd->pktfilter_custom[i])
+			dhd->pktfilter[dhd->pktfilter_count++] =
+				dhd->pktfilter_custom[i];
+	}
+}
+#endif /* PKT_FILTER_SUPPORT */
+
 void dhd_set_packet_filter(dhd_pub_t *dhd)
 {
 #ifdef PKT_FILTER_SUPPORT
@@ -1668,6 +1808,33 @@ uint8 prio2fifo[8] = { 1, 0, 0, 1, 2, 2, 3, 3 };
 #define WME_PRIO2AC(prio)	wme_fifo2ac[prio2fifo[(prio)]]
 
 #endif /* PROP_TXSTATUS */
+
+#define DHD_UDP_HDR_LEN		8
+
+/* UDP over IPv4 to or from the latency mode port, any UDP if port is 0 */
+static bool
+dhd_latency_flow(dhd_info_t *dhd, void *pktbuf)
+{
+	uint8 *pktdata = (uint8 *)PKTDATA(dhd->pub.osh, pktbuf);
+	uint len = PKTLEN(dhd->pub.osh, pktbuf);
+	struct ether_header *eh = (struct ether_header *)pktdata;
+	uint8 *iph = pktdata + ETHER_HDR_LEN;
+	uint8 *udph;
+
+	if (len < ETHER_HDR_LEN + IPV4_MIN_HEADER_LEN + DHD_UDP_HDR_LEN ||
+	    ntoh16(eh->ether_type) != ETHER_TYPE_IP ||
+	    IP_VER(iph) != IP_VER_4 || IPV4_PROT(iph) != IP_PROT_UDP ||
+	    len < ETHER_HDR_LEN + IPV4_HLEN(iph) + DHD_UDP_HDR_LEN)
+		return FALSE;
+
+	if (!dhd->latency_port)
+		return TRUE;
+
+	udph = iph + IPV4_HLEN(iph);
+	return (ntoh16_ua(udph) == dhd->latency_port ||
+		ntoh16_ua(udph + 2) == dhd->latency_port);
+}
+
 int
 dhd_sendpkt(dhd_pub_t *dhdp, int ifidx, void *pktbuf)
 {
@@ -1702,6 +1869,11 @@ dhd_sendpkt(dhd_pub_t *dhdp, int ifidx, void *pktbuf)
 #endif 
 		pktsetprio(pktbuf, FALSE);
 
+	/* Move the streaming flow ahead of best effort in the AC queues */
+	if (dhd->latency_mode && PKTPRIO(pktbuf) < PRIO_8021D_VI &&
+	    dhd_latency_flow(dhd, pktbuf))
+		PKTSETPRIO(pktbuf, PRIO_8021D_VI);
+
 #ifdef PROP_TXSTATUS
 	if (dhdp->wlfc_state) {
 		/* store the interface ID */
@@ -2085,6 +2257,8 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 			&data);
 
 			wl_event_to_host_order(&event);
+			if (dhd->wake_pending)
+				dhd_wake_account(dhd, skb, &event);
 			if (!tout_ctrl)
 				tout_ctrl = DHD_PACKET_TIMEOUT_MS;
 
@@ -2100,6 +2274,8 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 			continue;
 #endif /* DHD_DONOT_FORWARD_BCMEVENT_AS_NETWORK_PKT */
 		} else {
+			if (dhd->wake_pending)
+				dhd_wake_account(dhd, skb, NULL);
 			tout_rx = DHD_PACKET_TIMEOUT_MS;
 		}
 
@@ -2316,6 +2492,138 @@ dhd_sched_policy(int prio)
 }
 #endif /* ENABLE_ADAPTIVE_SCHED */
 
+#ifdef DHDTHREAD
+#define DHD_AFFINITY_NONE	-2	/* scheduler places the threads */
+#define DHD_AFFINITY_IRQ	-1	/* follow the SDIO host IRQ */
+
+#ifdef CUSTOM_DPC_CPUCORE
+#define DHD_AFFINITY_DEFAULT	CUSTOM_DPC_CPUCORE
+#else
+#define DHD_AFFINITY_DEFAULT	DHD_AFFINITY_IRQ
+#endif
+
+extern int sdioh_sdmmc_host_irq(void);
+extern void sdioh_sdmmc_irq_thread_affinity(const struct cpumask *mask);
+
+static int
+dhd_affinity_irq_cpu(int irq)
+{
+	struct irq_data *data = (irq >= 0) ? irq_get_irq_data(irq) : NULL;
+	int cpu;
+
+	if (!data)
+		return -1;
+	cpu = cpumask_first_and(data->affinity, cpu_online_mask);
+	return (cpu < nr_cpu_ids) ? cpu : -1;
+}
+
+/*
+ * Keep the DPC and RXF threads, and the mmc core's SDIO IRQ thread, on
+ * the core that takes the host controller interrupt, so that a frame is
+ * handled where it was signalled instead of bouncing across the cluster
+ * and keeping extra cores online. A fixed core that cpuquiet has taken
+ * offline falls back to the IRQ's core until it comes back.
+ */
+static void
+dhd_affinity_apply(dhd_info_t *dhd)
+{
+	const struct cpumask *mask = cpu_possible_mask;
+	int cpu = -1;
+
+	mutex_lock(&dhd->affinity_lock);
+	if (dhd->affinity_policy >= 0 && cpu_online(dhd->affinity_policy))
+		cpu = dhd->affinity_policy;
+	else if (dhd->affinity_policy != DHD_AFFINITY_NONE)
+		cpu = dhd_affinity_irq_cpu(dhd->affinity_irq);
+	if (cpu >= 0)
+		mask = cpumask_of(cpu);
+
+	if (dhd->thr_dpc_ctl.thr_pid >= 0)
+		set_cpus_allowed_ptr(dhd->thr_dpc_ctl.p_task, mask);
+#ifdef RXFRAME_THREAD
+	if (dhd->thr_rxf_ctl.thr_pid >= 0)
+		set_cpus_allowed_ptr(dhd->thr_rxf_ctl.p_task, mask);
+#endif
+	sdioh_sdmmc_irq_thread_affinity(mask);
+	dhd->affinity_cpu = cpu;
+	mutex_unlock(&dhd->affinity_lock);
+}
+
+static void
+dhd_affinity_work(struct work_struct *work)
+{
+	dhd_info_t *dhd = container_of(work, dhd_info_t, affinity_work);
+
+	dhd_affinity_apply(dhd);
+}
+
+static int
+dhd_affinity_cpu_callback(struct notifier_block *nb, unsigned long action,
+	void *hcpu)
+{
+	dhd_info_t *dhd = container_of(nb, dhd_info_t, affinity_cpu_nb);
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+	case CPU_DEAD:
+		schedule_work(&dhd->affinity_work);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static void
+dhd_affinity_irq_notify(struct irq_affinity_notify *notify,
+	const cpumask_t *mask)
+{
+	dhd_info_t *dhd = container_of(notify, dhd_info_t, affinity_irq_nb);
+
+	dhd_affinity_apply(dhd);
+}
+
+static void
+dhd_affinity_irq_release(struct kref *ref)
+{
+	/* embedded in dhd_info, freed with it */
+}
+
+static void
+dhd_affinity_init(dhd_info_t *dhd)
+{
+	dhd->affinity_policy = DHD_AFFINITY_DEFAULT;
+	dhd->affinity_cpu = -1;
+	mutex_init(&dhd->affinity_lock);
+	INIT_WORK(&dhd->affinity_work, dhd_affinity_work);
+
+	dhd->affinity_irq = sdioh_sdmmc_host_irq();
+	if (dhd->affinity_irq >= 0) {
+		dhd->affinity_irq_nb.notify = dhd_affinity_irq_notify;
+		dhd->affinity_irq_nb.release = dhd_affinity_irq_release;
+		if (irq_set_affinity_notifier(dhd->affinity_irq,
+			&dhd->affinity_irq_nb))
+			dhd->affinity_irq = -1;
+	}
+
+	dhd->affinity_cpu_nb.notifier_call = dhd_affinity_cpu_callback;
+	register_cpu_notifier(&dhd->affinity_cpu_nb);
+	dhd->affinity_inited = TRUE;
+
+	dhd_affinity_apply(dhd);
+}
+
+static void
+dhd_affinity_deinit(dhd_info_t *dhd)
+{
+	if (!dhd->affinity_inited)
+		return;
+
+	unregister_cpu_notifier(&dhd->affinity_cpu_nb);
+	if (dhd->affinity_irq >= 0)
+		irq_set_affinity_notifier(dhd->affinity_irq, NULL);
+	cancel_work_sync(&dhd->affinity_work);
+	dhd->affinity_inited = FALSE;
+}
+#endif /* DHDTHREAD */
 
 static int
 dhd_dpc_thread(void *data)
@@ -2332,10 +2640,6 @@ dhd_dpc_thread(void *data)
 		setScheduler(current, SCHED_FIFO, &param);
 	}
 
-#ifdef CUSTOM_DPC_CPUCORE
-		set_cpus_allowed_ptr(current, cpumask_of(CUSTOM_DPC_CPUCORE));
-#endif /* CUSTOM_DPC_CPUCORE */
-
 	/* Run until signal received */
 	while (1) {
 		if (!binary_sema_down(tsk)) {
@@ -2413,6 +2717,11 @@ dhd_rxf_thread(void *data)
 			if (skb == NULL) {
 				continue;
 			}
+			if (dhd->rx_napi_enabled) {
+				dhd_rxf_napi_deliver(dhd, skb);
+				DHD_OS_WAKE_UNLOCK(pub);
+				continue;
+			}
 			while (skb) {
 				void *skbnext = PKTNEXT(pub->osh, skb);
 				PKTSETNEXT(pub->osh, skb, NULL);
@@ -3475,6 +3784,7 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen, void *dev)
 
 	/* Initialize Wakelock stuff */
 	spin_lock_init(&dhd->wakelock_spinlock);
+	spin_lock_init(&dhd->wake_stats_lock);
 	dhd->wakelock_counter = 0;
 	dhd->wakelock_wd_counter = 0;
 	dhd->wakelock_rx_timeout_enable = 0;
@@ -3555,9 +3865,17 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen, void *dev)
 	}
 #ifdef RXFRAME_THREAD
 	bzero(&dhd->pub.skbbuf[0], sizeof(void *) * MAXSKBPEND);
+	skb_queue_head_init(&dhd->rx_napi_queue);
+	if (dhd_napi_weight > 0) {
+		netif_napi_add(net, &dhd->rx_napi, dhd_napi_poll,
+			dhd_napi_weight);
+		napi_enable(&dhd->rx_napi);
+		dhd->rx_napi_enabled = TRUE;
+	}
 	/* Initialize RXF thread */
 	PROC_START2(dhd_rxf_thread, dhd, &dhd->thr_rxf_ctl, 0, "dhd_rxf");
 #endif
+	dhd_affinity_init(dhd);
 #else
 	/* Set up the bottom half handler */
 	tasklet_init(&dhd->tasklet, dhd_dpc, (ulong)dhd);
@@ -3732,6 +4050,10 @@ dhd_bus_start(dhd_pub_t *dhdp)
 #ifdef DHDTHREAD
 	if (dhd->threads_only)
 		dhd_os_sdunlock(dhdp);
+
+	/* The SDIO IRQ thread exists only once the interrupt is claimed */
+	if (dhd->affinity_inited)
+		schedule_work(&dhd->affinity_work);
 #endif /* DHDTHREAD */
 
 	dhd_process_cid_mac(dhdp, TRUE);
@@ -4339,7 +4661,6 @@ dhd_preinit_ioctls(dhd_pub_t *dhd)
 
 #ifdef PKT_FILTER_SUPPORT
 	/* Setup default defintions for pktfilter , enable in suspend */
-	dhd->pktfilter_count = 6;
 	/* Setup filter to allow only unicast */
 	dhd->pktfilter[DHD_UNICAST_FILTER_NUM] = "100 0 0 0 0x01 0x00";
 	dhd->pktfilter[DHD_BROADCAST_FILTER_NUM] = NULL;
@@ -4349,7 +4670,8 @@ dhd_preinit_ioctls(dhd_pub_t *dhd)
 	dhd->pktfilter[DHD_MDNS_FILTER_NUM] = "104 0 0 0 0xFFFFFFFFFFFF 0x01005E0000FB";
 	/* apply APP pktfilter */
 	dhd->pktfilter[DHD_ARP_FILTER_NUM] = "105 0 0 12 0xFFFF 0x0806";
-
+	/* and whatever was added through PKTFILTER-ADD */
+	dhd_pktfilter_custom_sync(dhd);
 
 #if defined(SOFTAP)
 	if (ap_fw_loaded) {
@@ -4848,6 +5170,9 @@ void dhd_detach(dhd_pub_t *dhdp)
 	dhd_info_t *dhd;
 	unsigned long flags;
 	int timer_valid = FALSE;
+#ifdef PKT_FILTER_SUPPORT
+	int i;
+#endif
 
 	if (!dhdp)
 		return;
@@ -4898,6 +5223,15 @@ void dhd_detach(dhd_pub_t *dhdp)
 		PROC_STOP(&dhd->thr_sysioc_ctl);
 	}
 
+#if defined(DHDTHREAD) && defined(RXFRAME_THREAD)
+	/* NAPI lives on the primary net device, which goes away below */
+	if (dhd->rx_napi_enabled) {
+		dhd->rx_napi_enabled = FALSE;
+		napi_disable(&dhd->rx_napi);
+		netif_napi_del(&dhd->rx_napi);
+	}
+#endif /* defined(DHDTHREAD) && defined(RXFRAME_THREAD) */
+
 	/* delete all interfaces, start with virtual  */
 	if (dhd->dhd_state & DHD_ATTACH_STATE_ADD_IF) {
 		int i = 1;
@@ -4944,6 +5278,8 @@ void dhd_detach(dhd_pub_t *dhdp)
 
 	if (dhd->dhd_state & DHD_ATTACH_STATE_THREADS_CREATED) {
 #ifdef DHDTHREAD
+		dhd_affinity_deinit(dhd);
+
 		if (dhd->thr_wdt_ctl.thr_pid >= 0) {
 			PROC_STOP(&dhd->thr_wdt_ctl);
 		}
@@ -4954,6 +5290,7 @@ void dhd_detach(dhd_pub_t *dhdp)
 #ifdef RXFRAME_THREAD
 		if (dhd->thr_rxf_ctl.thr_pid >= 0) {
 			PROC_STOP(&dhd->thr_rxf_ctl);
+			skb_queue_purge(&dhd->rx_napi_queue);
 		}
 #endif
 		else
@@ -4971,6 +5308,16 @@ void dhd_detach(dhd_pub_t *dhdp)
 	if (dhdp->pno_state)
 		dhd_pno_deinit(dhdp);
 #endif
+#ifdef PKT_FILTER_SUPPORT
+	for (i = 0; i < DHD_CUSTOM_FILTER_MAX; i++) {
+		char *filter = dhdp->pktfilter_custom[i];
+
+		if (filter) {
+			MFREE(dhdp->osh, filter, strlen(filter) + 1);
+			dhdp->pktfilter_custom[i] = NULL;
+		}
+	}
+#endif /* PKT_FILTER_SUPPORT */
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27)) && (LINUX_VERSION_CODE <= \
 	KERNEL_VERSION(2, 6, 39)) && defined(CONFIG_PM_SLEEP)
 		unregister_pm_notifier(&dhd_sleep_pm_notifier);
@@ -5754,6 +6101,85 @@ int net_os_rxfilter_add_remove(struct net_device *dev, int add_remove, int num)
 	return ret;
 }
 
+/*
+ * Add a filter given as "<id> <polarity> <type> <offset> <mask> <pattern>",
+ * the format of the built-in ones. It is installed at once and enabled with
+ * the others whenever the host enters early suspend.
+ */
+int net_os_pktfilter_add(struct net_device *dev, char *spec)
+{
+	dhd_info_t *dhd = *(dhd_info_t **)netdev_priv(dev);
+	dhd_pub_t *dhdp;
+	int id, i, slot = -1;
+	char *filter;
+
+	if (!dhd)
+		return -ENODEV;
+	dhdp = &dhd->pub;
+
+	while (*spec == ' ')
+		spec++;
+	id = dhd_pktfilter_id(spec);
+	if (id <= 0 || (id >= DHD_PKT_FILTER_ID_BASE &&
+		id < DHD_PKT_FILTER_ID_BASE + DHD_CUSTOM_FILTER_NUM))
+		return -EINVAL;
+
+	for (i = 0; i < DHD_CUSTOM_FILTER_MAX; i++) {
+		if (!dhdp->pktfilter_custom[i]) {
+			if (slot < 0)
+				slot = i;
+		} else if (dhd_pktfilter_id(dhdp->pktfilter_custom[i]) == id) {
+			return -EEXIST;
+		}
+	}
+	if (slot < 0)
+		return -ENOSPC;
+
+	if (!(filter = MALLOC(dhdp->osh, strlen(spec) + 1)))
+		return -ENOMEM;
+	strcpy(filter, spec);
+	dhdp->pktfilter_custom[slot] = filter;
+	dhd_pktfilter_custom_sync(dhdp);
+
+	if (dhdp->up) {
+		dhd_pktfilter_offload_set(dhdp, filter);
+		if (dhdp->early_suspended)
+			dhd_pktfilter_offload_enable(dhdp, filter, 1,
+				dhd_master_mode);
+	}
+	DHD_INFO(("%s: filter %d: %s\n", __FUNCTION__, id, filter));
+
+	return 0;
+}
+
+int net_os_pktfilter_del(struct net_device *dev, int id)
+{
+	dhd_info_t *dhd = *(dhd_info_t **)netdev_priv(dev);
+	dhd_pub_t *dhdp;
+	char *filter;
+	int i;
+
+	if (!dhd)
+		return -ENODEV;
+	dhdp = &dhd->pub;
+
+	for (i = 0; i < DHD_CUSTOM_FILTER_MAX; i++) {
+		filter = dhdp->pktfilter_custom[i];
+		if (filter && dhd_pktfilter_id(filter) == id)
+			break;
+	}
+	if (i == DHD_CUSTOM_FILTER_MAX)
+		return -ENOENT;
+
+	if (dhdp->up)
+		dhd_pktfilter_offload_delete(dhdp, id);
+	dhdp->pktfilter_custom[i] = NULL;
+	dhd_pktfilter_custom_sync(dhdp);
+	MFREE(dhdp->osh, filter, strlen(filter) + 1);
+
+	return 0;
+}
+
 int dhd_os_enable_packet_filter(dhd_pub_t *dhdp, int val)
 
 {
@@ -6292,6 +6718,100 @@ int dhd_os_check_if_up(void *dhdp)
 		return 0;
 	return pub->up;
 }
+
+/* Called from the SDIO resume path, before the OOB interrupt is unmasked */
+void dhd_os_wake_resume(void *dhdp)
+{
+	dhd_pub_t *pub = (dhd_pub_t *)dhdp;
+	dhd_info_t *dhd;
+	unsigned long flags;
+
+	if (!pub || !(dhd = (dhd_info_t *)pub->info))
+		return;
+
+	spin_lock_irqsave(&dhd->wake_stats_lock, flags);
+	dhd->wake_check = TRUE;
+	dhd->wake_resume_time = jiffies;
+	spin_unlock_irqrestore(&dhd->wake_stats_lock, flags);
+}
+
+/*
+ * The OOB interrupt is masked across suspend, so a dongle wakeup shows up
+ * as the interrupt latched on the GPIO firing as soon as resume unmasks it.
+ * Count it and let dhd_wake_account() blame the first frame that follows.
+ */
+void dhd_os_wake_irq(void *dhdp)
+{
+	dhd_pub_t *pub = (dhd_pub_t *)dhdp;
+	dhd_info_t *dhd;
+	unsigned long flags;
+
+	if (!pub || !(dhd = (dhd_info_t *)pub->info))
+		return;
+
+	spin_lock_irqsave(&dhd->wake_stats_lock, flags);
+	if (dhd->wake_check) {
+		dhd->wake_check = FALSE;
+		if (time_before(jiffies, dhd->wake_resume_time +
+			msecs_to_jiffies(DHD_WAKE_WINDOW_MS))) {
+			if (dhd->wake_pending)
+				dhd->wake_stats.unattributed++;
+			dhd->wake_pending = TRUE;
+			dhd->wake_stats.total++;
+		}
+	}
+	spin_unlock_irqrestore(&dhd->wake_stats_lock, flags);
+}
+
+static void
+dhd_wake_account(dhd_info_t *dhd, struct sk_buff *skb, wl_event_msg_t *event)
+{
+	dhd_wake_stats_t *ws = &dhd->wake_stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dhd->wake_stats_lock, flags);
+	if (!dhd->wake_pending)
+		goto done;
+	dhd->wake_pending = FALSE;
+
+	if (event) {
+		switch (event->event_type) {
+		case WLC_E_PFN_NET_FOUND:
+		case WLC_E_PFN_NET_LOST:
+			ws->ev_pfn++;
+			break;
+		case WLC_E_PFN_BEST_BATCHING:
+			ws->ev_batch++;
+			break;
+		case WLC_E_LINK:
+		case WLC_E_ROAM:
+		case WLC_E_DEAUTH:
+		case WLC_E_DEAUTH_IND:
+		case WLC_E_DISASSOC:
+		case WLC_E_DISASSOC_IND:
+			ws->ev_link++;
+			break;
+		default:
+			ws->ev_other++;
+			break;
+		}
+		DHD_INFO(("%s: woken by event %d\n", __FUNCTION__,
+			event->event_type));
+	} else {
+		if (ntoh16(skb->protocol) == ETHER_TYPE_ARP)
+			ws->rx_arp++;
+		else if (skb->pkt_type == PACKET_BROADCAST)
+			ws->rx_bcast++;
+		else if (skb->pkt_type == PACKET_MULTICAST)
+			ws->rx_mcast++;
+		else
+			ws->rx_ucast++;
+		DHD_INFO(("%s: woken by rx frame, proto 0x%04x\n", __FUNCTION__,
+			ntoh16(skb->protocol)));
+	}
+done:
+	spin_unlock_irqrestore(&dhd->wake_stats_lock, flags);
+}
 /* function to collect firmware, chip id and chip version info */
 void dhd_set_version_info(dhd_pub_t *dhdp, char *fw)
 {
@@ -6920,8 +7440,132 @@ dhd_sysfs_idletime_show(struct kobject *kobj, struct kobj_attribute *attr,
 static struct kobj_attribute dhd_sysfs_idletime_attribute =
 	__ATTR(idletime, 0644, dhd_sysfs_idletime_show, dhd_sysfs_idletime_store);
 
+#ifdef DHDTHREAD
+/*
+ * "irq" pins the DHD threads to the core taking the SDIO host interrupt,
+ * "none" leaves them to the scheduler and a number pins them to that core.
+ * Reading shows the policy and the core currently in use.
+ */
+static ssize_t
+dhd_sysfs_affinity_store(struct kobject *kobj, struct kobj_attribute *attr,
+		const char *buf, size_t count)
+{
+	dhd_info_t *dhd;
+	int policy;
+
+	if (!g_sysfs.dhdp) {
+		DHD_ERROR(("%s: not initialized yet\n", __FUNCTION__));
+		return -EFAULT;
+	}
+	dhd = (dhd_info_t *)g_sysfs.dhdp->info;
+
+	if (sysfs_streq(buf, "irq"))
+		policy = DHD_AFFINITY_IRQ;
+	else if (sysfs_streq(buf, "none"))
+		policy = DHD_AFFINITY_NONE;
+	else if (sscanf(buf, "%d", &policy) < 1 || policy < 0 ||
+		policy >= nr_cpu_ids || !cpu_possible(policy))
+		return -EINVAL;
+
+	mutex_lock(&dhd->affinity_lock);
+	dhd->affinity_policy = policy;
+	mutex_unlock(&dhd->affinity_lock);
+	dhd_affinity_apply(dhd);
+
+	return count;
+}
+
+static ssize_t
+dhd_sysfs_affinity_show(struct kobject *kobj, struct kobj_attribute *attr,
+		char *buf)
+{
+	dhd_info_t *dhd;
+	ssize_t len;
+
+	if (!g_sysfs.dhdp) {
+		DHD_ERROR(("%s: not initialized yet\n", __FUNCTION__));
+		return -EFAULT;
+	}
+	dhd = (dhd_info_t *)g_sysfs.dhdp->info;
+
+	mutex_lock(&dhd->affinity_lock);
+	if (dhd->affinity_policy == DHD_AFFINITY_IRQ)
+		len = sprintf(buf, "irq");
+	else if (dhd->affinity_policy == DHD_AFFINITY_NONE)
+		len = sprintf(buf, "none");
+	else
+		len = sprintf(buf, "%d", dhd->affinity_policy);
+	if (dhd->affinity_cpu >= 0)
+		len += sprintf(buf + len, " (cpu%d)", dhd->affinity_cpu);
+	len += sprintf(buf + len, "\n");
+	mutex_unlock(&dhd->affinity_lock);
+
+	return len;
+}
+
+static struct kobj_attribute dhd_sysfs_affinity_attribute =
+	__ATTR(affinity, 0644, dhd_sysfs_affinity_show, dhd_sysfs_affinity_store);
+#endif /* DHDTHREAD */
+
+/*
+ * Host wakeups caused by the dongle and what woke us; any write clears the
+ * counters.
+ */
+static ssize_t
+dhd_sysfs_wakeups_store(struct kobject *kobj, struct kobj_attribute *attr,
+		const char *buf, size_t count)
+{
+	dhd_info_t *dhd;
+	unsigned long flags;
+
+	if (!g_sysfs.dhdp) {
+		DHD_ERROR(("%s: not initialized yet\n", __FUNCTION__));
+		return -EFAULT;
+	}
+	dhd = (dhd_info_t *)g_sysfs.dhdp->info;
+
+	spin_lock_irqsave(&dhd->wake_stats_lock, flags);
+	memset(&dhd->wake_stats, 0, sizeof(dhd->wake_stats));
+	dhd->wake_pending = FALSE;
+	spin_unlock_irqrestore(&dhd->wake_stats_lock, flags);
+
+	return count;
+}
+
+static ssize_t
+dhd_sysfs_wakeups_show(struct kobject *kobj, struct kobj_attribute *attr,
+		char *buf)
+{
+	dhd_info_t *dhd;
+	dhd_wake_stats_t ws;
+	unsigned long flags;
+
+	if (!g_sysfs.dhdp) {
+		DHD_ERROR(("%s: not initialized yet\n", __FUNCTION__));
+		return -EFAULT;
+	}
+	dhd = (dhd_info_t *)g_sysfs.dhdp->info;
+
+	spin_lock_irqsave(&dhd->wake_stats_lock, flags);
+	ws = dhd->wake_stats;
+	spin_unlock_irqrestore(&dhd->wake_stats_lock, flags);
+
+	return sprintf(buf, "total %u\nunattributed %u\n"
+		"pfn %u\nbatch %u\nlink %u\nevent_other %u\n"
+		"rx_ucast %u\nrx_mcast %u\nrx_bcast %u\nrx_arp %u\n",
+		ws.total, ws.unattributed, ws.ev_pfn, ws.ev_batch, ws.ev_link,
+		ws.ev_other, ws.rx_ucast, ws.rx_mcast, ws.rx_bcast, ws.rx_arp);
+}
+
+static struct kobj_attribute dhd_sysfs_wakeups_attribute =
+	__ATTR(wakeups, 0644, dhd_sysfs_wakeups_show, dhd_sysfs_wakeups_store);
+
 static struct attribute *dhd_sysfs_attrs[] = {
 	&dhd_sysfs_idletime_attribute.attr,
+	&dhd_sysfs_wakeups_attribute.attr,
+#ifdef DHDTHREAD
+	&dhd_sysfs_affinity_attribute.attr,
+#endif
 	NULL,
 };
 
@@ -6967,6 +7611,140 @@ int dhd_sysfs_init(dhd_pub_t *dhdp)
 }
 #endif /* SYSFS_IDLETIME */
 
+/*
+ * Low latency mode trades power for jitter: the dongle bus stays awake
+ * (no KSO sleep, no idle clock gating) and the watchdog runs faster. The
+ * saved settings are put back when the mode is left.
+ */
+int
+dhd_set_latency_mode(struct net_device *dev, bool enable, uint16 port)
+{
+	dhd_info_t *dhd = *(dhd_info_t **)netdev_priv(dev);
+	dhd_pub_t *dhdp;
+	uint wd_ms;
+
+	if (!dhd)
+		return -1;
+	dhdp = &dhd->pub;
+
+	dhd->latency_port = port;
+	if (enable == dhd->latency_mode)
+		return 0;
+
+	DHD_ERROR(("%s: %s low latency mode, port %u\n", __FUNCTION__,
+		enable ? "enter" : "leave", port));
+
+	if (enable) {
+		dhd->latency_saved_slpauto = dhd_slpauto;
+		dhd->latency_saved_wd = dhd_watchdog_ms;
+		dhd_bus_getidletime(dhdp, &dhd->latency_saved_idletime);
+		wd_ms = MIN(dhd_watchdog_ms, DHD_LATENCY_WD_MS);
+	} else {
+		wd_ms = dhd->latency_saved_wd;
+	}
+
+	dhd_os_sdlock(dhdp);
+	dhd_slpauto_config(dhdp, enable ? FALSE : dhd->latency_saved_slpauto);
+	dhd_os_sdunlock(dhdp);
+
+	dhd_bus_setidletime(dhdp, enable ? DHD_IDLE_ACTIVE :
+		dhd->latency_saved_idletime);
+
+	if (dhd->wd_timer_valid)
+		dhd_os_wd_timer(dhdp, wd_ms);
+	else
+		dhd_watchdog_ms = wd_ms;
+
+	dhd->latency_mode = enable;
+	return 0;
+}
+
+int
+dhd_get_latency_stats(struct net_device *dev, char *buf, int len)
+{
+	dhd_info_t *dhd = *(dhd_info_t **)netdev_priv(dev);
+	int n;
+
+	if (!dhd || len <= 0)
+		return -1;
+
+	n = snprintf(buf, len, "latency mode %s, port %u, watchdog %u ms\n",
+		dhd->latency_mode ? "on" : "off", dhd->latency_port,
+		dhd_watchdog_ms);
+#ifdef QMONITOR
+	if (n < len)
+		n += dhd_qmon_latency_dump(&dhd->pub, buf + n, len - n);
+#endif /* QMONITOR */
+
+	return MIN(n, len - 1);
+}
+
+/*
+ * What the suspend offloads caught: ARP and NS requests answered or dropped
+ * in the dongle and per filter matches. With "clear" the counters are reset
+ * once reported.
+ */
+int
+dhd_dev_get_offload_stats(struct net_device *dev, char *buf, int len, bool clear)
+{
+	dhd_info_t *dhd = *(dhd_info_t **)netdev_priv(dev);
+	dhd_pub_t *dhdp;
+	int n = 0;
+#ifdef ARP_OFFLOAD_SUPPORT
+	struct arp_ol_stats_t arp;
+#endif
+	struct nd_ol_stats_t nd;
+#ifdef PKT_FILTER_SUPPORT
+	wl_pkt_filter_stats_t pf;
+	int i, id, totals = 0;
+#endif
+
+	if (!dhd || len <= 0)
+		return -1;
+	dhdp = &dhd->pub;
+	if (!dhdp->up)
+		return -ENODEV;
+
+#ifdef ARP_OFFLOAD_SUPPORT
+	if (dhd_arp_get_stats(dhdp, &arp) == 0) {
+		n += snprintf(buf + n, len - n, "arp: hostip %u request %u "
+			"request_drop %u reply %u reply_drop %u service %u\n",
+			arp.host_ip_entries, arp.peer_request,
+			arp.peer_request_drop, arp.peer_reply,
+			arp.peer_reply_drop, arp.peer_service);
+		if (clear)
+			dhd_arp_clear_stats(dhdp);
+	}
+#endif /* ARP_OFFLOAD_SUPPORT */
+	if (n < len && dhd_ndo_get_stats(dhdp, &nd) == 0) {
+		n += snprintf(buf + n, len - n, "nd: hostip %u request %u "
+			"request_drop %u reply_drop %u service %u\n",
+			nd.host_ip_entries, nd.peer_request,
+			nd.peer_request_drop, nd.peer_reply_drop,
+			nd.peer_service);
+		if (clear)
+			dhd_ndo_clear_stats(dhdp);
+	}
+#ifdef PKT_FILTER_SUPPORT
+	for (i = 0; i < dhdp->pktfilter_count && n < len; i++) {
+		if ((id = dhd_pktfilter_id(dhdp->pktfilter[i])) <= 0 ||
+			dhd_pktfilter_get_stats(dhdp, id, &pf) < 0)
+			continue;
+		if (!totals++)
+			n += snprintf(buf + n, len - n, "filter: forwarded %u "
+				"discarded %u\n", pf.num_pkts_forwarded,
+				pf.num_pkts_discarded);
+		if (n < len)
+			n += snprintf(buf + n, len - n, "filter %d: matched %u\n",
+				id, pf.num_pkts_matched);
+		if (clear)
+			dhd_pktfilter_clear_stats(dhdp, id);
+	}
+#endif /* PKT_FILTER_SUPPORT */
+
+	return MIN(n, len - 1);
+}
+
 int
 dhd_set_slpauto_mode(struct net_device *dev, s32 val)
 {
@@ -47,7 +47,9 @@
 #include <dhd_wlfc.h>
 
 #if defined(BCMDRIVER)
-#define QMON_SYSUPTIME() ((uint64)(jiffies_to_usecs(jiffies)))
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#define QMON_SYSUPTIME() ((uint64)ktime_to_us(ktime_get()))
 #else
 	#error "target not yet supported"
 #endif
@@ -93,11 +95,28 @@ dhd_qmon_reset(dhd_qmon_t* qmon)
 	qmon->queued_time_cumul_last = 0;
 	qmon->queued_time_last = 0;
 	qmon->queued_time_last_io = 0;
+	qmon->lat_stamp = 0;
+	qmon->lat_cumul = 0;
+	qmon->lat_pkts = 0;
+	qmon->transitq_max = 0;
+}
+
+static void
+dhd_qmon_lat_account(dhd_qmon_t* qmon, uint64 now)
+{
+	if (qmon->lat_stamp)
+		qmon->lat_cumul += (uint64)qmon->transitq_count *
+			(now - qmon->lat_stamp);
+	qmon->lat_stamp = now;
 }
 
 void
 dhd_qmon_tx(dhd_qmon_t* qmon)
 {
+	dhd_qmon_lat_account(qmon, QMON_SYSUPTIME());
+	if (qmon->transitq_count + 1 > qmon->transitq_max)
+		qmon->transitq_max = qmon->transitq_count + 1;
+
 	if ((++qmon->transitq_count > qmon->queued_time_thres) &&
 	    (qmon->queued_time_last == 0)) {
 		/* Set timestamp when transit packet above a threshold */
@@ -110,6 +129,8 @@ dhd_qmon_txcomplete(dhd_qmon_t* qmon)
 {
 	uint64 now = QMON_SYSUPTIME();
 
+	dhd_qmon_lat_account(qmon, now);
+	qmon->lat_pkts++;
 	qmon->transitq_count--;
 	if ((qmon->transitq_count <= qmon->queued_time_thres) &&
 	    (qmon->queued_time_last != 0)) {
@@ -167,3 +188,57 @@ dhd_qmon_getpercent(dhd_pub_t *dhdp)
 
 	return percent;
 }
+
+static int
+dhd_qmon_latency_entry(wlfc_mac_descriptor_t *entry, char *buf, int len)
+{
+	dhd_qmon_t *qmon = &entry->qmon;
+	uint32 avg_us = 0;
+
+	if (qmon->lat_pkts)
+		avg_us = (uint32)div_u64(qmon->lat_cumul, qmon->lat_pkts);
+
+	return snprintf(buf, len, "%02x:%02x:%02x:%02x:%02x:%02x if %u "
+		"pkts %u avg_us %u inflight %u max %u\n",
+		entry->ea[0], entry->ea[1], entry->ea[2], entry->ea[3],
+		entry->ea[4], entry->ea[5], entry->interface_id,
+		qmon->lat_pkts, avg_us, qmon->transitq_count,
+		qmon->transitq_max);
+}
+
+/*
+ * Per destination host-to-status latency, the mean time a packet spent
+ * between being queued for the dongle and its TX status coming back.
+ */
+int
+dhd_qmon_latency_dump(dhd_pub_t *dhdp, char *buf, int len)
+{
+	athost_wl_status_info_t *wlfc;
+	wlfc_mac_descriptor_t *entry;
+	int i, n = 0;
+
+	if (len <= 0)
+		return 0;
+	buf[0] = '\0';
+
+	dhd_os_wlfc_block(dhdp);
+	wlfc = (athost_wl_status_info_t*)dhdp->wlfc_state;
+	if (wlfc == NULL) {
+		dhd_os_wlfc_unblock(dhdp);
+		return 0;
+	}
+
+	for (i = 0; i < WLFC_MAX_IFNUM && n < len; i++) {
+		entry = &wlfc->destination_entries.interfaces[i];
+		if (entry->occupied)
+			n += dhd_qmon_latency_entry(entry, buf + n, len - n);
+	}
+	for (i = 0; i < WLFC_MAC_DESC_TABLE_SIZE && n < len; i++) {
+		entry = &wlfc->destination_entries.nodes[i];
+		if (entry->occupied)
+			n += dhd_qmon_latency_entry(entry, buf + n, len - n);
+	}
+	dhd_os_wlfc_unblock(dhdp);
+
+	return MIN(n, len - 1);
+}
@@ -44,6 +44,11 @@ typedef struct dhd_qmon_s {
 	uint64  queued_time_cumul_last;
 	uint64  queued_time_last;
 	uint64  queued_time_last_io;
+	/* Little's law latency: packets in transit integrated over time */
+	uint64  lat_stamp;
+	uint64  lat_cumul;
+	uint32  lat_pkts;
+	uint32  transitq_max;
 } dhd_qmon_t;
 
 
@@ -52,6 +57,7 @@ extern void dhd_qmon_tx(dhd_qmon_t* entry);
 extern void dhd_qmon_txcomplete(dhd_qmon_t* entry);
 extern int dhd_qmon_getpercent(dhd_pub_t *dhdp);
 extern int dhd_qmon_thres(dhd_pub_t *dhdp, int set, int setval);
+extern int dhd_qmon_latency_dump(dhd_pub_t *dhdp, char *buf, int len);
 
 
 #endif	/* _dhd_qmon_h_ */
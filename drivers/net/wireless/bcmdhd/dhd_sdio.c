@@ -66,6 +66,14 @@
 #include <dhdioctl.h>
 #include <sdiovar.h>
 
+#ifdef BCMSDIOH_TXGLOM
+#include <linux/hrtimer.h>
+#endif
+#if defined(BCMSDIOH_TXGLOM) || defined(SDTEST)
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#endif
+
 bool dhd_mp_halting(dhd_pub_t *dhdp);
 extern void bcmsdh_waitfor_iodrain(void *sdh);
 extern void bcmsdh_reject_ioreqs(void *sdh, bool reject);
@@ -115,6 +123,9 @@ extern bool  bcmsdh_fatal_error(void *sdh);
 
 #ifdef SDTEST
 #define SDPCM_RESERVE	(SDPCM_HDRLEN + SDPCM_TEST_HDRLEN + DHD_SDALIGN)
+/* Echo latency histogram: four linear bins per power of two, up to ~2 s */
+#define PKTGEN_LAT_BINS		80
+#define PKTGEN_LAT_MAX_US	((1 << 21) - 1)
 #else
 #define SDPCM_RESERVE	(SDPCM_HDRLEN + DHD_SDALIGN)
 #endif
@@ -287,6 +298,8 @@ typedef struct dhd_bus {
 	int32		sd_mode;		/* Mode control to bus driver */
 	int32		sd_rxchain;		/* If bcmsdh api accepts PKT chains */
 	bool		use_rxchain;		/* If dhd should use PKT chains */
+	uint		rxglom_chained;		/* Superframes read straight into the chain */
+	uint		rxglom_copied;		/* Superframes bounced through databuf */
 	bool		sleeping;		/* Is SDIO bus sleeping? */
 	uint		rxflow_mode;		/* Rx flow control mode */
 	bool		rxflow;			/* Is rx flow control on */
@@ -328,6 +341,19 @@ typedef struct dhd_bus {
 #define PKTGEN_RCV_ONGOING  (1)
 	uint16		pktgen_rcv_state;		/* receive state */
 	uint		pktgen_rcvd_rcvsession;	/* test pkts rcvd per rcv session. */
+
+	/* pktgen benchmark results, see dhdsdio_pktgen_stats_get() */
+	ktime_t		pktgen_start;		/* Start of the measured run */
+	uint		pktgen_tx_pkts;
+	uint		pktgen_tx_bytes;
+	uint		pktgen_rx_pkts;
+	uint		pktgen_rx_bytes;
+	uint32		pktgen_txts[256];	/* Echo tx time (us), by sequence byte */
+	uint		pktgen_lat_hist[PKTGEN_LAT_BINS];
+	uint		pktgen_lat_samples;
+	uint		pktgen_lat_min;
+	uint		pktgen_lat_max;
+	uint64		pktgen_lat_sum;
 #endif /* SDTEST */
 
 	/* Some additional counters */
@@ -373,6 +399,17 @@ typedef struct dhd_bus {
 	bool		glom_enable;	/* Flag to indicate whether tx glom is enabled/disabled */
 	uint8		glom_mode;	/* Glom mode - 0-copy mode, 1 - Multi-descriptor mode */
 	uint32		glomsize;	/* Glom size limitation */
+	uint		glom_adapt;	/* Current adaptive glom size, <= glomsize */
+	uint		glom_partial;	/* Consecutive superframes below glom_adapt */
+	uint32		glom_rate[SDPCM_MAXGLOM_SIZE + 1]; /* Bytes/ms per size, EWMA */
+	struct hrtimer	glom_timer;	/* Ends a coalescing hold */
+	bool		glom_hold;	/* Holding TX to let the queue fill */
+	bool		glom_held;	/* Already held once for this superframe */
+	uint		glom_frames;	/* Superframes sent */
+	uint		glom_pkts;	/* Packets sent in superframes */
+	uint		glom_holds;	/* Coalescing holds started */
+	uint		glom_grow;	/* Adaptive size increases */
+	uint		glom_shrink;	/* Adaptive size decreases */
 #endif
 } dhd_bus_t;
 
@@ -396,6 +433,9 @@ extern uint dhd_watchdog_ms;
 
 extern void dhd_os_wd_timer(void *bus, uint wdtick);
 
+/* Subframes a chained superframe read can scatter into (host SG entries) */
+#define DHD_RXCHAIN_MAX_SUBFRAMES	32
+
 /* Tx/Rx bounds */
 uint dhd_txbound;
 uint dhd_rxbound;
@@ -411,6 +451,19 @@ uint dhd_dpcpoll = FALSE;
 module_param(dhd_doflow, uint, 0644);
 module_param(dhd_dpcpoll, uint, 0644);
 
+#ifdef BCMSDIOH_TXGLOM
+/* Longest time TX is held back to let a superframe fill, 0 disables */
+uint dhd_txglom_coalesce_us = 500;
+module_param(dhd_txglom_coalesce_us, uint, 0644);
+
+/* Partial superframes in a row before the adaptive glom size shrinks */
+#define GLOM_DECAY_CNT	8
+
+#define GLOM_HOLD(bus)	((bus)->glom_hold)
+#else
+#define GLOM_HOLD(bus)	FALSE
+#endif /* BCMSDIOH_TXGLOM */
+
 static bool dhd_alignctl;
 
 static bool sd1idle;
@@ -551,6 +604,8 @@ do { \
 #ifdef SDTEST
 static void dhdsdio_testrcv(dhd_bus_t *bus, void *pkt, uint seq);
 static void dhdsdio_sdtest_set(dhd_bus_t *bus, uint count);
+static void dhdsdio_pktgen_stats_reset(dhd_bus_t *bus);
+static void dhdsdio_pktgen_stats_get(dhd_bus_t *bus, dhd_pktgen_stats_t *st);
 #endif
 
 #ifdef DHD_DEBUG
@@ -2247,6 +2302,82 @@ dhd_bus_txdata(struct dhd_bus *bus, void *pkt)
 	return ret;
 }
 
+#ifdef BCMSDIOH_TXGLOM
+static enum hrtimer_restart
+dhdsdio_glom_timer(struct hrtimer *timer)
+{
+	dhd_bus_t *bus = container_of(timer, dhd_bus_t, glom_timer);
+
+	bus->glom_hold = FALSE;
+	if (!bus->dpc_sched) {
+		bus->dpc_sched = TRUE;
+		dhd_sched_dpc(bus->dhd);
+	}
+	return HRTIMER_NORESTART;
+}
+
+static void
+dhdsdio_glom_reset(dhd_bus_t *bus)
+{
+	bus->glom_adapt = MAX(bus->glomsize, 1);
+	bus->glom_partial = 0;
+	bzero(bus->glom_rate, sizeof(bus->glom_rate));
+}
+
+/*
+ * Pick the glom size for the next superframe from how this one went: grow
+ * while there is a backlog to fill a bigger one and bigger ones have not
+ * been measured slower, fall back when the next smaller size moved clearly
+ * more bytes per ms, halve on a bus error and drift down when the traffic
+ * no longer fills the superframes.
+ */
+static void
+dhdsdio_glom_adapt(dhd_bus_t *bus, uint glom_cnt, uint datalen, uint32 us,
+	uint backlog, int ret)
+{
+	uint size = MIN(bus->glom_adapt, bus->glomsize);
+	uint32 rate;
+
+	if (ret != BCME_OK) {
+		bus->glom_adapt = MAX(size / 2, 1);
+		bus->glom_partial = 0;
+		bus->glom_shrink++;
+		return;
+	}
+
+	if (glom_cnt < size) {
+		if (!backlog && ++bus->glom_partial >= GLOM_DECAY_CNT) {
+			bus->glom_partial = 0;
+			if (size > 1) {
+				bus->glom_adapt = size - 1;
+				bus->glom_shrink++;
+			}
+		}
+		return;
+	}
+	bus->glom_partial = 0;
+
+	rate = datalen * 1000 / MAX(us, 1);
+	if (bus->glom_rate[size])
+		bus->glom_rate[size] = (bus->glom_rate[size] * 3 + rate) / 4;
+	else
+		bus->glom_rate[size] = rate;
+
+	if (backlog >= size && size < bus->glomsize &&
+	    (!bus->glom_rate[size + 1] ||
+	     bus->glom_rate[size + 1] >= bus->glom_rate[size])) {
+		bus->glom_adapt = size + 1;
+		bus->glom_grow++;
+	} else if (size > 1 && bus->glom_rate[size - 1] >
+		   bus->glom_rate[size] + bus->glom_rate[size] / 8) {
+		bus->glom_adapt = size - 1;
+		bus->glom_shrink++;
+	} else {
+		bus->glom_adapt = size;
+	}
+}
+#endif /* BCMSDIOH_TXGLOM */
+
 static uint
 dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 {
@@ -2261,6 +2392,8 @@ dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 #ifdef BCMSDIOH_TXGLOM
 	uint i;
 	uint8 glom_cnt;
+	uint glom_max, qlen;
+	ktime_t start;
 #endif
 
 	dhd_pub_t *dhd = bus->dhd;
@@ -2280,9 +2413,38 @@ dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 #ifdef BCMSDIOH_TXGLOM
 		if (bus->glom_enable) {
 			void *pkttable[SDPCM_MAXGLOM_SIZE];
+			glom_max = MAX(MIN(bus->glom_adapt, bus->glomsize), 1);
 			dhd_os_sdlock_txq(bus->dhd);
-			glom_cnt = MIN(DATABUFCNT(bus), bus->glomsize);
-			glom_cnt = MIN(glom_cnt, pktq_mlen(&bus->txq, tx_prec_map));
+			qlen = pktq_mlen(&bus->txq, tx_prec_map);
+
+			/*
+			 * A short queue would go out as a small superframe;
+			 * wait once, briefly, for it to fill up to glom_max.
+			 */
+			if (qlen < glom_max && cnt == 0 && !bus->glom_held &&
+			    dhd_txglom_coalesce_us) {
+				bus->glom_hold = TRUE;
+				bus->glom_held = TRUE;
+				bus->glom_holds++;
+				dhd_os_sdunlock_txq(bus->dhd);
+				hrtimer_start(&bus->glom_timer,
+					ns_to_ktime(dhd_txglom_coalesce_us *
+						    NSEC_PER_USEC),
+					HRTIMER_MODE_REL);
+				break;
+			}
+			if (bus->glom_hold) {
+				if (qlen < glom_max) {
+					dhd_os_sdunlock_txq(bus->dhd);
+					break;
+				}
+				bus->glom_hold = FALSE;
+				hrtimer_try_to_cancel(&bus->glom_timer);
+			}
+			bus->glom_held = FALSE;
+
+			glom_cnt = MIN(DATABUFCNT(bus), glom_max);
+			glom_cnt = MIN(glom_cnt, qlen);
 			glom_cnt = MIN(glom_cnt, maxframes-cnt);
 
 			/* Limiting the size to 2pkts in case of copy */
@@ -2298,6 +2460,7 @@ dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 			if (glom_cnt == 0)
 				break;
 			datalen = 0;
+			start = ktime_get();
 			for (i = 0; i < glom_cnt; i++) {
 				uint datalen_tmp = 0;
 
@@ -2325,6 +2488,11 @@ dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 				if (ret == BCME_OK)
 					datalen += datalen_tmp;
 			}
+			bus->glom_frames++;
+			bus->glom_pkts += i;
+			dhdsdio_glom_adapt(bus, i, datalen,
+				(uint32)ktime_us_delta(ktime_get(), start),
+				txpktqlen, ret);
 			cnt += i-1;
 		} else
 #endif /* BCMSDIOH_TXGLOM */
@@ -2723,6 +2891,7 @@ enum {
 #endif /* SDIO_CRC_ERROR_FIX */
 #ifdef SDTEST
 	IOV_PKTGEN,
+	IOV_PKTGEN_STATS,
 	IOV_EXTLOOP,
 #endif /* SDTEST */
 	IOV_SPROM,
@@ -2782,6 +2951,7 @@ const bcm_iovar_t dhdsdio_iovars[] = {
 #ifdef SDTEST
 	{"extloop",	IOV_EXTLOOP,	0,	IOVT_BOOL,	0 },
 	{"pktgen",	IOV_PKTGEN,	0,	IOVT_BUFFER,	sizeof(dhd_pktgen_t) },
+	{"pktgen_stats", IOV_PKTGEN_STATS, 0, IOVT_BUFFER, sizeof(dhd_pktgen_stats_t) },
 #endif /* SDTEST */
 #if defined(SDIO_CRC_ERROR_FIX)
 	{"watermark",	IOV_WATERMARK,	0,	IOVT_UINT32,	0 },
@@ -2840,6 +3010,14 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 	            bus->fc_rcvd, bus->fc_xoff, bus->fc_xon);
 	bcm_bprintf(strbuf, "rxglomfail %u, rxglomframes %u, rxglompkts %u\n",
 	            bus->rxglomfail, bus->rxglomframes, bus->rxglompkts);
+	bcm_bprintf(strbuf, "rxglom chained %u, copied %u\n",
+	            bus->rxglom_chained, bus->rxglom_copied);
+#ifdef BCMSDIOH_TXGLOM
+	bcm_bprintf(strbuf, "txglom size %u/%u, frames %u, pkts %u, holds %u, "
+	            "grow %u, shrink %u\n", bus->glom_adapt, bus->glomsize,
+	            bus->glom_frames, bus->glom_pkts, bus->glom_holds,
+	            bus->glom_grow, bus->glom_shrink);
+#endif
 	bcm_bprintf(strbuf, "f2rx (hdrs/data) %u (%u/%u), f2tx %u f1regs %u\n",
 	            (bus->f2rxhdrs + bus->f2rxdata), bus->f2rxhdrs, bus->f2rxdata,
 	            bus->f2txdata, bus->f1regdata);
@@ -2886,6 +3064,20 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 		bcm_bprintf(strbuf, "send attempts %u rcvd %u fail %u\n",
 		            bus->pktgen_sent, bus->pktgen_rcvd, bus->pktgen_fail);
 	}
+	if (bus->pktgen_tx_pkts || bus->pktgen_rx_pkts) {
+		dhd_pktgen_stats_t st;
+
+		dhdsdio_pktgen_stats_get(bus, &st);
+		bcm_bprintf(strbuf, "pktgen %u ms: tx %u pkts %u kbps, "
+		            "rx %u pkts %u kbps\n", st.elapsed_us / 1000,
+		            st.tx_pkts, st.tx_kbps, st.rx_pkts, st.rx_kbps);
+		if (st.lat_samples)
+			bcm_bprintf(strbuf, "echo latency us: min %u avg %u "
+			            "p50 %u p90 %u p99 %u max %u (%u samples)\n",
+			            st.lat_min_us, st.lat_avg_us, st.lat_p50_us,
+			            st.lat_p90_us, st.lat_p99_us, st.lat_max_us,
+			            st.lat_samples);
+	}
 #endif /* SDTEST */
 #ifdef DHD_DEBUG
 	bcm_bprintf(strbuf, "dpc_sched %d host interrupt%spending\n",
@@ -2906,6 +3098,11 @@ dhd_bus_clearcounts(dhd_pub_t *dhdp)
 	bus->rx_hdrfail = bus->rx_badhdr = bus->rx_badseq = 0;
 	bus->tx_sderrs = bus->fc_rcvd = bus->fc_xoff = bus->fc_xon = 0;
 	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = 0;
+	bus->rxglom_chained = bus->rxglom_copied = 0;
+#ifdef BCMSDIOH_TXGLOM
+	bus->glom_frames = bus->glom_pkts = bus->glom_holds = 0;
+	bus->glom_grow = bus->glom_shrink = 0;
+#endif
 	bus->f2rxhdrs = bus->f2rxdata = bus->f2txdata = bus->f1regdata = 0;
 }
 
@@ -2964,6 +3161,7 @@ dhdsdio_pktgen_set(dhd_bus_t *bus, uint8 *arg)
 	if (bus->pktgen_count && (!oldcnt || oldmode != bus->pktgen_mode)) {
 		bus->pktgen_sent = bus->pktgen_prev_sent = bus->pktgen_rcvd = 0;
 		bus->pktgen_prev_rcvd = bus->pktgen_fail = 0;
+		dhdsdio_pktgen_stats_reset(bus);
 	}
 
 	return 0;
@@ -3913,6 +4111,14 @@ dhdsdio_doiovar(dhd_bus_t *bus, const bcm_iovar_t *vi, uint32 actionid, const ch
 	case IOV_SVAL(IOV_PKTGEN):
 		bcmerror = dhdsdio_pktgen_set(bus, arg);
 		break;
+
+	case IOV_GVAL(IOV_PKTGEN_STATS):
+		dhdsdio_pktgen_stats_get(bus, (dhd_pktgen_stats_t *)arg);
+		break;
+
+	case IOV_SVAL(IOV_PKTGEN_STATS):
+		dhdsdio_pktgen_stats_reset(bus);
+		break;
 #endif /* SDTEST */
 
 #if defined(SDIO_CRC_ERROR_FIX)
@@ -4037,6 +4243,7 @@ dhdsdio_doiovar(dhd_bus_t *bus, const bcm_iovar_t *vi, uint32 actionid, const ch
 			bcmerror = BCME_ERROR;
 		} else {
 			bus->glomsize = (uint)int_val;
+			dhdsdio_glom_reset(bus);
 		}
 		break;
 	case IOV_GVAL(IOV_TXGLOMMODE):
@@ -4462,6 +4669,11 @@ dhd_bus_stop(struct dhd_bus *bus, bool enforce_mutex)
 
 	bcmsdh_waitlockfree(NULL);
 
+#ifdef BCMSDIOH_TXGLOM
+	hrtimer_cancel(&bus->glom_timer);
+	bus->glom_hold = bus->glom_held = FALSE;
+#endif
+
 	if (enforce_mutex)
 		dhd_os_sdlock(bus->dhd);
 
@@ -4934,8 +5146,8 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 				break;
 			}
 			if (sublen % DHD_SDALIGN) {
-				DHD_ERROR(("%s: sublen %d not a multiple of %d\n",
-				           __FUNCTION__, sublen, DHD_SDALIGN));
+				DHD_GLOM(("%s: sublen %d not a multiple of %d\n",
+				          __FUNCTION__, sublen, DHD_SDALIGN));
 				usechain = FALSE;
 			}
 			totlen += sublen;
@@ -5007,6 +5219,10 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 
 		pfirst = bus->glom;
 		dlen = (uint16)pkttotlen(osh, pfirst);
+		for (num = 0, pnext = pfirst; pnext; pnext = PKTNEXT(osh, pnext))
+			num++;
+		if (num > DHD_RXCHAIN_MAX_SUBFRAMES)
+			usechain = FALSE;
 
 		/* Do an SDIO read for the superframe.  Configurable iovar to
 		 * read directly into the chained packet, or allocate a large
@@ -5017,7 +5233,9 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 			                              bcmsdh_cur_sbwad(bus->sdh), SDIO_FUNC_2,
 			                              F2SYNC, (uint8*)PKTDATA(osh, pfirst),
 			                              dlen, pfirst, NULL, NULL);
+			bus->rxglom_chained++;
 		} else if (bus->dataptr) {
+			bus->rxglom_copied++;
 			errcode = dhd_bcmsdh_recv_buf(bus,
 			                              bcmsdh_cur_sbwad(bus->sdh), SDIO_FUNC_2,
 			                              F2SYNC, bus->dataptr,
@@ -6260,7 +6478,8 @@ clkwait:
 	} else if (bus->clkstate == CLK_PENDING) {
 		/* Awaiting I_CHIPACTIVE; don't resched */
 	} else if (bus->intstatus || bus->ipend ||
-	           (!bus->fcstate && pktq_mlen(&bus->txq, ~bus->flowcontrol) && DATAOK(bus)) ||
+	           (!bus->fcstate && pktq_mlen(&bus->txq, ~bus->flowcontrol) && DATAOK(bus) &&
+	            !GLOM_HOLD(bus)) ||
 			PKT_AVAILABLE(bus, bus->intstatus)) {  /* Read multiple frames */
 		resched = TRUE;
 	}
@@ -6357,6 +6576,104 @@ dhdsdio_isr(void *arg)
 }
 
 #ifdef SDTEST
+static uint
+dhdsdio_pktgen_lat_bin(uint us)
+{
+	uint log;
+
+	if (us < 4)
+		return us;
+	us = MIN(us, PKTGEN_LAT_MAX_US);
+	log = fls(us) - 1;
+	return (log - 1) * 4 + ((us >> (log - 2)) & 3);
+}
+
+/* Largest latency falling into "bin" */
+static uint
+dhdsdio_pktgen_lat_bin_us(uint bin)
+{
+	uint shift;
+
+	if (bin < 4)
+		return bin;
+	shift = bin / 4 - 1;
+	return ((4 + bin % 4 + 1) << shift) - 1;
+}
+
+static void
+dhdsdio_pktgen_lat_add(dhd_bus_t *bus, uint32 us)
+{
+	/* a stale slot after the sequence byte wrapped, or a lost response */
+	if (us > PKTGEN_LAT_MAX_US)
+		return;
+
+	bus->pktgen_lat_hist[dhdsdio_pktgen_lat_bin(us)]++;
+	if (!bus->pktgen_lat_samples++ || us < bus->pktgen_lat_min)
+		bus->pktgen_lat_min = us;
+	if (us > bus->pktgen_lat_max)
+		bus->pktgen_lat_max = us;
+	bus->pktgen_lat_sum += us;
+}
+
+static void
+dhdsdio_pktgen_stats_reset(dhd_bus_t *bus)
+{
+	bus->pktgen_start = ktime_get();
+	bus->pktgen_tx_pkts = bus->pktgen_tx_bytes = 0;
+	bus->pktgen_rx_pkts = bus->pktgen_rx_bytes = 0;
+	bzero(bus->pktgen_lat_hist, sizeof(bus->pktgen_lat_hist));
+	bus->pktgen_lat_samples = bus->pktgen_lat_min = bus->pktgen_lat_max = 0;
+	bus->pktgen_lat_sum = 0;
+}
+
+static uint
+dhdsdio_pktgen_lat_pct(dhd_bus_t *bus, uint pct)
+{
+	uint want = (bus->pktgen_lat_samples * pct + 99) / 100;
+	uint bin, seen = 0;
+
+	for (bin = 0; bin < PKTGEN_LAT_BINS; bin++) {
+		seen += bus->pktgen_lat_hist[bin];
+		if (seen >= want)
+			break;
+	}
+	return MIN(dhdsdio_pktgen_lat_bin_us(bin), bus->pktgen_lat_max);
+}
+
+/*
+ * Throughput and echo round trip of the current run, e.g. after
+ * "dhd pktgen" with a fixed length and "dhd txglomsize" set to the glom
+ * under test; setting pktgen_stats clears them.
+ */
+static void
+dhdsdio_pktgen_stats_get(dhd_bus_t *bus, dhd_pktgen_stats_t *st)
+{
+	uint64 us = ktime_us_delta(ktime_get(), bus->pktgen_start);
+
+	bzero(st, sizeof(*st));
+	st->version = DHD_PKTGEN_STATS_VERSION;
+	st->elapsed_us = (uint)MIN(us, (uint64)UINT_MAX);
+	st->tx_pkts = bus->pktgen_tx_pkts;
+	st->tx_bytes = bus->pktgen_tx_bytes;
+	st->rx_pkts = bus->pktgen_rx_pkts;
+	st->rx_bytes = bus->pktgen_rx_bytes;
+	if (us >= 1000) {
+		/* bytes per ms is kbit/s over 8 */
+		st->tx_kbps = (uint)div64_u64((uint64)st->tx_bytes * 8000, us);
+		st->rx_kbps = (uint)div64_u64((uint64)st->rx_bytes * 8000, us);
+	}
+
+	st->lat_samples = bus->pktgen_lat_samples;
+	if (!st->lat_samples)
+		return;
+	st->lat_min_us = bus->pktgen_lat_min;
+	st->lat_max_us = bus->pktgen_lat_max;
+	st->lat_avg_us = (uint)div_u64(bus->pktgen_lat_sum, st->lat_samples);
+	st->lat_p50_us = dhdsdio_pktgen_lat_pct(bus, 50);
+	st->lat_p90_us = dhdsdio_pktgen_lat_pct(bus, 90);
+	st->lat_p99_us = dhdsdio_pktgen_lat_pct(bus, 99);
+}
+
 static void
 dhdsdio_pktgen_init(dhd_bus_t *bus)
 {
@@ -6378,6 +6695,8 @@ dhdsdio_pktgen_init(dhd_bus_t *bus)
 	/* Default to echo mode */
 	bus->pktgen_mode = DHD_PKTGEN_ECHO;
 	bus->pktgen_stop = 1;
+
+	dhdsdio_pktgen_stats_reset(bus);
 }
 
 static void
@@ -6497,10 +6816,16 @@ dhdsdio_pktgen(dhd_bus_t *bus)
 #endif
 
 		/* Send it */
+		if (bus->pktgen_mode == DHD_PKTGEN_ECHO)
+			bus->pktgen_txts[(uint8)bus->pktgen_sent] =
+				(uint32)ktime_to_us(ktime_get());
 		if (dhdsdio_txpkt(bus, pkt, SDPCM_TEST_CHANNEL, TRUE, FALSE)) {
 			bus->pktgen_fail++;
 			if (bus->pktgen_stop && bus->pktgen_stop == bus->pktgen_fail)
 				bus->pktgen_count = 0;
+		} else {
+			bus->pktgen_tx_pkts++;
+			bus->pktgen_tx_bytes += len;
 		}
 		bus->pktgen_sent++;
 
@@ -6603,6 +6928,11 @@ dhdsdio_testrcv(dhd_bus_t *bus, void *pkt, uint seq)
 			break;
 		}
 
+		dhdsdio_pktgen_lat_add(bus, (uint32)ktime_to_us(ktime_get()) -
+			bus->pktgen_txts[extra]);
+		bus->pktgen_rx_pkts++;
+		bus->pktgen_rx_bytes += len;
+
 		for (offset = 0; offset < len; offset++, data++) {
 			if (*data != SDPCM_TEST_FILL(offset, extra)) {
 				DHD_ERROR(("dhdsdio_testrcv: echo data mismatch: "
@@ -6630,6 +6960,8 @@ dhdsdio_testrcv(dhd_bus_t *bus, void *pkt, uint seq)
 		}
 		PKTFREE(osh, pkt, FALSE);
 		bus->pktgen_rcvd++;
+		bus->pktgen_rx_pkts++;
+		bus->pktgen_rx_bytes += len;
 		break;
 
 	case SDPCM_TEST_BURST:
@@ -7031,6 +7363,10 @@ dhdsdio_probe(uint16 venid, uint16 devid, uint16 bus_no, uint16 slot,
 	bus->bus = DHD_BUS;
 	bus->tx_seq = SDPCM_SEQUENCE_WRAP - 1;
 	bus->usebufpool = FALSE; /* Use bufpool if allocated, else use locally malloced rxbuf */
+#ifdef BCMSDIOH_TXGLOM
+	hrtimer_init(&bus->glom_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	bus->glom_timer.function = dhdsdio_glom_timer;
+#endif
 
 	/* attach the common module */
 	dhd_common_init(osh);
@@ -7309,6 +7645,7 @@ dhdsdio_probe_attach(struct dhd_bus *bus, osl_t *osh, void *sdh, void *regsva,
 	bus->glom_mode = bcmsdh_set_mode(bus->sdh, SDPCM_DEFGLOM_MODE);
 	/* Setting default Glom size */
 	bus->glomsize = SDPCM_DEFGLOM_SIZE;
+	dhdsdio_glom_reset(bus);
 #endif
 
 	return TRUE;
@@ -7482,6 +7819,9 @@ dhdsdio_release(dhd_bus_t *bus, osl_t *osh)
 		/* De-register interrupt handler */
 		bcmsdh_intr_disable(bus->sdh);
 		bcmsdh_intr_dereg(bus->sdh);
+#ifdef BCMSDIOH_TXGLOM
+		hrtimer_cancel(&bus->glom_timer);
+#endif
 
 		if (bus->dhd) {
 			dhdsdio_release_dongle(bus, osh, dongle_isolation, TRUE);
@@ -8209,6 +8549,27 @@ dhd_bus_membytes(dhd_pub_t *dhdp, bool set, uint32 address, uint8 *data, uint si
 	return dhdsdio_membytes(bus, set, address, data, size);
 }
 
+void
+dhd_bus_getidletime(dhd_pub_t *dhdp, int *idletime)
+{
+	*idletime = dhdp->bus->idletime;
+}
+
+void
+dhd_bus_setidletime(dhd_pub_t *dhdp, int idle_time)
+{
+	dhd_bus_t *bus = dhdp->bus;
+
+	bus->idletime = idle_time;
+
+	/* Going active, bring the clock up now rather than on the next frame */
+	if (dhdp->busstate != DHD_BUS_DOWN && idle_time == DHD_IDLE_ACTIVE) {
+		dhd_os_sdlock(dhdp);
+		BUS_WAKE(bus);
+		dhd_os_sdunlock(dhdp);
+	}
+}
+
 #ifdef SYSFS_IDLETIME
 int32 dhd_get_bus_idletime(dhd_pub_t *dhdp)
 {
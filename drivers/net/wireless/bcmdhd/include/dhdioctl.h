@@ -110,6 +110,26 @@ typedef struct dhd_pktgen {
 	uint stop;		/* Stop after this many tx failures */
 } dhd_pktgen_t;
 
+/* For pktgen_stats iovar: results of the run since pktgen was last started */
+#define DHD_PKTGEN_STATS_VERSION 1
+typedef struct dhd_pktgen_stats {
+	uint version;		/* To allow structure change tracking */
+	uint elapsed_us;	/* Time since the run started */
+	uint tx_pkts;		/* Test packets accepted by the bus */
+	uint tx_bytes;
+	uint rx_pkts;		/* Echo responses and discard packets received */
+	uint rx_bytes;
+	uint tx_kbps;		/* tx_bytes over elapsed_us */
+	uint rx_kbps;
+	uint lat_samples;	/* Echo round trips measured */
+	uint lat_min_us;
+	uint lat_avg_us;
+	uint lat_max_us;
+	uint lat_p50_us;	/* Percentiles, to the upper edge of the bin */
+	uint lat_p90_us;
+	uint lat_p99_us;
+} dhd_pktgen_stats_t;
+
 /* Version in case structure changes */
 #define DHD_PKTGEN_VERSION 2
 
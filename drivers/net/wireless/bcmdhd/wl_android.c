@@ -28,6 +28,9 @@
 #include <linux/netdevice.h>
 #include <linux/of_gpio.h>
 #include <linux/regulator/consumer.h>
+#include <linux/power_supply.h>
+#include <linux/workqueue.h>
+#include <linux/mutex.h>
 
 #include <wl_android.h>
 #include <wldev_common.h>
@@ -77,7 +80,10 @@
 #define CMD_RXFILTER_REMOVE	"RXFILTER-REMOVE"
 #define CMD_PKT_FILTER_MODE		"PKT_FILTER_MODE"
 #define CMD_PKT_FILTER_PORTS	"PKT_FILTER_PORTS"
+#define CMD_PKTFILTER_ADD	"PKTFILTER-ADD"
+#define CMD_PKTFILTER_DEL	"PKTFILTER-DEL"
 #endif /* PKT_FILTER_SUPPORT */
+#define CMD_OFFLOADSTATS	"OFFLOADSTATS"
 #define CMD_BTCOEXSCAN_START	"BTCOEXSCAN-START"
 #define CMD_BTCOEXSCAN_STOP	"BTCOEXSCAN-STOP"
 #define CMD_BTCOEXMODE		"BTCOEXMODE"
@@ -128,6 +134,8 @@
 
 #define	CMD_HAPD_MAC_FILTER	"HAPD_MAC_FILTER"
 #define	CMD_AUTOSLEEP		"AUTOSLEEP"
+#define CMD_LATENCYMODE		"LATENCYMODE"
+#define CMD_LATENCYSTATS	"LATENCYSTATS"
 /* hostap mac mode */
 #define MACLIST_MODE_DISABLED   0
 #define MACLIST_MODE_DENY       1
@@ -164,6 +172,19 @@
 static LIST_HEAD(miracast_resume_list);
 static u8 miracast_cur_mode;
 
+/* latency mode related definition */
+#define LATENCY_POWER_POLL_MS	5000
+
+static void wl_android_latency_work(struct work_struct *work);
+
+static LIST_HEAD(latency_resume_list);
+static DEFINE_MUTEX(latency_lock);
+static DECLARE_DELAYED_WORK(latency_work, wl_android_latency_work);
+static struct net_device *latency_dev;
+static bool latency_requested;
+static bool latency_active;
+static u16 latency_port;
+
 struct io_cfg {
 	s8 *iovar;
 	s32 param;
@@ -205,6 +226,8 @@ extern int dhd_os_check_if_up(void *dhdp);
 extern void *bcmsdh_get_drvdata(void);
 #endif /* BCMLXSDMMC */
 extern int dhd_set_slpauto_mode(struct net_device *dev, s32 val);
+extern int dhd_set_latency_mode(struct net_device *dev, bool enable, uint16 port);
+extern int dhd_get_latency_stats(struct net_device *dev, char *buf, int len);
 
 
 #ifdef ENABLE_4335BT_WAR
@@ -729,6 +752,8 @@ exit:
 	return ret;
 }
 
+static void wl_android_latency_stop(struct net_device *dev);
+
 int wl_android_wifi_off(struct net_device *dev)
 {
 	int ret = 0;
@@ -739,6 +764,8 @@ int wl_android_wifi_off(struct net_device *dev)
 		return -EINVAL;
 	}
 
+	wl_android_latency_stop(dev);
+
 	dhd_net_if_lock(dev);
 	if (g_wifi_on) {
 		ret = dhd_dev_reset(dev, TRUE);
@@ -1106,6 +1133,107 @@ resume:
 	return ret;
 }
 
+/* Latency mode is only allowed while running from external power */
+static bool
+wl_android_latency_allowed(void)
+{
+	return power_supply_is_system_supplied() > 0;
+}
+
+/* latency_lock held */
+static int
+wl_android_latency_apply(struct net_device *dev, bool on)
+{
+	struct io_cfg config;
+	int val = 0;
+	int ret;
+
+	if (on == latency_active)
+		return on ? dhd_set_latency_mode(dev, TRUE, latency_port) : 0;
+
+	if (!on) {
+		wl_android_iolist_resume(dev, &latency_resume_list);
+		dhd_set_latency_mode(dev, FALSE, 0);
+		latency_active = FALSE;
+		return 0;
+	}
+
+	/* turn off pm */
+	config.iovar = NULL;
+	config.ioctl = WLC_GET_PM;
+	config.arg = &val;
+	config.len = sizeof(int);
+	ret = wl_android_iolist_add(dev, &latency_resume_list, &config);
+	if (ret)
+		return ret;
+
+	ret = dhd_set_latency_mode(dev, TRUE, latency_port);
+	if (ret) {
+		wl_android_iolist_resume(dev, &latency_resume_list);
+		return ret;
+	}
+	latency_active = TRUE;
+
+	return 0;
+}
+
+/* Follow the charger: drop out of latency mode on battery, resume on AC */
+static void
+wl_android_latency_work(struct work_struct *work)
+{
+	mutex_lock(&latency_lock);
+	if (latency_requested && latency_dev) {
+		wl_android_latency_apply(latency_dev,
+			wl_android_latency_allowed());
+		schedule_delayed_work(&latency_work,
+			msecs_to_jiffies(LATENCY_POWER_POLL_MS));
+	}
+	mutex_unlock(&latency_lock);
+}
+
+static int
+wl_android_set_latency_mode(struct net_device *dev, char *command, int total_len)
+{
+	int mode, port = 0;
+	int ret;
+
+	if (sscanf(command, "%*s %d %d", &mode, &port) < 1 ||
+	    port < 0 || port > 0xffff) {
+		DHD_ERROR(("%s: Failed to get Parameter\n", __FUNCTION__));
+		return -1;
+	}
+
+	DHD_INFO(("%s: latency mode %d port %d\n", __FUNCTION__, mode, port));
+
+	cancel_delayed_work_sync(&latency_work);
+	mutex_lock(&latency_lock);
+	latency_requested = mode ? TRUE : FALSE;
+	latency_port = (u16)port;
+	latency_dev = dev;
+	ret = wl_android_latency_apply(dev,
+		latency_requested && wl_android_latency_allowed());
+	if (ret)
+		latency_requested = FALSE;
+	if (latency_requested)
+		schedule_delayed_work(&latency_work,
+			msecs_to_jiffies(LATENCY_POWER_POLL_MS));
+	mutex_unlock(&latency_lock);
+
+	return ret;
+}
+
+static void
+wl_android_latency_stop(struct net_device *dev)
+{
+	cancel_delayed_work_sync(&latency_work);
+	mutex_lock(&latency_lock);
+	if (latency_active)
+		wl_android_latency_apply(dev, FALSE);
+	latency_requested = FALSE;
+	latency_dev = NULL;
+	mutex_unlock(&latency_lock);
+}
+
 int
 wl_android_ampdu_send_delba(struct net_device *dev, char *command)
 {
@@ -1420,6 +1548,12 @@ int wl_android_priv_cmd(struct net_device *net, struct ifreq *ifr, int cmd)
 		bytes_written = dhd_set_packet_filter_ports(net,
 			&command[strlen(CMD_PKT_FILTER_PORTS) + 1]);
 		ret = bytes_written;
+	} else if (strnicmp(command, CMD_PKTFILTER_ADD, strlen(CMD_PKTFILTER_ADD)) == 0) {
+		bytes_written = net_os_pktfilter_add(net,
+			command + strlen(CMD_PKTFILTER_ADD));
+	} else if (strnicmp(command, CMD_PKTFILTER_DEL, strlen(CMD_PKTFILTER_DEL)) == 0) {
+		bytes_written = net_os_pktfilter_del(net,
+			bcm_strtoul(command + strlen(CMD_PKTFILTER_DEL), NULL, 0));
 	}
 #endif /* PKT_FILTER_SUPPORT */
 	else if (strnicmp(command, CMD_BTCOEXSCAN_START, strlen(CMD_BTCOEXSCAN_START)) == 0) {
@@ -1556,6 +1690,19 @@ priv_cmd.total_len);
 		bytes_written = wl_android_set_slpauto(net, command,
 			priv_cmd.total_len);
 	}
+	else if (strnicmp(command, CMD_LATENCYMODE, strlen(CMD_LATENCYMODE)) == 0)
+		bytes_written = wl_android_set_latency_mode(net, command,
+			priv_cmd.total_len);
+	else if (strnicmp(command, CMD_LATENCYSTATS, strlen(CMD_LATENCYSTATS)) == 0)
+		bytes_written = dhd_get_latency_stats(net, command,
+			priv_cmd.total_len);
+	else if (strnicmp(command, CMD_OFFLOADSTATS, strlen(CMD_OFFLOADSTATS)) == 0) {
+		bool clear = strnicmp(command + strlen(CMD_OFFLOADSTATS),
+			" CLEAR", strlen(" CLEAR")) == 0;
+
+		bytes_written = dhd_dev_get_offload_stats(net, command,
+			priv_cmd.total_len, clear);
+	}
 	else {
 		DHD_ERROR(("Unknown PRIVATE command %s - ignored\n", command));
 		snprintf(command, 3, "OK");
@@ -1612,6 +1759,7 @@ int wl_android_exit(void)
 {
 	int ret = 0;
 
+	cancel_delayed_work_sync(&latency_work);
 
 	return ret;
 }
@@ -19,7 +19,9 @@
 #include <linux/fdtable.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/math64.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/module.h>
@@ -107,6 +109,10 @@ module_param_named(debug_mask, binder_debug_mask, uint, S_IWUSR | S_IRUGO);
 static bool binder_debug_no_lock;
 module_param_named(proc_no_lock, binder_debug_no_lock, bool, S_IWUSR | S_IRUGO);
 
+/* let synchronous transactions from SCHED_FIFO/RR callers run the callee RT */
+static bool binder_inherit_rt = true;
+module_param_named(inherit_rt, binder_inherit_rt, bool, S_IWUSR | S_IRUGO);
+
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
 
@@ -303,6 +309,8 @@ struct binder_proc {
 	size_t free_async_space;
 
 	struct page **pages;
+	unsigned long *pages_cached;	/* mapped, but in no buffer */
+	size_t nr_pages_cached;
 	size_t buffer_size;
 	uint32_t buffer_free;
 	struct list_head todo;
@@ -313,7 +321,7 @@ struct binder_proc {
 	int requested_threads;
 	int requested_threads_started;
 	int ready_threads;
-	long default_priority;
+	struct binder_priority default_priority;
 	struct dentry *debugfs_entry;
 };
 
@@ -341,6 +349,12 @@ struct binder_thread {
 	struct binder_stats stats;
 };
 
+struct binder_priority {
+	unsigned int sched_policy;
+	int rt_prio;		/* SCHED_FIFO and SCHED_RR */
+	long nice;		/* all other policies */
+};
+
 struct binder_transaction {
 	int debug_id;
 	struct binder_work work;
@@ -355,8 +369,8 @@ struct binder_transaction {
 	struct binder_buffer *buffer;
 	unsigned int	code;
 	unsigned int	flags;
-	long	priority;
-	long	saved_priority;
+	struct binder_priority	priority;
+	struct binder_priority	saved_priority;
 	uid_t	sender_euid;
 };
 
@@ -500,15 +514,46 @@ out_unlock:
 	return -EBADF;
 }
 
+/*
+ * Contention on binder_main_lock, reported in debugfs stats and by the
+ * binder_lock_stat tracepoint. Updated with the lock held.
+ */
+static struct binder_lock_stats {
+	u64 count;
+	u64 wait_ns;
+	u64 hold_ns;
+	u64 max_hold_ns;
+	const char *max_hold_tag;
+	ktime_t acquired;
+	u64 last_wait_ns;
+} binder_lock_stats;
+
 static inline void binder_lock(const char *tag)
 {
+	ktime_t start;
+
 	trace_binder_lock(tag);
+	start = ktime_get();
 	mutex_lock(&binder_main_lock);
+	binder_lock_stats.acquired = ktime_get();
+	binder_lock_stats.last_wait_ns =
+		ktime_to_ns(ktime_sub(binder_lock_stats.acquired, start));
 	trace_binder_locked(tag);
 }
 
 static inline void binder_unlock(const char *tag)
 {
+	u64 hold = ktime_to_ns(ktime_sub(ktime_get(),
+					 binder_lock_stats.acquired));
+
+	binder_lock_stats.count++;
+	binder_lock_stats.wait_ns += binder_lock_stats.last_wait_ns;
+	binder_lock_stats.hold_ns += hold;
+	if (hold > binder_lock_stats.max_hold_ns) {
+		binder_lock_stats.max_hold_ns = hold;
+		binder_lock_stats.max_hold_tag = tag;
+	}
+	trace_binder_lock_stat(tag, binder_lock_stats.last_wait_ns, hold);
 	trace_binder_unlock(tag);
 	mutex_unlock(&binder_main_lock);
 }
@@ -530,6 +575,69 @@ static void binder_set_nice(long nice)
 	binder_user_error("binder: %d RLIMIT_NICE not set\n", current->pid);
 }
 
+static bool binder_is_rt_policy(unsigned int policy)
+{
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static struct binder_priority binder_get_priority(struct task_struct *task)
+{
+	struct binder_priority p;
+
+	p.sched_policy = task->policy;
+	p.rt_prio = binder_is_rt_policy(task->policy) ? task->rt_priority : 0;
+	p.nice = task_nice(task);
+	return p;
+}
+
+static void binder_set_priority(struct binder_priority desired)
+{
+	struct binder_priority cur = binder_get_priority(current);
+	struct sched_param param = { .sched_priority = desired.rt_prio };
+
+	if (cur.sched_policy == desired.sched_policy &&
+	    cur.rt_prio == desired.rt_prio && cur.nice == desired.nice)
+		return;
+
+	trace_binder_set_priority(current->tgid, current->pid,
+				  cur.sched_policy, cur.rt_prio, cur.nice,
+				  desired.sched_policy, desired.rt_prio,
+				  desired.nice);
+
+	if (cur.sched_policy != desired.sched_policy ||
+	    cur.rt_prio != desired.rt_prio)
+		sched_setscheduler_nocheck(current, desired.sched_policy,
+					   &param);
+	if (!binder_is_rt_policy(desired.sched_policy))
+		binder_set_nice(desired.nice);
+}
+
+/*
+ * Run the thread picking up @t at the caller's priority. Synchronous
+ * calls from RT threads make the callee RT as well, so that an audio or
+ * display thread is not stuck behind normal work in the service; the
+ * node's min_priority still acts as a floor for the nice value.
+ */
+static void binder_transaction_priority(struct binder_transaction *t,
+					struct binder_node *node)
+{
+	struct binder_priority desired = t->priority;
+
+	if (t->flags & TF_ONE_WAY) {
+		if (t->saved_priority.nice > node->min_priority)
+			binder_set_nice(node->min_priority);
+		return;
+	}
+
+	if (!binder_is_rt_policy(desired.sched_policy) || !binder_inherit_rt) {
+		desired.sched_policy = SCHED_NORMAL;
+		desired.rt_prio = 0;
+		if (desired.nice >= node->min_priority)
+			desired.nice = node->min_priority;
+	}
+	binder_set_priority(desired);
+}
+
 static size_t binder_buffer_size(struct binder_proc *proc,
 				 struct binder_buffer *buffer)
 {
@@ -622,6 +730,61 @@ static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 	return NULL;
 }
 
+/*
+ * Pages of freed buffers stay mapped in the kernel and in user space so
+ * the next transaction can reuse them without touching page tables.
+ * binder_shrink() returns them under memory pressure; release frees the
+ * rest. All of it is protected by binder_main_lock.
+ */
+static long binder_nr_pages_cached;
+
+static struct binder_page_stats {
+	u64 mapped;
+	u64 reused;
+	u64 shrunk;
+} binder_page_stats;
+
+static void binder_cache_page_range(struct binder_proc *proc,
+				    void *start, void *end)
+{
+	void *page_addr;
+
+	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
+		size_t index = (page_addr - proc->buffer) / PAGE_SIZE;
+
+		if (!proc->pages[index] ||
+		    __test_and_set_bit(index, proc->pages_cached))
+			continue;
+		proc->nr_pages_cached++;
+		binder_nr_pages_cached++;
+	}
+}
+
+static void binder_claim_cached_page(struct binder_proc *proc,
+				     void *page_addr)
+{
+	size_t index = (page_addr - proc->buffer) / PAGE_SIZE;
+
+	BUG_ON(!__test_and_clear_bit(index, proc->pages_cached));
+	proc->nr_pages_cached--;
+	binder_nr_pages_cached--;
+	binder_page_stats.reused++;
+}
+
+static bool binder_claim_cached_range(struct binder_proc *proc,
+				      void *start, void *end)
+{
+	void *page_addr;
+
+	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE)
+		if (!proc->pages[(page_addr - proc->buffer) / PAGE_SIZE])
+			return false;
+
+	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE)
+		binder_claim_cached_page(proc, page_addr);
+	return true;
+}
+
 static int binder_update_page_range(struct binder_proc *proc, int allocate,
 				    void *start, void *end,
 				    struct vm_area_struct *vma)
@@ -639,6 +802,10 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	if (end <= start)
 		return 0;
 
+	/* pages kept from a freed buffer need no page table update */
+	if (allocate && binder_claim_cached_range(proc, start, end))
+		return 0;
+
 	trace_binder_update_page_range(proc, allocate, start, end);
 
 	if (vma)
@@ -670,7 +837,10 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		struct page **page_array_ptr;
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
 
-		BUG_ON(*page);
+		if (*page) {
+			binder_claim_cached_page(proc, page_addr);
+			continue;
+		}
 		*page = alloc_page(GFP_KERNEL | __GFP_ZERO);
 		if (*page == NULL) {
 			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
@@ -697,6 +867,7 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 			goto err_vm_insert_page_failed;
 		}
 		/* vm_insert_page does not seem to increment the refcount */
+		binder_page_stats.mapped++;
 	}
 	if (mm) {
 		up_write(&mm->mmap_sem);
@@ -727,6 +898,83 @@ err_no_vma:
 	return -ENOMEM;
 }
 
+static unsigned long binder_shrink_proc(struct binder_proc *proc,
+					unsigned long nr_to_scan)
+{
+	struct vm_area_struct *vma;
+	struct mm_struct *mm;
+	unsigned long freed = 0;
+	size_t index;
+
+	/* the task is exiting, release will free the pages */
+	mm = get_task_mm(proc->tsk);
+	if (!mm)
+		return 0;
+	/* we may be reclaiming on behalf of a fault in this mm */
+	if (!down_write_trylock(&mm->mmap_sem)) {
+		mmput(mm);
+		return 0;
+	}
+	vma = proc->vma;
+	if (vma && mm != proc->vma_vm_mm)
+		vma = NULL;
+
+	for_each_set_bit(index, proc->pages_cached,
+			 proc->buffer_size / PAGE_SIZE) {
+		void *page_addr = proc->buffer + index * PAGE_SIZE;
+
+		if (freed == nr_to_scan)
+			break;
+		if (vma)
+			zap_page_range(vma, (uintptr_t)page_addr +
+				proc->user_buffer_offset, PAGE_SIZE, NULL);
+		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
+		__free_page(proc->pages[index]);
+		proc->pages[index] = NULL;
+		__clear_bit(index, proc->pages_cached);
+		proc->nr_pages_cached--;
+		binder_nr_pages_cached--;
+		freed++;
+	}
+	binder_page_stats.shrunk += freed;
+
+	up_write(&mm->mmap_sem);
+	mmput(mm);
+	return freed;
+}
+
+static int binder_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct binder_proc *proc;
+	struct hlist_node *pos;
+	unsigned long nr_to_scan = sc->nr_to_scan;
+	int ret;
+
+	if (!nr_to_scan)
+		return ACCESS_ONCE(binder_nr_pages_cached);
+
+	/* binder itself may be allocating with the lock held */
+	if (!mutex_trylock(&binder_main_lock))
+		return -1;
+
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		if (!proc->nr_pages_cached)
+			continue;
+		nr_to_scan -= binder_shrink_proc(proc, nr_to_scan);
+		if (!nr_to_scan)
+			break;
+	}
+	ret = binder_nr_pages_cached;
+	mutex_unlock(&binder_main_lock);
+
+	return ret;
+}
+
+static struct shrinker binder_shrinker = {
+	.shrink = binder_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
 static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 					      size_t data_size,
 					      size_t offsets_size, int is_async)
@@ -883,10 +1131,10 @@ static void binder_delete_free_buffer(struct binder_proc *proc,
 			     "not share page%s%s with with %p or %p\n",
 			     proc->pid, buffer, free_page_start ? "" : " end",
 			     free_page_end ? "" : " start", prev, next);
-		binder_update_page_range(proc, 0, free_page_start ?
+		binder_cache_page_range(proc, free_page_start ?
 			buffer_start_page(buffer) : buffer_end_page(buffer),
 			(free_page_end ? buffer_end_page(buffer) :
-			buffer_start_page(buffer)) + PAGE_SIZE, NULL);
+			buffer_start_page(buffer)) + PAGE_SIZE);
 	}
 }
 
@@ -919,10 +1167,9 @@ static void binder_free_buf(struct binder_proc *proc,
 			     proc->free_async_space);
 	}
 
-	binder_update_page_range(proc, 0,
+	binder_cache_page_range(proc,
 		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
-		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK),
-		NULL);
+		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK));
 	rb_erase(&buffer->rb_node, &proc->allocated_buffers);
 	buffer->free = 1;
 	if (!list_is_last(&buffer->entry, &proc->buffers)) {
@@ -1430,7 +1677,7 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		binder_set_priority(in_reply_to->saved_priority);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("binder: %d:%d got reply transaction "
 				"with bad transaction stack,"
@@ -1564,7 +1811,7 @@ static void binder_transaction(struct binder_proc *proc,
 	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
-	t->priority = task_nice(current);
+	t->priority = binder_get_priority(current);
 
 	trace_binder_transaction(reply, t, target_node);
 
@@ -2285,7 +2532,7 @@ retry:
 			wait_event_interruptible(binder_user_error_wait,
 						 binder_stop_on_user_error < 2);
 		}
-		binder_set_nice(proc->default_priority);
+		binder_set_priority(proc->default_priority);
 		if (non_block) {
 			if (!binder_has_proc_work(proc, thread))
 				ret = -EAGAIN;
@@ -2451,13 +2698,8 @@ retry:
 			struct binder_node *target_node = t->buffer->target_node;
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
-			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
-			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
+			t->saved_priority = binder_get_priority(current);
+			binder_transaction_priority(t, target_node);
 			cmd = BR_TRANSACTION;
 		} else {
 			tr.target.ptr = NULL;
@@ -2889,6 +3131,12 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 		failure_string = "alloc page array";
 		goto err_alloc_pages_failed;
 	}
+	proc->pages_cached = kzalloc(BITS_TO_LONGS((vma->vm_end - vma->vm_start) / PAGE_SIZE) * sizeof(long), GFP_KERNEL);
+	if (proc->pages_cached == NULL) {
+		ret = -ENOMEM;
+		failure_string = "alloc page cache bitmap";
+		goto err_alloc_small_buf_failed;
+	}
 	proc->buffer_size = vma->vm_end - vma->vm_start;
 
 	vma->vm_ops = &binder_vm_ops;
@@ -2915,6 +3163,8 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	return 0;
 
 err_alloc_small_buf_failed:
+	kfree(proc->pages_cached);
+	proc->pages_cached = NULL;
 	kfree(proc->pages);
 	proc->pages = NULL;
 err_alloc_pages_failed:
@@ -2944,7 +3194,7 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	proc->tsk = current;
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
-	proc->default_priority = task_nice(current);
+	proc->default_priority = binder_get_priority(current);
 
 	binder_lock(__func__);
 
@@ -3111,6 +3361,8 @@ static void binder_deferred_release(struct binder_proc *proc)
 				page_count++;
 			}
 		}
+		binder_nr_pages_cached -= proc->nr_pages_cached;
+		kfree(proc->pages_cached);
 		kfree(proc->pages);
 		vfree(proc->buffer);
 	}
@@ -3185,13 +3437,14 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 				     struct binder_transaction *t)
 {
 	seq_printf(m,
-		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %ld r%d",
+		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %u:%d:%ld r%d",
 		   prefix, t->debug_id, t,
 		   t->from ? t->from->proc->pid : 0,
 		   t->from ? t->from->pid : 0,
 		   t->to_proc ? t->to_proc->pid : 0,
 		   t->to_thread ? t->to_thread->pid : 0,
-		   t->code, t->flags, t->priority, t->need_reply);
+		   t->code, t->flags, t->priority.sched_policy,
+		   t->priority.rt_prio, t->priority.nice, t->need_reply);
 	if (t->buffer == NULL) {
 		seq_puts(m, " buffer free\n");
 		return;
@@ -3529,6 +3782,15 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 
 	seq_puts(m, "binder stats:\n");
 
+	seq_printf(m, "main lock: %llu acquired, wait %llu us, hold %llu us, max hold %llu us (%s)\n",
+		   binder_lock_stats.count,
+		   div_u64(binder_lock_stats.wait_ns, NSEC_PER_USEC),
+		   div_u64(binder_lock_stats.hold_ns, NSEC_PER_USEC),
+		   div_u64(binder_lock_stats.max_hold_ns, NSEC_PER_USEC),
+		   binder_lock_stats.max_hold_tag ?: "-");
+	seq_printf(m, "pages: %ld cached, %llu mapped, %llu reused, %llu shrunk\n",
+		   binder_nr_pages_cached, binder_page_stats.mapped,
+		   binder_page_stats.reused, binder_page_stats.shrunk);
 	print_binder_stats(m, "", &binder_stats);
 
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
@@ -3635,6 +3897,8 @@ static int __init binder_init(void)
 	if (!binder_deferred_workqueue)
 		return -ENOMEM;
 
+	register_shrinker(&binder_shrinker);
+
 	binder_debugfs_dir_entry_root = debugfs_create_dir("binder", NULL);
 	if (binder_debugfs_dir_entry_root)
 		binder_debugfs_dir_entry_proc = debugfs_create_dir("proc",
@@ -63,6 +63,56 @@ DEFINE_BINDER_LOCK_EVENT(binder_lock);
 DEFINE_BINDER_LOCK_EVENT(binder_locked);
 DEFINE_BINDER_LOCK_EVENT(binder_unlock);
 
+TRACE_EVENT(binder_set_priority,
+	TP_PROTO(int proc, int thread, unsigned int old_policy, int old_rt_prio,
+		 long old_nice, unsigned int new_policy, int new_rt_prio,
+		 long new_nice),
+	TP_ARGS(proc, thread, old_policy, old_rt_prio, old_nice,
+		new_policy, new_rt_prio, new_nice),
+	TP_STRUCT__entry(
+		__field(int, proc)
+		__field(int, thread)
+		__field(unsigned int, old_policy)
+		__field(int, old_rt_prio)
+		__field(long, old_nice)
+		__field(unsigned int, new_policy)
+		__field(int, new_rt_prio)
+		__field(long, new_nice)
+	),
+	TP_fast_assign(
+		__entry->proc = proc;
+		__entry->thread = thread;
+		__entry->old_policy = old_policy;
+		__entry->old_rt_prio = old_rt_prio;
+		__entry->old_nice = old_nice;
+		__entry->new_policy = new_policy;
+		__entry->new_rt_prio = new_rt_prio;
+		__entry->new_nice = new_nice;
+	),
+	TP_printk("proc=%d thread=%d policy %u rt %d nice %ld => policy %u rt %d nice %ld",
+		  __entry->proc, __entry->thread,
+		  __entry->old_policy, __entry->old_rt_prio, __entry->old_nice,
+		  __entry->new_policy, __entry->new_rt_prio, __entry->new_nice)
+);
+
+TRACE_EVENT(binder_lock_stat,
+	TP_PROTO(const char *tag, u64 wait_ns, u64 hold_ns),
+	TP_ARGS(tag, wait_ns, hold_ns),
+	TP_STRUCT__entry(
+		__field(const char *, tag)
+		__field(u64, wait_ns)
+		__field(u64, hold_ns)
+	),
+	TP_fast_assign(
+		__entry->tag = tag;
+		__entry->wait_ns = wait_ns;
+		__entry->hold_ns = hold_ns;
+	),
+	TP_printk("tag=%s wait=%llu ns hold=%llu ns", __entry->tag,
+		  (unsigned long long)__entry->wait_ns,
+		  (unsigned long long)__entry->hold_ns)
+);
+
 DECLARE_EVENT_CLASS(binder_function_return_class,
 	TP_PROTO(int ret),
 	TP_ARGS(ret),
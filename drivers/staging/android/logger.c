@@ -25,10 +25,31 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
 
+/*
+ * struct logger_stage - per-cpu staging area for a log
+ *
+ * Writers append whole entries here without touching log->mutex. Entries are
+ * packed back to back, each padded to LOGGER_STAGE_ALIGN so headers stay
+ * aligned. 'buf' and 'len' are protected by 'lock'; 'end' and 'pos' belong
+ * to the drain and are protected by log->mutex.
+ */
+struct logger_stage {
+	spinlock_t		lock;
+	unsigned char		*buf;
+	size_t			len;	/* bytes staged */
+	size_t			end;	/* drain snapshot of 'len' */
+	size_t			pos;	/* drain cursor */
+};
+
+#define LOGGER_STAGE_SIZE	8192
+#define LOGGER_STAGE_ALIGN	4
+
 /*
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
@@ -45,6 +66,7 @@ struct logger_log {
 	size_t			w_off;	/* current write head offset */
 	size_t			head;	/* new readers start here */
 	size_t			size;	/* size of the log */
+	struct logger_stage __percpu *stage; /* per-cpu write staging */
 };
 
 /*
@@ -61,6 +83,8 @@ struct logger_reader {
 	int			r_ver;	/* reader ABI version */
 };
 
+static void logger_drain(struct logger_log *log);
+
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
 size_t logger_offset(struct logger_log *log, size_t n)
 {
@@ -265,6 +289,7 @@ start:
 
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
+		logger_drain(log);
 		ret = (log->w_off == reader->r_off);
 		mutex_unlock(&log->mutex);
 		if (!ret)
@@ -406,6 +431,144 @@ static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 
 }
 
+static inline bool entry_before(struct logger_entry *a, struct logger_entry *b)
+{
+	return a->sec < b->sec || (a->sec == b->sec && a->nsec < b->nsec);
+}
+
+/*
+ * logger_drain - move every staged entry into the ring buffer, merging the
+ * per-cpu staging areas in timestamp order. Entries staged while we merge
+ * are left for the next drain.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void logger_drain(struct logger_log *log)
+{
+	struct logger_stage *stage;
+	size_t pending = 0;
+	int cpu;
+
+	if (!log->stage)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		stage = per_cpu_ptr(log->stage, cpu);
+		spin_lock(&stage->lock);
+		stage->end = stage->len;
+		spin_unlock(&stage->lock);
+		stage->pos = 0;
+		pending |= stage->end;
+	}
+
+	if (!pending)
+		return;
+
+	/*
+	 * Each staging area is already in timestamp order, because writers
+	 * stamp entries under the area's lock. Nothing but the drain ever
+	 * moves data below 'end', so the snapshot can be read unlocked.
+	 */
+	for (;;) {
+		struct logger_stage *best = NULL;
+		struct logger_entry *best_entry = NULL;
+		size_t len;
+
+		for_each_possible_cpu(cpu) {
+			struct logger_entry *entry;
+
+			stage = per_cpu_ptr(log->stage, cpu);
+			if (stage->pos == stage->end)
+				continue;
+
+			entry = (struct logger_entry *)(stage->buf + stage->pos);
+			if (!best || entry_before(entry, best_entry)) {
+				best = stage;
+				best_entry = entry;
+			}
+		}
+
+		if (!best)
+			break;
+
+		len = sizeof(struct logger_entry) + best_entry->len;
+		fix_up_readers(log, len);
+		do_write_log(log, best_entry, len);
+		best->pos += ALIGN(len, LOGGER_STAGE_ALIGN);
+	}
+
+	for_each_possible_cpu(cpu) {
+		stage = per_cpu_ptr(log->stage, cpu);
+		if (!stage->end)
+			continue;
+
+		spin_lock(&stage->lock);
+		memmove(stage->buf, stage->buf + stage->end,
+			stage->len - stage->end);
+		stage->len -= stage->end;
+		spin_unlock(&stage->lock);
+	}
+}
+
+/*
+ * logger_stage_write - try to stage an entry on this cpu without taking
+ * log->mutex. The payload is copied with page faults disabled; if it would
+ * fault, or the staging area is full, returns false and the caller takes the
+ * locked path instead.
+ */
+static bool logger_stage_write(struct logger_log *log,
+			       struct logger_entry *header,
+			       const struct iovec *iov, unsigned long nr_segs)
+{
+	struct logger_stage *stage;
+	size_t need = ALIGN(sizeof(struct logger_entry) + header->len,
+			    LOGGER_STAGE_ALIGN);
+	bool staged = false;
+
+	if (!log->stage)
+		return false;
+
+	stage = get_cpu_ptr(log->stage);
+	spin_lock(&stage->lock);
+
+	if (stage->len + need <= LOGGER_STAGE_SIZE) {
+		unsigned char *msg = stage->buf + stage->len +
+			sizeof(struct logger_entry);
+		struct timespec now;
+		size_t done = 0;
+
+		pagefault_disable();
+		while (nr_segs-- > 0) {
+			size_t len = min_t(size_t, iov->iov_len,
+					   header->len - done);
+
+			if (len && (!access_ok(VERIFY_READ, iov->iov_base, len) ||
+				    __copy_from_user_inatomic(msg + done,
+							      iov->iov_base,
+							      len)))
+				break;
+			iov++;
+			done += len;
+		}
+		pagefault_enable();
+
+		if (done == header->len) {
+			now = current_kernel_time();
+			header->sec = now.tv_sec;
+			header->nsec = now.tv_nsec;
+			memcpy(stage->buf + stage->len, header,
+			       sizeof(struct logger_entry));
+			stage->len += need;
+			staged = true;
+		}
+	}
+
+	spin_unlock(&stage->lock);
+	put_cpu_ptr(log->stage);
+
+	return staged;
+}
+
 /*
  * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
  * the log 'log'
@@ -441,23 +604,20 @@ static ssize_t do_write_log_from_user(struct logger_log *log,
 /*
  * logger_aio_write - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
- * them above all else.
+ * them above all else: the common case stages the entry on the local cpu and
+ * never touches log->mutex.
  */
 ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
+	size_t orig;
 	struct logger_entry header;
 	struct timespec now;
 	ssize_t ret = 0;
 
-	now = current_kernel_time();
-
 	header.pid = current->tgid;
 	header.tid = current->pid;
-	header.sec = now.tv_sec;
-	header.nsec = now.tv_nsec;
 	header.euid = current_euid();
 	header.len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
 	header.hdr_size = sizeof(struct logger_entry);
@@ -466,8 +626,21 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
+	if (logger_stage_write(log, &header, iov, nr_segs)) {
+		wake_up_interruptible(&log->wq);
+		return header.len;
+	}
+
 	mutex_lock(&log->mutex);
 
+	/* keep the ring in timestamp order behind anything already staged */
+	logger_drain(log);
+
+	now = current_kernel_time();
+	header.sec = now.tv_sec;
+	header.nsec = now.tv_nsec;
+	orig = log->w_off;
+
 	/*
 	 * Fix up any readers, pulling them forward to the first readable
 	 * entry after (what will be) the new write offset. We do this now
@@ -540,6 +713,7 @@ static int logger_open(struct inode *inode, struct file *file)
 		INIT_LIST_HEAD(&reader->list);
 
 		mutex_lock(&log->mutex);
+		logger_drain(log);
 		reader->r_off = log->head;
 		list_add_tail(&reader->list, &log->readers);
 		mutex_unlock(&log->mutex);
@@ -596,6 +770,7 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &log->wq, wait);
 
 	mutex_lock(&log->mutex);
+	logger_drain(log);
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
 			reader->r_off, current_euid());
@@ -629,6 +804,8 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 
 	mutex_lock(&log->mutex);
 
+	logger_drain(log);
+
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
 		ret = log->size;
@@ -746,10 +923,42 @@ static struct logger_log *get_log_from_minor(int minor)
 	return NULL;
 }
 
+/*
+ * init_log_stage - set up the per-cpu staging areas. On failure the log
+ * still works, with every write going through log->mutex.
+ */
+static void __init init_log_stage(struct logger_log *log)
+{
+	int cpu;
+
+	log->stage = alloc_percpu(struct logger_stage);
+	if (!log->stage)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct logger_stage *stage = per_cpu_ptr(log->stage, cpu);
+
+		spin_lock_init(&stage->lock);
+		stage->buf = kmalloc(LOGGER_STAGE_SIZE, GFP_KERNEL);
+		if (!stage->buf)
+			goto fail;
+	}
+
+	return;
+
+fail:
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu_ptr(log->stage, cpu)->buf);
+	free_percpu(log->stage);
+	log->stage = NULL;
+}
+
 static int __init init_log(struct logger_log *log)
 {
 	int ret;
 
+	init_log_stage(log);
+
 	ret = misc_register(&log->misc);
 	if (unlikely(ret)) {
 		printk(KERN_ERR "logger: failed to register misc "
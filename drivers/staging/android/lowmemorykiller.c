@@ -17,6 +17,17 @@
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
  *
+ * Below the first (most critical) level the driver only kills when reclaim
+ * is failing: at least pressure_min percent of the last pressure_window
+ * pages scanned by reclaim must have stayed unreclaimed. Write 0 to
+ * /sys/module/lowmemorykiller/parameters/pressure_min to kill on free
+ * memory alone.
+ *
+ * Kill counts and histograms of the free memory at kill time and of the
+ * time from kill to the victim being freed are in debugfs as
+ * "lowmemorykiller"; the lowmem_kill and lowmem_victim_freed tracepoints
+ * carry the per-kill details.
+ *
  * Copyright (C) 2007-2008 Google, Inc.
  *
  * This software is licensed under the terms of the GNU General Public
@@ -37,6 +48,16 @@
 #include <linux/sched.h>
 #include <linux/rcupdate.h>
 #include <linux/notifier.h>
+#include <linux/mutex.h>
+#include <linux/vmstat.h>
+#include <linux/profile.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#define CREATE_TRACE_POINTS
+#include "lowmemorykiller_trace.h"
 
 static uint32_t lowmem_debug_level = 2;
 static int lowmem_adj[6] = {
@@ -55,6 +76,36 @@ static int lowmem_minfree[6] = {
 static int lowmem_minfree_size = 4;
 
 static unsigned long lowmem_deathpending_timeout;
+static struct task_struct *lowmem_deathpending;
+static ktime_t lowmem_deathpending_start;
+/* victims are tracked by the task free notifier instead of a reference */
+static bool lowmem_task_notify;
+
+/* log2 histograms: free pages at kill time, and kill to free in ms */
+#define LOWMEM_HIST_BUCKETS	16
+
+static struct lowmem_stats {
+	unsigned long scans;
+	unsigned long pressure_skips;
+	unsigned long pending_skips;
+	unsigned long kills;
+	unsigned long freed;
+	unsigned long timeouts;
+	unsigned long free_hist[LOWMEM_HIST_BUCKETS];
+	unsigned long latency_hist[LOWMEM_HIST_BUCKETS];
+} lowmem_stats;
+static DEFINE_SPINLOCK(lowmem_stats_lock);
+
+/*
+ * Only kill above the most critical minfree level when reclaim is
+ * struggling: at least lowmem_pressure_min percent of the pages scanned
+ * over the last lowmem_pressure_window scanned pages were not reclaimed.
+ */
+static uint32_t lowmem_pressure_window = 512;
+static uint32_t lowmem_pressure_min = 60;
+static unsigned long lowmem_events[NR_VM_EVENT_ITEMS];
+static unsigned long lowmem_last_scanned;
+static unsigned long lowmem_last_reclaimed;
 
 #define lowmem_print(level, x...)			\
 	do {						\
@@ -62,20 +113,192 @@ static unsigned long lowmem_deathpending_timeout;
 			printk(x);			\
 	} while (0)
 
+/*
+ * Thread group leaders bucketed by oom_score_adj. Buckets are ranges, so
+ * every task in a higher bucket has a higher oom_score_adj than every task
+ * in a lower one and the scan can stop at the first bucket with a victim.
+ */
+#define LOWMEM_ADJ_SHIFT	5
+#define LOWMEM_ADJ_BUCKETS	\
+	(((OOM_SCORE_ADJ_MAX - OOM_SCORE_ADJ_MIN) >> LOWMEM_ADJ_SHIFT) + 1)
+#define LOWMEM_BATCH		16
+
+static struct hlist_head lowmem_adj_buckets[LOWMEM_ADJ_BUCKETS];
+static DEFINE_SPINLOCK(lowmem_adj_lock);
+static DEFINE_MUTEX(lowmem_scan_lock);
+static struct task_struct *lowmem_batch[LOWMEM_BATCH];
+
+static int lowmem_adj_bucket(int oom_score_adj)
+{
+	oom_score_adj = clamp(oom_score_adj, OOM_SCORE_ADJ_MIN,
+			      OOM_SCORE_ADJ_MAX);
+	return (oom_score_adj - OOM_SCORE_ADJ_MIN) >> LOWMEM_ADJ_SHIFT;
+}
+
+/* Called from copy_process() with tasklist_lock held for writing. */
+void lowmem_adj_add(struct task_struct *p)
+{
+	int b = lowmem_adj_bucket(p->signal->oom_score_adj);
+
+	spin_lock(&lowmem_adj_lock);
+	hlist_add_head(&p->lmk_node, &lowmem_adj_buckets[b]);
+	spin_unlock(&lowmem_adj_lock);
+}
+
+/* Called from __unhash_process() with tasklist_lock held for writing. */
+void lowmem_adj_del(struct task_struct *p)
+{
+	spin_lock(&lowmem_adj_lock);
+	if (!hlist_unhashed(&p->lmk_node))
+		hlist_del_init(&p->lmk_node);
+	spin_unlock(&lowmem_adj_lock);
+}
+
+/* Called with ->siglock held after p->signal->oom_score_adj changed. */
+void lowmem_adj_update(struct task_struct *p)
+{
+	struct task_struct *leader = p->group_leader;
+	int b = lowmem_adj_bucket(p->signal->oom_score_adj);
+
+	spin_lock(&lowmem_adj_lock);
+	if (!hlist_unhashed(&leader->lmk_node)) {
+		hlist_del(&leader->lmk_node);
+		hlist_add_head(&leader->lmk_node, &lowmem_adj_buckets[b]);
+	}
+	spin_unlock(&lowmem_adj_lock);
+}
+
+/* Called from de_thread() when @new takes over as group leader. */
+void lowmem_adj_replace(struct task_struct *old, struct task_struct *new)
+{
+	spin_lock(&lowmem_adj_lock);
+	if (!hlist_unhashed(&old->lmk_node)) {
+		hlist_add_before(&new->lmk_node, &old->lmk_node);
+		hlist_del_init(&old->lmk_node);
+	}
+	spin_unlock(&lowmem_adj_lock);
+}
+
+/*
+ * Take references on up to LOWMEM_BATCH tasks of bucket @b, skipping the
+ * first @skip. Task locks nest outside ->siglock, which nests outside
+ * lowmem_adj_lock, so the tasks are examined after the lock is dropped.
+ */
+static int lowmem_fill_batch(int b, int skip)
+{
+	struct task_struct *p;
+	struct hlist_node *pos;
+	int n = 0;
+
+	spin_lock(&lowmem_adj_lock);
+	hlist_for_each_entry(p, pos, &lowmem_adj_buckets[b], lmk_node) {
+		if (skip) {
+			skip--;
+			continue;
+		}
+		get_task_struct(p);
+		lowmem_batch[n++] = p;
+		if (n == LOWMEM_BATCH)
+			break;
+	}
+	spin_unlock(&lowmem_adj_lock);
+	return n;
+}
+
+/* Percentage of recently scanned pages that reclaim failed to free. */
+static int lowmem_reclaim_pressure(void)
+{
+	unsigned long scanned = 0;
+	unsigned long reclaimed = 0;
+	unsigned long delta, freed;
+	int z;
+
+	if (!IS_ENABLED(CONFIG_VM_EVENT_COUNTERS))
+		return 100;
+
+	all_vm_events(lowmem_events);
+	for (z = 0; z < MAX_NR_ZONES; z++) {
+		scanned += lowmem_events[PGSCAN_KSWAPD_NORMAL - ZONE_NORMAL + z];
+		scanned += lowmem_events[PGSCAN_DIRECT_NORMAL - ZONE_NORMAL + z];
+		reclaimed += lowmem_events[PGSTEAL_KSWAPD_NORMAL - ZONE_NORMAL + z];
+		reclaimed += lowmem_events[PGSTEAL_DIRECT_NORMAL - ZONE_NORMAL + z];
+	}
+
+	delta = scanned - lowmem_last_scanned;
+	if (delta < lowmem_pressure_window)
+		return -1;
+
+	freed = min(reclaimed - lowmem_last_reclaimed, delta);
+	lowmem_last_scanned = scanned;
+	lowmem_last_reclaimed = reclaimed;
+	return (delta - freed) * 100 / delta;
+}
+
+static int lowmem_hist_bucket(u64 val)
+{
+	int b = val ? fls64(val) : 0;
+
+	return min(b, LOWMEM_HIST_BUCKETS - 1);
+}
+
+static void lowmem_victim_freed(struct task_struct *task)
+{
+	u64 us = ktime_to_us(ktime_sub(ktime_get(), lowmem_deathpending_start));
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_stats_lock, flags);
+	lowmem_stats.freed++;
+	lowmem_stats.latency_hist[lowmem_hist_bucket(div_u64(us,
+						     USEC_PER_MSEC))]++;
+	spin_unlock_irqrestore(&lowmem_stats_lock, flags);
+	trace_lowmem_victim_freed(task->pid, us);
+	lowmem_print(3, "victim %d freed after %llu us\n", task->pid,
+		     (unsigned long long)us);
+}
+
+/* Called when a task_struct is freed, possibly from an RCU callback. */
+static int lowmem_task_free(struct notifier_block *nb, unsigned long val,
+			    void *data)
+{
+	struct task_struct *task = data;
+
+	if (task == lowmem_deathpending &&
+	    cmpxchg(&lowmem_deathpending, task, NULL) == task)
+		lowmem_victim_freed(task);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block lowmem_task_nb = {
+	.notifier_call = lowmem_task_free,
+};
+
+static void lowmem_stat_inc(unsigned long *counter)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_stats_lock, flags);
+	(*counter)++;
+	spin_unlock_irqrestore(&lowmem_stats_lock, flags);
+}
+
 static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
-	struct task_struct *tsk;
 	struct task_struct *selected = NULL;
 	int rem = 0;
 	int tasksize;
-	int i;
+	int i, b, n, skip;
 	int min_score_adj = OOM_SCORE_ADJ_MAX + 1;
+	int min_level = -1;
+	int pressure;
+	bool pending = false;
+	struct task_struct *victim;
+	unsigned long flags;
 	int selected_tasksize = 0;
 	int selected_oom_score_adj;
 	int array_size = ARRAY_SIZE(lowmem_adj);
-	int other_free = global_page_state(NR_FREE_PAGES);
-	int other_file = global_page_state(NR_FILE_PAGES) -
-						global_page_state(NR_SHMEM);
+	int other_free = global_page_state_snapshot(NR_FREE_PAGES);
+	int other_file = global_page_state_snapshot(NR_FILE_PAGES) -
+				global_page_state_snapshot(NR_SHMEM);
 
 	if (lowmem_adj_size < array_size)
 		array_size = lowmem_adj_size;
@@ -85,6 +308,7 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		if (other_free < lowmem_minfree[i] &&
 		    other_file < lowmem_minfree[i]) {
 			min_score_adj = lowmem_adj[i];
+			min_level = i;
 			break;
 		}
 	}
@@ -101,60 +325,144 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			     sc->nr_to_scan, sc->gfp_mask, rem);
 		return rem;
 	}
-	selected_oom_score_adj = min_score_adj;
-
-	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		int oom_score_adj;
 
-		if (tsk->flags & PF_KTHREAD)
-			continue;
-
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
+	/* another reclaimer is already picking a victim */
+	if (!mutex_trylock(&lowmem_scan_lock))
+		return rem;
 
-		if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
-		    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			task_unlock(p);
-			rcu_read_unlock();
+	if (lowmem_task_notify) {
+		victim = ACCESS_ONCE(lowmem_deathpending);
+		if (victim && time_before_eq(jiffies,
+					     lowmem_deathpending_timeout)) {
+			lowmem_stat_inc(&lowmem_stats.pending_skips);
+			mutex_unlock(&lowmem_scan_lock);
 			return 0;
 		}
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
+		/* give up on a victim that outlived its timeout */
+		if (victim && cmpxchg(&lowmem_deathpending, victim, NULL) ==
+		    victim)
+			lowmem_stat_inc(&lowmem_stats.timeouts);
+	} else if (lowmem_deathpending) {
+		/* no free notifier: the victim's exit_mm() is the best hint */
+		if (ACCESS_ONCE(lowmem_deathpending->mm) &&
+		    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+			lowmem_stat_inc(&lowmem_stats.pending_skips);
+			mutex_unlock(&lowmem_scan_lock);
+			return 0;
 		}
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
+		if (lowmem_deathpending->mm)
+			lowmem_stat_inc(&lowmem_stats.timeouts);
+		else
+			lowmem_victim_freed(lowmem_deathpending);
+		put_task_struct(lowmem_deathpending);
+		lowmem_deathpending = NULL;
+	}
+
+	if (min_level > 0 && lowmem_pressure_min) {
+		pressure = lowmem_reclaim_pressure();
+		if (pressure < (int)lowmem_pressure_min) {
+			lowmem_print(5, "lowmem_shrink pressure %d, return %d\n",
+				     pressure, rem);
+			lowmem_stat_inc(&lowmem_stats.pressure_skips);
+			mutex_unlock(&lowmem_scan_lock);
+			return rem;
 		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
-			     p->pid, p->comm, oom_score_adj, tasksize);
+	}
+
+	lowmem_stat_inc(&lowmem_stats.scans);
+
+	selected_oom_score_adj = min_score_adj;
+
+	for (b = LOWMEM_ADJ_BUCKETS - 1;
+	     b >= lowmem_adj_bucket(min_score_adj) && !selected && !pending;
+	     b--) {
+		skip = 0;
+		do {
+			n = lowmem_fill_batch(b, skip);
+			skip += n;
+
+			rcu_read_lock();
+			for (i = 0; i < n && !pending; i++) {
+				struct task_struct *p;
+				int oom_score_adj;
+
+				if (lowmem_batch[i]->flags & PF_KTHREAD)
+					continue;
+
+				p = find_lock_task_mm(lowmem_batch[i]);
+				if (!p)
+					continue;
+
+				if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
+				    time_before_eq(jiffies,
+						   lowmem_deathpending_timeout)) {
+					task_unlock(p);
+					pending = true;
+					break;
+				}
+				oom_score_adj = p->signal->oom_score_adj;
+				if (oom_score_adj < min_score_adj) {
+					task_unlock(p);
+					continue;
+				}
+				tasksize = get_mm_rss(p->mm);
+				task_unlock(p);
+				if (tasksize <= 0)
+					continue;
+				if (selected) {
+					if (oom_score_adj < selected_oom_score_adj)
+						continue;
+					if (oom_score_adj == selected_oom_score_adj &&
+					    tasksize <= selected_tasksize)
+						continue;
+					put_task_struct(selected);
+				}
+				get_task_struct(p);
+				selected = p;
+				selected_tasksize = tasksize;
+				selected_oom_score_adj = oom_score_adj;
+				lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
+					     p->pid, p->comm, oom_score_adj, tasksize);
+			}
+			rcu_read_unlock();
+
+			for (i = 0; i < n; i++)
+				put_task_struct(lowmem_batch[i]);
+		} while (n == LOWMEM_BATCH && !pending);
+	}
+
+	if (pending) {
+		if (selected)
+			put_task_struct(selected);
+		lowmem_stat_inc(&lowmem_stats.pending_skips);
+		mutex_unlock(&lowmem_scan_lock);
+		return 0;
 	}
 	if (selected) {
 		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
 			     selected->pid, selected->comm,
 			     selected_oom_score_adj, selected_tasksize);
+		trace_lowmem_kill(selected, selected_oom_score_adj,
+				  selected_tasksize, other_free, other_file,
+				  min_score_adj);
+		spin_lock_irqsave(&lowmem_stats_lock, flags);
+		lowmem_stats.kills++;
+		lowmem_stats.free_hist[lowmem_hist_bucket(other_free)]++;
+		spin_unlock_irqrestore(&lowmem_stats_lock, flags);
+
 		lowmem_deathpending_timeout = jiffies + HZ;
+		lowmem_deathpending_start = ktime_get();
+		lowmem_deathpending = selected;
 		send_sig(SIGKILL, selected, 0);
 		set_tsk_thread_flag(selected, TIF_MEMDIE);
 		rem -= selected_tasksize;
+		/* with the notifier the victim is tracked without a reference */
+		if (lowmem_task_notify)
+			put_task_struct(selected);
 	}
+	mutex_unlock(&lowmem_scan_lock);
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
 		     sc->nr_to_scan, sc->gfp_mask, rem);
-	rcu_read_unlock();
 	return rem;
 }
 
@@ -163,15 +471,75 @@ static struct shrinker lowmem_shrinker = {
 	.seeks = DEFAULT_SEEKS * 16
 };
 
+static void lowmem_print_hist(struct seq_file *m, const char *name,
+			      const char *unit, unsigned long *hist)
+{
+	int i;
+
+	seq_printf(m, "%s:\n", name);
+	for (i = 0; i < LOWMEM_HIST_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		if (i == LOWMEM_HIST_BUCKETS - 1)
+			seq_printf(m, "  >= %lu %s: %lu\n", 1UL << (i - 1),
+				   unit, hist[i]);
+		else
+			seq_printf(m, "  < %lu %s: %lu\n", 1UL << i, unit,
+				   hist[i]);
+	}
+}
+
+static int lowmem_stats_show(struct seq_file *m, void *unused)
+{
+	struct lowmem_stats stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_stats_lock, flags);
+	stats = lowmem_stats;
+	spin_unlock_irqrestore(&lowmem_stats_lock, flags);
+
+	seq_printf(m, "scans: %lu\n", stats.scans);
+	seq_printf(m, "pressure_skips: %lu\n", stats.pressure_skips);
+	seq_printf(m, "pending_skips: %lu\n", stats.pending_skips);
+	seq_printf(m, "kills: %lu\n", stats.kills);
+	seq_printf(m, "freed: %lu\n", stats.freed);
+	seq_printf(m, "timeouts: %lu\n", stats.timeouts);
+	lowmem_print_hist(m, "free_at_kill", "pages", stats.free_hist);
+	lowmem_print_hist(m, "kill_to_free", "ms", stats.latency_hist);
+	return 0;
+}
+
+static int lowmem_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lowmem_stats_show, inode->i_private);
+}
+
+static const struct file_operations lowmem_stats_fops = {
+	.open = lowmem_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static struct dentry *lowmem_debugfs;
+
 static int __init lowmem_init(void)
 {
+	lowmem_task_notify = !task_handoff_register(&lowmem_task_nb);
 	register_shrinker(&lowmem_shrinker);
+	lowmem_debugfs = debugfs_create_file("lowmemorykiller", S_IRUGO, NULL,
+					     NULL, &lowmem_stats_fops);
 	return 0;
 }
 
 static void __exit lowmem_exit(void)
 {
+	debugfs_remove(lowmem_debugfs);
 	unregister_shrinker(&lowmem_shrinker);
+	if (lowmem_task_notify)
+		task_handoff_unregister(&lowmem_task_nb);
+	else if (lowmem_deathpending)
+		put_task_struct(lowmem_deathpending);
 }
 
 module_param_named(cost, lowmem_shrinker.seeks, int, S_IRUGO | S_IWUSR);
@@ -180,6 +548,9 @@ module_param_array_named(adj, lowmem_adj, int, &lowmem_adj_size,
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
+module_param_named(pressure_window, lowmem_pressure_window, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(pressure_min, lowmem_pressure_min, uint, S_IRUGO | S_IWUSR);
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2013, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lowmemorykiller
+
+#if !defined(_LOWMEMORYKILLER_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _LOWMEMORYKILLER_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(lowmem_kill,
+	TP_PROTO(struct task_struct *p, int oom_score_adj, int tasksize,
+		 int other_free, int other_file, int min_score_adj),
+	TP_ARGS(p, oom_score_adj, tasksize, other_free, other_file,
+		min_score_adj),
+
+	TP_STRUCT__entry(
+		__array(char, comm, TASK_COMM_LEN)
+		__field(pid_t, pid)
+		__field(int, oom_score_adj)
+		__field(int, tasksize)
+		__field(int, other_free)
+		__field(int, other_file)
+		__field(int, min_score_adj)
+	),
+	TP_fast_assign(
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->pid = p->pid;
+		__entry->oom_score_adj = oom_score_adj;
+		__entry->tasksize = tasksize;
+		__entry->other_free = other_free;
+		__entry->other_file = other_file;
+		__entry->min_score_adj = min_score_adj;
+	),
+	TP_printk("pid=%d comm=%s adj=%d size=%d free=%d file=%d min_adj=%d",
+		  __entry->pid, __entry->comm, __entry->oom_score_adj,
+		  __entry->tasksize, __entry->other_free, __entry->other_file,
+		  __entry->min_score_adj)
+);
+
+TRACE_EVENT(lowmem_victim_freed,
+	TP_PROTO(pid_t pid, u64 latency_us),
+	TP_ARGS(pid, latency_us),
+
+	TP_STRUCT__entry(
+		__field(pid_t, pid)
+		__field(u64, latency_us)
+	),
+	TP_fast_assign(
+		__entry->pid = pid;
+		__entry->latency_us = latency_us;
+	),
+	TP_printk("pid=%d latency=%llu us",
+		  __entry->pid, (unsigned long long)__entry->latency_us)
+);
+
+#endif /* _LOWMEMORYKILLER_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_PATH .
+#define TRACE_INCLUDE_FILE lowmemorykiller_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,141 @@
+/*
+ * Compressed RAM block device: deduplication of compressed objects
+ *
+ * Copyright (c) 2013, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#include <linux/jhash.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "zram_drv.h"
+
+/*
+ * Identical pages compress to identical objects, so dedup works on the
+ * compressed output: a checksum picks the candidates and a memcmp against
+ * the stored object confirms the match. Entries with equal checksums are
+ * always inserted to the right, so they stay adjacent in tree order.
+ */
+
+void zram_dedup_init(struct zram *zram)
+{
+	spin_lock_init(&zram->dedup_lock);
+	zram->dedup_tree = RB_ROOT;
+}
+
+u32 zram_dedup_checksum(const unsigned char *mem, size_t len)
+{
+	return jhash(mem, len, 0);
+}
+
+/*
+ * Look for a stored object with the same content. On a hit the entry's
+ * refcount is raised for the caller.
+ */
+struct zram_entry *zram_dedup_find(struct zram *zram,
+		const unsigned char *mem, size_t len, u32 checksum)
+{
+	struct rb_node *rb_node = zram->dedup_tree.rb_node;
+	struct zram_entry *entry, *found = NULL;
+
+	spin_lock(&zram->dedup_lock);
+
+	/* leftmost entry with this checksum */
+	while (rb_node) {
+		entry = rb_entry(rb_node, struct zram_entry, node);
+		if (checksum < entry->checksum) {
+			rb_node = rb_node->rb_left;
+		} else if (checksum > entry->checksum) {
+			rb_node = rb_node->rb_right;
+		} else {
+			found = entry;
+			rb_node = rb_node->rb_left;
+		}
+	}
+
+	for (entry = found; entry && entry->checksum == checksum;
+	     entry = rb_node ? rb_entry(rb_node, struct zram_entry, node) :
+			       NULL) {
+		unsigned char *cmem;
+		bool match;
+
+		rb_node = rb_next(&entry->node);
+		if (entry->len != len)
+			continue;
+
+		cmem = zs_map_object(zram->mem_pool, entry->handle);
+		match = !memcmp(cmem, mem, len);
+		zs_unmap_object(zram->mem_pool, entry->handle);
+
+		if (match) {
+			entry->refcount++;
+			spin_unlock(&zram->dedup_lock);
+			return entry;
+		}
+	}
+
+	spin_unlock(&zram->dedup_lock);
+	return NULL;
+}
+
+/* wrap a freshly stored object so later writes can share it */
+struct zram_entry *zram_dedup_insert(struct zram *zram,
+		void *handle, size_t len, u32 checksum)
+{
+	struct rb_node **p = &zram->dedup_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct zram_entry *entry;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO);
+	if (!entry)
+		return NULL;
+
+	entry->handle = handle;
+	entry->checksum = checksum;
+	entry->refcount = 1;
+	entry->len = len;
+
+	spin_lock(&zram->dedup_lock);
+	while (*p) {
+		struct zram_entry *e;
+
+		parent = *p;
+		e = rb_entry(parent, struct zram_entry, node);
+		if (checksum < e->checksum)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&entry->node, parent, p);
+	rb_insert_color(&entry->node, &zram->dedup_tree);
+	spin_unlock(&zram->dedup_lock);
+
+	return entry;
+}
+
+/*
+ * Drop one slot's reference. Returns true if that was the last one and
+ * the compressed object has been freed.
+ */
+bool zram_dedup_put(struct zram *zram, struct zram_entry *entry)
+{
+	spin_lock(&zram->dedup_lock);
+	if (--entry->refcount) {
+		spin_unlock(&zram->dedup_lock);
+		return false;
+	}
+	rb_erase(&entry->node, &zram->dedup_tree);
+	spin_unlock(&zram->dedup_lock);
+
+	zs_free(zram->mem_pool, entry->handle);
+	kfree(entry);
+
+	return true;
+}
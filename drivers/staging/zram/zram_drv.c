@@ -30,6 +30,9 @@
 #include <linux/highmem.h>
 #include <linux/slab.h>
 #include <linux/lzo.h>
+#include <linux/lz4.h>
+#include <linux/ktime.h>
+#include <linux/percpu.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 
@@ -42,6 +45,53 @@ struct zram *zram_devices;
 /* Module params (documentation at end) */
 static unsigned int num_devices;
 
+/* The first entry is the default for new devices */
+static const struct zram_compressor zram_compressors[] = {
+	{
+		.name = "lzo",
+		.workmem_size = LZO1X_MEM_COMPRESS,
+		.compress = lzo1x_1_compress,
+		.decompress = lzo1x_decompress_safe,
+	},
+#ifdef CONFIG_ZRAM_LZ4
+	{
+		.name = "lz4",
+		.workmem_size = LZ4_MEM_COMPRESS,
+		.compress = lz4_compress,
+		.decompress = lz4_decompress_unknownoutputsize,
+	},
+#endif
+};
+
+const struct zram_compressor *zram_find_compressor(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(zram_compressors); i++)
+		if (sysfs_streq(name, zram_compressors[i].name))
+			return &zram_compressors[i];
+
+	return NULL;
+}
+
+ssize_t zram_show_compressors(struct zram *zram, char *buf)
+{
+	ssize_t sz = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(zram_compressors); i++) {
+		const struct zram_compressor *comp = &zram_compressors[i];
+
+		if (comp == zram->comp)
+			sz += sprintf(buf + sz, "[%s] ", comp->name);
+		else
+			sz += sprintf(buf + sz, "%s ", comp->name);
+	}
+	sz += sprintf(buf + sz, "\n");
+
+	return sz;
+}
+
 static void zram_stat_inc(u32 *v)
 {
 	*v = *v + 1;
@@ -71,6 +121,32 @@ static void zram_stat64_inc(struct zram *zram, u64 *v)
 	zram_stat64_add(zram, v, 1);
 }
 
+static void zram_stat64_time(struct zram *zram, u64 *time, u64 *count,
+			     ktime_t start)
+{
+	s64 delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&zram->stat64_lock);
+	*time += delta;
+	*count += 1;
+	spin_unlock(&zram->stat64_lock);
+}
+
+/* decompress one stored object into a full page at 'dst' */
+static int zram_decompress(struct zram *zram, const unsigned char *src,
+			   size_t src_len, unsigned char *dst)
+{
+	size_t clen = PAGE_SIZE;
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = zram->comp->decompress(src, src_len, dst, &clen);
+	zram_stat64_time(zram, &zram->stats.decompr_time,
+			 &zram->stats.num_decompr, start);
+
+	return ret;
+}
+
 static int zram_test_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
 {
@@ -89,21 +165,34 @@ static void zram_clear_flag(struct zram *zram, u32 index,
 	zram->table[index].flags &= ~BIT(flag);
 }
 
-static int page_zero_filled(void *ptr)
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
 
 	page = (unsigned long *)ptr;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != page[0])
 			return 0;
 	}
 
+	*element = page[0];
+
 	return 1;
 }
 
+/* zsmalloc handle of a compressed slot, looking through a dedup entry */
+static void *zram_zs_handle(struct zram *zram, u32 index)
+{
+	void *handle = zram->table[index].handle;
+
+	if (zram->use_dedup)
+		return ((struct zram_entry *)handle)->handle;
+
+	return handle;
+}
+
 static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 {
 	if (!zram->disksize) {
@@ -137,18 +226,23 @@ static void zram_free_page(struct zram *zram, size_t index)
 {
 	void *handle = zram->table[index].handle;
 
-	if (unlikely(!handle)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (zram_test_flag(zram, index, ZRAM_ZERO)) {
-			zram_clear_flag(zram, index, ZRAM_ZERO);
+	/*
+	 * No memory is allocated for same filled pages.
+	 * Simply clear same page flag.
+	 */
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		zram_clear_flag(zram, index, ZRAM_SAME);
+		if (zram->table[index].element)
+			zram_stat_dec(&zram->stats.pages_same);
+		else
 			zram_stat_dec(&zram->stats.pages_zero);
-		}
+		zram->table[index].element = 0;
 		return;
 	}
 
+	if (unlikely(!handle))
+		return;
+
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
 		__free_page(handle);
 		zram_clear_flag(zram, index, ZRAM_UNCOMPRESSED);
@@ -156,27 +250,49 @@ static void zram_free_page(struct zram *zram, size_t index)
 		goto out;
 	}
 
-	zs_free(zram->mem_pool, handle);
-
 	if (zram->table[index].size <= PAGE_SIZE / 2)
 		zram_stat_dec(&zram->stats.good_compress);
 
+	if (!zram->use_dedup) {
+		zs_free(zram->mem_pool, handle);
+	} else if (!zram_dedup_put(zram, handle)) {
+		/* object is still shared with other slots */
+		zram_stat64_sub(zram, &zram->stats.dup_data_size,
+				zram->table[index].size);
+		goto stored;
+	}
+
 out:
 	zram_stat64_sub(zram, &zram->stats.compr_size,
 			zram->table[index].size);
+stored:
 	zram_stat_dec(&zram->stats.pages_stored);
 
 	zram->table[index].handle = NULL;
 	zram->table[index].size = 0;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void zram_fill_page(void *ptr, unsigned int len, unsigned long value)
+{
+	unsigned long *page = ptr;
+	unsigned int pos;
+
+	if (!value) {
+		memset(ptr, 0, len);
+		return;
+	}
+
+	for (pos = 0; pos != len / sizeof(*page); pos++)
+		page[pos] = value;
+}
+
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
-	memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
+	zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len, element);
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
@@ -207,15 +323,15 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
 	int ret;
-	size_t clen;
+	void *handle;
 	struct page *page;
 	struct zobj_header *zheader;
 	unsigned char *user_mem, *cmem, *uncmem = NULL;
 
 	page = bvec->bv_page;
 
-	if (zram_test_flag(zram, index, ZRAM_ZERO)) {
-		handle_zero_page(bvec);
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		handle_same_page(bvec, zram->table[index].element);
 		return 0;
 	}
 
@@ -223,7 +339,7 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	if (unlikely(!zram->table[index].handle)) {
 		pr_debug("Read before write: sector=%lu, size=%u",
 			 (ulong)(bio->bi_sector), bio->bi_size);
-		handle_zero_page(bvec);
+		handle_same_page(bvec, 0);
 		return 0;
 	}
 
@@ -242,16 +358,16 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		}
 	}
 
+	handle = zram_zs_handle(zram, index);
+
 	user_mem = kmap_atomic(page);
 	if (!is_partial_io(bvec))
 		uncmem = user_mem;
-	clen = PAGE_SIZE;
 
-	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
+	cmem = zs_map_object(zram->mem_pool, handle);
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    uncmem, &clen);
+	ret = zram_decompress(zram, cmem + sizeof(*zheader),
+			      zram->table[index].size, uncmem);
 
 	if (is_partial_io(bvec)) {
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
@@ -259,11 +375,11 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		kfree(uncmem);
 	}
 
-	zs_unmap_object(zram->mem_pool, zram->table[index].handle);
+	zs_unmap_object(zram->mem_pool, handle);
 	kunmap_atomic(user_mem);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -277,32 +393,37 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 {
 	int ret;
-	size_t clen = PAGE_SIZE;
+	void *handle;
 	struct zobj_header *zheader;
 	unsigned char *cmem;
 
-	if (zram_test_flag(zram, index, ZRAM_ZERO) ||
-	    !zram->table[index].handle) {
-		memset(mem, 0, PAGE_SIZE);
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		zram_fill_page(mem, PAGE_SIZE, zram->table[index].element);
 		return 0;
 	}
 
-	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
+	if (!zram->table[index].handle) {
+		memset(mem, 0, PAGE_SIZE);
+		return 0;
+	}
 
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		cmem = kmap_atomic(zram->table[index].handle);
 		memcpy(mem, cmem, PAGE_SIZE);
 		kunmap_atomic(cmem);
 		return 0;
 	}
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    mem, &clen);
-	zs_unmap_object(zram->mem_pool, zram->table[index].handle);
+	handle = zram_zs_handle(zram, index);
+	cmem = zs_map_object(zram->mem_pool, handle);
+
+	ret = zram_decompress(zram, cmem + sizeof(*zheader),
+			      zram->table[index].size, mem);
+	zs_unmap_object(zram->mem_pool, handle);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -311,45 +432,54 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+/*
+ * zram_bvec_write - compress and store one page
+ *
+ * Compression runs on a per-cpu stream without holding zram->lock, so
+ * writers on different cpus compress in parallel. The lock is only taken
+ * for writing to swap the new object into the table.
+ */
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			   int offset)
 {
 	int ret;
-	u32 store_offset;
 	size_t clen;
 	void *handle;
+	u32 checksum = 0;
+	bool dup = false;
+	ktime_t start;
+	unsigned long element;
+	struct zram_entry *entry;
 	struct zobj_header *zheader;
-	struct page *page, *page_store;
+	struct zram_stream *stream;
+	struct page *page, *page_store = NULL;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 
 	page = bvec->bv_page;
-	src = zram->compress_buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
 		 * This is a partial IO. We need to read the full page
 		 * before to write the changes.
 		 */
-		uncmem = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
 		if (!uncmem) {
 			pr_info("Error allocating temp memory!\n");
 			ret = -ENOMEM;
 			goto out;
 		}
+		down_read(&zram->lock);
 		ret = zram_read_before_write(zram, uncmem, index);
+		up_read(&zram->lock);
 		if (ret) {
 			kfree(uncmem);
 			goto out;
 		}
 	}
 
-	/*
-	 * System overwrites unused sectors. Free memory associated
-	 * with this sector now.
-	 */
-	if (zram->table[index].handle ||
-	    zram_test_flag(zram, index, ZRAM_ZERO))
-		zram_free_page(zram, index);
+	stream = per_cpu_ptr(zram->streams, raw_smp_processor_id());
+	mutex_lock(&stream->lock);
+	src = stream->buffer;
 
 	user_mem = kmap_atomic(page);
 
@@ -359,24 +489,38 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	else
 		uncmem = user_mem;
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(uncmem, &element)) {
 		kunmap_atomic(user_mem);
 		if (is_partial_io(bvec))
 			kfree(uncmem);
-		zram_stat_inc(&zram->stats.pages_zero);
-		zram_set_flag(zram, index, ZRAM_ZERO);
+		mutex_unlock(&stream->lock);
+
+		down_write(&zram->lock);
+		zram_free_page(zram, index);
+		if (element)
+			zram_stat_inc(&zram->stats.pages_same);
+		else
+			zram_stat_inc(&zram->stats.pages_zero);
+		zram->table[index].element = element;
+		zram_set_flag(zram, index, ZRAM_SAME);
+		up_write(&zram->lock);
 		ret = 0;
 		goto out;
 	}
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       zram->compress_workmem);
+	clen = 2 * PAGE_SIZE;
+	start = ktime_get();
+	ret = zram->comp->compress(uncmem, PAGE_SIZE, src, &clen,
+				   stream->workmem);
+	zram_stat64_time(zram, &zram->stats.compr_time,
+			 &zram->stats.num_compr, start);
 
 	kunmap_atomic(user_mem);
 	if (is_partial_io(bvec))
 			kfree(uncmem);
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
+		mutex_unlock(&stream->lock);
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
@@ -387,6 +531,7 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	 * errors which has side effect of hanging the system.
 	 */
 	if (unlikely(clen > max_zpage_size)) {
+		mutex_unlock(&stream->lock);
 		clen = PAGE_SIZE;
 		page_store = alloc_page(GFP_NOIO | __GFP_HIGHMEM);
 		if (unlikely(!page_store)) {
@@ -396,17 +541,29 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			goto out;
 		}
 
-		store_offset = 0;
-		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
-		zram_stat_inc(&zram->stats.pages_expand);
 		handle = page_store;
 		src = kmap_atomic(page);
 		cmem = kmap_atomic(page_store);
-		goto memstore;
+		memcpy(cmem, src, clen);
+		kunmap_atomic(cmem);
+		kunmap_atomic(src);
+		goto install;
+	}
+
+	if (zram->use_dedup) {
+		checksum = zram_dedup_checksum(src, clen);
+		entry = zram_dedup_find(zram, src, clen, checksum);
+		if (entry) {
+			mutex_unlock(&stream->lock);
+			handle = entry;
+			dup = true;
+			goto install;
+		}
 	}
 
 	handle = zs_malloc(zram->mem_pool, clen + sizeof(*zheader));
 	if (!handle) {
+		mutex_unlock(&stream->lock);
 		pr_info("Error allocating memory for compressed "
 			"page: %u, size=%zu\n", index, clen);
 		ret = -ENOMEM;
@@ -414,34 +571,60 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	}
 	cmem = zs_map_object(zram->mem_pool, handle);
 
-memstore:
 #if 0
 	/* Back-reference needed for memory defragmentation */
-	if (!zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)) {
-		zheader = (struct zobj_header *)cmem;
-		zheader->table_idx = index;
-		cmem += sizeof(*zheader);
-	}
+	zheader = (struct zobj_header *)cmem;
+	zheader->table_idx = index;
+	cmem += sizeof(*zheader);
 #endif
 
 	memcpy(cmem, src, clen);
+	zs_unmap_object(zram->mem_pool, handle);
 
-	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
-		kunmap_atomic(cmem);
-		kunmap_atomic(src);
-	} else {
-		zs_unmap_object(zram->mem_pool, handle);
+	if (zram->use_dedup) {
+		entry = zram_dedup_insert(zram, handle, clen, checksum);
+		if (!entry) {
+			mutex_unlock(&stream->lock);
+			zs_free(zram->mem_pool, handle);
+			pr_info("Error allocating dedup entry for "
+				"page: %u\n", index);
+			ret = -ENOMEM;
+			goto out;
+		}
+		handle = entry;
+	}
+	mutex_unlock(&stream->lock);
+
+install:
+	down_write(&zram->lock);
+
+	/*
+	 * System overwrites unused sectors. Free memory associated
+	 * with this sector now.
+	 */
+	zram_free_page(zram, index);
+
+	if (page_store) {
+		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
+		zram_stat_inc(&zram->stats.pages_expand);
 	}
 
 	zram->table[index].handle = handle;
 	zram->table[index].size = clen;
 
 	/* Update stats */
-	zram_stat64_add(zram, &zram->stats.compr_size, clen);
+	if (dup) {
+		zram_stat64_inc(zram, &zram->stats.dedup_hits);
+		zram_stat64_add(zram, &zram->stats.dup_data_size, clen);
+	} else {
+		zram_stat64_add(zram, &zram->stats.compr_size, clen);
+	}
 	zram_stat_inc(&zram->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
 		zram_stat_inc(&zram->stats.good_compress);
 
+	up_write(&zram->lock);
+
 	return 0;
 
 out:
@@ -460,9 +643,7 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
 		up_read(&zram->lock);
 	} else {
-		down_write(&zram->lock);
 		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
 	}
 
 	return ret;
@@ -577,6 +758,47 @@ error:
 	bio_io_error(bio);
 }
 
+static void zram_free_streams(struct zram *zram)
+{
+	int cpu;
+
+	if (!zram->streams)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct zram_stream *stream = per_cpu_ptr(zram->streams, cpu);
+
+		kfree(stream->workmem);
+		free_pages((unsigned long)stream->buffer, 1);
+	}
+
+	free_percpu(zram->streams);
+	zram->streams = NULL;
+}
+
+static int zram_alloc_streams(struct zram *zram)
+{
+	int cpu;
+
+	zram->streams = alloc_percpu(struct zram_stream);
+	if (!zram->streams)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct zram_stream *stream = per_cpu_ptr(zram->streams, cpu);
+
+		mutex_init(&stream->lock);
+		stream->workmem = kzalloc(zram->comp->workmem_size,
+					  GFP_KERNEL);
+		stream->buffer =
+			(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
+		if (!stream->workmem || !stream->buffer)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
 void __zram_reset_device(struct zram *zram)
 {
 	size_t index;
@@ -584,20 +806,18 @@ void __zram_reset_device(struct zram *zram)
 	zram->init_done = 0;
 
 	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
-
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+	zram_free_streams(zram);
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		void *handle = zram->table[index].handle;
-		if (!handle)
+		if (!handle || zram_test_flag(zram, index, ZRAM_SAME))
 			continue;
 
 		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
 			__free_page(handle);
+		else if (zram->use_dedup)
+			zram_dedup_put(zram, handle);
 		else
 			zs_free(zram->mem_pool, handle);
 	}
@@ -635,18 +855,9 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
-		goto fail_no_table;
-	}
-
-	zram->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		ret = -ENOMEM;
+	ret = zram_alloc_streams(zram);
+	if (ret) {
+		pr_err("Error allocating compression streams!\n");
 		goto fail_no_table;
 	}
 
@@ -663,7 +874,8 @@ int zram_init_device(struct zram *zram)
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 
-	zram->mem_pool = zs_create_pool("zram", GFP_NOIO | __GFP_HIGHMEM);
+	zram->mem_pool = zs_create_pool(zram->disk->disk_name,
+					GFP_NOIO | __GFP_HIGHMEM);
 	if (!zram->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		ret = -ENOMEM;
@@ -708,6 +920,8 @@ static int create_device(struct zram *zram, int device_id)
 	init_rwsem(&zram->lock);
 	init_rwsem(&zram->init_lock);
 	spin_lock_init(&zram->stat64_lock);
+	zram_dedup_init(zram);
+	zram->comp = &zram_compressors[0];
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -750,6 +964,9 @@ static int create_device(struct zram *zram, int device_id)
 	blk_queue_io_min(zram->disk->queue, PAGE_SIZE);
 	blk_queue_io_opt(zram->disk->queue, PAGE_SIZE);
 
+	/* no seeks at all: swap readahead and clustering only burn cpu */
+	zram->queue->backing_dev_info.capabilities |= BDI_CAP_NO_SEEK;
+
 	add_disk(zram->disk);
 
 	ret = sysfs_create_group(&disk_to_dev(zram->disk)->kobj,
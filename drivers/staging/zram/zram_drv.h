@@ -17,6 +17,7 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/rbtree.h>
 
 #include "../zsmalloc/zsmalloc.h"
 
@@ -71,8 +72,8 @@ enum zram_pageflags {
 	/* Page is stored uncompressed */
 	ZRAM_UNCOMPRESSED,
 
-	/* Page consists entirely of zeros */
-	ZRAM_ZERO,
+	/* Page is one repeated word, kept in table[].element */
+	ZRAM_SAME,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -81,12 +82,28 @@ enum zram_pageflags {
 
 /* Allocated for each disk page */
 struct table {
-	void *handle;
+	union {
+		void *handle;
+		unsigned long element;	/* fill value of a ZRAM_SAME page */
+	};
 	u16 size;	/* object size (excluding header) */
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
 } __attribute__((aligned(4)));
 
+/*
+ * Compression backend. Both hooks return 0 on success; 'dst_len' is the
+ * output buffer size on entry and the produced size on return.
+ */
+struct zram_compressor {
+	const char *name;
+	size_t workmem_size;
+	int (*compress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len, void *workmem);
+	int (*decompress)(const unsigned char *src, size_t src_len,
+			  unsigned char *dst, size_t *dst_len);
+};
+
 struct zram_stats {
 	u64 compr_size;		/* compressed size of pages stored */
 	u64 num_reads;		/* failed + successful */
@@ -95,20 +112,49 @@ struct zram_stats {
 	u64 failed_writes;	/* can happen when memory is too low */
 	u64 invalid_io;		/* non-page-aligned I/O requests */
 	u64 notify_free;	/* no. of swap slot free notifications */
+	u64 num_compr;		/* no. of pages run through the compressor */
+	u64 num_decompr;	/* no. of pages decompressed */
+	u64 compr_time;		/* total time spent compressing, in ns */
+	u64 decompr_time;	/* total time spent decompressing, in ns */
+	u64 dedup_hits;		/* writes that reused a stored object */
+	u64 dup_data_size;	/* compressed bytes not stored thanks to dedup */
 	u32 pages_zero;		/* no. of zero filled pages */
+	u32 pages_same;		/* no. of other same-value filled pages */
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
 };
 
+/*
+ * Per-cpu compression stream. A writer uses the stream of the cpu it
+ * starts on; the mutex only matters if it gets migrated meanwhile.
+ */
+struct zram_stream {
+	struct mutex lock;
+	void *workmem;		/* comp->workmem_size bytes */
+	void *buffer;		/* compressed output, two pages */
+};
+
+/*
+ * Shared compressed object, used in place of a bare zsmalloc handle when
+ * dedup is enabled on a device. Indexed by checksum in zram->dedup_tree.
+ */
+struct zram_entry {
+	struct rb_node node;
+	void *handle;		/* zsmalloc handle */
+	u32 checksum;
+	u32 refcount;		/* no. of table slots pointing here */
+	u16 len;		/* compressed length */
+};
+
 struct zram {
 	struct zs_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	const struct zram_compressor *comp;
+	struct zram_stream __percpu *streams;
 	struct table *table;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct rw_semaphore lock; /* protect compression buffers and table
-				   * against concurrent read and writes */
+	struct rw_semaphore lock; /* protect table and 32-bit stats against
+				   * concurrent read and writes */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -120,6 +166,11 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 
+	/* Content dedup of compressed objects, set before init */
+	int use_dedup;
+	spinlock_t dedup_lock;	/* protects dedup_tree and entry refcounts */
+	struct rb_root dedup_tree;
+
 	struct zram_stats stats;
 };
 
@@ -129,6 +180,17 @@ unsigned int zram_get_num_devices(void);
 extern struct attribute_group zram_disk_attr_group;
 #endif
 
+extern const struct zram_compressor *zram_find_compressor(const char *name);
+extern ssize_t zram_show_compressors(struct zram *zram, char *buf);
+
+extern void zram_dedup_init(struct zram *zram);
+extern u32 zram_dedup_checksum(const unsigned char *mem, size_t len);
+extern struct zram_entry *zram_dedup_find(struct zram *zram,
+		const unsigned char *mem, size_t len, u32 checksum);
+extern struct zram_entry *zram_dedup_insert(struct zram *zram,
+		void *handle, size_t len, u32 checksum);
+extern bool zram_dedup_put(struct zram *zram, struct zram_entry *entry);
+
 extern int zram_init_device(struct zram *zram);
 extern void __zram_reset_device(struct zram *zram);
 
@@ -17,9 +17,13 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/bitops.h>
+#include <linux/bit_spinlock.h>
+#include <linux/debugfs.h>
 #include <linux/errno.h>
 #include <linux/highmem.h>
 #include <linux/init.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/string.h>
 #include <linux/slab.h>
 #include <asm/tlbflush.h>
@@ -43,6 +47,11 @@
 /* per-cpu VM mapping areas for zspage accesses that cross page boundaries */
 static DEFINE_PER_CPU(struct mapping_area, zs_map_area);
 
+/* backing store for the handles handed out by zs_malloc() */
+static struct kmem_cache *zs_handle_cache;
+
+static struct dentry *zs_stat_root;
+
 static int is_first_page(struct page *page)
 {
 	return test_bit(PG_private, &page->flags);
@@ -122,6 +131,7 @@ static void insert_zspage(struct page *page, struct size_class *class,
 		list_add_tail(&page->lru, &(*head)->lru);
 
 	*head = page;
+	class->nr_zspages[fullness]++;
 }
 
 static void remove_zspage(struct page *page, struct size_class *class,
@@ -143,6 +153,7 @@ static void remove_zspage(struct page *page, struct size_class *class,
 					struct page, lru);
 
 	list_del_init(&page->lru);
+	class->nr_zspages[fullness]--;
 }
 
 static enum fullness_group fix_fullness_group(struct zs_pool *pool,
@@ -230,30 +241,57 @@ static struct page *get_next_page(struct page *page)
 	return next;
 }
 
-/* Encode <page, obj_idx> as a single handle value */
-static void *obj_location_to_handle(struct page *page, unsigned long obj_idx)
+/* Encode <page, obj_idx> as a single object location value */
+static void *location_to_obj(struct page *page, unsigned long obj_idx)
 {
-	unsigned long handle;
+	unsigned long obj;
 
 	if (!page) {
 		BUG_ON(obj_idx);
 		return NULL;
 	}
 
-	handle = page_to_pfn(page) << OBJ_INDEX_BITS;
-	handle |= (obj_idx & OBJ_INDEX_MASK);
+	obj = page_to_pfn(page) << OBJ_INDEX_BITS;
+	obj |= (obj_idx & OBJ_INDEX_MASK);
+	obj <<= OBJ_TAG_BITS;
 
-	return (void *)handle;
+	return (void *)obj;
 }
 
-/* Decode <page, obj_idx> pair from the given object handle */
-static void obj_handle_to_location(void *handle, struct page **page,
+/* Decode <page, obj_idx> pair from the given object location */
+static void obj_to_location(void *obj, struct page **page,
 				unsigned long *obj_idx)
 {
-	unsigned long hval = (unsigned long)handle;
+	unsigned long oval = (unsigned long)obj >> OBJ_TAG_BITS;
+
+	*page = pfn_to_page(oval >> OBJ_INDEX_BITS);
+	*obj_idx = oval & OBJ_INDEX_MASK;
+}
+
+/* Current location of the object behind a handle, minus the pin bit */
+static void *handle_to_obj(unsigned long *handle)
+{
+	return (void *)(*handle & ~(1UL << HANDLE_PIN_BIT));
+}
 
-	*page = pfn_to_page(hval >> OBJ_INDEX_BITS);
-	*obj_idx = hval & OBJ_INDEX_MASK;
+static void record_obj(unsigned long *handle, void *obj)
+{
+	*handle = (unsigned long)obj;
+}
+
+static void pin_tag(unsigned long *handle)
+{
+	bit_spin_lock(HANDLE_PIN_BIT, handle);
+}
+
+static int trypin_tag(unsigned long *handle)
+{
+	return bit_spin_trylock(HANDLE_PIN_BIT, handle);
+}
+
+static void unpin_tag(unsigned long *handle)
+{
+	bit_spin_unlock(HANDLE_PIN_BIT, handle);
 }
 
 static unsigned long obj_idx_to_offset(struct page *page,
@@ -330,7 +368,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		for (i = 1; i <= objs_on_page; i++) {
 			off += class->size;
 			if (off < PAGE_SIZE) {
-				link->next = obj_location_to_handle(page, i);
+				link->next = location_to_obj(page, i);
 				link += class->size / sizeof(*link);
 			}
 		}
@@ -341,7 +379,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		 * page (if present)
 		 */
 		next_page = get_next_page(page);
-		link->next = obj_location_to_handle(next_page, 0);
+		link->next = location_to_obj(next_page, 0);
 		kunmap_atomic(link);
 		page = next_page;
 		off = (off + class->size) % PAGE_SIZE;
@@ -396,7 +434,7 @@ static struct page *alloc_zspage(struct size_class *class, gfp_t flags)
 
 	init_zspage(first_page, class);
 
-	first_page->freelist = obj_location_to_handle(first_page, 0);
+	first_page->freelist = location_to_obj(first_page, 0);
 	/* Maximum number of objects we can store in this zspage */
 	first_page->objects = class->zspage_order * PAGE_SIZE / class->size;
 
@@ -425,6 +463,395 @@ static struct page *find_get_zspage(struct size_class *class)
 	return page;
 }
 
+/* Take a free slot from the zspage and tag it with its owning handle */
+static void *obj_malloc(struct page *first_page, struct size_class *class,
+				unsigned long *handle)
+{
+	void *obj;
+	struct link_free *link;
+	struct page *m_page;
+	unsigned long m_objidx, m_offset;
+
+	obj = first_page->freelist;
+	obj_to_location(obj, &m_page, &m_objidx);
+	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
+
+	link = (struct link_free *)kmap_atomic(m_page) +
+					m_offset / sizeof(*link);
+	first_page->freelist = link->next;
+	link->handle = (unsigned long)handle | OBJ_ALLOCATED_TAG;
+	kunmap_atomic(link);
+
+	first_page->inuse++;
+	class->objs_used++;
+
+	return obj;
+}
+
+/* Return a slot to its zspage's freelist; class->lock must be held */
+static void obj_free(struct size_class *class, void *obj)
+{
+	struct link_free *link;
+	struct page *first_page, *f_page;
+	unsigned long f_objidx, f_offset;
+
+	obj_to_location(obj, &f_page, &f_objidx);
+	first_page = get_first_page(f_page);
+	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
+
+	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
+							+ f_offset);
+	link->next = first_page->freelist;
+	kunmap_atomic(link);
+	first_page->freelist = obj;
+
+	first_page->inuse--;
+	class->objs_used--;
+}
+
+/* Copy a whole slot, either end of which may cross a page boundary */
+static void zs_object_copy(void *dst, void *src, struct size_class *class)
+{
+	struct page *s_page, *d_page;
+	unsigned long s_objidx, d_objidx;
+	unsigned long s_off, d_off;
+	void *s_addr, *d_addr;
+	int s_size, d_size, size;
+	int written = 0;
+
+	s_size = d_size = class->size;
+
+	obj_to_location(src, &s_page, &s_objidx);
+	obj_to_location(dst, &d_page, &d_objidx);
+
+	s_off = obj_idx_to_offset(s_page, s_objidx, class->size);
+	d_off = obj_idx_to_offset(d_page, d_objidx, class->size);
+
+	if (s_off + class->size > PAGE_SIZE)
+		s_size = PAGE_SIZE - s_off;
+	if (d_off + class->size > PAGE_SIZE)
+		d_size = PAGE_SIZE - d_off;
+
+	s_addr = kmap_atomic(s_page);
+	d_addr = kmap_atomic(d_page);
+
+	while (1) {
+		size = min(s_size, d_size);
+		memcpy(d_addr + d_off, s_addr + s_off, size);
+		written += size;
+
+		if (written == class->size)
+			break;
+
+		s_off += size;
+		s_size -= size;
+		d_off += size;
+		d_size -= size;
+
+		/* kmap_atomic() slots must be released in reverse order */
+		if (s_off >= PAGE_SIZE) {
+			kunmap_atomic(d_addr);
+			kunmap_atomic(s_addr);
+			s_page = get_next_page(s_page);
+			BUG_ON(!s_page);
+			s_addr = kmap_atomic(s_page);
+			d_addr = kmap_atomic(d_page);
+			s_size = class->size - written;
+			s_off = 0;
+		}
+
+		if (d_off >= PAGE_SIZE) {
+			kunmap_atomic(d_addr);
+			d_page = get_next_page(d_page);
+			BUG_ON(!d_page);
+			d_addr = kmap_atomic(d_page);
+			d_size = class->size - written;
+			d_off = 0;
+		}
+	}
+
+	kunmap_atomic(d_addr);
+	kunmap_atomic(s_addr);
+}
+
+/*
+ * Move allocated objects from src_page into dst_page until either src is
+ * empty or dst is full. Returns -EAGAIN if an object is pinned by a user
+ * (mapped or being freed), in which case src cannot be emptied right now.
+ */
+static int migrate_zspage(struct size_class *class, struct page *src_page,
+				struct page *dst_page)
+{
+	struct page *page = src_page;
+	unsigned long obj_idx = 0, off = 0;
+	int i;
+
+	for (i = 0; i < src_page->objects && src_page->inuse; i++) {
+		struct link_free *link;
+		unsigned long *handle;
+		unsigned long val;
+		void *old_obj, *new_obj;
+
+		if (off >= PAGE_SIZE) {
+			page = get_next_page(page);
+			obj_idx = 0;
+			off = page->index;
+		}
+
+		link = (struct link_free *)((unsigned char *)kmap_atomic(page)
+								+ off);
+		val = link->handle;
+		kunmap_atomic(link);
+
+		if (!(val & OBJ_ALLOCATED_TAG))
+			goto next;
+
+		if (dst_page->inuse == dst_page->objects)
+			return 0;
+
+		handle = (unsigned long *)(val & ~OBJ_ALLOCATED_TAG);
+		if (!trypin_tag(handle))
+			return -EAGAIN;
+
+		old_obj = location_to_obj(page, obj_idx);
+		new_obj = obj_malloc(dst_page, class, handle);
+		zs_object_copy(new_obj, old_obj, class);
+		/* keep the pin bit set until the old slot is released */
+		record_obj(handle, (void *)((unsigned long)new_obj |
+					    (1UL << HANDLE_PIN_BIT)));
+		obj_free(class, old_obj);
+		unpin_tag(handle);
+next:
+		obj_idx++;
+		off += class->size;
+	}
+
+	return 0;
+}
+
+/* Unlink the first zspage of a fullness group from the class lists */
+static struct page *isolate_zspage(struct size_class *class,
+				enum fullness_group fullness)
+{
+	struct page *page = class->fullness_list[fullness];
+
+	if (page)
+		remove_zspage(page, class, fullness);
+
+	return page;
+}
+
+static enum fullness_group putback_zspage(struct size_class *class,
+				struct page *first_page)
+{
+	enum fullness_group fullness;
+
+	fullness = get_fullness_group(first_page);
+	insert_zspage(first_page, class, fullness);
+	set_zspage_mapping(first_page, class->index, fullness);
+
+	return fullness;
+}
+
+/* Number of system pages compaction could release in this class */
+static unsigned long zs_can_compact(struct size_class *class)
+{
+	unsigned long obj_allocated, obj_wasted;
+
+	obj_allocated = (unsigned long)class->pages_allocated /
+			class->zspage_order * class->objs_per_zspage;
+	obj_wasted = obj_allocated - class->objs_used;
+
+	return obj_wasted / class->objs_per_zspage * class->zspage_order;
+}
+
+/*
+ * Empty sparsely used zspages into denser ones of the same class. The
+ * class lock is held while zspages are off the fullness lists, so
+ * zs_malloc() and zs_free() never see an isolated zspage; it is dropped
+ * between source zspages to bound the hold time.
+ */
+static unsigned long zs_compact_class(struct size_class *class)
+{
+	struct page *src_page, *dst_page;
+	unsigned long freed = 0;
+
+	spin_lock(&class->lock);
+	while (zs_can_compact(class)) {
+		int ret = 0;
+
+		src_page = isolate_zspage(class, ZS_ALMOST_EMPTY);
+		if (!src_page)
+			break;
+
+		while (src_page->inuse) {
+			dst_page = isolate_zspage(class, ZS_ALMOST_FULL);
+			if (!dst_page)
+				dst_page = isolate_zspage(class,
+							  ZS_ALMOST_EMPTY);
+			if (!dst_page)
+				break;
+
+			ret = migrate_zspage(class, src_page, dst_page);
+			putback_zspage(class, dst_page);
+			if (ret)
+				break;
+		}
+
+		if (src_page->inuse) {
+			/* pinned object or no room left: try again later */
+			putback_zspage(class, src_page);
+			break;
+		}
+
+		class->pages_allocated -= class->zspage_order;
+		class->pages_compacted += class->zspage_order;
+		freed += class->zspage_order;
+		spin_unlock(&class->lock);
+
+		free_zspage(src_page);
+		cond_resched();
+
+		spin_lock(&class->lock);
+	}
+	spin_unlock(&class->lock);
+
+	return freed;
+}
+
+/**
+ * zs_compact - migrate objects out of sparse zspages
+ * @pool: pool to compact
+ *
+ * Returns the number of system pages released.
+ */
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	int i;
+	unsigned long freed = 0;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++)
+		freed += zs_compact_class(&pool->size_class[i]);
+
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
+static int zs_shrinker_count(struct zs_pool *pool)
+{
+	int i;
+	unsigned long pages = 0;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		spin_lock(&class->lock);
+		pages += zs_can_compact(class);
+		spin_unlock(&class->lock);
+	}
+
+	return min_t(unsigned long, pages, INT_MAX);
+}
+
+static int zs_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct zs_pool *pool = container_of(shrinker, struct zs_pool,
+					    shrinker);
+
+	if (sc->nr_to_scan)
+		zs_compact(pool);
+
+	return zs_shrinker_count(pool);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int zs_stats_show(struct seq_file *s, void *v)
+{
+	int i;
+	struct zs_pool *pool = s->private;
+	unsigned long obj_allocated, obj_used, pages_used;
+	unsigned long total_objs = 0, total_used = 0, total_pages = 0;
+	u64 compacted, total_compacted = 0;
+	unsigned long almost_full, almost_empty;
+
+	seq_printf(s, " %5s %5s %11s %12s %13s %10s %10s %16s %10s\n",
+			"class", "size", "almost_full", "almost_empty",
+			"obj_allocated", "obj_used", "pages_used",
+			"pages_per_zspage", "compacted");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		spin_lock(&class->lock);
+		almost_full = class->nr_zspages[ZS_ALMOST_FULL];
+		almost_empty = class->nr_zspages[ZS_ALMOST_EMPTY];
+		pages_used = class->pages_allocated;
+		obj_allocated = pages_used / class->zspage_order *
+				class->objs_per_zspage;
+		obj_used = class->objs_used;
+		compacted = class->pages_compacted;
+		spin_unlock(&class->lock);
+
+		if (!pages_used && !compacted)
+			continue;
+
+		seq_printf(s, " %5d %5d %11lu %12lu %13lu %10lu %10lu %16d %10llu\n",
+			i, class->size, almost_full, almost_empty,
+			obj_allocated, obj_used, pages_used,
+			class->zspage_order, compacted);
+
+		total_objs += obj_allocated;
+		total_used += obj_used;
+		total_pages += pages_used;
+		total_compacted += compacted;
+	}
+
+	seq_printf(s, "\n %5s %5s %11s %12s %13lu %10lu %10lu %16s %10llu\n",
+			"Total", "", "", "", total_objs, total_used,
+			total_pages, "", total_compacted);
+
+	return 0;
+}
+
+static int zs_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zs_stats_show, inode->i_private);
+}
+
+static const struct file_operations zs_stats_fops = {
+	.open = zs_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void zs_pool_stat_create(struct zs_pool *pool)
+{
+	if (IS_ERR_OR_NULL(zs_stat_root))
+		return;
+
+	pool->stat_dentry = debugfs_create_file(pool->name, S_IRUGO,
+				zs_stat_root, pool, &zs_stats_fops);
+	if (IS_ERR_OR_NULL(pool->stat_dentry)) {
+		pr_warn("zsmalloc: no debugfs stats for pool %s\n",
+			pool->name);
+		pool->stat_dentry = NULL;
+	}
+}
+
+static void zs_pool_stat_destroy(struct zs_pool *pool)
+{
+	debugfs_remove(pool->stat_dentry);
+}
+#else
+static void zs_pool_stat_create(struct zs_pool *pool)
+{
+}
+
+static void zs_pool_stat_destroy(struct zs_pool *pool)
+{
+}
+#endif
 
 static int zs_cpu_notifier(struct notifier_block *nb, unsigned long action,
 				void *pcpu)
@@ -464,12 +891,25 @@ static void zs_exit(void)
 	for_each_online_cpu(cpu)
 		zs_cpu_notifier(NULL, CPU_DEAD, (void *)(long)cpu);
 	unregister_cpu_notifier(&zs_cpu_nb);
+
+	debugfs_remove(zs_stat_root);
+	if (zs_handle_cache)
+		kmem_cache_destroy(zs_handle_cache);
 }
 
 static int zs_init(void)
 {
 	int cpu, ret;
 
+	zs_handle_cache = kmem_cache_create("zs_handle", ZS_HANDLE_SIZE,
+					    0, 0, NULL);
+	if (!zs_handle_cache)
+		return -ENOMEM;
+
+	zs_stat_root = debugfs_create_dir("zsmalloc", NULL);
+	if (IS_ERR(zs_stat_root))
+		zs_stat_root = NULL;
+
 	register_cpu_notifier(&zs_cpu_nb);
 	for_each_online_cpu(cpu) {
 		ret = zs_cpu_notifier(NULL, CPU_UP_PREPARE, (void *)(long)cpu);
@@ -508,12 +948,19 @@ struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
 		class->index = i;
 		spin_lock_init(&class->lock);
 		class->zspage_order = get_zspage_order(size);
-
+		class->objs_per_zspage = class->zspage_order * PAGE_SIZE /
+						size;
 	}
 
 	pool->flags = flags;
 	pool->name = name;
 
+	pool->shrinker.shrink = zs_shrink;
+	pool->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&pool->shrinker);
+
+	zs_pool_stat_create(pool);
+
 	return pool;
 }
 EXPORT_SYMBOL_GPL(zs_create_pool);
@@ -522,6 +969,9 @@ void zs_destroy_pool(struct zs_pool *pool)
 {
 	int i;
 
+	zs_pool_stat_destroy(pool);
+	unregister_shrinker(&pool->shrinker);
+
 	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
 		int fg;
 		struct size_class *class = &pool->size_class[i];
@@ -542,28 +992,32 @@ EXPORT_SYMBOL_GPL(zs_destroy_pool);
  * zs_malloc - Allocate block of given size from pool.
  * @pool: pool to allocate from
  * @size: size of block to allocate
- * @page: page no. that holds the object
- * @offset: location of object within page
  *
- * On success, <page, offset> identifies block allocated
- * and 0 is returned. On failure, <page, offset> is set to
- * 0 and -ENOMEM is returned.
+ * On success, an opaque handle to the block is returned, to be passed
+ * to zs_map_object() for access. The handle stays valid when compaction
+ * moves the block. On failure, NULL is returned.
  *
- * Allocation requests with size > ZS_MAX_ALLOC_SIZE will fail.
+ * Allocation requests with size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE
+ * will fail.
  */
 void *zs_malloc(struct zs_pool *pool, size_t size)
 {
 	void *obj;
-	struct link_free *link;
+	unsigned long *handle;
 	int class_idx;
 	struct size_class *class;
+	struct page *first_page;
 
-	struct page *first_page, *m_page;
-	unsigned long m_objidx, m_offset;
+	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE))
+		return NULL;
 
-	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
+	handle = kmem_cache_alloc(zs_handle_cache,
+				  pool->flags & ~__GFP_HIGHMEM);
+	if (!handle)
 		return NULL;
 
+	/* extra space in the chunk to keep the handle */
+	size += ZS_HANDLE_SIZE;
 	class_idx = get_size_class_index(size);
 	class = &pool->size_class[class_idx];
 	BUG_ON(class_idx != class->index);
@@ -574,75 +1028,71 @@ void *zs_malloc(struct zs_pool *pool, size_t size)
 	if (!first_page) {
 		spin_unlock(&class->lock);
 		first_page = alloc_zspage(class, pool->flags);
-		if (unlikely(!first_page))
+		if (unlikely(!first_page)) {
+			kmem_cache_free(zs_handle_cache, handle);
 			return NULL;
+		}
 
 		set_zspage_mapping(first_page, class->index, ZS_EMPTY);
 		spin_lock(&class->lock);
 		class->pages_allocated += class->zspage_order;
 	}
 
-	obj = first_page->freelist;
-	obj_handle_to_location(obj, &m_page, &m_objidx);
-	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
-
-	link = (struct link_free *)kmap_atomic(m_page) +
-					m_offset / sizeof(*link);
-	first_page->freelist = link->next;
-	memset(link, POISON_INUSE, sizeof(*link));
-	kunmap_atomic(link);
+	obj = obj_malloc(first_page, class, handle);
+	record_obj(handle, obj);
 
-	first_page->inuse++;
 	/* Now move the zspage to another fullness group, if required */
 	fix_fullness_group(pool, first_page);
 	spin_unlock(&class->lock);
 
-	return obj;
+	return handle;
 }
 EXPORT_SYMBOL_GPL(zs_malloc);
 
 void zs_free(struct zs_pool *pool, void *obj)
 {
-	struct link_free *link;
+	unsigned long *handle = obj;
 	struct page *first_page, *f_page;
-	unsigned long f_objidx, f_offset;
+	unsigned long f_objidx;
+	void *loc;
 
 	int class_idx;
 	struct size_class *class;
 	enum fullness_group fullness;
 
-	if (unlikely(!obj))
+	if (unlikely(!handle))
 		return;
 
-	obj_handle_to_location(obj, &f_page, &f_objidx);
+	/* keeps compaction from moving the object under us */
+	pin_tag(handle);
+	loc = handle_to_obj(handle);
+	obj_to_location(loc, &f_page, &f_objidx);
 	first_page = get_first_page(f_page);
 
 	get_zspage_mapping(first_page, &class_idx, &fullness);
 	class = &pool->size_class[class_idx];
-	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
 
 	spin_lock(&class->lock);
-
-	/* Insert this object in containing zspage's freelist */
-	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
-							+ f_offset);
-	link->next = first_page->freelist;
-	kunmap_atomic(link);
-	first_page->freelist = obj;
-
-	first_page->inuse--;
+	obj_free(class, loc);
 	fullness = fix_fullness_group(pool, first_page);
 
 	if (fullness == ZS_EMPTY)
 		class->pages_allocated -= class->zspage_order;
 
 	spin_unlock(&class->lock);
+	unpin_tag(handle);
+
+	kmem_cache_free(zs_handle_cache, handle);
 
 	if (fullness == ZS_EMPTY)
 		free_zspage(first_page);
 }
 EXPORT_SYMBOL_GPL(zs_free);
 
+/*
+ * The object stays pinned, and so cannot be moved by compaction, until
+ * the matching zs_unmap_object().
+ */
 void *zs_map_object(struct zs_pool *pool, void *handle)
 {
 	struct page *page;
@@ -655,7 +1105,9 @@ void *zs_map_object(struct zs_pool *pool, void *handle)
 
 	BUG_ON(!handle);
 
-	obj_handle_to_location(handle, &page, &obj_idx);
+	pin_tag(handle);
+
+	obj_to_location(handle_to_obj(handle), &page, &obj_idx);
 	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
@@ -679,7 +1131,7 @@ void *zs_map_object(struct zs_pool *pool, void *handle)
 		area->vm_addr = area->vm->addr;
 	}
 
-	return area->vm_addr + off;
+	return area->vm_addr + off + ZS_HANDLE_SIZE;
 }
 EXPORT_SYMBOL_GPL(zs_map_object);
 
@@ -695,7 +1147,7 @@ void zs_unmap_object(struct zs_pool *pool, void *handle)
 
 	BUG_ON(!handle);
 
-	obj_handle_to_location(handle, &page, &obj_idx);
+	obj_to_location(handle_to_obj(handle), &page, &obj_idx);
 	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
@@ -710,6 +1162,8 @@ void zs_unmap_object(struct zs_pool *pool, void *handle)
 		__flush_tlb_one((unsigned long)area->vm_addr + PAGE_SIZE);
 	}
 	put_cpu_var(zs_map_area);
+
+	unpin_tag(handle);
 }
 EXPORT_SYMBOL_GPL(zs_unmap_object);
 
@@ -40,6 +40,7 @@
 #include <linux/pm_qos.h>
 #include <linux/platform_data/tegra_usb.h>
 #include <linux/timer.h>
+#include <linux/log2.h>
 
 #include <asm/byteorder.h>
 #include <asm/io.h>
@@ -101,18 +102,67 @@ static const u8 tegra_udc_test_packet[53] = {
 static struct tegra_udc *the_udc;
 
 #ifdef CONFIG_TEGRA_GADGET_BOOST_CPU_FREQ
+/*
+ * Bulk transfer boost.  While data moves, the bytes retired by done() and
+ * the number of requests in flight are sampled every BOOST_SAMPLE_MS.  The
+ * CPU frequency, online CPU and EMC floors are raised while either is over
+ * its threshold, and dropped boost_hold_ms after both fall below it.  An
+ * idle connection stops sampling and holds no floors.
+ */
+#define BOOST_SAMPLE_MS		100
+
 static struct pm_qos_request boost_cpu_freq_req;
-static u32 ep_queue_request_count;
-static u8 boost_cpufreq_work_flag, set_cpufreq_normal_flag;
-static struct timer_list boost_timer;
+static struct pm_qos_request boost_cpus_req;
+static struct pm_qos_request boost_emc_req;
+static u32 ep_queue_request_count;	/* protected by udc->lock */
+static u32 boost_bytes;			/* protected by udc->lock */
+static bool boost_sampling;		/* protected by udc->lock */
+static bool boosted;
+static unsigned long boost_until;	/* jiffies */
 static bool boost_enable = true;
+
+static unsigned int boost_min_kbps = 4096;	/* KB/s */
+module_param(boost_min_kbps, uint, 0644);
+MODULE_PARM_DESC(boost_min_kbps, "Bulk throughput that starts a boost");
+static unsigned int boost_min_depth = 4;
+module_param(boost_min_depth, uint, 0644);
+MODULE_PARM_DESC(boost_min_depth, "Requests in flight that start a boost");
+static unsigned int boost_hold_ms = 1000;
+module_param(boost_hold_ms, uint, 0644);
+MODULE_PARM_DESC(boost_hold_ms, "Time the floors are kept after traffic drops");
+static unsigned int boost_cpus = 2;
+module_param(boost_cpus, uint, 0644);
+MODULE_PARM_DESC(boost_cpus, "Minimum online CPUs while boosted");
+static unsigned int boost_emc_freq;	/* kHz */
+module_param(boost_emc_freq, uint, 0644);
+MODULE_PARM_DESC(boost_emc_freq, "EMC floor in kHz while boosted, 0 for none");
+
+/* last sample and boost count, read only */
+static unsigned int boost_kbps;
+module_param(boost_kbps, uint, 0444);
+static unsigned int boost_count;
+module_param(boost_count, uint, 0444);
+
+static void tegra_udc_unboost(void)
+{
+	if (!boosted)
+		return;
+	pm_qos_update_request(&boost_emc_req, PM_QOS_DEFAULT_VALUE);
+	pm_qos_update_request(&boost_cpus_req, PM_QOS_DEFAULT_VALUE);
+	pm_qos_update_request(&boost_cpu_freq_req, PM_QOS_DEFAULT_VALUE);
+	boosted = false;
+	DBG("%s(%d) set CPU frequency to normal\n", __func__, __LINE__);
+}
+
 static int boost_enable_set(const char *arg, const struct kernel_param *kp)
 {
 	bool old_boost = boost_enable;
 	int ret = param_set_bool(arg, kp);
-	if (ret == 0 && old_boost && !boost_enable)
-		pm_qos_update_request(&boost_cpu_freq_req,
-				      PM_QOS_DEFAULT_VALUE);
+	if (ret == 0 && old_boost && !boost_enable && the_udc) {
+		cancel_delayed_work_sync(&the_udc->boost_cpufreq_work);
+		tegra_udc_unboost();
+		boost_sampling = false;
+	}
 	return ret;
 }
 static int boost_enable_get(char *buffer, const struct kernel_param *kp)
@@ -126,6 +176,22 @@ static struct kernel_param_ops boost_enable_ops = {
 module_param_cb(boost_enable, &boost_enable_ops, &boost_enable, 0644);
 #endif
 
+/*
+ * Interrupt threshold: the controller holds completion interrupts for up to
+ * this many 125 uS micro frames.  Only 0, 1, 2, 4 ... 64 are valid, other
+ * values are rounded down.  Takes effect on the next controller run.
+ */
+static unsigned int itc_uframes = 1;
+module_param(itc_uframes, uint, 0644);
+MODULE_PARM_DESC(itc_uframes, "Max completion irq delay in micro frames");
+
+static u32 tegra_udc_itc(void)
+{
+	unsigned int itc = min(itc_uframes, 64U);
+
+	return (itc ? 1 << ilog2(itc) : 0) << USB_CMD_ITC_BIT_POS;
+}
+
 static inline void udc_writel(struct tegra_udc *udc, u32 val, u32 offset)
 {
 	writel(val, udc->regs + offset);
@@ -151,6 +217,80 @@ static inline bool vbus_enabled(struct tegra_udc *udc)
 	return status;
 }
 
+/*
+ * dTDs are recycled through a free list instead of going back to the
+ * dma_pool on every completion.  The list is filled at probe and capped at
+ * DTD_FREE_LIST_MAX entries; it may be used with or without udc->lock held.
+ */
+static struct ep_td_struct *tegra_dtd_alloc(struct tegra_udc *udc,
+	gfp_t gfp_flags, dma_addr_t *dma)
+{
+	struct ep_td_struct *dtd;
+	unsigned long flags;
+
+	spin_lock_irqsave(&udc->td_lock, flags);
+	dtd = udc->free_td;
+	if (dtd) {
+		udc->free_td = dtd->next_td_virt;
+		udc->free_td_count--;
+		udc->stat_td_reuse++;
+	}
+	spin_unlock_irqrestore(&udc->td_lock, flags);
+
+	if (dtd) {
+		*dma = dtd->td_dma;
+		return dtd;
+	}
+
+	dtd = dma_pool_alloc(udc->td_pool, gfp_flags, dma);
+	if (dtd) {
+		dtd->td_dma = *dma;
+		udc->stat_td_alloc++;
+	}
+	return dtd;
+}
+
+static void tegra_dtd_free(struct tegra_udc *udc, struct ep_td_struct *dtd)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&udc->td_lock, flags);
+	if (udc->free_td_count < DTD_FREE_LIST_MAX) {
+		dtd->next_td_virt = udc->free_td;
+		udc->free_td = dtd;
+		udc->free_td_count++;
+		dtd = NULL;
+	}
+	spin_unlock_irqrestore(&udc->td_lock, flags);
+
+	if (dtd)
+		dma_pool_free(udc->td_pool, dtd, dtd->td_dma);
+}
+
+static void tegra_dtd_free_chain(struct tegra_udc *udc,
+	struct ep_td_struct *dtd, int count)
+{
+	struct ep_td_struct *next_td;
+
+	while (count--) {
+		next_td = dtd->next_td_virt;
+		tegra_dtd_free(udc, dtd);
+		dtd = next_td;
+	}
+}
+
+/* Return the free list to the dma_pool before it is destroyed */
+static void tegra_dtd_drain(struct tegra_udc *udc)
+{
+	struct ep_td_struct *dtd;
+
+	while ((dtd = udc->free_td)) {
+		udc->free_td = dtd->next_td_virt;
+		dma_pool_free(udc->td_pool, dtd, dtd->td_dma);
+	}
+	udc->free_td_count = 0;
+}
+
 /**
  * done() - retire a request; caller blocked irqs
  * @status : request status to be set, only works when
@@ -160,8 +300,7 @@ static void done(struct tegra_ep *ep, struct tegra_req *req, int status)
 {
 	struct tegra_udc *udc = NULL;
 	unsigned char stopped = ep->stopped;
-	struct ep_td_struct *curr_td, *next_td = 0;
-	int j;
+	struct ep_td_struct *next_td = 0;
 	int count;
 
 	BUG_ON(!(in_irq() || irqs_disabled()));
@@ -184,13 +323,8 @@ static void done(struct tegra_ep *ep, struct tegra_req *req, int status)
 	ep->last_td = req->head;
 	ep->last_dtd_count = req->dtd_count;
 
-	for (j = 0; j < count; j++) {
-		curr_td = next_td;
-		if (j != count - 1) {
-			next_td = curr_td->next_td_virt;
-		}
-		dma_pool_free(udc->td_pool, curr_td, curr_td->td_dma);
-	}
+	if (count)
+		tegra_dtd_free_chain(udc, next_td, count);
 
 	if (req->mapped) {
 		DEFINE_DMA_ATTRS(attrs);
@@ -220,8 +354,10 @@ static void done(struct tegra_ep *ep, struct tegra_req *req, int status)
 
 	ep->stopped = 1;
 #ifdef CONFIG_TEGRA_GADGET_BOOST_CPU_FREQ
-	if (req->req.complete && req->req.length >= BOOST_TRIGGER_SIZE)
+	if (req->req.complete && req->req.length >= BOOST_TRIGGER_SIZE) {
 		ep_queue_request_count--;
+		boost_bytes += req->req.actual;
+	}
 #endif
 
 	/* complete() is from gadget layer,
@@ -390,11 +526,11 @@ static void dr_controller_run(struct tegra_udc *udc)
 	temp |= USB_MODE_CTRL_MODE_DEVICE;
 	udc_writel(udc, temp, USB_MODE_REG_OFFSET);
 
-	/* set interrupt latency to 125 uS (1 uFrame) */
+	/* set interrupt latency to itc_uframes micro frames */
 	/* Set controller to Run */
 	temp = udc_readl(udc, USB_CMD_REG_OFFSET);
 	temp &= ~USB_CMD_ITC;
-	temp |= USB_CMD_ITC_1_MICRO_FRM;
+	temp |= tegra_udc_itc();
 	if (can_pullup(udc)) {
 		temp |= USB_CMD_RUN_STOP;
 		if (udc->connect_type == CONNECT_TYPE_SDP)
@@ -672,8 +808,6 @@ static int tegra_ep_disable(struct usb_ep *_ep)
 	unsigned long flags = 0;
 	u32 epctrl;
 	int ep_num;
-	struct ep_td_struct *curr_td, *next_td;
-	int j;
 
 	ep = container_of(_ep, struct tegra_ep, ep);
 	if (!_ep || !ep->desc) {
@@ -702,16 +836,8 @@ static int tegra_ep_disable(struct usb_ep *_ep)
 
 	ep->desc = NULL;
 	ep->stopped = 1;
-	if (ep->last_td) {
-		next_td = ep->last_td;
-		for (j = 0; j < ep->last_dtd_count; j++) {
-			curr_td = next_td;
-			dma_pool_free(udc->td_pool, curr_td, curr_td->td_dma);
-			if (j != ep->last_dtd_count - 1) {
-				next_td = curr_td->next_td_virt;
-			}
-		}
-	}
+	if (ep->last_td)
+		tegra_dtd_free_chain(udc, ep->last_td, ep->last_dtd_count);
 	ep->last_td =0;
 	ep->last_dtd_count = 0;
 	spin_unlock_irqrestore(&udc->lock, flags);
@@ -832,16 +958,24 @@ static struct ep_td_struct *tegra_build_dtd(struct tegra_req *req,
 {
 	u32 swap_temp;
 	struct ep_td_struct *dtd;
+	unsigned remaining = req->req.length - req->req.actual;
 
-	/* how big will this transfer be? */
-	*length = min(req->req.length - req->req.actual,
-			(unsigned)EP_MAX_LENGTH_TRANSFER);
+	/*
+	 * how big will this transfer be?  Use all five buffer pages from
+	 * the start address; a dTD that is not the last one must end on a
+	 * packet boundary, or the host would see a short packet.
+	 */
+	swap_temp = (u32) (req->req.dma + req->req.actual);
+	*length = DTD_MAX_BUFFER_SIZE - (swap_temp & 0xfff);
+	if (*length >= remaining)
+		*length = remaining;
+	else
+		*length = rounddown(*length, req->ep->ep.maxpacket);
 
-	dtd = dma_pool_alloc(the_udc->td_pool, gfp_flags, dma);
+	dtd = tegra_dtd_alloc(the_udc, gfp_flags, dma);
 	if (dtd == NULL)
 		return dtd;
 
-	dtd->td_dma = *dma;
 	/* Clear reserved field */
 	swap_temp = cpu_to_le32(dtd->size_ioc_sts);
 	swap_temp &= ~DTD_RESERVED_FIELDS;
@@ -900,8 +1034,13 @@ static int tegra_req_to_dtd(struct tegra_req *req, gfp_t gfp_flags)
 
 	do {
 		dtd = tegra_build_dtd(req, &count, &dma, &is_last, gfp_flags);
-		if (dtd == NULL)
+		if (dtd == NULL) {
+			if (req->dtd_count)
+				tegra_dtd_free_chain(the_udc, req->head,
+						     req->dtd_count);
+			req->dtd_count = 0;
 			return -ENOMEM;
+		}
 
 		if (is_first) {
 			is_first = 0;
@@ -919,6 +1058,9 @@ static int tegra_req_to_dtd(struct tegra_req *req, gfp_t gfp_flags)
 
 	req->tail = dtd;
 
+	the_udc->stat_reqs++;
+	the_udc->stat_dtds += req->dtd_count;
+
 	return 0;
 }
 
@@ -955,13 +1097,6 @@ tegra_ep_queue(struct usb_ep *_ep, struct usb_request *_req, gfp_t gfp_flags)
 		}
 	}
 
-#ifdef CONFIG_TEGRA_GADGET_BOOST_CPU_FREQ
-	if (req->req.length >= BOOST_TRIGGER_SIZE) {
-		ep_queue_request_count++;
-		schedule_work(&udc->boost_cpufreq_work);
-	}
-#endif
-
 	dir = ep_is_in(ep) ? DMA_TO_DEVICE : DMA_FROM_DEVICE;
 
 	spin_unlock_irqrestore(&udc->lock, flags);
@@ -1015,6 +1150,17 @@ tegra_ep_queue(struct usb_ep *_ep, struct usb_request *_req, gfp_t gfp_flags)
 	if ((ep_index(ep) == 0))
 		udc->ep0_state = DATA_STATE_XMIT;
 
+#ifdef CONFIG_TEGRA_GADGET_BOOST_CPU_FREQ
+	if (req->req.length >= BOOST_TRIGGER_SIZE) {
+		ep_queue_request_count++;
+		if (boost_enable && !boost_sampling) {
+			boost_sampling = true;
+			schedule_delayed_work(&udc->boost_cpufreq_work,
+				msecs_to_jiffies(BOOST_SAMPLE_MS));
+		}
+	}
+#endif
+
 	/* irq handler advances the queue */
 	list_add_tail(&req->queue, &ep->queue);
 	spin_unlock_irqrestore(&udc->lock, flags);
@@ -1504,10 +1650,10 @@ static int tegra_pullup(struct usb_gadget *gadget, int is_on)
 			OTG_STATE_B_PERIPHERAL)
 			return 0;
 
-	/* set interrupt latency to 125 uS (1 uFrame) */
+	/* set interrupt latency to itc_uframes micro frames */
 	tmp = udc_readl(udc, USB_CMD_REG_OFFSET);
 	tmp &= ~USB_CMD_ITC;
-	tmp |= USB_CMD_ITC_1_MICRO_FRM;
+	tmp |= tegra_udc_itc();
 	if (can_pullup(udc)) {
 		udc_writel(udc, tmp | USB_CMD_RUN_STOP, USB_CMD_REG_OFFSET);
 		/*
@@ -2114,6 +2260,8 @@ static void dtd_complete_irq(struct tegra_udc *udc)
 	if (!bit_pos)
 		return;
 
+	udc->stat_irqs++;
+
 	for (i = 0; i < udc->max_ep; i++) {
 		ep_num = i >> 1;
 		direction = i % 2;
@@ -2142,6 +2290,7 @@ static void dtd_complete_irq(struct tegra_udc *udc)
 				break;
 			/* write back status to req */
 			curr_req->req.status = status;
+			udc->stat_irq_reqs++;
 
 			if (ep_num == 0) {
 				ep0_req_complete(udc, curr_ep, curr_req);
@@ -2272,6 +2421,20 @@ static void reset_irq(struct tegra_udc *udc)
 	udc->usb_state = USB_STATE_DEFAULT;
 }
 
+static ssize_t tegra_udc_dtd_stats_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tegra_udc *udc = dev_get_drvdata(dev);
+
+	return sprintf(buf, "requests %lu\ndtds %lu\ncomplete_irqs %lu\n"
+			"irq_requests %lu\ntd_pool_allocs %lu\n"
+			"td_reuse %lu\ntd_free %u\n",
+			udc->stat_reqs, udc->stat_dtds, udc->stat_irqs,
+			udc->stat_irq_reqs, udc->stat_td_alloc,
+			udc->stat_td_reuse, udc->free_td_count);
+}
+static DEVICE_ATTR(dtd_stats, S_IRUGO, tegra_udc_dtd_stats_show, NULL);
+
 static void tegra_udc_set_current_limit_work(struct work_struct *work)
 {
 	struct tegra_udc *udc = container_of(work, struct tegra_udc,
@@ -2280,36 +2443,56 @@ static void tegra_udc_set_current_limit_work(struct work_struct *work)
 }
 
 #ifdef CONFIG_TEGRA_GADGET_BOOST_CPU_FREQ
-void tegra_udc_set_cpu_freq_normal(unsigned long data)
-{
-	set_cpufreq_normal_flag = 1;
-	schedule_work(&the_udc->boost_cpufreq_work);
-}
-
 static void tegra_udc_boost_cpu_frequency_work(struct work_struct *work)
 {
-	if (set_cpufreq_normal_flag) {
-		pm_qos_update_request(&boost_cpu_freq_req,
-					PM_QOS_DEFAULT_VALUE);
-		boost_cpufreq_work_flag = 1;
-		set_cpufreq_normal_flag = 0;
-		DBG("%s(%d) set CPU frequency to normal\n", __func__,
-							__LINE__);
-		return ;
-	}
-
-	/* If CPU frequency is not boosted earlier boost it, and modify
-	 * timer expiry time to 2sec */
-	if (boost_cpufreq_work_flag) {
-		if (boost_enable)
-			pm_qos_update_request(
-				&boost_cpu_freq_req,
+	struct tegra_udc *udc = container_of(to_delayed_work(work),
+				struct tegra_udc, boost_cpufreq_work);
+	unsigned long flags;
+	u32 bytes, depth;
+
+	spin_lock_irqsave(&udc->lock, flags);
+	bytes = boost_bytes;
+	boost_bytes = 0;
+	depth = ep_queue_request_count;
+	spin_unlock_irqrestore(&udc->lock, flags);
+
+	/* bytes per ms is KB/s */
+	boost_kbps = bytes / BOOST_SAMPLE_MS;
+
+	if (boost_enable && bytes && (boost_kbps >= boost_min_kbps ||
+				      depth >= boost_min_depth)) {
+		boost_until = jiffies + msecs_to_jiffies(boost_hold_ms);
+		if (!boosted) {
+			pm_qos_update_request(&boost_cpu_freq_req,
 				(s32)(CONFIG_TEGRA_GADGET_BOOST_CPU_FREQ
 				      * 1000));
-		boost_cpufreq_work_flag = 0;
-		DBG("%s(%d) boost CPU frequency\n", __func__, __LINE__);
+			pm_qos_update_request(&boost_cpus_req,
+				boost_cpus ? (s32)boost_cpus
+					   : PM_QOS_DEFAULT_VALUE);
+			pm_qos_update_request(&boost_emc_req,
+				boost_emc_freq ? (s32)boost_emc_freq
+					       : PM_QOS_DEFAULT_VALUE);
+			boosted = true;
+			boost_count++;
+			DBG("%s(%d) boost CPU frequency\n", __func__,
+			    __LINE__);
+		}
+	} else if (boosted && time_after_eq(jiffies, boost_until)) {
+		tegra_udc_unboost();
 	}
-	mod_timer(&boost_timer, jiffies + msecs_to_jiffies(2000));
+
+	/*
+	 * Keep sampling while boosted or moving data.  Gadgets keep an OUT
+	 * request queued while idle, so queue depth alone does not count;
+	 * the next tegra_ep_queue() restarts sampling.
+	 */
+	spin_lock_irqsave(&udc->lock, flags);
+	if (boost_enable && (boosted || bytes || boost_bytes))
+		schedule_delayed_work(&udc->boost_cpufreq_work,
+				      msecs_to_jiffies(BOOST_SAMPLE_MS));
+	else
+		boost_sampling = false;
+	spin_unlock_irqrestore(&udc->lock, flags);
 }
 #endif
 
@@ -2705,6 +2888,7 @@ static int __init tegra_udc_probe(struct platform_device *pdev)
 	struct resource *res;
 	struct tegra_usb_platform_data *pdata;
 	int err = -ENODEV;
+	int i;
 	DBG("%s(%d) BEGIN\n", __func__, __LINE__);
 
 	if (strcmp(pdev->name, driver_name)) {
@@ -2790,6 +2974,7 @@ static int __init tegra_udc_probe(struct platform_device *pdev)
 		goto err_phy;
 	}
 	spin_lock_init(&udc->lock);
+	spin_lock_init(&udc->td_lock);
 	udc->stopped = 1;
 	udc->pdev = pdev;
 	udc->has_hostpc = tegra_usb_phy_has_hostpc(udc->phy) ? 1 : 0;
@@ -2831,17 +3016,34 @@ static int __init tegra_udc_probe(struct platform_device *pdev)
 		goto err_unregister;
 	}
 
+	/* Pre-fill the free list so the first transfers skip the pool */
+	for (i = 0; i < DTD_FREE_LIST_MIN; i++) {
+		struct ep_td_struct *dtd;
+		dma_addr_t dma;
+
+		dtd = dma_pool_alloc(udc->td_pool, GFP_KERNEL, &dma);
+		if (!dtd)
+			break;
+		dtd->td_dma = dma;
+		tegra_dtd_free(udc, dtd);
+	}
+
 	err = usb_add_gadget_udc(&pdev->dev, &udc->gadget);
 	if (err)
 		goto err_del_udc;
+
+	if (device_create_file(&pdev->dev, &dev_attr_dtd_stats))
+		dev_warn(&pdev->dev, "failed to create dtd_stats\n");
 #ifdef CONFIG_TEGRA_GADGET_BOOST_CPU_FREQ
-	boost_cpufreq_work_flag = 1;
 	ep_queue_request_count = 0;
-	INIT_WORK(&udc->boost_cpufreq_work,
+	INIT_DELAYED_WORK(&udc->boost_cpufreq_work,
 					tegra_udc_boost_cpu_frequency_work);
 	pm_qos_add_request(&boost_cpu_freq_req, PM_QOS_CPU_FREQ_MIN,
 					PM_QOS_DEFAULT_VALUE);
-	setup_timer(&boost_timer, tegra_udc_set_cpu_freq_normal, 0);
+	pm_qos_add_request(&boost_cpus_req, PM_QOS_MIN_ONLINE_CPUS,
+					PM_QOS_DEFAULT_VALUE);
+	pm_qos_add_request(&boost_emc_req, PM_QOS_EMC_FREQ_MIN,
+					PM_QOS_DEFAULT_VALUE);
 #endif
 
 	/* Create work for controlling clocks to the phy if otg is disabled */
@@ -2884,6 +3086,7 @@ static int __init tegra_udc_probe(struct platform_device *pdev)
 	return 0;
 
 err_del_udc:
+	tegra_dtd_drain(udc);
 	dma_pool_destroy(udc->td_pool);
 
 err_unregister:
@@ -2920,14 +3123,16 @@ static int __exit tegra_udc_remove(struct platform_device *pdev)
 	if (!udc)
 		return -ENODEV;
 
+	device_remove_file(&pdev->dev, &dev_attr_dtd_stats);
 	usb_del_gadget_udc(&udc->gadget);
 	udc->done = &done;
 
 	cancel_delayed_work(&udc->non_std_charger_work);
 #ifdef CONFIG_TEGRA_GADGET_BOOST_CPU_FREQ
-	cancel_work_sync(&udc->boost_cpufreq_work);
+	cancel_delayed_work_sync(&udc->boost_cpufreq_work);
+	pm_qos_remove_request(&boost_emc_req);
+	pm_qos_remove_request(&boost_cpus_req);
 	pm_qos_remove_request(&boost_cpu_freq_req);
-	del_timer(&boost_timer);
 #endif
 
 	if (udc->vbus_reg)
@@ -2944,6 +3149,7 @@ static int __exit tegra_udc_remove(struct platform_device *pdev)
 	kfree(udc->status_req);
 	kfree(udc->eps);
 
+	tegra_dtd_drain(udc);
 	dma_pool_destroy(udc->td_pool);
 	free_irq(udc->irq, udc);
 	iounmap(udc->regs);
@@ -307,6 +307,8 @@
 #define  EP_QUEUE_HEAD_NEXT_POINTER_MASK      0xFFFFFFE0
 #define  EP_QUEUE_FRINDEX_MASK                0x000007FF
 #define  EP_MAX_LENGTH_TRANSFER               0x4000
+/* five 4K buffer pointers per dTD */
+#define  DTD_MAX_BUFFER_SIZE                  0x5000
 
 
 
@@ -326,6 +328,10 @@
 						DTD_STATUS_TRANSACTION_ERR)
 /* Alignment requirements; must be a power of two */
 #define DTD_ALIGNMENT				0x80
+
+/* dTDs kept on the free list at probe, and at most */
+#define DTD_FREE_LIST_MIN			64
+#define DTD_FREE_LIST_MAX			512
 #define QH_ALIGNMENT				2048
 #define QH_OFFSET				0x1000
 
@@ -426,13 +432,23 @@ struct tegra_udc {
 	struct ep_queue_head *ep_qh;	/* Endpoints Queue-Head */
 	struct tegra_req *status_req;	/* ep0 status request */
 	struct dma_pool *td_pool;	/* dma pool for DTD */
+	struct ep_td_struct *free_td;	/* recycled dTDs, next_td_virt linked */
+	unsigned int free_td_count;
+	spinlock_t td_lock;		/* protects free_td */
+	/* dTD statistics */
+	unsigned long stat_reqs;	/* requests turned into dTD chains */
+	unsigned long stat_dtds;	/* dTDs built for those requests */
+	unsigned long stat_td_alloc;	/* dTDs taken from the dma_pool */
+	unsigned long stat_td_reuse;	/* dTDs taken from the free list */
+	unsigned long stat_irqs;	/* dTD completion interrupts */
+	unsigned long stat_irq_reqs;	/* requests retired by those irqs */
 	struct regulator *vbus_reg;	/* regulator for drawing VBUS */
 	/* delayed work for non standard charger detection */
 	struct delayed_work non_std_charger_work;
 	/* work for setting regulator current limit */
 	struct work_struct current_work;
-	/* work for boosting cpu frequency */
-	struct work_struct boost_cpufreq_work;
+	/* sampling work for the bulk transfer boost */
+	struct delayed_work boost_cpufreq_work;
 	/* irq work for controlling the usb power */
 	struct work_struct irq_work;
 	enum tegra_connect_type connect_type;
@@ -44,6 +44,48 @@ static const char driver_name[] = "tegra-ehci";
 #define TEGRA_STREAM_DISABLE	0x1f8
 #define TEGRA_STREAM_DISABLE_OFFSET (1 << 4)
 
+#define TEGRA_EHCI_CMD_ITC		(0xff << 16)
+
+/* irq to giveback latency buckets: 0, 1, 2-3, 4-7 ... 256+ us */
+#define TEGRA_EHCI_LAT_BUCKETS		10
+
+/*
+ * Interrupt moderation: "auto" uses the latency threshold while a HID
+ * device is attached, the storage threshold while a mass storage device is
+ * attached, and log2_irq_thresh otherwise.  The other modes force one.
+ */
+enum tegra_ehci_itc_mode {
+	TEGRA_EHCI_ITC_AUTO,
+	TEGRA_EHCI_ITC_DEFAULT,
+	TEGRA_EHCI_ITC_LATENCY,
+	TEGRA_EHCI_ITC_STORAGE,
+};
+
+static const char * const tegra_ehci_itc_modes[] = {
+	[TEGRA_EHCI_ITC_AUTO]		= "auto",
+	[TEGRA_EHCI_ITC_DEFAULT]	= "default",
+	[TEGRA_EHCI_ITC_LATENCY]	= "latency",
+	[TEGRA_EHCI_ITC_STORAGE]	= "storage",
+};
+
+static int tegra_hid_log2_irq_thresh;		/* 1 microframe */
+module_param(tegra_hid_log2_irq_thresh, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(tegra_hid_log2_irq_thresh,
+		 "log2 IRQ latency with HID devices attached");
+static int tegra_storage_log2_irq_thresh = 3;	/* 1 ms */
+module_param(tegra_storage_log2_irq_thresh, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(tegra_storage_log2_irq_thresh,
+		 "log2 IRQ latency with mass storage attached");
+
+struct tegra_ehci_stats {
+	unsigned long irqs;
+	unsigned long urbs[4];		/* by usb_pipetype() */
+	unsigned long irq_urbs;		/* given back from the irq */
+	unsigned long lat[TEGRA_EHCI_LAT_BUCKETS];
+	u64 lat_total_us;
+	unsigned int lat_max_us;
+};
+
 struct tegra_ehci_hcd {
 	struct ehci_hcd *ehci;
 	struct tegra_usb_phy *phy;
@@ -55,6 +97,14 @@ struct tegra_ehci_hcd {
 	unsigned int irq;
 	bool bus_suspended_fail;
 	bool unaligned_dma_buf_supported;
+	struct notifier_block usb_nb;
+	enum tegra_ehci_itc_mode itc_mode;
+	int log2_itc;			/* threshold in effect */
+	unsigned int hid_devs;		/* attached, protected by sync_lock */
+	unsigned int storage_devs;
+	bool in_irq;
+	ktime_t irq_start;
+	struct tegra_ehci_stats stats;	/* protected by ehci->lock */
 };
 
 struct dma_align_buffer {
@@ -152,9 +202,39 @@ static int tegra_ehci_map_urb_for_dma(struct usb_hcd *hcd,
 	return ret;
 }
 
+/*
+ * Completion statistics.  Each controller drives a single root port, so
+ * these are per port.  Latency is measured from controller irq entry to the
+ * giveback, so it does not include the interrupt threshold itself.
+ */
+static void tegra_ehci_count_urb(struct tegra_ehci_hcd *tegra,
+	struct ehci_hcd *ehci, struct urb *urb)
+{
+	struct tegra_ehci_stats *st = &tegra->stats;
+	unsigned long flags;
+	unsigned int us = 0;
+
+	if (tegra->in_irq)
+		us = ktime_to_us(ktime_sub(ktime_get(), tegra->irq_start));
+
+	spin_lock_irqsave(&ehci->lock, flags);
+	st->urbs[usb_pipetype(urb->pipe)]++;
+	if (tegra->in_irq) {
+		st->irq_urbs++;
+		st->lat[min(fls(us), TEGRA_EHCI_LAT_BUCKETS - 1)]++;
+		st->lat_total_us += us;
+		if (us > st->lat_max_us)
+			st->lat_max_us = us;
+	}
+	spin_unlock_irqrestore(&ehci->lock, flags);
+}
+
 static void tegra_ehci_unmap_urb_for_dma(struct usb_hcd *hcd,
 	struct urb *urb)
 {
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(hcd->self.controller);
+
+	tegra_ehci_count_urb(tegra, hcd_to_ehci(hcd), urb);
 	usb_hcd_unmap_urb_for_dma(hcd, urb);
 	free_align_buffer(urb, hcd);
 }
@@ -177,6 +257,7 @@ static irqreturn_t tegra_ehci_irq(struct usb_hcd *hcd)
 		spin_unlock(&ehci->lock);
 		return irq_status;
 	}
+	tegra->stats.irqs++;
 	spin_unlock(&ehci->lock);
 
 	EHCI_DBG("%s() cmd = 0x%x, int_sts = 0x%x, portsc = 0x%x\n", __func__,
@@ -184,7 +265,10 @@ static irqreturn_t tegra_ehci_irq(struct usb_hcd *hcd)
 		ehci_readl(ehci, &ehci->regs->status),
 		ehci_readl(ehci, &ehci->regs->port_status[0]));
 
+	tegra->irq_start = ktime_get();
+	tegra->in_irq = true;
 	irq_status = ehci_irq(hcd);
+	tegra->in_irq = false;
 
 	if (ehci->controller_remote_wakeup) {
 		ehci->controller_remote_wakeup = false;
@@ -290,6 +374,207 @@ static int tegra_ehci_hub_control(
 	return retval;
 }
 
+/*
+ * Pick the interrupt threshold for the attached devices and program it.
+ * ehci->command is updated as well, so that ehci_run() and bus resume
+ * keep it.  Called with sync_lock held, or before the hcd runs.
+ */
+static void tegra_ehci_update_itc(struct tegra_ehci_hcd *tegra,
+	struct ehci_hcd *ehci)
+{
+	enum tegra_ehci_itc_mode mode = tegra->itc_mode;
+	unsigned long flags;
+	int log2_itc;
+	u32 cmd;
+
+	if (mode == TEGRA_EHCI_ITC_AUTO) {
+		if (tegra->hid_devs)
+			mode = TEGRA_EHCI_ITC_LATENCY;
+		else if (tegra->storage_devs)
+			mode = TEGRA_EHCI_ITC_STORAGE;
+		else
+			mode = TEGRA_EHCI_ITC_DEFAULT;
+	}
+
+	if (mode == TEGRA_EHCI_ITC_LATENCY)
+		log2_itc = tegra_hid_log2_irq_thresh;
+	else if (mode == TEGRA_EHCI_ITC_STORAGE)
+		log2_itc = tegra_storage_log2_irq_thresh;
+	else
+		log2_itc = log2_irq_thresh;
+	log2_itc = clamp(log2_itc, 0, 6);
+
+	/* a HID device should not wait for the phy to power up */
+	tegra_usb_phy_block_lp(tegra->phy, mode == TEGRA_EHCI_ITC_LATENCY &&
+			       tegra->hid_devs);
+
+	spin_lock_irqsave(&ehci->lock, flags);
+	tegra->log2_itc = log2_itc;
+	ehci->command &= ~TEGRA_EHCI_CMD_ITC;
+	ehci->command |= 1 << (16 + log2_itc);
+	if (ehci->rh_state == EHCI_RH_RUNNING &&
+	    tegra_usb_phy_hw_accessible(tegra->phy)) {
+		cmd = ehci_readl(ehci, &ehci->regs->command);
+		cmd &= ~TEGRA_EHCI_CMD_ITC;
+		cmd |= 1 << (16 + log2_itc);
+		ehci_writel(ehci, cmd, &ehci->regs->command);
+	}
+	spin_unlock_irqrestore(&ehci->lock, flags);
+}
+
+static void tegra_ehci_classify(struct usb_device *udev,
+	bool *hid, bool *storage)
+{
+	struct usb_host_config *config = udev->actconfig;
+	int i;
+
+	*hid = *storage = false;
+	if (!config)
+		return;
+
+	for (i = 0; i < config->desc.bNumInterfaces; i++) {
+		struct usb_interface *intf = config->interface[i];
+		u8 class;
+
+		if (!intf || !intf->cur_altsetting)
+			continue;
+		class = intf->cur_altsetting->desc.bInterfaceClass;
+		if (class == USB_CLASS_HID)
+			*hid = true;
+		else if (class == USB_CLASS_MASS_STORAGE)
+			*storage = true;
+	}
+}
+
+static int tegra_ehci_usb_notify(struct notifier_block *nb,
+	unsigned long action, void *data)
+{
+	struct tegra_ehci_hcd *tegra = container_of(nb, struct tegra_ehci_hcd,
+						    usb_nb);
+	struct usb_device *udev = data;
+	bool hid, storage;
+
+	if (action != USB_DEVICE_ADD && action != USB_DEVICE_REMOVE)
+		return NOTIFY_DONE;
+	if (!tegra->ehci || udev->bus != &ehci_to_hcd(tegra->ehci)->self)
+		return NOTIFY_DONE;
+
+	tegra_ehci_classify(udev, &hid, &storage);
+	if (!hid && !storage)
+		return NOTIFY_OK;
+
+	mutex_lock(&tegra->sync_lock);
+	if (action == USB_DEVICE_ADD) {
+		tegra->hid_devs += hid;
+		tegra->storage_devs += storage;
+	} else {
+		if (hid && tegra->hid_devs)
+			tegra->hid_devs--;
+		if (storage && tegra->storage_devs)
+			tegra->storage_devs--;
+	}
+	tegra_ehci_update_itc(tegra, tegra->ehci);
+	mutex_unlock(&tegra->sync_lock);
+
+	return NOTIFY_OK;
+}
+
+static ssize_t show_irq_moderation(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+	ssize_t n = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tegra_ehci_itc_modes); i++)
+		n += sprintf(buf + n, i == tegra->itc_mode ? "[%s] " : "%s ",
+			     tegra_ehci_itc_modes[i]);
+	n += sprintf(buf + n, "itc %d uframes hid %u storage %u\n",
+		     1 << tegra->log2_itc, tegra->hid_devs,
+		     tegra->storage_devs);
+	return n;
+}
+
+static ssize_t store_irq_moderation(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tegra_ehci_itc_modes); i++)
+		if (sysfs_streq(buf, tegra_ehci_itc_modes[i]))
+			break;
+	if (i == ARRAY_SIZE(tegra_ehci_itc_modes))
+		return -EINVAL;
+
+	mutex_lock(&tegra->sync_lock);
+	tegra->itc_mode = i;
+	if (tegra->ehci)
+		tegra_ehci_update_itc(tegra, tegra->ehci);
+	mutex_unlock(&tegra->sync_lock);
+
+	return count;
+}
+static DEVICE_ATTR(irq_moderation, S_IRUGO | S_IWUSR, show_irq_moderation,
+		   store_irq_moderation);
+
+static ssize_t show_urb_stats(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+	struct tegra_ehci_stats st;
+	unsigned long flags;
+	ssize_t n;
+	int i;
+
+	if (!tegra->ehci)
+		return -ENODEV;
+
+	spin_lock_irqsave(&tegra->ehci->lock, flags);
+	st = tegra->stats;
+	spin_unlock_irqrestore(&tegra->ehci->lock, flags);
+
+	n = sprintf(buf, "irqs %lu\nctrl %lu\nbulk %lu\nintr %lu\niso %lu\n"
+		    "irq_urbs %lu\n", st.irqs, st.urbs[PIPE_CONTROL],
+		    st.urbs[PIPE_BULK], st.urbs[PIPE_INTERRUPT],
+		    st.urbs[PIPE_ISOCHRONOUS], st.irq_urbs);
+	n += sprintf(buf + n, "latency_us avg %llu max %u\nhist",
+		     st.irq_urbs ? div_u64(st.lat_total_us, st.irq_urbs) : 0,
+		     st.lat_max_us);
+	for (i = 0; i < TEGRA_EHCI_LAT_BUCKETS; i++)
+		n += sprintf(buf + n, " %lu", st.lat[i]);
+	n += sprintf(buf + n, "\n");
+	return n;
+}
+
+static ssize_t store_urb_stats(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+	unsigned long flags;
+
+	if (!tegra->ehci)
+		return -ENODEV;
+
+	spin_lock_irqsave(&tegra->ehci->lock, flags);
+	memset(&tegra->stats, 0, sizeof(tegra->stats));
+	spin_unlock_irqrestore(&tegra->ehci->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR(urb_stats, S_IRUGO | S_IWUSR, show_urb_stats,
+		   store_urb_stats);
+
+static struct attribute *tegra_ehci_attrs[] = {
+	&dev_attr_irq_moderation.attr,
+	&dev_attr_urb_stats.attr,
+	NULL,
+};
+
+static const struct attribute_group tegra_ehci_attr_group = {
+	.attrs = tegra_ehci_attrs,
+};
+
 static void tegra_ehci_shutdown(struct usb_hcd *hcd)
 {
 	struct ehci_hcd *ehci = hcd_to_ehci(hcd);
@@ -348,6 +633,9 @@ static int tegra_ehci_setup(struct usb_hcd *hcd)
 	if (retval)
 		return retval;
 
+	/* ehci_init() set the threshold from log2_irq_thresh */
+	tegra_ehci_update_itc(tegra, ehci);
+
 	ehci->sbrn = 0x20;
 	ehci->controller_remote_wakeup = false;
 	ehci_reset(ehci);
@@ -581,6 +869,11 @@ static int tegra_ehci_probe(struct platform_device *pdev)
 
 	tegra->ehci = hcd_to_ehci(hcd);
 
+	tegra->usb_nb.notifier_call = tegra_ehci_usb_notify;
+	usb_register_notify(&tegra->usb_nb);
+	if (sysfs_create_group(&pdev->dev.kobj, &tegra_ehci_attr_group))
+		dev_warn(&pdev->dev, "failed to create sysfs attributes\n");
+
 #ifdef CONFIG_USB_OTG_UTILS
 	if (tegra_usb_phy_otg_supported(tegra->phy)) {
 		tegra->transceiver = usb_get_transceiver();
@@ -588,6 +881,13 @@ static int tegra_ehci_probe(struct platform_device *pdev)
 			otg_set_host(tegra->transceiver->otg, &hcd->self);
 	}
 #endif
+	/*
+	 * Resume host-only ports in parallel with the rest of LP0 resume;
+	 * an OTG port has to stay ordered against its transceiver.
+	 */
+	if (!tegra_usb_phy_otg_supported(tegra->phy))
+		device_enable_async_suspend(&pdev->dev);
+
 	return err;
 
 fail_phy:
@@ -641,6 +941,9 @@ static int tegra_ehci_remove(struct platform_device *pdev)
 	if (hcd == NULL)
 		return -EINVAL;
 
+	sysfs_remove_group(&pdev->dev.kobj, &tegra_ehci_attr_group);
+	usb_unregister_notify(&tegra->usb_nb);
+
 #ifdef CONFIG_USB_OTG_UTILS
 	if (tegra->transceiver) {
 		otg_set_host(tegra->transceiver->otg, NULL);
@@ -18,6 +18,7 @@
 #include "camera_clk.h"
 #include "camera_power.h"
 #include "camera_emc.h"
+#include "camera_bufq.h"
 
 #define TEGRA_CAMERA_NAME "tegra_camera"
 
@@ -36,6 +37,38 @@ static struct clock_data clock_init[] = {
 #endif
 };
 
+/* VI instance that sensor drivers report their active mode to */
+static struct tegra_camera *tegra_camera_sensor_target;
+
+/**
+ * tegra_camera_set_sensor_mode - report the active sensor mode
+ * @res_x: output width in pixels, 0 when the sensor stops streaming
+ * @res_y: output height in pixels
+ * @frame_rate: peak frame rate, in fps * 1000
+ *
+ * Scales the camera EMC floor and ISO reservation to the mode, so a
+ * small preview does not hold EMC at the rate of a full resolution burst.
+ */
+int tegra_camera_set_sensor_mode(u32 res_x, u32 res_y, u32 frame_rate)
+{
+	struct tegra_camera *camera = tegra_camera_sensor_target;
+	int ret;
+
+	if (!camera)
+		return 0;
+
+	mutex_lock(&camera->tegra_camera_lock);
+	camera->emc_sensor_bw = tegra_camera_emc_mode_bw(res_x, res_y,
+							frame_rate);
+	dev_dbg(camera->dev, "%s: %ux%u@%u -> %lu KB/s\n", __func__,
+		res_x, res_y, frame_rate, camera->emc_sensor_bw);
+	ret = tegra_camera_emc_update(camera);
+	mutex_unlock(&camera->tegra_camera_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(tegra_camera_set_sensor_mode);
+
 static long tegra_camera_ioctl(struct file *file,
 			       unsigned int cmd, unsigned long arg)
 {
@@ -76,7 +109,9 @@ static long tegra_camera_ioctl(struct file *file,
 				"%s: Failed to copy arg from user\n", __func__);
 			return -EFAULT;
 		}
+		mutex_lock(&camera->tegra_camera_lock);
 		ret = tegra_camera_clk_set_rate(camera);
+		mutex_unlock(&camera->tegra_camera_lock);
 		if (ret)
 			return ret;
 		if (copy_to_user((void __user *)arg, &camera->info,
@@ -87,6 +122,11 @@ static long tegra_camera_ioctl(struct file *file,
 		}
 		return 0;
 	}
+	case TEGRA_CAMERA_IOCTL_SET_NVMAP_FD:
+	case TEGRA_CAMERA_IOCTL_BUFQ_REGISTER:
+	case TEGRA_CAMERA_IOCTL_BUFQ_QUEUE:
+	case TEGRA_CAMERA_IOCTL_BUFQ_DEQUEUE:
+		return tegra_camera_bufq_ioctl(camera, cmd, arg);
 	default:
 		dev_err(camera->dev,
 				"%s: Unknown tegra_camera ioctl.\n", __func__);
@@ -129,10 +169,17 @@ static int tegra_camera_open(struct inode *inode, struct file *file)
 	if (ret)
 		goto enable_clk_fail;
 
+	/* set up the capture buffer ring */
+	ret = tegra_camera_bufq_open(camera);
+	if (ret)
+		goto bufq_fail;
+
 	mutex_unlock(&camera->tegra_camera_lock);
 
 	return 0;
 
+bufq_fail:
+	tegra_camera_disable_clk(camera);
 enable_clk_fail:
 	tegra_camera_disable_emc(camera);
 enable_emc_fail:
@@ -150,6 +197,8 @@ static int tegra_camera_release(struct inode *inode, struct file *file)
 	dev_info(camera->dev, "%s++\n", __func__);
 
 	mutex_lock(&camera->tegra_camera_lock);
+	/* drop the buffers before the engines lose their clocks */
+	tegra_camera_bufq_release(camera);
 	/* disable HW clock */
 	ret = tegra_camera_disable_clk(camera);
 	if (ret)
@@ -275,6 +324,9 @@ struct tegra_camera *tegra_camera_register(struct platform_device *ndev)
 	}
 #endif
 
+	if (!tegra_camera_sensor_target)
+		tegra_camera_sensor_target = camera;
+
 	return camera;
 
 clk_get_fail:
@@ -295,6 +347,9 @@ int tegra_camera_unregister(struct tegra_camera *camera)
 
 	dev_info(camera->dev, "%s: ++\n", __func__);
 
+	if (tegra_camera_sensor_target == camera)
+		tegra_camera_sensor_target = NULL;
+
 	for (i = 0; i < CAMERA_CLK_MAX; i++)
 		clk_put(camera->clock[i].clk);
 
@@ -0,0 +1,339 @@
+/*
+ * drivers/video/tegra/camera/camera_bufq.c
+ *
+ * Copyright (C) 2013 Nvidia Corp
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/err.h>
+#include <linux/sched.h>
+#include <linux/nvhost.h>
+#include <linux/nvmap.h>
+
+#include "../nvmap/nvmap.h"
+#include "nvhost_syncpt.h"
+#include "host1x/host1x.h"
+
+#include "camera_bufq.h"
+
+static struct tegra_camera_bufq_slot *bufq_slot(struct tegra_camera *camera,
+						uint index)
+{
+	if (index >= TEGRA_CAMERA_BUFQ_SLOTS)
+		return NULL;
+
+	return &camera->bufq.slot[index];
+}
+
+static bool bufq_fence_valid(struct tegra_camera *camera, u32 id)
+{
+	struct platform_device *host =
+		to_platform_device(camera->dev->parent);
+
+	if (id == NVSYNCPT_INVALID)
+		return true;
+
+	return id < nvhost_syncpt_nb_pts(&nvhost_get_host(host)->syncpt);
+}
+
+static void bufq_unpin_slot(struct tegra_camera *camera,
+			    struct tegra_camera_bufq_slot *slot)
+{
+	struct tegra_camera_bufq *bufq = &camera->bufq;
+
+	if (!slot->ref)
+		return;
+
+	nvmap_unpin(bufq->nvmap, slot->ref);
+	nvmap_free(bufq->nvmap, slot->ref);
+	slot->ref = NULL;
+	slot->addr = 0;
+}
+
+int tegra_camera_bufq_open(struct tegra_camera *camera)
+{
+	struct tegra_camera_bufq *bufq = &camera->bufq;
+	int i;
+
+	memset(bufq, 0, sizeof(*bufq));
+	spin_lock_init(&bufq->lock);
+	init_waitqueue_head(&bufq->wq);
+	for (i = 0; i < TEGRA_CAMERA_BUFQ_MAX; i++)
+		INIT_LIST_HEAD(&bufq->queue[i]);
+	for (i = 0; i < TEGRA_CAMERA_BUFQ_SLOTS; i++)
+		INIT_LIST_HEAD(&bufq->slot[i].node);
+
+	bufq->nvmap = nvmap_create_client(nvmap_dev, "tegra_camera");
+	if (!bufq->nvmap) {
+		dev_err(camera->dev, "%s: can't create nvmap client\n",
+			__func__);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+void tegra_camera_bufq_release(struct tegra_camera *camera)
+{
+	struct tegra_camera_bufq *bufq = &camera->bufq;
+	int i;
+
+	/*
+	 * The engines may still be writing queued frames; wait for their
+	 * fences before dropping the pins.
+	 */
+	for (i = 0; i < TEGRA_CAMERA_BUFQ_SLOTS; i++) {
+		struct tegra_camera_bufq_slot *slot = &bufq->slot[i];
+
+		if (slot->ref && slot->syncpt_id != NVSYNCPT_INVALID)
+			nvhost_syncpt_wait_timeout_ext(
+				to_platform_device(camera->dev),
+				slot->syncpt_id, slot->syncpt_thresh,
+				msecs_to_jiffies(1000), NULL);
+		bufq_unpin_slot(camera, slot);
+	}
+
+	if (bufq->user_nvmap) {
+		nvmap_client_put(bufq->user_nvmap);
+		bufq->user_nvmap = NULL;
+	}
+	if (bufq->nvmap) {
+		nvmap_client_put(bufq->nvmap);
+		bufq->nvmap = NULL;
+	}
+}
+
+static int bufq_set_nvmap_fd(struct tegra_camera *camera, int fd)
+{
+	struct tegra_camera_bufq *bufq = &camera->bufq;
+	struct nvmap_client *nvmap = NULL;
+
+	if (fd >= 0) {
+		nvmap = nvmap_client_get_file(fd);
+		if (IS_ERR(nvmap))
+			return PTR_ERR(nvmap);
+	}
+
+	if (bufq->user_nvmap)
+		nvmap_client_put(bufq->user_nvmap);
+
+	bufq->user_nvmap = nvmap;
+
+	return 0;
+}
+
+static int bufq_register(struct tegra_camera *camera,
+			 struct tegra_camera_bufq_buffer *buf)
+{
+	struct tegra_camera_bufq *bufq = &camera->bufq;
+	struct tegra_camera_bufq_slot *slot = bufq_slot(camera, buf->index);
+	struct nvmap_handle_ref *ref;
+	struct nvmap_handle *handle;
+	phys_addr_t addr;
+	unsigned long flags;
+	bool queued;
+
+	if (!slot)
+		return -EINVAL;
+
+	/* a slot that is in flight between engines can't be replaced */
+	spin_lock_irqsave(&bufq->lock, flags);
+	queued = slot->queued;
+	spin_unlock_irqrestore(&bufq->lock, flags);
+	if (queued)
+		return -EBUSY;
+
+	bufq_unpin_slot(camera, slot);
+	buf->addr = 0;
+	if (!buf->handle)
+		return 0;
+
+	if (!bufq->user_nvmap)
+		return -EINVAL;
+
+	/*
+	 * Check the caller may access the buffer, then keep a reference and
+	 * the pin in our own client for as long as the slot is registered.
+	 */
+	handle = nvmap_get_handle_id(bufq->user_nvmap, buf->handle);
+	if (!handle)
+		return -EACCES;
+
+	ref = nvmap_duplicate_handle_id(bufq->nvmap, buf->handle);
+	nvmap_handle_put(handle);
+	if (IS_ERR(ref))
+		return PTR_ERR(ref);
+
+	addr = nvmap_pin(bufq->nvmap, ref);
+	if (IS_ERR((void *)addr)) {
+		nvmap_free(bufq->nvmap, ref);
+		return PTR_ERR((void *)addr);
+	}
+
+	slot->ref = ref;
+	slot->addr = addr;
+	slot->syncpt_id = NVSYNCPT_INVALID;
+	buf->addr = addr;
+
+	return 0;
+}
+
+static int bufq_queue(struct tegra_camera *camera,
+		      struct tegra_camera_bufq_fence *fence)
+{
+	struct tegra_camera_bufq *bufq = &camera->bufq;
+	struct tegra_camera_bufq_slot *slot = bufq_slot(camera, fence->index);
+	unsigned long flags;
+
+	if (!slot || fence->queue >= TEGRA_CAMERA_BUFQ_MAX ||
+	    !bufq_fence_valid(camera, fence->syncpt_id))
+		return -EINVAL;
+
+	spin_lock_irqsave(&bufq->lock, flags);
+	if (!slot->ref || slot->queued) {
+		spin_unlock_irqrestore(&bufq->lock, flags);
+		return -EINVAL;
+	}
+	slot->syncpt_id = fence->syncpt_id;
+	slot->syncpt_thresh = fence->syncpt_thresh;
+	slot->queued = true;
+	list_add_tail(&slot->node, &bufq->queue[fence->queue]);
+	spin_unlock_irqrestore(&bufq->lock, flags);
+
+	wake_up_all(&bufq->wq);
+
+	return 0;
+}
+
+static struct tegra_camera_bufq_slot *bufq_take(struct tegra_camera_bufq *bufq,
+						uint queue)
+{
+	struct tegra_camera_bufq_slot *slot = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&bufq->lock, flags);
+	if (!list_empty(&bufq->queue[queue])) {
+		slot = list_first_entry(&bufq->queue[queue],
+					struct tegra_camera_bufq_slot, node);
+		list_del_init(&slot->node);
+		slot->queued = false;
+	}
+	spin_unlock_irqrestore(&bufq->lock, flags);
+
+	return slot;
+}
+
+static int bufq_dequeue(struct tegra_camera *camera,
+			struct tegra_camera_bufq_fence *fence)
+{
+	struct tegra_camera_bufq *bufq = &camera->bufq;
+	struct tegra_camera_bufq_slot *slot = NULL;
+	long timeout = fence->timeout_ms ?
+		msecs_to_jiffies(fence->timeout_ms) : MAX_SCHEDULE_TIMEOUT;
+	long ret;
+	int err;
+
+	if (fence->queue >= TEGRA_CAMERA_BUFQ_MAX)
+		return -EINVAL;
+
+	ret = wait_event_interruptible_timeout(bufq->wq,
+			(slot = bufq_take(bufq, fence->queue)) != NULL,
+			timeout);
+	if (ret < 0)
+		return ret;
+	if (!slot)
+		return -EAGAIN;
+
+	fence->index = slot - bufq->slot;
+	fence->syncpt_id = slot->syncpt_id;
+	fence->syncpt_thresh = slot->syncpt_thresh;
+
+	if (slot->syncpt_id == NVSYNCPT_INVALID)
+		return 0;
+
+	/* the frame is ours; block until the producer has finished it */
+	err = nvhost_syncpt_wait_timeout_ext(to_platform_device(camera->dev),
+			slot->syncpt_id, slot->syncpt_thresh,
+			fence->timeout_ms ? msecs_to_jiffies(fence->timeout_ms) :
+			MAX_SCHEDULE_TIMEOUT, NULL);
+	if (err) {
+		/* hand it back so the frame isn't lost */
+		unsigned long flags;
+
+		spin_lock_irqsave(&bufq->lock, flags);
+		slot->queued = true;
+		list_add(&slot->node, &bufq->queue[fence->queue]);
+		spin_unlock_irqrestore(&bufq->lock, flags);
+		return err;
+	}
+
+	return 0;
+}
+
+long tegra_camera_bufq_ioctl(struct tegra_camera *camera,
+			     unsigned int cmd, unsigned long arg)
+{
+	void __user *uarg = (void __user *)arg;
+	int ret;
+
+	switch (cmd) {
+	case TEGRA_CAMERA_IOCTL_SET_NVMAP_FD:
+	{
+		struct tegra_camera_nvmap_fd args;
+
+		if (copy_from_user(&args, uarg, sizeof(args)))
+			return -EFAULT;
+		mutex_lock(&camera->tegra_camera_lock);
+		ret = bufq_set_nvmap_fd(camera, args.fd);
+		mutex_unlock(&camera->tegra_camera_lock);
+		return ret;
+	}
+	case TEGRA_CAMERA_IOCTL_BUFQ_REGISTER:
+	{
+		struct tegra_camera_bufq_buffer args;
+
+		if (copy_from_user(&args, uarg, sizeof(args)))
+			return -EFAULT;
+		mutex_lock(&camera->tegra_camera_lock);
+		ret = bufq_register(camera, &args);
+		mutex_unlock(&camera->tegra_camera_lock);
+		if (ret)
+			return ret;
+		if (copy_to_user(uarg, &args, sizeof(args)))
+			return -EFAULT;
+		return 0;
+	}
+	case TEGRA_CAMERA_IOCTL_BUFQ_QUEUE:
+	{
+		struct tegra_camera_bufq_fence args;
+
+		if (copy_from_user(&args, uarg, sizeof(args)))
+			return -EFAULT;
+		return bufq_queue(camera, &args);
+	}
+	case TEGRA_CAMERA_IOCTL_BUFQ_DEQUEUE:
+	{
+		struct tegra_camera_bufq_fence args;
+
+		if (copy_from_user(&args, uarg, sizeof(args)))
+			return -EFAULT;
+		ret = bufq_dequeue(camera, &args);
+		if (ret)
+			return ret;
+		if (copy_to_user(uarg, &args, sizeof(args)))
+			return -EFAULT;
+		return 0;
+	}
+	}
+
+	return -ENOTTY;
+}
@@ -0,0 +1,26 @@
+/*
+ * drivers/video/tegra/camera/camera_bufq.h
+ *
+ * Copyright (C) 2013 Nvidia Corp
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __DRIVERS_VIDEO_TEGRA_CAMERA_CAMERA_BUFQ_H
+#define __DRIVERS_VIDEO_TEGRA_CAMERA_CAMERA_BUFQ_H
+#include "camera_priv_defs.h"
+
+int tegra_camera_bufq_open(struct tegra_camera *camera);
+void tegra_camera_bufq_release(struct tegra_camera *camera);
+long tegra_camera_bufq_ioctl(struct tegra_camera *camera,
+			     unsigned int cmd, unsigned long arg);
+
+#endif
@@ -15,6 +15,7 @@
  */
 
 #include "camera_clk.h"
+#include "camera_emc.h"
 
 int tegra_camera_enable_clk(struct tegra_camera *camera)
 {
@@ -102,36 +103,17 @@ int tegra_camera_clk_set_rate(struct tegra_camera *camera)
 			 * Emc bandwidth needs to be calcaluated using input emc
 			 * freq first, and then real emc freq will
 			 * be calculated using tegra_emc API.
-			 * tegra_emc_bw_to_freq_req takes HW difference
-			 * into consideration.
-			 * bw param in tegra_emc_bw_to_freq_req() is in KHz.
+			 * The request is combined with the sensor mode
+			 * bandwidth in tegra_camera_emc_update().
 			 */
-			unsigned long bw = (info->rate * 8) >> 10;
-#ifdef CONFIG_ARCH_TEGRA_11x_SOC
-			int ret = 0;
-#endif
+			int ret;
+
 			dev_dbg(camera->dev, "%s: emc_clk rate=%lu\n",
 				__func__, info->rate);
-			clk_set_rate(clk,
-					tegra_emc_bw_to_freq_req(bw) << 10);
-#ifdef CONFIG_ARCH_TEGRA_11x_SOC
-			/*
-			 * There is no way to figure out what latency
-			 * can be tolerated in VI without reading VI
-			 * registers for now. 3 usec is minimum time
-			 * to switch PLL source. Let's put 4 usec as
-			 * latency for now.
-			 */
-			ret = tegra_isomgr_reserve(camera->isomgr_handle,
-					bw,	/* KB/sec */
-					4);	/* usec */
-			if (!ret)
-				return -ENOMEM;
-
-			ret = tegra_isomgr_realize(camera->isomgr_handle);
-			if (!ret)
-				return -ENOMEM;
-#endif
+			camera->emc_user_bw = (info->rate * 8) >> 10;
+			ret = tegra_camera_emc_update(camera);
+			if (ret)
+				return ret;
 		}
 #endif
 		goto set_rate_end;
@@ -14,8 +14,68 @@
  *
  */
 
+#include <linux/math64.h>
+
 #include "camera_emc.h"
 
+/*
+ * DRAM traffic per sensor pixel, in half bytes: VI writes the bayer
+ * frame at 2 Bpp, ISP reads it back at 2 Bpp and writes YUV420 at 1.5 Bpp.
+ */
+#define CAMERA_EMC_HALF_BYTES_PER_PIXEL	11
+
+unsigned long tegra_camera_emc_mode_bw(u32 res_x, u32 res_y, u32 frame_rate)
+{
+	u64 bw;
+
+	/* frame_rate is fps * 1000; result is KB/sec */
+	bw = (u64)res_x * res_y * frame_rate * CAMERA_EMC_HALF_BYTES_PER_PIXEL;
+	return (unsigned long)div_u64(bw, 2 * 1000 * 1000);
+}
+
+/*
+ * Apply the larger of the user space EMC request and the bandwidth of
+ * the active sensor mode. Called with tegra_camera_lock held.
+ */
+int tegra_camera_emc_update(struct tegra_camera *camera)
+{
+#ifndef CONFIG_ARCH_TEGRA_2x_SOC
+	unsigned long bw = max(camera->emc_user_bw, camera->emc_sensor_bw);
+#ifdef CONFIG_ARCH_TEGRA_11x_SOC
+	int ret;
+#endif
+
+	if (!camera->power_on)
+		return 0;
+
+	dev_dbg(camera->dev, "%s: user %lu sensor %lu KB/s\n", __func__,
+		camera->emc_user_bw, camera->emc_sensor_bw);
+	/* bw param in tegra_emc_bw_to_freq_req() is in KHz */
+	clk_set_rate(camera->clock[CAMERA_EMC_CLK].clk,
+			tegra_emc_bw_to_freq_req(bw) << 10);
+#ifdef CONFIG_ARCH_TEGRA_11x_SOC
+	/*
+	 * There is no way to figure out what latency
+	 * can be tolerated in VI without reading VI
+	 * registers for now. 3 usec is minimum time
+	 * to switch PLL source. Let's put 4 usec as
+	 * latency for now. If bandwidth is zero, the
+	 * latency is ignored by tegra_isomgr_reserve().
+	 */
+	ret = tegra_isomgr_reserve(camera->isomgr_handle,
+			bw,			/* KB/sec */
+			bw ? 4 : 0);		/* usec */
+	if (!ret)
+		return -ENOMEM;
+
+	ret = tegra_isomgr_realize(camera->isomgr_handle);
+	if (!ret)
+		return -ENOMEM;
+#endif
+#endif
+	return 0;
+}
+
 int tegra_camera_enable_emc(struct tegra_camera *camera)
 {
 	int ret = tegra_emc_disable_eack();
@@ -24,6 +84,13 @@ int tegra_camera_enable_emc(struct tegra_camera *camera)
 	clk_prepare_enable(camera->clock[CAMERA_EMC_CLK].clk);
 #ifdef CONFIG_ARCH_TEGRA_2x_SOC
 	clk_set_rate(camera->clock[TEGRA_CAMERA_EMC_CLK].clk, 300000000);
+#else
+	/*
+	 * Start from the sensor mode floor instead of whatever the
+	 * previous session left on the EMC clock.
+	 */
+	camera->emc_user_bw = 0;
+	tegra_camera_emc_update(camera);
 #endif
 	return ret;
 }
@@ -32,5 +99,10 @@ int tegra_camera_disable_emc(struct tegra_camera *camera)
 {
 	dev_dbg(camera->dev, "%s++\n", __func__);
 	clk_disable_unprepare(camera->clock[CAMERA_EMC_CLK].clk);
+#ifdef CONFIG_ARCH_TEGRA_11x_SOC
+	/* don't keep ISO bandwidth reserved while the camera is closed */
+	tegra_isomgr_reserve(camera->isomgr_handle, 0, 0);
+	tegra_isomgr_realize(camera->isomgr_handle);
+#endif
 	return tegra_emc_enable_eack();
 }
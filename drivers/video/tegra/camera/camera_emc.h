@@ -18,6 +18,8 @@
 #define __DRIVERS_VIDEO_TEGRA_CAMERA_CAMERA_EMC_H
 #include "camera_priv_defs.h"
 
+unsigned long tegra_camera_emc_mode_bw(u32 res_x, u32 res_y, u32 frame_rate);
+int tegra_camera_emc_update(struct tegra_camera *camera);
 int tegra_camera_enable_emc(struct tegra_camera *camera);
 int tegra_camera_disable_emc(struct tegra_camera *camera);
 
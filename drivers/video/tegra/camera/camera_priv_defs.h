@@ -29,6 +29,7 @@
 #include <linux/delay.h>
 #include <linux/export.h>
 #include <linux/slab.h>
+#include <linux/wait.h>
 
 #include <mach/powergate.h>
 #include <mach/clk.h>
@@ -67,6 +68,27 @@ struct clock {
 	bool on;
 };
 
+struct nvmap_client;
+struct nvmap_handle_ref;
+
+struct tegra_camera_bufq_slot {
+	struct list_head node;		/* on one of bufq->queue[] when queued */
+	struct nvmap_handle_ref *ref;	/* NULL if the slot is unused */
+	u32 addr;			/* pinned device address */
+	u32 syncpt_id;			/* fence of the last producer */
+	u32 syncpt_thresh;
+	bool queued;
+};
+
+struct tegra_camera_bufq {
+	struct nvmap_client *nvmap;	/* holds the pinned buffers */
+	struct nvmap_client *user_nvmap;	/* for permission checks */
+	struct tegra_camera_bufq_slot slot[TEGRA_CAMERA_BUFQ_SLOTS];
+	struct list_head queue[TEGRA_CAMERA_BUFQ_MAX];
+	spinlock_t lock;		/* protects slot state and queues */
+	wait_queue_head_t wq;
+};
+
 struct tegra_camera {
 	struct device *dev;
 	struct miscdevice misc_dev;
@@ -76,6 +98,9 @@ struct tegra_camera {
 	struct mutex tegra_camera_lock;
 	atomic_t in_use;
 	int power_on;
+	unsigned long emc_user_bw;	/* KB/sec, from CLK_SET_RATE */
+	unsigned long emc_sensor_bw;	/* KB/sec, from the sensor mode */
+	struct tegra_camera_bufq bufq;
 #ifdef CONFIG_ARCH_TEGRA_11x_SOC
 	tegra_isomgr_handle isomgr_handle;
 #endif
@@ -34,19 +34,21 @@ static int use_dynamic_emc = 1;
 
 module_param_named(use_dynamic_emc, use_dynamic_emc, int, S_IRUGO | S_IWUSR);
 
-/* uses the larger of w->bandwidth or w->new_bandwidth */
+/* windows A, B, C for first and second display */
+static const enum tegra_la_id la_id_tab[2][3] = {
+	/* first display */
+	{ TEGRA_LA_DISPLAY_0A, TEGRA_LA_DISPLAY_0B,
+		TEGRA_LA_DISPLAY_0C },
+	/* second display */
+	{ TEGRA_LA_DISPLAY_0AB, TEGRA_LA_DISPLAY_0BB,
+		TEGRA_LA_DISPLAY_0CB },
+};
+
+/* uses the larger of w->bandwidth or w->new_bandwidth. the latency allowance
+ * is only reprogrammed when the request changes. */
 static void tegra_dc_set_latency_allowance(struct tegra_dc *dc,
 	struct tegra_dc_win *w)
 {
-	/* windows A, B, C for first and second display */
-	static const enum tegra_la_id la_id_tab[2][3] = {
-		/* first display */
-		{ TEGRA_LA_DISPLAY_0A, TEGRA_LA_DISPLAY_0B,
-			TEGRA_LA_DISPLAY_0C },
-		/* second display */
-		{ TEGRA_LA_DISPLAY_0AB, TEGRA_LA_DISPLAY_0BB,
-			TEGRA_LA_DISPLAY_0CB },
-	};
 #if defined(CONFIG_ARCH_TEGRA_2x_SOC) || defined(CONFIG_ARCH_TEGRA_3x_SOC)
 	/* window B V-filter tap for first and second display. */
 	static const enum tegra_la_id vfilter_tab[2] = {
@@ -74,6 +76,10 @@ static void tegra_dc_set_latency_allowance(struct tegra_dc *dc,
 	 * round up bandwidth to next 1MBps */
 	bw = bw / 1000 + 1;
 
+	if (dc->win_bw[w->idx].la_bw == bw)
+		return;
+	dc->win_bw[w->idx].la_bw = bw;
+
 #ifdef CONFIG_TEGRA_SILICON_PLATFORM
 	tegra_set_latency_allowance(la_id_tab[dc->ndev->id][w->idx], bw);
 #if defined(CONFIG_ARCH_TEGRA_2x_SOC) || defined(CONFIG_ARCH_TEGRA_3x_SOC)
@@ -84,6 +90,17 @@ static void tegra_dc_set_latency_allowance(struct tegra_dc *dc,
 #endif
 }
 
+/* feed a window underflow back to the latency allowance, which may tighten
+ * the window's LA in closed-loop mode. safe from the irq handler. */
+void tegra_dc_la_underflow(struct tegra_dc *dc, unsigned idx)
+{
+	if (dc->ndev->id >= ARRAY_SIZE(la_id_tab) ||
+	    idx >= ARRAY_SIZE(*la_id_tab))
+		return;
+
+	tegra_latency_allowance_underflow(la_id_tab[dc->ndev->id][idx]);
+}
+
 static unsigned int tegra_dc_windows_is_overlapped(struct tegra_dc_win *a,
 						   struct tegra_dc_win *b)
 {
@@ -208,6 +225,46 @@ static unsigned long tegra_dc_calc_win_bandwidth(struct tegra_dc *dc,
 	return ret;
 }
 
+/*
+ * Window bandwidth only depends on the window geometry, format and flags
+ * and on the pixel clock. Reuse the last result while none of those changed.
+ */
+static unsigned long tegra_dc_get_win_bandwidth(struct tegra_dc *dc,
+	struct tegra_dc_win *w)
+{
+	struct tegra_dc_win_bw *c = &dc->win_bw[w->idx];
+
+	if (c->valid && c->flags == w->flags && c->fmt == w->fmt &&
+	    c->w.full == w->w.full && c->h.full == w->h.full &&
+	    c->out_w == w->out_w && c->out_h == w->out_h &&
+	    c->pclk == dc->mode.pclk)
+		return c->bw;
+
+	c->flags = w->flags;
+	c->fmt = w->fmt;
+	c->w = w->w;
+	c->h = w->h;
+	c->out_w = w->out_w;
+	c->out_h = w->out_h;
+	c->pclk = dc->mode.pclk;
+	c->bw = tegra_dc_calc_win_bandwidth(dc, w);
+	c->valid = true;
+
+	return c->bw;
+}
+
+/* forget cached bandwidth and latency allowance, e.g. after a reset */
+void tegra_dc_invalidate_bandwidth(struct tegra_dc *dc)
+{
+	int i;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		dc->win_bw[i].valid = false;
+		dc->win_bw[i].la_bw = 0;
+	}
+	dc->emc_clk_req = 0;
+}
+
 static unsigned long tegra_dc_get_bandwidth(
 	struct tegra_dc_win *windows[], int n)
 {
@@ -222,7 +279,7 @@ static unsigned long tegra_dc_get_bandwidth(
 
 		if (w)
 			w->new_bandwidth =
-				tegra_dc_calc_win_bandwidth(w->dc, w);
+				tegra_dc_get_win_bandwidth(w->dc, w);
 	}
 
 	return tegra_dc_find_max_bandwidth(windows, n);
@@ -235,6 +292,7 @@ void tegra_dc_clear_bandwidth(struct tegra_dc *dc)
 	if (tegra_is_clk_enabled(dc->emc_clk))
 		clk_disable_unprepare(dc->emc_clk);
 	dc->emc_clk_rate = 0;
+	dc->emc_clk_req = 0;
 }
 
 /* use the larger of dc->emc_clk_rate or dc->new_emc_clk_rate, and copies
@@ -242,18 +300,24 @@ void tegra_dc_clear_bandwidth(struct tegra_dc *dc)
  * calling this function both before and after a flip is sufficient to select
  * the best possible frequency and latency allowance.
  * set use_new to true to force dc->new_emc_clk_rate programming.
+ * the emc clock is only touched when the requested rate changes.
  */
 void tegra_dc_program_bandwidth(struct tegra_dc *dc, bool use_new)
 {
 	unsigned i;
 
 	if (use_new || dc->emc_clk_rate != dc->new_emc_clk_rate) {
+		unsigned long rate = max(dc->emc_clk_rate,
+					 dc->new_emc_clk_rate);
+
 		/* going from 0 to non-zero */
 		if (!dc->emc_clk_rate && !tegra_is_clk_enabled(dc->emc_clk))
 			clk_prepare_enable(dc->emc_clk);
 
-		clk_set_rate(dc->emc_clk,
-			max(dc->emc_clk_rate, dc->new_emc_clk_rate));
+		if (rate != dc->emc_clk_req) {
+			clk_set_rate(dc->emc_clk, rate);
+			dc->emc_clk_req = rate;
+		}
 		dc->emc_clk_rate = dc->new_emc_clk_rate;
 
 		/* going from non-zero to 0 */
@@ -759,11 +759,15 @@ static int dbg_dc_stats_show(struct seq_file *s, void *unused)
 		"underflows: %llu\n"
 		"underflows_a: %llu\n"
 		"underflows_b: %llu\n"
-		"underflows_c: %llu\n",
+		"underflows_c: %llu\n"
+		"flips: %llu\n"
+		"missed_vblanks: %llu\n",
 		dc->stats.underflows,
 		dc->stats.underflows_a,
 		dc->stats.underflows_b,
-		dc->stats.underflows_c);
+		dc->stats.underflows_c,
+		dc->stats.flips,
+		dc->stats.missed_vblanks);
 	mutex_unlock(&dc->lock);
 
 	return 0;
@@ -1127,6 +1131,79 @@ u32 tegra_dc_incr_syncpt_max(struct tegra_dc *dc, int i)
 	return max;
 }
 
+/* called from the interrupt thread with dc->lock held */
+void tegra_dc_record_latch(struct tegra_dc *dc)
+{
+	dc->latch_ts = dc->irq_ts;
+	dc->latch_frame = nvhost_syncpt_read_ext(dc->ndev, dc->vblank_syncpt);
+}
+
+/* current value of the head's vblank syncpoint */
+u32 tegra_dc_get_frame(struct tegra_dc *dc)
+{
+	return nvhost_syncpt_read_ext(dc->ndev, dc->vblank_syncpt);
+}
+
+/*
+ * Account a flip that has just been latched. submitted is when the client
+ * queued it and programmed_frame the vblank syncpoint value when its
+ * windows were written; a flip is expected to latch on the vblank after
+ * that, any later one counts as missed.
+ */
+void tegra_dc_record_flip(struct tegra_dc *dc, ktime_t submitted,
+			  u32 programmed_frame)
+{
+	s64 latency_us;
+	u32 missed = 0;
+	int bucket;
+
+	mutex_lock(&dc->lock);
+	latency_us = ktime_to_us(ktime_sub(dc->latch_ts, submitted));
+	if (latency_us < 0)
+		latency_us = 0;
+	if ((s32)(dc->latch_frame - programmed_frame) > 1)
+		missed = dc->latch_frame - programmed_frame - 1;
+
+	bucket = fls64(div_u64(latency_us, 1000));
+	if (bucket >= TEGRA_DC_FLIP_LAT_BUCKETS)
+		bucket = TEGRA_DC_FLIP_LAT_BUCKETS - 1;
+
+	dc->stats.flips++;
+	dc->stats.missed_vblanks += missed;
+	dc->stats.flip_latency[bucket]++;
+	mutex_unlock(&dc->lock);
+
+	trace_display_flip_latency(dc, latency_us, missed);
+}
+
+/*
+ * Report the vblank that latched the most recent window update: the value
+ * of the head's vblank syncpoint and the CLOCK_MONOTONIC time its interrupt
+ * was raised.
+ */
+void tegra_dc_get_latch(struct tegra_dc *dc, u32 *frame, s64 *timestamp_ns)
+{
+	mutex_lock(&dc->lock);
+	*frame = dc->latch_frame;
+	*timestamp_ns = ktime_to_ns(dc->latch_ts);
+	mutex_unlock(&dc->lock);
+}
+EXPORT_SYMBOL(tegra_dc_get_latch);
+
+/*
+ * Block until the head's vblank syncpoint reaches frame. Returns 0 right
+ * away for one-shot outputs, which only scan out on demand.
+ */
+int tegra_dc_wait_for_frame(struct tegra_dc *dc, u32 frame)
+{
+	if (!dc->enabled || (dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE))
+		return 0;
+
+	return nvhost_syncpt_wait_timeout_ext(dc->ndev, dc->vblank_syncpt,
+			frame, msecs_to_jiffies(1000), NULL);
+}
+EXPORT_SYMBOL(tegra_dc_wait_for_frame);
+
 void tegra_dc_incr_syncpt_min(struct tegra_dc *dc, int i, u32 val)
 {
 	mutex_lock(&dc->lock);
@@ -1548,6 +1625,22 @@ static u64 tegra_dc_underflow_count(struct tegra_dc *dc, unsigned reg)
 	return ((count & 0x80000000) == 0) ? count : 10000000000ll;
 }
 
+/* snapshot the memory state as close to the underflow as we can */
+static void tegra_dc_record_underflow(struct tegra_dc *dc, u32 mask)
+{
+	struct tegra_dc_underflow_cause *c = &dc->stats.last_underflow;
+	int i;
+
+	c->timestamp_ns = ktime_to_ns(dc->irq_ts);
+	c->mask = mask;
+	c->emc_rate = clk_get_rate(clk_get_parent(dc->emc_clk));
+	c->emc_req = dc->emc_clk_req;
+	for (i = 0; i < DC_N_WINDOWS; i++)
+		c->la_bw[i] = dc->win_bw[i].la_bw;
+
+	trace_display_underflow_cause(dc, c);
+}
+
 static void tegra_dc_underflow_handler(struct tegra_dc *dc)
 {
 	int i;
@@ -1567,6 +1660,7 @@ static void tegra_dc_underflow_handler(struct tegra_dc *dc)
 	for (i = 0; i < DC_N_WINDOWS; i++) {
 		if (dc->underflow_mask & (WIN_A_UF_INT << i)) {
 			dc->windows[i].underflows++;
+			tegra_dc_la_underflow(dc, i);
 
 #ifdef CONFIG_ARCH_TEGRA_2x_SOC
 			if (dc->windows[i].underflows > 4) {
@@ -1722,6 +1816,16 @@ bool tegra_dc_does_vsync_separate(struct tegra_dc *dc, s64 new_ts, s64 old_ts)
 }
 #endif
 
+/* timestamp the interrupt before the thread gets to run */
+static irqreturn_t tegra_dc_irq_timestamp(int irq, void *ptr)
+{
+	struct tegra_dc *dc = ptr;
+
+	dc->irq_ts = ktime_get();
+
+	return IRQ_WAKE_THREAD;
+}
+
 static irqreturn_t tegra_dc_irq(int irq, void *ptr)
 {
 #ifndef CONFIG_TEGRA_FPGA_PLATFORM
@@ -1768,6 +1872,7 @@ static irqreturn_t tegra_dc_irq(int irq, void *ptr)
 
 	/* Check underflow */
 	if (underflow_mask) {
+		tegra_dc_record_underflow(dc, underflow_mask);
 		dc->underflow_mask |= underflow_mask;
 		schedule_delayed_work(&dc->underflow_work,
 			msecs_to_jiffies(1));
@@ -2200,6 +2305,8 @@ static void _tegra_dc_controller_disable(struct tegra_dc *dc)
 	disable_irq_nosync(dc->irq);
 
 	tegra_dc_clear_bandwidth(dc);
+	tegra_dc_invalidate_bandwidth(dc);
+	dc->partial_win = -1;
 
 	if (dc->out && dc->out->disable)
 		dc->out->disable();
@@ -2578,6 +2685,7 @@ static int tegra_dc_probe(struct platform_device *ndev)
 	/* Initialize one shot work delay, it will be assigned by dsi
 	 * according to refresh rate later. */
 	dc->one_shot_delay_ms = 40;
+	dc->partial_win = -1;
 
 	dc->base_res = base_res;
 	dc->base = base;
@@ -2654,8 +2762,8 @@ static int tegra_dc_probe(struct platform_device *ndev)
 	}
 
 	/* interrupt handler must be registered before tegra_fb_register() */
-	if (request_threaded_irq(irq, NULL, tegra_dc_irq, IRQF_ONESHOT,
-			dev_name(&ndev->dev), dc)) {
+	if (request_threaded_irq(irq, tegra_dc_irq_timestamp, tegra_dc_irq,
+			IRQF_ONESHOT, dev_name(&ndev->dev), dc)) {
 		dev_err(&ndev->dev, "request_irq %d failed\n", irq);
 		ret = -EBUSY;
 		goto err_disable_dc;
@@ -262,7 +262,9 @@ void tegra_dc_release_dc_out(struct tegra_dc *dc);
 /* defined in bandwidth.c, used in dc.c */
 void tegra_dc_clear_bandwidth(struct tegra_dc *dc);
 void tegra_dc_program_bandwidth(struct tegra_dc *dc, bool use_new);
+void tegra_dc_invalidate_bandwidth(struct tegra_dc *dc);
 int tegra_dc_set_dynamic_emc(struct tegra_dc_win *windows[], int n);
+void tegra_dc_la_underflow(struct tegra_dc *dc, unsigned idx);
 
 /* defined in mode.c, used in dc.c and window.c */
 int tegra_dc_program_mode(struct tegra_dc *dc, struct tegra_dc_mode *mode);
@@ -284,6 +286,10 @@ void tegra_dc_set_csc(struct tegra_dc *dc, struct tegra_dc_csc *csc);
 
 /* defined in window.c, used in dc.c */
 void tegra_dc_trigger_windows(struct tegra_dc *dc);
+void tegra_dc_record_latch(struct tegra_dc *dc);
+u32 tegra_dc_get_frame(struct tegra_dc *dc);
+void tegra_dc_record_flip(struct tegra_dc *dc, ktime_t submitted,
+			  u32 programmed_frame);
 
 void tegra_dc_set_color_control(struct tegra_dc *dc);
 #ifdef CONFIG_TEGRA_DC_CMU
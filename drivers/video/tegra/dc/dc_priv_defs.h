@@ -88,6 +88,36 @@ struct tegra_dc_out_ops {
 			struct fb_videomode *mode);
 	/* setup pixel clock and parent clock programming */
 	long (*setup_clk)(struct tegra_dc *dc, struct clk *clk);
+	/* limit the next one-shot transfer to rows *y .. *y + *h - 1. may
+	 * grow the region to suit the panel. returns < 0 if unsupported. */
+	int (*partial_update)(struct tegra_dc *dc, unsigned *y, unsigned *h);
+};
+
+/* flip latency histogram buckets: < 1, 2, 4 .. 64 ms, then the rest */
+#define TEGRA_DC_FLIP_LAT_BUCKETS	8
+
+/* memory state in effect when an underflow was raised */
+struct tegra_dc_underflow_cause {
+	s64				timestamp_ns;
+	u32				mask;		/* *_UF_INT */
+	unsigned long			emc_rate;	/* Hz */
+	unsigned long			emc_req;	/* dc request, Hz */
+	unsigned long			la_bw[DC_N_WINDOWS];	/* MBps */
+};
+
+/* inputs and results of the last bandwidth computation for a window */
+struct tegra_dc_win_bw {
+	bool				valid;
+	u32				flags;
+	u8				fmt;
+	fixed20_12			w;
+	fixed20_12			h;
+	unsigned			out_w;
+	unsigned			out_h;
+	unsigned long			pclk;
+	unsigned long			bw;	/* kBps */
+
+	unsigned long			la_bw;	/* last LA request, MBps */
 };
 
 struct tegra_dc_shift_clk_div {
@@ -107,6 +137,11 @@ struct tegra_dc {
 	struct clk			*emc_clk;
 	int				emc_clk_rate;
 	int				new_emc_clk_rate;
+	unsigned long			emc_clk_req;	/* last clk_set_rate */
+
+	/* window scanned out as a band of rows in one-shot mode, or -1 */
+	int				partial_win;
+	struct tegra_dc_win_bw		win_bw[DC_N_WINDOWS];
 	struct tegra_dc_shift_clk_div	shift_clk_div;
 
 	u32				powergate_id;
@@ -165,6 +200,11 @@ struct tegra_dc {
 		u64			underflows_a;
 		u64			underflows_b;
 		u64			underflows_c;
+
+		u64			flips;
+		u64			missed_vblanks;
+		u64			flip_latency[TEGRA_DC_FLIP_LAT_BUCKETS];
+		struct tegra_dc_underflow_cause	last_underflow;
 	} stats;
 
 	struct tegra_dc_ext		*ext;
@@ -181,7 +221,16 @@ struct tegra_dc {
 	struct delayed_work		one_shot_work;
 	s64				frame_end_timestamp;
 
+	/* raised time of the interrupt being handled, and the vblank that
+	 * last latched a window update (vblank syncpoint value and time) */
+	ktime_t				irq_ts;
+	ktime_t				latch_ts;
+	u32				latch_frame;
+
 	bool				mode_dirty;
+	/* v_front_porch of the mode that was set, before any stretching by
+	 * tegra_dc_set_content_rate() */
+	int				base_v_front_porch;
 };
 
 #endif
@@ -102,6 +102,60 @@ static ssize_t stats_enable_store(struct device *dev,
 static DEVICE_ATTR(stats_enable, S_IRUGO|S_IWUSR,
 	stats_enable_show, stats_enable_store);
 
+static ssize_t underflows_show(struct device *device,
+	struct device_attribute *attr, char *buf)
+{
+	struct platform_device *ndev = to_platform_device(device);
+	struct tegra_dc *dc = platform_get_drvdata(ndev);
+	struct tegra_dc_underflow_cause *c = &dc->stats.last_underflow;
+	ssize_t res;
+
+	mutex_lock(&dc->lock);
+	res = snprintf(buf, PAGE_SIZE,
+		"events: %llu\n"
+		"win_a: %llu\n"
+		"win_b: %llu\n"
+		"win_c: %llu\n"
+		"last_timestamp_ns: %lld\n"
+		"last_mask: %#x\n"
+		"last_emc_rate: %lu\n"
+		"last_emc_req: %lu\n"
+		"last_la_bw: %lu %lu %lu\n",
+		dc->stats.underflows, dc->stats.underflows_a,
+		dc->stats.underflows_b, dc->stats.underflows_c,
+		c->timestamp_ns, c->mask, c->emc_rate, c->emc_req,
+		c->la_bw[0], c->la_bw[1], c->la_bw[2]);
+	mutex_unlock(&dc->lock);
+
+	return res;
+}
+
+static DEVICE_ATTR(underflows, S_IRUGO, underflows_show, NULL);
+
+static ssize_t flip_latency_show(struct device *device,
+	struct device_attribute *attr, char *buf)
+{
+	struct platform_device *ndev = to_platform_device(device);
+	struct tegra_dc *dc = platform_get_drvdata(ndev);
+	ssize_t res;
+	int i;
+
+	mutex_lock(&dc->lock);
+	res = snprintf(buf, PAGE_SIZE, "flips: %llu\nmissed_vblanks: %llu\n",
+		dc->stats.flips, dc->stats.missed_vblanks);
+	/* bucket i counts flips latched within 2^i ms of submission */
+	for (i = 0; i < TEGRA_DC_FLIP_LAT_BUCKETS - 1; i++)
+		res += snprintf(buf + res, PAGE_SIZE - res, "<%ums: %llu\n",
+			1 << i, dc->stats.flip_latency[i]);
+	res += snprintf(buf + res, PAGE_SIZE - res, ">=%ums: %llu\n",
+		1 << (i - 1), dc->stats.flip_latency[i]);
+	mutex_unlock(&dc->lock);
+
+	return res;
+}
+
+static DEVICE_ATTR(flip_latency, S_IRUGO, flip_latency_show, NULL);
+
 static ssize_t enable_show(struct device *device,
 	struct device_attribute *attr, char *buf)
 {
@@ -456,6 +510,8 @@ void __devexit tegra_dc_remove_sysfs(struct device *dev)
 	device_remove_file(dev, &dev_attr_nvdps);
 	device_remove_file(dev, &dev_attr_enable);
 	device_remove_file(dev, &dev_attr_stats_enable);
+	device_remove_file(dev, &dev_attr_underflows);
+	device_remove_file(dev, &dev_attr_flip_latency);
 	device_remove_file(dev, &dev_attr_crc_checksum_latched);
 	device_remove_file(dev, &dev_attr_colorbar);
 #ifdef CONFIG_TEGRA_DC_CMU
@@ -485,6 +541,8 @@ void tegra_dc_create_sysfs(struct device *dev)
 	error |= device_create_file(dev, &dev_attr_nvdps);
 	error |= device_create_file(dev, &dev_attr_enable);
 	error |= device_create_file(dev, &dev_attr_stats_enable);
+	error |= device_create_file(dev, &dev_attr_underflows);
+	error |= device_create_file(dev, &dev_attr_flip_latency);
 	error |= device_create_file(dev, &dev_attr_crc_checksum_latched);
 	error |= device_create_file(dev, &dev_attr_colorbar);
 #ifdef CONFIG_TEGRA_DC_CMU
@@ -4141,6 +4141,9 @@ fail:
 
 static void tegra_dc_dsi_disable(struct tegra_dc *dc)
 {
+	struct tegra_dc_dsi_data *dsi = tegra_dc_get_outdata(dc);
+
+	dsi->partial_h = 0;
 	_tegra_dc_dsi_disable(dc);
 
 	if (dc->out->dsi->ganged_type) {
@@ -4357,6 +4360,51 @@ skip_setup:
 	return tegra_dc_pclk_round_rate(dc, dc->mode.pclk);
 }
 
+/*
+ * Limit the panel's page address window to the rows the next one-shot frame
+ * will carry. The band is grown to the panel's alignment; a full frame
+ * restores the whole window.
+ */
+static int tegra_dc_dsi_partial_update(struct tegra_dc *dc,
+	unsigned *y, unsigned *h)
+{
+	struct tegra_dc_dsi_data *dsi = tegra_dc_get_outdata(dc);
+	unsigned v_active = dc->mode.v_active;
+	unsigned align = max_t(unsigned, dsi->info.partial_update_align, 16);
+	unsigned y0, y1;
+	u8 data[5];
+	int err;
+
+	if (!dsi->info.partial_update || dsi->info.ganged_type)
+		return -EINVAL;
+
+	y0 = rounddown(*y, align);
+	y1 = min(roundup(*y + *h, align), v_active);
+	if (y1 <= y0)
+		return -EINVAL;
+
+	if (y0 == dsi->partial_y && y1 - y0 == dsi->partial_h)
+		goto done;
+
+	data[0] = DSI_SET_PAGE_ADDRESS;
+	data[1] = y0 >> 8;
+	data[2] = y0 & 0xff;
+	data[3] = (y1 - 1) >> 8;
+	data[4] = (y1 - 1) & 0xff;
+	err = tegra_dsi_write_data(dc, dsi, data, dsi_command_long_write,
+				   sizeof(data));
+	if (err < 0) {
+		dsi->partial_h = 0;
+		return err;
+	}
+	dsi->partial_y = y0;
+	dsi->partial_h = y1 - y0;
+done:
+	*y = y0;
+	*h = y1 - y0;
+	return 0;
+}
+
 struct tegra_dc_out_ops tegra_dc_dsi_ops = {
 	.init = tegra_dc_dsi_init,
 	.destroy = tegra_dc_dsi_destroy,
@@ -4369,4 +4417,5 @@ struct tegra_dc_out_ops tegra_dc_dsi_ops = {
 	.resume = tegra_dc_dsi_resume,
 #endif
 	.setup_clk = tegra_dc_dsi_setup_clk,
+	.partial_update = tegra_dc_dsi_partial_update,
 };
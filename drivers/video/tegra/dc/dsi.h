@@ -87,6 +87,10 @@ struct tegra_dc_dsi_data {
 	unsigned long idle_delay;
 	atomic_t host_ref;
 
+	/* page address window last sent to the panel, 0 if unknown */
+	u16 partial_y;
+	u16 partial_h;
+
 	u8 driven_mode;
 	u8 controller_index;
 
@@ -33,6 +33,11 @@ int tegra_dc_ext_process_hotplug(int output)
 	return tegra_dc_ext_queue_hotplug(&g_control, output);
 }
 
+int tegra_dc_ext_process_flip(struct tegra_dc_ext_control_event_flip *flip)
+{
+	return tegra_dc_ext_queue_flip(&g_control, flip);
+}
+
 static int
 get_output_properties(struct tegra_dc_ext_control_output_properties *properties)
 {
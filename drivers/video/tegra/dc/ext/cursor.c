@@ -58,6 +58,55 @@ int tegra_dc_ext_put_cursor(struct tegra_dc_ext_user *user)
 	return ret;
 }
 
+/*
+ * Cursor registers are only written from here, under ext->cursor.lock, so
+ * they are programmed without dc->lock: a flip holding dc->lock while it
+ * adjusts bandwidth must not hold up the cursor. Powering the head is all
+ * that is needed; GENERAL_ACT_REQ makes the new state active on the next
+ * vblank, independently of any window update in flight. ext->enabled is
+ * only cleared under ext->cursor.lock before the head is powered down.
+ */
+static void cursor_hw_begin(struct tegra_dc *dc)
+{
+	tegra_dc_io_start(dc);
+	tegra_dc_hold_dc_out(dc);
+}
+
+static void cursor_hw_commit(struct tegra_dc *dc)
+{
+	tegra_dc_writel(dc, GENERAL_ACT_REQ << 8, DC_CMD_STATE_CONTROL);
+	tegra_dc_writel(dc, GENERAL_ACT_REQ, DC_CMD_STATE_CONTROL);
+
+	tegra_dc_release_dc_out(dc);
+	tegra_dc_io_end(dc);
+}
+
+/*
+ * DC_DISP_DISP_WIN_OPTIONS is shared with the output drivers, so
+ * changing the cursor enable takes dc->lock. Visibility is cached to keep
+ * this off the path of plain motion.
+ */
+static void set_cursor_visible(struct tegra_dc_ext *ext, bool enable)
+{
+	struct tegra_dc *dc = ext->dc;
+	u32 win_options;
+
+	if (ext->cursor.visible == enable)
+		return;
+
+	mutex_lock(&dc->lock);
+	win_options = tegra_dc_readl(dc, DC_DISP_DISP_WIN_OPTIONS);
+	if (!!(win_options & CURSOR_ENABLE) != enable) {
+		win_options &= ~CURSOR_ENABLE;
+		if (enable)
+			win_options |= CURSOR_ENABLE;
+		tegra_dc_writel(dc, win_options, DC_DISP_DISP_WIN_OPTIONS);
+	}
+	mutex_unlock(&dc->lock);
+
+	ext->cursor.visible = enable;
+}
+
 static void set_cursor_image_hw(struct tegra_dc *dc,
 				struct tegra_dc_ext_cursor_image *args,
 				dma_addr_t phys_addr)
@@ -128,21 +177,11 @@ int tegra_dc_ext_set_cursor_image(struct tegra_dc_ext_user *user,
 
 	ext->cursor.cur_handle = handle;
 
-	mutex_lock(&dc->lock);
-	tegra_dc_io_start(dc);
-	tegra_dc_hold_dc_out(dc);
-
+	cursor_hw_begin(dc);
 	set_cursor_image_hw(dc, args, phys_addr);
-
-	tegra_dc_writel(dc, GENERAL_ACT_REQ << 8, DC_CMD_STATE_CONTROL);
-	tegra_dc_writel(dc, GENERAL_ACT_REQ, DC_CMD_STATE_CONTROL);
-
-	tegra_dc_release_dc_out(dc);
-	tegra_dc_io_end(dc);
+	cursor_hw_commit(dc);
 	/* XXX sync here? */
 
-	mutex_unlock(&dc->lock);
-
 	mutex_unlock(&ext->cursor.lock);
 
 	if (old_handle) {
@@ -163,7 +202,6 @@ int tegra_dc_ext_set_cursor(struct tegra_dc_ext_user *user,
 {
 	struct tegra_dc_ext *ext = user->ext;
 	struct tegra_dc *dc = ext->dc;
-	u32 win_options;
 	bool enable;
 	int ret;
 
@@ -181,30 +219,15 @@ int tegra_dc_ext_set_cursor(struct tegra_dc_ext_user *user,
 
 	enable = !!(args->flags & TEGRA_DC_EXT_CURSOR_FLAGS_VISIBLE);
 
-	mutex_lock(&dc->lock);
-	tegra_dc_io_start(dc);
-	tegra_dc_hold_dc_out(dc);
+	cursor_hw_begin(dc);
 
-	win_options = tegra_dc_readl(dc, DC_DISP_DISP_WIN_OPTIONS);
-	if (!!(win_options & CURSOR_ENABLE) != enable) {
-		win_options &= ~CURSOR_ENABLE;
-		if (enable)
-			win_options |= CURSOR_ENABLE;
-		tegra_dc_writel(dc, win_options, DC_DISP_DISP_WIN_OPTIONS);
-	}
+	set_cursor_visible(ext, enable);
 
+	/* moves within a frame coalesce, the last one is latched */
 	tegra_dc_writel(dc, CURSOR_POSITION(args->x, args->y),
 		DC_DISP_CURSOR_POSITION);
 
-	tegra_dc_writel(dc, GENERAL_ACT_REQ << 8, DC_CMD_STATE_CONTROL);
-	tegra_dc_writel(dc, GENERAL_ACT_REQ, DC_CMD_STATE_CONTROL);
-
-	/* TODO: need to sync here?  hopefully can avoid this, but need to
-	 * figure out interaction w/ rest of GENERAL_ACT_REQ */
-
-	tegra_dc_release_dc_out(dc);
-	tegra_dc_io_end(dc);
-	mutex_unlock(&dc->lock);
+	cursor_hw_commit(dc);
 
 	mutex_unlock(&ext->cursor.lock);
 
@@ -236,9 +259,7 @@ int tegra_dc_ext_cursor_clip(struct tegra_dc_ext_user *user,
 		goto unlock;
 	}
 
-	mutex_lock(&dc->lock);
-	tegra_dc_io_start(dc);
-	tegra_dc_hold_dc_out(dc);
+	cursor_hw_begin(dc);
 
 	reg_val = tegra_dc_readl(dc, DC_DISP_CURSOR_START_ADDR);
 	reg_val &= ~CURSOR_CLIP_SHIFT_BITS(3); /* Clear out the old value */
@@ -247,7 +268,6 @@ int tegra_dc_ext_cursor_clip(struct tegra_dc_ext_user *user,
 
 	tegra_dc_release_dc_out(dc);
 	tegra_dc_io_end(dc);
-	mutex_unlock(&dc->lock);
 
 	mutex_unlock(&ext->cursor.lock);
 
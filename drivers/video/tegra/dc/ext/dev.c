@@ -24,6 +24,8 @@
 #include <linux/slab.h>
 #include <linux/workqueue.h>
 #include <linux/export.h>
+#include <linux/module.h>
+#include <linux/input/frame_trace.h>
 
 #include <video/tegra_dc_ext.h>
 
@@ -44,6 +46,17 @@ int tegra_dc_ext_devno;
 struct class *tegra_dc_ext_class;
 static int head_count;
 
+/* protects tegra_dc_ext.clone and .clone_src of every head */
+static DEFINE_MUTEX(clone_lock);
+
+/*
+ * Maximum number of flips queued on a head before TEGRA_DC_EXT_FLIP blocks.
+ * 0 means no limit.
+ */
+static unsigned int flip_queue_depth;
+module_param(flip_queue_depth, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(flip_queue_depth, "Flips queued per head, 0 = unlimited");
+
 struct tegra_dc_ext_flip_win {
 	struct tegra_dc_ext_flip_windowattr	attr;
 	struct nvmap_handle_ref			*handle[TEGRA_DC_NUM_PLANES];
@@ -58,6 +71,17 @@ struct tegra_dc_ext_flip_data {
 	struct work_struct		work;
 	struct tegra_dc_ext_flip_win	win[DC_N_WINDOWS];
 	struct list_head		timestamp_node;
+	struct list_head		queue_node;
+	u32				win_mask;
+	u32				post_syncpt_id;
+	u32				post_syncpt_val;
+	u32				frame;
+	ktime_t				submitted;
+	u32				programmed_frame;
+	u32				trace_frame;
+	bool				has_timestamp;
+	bool				has_cursor;
+	bool				has_frame;
 };
 
 int tegra_dc_ext_get_num_outputs(void)
@@ -97,14 +121,18 @@ static int tegra_dc_ext_get_window(struct tegra_dc_ext_user *user,
 
 	win = &ext->win[n];
 
+	mutex_lock(&clone_lock);
 	mutex_lock(&win->lock);
 
-	if (!win->user)
+	if (ext->clone_src)
+		ret = -EBUSY;
+	else if (!win->user)
 		win->user = user;
 	else if (win->user != user)
 		ret = -EBUSY;
 
 	mutex_unlock(&win->lock);
+	mutex_unlock(&clone_lock);
 
 	return ret;
 }
@@ -148,6 +176,7 @@ static void set_enable(struct tegra_dc_ext *ext, bool en)
 	mutex_lock(&ext->cursor.lock);
 
 	ext->enabled = en;
+	ext->cursor.visible = -1;
 
 	mutex_unlock(&ext->cursor.lock);
 	for (i = ext->dc->n_windows - 1; i >= 0 ; i--)
@@ -249,6 +278,14 @@ static int tegra_dc_ext_set_windowattr(struct tegra_dc_ext *ext,
 	win->out_w = flip_win->attr.out_w;
 	win->out_h = flip_win->attr.out_h;
 	win->z = flip_win->attr.z;
+	if (flip_win->attr.flags & TEGRA_DC_EXT_FLIP_FLAG_DAMAGE) {
+		win->damage_x = flip_win->attr.damage_x;
+		win->damage_y = flip_win->attr.damage_y;
+		win->damage_w = flip_win->attr.damage_w;
+		win->damage_h = flip_win->attr.damage_h;
+	} else {
+		win->damage_w = 0;
+	}
 	memcpy(ext_win->cur_handle, flip_win->handle,
 	       sizeof(ext_win->cur_handle));
 
@@ -327,6 +364,15 @@ int tegra_dc_unset_flip_callback()
 }
 EXPORT_SYMBOL(tegra_dc_unset_flip_callback);
 
+/* jiffies of the last flip on any head, for clients pacing to screen activity */
+static unsigned long last_flip_jiffies = INITIAL_JIFFIES;
+
+unsigned long tegra_dc_get_last_flip(void)
+{
+	return ACCESS_ONCE(last_flip_jiffies);
+}
+EXPORT_SYMBOL(tegra_dc_get_last_flip);
+
 static void tegra_dc_ext_unpin_handles(struct tegra_dc_ext *ext,
 				       struct nvmap_handle_ref *unpin_handles[],
 				       int nr_unpin)
@@ -339,17 +385,282 @@ static void tegra_dc_ext_unpin_handles(struct tegra_dc_ext *ext,
 	}
 }
 
+/* Have the pre-syncpoints of every window in the flip already expired? */
+static bool tegra_dc_ext_flip_ready(struct tegra_dc_ext *ext,
+				    struct tegra_dc_ext_flip_data *data)
+{
+	int i;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		struct tegra_dc_ext_flip_windowattr *attr = &data->win[i].attr;
+		u32 val;
+
+		if (attr->index < 0 || (s32)attr->pre_syncpt_id < 0)
+			continue;
+
+		val = nvhost_syncpt_read_ext(ext->dc->ndev,
+					     attr->pre_syncpt_id);
+		if ((s32)(val - attr->pre_syncpt_val) < 0)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * A flip is superseded when a later flip on the same head updates all of
+ * its windows and is ready to go. Programming it would only be overwritten
+ * before scanout, so it is dropped. Timed, frame-targeted and cursor flips
+ * are never dropped or used to drop another flip.
+ */
+static bool tegra_dc_ext_flip_superseded(struct tegra_dc_ext *ext,
+					 struct tegra_dc_ext_flip_data *data)
+{
+	struct tegra_dc_ext_flip_data *next;
+	bool superseded = false;
+
+	if (data->has_timestamp || data->has_cursor || data->has_frame)
+		return false;
+
+	mutex_lock(&ext->flip_queue_lock);
+	list_for_each_entry_reverse(next, &ext->flip_queue, queue_node) {
+		if (next == data)
+			break;
+		if (next->has_timestamp || next->has_cursor || next->has_frame)
+			continue;
+		if ((next->win_mask & data->win_mask) != data->win_mask)
+			continue;
+		if (tegra_dc_ext_flip_ready(ext, next)) {
+			superseded = true;
+			break;
+		}
+	}
+	mutex_unlock(&ext->flip_queue_lock);
+
+	return superseded;
+}
+
+static void tegra_dc_ext_flip_dequeue(struct tegra_dc_ext *ext,
+				      struct tegra_dc_ext_flip_data *data)
+{
+	mutex_lock(&ext->flip_queue_lock);
+	list_del(&data->queue_node);
+	ext->nr_flips_queued--;
+	mutex_unlock(&ext->flip_queue_lock);
+
+	wake_up(&ext->flip_queue_wq);
+}
+
+/*
+ * Release a superseded flip without touching the hardware. Its post
+ * syncpoint values are reached when the superseding flip completes.
+ */
+static void tegra_dc_ext_flip_drop(struct tegra_dc_ext_flip_data *data)
+{
+	struct tegra_dc_ext *ext = data->ext;
+	struct nvmap_handle_ref *unpin_handles[DC_N_WINDOWS *
+					       TEGRA_DC_NUM_PLANES];
+	int i, j, nr_unpin = 0;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+		int index = flip_win->attr.index;
+
+		if (index < 0)
+			continue;
+
+		atomic_dec(&ext->win[index].nr_pending_flips);
+
+		for (j = 0; j < TEGRA_DC_NUM_PLANES; j++)
+			if (flip_win->handle[j])
+				unpin_handles[nr_unpin++] = flip_win->handle[j];
+	}
+
+	tegra_dc_ext_flip_dequeue(ext, data);
+	tegra_dc_ext_unpin_handles(ext, unpin_handles, nr_unpin);
+	kfree(data);
+}
+
+/*
+ * Map a window of the source head onto the same window of its clone: the
+ * buffer is shared, the output rectangle is scaled to fit the clone's mode
+ * keeping the aspect ratio, and the clone's scaler does the rest.
+ */
+static void tegra_dc_ext_clone_win(struct tegra_dc *src_dc,
+				   struct tegra_dc *dst_dc,
+				   const struct tegra_dc_win *src,
+				   struct tegra_dc_win *dst)
+{
+	unsigned sw = src_dc->mode.h_active, sh = src_dc->mode.v_active;
+	unsigned dw = dst_dc->mode.h_active, dh = dst_dc->mode.v_active;
+	unsigned num, den, off_x, off_y;
+
+	dst->flags = src->flags;
+	if (!sw || !sh || !WIN_IS_ENABLED(src)) {
+		dst->flags = 0;
+		return;
+	}
+
+	if ((u64)dw * sh < (u64)dh * sw) {
+		num = dw;
+		den = sw;
+	} else {
+		num = dh;
+		den = sh;
+	}
+	off_x = (dw - div_u64((u64)sw * num, den)) / 2;
+	off_y = (dh - div_u64((u64)sh * num, den)) / 2;
+
+	dst->fmt = src->fmt;
+	dst->ppflags = src->ppflags;
+	dst->phys_addr = src->phys_addr;
+	dst->phys_addr_u = src->phys_addr_u;
+	dst->phys_addr_v = src->phys_addr_v;
+	dst->stride = src->stride;
+	dst->stride_uv = src->stride_uv;
+	dst->x = src->x;
+	dst->y = src->y;
+	dst->w = src->w;
+	dst->h = src->h;
+	dst->out_x = off_x + div_u64((u64)src->out_x * num, den);
+	dst->out_y = off_y + div_u64((u64)src->out_y * num, den);
+	dst->out_w = max_t(unsigned, div_u64((u64)src->out_w * num, den), 1);
+	dst->out_h = max_t(unsigned, div_u64((u64)src->out_h * num, den), 1);
+	dst->z = src->z;
+	dst->global_alpha = src->global_alpha;
+	dst->damage_w = 0;
+
+	if ((dst->out_w != dfixed_trunc(src->w) ||
+	     dst->out_h != dfixed_trunc(src->h)) &&
+	    !tegra_dc_feature_has_scaling(dst_dc, dst->idx))
+		dst->flags = 0;
+}
+
+/* called with clone_lock held */
+static int tegra_dc_ext_clone_update(struct tegra_dc_ext *ext,
+				     struct tegra_dc_win *wins[], int nr_win,
+				     struct tegra_dc_win *clone_wins[])
+{
+	struct tegra_dc_ext *clone = ext->clone;
+	int i, nr_clone = 0;
+
+	if (!clone || !clone->enabled)
+		return 0;
+
+	for (i = 0; i < nr_win; i++) {
+		struct tegra_dc_win *dst;
+
+		dst = tegra_dc_get_window(clone->dc, wins[i]->idx);
+		if (!dst)
+			continue;
+
+		tegra_dc_ext_clone_win(ext->dc, clone->dc, wins[i], dst);
+		clone_wins[nr_clone++] = dst;
+	}
+
+	if (nr_clone)
+		tegra_dc_update_windows(clone_wins, nr_clone);
+
+	return nr_clone;
+}
+
+/* stop the clone from scanning out buffers about to be unpinned */
+static void tegra_dc_ext_clone_blank(struct tegra_dc_ext *ext,
+				     unsigned windows)
+{
+	mutex_lock(&clone_lock);
+	if (ext->clone)
+		tegra_dc_blank(ext->clone->dc, windows);
+	mutex_unlock(&clone_lock);
+}
+
+static int tegra_dc_ext_set_clone(struct tegra_dc_ext_user *user, int head)
+{
+	struct tegra_dc_ext *ext = user->ext;
+	struct tegra_dc_ext *clone = NULL;
+	int i, ret = 0;
+
+	if (head >= 0) {
+		struct tegra_dc *dc = tegra_dc_get_dc(head);
+
+		if (!dc || !dc->ext || dc->ext == ext)
+			return -EINVAL;
+		clone = dc->ext;
+	}
+
+	mutex_lock(&clone_lock);
+
+	if (ext->clone == clone)
+		goto unlock;
+
+	if (ext->clone_src || (clone && (clone->clone || clone->clone_src))) {
+		ret = -EBUSY;
+		goto unlock;
+	}
+
+	if (clone) {
+		for (i = 0; i < clone->dc->n_windows; i++) {
+			if (clone->win[i].user) {
+				ret = -EBUSY;
+				goto unlock;
+			}
+		}
+	}
+
+	if (ext->clone) {
+		tegra_dc_blank(ext->clone->dc, BIT(DC_N_WINDOWS) - 1);
+		ext->clone->clone_src = NULL;
+	}
+
+	ext->clone = clone;
+	if (clone)
+		clone->clone_src = ext;
+
+unlock:
+	mutex_unlock(&clone_lock);
+
+	return ret;
+}
+
+/* tell the control device which vblank latched the flip */
+static void tegra_dc_ext_flip_complete(struct tegra_dc_ext *ext,
+				       struct tegra_dc_ext_flip_data *data)
+{
+	struct tegra_dc_ext_control_event_flip flip;
+	s64 timestamp_ns;
+
+	flip.handle = ext->dc->ndev->id;
+	flip.post_syncpt_id = data->post_syncpt_id;
+	flip.post_syncpt_val = data->post_syncpt_val;
+	tegra_dc_get_latch(ext->dc, &flip.frame, &timestamp_ns);
+	flip.timestamp_ns = timestamp_ns;
+
+	tegra_dc_ext_process_flip(&flip);
+
+	frame_trace_scanout(flip.handle, data->trace_frame,
+			    data->post_syncpt_id, data->post_syncpt_val,
+			    flip.frame, timestamp_ns);
+
+	tegra_dc_record_flip(ext->dc, data->submitted, data->programmed_frame);
+}
+
 static void tegra_dc_ext_flip_worker(struct work_struct *work)
 {
 	struct tegra_dc_ext_flip_data *data =
 		container_of(work, struct tegra_dc_ext_flip_data, work);
 	struct tegra_dc_ext *ext = data->ext;
 	struct tegra_dc_win *wins[DC_N_WINDOWS];
+	struct tegra_dc_win *clone_wins[DC_N_WINDOWS];
 	struct nvmap_handle_ref *unpin_handles[DC_N_WINDOWS *
 					       TEGRA_DC_NUM_PLANES];
 	struct nvmap_handle_ref *old_handle;
-	int i, nr_unpin = 0, nr_win = 0;
-	bool skip_flip = false;
+	int i, nr_unpin = 0, nr_win = 0, nr_clone = 0;
+	bool skip_flip = false, cloned = false;
+
+	if (tegra_dc_ext_flip_superseded(ext, data)) {
+		tegra_dc_ext_flip_drop(data);
+		return;
+	}
 
 	for (i = 0; i < DC_N_WINDOWS; i++) {
 		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
@@ -421,9 +732,29 @@ static void tegra_dc_ext_flip_worker(struct work_struct *work)
 	}
 
 	if (!skip_flip) {
+		if (data->has_frame)
+			tegra_dc_wait_for_frame(ext->dc, data->frame - 1);
+
+		data->programmed_frame = tegra_dc_get_frame(ext->dc);
 		tegra_dc_update_windows(wins, nr_win);
+
+		/* only heads being mirrored ever take clone_lock here */
+		if (ext->clone) {
+			mutex_lock(&clone_lock);
+			cloned = true;
+			nr_clone = tegra_dc_ext_clone_update(ext, wins, nr_win,
+							     clone_wins);
+		}
+
 		/* TODO: implement swapinterval here */
 		tegra_dc_sync_windows(wins, nr_win);
+		/* the old buffers are unpinned below, the clone too must be
+		 * off them by then */
+		if (nr_clone)
+			tegra_dc_sync_windows(clone_wins, nr_clone);
+		if (cloned)
+			mutex_unlock(&clone_lock);
+		last_flip_jiffies = jiffies;
 		if (!tegra_dc_has_multiple_dc()) {
 			spin_lock(&flip_callback_lock);
 			if (flip_callback)
@@ -441,8 +772,12 @@ static void tegra_dc_ext_flip_worker(struct work_struct *work)
 			tegra_dc_incr_syncpt_min(ext->dc, index,
 					flip_win->syncpt_max);
 		}
+
+		tegra_dc_ext_flip_complete(ext, data);
 	}
 
+	tegra_dc_ext_flip_dequeue(ext, data);
+
 	/* unpin and deref previous front buffers */
 	tegra_dc_ext_unpin_handles(ext, unpin_handles, nr_unpin);
 
@@ -560,7 +895,8 @@ static void tegra_dc_ext_unpin_window(struct tegra_dc_ext_win *win)
 }
 
 static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
-			     struct tegra_dc_ext_flip *args)
+			     struct tegra_dc_ext_flip *args,
+			     const u32 *frame)
 {
 	struct tegra_dc_ext *ext = user->ext;
 	struct tegra_dc_ext_flip_data *data;
@@ -580,12 +916,26 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 	if (ret)
 		return ret;
 
+	/* throttle the client to the queue depth of the head */
+	if (flip_queue_depth) {
+		ret = wait_event_interruptible(ext->flip_queue_wq,
+			ext->nr_flips_queued < flip_queue_depth);
+		if (ret)
+			return ret;
+	}
+
 	data = kzalloc(sizeof(*data), GFP_KERNEL);
 	if (!data)
 		return -ENOMEM;
 
 	INIT_WORK(&data->work, tegra_dc_ext_flip_worker);
 	data->ext = ext;
+	data->submitted = ktime_get();
+	data->trace_frame = frame_trace_current();
+	if (frame) {
+		data->frame = *frame;
+		data->has_frame = true;
+	}
 
 #ifdef CONFIG_ANDROID
 	for (i = 0; i < DC_N_WINDOWS; i++) {
@@ -613,6 +963,10 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		if (index < 0)
 			continue;
 
+		data->win_mask |= BIT(index);
+		if (flip_win->attr.flags & TEGRA_DC_EXT_FLIP_FLAG_CURSOR)
+			data->has_cursor = true;
+
 		ret = tegra_dc_ext_pin_window(user, flip_win->attr.buff_id,
 					      &flip_win->handle[TEGRA_DC_Y],
 					      &flip_win->phys_addr);
@@ -686,6 +1040,25 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		list_add_tail(&data->timestamp_node, &ext->win[work_index].timestamp_queue);
 		mutex_unlock(&ext->win[work_index].queue_lock);
 	}
+	data->has_timestamp = has_timestamp;
+	data->post_syncpt_id = args->post_syncpt_id;
+	data->post_syncpt_val = args->post_syncpt_val;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		if (args->win[i].index < 0)
+			continue;
+		frame_trace_flip(ext->dc->ndev->id, data->trace_frame,
+				 args->win[i].index,
+				 args->win[i].pre_syncpt_id,
+				 args->win[i].pre_syncpt_val,
+				 data->post_syncpt_id, data->post_syncpt_val);
+	}
+
+	mutex_lock(&ext->flip_queue_lock);
+	list_add_tail(&data->queue_node, &ext->flip_queue);
+	ext->nr_flips_queued++;
+	mutex_unlock(&ext->flip_queue_lock);
+
 	queue_work(ext->win[work_index].flip_wq, &data->work);
 
 	unlock_windows_for_flip(user, args);
@@ -903,6 +1276,7 @@ static long tegra_dc_ioctl(struct file *filp, unsigned int cmd,
 		ret = tegra_dc_ext_put_window(user, arg);
 		if (!ret) {
 			tegra_dc_blank(user->ext->dc, BIT(arg));
+			tegra_dc_ext_clone_blank(user->ext, BIT(arg));
 			tegra_dc_ext_unpin_window(&user->ext->win[arg]);
 		}
 		return ret;
@@ -915,7 +1289,7 @@ static long tegra_dc_ioctl(struct file *filp, unsigned int cmd,
 		if (copy_from_user(&args, user_arg, sizeof(args)))
 			return -EFAULT;
 
-		ret = tegra_dc_ext_flip(user, &args);
+		ret = tegra_dc_ext_flip(user, &args, NULL);
 
 		if (copy_to_user(user_arg, &args, sizeof(args)))
 			return -EFAULT;
@@ -923,6 +1297,45 @@ static long tegra_dc_ioctl(struct file *filp, unsigned int cmd,
 		return ret;
 	}
 
+	case TEGRA_DC_EXT_FLIP_AT_FRAME:
+	{
+		struct tegra_dc_ext_flip_frame args;
+		int ret;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		ret = tegra_dc_ext_flip(user, &args.flip, &args.frame);
+
+		if (copy_to_user(user_arg, &args, sizeof(args)))
+			return -EFAULT;
+
+		return ret;
+	}
+
+	case TEGRA_DC_EXT_SET_CONTENT_RATE:
+	{
+		struct tegra_dc_ext_content_rate args;
+		int ret;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		ret = tegra_dc_set_content_rate(user->ext->dc,
+						args.content_rate);
+		if (ret < 0)
+			return ret;
+
+		args.refresh = ret;
+		if (copy_to_user(user_arg, &args, sizeof(args)))
+			return -EFAULT;
+
+		return 0;
+	}
+
+	case TEGRA_DC_EXT_SET_CLONE:
+		return tegra_dc_ext_set_clone(user, (int)arg);
+
 	case TEGRA_DC_EXT_GET_CURSOR:
 		return tegra_dc_ext_get_cursor(user);
 	case TEGRA_DC_EXT_PUT_CURSOR:
@@ -1074,6 +1487,7 @@ static int tegra_dc_release(struct inode *inode, struct file *filp)
 	}
 
 	tegra_dc_blank(ext->dc, windows);
+	tegra_dc_ext_clone_blank(ext, windows);
 	for_each_set_bit(i, &windows, DC_N_WINDOWS)
 		tegra_dc_ext_unpin_window(&ext->win[i]);
 
@@ -1177,6 +1591,11 @@ struct tegra_dc_ext *tegra_dc_ext_register(struct platform_device *ndev,
 		goto cleanup_nvmap;
 
 	mutex_init(&ext->cursor.lock);
+	ext->cursor.visible = -1;
+
+	INIT_LIST_HEAD(&ext->flip_queue);
+	mutex_init(&ext->flip_queue_lock);
+	init_waitqueue_head(&ext->flip_queue_wq);
 
 	head_count++;
 
@@ -195,3 +195,21 @@ int tegra_dc_ext_queue_hotplug(struct tegra_dc_ext_control *control, int output)
 
 	return 0;
 }
+
+int tegra_dc_ext_queue_flip(struct tegra_dc_ext_control *control,
+			    struct tegra_dc_ext_control_event_flip *flip)
+{
+	struct {
+		struct tegra_dc_ext_event event;
+		struct tegra_dc_ext_control_event_flip flip;
+	} __packed pack;
+
+	pack.event.type = TEGRA_DC_EXT_EVENT_FLIP;
+	pack.event.data_size = sizeof(pack.flip);
+
+	pack.flip = *flip;
+
+	tegra_dc_ext_queue_event(control, &pack.event);
+
+	return 0;
+}
@@ -78,15 +78,26 @@ struct tegra_dc_ext {
 		struct tegra_dc_ext_user	*user;
 		struct nvmap_handle_ref		*cur_handle;
 		struct mutex			lock;
+		int				visible; /* -1 if unknown */
 	} cursor;
 
+	/* flips queued on this head, oldest first */
+	struct list_head		flip_queue;
+	struct mutex			flip_queue_lock;
+	int				nr_flips_queued;
+	wait_queue_head_t		flip_queue_wq;
+
+	/* head mirroring this one's flips, and the head this one mirrors */
+	struct tegra_dc_ext		*clone;
+	struct tegra_dc_ext		*clone_src;
+
 	bool				enabled;
 };
 
 #define TEGRA_DC_EXT_EVENT_MASK_ALL \
-	TEGRA_DC_EXT_EVENT_HOTPLUG
+	(TEGRA_DC_EXT_EVENT_HOTPLUG | TEGRA_DC_EXT_EVENT_FLIP)
 
-#define TEGRA_DC_EXT_EVENT_MAX_SZ	8
+#define TEGRA_DC_EXT_EVENT_MAX_SZ	24
 
 struct tegra_dc_ext_event_list {
 	struct tegra_dc_ext_event	event;
@@ -144,6 +155,9 @@ extern int tegra_dc_ext_control_init(void);
 
 extern int tegra_dc_ext_queue_hotplug(struct tegra_dc_ext_control *,
 				      int output);
+extern int tegra_dc_ext_queue_flip(struct tegra_dc_ext_control *,
+				   struct tegra_dc_ext_control_event_flip *);
+extern int tegra_dc_ext_process_flip(struct tegra_dc_ext_control_event_flip *);
 extern ssize_t tegra_dc_ext_event_read(struct file *filp, char __user *buf,
 				       size_t size, loff_t *ppos);
 extern unsigned int tegra_dc_ext_event_poll(struct file *, poll_table *);
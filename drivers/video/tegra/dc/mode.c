@@ -309,12 +309,90 @@ int tegra_dc_set_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode)
 
 	print_mode(dc, mode, __func__);
 	dc->frametime_ns = calc_frametime_ns(mode);
+	dc->base_v_front_porch = mode->v_front_porch;
 	mutex_unlock(&dc->lock);
 
 	return 0;
 }
 EXPORT_SYMBOL(tegra_dc_set_mode);
 
+/*
+ * Run the display at the highest integer multiple of content_rate (in
+ * 1000ths of a Hertz) that the mode allows, by stretching the vertical
+ * front porch. The pixel clock and the active timing are left alone, so
+ * the sink stays in sync and no modeset is needed. The new timing takes
+ * effect on the next frame. A content_rate of 0 restores the mode's own
+ * refresh rate. Returns the refresh rate now in effect, in 1000ths of a
+ * Hertz.
+ */
+int tegra_dc_set_content_rate(struct tegra_dc *dc, int content_rate)
+{
+	struct tegra_dc_mode *m = &dc->mode;
+	long h_total, v_total, v_fixed, pclk;
+	int base_refresh, refresh, v_front_porch;
+	int ret;
+
+	if (content_rate < 0 || !dc->out->min_refresh ||
+	    (dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE))
+		return -EINVAL;
+
+	mutex_lock(&dc->lock);
+
+	pclk = m->rated_pclk > 0 ? m->rated_pclk : m->pclk;
+	h_total = m->h_active + m->h_front_porch + m->h_back_porch +
+		m->h_sync_width;
+	v_fixed = m->v_active + m->v_back_porch + m->v_sync_width;
+	v_total = v_fixed + dc->base_v_front_porch;
+	if (!pclk || !h_total) {
+		ret = -EINVAL;
+		goto out;
+	}
+	base_refresh = div_s64((s64)pclk * 1000, h_total * v_total);
+
+	refresh = base_refresh;
+	if (content_rate && content_rate < base_refresh)
+		refresh = base_refresh / content_rate * content_rate;
+	if (refresh < (int)dc->out->min_refresh * 1000) {
+		ret = -ERANGE;
+		goto out;
+	}
+
+	v_front_porch = div_s64((s64)pclk * 1000, h_total * refresh) -
+		v_fixed;
+	if (v_front_porch < dc->base_v_front_porch ||
+	    v_front_porch > 0x7fff) {
+		ret = -ERANGE;
+		goto out;
+	}
+
+	if (v_front_porch != m->v_front_porch) {
+		m->v_front_porch = v_front_porch;
+		dc->frametime_ns = calc_frametime_ns(m);
+
+		if (dc->enabled) {
+			tegra_dc_io_start(dc);
+			tegra_dc_hold_dc_out(dc);
+			tegra_dc_writel(dc, m->h_front_porch |
+					(m->v_front_porch << 16),
+					DC_DISP_FRONT_PORCH);
+			tegra_dc_writel(dc, GENERAL_UPDATE,
+					DC_CMD_STATE_CONTROL);
+			tegra_dc_writel(dc, GENERAL_ACT_REQ,
+					DC_CMD_STATE_CONTROL);
+			tegra_dc_release_dc_out(dc);
+			tegra_dc_io_end(dc);
+		}
+
+		trace_display_mode(dc, m);
+	}
+
+	ret = tegra_dc_calc_refresh(m);
+out:
+	mutex_unlock(&dc->lock);
+	return ret;
+}
+EXPORT_SYMBOL(tegra_dc_set_content_rate);
+
 int tegra_dc_to_fb_videomode(struct fb_videomode *fbmode,
 	const struct tegra_dc_mode *mode)
 {
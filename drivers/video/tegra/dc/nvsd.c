@@ -110,6 +110,26 @@ static atomic_t *sd_brightness;
 /* shared boolean for manual K workaround */
 static atomic_t man_k_until_blank = ATOMIC_INIT(0);
 
+/* Frames to keep watching after the histogram last changed. The HW keeps
+ * moving K and brightness for a few frames after a flip (update delay,
+ * smooth K, BLP time constant), so stopping at the first quiet frame would
+ * miss the final value. */
+#define NVSD_SETTLE_FRAMES	8
+/* Largest per-frame change of the soft-clipping corrected brightness. */
+#define NVSD_BL_STEP		2
+
+/* Last histogram and the HW outputs that go with it. */
+struct nvsd_snapshot {
+	u32 histo[DC_DISP_SD_HISTOGRAM_NUM];
+	u32 hw_k;
+	u32 bl;
+};
+
+static struct nvsd_snapshot sd_snap;
+static bool sd_snap_valid;
+static int sd_target_brightness;
+static unsigned sd_settle;
+
 static u8 nvsd_get_bw_idx(struct tegra_dc_sd_settings *settings)
 {
 	u8 bw;
@@ -584,6 +604,9 @@ void nvsd_init(struct tegra_dc *dc, struct tegra_dc_sd_settings *settings)
 
 	/* note that we're in manual K until the next flip */
 	atomic_set(&man_k_until_blank, 1);
+
+	/* settings changed, so recompute on the next frame */
+	sd_snap_valid = false;
 }
 
 static int bl_tf[17] = {
@@ -630,7 +653,8 @@ static u32 nvsd_softclip(fixed20_12 pixel, fixed20_12 k, fixed20_12 th)
 	return min_t(u32, num.full, dfixed_const(255));
 }
 
-static int nvsd_set_brightness(struct tegra_dc *dc)
+static int nvsd_set_brightness(struct tegra_dc *dc,
+	const struct nvsd_snapshot *snap)
 {
 	u32 bin_width;
 	int i, j;
@@ -652,13 +676,12 @@ static int nvsd_set_brightness(struct tegra_dc *dc)
 
 	/* Collet the inputs of the algorithm */
 	for (i = 0; i < DC_DISP_SD_HISTOGRAM_NUM; i++) {
-		val = tegra_dc_readl(dc, DC_DISP_SD_HISTOGRAM(i));
+		val = snap->histo[i];
 		for (j = 0; j < 4; j++)
 			histo[i * 4 + j] = SD_HISTOGRAM_BIN(val, (j * 8));
 	}
 
-	val = tegra_dc_readl(dc, DC_DISP_SD_HW_K_VALUES);
-	k.full = SD_HW_K_R(val) << 2;
+	k.full = SD_HW_K_R(snap->hw_k) << 2;
 
 	val = tegra_dc_readl(dc, DC_DISP_SD_SOFT_CLIPPING);
 	threshold.full = dfixed_const(SD_SOFT_CLIPPING_THRESHOLD(val));
@@ -699,7 +722,28 @@ static int nvsd_set_brightness(struct tegra_dc *dc)
 	return nvsd_backlght_interplate(val, 128);
 }
 
-/* Periodic update */
+/* Latch the histogram and HW outputs. Returns true if any of them changed
+ * since the last frame, i.e. the content or the HW's response to it moved. */
+static bool nvsd_sample(struct tegra_dc *dc)
+{
+	struct nvsd_snapshot snap;
+	int i;
+
+	for (i = 0; i < DC_DISP_SD_HISTOGRAM_NUM; i++)
+		snap.histo[i] = tegra_dc_readl(dc, DC_DISP_SD_HISTOGRAM(i));
+	snap.hw_k = tegra_dc_readl(dc, DC_DISP_SD_HW_K_VALUES);
+	snap.bl = SD_BLC_BRIGHTNESS(tegra_dc_readl(dc, DC_DISP_SD_BL_CONTROL));
+
+	if (sd_snap_valid && !memcmp(&snap, &sd_snap, sizeof(snap)))
+		return false;
+
+	sd_snap = snap;
+	sd_snap_valid = true;
+	return true;
+}
+
+/* Per-frame update, run from the vblank (or vpulse2) worker. Returns true
+ * while the brightness is still moving, which keeps the interrupt armed. */
 bool nvsd_update_brightness(struct tegra_dc *dc)
 {
 	u32 val = 0;
@@ -723,29 +767,47 @@ bool nvsd_update_brightness(struct tegra_dc *dc)
 		if (!settings->enable)
 			return true;
 
-		cur_sd_brightness = atomic_read(sd_brightness);
+		/* PRISM is updated by hw or sw algorithm. */
+		if (settings->phase_in_adjustments)
+			return nvsd_phase_in_adjustments(dc, settings);
 
-		/* read brightness value */
-		val = tegra_dc_readl(dc, DC_DISP_SD_BL_CONTROL);
-		val = SD_BLC_BRIGHTNESS(val);
+		cur_sd_brightness = atomic_read(sd_brightness);
 
-		/* PRISM is updated by hw or sw algorithm. Brightness is
-		 * compensated according to histogram for soft-clipping
-		 * if hw output is used to update brightness. */
-		if (settings->phase_in_adjustments) {
-			return nvsd_phase_in_adjustments(dc, settings);
-		} else if (settings->soft_clipping_correction) {
-			sw_sd_brightness = nvsd_set_brightness(dc);
-			if (sw_sd_brightness != cur_sd_brightness) {
-				atomic_set(sd_brightness, sw_sd_brightness);
-				return true;
+		/* Static content: the histogram and HW outputs are unchanged,
+		 * so the target from the last change still stands. */
+		if (nvsd_sample(dc)) {
+			sd_settle = NVSD_SETTLE_FRAMES;
+			/* Brightness is compensated according to histogram for
+			 * soft-clipping if hw output is used to update it. */
+			if (settings->soft_clipping_correction) {
+				sw_sd_brightness = nvsd_set_brightness(dc,
+								&sd_snap);
+				if (sw_sd_brightness >= 0)
+					sd_target_brightness = sw_sd_brightness;
+			} else {
+				sd_target_brightness = sd_snap.bl;
 			}
-		} else if (val != (u32)cur_sd_brightness) {
+		} else if (sd_settle) {
+			sd_settle--;
+		}
+
+		if (sd_target_brightness != cur_sd_brightness) {
+			/* The HW already ramps its own output through the BLP
+			 * settings; ramp the sw estimate one step per frame so
+			 * the backlight does not jump with each histogram. */
+			if (settings->soft_clipping_correction)
+				cur_sd_brightness = clamp(sd_target_brightness,
+					cur_sd_brightness - NVSD_BL_STEP,
+					cur_sd_brightness + NVSD_BL_STEP);
+			else
+				cur_sd_brightness = sd_target_brightness;
+
 			/* set brightness value and note the update */
-			atomic_set(sd_brightness, (int)val);
+			atomic_set(sd_brightness, cur_sd_brightness);
 			return true;
 		}
 
+		return sd_settle != 0;
 	}
 
 	/* No update needed. */
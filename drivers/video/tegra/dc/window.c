@@ -19,6 +19,7 @@
 #include <linux/types.h>
 #include <linux/moduleparam.h>
 #include <mach/dc.h>
+#include <mach/boot_profile.h>
 #include <trace/events/display.h>
 
 #include "dc_reg.h"
@@ -314,6 +315,112 @@ static inline void tegra_dc_update_scaling(struct tegra_dc *dc,
 		H_DDA_INC(h_dda), DC_WIN_DDA_INCREMENT);
 }
 
+/* scan out rows y .. y + h - 1 of win only. y = 0, h = v_active restores the
+ * full frame. */
+static void tegra_dc_program_partial(struct tegra_dc *dc,
+	struct tegra_dc_win *win, unsigned y, unsigned h)
+{
+	unsigned top = max(win->out_y, y);
+	unsigned bottom = min(win->out_y + win->out_h, y + h);
+	unsigned Bpp = tegra_dc_fmt_bpp(win->fmt) / 8;
+
+	tegra_dc_writel(dc, WINDOW_A_SELECT << win->idx,
+			DC_CMD_DISPLAY_WINDOW_HEADER);
+	tegra_dc_writel(dc, V_POSITION(top - y) | H_POSITION(win->out_x),
+			DC_WIN_POSITION);
+	tegra_dc_writel(dc, V_SIZE(bottom - top) | H_SIZE(win->out_w),
+			DC_WIN_SIZE);
+	if (tegra_dc_feature_has_scaling(dc, win->idx))
+		tegra_dc_writel(dc, V_PRESCALED_SIZE(bottom - top) |
+			H_PRESCALED_SIZE(dfixed_trunc(win->w) * Bpp),
+			DC_WIN_PRESCALED_SIZE);
+	tegra_dc_writel(dc, dfixed_trunc(win->y) + top - win->out_y,
+			DC_WINBUF_ADDR_V_OFFSET);
+
+	tegra_dc_writel(dc, dc->mode.h_active | (h << 16),
+			DC_DISP_DISP_ACTIVE);
+}
+
+/* a band of rows can only be scanned out for a single, unscaled, linear RGB
+ * window that is part of this update */
+static struct tegra_dc_win *tegra_dc_partial_window(struct tegra_dc *dc,
+	struct tegra_dc_win *windows[], int n)
+{
+	struct tegra_dc_win *win = NULL;
+	int i;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		if (!WIN_IS_ENABLED(&dc->windows[i]))
+			continue;
+		if (win)
+			return NULL;
+		win = &dc->windows[i];
+	}
+	if (!win || !win->damage_w || !win->damage_h)
+		return NULL;
+
+	for (i = 0; i < n; i++)
+		if (windows[i] == win)
+			break;
+	if (i == n)
+		return NULL;
+
+	if (win->flags & (TEGRA_WIN_FLAG_INVERT_V | TEGRA_WIN_FLAG_TILED |
+			  TEGRA_WIN_FLAG_SCAN_COLUMN))
+		return NULL;
+	if (tegra_dc_is_yuv(win->fmt) || dfixed_frac(win->y) ||
+	    win->h.full != dfixed_const(win->out_h))
+		return NULL;
+
+	return win;
+}
+
+/* called with dc->lock held, before the update is activated */
+static void tegra_dc_update_partial(struct tegra_dc *dc,
+	struct tegra_dc_win *windows[], int n)
+{
+	struct tegra_dc_win *win = NULL;
+	unsigned y = 0, h = dc->mode.v_active;
+	int i;
+
+	if (dc->out_ops && dc->out_ops->partial_update)
+		win = tegra_dc_partial_window(dc, windows, n);
+
+	if (win) {
+		unsigned bottom = min(win->damage_y + win->damage_h,
+				      (unsigned)dc->mode.v_active);
+
+		y = min(win->damage_y, bottom);
+		h = bottom - y;
+		if (!h || dc->out_ops->partial_update(dc, &y, &h) < 0 ||
+		    y >= win->out_y + win->out_h || y + h <= win->out_y) {
+			win = NULL;
+			y = 0;
+			h = dc->mode.v_active;
+		}
+	}
+
+	if (win) {
+		tegra_dc_program_partial(dc, win, y, h);
+		dc->partial_win = win->idx;
+	} else if (dc->partial_win >= 0) {
+		/* back to full frames */
+		struct tegra_dc_win *old = &dc->windows[dc->partial_win];
+
+		dc->out_ops->partial_update(dc, &y, &h);
+		if (WIN_IS_ENABLED(old))
+			tegra_dc_program_partial(dc, old, y, h);
+		else
+			tegra_dc_writel(dc, dc->mode.h_active |
+				(dc->mode.v_active << 16), DC_DISP_DISP_ACTIVE);
+		dc->partial_win = -1;
+	}
+
+	/* damage only describes this update */
+	for (i = 0; i < n; i++)
+		windows[i]->damage_w = 0;
+}
+
 /* Does not support updating windows on multiple dcs in one call.
  * Requires a matching sync_windows to avoid leaking ref-count on clocks. */
 int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
@@ -511,6 +618,9 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 		}
 	}
 
+	if (dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE)
+		tegra_dc_update_partial(dc, windows, n);
+
 	tegra_dc_set_dynamic_emc(windows, n);
 
 	tegra_dc_writel(dc, update_mask << 8, DC_CMD_STATE_CONTROL);
@@ -546,6 +656,7 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 		update_mask |= NC_HOST_TRIG;
 
 	tegra_dc_writel(dc, update_mask, DC_CMD_STATE_CONTROL);
+	tegra_boot_profile_mark("first frame");
 
 	tegra_dc_release_dc_out(dc);
 	/* tegra_dc_io_end() is called in tegra_dc_sync_windows() */
@@ -562,6 +673,7 @@ void tegra_dc_trigger_windows(struct tegra_dc *dc)
 	u32 val, i;
 	u32 completed = 0;
 	u32 dirty = 0;
+	u32 latched = 0;
 
 	val = tegra_dc_readl(dc, DC_CMD_STATE_CONTROL);
 	for (i = 0; i < DC_N_WINDOWS; i++) {
@@ -572,6 +684,8 @@ void tegra_dc_trigger_windows(struct tegra_dc *dc)
 		completed = 1;
 #else
 		if (!(val & (WIN_A_ACT_REQ << i))) {
+			if (dc->windows[i].dirty)
+				latched = 1;
 			dc->windows[i].dirty = 0;
 			completed = 1;
 		} else {
@@ -586,6 +700,9 @@ void tegra_dc_trigger_windows(struct tegra_dc *dc)
 			tegra_dc_mask_interrupt(dc, FRAME_END_INT);
 	}
 
+	if (latched)
+		tegra_dc_record_latch(dc);
+
 	if (completed)
 		wake_up(&dc->wq);
 }
@@ -30,6 +30,7 @@
 #include <linux/file.h>
 #include <linux/workqueue.h>
 #include <linux/console.h>
+#include <linux/hardirq.h>
 
 #include <asm/atomic.h>
 
@@ -344,15 +345,80 @@ static int tegra_fb_pan_display(struct fb_var_screeninfo *var,
 	return 0;
 }
 
+#ifdef CONFIG_FB_TEGRA_2D_ACCEL
+/* below this many pixels the CPU beats a round trip through gr2d */
+#define TEGRA_FB_2D_MIN_PIXELS	4096
+
+/*
+ * gr2d blits sleep until the engine is done, so they are only used from
+ * process context. fbcon also draws from printk with interrupts off and
+ * while oopsing, and those paths keep using the CPU.
+ */
+static bool tegra_fb_use_2d(struct fb_info *info, u32 width, u32 height)
+{
+	struct tegra_fb_info *tegra_fb = info->par;
+	u32 bpp = info->var.bits_per_pixel;
+
+	return tegra_fb->valid && info->state == FBINFO_STATE_RUNNING &&
+		(bpp == 16 || bpp == 32) &&
+		width * height >= TEGRA_FB_2D_MIN_PIXELS &&
+		!oops_in_progress && !in_atomic() && !irqs_disabled();
+}
+
+static void tegra_fb_init_blit(struct fb_info *info,
+			       struct nvhost_gr2d_blit *blit)
+{
+	memset(blit, 0, sizeof(*blit));
+	blit->base = info->fix.smem_start;
+	blit->pitch = info->fix.line_length;
+	blit->bpp = info->var.bits_per_pixel;
+}
+#endif
+
 static void tegra_fb_fillrect(struct fb_info *info,
 			      const struct fb_fillrect *rect)
 {
+#ifdef CONFIG_FB_TEGRA_2D_ACCEL
+	if (tegra_fb_use_2d(info, rect->width, rect->height)) {
+		struct nvhost_gr2d_blit blit;
+
+		tegra_fb_init_blit(info, &blit);
+		blit.fill = true;
+		blit.xor = rect->rop == ROP_XOR;
+		if (info->fix.visual == FB_VISUAL_TRUECOLOR ||
+		    info->fix.visual == FB_VISUAL_DIRECTCOLOR)
+			blit.color = ((u32 *)info->pseudo_palette)[rect->color];
+		else
+			blit.color = rect->color;
+		blit.dx = rect->dx;
+		blit.dy = rect->dy;
+		blit.w = rect->width;
+		blit.h = rect->height;
+		if (!nvhost_gr2d_blit(&blit))
+			return;
+	}
+#endif
 	cfb_fillrect(info, rect);
 }
 
 static void tegra_fb_copyarea(struct fb_info *info,
 			      const struct fb_copyarea *region)
 {
+#ifdef CONFIG_FB_TEGRA_2D_ACCEL
+	if (tegra_fb_use_2d(info, region->width, region->height)) {
+		struct nvhost_gr2d_blit blit;
+
+		tegra_fb_init_blit(info, &blit);
+		blit.sx = region->sx;
+		blit.sy = region->sy;
+		blit.dx = region->dx;
+		blit.dy = region->dy;
+		blit.w = region->width;
+		blit.h = region->height;
+		if (!nvhost_gr2d_blit(&blit))
+			return;
+	}
+#endif
 	cfb_copyarea(info, region);
 }
 
@@ -593,6 +659,10 @@ struct tegra_fb_info *tegra_fb_register(struct platform_device *ndev,
 
 	info->fbops = &tegra_fb_ops;
 	info->pseudo_palette = pseudo_palette;
+#ifdef CONFIG_FB_TEGRA_2D_ACCEL
+	/* lets fbcon scroll by copying instead of redrawing */
+	info->flags |= FBINFO_HWACCEL_COPYAREA | FBINFO_HWACCEL_FILLRECT;
+#endif
 	info->screen_base = fb_base;
 	info->screen_size = fb_size;
 
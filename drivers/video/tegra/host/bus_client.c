@@ -113,6 +113,42 @@ int nvhost_write_module_regs(struct platform_device *ndev,
 	return 0;
 }
 
+/**
+ * nvhost_read_engine_counters - sample the channel counters of an engine
+ * @dev: client device
+ * @c: filled with the cumulative counts
+ *
+ * The counts only ever grow, so consumers compare two samples. May sleep,
+ * but does not wake host1x up.
+ */
+int nvhost_read_engine_counters(struct platform_device *dev,
+		struct nvhost_engine_counters *c)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+
+	if (!pdata || !pdata->channel || !tickctrl_op().counters)
+		return -ENODEV;
+
+	return tickctrl_op().counters(dev, c);
+}
+EXPORT_SYMBOL(nvhost_read_engine_counters);
+
+static ssize_t engine_counters_show(struct device *device,
+	struct device_attribute *attr, char *buf)
+{
+	struct nvhost_engine_counters c;
+	int err;
+
+	err = nvhost_read_engine_counters(to_platform_device(device), &c);
+	if (err)
+		return err;
+
+	return sprintf(buf, "%llu %llu %llu %llu\n",
+			c.ticks, c.busy, c.stall, c.idle);
+}
+
+static DEVICE_ATTR(engine_counters, S_IRUGO, engine_counters_show, NULL);
+
 struct nvhost_channel_userctx {
 	struct nvhost_channel *ch;
 	struct nvhost_hwctx *hwctx;
@@ -143,6 +179,8 @@ static int nvhost_channelrelease(struct inode *inode, struct file *filp)
 	if (priv->job)
 		nvhost_job_put(priv->job);
 
+	if (priv->memmgr)
+		nvhost_pin_cache_drop_mgr(&priv->ch->pin_cache, priv->memmgr);
 	mem_op().put_mgr(priv->memmgr);
 	kfree(priv);
 	return 0;
@@ -173,6 +211,10 @@ static int nvhost_channelopen(struct inode *inode, struct file *filp)
 		priv->hwctx = ch->ctxhandler->alloc(ch->ctxhandler, ch);
 		if (!priv->hwctx)
 			goto fail;
+		priv->hwctx->pid = current->tgid;
+		mutex_lock(&ch->reflock);
+		list_add_tail(&priv->hwctx->list, &ch->hwctx_list);
+		mutex_unlock(&ch->reflock);
 	}
 	priv->priority = NVHOST_PRIORITY_MEDIUM;
 	priv->clientid = atomic_add_return(1,
@@ -407,8 +449,9 @@ fail:
 	return err;
 }
 
-static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
-		struct nvhost_submit_args *args)
+/* build and pin a job from a submit ioctl's arguments */
+static int nvhost_ioctl_channel_get_job(struct nvhost_channel_userctx *ctx,
+		struct nvhost_submit_args *args, struct nvhost_job **out)
 {
 	struct nvhost_job *job;
 	int num_cmdbufs = args->num_cmdbufs;
@@ -487,20 +530,84 @@ static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
 
 	job->timeout_debug_dump = ctx->timeout_debug_dump;
 
-	err = nvhost_channel_submit(job);
+	*out = job;
+	return 0;
+
+fail:
+	nvhost_job_put(job);
+	return err;
+}
+
+static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
+		struct nvhost_submit_args *args)
+{
+	struct nvhost_job *job;
+	int err;
+
+	err = nvhost_ioctl_channel_get_job(ctx, args, &job);
 	if (err)
-		goto fail_submit;
+		return err;
+
+	err = nvhost_channel_submit(job);
+	if (err) {
+		nvhost_job_unpin(job);
+		goto fail;
+	}
 
 	args->fence = job->syncpt_end;
 
+fail:
 	nvhost_job_put(job);
+	return err;
+}
 
-	return 0;
+static int nvhost_ioctl_channel_submit_batch(
+		struct nvhost_channel_userctx *ctx,
+		struct nvhost_submit_batch_args *args)
+{
+	struct nvhost_submit_args __user *submits = args->submits;
+	struct nvhost_job *jobs[NVHOST_SUBMIT_BATCH_MAX];
+	int num_jobs;
+	int submitted = 0;
+	int err = 0;
+	int i;
+
+	if (!args->num_submits || args->num_submits > NVHOST_SUBMIT_BATCH_MAX)
+		return -EINVAL;
+
+	/* pin and patch everything before taking the channel */
+	for (num_jobs = 0; num_jobs < args->num_submits; num_jobs++) {
+		struct nvhost_submit_args submit;
+
+		if (copy_from_user(&submit, &submits[num_jobs],
+					sizeof(submit))) {
+			err = -EFAULT;
+			break;
+		}
+
+		err = nvhost_ioctl_channel_get_job(ctx, &submit,
+				&jobs[num_jobs]);
+		if (err)
+			break;
+	}
+
+	if (!err)
+		err = nvhost_channel_submit_batch(jobs, num_jobs, &submitted);
+
+	for (i = 0; i < submitted; i++)
+		if (put_user(jobs[i]->syncpt_end, &submits[i].fence))
+			err = -EFAULT;
+
+	/* a partially queued batch is reported through num_submitted */
+	if (submitted && err != -EFAULT)
+		err = 0;
+	args->num_submitted = submitted;
+
+	for (i = submitted; i < num_jobs; i++)
+		nvhost_job_unpin(jobs[i]);
+	for (i = 0; i < num_jobs; i++)
+		nvhost_job_put(jobs[i]);
 
-fail_submit:
-	nvhost_job_unpin(job);
-fail:
-	nvhost_job_put(job);
 	return err;
 }
 
@@ -704,8 +811,11 @@ static long nvhost_channelctl(struct file *filp,
 			break;
 		}
 
-		if (priv->memmgr)
+		if (priv->memmgr) {
+			nvhost_pin_cache_drop_mgr(&priv->ch->pin_cache,
+					priv->memmgr);
 			mem_op().put_mgr(priv->memmgr);
+		}
 
 		priv->memmgr = new_client;
 		break;
@@ -751,6 +861,9 @@ static long nvhost_channelctl(struct file *filp,
 	case NVHOST_IOCTL_CHANNEL_SUBMIT:
 		err = nvhost_ioctl_channel_submit(priv, (void *)buf);
 		break;
+	case NVHOST_IOCTL_CHANNEL_SUBMIT_BATCH:
+		err = nvhost_ioctl_channel_submit_batch(priv, (void *)buf);
+		break;
 	case NVHOST_IOCTL_CHANNEL_SET_TIMEOUT_EX:
 		priv->timeout = (u32)
 			((struct nvhost_set_timeout_ex_args *)buf)->timeout;
@@ -855,6 +968,13 @@ int nvhost_client_device_init(struct platform_device *dev)
 
 	nvhost_device_debug_init(dev);
 
+	if (tickctrl_op().counters &&
+	    device_create_file(&dev->dev, &dev_attr_engine_counters))
+		dev_warn(&dev->dev, "failed to create engine_counters\n");
+
+	/* clients only depend on host1x, their parent, so resume in parallel */
+	device_enable_async_suspend(&dev->dev);
+
 	/* reset syncpoint values for this unit */
 	nvhost_module_busy(nvhost_master->dev);
 	nvhost_syncpt_reset_client(dev);
@@ -32,6 +32,7 @@ struct nvhost_channel;
 struct nvhost_hwctx;
 struct nvhost_cdma;
 struct nvhost_job;
+struct nvhost_engine_counters;
 struct push_buffer;
 struct nvhost_syncpt;
 struct dentry;
@@ -48,6 +49,8 @@ struct nvhost_channel_ops {
 		    struct nvhost_master *,
 		    int chid);
 	int (*submit)(struct nvhost_job *job);
+	int (*submit_batch)(struct nvhost_job **jobs, int num_jobs,
+			int *submitted);
 	int (*save_context)(struct nvhost_channel *channel);
 	int (*drain_read_fifo)(struct nvhost_channel *ch,
 		u32 *ptr, unsigned int count, unsigned int *pending);
@@ -57,6 +60,7 @@ struct nvhost_cdma_ops {
 	void (*start)(struct nvhost_cdma *);
 	void (*stop)(struct nvhost_cdma *);
 	void (*kick)(struct  nvhost_cdma *);
+	int (*grow_push_buffer)(struct nvhost_cdma *);
 	int (*timeout_init)(struct nvhost_cdma *,
 			    u32 syncpt_id);
 	void (*timeout_destroy)(struct nvhost_cdma *);
@@ -151,9 +155,11 @@ struct nvhost_mem_ops {
 	struct sg_table *(*pin)(struct mem_mgr *, struct mem_handle *);
 	void (*unpin)(struct mem_mgr *, struct mem_handle *, struct sg_table *);
 	void *(*mmap)(struct mem_handle *);
+	void *(*mmap_wc)(struct mem_handle *, size_t max_size, size_t *size);
 	void (*munmap)(struct mem_handle *, void *);
 	void *(*kmap)(struct mem_handle *, unsigned int);
 	void (*kunmap)(struct mem_handle *, unsigned int, void *);
+	void (*kunmap_clean)(struct mem_handle *, unsigned int, void *);
 	int (*pin_array_ids)(struct mem_mgr *,
 			struct platform_device *,
 			long unsigned *,
@@ -184,6 +190,8 @@ struct nvhost_tickctrl_ops {
 	int (*tickcount)(struct platform_device *dev, u64 *val);
 	int (*stallcount)(struct platform_device *dev, u64 *val);
 	int (*xfercount)(struct platform_device *dev, u64 *val);
+	int (*counters)(struct platform_device *dev,
+			struct nvhost_engine_counters *c);
 };
 
 struct nvhost_chip_support {
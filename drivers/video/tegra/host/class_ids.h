@@ -26,6 +26,7 @@ enum {
 	NV_HOST1X_CLASS_ID		= 0x1,
 	NV_VIDEO_ENCODE_MPEG_CLASS_ID	= 0x20,
 	NV_VIDEO_ENCODE_MSENC_CLASS_ID	= 0x21,
+	NV_GRAPHICS_2D_CLASS_ID		= 0x51,
 	NV_GRAPHICS_3D_CLASS_ID		= 0x60,
 	NV_TSEC_CLASS_ID		= 0xE0,
 };
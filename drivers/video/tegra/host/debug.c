@@ -19,6 +19,7 @@
 
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/math64.h>
 #include <linux/uaccess.h>
 
 #include <linux/io.h>
@@ -27,6 +28,7 @@
 #include "debug.h"
 #include "nvhost_acm.h"
 #include "nvhost_channel.h"
+#include "nvhost_hwctx.h"
 #include "chip_support.h"
 
 pid_t nvhost_debug_null_kickoff_pid;
@@ -482,6 +484,184 @@ static const struct file_operations xfercount_fops = {
 	.release	= single_release,
 };
 
+static int priority_show(struct seq_file *s, void *unused)
+{
+	static const char * const names[NVHOST_PRIO_LEVELS] = {
+		"high", "medium", "low"
+	};
+	struct platform_device *dev = s->private;
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	struct nvhost_channel *ch = pdata->channel;
+	struct nvhost_cdma *cdma;
+	int queued[NVHOST_PRIO_LEVELS];
+	int i;
+
+	if (!ch)
+		return -ENODEV;
+	cdma = &ch->cdma;
+
+	mutex_lock(&cdma->lock);
+	queued[NVHOST_PRIO_LEVEL_HIGH] = cdma->high_prio_count;
+	queued[NVHOST_PRIO_LEVEL_MEDIUM] = cdma->med_prio_count;
+	queued[NVHOST_PRIO_LEVEL_LOW] = cdma->low_prio_count;
+
+	seq_printf(s, "%-8s %8s %8s %12s %10s %10s\n", "level", "waiting",
+			"queued", "completed", "avg_us", "max_us");
+	for (i = 0; i < NVHOST_PRIO_LEVELS; i++) {
+		struct nvhost_prio_stats *st = &cdma->prio_stats[i];
+		u64 avg = 0;
+
+		if (st->completed)
+			avg = div64_u64(st->total_us, st->completed);
+		seq_printf(s, "%-8s %8d %8d %12llu %10llu %10u\n", names[i],
+				atomic_read(&ch->prio_waiting[i]), queued[i],
+				st->completed, avg, st->max_us);
+	}
+	mutex_unlock(&cdma->lock);
+
+	return 0;
+}
+
+static int priority_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, priority_show, inode->i_private);
+}
+
+static const struct file_operations priority_fops = {
+	.open		= priority_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int cdma_stats_show(struct seq_file *s, void *unused)
+{
+	struct platform_device *dev = s->private;
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	struct nvhost_cdma *cdma;
+	struct nvhost_cdma_stats *st;
+
+	if (!pdata->channel)
+		return -ENODEV;
+	cdma = &pdata->channel->cdma;
+	st = &cdma->stats;
+
+	mutex_lock(&cdma->lock);
+	seq_printf(s, "push buffer slots: %u (grown %u times)\n",
+			cdma->push_buffer.size / 8, st->pb_grows);
+	seq_printf(s, "push buffer waits: %llu, %llu us total, %u us max\n",
+			st->pb_waits, st->pb_wait_us, st->pb_wait_max_us);
+	seq_printf(s, "sync queue waits: %llu, %llu us total, %u us max\n",
+			st->sq_waits, st->sq_wait_us, st->sq_wait_max_us);
+	seq_printf(s, "sync queue depth: %u (max %u)\n",
+			st->sq_depth, st->sq_depth_max);
+	mutex_unlock(&cdma->lock);
+
+	return 0;
+}
+
+static int cdma_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cdma_stats_show, inode->i_private);
+}
+
+static const struct file_operations cdma_stats_fops = {
+	.open		= cdma_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int latency_show(struct seq_file *s, void *unused)
+{
+	static const char * const names[NVHOST_JOB_STAGES] = {
+		"submit", "queue", "exec", "irq", "total"
+	};
+	struct platform_device *dev = s->private;
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	struct nvhost_cdma *cdma;
+	struct nvhost_job_latency *lat;
+	int i, j;
+
+	if (!pdata->channel)
+		return -ENODEV;
+	cdma = &pdata->channel->cdma;
+	lat = &cdma->latency;
+
+	mutex_lock(&cdma->lock);
+	seq_printf(s, "jobs: %llu\n", lat->jobs);
+	seq_printf(s, "%-10s", "stage");
+	for (j = 0; j < NVHOST_JOB_STAGES; j++)
+		seq_printf(s, " %10s", names[j]);
+	seq_printf(s, "\n%-10s", "avg_us");
+	for (j = 0; j < NVHOST_JOB_STAGES; j++)
+		seq_printf(s, " %10llu", lat->jobs ?
+				div64_u64(lat->total_us[j], lat->jobs) : 0);
+	seq_printf(s, "\n%-10s", "max_us");
+	for (j = 0; j < NVHOST_JOB_STAGES; j++)
+		seq_printf(s, " %10u", lat->max_us[j]);
+	seq_puts(s, "\n\nhistogram, jobs per stage by duration (us):\n");
+	for (i = 0; i < NVHOST_LATENCY_BUCKETS; i++) {
+		if (i == NVHOST_LATENCY_BUCKETS - 1)
+			seq_printf(s, ">=%-8u", 1 << (i - 1));
+		else
+			seq_printf(s, "<%-9u", 1 << i);
+		for (j = 0; j < NVHOST_JOB_STAGES; j++)
+			seq_printf(s, " %10u", lat->hist[j][i]);
+		seq_putc(s, '\n');
+	}
+	mutex_unlock(&cdma->lock);
+
+	return 0;
+}
+
+static int latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, latency_show, inode->i_private);
+}
+
+static const struct file_operations latency_fops = {
+	.open		= latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int contexts_show(struct seq_file *s, void *unused)
+{
+	struct platform_device *dev = s->private;
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	struct nvhost_channel *ch = pdata->channel;
+	struct nvhost_hwctx *ctx;
+
+	if (!ch)
+		return -ENODEV;
+
+	seq_printf(s, "%-8s %10s %10s %10s %s\n",
+			"pid", "saves", "restores", "skipped", "resident");
+	mutex_lock(&ch->reflock);
+	list_for_each_entry(ctx, &ch->hwctx_list, list)
+		seq_printf(s, "%-8d %10u %10u %10u %s\n",
+				ctx->pid, ctx->save_count,
+				ctx->restore_count, ctx->skip_count,
+				ctx == ch->cur_ctx ? "yes" : "no");
+	mutex_unlock(&ch->reflock);
+
+	return 0;
+}
+
+static int contexts_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, contexts_show, inode->i_private);
+}
+
+static const struct file_operations contexts_fops = {
+	.open		= contexts_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void nvhost_device_debug_init(struct platform_device *dev)
 {
 	struct dentry *de = NULL;
@@ -491,6 +671,11 @@ void nvhost_device_debug_init(struct platform_device *dev)
 	debugfs_create_file("stallcount", S_IRUGO, de, dev, &stallcount_fops);
 	debugfs_create_file("xfercount", S_IRUGO, de, dev, &xfercount_fops);
 	debugfs_create_file("tickcount", S_IRUGO, de, dev, &tickcount_fops);
+	debugfs_create_file("priority", S_IRUGO, de, dev, &priority_fops);
+	debugfs_create_file("cdma", S_IRUGO, de, dev, &cdma_stats_fops);
+	debugfs_create_file("latency", S_IRUGO, de, dev, &latency_fops);
+	debugfs_create_file("contexts", S_IRUGO, de, dev, &contexts_fops);
+	nvhost_module_debug_init(dev, de);
 
 	pdata->debugfs = de;
 }
@@ -521,6 +706,9 @@ void nvhost_debug_init(struct nvhost_master *master)
 	if (nvhost_get_chip_ops()->debug.debug_init)
 		nvhost_get_chip_ops()->debug.debug_init(de);
 
+	nvhost_intr_debug_init(de);
+	nvhost_pin_cache_debug_init(de);
+
 	debugfs_create_u32("force_timeout_pid", S_IRUGO|S_IWUSR, de,
 			&nvhost_debug_force_timeout_pid);
 	debugfs_create_u32("force_timeout_val", S_IRUGO|S_IWUSR, de,
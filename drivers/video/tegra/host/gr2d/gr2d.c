@@ -23,6 +23,7 @@
 
 #include "dev.h"
 #include "bus_client.h"
+#include "nvhost_scale.h"
 #include "gr2d_t30.h"
 #include "gr2d_t114.h"
 
@@ -33,14 +34,18 @@ enum gr2d_ip_ver {
 
 struct gr2d_desc {
 	void (*finalize_poweron)(struct platform_device *dev);
+	int (*blit)(struct platform_device *dev,
+			const struct nvhost_gr2d_blit *blit);
 };
 
 static const struct gr2d_desc gr2d[] = {
 	[gr2d_01] = {
 		.finalize_poweron = nvhost_gr2d_t30_finalize_poweron,
+		.blit = NULL,
 	},
 	[gr2d_02] = {
 		.finalize_poweron = nvhost_gr2d_t114_finalize_poweron,
+		.blit = nvhost_gr2d_t114_blit,
 	},
 };
 
@@ -52,9 +57,28 @@ static struct platform_device_id gr2d_id[] = {
 
 MODULE_DEVICE_TABLE(nvhost, gr2d_id);
 
+static struct platform_device *gr2d_pdev;
+
+/* fill or copy within a surface for in-kernel users such as tegra_fb */
+int nvhost_gr2d_blit(const struct nvhost_gr2d_blit *blit)
+{
+	struct platform_device *dev = ACCESS_ONCE(gr2d_pdev);
+	int index;
+
+	if (!dev)
+		return -ENODEV;
+
+	index = (int)(platform_get_device_id(dev)->driver_data);
+	if (!gr2d[index].blit)
+		return -ENODEV;
+
+	return gr2d[index].blit(dev, blit);
+}
+EXPORT_SYMBOL(nvhost_gr2d_blit);
+
 static int __devinit gr2d_probe(struct platform_device *dev)
 {
-	int index = 0;
+	int index = 0, err;
 	struct nvhost_device_data *pdata =
 		(struct nvhost_device_data *)dev->dev.platform_data;
 
@@ -66,15 +90,24 @@ static int __devinit gr2d_probe(struct platform_device *dev)
 
 	pdata->pdev = dev;
 	pdata->finalize_poweron = gr2d[index].finalize_poweron;
+	pdata->busy = nvhost_scale_notify_busy;
+	pdata->idle = nvhost_scale_notify_idle;
+	pdata->scaling_init = nvhost_scale_init;
+	pdata->scaling_deinit = nvhost_scale_deinit;
 
 	platform_set_drvdata(dev, pdata);
 
-	return nvhost_client_device_init(dev);
+	err = nvhost_client_device_init(dev);
+	if (err)
+		return err;
+
+	gr2d_pdev = dev;
+	return 0;
 }
 
 static int __exit gr2d_remove(struct platform_device *dev)
 {
-	/* Add clean-up */
+	nvhost_scale_deinit(dev);
 	return 0;
 }
 
@@ -20,11 +20,229 @@
 
 #include <linux/nvhost.h>
 #include <linux/io.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
 #include "host1x/host1x.h"
+#include "host1x/host1x02_hardware.h"
 #include "host1x/hw_host1x02_sync.h"
+#include "dev.h"
+#include "nvhost_acm.h"
+#include "nvhost_cdma.h"
+#include "nvhost_channel.h"
+#include "nvhost_intr.h"
+#include "nvhost_job.h"
+#include "nvhost_syncpt.h"
+#include "class_ids.h"
+#include "gr2d_t114.h"
 
 #include "gr2d_common.c"
 
+/* Registers of 2D unit */
+
+#define G2_TRIGGER			0x009
+#define G2_CMDSEL			0x00c
+#define G2_CONTROLSECOND		0x01e
+#define G2_CONTROLMAIN			0x01f
+#define G2_CONTROLMAIN_TURBOFILL	(1 << 2)
+#define G2_CONTROLMAIN_SRCSLD		(1 << 6)
+#define G2_CONTROLMAIN_XDIR		(1 << 9)
+#define G2_CONTROLMAIN_YDIR		(1 << 10)
+#define G2_CONTROLMAIN_DSTCD(bpp)	(((bpp) >> 4) << 16)
+#define G2_ROPFADE			0x020
+#define G2_DSTBA			0x02b
+#define G2_DSTST			0x02e
+#define G2_SRCBA			0x031
+#define G2_SRCST			0x033
+#define G2_SRCFGC			0x035
+#define G2_DSTSIZE			0x038
+#define G2_DSTPS			0x03a
+#define G2_SRCPS			0x03c
+#define G2_TILEMODE			0x046
+
+#define G2_ROP_COPY			0xcc
+#define G2_ROP_XOR			0x66
+
+#define G2_XY(x, y)			(((y) << 16) | (x))
+
+#define GR2D_BLIT_TIMEOUT_MS		100
+
+/* kernel blits share one channel reference and go one at a time */
+static DEFINE_MUTEX(gr2d_blit_lock);
+static struct nvhost_channel *gr2d_blit_ch;
+
+static void gr2d_push_fill(struct nvhost_cdma *cdma,
+		const struct nvhost_gr2d_blit *b)
+{
+	nvhost_cdma_push(cdma,
+		nvhost_opcode_mask(G2_CONTROLSECOND, 0x7),
+		0);
+	nvhost_cdma_push(cdma,
+		G2_CONTROLMAIN_DSTCD(b->bpp) | G2_CONTROLMAIN_SRCSLD
+			| G2_CONTROLMAIN_TURBOFILL,
+		b->xor ? G2_ROP_XOR : G2_ROP_COPY);
+	nvhost_cdma_push(cdma,
+		nvhost_opcode_mask(G2_DSTBA, 0x9),
+		b->base);
+	nvhost_cdma_push(cdma,
+		b->pitch,
+		nvhost_opcode_nonincr(G2_SRCFGC, 1));
+	nvhost_cdma_push(cdma,
+		b->color,
+		nvhost_opcode_nonincr(G2_TILEMODE, 1));
+	nvhost_cdma_push(cdma,
+		0,
+		nvhost_opcode_nonincr(G2_DSTSIZE, 1));
+	nvhost_cdma_push(cdma,
+		G2_XY(b->w, b->h),
+		nvhost_opcode_nonincr(G2_DSTPS, 1));
+	/* writing DSTPS triggers the fill */
+	nvhost_cdma_push(cdma,
+		G2_XY(b->dx, b->dy),
+		NVHOST_OPCODE_NOOP);
+}
+
+static void gr2d_push_copy(struct nvhost_cdma *cdma,
+		const struct nvhost_gr2d_blit *b)
+{
+	u32 controlmain = G2_CONTROLMAIN_DSTCD(b->bpp);
+	u32 sx = b->sx, sy = b->sy, dx = b->dx, dy = b->dy;
+
+	/* overlapping copies run from the far end of the area */
+	if (b->dy > b->sy) {
+		controlmain |= G2_CONTROLMAIN_YDIR;
+		sy += b->h - 1;
+		dy += b->h - 1;
+	}
+	if (b->dy == b->sy && b->dx > b->sx) {
+		controlmain |= G2_CONTROLMAIN_XDIR;
+		sx += b->w - 1;
+		dx += b->w - 1;
+	}
+
+	nvhost_cdma_push(cdma,
+		nvhost_opcode_mask(G2_CONTROLSECOND, 0x7),
+		0);
+	nvhost_cdma_push(cdma,
+		controlmain,
+		G2_ROP_COPY);
+	nvhost_cdma_push(cdma,
+		nvhost_opcode_mask(G2_DSTBA, 0x149),
+		b->base);
+	nvhost_cdma_push(cdma,
+		b->pitch,
+		b->base);
+	nvhost_cdma_push(cdma,
+		b->pitch,
+		nvhost_opcode_nonincr(G2_TILEMODE, 1));
+	nvhost_cdma_push(cdma,
+		0,
+		nvhost_opcode_mask(G2_DSTSIZE, 0x11));
+	nvhost_cdma_push(cdma,
+		G2_XY(b->w, b->h),
+		G2_XY(sx, sy));
+	/* writing DSTPS triggers the copy */
+	nvhost_cdma_push(cdma,
+		nvhost_opcode_nonincr(G2_DSTPS, 1),
+		G2_XY(dx, dy));
+}
+
+/*
+ * Run one fill or copy on gr2d from the kernel and wait for it to finish.
+ * The commands go straight into the push buffer, the way gr3d register
+ * reads do, so no command buffer has to be allocated or pinned. May sleep.
+ */
+int nvhost_gr2d_t114_blit(struct platform_device *dev,
+		const struct nvhost_gr2d_blit *b)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	struct nvhost_master *host = nvhost_get_host(dev);
+	struct nvhost_syncpt *sp = &host->syncpt;
+	unsigned long syncpts = pdata->syncpts;
+	u32 syncpt = find_first_bit(&syncpts, BITS_PER_LONG);
+	void *completed_waiter = NULL;
+	struct nvhost_channel *ch;
+	struct nvhost_job *job;
+	u32 syncval;
+	int err;
+
+	if (b->bpp != 16 && b->bpp != 32)
+		return -EINVAL;
+	if (!b->w || !b->h)
+		return 0;
+
+	mutex_lock(&gr2d_blit_lock);
+
+	if (!gr2d_blit_ch)
+		gr2d_blit_ch = nvhost_getchannel(pdata->channel);
+	ch = gr2d_blit_ch;
+	if (!ch) {
+		err = -EBUSY;
+		goto done;
+	}
+
+	completed_waiter = nvhost_intr_alloc_waiter();
+	if (!completed_waiter) {
+		err = -ENOMEM;
+		goto done;
+	}
+
+	job = nvhost_job_alloc(ch, NULL, 0, 0, 0, host->memmgr);
+	if (!job) {
+		err = -ENOMEM;
+		goto done;
+	}
+
+	/* keep module powered until the submit complete interrupt */
+	nvhost_module_busy(dev);
+
+	mutex_lock(&ch->submitlock);
+	err = nvhost_cdma_begin(&ch->cdma, job);
+	if (err) {
+		mutex_unlock(&ch->submitlock);
+		nvhost_module_idle(dev);
+		nvhost_job_put(job);
+		goto done;
+	}
+
+	syncval = nvhost_syncpt_incr_max(sp, syncpt, 1);
+	job->syncpt_id = syncpt;
+	job->syncpt_incrs = 1;
+	job->syncpt_end = syncval;
+
+	nvhost_cdma_push(&ch->cdma,
+		nvhost_opcode_setclass(NV_GRAPHICS_2D_CLASS_ID, 0, 0),
+		nvhost_opcode_mask(G2_TRIGGER, 0x9));
+	nvhost_cdma_push(&ch->cdma,
+		G2_DSTPS,
+		0);
+	if (b->fill)
+		gr2d_push_fill(&ch->cdma, b);
+	else
+		gr2d_push_copy(&ch->cdma, b);
+	nvhost_cdma_push(&ch->cdma,
+		nvhost_opcode_imm_incr_syncpt(
+			host1x_uclass_incr_syncpt_cond_op_done_v(), syncpt),
+		NVHOST_OPCODE_NOOP);
+
+	nvhost_cdma_end(&ch->cdma, job);
+	mutex_unlock(&ch->submitlock);
+	nvhost_job_put(job);
+
+	err = nvhost_intr_add_action(&host->intr, syncpt, syncval,
+			NVHOST_INTR_ACTION_SUBMIT_COMPLETE, ch,
+			completed_waiter, NULL);
+	completed_waiter = NULL;
+	WARN(err, "Failed to set submit complete interrupt");
+
+	err = nvhost_syncpt_wait_timeout(sp, syncpt, syncval,
+			msecs_to_jiffies(GR2D_BLIT_TIMEOUT_MS), NULL);
+
+done:
+	mutex_unlock(&gr2d_blit_lock);
+	nvhost_intr_free_waiter(completed_waiter);
+	return err;
+}
+
 void nvhost_gr2d_t114_finalize_poweron(struct platform_device *dev)
 {
 	gr2d_reset(dev);
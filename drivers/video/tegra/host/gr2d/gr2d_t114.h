@@ -22,7 +22,10 @@
 #define __NVHOST_2D_T114_H
 
 struct platform_device;
+struct nvhost_gr2d_blit;
 
 void nvhost_gr2d_t114_finalize_poweron(struct platform_device *dev);
+int nvhost_gr2d_t114_blit(struct platform_device *dev,
+		const struct nvhost_gr2d_blit *blit);
 
 #endif
@@ -36,6 +36,7 @@
 #include "scale3d.h"
 #include "bus_client.h"
 #include "nvhost_channel.h"
+#include "nvhost_acm.h"
 #include "nvhost_memmgr.h"
 #include "chip_support.h"
 #include "pod_scaling.h"
@@ -227,9 +228,20 @@ static struct platform_device_id gr3d_id[] = {
 
 MODULE_DEVICE_TABLE(nvhost, gr3d_id);
 
+static struct platform_device *gr3d_pdev;
+
+/* time gr3d has had work queued since boot, in us */
+u64 nvhost_gr3d_busy_us(void)
+{
+	struct platform_device *dev = ACCESS_ONCE(gr3d_pdev);
+
+	return dev ? nvhost_module_busy_time(dev) : 0;
+}
+EXPORT_SYMBOL(nvhost_gr3d_busy_us);
+
 static int __devinit gr3d_probe(struct platform_device *dev)
 {
-	int index = 0;
+	int index = 0, err;
 	struct nvhost_device_data *pdata =
 		(struct nvhost_device_data *)dev->dev.platform_data;
 
@@ -254,7 +266,12 @@ static int __devinit gr3d_probe(struct platform_device *dev)
 
 	platform_set_drvdata(dev, pdata);
 
-	return nvhost_client_device_init(dev);
+	err = nvhost_client_device_init(dev);
+	if (err)
+		return err;
+
+	gr3d_pdev = dev;
+	return 0;
 }
 
 static int __exit gr3d_remove(struct platform_device *dev)
@@ -592,9 +592,9 @@ int nvhost_gr3d_t20_read_reg(struct platform_device *dev,
 	mutex_unlock(&channel->submitlock);
 
 done:
-	kfree(ctx_waiter);
-	kfree(read_waiter);
-	kfree(completed_waiter);
+	nvhost_intr_free_waiter(ctx_waiter);
+	nvhost_intr_free_waiter(read_waiter);
+	nvhost_intr_free_waiter(completed_waiter);
 	return err;
 }
 
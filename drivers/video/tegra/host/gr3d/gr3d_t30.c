@@ -533,11 +533,13 @@ int nvhost_gr3d_t30_read_reg(
 		if (hwctx_to_save) {
 			syncpt_incrs += hwctx_to_save->save_incrs;
 			hwctx_to_save->hwctx.valid = true;
+			hwctx_to_save->hwctx.save_count++;
 			nvhost_job_get_hwctx(job, &hwctx_to_save->hwctx);
 		}
 		channel->cur_ctx = hwctx;
 		if (channel->cur_ctx && channel->cur_ctx->valid) {
 			need_restore = true;
+			channel->cur_ctx->restore_count++;
 			syncpt_incrs += to_host1x_hwctx(channel->cur_ctx)
 				->restore_incrs;
 		}
@@ -656,9 +658,9 @@ int nvhost_gr3d_t30_read_reg(
 	*value = *mem_ptr;
 
 done:
-	kfree(ctx_waiter);
-	kfree(read_waiter);
-	kfree(completed_waiter);
+	nvhost_intr_free_waiter(ctx_waiter);
+	nvhost_intr_free_waiter(read_waiter);
+	nvhost_intr_free_waiter(completed_waiter);
 	if (mem_ptr)
 		mem_op().munmap(mem, mem_ptr);
 	if (mem_sgt)
@@ -37,7 +37,10 @@
 #include <linux/types.h>
 #include <linux/clk.h>
 #include <linux/export.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/nvhost_podgov.h>
@@ -50,6 +53,7 @@
 #include "scale3d.h"
 #include "pod_scaling.h"
 #include "dev.h"
+#include "nvhost_scale.h"
 
 /* time frame for load and hint tracking - when events come in at a larger
  * interval, this probably indicates the current estimates are stale
@@ -66,6 +70,46 @@
 static int podgov_is_enabled(struct device *dev);
 static void podgov_enable(struct device *dev, int enable);
 
+/*******************************************************************************
+ * podgov_params - a named set of the tunable scaling parameters
+ *
+ * Each workload class gets its own profile. Selecting a profile swaps the
+ * tunables only; the load and hint history carries over. Changes made to
+ * the tunables through debugfs are kept in the active profile.
+ ******************************************************************************/
+
+enum podgov_profile_id {
+	PODGOV_PROFILE_DEFAULT,
+	PODGOV_PROFILE_EMULATOR,
+	PODGOV_PROFILE_VIDEO,
+	PODGOV_PROFILE_UI,
+	PODGOV_PROFILE_COUNT
+};
+
+static const char * const podgov_profile_names[PODGOV_PROFILE_COUNT] = {
+	[PODGOV_PROFILE_DEFAULT]	= "default",
+	[PODGOV_PROFILE_EMULATOR]	= "emulator",
+	[PODGOV_PROFILE_VIDEO]		= "video",
+	[PODGOV_PROFILE_UI]		= "ui",
+};
+
+struct podgov_params {
+	unsigned int		estimation_window;
+	unsigned int		use_throughput_hint;
+	unsigned int		hint_lo_limit;
+	unsigned int		hint_hi_limit;
+	unsigned int		scaleup_limit;
+	unsigned int		scaledown_limit;
+	unsigned int		smooth;
+	unsigned int		idle_min;
+	unsigned int		idle_max;
+	unsigned int		adjust;
+	unsigned int		frame_control;
+	unsigned int		frame_busy_target;
+	unsigned int		frame_deadband;
+	unsigned int		frame_ki;
+};
+
 /*******************************************************************************
  * podgov_info_rec - gr3d scaling governor specific parameters
  ******************************************************************************/
@@ -104,6 +148,10 @@ struct podgov_info_rec {
 	unsigned int		p_idle_max;
 	unsigned int		idle_max;
 	unsigned int		p_adjust;
+	unsigned int		p_frame_control;
+	unsigned int		p_frame_busy_target;
+	unsigned int		p_frame_deadband;
+	unsigned int		p_frame_ki;
 
 	long			last_total_idle;
 	long			total_idle;
@@ -122,7 +170,12 @@ struct podgov_info_rec {
 
 	unsigned int		idle_avg;
 	unsigned int		hint_avg;
+	int			frame_integral;
 	int			block;
+	int			emc_bound;
+
+	int			profile;
+	struct podgov_params	profiles[PODGOV_PROFILE_COUNT];
 
 };
 
@@ -160,6 +213,142 @@ static void scaling_limit(struct devfreq *df, unsigned long *freq)
 		*freq = df->max_freq;
 }
 
+/*******************************************************************************
+ * podgov_params_save(podgov, params)
+ * podgov_params_load(podgov, params)
+ *
+ * Copy the tunables between the governor and a profile
+ ******************************************************************************/
+
+static void podgov_params_save(struct podgov_info_rec *podgov,
+			       struct podgov_params *params)
+{
+	params->estimation_window = podgov->p_estimation_window;
+	params->use_throughput_hint = podgov->p_use_throughput_hint;
+	params->hint_lo_limit = podgov->p_hint_lo_limit;
+	params->hint_hi_limit = podgov->p_hint_hi_limit;
+	params->scaleup_limit = podgov->p_scaleup_limit;
+	params->scaledown_limit = podgov->p_scaledown_limit;
+	params->smooth = podgov->p_smooth;
+	params->idle_min = podgov->p_idle_min;
+	params->idle_max = podgov->p_idle_max;
+	params->adjust = podgov->p_adjust;
+	params->frame_control = podgov->p_frame_control;
+	params->frame_busy_target = podgov->p_frame_busy_target;
+	params->frame_deadband = podgov->p_frame_deadband;
+	params->frame_ki = podgov->p_frame_ki;
+}
+
+static void podgov_params_load(struct podgov_info_rec *podgov,
+			       struct podgov_params *params)
+{
+	podgov->p_estimation_window = params->estimation_window;
+	podgov->p_use_throughput_hint = params->use_throughput_hint;
+	podgov->p_hint_lo_limit = params->hint_lo_limit;
+	podgov->p_hint_hi_limit = params->hint_hi_limit;
+	podgov->p_scaleup_limit = params->scaleup_limit;
+	podgov->p_scaledown_limit = params->scaledown_limit;
+	podgov->p_smooth = params->smooth;
+	podgov->p_idle_min = params->idle_min;
+	podgov->p_idle_max = params->idle_max;
+	podgov->p_adjust = params->adjust;
+	podgov->p_frame_control = params->frame_control;
+	podgov->p_frame_busy_target = params->frame_busy_target;
+	podgov->p_frame_deadband = params->frame_deadband;
+	podgov->p_frame_ki = params->frame_ki;
+
+	/* the adjusted limits restart from the new base values */
+	podgov->idle_min = podgov->p_idle_min;
+	podgov->idle_max = podgov->p_idle_max;
+}
+
+/*******************************************************************************
+ * podgov_init_profiles(podgov)
+ *
+ * Derive the workload profiles from the current (default) tunables.
+ * Emulators boost early and hold the clock; video and ui scale down
+ * readily and smooth the hints more.
+ ******************************************************************************/
+
+static void podgov_init_profiles(struct podgov_info_rec *podgov)
+{
+	struct podgov_params *p;
+	int i;
+
+	for (i = 0; i < PODGOV_PROFILE_COUNT; i++)
+		podgov_params_save(podgov, &podgov->profiles[i]);
+
+	p = &podgov->profiles[PODGOV_PROFILE_EMULATOR];
+	p->idle_min = min(2 * p->idle_min, p->idle_max);
+	p->idle_max = min(2 * p->idle_max, 1000U);
+	p->hint_lo_limit = p->hint_hi_limit - 50;
+	p->scaledown_limit += 200;
+	p->smooth = max(p->smooth / 2, 1U);
+
+	p = &podgov->profiles[PODGOV_PROFILE_VIDEO];
+	p->idle_min /= 2;
+	p->idle_max /= 2;
+	p->smooth *= 2;
+
+	p = &podgov->profiles[PODGOV_PROFILE_UI];
+	p->idle_min /= 2;
+	p->idle_max /= 2;
+	p->scaleup_limit -= 100;
+	p->scaledown_limit -= 100;
+	p->smooth *= 2;
+
+	podgov->profile = PODGOV_PROFILE_DEFAULT;
+}
+
+/*******************************************************************************
+ * podgov_set_profile(podgov, name)
+ *
+ * Switch to the named profile. Must be called with the devfreq lock held,
+ * so the governor never sees a mix of two profiles.
+ ******************************************************************************/
+
+static int podgov_set_profile(struct podgov_info_rec *podgov,
+			      const char *name)
+{
+	int i;
+
+	for (i = 0; i < PODGOV_PROFILE_COUNT; i++)
+		if (!strcmp(name, podgov_profile_names[i]))
+			break;
+	if (i == PODGOV_PROFILE_COUNT)
+		return -EINVAL;
+
+	if (i != podgov->profile) {
+		podgov_params_save(podgov, &podgov->profiles[podgov->profile]);
+		podgov_params_load(podgov, &podgov->profiles[i]);
+		podgov->profile = i;
+	}
+
+	return 0;
+}
+
+/*******************************************************************************
+ * nvhost_scale3d_set_profile(name)
+ *
+ * Select a named scaling profile ("default", "emulator", "video", "ui")
+ ******************************************************************************/
+
+int nvhost_scale3d_set_profile(const char *name)
+{
+	struct podgov_info_rec *podgov = local_podgov;
+	int err;
+
+	if (!podgov || !podgov->power_manager)
+		return -ENODEV;
+
+	mutex_lock(&podgov->power_manager->lock);
+	err = podgov_set_profile(podgov, name);
+	mutex_unlock(&podgov->power_manager->lock);
+
+	return err;
+}
+EXPORT_SYMBOL(nvhost_scale3d_set_profile);
+
 /*******************************************************************************
  * podgov_clocks_handler(work)
  *
@@ -487,7 +676,9 @@ static void update_load_estimate(struct devfreq *df)
  * freqlist_up(podgov, target, steps)
  *
  * This function determines the frequency that is "steps" frequency steps
- * higher compared to the target frequency.
+ * higher compared to the target frequency. While the device reports being
+ * bandwidth bound, the current frequency is not exceeded: a faster 3d clock
+ * would only wait longer on memory.
  ******************************************************************************/
 
 int freqlist_up(struct podgov_info_rec *podgov, long target, int steps)
@@ -499,6 +690,9 @@ int freqlist_up(struct podgov_info_rec *podgov, long target, int steps)
 			break;
 
 	pos = min(podgov->freq_count - 1, i + steps);
+	if (podgov->emc_bound)
+		return min_t(long, podgov->freqlist[pos],
+			     podgov->power_manager->previous_freq);
 	return podgov->freqlist[pos];
 }
 
@@ -521,6 +715,29 @@ int freqlist_down(struct podgov_info_rec *podgov, long target, int steps)
 	return podgov->freqlist[pos];
 }
 
+/*******************************************************************************
+ * podgov_log_decision(df, busy_us, total_us, event, freq)
+ *
+ * Record a scaling decision and the governor state it was based on
+ ******************************************************************************/
+
+static void podgov_log_decision(struct devfreq *df, unsigned long busy_us,
+				unsigned long total_us, int event,
+				unsigned long freq)
+{
+	struct podgov_info_rec *podgov = df->data;
+	struct nvhost_scale_sample sample;
+
+	sample.busy_us = busy_us;
+	sample.total_us = total_us;
+	sample.event = event;
+	sample.idle = podgov->idle_estimate;
+	sample.hint = podgov->hint_avg;
+	sample.old_freq = df->previous_freq;
+	sample.new_freq = freq;
+	nvhost_scale_stats_log(to_platform_device(df->dev.parent), &sample);
+}
+
 /*******************************************************************************
  * podgov_idle_handler(work)
  *
@@ -560,6 +777,54 @@ static void podgov_idle_handler(struct work_struct *work)
 		pdata->idle(dev);
 }
 
+/*******************************************************************************
+ * frame_control_target(podgov, curr, avg_hint, avg_idle)
+ *
+ * Frame time feedback. The hint is 1000 * target frame time / measured
+ * frame time, so below 1000 the target fps is missed and the needed
+ * clock is estimated from frame time scaling with 1/freq. At or above
+ * the target, frames are typically vsync limited and the hint says
+ * nothing about headroom, so the clock is sized to keep the device busy
+ * for frame_busy_target per mille of the time instead. An integral of
+ * the frame time error removes the steady-state offset of both models.
+ * The lowest frequency step that covers the demand is returned.
+ ******************************************************************************/
+
+#define FRAME_INTEGRAL_MAX	2000
+
+static long frame_control_target(struct podgov_info_rec *podgov, long curr,
+				 int avg_hint, int avg_idle)
+{
+	int busy = max(1000 - avg_idle, 0);
+	int err = 1000 - avg_hint;
+	long demand;
+
+	if (avg_hint <= 0)
+		return podgov->freqlist[podgov->freq_count - 1];
+
+	podgov->frame_integral = clamp(podgov->frame_integral + err,
+			-FRAME_INTEGRAL_MAX, FRAME_INTEGRAL_MAX);
+
+	if (avg_hint < 1000 - (int)podgov->p_frame_deadband)
+		demand = 1000000 / avg_hint;
+	else
+		demand = (busy * 1000) /
+			max(podgov->p_frame_busy_target, 1u);
+	demand += (podgov->frame_integral * (int)podgov->p_frame_ki) / 100;
+
+	/* hold the current step inside the deadband */
+	if (demand > 1000 && demand < 1000 + (int)podgov->p_frame_deadband)
+		demand = 1000;
+	demand = clamp(demand, 0L, 4000L);
+
+	trace_podgov_frame_control(curr, avg_hint, busy,
+			podgov->frame_integral, demand);
+
+	return freqlist_up(podgov, (curr / 1000) * demand, 0);
+}
+
+#undef FRAME_INTEGRAL_MAX
+
 /*******************************************************************************
  * nvhost_scale3d_set_throughput_hint(hint)
  *
@@ -609,7 +874,10 @@ void nvhost_scale3d_set_throughput_hint(int hint)
 
 	/* set the target using avg_hint and avg_idle */
 	target = curr;
-	if (avg_hint < podgov->p_hint_lo_limit) {
+	if (podgov->p_frame_control) {
+		target = frame_control_target(podgov, curr, avg_hint,
+				avg_idle);
+	} else if (avg_hint < podgov->p_hint_lo_limit) {
 		target = freqlist_up(podgov, curr, 1);
 	} else {
 		scale_score = avg_idle + avg_hint;
@@ -622,6 +890,7 @@ void nvhost_scale3d_set_throughput_hint(int hint)
 
 	/* clamp and apply target */
 	scaling_limit(df, &target);
+	podgov_log_decision(df, 0, 0, -1, target);
 	if (target != curr) {
 		podgov->block = podgov->p_smooth;
 		trace_podgov_do_scale(df->previous_freq, target);
@@ -643,6 +912,55 @@ EXPORT_SYMBOL(nvhost_scale3d_set_throughput_hint);
 
 #ifdef CONFIG_DEBUG_FS
 
+static int podgov_profile_show(struct seq_file *s, void *unused)
+{
+	struct podgov_info_rec *podgov = s->private;
+	int i;
+
+	mutex_lock(&podgov->power_manager->lock);
+	for (i = 0; i < PODGOV_PROFILE_COUNT; i++)
+		seq_printf(s, "%c %s\n", i == podgov->profile ? '*' : ' ',
+			   podgov_profile_names[i]);
+	mutex_unlock(&podgov->power_manager->lock);
+
+	return 0;
+}
+
+static int podgov_profile_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, podgov_profile_show, inode->i_private);
+}
+
+static ssize_t podgov_profile_write(struct file *file,
+				    const char __user *user_buf,
+				    size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct podgov_info_rec *podgov = s->private;
+	char buf[16];
+	int err;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, user_buf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	mutex_lock(&podgov->power_manager->lock);
+	err = podgov_set_profile(podgov, strim(buf));
+	mutex_unlock(&podgov->power_manager->lock);
+
+	return err ? err : count;
+}
+
+static const struct file_operations podgov_profile_fops = {
+	.open		= podgov_profile_open,
+	.read		= seq_read,
+	.write		= podgov_profile_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void nvhost_scale3d_debug_init(struct devfreq *df)
 {
 	struct podgov_info_rec *podgov = df->data;
@@ -679,7 +997,16 @@ static void nvhost_scale3d_debug_init(struct devfreq *df)
 	CREATE_PODGOV_FILE(scaleup_limit);
 	CREATE_PODGOV_FILE(scaledown_limit);
 	CREATE_PODGOV_FILE(smooth);
+	CREATE_PODGOV_FILE(frame_control);
+	CREATE_PODGOV_FILE(frame_busy_target);
+	CREATE_PODGOV_FILE(frame_deadband);
+	CREATE_PODGOV_FILE(frame_ki);
 #undef CREATE_PODGOV_FILE
+
+	f = debugfs_create_file("profile", S_IRUGO | S_IWUSR,
+			podgov->debugdir, podgov, &podgov_profile_fops);
+	if (NULL == f)
+		pr_err("podgov: can\'t create file profile\n");
 }
 
 static void nvhost_scale3d_debug_deinit(struct devfreq *df)
@@ -797,6 +1124,7 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 
 	/* Sustain local variables */
 	podgov->last_event_type = current_event;
+	podgov->emc_bound = ext_stat->emc_bound;
 	podgov->total_idle += (dev_stat.total_time - dev_stat.busy_time);
 	podgov->last_total_idle += (dev_stat.total_time - dev_stat.busy_time);
 
@@ -829,6 +1157,9 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 
 	}
 
+	podgov_log_decision(df, dev_stat.busy_time, dev_stat.total_time,
+			    current_event, *freq);
+
 	if (!(*freq) || (*freq == df->previous_freq))
 		return GET_TARGET_FREQ_DONTSCALE;
 
@@ -897,7 +1228,13 @@ static int nvhost_pod_init(struct devfreq *df)
 		podgov->p_smooth = 7;
 	}
 	podgov->p_estimation_window = 10000;
+	podgov->p_frame_control = 0;
+	podgov->p_frame_busy_target = 850;
+	podgov->p_frame_deadband = 20;
+	podgov->p_frame_ki = 10;
+	podgov->frame_integral = 0;
 	podgov->adjustment_type = ADJUSTMENT_DEVICE_REQ;
+	podgov_init_profiles(podgov);
 
 	/* Reset clock counters */
 	podgov->last_throughput_hint = now;
@@ -27,6 +27,13 @@
  *
  * 3d.emc clock is scaled proportionately to 3d clock, with a quadratic-
  * bezier-like factor added to pull 3d.emc rate a bit lower.
+ *
+ * The resulting (3d, 3d.emc) rates are kept in a table of operating pairs.
+ * Each 3d rate has a balanced pair using the emc curve above, and a
+ * bandwidth pair that requests the emc rate of a higher 3d step. The
+ * bandwidth pair is used while the EMC activity monitor reports the memory
+ * as saturated and 3d is busy: 3d is then waiting on memory, and raising
+ * emc helps where raising the 3d clock would not.
  */
 
 #include <linux/devfreq.h>
@@ -34,6 +41,7 @@
 #include <linux/types.h>
 #include <linux/clk.h>
 #include <linux/export.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 
 #include <chip_support.h>
@@ -49,9 +57,25 @@
 #include "scale3d_actmon.h"
 #include "dev.h"
 #include "nvhost_acm.h"
+#include "nvhost_scale.h"
 
 #define POW2(x) ((x) * (x))
 
+#define SCALE3D_BOUND_STEPS	2	/* emc boost of the bandwidth pairs */
+#define SCALE3D_BOUND_LOAD	900	/* emc load (per mille) to be bound */
+#define SCALE3D_BOUND_BUSY	700	/* 3d load (per mille) to be bound */
+
+/*******************************************************************************
+ * scale3d_opp - (3d, 3d.emc) operating pair and the time spent at it
+ ******************************************************************************/
+
+struct scale3d_opp {
+	unsigned long			rate_3d;
+	unsigned long			rate_emc;
+	u64				time_us;
+	unsigned int			entries;
+};
+
 static int nvhost_scale3d_target(struct device *d, unsigned long *freq,
 					u32 flags);
 
@@ -81,6 +105,19 @@ struct power_profile_gr3d {
 	ktime_t				last_request_time;
 
 	int				last_event_type;
+
+	/* steps balanced pairs followed by steps bandwidth pairs */
+	struct scale3d_opp		*opp;
+	int				opp_steps;
+	int				cur_opp;
+	ktime_t				opp_since;
+	spinlock_t			opp_lock;
+
+	int				emc_bound;
+	u32				emc_bound_load;
+	u32				emc_bound_busy;
+
+	struct dentry			*debugdir;
 };
 
 /*******************************************************************************
@@ -147,6 +184,85 @@ void nvhost_scale3d_actmon_notify_busy(struct platform_device *dev)
 	nvhost_scale3d_notify(dev, 1);
 }
 
+/*******************************************************************************
+ * nvhost_scale3d_emc_rate(rate_3d)
+ *
+ * Balanced 3d.emc rate for the given 3d rate (see calibrate_emc() below)
+ ******************************************************************************/
+
+static unsigned long nvhost_scale3d_emc_rate(long rate_3d)
+{
+	long hz;
+
+	hz = rate_3d * power_profile.emc_slope + power_profile.emc_offset;
+	hz -= (power_profile.emc_dip_slope *
+		POW2(rate_3d / 1000 - power_profile.emc_xmid) +
+		power_profile.emc_dip_offset);
+
+	return (hz < 0) ? 0 : hz;
+}
+
+/*******************************************************************************
+ * nvhost_scale3d_find_opp(rate_3d, bound)
+ *
+ * Find the operating pair for the given 3d rate
+ ******************************************************************************/
+
+static int nvhost_scale3d_find_opp(unsigned long rate_3d, int bound)
+{
+	int i;
+
+	for (i = 0; i < power_profile.opp_steps - 1; i++)
+		if (power_profile.opp[i].rate_3d >= rate_3d)
+			break;
+
+	return bound ? i + power_profile.opp_steps : i;
+}
+
+/*******************************************************************************
+ * nvhost_scale3d_set_opp(idx)
+ *
+ * Account the time spent at the previous operating pair and switch to idx
+ ******************************************************************************/
+
+static void nvhost_scale3d_set_opp(int idx)
+{
+	unsigned long flags;
+	ktime_t now = ktime_get();
+
+	spin_lock_irqsave(&power_profile.opp_lock, flags);
+	power_profile.opp[power_profile.cur_opp].time_us +=
+		ktime_us_delta(now, power_profile.opp_since);
+	power_profile.opp_since = now;
+	if (idx != power_profile.cur_opp) {
+		power_profile.opp[idx].entries++;
+		power_profile.cur_opp = idx;
+	}
+	spin_unlock_irqrestore(&power_profile.opp_lock, flags);
+}
+
+/*******************************************************************************
+ * nvhost_scale3d_set_emc(rate_3d)
+ *
+ * Set the 3d.emc rate of the operating pair matching the 3d rate
+ ******************************************************************************/
+
+static void nvhost_scale3d_set_emc(long rate_3d)
+{
+	unsigned long hz;
+	int opp;
+
+	if (power_profile.opp) {
+		opp = nvhost_scale3d_find_opp(rate_3d, power_profile.emc_bound);
+		nvhost_scale3d_set_opp(opp);
+		hz = power_profile.opp[opp].rate_emc;
+	} else
+		hz = nvhost_scale3d_emc_rate(rate_3d);
+
+	nvhost_module_set_devfreq_rate(power_profile.dev,
+				clk_to_idx(power_profile.clk_3d_emc), hz);
+}
+
 /*******************************************************************************
  * nvhost_scale3d_target(dev, *freq, flags)
  *
@@ -156,8 +272,9 @@ void nvhost_scale3d_actmon_notify_busy(struct platform_device *dev)
 static int nvhost_scale3d_target(struct device *d, unsigned long *freq,
 				u32 flags)
 {
-	long hz;
 	long after;
+	int opp = -1;
+	ktime_t start;
 
 	/* Inform that the clock is disabled */
 	if (!tegra_is_clk_enabled(power_profile.clk_3d)) {
@@ -171,11 +288,15 @@ static int nvhost_scale3d_target(struct device *d, unsigned long *freq,
 	else if (*freq > power_profile.max_rate_3d)
 		*freq = power_profile.max_rate_3d;
 
-	/* Check if we're already running at the desired speed */
-	if (*freq == clk_get_rate(power_profile.clk_3d))
+	/* Check if we're already running at the desired operating pair */
+	if (power_profile.opp)
+		opp = nvhost_scale3d_find_opp(*freq, power_profile.emc_bound);
+	if (*freq == clk_get_rate(power_profile.clk_3d) &&
+	    (!power_profile.opp || opp == power_profile.cur_opp))
 		return 0;
 
 	/* Set GPU clockrate */
+	start = ktime_get();
 	if (tegra_get_chipid() == TEGRA_CHIPID_TEGRA3)
 		nvhost_module_set_devfreq_rate(power_profile.dev,
 					clk_to_idx(power_profile.clk_3d2), 0);
@@ -184,18 +305,11 @@ static int nvhost_scale3d_target(struct device *d, unsigned long *freq,
 
 	/* Set EMC clockrate */
 	after = (long) clk_get_rate(power_profile.clk_3d);
-	hz = after * power_profile.emc_slope +
-		power_profile.emc_offset;
-
-	hz -= (power_profile.emc_dip_slope *
-		POW2(after / 1000 - power_profile.emc_xmid) +
-		power_profile.emc_dip_offset);
-	hz = (hz < 0) ? 0 : hz;
-	nvhost_module_set_devfreq_rate(power_profile.dev,
-				clk_to_idx(power_profile.clk_3d_emc), hz);
+	nvhost_scale3d_set_emc(after);
 
 	/* Get the new clockrate */
 	*freq = clk_get_rate(power_profile.clk_3d);
+	nvhost_scale_stats_transition(power_profile.dev, *freq, start);
 
 	return 0;
 }
@@ -215,6 +329,7 @@ static int nvhost_scale3d_get_dev_status(struct device *d,
 	struct nvhost_devfreq_ext_stat *ext_stat =
 		power_profile.dev_stat->private_data;
 	u32 avg = 0;
+	int emc_load, bound;
 	ktime_t t;
 
 	/* Make sure there are correct values for the current frequency */
@@ -234,6 +349,21 @@ static int nvhost_scale3d_get_dev_status(struct device *d,
 	stat->busy_time = (avg * stat->total_time) / 1000;
 	power_profile.last_request_time = t;
 
+	/* 3d is bandwidth bound if it is busy while the memory is saturated */
+	emc_load = tegra_actmon_emc_load();
+	bound = emc_load >= power_profile.emc_bound_load &&
+		avg >= power_profile.emc_bound_busy;
+
+	/* The governor may keep the 3d rate, so move to the new pair here */
+	if (bound != power_profile.emc_bound) {
+		power_profile.emc_bound = bound;
+		if (power_profile.opp &&
+		    tegra_is_clk_enabled(power_profile.clk_3d))
+			nvhost_scale3d_set_emc(
+				clk_get_rate(power_profile.clk_3d));
+	}
+	ext_stat->emc_bound = bound;
+
 	/* Finally, clear out the local values */
 	power_profile.dev_stat->total_time = 0;
 	power_profile.dev_stat->busy_time = 0;
@@ -332,6 +462,115 @@ static void nvhost_scale3d_calibrate_emc(void)
 	power_profile.emc_dip_offset -= correction;
 }
 
+/*******************************************************************************
+ * nvhost_scale3d_init_opp(rates, steps)
+ *
+ * Build the table of operating pairs from the 3d frequency steps. Without
+ * the table 3d.emc simply follows the balanced curve.
+ ******************************************************************************/
+
+static void nvhost_scale3d_init_opp(unsigned long *rates, int steps)
+{
+	int i, j;
+
+	if (!steps)
+		return;
+
+	power_profile.opp = kzalloc(2 * steps * sizeof(*power_profile.opp),
+				    GFP_KERNEL);
+	if (!power_profile.opp)
+		return;
+
+	for (i = 0; i < steps; i++) {
+		j = min(i + SCALE3D_BOUND_STEPS, steps - 1);
+		power_profile.opp[i].rate_3d = rates[i];
+		power_profile.opp[i].rate_emc =
+			nvhost_scale3d_emc_rate(rates[i]);
+		power_profile.opp[steps + i].rate_3d = rates[i];
+		power_profile.opp[steps + i].rate_emc =
+			nvhost_scale3d_emc_rate(rates[j]);
+	}
+
+	spin_lock_init(&power_profile.opp_lock);
+	power_profile.opp_steps = steps;
+	power_profile.cur_opp = steps - 1;
+	power_profile.opp_since = ktime_get();
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int nvhost_scale3d_opp_show(struct seq_file *s, void *unused)
+{
+	unsigned long flags;
+	int i;
+
+	seq_printf(s, "    3d (kHz)  emc (kHz)  bound  entries  time (ms)\n");
+
+	spin_lock_irqsave(&power_profile.opp_lock, flags);
+	for (i = 0; i < 2 * power_profile.opp_steps; i++) {
+		struct scale3d_opp *opp = &power_profile.opp[i];
+		u64 time_us = opp->time_us;
+
+		if (i == power_profile.cur_opp)
+			time_us += ktime_us_delta(ktime_get(),
+					power_profile.opp_since);
+		seq_printf(s, "%c %10lu %10lu %6d %8u %10llu\n",
+			i == power_profile.cur_opp ? '*' : ' ',
+			opp->rate_3d / 1000, opp->rate_emc / 1000,
+			i >= power_profile.opp_steps, opp->entries,
+			div_u64(time_us, 1000));
+	}
+	spin_unlock_irqrestore(&power_profile.opp_lock, flags);
+
+	return 0;
+}
+
+static int nvhost_scale3d_opp_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvhost_scale3d_opp_show, inode->i_private);
+}
+
+static const struct file_operations nvhost_scale3d_opp_fops = {
+	.open		= nvhost_scale3d_opp_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void nvhost_scale3d_debug_init(struct nvhost_device_data *pdata)
+{
+	struct dentry *d;
+
+	if (!power_profile.opp)
+		return;
+
+	d = debugfs_create_dir("emc_scaling", pdata->debugfs);
+	if (!d)
+		return;
+	power_profile.debugdir = d;
+
+	debugfs_create_file("pairs", S_IRUGO, d, NULL,
+			    &nvhost_scale3d_opp_fops);
+	debugfs_create_u32("bound_load", S_IRUGO | S_IWUSR, d,
+			   &power_profile.emc_bound_load);
+	debugfs_create_u32("bound_busy", S_IRUGO | S_IWUSR, d,
+			   &power_profile.emc_bound_busy);
+}
+
+static void nvhost_scale3d_debug_deinit(void)
+{
+	debugfs_remove_recursive(power_profile.debugdir);
+	power_profile.debugdir = NULL;
+}
+#else
+static void nvhost_scale3d_debug_init(struct nvhost_device_data *pdata)
+{
+}
+
+static void nvhost_scale3d_debug_deinit(void)
+{
+}
+#endif
+
 /*******************************************************************************
  * nvhost_scale3d_init(dev)
  *
@@ -343,6 +582,8 @@ void nvhost_scale3d_actmon_init(struct platform_device *dev)
 {
 	struct nvhost_devfreq_ext_stat *ext_stat;
 	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	unsigned long rates[NVHOST_SCALE_MAX_STEPS];
+	int steps;
 
 	if (power_profile.init)
 		return;
@@ -388,12 +629,24 @@ void nvhost_scale3d_actmon_init(struct platform_device *dev)
 
 	nvhost_scale3d_calibrate_emc();
 
+	power_profile.emc_bound = 0;
+	power_profile.emc_bound_load = SCALE3D_BOUND_LOAD;
+	power_profile.emc_bound_busy = SCALE3D_BOUND_BUSY;
+	steps = nvhost_scale_freq_steps(clk_get_parent(power_profile.clk_3d),
+					power_profile.max_rate_3d, rates,
+					NVHOST_SCALE_MAX_STEPS);
+	nvhost_scale3d_init_opp(rates, steps);
+
 	/* Start using devfreq */
 	pdata->power_manager = devfreq_add_device(&dev->dev,
 				&nvhost_scale3d_devfreq_profile,
 				&nvhost_podgov,
 				NULL);
 
+	nvhost_scale3d_debug_init(pdata);
+	nvhost_scale_stats_init(dev, rates, steps,
+				clk_get_rate(power_profile.clk_3d));
+
 	power_profile.init = 1;
 	return;
 
@@ -419,9 +672,15 @@ void nvhost_scale3d_actmon_deinit(struct platform_device *dev)
 	if (!power_profile.init)
 		return;
 
+	nvhost_scale3d_debug_deinit();
+	nvhost_scale_stats_deinit(dev);
+
 	if (pdata->power_manager)
 		devfreq_remove_device(pdata->power_manager);
 
+	kfree(power_profile.opp);
+	power_profile.opp = NULL;
+
 	kfree(power_profile.dev_stat->private_data);
 	kfree(power_profile.dev_stat);
 
@@ -38,6 +38,7 @@
 #include "nvhost_acm.h"
 #include "nvhost_channel.h"
 #include "nvhost_job.h"
+#include "nvhost_sync.h"
 #include "chip_support.h"
 
 #define DRIVER_NAME		"host1x"
@@ -133,6 +134,56 @@ static int nvhost_ioctl_ctrl_syncpt_waitex(struct nvhost_ctrl_userctx *ctx,
 	return err;
 }
 
+static int nvhost_ioctl_ctrl_syncpt_wait_multi(struct nvhost_ctrl_userctx *ctx,
+	struct nvhost_ctrl_syncpt_wait_multi_args *args)
+{
+	struct nvhost_ctrl_syncpt_fence fences[NVHOST_SYNCPT_WAIT_MULTI_MAX];
+	u32 timeout;
+
+	if (!args->num_fences ||
+	    args->num_fences > NVHOST_SYNCPT_WAIT_MULTI_MAX)
+		return -EINVAL;
+	if (copy_from_user(fences, (void __user *)args->fences,
+			   args->num_fences * sizeof(*fences)))
+		return -EFAULT;
+
+	if (args->timeout == NVHOST_NO_TIMEOUT)
+		timeout = MAX_SCHEDULE_TIMEOUT;
+	else
+		timeout = (u32)msecs_to_jiffies(args->timeout);
+
+	return nvhost_syncpt_wait_multi(&ctx->dev->syncpt, fences,
+			args->num_fences,
+			!!(args->flags & NVHOST_SYNCPT_WAIT_MULTI_ALL),
+			timeout, &args->index, &args->value);
+}
+
+static int nvhost_ioctl_ctrl_sync_fence_create(struct nvhost_ctrl_userctx *ctx,
+	struct nvhost_ctrl_sync_fence_create_args *args)
+{
+	struct nvhost_ctrl_syncpt_fence pts[NVHOST_SYNCPT_WAIT_MULTI_MAX];
+	char name[32];
+	const char __user *args_name =
+		(const char __user *)(uintptr_t)args->name;
+
+	if (!args->num_pts || args->num_pts > NVHOST_SYNCPT_WAIT_MULTI_MAX)
+		return -EINVAL;
+	if (copy_from_user(pts, (void __user *)(uintptr_t)args->pts,
+			   args->num_pts * sizeof(*pts)))
+		return -EFAULT;
+
+	if (args_name) {
+		if (strncpy_from_user(name, args_name, sizeof(name)) < 0)
+			return -EFAULT;
+		name[sizeof(name) - 1] = '\0';
+	} else {
+		name[0] = '\0';
+	}
+
+	return nvhost_sync_create_fence(&ctx->dev->syncpt, pts, args->num_pts,
+			name, &args->fence_fd);
+}
+
 static int nvhost_ioctl_ctrl_module_mutex(struct nvhost_ctrl_userctx *ctx,
 	struct nvhost_ctrl_module_mutex_args *args)
 {
@@ -274,6 +325,12 @@ static long nvhost_ctrlctl(struct file *filp,
 	case NVHOST_IOCTL_CTRL_SYNCPT_READ_MAX:
 		err = nvhost_ioctl_ctrl_syncpt_read_max(priv, (void *)buf);
 		break;
+	case NVHOST_IOCTL_CTRL_SYNCPT_WAIT_MULTI:
+		err = nvhost_ioctl_ctrl_syncpt_wait_multi(priv, (void *)buf);
+		break;
+	case NVHOST_IOCTL_CTRL_SYNC_FENCE_CREATE:
+		err = nvhost_ioctl_ctrl_sync_fence_create(priv, (void *)buf);
+		break;
 	default:
 		err = -ENOTTY;
 		break;
@@ -372,6 +429,8 @@ static void nvhost_free_resources(struct nvhost_master *host)
 {
 	kfree(host->intr.syncpt);
 	host->intr.syncpt = 0;
+	kfree(host->intr.syncpt_pending);
+	host->intr.syncpt_pending = NULL;
 }
 
 static int __devinit nvhost_alloc_resources(struct nvhost_master *host)
@@ -386,7 +445,11 @@ static int __devinit nvhost_alloc_resources(struct nvhost_master *host)
 				    nvhost_syncpt_nb_pts(&host->syncpt),
 				    GFP_KERNEL);
 
-	if (!host->intr.syncpt) {
+	host->intr.syncpt_pending = kzalloc(sizeof(unsigned long) *
+			BITS_TO_LONGS(nvhost_syncpt_nb_pts(&host->syncpt)),
+			GFP_KERNEL);
+
+	if (!host->intr.syncpt || !host->intr.syncpt_pending) {
 		/* frees happen in the support removal phase */
 		return -ENOMEM;
 	}
@@ -20,6 +20,8 @@
 
 #include <linux/slab.h>
 #include <linux/scatterlist.h>
+#include <linux/log2.h>
+#include <linux/moduleparam.h>
 #include "nvhost_acm.h"
 #include "nvhost_cdma.h"
 #include "nvhost_channel.h"
@@ -40,6 +42,16 @@ static inline u32 host1x_channel_dmactrl(int stop, int get_rst, int init_get)
 
 static void cdma_timeout_handler(struct work_struct *work);
 
+/* push buffer slots a channel starts with, and the most it may grow to */
+static unsigned int pb_slots = NVHOST_GATHER_QUEUE_SIZE;
+module_param(pb_slots, uint, 0444);
+MODULE_PARM_DESC(pb_slots, "Initial push buffer size in slots");
+
+static unsigned int pb_max_slots = NVHOST_GATHER_QUEUE_MAX_SIZE;
+module_param(pb_max_slots, uint, 0644);
+MODULE_PARM_DESC(pb_max_slots,
+	"Push buffer size in slots beyond which it is not grown");
+
 /*
  * push_buffer
  *
@@ -54,28 +66,48 @@ static void cdma_timeout_handler(struct work_struct *work);
  */
 static void push_buffer_reset(struct push_buffer *pb)
 {
-	pb->fence = PUSH_BUFFER_SIZE - 8;
+	pb->fence = pb->size - 8;
 	pb->cur = 0;
 }
 
 /**
- * Init push buffer resources
+ * Release the memory backing a push buffer
  */
-static void push_buffer_destroy(struct push_buffer *pb);
-static int push_buffer_init(struct push_buffer *pb)
+static void __push_buffer_free(struct push_buffer *pb, struct mem_mgr *mgr)
+{
+	if (pb->mapped)
+		mem_op().munmap(pb->mem, pb->mapped);
+
+	if (pb->phys != 0)
+		mem_op().unpin(mgr, pb->mem, pb->sgt);
+
+	if (pb->mem)
+		mem_op().put(mgr, pb->mem);
+
+	kfree(pb->client_handle);
+
+	pb->mem = NULL;
+	pb->mapped = NULL;
+	pb->phys = 0;
+	pb->client_handle = 0;
+}
+
+/**
+ * Allocate and map an empty push buffer of the given number of slots
+ */
+static int __push_buffer_alloc(struct push_buffer *pb, struct mem_mgr *mgr,
+		u32 slots)
 {
-	struct nvhost_cdma *cdma = pb_to_cdma(pb);
-	struct mem_mgr *mgr = cdma_to_memmgr(cdma);
 	pb->mem = NULL;
 	pb->mapped = NULL;
 	pb->phys = 0;
 	pb->client_handle = NULL;
+	pb->size = slots * 8;
 
-	BUG_ON(!cdma_pb_op().reset);
-	cdma_pb_op().reset(pb);
+	push_buffer_reset(pb);
 
 	/* allocate and map pushbuffer memory */
-	pb->mem = mem_op().alloc(mgr, PUSH_BUFFER_SIZE + 4, 32,
+	pb->mem = mem_op().alloc(mgr, pb->size + 4, 32,
 			      mem_mgr_flag_write_combine);
 	if (IS_ERR_OR_NULL(pb->mem)) {
 		pb->mem = NULL;
@@ -96,45 +128,43 @@ static int push_buffer_init(struct push_buffer *pb)
 	pb->phys = sg_dma_address(pb->sgt->sgl);
 
 	/* memory for storing nvmap client and handles for each opcode pair */
-	pb->client_handle = kzalloc(NVHOST_GATHER_QUEUE_SIZE *
-				sizeof(struct mem_mgr_handle),
+	pb->client_handle = kzalloc(slots * sizeof(struct mem_mgr_handle),
 			GFP_KERNEL);
 	if (!pb->client_handle)
 		goto fail;
 
 	/* put the restart at the end of pushbuffer memory */
-	*(pb->mapped + (PUSH_BUFFER_SIZE >> 2)) =
+	*(pb->mapped + (pb->size >> 2)) =
 		nvhost_opcode_restart(pb->phys);
 
 	return 0;
 
 fail:
-	push_buffer_destroy(pb);
+	__push_buffer_free(pb, mgr);
 	return -ENOMEM;
 }
 
 /**
- * Clean up push buffer resources
+ * Init push buffer resources
  */
-static void push_buffer_destroy(struct push_buffer *pb)
+static int push_buffer_init(struct push_buffer *pb)
 {
 	struct nvhost_cdma *cdma = pb_to_cdma(pb);
-	struct mem_mgr *mgr = cdma_to_memmgr(cdma);
-	if (pb->mapped)
-		mem_op().munmap(pb->mem, pb->mapped);
-
-	if (pb->phys != 0)
-		mem_op().unpin(mgr, pb->mem, pb->sgt);
+	u32 slots = clamp_t(u32, pb_slots, NVHOST_GATHER_QUEUE_SIZE,
+			NVHOST_GATHER_QUEUE_MAX_SIZE);
 
-	if (pb->mem)
-		mem_op().put(mgr, pb->mem);
+	return __push_buffer_alloc(pb, cdma_to_memmgr(cdma),
+			rounddown_pow_of_two(slots));
+}
 
-	kfree(pb->client_handle);
+/**
+ * Clean up push buffer resources
+ */
+static void push_buffer_destroy(struct push_buffer *pb)
+{
+	struct nvhost_cdma *cdma = pb_to_cdma(pb);
 
-	pb->mem = NULL;
-	pb->mapped = NULL;
-	pb->phys = 0;
-	pb->client_handle = 0;
+	__push_buffer_free(pb, cdma_to_memmgr(cdma));
 }
 
 /**
@@ -147,13 +177,13 @@ static void push_buffer_push_to(struct push_buffer *pb,
 {
 	u32 cur = pb->cur;
 	u32 *p = (u32 *)((u32)pb->mapped + cur);
-	u32 cur_nvmap = (cur/8) & (NVHOST_GATHER_QUEUE_SIZE - 1);
+	u32 cur_nvmap = (cur/8) & (pb->size / 8 - 1);
 	BUG_ON(cur == pb->fence);
 	*(p++) = op1;
 	*(p++) = op2;
 	pb->client_handle[cur_nvmap].client = client;
 	pb->client_handle[cur_nvmap].handle = handle;
-	pb->cur = (cur + 8) & (PUSH_BUFFER_SIZE - 1);
+	pb->cur = (cur + 8) & (pb->size - 1);
 }
 
 /**
@@ -168,13 +198,13 @@ static void push_buffer_pop_from(struct push_buffer *pb,
 	u32 fence_nvmap = pb->fence/8;
 	for (i = 0; i < slots; i++) {
 		int cur_fence_nvmap = (fence_nvmap+i)
-				& (NVHOST_GATHER_QUEUE_SIZE - 1);
+				& (pb->size / 8 - 1);
 		struct mem_mgr_handle *h = &pb->client_handle[cur_fence_nvmap];
 		h->client = NULL;
 		h->handle = NULL;
 	}
 	/* Advance the next write position */
-	pb->fence = (pb->fence + slots * 8) & (PUSH_BUFFER_SIZE - 1);
+	pb->fence = (pb->fence + slots * 8) & (pb->size - 1);
 }
 
 /**
@@ -182,7 +212,7 @@ static void push_buffer_pop_from(struct push_buffer *pb,
  */
 static u32 push_buffer_space(struct push_buffer *pb)
 {
-	return ((pb->fence - pb->cur) & (PUSH_BUFFER_SIZE - 1)) / 8;
+	return ((pb->fence - pb->cur) & (pb->size - 1)) / 8;
 }
 
 static u32 push_buffer_putptr(struct push_buffer *pb)
@@ -258,7 +288,7 @@ static void cdma_timeout_cpu_incr(struct nvhost_cdma *cdma, u32 getptr,
 		*(p++) = NVHOST_OPCODE_NOOP;
 		dev_dbg(&dev->dev->dev, "%s: NOP at 0x%x\n",
 			__func__, pb->phys + getidx);
-		getidx = (getidx + 8) & (PUSH_BUFFER_SIZE - 1);
+		getidx = (getidx + 8) & (pb->size - 1);
 	}
 	wmb();
 }
@@ -360,6 +390,45 @@ static void cdma_kick(struct nvhost_cdma *cdma)
 	}
 }
 
+/**
+ * Replace the push buffer with one twice the size. Called with the cdma
+ * lock held and the sync queue empty, so nothing in the old buffer is
+ * still referenced once DMA has fetched up to PUT.
+ */
+static int cdma_grow_push_buffer(struct nvhost_cdma *cdma)
+{
+	struct push_buffer *pb = &cdma->push_buffer;
+	struct mem_mgr *mgr = cdma_to_memmgr(cdma);
+	void __iomem *chan_regs = cdma_to_channel(cdma)->aperture;
+	struct push_buffer new_pb;
+	u32 slots = pb->size / 8 * 2;
+	int err;
+
+	if (slots > min_t(u32, pb_max_slots, NVHOST_GATHER_QUEUE_MAX_SIZE))
+		return -ENOSPC;
+
+	/* trailing methods of the last job may still be in flight */
+	if (cdma->running &&
+	    readl(chan_regs + host1x_channel_dmaget_r()) != cdma->last_put)
+		return -EBUSY;
+
+	err = __push_buffer_alloc(&new_pb, mgr, slots);
+	if (err)
+		return err;
+
+	/* stop DMA so that cdma_start() reloads GET in the new buffer */
+	if (cdma->running) {
+		writel(host1x_channel_dmactrl(true, false, false),
+			chan_regs + host1x_channel_dmactrl_r());
+		cdma->running = false;
+	}
+
+	__push_buffer_free(pb, mgr);
+	*pb = new_pb;
+
+	return 0;
+}
+
 static void cdma_stop(struct nvhost_cdma *cdma)
 {
 	void __iomem *chan_regs = cdma_to_channel(cdma)->aperture;
@@ -507,6 +576,7 @@ static const struct nvhost_cdma_ops host1x_cdma_ops = {
 	.start = cdma_start,
 	.stop = cdma_stop,
 	.kick = cdma_kick,
+	.grow_push_buffer = cdma_grow_push_buffer,
 
 	.timeout_init = cdma_timeout_init,
 	.timeout_destroy = cdma_timeout_destroy,
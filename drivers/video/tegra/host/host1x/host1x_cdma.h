@@ -25,12 +25,12 @@
  * many command buffers. If it is too large, we waste memory. */
 #define NVHOST_SYNC_QUEUE_SIZE 512
 
-/* Number of gathers we allow to be queued up per channel. Must be a
- * power of two. Currently sized such that pushbuffer is 4KB (512*8B). */
+/* Number of gathers we allow to be queued up per channel by default. Must
+ * be a power of two. Currently sized such that pushbuffer is 4KB (512*8B). */
 #define NVHOST_GATHER_QUEUE_SIZE 512
 
-/* 8 bytes per slot. (This number does not include the final RESTART.) */
-#define PUSH_BUFFER_SIZE (NVHOST_GATHER_QUEUE_SIZE * 8)
+/* Upper bound for the push buffer when it is grown on demand */
+#define NVHOST_GATHER_QUEUE_MAX_SIZE 8192
 
 /* 4K page containing GATHERed methods to increment channel syncpts
  * and replaces the original timed out contexts GATHER slots */
@@ -24,6 +24,7 @@
 #include "nvhost_job.h"
 #include "nvhost_hwctx.h"
 #include <trace/events/nvhost.h>
+#include <linux/input/frame_trace.h>
 #include <linux/slab.h>
 
 #include "host1x_hwctx.h"
@@ -51,6 +52,16 @@ static void sync_waitbases(struct nvhost_channel *ch, u32 syncpt_val)
 	}
 }
 
+/*
+ * A job which sends nothing to the unit leaves its registers alone, so it
+ * does not need its own context loaded and whichever context is resident
+ * can stay resident.
+ */
+static bool job_needs_ctx(struct nvhost_job *job)
+{
+	return !job->null_kickoff && job->num_gathers;
+}
+
 static void *pre_submit_ctxsave(struct nvhost_job *job,
 		struct nvhost_hwctx *cur_ctx)
 {
@@ -106,6 +117,7 @@ static void submit_ctxsave(struct nvhost_job *job, void *ctxsave_waiter,
 
 	/* Send the save to channel */
 	cur_ctx->valid = true;
+	cur_ctx->save_count++;
 	ch->ctxhandler->save_push(cur_ctx, &ch->cdma);
 	nvhost_job_get_hwctx(job, cur_ctx);
 
@@ -143,6 +155,7 @@ static void submit_ctxrestore(struct nvhost_job *job)
 			ctx->restore_incrs);
 
 	/* Send restore buffer to channel */
+	ctx->hwctx.restore_count++;
 	nvhost_cdma_push_gather(&ch->cdma,
 		host->memmgr,
 		ctx->restore,
@@ -226,7 +239,12 @@ static void submit_gathers(struct nvhost_job *job)
 	}
 }
 
-static int host1x_channel_submit(struct nvhost_job *job)
+/*
+ * Queue one job into the push buffer. Called with ch->submitlock held.
+ * Unless kick is set the DMA PUT pointer is left alone, and the caller
+ * is responsible for kicking once it has queued all its jobs.
+ */
+static int host1x_channel_submit_locked(struct nvhost_job *job, bool kick)
 {
 	struct nvhost_channel *ch = job->ch;
 	struct nvhost_syncpt *sp = &nvhost_get_host(job->ch->dev)->syncpt;
@@ -236,6 +254,7 @@ static int host1x_channel_submit(struct nvhost_job *job)
 	int err;
 	void *completed_waiter = NULL, *ctxsave_waiter = NULL;
 	struct nvhost_device_data *pdata = platform_get_drvdata(ch->dev);
+	bool switch_ctx = job_needs_ctx(job);
 
 	/* Bail out on timed out contexts */
 	if (job->hwctx && job->hwctx->has_timedout)
@@ -248,37 +267,25 @@ static int host1x_channel_submit(struct nvhost_job *job)
 	prev_max = job->syncpt_end =
 		nvhost_syncpt_read_max(sp, job->syncpt_id);
 
-	/* get submit lock */
-	err = mutex_lock_interruptible(&ch->submitlock);
-	if (err) {
-		nvhost_module_idle(ch->dev);
-		goto error;
-	}
-
 	/* Do the needed allocations */
-	ctxsave_waiter = pre_submit_ctxsave(job, ch->cur_ctx);
+	if (switch_ctx)
+		ctxsave_waiter = pre_submit_ctxsave(job, ch->cur_ctx);
 	if (IS_ERR(ctxsave_waiter)) {
 		err = PTR_ERR(ctxsave_waiter);
-		nvhost_module_idle(ch->dev);
-		mutex_unlock(&ch->submitlock);
+		ctxsave_waiter = NULL;
 		goto error;
 	}
 
 	completed_waiter = nvhost_intr_alloc_waiter();
 	if (!completed_waiter) {
-		nvhost_module_idle(ch->dev);
-		mutex_unlock(&ch->submitlock);
 		err = -ENOMEM;
 		goto error;
 	}
 
 	/* begin a CDMA submit */
 	err = nvhost_cdma_begin(&ch->cdma, job);
-	if (err) {
-		mutex_unlock(&ch->submitlock);
-		nvhost_module_idle(ch->dev);
+	if (err)
 		goto error;
-	}
 
 	if (pdata->serialize) {
 		/* Force serialization by inserting a host wait for the
@@ -292,14 +299,19 @@ static int host1x_channel_submit(struct nvhost_job *job)
 						job->syncpt_id)));
 	}
 
-	submit_ctxsave(job, ctxsave_waiter, ch->cur_ctx);
-	submit_ctxrestore(job);
-	ch->cur_ctx = job->hwctx;
+	if (switch_ctx) {
+		submit_ctxsave(job, ctxsave_waiter, ch->cur_ctx);
+		submit_ctxrestore(job);
+		ch->cur_ctx = job->hwctx;
+	} else if (job->hwctx && job->hwctx != ch->cur_ctx) {
+		job->hwctx->skip_count++;
+	}
 
 	syncval = nvhost_syncpt_incr_max(sp,
 			job->syncpt_id, user_syncpt_incrs);
 
 	job->syncpt_end = syncval;
+	job->frame = frame_trace_current();
 
 	/* add a setclass for modules that require it */
 	if (pdata->class)
@@ -315,10 +327,14 @@ static int host1x_channel_submit(struct nvhost_job *job)
 	sync_waitbases(ch, job->syncpt_end);
 
 	/* end CDMA submit & stash pinned hMems into sync queue */
-	nvhost_cdma_end(&ch->cdma, job);
+	if (kick)
+		nvhost_cdma_end(&ch->cdma, job);
+	else
+		nvhost_cdma_end_nokick(&ch->cdma, job);
 
 	trace_nvhost_channel_submitted(ch->dev->name,
 			prev_max, syncval);
+	frame_trace_submit(ch->dev->name, job->frame, job->syncpt_id, syncval);
 
 	/* schedule a submit complete interrupt */
 	err = nvhost_intr_add_action(&nvhost_get_host(ch->dev)->intr,
@@ -329,13 +345,61 @@ static int host1x_channel_submit(struct nvhost_job *job)
 	completed_waiter = NULL;
 	WARN(err, "Failed to set submit complete interrupt");
 
-	mutex_unlock(&ch->submitlock);
-
 	return 0;
 
 error:
-	kfree(ctxsave_waiter);
-	kfree(completed_waiter);
+	nvhost_module_idle(ch->dev);
+	nvhost_intr_free_waiter(ctxsave_waiter);
+	nvhost_intr_free_waiter(completed_waiter);
+	return err;
+}
+
+static int host1x_channel_submit(struct nvhost_job *job)
+{
+	struct nvhost_channel *ch = job->ch;
+	int err;
+
+	/* get submit lock */
+	err = mutex_lock_interruptible(&ch->submitlock);
+	if (err)
+		return err;
+
+	err = host1x_channel_submit_locked(job, true);
+
+	mutex_unlock(&ch->submitlock);
+	return err;
+}
+
+/*
+ * Queue jobs back to back under one hold of the submit lock and kick DMA
+ * once at the end. Stops at the first job that fails; *submitted is the
+ * number of jobs queued before it.
+ */
+static int host1x_channel_submit_batch(struct nvhost_job **jobs,
+		int num_jobs, int *submitted)
+{
+	struct nvhost_channel *ch = jobs[0]->ch;
+	int err;
+	int i;
+
+	*submitted = 0;
+
+	err = mutex_lock_interruptible(&ch->submitlock);
+	if (err)
+		return err;
+
+	for (i = 0; i < num_jobs; i++) {
+		err = host1x_channel_submit_locked(jobs[i], false);
+		if (err)
+			break;
+	}
+
+	if (i)
+		nvhost_cdma_kick(&ch->cdma);
+
+	mutex_unlock(&ch->submitlock);
+
+	*submitted = i;
 	return err;
 }
 
@@ -416,6 +480,7 @@ static int host1x_save_context(struct nvhost_channel *ch)
 	}
 
 	hwctx_to_save->valid = true;
+	hwctx_to_save->save_count++;
 	ch->cur_ctx = NULL;
 	syncpt_id = to_host1x_hwctx_handler(hwctx_to_save->h)->syncpt;
 
@@ -465,8 +530,8 @@ static int host1x_save_context(struct nvhost_channel *ch)
 	mutex_unlock(&ch->submitlock);
 
 done:
-	kfree(ctx_waiter);
-	kfree(wakeup_waiter);
+	nvhost_intr_free_waiter(ctx_waiter);
+	nvhost_intr_free_waiter(wakeup_waiter);
 	return err;
 }
 
@@ -511,6 +576,7 @@ static int host1x_channel_init(struct nvhost_channel *ch,
 static const struct nvhost_channel_ops host1x_channel_ops = {
 	.init = host1x_channel_init,
 	.submit = host1x_channel_submit,
+	.submit_batch = host1x_channel_submit_batch,
 	.save_context = host1x_save_context,
 	.drain_read_fifo = host1x_drain_read_fifo,
 };
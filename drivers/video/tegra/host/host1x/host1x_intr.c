@@ -32,18 +32,33 @@
 
 static void t20_intr_syncpt_thresh_isr(struct nvhost_intr_syncpt *syncpt);
 
-static void syncpt_thresh_cascade_fn(struct work_struct *work)
+/*
+ * Threaded half of the sync point interrupt: one pass services every
+ * sync point flagged by the hard handler since the last pass.
+ */
+static irqreturn_t syncpt_thresh_cascade_fn(int irq, void *dev_id)
 {
-	struct nvhost_intr_syncpt *sp =
-		container_of(work, struct nvhost_intr_syncpt, work);
-	nvhost_syncpt_thresh_fn(sp->irq, sp);
+	struct nvhost_master *dev = dev_id;
+	struct nvhost_intr *intr = &dev->intr;
+	int id;
+
+	for_each_set_bit(id, intr->syncpt_pending, dev->info.nb_pts)
+		if (test_and_clear_bit(id, intr->syncpt_pending))
+			nvhost_syncpt_thresh_fn(irq, intr->syncpt + id);
+
+	return IRQ_HANDLED;
 }
 
+/*
+ * Hard half: only mask and ack the triggered sync points, leaving the
+ * wait lists to the thread.
+ */
 static irqreturn_t syncpt_thresh_cascade_isr(int irq, void *dev_id)
 {
 	struct nvhost_master *dev = dev_id;
 	void __iomem *sync_regs = dev->sync_aperture;
 	struct nvhost_intr *intr = &dev->intr;
+	irqreturn_t ret = IRQ_HANDLED;
 	unsigned long reg;
 	int i, id;
 
@@ -52,14 +67,15 @@ static irqreturn_t syncpt_thresh_cascade_isr(int irq, void *dev_id)
 				host1x_sync_syncpt_thresh_cpu0_int_status_r() +
 				i * REGISTER_STRIDE);
 		for_each_set_bit(id, &reg, BITS_PER_LONG) {
-			struct nvhost_intr_syncpt *sp =
-				intr->syncpt + (i * BITS_PER_LONG + id);
-			t20_intr_syncpt_thresh_isr(sp);
-			queue_work(intr->wq, &sp->work);
+			int sp_id = i * BITS_PER_LONG + id;
+
+			t20_intr_syncpt_thresh_isr(intr->syncpt + sp_id);
+			set_bit(sp_id, intr->syncpt_pending);
+			ret = IRQ_WAKE_THREAD;
 		}
 	}
 
-	return IRQ_HANDLED;
+	return ret;
 }
 
 static void t20_intr_init_host_sync(struct nvhost_intr *intr)
@@ -73,11 +89,9 @@ static void t20_intr_init_host_sync(struct nvhost_intr *intr)
 	writel(0xffffffffUL,
 		sync_regs + host1x_sync_syncpt_thresh_cpu0_int_status_r());
 
-	for (i = 0; i < dev->info.nb_pts; i++)
-		INIT_WORK(&intr->syncpt[i].work, syncpt_thresh_cascade_fn);
-
-	err = request_irq(INT_HOST1X_MPCORE_SYNCPT,
+	err = request_threaded_irq(INT_HOST1X_MPCORE_SYNCPT,
 				syncpt_thresh_cascade_isr,
+				syncpt_thresh_cascade_fn,
 				IRQF_SHARED, "host_syncpt", dev);
 	if (err)
 		BUG();
@@ -289,8 +303,8 @@ static void host1x_intr_disable_general_irq(struct nvhost_intr *intr, int irq)
 static int t20_free_syncpt_irq(struct nvhost_intr *intr)
 {
 	struct nvhost_master *dev = intr_to_dev(intr);
+	/* also waits for the irq thread to finish */
 	free_irq(INT_HOST1X_MPCORE_SYNCPT, dev);
-	flush_workqueue(intr->wq);
 	return 0;
 }
 
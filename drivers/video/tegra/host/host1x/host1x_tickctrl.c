@@ -23,13 +23,8 @@
 #include "dev.h"
 #include "chip_support.h"
 
-static int host1x_tickctrl_init_channel(struct platform_device *dev)
+static void host1x_tickctrl_enable(void __iomem *regs)
 {
-	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
-	void __iomem *regs = pdata->channel->aperture;
-
-	nvhost_module_busy(nvhost_get_parent(dev));
-
 	/* Initialize counter */
 	writel(0, regs + host1x_channel_tickcount_hi_r());
 	writel(0, regs + host1x_channel_tickcount_lo_r());
@@ -44,7 +39,15 @@ static int host1x_tickctrl_init_channel(struct platform_device *dev)
 			regs + host1x_channel_stallctrl_r());
 	writel(host1x_channel_xferctrl_enable_channel_xfer_f(1),
 			regs + host1x_channel_xferctrl_r());
+}
 
+static int host1x_tickctrl_init_channel(struct platform_device *dev)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	void __iomem *regs = pdata->channel->aperture;
+
+	nvhost_module_busy(nvhost_get_parent(dev));
+	host1x_tickctrl_enable(regs);
 	nvhost_module_idle(nvhost_get_parent(dev));
 
 	return 0;
@@ -121,10 +124,73 @@ static int host1x_tickctrl_xfercount(struct platform_device *dev, u64 *val)
 	return 0;
 }
 
+static u64 host1x_tickctrl_delta(u64 now, u64 *last)
+{
+	u64 delta = now >= *last ? now - *last : now;
+
+	*last = now;
+	return delta;
+}
+
+/*
+ * Fold the hardware counters into the channel's running totals. The
+ * totals only move while host1x is clocked, so a gated host1x is not
+ * woken up just to be sampled. The counters are lost when host1x loses
+ * power in LP0; they are then restarted and the totals carry on.
+ */
+static int host1x_tickctrl_counters(struct platform_device *dev,
+		struct nvhost_engine_counters *c)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	struct platform_device *host = nvhost_get_parent(dev);
+	struct nvhost_device_data *host_pdata = platform_get_drvdata(host);
+	struct nvhost_channel *ch = pdata->channel;
+	struct nvhost_engine_counters *hw = &ch->counters_hw;
+	void __iomem *regs = ch->aperture;
+
+	/* holding the power lock keeps host1x from being gated meanwhile */
+	mutex_lock(&host_pdata->lock);
+	if (nvhost_module_powered(host)) {
+		u32 ctrl = readl(regs + host1x_channel_channelctrl_r());
+
+		if (!host1x_channel_channelctrl_enabletickcnt_v(ctrl)) {
+			host1x_tickctrl_enable(regs);
+			memset(hw, 0, sizeof(*hw));
+		} else {
+			u64 busy, stall, ticks;
+
+			busy = host1x_tickctrl_delta(readl64(
+				regs + host1x_channel_xfercount_hi_r(),
+				regs + host1x_channel_xfercount_lo_r()),
+				&hw->busy);
+			stall = host1x_tickctrl_delta(readl64(
+				regs + host1x_channel_stallcount_hi_r(),
+				regs + host1x_channel_stallcount_lo_r()),
+				&hw->stall);
+			/* read last, so that it covers the other two */
+			ticks = host1x_tickctrl_delta(readl64(
+				regs + host1x_channel_tickcount_hi_r(),
+				regs + host1x_channel_tickcount_lo_r()),
+				&hw->ticks);
+
+			ch->counters.ticks += ticks;
+			ch->counters.busy += busy;
+			ch->counters.stall += stall;
+			if (ticks > busy + stall)
+				ch->counters.idle += ticks - busy - stall;
+		}
+	}
+	*c = ch->counters;
+	mutex_unlock(&host_pdata->lock);
+
+	return 0;
+}
+
 static const struct nvhost_tickctrl_ops host1x_tickctrl_ops = {
 	.init_channel = host1x_tickctrl_init_channel,
 	.deinit_channel = host1x_tickctrl_deinit_channel,
 	.tickcount = host1x_tickctrl_tickcount,
 	.stallcount = host1x_tickctrl_stallcount,
 	.xfercount = host1x_tickctrl_xfercount,
+	.counters = host1x_tickctrl_counters,
 };
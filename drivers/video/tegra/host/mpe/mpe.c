@@ -911,8 +911,8 @@ static int nvhost_mpe_read_reg(
 	mutex_unlock(&channel->submitlock);
 
 done:
-	kfree(ctx_waiter);
-	kfree(read_waiter);
-	kfree(completed_waiter);
+	nvhost_intr_free_waiter(ctx_waiter);
+	nvhost_intr_free_waiter(read_waiter);
+	nvhost_intr_free_waiter(completed_waiter);
 	return err;
 }
@@ -31,6 +31,7 @@
 #include "hw_msenc.h"
 #include "bus_client.h"
 #include "nvhost_acm.h"
+#include "nvhost_scale.h"
 #include "chip_support.h"
 #include "nvhost_memmgr.h"
 
@@ -377,6 +378,10 @@ static int __devinit msenc_probe(struct platform_device *dev)
 	pdata->init = nvhost_msenc_init;
 	pdata->deinit = nvhost_msenc_deinit;
 	pdata->finalize_poweron = nvhost_msenc_finalize_poweron;
+	pdata->busy = nvhost_scale_notify_busy;
+	pdata->idle = nvhost_scale_notify_idle;
+	pdata->scaling_init = nvhost_scale_init;
+	pdata->scaling_deinit = nvhost_scale_deinit;
 
 	platform_set_drvdata(dev, pdata);
 
@@ -389,7 +394,7 @@ static int __devinit msenc_probe(struct platform_device *dev)
 
 static int __exit msenc_remove(struct platform_device *dev)
 {
-	/* Add clean-up */
+	nvhost_scale_deinit(dev);
 	return 0;
 }
 
@@ -26,6 +26,9 @@
 #include <linux/device.h>
 #include <linux/delay.h>
 #include <linux/platform_device.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
 #include <trace/events/nvhost.h>
 
 #include <mach/powergate.h>
@@ -40,6 +43,13 @@
 #define POWERGATE_DELAY 			10
 #define MAX_DEVID_LENGTH			16
 
+/* adaptive power gating: defaults and limits, all in ms */
+#define POWERGATE_BREAKEVEN_MS			5
+#define POWERGATE_ADAPTIVE_MAX_DELAY		1000
+/* idle periods seen before the history is trusted, and decay point */
+#define POWERGATE_MIN_SAMPLES			8
+#define POWERGATE_MAX_SAMPLES			256
+
 DEFINE_MUTEX(client_list_lock);
 
 struct nvhost_module_client {
@@ -141,6 +151,8 @@ static void to_state_clockgated_locked(struct platform_device *dev)
 
 		if (dev->dev.parent)
 			nvhost_module_idle(to_platform_device(dev->dev.parent));
+
+		pdata->pg.clockgates++;
 	} else if (pdata->powerstate == NVHOST_POWER_STATE_POWERGATED
 			&& pdata->can_powergate) {
 		do_unpowergate_locked(pdata->powergate_ids[0]);
@@ -161,10 +173,64 @@ static void to_state_clockgated_locked(struct platform_device *dev)
 	pdata->powerstate = NVHOST_POWER_STATE_CLOCKGATED;
 }
 
+/* account for a power ungate that took us since start */
+static void powergate_ungated_locked(struct nvhost_device_data *pdata,
+		ktime_t start)
+{
+	struct nvhost_pg_stats *pg = &pdata->pg;
+	ktime_t now = ktime_get();
+	s64 off_ms = ktime_to_ms(ktime_sub(start, pg->pg_start));
+	u32 us = min_t(s64, ktime_us_delta(now, start), U32_MAX);
+
+	pg->unpowergates++;
+	pg->ungate_us += us;
+	pg->ungate_max_us = max(pg->ungate_max_us, us);
+
+	if (off_ms < pg->breakeven_ms) {
+		pg->short_powergates++;
+		pg->wasted_ms += pg->breakeven_ms - off_ms;
+	}
+}
+
+/* track the time the unit has work queued, for nvhost_module_busy_time() */
+static void busy_account_locked(struct nvhost_device_data *pdata, bool busy)
+{
+	struct nvhost_pg_stats *pg = &pdata->pg;
+	ktime_t now = ktime_get();
+	unsigned long flags;
+
+	write_seqlock_irqsave(&pg->busy_lock, flags);
+	if (busy) {
+		pg->busy_start = now;
+	} else if (pg->busy_start.tv64) {
+		pg->busy_us += ktime_us_delta(now, pg->busy_start);
+		pg->busy_start = ktime_set(0, 0);
+	}
+	write_sequnlock_irqrestore(&pg->busy_lock, flags);
+}
+
+u64 nvhost_module_busy_time(struct platform_device *dev)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	struct nvhost_pg_stats *pg = &pdata->pg;
+	unsigned int seq;
+	u64 busy_us;
+
+	do {
+		seq = read_seqbegin(&pg->busy_lock);
+		busy_us = pg->busy_us;
+		if (pg->busy_start.tv64)
+			busy_us += ktime_us_delta(ktime_get(), pg->busy_start);
+	} while (read_seqretry(&pg->busy_lock, seq));
+
+	return busy_us;
+}
+
 static void to_state_running_locked(struct platform_device *dev)
 {
 	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
 	int prev_state = pdata->powerstate;
+	ktime_t start = ktime_get();
 
 	if (pdata->powerstate == NVHOST_POWER_STATE_POWERGATED)
 		to_state_clockgated_locked(dev);
@@ -194,6 +260,9 @@ static void to_state_running_locked(struct platform_device *dev)
 			pdata->finalize_poweron(dev);
 	}
 	pdata->powerstate = NVHOST_POWER_STATE_RUNNING;
+
+	if (prev_state == NVHOST_POWER_STATE_POWERGATED && pdata->can_powergate)
+		powergate_ungated_locked(pdata, start);
 }
 
 /* This gets called from powergate_handler() and from module suspend.
@@ -220,18 +289,91 @@ static int to_state_powergated_locked(struct platform_device *dev)
 	if (pdata->can_powergate) {
 		do_powergate_locked(pdata->powergate_ids[0]);
 		do_powergate_locked(pdata->powergate_ids[1]);
+		if (pdata->powerstate != NVHOST_POWER_STATE_POWERGATED) {
+			pdata->pg.powergates++;
+			pdata->pg.pg_start = ktime_get();
+		}
 	}
 
 	pdata->powerstate = NVHOST_POWER_STATE_POWERGATED;
 	return 0;
 }
 
+/* add an idle period to the history, halving it now and then so that it
+ * follows changes in workload */
+static void powergate_record_idle_locked(struct nvhost_device_data *pdata)
+{
+	struct nvhost_pg_stats *pg = &pdata->pg;
+	s64 ms;
+	int i;
+
+	if (!pg->idle_start.tv64)
+		return;
+
+	ms = ktime_to_ms(ktime_sub(ktime_get(), pg->idle_start));
+	pg->idle_start.tv64 = 0;
+	i = ms > 1 ? min_t(int, ilog2((u64)ms),
+			NVHOST_IDLE_HIST_BUCKETS - 1) : 0;
+	pg->idle_hist[i]++;
+
+	if (++pg->idle_total < POWERGATE_MAX_SAMPLES)
+		return;
+
+	pg->idle_total = 0;
+	for (i = 0; i < NVHOST_IDLE_HIST_BUCKETS; i++) {
+		pg->idle_hist[i] /= 2;
+		pg->idle_total += pg->idle_hist[i];
+	}
+}
+
+/*
+ * Pick how long to stay clock gated before power gating. An idle period
+ * of g ms power gated after clockgate_delay + d is off for
+ * g - clockgate_delay - d; that has to exceed the break-even time for
+ * the ungate and context restore to pay off. If the idle periods that
+ * make up 90% of the history are too short for that with the static
+ * delay, hold off until such a period has passed: an idle period that
+ * outlasts it is likely to be a long one.
+ */
+static int powergate_delay_locked(struct nvhost_device_data *pdata)
+{
+	struct nvhost_pg_stats *pg = &pdata->pg;
+	int delay = pdata->powergate_delay;
+	u32 sum = 0;
+	int gap = 0;
+	int i;
+
+	if (!pg->adaptive || pg->idle_total < POWERGATE_MIN_SAMPLES)
+		return delay;
+
+	for (i = 0; i < NVHOST_IDLE_HIST_BUCKETS; i++) {
+		sum += pg->idle_hist[i];
+		if (sum * 10 >= pg->idle_total * 9) {
+			/* upper bound of bucket i */
+			gap = 2 << i;
+			break;
+		}
+	}
+
+	if (gap - pdata->clockgate_delay - delay < (int)pg->breakeven_ms)
+		delay = max(delay, min(gap - pdata->clockgate_delay,
+				POWERGATE_ADAPTIVE_MAX_DELAY));
+
+	return delay;
+}
+
 static void schedule_powergating_locked(struct platform_device *dev)
 {
 	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
-	if (pdata->can_powergate)
-		schedule_delayed_work(&pdata->powerstate_down,
-				msecs_to_jiffies(pdata->powergate_delay));
+	int delay;
+
+	if (!pdata->can_powergate)
+		return;
+
+	delay = powergate_delay_locked(pdata);
+	pdata->pg.last_delay_ms = delay;
+	schedule_delayed_work(&pdata->powerstate_down,
+			msecs_to_jiffies(delay));
 }
 
 static void schedule_clockgating_locked(struct platform_device *dev)
@@ -252,6 +394,10 @@ void nvhost_module_busy(struct platform_device *dev)
 	cancel_delayed_work(&pdata->powerstate_down);
 
 	pdata->refcount++;
+	if (pdata->refcount == 1) {
+		powergate_record_idle_locked(pdata);
+		busy_account_locked(pdata, true);
+	}
 	if (pdata->refcount > 0 && !nvhost_module_powered(dev))
 		to_state_running_locked(dev);
 	mutex_unlock(&pdata->lock);
@@ -315,6 +461,8 @@ void nvhost_module_idle_mult(struct platform_device *dev, int refs)
 
 	/* no new submits. just schedule clock gating */
 	kick = true;
+	pdata->pg.idle_start = ktime_get();
+	busy_account_locked(pdata, false);
 	if (nvhost_module_powered(dev))
 		schedule_clockgating_locked(dev);
 
@@ -601,6 +749,10 @@ int nvhost_module_init(struct platform_device *dev)
 	init_waitqueue_head(&pdata->idle_wq);
 	INIT_DELAYED_WORK(&pdata->powerstate_down, powerstate_down_handler);
 
+	pdata->pg.adaptive = 1;
+	pdata->pg.breakeven_ms = POWERGATE_BREAKEVEN_MS;
+	seqlock_init(&pdata->pg.busy_lock);
+
 	/* reset the module */
 	do_module_reset_locked(dev);
 
@@ -691,6 +843,57 @@ fail_attrib_alloc:
 	return err;
 }
 
+static int powergating_show(struct seq_file *s, void *unused)
+{
+	struct platform_device *dev = s->private;
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	struct nvhost_pg_stats *pg = &pdata->pg;
+	int i;
+
+	mutex_lock(&pdata->lock);
+	seq_printf(s, "clockgates: %llu\npowergates: %llu\n"
+		   "unpowergates: %llu\n",
+		   pg->clockgates, pg->powergates, pg->unpowergates);
+	seq_printf(s, "powergates shorter than break-even: %llu "
+		   "(%llu ms short in total)\n",
+		   pg->short_powergates, pg->wasted_ms);
+	seq_printf(s, "ungate latency: %llu us total, %u us max\n",
+		   pg->ungate_us, pg->ungate_max_us);
+	seq_printf(s, "last powergate delay: %u ms\n", pg->last_delay_ms);
+	seq_puts(s, "idle period histogram (ms):\n");
+	for (i = 0; i < NVHOST_IDLE_HIST_BUCKETS; i++)
+		if (pg->idle_hist[i])
+			seq_printf(s, "  %6u-%-6u %u\n", i ? 1 << i : 0,
+				   (2 << i) - 1, pg->idle_hist[i]);
+	mutex_unlock(&pdata->lock);
+
+	return 0;
+}
+
+static int powergating_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, powergating_show, inode->i_private);
+}
+
+static const struct file_operations powergating_fops = {
+	.open		= powergating_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void nvhost_module_debug_init(struct platform_device *dev, struct dentry *de)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+
+	debugfs_create_file("powergating", S_IRUGO, de, dev,
+			&powergating_fops);
+	debugfs_create_u32("powergate_adaptive", S_IRUGO|S_IWUSR, de,
+			&pdata->pg.adaptive);
+	debugfs_create_u32("powergate_breakeven_ms", S_IRUGO|S_IWUSR, de,
+			&pdata->pg.breakeven_ms);
+}
+
 static int is_module_idle(struct platform_device *dev)
 {
 	int count;
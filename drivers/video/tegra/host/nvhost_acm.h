@@ -27,14 +27,18 @@
 #include <linux/clk.h>
 #include <linux/nvhost.h>
 
+struct dentry;
+
 /* Sets clocks and powergating state for a module */
 int nvhost_module_init(struct platform_device *ndev);
 void nvhost_module_deinit(struct platform_device *dev);
 int nvhost_module_suspend(struct platform_device *dev);
 
 void nvhost_module_reset(struct platform_device *dev);
+void nvhost_module_debug_init(struct platform_device *dev, struct dentry *de);
 void nvhost_module_busy(struct platform_device *dev);
 void nvhost_module_idle_mult(struct platform_device *dev, int refs);
+u64 nvhost_module_busy_time(struct platform_device *dev);
 int nvhost_module_add_client(struct platform_device *dev,
 		void *priv);
 void nvhost_module_remove_client(struct platform_device *dev,
@@ -31,6 +31,7 @@
 #include <linux/slab.h>
 #include <linux/kfifo.h>
 #include <trace/events/nvhost.h>
+#include <linux/input/frame_trace.h>
 #include <linux/interrupt.h>
 
 /*
@@ -53,9 +54,13 @@ static void add_to_sync_queue(struct nvhost_cdma *cdma,
 
 	job->first_get = first_get;
 	job->num_slots = nr_slots;
+	job->pb_time = ktime_get();
 	nvhost_job_get(job);
 	list_add_tail(&job->list, &cdma->sync_queue);
 
+	if (++cdma->stats.sq_depth > cdma->stats.sq_depth_max)
+		cdma->stats.sq_depth_max = cdma->stats.sq_depth;
+
 	switch (job->priority) {
 	case NVHOST_PRIORITY_HIGH:
 		cdma->high_prio_count++;
@@ -69,6 +74,70 @@ static void add_to_sync_queue(struct nvhost_cdma *cdma,
 	}
 }
 
+static void prio_stats_update(struct nvhost_cdma *cdma,
+		struct nvhost_job *job)
+{
+	struct nvhost_prio_stats *st;
+	s64 us;
+
+	if (!job->submit_time.tv64)
+		return;
+
+	st = &cdma->prio_stats[nvhost_prio_level(job->priority)];
+	us = ktime_us_delta(ktime_get(), job->submit_time);
+	st->completed++;
+	st->total_us += us;
+	if (us > st->max_us)
+		st->max_us = min_t(s64, us, U32_MAX);
+}
+
+static void job_latency_record(struct nvhost_job_latency *lat,
+		int stage, s64 us)
+{
+	u32 v = clamp_t(s64, us, 0, U32_MAX);
+
+	lat->hist[stage][min_t(int, fls(v), NVHOST_LATENCY_BUCKETS - 1)]++;
+	lat->total_us[stage] += v;
+	if (v > lat->max_us[stage])
+		lat->max_us[stage] = v;
+}
+
+static void job_latency_update(struct nvhost_cdma *cdma,
+		struct nvhost_job *job)
+{
+	struct nvhost_job_latency *lat = &cdma->latency;
+	ktime_t done = ktime_get();
+	ktime_t irq = lat->irq_time.tv64 ? lat->irq_time : done;
+	ktime_t start;
+	s64 submit_us, queue_us, exec_us, irq_us;
+
+	if (!job->submit_time.tv64 || !job->pb_time.tv64)
+		return;
+
+	start = lat->last_done.tv64 > job->pb_time.tv64 ?
+		lat->last_done : job->pb_time;
+	if (start.tv64 > irq.tv64)
+		start = irq;
+	lat->last_done = irq;
+
+	submit_us = ktime_us_delta(job->pb_time, job->submit_time);
+	queue_us = ktime_us_delta(start, job->pb_time);
+	exec_us = ktime_us_delta(irq, start);
+	irq_us = ktime_us_delta(done, irq);
+
+	lat->jobs++;
+	job_latency_record(lat, NVHOST_JOB_STAGE_SUBMIT, submit_us);
+	job_latency_record(lat, NVHOST_JOB_STAGE_QUEUE, queue_us);
+	job_latency_record(lat, NVHOST_JOB_STAGE_EXEC, exec_us);
+	job_latency_record(lat, NVHOST_JOB_STAGE_IRQ, irq_us);
+	job_latency_record(lat, NVHOST_JOB_STAGE_TOTAL,
+			ktime_us_delta(done, job->submit_time));
+
+	trace_nvhost_job_timestamps(cdma_to_channel(cdma)->dev->name,
+			job->syncpt_id, job->syncpt_end,
+			submit_us, queue_us, exec_us, irq_us);
+}
+
 /**
  * Return the status of the cdma's sync queue or push buffer for the given event
  *  - sq empty: returns 1 for empty, 0 for not empty (as in "1 empty queue" :-)
@@ -99,13 +168,48 @@ static unsigned int cdma_status_locked(struct nvhost_cdma *cdma,
  *     - Return the amount of space (> 0)
  * Must be called with the cdma lock held.
  */
+static void cdma_wait_done_locked(struct nvhost_cdma *cdma,
+		enum cdma_event event, ktime_t start)
+{
+	struct nvhost_cdma_stats *st = &cdma->stats;
+	u32 us = min_t(s64, ktime_us_delta(ktime_get(), start), U32_MAX);
+
+	switch (event) {
+	case CDMA_EVENT_PUSH_BUFFER_SPACE:
+		st->pb_waits++;
+		st->pb_wait_us += us;
+		st->pb_wait_max_us = max(st->pb_wait_max_us, us);
+		/* submitters outran the push buffer: grow it once idle */
+		cdma->pb_grow = true;
+		break;
+	case CDMA_EVENT_SYNC_QUEUE_EMPTY:
+		st->sq_waits++;
+		st->sq_wait_us += us;
+		st->sq_wait_max_us = max(st->sq_wait_max_us, us);
+		break;
+	default:
+		break;
+	}
+
+	trace_nvhost_wait_cdma_done(cdma_to_channel(cdma)->dev->name,
+			event, us, st->sq_depth);
+}
+
 unsigned int nvhost_cdma_wait_locked(struct nvhost_cdma *cdma,
 		enum cdma_event event)
 {
+	ktime_t start = ktime_set(0, 0);
+
 	for (;;) {
 		unsigned int space = cdma_status_locked(cdma, event);
-		if (space)
+		if (space) {
+			if (start.tv64)
+				cdma_wait_done_locked(cdma, event, start);
 			return space;
+		}
+
+		if (!start.tv64)
+			start = ktime_get();
 
 		trace_nvhost_wait_cdma(cdma_to_channel(cdma)->dev->name,
 				event);
@@ -215,6 +319,12 @@ static void update_cdma_locked(struct nvhost_cdma *cdma)
 		}
 
 		list_del(&job->list);
+		cdma->stats.sq_depth--;
+
+		prio_stats_update(cdma, job);
+		job_latency_update(cdma, job);
+		frame_trace_complete(cdma_to_channel(cdma)->dev->name,
+				job->frame, job->syncpt_id, job->syncpt_end);
 
 		switch (job->priority) {
 		case NVHOST_PRIORITY_HIGH:
@@ -374,6 +484,33 @@ void nvhost_cdma_deinit(struct nvhost_cdma *cdma)
 	cdma_op().timeout_destroy(cdma);
 }
 
+/**
+ * Swap in a larger push buffer. Must be called with the cdma lock held and
+ * an empty sync queue.
+ */
+static void cdma_grow_push_buffer_locked(struct nvhost_cdma *cdma)
+{
+	u32 old_slots = cdma->push_buffer.size / 8;
+	int err;
+
+	if (!cdma_op().grow_push_buffer) {
+		cdma->pb_grow = false;
+		return;
+	}
+
+	err = cdma_op().grow_push_buffer(cdma);
+	if (err == -EBUSY)
+		return;		/* DMA still draining, retry on next submit */
+
+	cdma->pb_grow = false;
+	if (err)
+		return;
+
+	cdma->stats.pb_grows++;
+	trace_nvhost_cdma_grow_push_buffer(cdma_to_channel(cdma)->dev->name,
+			old_slots, cdma->push_buffer.size / 8);
+}
+
 /**
  * Begin a cdma submit
  */
@@ -394,6 +531,9 @@ int nvhost_cdma_begin(struct nvhost_cdma *cdma, struct nvhost_job *job)
 			}
 		}
 	}
+	if (cdma->pb_grow && list_empty(&cdma->sync_queue))
+		cdma_grow_push_buffer_locked(cdma);
+
 	if (!cdma->running) {
 		BUG_ON(!cdma_op().start);
 		cdma_op().start(cdma);
@@ -482,11 +622,22 @@ void nvhost_cdma_push_gather(struct nvhost_cdma *cdma,
 void nvhost_cdma_end(struct nvhost_cdma *cdma,
 		struct nvhost_job *job)
 {
-	bool was_idle = list_empty(&cdma->sync_queue);
-
 	BUG_ON(!cdma_op().kick);
 	cdma_op().kick(cdma);
 
+	nvhost_cdma_end_nokick(cdma, job);
+}
+
+/**
+ * End a cdma submit without kicking DMA
+ * Used when queueing several jobs back to back: the caller rings the
+ * doorbell once for all of them through nvhost_cdma_kick().
+ */
+void nvhost_cdma_end_nokick(struct nvhost_cdma *cdma,
+		struct nvhost_job *job)
+{
+	bool was_idle = list_empty(&cdma->sync_queue);
+
 	BUG_ON(job->syncpt_id == NVSYNCPT_INVALID);
 
 	add_to_sync_queue(cdma,
@@ -507,6 +658,18 @@ void nvhost_cdma_end(struct nvhost_cdma *cdma,
 	mutex_unlock(&cdma->lock);
 }
 
+/**
+ * Kick DMA for everything pushed since the last kick
+ */
+void nvhost_cdma_kick(struct nvhost_cdma *cdma)
+{
+	BUG_ON(!cdma_op().kick);
+
+	mutex_lock(&cdma->lock);
+	cdma_op().kick(cdma);
+	mutex_unlock(&cdma->lock);
+}
+
 /**
  * Update cdma state according to current sync point values
  */
@@ -517,6 +680,19 @@ void nvhost_cdma_update(struct nvhost_cdma *cdma)
 	mutex_unlock(&cdma->lock);
 }
 
+/**
+ * Update cdma state from a sync point threshold interrupt seen at
+ * irq_time, so that job latency stats can tell execution from cleanup.
+ */
+void nvhost_cdma_update_at(struct nvhost_cdma *cdma, ktime_t irq_time)
+{
+	mutex_lock(&cdma->lock);
+	cdma->latency.irq_time = irq_time;
+	update_cdma_locked(cdma);
+	cdma->latency.irq_time.tv64 = 0;
+	mutex_unlock(&cdma->lock);
+}
+
 /**
  * Wait for push buffer to be empty.
  * @cdma pointer to channel cdma
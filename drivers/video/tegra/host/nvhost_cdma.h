@@ -25,6 +25,7 @@
 #include <linux/semaphore.h>
 
 #include <linux/nvhost.h>
+#include <linux/nvhost_ioctl.h>
 #include <linux/list.h>
 
 struct nvhost_syncpt;
@@ -57,6 +58,7 @@ struct push_buffer {
 	u32 *mapped;			/* mapped pushbuffer memory */
 	struct sg_table *sgt;
 	dma_addr_t phys;		/* physical address of pushbuffer */
+	u32 size;			/* bytes, excluding the final RESTART */
 	u32 fence;			/* index we've written */
 	u32 cur;			/* index to write to */
 	struct mem_mgr_handle *client_handle; /* handle for each opcode pair */
@@ -80,6 +82,67 @@ enum cdma_event {
 	CDMA_EVENT_PUSH_BUFFER_SPACE	/* wait for space in push buffer */
 };
 
+enum nvhost_prio_level {
+	NVHOST_PRIO_LEVEL_HIGH,
+	NVHOST_PRIO_LEVEL_MEDIUM,
+	NVHOST_PRIO_LEVEL_LOW,
+	NVHOST_PRIO_LEVELS
+};
+
+static inline int nvhost_prio_level(int priority)
+{
+	if (priority >= NVHOST_PRIORITY_HIGH)
+		return NVHOST_PRIO_LEVEL_HIGH;
+	if (priority >= NVHOST_PRIORITY_MEDIUM)
+		return NVHOST_PRIO_LEVEL_MEDIUM;
+	return NVHOST_PRIO_LEVEL_LOW;
+}
+
+/* submit to completion latency of finished jobs, per priority level */
+struct nvhost_prio_stats {
+	u64 completed;
+	u64 total_us;
+	u32 max_us;
+};
+
+/*
+ * Where finished jobs spent their time. A job is taken to start on the
+ * channel when it reached the push buffer or when the job before it
+ * completed, whichever is later.
+ */
+enum nvhost_job_stage {
+	NVHOST_JOB_STAGE_SUBMIT,	/* submit ioctl to push buffer */
+	NVHOST_JOB_STAGE_QUEUE,		/* push buffer to start on channel */
+	NVHOST_JOB_STAGE_EXEC,		/* start to syncpt threshold irq */
+	NVHOST_JOB_STAGE_IRQ,		/* syncpt threshold irq to cleanup */
+	NVHOST_JOB_STAGE_TOTAL,		/* submit ioctl to cleanup */
+	NVHOST_JOB_STAGES
+};
+
+#define NVHOST_LATENCY_BUCKETS	16
+
+struct nvhost_job_latency {
+	u64 jobs;
+	u32 hist[NVHOST_JOB_STAGES][NVHOST_LATENCY_BUCKETS]; /* log2 us */
+	u64 total_us[NVHOST_JOB_STAGES];
+	u32 max_us[NVHOST_JOB_STAGES];
+	ktime_t last_done;		/* threshold irq of the previous job */
+	ktime_t irq_time;		/* threshold irq of current update */
+};
+
+/* push buffer and sync queue backpressure seen by submitters */
+struct nvhost_cdma_stats {
+	u64 pb_waits;			/* waits for push buffer space */
+	u64 pb_wait_us;
+	u32 pb_wait_max_us;
+	u64 sq_waits;			/* waits for the sync queue to drain */
+	u64 sq_wait_us;
+	u32 sq_wait_max_us;
+	u32 sq_depth;			/* jobs currently in the sync queue */
+	u32 sq_depth_max;
+	u32 pb_grows;			/* times the push buffer was doubled */
+};
+
 struct nvhost_cdma {
 	struct mutex lock;		/* controls access to shared state */
 	struct semaphore sem;		/* signalled when event occurs */
@@ -96,6 +159,10 @@ struct nvhost_cdma {
 	int high_prio_count;
 	int med_prio_count;
 	int low_prio_count;
+	struct nvhost_prio_stats prio_stats[NVHOST_PRIO_LEVELS];
+	bool pb_grow;			/* grow push buffer once idle */
+	struct nvhost_cdma_stats stats;
+	struct nvhost_job_latency latency;
 };
 
 #define cdma_to_channel(cdma) container_of(cdma, struct nvhost_channel, cdma)
@@ -113,7 +180,11 @@ void	nvhost_cdma_push_gather(struct nvhost_cdma *cdma,
 		struct mem_handle *handle, u32 offset, u32 op1, u32 op2);
 void	nvhost_cdma_end(struct nvhost_cdma *cdma,
 		struct nvhost_job *job);
+void	nvhost_cdma_end_nokick(struct nvhost_cdma *cdma,
+		struct nvhost_job *job);
+void	nvhost_cdma_kick(struct nvhost_cdma *cdma);
 void	nvhost_cdma_update(struct nvhost_cdma *cdma);
+void	nvhost_cdma_update_at(struct nvhost_cdma *cdma, ktime_t irq_time);
 int	nvhost_cdma_flush(struct nvhost_cdma *cdma, int timeout);
 void	nvhost_cdma_peek(struct nvhost_cdma *cdma,
 		u32 dmaget, int slot, u32 *out);
@@ -48,7 +48,7 @@ int nvhost_channel_init(struct nvhost_channel *ch,
 	return 0;
 }
 
-int nvhost_channel_submit(struct nvhost_job *job)
+static void channel_wait_higher_prio(struct nvhost_job *job)
 {
 	/*
 	 * Check if queue has higher priority jobs running. If so, wait until
@@ -72,8 +72,93 @@ int nvhost_channel_submit(struct nvhost_job *job)
 	if (higher_count > 0)
 		(void)nvhost_cdma_flush(&job->ch->cdma,
 				NVHOST_CHANNEL_LOW_PRIO_MAX_WAIT);
+}
 
-	return channel_op().submit(job);
+static bool channel_higher_prio_waiting(struct nvhost_channel *ch,
+		int level)
+{
+	int i;
+
+	for (i = 0; i < level; i++)
+		if (atomic_read(&ch->prio_waiting[i]))
+			return true;
+	return false;
+}
+
+/*
+ * Submits are served in the order they take the submit lock. Let a
+ * higher priority submitter that is already on its way in go first,
+ * instead of queueing it behind background work on the lock. The wait
+ * is bounded so that low priority clients cannot be starved.
+ */
+static int channel_prio_enter(struct nvhost_job *job)
+{
+	struct nvhost_channel *ch = job->ch;
+	int level = nvhost_prio_level(job->priority);
+
+	atomic_inc(&ch->prio_waiting[level]);
+	wait_event_timeout(ch->prio_wq,
+			!channel_higher_prio_waiting(ch, level),
+			msecs_to_jiffies(NVHOST_CHANNEL_LOW_PRIO_MAX_WAIT));
+
+	channel_wait_higher_prio(job);
+	return level;
+}
+
+static void channel_prio_exit(struct nvhost_channel *ch, int level)
+{
+	if (atomic_dec_and_test(&ch->prio_waiting[level]) &&
+			level != NVHOST_PRIO_LEVEL_LOW)
+		wake_up_all(&ch->prio_wq);
+}
+
+int nvhost_channel_submit(struct nvhost_job *job)
+{
+	int level;
+	int err;
+
+	job->submit_time = ktime_get();
+	level = channel_prio_enter(job);
+	err = channel_op().submit(job);
+	channel_prio_exit(job->ch, level);
+
+	return err;
+}
+
+/*
+ * Submit jobs from one client context in order. On return *submitted
+ * holds how many were queued; the rest are left pinned for the caller to
+ * release.
+ */
+int nvhost_channel_submit_batch(struct nvhost_job **jobs, int num_jobs,
+		int *submitted)
+{
+	ktime_t now = ktime_get();
+	int level;
+	int err = 0;
+	int i;
+
+	for (i = 0; i < num_jobs; i++)
+		jobs[i]->submit_time = now;
+
+	/* all jobs come from one userctx and share its priority */
+	level = channel_prio_enter(jobs[0]);
+
+	if (channel_op().submit_batch) {
+		err = channel_op().submit_batch(jobs, num_jobs, submitted);
+		goto out;
+	}
+
+	for (i = 0; i < num_jobs; i++) {
+		err = channel_op().submit(jobs[i]);
+		if (err)
+			break;
+	}
+	*submitted = i;
+
+out:
+	channel_prio_exit(jobs[0]->ch, level);
+	return err;
 }
 
 struct nvhost_channel *nvhost_getchannel(struct nvhost_channel *ch)
@@ -111,6 +196,10 @@ void nvhost_putchannel(struct nvhost_channel *ch, struct nvhost_hwctx *ctx)
 		if (ch->cur_ctx == ctx)
 			ch->cur_ctx = NULL;
 		mutex_unlock(&ch->submitlock);
+
+		mutex_lock(&ch->reflock);
+		list_del(&ctx->list);
+		mutex_unlock(&ch->reflock);
 	}
 
 	/* Allow keep-alive'd module to be turned off */
@@ -158,6 +247,9 @@ struct nvhost_channel *nvhost_alloc_channel_internal(int chindex,
 		if (ch == NULL)
 			return NULL;
 		else {
+			nvhost_pin_cache_init(&ch->pin_cache);
+			init_waitqueue_head(&ch->prio_wq);
+			INIT_LIST_HEAD(&ch->hwctx_list);
 			(*current_channel_count)++;
 			return ch;
 		}
@@ -167,6 +259,7 @@ struct nvhost_channel *nvhost_alloc_channel_internal(int chindex,
 void nvhost_free_channel_internal(struct nvhost_channel *ch,
 	int *current_channel_count)
 {
+	nvhost_pin_cache_deinit(&ch->pin_cache);
 	kfree(ch);
 	(*current_channel_count)--;
 }
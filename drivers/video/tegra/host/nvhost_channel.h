@@ -23,7 +23,10 @@
 
 #include <linux/cdev.h>
 #include <linux/io.h>
+#include <linux/wait.h>
+#include <linux/nvhost.h>
 #include "nvhost_cdma.h"
+#include "nvhost_pin_cache.h"
 
 #define NVHOST_MAX_WAIT_CHECKS		256
 #define NVHOST_MAX_GATHERS		512
@@ -48,12 +51,31 @@ struct nvhost_channel {
 	struct cdev cdev;
 	struct nvhost_hwctx_handler *ctxhandler;
 	struct nvhost_cdma cdma;
+	struct nvhost_pin_cache pin_cache;
+	atomic64_t relocs_patched;
+	atomic64_t relocs_skipped;
+
+	/* user contexts of this channel, protected by reflock */
+	struct list_head hwctx_list;
+
+	/* submitters on their way to the submit lock, per priority level */
+	wait_queue_head_t prio_wq;
+	atomic_t prio_waiting[NVHOST_PRIO_LEVELS];
+
+	/*
+	 * Engine counters, and the hardware values at the last sample.
+	 * Protected by the power lock of host1x.
+	 */
+	struct nvhost_engine_counters counters;
+	struct nvhost_engine_counters counters_hw;
 };
 
 int nvhost_channel_init(struct nvhost_channel *ch,
 	struct nvhost_master *dev, int index);
 
 int nvhost_channel_submit(struct nvhost_job *job);
+int nvhost_channel_submit_batch(struct nvhost_job **jobs, int num_jobs,
+		int *submitted);
 
 struct nvhost_channel *nvhost_getchannel(struct nvhost_channel *ch);
 void nvhost_putchannel(struct nvhost_channel *ch, struct nvhost_hwctx *ctx);
@@ -35,6 +35,15 @@ struct nvhost_hwctx {
 	struct nvhost_channel *channel;
 	bool valid;
 	bool has_timedout;
+
+	/* Owning process and entry on the channel's list of contexts */
+	pid_t pid;
+	struct list_head list;
+
+	/* Context saves, restores, and switches avoided, for debugfs */
+	u32 save_count;
+	u32 restore_count;
+	u32 skip_count;
 };
 
 struct nvhost_hwctx_handler {
@@ -21,9 +21,15 @@
 #include "nvhost_intr.h"
 #include "dev.h"
 #include "nvhost_acm.h"
+#include "nvhost_sync.h"
+#include <linux/debugfs.h>
+#include <linux/export.h>
 #include <linux/interrupt.h>
+#include <linux/llist.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/irq.h>
+#include <linux/ktime.h>
 #include <trace/events/nvhost.h>
 #include "nvhost_channel.h"
 #include "nvhost_hwctx.h"
@@ -39,6 +45,8 @@ struct nvhost_waitlist {
 	atomic_t state;
 	void *data;
 	int count;
+	ktime_t time;			/* when the threshold was seen met */
+	struct llist_node pool_node;	/* entry on waiter_pool when free */
 };
 
 enum waitlist_state {
@@ -48,9 +56,40 @@ enum waitlist_state {
 	WLS_HANDLED
 };
 
+/*** Waiter pool ***/
+
+/* every submit and wait allocates waiters, and they are mostly released
+ * from the interrupt path. released waiters are parked on a lock-less
+ * list and handed out again, so the allocator is only hit when the pool
+ * runs dry. producers (releases) need no lock; consumers serialise on
+ * waiter_pool_lock as llist_del_first requires */
+#define NVHOST_WAITER_POOL_SIZE	256
+
+static struct kmem_cache *waiter_cache;
+static LLIST_HEAD(waiter_pool);
+static DEFINE_SPINLOCK(waiter_pool_lock);
+static atomic_t waiter_pool_count = ATOMIC_INIT(0);
+static atomic_t waiter_pool_hits = ATOMIC_INIT(0);
+static atomic_t waiter_alloc_fallbacks = ATOMIC_INIT(0);
+static atomic_t waiter_free_overflows = ATOMIC_INIT(0);
+
+/* threshold interrupts serviced, for system profilers */
+static atomic_t syncpt_intr_count = ATOMIC_INIT(0);
+
+static void waiter_free(struct nvhost_waitlist *waiter)
+{
+	if (atomic_inc_return(&waiter_pool_count) <= NVHOST_WAITER_POOL_SIZE) {
+		llist_add(&waiter->pool_node, &waiter_pool);
+		return;
+	}
+	atomic_dec(&waiter_pool_count);
+	atomic_inc(&waiter_free_overflows);
+	kmem_cache_free(waiter_cache, waiter);
+}
+
 static void waiter_release(struct kref *kref)
 {
-	kfree(container_of(kref, struct nvhost_waitlist, refcount));
+	waiter_free(container_of(kref, struct nvhost_waitlist, refcount));
 }
 
 /**
@@ -78,6 +117,7 @@ static bool add_waiter_to_queue(struct nvhost_waitlist *waiter,
  * and gather all completed waiters into lists by actions
  */
 static void remove_completed_waiters(struct list_head *head, u32 sync,
+			ktime_t now,
 			struct list_head completed[NVHOST_INTR_ACTION_COUNT])
 {
 	struct list_head *dest;
@@ -89,8 +129,9 @@ static void remove_completed_waiters(struct list_head *head, u32 sync,
 
 		dest = completed + waiter->action;
 
-		/* consolidate submit cleanups */
-		if (waiter->action == NVHOST_INTR_ACTION_SUBMIT_COMPLETE
+		/* consolidate submit cleanups and timeline signals */
+		if ((waiter->action == NVHOST_INTR_ACTION_SUBMIT_COMPLETE ||
+		     waiter->action == NVHOST_INTR_ACTION_SIGNAL_SYNC_PT)
 			&& !list_empty(dest)) {
 			prev = list_entry(dest->prev,
 					struct nvhost_waitlist, list);
@@ -105,6 +146,7 @@ static void remove_completed_waiters(struct list_head *head, u32 sync,
 			list_del(&waiter->list);
 			kref_put(&waiter->refcount, waiter_release);
 		} else {
+			waiter->time = now;
 			list_move_tail(&waiter->list, dest);
 		}
 	}
@@ -130,7 +172,7 @@ static void action_submit_complete(struct nvhost_waitlist *waiter)
 	int nr_completed = waiter->count;
 
 	nvhost_module_idle_mult(channel->dev, nr_completed);
-	nvhost_cdma_update(&channel->cdma);
+	nvhost_cdma_update_at(&channel->cdma, waiter->time);
 
 	/*  Add nr_completed to trace */
 	trace_nvhost_channel_submit_complete(channel->dev->name,
@@ -164,6 +206,13 @@ static void action_wakeup_interruptible(struct nvhost_waitlist *waiter)
 	wake_up_interruptible(wq);
 }
 
+static void action_signal_sync_pt(struct nvhost_waitlist *waiter)
+{
+	struct nvhost_sync_timeline *obj = waiter->data;
+
+	nvhost_sync_timeline_signal(obj, waiter->count);
+}
+
 typedef void (*action_handler)(struct nvhost_waitlist *waiter);
 
 static action_handler action_handlers[NVHOST_INTR_ACTION_COUNT] = {
@@ -171,6 +220,7 @@ static action_handler action_handlers[NVHOST_INTR_ACTION_COUNT] = {
 	action_ctxsave,
 	action_wakeup,
 	action_wakeup_interruptible,
+	action_signal_sync_pt,
 };
 
 static void run_handlers(struct list_head completed[NVHOST_INTR_ACTION_COUNT])
@@ -196,8 +246,9 @@ static void run_handlers(struct list_head completed[NVHOST_INTR_ACTION_COUNT])
  */
 static int process_wait_list(struct nvhost_intr *intr,
 			     struct nvhost_intr_syncpt *syncpt,
-			     u32 threshold)
+			     u32 threshold, ktime_t now)
 {
+	struct nvhost_syncpt *sp = &intr_to_dev(intr)->syncpt;
 	struct list_head completed[NVHOST_INTR_ACTION_COUNT];
 	unsigned int i;
 	int empty;
@@ -207,14 +258,30 @@ static int process_wait_list(struct nvhost_intr *intr,
 
 	spin_lock(&syncpt->lock);
 
-	remove_completed_waiters(&syncpt->wait_head, threshold, completed);
+	for (;;) {
+		u32 next;
 
-	empty = list_empty(&syncpt->wait_head);
-	if (empty)
-		intr_op().disable_syncpt_intr(intr, syncpt->id);
-	else
-		reset_threshold_interrupt(intr, &syncpt->wait_head,
-					  syncpt->id);
+		remove_completed_waiters(&syncpt->wait_head, threshold, now,
+					 completed);
+
+		empty = list_empty(&syncpt->wait_head);
+		if (empty) {
+			intr_op().disable_syncpt_intr(intr, syncpt->id);
+			break;
+		}
+
+		/* if the sync point has moved past the next threshold
+		 * meanwhile, take those waiters now instead of through
+		 * another interrupt */
+		next = list_first_entry(&syncpt->wait_head,
+				struct nvhost_waitlist, list)->thresh;
+		threshold = nvhost_syncpt_update_min(sp, syncpt->id);
+		if ((s32)(next - threshold) > 0) {
+			reset_threshold_interrupt(intr, &syncpt->wait_head,
+						  syncpt->id);
+			break;
+		}
+	}
 
 	spin_unlock(&syncpt->lock);
 
@@ -234,13 +301,23 @@ irqreturn_t nvhost_syncpt_thresh_fn(int irq, void *dev_id)
 	unsigned int id = syncpt->id;
 	struct nvhost_intr *intr = intr_syncpt_to_intr(syncpt);
 	struct nvhost_master *dev = intr_to_dev(intr);
+	ktime_t now = ktime_get();
+
+	atomic_inc(&syncpt_intr_count);
 
 	(void)process_wait_list(intr, syncpt,
-				nvhost_syncpt_update_min(&dev->syncpt, id));
+				nvhost_syncpt_update_min(&dev->syncpt, id),
+				now);
 
 	return IRQ_HANDLED;
 }
 
+u32 nvhost_syncpt_intr_count(void)
+{
+	return atomic_read(&syncpt_intr_count);
+}
+EXPORT_SYMBOL(nvhost_syncpt_intr_count);
+
 irqreturn_t nvhost_intr_irq_fn(int irq, void *dev_id)
 {
 	struct nvhost_intr *intr = dev_id;
@@ -309,8 +386,81 @@ int nvhost_intr_add_action(struct nvhost_intr *intr, u32 id, u32 thresh,
 
 void *nvhost_intr_alloc_waiter()
 {
-	return kzalloc(sizeof(struct nvhost_waitlist),
-			GFP_KERNEL|__GFP_REPEAT);
+	struct nvhost_waitlist *waiter;
+	struct llist_node *node;
+
+	spin_lock(&waiter_pool_lock);
+	node = llist_del_first(&waiter_pool);
+	spin_unlock(&waiter_pool_lock);
+
+	if (node) {
+		atomic_dec(&waiter_pool_count);
+		atomic_inc(&waiter_pool_hits);
+		waiter = llist_entry(node, struct nvhost_waitlist, pool_node);
+		memset(waiter, 0, sizeof(*waiter));
+		return waiter;
+	}
+
+	atomic_inc(&waiter_alloc_fallbacks);
+	return kmem_cache_zalloc(waiter_cache, GFP_KERNEL|__GFP_REPEAT);
+}
+
+void nvhost_intr_free_waiter(void *waiter)
+{
+	if (waiter)
+		waiter_free(waiter);
+}
+
+static int waiter_pool_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "pooled: %d\nhits: %d\nalloc fallbacks: %d\n"
+		   "free overflows: %d\n",
+		   atomic_read(&waiter_pool_count),
+		   atomic_read(&waiter_pool_hits),
+		   atomic_read(&waiter_alloc_fallbacks),
+		   atomic_read(&waiter_free_overflows));
+	return 0;
+}
+
+static int waiter_pool_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, waiter_pool_show, inode->i_private);
+}
+
+static const struct file_operations waiter_pool_fops = {
+	.open = waiter_pool_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void nvhost_intr_debug_init(struct dentry *de)
+{
+	debugfs_create_file("waiter_pool", S_IRUGO, de, NULL,
+			&waiter_pool_fops);
+}
+
+static int waiter_pool_init(void)
+{
+	int i;
+
+	if (waiter_cache)
+		return 0;
+
+	waiter_cache = KMEM_CACHE(nvhost_waitlist, 0);
+	if (!waiter_cache)
+		return -ENOMEM;
+
+	/* a short pool only means more fallbacks later */
+	for (i = 0; i < NVHOST_WAITER_POOL_SIZE; i++) {
+		struct nvhost_waitlist *waiter;
+
+		waiter = kmem_cache_zalloc(waiter_cache, GFP_KERNEL);
+		if (!waiter)
+			break;
+		waiter_free(waiter);
+	}
+	return 0;
 }
 
 void nvhost_intr_put_ref(struct nvhost_intr *intr, u32 id, void *ref)
@@ -325,7 +475,8 @@ void nvhost_intr_put_ref(struct nvhost_intr *intr, u32 id, void *ref)
 
 	syncpt = intr->syncpt + id;
 	(void)process_wait_list(intr, syncpt,
-				nvhost_syncpt_update_min(&host->syncpt, id));
+				nvhost_syncpt_update_min(&host->syncpt, id),
+				ktime_get());
 
 	kref_put(&waiter->refcount, waiter_release);
 }
@@ -339,10 +490,14 @@ int nvhost_intr_init(struct nvhost_intr *intr, u32 irq_gen, u32 irq_sync)
 	struct nvhost_intr_syncpt *syncpt;
 	struct nvhost_master *host = intr_to_dev(intr);
 	u32 nb_pts = nvhost_syncpt_nb_pts(&host->syncpt);
+	int err;
+
+	err = waiter_pool_init();
+	if (err)
+		return err;
 
 	mutex_init(&intr->mutex);
 	intr->host_syncpt_irq_base = irq_sync;
-	intr->wq = create_workqueue("host_syncpt");
 	intr_op().init_host_sync(intr);
 	intr->host_general_irq = irq_gen;
 	intr_op().request_host_general_irq(intr);
@@ -366,7 +521,6 @@ int nvhost_intr_init(struct nvhost_intr *intr, u32 irq_gen, u32 irq_sync)
 void nvhost_intr_deinit(struct nvhost_intr *intr)
 {
 	nvhost_intr_stop(intr);
-	destroy_workqueue(intr->wq);
 }
 
 void nvhost_intr_start(struct nvhost_intr *intr, u32 hz)
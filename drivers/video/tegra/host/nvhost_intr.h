@@ -27,6 +27,7 @@
 #include <linux/workqueue.h>
 
 struct nvhost_channel;
+struct dentry;
 
 enum nvhost_intr_action {
 	/**
@@ -53,6 +54,12 @@ enum nvhost_intr_action {
 	 */
 	NVHOST_INTR_ACTION_WAKEUP_INTERRUPTIBLE,
 
+	/**
+	 * Signal a sync framework timeline.
+	 * 'data' points to a nvhost_sync_timeline
+	 */
+	NVHOST_INTR_ACTION_SIGNAL_SYNC_PT,
+
 	NVHOST_INTR_ACTION_COUNT
 };
 
@@ -65,7 +72,6 @@ struct nvhost_intr_syncpt {
 	spinlock_t lock;
 	struct list_head wait_head;
 	char thresh_irq_name[12];
-	struct work_struct work;
 };
 
 struct nvhost_intr {
@@ -73,7 +79,7 @@ struct nvhost_intr {
 	struct mutex mutex;
 	int host_general_irq;
 	int host_syncpt_irq_base;
-	struct workqueue_struct *wq;
+	unsigned long *syncpt_pending;	/* set in isr, handled in thread */
 	void (*generic_isr[BITS_PER_LONG])(void);
 	void (*generic_isr_thread[BITS_PER_LONG])(void);
 	u32 intstatus;
@@ -103,6 +109,11 @@ int nvhost_intr_add_action(struct nvhost_intr *intr, u32 id, u32 thresh,
  */
 void *nvhost_intr_alloc_waiter(void);
 
+/**
+ * Free a waiter that was never passed to nvhost_intr_add_action().
+ */
+void nvhost_intr_free_waiter(void *waiter);
+
 /**
  * Unreference an action submitted to nvhost_intr_add_action().
  * You must call this if you passed non-NULL as ref.
@@ -112,6 +123,7 @@ void nvhost_intr_put_ref(struct nvhost_intr *intr, u32 id, void *ref);
 
 int nvhost_intr_init(struct nvhost_intr *intr, u32 irq_gen, u32 irq_sync);
 void nvhost_intr_deinit(struct nvhost_intr *intr);
+void nvhost_intr_debug_init(struct dentry *de);
 void nvhost_intr_start(struct nvhost_intr *intr, u32 hz);
 void nvhost_intr_stop(struct nvhost_intr *intr);
 
@@ -161,7 +161,7 @@ void nvhost_job_add_gather(struct nvhost_job *job,
  * avoid a wrap condition in the HW).
  */
 static int do_waitchks(struct nvhost_job *job, struct nvhost_syncpt *sp,
-		u32 patch_mem, struct mem_handle *h)
+		u32 patch_mem, struct mem_handle *h, void *vaddr, size_t size)
 {
 	int i;
 
@@ -200,6 +200,14 @@ static int do_waitchks(struct nvhost_job *job, struct nvhost_syncpt *sp,
 			    nvhost_syncpt_read_min(sp, wait->syncpt_id));
 
 			/* patch the wait */
+			if (vaddr) {
+				if (wait->offset + sizeof(u32) > size)
+					return -EINVAL;
+				nvhost_syncpt_patch_wait(sp,
+						vaddr + wait->offset);
+				goto next;
+			}
+
 			patch_addr = mem_op().kmap(h,
 					wait->offset >> PAGE_SHIFT);
 			if (patch_addr) {
@@ -214,6 +222,7 @@ static int do_waitchks(struct nvhost_job *job, struct nvhost_syncpt *sp,
 			}
 		}
 
+next:
 		wait->mem = 0;
 	}
 	return 0;
@@ -249,19 +258,37 @@ static int pin_job_mem(struct nvhost_job *job)
 		ids, job->addr_phys,
 		count,
 		job->unpins);
-	kfree(ids);
 
-	if (result > 0)
+	if (result > 0) {
 		job->num_unpins = result;
+		nvhost_pin_cache_touch(&job->ch->pin_cache, job->memmgr,
+				job->ch->dev, ids, count);
+	}
+	kfree(ids);
 
 	return result;
 }
 
+static void reloc_kunmap(struct mem_handle *h, int page, void *addr,
+		bool dirty)
+{
+	if (dirty)
+		mem_op().kunmap(h, page, addr);
+	else
+		mem_op().kunmap_clean(h, page, addr);
+}
+
+/*
+ * Patch the relocs of one gather. With vaddr set, the gather is kept
+ * mapped by the pin cache and is patched in place, otherwise each page
+ * is mapped in turn.
+ */
 static int do_relocs(struct nvhost_job *job,
-		u32 cmdbuf_mem, struct mem_handle *h)
+		u32 cmdbuf_mem, struct mem_handle *h, void *vaddr, size_t size)
 {
 	int i = 0;
 	int last_page = -1;
+	bool page_dirty = false;
 	void *cmdbuf_page_addr = NULL;
 
 	/* pin & patch the relocs for one gather */
@@ -275,25 +302,48 @@ static int do_relocs(struct nvhost_job *job,
 			continue;
 		}
 
-		if (last_page != reloc->cmdbuf_offset >> PAGE_SHIFT) {
-			if (cmdbuf_page_addr)
-				mem_op().kunmap(h, last_page, cmdbuf_page_addr);
+		u32 target;
+		void *slot;
+
+		if (vaddr) {
+			if (reloc->cmdbuf_offset + sizeof(u32) > size)
+				return -EINVAL;
+			slot = vaddr + reloc->cmdbuf_offset;
+		} else {
+			int page = reloc->cmdbuf_offset >> PAGE_SHIFT;
 
-			cmdbuf_page_addr = mem_op().kmap(h,
-					reloc->cmdbuf_offset >> PAGE_SHIFT);
-			last_page = reloc->cmdbuf_offset >> PAGE_SHIFT;
+			if (last_page != page) {
+				if (cmdbuf_page_addr)
+					reloc_kunmap(h, last_page,
+						cmdbuf_page_addr, page_dirty);
 
-			if (unlikely(!cmdbuf_page_addr)) {
-				pr_err("Couldn't map cmdbuf for relocation\n");
-				return -ENOMEM;
+				cmdbuf_page_addr = mem_op().kmap(h, page);
+				last_page = page;
+				page_dirty = false;
+
+				if (unlikely(!cmdbuf_page_addr)) {
+					pr_err("Couldn't map cmdbuf for relocation\n");
+					return -ENOMEM;
+				}
 			}
+			slot = cmdbuf_page_addr +
+				(reloc->cmdbuf_offset & ~PAGE_MASK);
 		}
 
-		__raw_writel(
-			(job->reloc_addr_phys[i] +
-				reloc->target_offset) >> shift->shift,
-			(cmdbuf_page_addr +
-				(reloc->cmdbuf_offset & ~PAGE_MASK)));
+		target = (job->reloc_addr_phys[i] +
+				reloc->target_offset) >> shift->shift;
+
+		/*
+		 * With the target still pinned at the same address, a reused
+		 * cmdbuf already holds the value patched on the last submit.
+		 */
+		if (__raw_readl(slot) == target) {
+			job->num_relocs_skipped++;
+		} else {
+			__raw_writel(target, slot);
+			job->num_relocs_patched++;
+			page_dirty = true;
+		}
 
 		/* remove completed reloc from the job */
 		if (i != job->num_relocs - 1) {
@@ -315,7 +365,7 @@ static int do_relocs(struct nvhost_job *job,
 	}
 
 	if (cmdbuf_page_addr)
-		mem_op().kunmap(h, last_page, cmdbuf_page_addr);
+		reloc_kunmap(h, last_page, cmdbuf_page_addr, page_dirty);
 
 	return 0;
 }
@@ -326,6 +376,9 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 	int err = 0, i = 0, j = 0;
 	unsigned long waitchk_mask[nvhost_syncpt_nb_pts(sp) / BITS_PER_LONG];
 
+	job->num_relocs_patched = 0;
+	job->num_relocs_skipped = 0;
+
 	memset(&waitchk_mask[0], 0, sizeof(waitchk_mask));
 	for (i = 0; i < job->num_waitchk; i++) {
 		u32 syncpt_id = job->waitchk[i].syncpt_id;
@@ -346,6 +399,8 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 	/* patch gathers */
 	for (i = 0; i < job->num_gathers; i++) {
 		struct nvhost_job_gather *g = &job->gathers[i];
+		void *vaddr, *cookie = NULL;
+		size_t size = 0;
 
 		/* process each gather mem only once */
 		if (!g->ref) {
@@ -367,15 +422,25 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 					tmp->mem_base = g->mem_base;
 				}
 			}
-			err = do_relocs(job, g->mem_id,  g->ref);
+			vaddr = nvhost_pin_cache_map(&job->ch->pin_cache,
+					job->memmgr, g->mem_id, &size, &cookie);
+			err = do_relocs(job, g->mem_id,  g->ref, vaddr, size);
 			if (!err)
 				err = do_waitchks(job, sp,
-						g->mem_id, g->ref);
+						g->mem_id, g->ref, vaddr, size);
+			if (vaddr)
+				nvhost_pin_cache_unmap(&job->ch->pin_cache,
+						cookie);
 			mem_op().put(job->memmgr, g->ref);
 			if (err)
 				break;
 		}
 	}
+
+	atomic64_add(job->num_relocs_patched, &job->ch->relocs_patched);
+	atomic64_add(job->num_relocs_skipped, &job->ch->relocs_skipped);
+	trace_nvhost_job_relocs(dev_name(&job->ch->dev->dev),
+			job->num_relocs_patched, job->num_relocs_skipped);
 fail:
 	wmb();
 
@@ -23,6 +23,7 @@
 
 #include <linux/nvhost_ioctl.h>
 #include <linux/kref.h>
+#include <linux/ktime.h>
 
 struct nvhost_channel;
 struct nvhost_hwctx;
@@ -74,6 +75,10 @@ struct nvhost_job {
 	struct nvhost_job_unpin *unpins;
 	int num_unpins;
 
+	/* Relocs rewritten vs. found already holding the target address */
+	u32 num_relocs_patched;
+	u32 num_relocs_skipped;
+
 	dma_addr_t *addr_phys;
 	dma_addr_t *gather_addr_phys;
 	dma_addr_t *reloc_addr_phys;
@@ -86,6 +91,15 @@ struct nvhost_job {
 	/* Priority of this submit. */
 	int priority;
 
+	/* When the submit reached the channel, for latency stats */
+	ktime_t submit_time;
+
+	/* When the submit was added to the push buffer */
+	ktime_t pb_time;
+
+	/* Input frame id current at submit, for frame tracing */
+	u32 frame;
+
 	/* Maximum time to wait for this job */
 	int timeout;
 
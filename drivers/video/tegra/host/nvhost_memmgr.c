@@ -215,6 +215,22 @@ void nvhost_memmgr_munmap(struct mem_handle *handle, void *addr)
 	}
 }
 
+/* dmabuf buffers are never mapped persistently */
+void *nvhost_memmgr_mmap_wc(struct mem_handle *handle, size_t max_size,
+		size_t *size)
+{
+	switch (nvhost_memmgr_type((u32)handle)) {
+#ifdef CONFIG_TEGRA_GRHOST_USE_NVMAP
+	case mem_mgr_type_nvmap:
+		return nvhost_nvmap_mmap_wc(handle, max_size, size);
+		break;
+#endif
+	default:
+		return NULL;
+		break;
+	}
+}
+
 void *nvhost_memmgr_kmap(struct mem_handle *handle, unsigned int pagenum)
 {
 	switch (nvhost_memmgr_type((u32)handle)) {
@@ -253,6 +269,25 @@ void nvhost_memmgr_kunmap(struct mem_handle *handle, unsigned int pagenum,
 	}
 }
 
+void nvhost_memmgr_kunmap_clean(struct mem_handle *handle,
+		unsigned int pagenum, void *addr)
+{
+	switch (nvhost_memmgr_type((u32)handle)) {
+#ifdef CONFIG_TEGRA_GRHOST_USE_NVMAP
+	case mem_mgr_type_nvmap:
+		nvhost_nvmap_kunmap_clean(handle, pagenum, addr);
+		break;
+#endif
+#ifdef CONFIG_TEGRA_GRHOST_USE_DMABUF
+	case mem_mgr_type_dmabuf:
+		nvhost_dmabuf_kunmap(handle, pagenum, addr);
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
 int nvhost_memmgr_pin_array_ids(struct mem_mgr *mgr,
 		struct platform_device *dev,
 		long unsigned *ids,
@@ -314,9 +349,11 @@ static const struct nvhost_mem_ops mem_ops = {
 	.pin = nvhost_memmgr_pin,
 	.unpin = nvhost_memmgr_unpin,
 	.mmap = nvhost_memmgr_mmap,
+	.mmap_wc = nvhost_memmgr_mmap_wc,
 	.munmap = nvhost_memmgr_munmap,
 	.kmap = nvhost_memmgr_kmap,
 	.kunmap = nvhost_memmgr_kunmap,
+	.kunmap_clean = nvhost_memmgr_kunmap_clean,
 	.pin_array_ids = nvhost_memmgr_pin_array_ids,
 };
 
@@ -0,0 +1,373 @@
+/*
+ * drivers/video/tegra/host/nvhost_pin_cache.c
+ *
+ * Tegra Graphics Host Channel Pin Cache
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/err.h>
+#include <linux/hash.h>
+#include <linux/jiffies.h>
+#include <linux/mm.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+
+#include "nvhost_pin_cache.h"
+#include "nvhost_channel.h"
+#include "nvhost_memmgr.h"
+#include "chip_support.h"
+
+/* entries per channel before the least recently used one is evicted */
+#define NVHOST_PIN_CACHE_MAX	128
+/* entries not referenced by a submit for this long are released */
+#define NVHOST_PIN_CACHE_AGE	HZ
+/* largest gather kept mapped, and kernel address space per channel */
+#define NVHOST_PIN_CACHE_MAP_MAX	(256 * 1024)
+#define NVHOST_PIN_CACHE_MAP_BUDGET	(2 * 1024 * 1024)
+
+struct pin_cache_entry {
+	struct hlist_node hnode;
+	struct list_head lru;
+	struct mem_mgr *mgr;
+	unsigned long id;
+	struct mem_handle *h;
+	struct sg_table *sgt;
+	unsigned long last_used;
+	void *vaddr;			/* persistent mapping of a gather */
+	size_t size;
+	bool map_tried;
+	int users;			/* nvhost_pin_cache_map() callers */
+};
+
+static LIST_HEAD(pin_caches);
+static DEFINE_MUTEX(pin_caches_lock);
+
+static inline struct hlist_head *pin_cache_bucket(
+		struct nvhost_pin_cache *cache,
+		struct mem_mgr *mgr, unsigned long id)
+{
+	unsigned long key = id ^ (unsigned long)mgr;
+
+	return &cache->hash[hash_long(key, NVHOST_PIN_CACHE_BITS)];
+}
+
+static void pin_cache_free(struct nvhost_pin_cache *cache,
+		struct pin_cache_entry *e)
+{
+	if (e->vaddr) {
+		mem_op().munmap(e->h, e->vaddr);
+		cache->mapped_bytes -= e->size;
+	}
+	mem_op().unpin(e->mgr, e->h, e->sgt);
+	mem_op().put(e->mgr, e->h);
+	mem_op().put_mgr(e->mgr);
+	kfree(e);
+}
+
+/* an entry still mapped by a submit is unlinked now and freed by unmap */
+static void pin_cache_release_locked(struct nvhost_pin_cache *cache,
+		struct pin_cache_entry *e)
+{
+	hlist_del_init(&e->hnode);
+	list_del_init(&e->lru);
+	cache->count--;
+
+	if (!e->users)
+		pin_cache_free(cache, e);
+}
+
+static struct pin_cache_entry *pin_cache_find_locked(
+		struct nvhost_pin_cache *cache,
+		struct mem_mgr *mgr, unsigned long id)
+{
+	struct pin_cache_entry *e;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(e, pos, pin_cache_bucket(cache, mgr, id), hnode)
+		if (e->mgr == mgr && e->id == id)
+			return e;
+	return NULL;
+}
+
+static void pin_cache_insert_locked(struct nvhost_pin_cache *cache,
+		struct mem_mgr *mgr, struct platform_device *dev,
+		unsigned long id)
+{
+	struct pin_cache_entry *e;
+
+	e = kzalloc(sizeof(*e), GFP_KERNEL | __GFP_NOWARN);
+	if (!e)
+		return;
+
+	e->h = mem_op().get(mgr, id, dev);
+	if (IS_ERR(e->h))
+		goto fail;
+
+	e->sgt = mem_op().pin(mgr, e->h);
+	if (IS_ERR(e->sgt)) {
+		mem_op().put(mgr, e->h);
+		goto fail;
+	}
+
+	if (cache->count >= NVHOST_PIN_CACHE_MAX) {
+		struct pin_cache_entry *old;
+
+		old = list_first_entry(&cache->lru,
+				struct pin_cache_entry, lru);
+		pin_cache_release_locked(cache, old);
+		cache->evictions++;
+	}
+
+	e->mgr = mem_op().get_mgr(mgr);
+	e->id = id;
+	e->last_used = jiffies;
+	hlist_add_head(&e->hnode, pin_cache_bucket(cache, mgr, id));
+	list_add_tail(&e->lru, &cache->lru);
+	cache->count++;
+	return;
+
+fail:
+	kfree(e);
+}
+
+/*
+ * Record that ids were pinned for a job submitted by mgr. The ids must
+ * already have been validated against mgr by pin_array_ids.
+ */
+void nvhost_pin_cache_touch(struct nvhost_pin_cache *cache,
+		struct mem_mgr *mgr, struct platform_device *dev,
+		unsigned long *ids, u32 count)
+{
+	u32 i;
+
+	mutex_lock(&cache->lock);
+	for (i = 0; i < count; i++) {
+		struct pin_cache_entry *e;
+
+		e = pin_cache_find_locked(cache, mgr, ids[i]);
+		if (e) {
+			e->last_used = jiffies;
+			list_move_tail(&e->lru, &cache->lru);
+			cache->hits++;
+			continue;
+		}
+
+		cache->misses++;
+		pin_cache_insert_locked(cache, mgr, dev, ids[i]);
+	}
+
+	if (cache->count)
+		schedule_delayed_work(&cache->age_work, NVHOST_PIN_CACHE_AGE);
+	mutex_unlock(&cache->lock);
+}
+
+/*
+ * Return a kernel mapping of a cached buffer that stays valid until
+ * nvhost_pin_cache_unmap(), or NULL if the buffer is not cached or
+ * cannot be kept mapped. Only write-combined or uncached buffers are
+ * mapped, so writes through the mapping need no cache maintenance.
+ */
+void *nvhost_pin_cache_map(struct nvhost_pin_cache *cache,
+		struct mem_mgr *mgr, unsigned long id, size_t *size,
+		void **cookie)
+{
+	struct pin_cache_entry *e;
+	void *vaddr = NULL;
+
+	mutex_lock(&cache->lock);
+	e = pin_cache_find_locked(cache, mgr, id);
+	if (!e)
+		goto out;
+
+	if (!e->vaddr && !e->map_tried) {
+		size_t budget = NVHOST_PIN_CACHE_MAP_BUDGET -
+			cache->mapped_bytes;
+
+		e->map_tried = true;
+		e->vaddr = mem_op().mmap_wc(e->h,
+				min_t(size_t, budget, NVHOST_PIN_CACHE_MAP_MAX),
+				&e->size);
+		if (IS_ERR_OR_NULL(e->vaddr))
+			e->vaddr = NULL;
+		else
+			cache->mapped_bytes += e->size;
+	}
+
+	if (e->vaddr) {
+		e->users++;
+		vaddr = e->vaddr;
+		*size = e->size;
+		*cookie = e;
+		cache->map_hits++;
+	}
+out:
+	mutex_unlock(&cache->lock);
+	return vaddr;
+}
+
+void nvhost_pin_cache_unmap(struct nvhost_pin_cache *cache, void *cookie)
+{
+	struct pin_cache_entry *e = cookie;
+
+	mutex_lock(&cache->lock);
+	if (!--e->users && list_empty(&e->lru))
+		pin_cache_free(cache, e);
+	mutex_unlock(&cache->lock);
+}
+
+void nvhost_pin_cache_drop_mgr(struct nvhost_pin_cache *cache,
+		struct mem_mgr *mgr)
+{
+	struct pin_cache_entry *e, *tmp;
+
+	mutex_lock(&cache->lock);
+	list_for_each_entry_safe(e, tmp, &cache->lru, lru)
+		if (e->mgr == mgr)
+			pin_cache_release_locked(cache, e);
+	mutex_unlock(&cache->lock);
+}
+
+static void pin_cache_age(struct work_struct *work)
+{
+	struct nvhost_pin_cache *cache = container_of(to_delayed_work(work),
+			struct nvhost_pin_cache, age_work);
+	struct pin_cache_entry *e, *tmp;
+
+	mutex_lock(&cache->lock);
+	list_for_each_entry_safe(e, tmp, &cache->lru, lru) {
+		/* the list is in use order, so stop at the first live one */
+		if (!cache->flush &&
+		    time_before(jiffies, e->last_used + NVHOST_PIN_CACHE_AGE))
+			break;
+		pin_cache_release_locked(cache, e);
+		cache->evictions++;
+	}
+	cache->flush = false;
+
+	if (cache->count)
+		schedule_delayed_work(&cache->age_work, NVHOST_PIN_CACHE_AGE);
+	mutex_unlock(&cache->lock);
+}
+
+/*
+ * The shrinker cannot release pins directly: reclaim may be entered with
+ * memmgr locks held that unpin needs. Hand the work to the aging pass.
+ */
+static int pin_cache_shrink(struct shrinker *shrinker,
+		struct shrink_control *sc)
+{
+	struct nvhost_pin_cache *cache;
+	int count = 0;
+
+	if (!mutex_trylock(&pin_caches_lock))
+		return -1;
+
+	list_for_each_entry(cache, &pin_caches, node) {
+		count += ACCESS_ONCE(cache->count);
+		if (sc->nr_to_scan && cache->count) {
+			cache->flush = true;
+			cancel_delayed_work(&cache->age_work);
+			schedule_delayed_work(&cache->age_work, 0);
+		}
+	}
+	mutex_unlock(&pin_caches_lock);
+
+	return sc->nr_to_scan ? 0 : count;
+}
+
+static struct shrinker pin_cache_shrinker = {
+	.shrink = pin_cache_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+void nvhost_pin_cache_init(struct nvhost_pin_cache *cache)
+{
+	int i;
+
+	mutex_init(&cache->lock);
+	for (i = 0; i < NVHOST_PIN_CACHE_SIZE; i++)
+		INIT_HLIST_HEAD(&cache->hash[i]);
+	INIT_LIST_HEAD(&cache->lru);
+	INIT_DELAYED_WORK(&cache->age_work, pin_cache_age);
+
+	mutex_lock(&pin_caches_lock);
+	if (list_empty(&pin_caches))
+		register_shrinker(&pin_cache_shrinker);
+	list_add_tail(&cache->node, &pin_caches);
+	mutex_unlock(&pin_caches_lock);
+}
+
+void nvhost_pin_cache_deinit(struct nvhost_pin_cache *cache)
+{
+	struct pin_cache_entry *e, *tmp;
+
+	mutex_lock(&pin_caches_lock);
+	list_del(&cache->node);
+	if (list_empty(&pin_caches))
+		unregister_shrinker(&pin_cache_shrinker);
+	mutex_unlock(&pin_caches_lock);
+
+	cancel_delayed_work_sync(&cache->age_work);
+
+	mutex_lock(&cache->lock);
+	list_for_each_entry_safe(e, tmp, &cache->lru, lru)
+		pin_cache_release_locked(cache, e);
+	mutex_unlock(&cache->lock);
+}
+
+static int pin_cache_show(struct seq_file *s, void *unused)
+{
+	struct nvhost_pin_cache *cache;
+
+	mutex_lock(&pin_caches_lock);
+	list_for_each_entry(cache, &pin_caches, node) {
+		struct nvhost_channel *ch = container_of(cache,
+				struct nvhost_channel, pin_cache);
+
+		mutex_lock(&cache->lock);
+		seq_printf(s, "%-16s entries %3u hits %llu misses %llu "
+			   "evictions %llu mapped %zu map hits %llu "
+			   "relocs patched %llu skipped %llu\n",
+			   ch->dev ? dev_name(&ch->dev->dev) : "?",
+			   cache->count, cache->hits, cache->misses,
+			   cache->evictions, cache->mapped_bytes,
+			   cache->map_hits,
+			   (u64)atomic64_read(&ch->relocs_patched),
+			   (u64)atomic64_read(&ch->relocs_skipped));
+		mutex_unlock(&cache->lock);
+	}
+	mutex_unlock(&pin_caches_lock);
+	return 0;
+}
+
+static int pin_cache_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pin_cache_show, inode->i_private);
+}
+
+static const struct file_operations pin_cache_fops = {
+	.open = pin_cache_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void nvhost_pin_cache_debug_init(struct dentry *de)
+{
+	debugfs_create_file("pin_cache", S_IRUGO, de, NULL,
+			&pin_cache_fops);
+}
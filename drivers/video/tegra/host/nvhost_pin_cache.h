@@ -0,0 +1,71 @@
+/*
+ * drivers/video/tegra/host/nvhost_pin_cache.h
+ *
+ * Tegra Graphics Host Channel Pin Cache
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NVHOST_PIN_CACHE_H
+#define __NVHOST_PIN_CACHE_H
+
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+
+#define NVHOST_PIN_CACHE_BITS	6
+#define NVHOST_PIN_CACHE_SIZE	(1 << NVHOST_PIN_CACHE_BITS)
+
+struct mem_mgr;
+struct platform_device;
+struct dentry;
+
+/*
+ * Per-channel cache of pinned buffers. Every buffer referenced by a
+ * submitted job gets one extra pin that is held here, so the job's own
+ * pin/unpin pair never drops the pin count to zero and the IOVMM mapping
+ * survives between submits of the same buffer.
+ */
+struct nvhost_pin_cache {
+	struct mutex lock;
+	struct hlist_head hash[NVHOST_PIN_CACHE_SIZE];
+	struct list_head lru;		/* least recently used first */
+	unsigned int count;
+	bool flush;			/* drop everything on next aging pass */
+	struct delayed_work age_work;
+	struct list_head node;		/* on the global list for the shrinker */
+
+	size_t mapped_bytes;		/* kernel mappings of gathers */
+
+	u64 hits;
+	u64 misses;
+	u64 evictions;
+	u64 map_hits;
+};
+
+void nvhost_pin_cache_init(struct nvhost_pin_cache *cache);
+void nvhost_pin_cache_deinit(struct nvhost_pin_cache *cache);
+void nvhost_pin_cache_touch(struct nvhost_pin_cache *cache,
+		struct mem_mgr *mgr, struct platform_device *dev,
+		unsigned long *ids, u32 count);
+void *nvhost_pin_cache_map(struct nvhost_pin_cache *cache,
+		struct mem_mgr *mgr, unsigned long id, size_t *size,
+		void **cookie);
+void nvhost_pin_cache_unmap(struct nvhost_pin_cache *cache, void *cookie);
+void nvhost_pin_cache_drop_mgr(struct nvhost_pin_cache *cache,
+		struct mem_mgr *mgr);
+void nvhost_pin_cache_debug_init(struct dentry *de);
+
+#endif
@@ -0,0 +1,511 @@
+/*
+ * drivers/video/tegra/host/nvhost_scale.c
+ *
+ * Tegra Graphics Host Unit clock scaling
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Generic unit clock scaling
+ *
+ * nvhost_scale_notify_busy() is called from nvhost_module_busy() and
+ * nvhost_scale_notify_idle() when the unit's refcount drops back to zero.
+ * The time spent between the two is the unit's busy time, which devfreq
+ * polls through get_dev_status() and feeds to the simple_ondemand
+ * governor. The unit's emc clock, if it has one, is requested in
+ * proportion to the unit clock.
+ *
+ * The frequency statistics below are shared with the gr3d scaling code.
+ */
+
+#include <linux/devfreq.h>
+#include <linux/clk.h>
+#include <linux/debugfs.h>
+#include <linux/err.h>
+#include <linux/export.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "nvhost_scale.h"
+#include "nvhost_acm.h"
+#include "dev.h"
+
+#define NVHOST_SCALE_POLL_MS		50
+#define NVHOST_SCALE_UPTHRESHOLD	80
+#define NVHOST_SCALE_DOWNDIFFERENTIAL	10
+
+/* fold the time since the last event into the busy/total counters */
+static void nvhost_scale_account_locked(struct nvhost_device_profile *profile,
+					ktime_t now)
+{
+	s64 delta = ktime_us_delta(now, profile->last_event);
+
+	if (delta > 0) {
+		profile->total_us += delta;
+		if (profile->busy)
+			profile->busy_us += delta;
+	}
+	profile->last_event = now;
+}
+
+static void nvhost_scale_notify(struct platform_device *pdev, bool busy)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_device_profile *profile = pdata->power_profile;
+	unsigned long flags;
+
+	if (!profile)
+		return;
+
+	spin_lock_irqsave(&profile->lock, flags);
+	if (profile->busy != busy) {
+		nvhost_scale_account_locked(profile, ktime_get());
+		profile->busy = busy;
+	}
+	spin_unlock_irqrestore(&profile->lock, flags);
+}
+
+void nvhost_scale_notify_busy(struct platform_device *pdev)
+{
+	nvhost_scale_notify(pdev, true);
+}
+
+void nvhost_scale_notify_idle(struct platform_device *pdev)
+{
+	nvhost_scale_notify(pdev, false);
+}
+
+/*
+ * nvhost_scale_freq_steps(c, max_rate, freqs, max_count)
+ *
+ * Fill freqs with the distinct rates of c up to max_rate. Returns the
+ * number of rates found.
+ */
+int nvhost_scale_freq_steps(struct clk *c, unsigned long max_rate,
+			    unsigned long *freqs, int max_count)
+{
+	long rate = 0;
+	int count = 0;
+
+	while (rate <= max_rate && count < max_count) {
+		long rounded = clk_round_rate(c, rate);
+
+		if (rounded <= 0 || (count && rounded <= freqs[count - 1]))
+			break;
+		freqs[count++] = rounded;
+		rate = rounded + 2000;
+	}
+
+	return count;
+}
+EXPORT_SYMBOL(nvhost_scale_freq_steps);
+
+static int nvhost_scale_stats_find(struct nvhost_scale_stats *stats,
+				   unsigned long freq)
+{
+	int i;
+
+	for (i = 0; i < stats->count - 1; i++)
+		if (stats->freqs[i] >= freq)
+			break;
+	return i;
+}
+
+static void nvhost_scale_stats_account_locked(
+		struct nvhost_scale_stats *stats, ktime_t now)
+{
+	stats->time_us[stats->cur] += ktime_us_delta(now, stats->last);
+	stats->last = now;
+}
+
+/*
+ * nvhost_scale_stats_transition(pdev, freq, start)
+ *
+ * Record that the unit now runs at freq. start is the time the governor
+ * started programming the clocks.
+ */
+void nvhost_scale_stats_transition(struct platform_device *pdev,
+				   unsigned long freq, ktime_t start)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_scale_stats *stats = pdata->scale_stats;
+	unsigned long flags;
+	ktime_t now;
+	int i;
+
+	if (!stats)
+		return;
+
+	now = ktime_get();
+	i = nvhost_scale_stats_find(stats, freq);
+
+	spin_lock_irqsave(&stats->lock, flags);
+	nvhost_scale_stats_account_locked(stats, now);
+	if (i != stats->cur) {
+		stats->trans[i]++;
+		stats->trans_us[i] += ktime_us_delta(now, start);
+		stats->cur = i;
+	}
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+EXPORT_SYMBOL(nvhost_scale_stats_transition);
+
+/*
+ * nvhost_scale_stats_log(pdev, sample)
+ *
+ * Append a governor decision to the decision ring. The time stamp is
+ * filled in here.
+ */
+void nvhost_scale_stats_log(struct platform_device *pdev,
+			    struct nvhost_scale_sample *sample)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_scale_stats *stats = pdata->scale_stats;
+	unsigned long flags;
+
+	if (!stats)
+		return;
+
+	sample->time_us = ktime_to_us(ktime_get());
+
+	spin_lock_irqsave(&stats->lock, flags);
+	stats->log[stats->log_next] = *sample;
+	stats->log_next = (stats->log_next + 1) % NVHOST_SCALE_LOG_SIZE;
+	if (stats->log_count < NVHOST_SCALE_LOG_SIZE)
+		stats->log_count++;
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+EXPORT_SYMBOL(nvhost_scale_stats_log);
+
+#ifdef CONFIG_DEBUG_FS
+static int time_in_state_show(struct seq_file *s, void *unused)
+{
+	struct nvhost_scale_stats *stats = s->private;
+	unsigned long flags;
+	int i;
+
+	seq_printf(s, "  freq (kHz)  time (ms)  transitions  latency (us)\n");
+
+	spin_lock_irqsave(&stats->lock, flags);
+	nvhost_scale_stats_account_locked(stats, ktime_get());
+	for (i = 0; i < stats->count; i++) {
+		u64 lat = 0;
+
+		if (stats->trans[i])
+			lat = div_u64(stats->trans_us[i], stats->trans[i]);
+		seq_printf(s, "%c %10lu %10llu %12u %13llu\n",
+			   i == stats->cur ? '*' : ' ',
+			   stats->freqs[i] / 1000,
+			   div_u64(stats->time_us[i], 1000),
+			   stats->trans[i], lat);
+	}
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	return 0;
+}
+
+static int time_in_state_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, time_in_state_show, inode->i_private);
+}
+
+static const struct file_operations time_in_state_fops = {
+	.open		= time_in_state_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* one line per decision, oldest first, for feeding to replay tools */
+static int decisions_show(struct seq_file *s, void *unused)
+{
+	struct nvhost_scale_stats *stats = s->private;
+	unsigned long flags;
+	unsigned int i, idx;
+
+	seq_printf(s, "# time_us busy_us total_us event idle hint "
+		   "old_khz new_khz\n");
+
+	spin_lock_irqsave(&stats->lock, flags);
+	idx = (stats->log_next + NVHOST_SCALE_LOG_SIZE - stats->log_count) %
+		NVHOST_SCALE_LOG_SIZE;
+	for (i = 0; i < stats->log_count; i++) {
+		struct nvhost_scale_sample *d = &stats->log[idx];
+
+		seq_printf(s, "%lld %lu %lu %d %u %u %lu %lu\n",
+			   d->time_us, d->busy_us, d->total_us, d->event,
+			   d->idle, d->hint, d->old_freq / 1000,
+			   d->new_freq / 1000);
+		idx = (idx + 1) % NVHOST_SCALE_LOG_SIZE;
+	}
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	return 0;
+}
+
+static int decisions_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, decisions_show, inode->i_private);
+}
+
+static const struct file_operations decisions_fops = {
+	.open		= decisions_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void nvhost_scale_stats_debug_init(struct nvhost_device_data *pdata,
+					  struct nvhost_scale_stats *stats)
+{
+	struct dentry *de;
+
+	de = debugfs_create_dir("freq_stats", pdata->debugfs);
+	if (!de)
+		return;
+
+	debugfs_create_file("time_in_state", S_IRUGO, de, stats,
+			    &time_in_state_fops);
+	debugfs_create_file("decisions", S_IRUGO, de, stats,
+			    &decisions_fops);
+	stats->debugdir = de;
+}
+#else
+static void nvhost_scale_stats_debug_init(struct nvhost_device_data *pdata,
+					  struct nvhost_scale_stats *stats)
+{
+}
+#endif
+
+/*
+ * nvhost_scale_stats_init(pdev, freqs, count, cur_freq)
+ *
+ * Start collecting frequency statistics over the given frequency steps.
+ */
+void nvhost_scale_stats_init(struct platform_device *pdev,
+			     unsigned long *freqs, int count,
+			     unsigned long cur_freq)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_scale_stats *stats;
+
+	if (pdata->scale_stats || count <= 0)
+		return;
+
+	stats = kzalloc(sizeof(*stats), GFP_KERNEL);
+	if (!stats)
+		return;
+
+	stats->count = min(count, NVHOST_SCALE_MAX_STEPS);
+	memcpy(stats->freqs, freqs, stats->count * sizeof(*freqs));
+	spin_lock_init(&stats->lock);
+	stats->cur = nvhost_scale_stats_find(stats, cur_freq);
+	stats->last = ktime_get();
+
+	nvhost_scale_stats_debug_init(pdata, stats);
+	pdata->scale_stats = stats;
+}
+EXPORT_SYMBOL(nvhost_scale_stats_init);
+
+void nvhost_scale_stats_deinit(struct platform_device *pdev)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_scale_stats *stats = pdata->scale_stats;
+
+	if (!stats)
+		return;
+
+	pdata->scale_stats = NULL;
+	debugfs_remove_recursive(stats->debugdir);
+	kfree(stats);
+}
+EXPORT_SYMBOL(nvhost_scale_stats_deinit);
+
+static int nvhost_scale_target(struct device *dev, unsigned long *freq,
+			       u32 flags)
+{
+	struct nvhost_device_data *pdata = dev_get_drvdata(dev);
+	struct nvhost_device_profile *profile = pdata->power_profile;
+	struct nvhost_scale_sample sample;
+	unsigned long rate;
+	ktime_t start = ktime_get();
+
+	sample.busy_us = profile->last_busy_us;
+	sample.total_us = profile->last_total_us;
+	sample.event = -1;
+	sample.idle = sample.total_us ? 1000 - div64_u64(
+		(u64)sample.busy_us * 1000, sample.total_us) : 1000;
+	sample.hint = 0;
+	sample.old_freq = profile->cur_rate;
+
+	rate = clamp(*freq, profile->min_rate, profile->max_rate);
+	nvhost_module_set_devfreq_rate(profile->pdev, 0, rate);
+	profile->cur_rate = pdata->clocks[0].devfreq_rate;
+
+	if (profile->emc_index >= 0) {
+		u64 emc = (u64)profile->emc_max_rate * profile->cur_rate;
+
+		nvhost_module_set_devfreq_rate(profile->pdev,
+				profile->emc_index,
+				div64_u64(emc, profile->max_rate));
+	}
+
+	nvhost_scale_stats_transition(profile->pdev, profile->cur_rate, start);
+	sample.new_freq = profile->cur_rate;
+	nvhost_scale_stats_log(profile->pdev, &sample);
+
+	*freq = profile->cur_rate;
+	return 0;
+}
+
+static int nvhost_scale_get_dev_status(struct device *dev,
+				       struct devfreq_dev_status *stat)
+{
+	struct nvhost_device_data *pdata = dev_get_drvdata(dev);
+	struct nvhost_device_profile *profile = pdata->power_profile;
+	unsigned long flags;
+
+	spin_lock_irqsave(&profile->lock, flags);
+	nvhost_scale_account_locked(profile, ktime_get());
+	stat->busy_time = min_t(u64, profile->busy_us, ULONG_MAX);
+	stat->total_time = min_t(u64, profile->total_us, ULONG_MAX);
+	profile->busy_us = 0;
+	profile->total_us = 0;
+	spin_unlock_irqrestore(&profile->lock, flags);
+
+	profile->last_busy_us = stat->busy_time;
+	profile->last_total_us = stat->total_time;
+
+	stat->current_frequency = profile->cur_rate;
+	stat->private_data = NULL;
+	return 0;
+}
+
+static int nvhost_scale_find_emc(struct nvhost_device_data *pdata)
+{
+	int i;
+
+	for (i = 1; i < pdata->num_clks; i++)
+		if (pdata->clocks[i].name &&
+		    !strcmp(pdata->clocks[i].name, "emc"))
+			return i;
+	return -1;
+}
+
+/*
+ * nvhost_scale_init(pdev)
+ *
+ * Start scaling the first clock of the unit with devfreq. Units whose
+ * clock cannot be scaled stay at their default rates.
+ */
+void nvhost_scale_init(struct platform_device *pdev)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_device_profile *profile;
+	struct devfreq *df;
+	void *gov_data = NULL;
+	unsigned long freqs[NVHOST_SCALE_MAX_STEPS];
+	int count;
+
+	if (pdata->power_profile || !pdata->num_clks)
+		return;
+
+	profile = kzalloc(sizeof(*profile), GFP_KERNEL);
+	if (!profile)
+		return;
+
+	profile->pdev = pdev;
+	profile->max_rate = clk_round_rate(pdata->clk[0], UINT_MAX);
+	profile->min_rate = clk_round_rate(pdata->clk[0], 0);
+	if (IS_ERR_VALUE(profile->max_rate) ||
+	    profile->max_rate <= profile->min_rate) {
+		dev_info(&pdev->dev, "scaling disabled: no rate range\n");
+		goto err_profile;
+	}
+	profile->cur_rate = profile->max_rate;
+
+	profile->emc_index = nvhost_scale_find_emc(pdata);
+	if (profile->emc_index >= 0) {
+		int i = profile->emc_index;
+		profile->emc_max_rate = clk_round_rate(pdata->clk[i],
+				pdata->clocks[i].default_rate);
+	}
+
+	spin_lock_init(&profile->lock);
+	profile->last_event = ktime_get();
+
+	profile->devfreq_profile.initial_freq = profile->max_rate;
+	profile->devfreq_profile.polling_ms = NVHOST_SCALE_POLL_MS;
+	profile->devfreq_profile.target = nvhost_scale_target;
+	profile->devfreq_profile.get_dev_status = nvhost_scale_get_dev_status;
+
+#ifdef CONFIG_DEVFREQ_GOV_SIMPLE_ONDEMAND
+	profile->ondemand_data.upthreshold = NVHOST_SCALE_UPTHRESHOLD;
+	profile->ondemand_data.downdifferential =
+		NVHOST_SCALE_DOWNDIFFERENTIAL;
+	gov_data = &profile->ondemand_data;
+#endif
+
+	/* the callbacks may run as soon as devfreq is added */
+	pdata->power_profile = profile;
+
+	df = devfreq_add_device(&pdev->dev, &profile->devfreq_profile,
+				devfreq_simple_ondemand, gov_data);
+	if (IS_ERR_OR_NULL(df)) {
+		pdata->power_profile = NULL;
+		goto err_profile;
+	}
+	pdata->power_manager = df;
+
+	count = nvhost_scale_freq_steps(pdata->clk[0], profile->max_rate,
+					freqs, NVHOST_SCALE_MAX_STEPS);
+	nvhost_scale_stats_init(pdev, freqs, count, profile->cur_rate);
+
+	return;
+
+err_profile:
+	kfree(profile);
+}
+EXPORT_SYMBOL(nvhost_scale_init);
+
+/*
+ * nvhost_scale_deinit(pdev)
+ *
+ * Stop scaling and return the unit to its default rates.
+ */
+void nvhost_scale_deinit(struct platform_device *pdev)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_device_profile *profile = pdata->power_profile;
+
+	if (!profile)
+		return;
+
+	devfreq_remove_device(pdata->power_manager);
+	pdata->power_manager = NULL;
+	pdata->power_profile = NULL;
+	nvhost_scale_stats_deinit(pdev);
+
+	nvhost_module_set_devfreq_rate(pdev, 0, pdata->clocks[0].default_rate);
+	if (profile->emc_index >= 0)
+		nvhost_module_set_devfreq_rate(pdev, profile->emc_index,
+				profile->emc_max_rate);
+
+	kfree(profile);
+}
+EXPORT_SYMBOL(nvhost_scale_deinit);
@@ -0,0 +1,117 @@
+/*
+ * drivers/video/tegra/host/nvhost_scale.h
+ *
+ * Tegra Graphics Host Unit clock scaling
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NVHOST_SCALE_H
+#define __NVHOST_SCALE_H
+
+#include <linux/devfreq.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+
+struct platform_device;
+struct clk;
+struct dentry;
+
+/*
+ * Per-unit scaling state. Load is measured from the busy/idle transitions
+ * reported by nvhost_module_busy() and nvhost_module_idle_mult(), and the
+ * unit's EMC request follows its own clock.
+ */
+struct nvhost_device_profile {
+	struct platform_device		*pdev;
+	struct devfreq_dev_profile	devfreq_profile;
+#ifdef CONFIG_DEVFREQ_GOV_SIMPLE_ONDEMAND
+	struct devfreq_simple_ondemand_data ondemand_data;
+#endif
+
+	unsigned long			min_rate;
+	unsigned long			max_rate;
+	unsigned long			cur_rate;
+
+	int				emc_index;	/* -1 if no emc clock */
+	unsigned long			emc_max_rate;
+
+	spinlock_t			lock;		/* protects below */
+	bool				busy;
+	ktime_t				last_event;
+	u64				busy_us;
+	u64				total_us;
+
+	/* inputs of the last governor decision */
+	unsigned long			last_busy_us;
+	unsigned long			last_total_us;
+};
+
+/*
+ * Frequency statistics, in the spirit of cpufreq_stats: time spent at each
+ * frequency step, transitions into it and the time the transitions took.
+ * A ring of the most recent governor decisions and their inputs is kept
+ * alongside so that a session can be replayed against the governor
+ * offline.
+ */
+#define NVHOST_SCALE_MAX_STEPS		64
+#define NVHOST_SCALE_LOG_SIZE		256
+
+struct nvhost_scale_sample {
+	s64				time_us;
+	unsigned long			busy_us;
+	unsigned long			total_us;
+	int				event;		/* DEVICE_* or -1 */
+	unsigned int			idle;		/* per mille */
+	unsigned int			hint;		/* 0 if no hints */
+	unsigned long			old_freq;
+	unsigned long			new_freq;
+};
+
+struct nvhost_scale_stats {
+	int				count;
+	unsigned long			freqs[NVHOST_SCALE_MAX_STEPS];
+	u64				time_us[NVHOST_SCALE_MAX_STEPS];
+	unsigned int			trans[NVHOST_SCALE_MAX_STEPS];
+	u64				trans_us[NVHOST_SCALE_MAX_STEPS];
+
+	spinlock_t			lock;		/* protects below */
+	int				cur;
+	ktime_t				last;
+	struct nvhost_scale_sample	log[NVHOST_SCALE_LOG_SIZE];
+	unsigned int			log_next;
+	unsigned int			log_count;
+
+	struct dentry			*debugdir;
+};
+
+int nvhost_scale_freq_steps(struct clk *c, unsigned long max_rate,
+			    unsigned long *freqs, int max_count);
+void nvhost_scale_stats_init(struct platform_device *pdev,
+			     unsigned long *freqs, int count,
+			     unsigned long cur_freq);
+void nvhost_scale_stats_deinit(struct platform_device *pdev);
+void nvhost_scale_stats_transition(struct platform_device *pdev,
+				   unsigned long freq, ktime_t start);
+void nvhost_scale_stats_log(struct platform_device *pdev,
+			    struct nvhost_scale_sample *sample);
+
+/* Hooks for nvhost_device_data */
+void nvhost_scale_init(struct platform_device *pdev);
+void nvhost_scale_deinit(struct platform_device *pdev);
+void nvhost_scale_notify_busy(struct platform_device *pdev);
+void nvhost_scale_notify_idle(struct platform_device *pdev);
+
+#endif
@@ -0,0 +1,302 @@
+/*
+ * drivers/video/tegra/host/nvhost_sync.c
+ *
+ * Tegra Graphics Host Syncpoint Integration to linux/sync Framework
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/seq_file.h>
+#include <linux/sync.h>
+#include <linux/nvhost_ioctl.h>
+
+#include "nvhost_sync.h"
+#include "nvhost_syncpt.h"
+#include "nvhost_intr.h"
+#include "nvhost_acm.h"
+#include "dev.h"
+#include "chip_support.h"
+
+/* one timeline per syncpoint: sync_fence_merge() collapses points on the
+ * same timeline, so fences on one syncpoint stay a single sync_pt */
+struct nvhost_sync_timeline {
+	struct sync_timeline obj;
+	struct nvhost_syncpt *sp;
+	u32 id;
+};
+
+struct nvhost_sync_pt {
+	struct sync_pt pt;
+	u32 thresh;
+};
+
+static inline struct nvhost_sync_timeline *to_nvhost_sync_timeline(
+		struct sync_timeline *obj)
+{
+	return container_of(obj, struct nvhost_sync_timeline, obj);
+}
+
+static inline struct nvhost_sync_pt *to_nvhost_sync_pt(struct sync_pt *pt)
+{
+	return container_of(pt, struct nvhost_sync_pt, pt);
+}
+
+static struct sync_pt *nvhost_sync_pt_create(struct nvhost_sync_timeline *obj,
+		u32 thresh)
+{
+	struct sync_pt *pt;
+
+	pt = sync_pt_create(&obj->obj, sizeof(struct nvhost_sync_pt));
+	if (!pt)
+		return NULL;
+
+	to_nvhost_sync_pt(pt)->thresh = thresh;
+
+	return pt;
+}
+
+static struct sync_pt *nvhost_sync_pt_dup(struct sync_pt *sync_pt)
+{
+	return nvhost_sync_pt_create(to_nvhost_sync_timeline(sync_pt->parent),
+			to_nvhost_sync_pt(sync_pt)->thresh);
+}
+
+static int nvhost_sync_pt_has_signaled(struct sync_pt *sync_pt)
+{
+	struct nvhost_sync_timeline *obj =
+		to_nvhost_sync_timeline(sync_pt->parent);
+
+	/* cached min is refreshed by the threshold interrupt before the
+	 * timeline is signalled, so there is no need to touch the hw */
+	return nvhost_syncpt_is_expired(obj->sp, obj->id,
+			to_nvhost_sync_pt(sync_pt)->thresh);
+}
+
+static int nvhost_sync_pt_compare(struct sync_pt *a, struct sync_pt *b)
+{
+	u32 thresh_a = to_nvhost_sync_pt(a)->thresh;
+	u32 thresh_b = to_nvhost_sync_pt(b)->thresh;
+
+	if (thresh_a == thresh_b)
+		return 0;
+
+	return ((s32)(thresh_a - thresh_b)) < 0 ? -1 : 1;
+}
+
+static void nvhost_sync_print_obj(struct seq_file *s,
+		struct sync_timeline *sync_timeline)
+{
+	struct nvhost_sync_timeline *obj =
+		to_nvhost_sync_timeline(sync_timeline);
+
+	seq_printf(s, "id %d: %d / %d", obj->id,
+			nvhost_syncpt_read_min(obj->sp, obj->id),
+			nvhost_syncpt_read_max(obj->sp, obj->id));
+}
+
+static void nvhost_sync_print_pt(struct seq_file *s, struct sync_pt *sync_pt)
+{
+	struct nvhost_sync_timeline *obj =
+		to_nvhost_sync_timeline(sync_pt->parent);
+
+	seq_printf(s, "id %d: %d / %d", obj->id,
+			to_nvhost_sync_pt(sync_pt)->thresh,
+			nvhost_syncpt_read_min(obj->sp, obj->id));
+}
+
+static int nvhost_sync_fill_driver_data(struct sync_pt *sync_pt,
+		void *data, int size)
+{
+	struct nvhost_sync_timeline *obj =
+		to_nvhost_sync_timeline(sync_pt->parent);
+	struct nvhost_ctrl_syncpt_fence info;
+
+	if (size < sizeof(info))
+		return -ENOMEM;
+
+	info.id = obj->id;
+	info.thresh = to_nvhost_sync_pt(sync_pt)->thresh;
+	memcpy(data, &info, sizeof(info));
+
+	return sizeof(info);
+}
+
+static const struct sync_timeline_ops nvhost_sync_timeline_ops = {
+	.driver_name = "nvhost_sync",
+	.dup = nvhost_sync_pt_dup,
+	.has_signaled = nvhost_sync_pt_has_signaled,
+	.compare = nvhost_sync_pt_compare,
+	.print_obj = nvhost_sync_print_obj,
+	.print_pt = nvhost_sync_print_pt,
+	.fill_driver_data = nvhost_sync_fill_driver_data,
+};
+
+struct nvhost_sync_timeline *nvhost_sync_timeline_create(
+		struct nvhost_syncpt *sp, u32 id)
+{
+	struct nvhost_sync_timeline *obj;
+	char name[32];
+
+	snprintf(name, sizeof(name), "%d_%s", id, syncpt_op().name(sp, id));
+
+	obj = (struct nvhost_sync_timeline *)
+		sync_timeline_create(&nvhost_sync_timeline_ops,
+				     sizeof(struct nvhost_sync_timeline),
+				     name);
+	if (!obj)
+		return NULL;
+
+	obj->sp = sp;
+	obj->id = id;
+
+	return obj;
+}
+
+void nvhost_sync_timeline_destroy(struct nvhost_sync_timeline *obj)
+{
+	sync_timeline_destroy(&obj->obj);
+}
+
+void nvhost_sync_timeline_signal(struct nvhost_sync_timeline *obj, int refs)
+{
+	sync_timeline_signal(&obj->obj);
+	nvhost_module_idle_mult(syncpt_to_dev(obj->sp)->dev, refs);
+}
+
+/**
+ * Create a single-point fence for one syncpoint threshold and arm the
+ * threshold interrupt for it. The host is kept busy until the waiter
+ * fires, so the interrupt cannot be lost to clock gating.
+ */
+static struct sync_fence *nvhost_sync_fence_create_pt(
+		struct nvhost_syncpt *sp, u32 id, u32 thresh, const char *name)
+{
+	struct nvhost_master *host = syncpt_to_dev(sp);
+	struct nvhost_sync_timeline *obj = sp->timeline[id];
+	struct sync_fence *fence;
+	struct sync_pt *pt;
+	void *waiter;
+	int err;
+
+	pt = nvhost_sync_pt_create(obj, thresh);
+	if (!pt)
+		return NULL;
+
+	fence = sync_fence_create(name, pt);
+	if (!fence) {
+		sync_pt_free(pt);
+		return NULL;
+	}
+
+	/* activation already signalled the point from the cached value */
+	if (nvhost_syncpt_is_expired(sp, id, thresh))
+		return fence;
+
+	waiter = nvhost_intr_alloc_waiter();
+	if (!waiter) {
+		sync_fence_put(fence);
+		return NULL;
+	}
+
+	nvhost_module_busy(host->dev);
+
+	nvhost_syncpt_update_min(sp, id);
+	if (nvhost_syncpt_is_expired(sp, id, thresh)) {
+		nvhost_intr_free_waiter(waiter);
+		nvhost_sync_timeline_signal(obj, 1);
+		return fence;
+	}
+
+	err = nvhost_intr_add_action(&host->intr, id, thresh,
+			NVHOST_INTR_ACTION_SIGNAL_SYNC_PT, obj, waiter, NULL);
+	if (err) {
+		nvhost_module_idle(host->dev);
+		sync_fence_put(fence);
+		return NULL;
+	}
+
+	return fence;
+}
+
+int nvhost_sync_create_fence(struct nvhost_syncpt *sp,
+		struct nvhost_ctrl_syncpt_fence *pts,
+		u32 num_pts, const char *name, int *fence_fd)
+{
+	struct sync_fence *fence = NULL;
+	u32 i, j, n = 0;
+	int fd, err;
+
+	/* keep only the latest threshold per syncpoint, in place */
+	for (i = 0; i < num_pts; i++) {
+		if (!nvhost_syncpt_is_valid(sp, pts[i].id))
+			return -EINVAL;
+
+		for (j = 0; j < n; j++)
+			if (pts[j].id == pts[i].id)
+				break;
+
+		if (j == n)
+			pts[n++] = pts[i];
+		else if ((s32)(pts[i].thresh - pts[j].thresh) > 0)
+			pts[j].thresh = pts[i].thresh;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct sync_fence *f, *merged;
+
+		f = nvhost_sync_fence_create_pt(sp, pts[i].id,
+				pts[i].thresh, name);
+		if (!f) {
+			err = -ENOMEM;
+			goto err;
+		}
+
+		if (!fence) {
+			fence = f;
+			continue;
+		}
+
+		merged = sync_fence_merge(name, fence, f);
+		sync_fence_put(f);
+		sync_fence_put(fence);
+		fence = merged;
+		if (!fence) {
+			err = -ENOMEM;
+			goto err;
+		}
+	}
+
+	if (!fence)
+		return -EINVAL;
+
+	fd = get_unused_fd();
+	if (fd < 0) {
+		err = fd;
+		goto err;
+	}
+
+	sync_fence_install(fence, fd);
+	*fence_fd = fd;
+
+	return 0;
+
+err:
+	if (fence)
+		sync_fence_put(fence);
+	return err;
+}
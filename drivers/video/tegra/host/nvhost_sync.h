@@ -0,0 +1,75 @@
+/*
+ * drivers/video/tegra/host/nvhost_sync.h
+ *
+ * Tegra Graphics Host Syncpoint Integration to linux/sync Framework
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NVHOST_SYNC_H
+#define __NVHOST_SYNC_H
+
+#include <linux/types.h>
+#include <linux/errno.h>
+
+struct nvhost_syncpt;
+struct nvhost_sync_timeline;
+struct nvhost_ctrl_syncpt_fence;
+
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+struct nvhost_sync_timeline *nvhost_sync_timeline_create(
+		struct nvhost_syncpt *sp, u32 id);
+void nvhost_sync_timeline_destroy(struct nvhost_sync_timeline *obj);
+
+/**
+ * Signal the timeline from the syncpoint interrupt thread and drop
+ * the host1x references held by the 'refs' waiters that fired.
+ */
+void nvhost_sync_timeline_signal(struct nvhost_sync_timeline *obj, int refs);
+
+/**
+ * Create a fence over an array of syncpoint thresholds and install it
+ * in a new file descriptor. Thresholds on the same syncpoint are merged
+ * into a single sync_pt.
+ */
+int nvhost_sync_create_fence(struct nvhost_syncpt *sp,
+		struct nvhost_ctrl_syncpt_fence *pts,
+		u32 num_pts, const char *name, int *fence_fd);
+#else
+static inline struct nvhost_sync_timeline *nvhost_sync_timeline_create(
+		struct nvhost_syncpt *sp, u32 id)
+{
+	return NULL;
+}
+
+static inline void nvhost_sync_timeline_destroy(
+		struct nvhost_sync_timeline *obj)
+{
+}
+
+static inline void nvhost_sync_timeline_signal(
+		struct nvhost_sync_timeline *obj, int refs)
+{
+}
+
+static inline int nvhost_sync_create_fence(struct nvhost_syncpt *sp,
+		struct nvhost_ctrl_syncpt_fence *pts,
+		u32 num_pts, const char *name, int *fence_fd)
+{
+	return -EINVAL;
+}
+#endif
+
+#endif
@@ -24,6 +24,7 @@
 #include <linux/stat.h>
 #include <trace/events/nvhost.h>
 #include "nvhost_syncpt.h"
+#include "nvhost_sync.h"
 #include "nvhost_acm.h"
 #include "dev.h"
 #include "chip_support.h"
@@ -264,6 +265,152 @@ done:
 	return err;
 }
 
+/**
+ * Checks a fence array against the cached syncpoint values, refreshing
+ * from hardware first if update is set. Returns true once any fence (or
+ * all of them, if all is set) has expired; *index is then the first
+ * expired fence.
+ */
+static bool syncpt_fences_expired(struct nvhost_syncpt *sp,
+			const struct nvhost_ctrl_syncpt_fence *fences,
+			u32 num_fences, bool all, bool update, u32 *index)
+{
+	u32 i, first = num_fences;
+
+	for (i = 0; i < num_fences; i++) {
+		bool expired;
+
+		if (update)
+			expired = syncpt_update_min_is_expired(sp,
+					fences[i].id, fences[i].thresh);
+		else
+			expired = nvhost_syncpt_is_expired(sp,
+					fences[i].id, fences[i].thresh);
+
+		if (expired && first == num_fences)
+			first = i;
+		if (expired && !all)
+			break;
+		if (!expired && all)
+			return false;
+	}
+
+	*index = first;
+	return first < num_fences;
+}
+
+/**
+ * Waits on several syncpoint fences with a single sleep. One waiter per
+ * outstanding fence is registered against a shared wait queue, so that
+ * whichever interrupt comes first wakes the caller.
+ */
+int nvhost_syncpt_wait_multi(struct nvhost_syncpt *sp,
+			const struct nvhost_ctrl_syncpt_fence *fences,
+			u32 num_fences, bool all, u32 timeout,
+			u32 *index, u32 *value)
+{
+	DECLARE_WAIT_QUEUE_HEAD_ONSTACK(wq);
+	struct nvhost_intr *intr = &(syncpt_to_dev(sp)->intr);
+	void *refs[NVHOST_SYNCPT_WAIT_MULTI_MAX];
+	u32 i, nr_refs = 0;
+	int err = 0, check_count = 0;
+
+	if (!num_fences || num_fences > NVHOST_SYNCPT_WAIT_MULTI_MAX)
+		return -EINVAL;
+	for (i = 0; i < num_fences; i++)
+		if (fences[i].id >= nvhost_syncpt_nb_pts(sp))
+			return -EINVAL;
+
+	*value = 0;
+
+	/* first check cache */
+	if (syncpt_fences_expired(sp, fences, num_fences, all, false, index))
+		goto out;
+
+	/* keep host alive */
+	nvhost_module_busy(syncpt_to_dev(sp)->dev);
+
+	/* try to read from registers */
+	if (syncpt_fences_expired(sp, fences, num_fences, all, true, index))
+		goto done;
+
+	if (!timeout) {
+		err = -EAGAIN;
+		goto done;
+	}
+
+	/* schedule a wakeup for every fence that hasn't expired yet */
+	for (i = 0; i < num_fences; i++) {
+		void *waiter;
+
+		if (nvhost_syncpt_is_expired(sp, fences[i].id,
+					fences[i].thresh)) {
+			refs[i] = NULL;
+			continue;
+		}
+
+		waiter = nvhost_intr_alloc_waiter();
+		if (!waiter) {
+			err = -ENOMEM;
+			goto put_refs;
+		}
+
+		err = nvhost_intr_add_action(intr, fences[i].id,
+				fences[i].thresh,
+				NVHOST_INTR_ACTION_WAKEUP_INTERRUPTIBLE, &wq,
+				waiter, &refs[i]);
+		if (err)
+			goto put_refs;
+		nr_refs = i + 1;
+	}
+	nr_refs = num_fences;
+
+	err = -EAGAIN;
+	while (timeout) {
+		u32 check = min_t(u32, SYNCPT_CHECK_PERIOD, timeout);
+		int remain = wait_event_interruptible_timeout(wq,
+				syncpt_fences_expired(sp, fences, num_fences,
+					all, true, index),
+				check);
+		if (remain > 0 || syncpt_fences_expired(sp, fences,
+					num_fences, all, false, index)) {
+			err = 0;
+			break;
+		}
+		if (remain < 0) {
+			err = remain;
+			break;
+		}
+		if (timeout != NVHOST_NO_TIMEOUT)
+			timeout -= check;
+		if (timeout && check_count <= MAX_STUCK_CHECK_COUNT) {
+			dev_warn(&syncpt_to_dev(sp)->dev->dev,
+				"%s: stuck waiting on %u fences (first: syncpoint id %d, thresh %d), timeout=%d\n",
+				current->comm, num_fences, fences[0].id,
+				fences[0].thresh, timeout);
+			syncpt_op().debug(sp);
+			if (check_count == MAX_STUCK_CHECK_COUNT)
+				nvhost_debug_dump(syncpt_to_dev(sp));
+			check_count++;
+		}
+	}
+
+put_refs:
+	for (i = 0; i < nr_refs; i++)
+		if (refs[i])
+			nvhost_intr_put_ref(intr, fences[i].id, refs[i]);
+
+done:
+	nvhost_module_idle(syncpt_to_dev(sp)->dev);
+out:
+	/* an "all" wait reports the last fence, which has expired too */
+	if (!err && all)
+		*index = num_fences - 1;
+	if (!err)
+		*value = nvhost_syncpt_read_min(sp, fences[*index].id);
+	return err;
+}
+
 /**
  * Returns true if syncpoint is expired, false if we may need to wait
  */
@@ -460,6 +607,23 @@ int nvhost_syncpt_init(struct platform_device *dev,
 		}
 	}
 
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+	sp->timeline = kzalloc(sizeof(*sp->timeline)
+			* nvhost_syncpt_nb_pts(sp), GFP_KERNEL);
+	if (!sp->timeline) {
+		err = -ENOMEM;
+		goto fail;
+	}
+
+	for (i = 0; i < nvhost_syncpt_nb_pts(sp); i++) {
+		sp->timeline[i] = nvhost_sync_timeline_create(sp, i);
+		if (!sp->timeline[i]) {
+			err = -ENOMEM;
+			goto fail;
+		}
+	}
+#endif
+
 	return err;
 
 fail:
@@ -469,6 +633,18 @@ fail:
 
 void nvhost_syncpt_deinit(struct nvhost_syncpt *sp)
 {
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+	int i;
+
+	if (sp->timeline) {
+		for (i = 0; i < nvhost_syncpt_nb_pts(sp); i++)
+			if (sp->timeline[i])
+				nvhost_sync_timeline_destroy(sp->timeline[i]);
+		kfree(sp->timeline);
+		sp->timeline = NULL;
+	}
+#endif
+
 	kobject_put(sp->kobj);
 
 	kfree(sp->min_val);
@@ -44,6 +44,9 @@ struct nvhost_syncpt {
 	atomic_t *lock_counts;
 	const char **syncpt_names;
 	struct nvhost_syncpt_attr *syncpt_attrs;
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+	struct nvhost_sync_timeline **timeline;
+#endif
 };
 
 int nvhost_syncpt_init(struct platform_device *, struct nvhost_syncpt *);
@@ -130,6 +133,12 @@ void nvhost_syncpt_incr(struct nvhost_syncpt *sp, u32 id);
 int nvhost_syncpt_wait_timeout(struct nvhost_syncpt *sp, u32 id, u32 thresh,
 			u32 timeout, u32 *value);
 
+struct nvhost_ctrl_syncpt_fence;
+int nvhost_syncpt_wait_multi(struct nvhost_syncpt *sp,
+			const struct nvhost_ctrl_syncpt_fence *fences,
+			u32 num_fences, bool all, u32 timeout,
+			u32 *index, u32 *value);
+
 static inline int nvhost_syncpt_wait(struct nvhost_syncpt *sp, u32 id, u32 thresh)
 {
 	return nvhost_syncpt_wait_timeout(sp, id, thresh,
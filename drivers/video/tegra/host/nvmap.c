@@ -104,6 +104,12 @@ void *nvhost_nvmap_mmap(struct mem_handle *handle)
 	return nvmap_mmap((struct nvmap_handle_ref *)handle);
 }
 
+void *nvhost_nvmap_mmap_wc(struct mem_handle *handle, size_t max_size,
+		size_t *size)
+{
+	return nvmap_mmap_wc((struct nvmap_handle_ref *)handle, max_size, size);
+}
+
 void nvhost_nvmap_munmap(struct mem_handle *handle, void *addr)
 {
 	nvmap_munmap((struct nvmap_handle_ref *)handle, addr);
@@ -120,6 +126,12 @@ void nvhost_nvmap_kunmap(struct mem_handle *handle, unsigned int pagenum,
 	nvmap_kunmap((struct nvmap_handle_ref *)handle, pagenum, addr);
 }
 
+void nvhost_nvmap_kunmap_clean(struct mem_handle *handle,
+		unsigned int pagenum, void *addr)
+{
+	nvmap_kunmap_clean((struct nvmap_handle_ref *)handle, pagenum, addr);
+}
+
 int nvhost_nvmap_pin_array_ids(struct mem_mgr *mgr,
 		long unsigned *ids,
 		long unsigned id_type_mask,
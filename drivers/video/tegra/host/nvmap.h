@@ -39,10 +39,14 @@ struct sg_table *nvhost_nvmap_pin(struct mem_mgr *mgr,
 void nvhost_nvmap_unpin(struct mem_mgr *mgr,
 		struct mem_handle *handle, struct sg_table *sgt);
 void *nvhost_nvmap_mmap(struct mem_handle *handle);
+void *nvhost_nvmap_mmap_wc(struct mem_handle *handle, size_t max_size,
+		size_t *size);
 void nvhost_nvmap_munmap(struct mem_handle *handle, void *addr);
 void *nvhost_nvmap_kmap(struct mem_handle *handle, unsigned int pagenum);
 void nvhost_nvmap_kunmap(struct mem_handle *handle, unsigned int pagenum,
 		void *addr);
+void nvhost_nvmap_kunmap_clean(struct mem_handle *handle,
+		unsigned int pagenum, void *addr);
 struct mem_handle *nvhost_nvmap_get(struct mem_mgr *mgr,
 		u32 id, struct platform_device *dev);
 
@@ -31,6 +31,7 @@
 #include "hw_tsec.h"
 #include "bus_client.h"
 #include "nvhost_acm.h"
+#include "nvhost_scale.h"
 #include "chip_support.h"
 #include "nvhost_memmgr.h"
 #include "nvhost_intr.h"
@@ -517,6 +518,10 @@ static int __devinit tsec_probe(struct platform_device *dev)
 	pdata->pdev = dev;
 	pdata->init = nvhost_tsec_init;
 	pdata->deinit = nvhost_tsec_deinit;
+	pdata->busy = nvhost_scale_notify_busy;
+	pdata->idle = nvhost_scale_notify_idle;
+	pdata->scaling_init = nvhost_scale_init;
+	pdata->scaling_deinit = nvhost_scale_deinit;
 
 	platform_set_drvdata(dev, pdata);
 
@@ -546,7 +551,7 @@ static int __exit tsec_remove(struct platform_device *dev)
 {
 	struct nvhost_master *host = nvhost_get_host(dev);
 
-	/* Add clean-up */
+	nvhost_scale_deinit(dev);
 	host->intr.generic_isr[20] = NULL;
 	host->intr.generic_isr_thread[20] = NULL;
 	return 0;
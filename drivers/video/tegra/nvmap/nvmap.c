@@ -670,8 +670,8 @@ out:
 	return NULL;
 }
 
-void nvmap_kunmap(struct nvmap_handle_ref *ref, unsigned int pagenum,
-		  void *addr)
+static void __nvmap_kunmap(struct nvmap_handle_ref *ref,
+		unsigned int pagenum, void *addr, bool flush)
 {
 	struct nvmap_handle *h;
 	phys_addr_t paddr;
@@ -694,7 +694,7 @@ void nvmap_kunmap(struct nvmap_handle_ref *ref, unsigned int pagenum,
 	else
 		paddr = h->carveout->base + pagenum * PAGE_SIZE;
 
-	if (h->flags != NVMAP_HANDLE_UNCACHEABLE &&
+	if (flush && h->flags != NVMAP_HANDLE_UNCACHEABLE &&
 	    h->flags != NVMAP_HANDLE_WRITE_COMBINE) {
 		dmac_flush_range(addr, addr + PAGE_SIZE);
 		outer_flush_range(paddr, paddr + PAGE_SIZE);
@@ -705,6 +705,19 @@ void nvmap_kunmap(struct nvmap_handle_ref *ref, unsigned int pagenum,
 	nvmap_handle_put(h);
 }
 
+void nvmap_kunmap(struct nvmap_handle_ref *ref, unsigned int pagenum,
+		  void *addr)
+{
+	__nvmap_kunmap(ref, pagenum, addr, true);
+}
+
+/* for callers that only read through the mapping: nothing to write back */
+void nvmap_kunmap_clean(struct nvmap_handle_ref *ref, unsigned int pagenum,
+		  void *addr)
+{
+	__nvmap_kunmap(ref, pagenum, addr, false);
+}
+
 void *nvmap_mmap(struct nvmap_handle_ref *ref)
 {
 	struct nvmap_handle *h;
@@ -777,6 +790,26 @@ void *nvmap_mmap(struct nvmap_handle_ref *ref)
 	return p;
 }
 
+/*
+ * Map a write-combined or uncached handle of at most max_size bytes.
+ * Writes through such a mapping reach memory without cache maintenance,
+ * so callers may keep it across uses. Returns NULL for other handles.
+ */
+void *nvmap_mmap_wc(struct nvmap_handle_ref *ref, size_t max_size,
+		    size_t *size)
+{
+	struct nvmap_handle *h = ref->handle;
+
+	if (h->flags != NVMAP_HANDLE_UNCACHEABLE &&
+	    h->flags != NVMAP_HANDLE_WRITE_COMBINE)
+		return NULL;
+	if (h->size > max_size)
+		return NULL;
+
+	*size = h->size;
+	return nvmap_mmap(ref);
+}
+
 void nvmap_munmap(struct nvmap_handle_ref *ref, void *addr)
 {
 	struct nvmap_handle *h;
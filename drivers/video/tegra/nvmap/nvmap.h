@@ -23,11 +23,15 @@
 #ifndef __VIDEO_TEGRA_NVMAP_NVMAP_H
 #define __VIDEO_TEGRA_NVMAP_NVMAP_H
 
+#include <linux/hash.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/mm.h>
 #include <linux/mutex.h>
 #include <linux/rbtree.h>
+#include <linux/rculist.h>
 #include <linux/sched.h>
+#include <linux/static_key.h>
 #include <linux/wait.h>
 #include <linux/atomic.h>
 #include <linux/dma-buf.h>
@@ -67,6 +71,26 @@ struct nvmap_deferred_ops {
 	u64 deferred_maint_inner_flushed;
 	u64 deferred_maint_outer_requested;
 	u64 deferred_maint_outer_flushed;
+	u64 deferred_maint_merged;	/* ops folded into a queued op */
+	u64 deferred_maint_skipped;	/* ops on uncached/wc handles */
+};
+
+/* latency histograms, kept per client and per heap. bucket b counts
+ * operations that took [2^(b-1), 2^b) microseconds; the last bucket is
+ * open-ended */
+enum nvmap_lat_op {
+	NVMAP_LAT_ALLOC,
+	NVMAP_LAT_FREE,
+	NVMAP_LAT_PIN,
+	NVMAP_LAT_MAP,
+	NVMAP_LAT_CACHE,
+	NVMAP_LAT_NR_OPS,
+};
+
+#define NVMAP_LAT_BUCKETS	16
+
+struct nvmap_lat_hist {
+	atomic_t count[NVMAP_LAT_NR_OPS][NVMAP_LAT_BUCKETS];
 };
 
 /* handles allocated using shared system memory (either IOVMM- or high-order
@@ -74,16 +98,21 @@ struct nvmap_deferred_ops {
 struct nvmap_pgalloc {
 	struct page **pages;
 	struct tegra_iovmm_area *area;
-	struct list_head mru_list;	/* MRU entry for IOVMM reclamation */
+	struct list_head mru_list;	/* LRU entry for IOVMM reclamation */
+	unsigned long lru_time;		/* jiffies when put on the LRU */
+	u32 remaps;			/* area rebuilt after eviction */
+	bool evicted;			/* area was taken away while unpinned */
 	bool contig;			/* contiguous system memory */
 	bool dirty;			/* area is invalid and needs mapping */
 	u32 iovm_addr;	/* is non-zero, if client need specific iova mapping */
 };
 
 struct nvmap_handle {
-	struct rb_node node;	/* entry on global handle tree */
+	struct hlist_node node;	/* entry on global handle hash */
+	struct rcu_head rcu;	/* handles are freed after a grace period */
 	atomic_t ref;		/* reference count (i.e., # of duplications) */
 	atomic_t pin;		/* pin count */
+	atomic_t maint_pending;	/* queued deferred cache maintenance ops */
 #ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
 	atomic_t usecount;	/* holds map count on carveout handle and is
 					used to avoid relocation during
@@ -120,6 +149,27 @@ struct nvmap_handle {
 #define NVMAP_WB_POOL NVMAP_HANDLE_CACHEABLE
 #define NVMAP_NUM_POOLS (NVMAP_HANDLE_CACHEABLE + 1)
 
+/* per-CPU front-end cache of pool pages. pages held here carry the same
+ * attributes as pages in the backing pool, but are moved to and from the
+ * pool in batches so that the pool mutex is only taken on refill/drain. */
+#define NVMAP_PP_MAG_SIZE	64
+#define NVMAP_PP_MAG_BATCH	(NVMAP_PP_MAG_SIZE / 2)
+
+struct nvmap_pp_magazine {
+	spinlock_t lock;
+	int count;
+	struct page *pages[NVMAP_PP_MAG_SIZE];
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long refills;
+	unsigned long drains;
+};
+
+/* high-order chunks kept by each pool, largest first. chunks are split
+ * pages, chained through the head page's lru entry. */
+#define NVMAP_PP_NR_ORDERS	2
+#define NVMAP_PP_ORDERS		{ 8, 4 }
+
 struct nvmap_page_pool {
 	struct mutex lock;
 	int npages;
@@ -127,6 +177,15 @@ struct nvmap_page_pool {
 	struct page **shrink_array;
 	int max_pages;
 	int flags;
+	struct nvmap_pp_magazine __percpu *mags;
+	atomic_t contended;	/* pool mutex found locked on refill/drain */
+	struct list_head chunks[NVMAP_PP_NR_ORDERS];
+	u32 nchunks[NVMAP_PP_NR_ORDERS];
+	int chunk_pages;	/* pages held in chunks, counts to max_pages */
+	struct list_head clean_list;	/* pages already zeroed in background */
+	int nclean;
+	atomic_t zero_avoided;	/* zeroed allocs served from clean_list */
+	atomic_t zero_sync;	/* zeroed allocs that had to memset */
 };
 
 int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags);
@@ -149,8 +208,9 @@ struct nvmap_share {
 #endif
 #ifdef CONFIG_NVMAP_RECLAIM_UNPINNED_VM
 	struct mutex mru_lock;
-	struct list_head *mru_lists;
-	int nr_mru;
+	struct list_head mru_list;	/* unpinned handles, coldest first */
+	struct delayed_work mru_work;	/* evicts cold areas ahead of time */
+	atomic_t mru_bg_evictions;
 #endif
 };
 
@@ -159,18 +219,27 @@ struct nvmap_carveout_commit {
 	struct list_head list;
 };
 
+/* handle ids are looked up on every ioctl, so each client keeps a hash
+ * of its refs next to the (ordered) rbtree used for the debugfs dumps */
+#define NVMAP_REF_HASH_BITS	6
+#define NVMAP_REF_HASH_SIZE	(1 << NVMAP_REF_HASH_BITS)
+
 struct nvmap_client {
 	const char			*name;
 	struct nvmap_device		*dev;
 	struct nvmap_share		*share;
 	struct rb_root			handle_refs;
+	struct hlist_head		ref_hash[NVMAP_REF_HASH_SIZE];
 	atomic_t			iovm_commit;
 	size_t				iovm_limit;
+	atomic_t			iovm_evictions;	/* areas stolen */
+	atomic_t			iovm_remaps;	/* re-pins */
 	struct mutex			ref_lock;
 	bool				super;
 	atomic_t			count;
 	struct task_struct		*task;
 	struct list_head		list;
+	struct nvmap_lat_hist		lat;
 	struct nvmap_carveout_commit	carveout_commit[0];
 };
 
@@ -180,6 +249,12 @@ struct nvmap_vma_priv {
 	atomic_t	count;	/* number of processes cloning the VMA */
 };
 
+static inline struct hlist_head *nvmap_ref_bucket(struct nvmap_client *c,
+						  unsigned long id)
+{
+	return &c->ref_hash[hash_long(id, NVMAP_REF_HASH_BITS)];
+}
+
 static inline void nvmap_ref_lock(struct nvmap_client *priv)
 {
 	mutex_lock(&priv->ref_lock);
@@ -190,6 +265,34 @@ static inline void nvmap_ref_unlock(struct nvmap_client *priv)
 	mutex_unlock(&priv->ref_lock);
 }
 
+/* the latency hooks compile to a patched-out branch until the
+ * nvmap.latency_stats parameter is set */
+extern struct static_key nvmap_lat_key;
+
+struct nvmap_lat_hist *nvmap_lat_heap_hist(struct nvmap_handle *h);
+void __nvmap_lat_record(struct nvmap_client *client,
+			struct nvmap_lat_hist *heap,
+			enum nvmap_lat_op op, ktime_t start);
+
+static inline bool nvmap_lat_enabled(void)
+{
+	return static_key_false(&nvmap_lat_key);
+}
+
+static inline ktime_t nvmap_lat_start(void)
+{
+	return nvmap_lat_enabled() ? ktime_get() : ktime_set(0, 0);
+}
+
+/* heap may be NULL when the operation isn't tied to a single heap */
+static inline void nvmap_lat_record(struct nvmap_client *client,
+				    struct nvmap_lat_hist *heap,
+				    enum nvmap_lat_op op, ktime_t start)
+{
+	if (nvmap_lat_enabled())
+		__nvmap_lat_record(client, heap, op, start);
+}
+
 static inline struct nvmap_handle *nvmap_handle_get(struct nvmap_handle *h)
 {
 	if (unlikely(atomic_inc_return(&h->ref) <= 1)) {
@@ -301,6 +404,7 @@ int nvmap_handle_remove(struct nvmap_device *dev, struct nvmap_handle *h);
 void nvmap_handle_add(struct nvmap_device *dev, struct nvmap_handle *h);
 
 int is_nvmap_vma(struct vm_area_struct *vma);
+void nvmap_vma_prefault(struct vm_area_struct *vma, bool all);
 
 struct nvmap_handle_ref *nvmap_alloc_iovm(struct nvmap_client *client,
 	size_t size, size_t align, unsigned int flags, unsigned int iova_start);
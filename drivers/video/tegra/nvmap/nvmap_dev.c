@@ -23,6 +23,7 @@
 #include <linux/backing-dev.h>
 #include <linux/bitmap.h>
 #include <linux/debugfs.h>
+#include <linux/hash.h>
 #include <linux/delay.h>
 #include <linux/kernel.h>
 #include <linux/miscdevice.h>
@@ -30,6 +31,7 @@
 #include <linux/module.h>
 #include <linux/oom.h>
 #include <linux/platform_device.h>
+#include <linux/rculist.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
@@ -60,6 +62,35 @@ static bool carveout_killer;
 #endif
 module_param(carveout_killer, bool, 0640);
 
+struct static_key nvmap_lat_key = STATIC_KEY_INIT_FALSE;
+static bool latency_stats;
+
+static int latency_stats_set(const char *arg, const struct kernel_param *kp)
+{
+	bool old = latency_stats;
+	int ret = param_set_bool(arg, kp);
+
+	if (ret)
+		return ret;
+	if (latency_stats && !old)
+		static_key_slow_inc(&nvmap_lat_key);
+	else if (!latency_stats && old)
+		static_key_slow_dec(&nvmap_lat_key);
+	return 0;
+}
+
+static int latency_stats_get(char *buff, const struct kernel_param *kp)
+{
+	return param_get_bool(buff, kp);
+}
+
+static struct kernel_param_ops latency_stats_ops = {
+	.get = latency_stats_get,
+	.set = latency_stats_set,
+};
+
+module_param_cb(latency_stats, &latency_stats_ops, &latency_stats, 0644);
+
 #ifdef CONFIG_NVMAP_CACHE_MAINT_BY_SET_WAYS
 size_t cache_maint_inner_threshold = 8 << PAGE_SHIFT;
 #endif
@@ -73,8 +104,14 @@ struct nvmap_carveout_node {
 	int			index;
 	struct list_head	clients;
 	spinlock_t		clients_lock;
+	struct nvmap_lat_hist	lat;
 };
 
+/* global id -> handle table. lookups are lock-free under RCU; adds and
+ * removes still take handle_lock */
+#define NVMAP_HANDLE_HASH_BITS	10
+#define NVMAP_HANDLE_HASH_SIZE	(1 << NVMAP_HANDLE_HASH_BITS)
+
 struct nvmap_device {
 	struct vm_struct *vm_rgn;
 	pte_t		*ptes[NVMAP_NUM_PTES];
@@ -82,8 +119,8 @@ struct nvmap_device {
 	unsigned int	lastpte;
 	spinlock_t	ptelock;
 
-	struct rb_root	handles;
-	spinlock_t	handle_lock;
+	struct hlist_head handles[NVMAP_HANDLE_HASH_SIZE];
+	spinlock_t	handle_lock;	/* serialises writers of handles[] */
 	wait_queue_head_t pte_wait;
 	struct miscdevice dev_super;
 	struct miscdevice dev_user;
@@ -93,6 +130,7 @@ struct nvmap_device {
 	struct list_head clients;
 	spinlock_t	clients_lock;
 	struct nvmap_deferred_ops deferred_ops;
+	struct nvmap_lat_hist pgalloc_lat;	/* sysmem and iovmm handles */
 };
 
 struct nvmap_device *nvmap_dev;
@@ -236,35 +274,38 @@ pte_t **nvmap_vaddr_to_pte(struct nvmap_device *dev, unsigned long vaddr)
 struct nvmap_handle_ref *_nvmap_validate_id_locked(struct nvmap_client *c,
 						   unsigned long id)
 {
-	struct rb_node *n = c->handle_refs.rb_node;
+	struct nvmap_handle_ref *ref;
+	struct hlist_node *pos;
 
-	while (n) {
-		struct nvmap_handle_ref *ref;
-		ref = rb_entry(n, struct nvmap_handle_ref, node);
+	hlist_for_each_entry(ref, pos, nvmap_ref_bucket(c, id), hnode)
 		if ((unsigned long)ref->handle == id)
 			return ref;
-		else if (id > (unsigned long)ref->handle)
-			n = n->rb_right;
-		else
-			n = n->rb_left;
-	}
 
 	return NULL;
 }
 
+/* lock-free variant of _nvmap_validate_id_locked + nvmap_handle_get.
+ * refs and handles are both freed through RCU, so the entry found here
+ * stays readable; a handle whose last reference is already gone is
+ * never resurrected */
 struct nvmap_handle *nvmap_get_handle_id(struct nvmap_client *client,
 					 unsigned long id)
 {
 	struct nvmap_handle_ref *ref;
 	struct nvmap_handle *h = NULL;
+	struct hlist_node *pos;
 
-	nvmap_ref_lock(client);
-	ref = _nvmap_validate_id_locked(client, id);
-	if (ref)
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(ref, pos, nvmap_ref_bucket(client, id),
+				 hnode) {
+		if ((unsigned long)ref->handle != id)
+			continue;
 		h = ref->handle;
-	if (h)
-		h = nvmap_handle_get(h);
-	nvmap_ref_unlock(client);
+		if (!atomic_inc_not_zero(&h->ref))
+			h = NULL;
+		break;
+	}
+	rcu_read_unlock();
 	return h;
 }
 
@@ -563,7 +604,7 @@ struct nvmap_heap_block *nvmap_carveout_alloc(struct nvmap_client *client,
 	return NULL;
 }
 
-/* remove a handle from the device's tree of all handles; called
+/* remove a handle from the device's table of all handles; called
  * when freeing handles. */
 int nvmap_handle_remove(struct nvmap_device *dev, struct nvmap_handle *h)
 {
@@ -579,63 +620,48 @@ int nvmap_handle_remove(struct nvmap_device *dev, struct nvmap_handle *h)
 	BUG_ON(atomic_read(&h->ref) < 0);
 	BUG_ON(atomic_read(&h->pin) != 0);
 
-	rb_erase(&h->node, &dev->handles);
+	hlist_del_rcu(&h->node);
 
 	spin_unlock(&dev->handle_lock);
 	return 0;
 }
 
-/* adds a newly-created handle to the device master tree */
+static inline struct hlist_head *nvmap_handle_bucket(struct nvmap_device *dev,
+						     unsigned long id)
+{
+	return &dev->handles[hash_long(id, NVMAP_HANDLE_HASH_BITS)];
+}
+
+/* adds a newly-created handle to the device master table */
 void nvmap_handle_add(struct nvmap_device *dev, struct nvmap_handle *h)
 {
-	struct rb_node **p;
-	struct rb_node *parent = NULL;
+	struct hlist_head *head = nvmap_handle_bucket(dev, (unsigned long)h);
 
 	spin_lock(&dev->handle_lock);
-	p = &dev->handles.rb_node;
-	while (*p) {
-		struct nvmap_handle *b;
-
-		parent = *p;
-		b = rb_entry(parent, struct nvmap_handle, node);
-		if (h > b)
-			p = &parent->rb_right;
-		else
-			p = &parent->rb_left;
-	}
-	rb_link_node(&h->node, parent, p);
-	rb_insert_color(&h->node, &dev->handles);
+	hlist_add_head_rcu(&h->node, head);
 	spin_unlock(&dev->handle_lock);
 }
 
-/* validates that a handle is in the device master tree, and that the
+/* validates that a handle is in the device master table, and that the
  * client has permission to access it */
 struct nvmap_handle *nvmap_validate_get(struct nvmap_client *client,
 					unsigned long id)
 {
-	struct nvmap_handle *h = NULL;
-	struct rb_node *n;
-
-	spin_lock(&client->dev->handle_lock);
-
-	n = client->dev->handles.rb_node;
+	struct nvmap_handle *h;
+	struct hlist_node *pos;
 
-	while (n) {
-		h = rb_entry(n, struct nvmap_handle, node);
-		if ((unsigned long)h == id) {
-			if (client->super || h->global || (h->owner == client))
-				h = nvmap_handle_get(h);
-			else
-				h = NULL;
-			spin_unlock(&client->dev->handle_lock);
-			return h;
-		}
-		if (id > (unsigned long)h)
-			n = n->rb_right;
-		else
-			n = n->rb_left;
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(h, pos, nvmap_handle_bucket(client->dev, id),
+				 node) {
+		if ((unsigned long)h != id)
+			continue;
+		if (!(client->super || h->global || (h->owner == client)) ||
+		    !atomic_inc_not_zero(&h->ref))
+			h = NULL;
+		rcu_read_unlock();
+		return h;
 	}
-	spin_unlock(&client->dev->handle_lock);
+	rcu_read_unlock();
 	return NULL;
 }
 
@@ -662,6 +688,8 @@ struct nvmap_client *nvmap_create_client(struct nvmap_device *dev,
 	client->handle_refs = RB_ROOT;
 
 	atomic_set(&client->iovm_commit, 0);
+	atomic_set(&client->iovm_evictions, 0);
+	atomic_set(&client->iovm_remaps, 0);
 
 	client->iovm_limit = nvmap_mru_vm_size(client->share->iovmm);
 
@@ -708,6 +736,7 @@ static void destroy_client(struct nvmap_client *client)
 
 		ref = rb_entry(n, struct nvmap_handle_ref, node);
 		rb_erase(&ref->node, &client->handle_refs);
+		hlist_del_rcu(&ref->hnode);
 
 		smp_rmb();
 		pins = atomic_read(&ref->pin);
@@ -724,7 +753,7 @@ static void destroy_client(struct nvmap_client *client)
 		while (dupes--)
 			nvmap_handle_put(ref->handle);
 
-		kfree(ref);
+		kfree_rcu(ref, rcu);
 	}
 
 	if (carveout_killer) {
@@ -903,6 +932,10 @@ static long nvmap_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		err = nvmap_ioctl_cache_maint(filp, uarg);
 		break;
 
+	case NVMAP_IOC_CACHE_LIST:
+		err = nvmap_ioctl_cache_maint_list(filp, uarg);
+		break;
+
 	case NVMAP_IOC_SHARE:
 		err = nvmap_ioctl_share_dmabuf(filp, uarg);
 		break;
@@ -979,6 +1012,56 @@ static int nvmap_vma_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	}
 }
 
+/* carveout mappings at least this large are always populated up front;
+ * other mappings only when NVMAP_HANDLE_PREFAULT is passed to the
+ * NVMAP_IOC_MMAP ioctl */
+#define NVMAP_PREFAULT_MIN	SZ_1M
+#define NVMAP_PREFAULT_BATCH	(SZ_1M >> PAGE_SHIFT)
+
+/* fills in the PTEs of a VMA that was just bound to its handle, so that
+ * uploading into a large buffer doesn't take one fault per page. caller
+ * holds mmap_sem. errors are not fatal: whatever isn't mapped here is
+ * faulted in by nvmap_vma_fault as before */
+void nvmap_vma_prefault(struct vm_area_struct *vma, bool all)
+{
+	struct nvmap_vma_priv *priv = vma->vm_private_data;
+	struct nvmap_handle *h = priv->handle;
+	unsigned long addr, offs;
+	unsigned int n = 0;
+
+	if (!all && (h->heap_pgalloc ||
+		     vma->vm_end - vma->vm_start < NVMAP_PREFAULT_MIN))
+		return;
+
+	offs = priv->offs + (vma->vm_pgoff << PAGE_SHIFT);
+	for (addr = vma->vm_start; addr < vma->vm_end;
+	     addr += PAGE_SIZE, offs += PAGE_SIZE) {
+		int err;
+
+		if (offs >= h->size)
+			break;
+
+		if (!h->heap_pgalloc) {
+			unsigned long pfn;
+
+			pfn = (h->carveout->base + offs) >> PAGE_SHIFT;
+			err = vm_insert_pfn(vma, addr, pfn);
+		} else {
+			struct page *page;
+
+			page = h->pgalloc.pages[offs >> PAGE_SHIFT];
+			err = page ? vm_insert_page(vma, addr, page) : -EFAULT;
+		}
+		if (err && err != -EBUSY)
+			break;
+
+		if (++n == NVMAP_PREFAULT_BATCH) {
+			n = 0;
+			cond_resched();
+		}
+	}
+}
+
 static ssize_t attr_show_usage(struct device *dev,
 			       struct device_attribute *attr, char *buf)
 {
@@ -999,6 +1082,93 @@ static struct attribute_group heap_extra_attr_group = {
 	.attrs = heap_extra_attrs,
 };
 
+/* returns the histogram of the heap backing h, or NULL if h has no
+ * memory yet */
+struct nvmap_lat_hist *nvmap_lat_heap_hist(struct nvmap_handle *h)
+{
+	struct nvmap_carveout_node *node;
+
+	if (!h->alloc)
+		return NULL;
+	if (h->heap_pgalloc)
+		return &h->dev->pgalloc_lat;
+	node = nvmap_heap_to_arg(nvmap_block_to_heap(h->carveout));
+	return &node->lat;
+}
+
+void __nvmap_lat_record(struct nvmap_client *client,
+			struct nvmap_lat_hist *heap,
+			enum nvmap_lat_op op, ktime_t start)
+{
+	s64 us;
+	unsigned int b;
+
+	/* stats were switched on half-way through this operation */
+	if (!start.tv64)
+		return;
+
+	us = max_t(s64, ktime_us_delta(ktime_get(), start), 0);
+	b = min_t(unsigned int, fls64(us), NVMAP_LAT_BUCKETS - 1);
+
+	if (client)
+		atomic_inc(&client->lat.count[op][b]);
+	if (heap)
+		atomic_inc(&heap->count[op][b]);
+	if (client)
+		trace_nvmap_latency(client, op, us);
+}
+
+static const char * const lat_op_names[NVMAP_LAT_NR_OPS] = {
+	[NVMAP_LAT_ALLOC] = "alloc",
+	[NVMAP_LAT_FREE] = "free",
+	[NVMAP_LAT_PIN] = "pin",
+	[NVMAP_LAT_MAP] = "map",
+	[NVMAP_LAT_CACHE] = "cache",
+};
+
+static void lat_hist_stringify(struct nvmap_lat_hist *lat, struct seq_file *s)
+{
+	unsigned int op, b;
+
+	for (op = 0; op < NVMAP_LAT_NR_OPS; op++) {
+		seq_printf(s, "%-6s", lat_op_names[op]);
+		for (b = 0; b < NVMAP_LAT_BUCKETS; b++)
+			seq_printf(s, " %u", atomic_read(&lat->count[op][b]));
+		seq_printf(s, "\n");
+	}
+}
+
+static void lat_hist_header(struct seq_file *s)
+{
+	unsigned int b;
+
+	seq_printf(s, "%-6s %s", "us", "<1");
+	for (b = 1; b < NVMAP_LAT_BUCKETS - 1; b++)
+		seq_printf(s, " <%u", 1u << b);
+	seq_printf(s, " >=%u\n", 1u << (NVMAP_LAT_BUCKETS - 2));
+}
+
+static int nvmap_debug_heap_latency_show(struct seq_file *s, void *unused)
+{
+	lat_hist_header(s);
+	lat_hist_stringify(s->private, s);
+	return 0;
+}
+
+static int nvmap_debug_heap_latency_open(struct inode *inode,
+					 struct file *file)
+{
+	return single_open(file, nvmap_debug_heap_latency_show,
+			   inode->i_private);
+}
+
+static const struct file_operations debug_heap_latency_fops = {
+	.open = nvmap_debug_heap_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static void client_stringify(struct nvmap_client *client, struct seq_file *s)
 {
 	char task_comm[TASK_COMM_LEN];
@@ -1110,22 +1280,65 @@ static const struct file_operations debug_clients_fops = {
 	.release = single_release,
 };
 
+static int nvmap_debug_client_latency_show(struct seq_file *s, void *unused)
+{
+	unsigned long flags;
+	struct nvmap_client *client;
+	struct nvmap_device *dev = s->private;
+
+	lat_hist_header(s);
+	spin_lock_irqsave(&dev->clients_lock, flags);
+	list_for_each_entry(client, &dev->clients, list) {
+		client_stringify(client, s);
+		seq_printf(s, "\n");
+		lat_hist_stringify(&client->lat, s);
+	}
+	spin_unlock_irqrestore(&dev->clients_lock, flags);
+	return 0;
+}
+
+static int nvmap_debug_client_latency_open(struct inode *inode,
+					   struct file *file)
+{
+	return single_open(file, nvmap_debug_client_latency_show,
+			   inode->i_private);
+}
+
+static const struct file_operations debug_client_latency_fops = {
+	.open = nvmap_debug_client_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int nvmap_debug_iovmm_clients_show(struct seq_file *s, void *unused)
 {
 	unsigned long flags;
 	unsigned int total = 0;
+	unsigned int evictions = 0;
+	unsigned int remaps = 0;
 	struct nvmap_client *client;
 	struct nvmap_device *dev = s->private;
 
 	spin_lock_irqsave(&dev->clients_lock, flags);
-	seq_printf(s, "%-18s %18s %8s %10s\n", "CLIENT", "PROCESS", "PID",
-		"SIZE");
+	seq_printf(s, "%-18s %18s %8s %10s %8s %8s\n", "CLIENT", "PROCESS",
+		"PID", "SIZE", "EVICTS", "REMAPS");
 	list_for_each_entry(client, &dev->clients, list) {
 		client_stringify(client, s);
-		seq_printf(s, " %10u\n", atomic_read(&client->iovm_commit));
+		seq_printf(s, " %10u %8u %8u\n",
+			atomic_read(&client->iovm_commit),
+			atomic_read(&client->iovm_evictions),
+			atomic_read(&client->iovm_remaps));
 		total += atomic_read(&client->iovm_commit);
+		evictions += atomic_read(&client->iovm_evictions);
+		remaps += atomic_read(&client->iovm_remaps);
 	}
-	seq_printf(s, "%-18s %18s %8u %10u\n", "total", "", 0, total);
+	seq_printf(s, "%-18s %18s %8u %10u %8u %8u\n", "total", "", 0, total,
+		evictions, remaps);
+#ifdef CONFIG_NVMAP_RECLAIM_UNPINNED_VM
+	seq_printf(s, "background evictions: %u\n",
+		atomic_read(&dev->iovmm_master.mru_bg_evictions));
+#endif
 	spin_unlock_irqrestore(&dev->clients_lock, flags);
 
 	return 0;
@@ -1200,6 +1413,8 @@ static void nvmap_deferred_ops_init(struct nvmap_deferred_ops *deferred_ops)
 	deferred_ops->deferred_maint_inner_flushed = 0;
 	deferred_ops->deferred_maint_outer_requested = 0;
 	deferred_ops->deferred_maint_outer_flushed = 0;
+	deferred_ops->deferred_maint_merged = 0;
+	deferred_ops->deferred_maint_skipped = 0;
 }
 
 static int nvmap_probe(struct platform_device *pdev)
@@ -1236,7 +1451,8 @@ static int nvmap_probe(struct platform_device *pdev)
 	dev->dev_super.fops = &nvmap_super_fops;
 	dev->dev_super.parent = &pdev->dev;
 
-	dev->handles = RB_ROOT;
+	for (i = 0; i < NVMAP_HANDLE_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&dev->handles[i]);
 
 	init_waitqueue_head(&dev->pte_wait);
 
@@ -1332,6 +1548,9 @@ static int nvmap_probe(struct platform_device *pdev)
 	if (IS_ERR_OR_NULL(nvmap_debug_root))
 		dev_err(&pdev->dev, "couldn't create debug files\n");
 
+	debugfs_create_file("client_latency", S_IRUGO, nvmap_debug_root,
+		dev, &debug_client_latency_fops);
+
 	debugfs_create_bool("enable_deferred_cache_maintenance",
 		S_IRUGO|S_IWUSR, nvmap_debug_root,
 		(u32 *)&dev->deferred_ops.enable_deferred_cache_maintenance);
@@ -1343,6 +1562,14 @@ static int nvmap_probe(struct platform_device *pdev)
 	debugfs_create_u64("deferred_maint_inner_flushed", S_IRUGO|S_IWUSR,
 			nvmap_debug_root,
 			&dev->deferred_ops.deferred_maint_inner_flushed);
+
+	debugfs_create_u64("deferred_maint_merged", S_IRUGO|S_IWUSR,
+			nvmap_debug_root,
+			&dev->deferred_ops.deferred_maint_merged);
+
+	debugfs_create_u64("deferred_maint_skipped", S_IRUGO|S_IWUSR,
+			nvmap_debug_root,
+			&dev->deferred_ops.deferred_maint_skipped);
 #ifdef CONFIG_OUTER_CACHE
 	debugfs_create_u64("deferred_maint_outer_requested", S_IRUGO|S_IWUSR,
 			nvmap_debug_root,
@@ -1385,6 +1612,11 @@ static int nvmap_probe(struct platform_device *pdev)
 					heap_root, node, &debug_clients_fops);
 				debugfs_create_file("allocations", S_IRUGO,
 				    heap_root, node, &debug_allocations_fops);
+				debugfs_create_file("latency", S_IRUGO,
+				    heap_root, &node->lat,
+				    &debug_heap_latency_fops);
+				nvmap_heap_debugfs_init(node->carveout,
+							heap_root);
 			}
 		}
 	}
@@ -1396,16 +1628,32 @@ static int nvmap_probe(struct platform_device *pdev)
 				dev, &debug_iovmm_clients_fops);
 			debugfs_create_file("allocations", S_IRUGO, iovmm_root,
 				dev, &debug_iovmm_allocations_fops);
+			debugfs_create_file("latency", S_IRUGO, iovmm_root,
+				&dev->pgalloc_lat, &debug_heap_latency_fops);
 #ifdef CONFIG_NVMAP_PAGE_POOLS
 			for (i = 0; i < NVMAP_NUM_POOLS; i++) {
 				char name[40];
 				char *memtype_string[] = {"uc", "wc",
 							  "iwb", "wb"};
+				struct nvmap_page_pool *pool =
+					&dev->iovmm_master.pools[i];
+				unsigned int j;
+
 				sprintf(name, "%s_page_pool_available_pages",
 					memtype_string[i]);
 				debugfs_create_u32(name, S_IRUGO,
 					iovmm_root,
 					&dev->iovmm_master.pools[i].npages);
+				for (j = 0; j < NVMAP_PP_NR_ORDERS; j++) {
+					static const unsigned int orders[] =
+						NVMAP_PP_ORDERS;
+
+					sprintf(name,
+						"%s_page_pool_order%u_chunks",
+						memtype_string[i], orders[j]);
+					debugfs_create_u32(name, S_IRUGO,
+						iovmm_root, &pool->nchunks[j]);
+				}
 			}
 #endif
 		}
@@ -1452,17 +1700,18 @@ fail:
 static int nvmap_remove(struct platform_device *pdev)
 {
 	struct nvmap_device *dev = platform_get_drvdata(pdev);
-	struct rb_node *n;
 	struct nvmap_handle *h;
+	struct hlist_node *pos, *tmp;
 	int i;
 
 	misc_deregister(&dev->dev_super);
 	misc_deregister(&dev->dev_user);
 
-	while ((n = rb_first(&dev->handles))) {
-		h = rb_entry(n, struct nvmap_handle, node);
-		rb_erase(&h->node, &dev->handles);
-		kfree(h);
+	for (i = 0; i < NVMAP_HANDLE_HASH_SIZE; i++) {
+		hlist_for_each_entry_safe(h, pos, tmp, &dev->handles[i], node) {
+			hlist_del_rcu(&h->node);
+			kfree_rcu(h, rcu);
+		}
 	}
 
 	if (!IS_ERR_OR_NULL(dev->iovmm_master.iovmm))
@@ -22,15 +22,26 @@
 #include <linux/export.h>
 #include <linux/nvmap.h>
 #include <linux/dma-buf.h>
+#include <linux/mutex.h>
 
 #include "nvmap.h"
 #include "nvmap_ioctl.h"
 
+/*
+ * The pages of a page-allocated handle never change, so one sg_table per
+ * exported buffer is built on the first map and handed to every attachment
+ * until the buffer is released.  Each map still pins the handle; the iovmm
+ * area of an unpinned handle stays on the nvmap MRU list, so a remap
+ * normally gets the same address back and only the dma address in the
+ * cached table has to be refreshed when it does not.
+ */
 struct nvmap_handle_info {
 	struct nvmap_client *client;
 	u32 id;
 	struct nvmap_handle_ref *ref;
 	struct nvmap_handle *handle;
+	struct mutex lock;
+	struct sg_table *sgt;
 };
 
 static int nvmap_dmabuf_attach(struct dma_buf *dmabuf, struct device *dev,
@@ -43,8 +54,9 @@ static int nvmap_dmabuf_attach(struct dma_buf *dmabuf, struct device *dev,
 	if (IS_ERR(ref))
 		return PTR_ERR(ref);
 
+	/* refs are per client, so every attachment gets this same one */
 	info->ref = ref;
-	attach->priv = info;
+	attach->priv = ref;
 
 	dev_dbg(dev, "%s(%08x)\n", __func__, info->id);
 	return 0;
@@ -55,7 +67,7 @@ static void nvmap_dmabuf_detach(struct dma_buf *dmabuf,
 {
 	struct nvmap_handle_info *info = dmabuf->priv;
 
-	nvmap_free(info->client, info->ref);
+	nvmap_free(info->client, attach->priv);
 
 	dev_dbg(attach->dev, "%s(%08x)\n", __func__, info->id);
 }
@@ -64,7 +76,8 @@ static struct sg_table *nvmap_dmabuf_map_dma_buf(
 	struct dma_buf_attachment *attach, enum dma_data_direction dir)
 {
 	struct nvmap_handle_info *info = attach->dmabuf->priv;
-	struct nvmap_handle *handle = info->ref->handle;
+	struct nvmap_handle_ref *ref = attach->priv;
+	struct nvmap_handle *handle = ref->handle;
 	int err, npages = PAGE_ALIGN(handle->size) >> PAGE_SHIFT;
 	struct sg_table *sgt;
 	dma_addr_t addr;
@@ -72,38 +85,52 @@ static struct sg_table *nvmap_dmabuf_map_dma_buf(
 	if (WARN_ON(!handle->heap_pgalloc))
 		return ERR_PTR(-EINVAL);
 
-	sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
-	if (!sgt)
-		return ERR_PTR(-ENOMEM);
-
-	addr = nvmap_pin(info->client, info->ref);
-	if (IS_ERR_VALUE(addr)) {
-		err = addr;
-		goto err_pin;
+	addr = nvmap_pin(info->client, ref);
+	if (IS_ERR_VALUE(addr))
+		return ERR_PTR(addr);
+
+	mutex_lock(&info->lock);
+	sgt = info->sgt;
+	if (!sgt) {
+		sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
+		if (!sgt) {
+			err = -ENOMEM;
+			goto err_nomem;
+		}
+
+		if (handle->pgalloc.contig) {
+			err = sg_alloc_table(sgt, 1, GFP_KERNEL);
+			if (err)
+				goto err_sgalloc;
+			sg_set_page(sgt->sgl, *handle->pgalloc.pages,
+				    handle->size, 0);
+		} else {
+			err = sg_alloc_table_from_pages(sgt,
+							handle->pgalloc.pages,
+							npages, 0, handle->size,
+							GFP_KERNEL);
+			if (err)
+				goto err_sgalloc;
+		}
+		sg_dma_len(sgt->sgl) = handle->size;
+		info->sgt = sgt;
 	}
-
-	if (info->ref->handle->pgalloc.contig) {
-		err = sg_alloc_table(sgt, 1, GFP_KERNEL);
-		if (err)
-			goto err_sgalloc;
-		sg_set_page(sgt->sgl, *handle->pgalloc.pages, handle->size, 0);
-	} else {
-		err = sg_alloc_table_from_pages(sgt, handle->pgalloc.pages,
-						npages, 0, handle->size,
-						GFP_KERNEL);
-		if (err)
-			goto err_sgalloc;
+	/* only changes if the iovmm area was reclaimed while unpinned */
+	if (sg_dma_address(sgt->sgl) != addr) {
+		dev_dbg(attach->dev, "%s(%08x) remapped at %08x\n", __func__,
+			info->id, addr);
+		sg_dma_address(sgt->sgl) = addr;
 	}
-	sg_dma_len(sgt->sgl) = handle->size;
-	sg_dma_address(sgt->sgl) = addr;
+	mutex_unlock(&info->lock);
 
 	dev_dbg(attach->dev, "%s(%08x)\n", __func__, info->id);
 	return sgt;
 
 err_sgalloc:
-	nvmap_unpin(info->client, info->ref);
-err_pin:
 	kfree(sgt);
+err_nomem:
+	mutex_unlock(&info->lock);
+	nvmap_unpin(info->client, ref);
 	return ERR_PTR(err);
 }
 
@@ -113,9 +140,8 @@ static void nvmap_dmabuf_unmap_dma_buf(struct dma_buf_attachment *attach,
 {
 	struct nvmap_handle_info *info = attach->dmabuf->priv;
 
-	nvmap_unpin(info->client, info->ref);
-	sg_free_table(sgt);
-	kfree(sgt);
+	/* the sg_table stays cached on the buffer until it is released */
+	nvmap_unpin(info->client, attach->priv);
 
 	dev_dbg(attach->dev, "%s(%08x)\n", __func__, info->id);
 }
@@ -126,6 +152,10 @@ static void nvmap_dmabuf_release(struct dma_buf *dmabuf)
 
 	pr_debug("%s(%08x)\n", __func__, info->id);
 
+	if (info->sgt) {
+		sg_free_table(info->sgt);
+		kfree(info->sgt);
+	}
 	nvmap_handle_put(info->handle);
 	nvmap_client_put(info->client);
 	kfree(info);
@@ -215,6 +245,7 @@ struct dma_buf *nvmap_share_dmabuf(struct nvmap_client *client, u32 id)
 	info->id = id;
 	info->handle = handle;
 	info->client = client;
+	mutex_init(&info->lock);
 
 	dmabuf = dma_buf_export(info, &nvmap_dma_buf_ops, handle->size,
 				O_RDWR);
@@ -23,16 +23,20 @@
 #define pr_fmt(fmt)	"%s: " fmt, __func__
 
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/kernel.h>
+#include <linux/kthread.h>
 #include <linux/list.h>
 #include <linux/mm.h>
 #include <linux/rbtree.h>
+#include <linux/rculist.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/fs.h>
 #include <linux/shrinker.h>
 #include <linux/moduleparam.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
 #include <linux/nvmap.h>
 
 #include <asm/cacheflush.h>
@@ -65,6 +69,12 @@
 #define NVMAP_TEST_PAGE_POOL_SHRINKER 1
 static bool enable_pp = 1;
 static int pool_size[NVMAP_NUM_POOLS];
+static const unsigned int pp_orders[NVMAP_PP_NR_ORDERS] = NVMAP_PP_ORDERS;
+
+#define NVMAP_PP_ZERO_BATCH	32
+static bool enable_pp_zero = 1;
+static struct task_struct *pp_zero_task;
+static DECLARE_WAIT_QUEUE_HEAD(pp_zero_wait);
 
 static char *s_memtype_str[] = {
 	"uc",
@@ -83,6 +93,42 @@ static inline void nvmap_page_pool_unlock(struct nvmap_page_pool *pool)
 	mutex_unlock(&pool->lock);
 }
 
+static void nvmap_zero_page(struct page *page, unsigned long kaddr,
+			    pte_t **pte, pgprot_t prot)
+{
+	phys_addr_t paddr;
+
+	/*
+	 * Just memset low mem pages; they will for sure have a virtual
+	 * address. Otherwise, build a mapping for the page in the kernel.
+	 */
+	if (!PageHighMem(page)) {
+		memset(page_address(page), 0, PAGE_SIZE);
+	} else {
+		paddr = page_to_phys(page);
+		set_pte_at(&init_mm, kaddr, *pte,
+			   pfn_pte(__phys_to_pfn(paddr), prot));
+		flush_tlb_kernel_page(kaddr);
+		memset((char *)kaddr, 0, PAGE_SIZE);
+	}
+}
+
+/* pages held by the pool in any form, bounded by max_pages. */
+static inline int nvmap_page_pool_held(struct nvmap_page_pool *pool)
+{
+	return pool->npages + pool->nclean + pool->chunk_pages;
+}
+
+/* Same as nvmap_page_pool_lock(), but accounts for the pool mutex being
+ * held by someone else when we get to it. */
+static inline void nvmap_page_pool_lock_stat(struct nvmap_page_pool *pool)
+{
+	if (!mutex_trylock(&pool->lock)) {
+		atomic_inc(&pool->contended);
+		mutex_lock(&pool->lock);
+	}
+}
+
 static struct page *nvmap_page_pool_alloc_locked(struct nvmap_page_pool *pool)
 {
 	struct page *page = NULL;
@@ -96,24 +142,167 @@ static struct page *nvmap_page_pool_alloc_locked(struct nvmap_page_pool *pool)
 	return page;
 }
 
+static struct page *nvmap_page_pool_alloc_clean_locked(
+			struct nvmap_page_pool *pool)
+{
+	struct page *page;
+
+	if (list_empty(&pool->clean_list))
+		return NULL;
+
+	page = list_first_entry(&pool->clean_list, struct page, lru);
+	list_del(&page->lru);
+	pool->nclean--;
+	atomic_dec(&page->_count);
+	BUG_ON(atomic_read(&page->_count) != 1);
+	return page;
+}
+
+static bool nvmap_page_pool_release_clean_locked(struct nvmap_page_pool *pool,
+						 struct page *page)
+{
+	if (!enable_pp || nvmap_page_pool_held(pool) >= pool->max_pages)
+		return false;
+
+	atomic_inc(&page->_count);
+	BUG_ON(atomic_read(&page->_count) != 2);
+	list_add(&page->lru, &pool->clean_list);
+	pool->nclean++;
+	return true;
+}
+
+/* Must be called with the pool lock held. Takes a page from the pool and,
+ * once the pool itself is empty, from any of the per-CPU magazines and
+ * finally from the clean list. */
+static struct page *nvmap_page_pool_reclaim_locked(struct nvmap_page_pool *pool)
+{
+	struct page *page = nvmap_page_pool_alloc_locked(pool);
+	struct nvmap_pp_magazine *mag;
+	unsigned int cpu;
+
+	if (page)
+		return page;
+
+	if (pool->mags) {
+		for_each_possible_cpu(cpu) {
+			mag = per_cpu_ptr(pool->mags, cpu);
+			spin_lock(&mag->lock);
+			if (mag->count) {
+				page = mag->pages[--mag->count];
+				mag->pages[mag->count] = NULL;
+			}
+			spin_unlock(&mag->lock);
+			if (page)
+				return page;
+		}
+	}
+
+	/* clean pages go last, they have had work put into them. */
+	return nvmap_page_pool_alloc_clean_locked(pool);
+}
+
 static struct page *nvmap_page_pool_alloc(struct nvmap_page_pool *pool)
 {
 	struct page *page = NULL;
+	struct nvmap_pp_magazine *mag;
+
+	if (!pool)
+		return NULL;
 
-	if (pool) {
-		nvmap_page_pool_lock(pool);
+	if (!pool->mags) {
+		nvmap_page_pool_lock_stat(pool);
 		page = nvmap_page_pool_alloc_locked(pool);
 		nvmap_page_pool_unlock(pool);
+		return page;
+	}
+
+	/* The magazine lock only guards against the owning CPU being
+	 * migrated away from mid-operation and against the shrinker,
+	 * so it is practically never contended. */
+	mag = per_cpu_ptr(pool->mags, raw_smp_processor_id());
+	spin_lock(&mag->lock);
+	if (mag->count) {
+		page = mag->pages[--mag->count];
+		mag->pages[mag->count] = NULL;
+		mag->hits++;
+	}
+	spin_unlock(&mag->lock);
+	if (page)
+		return page;
+
+	/* Magazine is empty, refill a batch from the pool. */
+	nvmap_page_pool_lock_stat(pool);
+	spin_lock(&mag->lock);
+	mag->misses++;
+	page = nvmap_page_pool_alloc_locked(pool);
+	if (page && pool->npages) {
+		mag->refills++;
+		while (mag->count < NVMAP_PP_MAG_BATCH) {
+			struct page *p = nvmap_page_pool_alloc_locked(pool);
+
+			if (!p)
+				break;
+			mag->pages[mag->count++] = p;
+		}
 	}
+	spin_unlock(&mag->lock);
+	nvmap_page_pool_unlock(pool);
 	return page;
 }
 
+static struct page *nvmap_page_pool_alloc_chunk_locked(
+			struct nvmap_page_pool *pool, int o)
+{
+	struct page *page;
+
+	if (list_empty(&pool->chunks[o]))
+		return NULL;
+
+	page = list_first_entry(&pool->chunks[o], struct page, lru);
+	list_del(&page->lru);
+	pool->nchunks[o]--;
+	pool->chunk_pages -= 1 << pp_orders[o];
+	BUG_ON(page_count(page) != 1);
+	return page;
+}
+
+static bool nvmap_page_pool_release_chunk_locked(struct nvmap_page_pool *pool,
+						 struct page *page, int o)
+{
+	unsigned int n = 1 << pp_orders[o];
+
+	if (!enable_pp || nvmap_page_pool_held(pool) + n > pool->max_pages)
+		return false;
+
+	BUG_ON(page_count(page) != 1);
+	list_add(&page->lru, &pool->chunks[o]);
+	pool->nchunks[o]++;
+	pool->chunk_pages += n;
+	return true;
+}
+
+/* true if pages[] starts with a naturally aligned, physically contiguous
+ * run of 1 << order pages, i.e. something that came from a chunk. */
+static bool nvmap_pages_are_chunk(struct page **pages, unsigned int order)
+{
+	unsigned long pfn = page_to_pfn(pages[0]);
+	unsigned int i;
+
+	if (pfn & ((1 << order) - 1))
+		return false;
+
+	for (i = 1; i < (1 << order); i++)
+		if (page_to_pfn(pages[i]) != pfn + i)
+			return false;
+	return true;
+}
+
 static bool nvmap_page_pool_release_locked(struct nvmap_page_pool *pool,
 					    struct page *page)
 {
 	int ret = false;
 
-	if (enable_pp && pool->npages < pool->max_pages) {
+	if (enable_pp && nvmap_page_pool_held(pool) < pool->max_pages) {
 		atomic_inc(&page->_count);
 		BUG_ON(atomic_read(&page->_count) != 2);
 		BUG_ON(pool->page_array[pool->npages] != NULL);
@@ -127,46 +316,324 @@ static bool nvmap_page_pool_release(struct nvmap_page_pool *pool,
 					  struct page *page)
 {
 	int ret = false;
+	struct nvmap_pp_magazine *mag;
+
+	if (!pool)
+		return ret;
 
-	if (pool) {
-		nvmap_page_pool_lock(pool);
+	if (!pool->mags) {
+		nvmap_page_pool_lock_stat(pool);
 		ret = nvmap_page_pool_release_locked(pool, page);
 		nvmap_page_pool_unlock(pool);
+		return ret;
 	}
+
+	if (!enable_pp || !pool->max_pages)
+		return ret;
+
+	mag = per_cpu_ptr(pool->mags, raw_smp_processor_id());
+	spin_lock(&mag->lock);
+	if (mag->count < NVMAP_PP_MAG_SIZE) {
+		mag->pages[mag->count++] = page;
+		ret = true;
+	}
+	spin_unlock(&mag->lock);
+	if (ret)
+		return ret;
+
+	/* Magazine is full, drain a batch back to the pool. Whatever the
+	 * pool can't take stays in the magazine. */
+	nvmap_page_pool_lock_stat(pool);
+	spin_lock(&mag->lock);
+	mag->drains++;
+	while (mag->count > NVMAP_PP_MAG_BATCH) {
+		if (!nvmap_page_pool_release_locked(pool,
+				mag->pages[mag->count - 1]))
+			break;
+		mag->pages[--mag->count] = NULL;
+	}
+	if (mag->count < NVMAP_PP_MAG_SIZE) {
+		mag->pages[mag->count++] = page;
+		ret = true;
+	}
+	spin_unlock(&mag->lock);
+	nvmap_page_pool_unlock(pool);
 	return ret;
 }
 
+/* Fill up to nr entries of pages[] from the pool, preferring the largest
+ * chunk that fits. Returns the number of pages filled in, 0 when the pool
+ * has nothing left. */
+static unsigned int nvmap_page_pool_alloc_run(struct nvmap_page_pool *pool,
+					      struct page **pages,
+					      unsigned int nr)
+{
+	struct page *page = NULL;
+	unsigned int i;
+	int o;
+
+	if (!pool)
+		return 0;
+
+	for (o = 0; o < NVMAP_PP_NR_ORDERS; o++) {
+		if (nr < (1 << pp_orders[o]) || !pool->nchunks[o])
+			continue;
+
+		nvmap_page_pool_lock_stat(pool);
+		page = nvmap_page_pool_alloc_chunk_locked(pool, o);
+		nvmap_page_pool_unlock(pool);
+		if (page) {
+			for (i = 0; i < (1 << pp_orders[o]); i++)
+				pages[i] = nth_page(page, i);
+			return 1 << pp_orders[o];
+		}
+	}
+
+	pages[0] = nvmap_page_pool_alloc(pool);
+	return pages[0] ? 1 : 0;
+}
+
+/* Counterpart of nvmap_page_pool_alloc_run(); returns the number of
+ * leading pages of pages[] taken by the pool. */
+static unsigned int nvmap_page_pool_release_run(struct nvmap_page_pool *pool,
+						struct page **pages,
+						unsigned int nr)
+{
+	bool ret;
+	int o;
+
+	if (!pool)
+		return 0;
+
+	for (o = 0; o < NVMAP_PP_NR_ORDERS; o++) {
+		if (nr < (1 << pp_orders[o]) ||
+		    !nvmap_pages_are_chunk(pages, pp_orders[o]))
+			continue;
+
+		nvmap_page_pool_lock_stat(pool);
+		ret = nvmap_page_pool_release_chunk_locked(pool, pages[0], o);
+		nvmap_page_pool_unlock(pool);
+		if (ret)
+			return 1 << pp_orders[o];
+	}
+
+	return nvmap_page_pool_release(pool, pages[0]) ? 1 : 0;
+}
+
 static int nvmap_page_pool_get_available_count(struct nvmap_page_pool *pool)
 {
-	return pool->npages;
+	int count = nvmap_page_pool_held(pool);
+	unsigned int cpu;
+
+	if (pool->mags)
+		for_each_possible_cpu(cpu)
+			count += per_cpu_ptr(pool->mags, cpu)->count;
+	return count;
 }
 
-static int nvmap_page_pool_free(struct nvmap_page_pool *pool, int nr_free)
+static void nvmap_page_pool_free_pages(struct page **pages, int nr)
 {
 	int err;
+
+	if (!nr)
+		return;
+
+	/* This op should never fail. */
+	err = set_pages_array_wb(pages, nr);
+	BUG_ON(err);
+
+	while (nr--)
+		__free_page(pages[nr]);
+}
+
+/* Hand out up to nr pages that the zeroing thread already scrubbed. */
+static unsigned int nvmap_page_pool_alloc_clean(struct nvmap_page_pool *pool,
+						struct page **pages,
+						unsigned int nr)
+{
+	unsigned int i = 0;
+
+	if (!pool || !pool->nclean)
+		return 0;
+
+	nvmap_page_pool_lock_stat(pool);
+	while (i < nr) {
+		pages[i] = nvmap_page_pool_alloc_clean_locked(pool);
+		if (!pages[i])
+			break;
+		i++;
+	}
+	nvmap_page_pool_unlock(pool);
+	atomic_add(i, &pool->zero_avoided);
+	return i;
+}
+
+static pgprot_t nvmap_page_pool_pgprot(struct nvmap_page_pool *pool)
+{
+	if (pool->flags == NVMAP_HANDLE_UNCACHEABLE)
+		return pgprot_noncached(pgprot_kernel);
+	else if (pool->flags == NVMAP_HANDLE_WRITE_COMBINE)
+		return pgprot_writecombine(pgprot_kernel);
+#ifndef CONFIG_ARM_LPAE /* !!!FIXME!!! BUG 892578 */
+	else if (pool->flags == NVMAP_HANDLE_INNER_CACHEABLE)
+		return pgprot_inner_writeback(pgprot_kernel);
+#endif
+	return pgprot_kernel;
+}
+
+/* Returns the number of leading pages of pages[] that were zeroed. */
+static int nvmap_page_pool_zero_pages(struct nvmap_page_pool *pool,
+				      struct page **pages, int nr)
+{
+	pgprot_t prot = nvmap_page_pool_pgprot(pool);
+	unsigned long kaddr = 0;
+	pte_t **pte = NULL;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		if (PageHighMem(pages[i]) && !pte) {
+			pte = nvmap_alloc_pte(nvmap_dev, (void **)&kaddr);
+			if (IS_ERR(pte)) {
+				pte = NULL;
+				break;
+			}
+		}
+		nvmap_zero_page(pages[i], kaddr, pte, prot);
+	}
+
+	if (pte)
+		nvmap_free_pte(nvmap_dev, pte);
+	return i;
+}
+
+static bool nvmap_page_pool_putback_locked(struct nvmap_page_pool *pool,
+					   struct page *page, bool clean)
+{
+	if (clean)
+		return nvmap_page_pool_release_clean_locked(pool, page);
+	return nvmap_page_pool_release_locked(pool, page);
+}
+
+static bool nvmap_page_pool_have_dirty(void)
+{
+	struct nvmap_share *share;
+	unsigned int i;
+
+	if (!nvmap_dev || !enable_pp || !enable_pp_zero)
+		return false;
+
+	share = nvmap_get_share_from_dev(nvmap_dev);
+	for (i = 0; i < NVMAP_NUM_POOLS; i++)
+		if (share->pools[i].npages)
+			return true;
+	return false;
+}
+
+static void nvmap_page_pool_kick_zeroing(void)
+{
+	if (pp_zero_task && waitqueue_active(&pp_zero_wait))
+		wake_up(&pp_zero_wait);
+}
+
+/*
+ * Moves released pages from the pool's dirty array to its clean list,
+ * a batch at a time. Runs as SCHED_IDLE so it only ever gets CPU time
+ * nobody else wants.
+ */
+static int nvmap_page_pool_zero_thread(void *data)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	struct page *pages[NVMAP_PP_ZERO_BATCH];
+	struct nvmap_page_pool *pool;
+	struct nvmap_share *share;
+	unsigned int i;
+	int nr, zeroed, j;
+
+	sched_setscheduler(current, SCHED_IDLE, &param);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pp_zero_wait, kthread_should_stop() ||
+				     nvmap_page_pool_have_dirty());
+		if (kthread_should_stop())
+			break;
+
+		share = nvmap_get_share_from_dev(nvmap_dev);
+		for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+			pool = &share->pools[i];
+
+			nvmap_page_pool_lock(pool);
+			for (nr = 0; nr < NVMAP_PP_ZERO_BATCH; nr++) {
+				pages[nr] = nvmap_page_pool_alloc_locked(pool);
+				if (!pages[nr])
+					break;
+			}
+			nvmap_page_pool_unlock(pool);
+			if (!nr)
+				continue;
+
+			zeroed = nvmap_page_pool_zero_pages(pool, pages, nr);
+
+			nvmap_page_pool_lock(pool);
+			for (j = 0; j < nr; j++)
+				if (!nvmap_page_pool_putback_locked(pool,
+						pages[j], j < zeroed))
+					break;
+			nvmap_page_pool_unlock(pool);
+
+			/* pool shrank or got disabled under us. */
+			nvmap_page_pool_free_pages(&pages[j], nr - j);
+			cond_resched();
+		}
+	}
+	return 0;
+}
+
+static int nvmap_page_pool_free(struct nvmap_page_pool *pool, int nr_free)
+{
 	int i = nr_free;
 	int idx = 0;
+	int o, n, k;
 	struct page *page;
 
 	if (!nr_free)
 		return nr_free;
 	nvmap_page_pool_lock(pool);
+	if (!pool->shrink_array)
+		goto out;
 	while (i) {
-		page = nvmap_page_pool_alloc_locked(pool);
+		page = nvmap_page_pool_reclaim_locked(pool);
 		if (!page)
 			break;
 		pool->shrink_array[idx++] = page;
 		i--;
+		/* magazine pages may push us past the pool size. */
+		if (idx == pool->max_pages) {
+			nvmap_page_pool_free_pages(pool->shrink_array, idx);
+			idx = 0;
+		}
 	}
 
-	if (idx) {
-		/* This op should never fail. */
-		err = set_pages_array_wb(pool->shrink_array, idx);
-		BUG_ON(err);
+	/* Break up chunks, smallest first, only once order-0 pages are
+	 * gone; they are the expensive ones to get back. */
+	for (o = NVMAP_PP_NR_ORDERS - 1; o >= 0 && i > 0; o--) {
+		n = 1 << pp_orders[o];
+		while (i > 0) {
+			page = nvmap_page_pool_alloc_chunk_locked(pool, o);
+			if (!page)
+				break;
+			if (idx + n > pool->max_pages) {
+				nvmap_page_pool_free_pages(pool->shrink_array,
+							   idx);
+				idx = 0;
+			}
+			for (k = 0; k < n; k++)
+				pool->shrink_array[idx++] = nth_page(page, k);
+			i = max(i - n, 0);
+		}
 	}
-
-	while (idx--)
-		__free_page(pool->shrink_array[idx]);
+	nvmap_page_pool_free_pages(pool->shrink_array, idx);
+out:
 	nvmap_page_pool_unlock(pool);
 	return i;
 }
@@ -335,6 +802,107 @@ static struct kernel_param_ops enable_pp_ops = {
 
 module_param_cb(enable_page_pools, &enable_pp_ops, &enable_pp, 0644);
 
+static int pp_mag_stats_set(const char *arg, const struct kernel_param *kp)
+{
+	return -EPERM;
+}
+
+static int pp_mag_stats_get(char *buff, const struct kernel_param *kp)
+{
+	unsigned int i, cpu;
+	int len = 0;
+	struct nvmap_share *share;
+
+	if (!nvmap_dev)
+		return -ENODEV;
+
+	share = nvmap_get_share_from_dev(nvmap_dev);
+	len += sprintf(buff + len,
+		       "pool hits misses refills drains contended\n");
+	for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+		struct nvmap_page_pool *pool = &share->pools[i];
+		unsigned long hits = 0, misses = 0, refills = 0, drains = 0;
+
+		if (!pool->mags)
+			continue;
+
+		for_each_possible_cpu(cpu) {
+			struct nvmap_pp_magazine *mag =
+				per_cpu_ptr(pool->mags, cpu);
+
+			hits += mag->hits;
+			misses += mag->misses;
+			refills += mag->refills;
+			drains += mag->drains;
+		}
+		len += sprintf(buff + len, "%s %lu %lu %lu %lu %d\n",
+			s_memtype_str[i], hits, misses, refills, drains,
+			atomic_read(&pool->contended));
+	}
+	return len;
+}
+
+static struct kernel_param_ops pp_mag_stats_ops = {
+	.get = pp_mag_stats_get,
+	.set = pp_mag_stats_set,
+};
+
+module_param_cb(page_pool_mag_stats, &pp_mag_stats_ops, NULL, 0444);
+
+static int enable_pp_zero_set(const char *arg, const struct kernel_param *kp)
+{
+	int ret = param_set_bool(arg, kp);
+
+	if (!ret && enable_pp_zero)
+		nvmap_page_pool_kick_zeroing();
+	return ret;
+}
+
+static int enable_pp_zero_get(char *buff, const struct kernel_param *kp)
+{
+	return param_get_bool(buff, kp);
+}
+
+static struct kernel_param_ops enable_pp_zero_ops = {
+	.get = enable_pp_zero_get,
+	.set = enable_pp_zero_set,
+};
+
+module_param_cb(enable_page_pool_zeroing, &enable_pp_zero_ops,
+		&enable_pp_zero, 0644);
+
+static int pp_zero_stats_get(char *buff, const struct kernel_param *kp)
+{
+	unsigned int i;
+	int len = 0;
+	struct nvmap_share *share;
+
+	if (!nvmap_dev)
+		return -ENODEV;
+
+	share = nvmap_get_share_from_dev(nvmap_dev);
+	len += sprintf(buff + len, "pool clean dirty avoided sync\n");
+	for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+		struct nvmap_page_pool *pool = &share->pools[i];
+
+		if (!pool->max_pages)
+			continue;
+
+		len += sprintf(buff + len, "%s %d %d %d %d\n",
+			s_memtype_str[i], pool->nclean, pool->npages,
+			atomic_read(&pool->zero_avoided),
+			atomic_read(&pool->zero_sync));
+	}
+	return len;
+}
+
+static struct kernel_param_ops pp_zero_stats_ops = {
+	.get = pp_zero_stats_get,
+	.set = pp_mag_stats_set,
+};
+
+module_param_cb(page_pool_zero_stats, &pp_zero_stats_ops, NULL, 0444);
+
 #define POOL_SIZE_SET(m, i) \
 static int pool_size_##m##_set(const char *arg, const struct kernel_param *kp) \
 { \
@@ -383,8 +951,8 @@ int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags)
 {
 	static int reg = 1;
 	struct sysinfo info;
-#ifdef CONFIG_NVMAP_PAGE_POOLS_INIT_FILLUP
 	int i;
+#ifdef CONFIG_NVMAP_PAGE_POOLS_INIT_FILLUP
 	int err;
 	struct page *page;
 	int highmem_pages = 0;
@@ -401,6 +969,9 @@ int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags)
 	memset(pool, 0x0, sizeof(*pool));
 	mutex_init(&pool->lock);
 	pool->flags = flags;
+	for (i = 0; i < NVMAP_PP_NR_ORDERS; i++)
+		INIT_LIST_HEAD(&pool->chunks[i]);
+	INIT_LIST_HEAD(&pool->clean_list);
 
 	/* No default pool for cached memory. */
 	if (flags == NVMAP_HANDLE_CACHEABLE)
@@ -425,9 +996,27 @@ int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags)
 	if (!pool->page_array || !pool->shrink_array)
 		goto fail;
 
+	/* Without magazines every pool access simply takes the mutex. */
+	pool->mags = alloc_percpu(struct nvmap_pp_magazine);
+	if (pool->mags) {
+		unsigned int cpu;
+
+		for_each_possible_cpu(cpu)
+			spin_lock_init(&per_cpu_ptr(pool->mags, cpu)->lock);
+	} else {
+		pr_warn("no per-cpu caches for %s page pool\n",
+			s_memtype_str[flags]);
+	}
+
 	if (reg) {
 		reg = 0;
 		register_shrinker(&nvmap_page_pool_shrinker);
+		pp_zero_task = kthread_run(nvmap_page_pool_zero_thread, NULL,
+					   "nvmap-pp-zero");
+		if (IS_ERR(pp_zero_task)) {
+			pr_err("failed to start page pool zeroing thread");
+			pp_zero_task = NULL;
+		}
 	}
 
 #ifdef CONFIG_NVMAP_PAGE_POOLS_INIT_FILLUP
@@ -514,11 +1103,15 @@ void _nvmap_handle_free(struct nvmap_handle *h)
 		pool = &share->pools[h->flags];
 
 	while (page_index < nr_page) {
-		if (!nvmap_page_pool_release(pool,
-		    h->pgalloc.pages[page_index]))
+		unsigned int n = nvmap_page_pool_release_run(pool,
+					&h->pgalloc.pages[page_index],
+					nr_page - page_index);
+		if (!n)
 			break;
-		page_index++;
+		page_index += n;
 	}
+	if (page_index)
+		nvmap_page_pool_kick_zeroing();
 #endif
 
 	if (page_index == nr_page)
@@ -544,7 +1137,8 @@ skip_attr_restore:
 	altfree(h->pgalloc.pages, nr_page * sizeof(struct page *));
 
 out:
-	kfree(h);
+	/* lock-free id lookups may still be looking at h */
+	kfree_rcu(h, rcu);
 }
 
 static struct page *nvmap_alloc_pages_exact(gfp_t gfp, size_t size)
@@ -567,6 +1161,57 @@ static struct page *nvmap_alloc_pages_exact(gfp_t gfp, size_t size)
 	return page;
 }
 
+#ifdef CONFIG_TEGRA_IOMMU_SMMU
+/* 4MB chunks at 4MB offsets into the handle, which the SMMU maps as
+ * sections since the iova of a handle that big is 4MB aligned too */
+#define NVMAP_SECTION_ORDER	(22 - PAGE_SHIFT)
+#endif
+
+static bool nvmap_alloc_chunk(gfp_t gfp, struct page **pages,
+			      unsigned int order)
+{
+	struct page *page;
+	unsigned int j;
+
+	page = alloc_pages(gfp | __GFP_NORETRY | __GFP_NOWARN, order);
+	if (!page)
+		return false;
+	split_page(page, order);
+	for (j = 0; j < (1 << order); j++)
+		pages[j] = nth_page(page, j);
+	return true;
+}
+
+/* Allocate up to nr pages into pages[] using the largest naturally aligned
+ * chunk that the page allocator hands out without trying too hard, the same
+ * way ion's system heap does. index is where pages[] starts in the handle.
+ * Returns the number of pages filled in. */
+static unsigned int nvmap_alloc_largest_available(gfp_t gfp,
+						  struct page **pages,
+						  unsigned int index,
+						  unsigned int nr)
+{
+	static const unsigned int orders[] = NVMAP_PP_ORDERS;
+	unsigned int i;
+
+#ifdef NVMAP_SECTION_ORDER
+	if (nr >= (1 << NVMAP_SECTION_ORDER) &&
+	    !(index & ((1 << NVMAP_SECTION_ORDER) - 1)) &&
+	    nvmap_alloc_chunk(gfp, pages, NVMAP_SECTION_ORDER))
+		return 1 << NVMAP_SECTION_ORDER;
+#endif
+
+	for (i = 0; i < ARRAY_SIZE(orders); i++) {
+		if (nr < (1 << orders[i]))
+			continue;
+		if (nvmap_alloc_chunk(gfp, pages, orders[i]))
+			return 1 << orders[i];
+	}
+
+	pages[0] = nvmap_alloc_pages_exact(gfp, PAGE_SIZE);
+	return pages[0] ? 1 : 0;
+}
+
 static int handle_page_alloc(struct nvmap_client *client,
 			     struct nvmap_handle *h, bool contiguous)
 {
@@ -582,7 +1227,7 @@ static int handle_page_alloc(struct nvmap_client *client,
 #endif
 	gfp_t gfp = GFP_NVMAP;
 	unsigned long kaddr;
-	phys_addr_t paddr;
+	unsigned int n;
 	pte_t **pte = NULL;
 
 	if (h->userflags & NVMAP_HANDLE_ZEROED_PAGES) {
@@ -614,36 +1259,38 @@ static int handle_page_alloc(struct nvmap_client *client,
 		if (h->flags < NVMAP_NUM_POOLS)
 			pool = &share->pools[h->flags];
 
-		for (i = 0; i < nr_page; i++) {
-			/* Get pages from pool, if available. */
-			pages[i] = nvmap_page_pool_alloc(pool);
-			if (!pages[i])
-				break;
+		/* Get pages from pool, if available. Zeroed handles take
+		 * pre-scrubbed pages first. */
+		while (i < nr_page) {
 			if (h->userflags & NVMAP_HANDLE_ZEROED_PAGES) {
-				/*
-				 * Just memset low mem pages; they will for
-				 * sure have a virtual address. Otherwise, build
-				 * a mapping for the page in the kernel.
-				 */
-				if (!PageHighMem(pages[i])) {
-					memset(page_address(pages[i]), 0,
-					       PAGE_SIZE);
-				} else {
-					paddr = page_to_phys(pages[i]);
-					set_pte_at(&init_mm, kaddr, *pte,
-						   pfn_pte(__phys_to_pfn(paddr),
-							   prot));
-					flush_tlb_kernel_page(kaddr);
-					memset((char *)kaddr, 0, PAGE_SIZE);
+				n = nvmap_page_pool_alloc_clean(pool,
+						&pages[i], nr_page - i);
+				if (n) {
+					i += n;
+					continue;
 				}
 			}
-			page_index++;
+			n = nvmap_page_pool_alloc_run(pool, &pages[i],
+						      nr_page - i);
+			if (!n)
+				break;
+			if (h->userflags & NVMAP_HANDLE_ZEROED_PAGES) {
+				atomic_add(n, &pool->zero_sync);
+				for (; n; n--, i++)
+					nvmap_zero_page(pages[i], kaddr,
+							pte, prot);
+			} else {
+				i += n;
+			}
 		}
+		page_index = i;
 #endif
-		for (; i < nr_page; i++) {
-			pages[i] = nvmap_alloc_pages_exact(gfp,	PAGE_SIZE);
-			if (!pages[i])
+		while (i < nr_page) {
+			n = nvmap_alloc_largest_available(gfp, &pages[i], i,
+							  nr_page - i);
+			if (!n)
 				goto fail;
+			i += n;
 		}
 
 #ifndef CONFIG_NVMAP_RECLAIM_UNPINNED_VM
@@ -790,6 +1437,7 @@ int nvmap_alloc_handle_id(struct nvmap_client *client,
 	const unsigned int *alloc_policy;
 	int nr_page;
 	int err = -ENOMEM;
+	ktime_t lat_start = nvmap_lat_start();
 
 	h = nvmap_get_handle_id(client, id);
 
@@ -866,6 +1514,9 @@ int nvmap_alloc_handle_id(struct nvmap_client *client,
 
 out:
 	err = (h->alloc) ? 0 : err;
+	if (nvmap_lat_enabled())
+		__nvmap_lat_record(client, nvmap_lat_heap_hist(h),
+				   NVMAP_LAT_ALLOC, lat_start);
 	nvmap_handle_put(h);
 	return err;
 }
@@ -899,6 +1550,8 @@ void nvmap_free_handle_id(struct nvmap_client *client, unsigned long id)
 {
 	struct nvmap_handle_ref *ref;
 	struct nvmap_handle *h;
+	struct nvmap_lat_hist *lat_heap = NULL;
+	ktime_t lat_start = nvmap_lat_start();
 	int pins;
 
 	nvmap_ref_lock(client);
@@ -912,6 +1565,8 @@ void nvmap_free_handle_id(struct nvmap_client *client, unsigned long id)
 	trace_nvmap_free_handle_id(client, id);
 	BUG_ON(!ref->handle);
 	h = ref->handle;
+	if (nvmap_lat_enabled())
+		lat_heap = nvmap_lat_heap_hist(h);
 
 	if (atomic_dec_return(&ref->dupes)) {
 		nvmap_ref_unlock(client);
@@ -921,6 +1576,7 @@ void nvmap_free_handle_id(struct nvmap_client *client, unsigned long id)
 	smp_rmb();
 	pins = atomic_read(&ref->pin);
 	rb_erase(&ref->node, &client->handle_refs);
+	hlist_del_rcu(&ref->hnode);
 
 	if (h->alloc && h->heap_pgalloc && !h->pgalloc.contig)
 		atomic_sub(h->size, &client->iovm_commit);
@@ -947,13 +1603,14 @@ void nvmap_free_handle_id(struct nvmap_client *client, unsigned long id)
 		h->owner_ref = NULL;
 	}
 
-	kfree(ref);
+	kfree_rcu(ref, rcu);
 
 out:
 	BUG_ON(!atomic_read(&h->ref));
 	if (nvmap_find_cache_maint_op(h->dev, h))
 		nvmap_cache_maint_ops_flush(h->dev, h);
 	nvmap_handle_put(h);
+	nvmap_lat_record(client, lat_heap, NVMAP_LAT_FREE, lat_start);
 }
 EXPORT_SYMBOL(nvmap_free_handle_id);
 
@@ -961,6 +1618,7 @@ EXPORT_SYMBOL(nvmap_free_handle_id);
 static void add_handle_ref(struct nvmap_client *client,
 			   struct nvmap_handle_ref *ref)
 {
+	unsigned long id = (unsigned long)ref->handle;
 	struct rb_node **p, *parent = NULL;
 
 	nvmap_ref_lock(client);
@@ -976,6 +1634,7 @@ static void add_handle_ref(struct nvmap_client *client,
 	}
 	rb_link_node(&ref->node, parent, p);
 	rb_insert_color(&ref->node, &client->handle_refs);
+	hlist_add_head_rcu(&ref->hnode, nvmap_ref_bucket(client, id));
 	nvmap_ref_unlock(client);
 }
 
@@ -20,14 +20,18 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/mm.h>
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/stat.h>
 #include <linux/err.h>
+#include <linux/workqueue.h>
+#include <linux/gfp.h>
 
 #include <linux/nvmap.h>
 #include "nvmap.h"
@@ -73,6 +77,13 @@
 
 #define MAX_BUDDY_NR	128	/* maximum buddies in a buddy allocator */
 
+/* background compaction relocates at most this many blocks per step, and
+ * is started once this share of the free space (in percent) is outside
+ * the largest free block. */
+#define NVMAP_HEAP_COMPACT_STEP		4
+#define NVMAP_HEAP_COMPACT_DELAY_MS	100
+#define NVMAP_HEAP_COMPACT_FRAG_PCT	50
+
 enum direction {
 	TOP_DOWN,
 	BOTTOM_UP
@@ -145,6 +156,21 @@ struct nvmap_heap {
 	const char *name;
 	void *arg;
 	struct device dev;
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	struct delayed_work compact_work;
+	u32 compact_threshold;	/* fragmentation %, 0 disables */
+	u32 compact_moved;	/* blocks relocated */
+	u32 compact_steps;	/* background steps run */
+	u64 compact_time_us;	/* time spent compacting, all paths */
+#endif
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	bool cma;		/* heap lies in a CMA region */
+	u64 cma_claimed;	/* bytes currently taken from the buddy */
+	u32 cma_claims;		/* blocks migrated in */
+	u32 cma_claim_failures;
+	u64 cma_claim_time_us;	/* time spent migrating, all claims */
+	u64 cma_claim_max_us;	/* slowest single claim */
+#endif
 };
 
 static struct kmem_cache *buddy_heap_cache;
@@ -389,10 +415,10 @@ static struct buddy_heap *do_buddy_free(struct nvmap_heap_block *block)
  * base_max limits position of allocated chunk in memory.
  * if base_max is 0 then there is no such limitation.
  */
-static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
-					      size_t len, size_t align,
-					      unsigned int mem_prot,
-					      phys_addr_t base_max)
+static struct nvmap_heap_block *__do_heap_alloc(struct nvmap_heap *heap,
+						size_t len, size_t align,
+						unsigned int mem_prot,
+						phys_addr_t base_max)
 {
 	struct list_block *b = NULL;
 	struct list_block *i = NULL;
@@ -411,6 +437,15 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 		len = PAGE_ALIGN(len);
 	}
 
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	/* blocks of a CMA heap are claimed from the page allocator page by
+	 * page, so no two blocks may share a page. */
+	if (heap->cma) {
+		align = max_t(size_t, align, PAGE_SIZE);
+		len = PAGE_ALIGN(len);
+	}
+#endif
+
 #ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
 	dir = BOTTOM_UP;
 #else
@@ -579,6 +614,80 @@ static struct list_block *do_heap_free(struct nvmap_heap_block *block)
 	return b;
 }
 
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+/*
+ * A CMA heap leaves its free space to movable pages. Allocating a block
+ * migrates whatever lives in [start, end) elsewhere and takes the pages
+ * out of the buddy allocator; freeing the block gives them back.
+ */
+static int heap_cma_claim(struct nvmap_heap *heap, phys_addr_t start,
+			  phys_addr_t end)
+{
+	ktime_t t = ktime_get();
+	s64 us;
+	int err;
+
+	err = alloc_contig_range(__phys_to_pfn(start), __phys_to_pfn(end),
+				 MIGRATE_CMA);
+	us = ktime_us_delta(ktime_get(), t);
+	heap->cma_claim_time_us += us;
+	if (err) {
+		heap->cma_claim_failures++;
+		dev_warn(&heap->dev, "failed to claim %08lx..%08lx: %d\n",
+			 (unsigned long)start, (unsigned long)end, err);
+		return err;
+	}
+
+	heap->cma_claims++;
+	heap->cma_claimed += end - start;
+	heap->cma_claim_max_us = max_t(u64, heap->cma_claim_max_us, us);
+	return 0;
+}
+
+static void heap_cma_release(struct nvmap_heap *heap, phys_addr_t start,
+			     phys_addr_t end)
+{
+	free_contig_range(__phys_to_pfn(start), (end - start) >> PAGE_SHIFT);
+	heap->cma_claimed -= end - start;
+}
+
+/* the pages a list block owns, including any alignment slack before it */
+static void list_block_range(struct list_block *lb, phys_addr_t *start,
+			     phys_addr_t *end)
+{
+	*start = lb->orig_addr;
+	*end = lb->block.base + lb->size;
+}
+#endif
+
+static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
+					      size_t len, size_t align,
+					      unsigned int mem_prot,
+					      phys_addr_t base_max)
+{
+	struct nvmap_heap_block *b;
+
+	b = __do_heap_alloc(heap, len, align, mem_prot, base_max);
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	if (b && heap->cma) {
+		struct list_block *lb = container_of(b, struct list_block,
+						     block);
+		phys_addr_t start, end;
+
+		list_block_range(lb, &start, &end);
+		if (heap_cma_claim(heap, start, end)) {
+			do_heap_free(b);
+			return NULL;
+		}
+		/* the buddy allocator hands pages back with the cpu caches
+		 * possibly dirty, while carveout blocks are assumed clean */
+		nvmap_flush_heap_block(NULL, b, lb->size,
+				       NVMAP_HANDLE_CACHEABLE);
+	}
+#endif
+	return b;
+}
+
 #ifndef CONFIG_NVMAP_CARVEOUT_COMPACTOR
 
 static struct nvmap_heap_block *do_buddy_alloc(struct nvmap_heap *h,
@@ -701,6 +810,15 @@ static struct nvmap_heap_block *do_heap_relocate_listblock(
 	unsigned int src_prot = block->mem_prot;
 	int error = 0;
 	struct nvmap_share *share;
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	phys_addr_t src_start, src_end;
+
+	/* the full path would free the source pages to the buddy allocator
+	 * before copying out of them */
+	if (heap->cma)
+		fast = true;
+	list_block_range(block, &src_start, &src_end);
+#endif
 
 	if (!handle) {
 		pr_err("INVALID HANDLE!\n");
@@ -757,6 +875,10 @@ static struct nvmap_heap_block *do_heap_relocate_listblock(
 					dst_base, src_base, src_size);
 		BUG_ON(error);
 	}
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	if (heap->cma)
+		heap_cma_release(heap, src_start, src_end);
+#endif
 
 fail:
 	mutex_unlock(&share->pin_lock);
@@ -764,8 +886,12 @@ fail:
 	return heap_block_new;
 }
 
-static void nvmap_heap_compact(struct nvmap_heap *heap,
-				size_t requested_size, bool fast)
+/* relocates up to max_moves blocks towards the start of the heap and
+ * returns the number of blocks moved; must be called while holding the
+ * heap's lock. */
+static int __nvmap_heap_compact(struct nvmap_heap *heap,
+				size_t requested_size, bool fast,
+				int max_moves)
 {
 	struct list_block *block_current = NULL;
 	struct list_block *block_prev = NULL;
@@ -777,7 +903,7 @@ static void nvmap_heap_compact(struct nvmap_heap *heap,
 	ptr = heap->all_list.next;
 
 	/* walk through all blocks */
-	while (ptr != &heap->all_list) {
+	while (ptr != &heap->all_list && relocation_count < max_moves) {
 		block_current = list_entry(ptr, struct list_block, all_list);
 
 		ptr_prev = ptr->prev;
@@ -836,8 +962,67 @@ static void nvmap_heap_compact(struct nvmap_heap *heap,
 		}
 		ptr = ptr_next;
 	}
+	return relocation_count;
+}
+
+static void nvmap_heap_compact(struct nvmap_heap *heap,
+				size_t requested_size, bool fast)
+{
+	ktime_t start = ktime_get();
+	int relocation_count;
+
+	relocation_count = __nvmap_heap_compact(heap, requested_size, fast,
+						INT_MAX);
+	heap->compact_moved += relocation_count;
+	heap->compact_time_us += ktime_us_delta(ktime_get(), start);
 	pr_err("Relocated %d chunks\n", relocation_count);
 }
+
+static bool nvmap_heap_fragmented(struct nvmap_heap *heap)
+{
+	struct heap_stat stat;
+
+	if (!heap->compact_threshold)
+		return false;
+
+	heap_stat(heap, &stat);
+	if (!stat.free)
+		return false;
+
+	return stat.free - stat.free_largest >
+		stat.free / 100 * heap->compact_threshold;
+}
+
+static void nvmap_heap_compact_work(struct work_struct *work)
+{
+	struct nvmap_heap *heap = container_of(to_delayed_work(work),
+					struct nvmap_heap, compact_work);
+	ktime_t start = ktime_get();
+	int moved;
+
+	/* fast relocation only ever allocates below the block's current
+	 * base before freeing it, so every step leaves the heap in a
+	 * consistent state and allocations can get in between steps. */
+	mutex_lock(&heap->lock);
+	moved = __nvmap_heap_compact(heap, ~0, true, NVMAP_HEAP_COMPACT_STEP);
+	heap->compact_moved += moved;
+	heap->compact_steps++;
+	heap->compact_time_us += ktime_us_delta(ktime_get(), start);
+	mutex_unlock(&heap->lock);
+
+	if (moved == NVMAP_HEAP_COMPACT_STEP && nvmap_heap_fragmented(heap))
+		queue_delayed_work(system_freezable_wq, &heap->compact_work, 1);
+}
+
+static void nvmap_heap_compact_kick(struct nvmap_heap *heap)
+{
+	if (delayed_work_pending(&heap->compact_work) ||
+	    !nvmap_heap_fragmented(heap))
+		return;
+
+	queue_delayed_work(system_freezable_wq, &heap->compact_work,
+			   msecs_to_jiffies(NVMAP_HEAP_COMPACT_DELAY_MS));
+}
 #endif
 
 void nvmap_usecount_inc(struct nvmap_handle *h)
@@ -934,6 +1119,14 @@ void nvmap_heap_free(struct nvmap_heap_block *b)
 	else {
 		lb = container_of(b, struct list_block, block);
 		nvmap_flush_heap_block(NULL, b, lb->size, lb->mem_prot);
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+		if (h->cma) {
+			phys_addr_t start, end;
+
+			list_block_range(lb, &start, &end);
+			heap_cma_release(h, start, end);
+		}
+#endif
 		do_heap_free(b);
 	}
 
@@ -944,6 +1137,10 @@ void nvmap_heap_free(struct nvmap_heap_block *b)
 		kmem_cache_free(buddy_heap_cache, bh);
 	} else
 		mutex_unlock(&h->lock);
+
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	nvmap_heap_compact_kick(h);
+#endif
 }
 
 
@@ -951,6 +1148,27 @@ static void heap_release(struct device *heap)
 {
 }
 
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+/* a heap is CMA backed when all of it is in MIGRATE_CMA pageblocks, i.e.
+ * the platform declared it with dma_declare_contiguous() */
+static bool heap_in_cma(phys_addr_t base, size_t len)
+{
+	unsigned long pfn = __phys_to_pfn(base);
+	unsigned long end = __phys_to_pfn(base + len);
+
+	if (!IS_ALIGNED(pfn, pageblock_nr_pages) ||
+	    !IS_ALIGNED(end, pageblock_nr_pages))
+		return false;
+
+	for (; pfn < end; pfn += pageblock_nr_pages) {
+		if (!pfn_valid(pfn) ||
+		    !is_migrate_cma(get_pageblock_migratetype(pfn_to_page(pfn))))
+			return false;
+	}
+	return true;
+}
+#endif
+
 /* nvmap_heap_create: create a heap object of len bytes, starting from
  * address base.
  *
@@ -1029,6 +1247,15 @@ struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 	INIT_LIST_HEAD(&h->buddy_list);
 	INIT_LIST_HEAD(&h->all_list);
 	mutex_init(&h->lock);
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	INIT_DELAYED_WORK(&h->compact_work, nvmap_heap_compact_work);
+	h->compact_threshold = NVMAP_HEAP_COMPACT_FRAG_PCT;
+#endif
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	h->cma = heap_in_cma(base, len);
+	if (h->cma)
+		dev_info(parent, "%s: backed by CMA\n", name);
+#endif
 	l->block.base = base;
 	l->block.type = BLOCK_EMPTY;
 	l->size = len;
@@ -1066,6 +1293,10 @@ void nvmap_heap_destroy(struct nvmap_heap *heap)
 {
 	WARN_ON(!list_empty(&heap->buddy_list));
 
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	cancel_delayed_work_sync(&heap->compact_work);
+#endif
+
 	sysfs_remove_group(&heap->dev.kobj, &heap_stat_attr_group);
 	device_unregister(&heap->dev);
 
@@ -1104,6 +1335,36 @@ void nvmap_heap_remove_group(struct nvmap_heap *heap,
 	sysfs_remove_group(&heap->dev.kobj, grp);
 }
 
+/* nvmap_heap_debugfs_init: adds the heap's compaction knobs and counters
+ * to the heap's debugfs directory */
+void nvmap_heap_debugfs_init(struct nvmap_heap *heap, struct dentry *root)
+{
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	debugfs_create_u32("compact_threshold", S_IRUGO | S_IWUSR, root,
+			   &heap->compact_threshold);
+	debugfs_create_u32("compact_blocks_moved", S_IRUGO, root,
+			   &heap->compact_moved);
+	debugfs_create_u32("compact_steps", S_IRUGO, root,
+			   &heap->compact_steps);
+	debugfs_create_u64("compact_time_us", S_IRUGO, root,
+			   &heap->compact_time_us);
+#endif
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	if (!heap->cma)
+		return;
+	debugfs_create_u64("cma_claimed", S_IRUGO, root,
+			   &heap->cma_claimed);
+	debugfs_create_u32("cma_claims", S_IRUGO, root,
+			   &heap->cma_claims);
+	debugfs_create_u32("cma_claim_failures", S_IRUGO, root,
+			   &heap->cma_claim_failures);
+	debugfs_create_u64("cma_claim_time_us", S_IRUGO, root,
+			   &heap->cma_claim_time_us);
+	debugfs_create_u64("cma_claim_max_us", S_IRUGO, root,
+			   &heap->cma_claim_max_us);
+#endif
+}
+
 int nvmap_heap_init(void)
 {
 	BUG_ON(buddy_heap_cache != NULL);
@@ -24,6 +24,7 @@
 #define __NVMAP_HEAP_H
 
 struct device;
+struct dentry;
 struct nvmap_heap;
 struct attribute_group;
 
@@ -58,6 +59,8 @@ int nvmap_heap_create_group(struct nvmap_heap *heap,
 void nvmap_heap_remove_group(struct nvmap_heap *heap,
 			     const struct attribute_group *grp);
 
+void nvmap_heap_debugfs_init(struct nvmap_heap *heap, struct dentry *root);
+
 int __init nvmap_heap_init(void);
 
 void nvmap_heap_deinit(void);
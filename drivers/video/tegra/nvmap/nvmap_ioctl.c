@@ -24,6 +24,7 @@
 #include <linux/fs.h>
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/uaccess.h>
 #include <linux/nvmap.h>
 
@@ -46,6 +47,8 @@
 
 #define FLUSH_ALL_HANDLES		0
 
+#define CACHE_MAINT_LIST_MAX		256
+
 static ssize_t rw_handle(struct nvmap_client *client, struct nvmap_handle *h,
 			 int is_read, unsigned long h_offs,
 			 unsigned long sys_addr, unsigned long h_stride,
@@ -65,6 +68,7 @@ int nvmap_ioctl_pinop(struct file *filp, bool is_pin, void __user *arg)
 	unsigned long __user *output;
 	unsigned int i;
 	int err = 0;
+	ktime_t lat_start = nvmap_lat_start();
 
 	if (copy_from_user(&op, arg, sizeof(op)))
 		return -EFAULT;
@@ -137,6 +141,9 @@ out:
 	if (refs != on_stack)
 		kfree(refs);
 
+	if (is_pin)
+		nvmap_lat_record(filp->private_data, NULL, NVMAP_LAT_PIN,
+				 lat_start);
 	return err;
 }
 
@@ -235,6 +242,7 @@ int nvmap_map_into_caller_ptr(struct file *filp, void __user *arg)
 	struct nvmap_handle *h = NULL;
 	unsigned int cache_flags;
 	int err = 0;
+	ktime_t lat_start = nvmap_lat_start();
 
 	if (copy_from_user(&op, arg, sizeof(op)))
 		return -EFAULT;
@@ -331,10 +339,14 @@ int nvmap_map_into_caller_ptr(struct file *filp, void __user *arg)
 		}
 	}
 	vma->vm_page_prot = nvmap_pgprot(h, vma->vm_page_prot);
+	nvmap_vma_prefault(vma, !!(op.flags & NVMAP_HANDLE_PREFAULT));
 
 out:
 	up_read(&current->mm->mmap_sem);
 
+	if (nvmap_lat_enabled())
+		__nvmap_lat_record(client, nvmap_lat_heap_hist(h),
+				   NVMAP_LAT_MAP, lat_start);
 	if (err)
 		nvmap_handle_put(h);
 	return err;
@@ -789,22 +801,46 @@ out:
 	return;
 }
 
-int nvmap_find_cache_maint_op(struct nvmap_device *dev,
-		struct nvmap_handle *h) {
-	struct nvmap_deferred_ops *deferred_ops =
-			nvmap_get_deferred_ops_from_dev(dev);
-	struct cache_maint_op *cache_op = NULL;
-	spin_lock(&deferred_ops->deferred_ops_lock);
-	list_for_each_entry(cache_op, &deferred_ops->ops_list, list_data) {
-		if (cache_op->h == h) {
-			spin_unlock(&deferred_ops->deferred_ops_lock);
-			return true;
-		}
+static void cache_maint_op_free(struct cache_maint_op *cache_op)
+{
+	atomic_dec(&cache_op->h->maint_pending);
+	nvmap_handle_put(cache_op->h);
+	kfree(cache_op);
+}
+
+/* tries to fold a new deferred op into one already queued for the same
+ * handle. overlapping or adjacent ranges become one op covering both,
+ * and a clean merged with a clean+invalidate is upgraded to the latter;
+ * this is what keeps a CPU producer and a GPU consumer from cleaning the
+ * same buffer twice. caller holds deferred_ops_lock */
+static bool cache_maint_op_merge_locked(struct nvmap_deferred_ops *ops,
+					struct nvmap_handle *h,
+					unsigned long start, unsigned long end,
+					unsigned int op)
+{
+	struct cache_maint_op *cache_op;
+
+	list_for_each_entry(cache_op, &ops->ops_list, list_data) {
+		if (cache_op->h != h)
+			continue;
+		if (start > cache_op->end || end < cache_op->start)
+			continue;
+
+		cache_op->start = min_t(phys_addr_t, cache_op->start, start);
+		cache_op->end = max_t(phys_addr_t, cache_op->end, end);
+		if (op == NVMAP_CACHE_OP_WB_INV)
+			cache_op->op = op;
+		ops->deferred_maint_merged++;
+		return true;
 	}
-	spin_unlock(&deferred_ops->deferred_ops_lock);
 	return false;
 }
 
+int nvmap_find_cache_maint_op(struct nvmap_device *dev,
+		struct nvmap_handle *h) {
+	return atomic_read(&h->maint_pending) != 0;
+}
+
 void nvmap_cache_maint_ops_flush(struct nvmap_device *dev,
 		struct nvmap_handle *h) {
 
@@ -891,8 +927,7 @@ void nvmap_cache_maint_ops_flush(struct nvmap_device *dev,
 		list_for_each_entry_safe(cache_op, temp,
 				&flushed_ops, list_data) {
 			list_del(&cache_op->list_data);
-			nvmap_handle_put(cache_op->h);
-			kfree(cache_op);
+			cache_maint_op_free(cache_op);
 		}
 	} else if (flush_size_inner > cache_maint_inner_threshold) {
 		/* Flush only inner-cached entries */
@@ -901,8 +936,7 @@ void nvmap_cache_maint_ops_flush(struct nvmap_device *dev,
 		list_for_each_entry_safe(cache_op, temp,
 				&flushed_ops, list_data) {
 			list_del(&cache_op->list_data);
-			nvmap_handle_put(cache_op->h);
-			kfree(cache_op);
+			cache_maint_op_free(cache_op);
 		}
 	}
 #endif
@@ -926,11 +960,18 @@ void nvmap_cache_maint_ops_flush(struct nvmap_device *dev,
 				cache_op->h->flags);
 
 		list_del(&cache_op->list_data);
-		nvmap_handle_put(cache_op->h);
-		kfree(cache_op);
+		cache_maint_op_free(cache_op);
 	}
 }
 
+static inline void cache_maint_lat(struct nvmap_client *client,
+				   struct nvmap_handle *h, ktime_t start)
+{
+	if (nvmap_lat_enabled())
+		__nvmap_lat_record(client, nvmap_lat_heap_hist(h),
+				   NVMAP_LAT_CACHE, start);
+}
+
 static int cache_maint(struct nvmap_client *client,
 			struct nvmap_handle *h,
 			unsigned long start, unsigned long end,
@@ -941,11 +982,25 @@ static int cache_maint(struct nvmap_client *client,
 		nvmap_get_deferred_ops_from_dev(client->dev);
 	bool inner_maint = false;
 	bool outer_maint = false;
+	struct cache_maint_op cache_op;
+	ktime_t lat_start = nvmap_lat_start();
 
 	h = nvmap_handle_get(h);
 	if (!h)
 		return -EFAULT;
 
+	/* uncached and write-combined handles never hold dirty lines, so
+	 * there is nothing to clean, invalidate or defer */
+	if (h->flags == NVMAP_HANDLE_UNCACHEABLE ||
+	    h->flags == NVMAP_HANDLE_WRITE_COMBINE) {
+		spin_lock(&deferred_ops->deferred_ops_lock);
+		deferred_ops->deferred_maint_skipped++;
+		spin_unlock(&deferred_ops->deferred_ops_lock);
+		cache_maint_lat(client, h, lat_start);
+		nvmap_handle_put(h);
+		return 0;
+	}
+
 	/* count requested flush ops */
 	if (op == NVMAP_CACHE_OP_WB_INV) {
 		spin_lock(&deferred_ops->deferred_ops_lock);
@@ -970,7 +1025,9 @@ static int cache_maint(struct nvmap_client *client,
 		mutex_unlock(&share->pin_lock);
 	}
 
-	if (op == NVMAP_CACHE_OP_WB_INV &&
+	/* cleans are deferred too: both they and clean+invalidate are
+	 * flushed lazily when the handle is next pinned or mapped */
+	if ((op == NVMAP_CACHE_OP_WB_INV || op == NVMAP_CACHE_OP_WB) &&
 			(inner_maint || outer_maint) &&
 			allow_deferred == CACHE_MAINT_ALLOW_DEFERRED &&
 			atomic_read(&h->pin) == 0 &&
@@ -978,43 +1035,286 @@ static int cache_maint(struct nvmap_client *client,
 
 		struct cache_maint_op *cache_op;
 
-		cache_op = (struct cache_maint_op *)
-				kmalloc(sizeof(struct cache_maint_op),
-					GFP_KERNEL);
-		cache_op->h = h;
-		cache_op->start = start;
-		cache_op->end = end;
-		cache_op->op = op;
-		cache_op->inner = inner_maint;
-		cache_op->outer = outer_maint;
-
 		spin_lock(&deferred_ops->deferred_ops_lock);
+		if (cache_maint_op_merge_locked(deferred_ops, h,
+						start, end, op)) {
+			spin_unlock(&deferred_ops->deferred_ops_lock);
+			cache_maint_lat(client, h, lat_start);
+			nvmap_handle_put(h);
+			return 0;
+		}
+		spin_unlock(&deferred_ops->deferred_ops_lock);
+
+		/* fall back to doing the maintenance right away */
+		cache_op = kmalloc(sizeof(struct cache_maint_op), GFP_KERNEL);
+		if (cache_op) {
+			cache_op->h = h;
+			cache_op->start = start;
+			cache_op->end = end;
+			cache_op->op = op;
+			cache_op->inner = inner_maint;
+			cache_op->outer = outer_maint;
+
+			/* the queued op owns our reference from here on */
+			cache_maint_lat(client, h, lat_start);
+			atomic_inc(&h->maint_pending);
+			spin_lock(&deferred_ops->deferred_ops_lock);
 			list_add_tail(&cache_op->list_data,
 				&deferred_ops->ops_list);
+			spin_unlock(&deferred_ops->deferred_ops_lock);
+			return 0;
+		}
+	}
+
+	cache_op.h = h;
+	cache_op.start = start;
+	cache_op.end = end;
+	cache_op.op = op;
+	cache_op.inner = inner_maint;
+	cache_op.outer = outer_maint;
+
+	cache_maint_work_funct(&cache_op);
+
+	if (op == NVMAP_CACHE_OP_WB_INV) {
+		spin_lock(&deferred_ops->deferred_ops_lock);
+		debug_count_flushed_op(deferred_ops,
+			end - start, h->flags);
 		spin_unlock(&deferred_ops->deferred_ops_lock);
-	} else {
-		struct cache_maint_op cache_op;
+	}
+
+	err = cache_op.error;
+	cache_maint_lat(client, h, lat_start);
+	nvmap_handle_put(h);
+	return 0;
+}
+
+struct cache_list_op {
+	struct nvmap_handle *h;
+	unsigned long start;
+	unsigned long end;
+	unsigned int op;
+};
 
-		cache_op.h = h;
-		cache_op.start = start;
-		cache_op.end = end;
-		cache_op.op = op;
-		cache_op.inner = inner_maint;
-		cache_op.outer = outer_maint;
+static int cache_list_op_cmp(const void *a, const void *b)
+{
+	const struct cache_list_op *x = a;
+	const struct cache_list_op *y = b;
+
+	if (x->h != y->h)
+		return x->h < y->h ? -1 : 1;
+	if (x->op != y->op)
+		return x->op < y->op ? -1 : 1;
+	if (x->start != y->start)
+		return x->start < y->start ? -1 : 1;
+	return 0;
+}
 
-		cache_maint_work_funct(&cache_op);
+/* sorts the list by handle, op and offset, and folds overlapping or
+ * adjacent ranges of the same op on the same handle into one entry.
+ * returns the new number of entries. */
+static unsigned int cache_list_merge(struct cache_list_op *ops,
+				     unsigned int nr)
+{
+	unsigned int i, j = 0;
 
-		if (op == NVMAP_CACHE_OP_WB_INV) {
+	sort(ops, nr, sizeof(*ops), cache_list_op_cmp, NULL);
+
+	for (i = 1; i < nr; i++) {
+		if (ops[i].h == ops[j].h && ops[i].op == ops[j].op &&
+		    ops[i].start <= ops[j].end) {
+			ops[j].end = max(ops[j].end, ops[i].end);
+			nvmap_handle_put(ops[i].h);
+		} else {
+			ops[++j] = ops[i];
+		}
+	}
+	return j + 1;
+}
+
+static void cache_list_outer_maint(struct cache_list_op *c)
+{
+	struct nvmap_handle *h = c->h;
+
+	if (h->heap_pgalloc) {
+		heap_page_cache_maint(h, c->start, c->end, c->op,
+				      false, true, NULL, 0, 0);
+		return;
+	}
+
+	/* lock carveout from relocation by mapcount */
+	nvmap_usecount_inc(h);
+	outer_cache_maint(c->op, h->carveout->base + c->start,
+			  c->end - c->start);
+	nvmap_usecount_dec(h);
+}
+
+static int cache_maint_list(struct nvmap_client *client,
+			    struct cache_list_op *ops, unsigned int nr)
+{
+	struct nvmap_deferred_ops *deferred_ops =
+		nvmap_get_deferred_ops_from_dev(client->dev);
+	size_t inner_size = 0;
+	size_t outer_size = 0;
+	bool have_inv = false;
+	bool have_wb_inv = false;
+	bool inner_done = false;
+	bool outer_done = false;
+	unsigned int i;
+	int err = 0;
+
+	for (i = 0; i < nr; i++) {
+		struct nvmap_handle *h = ops[i].h;
+		size_t len = ops[i].end - ops[i].start;
+
+		if (ops[i].op == NVMAP_CACHE_OP_INV) {
+			have_inv = true;
+			/* Finish deferred maintenance before invalidating */
+			if (nvmap_find_cache_maint_op(h->dev, h)) {
+				struct nvmap_share *share =
+					nvmap_get_share_from_dev(h->dev);
+				mutex_lock(&share->pin_lock);
+				nvmap_cache_maint_ops_flush(h->dev, h);
+				mutex_unlock(&share->pin_lock);
+			}
+		} else if (ops[i].op == NVMAP_CACHE_OP_WB_INV) {
+			have_wb_inv = true;
+			spin_lock(&deferred_ops->deferred_ops_lock);
+			debug_count_requested_op(deferred_ops, len, h->flags);
+			spin_unlock(&deferred_ops->deferred_ops_lock);
+		}
+
+		if (h->flags == NVMAP_HANDLE_CACHEABLE ||
+		    h->flags == NVMAP_HANDLE_INNER_CACHEABLE)
+			inner_size += len;
+#ifdef CONFIG_OUTER_CACHE
+		if (h->flags == NVMAP_HANDLE_CACHEABLE)
+			outer_size += len;
+#endif
+	}
+
+#ifdef CONFIG_NVMAP_CACHE_MAINT_BY_SET_WAYS
+	/* decide once for the whole list whether walking the whole cache
+	 * by set/way is cheaper than maintaining each range. set/way
+	 * maintenance can't invalidate without writing back, so lists which
+	 * invalidate always go by range, as in fast_cache_maint(). */
+	if (!have_inv && inner_size >= cache_maint_inner_threshold) {
+		unsigned int op = have_wb_inv ? NVMAP_CACHE_OP_WB_INV :
+						NVMAP_CACHE_OP_WB;
+
+		if (have_wb_inv)
+			inner_flush_cache_all();
+		else
+			inner_clean_cache_all();
+		inner_done = true;
+
+		if (outer_size)
+			outer_done = fast_cache_maint_outer(0, outer_size, op);
+	}
+#endif
+
+	for (i = 0; i < nr; i++) {
+		struct cache_list_op *c = &ops[i];
+		struct nvmap_handle *h = c->h;
+
+		if (h->flags == NVMAP_HANDLE_UNCACHEABLE ||
+		    h->flags == NVMAP_HANDLE_WRITE_COMBINE ||
+		    c->start == c->end)
+			continue;
+
+		if (!inner_done) {
+			struct cache_maint_op cache_op;
+
+			cache_op.h = h;
+			cache_op.start = c->start;
+			cache_op.end = c->end;
+			cache_op.op = c->op;
+			cache_op.error = 0;
+			cache_maint_work_funct(&cache_op);
+			if (cache_op.error)
+				err = cache_op.error;
+		} else {
+			trace_cache_maint(client, h, c->start, c->end, c->op);
+			if (!outer_done &&
+			    h->flags != NVMAP_HANDLE_INNER_CACHEABLE)
+				cache_list_outer_maint(c);
+		}
+
+		if (c->op == NVMAP_CACHE_OP_WB_INV) {
 			spin_lock(&deferred_ops->deferred_ops_lock);
 			debug_count_flushed_op(deferred_ops,
-				end - start, h->flags);
+				c->end - c->start, h->flags);
 			spin_unlock(&deferred_ops->deferred_ops_lock);
 		}
+	}
 
-		err = cache_op.error;
-		nvmap_handle_put(h);
+	/* the per-range paths leave ordering to the caller */
+	outer_sync();
+	wmb();
+	return err;
+}
+
+int nvmap_ioctl_cache_maint_list(struct file *filp, void __user *arg)
+{
+	struct nvmap_client *client = filp->private_data;
+	struct nvmap_cache_list list;
+	struct nvmap_cache_op_entry entry;
+	struct nvmap_cache_op_entry __user *uentry;
+	struct cache_list_op *ops;
+	struct nvmap_handle *h;
+	unsigned int i, nr = 0;
+	int err = 0;
+
+	if (copy_from_user(&list, arg, sizeof(list)))
+		return -EFAULT;
+
+	if (!list.nr)
+		return 0;
+
+	if (!list.ops || list.nr > CACHE_MAINT_LIST_MAX)
+		return -EINVAL;
+
+	ops = kcalloc(list.nr, sizeof(*ops), GFP_KERNEL);
+	if (!ops)
+		return -ENOMEM;
+
+	uentry = (struct nvmap_cache_op_entry __user *)list.ops;
+	for (i = 0; i < list.nr; i++) {
+		if (copy_from_user(&entry, &uentry[i], sizeof(entry))) {
+			err = -EFAULT;
+			goto out;
+		}
+
+		if (!entry.handle || entry.op < NVMAP_CACHE_OP_WB ||
+		    entry.op > NVMAP_CACHE_OP_WB_INV) {
+			err = -EINVAL;
+			goto out;
+		}
+
+		h = nvmap_get_handle_id(client, entry.handle);
+		if (!h) {
+			err = -EPERM;
+			goto out;
+		}
+		ops[nr++].h = h;
+
+		if (!h->alloc || entry.offset > h->size ||
+		    entry.len > h->size - entry.offset) {
+			err = -EINVAL;
+			goto out;
+		}
+
+		ops[i].start = entry.offset;
+		ops[i].end = entry.offset + entry.len;
+		ops[i].op = entry.op;
 	}
-	return 0;
+
+	nr = cache_list_merge(ops, nr);
+	err = cache_maint_list(client, ops, nr);
+out:
+	for (i = 0; i < nr; i++)
+		nvmap_handle_put(ops[i].h);
+	kfree(ops);
+	return err;
 }
 
 static int rw_handle_page(struct nvmap_handle *h, int is_read,
@@ -20,8 +20,10 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <linux/jiffies.h>
 #include <linux/list.h>
 #include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include <asm/pgtable.h>
 
@@ -31,30 +33,26 @@
 #include "nvmap_mru.h"
 
 /* if IOVMM reclamation is enabled (CONFIG_NVMAP_RECLAIM_UNPINNED_VM),
- * unpinned handles are placed onto a most-recently-used eviction list;
- * multiple lists are maintained, segmented by size (sizes were chosen to
- * roughly correspond with common sizes for graphics surfaces).
+ * unpinned handles keep their IOVMM area and are placed at the tail of a
+ * least-recently-used list.
  *
- * if a handle is located on the MRU list, then the code below may
+ * if a handle is located on the LRU list, then the code below may
  * steal its IOVMM area at any time to satisfy a pin operation if no
- * free IOVMM space is available
+ * free IOVMM space is available. victims are picked among the
+ * LRU_SCAN coldest entries, preferring the handle that has been
+ * remapped the fewest times: handles that keep getting pinned again
+ * after losing their area are the expensive ones to evict.
+ *
+ * a background worker also evicts areas which have been unpinned for
+ * more than LRU_COLD_MS once the largest free IOVMM block drops below a
+ * quarter of the usable IOVMM space, so that pins rarely have to evict
+ * synchronously.
  */
 
-static const size_t mru_cutoff[] = {
-	262144, 393216, 786432, 1048576, 1572864
-};
-
-static inline struct list_head *mru_list(struct nvmap_share *share, size_t size)
-{
-	unsigned int i;
-
-	BUG_ON(!share->mru_lists);
-	for (i = 0; i < ARRAY_SIZE(mru_cutoff); i++)
-		if (size <= mru_cutoff[i])
-			break;
-
-	return &share->mru_lists[i];
-}
+#define LRU_SCAN		8
+#define LRU_COLD_MS		2000
+#define LRU_WORK_DELAY_MS	100
+#define LRU_SHRINK_BATCH	16
 
 size_t nvmap_mru_vm_size(struct tegra_iovmm_client *iovmm)
 {
@@ -62,11 +60,21 @@ size_t nvmap_mru_vm_size(struct tegra_iovmm_client *iovmm)
 	return (vm_size >> 2) * 3;
 }
 
+static bool lru_low_on_space(struct nvmap_share *share)
+{
+	return tegra_iovmm_get_max_free(share->iovmm) <
+		nvmap_mru_vm_size(share->iovmm) / 4;
+}
+
 /*  nvmap_mru_vma_lock should be acquired by the caller before calling this */
 void nvmap_mru_insert_locked(struct nvmap_share *share, struct nvmap_handle *h)
 {
-	size_t len = h->pgalloc.area->iovm_length;
-	list_add(&h->pgalloc.mru_list, mru_list(share, len));
+	h->pgalloc.lru_time = jiffies;
+	list_add_tail(&h->pgalloc.mru_list, &share->mru_list);
+
+	if (!delayed_work_pending(&share->mru_work))
+		schedule_delayed_work(&share->mru_work,
+				      msecs_to_jiffies(LRU_WORK_DELAY_MS));
 }
 
 void nvmap_mru_remove(struct nvmap_share *s, struct nvmap_handle *h)
@@ -78,29 +86,64 @@ void nvmap_mru_remove(struct nvmap_share *s, struct nvmap_handle *h)
 	INIT_LIST_HEAD(&h->pgalloc.mru_list);
 }
 
+/* picks the cheapest victim among the coldest LRU_SCAN handles whose area
+ * length is within [min, max]; must be called with the mru lock held. */
+static struct nvmap_handle *lru_pick_victim(struct nvmap_share *share,
+					    size_t min, size_t max)
+{
+	struct nvmap_handle *h, *victim = NULL;
+	unsigned int scanned = 0;
+
+	list_for_each_entry(h, &share->mru_list, pgalloc.mru_list) {
+		size_t len = h->pgalloc.area->iovm_length;
+
+		if (scanned++ == LRU_SCAN)
+			break;
+		if (len < min || len > max)
+			continue;
+		if (!victim || h->pgalloc.remaps < victim->pgalloc.remaps)
+			victim = h;
+	}
+	return victim;
+}
+
+/* takes the IOVMM area away from an unpinned handle and returns it. */
+static struct tegra_iovmm_area *lru_evict_locked(struct nvmap_handle *h)
+{
+	struct tegra_iovmm_area *vm = h->pgalloc.area;
+
+	BUG_ON(atomic_read(&h->pin) != 0);
+	BUG_ON(!vm);
+	list_del(&h->pgalloc.mru_list);
+	INIT_LIST_HEAD(&h->pgalloc.mru_list);
+	h->pgalloc.area = NULL;
+	h->pgalloc.evicted = true;
+	return vm;
+}
+
 /* returns a tegra_iovmm_area for a handle. if the handle already has
- * an iovmm_area allocated, the handle is simply removed from its MRU list
+ * an iovmm_area allocated, the handle is simply removed from the LRU list
  * and the existing iovmm_area is returned.
  *
  * if no existing allocation exists, try to allocate a new IOVMM area.
  *
- * if a new area can not be allocated, try to re-use the most-recently-unpinned
- * handle's allocation.
+ * if a new area can not be allocated, try to re-use the area of a cold
+ * handle of about the same size.
  *
- * and if that fails, iteratively evict handles from the MRU lists and free
+ * and if that fails, iteratively evict handles from the LRU list and free
  * their allocations, until the new allocation succeeds.
  */
 struct tegra_iovmm_area *nvmap_handle_iovmm_locked(struct nvmap_client *c,
 					    struct nvmap_handle *h)
 {
-	struct list_head *mru;
-	struct nvmap_handle *evict = NULL;
+	struct nvmap_share *share;
+	struct nvmap_handle *evict;
 	struct tegra_iovmm_area *vm = NULL;
-	unsigned int i, idx;
 	pgprot_t prot;
 
 	BUG_ON(!h || !c || !c->share);
 
+	share = c->share;
 	prot = nvmap_pgprot(h, pgprot_kernel);
 
 	if (h->pgalloc.area) {
@@ -110,78 +153,94 @@ struct tegra_iovmm_area *nvmap_handle_iovmm_locked(struct nvmap_client *c,
 		return h->pgalloc.area;
 	}
 
-	vm = tegra_iovmm_create_vm(c->share->iovmm, NULL,
+	vm = tegra_iovmm_create_vm(share->iovmm, NULL,
 			h->size, h->align, prot,
 			h->pgalloc.iovm_addr);
 
 	if (vm) {
 		INIT_LIST_HEAD(&h->pgalloc.mru_list);
-		return vm;
+		goto out;
 	}
 	/* if client is looking for specific iovm address, return from here. */
 	if ((vm == NULL) && (h->pgalloc.iovm_addr != 0))
 		return NULL;
-	/* attempt to re-use the most recently unpinned IOVMM area in the
-	 * same size bin as the current handle. If that fails, iteratively
-	 * evict handles (starting from the current bin) until an allocation
-	 * succeeds or no more areas can be evicted */
-	mru = mru_list(c->share, h->size);
-	if (!list_empty(mru))
-		evict = list_first_entry(mru, struct nvmap_handle,
-					 pgalloc.mru_list);
-
-	if (evict && evict->pgalloc.area->iovm_length >= h->size) {
-		list_del(&evict->pgalloc.mru_list);
-		vm = evict->pgalloc.area;
-		evict->pgalloc.area = NULL;
-		INIT_LIST_HEAD(&evict->pgalloc.mru_list);
-		return vm;
+
+	/* attempt to re-use a cold IOVMM area which is big enough, but not
+	 * wastefully so. If that fails, iteratively evict handles until an
+	 * allocation succeeds or no more areas can be evicted */
+	evict = lru_pick_victim(share, h->size, h->size * 2);
+	if (evict) {
+		vm = lru_evict_locked(evict);
+		atomic_inc(&c->iovm_evictions);
+		goto out;
+	}
+
+	while (!vm && !list_empty(&share->mru_list)) {
+		evict = lru_pick_victim(share, 0, ~0);
+		tegra_iovmm_free_vm(lru_evict_locked(evict));
+		atomic_inc(&c->iovm_evictions);
+		vm = tegra_iovmm_create_vm(share->iovmm,
+				NULL, h->size, h->align,
+				prot, h->pgalloc.iovm_addr);
 	}
 
-	idx = mru - c->share->mru_lists;
-
-	for (i = 0; i < c->share->nr_mru && !vm; i++, idx++) {
-		if (idx >= c->share->nr_mru)
-			idx = 0;
-		mru = &c->share->mru_lists[idx];
-		while (!list_empty(mru) && !vm) {
-			evict = list_first_entry(mru, struct nvmap_handle,
-						 pgalloc.mru_list);
-
-			BUG_ON(atomic_read(&evict->pin) != 0);
-			BUG_ON(!evict->pgalloc.area);
-			list_del(&evict->pgalloc.mru_list);
-			INIT_LIST_HEAD(&evict->pgalloc.mru_list);
-			tegra_iovmm_free_vm(evict->pgalloc.area);
-			evict->pgalloc.area = NULL;
-			vm = tegra_iovmm_create_vm(c->share->iovmm,
-					NULL, h->size, h->align,
-					prot, h->pgalloc.iovm_addr);
-		}
+out:
+	if (vm && h->pgalloc.evicted) {
+		h->pgalloc.evicted = false;
+		h->pgalloc.remaps++;
+		atomic_inc(&c->iovm_remaps);
 	}
 	return vm;
 }
 
-int nvmap_mru_init(struct nvmap_share *share)
+/* evicts up to nr_to_scan areas that have been unpinned for a while, as
+ * long as IOVMM space is short. returns the number of areas freed. */
+static int nvmap_mru_shrink(struct nvmap_share *share, int nr_to_scan)
 {
-	int i;
-	mutex_init(&share->mru_lock);
-	share->nr_mru = ARRAY_SIZE(mru_cutoff) + 1;
+	struct nvmap_handle *h;
+	int freed = 0;
+
+	nvmap_mru_lock(share);
+	while (freed < nr_to_scan && !list_empty(&share->mru_list) &&
+	       lru_low_on_space(share)) {
+		h = list_first_entry(&share->mru_list, struct nvmap_handle,
+				     pgalloc.mru_list);
+		if (time_before(jiffies, h->pgalloc.lru_time +
+				msecs_to_jiffies(LRU_COLD_MS)))
+			break;
+		tegra_iovmm_free_vm(lru_evict_locked(h));
+		freed++;
+	}
+	nvmap_mru_unlock(share);
 
-	share->mru_lists = kzalloc(sizeof(struct list_head) * share->nr_mru,
-				   GFP_KERNEL);
+	if (freed) {
+		atomic_add(freed, &share->mru_bg_evictions);
+		wake_up(&share->pin_wait);
+	}
+	return freed;
+}
 
-	if (!share->mru_lists)
-		return -ENOMEM;
+static void nvmap_mru_work(struct work_struct *work)
+{
+	struct nvmap_share *share = container_of(to_delayed_work(work),
+					struct nvmap_share, mru_work);
 
-	for (i = 0; i < share->nr_mru; i++)
-		INIT_LIST_HEAD(&share->mru_lists[i]);
+	if (nvmap_mru_shrink(share, LRU_SHRINK_BATCH) == LRU_SHRINK_BATCH ||
+	    (!list_empty(&share->mru_list) && lru_low_on_space(share)))
+		schedule_delayed_work(&share->mru_work,
+				      msecs_to_jiffies(LRU_WORK_DELAY_MS));
+}
 
+int nvmap_mru_init(struct nvmap_share *share)
+{
+	mutex_init(&share->mru_lock);
+	INIT_LIST_HEAD(&share->mru_list);
+	INIT_DELAYED_WORK(&share->mru_work, nvmap_mru_work);
+	atomic_set(&share->mru_bg_evictions, 0);
 	return 0;
 }
 
 void nvmap_mru_destroy(struct nvmap_share *share)
 {
-	kfree(share->mru_lists);
-	share->mru_lists = NULL;
+	cancel_delayed_work_sync(&share->mru_work);
 }
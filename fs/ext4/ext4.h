@@ -951,6 +951,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DIOREAD_NOLOCK	0x400000 /* Enable support for dio read nolocking */
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
+#define EXT4_MOUNT_FSYNC_BATCH		0x2000000 /* Batch concurrent fsyncs */
 #define EXT4_MOUNT_MBLK_IO_SUBMIT	0x4000000 /* multi-block io submits */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
@@ -1313,6 +1314,7 @@ enum {
 	EXT4_STATE_DIO_UNWRITTEN,	/* need convert on dio done*/
 	EXT4_STATE_NEWENTRY,		/* File just added to dir */
 	EXT4_STATE_DELALLOC_RESERVED,	/* blks already reserved for delalloc */
+	EXT4_STATE_DATA_UNFLUSHED,	/* data written since last cache flush */
 };
 
 #define EXT4_INODE_BIT_FNS(name, field, offset)				\
@@ -1327,6 +1329,12 @@ static inline void ext4_set_inode_##name(struct inode *inode, int bit)	\
 static inline void ext4_clear_inode_##name(struct inode *inode, int bit) \
 {									\
 	clear_bit(bit + (offset), &EXT4_I(inode)->i_##field);		\
+}									\
+static inline int ext4_test_and_clear_inode_##name(struct inode *inode,	\
+						   int bit)		\
+{									\
+	return test_and_clear_bit(bit + (offset),			\
+				  &EXT4_I(inode)->i_##field);		\
 }
 
 EXT4_INODE_BIT_FNS(flag, flags, 0)
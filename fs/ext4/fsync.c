@@ -213,14 +213,28 @@ int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 	int ret;
 	tid_t commit_tid;
 	bool needs_barrier = false;
+	bool whole = start == 0 && end == LLONG_MAX;
+	bool unflushed = true;
 
 	J_ASSERT(ext4_journal_current_handle() == NULL);
 
 	trace_ext4_sync_file_enter(file, datasync);
 
+	/*
+	 * Find out whether any data of the file reached the device since
+	 * the last cache flush made on its behalf: set before, or by the
+	 * writeback below. Only a whole file sync waits on all of that
+	 * data, so only it may take the mark down.
+	 */
+	if (whole)
+		unflushed = ext4_test_and_clear_inode_state(inode,
+						EXT4_STATE_DATA_UNFLUSHED);
 	ret = filemap_write_and_wait_range(inode->i_mapping, start, end);
+	if (whole && ext4_test_and_clear_inode_state(inode,
+						EXT4_STATE_DATA_UNFLUSHED))
+		unflushed = true;
 	if (ret)
-		return ret;
+		goto out_unflushed;
 	mutex_lock(&inode->i_mutex);
 
 	if (inode->i_sb->s_flags & MS_RDONLY)
@@ -256,16 +270,26 @@ int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 		goto out;
 	}
 
+	/*
+	 * The commit flushes the cache for its own blocks. A separate flush
+	 * is only needed for file data that reached the device but will not
+	 * be covered by the commit's flush; if no such data was written,
+	 * for instance because everything was synced and committed before,
+	 * there is nothing for the flush to make durable.
+	 */
 	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
-	if (journal->j_flags & JBD2_BARRIER &&
+	if (journal->j_flags & JBD2_BARRIER && unflushed &&
 	    !jbd2_trans_will_send_data_barrier(journal, commit_tid))
 		needs_barrier = true;
-	jbd2_log_start_commit(journal, commit_tid);
-	ret = jbd2_log_wait_commit(journal, commit_tid);
+	ret = jbd2_fsync_commit(journal, commit_tid);
 	if (needs_barrier)
 		blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL, NULL);
  out:
 	mutex_unlock(&inode->i_mutex);
+ out_unflushed:
+	/* the data is not known to be durable, flush for it next time */
+	if (ret && unflushed)
+		ext4_set_inode_state(inode, EXT4_STATE_DATA_UNFLUSHED);
 	trace_ext4_sync_file_exit(inode, ret);
 	return ret;
 }
@@ -1188,6 +1188,7 @@ enum {
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard, Opt_init_itable, Opt_noinit_itable,
+	Opt_fsync_batch, Opt_nofsync_batch,
 };
 
 static const match_table_t tokens = {
@@ -1261,6 +1262,8 @@ static const match_table_t tokens = {
 	{Opt_init_itable, "init_itable=%u"},
 	{Opt_init_itable, "init_itable"},
 	{Opt_noinit_itable, "noinit_itable"},
+	{Opt_fsync_batch, "fsync_batch"},
+	{Opt_nofsync_batch, "nofsync_batch"},
 	{Opt_removed, "check=none"},	/* mount option from ext2/3 */
 	{Opt_removed, "nocheck"},	/* mount option from ext2/3 */
 	{Opt_removed, "reservation"},	/* mount option from ext2/3 */
@@ -1402,6 +1405,8 @@ static const struct mount_opts {
 	{Opt_noauto_da_alloc, EXT4_MOUNT_NO_AUTO_DA_ALLOC, MOPT_SET},
 	{Opt_auto_da_alloc, EXT4_MOUNT_NO_AUTO_DA_ALLOC, MOPT_CLEAR},
 	{Opt_noinit_itable, EXT4_MOUNT_INIT_INODE_TABLE, MOPT_CLEAR},
+	{Opt_fsync_batch, EXT4_MOUNT_FSYNC_BATCH, MOPT_SET},
+	{Opt_nofsync_batch, EXT4_MOUNT_FSYNC_BATCH, MOPT_CLEAR},
 	{Opt_commit, 0, MOPT_GTE0},
 	{Opt_max_batch_time, 0, MOPT_GTE0},
 	{Opt_min_batch_time, 0, MOPT_GTE0},
@@ -3182,6 +3187,7 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 
 	if ((def_mount_opts & EXT4_DEFM_NOBARRIER) == 0)
 		set_opt(sb, BARRIER);
+	set_opt(sb, FSYNC_BATCH);
 
 	/*
 	 * enable delayed allocation by default
@@ -3878,6 +3884,10 @@ static void ext4_init_journal_params(struct super_block *sb, journal_t *journal)
 		journal->j_flags |= JBD2_ABORT_ON_SYNCDATA_ERR;
 	else
 		journal->j_flags &= ~JBD2_ABORT_ON_SYNCDATA_ERR;
+	if (test_opt(sb, FSYNC_BATCH))
+		journal->j_flags |= JBD2_FSYNC_BATCH;
+	else
+		journal->j_flags &= ~JBD2_FSYNC_BATCH;
 	write_unlock(&journal->j_state_lock);
 }
 
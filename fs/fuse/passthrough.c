@@ -0,0 +1,179 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+/*
+ * Passthrough reads and writes.
+ *
+ * A filesystem which only forwards data to files on another filesystem
+ * (the Android sdcard daemon is one) can answer OPEN or CREATE with
+ * FOPEN_PASSTHROUGH and one of its own file descriptors.  Reads and writes
+ * on the opened file then go straight to that lower file, without a round
+ * trip through the daemon.  Everything else (lookups, attributes, fsync,
+ * release, mmap) still goes through the daemon.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/fsnotify.h>
+#include <linux/pagemap.h>
+#include <linux/uio.h>
+
+/*
+ * Called from the daemon's write() of an OPEN or CREATE reply, so that
+ * passthrough_fd is looked up in the daemon's file table.  The lower file
+ * is held in the request until the opener takes it; if nobody does,
+ * fuse_put_request() drops it.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct inode *inode;
+	struct file *lower;
+
+	if (!fc->passthrough || req->out.h.error)
+		return;
+
+	if (req->in.h.opcode == FUSE_OPEN)
+		outarg = req->out.args[0].value;
+	else if (req->in.h.opcode == FUSE_CREATE)
+		outarg = req->out.args[1].value;
+	else
+		return;
+
+	if (!(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	lower = fget(outarg->passthrough_fd);
+	if (!lower)
+		return;
+
+	inode = lower->f_path.dentry->d_inode;
+	if (!S_ISREG(inode->i_mode) ||
+	    inode->i_sb->s_magic == FUSE_SUPER_MAGIC ||
+	    !lower->f_op || !lower->f_op->aio_read ||
+	    !lower->f_op->aio_write) {
+		fput(lower);
+		return;
+	}
+
+	req->passthrough_filp = lower;
+}
+
+/*
+ * The lower file must allow everything the fuse file was opened for,
+ * otherwise the file is served by the daemon as usual.
+ */
+void fuse_passthrough_open(struct file *file)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	fmode_t mode = file->f_mode & (FMODE_READ | FMODE_WRITE);
+
+	if (lower && (lower->f_mode & mode) != mode) {
+		ff->passthrough_filp = NULL;
+		fput(lower);
+	}
+}
+
+static ssize_t fuse_passthrough_rw(struct file *lower, int rw,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t *ppos)
+{
+	size_t count = iov_length(iov, nr_segs);
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = *ppos;
+	kiocb.ki_left = count;
+	kiocb.ki_nbytes = count;
+
+	if (rw == READ)
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, kiocb.ki_pos);
+	else
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, kiocb.ki_pos);
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+
+	*ppos = kiocb.ki_pos;
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	struct address_space *mapping = file->f_mapping;
+	size_t count = iov_length(iov, nr_segs);
+	ssize_t ret;
+
+	if (!count)
+		return 0;
+
+	/* dirty mmaped pages must reach the lower file first */
+	if (mapping->nrpages) {
+		ret = filemap_write_and_wait_range(mapping, pos,
+						   pos + count - 1);
+		if (ret)
+			return ret;
+	}
+
+	ret = fuse_passthrough_rw(lower, READ, iov, nr_segs, &pos);
+	if (ret > 0) {
+		iocb->ki_pos = pos;
+		fsnotify_access(lower);
+	}
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	size_t count = iov_length(iov, nr_segs);
+	ssize_t ret;
+
+	if (!count)
+		return 0;
+
+	mutex_lock(&inode->i_mutex);
+
+	if (file->f_flags & O_APPEND)
+		pos = i_size_read(lower->f_mapping->host);
+
+	if (mapping->nrpages) {
+		ret = filemap_write_and_wait_range(mapping, pos,
+						   pos + count - 1);
+		if (ret)
+			goto out;
+	}
+
+	ret = fuse_passthrough_rw(lower, WRITE, iov, nr_segs, &pos);
+	if (ret > 0) {
+		iocb->ki_pos = pos;
+		fuse_write_update_size(inode, pos);
+		/* the page cache copy of the range is now stale */
+		if (mapping->nrpages)
+			invalidate_inode_pages2_range(mapping,
+					(pos - ret) >> PAGE_CACHE_SHIFT,
+					(pos - 1) >> PAGE_CACHE_SHIFT);
+		fsnotify_modify(lower);
+	}
+out:
+	mutex_unlock(&inode->i_mutex);
+	fuse_invalidate_attr(inode);
+
+	return ret;
+}
@@ -1042,12 +1042,17 @@ restart_loop:
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
+	journal->j_stats.ts_commit_hist[
+		jbd2_hist_slot(stats.run.rs_blocks_logged)]++;
 	spin_unlock(&journal->j_history_lock);
 
 	commit_transaction->t_state = T_FINISHED;
 	J_ASSERT(commit_transaction == journal->j_committing_transaction);
 	journal->j_commit_sequence = commit_transaction->t_tid;
 	journal->j_committing_transaction = NULL;
+	if (atomic_read(&commit_transaction->t_fsync_count))
+		journal->j_fsync_last_count =
+			atomic_read(&commit_transaction->t_fsync_count);
 	commit_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
 
 	/*
@@ -41,6 +41,7 @@
 #include <linux/hash.h>
 #include <linux/log2.h>
 #include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
 #include <linux/backing-dev.h>
 #include <linux/bitops.h>
 #include <linux/ratelimit.h>
@@ -80,6 +81,7 @@ EXPORT_SYMBOL(jbd2_journal_errno);
 EXPORT_SYMBOL(jbd2_journal_ack_err);
 EXPORT_SYMBOL(jbd2_journal_clear_err);
 EXPORT_SYMBOL(jbd2_log_wait_commit);
+EXPORT_SYMBOL(jbd2_fsync_commit);
 EXPORT_SYMBOL(jbd2_log_start_commit);
 EXPORT_SYMBOL(jbd2_journal_start_commit);
 EXPORT_SYMBOL(jbd2_journal_force_commit_nested);
@@ -661,6 +663,66 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
 	return err;
 }
 
+/*
+ * Commit a transaction on behalf of fsync and wait for it.
+ *
+ * Without JBD2_FSYNC_BATCH this is jbd2_log_start_commit() followed by
+ * jbd2_log_wait_commit(). With it, the first fsync caller of the running
+ * transaction owns its commit and the others only wait for it. When the
+ * last fsync'ed commit was shared by several callers, the owner holds the
+ * commit back until the transaction is one average commit time old (the
+ * time it takes to write and flush a commit on this device, within
+ * j_min_batch_time and j_max_batch_time), so that concurrent fsyncs join
+ * the transaction instead of each forcing a commit and a cache flush of
+ * their own.
+ */
+int jbd2_fsync_commit(journal_t *journal, tid_t tid)
+{
+	transaction_t *transaction;
+	ktime_t start = ktime_get();
+	ktime_t expires = ktime_set(0, 0);
+	int owner = 1, err;
+	u64 us;
+
+	read_lock(&journal->j_state_lock);
+	transaction = journal->j_running_transaction;
+	if ((journal->j_flags & JBD2_FSYNC_BATCH) &&
+	    transaction && transaction->t_tid == tid) {
+		owner = atomic_inc_return(&transaction->t_fsync_count) == 1;
+		if (owner && journal->j_fsync_last_count > 1) {
+			u64 commit_time = journal->j_average_commit_time;
+
+			commit_time = max_t(u64, commit_time,
+					    1000*journal->j_min_batch_time);
+			commit_time = min_t(u64, commit_time,
+					    1000*journal->j_max_batch_time);
+			expires = ktime_add_ns(transaction->t_start_time,
+					       commit_time);
+		}
+	}
+	read_unlock(&journal->j_state_lock);
+
+	if (ktime_to_ns(expires) > ktime_to_ns(start)) {
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+	} else
+		expires = ktime_set(0, 0);
+
+	if (owner)
+		jbd2_log_start_commit(journal, tid);
+	err = jbd2_log_wait_commit(journal, tid);
+
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	spin_lock(&journal->j_history_lock);
+	journal->j_stats.ts_fsync++;
+	if (ktime_to_ns(expires))
+		journal->j_stats.ts_fsync_batched++;
+	journal->j_stats.ts_fsync_hist[jbd2_hist_slot(us)]++;
+	spin_unlock(&journal->j_history_lock);
+
+	return err;
+}
+
 /*
  * Log buffer allocation routines:
  */
@@ -852,6 +914,26 @@ static void *jbd2_seq_info_next(struct seq_file *seq, void *v, loff_t *pos)
 	return NULL;
 }
 
+static void jbd2_seq_hist_show(struct seq_file *seq, const char *name,
+			       unsigned long *hist)
+{
+	int i;
+
+	seq_printf(seq, "%s:\n", name);
+	for (i = 0; i < JBD2_HIST_SLOTS; i++) {
+		if (!hist[i])
+			continue;
+		if (i == 0)
+			seq_printf(seq, "  0: %lu\n", hist[i]);
+		else if (i == JBD2_HIST_SLOTS - 1)
+			seq_printf(seq, "  %lu+: %lu\n", 1UL << (i - 1),
+				   hist[i]);
+		else
+			seq_printf(seq, "  %lu-%lu: %lu\n", 1UL << (i - 1),
+				   (1UL << i) - 1, hist[i]);
+	}
+}
+
 static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 {
 	struct jbd2_stats_proc_session *s = seq->private;
@@ -881,6 +963,12 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	seq_printf(seq, "%lu fsync commits, %lu held back for batching\n",
+		   s->stats->ts_fsync, s->stats->ts_fsync_batched);
+	jbd2_seq_hist_show(seq, "logged blocks per transaction",
+			   s->stats->ts_commit_hist);
+	jbd2_seq_hist_show(seq, "fsync commit latency (us)",
+			   s->stats->ts_fsync_hist);
 	return 0;
 }
 
@@ -80,8 +80,10 @@ static inline int alarmtimer_callback_running(struct alarm *timer)
 /* Provide way to access the rtc device being used by alarmtimers */
 #ifdef CONFIG_RTC_CLASS
 struct rtc_device *alarmtimer_get_rtcdev(void);
+ktime_t alarmtimer_get_sleep_length(void);
 #else
 #define alarmtimer_get_rtcdev() (0)
+#define alarmtimer_get_sleep_length() (ktime_set(0, 0))
 #endif
 
 #endif
@@ -26,6 +26,11 @@ extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 extern int compact_pgdat(pg_data_t *pgdat, int order);
 extern unsigned long compaction_suitable(struct zone *zone, int order);
 
+extern int sysctl_compact_daemon_order;
+extern int sysctl_compact_daemon_blocks;
+extern int sysctl_compact_daemon_interval;
+extern void wakeup_kcompactd(int order);
+
 /* Do not skip compaction more than 64 times */
 #define COMPACT_MAX_DEFER_SHIFT 6
 
@@ -79,6 +84,10 @@ static inline unsigned long compaction_suitable(struct zone *zone, int order)
 	return COMPACT_SKIPPED;
 }
 
+static inline void wakeup_kcompactd(int order)
+{
+}
+
 static inline void defer_compaction(struct zone *zone, int order)
 {
 }
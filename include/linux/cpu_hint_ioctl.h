@@ -0,0 +1,47 @@
+/*
+ * include/linux/cpu_hint_ioctl.h
+ *
+ * ioctl declarations for the cpu demand hint miscdev
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __CPU_HINT_IOCTL_H
+#define __CPU_HINT_IOCTL_H
+
+#include <linux/ioctl.h>
+
+#define CPU_HINT_MAGIC 'h'
+
+/*
+ * "Keep at least @cpus cores online at @freq_khz or above for @time_ms."
+ * Both floors are optional (0). A hint replaces the previous hint of the
+ * same file descriptor; time_ms == 0 drops it. On return time_ms holds the
+ * duration actually granted, which may be shorter than asked for once the
+ * client has used up its budget.
+ */
+struct cpu_hint_args {
+	__u32 cpus;
+	__u32 freq_khz;
+	__u32 time_ms;
+};
+
+#define CPU_HINT_IOCTL_DEMAND \
+	_IOWR(CPU_HINT_MAGIC, 1, struct cpu_hint_args)
+#define CPU_HINT_IOCTL_MAXNR \
+	(_IOC_NR(CPU_HINT_IOCTL_DEMAND))
+
+#endif /* !defined(__CPU_HINT_IOCTL_H) */
@@ -232,6 +232,10 @@ struct cpufreq_driver {
 	unsigned int (*getavg)	(struct cpufreq_policy *policy,
 				 unsigned int cpu);
 	int	(*bios_limit)	(int cpu, unsigned int *limit);
+	/* compute capacity at freq, in kHz of the fastest core type */
+	unsigned int (*capacity)(unsigned int cpu, unsigned int freq);
+	/* memory bandwidth taken by cpu traffic, per mille */
+	unsigned int (*mem_load)(unsigned int cpu);
 
 	int	(*exit)		(struct cpufreq_policy *policy);
 	int	(*suspend)	(struct cpufreq_policy *policy);
@@ -338,6 +342,31 @@ static inline unsigned int cpufreq_quick_get_max(unsigned int cpu)
 }
 #endif
 
+#ifdef CONFIG_CPU_FREQ
+unsigned int cpufreq_freq_capacity(unsigned int cpu, unsigned int freq);
+unsigned int cpufreq_mem_load(unsigned int cpu);
+#else
+static inline unsigned int cpufreq_freq_capacity(unsigned int cpu,
+						 unsigned int freq)
+{
+	return freq;
+}
+static inline unsigned int cpufreq_mem_load(unsigned int cpu)
+{
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_CPU_FREQ_GOV_FRAMEDEADLINE
+void cpufreq_framedeadline_frame(unsigned int busy_us,
+				 unsigned int deadline_us);
+#else
+static inline void cpufreq_framedeadline_frame(unsigned int busy_us,
+					       unsigned int deadline_us)
+{
+}
+#endif
+
 
 /*********************************************************************
  *                       CPUFREQ DEFAULT GOVERNOR                    *
@@ -39,12 +39,16 @@ struct cpuquiet_driver {
 	char			name[CPUQUIET_NAME_LEN];
 	int (*quiesence_cpu)	(unsigned int cpunumber, bool sync);
 	int (*wake_cpu)		(unsigned int cpunumber, bool sync);
+	/* optional, temperature of a core in millicelsius */
+	int (*get_cpu_temp)	(unsigned int cpunumber, long *temp);
 };
 
 extern int cpuquiet_register_governor(struct cpuquiet_governor *gov);
 extern void cpuquiet_unregister_governor(struct cpuquiet_governor *gov);
 extern int cpuquiet_quiesence_cpu(unsigned int cpunumber, bool sync);
 extern int cpuquiet_wake_cpu(unsigned int cpunumber, bool sync);
+extern unsigned int cpuquiet_thermal_quiesence_cpu(unsigned int cpunumber);
+extern unsigned int cpuquiet_thermal_wake_cpu(unsigned int cpunumber);
 extern int cpuquiet_register_driver(struct cpuquiet_driver *drv);
 extern void cpuquiet_unregister_driver(struct cpuquiet_driver *drv);
 extern int cpuquiet_add_group(struct attribute_group *attrs);
@@ -0,0 +1,40 @@
+/*
+ * include/linux/input/cfboost.h
+ *
+ * Copyright (C) 2012 NVIDIA Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef _LINUX_INPUT_CFBOOST_H
+#define _LINUX_INPUT_CFBOOST_H
+
+/*
+ * Event sources for the input booster. Each source has its own boost
+ * duration tunable (<source>_boost_time); the floors are shared.
+ */
+enum cfboost_source {
+	CFBOOST_TOUCH = 0,
+	CFBOOST_GAMEPAD,
+	CFBOOST_KEY,
+	CFBOOST_WAKE,
+	CFBOOST_NR_SOURCES,
+};
+
+#ifdef CONFIG_INPUT_CFBOOST
+/* May be called from atomic context */
+void cfboost_kick(enum cfboost_source source);
+#else
+static inline void cfboost_kick(enum cfboost_source source)
+{
+}
+#endif
+
+#endif /* _LINUX_INPUT_CFBOOST_H */
@@ -0,0 +1,75 @@
+/*
+ * include/linux/input/frame_trace.h
+ *
+ * Copyright (C) 2013 NVIDIA Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef _LINUX_INPUT_FRAME_TRACE_H
+#define _LINUX_INPUT_FRAME_TRACE_H
+
+#include <linux/types.h>
+
+/*
+ * Input to photon tracing. Every touch or gamepad report bumps a global
+ * frame id; later pipeline stages tag their trace events with the id that
+ * was current when work entered them, and with the syncpoint (id, value)
+ * pairs that link one stage to the next:
+ *
+ *   frame_input     report from an input device
+ *   frame_submit    job queued to a host1x channel, up to syncpt >= thresh
+ *   frame_complete  that job retired
+ *   frame_flip      window flip queued, waits on the job's syncpt
+ *   frame_scanout   flip latched on a vblank
+ *
+ * All of these may be called from atomic context.
+ */
+#ifdef CONFIG_INPUT_FRAME_TRACE
+u32 frame_trace_current(void);
+void frame_trace_submit(const char *name, u32 frame, u32 syncpt_id,
+			u32 thresh);
+void frame_trace_complete(const char *name, u32 frame, u32 syncpt_id,
+			  u32 thresh);
+void frame_trace_flip(int head, u32 frame, int win, u32 pre_syncpt_id,
+		      u32 pre_syncpt_val, u32 post_syncpt_id,
+		      u32 post_syncpt_val);
+void frame_trace_scanout(int head, u32 frame, u32 post_syncpt_id,
+			 u32 post_syncpt_val, u32 vblank, s64 timestamp_ns);
+#else
+static inline u32 frame_trace_current(void)
+{
+	return 0;
+}
+
+static inline void frame_trace_submit(const char *name, u32 frame,
+				      u32 syncpt_id, u32 thresh)
+{
+}
+
+static inline void frame_trace_complete(const char *name, u32 frame,
+					u32 syncpt_id, u32 thresh)
+{
+}
+
+static inline void frame_trace_flip(int head, u32 frame, int win,
+				    u32 pre_syncpt_id, u32 pre_syncpt_val,
+				    u32 post_syncpt_id, u32 post_syncpt_val)
+{
+}
+
+static inline void frame_trace_scanout(int head, u32 frame,
+				       u32 post_syncpt_id, u32 post_syncpt_val,
+				       u32 vblank, s64 timestamp_ns)
+{
+}
+#endif
+
+#endif /* _LINUX_INPUT_FRAME_TRACE_H */
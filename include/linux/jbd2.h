@@ -591,6 +591,11 @@ struct transaction_s
 	 */
 	atomic_t		t_handle_count;
 
+	/*
+	 * How many fsync callers waited for this transaction? [no locking]
+	 */
+	atomic_t		t_fsync_count;
+
 	/*
 	 * This transaction is being forced and some process is
 	 * waiting for it to finish.
@@ -619,11 +624,23 @@ struct transaction_run_stats_s {
 	__u32			rs_blocks_logged;
 };
 
+/* log2 histogram slots: slot n counts values in [2^(n-1), 2^n) */
+#define JBD2_HIST_SLOTS		20
+
 struct transaction_stats_s {
 	unsigned long		ts_tid;
 	struct transaction_run_stats_s run;
+	unsigned long		ts_fsync;	/* fsyncs through jbd2_fsync_commit */
+	unsigned long		ts_fsync_batched; /* ... held back for joiners */
+	unsigned long		ts_commit_hist[JBD2_HIST_SLOTS]; /* logged blocks */
+	unsigned long		ts_fsync_hist[JBD2_HIST_SLOTS];	/* usecs */
 };
 
+static inline int jbd2_hist_slot(u64 val)
+{
+	return min_t(int, fls64(val), JBD2_HIST_SLOTS - 1);
+}
+
 static inline unsigned long
 jbd2_time_diff(unsigned long start, unsigned long end)
 {
@@ -696,6 +713,7 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_wbufsize: maximum number of buffer_heads allowed in j_wbuf, the
  *	number that will fit in j_blocksize
  * @j_last_sync_writer: most recent pid which did a synchronous write
+ * @j_fsync_last_count: fsync callers of the last transaction fsync'ed
  * @j_history: Buffer storing the transactions statistics history
  * @j_history_max: Maximum number of transactions in the statistics history
  * @j_history_cur: Current number of transactions in the statistics history
@@ -920,6 +938,12 @@ struct journal_s
 	u32			j_min_batch_time;
 	u32			j_max_batch_time;
 
+	/*
+	 * how many fsync callers shared the last commit that had any.
+	 * [j_state_lock]
+	 */
+	unsigned int		j_fsync_last_count;
+
 	/* This function is called when a transaction is closed */
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
@@ -953,6 +977,7 @@ struct journal_s
 #define JBD2_ABORT_ON_SYNCDATA_ERR	0x040	/* Abort the journal on file
 						 * data write error in ordered
 						 * mode */
+#define JBD2_FSYNC_BATCH	0x080	/* Batch concurrent fsync commits */
 
 /*
  * Function declarations for the journaling transaction and buffer
@@ -1177,6 +1202,7 @@ int __jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_journal_force_commit_nested(journal_t *journal);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
+int jbd2_fsync_commit(journal_t *journal, tid_t tid);
 int jbd2_log_do_checkpoint(journal_t *journal);
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid);
 
@@ -1446,6 +1446,21 @@ unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
 
+/* readahead_replay.c */
+#ifdef CONFIG_READAHEAD_REPLAY
+extern int sysctl_readahead_replay;
+extern int sysctl_readahead_record_ms;
+
+void readahead_replay_miss(struct address_space *mapping, struct file *filp,
+			   pgoff_t offset, unsigned long nr);
+#else
+static inline void readahead_replay_miss(struct address_space *mapping,
+					 struct file *filp, pgoff_t offset,
+					 unsigned long nr)
+{
+}
+#endif
+
 /* Generic expand stack which grows the stack according to GROWS{UP,DOWN} */
 extern int expand_stack(struct vm_area_struct *vma, unsigned long address);
 
@@ -215,6 +215,14 @@ struct mmc_part {
 /*
  * MMC device
  */
+struct mmc_bkops_stats {
+	unsigned int	level[4];	/* BKOPS_STATUS seen at idle checks */
+	unsigned int	urgent;		/* R1_URGENT_BKOPS responses */
+	unsigned int	started;	/* BKOPS_START commands issued */
+	unsigned int	hpi;		/* stopped by HPI for foreground I/O */
+	unsigned int	completed;	/* done before the next request */
+};
+
 struct mmc_card {
 	struct mmc_host		*host;		/* the host this device belongs to */
 	struct device		dev;		/* the device */
@@ -237,6 +245,7 @@ struct mmc_card {
 #define MMC_CARD_REMOVED	(1<<9)		/* card has been removed */
 #define MMC_STATE_HIGHSPEED_200	(1<<10)		/* card is in HS200 mode */
 #define MMC_STATE_SLEEP		(1<<11)		/* card is in sleep state */
+#define MMC_STATE_CACHE_DIRTY	(1<<12)		/* cache written since flush */
 
 	unsigned int		quirks; 	/* card quirks */
 #define MMC_QUIRK_LENIENT_FN0	(1<<0)		/* allow SDIO FN0 writes outside of the VS CCCR range */
@@ -284,12 +293,17 @@ struct mmc_card {
 
 	unsigned int		sd_bus_speed;	/* Bus Speed Mode set for the card */
 
+	u32			cache_flushes;	/* CMD6 cache flushes issued */
+	u32			cache_flushes_skipped; /* clean cache flushes */
+
 	struct dentry		*debugfs_root;
 	struct mmc_part	part[MMC_NUM_PHY_PARTITION]; /* physical partitions */
 	unsigned int    nr_parts;
 
 	struct timer_list	timer;
 	struct work_struct	bkops;
+	struct delayed_work	bkops_idle;	/* BKOPS once the queue idles */
+	struct mmc_bkops_stats	bkops_stats;
 	struct work_struct	refresh;
 };
 
@@ -409,6 +423,7 @@ static inline void __maybe_unused remove_quirk(struct mmc_card *card, int data)
 #define mmc_card_is_sleep(c)	((c)->state & MMC_STATE_SLEEP)
 #define mmc_card_doing_bkops(c) ((c)->state & MMC_STATE_DOING_BKOPS)
 #define mmc_card_need_bkops(c) ((c)->state & MMC_STATE_NEED_BKOPS)
+#define mmc_card_cache_dirty(c) ((c)->state & MMC_STATE_CACHE_DIRTY)
 #define mmc_card_removed(c)	((c) && ((c)->state & MMC_CARD_REMOVED))
 #define mmc_card_is_sleep(c)	((c)->state & MMC_STATE_SLEEP)
 
@@ -463,6 +478,9 @@ static inline void __maybe_unused remove_quirk_sd(struct mmc_card *card,
 #define mmc_card_clr_doing_bkops(c) ((c)->state &= ~MMC_STATE_DOING_BKOPS)
 #define mmc_card_clr_need_bkops(c) ((c)->state &= ~MMC_STATE_NEED_BKOPS)
 
+#define mmc_card_set_cache_dirty(c) ((c)->state |= MMC_STATE_CACHE_DIRTY)
+#define mmc_card_clr_cache_dirty(c) ((c)->state &= ~MMC_STATE_CACHE_DIRTY)
+
 static inline int mmc_card_lenient_fn0(const struct mmc_card *c)
 {
 	return c->quirks & MMC_QUIRK_LENIENT_FN0;
@@ -14,6 +14,7 @@
 #define MMC_SLOW_WRITE_TIME	500000	/* time (us) */
 #define MMC_REFRESH_INTERVAL	60	/* time (s) */
 #define MMC_BKOPS_INTERVAL	20	/* time (s) */
+#define MMC_BKOPS_IDLE_DELAY	2000	/* time (ms) */
 
 struct request;
 struct mmc_data;
@@ -144,6 +145,8 @@ extern struct mmc_async_req *mmc_start_req(struct mmc_host *,
 					   struct mmc_async_req *, int *);
 extern int mmc_interrupt_hpi(struct mmc_card *);
 extern int mmc_bkops_start(struct mmc_card *card, bool is_synchronous);
+extern void mmc_bkops_idle_schedule(struct mmc_card *card);
+extern void mmc_bkops_idle_cancel(struct mmc_card *card);
 extern void mmc_refresh(unsigned long data);
 
 extern void mmc_wait_for_req(struct mmc_host *, struct mmc_request *);
@@ -18,6 +18,12 @@
 #include <linux/io.h>
 #include <linux/mmc/host.h>
 
+/* sg list mapped by pre_req() ahead of the request that will use it */
+struct sdhci_next {
+	unsigned int	sg_count;
+	s32		cookie;
+};
+
 struct sdhci_host {
 	/* Data set by hardware interface driver */
 	const char *hw_name;	/* Hardware bus name */
@@ -152,6 +158,7 @@ struct sdhci_host {
 	unsigned int blocks;	/* remaining PIO blocks */
 
 	int sg_count;		/* Mapped sg entries */
+	struct sdhci_next next_data;	/* Mapped in pre_req() */
 
 	u8 *adma_desc;		/* ADMA descriptor table */
 	u8 *align_buffer;	/* Bounce buffer */
@@ -25,12 +25,16 @@
 
 #include <linux/device.h>
 #include <linux/types.h>
+#include <linux/ktime.h>
+#include <linux/seqlock.h>
 #include <linux/devfreq.h>
 #include <linux/platform_device.h>
 
 struct nvhost_master;
 struct nvhost_hwctx;
 struct nvhost_device_power_attr;
+struct nvhost_device_profile;
+struct nvhost_scale_stats;
 
 #define NVHOST_MODULE_MAX_CLOCKS		3
 #define NVHOST_MODULE_MAX_POWERGATE_IDS 	2
@@ -82,6 +86,29 @@ enum nvhost_device_powerstate_t {
 	NVHOST_POWER_STATE_POWERGATED
 };
 
+#define NVHOST_IDLE_HIST_BUCKETS		16
+
+/* Idle period history and gating transitions, for adaptive power gating */
+struct nvhost_pg_stats {
+	ktime_t		idle_start;	/* refcount last dropped to zero */
+	ktime_t		pg_start;	/* module last power gated */
+	u32		idle_hist[NVHOST_IDLE_HIST_BUCKETS]; /* log2 ms */
+	u32		idle_total;	/* samples in idle_hist, decayed */
+	u32		adaptive;	/* pick powergate delay from history */
+	u32		breakeven_ms;	/* minimum off time that pays off */
+	u32		last_delay_ms;	/* powergate delay last scheduled */
+	u64		clockgates;
+	u64		powergates;
+	u64		unpowergates;
+	u64		short_powergates; /* ungated before break-even */
+	u64		wasted_ms;	/* break-even shortfall of those */
+	u64		ungate_us;	/* time spent ungating + restoring */
+	u32		ungate_max_us;
+	seqlock_t	busy_lock;	/* busy_* are read from irq context */
+	ktime_t		busy_start;	/* refcount last rose from zero */
+	u64		busy_us;	/* total time with refcount > 0 */
+};
+
 struct nvhost_device_data {
 	int		version;	/* ip version number of device */
 	int		id;		/* Separates clients of same hw */
@@ -113,6 +140,7 @@ struct nvhost_device_data {
 	struct mutex	lock;		/* Power management lock */
 	int		powerstate;	/* Current power state */
 	int		refcount;	/* Number of tasks active */
+	struct nvhost_pg_stats pg;	/* Power gating policy state */
 	wait_queue_head_t idle_wq;	/* Work queue for idle */
 	struct list_head client_list;	/* List of clients and rate requests */
 
@@ -120,6 +148,8 @@ struct nvhost_device_data {
 	struct kobject *power_kobj;	/* kobject to hold power sysfs entries */
 	struct nvhost_device_power_attr *power_attrib;	/* sysfs attributes */
 	struct devfreq	*power_manager;	/* Device power management */
+	struct nvhost_device_profile *power_profile; /* Scaling state */
+	struct nvhost_scale_stats *scale_stats;	/* Frequency statistics */
 	struct dentry *debugfs;		/* debugfs directory */
 
 	void *private_data;		/* private platform data */
@@ -172,6 +202,7 @@ struct nvhost_devfreq_ext_stat {
 	int		busy;
 	unsigned long	max_freq;
 	unsigned long	min_freq;
+	int		emc_bound;	/* waiting on memory, not on 3d */
 };
 
 struct nvhost_device_power_attr {
@@ -195,5 +226,38 @@ int nvhost_syncpt_wait_timeout_ext(struct platform_device *dev, u32 id, u32 thre
 	u32 timeout, u32 *value);
 
 void nvhost_scale3d_set_throughput_hint(int hint);
+int nvhost_scale3d_set_profile(const char *name);
+
+/* in-kernel 2D fills and copies within one linear surface */
+struct nvhost_gr2d_blit {
+	u32 base;		/* surface address */
+	u32 pitch;		/* bytes per line */
+	u32 bpp;		/* 16 or 32 */
+	bool fill;		/* fill with color, else copy from sx, sy */
+	bool xor;		/* xor color into the surface instead */
+	u32 color;
+	u32 sx, sy;
+	u32 dx, dy, w, h;
+};
+
+int nvhost_gr2d_blit(const struct nvhost_gr2d_blit *blit);
+
+/* cumulative counters for system profilers, safe from irq context */
+u64 nvhost_gr3d_busy_us(void);
+u32 nvhost_syncpt_intr_count(void);
+
+/*
+ * Cumulative channel activity of an engine, in host1x clock cycles. Only
+ * cycles in which host1x was clocked are counted.
+ */
+struct nvhost_engine_counters {
+	u64 ticks;		/* cycles counted */
+	u64 busy;		/* cycles transferring to the engine */
+	u64 stall;		/* cycles waiting for the engine to accept */
+	u64 idle;		/* the rest */
+};
+
+int nvhost_read_engine_counters(struct platform_device *dev,
+		struct nvhost_engine_counters *c);
 
 #endif
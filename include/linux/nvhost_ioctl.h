@@ -164,6 +164,18 @@ struct nvhost_submit_args {
 	__u32 fence;		/* Return value */
 };
 
+#define NVHOST_SUBMIT_BATCH_MAX		16
+
+/* submits up to NVHOST_SUBMIT_BATCH_MAX jobs in order with one doorbell.
+ * the fence of each queued job is written back to its entry in submits.
+ * if a job fails after others were queued, the ioctl succeeds and
+ * num_submitted tells how far it got */
+struct nvhost_submit_batch_args {
+	struct nvhost_submit_args *submits;
+	__u32 num_submits;
+	__u32 num_submitted;	/* Return value */
+};
+
 #define NVHOST_IOCTL_CHANNEL_FLUSH		\
 	_IOR(NVHOST_IOCTL_MAGIC, 1, struct nvhost_get_param_args)
 #define NVHOST_IOCTL_CHANNEL_GET_SYNCPOINTS	\
@@ -196,8 +208,10 @@ struct nvhost_submit_args {
 	_IOWR(NVHOST_IOCTL_MAGIC, 15, struct nvhost_submit_args)
 #define NVHOST_IOCTL_CHANNEL_SET_TIMEOUT_EX	\
 	_IOWR(NVHOST_IOCTL_MAGIC, 18, struct nvhost_set_timeout_ex_args)
+#define NVHOST_IOCTL_CHANNEL_SUBMIT_BATCH	\
+	_IOWR(NVHOST_IOCTL_MAGIC, 19, struct nvhost_submit_batch_args)
 #define NVHOST_IOCTL_CHANNEL_LAST		\
-	_IOC_NR(NVHOST_IOCTL_CHANNEL_SET_TIMEOUT_EX)
+	_IOC_NR(NVHOST_IOCTL_CHANNEL_SUBMIT_BATCH)
 #define NVHOST_IOCTL_CHANNEL_MAX_ARG_SIZE sizeof(struct nvhost_submit_args)
 
 struct nvhost_ctrl_syncpt_read_args {
@@ -222,6 +236,37 @@ struct nvhost_ctrl_syncpt_waitex_args {
 	__u32 value;
 };
 
+struct nvhost_ctrl_syncpt_fence {
+	__u32 id;
+	__u32 thresh;
+};
+
+#define NVHOST_SYNCPT_WAIT_MULTI_MAX	16
+#define NVHOST_SYNCPT_WAIT_MULTI_ALL	(1 << 0)
+
+/* waits until any (or, with NVHOST_SYNCPT_WAIT_MULTI_ALL, every) fence in
+ * the array has expired. on return from an "any" wait, index is the
+ * fence that fired and value its syncpoint value */
+struct nvhost_ctrl_syncpt_wait_multi_args {
+	struct nvhost_ctrl_syncpt_fence *fences;
+	__u32 num_fences;
+	__u32 flags;
+	__s32 timeout;
+	__u32 index;
+	__u32 value;
+};
+
+/* creates a sync framework fence that signals once every syncpoint
+ * threshold in the array has been reached. thresholds on the same
+ * syncpoint collapse into one point. the fence fd is returned in
+ * fence_fd */
+struct nvhost_ctrl_sync_fence_create_args {
+	__u32 num_pts;
+	__s32 fence_fd;
+	__u64 pts; /* struct nvhost_ctrl_syncpt_fence* */
+	__u64 name; /* const char* */
+};
+
 struct nvhost_ctrl_module_mutex_args {
 	__u32 id;
 	__u32 lock;
@@ -259,8 +304,14 @@ enum nvhost_module_id {
 #define NVHOST_IOCTL_CTRL_SYNCPT_READ_MAX	\
 	_IOWR(NVHOST_IOCTL_MAGIC, 8, struct nvhost_ctrl_syncpt_read_args)
 
+#define NVHOST_IOCTL_CTRL_SYNCPT_WAIT_MULTI	\
+	_IOWR(NVHOST_IOCTL_MAGIC, 9, struct nvhost_ctrl_syncpt_wait_multi_args)
+
+#define NVHOST_IOCTL_CTRL_SYNC_FENCE_CREATE	\
+	_IOWR(NVHOST_IOCTL_MAGIC, 10, struct nvhost_ctrl_sync_fence_create_args)
+
 #define NVHOST_IOCTL_CTRL_LAST			\
-	_IOC_NR(NVHOST_IOCTL_CTRL_SYNCPT_READ_MAX)
+	_IOC_NR(NVHOST_IOCTL_CTRL_SYNC_FENCE_CREATE)
 #define NVHOST_IOCTL_CTRL_MAX_ARG_SIZE	\
 	sizeof(struct nvhost_ctrl_module_regrdwr_args)
 
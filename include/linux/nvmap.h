@@ -23,6 +23,8 @@
 #include <linux/ioctl.h>
 #include <linux/file.h>
 #include <linux/rbtree.h>
+#include <linux/list.h>
+#include <linux/rcupdate.h>
 #include <linux/dma-buf.h>
 
 #if !defined(__KERNEL__)
@@ -53,6 +55,9 @@
 #define NVMAP_HANDLE_SECURE          (0x1ul << 2)
 #define NVMAP_HANDLE_ZEROED_PAGES    (0x1ul << 3)
 
+/* NVMAP_IOC_MMAP flag: populate the whole mapping up front */
+#define NVMAP_HANDLE_PREFAULT        (0x1ul << 4)
+
 #if defined(__KERNEL__)
 
 #if defined(CONFIG_TEGRA_NVMAP)
@@ -71,6 +76,8 @@ struct nvmap_device;
 struct nvmap_handle_ref {
 	struct nvmap_handle *handle;
 	struct rb_node	node;
+	struct hlist_node hnode; /* entry on the client's id hash */
+	struct rcu_head	rcu;
 	atomic_t	dupes;	/* number of times to free on file close */
 	atomic_t	pin;	/* number of times to unpin on free */
 };
@@ -110,6 +117,9 @@ void _nvmap_free(struct nvmap_client *client, struct nvmap_handle_ref *r);
 
 void *nvmap_mmap(struct nvmap_handle_ref *r);
 
+void *nvmap_mmap_wc(struct nvmap_handle_ref *r, size_t max_size,
+		    size_t *size);
+
 void nvmap_munmap(struct nvmap_handle_ref *r, void *addr);
 
 void *nvmap_kmap(struct nvmap_handle_ref *r, unsigned int pagenum);
@@ -117,6 +127,9 @@ void *nvmap_kmap(struct nvmap_handle_ref *r, unsigned int pagenum);
 void nvmap_kunmap(struct nvmap_handle_ref *r, unsigned int pagenum,
 		void *addr);
 
+void nvmap_kunmap_clean(struct nvmap_handle_ref *r, unsigned int pagenum,
+		void *addr);
+
 struct nvmap_client *nvmap_client_get_file(int fd);
 
 struct nvmap_client *nvmap_client_get(struct nvmap_client *client);
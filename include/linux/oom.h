@@ -67,6 +67,23 @@ static inline void oom_killer_enable(void)
 
 extern struct task_struct *find_lock_task_mm(struct task_struct *p);
 
+/*
+ * The Android lowmemorykiller keeps thread group leaders on lists bucketed
+ * by oom_score_adj so that it can pick a victim without walking every task.
+ */
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+extern void lowmem_adj_add(struct task_struct *p);
+extern void lowmem_adj_del(struct task_struct *p);
+extern void lowmem_adj_update(struct task_struct *p);
+extern void lowmem_adj_replace(struct task_struct *old, struct task_struct *new);
+#else
+static inline void lowmem_adj_add(struct task_struct *p) { }
+static inline void lowmem_adj_del(struct task_struct *p) { }
+static inline void lowmem_adj_update(struct task_struct *p) { }
+static inline void lowmem_adj_replace(struct task_struct *old,
+				      struct task_struct *new) { }
+#endif
+
 /* sysctls */
 extern int sysctl_oom_dump_tasks;
 extern int sysctl_oom_kill_allocating_task;
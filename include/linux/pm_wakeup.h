@@ -42,6 +42,7 @@
  * @wakeup_count: Number of times the wakeup source might abort suspend.
  * @active: Status of the wakeup source.
  * @has_timeout: The wakeup source has been activated with a timeout.
+ * @attr_time: Active time when wakeup attribution was last started.
  */
 struct wakeup_source {
 	const char 		*name;
@@ -54,6 +55,7 @@ struct wakeup_source {
 	ktime_t last_time;
 	ktime_t start_prevent_time;
 	ktime_t prevent_sleep_time;
+	ktime_t attr_time;
 	unsigned long		event_count;
 	unsigned long		active_count;
 	unsigned long		relax_count;
@@ -99,6 +101,8 @@ extern void __pm_relax(struct wakeup_source *ws);
 extern void pm_relax(struct device *dev);
 extern void __pm_wakeup_event(struct wakeup_source *ws, unsigned int msec);
 extern void pm_wakeup_event(struct device *dev, unsigned int msec);
+extern void pm_wakeup_attribution_start(void);
+extern ktime_t pm_wakeup_attribution_end(char *name, size_t len);
 
 #else /* !CONFIG_PM_SLEEP */
 
@@ -177,6 +181,15 @@ static inline void __pm_wakeup_event(struct wakeup_source *ws, unsigned int msec
 
 static inline void pm_wakeup_event(struct device *dev, unsigned int msec) {}
 
+static inline void pm_wakeup_attribution_start(void) {}
+
+static inline ktime_t pm_wakeup_attribution_end(char *name, size_t len)
+{
+	if (len)
+		name[0] = '\0';
+	return ktime_set(0, 0);
+}
+
 #endif /* !CONFIG_PM_SLEEP */
 
 static inline void wakeup_source_init(struct wakeup_source *ws,
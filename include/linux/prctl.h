@@ -124,4 +124,13 @@
 #define PR_SET_CHILD_SUBREAPER 36
 #define PR_GET_CHILD_SUBREAPER 37
 
+/*
+ * Mark a thread (arg3, 0 for the caller) as latency sensitive: its
+ * wakeups preempt the running fair task without the wakeup granularity
+ * and prefer an idle cpu in the cache domain.  Numbered out of the way
+ * of the generic options, like PR_SET_PTRACER.
+ */
+#define PR_SET_LATENCY_SENSITIVE 0x4c415400
+#define PR_GET_LATENCY_SENSITIVE 0x4c415401
+
 #endif /* _LINUX_PRCTL_H */
@@ -140,6 +140,10 @@ extern unsigned long nr_running(void);
 extern unsigned long nr_uninterruptible(void);
 extern unsigned long nr_iowait(void);
 extern u64 nr_running_integral(unsigned int cpu);
+/* per-task utilization is scaled to SCHED_UTIL_SCALE, see fair.c */
+#define SCHED_UTIL_SCALE	1024
+extern unsigned int sched_heavy_task_util(unsigned int threshold,
+					  unsigned int *nr_heavy);
 extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
 
@@ -1175,6 +1179,7 @@ struct sched_statistics {
 	u64			wait_max;
 	u64			wait_count;
 	u64			wait_sum;
+	u64			latency_wake_start;
 	u64			iowait_count;
 	u64			iowait_sum;
 
@@ -1218,6 +1223,10 @@ struct sched_entity {
 
 	u64			nr_migrations;
 
+	/* decayed fraction of time spent running, see fair.c */
+	u64			util_last_update;
+	u32			util_avg;
+
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_statistics statistics;
 #endif
@@ -1300,6 +1309,7 @@ struct task_struct {
 #endif
 
 	unsigned int policy;
+	unsigned int latency_sensitive;
 	cpumask_t cpus_allowed;
 
 #ifdef CONFIG_PREEMPT_RCU
@@ -1319,6 +1329,9 @@ struct task_struct {
 #endif
 
 	struct list_head tasks;
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+	struct hlist_node lmk_node;	/* oom_score_adj bucket, leaders only */
+#endif
 #ifdef CONFIG_SMP
 	struct plist_node pushable_tasks;
 #endif
@@ -1923,6 +1936,7 @@ extern void do_set_cpus_allowed(struct task_struct *p,
 
 extern int set_cpus_allowed_ptr(struct task_struct *p,
 				const struct cpumask *new_mask);
+extern int sched_set_cpu_parked(int cpu, bool parked);
 #else
 static inline void do_set_cpus_allowed(struct task_struct *p,
 				      const struct cpumask *new_mask)
@@ -1935,6 +1949,10 @@ static inline int set_cpus_allowed_ptr(struct task_struct *p,
 		return -EINVAL;
 	return 0;
 }
+static inline int sched_set_cpu_parked(int cpu, bool parked)
+{
+	return -EINVAL;
+}
 #endif
 
 #ifdef CONFIG_NO_HZ
@@ -2073,6 +2091,35 @@ static inline unsigned int get_sysctl_timer_migration(void)
 extern unsigned int sysctl_sched_rt_period;
 extern int sysctl_sched_rt_runtime;
 
+/*
+ * Per-cpu demand as of the last scheduler tick, decayed to the time of the
+ * read for a cpu idling without tick. Averages are in SCHED_UTIL_SCALE
+ * units: one always-runnable task, one cpu always running fair tasks.
+ */
+struct sched_cpu_demand {
+	unsigned int nr_running;
+	unsigned int nr_running_avg;
+	unsigned int util;
+};
+
+#ifdef CONFIG_SMP
+extern unsigned int sysctl_sched_packing_util;
+extern unsigned int sysctl_sched_packing_task_util;
+extern unsigned int sched_packing_cpus(void);
+extern void sched_get_cpu_demand(int cpu, struct sched_cpu_demand *demand);
+#else
+static inline unsigned int sched_packing_cpus(void)
+{
+	return 0;
+}
+
+static inline void sched_get_cpu_demand(int cpu,
+					struct sched_cpu_demand *demand)
+{
+	demand->nr_running = demand->nr_running_avg = demand->util = 0;
+}
+#endif
+
 int sched_rt_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *lenp,
 		loff_t *ppos);
@@ -2725,6 +2772,8 @@ static inline void set_task_cpu(struct task_struct *p, unsigned int cpu)
 
 extern long sched_setaffinity(pid_t pid, const struct cpumask *new_mask);
 extern long sched_getaffinity(pid_t pid, struct cpumask *mask);
+extern int sched_setlatency(pid_t pid, int sensitive);
+extern int sched_getlatency(pid_t pid);
 
 extern void normalize_rt_tasks(void);
 
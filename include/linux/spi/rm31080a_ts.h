@@ -39,6 +39,20 @@
 #define RM_IOCTL_SET_KRL_TBL				0x1013
 #define RM_IOCTL_WATCH_DOG					0x1014
 
+/*
+ * Raw data ring shared with the HAL through mmap() of the misc device.
+ * Frames start at RM_QUEUE_DATA_OFFSET; the driver advances u32Rear and
+ * the HAL advances u32Front. The ring is empty when they are equal.
+ */
+#define RM_QUEUE_DATA_OFFSET				4096
+
+struct rm_tch_queue_hdr {
+	unsigned int u32Front;
+	unsigned int u32Rear;
+	unsigned int u32Count;
+	unsigned int u32Length;
+};
+
 #define RM_INPUT_RESOLUTION_X				4096
 #define RM_INPUT_RESOLUTION_Y				4096
 
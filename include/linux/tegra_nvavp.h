@@ -15,6 +15,7 @@
 #include <linux/types.h>
 
 #define NVAVP_MAX_RELOCATION_COUNT 64
+#define NVAVP_MAX_MULTI_SUBMITS 16
 
 /* avp submit flags */
 #define NVAVP_FLAG_NONE		0x00000000
@@ -55,6 +56,16 @@ struct nvavp_pushbuffer_submit_hdr {
 	__u32			flags;
 };
 
+/*
+ * Several command buffers in one ioctl. They are written to the push
+ * buffer back to back and the AVP is woken once; every entry with a
+ * syncpt pointer gets its own fence, signalled when that entry is done.
+ */
+struct nvavp_pushbuffer_submit_multi_hdr {
+	struct nvavp_pushbuffer_submit_hdr	*submits;
+	__u32					num_submits;
+};
+
 struct nvavp_set_nvmap_fd_args {
 	__u32 fd;
 };
@@ -73,6 +84,16 @@ struct nvavp_clock_stay_on_state_args {
 	enum nvavp_clock_stay_on_state	state;
 };
 
+/*
+ * read() on the audio channel returns how many of each event the AVP has
+ * raised since the driver loaded, blocking until one of them changes
+ * from what this file last read; poll() reports POLLIN when they have.
+ */
+struct nvavp_audio_events {
+	__u32 app_notify;	/* firmware asks the client for attention */
+	__u32 audio_idle;	/* audio channel drained */
+};
+
 #define NVAVP_IOCTL_MAGIC		'n'
 
 #define NVAVP_IOCTL_SET_NVMAP_FD	_IOW(NVAVP_IOCTL_MAGIC, 0x60, \
@@ -93,8 +114,12 @@ struct nvavp_clock_stay_on_state_args {
 					struct nvavp_clock_args)
 #define NVAVP_IOCTL_DISABLE_AUDIO_CLOCKS _IOWR(NVAVP_IOCTL_MAGIC, 0x69, \
 					struct nvavp_clock_args)
+#define NVAVP_IOCTL_PUSH_BUFFER_SUBMIT_MULTI \
+				_IOW(NVAVP_IOCTL_MAGIC, 0x6a, \
+				struct nvavp_pushbuffer_submit_multi_hdr)
 
 #define NVAVP_IOCTL_MIN_NR		_IOC_NR(NVAVP_IOCTL_SET_NVMAP_FD)
-#define NVAVP_IOCTL_MAX_NR		_IOC_NR(NVAVP_IOCTL_DISABLE_AUDIO_CLOCKS)
+#define NVAVP_IOCTL_MAX_NR \
+			_IOC_NR(NVAVP_IOCTL_PUSH_BUFFER_SUBMIT_MULTI)
 
 #endif /* __LINUX_TEGRA_NVAVP_H */
@@ -20,7 +20,7 @@
 #include <linux/ioctl.h>
 
 #define QUADD_SAMPLES_VERSION	34
-#define QUADD_IO_VERSION	18
+#define QUADD_IO_VERSION	21
 
 #define QUADD_IO_VERSION_DYNAMIC_RB		5
 #define QUADD_IO_VERSION_RB_MAX_FILL_COUNT	6
@@ -36,6 +36,9 @@
 #define QUADD_IO_VERSION_STACK_OFFSET		16
 #define QUADD_IO_VERSION_SECTIONS_INFO		17
 #define QUADD_IO_VERSION_UNW_METHODS_OPT	18
+#define QUADD_IO_VERSION_UNCORE_EVENTS		19
+#define QUADD_IO_VERSION_THREAD_COUNTERS	20
+#define QUADD_IO_VERSION_FLIGHT_RECORDER	21
 
 #define QUADD_SAMPLE_VERSION_THUMB_MODE_FLAG	17
 #define QUADD_SAMPLE_VERSION_GROUP_SAMPLES	18
@@ -133,6 +136,15 @@ enum quadd_events_id {
 	QUADD_EVENT_TYPE_L2_ICACHE_MISSES,
 
 	QUADD_EVENT_TYPE_MAX,
+
+	/* system-wide (uncore) events, not counted by the cpu pmu */
+	QUADD_EVENT_TYPE_EMC_LOAD = 32,		/* per mille */
+	QUADD_EVENT_TYPE_EMC_CPU_LOAD,		/* per mille */
+	QUADD_EVENT_TYPE_EMC_BANDWIDTH,		/* KB/s */
+	QUADD_EVENT_TYPE_GR3D_BUSY,		/* per mille */
+	QUADD_EVENT_TYPE_SYNCPT_INTRS,		/* count */
+
+	QUADD_EVENT_TYPE_UNCORE_MAX,
 };
 
 struct event_data {
@@ -159,6 +171,7 @@ enum quadd_record_type {
 enum quadd_event_source {
 	QUADD_EVENT_SOURCE_PMU = 1,
 	QUADD_EVENT_SOURCE_PL310,
+	QUADD_EVENT_SOURCE_UNCORE,
 };
 
 enum quadd_cpu_mode {
@@ -280,6 +293,12 @@ enum {
 	QUADD_SCHED_IDX_RESERVED,
 };
 
+/*
+ * Sched-out record is followed by u32 nr and nr u64 totals of the
+ * thread's pmu events, in the order of the header's event list.
+ */
+#define QUADD_SCHED_RES_THREAD_COUNTERS	(1 << 0)
+
 struct quadd_sched_data {
 	u32 pid;
 	u64 time;
@@ -331,6 +350,7 @@ struct quadd_debug_data {
 #define QUADD_HDR_USE_ARCH_TIMER	(1 << 3)
 #define QUADD_HDR_STACK_OFFSET		(1 << 4)
 #define QUADD_HDR_BT_DWARF		(1 << 5)
+#define QUADD_HDR_THREAD_COUNTERS	(1 << 6)
 
 struct quadd_header_data {
 	u16 magic;
@@ -387,6 +407,8 @@ enum {
 #define QUADD_PARAM_EXTRA_STACK_OFFSET		(1 << 5)
 #define QUADD_PARAM_EXTRA_BT_UT_CE		(1 << 6)
 #define QUADD_PARAM_EXTRA_BT_DWARF		(1 << 7)
+#define QUADD_PARAM_EXTRA_THREAD_COUNTERS	(1 << 8)
+#define QUADD_PARAM_EXTRA_FLIGHT_RECORDER	(1 << 9)
 
 struct quadd_parameters {
 	u32 freq;
@@ -422,7 +444,13 @@ struct quadd_events_cap {
 
 		l2_dcache_read_misses:1,
 		l2_dcache_write_misses:1,
-		l2_icache_misses:1;
+		l2_icache_misses:1,
+
+		emc_load:1,
+		emc_cpu_load:1,
+		emc_bandwidth:1,
+		gr3d_busy:1,
+		syncpt_intrs:1;
 };
 
 enum {
@@ -439,6 +467,8 @@ enum {
 #define QUADD_COMM_CAP_EXTRA_UNW_ENTRY_TYPE	(1 << 7)
 #define QUADD_COMM_CAP_EXTRA_ARCH_TIMER		(1 << 8)
 #define QUADD_COMM_CAP_EXTRA_RB_MMAP_OP		(1 << 9)
+#define QUADD_COMM_CAP_EXTRA_THREAD_COUNTERS	(1 << 10)
+#define QUADD_COMM_CAP_EXTRA_FLIGHT_RECORDER	(1 << 11)
 
 struct quadd_comm_cap {
 	u32	pmu:1,
@@ -537,6 +567,7 @@ enum {
 	QUADD_RB_STATE_NONE = 0,
 	QUADD_RB_STATE_ACTIVE,
 	QUADD_RB_STATE_STOPPED,
+	QUADD_RB_STATE_FROZEN,
 };
 
 struct quadd_ring_buffer_hdr {
@@ -567,6 +598,8 @@ extern void __quadd_task_sched_out(struct task_struct *prev,
 
 extern void __quadd_event_mmap(struct vm_area_struct *vma);
 
+extern void __quadd_flight_recorder_trigger(void);
+
 static inline void quadd_task_sched_in(struct task_struct *prev,
 				       struct task_struct *task)
 {
@@ -584,6 +617,11 @@ static inline void quadd_event_mmap(struct vm_area_struct *vma)
 	__quadd_event_mmap(vma);
 }
 
+static inline void quadd_flight_recorder_trigger(void)
+{
+	__quadd_flight_recorder_trigger();
+}
+
 #else	/* CONFIG_TEGRA_PROFILER */
 
 static inline void quadd_task_sched_in(struct task_struct *prev,
@@ -600,6 +638,10 @@ static inline void quadd_event_mmap(struct vm_area_struct *vma)
 {
 }
 
+static inline void quadd_flight_recorder_trigger(void)
+{
+}
+
 #endif	/* CONFIG_TEGRA_PROFILER */
 
 #endif	/* __KERNEL__ */
@@ -22,6 +22,8 @@
 
 #define MAX_ACTIVE_STATES 10
 
+#define THERM_EST_FORECAST_MAX_LEAD	5000
+
 struct therm_est_subdevice {
 	void *dev_data;
 	int (*get_temp)(void *, long *);
@@ -41,6 +43,8 @@ struct therm_est_data {
 	int ndevs;
 	int tc1;
 	int tc2;
+	long forecast_ms;	/* 0 disables the forecast */
+	long forecast_max_lead;	/* mC, 0 for default */
 	struct therm_est_subdevice devs[];
 };
 
@@ -58,6 +62,13 @@ struct therm_fan_est_data {
 	char *cdev_type;
 	int active_trip_temps[MAX_ACTIVE_STATES];
 	int active_hysteresis[MAX_ACTIVE_STATES];
+
+	/* power feed-forward, disabled if get_power is NULL */
+	int (*get_power)(void *, long *);	/* mW */
+	void *power_data;
+	long power_coeff;	/* mC of lead per W */
+	long power_max_lead;	/* mC */
+	long power_decay;	/* percent of lead kept per period on drops */
 	struct therm_fan_est_subdevice devs[];
 };
 #endif /* _LINUX_THERM_EST_H */
@@ -30,10 +30,50 @@ struct tegra_throughput_target_fps_args {
 	__u32 target_fps;
 };
 
+#define TEGRA_THROUGHPUT_PROFILE_NAME_LEN	16
+
+/* name of a gr3d scaling profile: "default", "emulator", "video", "ui" */
+struct tegra_throughput_scaling_profile_args {
+	char name[TEGRA_THROUGHPUT_PROFILE_NAME_LEN];
+};
+
+/*
+ * A completed frame: the CPU time the render thread spent on it, and the
+ * time it had (0 for the target frame time).
+ */
+struct tegra_throughput_frame_deadline_args {
+	__u32 busy_us;
+	__u32 deadline_us;
+};
+
+/* frames shown for 1, 2, ... vsyncs, the last bucket for that many or more */
+#define TEGRA_THROUGHPUT_HIST_BUCKETS	8
+
+/* frame statistics of the calling client, times in microseconds */
+struct tegra_throughput_stats_args {
+	__u64 frames;
+	__u64 janks;		/* frames shown later than the target */
+	__u32 target_frame_time_us;
+	__u32 vsync_time_us;
+	__u32 foreground;	/* flips are accounted to this client */
+	__u32 hist[TEGRA_THROUGHPUT_HIST_BUCKETS];
+};
+
 #define TEGRA_THROUGHPUT_IOCTL_TARGET_FPS \
 	_IOW(TEGRA_THROUGHPUT_MAGIC, 1, struct tegra_throughput_target_fps_args)
+#define TEGRA_THROUGHPUT_IOCTL_SCALING_PROFILE \
+	_IOW(TEGRA_THROUGHPUT_MAGIC, 2, \
+		struct tegra_throughput_scaling_profile_args)
+#define TEGRA_THROUGHPUT_IOCTL_FRAME_DEADLINE \
+	_IOW(TEGRA_THROUGHPUT_MAGIC, 3, \
+		struct tegra_throughput_frame_deadline_args)
+/* arg 1 makes the caller the foreground client, 0 gives that up */
+#define TEGRA_THROUGHPUT_IOCTL_FOREGROUND \
+	_IO(TEGRA_THROUGHPUT_MAGIC, 4)
+#define TEGRA_THROUGHPUT_IOCTL_GET_STATS \
+	_IOR(TEGRA_THROUGHPUT_MAGIC, 5, struct tegra_throughput_stats_args)
 #define TEGRA_THROUGHPUT_IOCTL_MAXNR \
-	(_IOC_NR(TEGRA_THROUGHPUT_IOCTL_TARGET_FPS))
+	(_IOC_NR(TEGRA_THROUGHPUT_IOCTL_GET_STATS))
 
 #endif /* !defined(__TEGRA_THROUGHPUT_IOCTL_H) */
 
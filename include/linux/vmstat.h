@@ -202,6 +202,8 @@ extern void __dec_zone_state(struct zone *, enum zone_stat_item);
 
 void refresh_cpu_vm_stats(int);
 void refresh_zone_stat_thresholds(void);
+void quiet_vmstat(void);
+unsigned long global_page_state_snapshot(enum zone_stat_item item);
 
 int calculate_pressure_threshold(struct zone *zone);
 int calculate_normal_threshold(struct zone *zone);
@@ -255,6 +257,12 @@ static inline void __dec_zone_page_state(struct page *page,
 
 static inline void refresh_cpu_vm_stats(int cpu) { }
 static inline void refresh_zone_stat_thresholds(void) { }
+static inline void quiet_vmstat(void) { }
+
+static inline unsigned long global_page_state_snapshot(enum zone_stat_item item)
+{
+	return global_page_state(item);
+}
 
 #endif		/* CONFIG_SMP */
 
@@ -112,6 +112,53 @@ DEFINE_EVENT(display_basic_template, underflow,
 	TP_ARGS(dc)
 );
 
+TRACE_EVENT(display_underflow_cause,
+	TP_PROTO(struct tegra_dc *dc, struct tegra_dc_underflow_cause *c),
+	TP_ARGS(dc, c),
+	TP_STRUCT__entry(
+		__field(	u8,		dev_id)
+		__field(	u32,		mask)
+		__field(	unsigned long,	emc_rate)
+		__field(	unsigned long,	emc_req)
+		__field(	unsigned long,	la_bw_a)
+		__field(	unsigned long,	la_bw_b)
+		__field(	unsigned long,	la_bw_c)
+	),
+	TP_fast_assign(
+		__entry->dev_id = dc->ndev->dev.id;
+		__entry->mask = c->mask;
+		__entry->emc_rate = c->emc_rate;
+		__entry->emc_req = c->emc_req;
+		__entry->la_bw_a = c->la_bw[0];
+		__entry->la_bw_b = c->la_bw[1];
+		__entry->la_bw_c = c->la_bw[2];
+	),
+	TP_printk("dc%u mask=%#x emc_rate=%lu emc_req=%lu la_bw=%lu/%lu/%lu",
+		__entry->dev_id, __entry->mask,
+		__entry->emc_rate, __entry->emc_req,
+		__entry->la_bw_a, __entry->la_bw_b, __entry->la_bw_c)
+);
+
+TRACE_EVENT(display_flip_latency,
+	TP_PROTO(struct tegra_dc *dc, s64 latency_us, u32 missed),
+	TP_ARGS(dc, latency_us, missed),
+	TP_STRUCT__entry(
+		__field(	u8,		dev_id)
+		__field(	s64,		latency_us)
+		__field(	u32,		missed)
+		__field(	u32,		frame)
+	),
+	TP_fast_assign(
+		__entry->dev_id = dc->ndev->dev.id;
+		__entry->latency_us = latency_us;
+		__entry->missed = missed;
+		__entry->frame = dc->latch_frame;
+	),
+	TP_printk("dc%u frame=%u latency=%lldus missed_vblanks=%u",
+		__entry->dev_id, __entry->frame,
+		__entry->latency_us, __entry->missed)
+);
+
 TRACE_EVENT(display_syncpt_flush,
 	TP_PROTO(struct tegra_dc *dc, u32 id, u32 min, u32 max),
 	TP_ARGS(dc, id, min, max),
@@ -0,0 +1,135 @@
+/*
+ * include/trace/events/frame.h
+ *
+ * Input to display frame pipeline events.
+ *
+ * Copyright (c) 2013, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM frame
+
+#if !defined(_TRACE_FRAME_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_FRAME_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(frame_input,
+	TP_PROTO(u32 frame, const char *name, const char *source),
+	TP_ARGS(frame, name, source),
+	TP_STRUCT__entry(
+		__field(u32, frame)
+		__string(name, name)
+		__field(const char *, source)
+	),
+	TP_fast_assign(
+		__entry->frame = frame;
+		__assign_str(name, name);
+		__entry->source = source;
+	),
+	TP_printk("frame=%u %s dev=%s",
+		__entry->frame, __entry->source, __get_str(name))
+);
+
+DECLARE_EVENT_CLASS(frame_job,
+	TP_PROTO(u32 frame, const char *name, u32 syncpt_id, u32 thresh),
+	TP_ARGS(frame, name, syncpt_id, thresh),
+	TP_STRUCT__entry(
+		__field(u32, frame)
+		__field(const char *, name)
+		__field(u32, syncpt_id)
+		__field(u32, thresh)
+	),
+	TP_fast_assign(
+		__entry->frame = frame;
+		__entry->name = name;
+		__entry->syncpt_id = syncpt_id;
+		__entry->thresh = thresh;
+	),
+	TP_printk("frame=%u %s syncpt=%u:%u",
+		__entry->frame, __entry->name,
+		__entry->syncpt_id, __entry->thresh)
+);
+
+DEFINE_EVENT(frame_job, frame_submit,
+	TP_PROTO(u32 frame, const char *name, u32 syncpt_id, u32 thresh),
+	TP_ARGS(frame, name, syncpt_id, thresh)
+);
+
+DEFINE_EVENT(frame_job, frame_complete,
+	TP_PROTO(u32 frame, const char *name, u32 syncpt_id, u32 thresh),
+	TP_ARGS(frame, name, syncpt_id, thresh)
+);
+
+TRACE_EVENT(frame_flip,
+	TP_PROTO(int head, u32 frame, int win, u32 pre_syncpt_id,
+		 u32 pre_syncpt_val, u32 post_syncpt_id, u32 post_syncpt_val),
+	TP_ARGS(head, frame, win, pre_syncpt_id, pre_syncpt_val,
+		post_syncpt_id, post_syncpt_val),
+	TP_STRUCT__entry(
+		__field(int, head)
+		__field(u32, frame)
+		__field(int, win)
+		__field(u32, pre_syncpt_id)
+		__field(u32, pre_syncpt_val)
+		__field(u32, post_syncpt_id)
+		__field(u32, post_syncpt_val)
+	),
+	TP_fast_assign(
+		__entry->head = head;
+		__entry->frame = frame;
+		__entry->win = win;
+		__entry->pre_syncpt_id = pre_syncpt_id;
+		__entry->pre_syncpt_val = pre_syncpt_val;
+		__entry->post_syncpt_id = post_syncpt_id;
+		__entry->post_syncpt_val = post_syncpt_val;
+	),
+	TP_printk("frame=%u dc%d win=%d pre=%d:%u post=%u:%u",
+		__entry->frame, __entry->head, __entry->win,
+		(int)__entry->pre_syncpt_id, __entry->pre_syncpt_val,
+		__entry->post_syncpt_id, __entry->post_syncpt_val)
+);
+
+TRACE_EVENT(frame_scanout,
+	TP_PROTO(int head, u32 frame, u32 post_syncpt_id, u32 post_syncpt_val,
+		 u32 vblank, s64 timestamp_ns),
+	TP_ARGS(head, frame, post_syncpt_id, post_syncpt_val, vblank,
+		timestamp_ns),
+	TP_STRUCT__entry(
+		__field(int, head)
+		__field(u32, frame)
+		__field(u32, post_syncpt_id)
+		__field(u32, post_syncpt_val)
+		__field(u32, vblank)
+		__field(s64, timestamp_ns)
+	),
+	TP_fast_assign(
+		__entry->head = head;
+		__entry->frame = frame;
+		__entry->post_syncpt_id = post_syncpt_id;
+		__entry->post_syncpt_val = post_syncpt_val;
+		__entry->vblank = vblank;
+		__entry->timestamp_ns = timestamp_ns;
+	),
+	TP_printk("frame=%u dc%d post=%u:%u vblank=%u latched=%lld",
+		__entry->frame, __entry->head,
+		__entry->post_syncpt_id, __entry->post_syncpt_val,
+		__entry->vblank, __entry->timestamp_ns)
+);
+
+#endif /* _TRACE_FRAME_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -111,6 +111,27 @@ TRACE_EVENT(nvhost_channel_submit,
 	  __entry->syncpt_id, __entry->syncpt_incrs)
 );
 
+TRACE_EVENT(nvhost_job_relocs,
+	TP_PROTO(const char *name, u32 patched, u32 skipped),
+
+	TP_ARGS(name, patched, skipped),
+
+	TP_STRUCT__entry(
+		__field(const char *, name)
+		__field(u32, patched)
+		__field(u32, skipped)
+	),
+
+	TP_fast_assign(
+		__entry->name = name;
+		__entry->patched = patched;
+		__entry->skipped = skipped;
+	),
+
+	TP_printk("name=%s, relocs patched=%u, skipped=%u",
+	  __entry->name, __entry->patched, __entry->skipped)
+);
+
 TRACE_EVENT(nvhost_ioctl_channel_submit,
 	TP_PROTO(const char *name, u32 version, u32 cmdbufs, u32 relocs,
 		 u32 waitchks, u32 syncpt_id, u32 syncpt_incrs),
@@ -566,6 +587,85 @@ TRACE_EVENT(nvhost_wait_cdma,
 	TP_printk("name=%s, event=%d", __entry->name, __entry->eventid)
 );
 
+TRACE_EVENT(nvhost_wait_cdma_done,
+	TP_PROTO(const char *name, u32 eventid, u32 usecs, u32 queue_depth),
+
+	TP_ARGS(name, eventid, usecs, queue_depth),
+
+	TP_STRUCT__entry(
+		__field(const char *, name)
+		__field(u32, eventid)
+		__field(u32, usecs)
+		__field(u32, queue_depth)
+	),
+
+	TP_fast_assign(
+		__entry->name = name;
+		__entry->eventid = eventid;
+		__entry->usecs = usecs;
+		__entry->queue_depth = queue_depth;
+	),
+
+	TP_printk("name=%s, event=%d, usecs=%u, queue_depth=%u",
+		__entry->name, __entry->eventid, __entry->usecs,
+		__entry->queue_depth)
+);
+
+TRACE_EVENT(nvhost_job_timestamps,
+	TP_PROTO(const char *name, u32 syncpt_id, u32 syncpt_thresh,
+		 u32 submit_us, u32 queue_us, u32 exec_us, u32 irq_us),
+
+	TP_ARGS(name, syncpt_id, syncpt_thresh, submit_us, queue_us,
+		exec_us, irq_us),
+
+	TP_STRUCT__entry(
+		__field(const char *, name)
+		__field(u32, syncpt_id)
+		__field(u32, syncpt_thresh)
+		__field(u32, submit_us)
+		__field(u32, queue_us)
+		__field(u32, exec_us)
+		__field(u32, irq_us)
+	),
+
+	TP_fast_assign(
+		__entry->name = name;
+		__entry->syncpt_id = syncpt_id;
+		__entry->syncpt_thresh = syncpt_thresh;
+		__entry->submit_us = submit_us;
+		__entry->queue_us = queue_us;
+		__entry->exec_us = exec_us;
+		__entry->irq_us = irq_us;
+	),
+
+	TP_printk("name=%s, id=%u, thresh=%u, submit=%uus, queue=%uus, "
+		  "exec=%uus, irq=%uus",
+		__entry->name, __entry->syncpt_id, __entry->syncpt_thresh,
+		__entry->submit_us, __entry->queue_us, __entry->exec_us,
+		__entry->irq_us)
+);
+
+TRACE_EVENT(nvhost_cdma_grow_push_buffer,
+	TP_PROTO(const char *name, u32 old_slots, u32 new_slots),
+
+	TP_ARGS(name, old_slots, new_slots),
+
+	TP_STRUCT__entry(
+		__field(const char *, name)
+		__field(u32, old_slots)
+		__field(u32, new_slots)
+	),
+
+	TP_fast_assign(
+		__entry->name = name;
+		__entry->old_slots = old_slots;
+		__entry->new_slots = new_slots;
+	),
+
+	TP_printk("name=%s, slots %u -> %u",
+		__entry->name, __entry->old_slots, __entry->new_slots)
+);
+
 TRACE_EVENT(nvhost_syncpt_update_min,
 	TP_PROTO(u32 id, u32 val),
 
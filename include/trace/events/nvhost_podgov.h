@@ -164,6 +164,33 @@ TRACE_EVENT(podgov_print_target,
 		__entry->target, __entry->hint, __entry->avg_hint)
 );
 
+TRACE_EVENT(podgov_frame_control,
+	TP_PROTO(long curr, int avg_hint, int busy, int integral, long demand),
+
+	TP_ARGS(curr, avg_hint, busy, integral, demand),
+
+	TP_STRUCT__entry(
+		__field(long, curr)
+		__field(int, avg_hint)
+		__field(int, busy)
+		__field(int, integral)
+		__field(long, demand)
+	),
+
+	TP_fast_assign(
+		__entry->curr = curr;
+		__entry->avg_hint = avg_hint;
+		__entry->busy = busy;
+		__entry->integral = integral;
+		__entry->demand = demand;
+	),
+
+	TP_printk("podgov: curr %ld, hint <%d>, busy %d, integral %d, "
+		"demand %ld\n",
+		__entry->curr, __entry->avg_hint, __entry->busy,
+		__entry->integral, __entry->demand)
+);
+
 TRACE_EVENT(podgov_stats,
 	TP_PROTO(int fast_up_count, int slow_down_count, unsigned int idle_min,
 		unsigned int idle_max),
@@ -298,6 +298,37 @@ TRACE_EVENT(nvmap_ioctl_pinop,
 );
 
 
+TRACE_EVENT(nvmap_latency,
+	TP_PROTO(struct nvmap_client *client,
+		 u32 op,
+		 u64 usecs
+	),
+
+	TP_ARGS(client, op, usecs),
+
+	TP_STRUCT__entry(
+		__field(struct nvmap_client *, client)
+		__field(u32, op)
+		__field(u64, usecs)
+	),
+
+	TP_fast_assign(
+		__entry->client = client;
+		__entry->op = op;
+		__entry->usecs = usecs;
+	),
+
+	TP_printk("client=%p, name=%s, op=%s, usecs=%llu",
+		__entry->client, __entry->client->name,
+		__print_symbolic(__entry->op,
+			{ NVMAP_LAT_ALLOC, "alloc" },
+			{ NVMAP_LAT_FREE, "free" },
+			{ NVMAP_LAT_PIN, "pin" },
+			{ NVMAP_LAT_MAP, "map" },
+			{ NVMAP_LAT_CACHE, "cache" }),
+		__entry->usecs)
+);
+
 DECLARE_EVENT_CLASS(pin_unpin,
 	TP_PROTO(struct nvmap_client *client,
 		 struct nvmap_handle *h,
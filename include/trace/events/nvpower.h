@@ -42,6 +42,17 @@ enum {
 	NVPOWER_CPU_POWERGATE_EXIT,
 };
 
+enum {
+	NVPOWER_CPU_FREQ_REQUEST,
+	NVPOWER_CPU_FREQ_SWITCH,
+	NVPOWER_CPU_FREQ_DONE,
+};
+
+enum {
+	NVPOWER_CPU_FREQ_PLL,
+	NVPOWER_CPU_FREQ_DFLL,
+};
+
 #endif
 
 TRACE_EVENT(nvcpu_cluster,
@@ -85,6 +96,60 @@ TRACE_EVENT(nvcpu_powergate,
 		  (unsigned long)__entry->state)
 );
 
+TRACE_EVENT(nvcpu_freq,
+
+	TP_PROTO(int phase, int mode, unsigned int old_freq,
+		 unsigned int new_freq),
+
+	TP_ARGS(phase, mode, old_freq, new_freq),
+
+	TP_STRUCT__entry(
+		__field(u32, counter)
+		__field(u32, phase)
+		__field(u32, mode)
+		__field(u32, old_freq)
+		__field(u32, new_freq)
+	),
+
+	TP_fast_assign(
+		__entry->counter = tegra_read_usec_raw();
+		__entry->phase = phase;
+		__entry->mode = mode;
+		__entry->old_freq = old_freq;
+		__entry->new_freq = new_freq;
+	),
+
+	TP_printk("counter=%lu, phase=%lu, mode=%s, old=%lu, new=%lu",
+		  (unsigned long)__entry->counter,
+		  (unsigned long)__entry->phase,
+		  __entry->mode == NVPOWER_CPU_FREQ_DFLL ? "dfll" : "pll",
+		  (unsigned long)__entry->old_freq,
+		  (unsigned long)__entry->new_freq)
+);
+
+TRACE_EVENT(nvcpu_voltage,
+
+	TP_PROTO(int old_mv, int new_mv),
+
+	TP_ARGS(old_mv, new_mv),
+
+	TP_STRUCT__entry(
+		__field(u32, counter)
+		__field(int, old_mv)
+		__field(int, new_mv)
+	),
+
+	TP_fast_assign(
+		__entry->counter = tegra_read_usec_raw();
+		__entry->old_mv = old_mv;
+		__entry->new_mv = new_mv;
+	),
+
+	TP_printk("counter=%lu, old=%d mV, new=%d mV",
+		  (unsigned long)__entry->counter,
+		  __entry->old_mv, __entry->new_mv)
+);
+
 #endif /* _TRACE_NVPOWER_H */
 
 /* This part must be outside protection */
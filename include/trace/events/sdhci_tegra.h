@@ -0,0 +1,83 @@
+/*
+ * include/trace/events/sdhci_tegra.h
+ *
+ * Tegra SDHCI request latency and error event logging to ftrace.
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM sdhci_tegra
+
+#if !defined(_TRACE_SDHCI_TEGRA_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_SDHCI_TEGRA_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(sdhci_tegra_request,
+	TP_PROTO(const char *name, u32 opcode, unsigned int blocks,
+		 unsigned int depth, u32 us),
+
+	TP_ARGS(name, opcode, blocks, depth, us),
+
+	TP_STRUCT__entry(
+		__string(name, name)
+		__field(u32, opcode)
+		__field(unsigned int, blocks)
+		__field(unsigned int, depth)
+		__field(u32, us)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->opcode = opcode;
+		__entry->blocks = blocks;
+		__entry->depth = depth;
+		__entry->us = us;
+	),
+
+	TP_printk("%s: cmd=%u, blocks=%u, depth=%u, us=%u",
+		__get_str(name), __entry->opcode, __entry->blocks,
+		__entry->depth, __entry->us)
+);
+
+TRACE_EVENT(sdhci_tegra_error,
+	TP_PROTO(const char *name, u32 opcode, u32 int_status),
+
+	TP_ARGS(name, opcode, int_status),
+
+	TP_STRUCT__entry(
+		__string(name, name)
+		__field(u32, opcode)
+		__field(u32, int_status)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->opcode = opcode;
+		__entry->int_status = int_status;
+	),
+
+	TP_printk("%s: cmd=%u, int_status=0x%08x",
+		__get_str(name), __entry->opcode, __entry->int_status)
+);
+
+#endif /* _TRACE_SDHCI_TEGRA_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,110 @@
+/*
+ * include/trace/events/tegra_smmu.h
+ *
+ * Tegra SMMU map/unmap event logging to ftrace.
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tegra_smmu
+
+#if !defined(_TRACE_TEGRA_SMMU_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_TEGRA_SMMU_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(smmu_map,
+	TP_PROTO(unsigned int asid, unsigned long iova, phys_addr_t pa,
+		 size_t bytes),
+
+	TP_ARGS(asid, iova, pa, bytes),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, asid)
+		__field(unsigned long, iova)
+		__field(phys_addr_t, pa)
+		__field(size_t, bytes)
+	),
+
+	TP_fast_assign(
+		__entry->asid = asid;
+		__entry->iova = iova;
+		__entry->pa = pa;
+		__entry->bytes = bytes;
+	),
+
+	TP_printk("asid=%u, iova=0x%lx, pa=0x%llx, bytes=0x%zx",
+		__entry->asid, __entry->iova, (u64)__entry->pa,
+		__entry->bytes)
+);
+
+TRACE_EVENT(smmu_map_sg,
+	TP_PROTO(unsigned int asid, unsigned long iova, int nents,
+		 unsigned long pages),
+
+	TP_ARGS(asid, iova, nents, pages),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, asid)
+		__field(unsigned long, iova)
+		__field(int, nents)
+		__field(unsigned long, pages)
+	),
+
+	TP_fast_assign(
+		__entry->asid = asid;
+		__entry->iova = iova;
+		__entry->nents = nents;
+		__entry->pages = pages;
+	),
+
+	TP_printk("asid=%u, iova=0x%lx, nents=%d, pages=%lu",
+		__entry->asid, __entry->iova, __entry->nents,
+		__entry->pages)
+);
+
+TRACE_EVENT(smmu_unmap,
+	TP_PROTO(unsigned int asid, unsigned long iova, size_t bytes,
+		 size_t unmapped),
+
+	TP_ARGS(asid, iova, bytes, unmapped),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, asid)
+		__field(unsigned long, iova)
+		__field(size_t, bytes)
+		__field(size_t, unmapped)
+	),
+
+	TP_fast_assign(
+		__entry->asid = asid;
+		__entry->iova = iova;
+		__entry->bytes = bytes;
+		__entry->unmapped = unmapped;
+	),
+
+	TP_printk("asid=%u, iova=0x%lx, bytes=0x%zx, unmapped=0x%zx",
+		__entry->asid, __entry->iova, __entry->bytes,
+		__entry->unmapped)
+);
+
+#endif /* _TRACE_TEGRA_SMMU_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
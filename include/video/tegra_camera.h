@@ -55,4 +55,68 @@ enum StereoCameraMode {
 	_IOWR('i', 3, struct tegra_camera_clk_info)
 #define TEGRA_CAMERA_IOCTL_RESET		_IOWR('i', 4, uint)
 
+/*
+ * Capture buffer ring.
+ *
+ * Frames are nvmap buffers registered once into a ring slot, where they
+ * stay pinned until unregistered or the device is closed. A slot is handed
+ * from one stage to the next (VI -> ISP -> encoder / preview) with
+ * BUFQ_QUEUE together with the syncpoint fence that completes when the
+ * producing engine is done writing it. BUFQ_DEQUEUE blocks until a slot is
+ * queued for the caller's stage and its fence has expired, so a consumer
+ * wakes up once per frame and never touches the pixels on the CPU.
+ * As with the other ioctls, the first field is the module id.
+ */
+#define TEGRA_CAMERA_BUFQ_SLOTS		16
+
+enum {
+	TEGRA_CAMERA_BUFQ_FREE = 0,	/* empty, to be filled by VI */
+	TEGRA_CAMERA_BUFQ_ISP,
+	TEGRA_CAMERA_BUFQ_ENCODER,
+	TEGRA_CAMERA_BUFQ_PREVIEW,
+	TEGRA_CAMERA_BUFQ_MAX
+};
+
+struct tegra_camera_nvmap_fd {
+	uint id;
+	int fd;		/* nvmap client fd owning the buffers */
+};
+
+struct tegra_camera_bufq_buffer {
+	uint id;
+	uint index;	/* ring slot */
+	__u32 handle;	/* nvmap handle id, 0 to unregister the slot */
+	__u32 addr;	/* out: device address of the pinned buffer */
+};
+
+struct tegra_camera_bufq_fence {
+	uint id;
+	uint index;	/* in for QUEUE, out for DEQUEUE */
+	uint queue;	/* TEGRA_CAMERA_BUFQ_* stage */
+	__u32 syncpt_id;	/* NVSYNCPT_INVALID (~0) for no fence */
+	__u32 syncpt_thresh;
+	__u32 timeout_ms;	/* DEQUEUE only, 0 waits forever */
+};
+
+#define TEGRA_CAMERA_IOCTL_SET_NVMAP_FD		\
+	_IOW('i', 5, struct tegra_camera_nvmap_fd)
+#define TEGRA_CAMERA_IOCTL_BUFQ_REGISTER	\
+	_IOWR('i', 6, struct tegra_camera_bufq_buffer)
+#define TEGRA_CAMERA_IOCTL_BUFQ_QUEUE		\
+	_IOW('i', 7, struct tegra_camera_bufq_fence)
+#define TEGRA_CAMERA_IOCTL_BUFQ_DEQUEUE		\
+	_IOWR('i', 8, struct tegra_camera_bufq_fence)
+
+#ifdef __KERNEL__
+#ifdef CONFIG_TEGRA_CAMERA
+int tegra_camera_set_sensor_mode(u32 res_x, u32 res_y, u32 frame_rate);
+#else
+static inline int tegra_camera_set_sensor_mode(u32 res_x, u32 res_y,
+					       u32 frame_rate)
+{
+	return 0;
+}
+#endif
+#endif
+
 #endif
@@ -61,6 +61,8 @@
 #define TEGRA_DC_EXT_FLIP_FLAG_CURSOR	(1 << 3)
 #define TEGRA_DC_EXT_FLIP_FLAG_GLOBAL_ALPHA	(1 << 4)
 #define TEGRA_DC_EXT_FLIP_FLAG_SCAN_COLUMN	(1 << 6)
+/* only the damage rectangle changed since the previous flip */
+#define TEGRA_DC_EXT_FLIP_FLAG_DAMAGE	(1 << 7)
 
 struct tegra_dc_ext_flip_windowattr {
 	__s32	index;
@@ -96,7 +98,15 @@ struct tegra_dc_ext_flip_windowattr {
 	__u8	global_alpha; /* requires TEGRA_DC_EXT_FLIP_FLAG_GLOBAL_ALPHA */
 	/* Leave some wiggle room for future expansion */
 	__u8	pad1[3];
-	__u32   pad2[4];
+	/*
+	 * Changed region in output coordinates, requires
+	 * TEGRA_DC_EXT_FLIP_FLAG_DAMAGE
+	 */
+	__u16	damage_x;
+	__u16	damage_y;
+	__u16	damage_w;
+	__u16	damage_h;
+	__u32   pad2[2];
 };
 
 #define TEGRA_DC_EXT_FLIP_N_WINDOWS	3
@@ -107,6 +117,18 @@ struct tegra_dc_ext_flip {
 	__u32	post_syncpt_val;
 };
 
+/*
+ * Flip presented at a given frame. Frames are counted by the head's vblank
+ * syncpoint (TEGRA_DC_EXT_GET_VBLANK_SYNCPT): the flip is held back until
+ * the syncpoint reaches frame - 1 so that it is latched by the vblank that
+ * advances it to frame. Frames already past are presented immediately.
+ */
+struct tegra_dc_ext_flip_frame {
+	struct tegra_dc_ext_flip	flip;
+	__u32				frame;
+	__u32				pad[3];
+};
+
 /*
  * Cursor image format:
  * - Tegra hardware supports two colors: foreground and background, specified
@@ -219,6 +241,17 @@ struct tegra_dc_ext_status {
 	__u32 pad[3];
 };
 
+/*
+ * Content frame rate for refresh-rate matching, in 1000ths of a Hertz.
+ * The head runs at the highest integer multiple of content_rate its panel
+ * allows without a modeset; 0 restores the mode's refresh rate. refresh
+ * returns the rate now in effect, also in 1000ths of a Hertz.
+ */
+struct tegra_dc_ext_content_rate {
+	__u32 content_rate;
+	__u32 refresh;
+};
+
 struct tegra_dc_ext_feature {
 	__u32 length;
 	__u32 *entries;
@@ -269,6 +302,20 @@ struct tegra_dc_ext_feature {
 #define TEGRA_DC_EXT_SET_CMU \
 	_IOW('D', 0x0D, struct tegra_dc_ext_cmu)
 
+#define TEGRA_DC_EXT_FLIP_AT_FRAME \
+	_IOWR('D', 0x0E, struct tegra_dc_ext_flip_frame)
+
+#define TEGRA_DC_EXT_SET_CONTENT_RATE \
+	_IOWR('D', 0x0F, struct tegra_dc_ext_content_rate)
+
+/*
+ * Mirror every flip on this head to the head given, scaled to fit its mode.
+ * The clone scans out the same buffers, so none of its windows may be in
+ * use. -1 stops cloning.
+ */
+#define TEGRA_DC_EXT_SET_CLONE \
+	_IOW('D', 0x10, __s32)
+
 enum tegra_dc_ext_control_output_type {
 	TEGRA_DC_EXT_DSI,
 	TEGRA_DC_EXT_LVDS,
@@ -323,6 +370,21 @@ struct tegra_dc_ext_control_event_hotplug {
 	__u32 handle;
 };
 
+/*
+ * Sent when a flip has been latched by the hardware. frame is the value of
+ * the head's vblank syncpoint at that vblank and timestamp_ns the
+ * CLOCK_MONOTONIC time of its interrupt. The post syncpoint identifies the
+ * flip as returned by TEGRA_DC_EXT_FLIP.
+ */
+#define TEGRA_DC_EXT_EVENT_FLIP		0x2
+struct tegra_dc_ext_control_event_flip {
+	__u32 handle;
+	__u32 post_syncpt_id;
+	__u32 post_syncpt_val;
+	__u32 frame;
+	__u64 timestamp_ns;
+};
+
 
 #define TEGRA_DC_EXT_CAPABILITIES_CURSOR_MODE	(1 << 0)
 struct tegra_dc_ext_control_capabilities {
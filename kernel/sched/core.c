@@ -556,6 +556,13 @@ int get_nohz_timer_target(void)
 	int i;
 	struct sched_domain *sd;
 
+	/*
+	 * A parked CPU is attached to no domain and must not collect timers,
+	 * hand them to the first active CPU.
+	 */
+	if (!cpu_active(cpu))
+		cpu = cpumask_first(cpu_active_mask);
+
 	rcu_read_lock();
 	for_each_domain(cpu, sd) {
 		for_each_cpu(i, sched_domain_span(sd)) {
@@ -1341,9 +1348,13 @@ int select_task_rq(struct task_struct *p, int sd_flags, int wake_flags)
 	 *
 	 * [ this allows ->select_task() to simply return task_cpu(p) and
 	 *   not worry about this generic constraint ]
+	 *
+	 * A parked cpu (online but not active, see sched_set_cpu_parked())
+	 * only keeps the tasks that are bound to it.
 	 */
 	if (unlikely(!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)) ||
-		     !cpu_online(cpu)))
+		     !cpu_online(cpu) ||
+		     (!cpu_active(cpu) && p->rt.nr_cpus_allowed > 1)))
 		cpu = select_fallback_rq(task_cpu(p), p);
 
 	return cpu;
@@ -1714,6 +1725,8 @@ static void __sched_fork(struct task_struct *p)
 	p->se.prev_sum_exec_runtime	= 0;
 	p->se.nr_migrations		= 0;
 	p->se.vruntime			= 0;
+	p->se.util_last_update		= 0;
+	p->se.util_avg			= 0;
 	INIT_LIST_HEAD(&p->se.group_node);
 
 #ifdef CONFIG_SCHEDSTATS
@@ -1761,6 +1774,7 @@ void sched_fork(struct task_struct *p)
 
 		p->prio = p->normal_prio = __normal_prio(p);
 		set_load_weight(p);
+		p->latency_sensitive = 0;
 
 		/*
 		 * We don't need the reset flag anymore after the fork. It has
@@ -3189,6 +3203,7 @@ void scheduler_tick(void)
 	update_rq_clock(rq);
 	update_cpu_load_active(rq);
 	curr->sched_class->task_tick(rq, curr, 0);
+	update_rq_demand(rq);
 	raw_spin_unlock(&rq->lock);
 
 	perf_event_task_tick();
@@ -4636,6 +4651,63 @@ out_unlock:
 	return retval;
 }
 
+/**
+ * sched_setlatency - mark a thread latency sensitive for fair wakeups
+ * @pid: thread id, 0 for the caller
+ * @sensitive: non-zero to mark, zero to clear
+ *
+ * Used by PR_SET_LATENCY_SENSITIVE.  Only the wakeup preemption and the
+ * idle cpu search of the fair class look at the mark, the task keeps its
+ * weight and vruntime, so it can not starve anything.
+ */
+int sched_setlatency(pid_t pid, int sensitive)
+{
+	struct task_struct *p;
+	int retval;
+
+	rcu_read_lock();
+
+	retval = -ESRCH;
+	p = find_process_by_pid(pid);
+	if (!p)
+		goto out_unlock;
+
+	retval = -EPERM;
+	if (!check_same_owner(p) && !ns_capable(task_user_ns(p), CAP_SYS_NICE))
+		goto out_unlock;
+
+	retval = security_task_setscheduler(p);
+	if (retval)
+		goto out_unlock;
+
+	p->latency_sensitive = !!sensitive;
+
+out_unlock:
+	rcu_read_unlock();
+	return retval;
+}
+
+int sched_getlatency(pid_t pid)
+{
+	struct task_struct *p;
+	int retval;
+
+	rcu_read_lock();
+
+	retval = -ESRCH;
+	p = find_process_by_pid(pid);
+	if (!p)
+		goto out_unlock;
+
+	retval = security_task_getscheduler(p);
+	if (!retval)
+		retval = p->latency_sensitive;
+
+out_unlock:
+	rcu_read_unlock();
+	return retval;
+}
+
 /**
  * sys_sched_getaffinity - get the cpu affinity of a process
  * @pid: pid of the process
@@ -6992,6 +7064,86 @@ static int cpuset_cpu_inactive(struct notifier_block *nfb, unsigned long action,
 	}
 }
 
+static DEFINE_MUTEX(sched_park_mutex);
+
+/*
+ * Push the fair tasks that may run elsewhere off a cpu that was just
+ * parked. Runs in the parked cpu's stopper, like migration_cpu_stop().
+ * Tasks of other classes move on their next wakeup.
+ */
+static int sched_park_cpu_stop(void *data)
+{
+	struct rq *rq = this_rq();
+	int cpu = cpu_of(rq);
+	struct task_struct *p;
+	bool found;
+	int dest_cpu;
+
+	do {
+		found = false;
+		local_irq_disable();
+		raw_spin_lock(&rq->lock);
+		list_for_each_entry(p, &rq->cfs_tasks, se.group_node) {
+			if (p->rt.nr_cpus_allowed < 2)
+				continue;
+			dest_cpu = cpumask_any_and(cpu_active_mask,
+						   tsk_cpus_allowed(p));
+			if (dest_cpu < nr_cpu_ids) {
+				get_task_struct(p);
+				found = true;
+				break;
+			}
+		}
+		raw_spin_unlock(&rq->lock);
+		if (found)
+			__migrate_task(p, cpu, dest_cpu);
+		local_irq_enable();
+		if (found)
+			put_task_struct(p);
+	} while (found);
+
+	return 0;
+}
+
+/*
+ * Park or unpark an online cpu. A parked cpu is dropped from the active
+ * mask and from the sched domains, exactly as at the start of a hot
+ * unplug, but is otherwise left running: it keeps only the tasks bound
+ * to it and idles in between. Unparking is a domain rebuild rather than
+ * a cpu_up(), so the cpu is usable again as soon as it leaves idle.
+ */
+int sched_set_cpu_parked(int cpu, bool parked)
+{
+	int ret = 0;
+
+	mutex_lock(&sched_park_mutex);
+	get_online_cpus();
+
+	if (!cpu_online(cpu)) {
+		ret = -EINVAL;
+		goto out;
+	}
+	if (cpu_active(cpu) != parked)
+		goto out;
+	if (parked && num_active_cpus() == 1) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	set_cpu_active(cpu, !parked);
+	cpuset_update_active_cpus();
+
+	if (parked)
+		stop_one_cpu(cpu, sched_park_cpu_stop, NULL);
+	else
+		resched_cpu(cpu);
+out:
+	put_online_cpus();
+	mutex_unlock(&sched_park_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(sched_set_cpu_parked);
+
 void __init sched_init_smp(void)
 {
 	cpumask_var_t non_isolated_cpus;
@@ -7874,6 +8026,24 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 	return (u64) scale_load_down(tg->shares);
 }
 
+static int cpu_latency_sensitive_write_u64(struct cgroup *cgrp,
+					   struct cftype *cftype, u64 val)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	tg->latency_sensitive = !!val;
+	return 0;
+}
+
+static u64 cpu_latency_sensitive_read_u64(struct cgroup *cgrp,
+					  struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->latency_sensitive;
+}
+
 #ifdef CONFIG_CFS_BANDWIDTH
 static DEFINE_MUTEX(cfs_constraints_mutex);
 
@@ -8104,6 +8274,40 @@ static int cpu_stats_show(struct cgroup *cgrp, struct cftype *cft,
 	return 0;
 }
 #endif /* CONFIG_CFS_BANDWIDTH */
+
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * Run and runqueue wait time of the group's entities on all cpus, to check
+ * how well a background group is kept out of the way of the foreground.
+ */
+static int cpu_sched_stat_show(struct cgroup *cgrp, struct cftype *cft,
+			       struct cgroup_map_cb *cb)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	u64 exec = 0, wait_sum = 0, wait_count = 0, wait_max = 0;
+	int i;
+
+	for_each_possible_cpu(i) {
+		struct sched_entity *se = tg->se[i];
+
+		/* the root group runs directly on the rq */
+		if (!se)
+			continue;
+
+		exec += se->sum_exec_runtime;
+		wait_sum += se->statistics.wait_sum;
+		wait_count += se->statistics.wait_count;
+		wait_max = max(wait_max, se->statistics.wait_max);
+	}
+
+	cb->fill(cb, "exec_runtime", exec);
+	cb->fill(cb, "wait_sum", wait_sum);
+	cb->fill(cb, "wait_count", wait_count);
+	cb->fill(cb, "wait_max", wait_max);
+
+	return 0;
+}
+#endif /* CONFIG_SCHEDSTATS */
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -8137,6 +8341,17 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "latency_sensitive",
+		.read_u64 = cpu_latency_sensitive_read_u64,
+		.write_u64 = cpu_latency_sensitive_write_u64,
+	},
+#ifdef CONFIG_SCHEDSTATS
+	{
+		.name = "sched_stat",
+		.read_map = cpu_sched_stat_show,
+	},
+#endif
 #endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
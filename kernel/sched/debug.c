@@ -297,6 +297,10 @@ static void print_cpu(struct seq_file *m, int cpu)
 	P(ttwu_count);
 	P(ttwu_local);
 
+	P(lat_wake_count);
+	P64(lat_wake_sum);
+	P64(lat_wake_max);
+
 #undef P
 #undef P64
 #endif
@@ -22,6 +22,7 @@
 
 #include <linux/latencytop.h>
 #include <linux/sched.h>
+#include <linux/export.h>
 #include <linux/cpumask.h>
 #include <linux/slab.h>
 #include <linux/profile.h>
@@ -656,6 +657,83 @@ static u64 sched_vslice(struct cfs_rq *cfs_rq, struct sched_entity *se)
 static void update_cfs_load(struct cfs_rq *cfs_rq, int global_update);
 static void update_cfs_shares(struct cfs_rq *cfs_rq);
 
+/*
+ * Per-entity utilization: the fraction of time an entity spends running,
+ * as a geometric series over ~1ms (2^20ns) periods that halves every 32
+ * periods, scaled to SCHED_UTIL_SCALE. It is updated whenever the entity
+ * starts running and from update_curr() while it runs; readers decay it
+ * for the time since. Whole periods are accounted only, the remainder is
+ * carried over to the next update.
+ */
+#define UTIL_PERIOD_SHIFT	20
+#define UTIL_HALFLIFE		32
+
+/* 2^32 * y^n, y^32 = 0.5 */
+static const u32 util_y_inv[UTIL_HALFLIFE] = {
+	0xffffffff, 0xfa83b2db, 0xf5257d15, 0xefe4b99b,
+	0xeac0c6e7, 0xe5b906e7, 0xe0ccdeec, 0xdbfbb797,
+	0xd744fcca, 0xd2a81d91, 0xce248c15, 0xc9b9bd86,
+	0xc5672a11, 0xc12c4cca, 0xbd08a39f, 0xb8fbaf47,
+	0xb504f333, 0xb123f581, 0xad583eea, 0xa9a15ab4,
+	0xa5fed6a9, 0xa2704303, 0x9ef53260, 0x9b8d39b9,
+	0x9837f051, 0x94f4efa8, 0x91c3d373, 0x8ea4398b,
+	0x8b95c1e3, 0x88980e80, 0x85aac367, 0x82cd8698,
+};
+
+static u32 util_decay(u32 val, u64 periods)
+{
+	unsigned int n;
+
+	/* SCHED_UTIL_SCALE halved 11 times is 0 */
+	if (periods >= UTIL_HALFLIFE * 11)
+		return 0;
+
+	n = periods;
+	val >>= n / UTIL_HALFLIFE;
+	return ((u64)val * util_y_inv[n % UTIL_HALFLIFE]) >> 32;
+}
+
+static void __update_util(u32 *util_avg, u64 *last_update, u64 now,
+			  int running)
+{
+	u64 periods;
+
+	if ((s64)(now - *last_update) < 0) {
+		/* clock of another cpu after a migration */
+		*last_update = now;
+		return;
+	}
+
+	periods = (now - *last_update) >> UTIL_PERIOD_SHIFT;
+	if (!periods)
+		return;
+
+	*last_update += periods << UTIL_PERIOD_SHIFT;
+	*util_avg = util_decay(*util_avg, periods);
+	if (running)
+		*util_avg += SCHED_UTIL_SCALE -
+			util_decay(SCHED_UTIL_SCALE, periods);
+}
+
+static inline void
+update_entity_util(struct sched_entity *se, u64 now, int running)
+{
+	__update_util(&se->util_avg, &se->util_last_update, now, running);
+}
+
+/*
+ * The same average over the time the rq ran fair tasks, for task packing.
+ * It follows rq->clock rather than clock_task so that it can be decayed
+ * against sched_clock_cpu() while the cpu sleeps and its clock is stale.
+ */
+static inline void update_rq_util(struct rq *rq, int running)
+{
+#ifdef CONFIG_SMP
+	__update_util(&rq->cfs_util_avg, &rq->cfs_util_last_update,
+		      rq->clock, running);
+#endif
+}
+
 /*
  * Update the current task's runtime statistics. Skip current tasks that
  * are not in our scheduling class.
@@ -701,10 +779,13 @@ static void update_curr(struct cfs_rq *cfs_rq)
 
 	__update_curr(cfs_rq, curr, delta_exec);
 	curr->exec_start = now;
+	update_entity_util(curr, now, 1);
 
 	if (entity_is_task(curr)) {
 		struct task_struct *curtask = task_of(curr);
 
+		update_rq_util(rq_of(cfs_rq), 1);
+
 		trace_sched_stat_runtime(curtask, delta_exec, curr->vruntime);
 		cpuacct_charge(curtask, delta_exec);
 		account_group_exec_runtime(curtask, delta_exec);
@@ -713,6 +794,54 @@ static void update_curr(struct cfs_rq *cfs_rq)
 	account_cfs_rq_runtime(cfs_rq, delta_exec);
 }
 
+/*
+ * Latency sensitive tasks, marked with PR_SET_LATENCY_SENSITIVE or through
+ * cpu.latency_sensitive of their group.  Caller holds p->pi_lock or the
+ * rq lock, as task_group() requires.
+ */
+static inline int task_latency_sensitive(struct task_struct *p)
+{
+	if (!sched_feat(LATENCY_SENSITIVE))
+		return 0;
+	if (p->latency_sensitive)
+		return 1;
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	return task_group(p)->latency_sensitive;
+#else
+	return 0;
+#endif
+}
+
+static inline void
+update_stats_latency_wake(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+#ifdef CONFIG_SCHEDSTATS
+	if (entity_is_task(se) && task_latency_sensitive(task_of(se)))
+		se->statistics.latency_wake_start = rq_of(cfs_rq)->clock;
+#endif
+}
+
+static inline void
+update_stats_latency_run(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+#ifdef CONFIG_SCHEDSTATS
+	struct rq *rq = rq_of(cfs_rq);
+	u64 delta;
+
+	if (!se->statistics.latency_wake_start)
+		return;
+
+	delta = rq->clock - se->statistics.latency_wake_start;
+	se->statistics.latency_wake_start = 0;
+	if ((s64)delta < 0)
+		return;
+
+	rq->lat_wake_count++;
+	rq->lat_wake_sum += delta;
+	rq->lat_wake_max = max(rq->lat_wake_max, delta);
+#endif
+}
+
 static inline void
 update_stats_wait_start(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
@@ -1103,6 +1232,7 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	if (flags & ENQUEUE_WAKEUP) {
 		place_entity(cfs_rq, se, 0);
 		enqueue_sleeper(cfs_rq, se);
+		update_stats_latency_wake(cfs_rq, se);
 	}
 
 	update_stats_enqueue(cfs_rq, se);
@@ -1260,10 +1390,15 @@ set_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 		 * runqueue.
 		 */
 		update_stats_wait_end(cfs_rq, se);
+		update_stats_latency_run(cfs_rq, se);
 		__dequeue_entity(cfs_rq, se);
 	}
 
 	update_stats_curr_start(cfs_rq, se);
+	update_entity_util(se, rq_of(cfs_rq)->clock_task, 0);
+	/* the time since the last fair task ran was idle or another class */
+	if (entity_is_task(se))
+		update_rq_util(rq_of(cfs_rq), 0);
 	cfs_rq->curr = se;
 #ifdef CONFIG_SCHEDSTATS
 	/*
@@ -2677,10 +2812,190 @@ next:
 			sg = sg->next;
 		} while (sg != sd->groups);
 	}
+
+	/*
+	 * No idle group: a latency sensitive task still takes any idle
+	 * allowed cpu sharing the cache rather than queue behind the
+	 * target's current task.
+	 */
+	if (task_latency_sensitive(p) && !idle_cpu(target)) {
+		sd = rcu_dereference(per_cpu(sd_llc, target));
+		if (sd) {
+			for_each_cpu_and(i, sched_domain_span(sd),
+					 tsk_cpus_allowed(p)) {
+				if (idle_cpu(i)) {
+					target = i;
+					break;
+				}
+			}
+		}
+	}
 done:
 	return target;
 }
 
+/*
+ * Task packing: while the fair utilization of all active cpus is below
+ * sysctl_sched_packing_util (SCHED_UTIL_SCALE is one busy cpu), wakeups of
+ * tasks at or below sysctl_sched_packing_task_util go to the lowest
+ * numbered cpu that stays under PACKING_CPU_UTIL, and idle cpus do not
+ * pull work.  The other cpus stay idle long enough for cluster power-down,
+ * and cpuquiet, which takes the highest and least loaded cpus offline
+ * first, sees them idle.  sysctl_sched_packing_util = 0 turns it off.
+ */
+unsigned int sysctl_sched_packing_util = SCHED_UTIL_SCALE;
+unsigned int sysctl_sched_packing_task_util = SCHED_UTIL_SCALE / 4;
+
+#define PACKING_CPU_UTIL	(SCHED_UTIL_SCALE * 8 / 10)
+
+static unsigned int decayed_util(u32 util, u64 last_update, u64 now)
+{
+	if ((s64)(now - last_update) > 0)
+		util = util_decay(util, (now - last_update) >> UTIL_PERIOD_SHIFT);
+	return util;
+}
+
+static unsigned int cpu_packing_util(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	return decayed_util(ACCESS_ONCE(rq->cfs_util_avg),
+			    ACCESS_ONCE(rq->cfs_util_last_update),
+			    sched_clock_cpu(cpu));
+}
+
+static unsigned int task_packing_util(struct task_struct *p)
+{
+	struct sched_entity *se = &p->se;
+
+	return decayed_util(ACCESS_ONCE(se->util_avg),
+			    ACCESS_ONCE(se->util_last_update),
+			    sched_clock_cpu(task_cpu(p)));
+}
+
+static unsigned int packing_total_util(void)
+{
+	unsigned int total = 0;
+	int i;
+
+	for_each_cpu(i, cpu_active_mask)
+		total += cpu_packing_util(i);
+
+	return total;
+}
+
+/*
+ * Number of cpus the fair load fits on while packing is in effect, 0 when
+ * it is not.  Used by cpuquiet governors to size the online core count.
+ */
+unsigned int sched_packing_cpus(void)
+{
+	unsigned int total;
+
+	if (!sysctl_sched_packing_util)
+		return 0;
+
+	total = packing_total_util();
+	if (total > sysctl_sched_packing_util)
+		return 0;
+
+	return max(DIV_ROUND_UP(total, PACKING_CPU_UTIL), 1U);
+}
+EXPORT_SYMBOL(sched_packing_cpus);
+
+/*
+ * Called from scheduler_tick() with the rq locked. The fair utilization
+ * is brought up to date for whichever class is running, the runnable
+ * average takes the mean nr_running since the previous update, exact
+ * from nr_running_integral, and decays the rest.
+ */
+void update_rq_demand(struct rq *rq)
+{
+	u64 now = rq->clock_task;
+	u64 integral, delta, periods;
+	unsigned int level, avg;
+
+	update_rq_util(rq, rq->curr->sched_class == &fair_sched_class &&
+		       rq->curr != rq->idle);
+
+	delta = now - rq->demand_stamp;
+	if ((s64)delta < 0) {
+		rq->demand_stamp = now;
+		return;
+	}
+
+	periods = delta >> UTIL_PERIOD_SHIFT;
+	if (!periods)
+		return;
+
+	integral = do_nr_running_integral(rq);
+	level = div64_u64(integral - rq->demand_integral, delta);
+	level = (level * SCHED_UTIL_SCALE) >> FSHIFT;
+
+	avg = util_decay(rq->nr_running_avg, periods) +
+		level - util_decay(level, periods);
+
+	write_seqcount_begin(&rq->ave_seqcnt);
+	rq->nr_running_avg = avg;
+	rq->demand_stamp = now;
+	rq->demand_integral = integral;
+	write_seqcount_end(&rq->ave_seqcnt);
+}
+
+/*
+ * Lockless read of a cpu's demand for governors: a couple of loads and no
+ * sampling state of their own.
+ */
+void sched_get_cpu_demand(int cpu, struct sched_cpu_demand *demand)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned int seq, nr, avg;
+	u64 stamp;
+
+	do {
+		seq = read_seqcount_begin(&rq->ave_seqcnt);
+		nr = rq->nr_running;
+		avg = rq->nr_running_avg;
+		stamp = rq->demand_stamp;
+	} while (read_seqcount_retry(&rq->ave_seqcnt, seq));
+
+	/* nothing runs on a cpu that stopped its tick */
+	if (!nr)
+		avg = decayed_util(avg, stamp, sched_clock_cpu(cpu));
+
+	demand->nr_running = nr;
+	demand->nr_running_avg = avg;
+	demand->util = cpu_packing_util(cpu);
+}
+EXPORT_SYMBOL(sched_get_cpu_demand);
+
+static int select_packing_cpu(struct task_struct *p, int prev_cpu)
+{
+	unsigned int util, cpu_util;
+	int i;
+
+	if (!sysctl_sched_packing_util || task_latency_sensitive(p))
+		return -1;
+
+	util = task_packing_util(p);
+	if (util > sysctl_sched_packing_task_util)
+		return -1;
+
+	if (packing_total_util() > sysctl_sched_packing_util)
+		return -1;
+
+	for_each_cpu_and(i, cpu_active_mask, tsk_cpus_allowed(p)) {
+		cpu_util = cpu_packing_util(i);
+		/* prev_cpu's average still holds the task's own history */
+		if (i != prev_cpu)
+			cpu_util += util;
+		if (cpu_util <= PACKING_CPU_UTIL)
+			return i;
+	}
+
+	return -1;
+}
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -2707,6 +3022,10 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 		return prev_cpu;
 
 	if (sd_flag & SD_BALANCE_WAKE) {
+		new_cpu = select_packing_cpu(p, prev_cpu);
+		if (new_cpu >= 0)
+			return new_cpu;
+
 		if (cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
 			want_affine = 1;
 		new_cpu = prev_cpu;
@@ -2898,6 +3217,7 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	struct cfs_rq *cfs_rq = task_cfs_rq(curr);
 	int scale = cfs_rq->nr_running >= sched_nr_latency;
 	int next_buddy_marked = 0;
+	int ret;
 
 	if (unlikely(se == pse))
 		return;
@@ -2944,7 +3264,17 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	find_matching_se(&se, &pse);
 	update_curr(cfs_rq_of(se));
 	BUG_ON(!pse);
-	if (wakeup_preempt_entity(se, pse) == 1) {
+	ret = wakeup_preempt_entity(se, pse);
+	/*
+	 * A latency sensitive task preempts as soon as it is owed time,
+	 * without the wakeup granularity.  It still has to be behind curr
+	 * in vruntime, so fairness (and RT, which is never preempted here)
+	 * is untouched.
+	 */
+	if (ret == 0 && task_latency_sensitive(p) &&
+	    !task_latency_sensitive(curr))
+		ret = 1;
+	if (ret == 1) {
 		/*
 		 * Bias pick_next to pick the sched entity that is
 		 * triggering this preemption.
@@ -4416,6 +4746,10 @@ static int load_balance(int this_cpu, struct rq *this_rq,
 
 	schedstat_inc(sd, lb_count[idle]);
 
+	/* do not spread what wakeup placement packed */
+	if (idle != CPU_NOT_IDLE && sched_packing_cpus())
+		goto out_balanced;
+
 redo:
 	group = find_busiest_group(sd, this_cpu, &imbalance, idle,
 				   cpus, balance);
@@ -5567,6 +5901,53 @@ void print_cfs_stats(struct seq_file *m, int cpu)
 }
 #endif
 
+/*
+ * Sum the utilization of every fair task at or above threshold (in
+ * SCHED_UTIL_SCALE units) and count them. This walks all threads, so it
+ * is meant for governors sampling every few tens of milliseconds.
+ */
+unsigned int sched_heavy_task_util(unsigned int threshold,
+				   unsigned int *nr_heavy)
+{
+	struct task_struct *g, *p;
+	unsigned int sum = 0, nr = 0;
+
+	rcu_read_lock();
+	do_each_thread(g, p) {
+		struct sched_entity *se = &p->se;
+		unsigned int util;
+		u64 now;
+
+		if (p->sched_class != &fair_sched_class)
+			continue;
+
+		util = ACCESS_ONCE(se->util_avg);
+		if (!util)
+			continue;
+
+		/* nothing has decayed a task that is not running */
+		if (!task_curr(p)) {
+			now = cpu_rq(task_cpu(p))->clock_task;
+			if ((s64)(now - se->util_last_update) > 0)
+				util = util_decay(util,
+					(now - se->util_last_update) >>
+					UTIL_PERIOD_SHIFT);
+		}
+
+		if (util >= threshold) {
+			sum += util;
+			nr++;
+		}
+	} while_each_thread(g, p);
+	rcu_read_unlock();
+
+	if (nr_heavy)
+		*nr_heavy = nr;
+
+	return sum;
+}
+EXPORT_SYMBOL(sched_heavy_task_util);
+
 __init void init_sched_fair_class(void)
 {
 #ifdef CONFIG_SMP
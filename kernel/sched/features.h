@@ -40,9 +40,14 @@ SCHED_FEAT(LAST_BUDDY, true)
 SCHED_FEAT(CACHE_HOT_BUDDY, true)
 
 /*
- * Use arch dependent cpu power functions
+ * Use arch dependent cpu power functions; on by default where the arch
+ * power only reflects how fast its cpus are.
  */
+#ifdef CONFIG_ARM_CPU_TOPOLOGY
+SCHED_FEAT(ARCH_POWER, true)
+#else
 SCHED_FEAT(ARCH_POWER, false)
+#endif
 
 SCHED_FEAT(HRTICK, false)
 SCHED_FEAT(DOUBLE_TICK, false)
@@ -66,6 +71,13 @@ SCHED_FEAT(NONTASK_POWER, true)
  */
 SCHED_FEAT(TTWU_QUEUE, true)
 
+/*
+ * Let latency sensitive tasks (prctl or cpu cgroup) preempt on wakeup
+ * without the wakeup granularity and look for an idle cpu in the cache
+ * domain when the wakeup target is busy.
+ */
+SCHED_FEAT(LATENCY_SENSITIVE, true)
+
 SCHED_FEAT(FORCE_SD_OVERLAP, false)
 SCHED_FEAT(RT_RUNTIME_SHARE, false)
 SCHED_FEAT(LB_MIN, false)
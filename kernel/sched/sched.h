@@ -110,6 +110,7 @@ struct task_group {
 	/* runqueue "owned" by this group on each cpu */
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
+	int latency_sensitive;
 
 	atomic_t load_weight;
 #endif
@@ -423,6 +424,15 @@ struct rq {
 	u64 age_stamp;
 	u64 idle_stamp;
 	u64 avg_idle;
+
+	/* fair class busy time, decayed like sched_entity::util_avg */
+	u64 cfs_util_last_update;
+	u32 cfs_util_avg;
+
+	/* decayed nr_running, folded in from nr_running_integral each tick */
+	u64 demand_stamp;
+	u64 demand_integral;
+	u32 nr_running_avg;
 #endif
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -463,6 +473,11 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+
+	/* wake-to-run latency of latency sensitive tasks */
+	unsigned int lat_wake_count;
+	u64 lat_wake_sum;
+	u64 lat_wake_max;
 #endif
 
 #ifdef CONFIG_SMP
@@ -959,6 +974,12 @@ static inline void dec_nr_running(struct rq *rq)
 
 extern void update_rq_clock(struct rq *rq);
 
+#ifdef CONFIG_SMP
+extern void update_rq_demand(struct rq *rq);
+#else
+static inline void update_rq_demand(struct rq *rq) { }
+#endif
+
 extern void activate_task(struct rq *rq, struct task_struct *p, int flags);
 extern void deactivate_task(struct rq *rq, struct task_struct *p, int flags);
 
@@ -1979,6 +1979,16 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 			error = put_user(me->signal->is_child_subreaper,
 					 (int __user *) arg2);
 			break;
+		case PR_SET_LATENCY_SENSITIVE:
+			if (arg4 | arg5)
+				return -EINVAL;
+			error = sched_setlatency(arg3, arg2);
+			break;
+		case PR_GET_LATENCY_SENSITIVE:
+			if (arg2 | arg4 | arg5)
+				return -EINVAL;
+			error = sched_getlatency(arg3);
+			break;
 		default:
 			error = -EINVAL;
 			break;
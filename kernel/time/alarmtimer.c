@@ -196,6 +196,23 @@ static enum hrtimer_restart alarmtimer_fired(struct hrtimer *timer)
 }
 
 #ifdef CONFIG_RTC_CLASS
+/* time to the soonest alarm, as seen by the last alarmtimer_suspend() */
+static ktime_t alarmtimer_sleep_length;
+
+/**
+ * alarmtimer_get_sleep_length - How long the system is expected to sleep
+ *
+ * Returns the time until the alarm that will wake the system from the
+ * suspend in progress, or 0 if no alarm is armed. Only meaningful after
+ * the alarmtimer device has been suspended, e.g. from platform suspend
+ * callbacks.
+ */
+ktime_t alarmtimer_get_sleep_length(void)
+{
+	return alarmtimer_sleep_length;
+}
+EXPORT_SYMBOL_GPL(alarmtimer_get_sleep_length);
+
 /**
  * alarmtimer_suspend - Suspend time callback
  * @dev: unused
@@ -215,6 +232,8 @@ static int alarmtimer_suspend(struct device *dev)
 	int i;
 	int ret;
 
+	alarmtimer_sleep_length = ktime_set(0, 0);
+
 	spin_lock_irqsave(&freezer_delta_lock, flags);
 	min = freezer_delta;
 	freezer_delta = ktime_set(0, 0);
@@ -243,6 +262,8 @@ static int alarmtimer_suspend(struct device *dev)
 	if (min.tv64 == 0)
 		return 0;
 
+	alarmtimer_sleep_length = min;
+
 	if (ktime_to_ns(min) < 2 * NSEC_PER_SEC) {
 		__pm_wakeup_event(ws, 2 * MSEC_PER_SEC);
 		return -EBUSY;
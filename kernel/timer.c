@@ -728,7 +728,8 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	cpu = smp_processor_id();
 
 #if defined(CONFIG_NO_HZ) && defined(CONFIG_SMP)
-	if (!pinned && get_sysctl_timer_migration() && idle_cpu(cpu))
+	if (!pinned && get_sysctl_timer_migration() &&
+	    (idle_cpu(cpu) || !cpu_active(cpu)))
 		cpu = get_nohz_timer_target();
 #endif
 	new_base = per_cpu(tvec_bases, cpu);
@@ -757,6 +758,15 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 		base->next_timer = timer->expires;
 	internal_add_timer(base, timer);
 
+#if defined(CONFIG_NO_HZ) && defined(CONFIG_SMP)
+	/*
+	 * The timer may have been moved off a parked CPU onto an idle one
+	 * whose tick is stopped beyond it.
+	 */
+	if (base == new_base && timer->expires == base->next_timer)
+		wake_up_idle_cpu(cpu);
+#endif
+
 out_unlock:
 	spin_unlock_irqrestore(&base->lock, flags);
 
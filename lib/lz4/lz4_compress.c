@@ -0,0 +1,119 @@
+/*
+ * LZ4 - Fast LZ compression algorithm, block format compressor
+ *
+ * Greedy single-pass compressor emitting the LZ4 block format, see
+ * http://code.google.com/p/lz4/ for the format description.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+static inline u32 lz4_hash(const unsigned char *p)
+{
+	return (LZ4_READ32(p) * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/* encode a length continuation: runs of 255 terminated by a smaller byte */
+static inline unsigned char *lz4_put_length(unsigned char *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = (unsigned char)len;
+
+	return op;
+}
+
+static inline unsigned char *lz4_put_literals(unsigned char *op,
+		unsigned char *token, const unsigned char *anchor, size_t len)
+{
+	if (len >= RUN_MASK) {
+		*token = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, len - RUN_MASK);
+	} else {
+		*token = len << ML_BITS;
+	}
+
+	memcpy(op, anchor, len);
+
+	return op + len;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	u32 *table = wrkmem;
+	const unsigned char *ip = src;
+	const unsigned char *anchor = src;
+	const unsigned char * const iend = src + src_len;
+	const unsigned char * const mflimit = iend - MFLIMIT;
+	const unsigned char * const matchlimit = iend - LASTLITERALS;
+	unsigned char *op = dst;
+	unsigned char *token;
+
+	if (src_len < MINLENGTH)
+		goto last_literals;
+
+	memset(table, 0, LZ4_MEM_COMPRESS);
+	table[lz4_hash(ip)] = 0;
+	ip++;
+
+	while (ip < mflimit) {
+		const unsigned char *ref;
+		size_t mlen;
+		u32 h = lz4_hash(ip);
+
+		/* an unset slot points at src, which the compare rejects */
+		ref = src + table[h];
+		table[h] = ip - src;
+
+		if (ref >= ip || ip - ref > MAX_DISTANCE ||
+		    LZ4_READ32(ref) != LZ4_READ32(ip)) {
+			ip++;
+			continue;
+		}
+
+		/* extend the match, keeping the last literals intact */
+		mlen = MINMATCH;
+		while (ip + mlen < matchlimit && ref[mlen] == ip[mlen])
+			mlen++;
+
+		token = op++;
+		op = lz4_put_literals(op, token, anchor, ip - anchor);
+
+		LZ4_WRITE_LE16(ip - ref, op);
+		op += 2;
+
+		mlen -= MINMATCH;
+		if (mlen >= ML_MASK) {
+			*token |= ML_MASK;
+			op = lz4_put_length(op, mlen - ML_MASK);
+		} else {
+			*token |= mlen;
+		}
+
+		ip += mlen + MINMATCH;
+		anchor = ip;
+
+		/* seed the table just behind the match end */
+		if (ip < mflimit)
+			table[lz4_hash(ip - 2)] = ip - 2 - src;
+	}
+
+last_literals:
+	token = op++;
+	op = lz4_put_literals(op, token, anchor, iend - anchor);
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 compressor");
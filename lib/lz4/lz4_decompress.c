@@ -0,0 +1,101 @@
+/*
+ * LZ4 - Fast LZ compression algorithm, block format decompressor
+ *
+ * Safe decompressor: every length and offset read from the input is
+ * checked against both buffers, so corrupt input cannot overrun them.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+/* read a length continuation, returns false on input overrun */
+static inline bool lz4_get_length(const unsigned char **ip,
+		const unsigned char *iend, size_t *len)
+{
+	unsigned int s;
+
+	do {
+		if (*ip >= iend)
+			return false;
+		s = *(*ip)++;
+		*len += s;
+	} while (s == 255);
+
+	return true;
+}
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	const unsigned char *ip = src;
+	const unsigned char * const iend = src + src_len;
+	unsigned char *op = dest;
+	unsigned char * const oend = dest + *dest_len;
+
+	while (ip < iend) {
+		unsigned int token = *ip++;
+		const unsigned char *ref;
+		size_t length, offset;
+
+		/* literals */
+		length = token >> ML_BITS;
+		if (length == RUN_MASK && !lz4_get_length(&ip, iend, &length))
+			goto _output_error;
+
+		if (length > (size_t)(iend - ip) ||
+		    length > (size_t)(oend - op))
+			goto _output_error;
+
+		memcpy(op, ip, length);
+		op += length;
+		ip += length;
+
+		/* the last sequence carries literals only */
+		if (ip == iend)
+			break;
+
+		/* match */
+		if (iend - ip < 2)
+			goto _output_error;
+		offset = LZ4_READ_LE16(ip);
+		ip += 2;
+
+		if (!offset || offset > (size_t)(op - dest))
+			goto _output_error;
+
+		length = token & ML_MASK;
+		if (length == ML_MASK && !lz4_get_length(&ip, iend, &length))
+			goto _output_error;
+		length += MINMATCH;
+
+		if (length > (size_t)(oend - op))
+			goto _output_error;
+
+		ref = op - offset;
+		if (offset >= length) {
+			memcpy(op, ref, length);
+			op += length;
+		} else {
+			/* overlapping match repeats the last 'offset' bytes */
+			while (length--)
+				*op++ = *ref++;
+		}
+	}
+
+	*dest_len = op - dest;
+	return 0;
+
+_output_error:
+	return -1;
+}
+EXPORT_SYMBOL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
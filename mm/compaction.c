@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #if defined CONFIG_COMPACTION || defined CONFIG_CMA
@@ -553,6 +555,18 @@ static isolate_migrate_t isolate_migratepages(struct zone *zone,
 	return ISOLATE_SUCCESS;
 }
 
+/* Free blocks of at least 2^order pages, counted in 2^order units */
+static unsigned long zone_free_blocks(struct zone *zone, int order)
+{
+	unsigned long nr = 0;
+	int o;
+
+	for (o = order; o < MAX_ORDER; o++)
+		nr += zone->free_area[o].nr_free << (o - order);
+
+	return nr;
+}
+
 static int compact_finished(struct zone *zone,
 			    struct compact_control *cc)
 {
@@ -566,6 +580,11 @@ static int compact_finished(struct zone *zone,
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
 
+	/* kcompactd: done once the zone holds enough free blocks */
+	if (cc->nr_blocks)
+		return zone_free_blocks(zone, cc->order) >= cc->nr_blocks ?
+			COMPACT_PARTIAL : COMPACT_CONTINUE;
+
 	/*
 	 * order == -1 is expected when compacting via
 	 * /proc/sys/vm/compact_memory
@@ -651,6 +670,10 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 	ret = compaction_suitable(zone, cc->order);
 	switch (ret) {
 	case COMPACT_PARTIAL:
+		/* one page of the order is not what kcompactd is after */
+		if (cc->nr_blocks)
+			break;
+		/* fall through */
 	case COMPACT_SKIPPED:
 		/* Compaction is likely to fail */
 		return ret;
@@ -874,6 +897,152 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * kcompactd keeps compact_daemon_blocks free blocks of
+ * compact_daemon_order in every zone, so that the order-2 to order-8
+ * allocations of nvmap, ion, USB and wifi rarely stall in direct
+ * compaction. It is woken by high-order allocations that enter the slow
+ * path and, every compact_daemon_interval ms, by a deferrable timer; the
+ * timer only leads to work while the cpus are nearly idle. It runs async
+ * at nice 19 and backs off while it cannot reach the target.
+ */
+int sysctl_compact_daemon_order = 4;
+int sysctl_compact_daemon_blocks = 32;
+int sysctl_compact_daemon_interval = 10000;
+
+#define KCOMPACTD_MAX_BACKOFF	4
+
+static struct task_struct *kcompactd_task;
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+static struct timer_list kcompactd_timer;
+static int kcompactd_kicked;
+static int kcompactd_tick;
+
+void wakeup_kcompactd(int order)
+{
+	if (!order || !sysctl_compact_daemon_blocks || !kcompactd_task)
+		return;
+
+	kcompactd_kicked = 1;
+	if (waitqueue_active(&kcompactd_wait))
+		wake_up_interruptible(&kcompactd_wait);
+}
+
+static void kcompactd_timer_fn(unsigned long data)
+{
+	kcompactd_tick = 1;
+	wake_up_interruptible(&kcompactd_wait);
+}
+
+/* less than half a runnable thread on average over the online cpus */
+static bool kcompactd_system_idle(void)
+{
+	struct sched_cpu_demand demand;
+	unsigned int nr = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		sched_get_cpu_demand(cpu, &demand);
+		nr += demand.nr_running_avg;
+	}
+
+	return nr < SCHED_UTIL_SCALE / 2;
+}
+
+/* Returns false if some zone is still short of blocks */
+static bool kcompactd_compact(int order, unsigned long nr_blocks)
+{
+	struct zone *zone;
+	bool ran = false, met = true;
+
+	for_each_populated_zone(zone) {
+		struct compact_control cc = {
+			.order = order,
+			.nr_blocks = nr_blocks,
+			.migratetype = MIGRATE_MOVABLE,
+			.zone = zone,
+			.sync = false,
+		};
+
+		if (zone_free_blocks(zone, order) >= nr_blocks)
+			continue;
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+		compact_zone(zone, &cc);
+		ran = true;
+
+		if (zone_free_blocks(zone, order) < nr_blocks)
+			met = false;
+
+		if (kthread_should_stop())
+			break;
+	}
+
+	if (ran) {
+		count_vm_event(KCOMPACTDRUN);
+		if (met)
+			count_vm_event(KCOMPACTDSUCCESS);
+	}
+
+	return met;
+}
+
+static int kcompactd(void *unused)
+{
+	unsigned int backoff = 0;
+
+	set_freezable();
+	set_user_nice(current, 19);
+	init_timer_deferrable(&kcompactd_timer);
+	kcompactd_timer.function = kcompactd_timer_fn;
+
+	while (!kthread_should_stop()) {
+		int order = clamp(sysctl_compact_daemon_order, 1, MAX_ORDER - 1);
+		unsigned long nr_blocks = max(sysctl_compact_daemon_blocks, 0);
+		int kicked;
+
+		mod_timer(&kcompactd_timer, jiffies + msecs_to_jiffies(
+			  max(sysctl_compact_daemon_interval, 100) << backoff));
+
+		wait_event_freezable(kcompactd_wait, kcompactd_kicked ||
+				     kcompactd_tick || kthread_should_stop());
+
+		kicked = xchg(&kcompactd_kicked, 0);
+		if (!xchg(&kcompactd_tick, 0) && !kicked)
+			continue;
+
+		/* while backing off, allocations do not force a run either */
+		if (!nr_blocks ||
+		    ((!kicked || backoff) && !kcompactd_system_idle()))
+			continue;
+
+		if (kcompactd_compact(order, nr_blocks))
+			backoff = 0;
+		else if (backoff < KCOMPACTD_MAX_BACKOFF)
+			backoff++;
+	}
+
+	del_timer_sync(&kcompactd_timer);
+
+	return 0;
+}
+
+static int __init kcompactd_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(kcompactd, NULL, "kcompactd");
+	if (IS_ERR(task)) {
+		pr_err("Failed to start kcompactd\n");
+		return PTR_ERR(task);
+	}
+	kcompactd_task = task;
+
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct device *dev,
 			struct device_attribute *attr,
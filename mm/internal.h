@@ -122,6 +122,7 @@ struct compact_control {
 	bool sync;			/* Synchronous migration */
 
 	int order;			/* order a direct compactor needs */
+	unsigned long nr_blocks;	/* kcompactd: free blocks of order */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
 };
@@ -98,6 +98,8 @@ enum mem_cgroup_events_index {
 	MEM_CGROUP_EVENTS_COUNT,	/* # of pages paged in/out */
 	MEM_CGROUP_EVENTS_PGFAULT,	/* # of page-faults */
 	MEM_CGROUP_EVENTS_PGMAJFAULT,	/* # of major page-faults */
+	MEM_CGROUP_EVENTS_SOFT_SCAN,	/* # of pages scanned over soft limit */
+	MEM_CGROUP_EVENTS_SOFT_STEAL,	/* # of pages reclaimed over soft limit */
 	MEM_CGROUP_EVENTS_NSTATS,
 };
 /*
@@ -1685,6 +1687,7 @@ static int mem_cgroup_soft_reclaim(struct mem_cgroup *root_memcg,
 	int loop = 0;
 	unsigned long excess;
 	unsigned long nr_scanned;
+	unsigned long nr_reclaimed;
 	struct mem_cgroup_reclaim_cookie reclaim = {
 		.zone = zone,
 		.priority = 0,
@@ -1718,8 +1721,14 @@ static int mem_cgroup_soft_reclaim(struct mem_cgroup *root_memcg,
 		}
 		if (!mem_cgroup_reclaimable(victim, false))
 			continue;
-		total += mem_cgroup_shrink_node_zone(victim, gfp_mask, false,
-						     zone, &nr_scanned);
+		nr_reclaimed = mem_cgroup_shrink_node_zone(victim, gfp_mask,
+							   false, zone,
+							   &nr_scanned);
+		this_cpu_add(victim->stat->events[MEM_CGROUP_EVENTS_SOFT_SCAN],
+			     nr_scanned);
+		this_cpu_add(victim->stat->events[MEM_CGROUP_EVENTS_SOFT_STEAL],
+			     nr_reclaimed);
+		total += nr_reclaimed;
 		*total_scanned += nr_scanned;
 		if (!res_counter_soft_limit_excess(&root_memcg->res))
 			break;
@@ -4046,6 +4055,8 @@ enum {
 	MCS_SWAP,
 	MCS_PGFAULT,
 	MCS_PGMAJFAULT,
+	MCS_SOFT_SCAN,
+	MCS_SOFT_STEAL,
 	MCS_INACTIVE_ANON,
 	MCS_ACTIVE_ANON,
 	MCS_INACTIVE_FILE,
@@ -4070,6 +4081,8 @@ struct {
 	{"swap", "total_swap"},
 	{"pgfault", "total_pgfault"},
 	{"pgmajfault", "total_pgmajfault"},
+	{"softlimit_scan", "total_softlimit_scan"},
+	{"softlimit_steal", "total_softlimit_steal"},
 	{"inactive_anon", "total_inactive_anon"},
 	{"active_anon", "total_active_anon"},
 	{"inactive_file", "total_inactive_file"},
@@ -4102,6 +4115,10 @@ mem_cgroup_get_local_stat(struct mem_cgroup *memcg, struct mcs_total_stat *s)
 	s->stat[MCS_PGFAULT] += val;
 	val = mem_cgroup_read_events(memcg, MEM_CGROUP_EVENTS_PGMAJFAULT);
 	s->stat[MCS_PGMAJFAULT] += val;
+	val = mem_cgroup_read_events(memcg, MEM_CGROUP_EVENTS_SOFT_SCAN);
+	s->stat[MCS_SOFT_SCAN] += val;
+	val = mem_cgroup_read_events(memcg, MEM_CGROUP_EVENTS_SOFT_STEAL);
+	s->stat[MCS_SOFT_STEAL] += val;
 
 	/* per zone stat */
 	val = mem_cgroup_nr_lru_pages(memcg, BIT(LRU_INACTIVE_ANON));
@@ -16,10 +16,15 @@
 #include <linux/pagemap.h>
 #include <linux/swap.h>
 #include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/slab.h>
 #include <linux/swapops.h>
 #include <linux/writeback.h>
 #include <asm/pgtable.h>
 
+/* most pages one batched swap-out bio carries */
+#define SWAP_BATCH_PAGES	32
+
 static struct bio *get_swap_bio(gfp_t gfp_flags,
 				struct page *page, bio_end_io_t end_io)
 {
@@ -43,26 +48,35 @@ static struct bio *get_swap_bio(gfp_t gfp_flags,
 static void end_swap_bio_write(struct bio *bio, int err)
 {
 	const int uptodate = test_bit(BIO_UPTODATE, &bio->bi_flags);
-	struct page *page = bio->bi_io_vec[0].bv_page;
+	struct bio_vec *bvec;
+	int i;
 
-	if (!uptodate) {
-		SetPageError(page);
-		/*
-		 * We failed to write the page out to swap-space.
-		 * Re-dirty the page in order to avoid it being reclaimed.
-		 * Also print a dire warning that things will go BAD (tm)
-		 * very quickly.
-		 *
-		 * Also clear PG_reclaim to avoid rotate_reclaimable_page()
-		 */
-		set_page_dirty(page);
-		printk(KERN_ALERT "Write-error on swap-device (%u:%u:%Lu)\n",
-				imajor(bio->bi_bdev->bd_inode),
-				iminor(bio->bi_bdev->bd_inode),
-				(unsigned long long)bio->bi_sector);
-		ClearPageReclaim(page);
+	/* batched swap-out bios carry more than one page */
+	__bio_for_each_segment(bvec, bio, i, 0) {
+		struct page *page = bvec->bv_page;
+
+		if (!uptodate) {
+			SetPageError(page);
+			/*
+			 * We failed to write the page out to swap-space.
+			 * Re-dirty the page in order to avoid it being
+			 * reclaimed. Also print a dire warning that things
+			 * will go BAD (tm) very quickly.
+			 *
+			 * Also clear PG_reclaim to avoid
+			 * rotate_reclaimable_page()
+			 */
+			set_page_dirty(page);
+			printk(KERN_ALERT "Write-error on swap-device "
+					"(%u:%u:%Lu)\n",
+					imajor(bio->bi_bdev->bd_inode),
+					iminor(bio->bi_bdev->bd_inode),
+					(unsigned long long)bio->bi_sector +
+					(i << (PAGE_SHIFT - 9)));
+			ClearPageReclaim(page);
+		}
+		end_page_writeback(page);
 	}
-	end_page_writeback(page);
 	bio_put(bio);
 }
 
@@ -85,12 +99,124 @@ void end_swap_bio_read(struct bio *bio, int err)
 	bio_put(bio);
 }
 
+/*
+ * Swap-out to a device without seek cost (zram) is batched. While the
+ * reclaimer holds a plug, pages going to adjacent swap slots are added to
+ * one pending bio, which is submitted once a page does not follow it or the
+ * plug is flushed. The device then sees one request instead of one per page.
+ */
+struct swap_plug {
+	struct blk_plug_cb cb;
+	struct bio *bio;
+	struct work_struct work;
+};
+
+static void swap_plug_submit(struct swap_plug *sp)
+{
+	if (sp->bio) {
+		submit_bio(WRITE, sp->bio);
+		sp->bio = NULL;
+	}
+}
+
+static void swap_plug_work(struct work_struct *work)
+{
+	struct swap_plug *sp = container_of(work, struct swap_plug, work);
+
+	swap_plug_submit(sp);
+	kfree(sp);
+}
+
+static void swap_plug_unplug(struct blk_plug_cb *cb)
+{
+	struct swap_plug *sp = container_of(cb, struct swap_plug, cb);
+
+	/* flushed on the way into schedule(): the driver must not sleep */
+	if (sp->bio && current->state != TASK_RUNNING) {
+		INIT_WORK(&sp->work, swap_plug_work);
+		kblockd_schedule_work(bdev_get_queue(sp->bio->bi_bdev),
+				      &sp->work);
+		return;
+	}
+	swap_plug_submit(sp);
+	kfree(sp);
+}
+
+static struct swap_plug *swap_plug_get(void)
+{
+	struct blk_plug *plug = current->plug;
+	struct blk_plug_cb *cb;
+	struct swap_plug *sp;
+
+	if (!plug)
+		return NULL;
+
+	list_for_each_entry(cb, &plug->cb_list, list) {
+		if (cb->callback == swap_plug_unplug)
+			return container_of(cb, struct swap_plug, cb);
+	}
+
+	sp = kzalloc(sizeof(*sp), GFP_NOIO | __GFP_NOWARN);
+	if (!sp)
+		return NULL;
+	sp->cb.callback = swap_plug_unplug;
+	list_add(&sp->cb.list, &plug->cb_list);
+	return sp;
+}
+
+/*
+ * Adds the locked page to the plug's pending bio, false if it could not.
+ * Anything that sleeps may flush the plug and free the swap_plug, so it is
+ * looked up again afterwards.
+ */
+static bool swap_plug_add(struct page *page)
+{
+	struct swap_plug *sp = swap_plug_get();
+	struct block_device *bdev;
+	struct bio *bio;
+	sector_t sector;
+
+	if (!sp)
+		return false;
+
+	sector = map_swap_page(page, &bdev) << (PAGE_SHIFT - 9);
+	bio = sp->bio;
+	if (bio) {
+		if (bio->bi_bdev == bdev &&
+		    bio->bi_sector + (bio->bi_size >> 9) == sector &&
+		    bio_add_page(bio, page, PAGE_SIZE, 0) == PAGE_SIZE)
+			return true;
+		sp->bio = NULL;
+		submit_bio(WRITE, bio);
+	}
+
+	bio = bio_alloc(GFP_NOIO, SWAP_BATCH_PAGES);
+	if (!bio)
+		return false;
+	bio->bi_sector = sector;
+	bio->bi_bdev = bdev;
+	bio->bi_end_io = end_swap_bio_write;
+	if (bio_add_page(bio, page, PAGE_SIZE, 0) != PAGE_SIZE)
+		goto fail;
+
+	sp = swap_plug_get();
+	if (!sp)
+		goto fail;
+	sp->bio = bio;
+	return true;
+
+fail:
+	bio_put(bio);
+	return false;
+}
+
 /*
  * We may have stale swap cache pages in memory: notice
  * them here and get rid of the unnecessary final write.
  */
 int swap_writepage(struct page *page, struct writeback_control *wbc)
 {
+	swp_entry_t entry = { .val = page_private(page) };
 	struct bio *bio;
 	int ret = 0, rw = WRITE;
 
@@ -98,6 +224,14 @@ int swap_writepage(struct page *page, struct writeback_control *wbc)
 		unlock_page(page);
 		goto out;
 	}
+	if (wbc->sync_mode == WB_SYNC_ALL)
+		rw |= REQ_SYNC;
+	else if (swap_entry_noseek(entry) && swap_plug_add(page)) {
+		count_vm_event(PSWPOUT);
+		set_page_writeback(page);
+		unlock_page(page);
+		goto out;
+	}
 	bio = get_swap_bio(GFP_NOIO, page, end_swap_bio_write);
 	if (bio == NULL) {
 		set_page_dirty(page);
@@ -105,8 +239,6 @@ int swap_writepage(struct page *page, struct writeback_control *wbc)
 		ret = -ENOMEM;
 		goto out;
 	}
-	if (wbc->sync_mode == WB_SYNC_ALL)
-		rw |= REQ_SYNC;
 	count_vm_event(PSWPOUT);
 	set_page_writeback(page);
 	unlock_page(page);
@@ -0,0 +1,288 @@
+/*
+ * mm/readahead_replay.c - recorded readahead for application launch.
+ *
+ * Launching an app faults in scattered pieces of its apk, dex files and
+ * native libraries. The ondemand heuristics either read too little around
+ * each miss or read windows which are never used, and a cold launch ends up
+ * waiting on many small reads.
+ *
+ * Instead, the page cache misses a file takes during the first
+ * sysctl_readahead_record_ms after its first miss are recorded. When the
+ * file is cold again later (most of the recorded pages are gone from the
+ * page cache), its first miss replays the record: the recorded ranges are
+ * sorted, merged across small holes and submitted as large reads under one
+ * plug.
+ *
+ * Records are keyed by device and inode number so that they outlive the
+ * inode, and are dropped once the file's size or mtime changes.
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/list.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/jiffies.h>
+#include <linux/blkdev.h>
+#include <linux/vmstat.h>
+
+int sysctl_readahead_replay __read_mostly = 1;
+int sysctl_readahead_record_ms __read_mostly = 5000;
+
+#define RA_RECORD_HASH_BITS	6
+#define RA_RECORD_MAX		128	/* records kept, least recent dropped */
+#define RA_REPLAY_HOLE		8	/* pages: holes up to this are read too */
+
+struct ra_extent {
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct ra_record {
+	struct hlist_node hash;
+	struct list_head lru;
+	dev_t dev;
+	unsigned long ino;
+	loff_t size;
+	struct timespec mtime;
+	unsigned long start;		/* jiffies of the first miss */
+	unsigned long replayed;		/* jiffies of the last replay */
+	unsigned long pages;		/* pages covered by the extents */
+	unsigned int nr;
+	unsigned int users;		/* replays in flight */
+	bool ready;			/* recording finished */
+	bool dead;			/* dropped while in use */
+	struct ra_extent ext[0];
+};
+
+/* one page per record */
+#define RA_RECORD_EXTENTS \
+	((PAGE_SIZE - sizeof(struct ra_record)) / sizeof(struct ra_extent))
+
+static struct hlist_head ra_record_hash[1 << RA_RECORD_HASH_BITS];
+static LIST_HEAD(ra_record_lru);
+static unsigned int ra_record_count;
+static DEFINE_SPINLOCK(ra_record_lock);
+
+static inline struct hlist_head *ra_record_bucket(dev_t dev, unsigned long ino)
+{
+	return &ra_record_hash[hash_long(ino ^ dev, RA_RECORD_HASH_BITS)];
+}
+
+static struct ra_record *ra_record_find(struct inode *inode)
+{
+	dev_t dev = inode->i_sb->s_dev;
+	struct hlist_node *pos;
+	struct ra_record *r;
+
+	hlist_for_each_entry(r, pos, ra_record_bucket(dev, inode->i_ino),
+			     hash) {
+		if (r->dev == dev && r->ino == inode->i_ino)
+			return r;
+	}
+	return NULL;
+}
+
+static bool ra_record_stale(struct ra_record *r, struct inode *inode)
+{
+	return r->size != i_size_read(inode) ||
+		!timespec_equal(&r->mtime, &inode->i_mtime);
+}
+
+static void ra_record_drop(struct ra_record *r)
+{
+	hlist_del(&r->hash);
+	list_del(&r->lru);
+	ra_record_count--;
+	if (r->users)
+		r->dead = true;
+	else
+		kfree(r);
+}
+
+static void ra_record_insert(struct ra_record *r)
+{
+	if (ra_record_count >= RA_RECORD_MAX)
+		ra_record_drop(list_entry(ra_record_lru.prev,
+					  struct ra_record, lru));
+	hlist_add_head(&r->hash, ra_record_bucket(r->dev, r->ino));
+	list_add(&r->lru, &ra_record_lru);
+	ra_record_count++;
+}
+
+static int ra_extent_cmp(const void *a, const void *b)
+{
+	const struct ra_extent *l = a, *r = b;
+
+	if (l->start < r->start)
+		return -1;
+	return l->start > r->start;
+}
+
+/* sort the extents and merge those that overlap or are close */
+static void ra_record_finish(struct ra_record *r)
+{
+	unsigned int i, n = 0;
+
+	sort(r->ext, r->nr, sizeof(r->ext[0]), ra_extent_cmp, NULL);
+
+	r->pages = 0;
+	for (i = 0; i < r->nr; i++) {
+		struct ra_extent *e = &r->ext[i];
+
+		if (n) {
+			struct ra_extent *last = &r->ext[n - 1];
+			pgoff_t end = last->start + last->nr;
+
+			if (e->start <= end + RA_REPLAY_HOLE) {
+				if (e->start + e->nr > end)
+					last->nr = e->start + e->nr -
+						last->start;
+				continue;
+			}
+		}
+		r->ext[n++] = *e;
+	}
+	r->nr = n;
+
+	for (i = 0; i < n; i++)
+		r->pages += r->ext[i].nr;
+
+	r->ready = true;
+	r->replayed = jiffies;
+}
+
+static void ra_record_add(struct ra_record *r, pgoff_t offset,
+			  unsigned long nr)
+{
+	struct ra_extent *last = r->nr ? &r->ext[r->nr - 1] : NULL;
+
+	/* sequential misses extend the previous extent */
+	if (last && offset >= last->start &&
+	    offset <= last->start + last->nr) {
+		last->nr = max(last->nr, offset + nr - last->start);
+		return;
+	}
+
+	if (r->nr == RA_RECORD_EXTENTS) {
+		ra_record_finish(r);
+		return;
+	}
+
+	r->ext[r->nr].start = offset;
+	r->ext[r->nr].nr = nr;
+	r->nr++;
+}
+
+static struct ra_record *ra_record_alloc(struct inode *inode)
+{
+	struct ra_record *r;
+
+	BUILD_BUG_ON(sizeof(struct ra_record) >= PAGE_SIZE / 4);
+
+	r = kzalloc(PAGE_SIZE, GFP_NOFS | __GFP_NOWARN);
+	if (!r)
+		return NULL;
+
+	r->dev = inode->i_sb->s_dev;
+	r->ino = inode->i_ino;
+	r->size = i_size_read(inode);
+	r->mtime = inode->i_mtime;
+	r->start = jiffies;
+	return r;
+}
+
+static void ra_record_replay(struct ra_record *r,
+			     struct address_space *mapping, struct file *filp)
+{
+	struct blk_plug plug;
+	unsigned long pages = 0;
+	unsigned int i;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < r->nr; i++) {
+		int ret = force_page_cache_readahead(mapping, filp,
+						     r->ext[i].start,
+						     r->ext[i].nr);
+		if (ret < 0)
+			break;
+		pages += ret;
+	}
+	blk_finish_plug(&plug);
+
+	count_vm_event(READAHEAD_REPLAY);
+	count_vm_events(READAHEAD_REPLAY_PAGES, pages);
+}
+
+/**
+ * readahead_replay_miss - record or replay a page cache miss
+ * @mapping: address_space which took the miss
+ * @filp: file the miss was taken through
+ * @offset: first missing page
+ * @nr: number of pages the caller is after
+ *
+ * Called on a synchronous page cache miss, before the regular readahead
+ * runs. While @mapping's record is young the miss is added to it; once the
+ * record is complete and the file has gone cold, the record is replayed.
+ */
+void readahead_replay_miss(struct address_space *mapping, struct file *filp,
+			   pgoff_t offset, unsigned long nr)
+{
+	struct inode *inode = mapping->host;
+	unsigned long window = msecs_to_jiffies(sysctl_readahead_record_ms);
+	struct ra_record *r, *new = NULL;
+
+	if (!sysctl_readahead_replay || !inode || !S_ISREG(inode->i_mode))
+		return;
+
+again:
+	spin_lock(&ra_record_lock);
+	r = ra_record_find(inode);
+	if (r && ra_record_stale(r, inode)) {
+		ra_record_drop(r);
+		r = NULL;
+	}
+
+	if (!r) {
+		if (!new) {
+			spin_unlock(&ra_record_lock);
+			new = ra_record_alloc(inode);
+			if (!new)
+				return;
+			goto again;
+		}
+		r = new;
+		new = NULL;
+		ra_record_insert(r);
+	}
+	list_move(&r->lru, &ra_record_lru);
+
+	if (!r->ready) {
+		if (time_before(jiffies, r->start + window))
+			ra_record_add(r, offset, nr);
+		else
+			ra_record_finish(r);
+		goto out;
+	}
+
+	/* a replay only helps a file that is cold again */
+	if (time_before(jiffies, r->replayed + window) ||
+	    mapping->nrpages >= r->pages / 2)
+		goto out;
+
+	r->replayed = jiffies;
+	r->users++;
+	spin_unlock(&ra_record_lock);
+
+	ra_record_replay(r, mapping, filp);
+
+	spin_lock(&ra_record_lock);
+	if (!--r->users && r->dead)
+		kfree(r);
+out:
+	spin_unlock(&ra_record_lock);
+	kfree(new);
+}
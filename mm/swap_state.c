@@ -367,6 +367,10 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
  *
+ * Devices without seek cost (SWP_NOSEEK, e.g. zram) get no readahead at
+ * all: neighbouring slots are as cheap to read later, and reading them now
+ * only burns cpu on decompression.
+ *
  * Caller must hold down_read on the vma->vm_mm if vma is not NULL.
  */
 struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
@@ -377,6 +381,9 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	unsigned long start_offset, end_offset;
 	unsigned long mask = (1UL << page_cluster) - 1;
 
+	if (swap_entry_noseek(entry))
+		goto single;
+
 	/* Read a page_cluster sized and aligned cluster around offset. */
 	start_offset = offset & ~mask;
 	end_offset = offset | mask;
@@ -392,5 +399,6 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 		page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
+single:
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
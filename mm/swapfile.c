@@ -203,7 +203,9 @@ static unsigned long scan_swap_map(struct swap_info_struct *si,
 	scan_base = offset = si->cluster_next;
 
 	if (unlikely(!si->cluster_nr--)) {
-		if (si->pages - si->inuse_pages < SWAPFILE_CLUSTER) {
+		/* nothing to gain from a free cluster without seeks */
+		if (si->pages - si->inuse_pages < SWAPFILE_CLUSTER ||
+		    (si->flags & SWP_NOSEEK)) {
 			si->cluster_nr = SWAPFILE_CLUSTER - 1;
 			goto checks;
 		}
@@ -1328,6 +1330,15 @@ sector_t map_swap_page(struct page *page, struct block_device **bdev)
 	return map_swap_entry(entry, bdev);
 }
 
+/*
+ * Returns whether entry lives on a device without any seek cost, such as
+ * zram, where reading neighbouring slots ahead only costs cpu.
+ */
+int swap_entry_noseek(swp_entry_t entry)
+{
+	return swap_info[swp_type(entry)]->flags & SWP_NOSEEK;
+}
+
 /*
  * Free all of a swapdev's extent information
  */
@@ -2100,7 +2111,9 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 	}
 
 	if (p->bdev) {
-		if (blk_queue_nonrot(bdev_get_queue(p->bdev))) {
+		if (bdi_cap_no_seek(blk_get_backing_dev_info(p->bdev)))
+			p->flags |= SWP_SOLIDSTATE | SWP_NOSEEK;
+		else if (blk_queue_nonrot(bdev_get_queue(p->bdev))) {
 			p->flags |= SWP_SOLIDSTATE;
 			p->cluster_next = 1 + (random32() % p->highest_bit);
 		}
@@ -2119,7 +2132,8 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 			"Priority:%d extents:%d across:%lluk %s%s\n",
 		p->pages<<(PAGE_SHIFT-10), name, p->prio,
 		nr_extents, (unsigned long long)span<<(PAGE_SHIFT-10),
-		(p->flags & SWP_SOLIDSTATE) ? "SS" : "",
+		(p->flags & SWP_NOSEEK) ? "NS" :
+			(p->flags & SWP_SOLIDSTATE) ? "SS" : "",
 		(p->flags & SWP_DISCARDABLE) ? "D" : "");
 
 	mutex_unlock(&swapon_mutex);
@@ -434,11 +434,12 @@ EXPORT_SYMBOL(dec_zone_page_state);
  * with the global counters. These could cause remote node cache line
  * bouncing and will have to be only done when necessary.
  */
-void refresh_cpu_vm_stats(int cpu)
+static int __refresh_cpu_vm_stats(int cpu, bool may_sleep)
 {
 	struct zone *zone;
 	int i;
 	int global_diff[NR_VM_ZONE_STAT_ITEMS] = { 0, };
+	int changes = 0;
 
 	for_each_populated_zone(zone) {
 		struct per_cpu_pageset *p;
@@ -456,12 +457,14 @@ void refresh_cpu_vm_stats(int cpu)
 				local_irq_restore(flags);
 				atomic_long_add(v, &zone->vm_stat[i]);
 				global_diff[i] += v;
+				changes++;
 #ifdef CONFIG_NUMA
 				/* 3 seconds idle till flush */
 				p->expire = 3;
 #endif
 			}
-		cond_resched();
+		if (may_sleep)
+			cond_resched();
 #ifdef CONFIG_NUMA
 		/*
 		 * Deal with draining the remote pageset of this
@@ -482,6 +485,7 @@ void refresh_cpu_vm_stats(int cpu)
 		}
 
 		p->expire--;
+		changes++;
 		if (p->expire)
 			continue;
 
@@ -493,7 +497,37 @@ void refresh_cpu_vm_stats(int cpu)
 	for (i = 0; i < NR_VM_ZONE_STAT_ITEMS; i++)
 		if (global_diff[i])
 			atomic_long_add(global_diff[i], &vm_stat[i]);
+
+	return changes;
+}
+
+void refresh_cpu_vm_stats(int cpu)
+{
+	__refresh_cpu_vm_stats(cpu, true);
+}
+
+/*
+ * Returns the global counter with the differentials of all online cpus
+ * added in. It is exact up to updates racing with it, and costs a pass
+ * over every zone's pagesets: for callers like the low memory killer which
+ * decide on the value, not for statistics.
+ */
+unsigned long global_page_state_snapshot(enum zone_stat_item item)
+{
+	long x = atomic_long_read(&vm_stat[item]);
+	struct zone *zone;
+	int cpu;
+
+	for_each_populated_zone(zone) {
+		for_each_online_cpu(cpu)
+			x += per_cpu_ptr(zone->pageset, cpu)->vm_stat_diff[item];
+	}
+
+	if (x < 0)
+		x = 0;
+	return x;
 }
+EXPORT_SYMBOL(global_page_state_snapshot);
 
 #endif
 
@@ -767,6 +801,14 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_stall_us",
+	"compact_daemon_run",
+	"compact_daemon_success",
+#endif
+
+#ifdef CONFIG_READAHEAD_REPLAY
+	"readahead_replay",
+	"readahead_replay_pages",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -1142,13 +1184,79 @@ static const struct file_operations proc_vmstat_file_operations = {
 #endif /* CONFIG_PROC_FS */
 
 #ifdef CONFIG_SMP
+/*
+ * Each cpu folds its differentials from its own deferrable vmstat_work.
+ * A cpu whose differentials are all zero stops rearming the work and is
+ * put in vmstat_off_cpus; the shepherd, a single deferrable work, restarts
+ * it once it has differentials again. A cpu going idle folds what it has,
+ * so idle cpus are neither woken nor left with stale counters.
+ */
 static DEFINE_PER_CPU(struct delayed_work, vmstat_work);
+static struct cpumask vmstat_off_cpus;
 int sysctl_stat_interval __read_mostly = HZ;
 
+static void vmstat_shepherd(struct work_struct *w);
+static DECLARE_DEFERRED_WORK(shepherd, vmstat_shepherd);
+
 static void vmstat_update(struct work_struct *w)
 {
-	refresh_cpu_vm_stats(smp_processor_id());
-	schedule_delayed_work(&__get_cpu_var(vmstat_work),
+	int cpu = smp_processor_id();
+
+	if (__refresh_cpu_vm_stats(cpu, true))
+		schedule_delayed_work(&__get_cpu_var(vmstat_work),
+			round_jiffies_relative(sysctl_stat_interval));
+	else
+		cpumask_set_cpu(cpu, &vmstat_off_cpus);
+}
+
+/* whether cpu has differentials that are not folded yet */
+static bool need_update(int cpu)
+{
+	struct zone *zone;
+
+	for_each_populated_zone(zone) {
+		struct per_cpu_pageset *p = per_cpu_ptr(zone->pageset, cpu);
+
+		BUILD_BUG_ON(sizeof(p->vm_stat_diff[0]) != 1);
+		if (memchr_inv(p->vm_stat_diff, 0, NR_VM_ZONE_STAT_ITEMS))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Called from the idle loop with preemption disabled, before the tick is
+ * stopped: folds this cpu's differentials so that its vmstat_work finds
+ * nothing left and stops rearming.
+ */
+void quiet_vmstat(void)
+{
+	int cpu = smp_processor_id();
+
+	if (system_state != SYSTEM_RUNNING)
+		return;
+	if (cpumask_test_cpu(cpu, &vmstat_off_cpus))
+		return;
+	if (!need_update(cpu))
+		return;
+
+	__refresh_cpu_vm_stats(cpu, false);
+}
+
+static void vmstat_shepherd(struct work_struct *w)
+{
+	int cpu;
+
+	get_online_cpus();
+	for_each_cpu(cpu, &vmstat_off_cpus) {
+		if (need_update(cpu) &&
+		    cpumask_test_and_clear_cpu(cpu, &vmstat_off_cpus))
+			schedule_delayed_work_on(cpu,
+				&per_cpu(vmstat_work, cpu), 0);
+	}
+	put_online_cpus();
+
+	schedule_delayed_work(&shepherd,
 		round_jiffies_relative(sysctl_stat_interval));
 }
 
@@ -1156,6 +1264,7 @@ static void __cpuinit start_cpu_timer(int cpu)
 {
 	struct delayed_work *work = &per_cpu(vmstat_work, cpu);
 
+	cpumask_clear_cpu(cpu, &vmstat_off_cpus);
 	INIT_DELAYED_WORK_DEFERRABLE(work, vmstat_update);
 	schedule_delayed_work_on(cpu, work, __round_jiffies_relative(HZ, cpu));
 }
@@ -1181,6 +1290,7 @@ static int __cpuinit vmstat_cpuup_callback(struct notifier_block *nfb,
 	case CPU_DOWN_PREPARE_FROZEN:
 		cancel_delayed_work_sync(&per_cpu(vmstat_work, cpu));
 		per_cpu(vmstat_work, cpu).work.func = NULL;
+		cpumask_clear_cpu(cpu, &vmstat_off_cpus);
 		break;
 	case CPU_DOWN_FAILED:
 	case CPU_DOWN_FAILED_FROZEN:
@@ -1209,6 +1319,8 @@ static int __init setup_vmstat(void)
 
 	for_each_online_cpu(cpu)
 		start_cpu_timer(cpu);
+	schedule_delayed_work(&shepherd,
+		round_jiffies_relative(sysctl_stat_interval));
 #endif
 #ifdef CONFIG_PROC_FS
 	proc_create("buddyinfo", S_IRUGO, NULL, &fragmentation_file_operations);
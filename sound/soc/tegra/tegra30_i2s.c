@@ -1173,6 +1173,125 @@ static int configure_dam(struct tegra30_i2s  *i2s, int out_channel,
 }
 
 
+static int tegra30_i2s_dam_input(struct tegra30_i2s *i2s,
+				struct snd_pcm_substream *substream)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(i2s->dam_stream); i++)
+		if (i2s->dam_stream[i] == substream)
+			return i;
+	return -EINVAL;
+}
+
+int tegra30_i2s_dam_startup(struct tegra30_i2s *i2s,
+			struct snd_pcm_substream *substream)
+{
+	static const int inputs[] = {
+		TEGRA30_DAM_CHIN1, TEGRA30_DAM_CHIN0_SRC,
+	};
+	int i, chin = -ENOENT;
+
+	if ((substream->stream != SNDRV_PCM_STREAM_PLAYBACK) ||
+		!i2s->is_dam_used)
+		return 0;
+
+	if (!i2s->dam_ch_refcount)
+		i2s->dam_ifc = tegra30_dam_allocate_controller();
+	if (i2s->dam_ifc < 0)
+		return -ENOENT;
+
+	/* the input without converter first: it runs at the I2S rate */
+	for (i = 0; i < ARRAY_SIZE(inputs); i++) {
+		if (!tegra30_dam_allocate_channel(i2s->dam_ifc, inputs[i])) {
+			chin = inputs[i];
+			break;
+		}
+	}
+	if (chin < 0) {
+		if (!i2s->dam_ch_refcount)
+			tegra30_dam_free_controller(i2s->dam_ifc);
+		return chin;
+	}
+
+	i2s->dam_stream[chin] = substream;
+	i2s->dam_ch_refcount++;
+	tegra30_dam_enable_clock(i2s->dam_ifc);
+	tegra30_dam_set_gain(i2s->dam_ifc, chin, 0x1000);
+
+	tegra30_ahub_set_rx_cif_source(TEGRA30_AHUB_RXCIF_DAM0_RX0 +
+			(i2s->dam_ifc*2) + chin, i2s->txcif);
+
+	/* the DAM feeds the I2S while any stream is mixed */
+	if (i2s->dam_ch_refcount == 1)
+		tegra30_ahub_set_rx_cif_source(
+			TEGRA30_AHUB_RXCIF_I2S0_RX0 + i2s->id,
+			TEGRA30_AHUB_TXCIF_DAM0_TX0 + i2s->dam_ifc);
+
+	tegra30_dam_enable(i2s->dam_ifc, TEGRA30_DAM_ENABLE, chin);
+	return 0;
+}
+
+int tegra30_i2s_dam_hw_params(struct tegra30_i2s *i2s,
+			struct snd_pcm_substream *substream,
+			int rate, int channels, int bit_size)
+{
+	int chin = tegra30_i2s_dam_input(i2s, substream);
+	int out_rate;
+
+	if (chin < 0)
+		return 0;
+
+	if (!i2s->dam_out_rate || !i2s->dam_stream[!chin])
+		i2s->dam_out_rate = rate;
+	out_rate = i2s->dam_out_rate;
+
+	/* only input 0 has a sample rate converter */
+	if ((rate != out_rate) && (chin != TEGRA30_DAM_CHIN0_SRC))
+		return -EINVAL;
+
+	tegra30_dam_set_samplerate(i2s->dam_ifc, TEGRA30_DAM_CHOUT, out_rate);
+	tegra30_dam_set_samplerate(i2s->dam_ifc, chin, rate);
+	tegra30_dam_set_acif(i2s->dam_ifc, chin,
+		channels, bit_size, channels, bit_size);
+	tegra30_dam_set_acif(i2s->dam_ifc, TEGRA30_DAM_CHOUT,
+		channels, bit_size, channels, bit_size);
+
+#ifndef CONFIG_ARCH_TEGRA_3x_SOC
+	if (rate != out_rate) {
+		tegra30_dam_write_coeff_ram(i2s->dam_ifc, rate, out_rate);
+		tegra30_dam_set_farrow_param(i2s->dam_ifc, rate, out_rate);
+		tegra30_dam_set_biquad_fixed_coef(i2s->dam_ifc);
+		tegra30_dam_enable_coeff_ram(i2s->dam_ifc);
+		tegra30_dam_set_filter_stages(i2s->dam_ifc, rate, out_rate);
+	}
+#endif
+
+	return 0;
+}
+
+void tegra30_i2s_dam_shutdown(struct tegra30_i2s *i2s,
+			struct snd_pcm_substream *substream)
+{
+	int chin = tegra30_i2s_dam_input(i2s, substream);
+
+	if (chin < 0)
+		return;
+
+	tegra30_dam_enable(i2s->dam_ifc, TEGRA30_DAM_DISABLE, chin);
+	tegra30_ahub_unset_rx_cif_source(TEGRA30_AHUB_RXCIF_DAM0_RX0 +
+			(i2s->dam_ifc*2) + chin);
+
+	tegra30_dam_disable_clock(i2s->dam_ifc);
+	tegra30_dam_free_channel(i2s->dam_ifc, chin);
+	i2s->dam_stream[chin] = NULL;
+	i2s->dam_ch_refcount--;
+	if (!i2s->dam_ch_refcount) {
+		tegra30_dam_free_controller(i2s->dam_ifc);
+		i2s->dam_out_rate = 0;
+	}
+}
+
 int tegra30_make_voice_call_connections(struct codec_config *codec_info,
 				struct codec_config *bb_info,
 				int uses_voice_codec)
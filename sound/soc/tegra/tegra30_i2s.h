@@ -283,6 +283,10 @@ struct tegra30_i2s {
 	int call_record_dam_ifc2;
 	int is_call_mode_rec;
 
+	/* playback streams mixed by the DAM, one per DAM input */
+	struct snd_pcm_substream *dam_stream[2];
+	int dam_out_rate;
+
 	struct dsp_config_t dsp_config;
 };
 
@@ -296,6 +300,19 @@ struct codec_config {
 	int bit_clk;
 };
 
+/*
+ * Playback mixing through the I2S's DAM, for machine drivers that set
+ * is_dam_used: call from the dai_link startup, hw_params and shutdown.
+ * The first stream sets the I2S rate; later ones are converted to it.
+ */
+int tegra30_i2s_dam_startup(struct tegra30_i2s *i2s,
+			struct snd_pcm_substream *substream);
+int tegra30_i2s_dam_hw_params(struct tegra30_i2s *i2s,
+			struct snd_pcm_substream *substream,
+			int rate, int channels, int bit_size);
+void tegra30_i2s_dam_shutdown(struct tegra30_i2s *i2s,
+			struct snd_pcm_substream *substream);
+
 int tegra30_make_voice_call_connections(struct codec_config *codec_info,
 			struct codec_config *bb_info,
 			int uses_voice_codec);
@@ -91,25 +91,6 @@ struct tegra_max98095 {
 };
 
 
-#ifndef CONFIG_ARCH_TEGRA_2x_SOC
-static int tegra_max98095_set_dam_cif(int dam_ifc, int srate,
-			int channels, int bit_size)
-{
-	tegra30_dam_set_samplerate(dam_ifc, TEGRA30_DAM_CHOUT,
-				srate);
-	tegra30_dam_set_samplerate(dam_ifc, TEGRA30_DAM_CHIN1,
-				srate);
-	tegra30_dam_set_acif(dam_ifc, TEGRA30_DAM_CHIN1,
-		channels, bit_size, channels,
-				bit_size);
-	tegra30_dam_set_acif(dam_ifc, TEGRA30_DAM_CHOUT,
-		channels, bit_size, channels,
-				bit_size);
-
-	return 0;
-}
-#endif
-
 static int tegra_max98095_hw_params(struct snd_pcm_substream *substream,
 					struct snd_pcm_hw_params *params)
 {
@@ -213,9 +194,10 @@ static int tegra_max98095_hw_params(struct snd_pcm_substream *substream,
 	}
 
 #ifndef CONFIG_ARCH_TEGRA_2x_SOC
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
-		tegra_max98095_set_dam_cif(i2s->dam_ifc, srate,
+	err = tegra30_i2s_dam_hw_params(i2s, substream, srate,
 				params_channels(params), sample_size);
+	if (err < 0)
+		return err;
 #endif
 
 	return 0;
@@ -282,67 +264,17 @@ static int tegra_hw_free(struct snd_pcm_substream *substream)
 static int tegra_max98095_startup(struct snd_pcm_substream *substream)
 {
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
-	struct snd_soc_dai *cpu_dai = rtd->cpu_dai;
-	struct tegra30_i2s *i2s = snd_soc_dai_get_drvdata(cpu_dai);
-
-	if ((substream->stream != SNDRV_PCM_STREAM_PLAYBACK) ||
-		!(i2s->is_dam_used))
-		return 0;
-
-	/*dam configuration*/
-	if (!i2s->dam_ch_refcount)
-		i2s->dam_ifc = tegra30_dam_allocate_controller();
-
-	tegra30_dam_allocate_channel(i2s->dam_ifc, TEGRA30_DAM_CHIN1);
-	i2s->dam_ch_refcount++;
-	tegra30_dam_enable_clock(i2s->dam_ifc);
-	tegra30_dam_set_gain(i2s->dam_ifc, TEGRA30_DAM_CHIN1, 0x1000);
-
-	tegra30_ahub_set_rx_cif_source(TEGRA30_AHUB_RXCIF_DAM0_RX1 +
-			(i2s->dam_ifc*2), i2s->txcif);
-
-	/*
-	*make the dam tx to i2s rx connection if this is the only client
-	*using i2s for playback
-	*/
-	if (i2s->playback_ref_count == 1)
-		tegra30_ahub_set_rx_cif_source(
-			TEGRA30_AHUB_RXCIF_I2S0_RX0 + i2s->id,
-			TEGRA30_AHUB_TXCIF_DAM0_TX0 + i2s->dam_ifc);
-
-	/* enable the dam*/
-	tegra30_dam_enable(i2s->dam_ifc, TEGRA30_DAM_ENABLE,
-			TEGRA30_DAM_CHIN1);
+	struct tegra30_i2s *i2s = snd_soc_dai_get_drvdata(rtd->cpu_dai);
 
-	return 0;
+	return tegra30_i2s_dam_startup(i2s, substream);
 }
 
 static void tegra_max98095_shutdown(struct snd_pcm_substream *substream)
 {
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
-	struct snd_soc_dai *cpu_dai = rtd->cpu_dai;
-	struct tegra30_i2s *i2s = snd_soc_dai_get_drvdata(cpu_dai);
-
-	if ((substream->stream != SNDRV_PCM_STREAM_PLAYBACK) ||
-		!(i2s->is_dam_used))
-		return;
-
-	/* disable the dam*/
-	tegra30_dam_enable(i2s->dam_ifc, TEGRA30_DAM_DISABLE,
-			TEGRA30_DAM_CHIN1);
-
-	/* disconnect the ahub connections*/
-	tegra30_ahub_unset_rx_cif_source(TEGRA30_AHUB_RXCIF_DAM0_RX1 +
-				(i2s->dam_ifc*2));
-
-	/* disable the dam and free the controller */
-	tegra30_dam_disable_clock(i2s->dam_ifc);
-	tegra30_dam_free_channel(i2s->dam_ifc, TEGRA30_DAM_CHIN1);
-	i2s->dam_ch_refcount--;
-	if (!i2s->dam_ch_refcount)
-		tegra30_dam_free_controller(i2s->dam_ifc);
+	struct tegra30_i2s *i2s = snd_soc_dai_get_drvdata(rtd->cpu_dai);
 
-	return;
+	tegra30_i2s_dam_shutdown(i2s, substream);
 }
 #endif
 
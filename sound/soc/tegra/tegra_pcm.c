@@ -42,6 +42,27 @@
 
 #define DRV_NAME "tegra-pcm-audio"
 
+/*
+ * Low latency mode: all periods of the ring are queued to a chained DMA
+ * channel, which starts each one as the previous ends, so small periods
+ * do not underrun while the completion interrupt is late.
+ */
+static bool low_latency;
+module_param(low_latency, bool, 0644);
+MODULE_PARM_DESC(low_latency, "Cyclic DMA with small periods for new streams");
+
+/*
+ * Deep buffer mode: playback on this PCM device gets a large buffer and
+ * periods of up to one maximal DMA request, a third of a second at
+ * 48kHz stereo, so background playback wakes the CPU rarely.
+ */
+static int deep_buffer_device = -1;
+module_param(deep_buffer_device, int, 0444);
+MODULE_PARM_DESC(deep_buffer_device, "PCM device with deep buffer playback");
+
+#define TEGRA_PCM_DEEP_PERIOD_BYTES	0x10000	/* max DMA request */
+#define TEGRA_PCM_DEEP_BUFFER_BYTES	(TEGRA_PCM_DEEP_PERIOD_BYTES * 4)
+
 static const struct snd_pcm_hardware tegra_pcm_hardware = {
 	.info			= SNDRV_PCM_INFO_MMAP |
 				  SNDRV_PCM_INFO_MMAP_VALID |
@@ -62,6 +83,52 @@ static const struct snd_pcm_hardware tegra_pcm_hardware = {
 	.fifo_size		= 4,
 };
 
+static const struct snd_pcm_hardware tegra_pcm_ll_hardware = {
+	.info			= SNDRV_PCM_INFO_MMAP |
+				  SNDRV_PCM_INFO_MMAP_VALID |
+				  SNDRV_PCM_INFO_PAUSE |
+				  SNDRV_PCM_INFO_RESUME |
+				  SNDRV_PCM_INFO_INTERLEAVED,
+	.formats		= SNDRV_PCM_FMTBIT_S8 |
+				  SNDRV_PCM_FMTBIT_S16_LE |
+				  SNDRV_PCM_FMTBIT_S24_LE |
+				  SNDRV_PCM_FMTBIT_S32_LE,
+	.channels_min		= 1,
+	.channels_max		= 2,
+	.period_bytes_min	= 64,
+	.period_bytes_max	= PAGE_SIZE,
+	.periods_min		= 2,
+	.periods_max		= MAX_DMA_REQ_COUNT_LL,
+	.buffer_bytes_max	= PAGE_SIZE * 4,
+	.fifo_size		= 4,
+};
+
+static const struct snd_pcm_hardware tegra_pcm_deep_hardware = {
+	.info			= SNDRV_PCM_INFO_MMAP |
+				  SNDRV_PCM_INFO_MMAP_VALID |
+				  SNDRV_PCM_INFO_PAUSE |
+				  SNDRV_PCM_INFO_RESUME |
+				  SNDRV_PCM_INFO_INTERLEAVED,
+	.formats		= SNDRV_PCM_FMTBIT_S8 |
+				  SNDRV_PCM_FMTBIT_S16_LE |
+				  SNDRV_PCM_FMTBIT_S24_LE |
+				  SNDRV_PCM_FMTBIT_S32_LE,
+	.channels_min		= 1,
+	.channels_max		= 2,
+	.period_bytes_min	= 128,
+	.period_bytes_max	= TEGRA_PCM_DEEP_PERIOD_BYTES,
+	.periods_min		= 2,
+	.periods_max		= 8,
+	.buffer_bytes_max	= TEGRA_PCM_DEEP_BUFFER_BYTES,
+	.fifo_size		= 4,
+};
+
+static bool tegra_pcm_is_deep(struct snd_pcm *pcm, int stream)
+{
+	return (stream == SNDRV_PCM_STREAM_PLAYBACK) &&
+		(pcm->device == deep_buffer_device);
+}
+
 static void tegra_pcm_queue_dma(struct tegra_runtime_data *prtd)
 {
 	struct snd_pcm_substream *substream = prtd->substream;
@@ -168,14 +235,18 @@ int tegra_pcm_allocate(struct snd_pcm_substream *substream,
 	spin_lock_init(&prtd->lock);
 
 	dmap = snd_soc_dai_get_dma_data(rtd->cpu_dai, substream);
-	prtd->dma_req_count = MAX_DMA_REQ_COUNT;
+	if (dma_mode & TEGRA_DMA_MODE_CHAINED)
+		prtd->dma_req_max = MAX_DMA_REQ_COUNT_LL;
+	else
+		prtd->dma_req_max = MAX_DMA_REQ_COUNT;
+	prtd->dma_req_count = prtd->dma_req_max;
 
 	if (dmap) {
 		for (i = 0; i < prtd->dma_req_count; i++)
 			prtd->dma_req[i].dev = prtd;
 
 		prtd->dma_chan = tegra_dma_allocate_channel(
-					dma_mode,
+					dma_mode | TEGRA_DMA_PRIO_HIGH,
 					"pcm");
 		if (prtd->dma_chan == NULL) {
 			ret = -ENOMEM;
@@ -212,6 +283,16 @@ err:
 
 static int tegra_pcm_open(struct snd_pcm_substream *substream)
 {
+	if (tegra_pcm_is_deep(substream->pcm, substream->stream))
+		return tegra_pcm_allocate(substream,
+					TEGRA_DMA_MODE_CONTINUOUS_SINGLE,
+					&tegra_pcm_deep_hardware);
+
+	if (low_latency)
+		return tegra_pcm_allocate(substream,
+					TEGRA_DMA_MODE_CHAINED,
+					&tegra_pcm_ll_hardware);
+
 	return tegra_pcm_allocate(substream,
 					TEGRA_DMA_MODE_CONTINUOUS_SINGLE,
 					&tegra_pcm_hardware);
@@ -243,8 +324,8 @@ int tegra_pcm_hw_params(struct snd_pcm_substream *substream,
 	snd_pcm_set_runtime_buffer(substream, &substream->dma_buffer);
 
 	/* Limit dma_req_count to period count */
-	if (prtd->dma_req_count > params_periods(params))
-		prtd->dma_req_count = params_periods(params);
+	prtd->dma_req_count = min(prtd->dma_req_max,
+				  (int)params_periods(params));
 	dmap = snd_soc_dai_get_dma_data(rtd->cpu_dai, substream);
 	if (dmap) {
 		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
@@ -293,8 +374,8 @@ int tegra_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 		} else if (!prtd->dma_req[0].complete) {
 			prtd->dma_req[0].complete = dma_complete_callback;
 			prtd->dma_req_count =
-				(MAX_DMA_REQ_COUNT <= runtime->periods) ?
-				MAX_DMA_REQ_COUNT : runtime->periods;
+				(prtd->dma_req_max <= runtime->periods) ?
+				prtd->dma_req_max : runtime->periods;
 		}
 		/* Fall-through */
 	case SNDRV_PCM_TRIGGER_RESUME:
@@ -331,12 +412,17 @@ snd_pcm_uframes_t tegra_pcm_pointer(struct snd_pcm_substream *substream)
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct tegra_runtime_data *prtd = runtime->private_data;
 	int dma_transfer_count;
+	snd_pcm_uframes_t pos;
 
 	dma_transfer_count = tegra_dma_get_transfer_count(prtd->dma_chan,
 					&prtd->dma_req[prtd->dma_req_idx]);
 
-	return prtd->period_index * runtime->period_size +
+	/* a finished period whose interrupt is pending reads as full */
+	pos = prtd->period_index * runtime->period_size +
 		bytes_to_frames(runtime, dma_transfer_count);
+	if (pos >= runtime->buffer_size)
+		pos -= runtime->buffer_size;
+	return pos;
 }
 
 int tegra_pcm_mmap(struct snd_pcm_substream *substream,
@@ -436,6 +522,7 @@ int tegra_pcm_dma_allocate(struct snd_soc_pcm_runtime *rtd, size_t size)
 {
 	struct snd_card *card = rtd->card->snd_card;
 	struct snd_pcm *pcm = rtd->pcm;
+	size_t play_size = size;
 	int ret = 0;
 
 	if (!card->dev->dma_mask)
@@ -444,9 +531,12 @@ int tegra_pcm_dma_allocate(struct snd_soc_pcm_runtime *rtd, size_t size)
 		card->dev->coherent_dma_mask = DMA_BIT_MASK(32);
 
 	if (pcm->streams[SNDRV_PCM_STREAM_PLAYBACK].substream) {
+		if (tegra_pcm_is_deep(pcm, SNDRV_PCM_STREAM_PLAYBACK))
+			play_size = max_t(size_t, size,
+					  TEGRA_PCM_DEEP_BUFFER_BYTES);
 		ret = tegra_pcm_preallocate_dma_buffer(pcm,
 						SNDRV_PCM_STREAM_PLAYBACK,
-						size);
+						play_size);
 		if (ret)
 			goto err;
 	}
@@ -35,6 +35,8 @@
 #include <linux/nvmap.h>
 
 #define MAX_DMA_REQ_COUNT 2
+/* low latency: every period of the ring is a queued request */
+#define MAX_DMA_REQ_COUNT_LL 16
 
 #define TEGRA30_USE_SMMU 0
 
@@ -53,9 +55,10 @@ struct tegra_runtime_data {
 	int dma_pos_end;
 	int period_index;
 	int dma_req_idx;
-	struct tegra_dma_req dma_req[MAX_DMA_REQ_COUNT];
+	struct tegra_dma_req dma_req[MAX_DMA_REQ_COUNT_LL];
 	struct tegra_dma_channel *dma_chan;
 	int dma_req_count;
+	int dma_req_max;
 	int disable_intr;
 	unsigned int avp_dma_addr;
 };
@@ -0,0 +1,554 @@
+/*
+ * Micro-benchmarks for the user space entry points of Tegra kernel hot
+ * paths: nvmap alloc/free, pin/unpin and cache maintenance, nvhost
+ * submit plus syncpoint wait, and binder round trips.
+ *
+ * Output matches /sys/kernel/debug/tegra_hotpath_bench/results, one line
+ * per benchmark with all times in nanoseconds:
+ *
+ *   # name iterations min_ns avg_ns max_ns
+ *
+ * Usage: hotpath_bench [iterations]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <linux/types.h>
+
+#include "../../../../drivers/video/tegra/nvmap/nvmap_ioctl.h"
+#include "../../../../include/linux/nvhost_ioctl.h"
+#include "../../../../drivers/staging/android/binder.h"
+
+/* from include/linux/nvmap.h, which is not usable from user space */
+#define NVMAP_HEAP_IOVMM		(1ul << 30)
+#define NVMAP_HANDLE_WRITE_COMBINE	(0x1ul << 0)
+#define NVMAP_HANDLE_CACHEABLE		(0x3ul << 0)
+
+/* host1x opcodes, see drivers/video/tegra/host/host1x/host1x01_hardware.h */
+#define HOST1X_CLASS_ID			0x1
+#define HOST1X_OPCODE_SETCLASS(c)	(((c) << 6))
+#define HOST1X_OPCODE_IMM_INCR_SYNCPT(id) \
+	((4u << 28) | (0 << 16) | (1 << 8) | (id))
+
+#define BENCH_BUF_SIZE		(64 * 1024)
+#define BENCH_BINDER_MAP_SIZE	(128 * 1024)
+
+struct bench_stats {
+	unsigned int iters;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint64_t total_ns;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench_account(struct bench_stats *s, uint64_t start)
+{
+	uint64_t ns = now_ns() - start;
+
+	if (!s->iters || ns < s->min_ns)
+		s->min_ns = ns;
+	if (ns > s->max_ns)
+		s->max_ns = ns;
+	s->total_ns += ns;
+	s->iters++;
+}
+
+static int nvmap_create_alloc(int fd, unsigned int flags, __u32 *handle)
+{
+	struct nvmap_create_handle create = { .size = BENCH_BUF_SIZE };
+	struct nvmap_alloc_handle alloc;
+
+	if (ioctl(fd, NVMAP_IOC_CREATE, &create))
+		return -errno;
+
+	memset(&alloc, 0, sizeof(alloc));
+	alloc.handle = create.handle;
+	alloc.heap_mask = NVMAP_HEAP_IOVMM;
+	alloc.flags = flags;
+	alloc.align = 4096;
+
+	if (ioctl(fd, NVMAP_IOC_ALLOC, &alloc)) {
+		int err = -errno;
+
+		ioctl(fd, NVMAP_IOC_FREE, create.handle);
+		return err;
+	}
+
+	*handle = create.handle;
+	return 0;
+}
+
+static int bench_nvmap_alloc_free(struct bench_stats *s, unsigned int iters)
+{
+	unsigned int i;
+	uint64_t start;
+	__u32 handle;
+	int fd, err = 0;
+
+	fd = open("/dev/nvmap", O_RDWR);
+	if (fd < 0)
+		return -errno;
+
+	for (i = 0; i < iters; i++) {
+		start = now_ns();
+		err = nvmap_create_alloc(fd, NVMAP_HANDLE_WRITE_COMBINE,
+					 &handle);
+		if (err)
+			break;
+		ioctl(fd, NVMAP_IOC_FREE, handle);
+		bench_account(s, start);
+	}
+
+	close(fd);
+	return err;
+}
+
+static int bench_nvmap_pin_unpin(struct bench_stats *s, unsigned int iters)
+{
+	struct nvmap_pin_handle pin;
+	unsigned int i;
+	uint64_t start;
+	__u32 handle;
+	int fd, err;
+
+	fd = open("/dev/nvmap", O_RDWR);
+	if (fd < 0)
+		return -errno;
+
+	err = nvmap_create_alloc(fd, NVMAP_HANDLE_WRITE_COMBINE, &handle);
+	if (err)
+		goto out;
+
+	for (i = 0; i < iters; i++) {
+		memset(&pin, 0, sizeof(pin));
+		pin.handles = handle;
+		pin.count = 1;
+
+		start = now_ns();
+		if (ioctl(fd, NVMAP_IOC_PIN_MULT, &pin)) {
+			err = -errno;
+			break;
+		}
+		ioctl(fd, NVMAP_IOC_UNPIN_MULT, &pin);
+		bench_account(s, start);
+	}
+
+	ioctl(fd, NVMAP_IOC_FREE, handle);
+out:
+	close(fd);
+	return err;
+}
+
+static int bench_nvmap_cache_maint(struct bench_stats *s, unsigned int iters)
+{
+	struct nvmap_map_caller map;
+	struct nvmap_cache_op op;
+	unsigned int i;
+	uint64_t start;
+	__u32 handle;
+	void *addr;
+	int fd, err;
+
+	fd = open("/dev/nvmap", O_RDWR);
+	if (fd < 0)
+		return -errno;
+
+	err = nvmap_create_alloc(fd, NVMAP_HANDLE_CACHEABLE, &handle);
+	if (err)
+		goto out;
+
+	addr = mmap(NULL, BENCH_BUF_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    fd, 0);
+	if (addr == MAP_FAILED) {
+		err = -errno;
+		goto out_free;
+	}
+
+	memset(&map, 0, sizeof(map));
+	map.handle = handle;
+	map.length = BENCH_BUF_SIZE;
+	map.flags = NVMAP_HANDLE_CACHEABLE;
+	map.addr = (unsigned long)addr;
+	if (ioctl(fd, NVMAP_IOC_MMAP, &map)) {
+		err = -errno;
+		goto out_unmap;
+	}
+
+	for (i = 0; i < iters; i++) {
+		/* dirty the lines so there is something to write back */
+		memset(addr, i, BENCH_BUF_SIZE);
+
+		memset(&op, 0, sizeof(op));
+		op.addr = (unsigned long)addr;
+		op.handle = handle;
+		op.len = BENCH_BUF_SIZE;
+		op.op = NVMAP_CACHE_OP_WB_INV;
+
+		start = now_ns();
+		if (ioctl(fd, NVMAP_IOC_CACHE, &op)) {
+			err = -errno;
+			break;
+		}
+		bench_account(s, start);
+	}
+
+out_unmap:
+	munmap(addr, BENCH_BUF_SIZE);
+out_free:
+	ioctl(fd, NVMAP_IOC_FREE, handle);
+out:
+	close(fd);
+	return err;
+}
+
+/* a one-gather job that only increments the channel syncpoint */
+static int bench_nvhost_submit_wait(struct bench_stats *s, unsigned int iters)
+{
+	struct nvhost_set_nvmap_fd_args nvmap_fd_args;
+	struct nvhost_get_param_args param;
+	struct nvhost_ctrl_syncpt_wait_args wait;
+	struct nvhost_submit_args submit;
+	struct nvhost_syncpt_incr incr;
+	struct nvhost_cmdbuf cmdbuf;
+	struct nvmap_map_caller map;
+	int nvmap_fd, ctrl_fd, ch_fd;
+	unsigned int i, id;
+	uint64_t start;
+	__u32 handle, *cmds;
+	int err;
+
+	nvmap_fd = open("/dev/nvmap", O_RDWR);
+	ctrl_fd = open("/dev/nvhost-ctrl", O_RDWR);
+	ch_fd = open("/dev/nvhost-gr2d", O_RDWR);
+	if (nvmap_fd < 0 || ctrl_fd < 0 || ch_fd < 0) {
+		err = -ENODEV;
+		goto out;
+	}
+
+	nvmap_fd_args.fd = nvmap_fd;
+	if (ioctl(ch_fd, NVHOST_IOCTL_CHANNEL_SET_NVMAP_FD, &nvmap_fd_args) ||
+	    ioctl(ch_fd, NVHOST_IOCTL_CHANNEL_GET_SYNCPOINTS, &param)) {
+		err = -errno;
+		goto out;
+	}
+	if (!param.value) {
+		err = -ENODEV;
+		goto out;
+	}
+	id = __builtin_ctz(param.value);
+
+	err = nvmap_create_alloc(nvmap_fd, NVMAP_HANDLE_WRITE_COMBINE, &handle);
+	if (err)
+		goto out;
+
+	cmds = mmap(NULL, BENCH_BUF_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    nvmap_fd, 0);
+	if (cmds == MAP_FAILED) {
+		err = -errno;
+		goto out_free;
+	}
+
+	memset(&map, 0, sizeof(map));
+	map.handle = handle;
+	map.length = BENCH_BUF_SIZE;
+	map.flags = NVMAP_HANDLE_WRITE_COMBINE;
+	map.addr = (unsigned long)cmds;
+	if (ioctl(nvmap_fd, NVMAP_IOC_MMAP, &map)) {
+		err = -errno;
+		goto out_unmap;
+	}
+
+	cmds[0] = HOST1X_OPCODE_SETCLASS(HOST1X_CLASS_ID);
+	cmds[1] = HOST1X_OPCODE_IMM_INCR_SYNCPT(id);
+
+	for (i = 0; i < iters; i++) {
+		memset(&submit, 0, sizeof(submit));
+		incr.syncpt_id = id;
+		incr.syncpt_incrs = 1;
+		cmdbuf.mem = handle;
+		cmdbuf.offset = 0;
+		cmdbuf.words = 2;
+
+		submit.submit_version = NVHOST_SUBMIT_VERSION_MAX_SUPPORTED;
+		submit.num_syncpt_incrs = 1;
+		submit.num_cmdbufs = 1;
+		submit.syncpt_incrs = &incr;
+		submit.cmdbufs = &cmdbuf;
+
+		start = now_ns();
+		if (ioctl(ch_fd, NVHOST_IOCTL_CHANNEL_SUBMIT, &submit)) {
+			err = -errno;
+			break;
+		}
+
+		wait.id = id;
+		wait.thresh = submit.fence;
+		wait.timeout = 1000;
+		if (ioctl(ctrl_fd, NVHOST_IOCTL_CTRL_SYNCPT_WAIT, &wait)) {
+			err = -errno;
+			break;
+		}
+		bench_account(s, start);
+	}
+
+out_unmap:
+	munmap(cmds, BENCH_BUF_SIZE);
+out_free:
+	ioctl(nvmap_fd, NVMAP_IOC_FREE, handle);
+out:
+	if (ch_fd >= 0)
+		close(ch_fd);
+	if (ctrl_fd >= 0)
+		close(ctrl_fd);
+	if (nvmap_fd >= 0)
+		close(nvmap_fd);
+	return err;
+}
+
+struct binder_conn {
+	int fd;
+	void *map;
+};
+
+static int binder_open(struct binder_conn *b)
+{
+	b->fd = open("/dev/binder", O_RDWR);
+	if (b->fd < 0)
+		return -errno;
+
+	b->map = mmap(NULL, BENCH_BINDER_MAP_SIZE, PROT_READ, MAP_PRIVATE,
+		      b->fd, 0);
+	if (b->map == MAP_FAILED) {
+		close(b->fd);
+		return -errno;
+	}
+
+	return 0;
+}
+
+static int binder_write(struct binder_conn *b, void *data, size_t len)
+{
+	struct binder_write_read bwr;
+
+	memset(&bwr, 0, sizeof(bwr));
+	bwr.write_size = len;
+	bwr.write_buffer = (unsigned long)data;
+
+	return ioctl(b->fd, BINDER_WRITE_READ, &bwr) ? -errno : 0;
+}
+
+/*
+ * Write the pending commands, then read until 'until' shows up. Return
+ * codes all carry their payload size, so unknown ones are skipped.
+ */
+static int binder_transact(struct binder_conn *b, void *wbuf, size_t wlen,
+			   uint32_t until, struct binder_transaction_data *tr)
+{
+	struct binder_write_read bwr;
+	uint32_t rbuf[64];
+
+	memset(&bwr, 0, sizeof(bwr));
+	bwr.write_size = wlen;
+	bwr.write_buffer = (unsigned long)wbuf;
+
+	for (;;) {
+		char *p = (char *)rbuf, *end;
+
+		bwr.read_size = sizeof(rbuf);
+		bwr.read_consumed = 0;
+		bwr.read_buffer = (unsigned long)rbuf;
+
+		if (ioctl(b->fd, BINDER_WRITE_READ, &bwr))
+			return -errno;
+
+		bwr.write_size = 0;
+		end = p + bwr.read_consumed;
+
+		while (p < end) {
+			uint32_t cmd = *(uint32_t *)p;
+
+			p += sizeof(cmd);
+			if (cmd == BR_DEAD_REPLY || cmd == BR_FAILED_REPLY)
+				return -EPIPE;
+			if (cmd == until) {
+				memcpy(tr, p, sizeof(*tr));
+				return 0;
+			}
+			p += _IOC_SIZE(cmd);
+		}
+	}
+}
+
+static void binder_server(struct binder_conn *b, int ready_fd)
+{
+	struct binder_transaction_data tr;
+	struct {
+		uint32_t free_cmd;
+		const void *buffer;
+		uint32_t reply_cmd;
+		struct binder_transaction_data reply;
+	} __attribute__((packed)) cmds;
+	uint32_t looper = BC_ENTER_LOOPER;
+	char ok = 0;
+
+	if (!ioctl(b->fd, BINDER_SET_CONTEXT_MGR, 0) &&
+	    !binder_write(b, &looper, sizeof(looper)))
+		ok = 1;
+
+	write(ready_fd, &ok, 1);
+	if (!ok)
+		_exit(1);
+
+	memset(&cmds, 0, sizeof(cmds));
+	cmds.free_cmd = BC_FREE_BUFFER;
+	cmds.reply_cmd = BC_REPLY;
+
+	if (binder_transact(b, NULL, 0, BR_TRANSACTION, &tr))
+		_exit(1);
+
+	for (;;) {
+		cmds.buffer = tr.data.ptr.buffer;
+		if (binder_transact(b, &cmds, sizeof(cmds), BR_TRANSACTION,
+				    &tr))
+			_exit(1);
+	}
+}
+
+static int bench_binder_roundtrip(struct bench_stats *s, unsigned int iters)
+{
+	struct binder_transaction_data reply;
+	struct {
+		uint32_t cmd;
+		struct binder_transaction_data tr;
+	} __attribute__((packed)) call;
+	struct {
+		uint32_t cmd;
+		const void *buffer;
+	} __attribute__((packed)) release;
+	struct binder_conn server, client;
+	uint32_t payload = 0;
+	int pipe_fd[2], err, status;
+	unsigned int i;
+	uint64_t start;
+	pid_t pid;
+	char ok = 0;
+
+	if (pipe(pipe_fd))
+		return -errno;
+
+	pid = fork();
+	if (pid < 0) {
+		err = -errno;
+		goto out_pipe;
+	}
+
+	if (pid == 0) {
+		close(pipe_fd[0]);
+		if (binder_open(&server))
+			write(pipe_fd[1], &ok, 1);
+		else
+			binder_server(&server, pipe_fd[1]);
+		_exit(1);
+	}
+
+	/* a running servicemanager owns the context, nothing to talk to */
+	if (read(pipe_fd[0], &ok, 1) != 1 || !ok) {
+		err = -EBUSY;
+		goto out_child;
+	}
+
+	err = binder_open(&client);
+	if (err)
+		goto out_child;
+
+	memset(&call, 0, sizeof(call));
+	call.cmd = BC_TRANSACTION;
+	call.tr.target.handle = 0;
+	call.tr.code = 1;
+	call.tr.data_size = sizeof(payload);
+	call.tr.data.ptr.buffer = &payload;
+
+	release.cmd = BC_FREE_BUFFER;
+
+	for (i = 0; i < iters; i++) {
+		start = now_ns();
+		err = binder_transact(&client, &call, sizeof(call), BR_REPLY,
+				      &reply);
+		if (err)
+			break;
+		bench_account(s, start);
+
+		release.buffer = reply.data.ptr.buffer;
+		binder_write(&client, &release, sizeof(release));
+	}
+
+	munmap(client.map, BENCH_BINDER_MAP_SIZE);
+	close(client.fd);
+out_child:
+	kill(pid, SIGKILL);
+	waitpid(pid, &status, 0);
+out_pipe:
+	close(pipe_fd[0]);
+	close(pipe_fd[1]);
+	return err;
+}
+
+static const struct {
+	const char *name;
+	unsigned int iters;
+	int (*run)(struct bench_stats *s, unsigned int iters);
+} benches[] = {
+	{ "nvmap_alloc_free",	10000,	bench_nvmap_alloc_free },
+	{ "nvmap_pin_unpin",	10000,	bench_nvmap_pin_unpin },
+	{ "nvmap_cache_maint",	1000,	bench_nvmap_cache_maint },
+	{ "nvhost_submit_wait",	1000,	bench_nvhost_submit_wait },
+	{ "binder_roundtrip",	10000,	bench_binder_roundtrip },
+};
+
+int main(int argc, char **argv)
+{
+	unsigned int i, iters = 0;
+
+	if (argc > 1)
+		iters = strtoul(argv[1], NULL, 0);
+
+	printf("# name iterations min_ns avg_ns max_ns\n");
+
+	for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		struct bench_stats s;
+		int err;
+
+		memset(&s, 0, sizeof(s));
+		err = benches[i].run(&s, iters ? iters : benches[i].iters);
+
+		if (err && !s.iters) {
+			printf("%s skipped %d\n", benches[i].name, err);
+			continue;
+		}
+
+		printf("%s %u %llu %llu %llu\n", benches[i].name, s.iters,
+		       (unsigned long long)s.min_ns,
+		       (unsigned long long)(s.total_ns / s.iters),
+		       (unsigned long long)s.max_ns);
+	}
+
+	return 0;
+}